@@ -24,6 +24,8 @@ template <typename ElemType>
 void DoAdapt(const ConfigParameters& config);
 template <typename ElemType>
 void DoEdit(const ConfigParameters& config);
+template <typename ElemType>
+void DoBenchmarkGradientAggregation(const ConfigParameters& config);
 
 // evaluation (EvalActions.cpp)
 template <typename ElemType>
@@ -32,13 +34,19 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoEnsembleWriteOutput(const ConfigParameters& config);
 
 // misc (OtherActions.cp)
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoBenchmarkReader(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
+void DoExportModel(const ConfigParameters& config);
+template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
@@ -17,6 +17,7 @@
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "EnsembleOutputWriter.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
@@ -67,7 +68,7 @@ static void DoEvalBase(const ConfigParameters& config, IDataReader<ElemType>& re
 
     auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
 
-    SimpleEvaluator<ElemType> eval(net, numMBsToShowResult, traceLevel);
+    SimpleEvaluator<ElemType> eval(net, numMBsToShowResult, traceLevel, g_mpi); // (with parallelTrain, data-parallel over all ranks)
     eval.Evaluate(&reader, evalNodeNamesVector, mbSize[0], epochSize);
 }
 
@@ -147,7 +148,7 @@ void DoCrossValidate(const ConfigParameters& config)
         cvModels.push_back(cvModelPath);
         auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, cvModelPath);
 
-        SimpleEvaluator<ElemType> eval(net, numMBsToShowResult, traceLevel);
+        SimpleEvaluator<ElemType> eval(net, numMBsToShowResult, traceLevel, g_mpi);
 
         fprintf(stderr, "model %ls --> \n", cvModelPath.c_str());
         auto evalErrors = eval.Evaluate(&cvDataReader, evalNodeNamesVector, mbSize[0], epochSize);
@@ -228,7 +229,7 @@ void DoWriteOutput(const ConfigParameters& config)
 
     auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
 
-    SimpleOutputWriter<ElemType> writer(net, 1);
+    SimpleOutputWriter<ElemType> writer(net, 1, g_mpi); // (with parallelTrain, writing to an outputPath is data-parallel over all ranks)
 
     if (config.Exists("writer"))
     {
@@ -240,10 +241,80 @@ void DoWriteOutput(const ConfigParameters& config)
     else if (config.Exists("outputPath"))
     {
         wstring outputPath = config(L"outputPath"); // crashes if no default given?
-        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, epochSize);
+        size_t outputTopK = config(L"outputTopK", "0"); // if not 0, write only this many "index:value" pairs per sample
+        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, epochSize, outputTopK);
     }
     // writer.WriteOutput(testDataReader, mbSize[0], testDataWriter, outputNodeNamesVector, epochSize);
 }
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoEnsembleWriteOutput() - implements CNTK "ensembleWrite" command
+// Like "write", for several models (modelPaths) on the same data, which is read once for all of them.
+// deviceIds optionally gives each model a device of its own (default: all on deviceId), so that they run concurrently.
+// combine=each writes the models' outputs to <outputPath>.<node>.model<i>, combine=average their average to
+// <outputPath>.<node>, and combine=both does both.
+// ===========================================================================
+
+template <typename ElemType>
+void DoEnsembleWriteOutput(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    readerConfig.Insert("randomize", "None"); // we don't want randomization when output results
+
+    DataReader<ElemType> testDataReader(readerConfig);
+
+    ConfigArray minibatchSize = config(L"minibatchSize", "2048");
+    intargvector mbSize = minibatchSize;
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+    {
+        epochSize = requestDataSize;
+    }
+
+    ConfigArray modelPaths = config(L"modelPaths");
+    if (modelPaths.size() == 0)
+        InvalidArgument("ensembleWrite: No modelPaths given.");
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    std::vector<DEVICEID_TYPE> deviceIds(modelPaths.size(), deviceId);
+    if (config.Exists("deviceIds"))
+    {
+        intargvector ids = ConfigArray(config(L"deviceIds"));
+        if (ids.size() != modelPaths.size())
+            InvalidArgument("ensembleWrite: deviceIds must give one device per model.");
+        for (size_t m = 0; m < ids.size(); m++)
+        {
+            deviceIds[m] = (DEVICEID_TYPE) ids[m];
+            if (deviceIds[m] >= 0 && deviceIds[m] != deviceId)
+                AllowAdditionalGPU(deviceIds[m]); // (exempt from EnforceOneGPUOnly())
+        }
+    }
+
+    std::vector<ComputationNetworkPtr> nets;
+    for (size_t m = 0; m < modelPaths.size(); m++)
+    {
+        wstring modelPath = modelPaths[m];
+        nets.push_back(ComputationNetwork::CreateFromFile<ElemType>(deviceIds[m], modelPath));
+    }
+
+    ConfigArray outputNodeNames = config(L"outputNodeNames", "");
+    vector<wstring> outputNodeNamesVector;
+    for (int i = 0; i < outputNodeNames.size(); ++i)
+    {
+        outputNodeNamesVector.push_back(outputNodeNames[i]);
+    }
+
+    wstring outputPath = config(L"outputPath");
+    string combine = config(L"combine", "average");
+    if (combine != "each" && combine != "average" && combine != "both")
+        InvalidArgument("ensembleWrite: combine must be 'each', 'average', or 'both'.");
+
+    EnsembleOutputWriter<ElemType> writer(nets);
+    writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, combine != "average", combine != "each", epochSize);
+}
+
+template void DoEnsembleWriteOutput<float>(const ConfigParameters& config);
+template void DoEnsembleWriteOutput<double>(const ConfigParameters& config);
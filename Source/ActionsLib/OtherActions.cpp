@@ -13,8 +13,12 @@
 #include "ComputationNetwork.h"
 #include "ComputationNode.h"
 #include "Config.h"
+#include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "Vocabulary.h"
+#include "MPIWrapper.h"
+#include "TimerUtility.h"
 
 #include <string>
 #include <chrono>
@@ -117,6 +121,145 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoBenchmarkReader() - implements CNTK "benchmarkReader" command
+// ===========================================================================
+
+// Reads minibatches from any reader as fast as it delivers them, without a network, and reports its throughput
+// (samples/s and MB/s), percentiles of the time per GetMinibatch() call, and the CPU usage of the process meanwhile.
+// This is for sizing the reader's threads and catching throughput regressions in reader code.
+//  - reader: the reader section; its inputs are the feature and label sections that GetFileConfigNames() finds
+//  - minibatchSize (256), epochSize (0: the whole corpus), epoch (0): as for training
+//  - numMBs: number of minibatches to time (0, the default: the whole epoch)
+//  - numWarmupMBs: minibatches read before the timing starts (default 1), while readers open files and load their first chunks
+//  - deviceId: where the minibatches go (default: CPU); a GPU includes the copy to it in the timing
+//  - distributedMBReading: with MPI, each rank reads its subset of each minibatch as in data-parallel training
+//    (default false: each rank reads all data). The main node then also reports the sums over all ranks.
+template <typename ElemType>
+void DoBenchmarkReader(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    size_t minibatchSize = config(L"minibatchSize", "256");
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+    size_t epoch = config(L"epoch", "0");
+    size_t numMBs = config(L"numMBs", "0");
+    size_t numWarmupMBs = config(L"numWarmupMBs", "1");
+    bool distributedMBReading = config(L"distributedMBReading", "false");
+    DEVICEID_TYPE deviceId = config.ExistsCurrent(L"deviceId") ? DeviceFromConfig(config) : CPUDEVICE;
+
+    // one matrix per input of the reader
+    vector<wstring> inputNames;
+    vector<wstring> labelNames;
+    GetFileConfigNames(readerConfig, inputNames, labelNames);
+    inputNames.insert(inputNames.end(), labelNames.begin(), labelNames.end());
+    if (inputNames.empty())
+        InvalidArgument("BenchmarkReader: The reader section has no feature or label inputs.");
+    vector<shared_ptr<Matrix<ElemType>>> inputMatrices;
+    std::map<std::wstring, Matrix<ElemType>*> matrices;
+    for (const auto& name : inputNames)
+    {
+        inputMatrices.push_back(make_shared<Matrix<ElemType>>(deviceId));
+        matrices[name] = inputMatrices.back().get();
+    }
+
+    const size_t numRanks = g_mpi ? g_mpi->NumNodesInUse() : 1;
+    const size_t rank = g_mpi ? g_mpi->CurrentNodeRank() : 0;
+    distributedMBReading = distributedMBReading && numRanks > 1;
+
+    Timer timer;
+    timer.Start();
+    DataReader<ElemType> reader(readerConfig);
+    if (distributedMBReading)
+    {
+        if (!reader.SupportsDistributedMBRead())
+            InvalidArgument("BenchmarkReader: distributedMBReading was requested, but the reader does not support it.");
+        reader.StartDistributedMinibatchLoop(minibatchSize, epoch, rank, numRanks, epochSize);
+    }
+    else
+        reader.StartMinibatchLoop(minibatchSize, epoch, epochSize);
+    timer.Stop();
+    fprintf(stderr, "BenchmarkReader: Created the reader and started the epoch in %.3f seconds.\n", timer.ElapsedSeconds());
+
+    // read and time the minibatches
+    vector<double> mbSeconds;
+    size_t numSamples = 0;
+    double numBytes = 0;
+    double cpuSecondsAtStart = ProcessCpuSeconds();
+    Timer mbTimer;
+    timer.Restart();
+    for (size_t mbIndex = 0; numMBs == 0 || mbSeconds.size() < numMBs; mbIndex++)
+    {
+        if (mbIndex == numWarmupMBs) // warm-up done: restart the clocks
+        {
+            cpuSecondsAtStart = ProcessCpuSeconds();
+            timer.Restart();
+        }
+        mbTimer.Restart();
+        if (!reader.GetMinibatch(matrices))
+            break;
+        mbTimer.Stop();
+        if (mbIndex < numWarmupMBs)
+            continue;
+        mbSeconds.push_back(mbTimer.ElapsedSeconds());
+        numSamples += matrices[inputNames[0]]->GetNumCols();
+        for (const auto& m : inputMatrices)
+        {
+            if (m->GetMatrixType() == MatrixType::SPARSE)
+                numBytes += (double) m->NzCount() * (sizeof(ElemType) + sizeof(int)); // values and their row indices
+            else
+                numBytes += (double) m->GetNumElements() * sizeof(ElemType);
+        }
+    }
+    timer.Stop();
+    const double seconds = max(timer.ElapsedSeconds(), 1e-9);
+    const double cpuSeconds = ProcessCpuSeconds() - cpuSecondsAtStart;
+
+    if (mbSeconds.empty())
+        fprintf(stderr, "BenchmarkReader: WARNING: The epoch ended within the %d warm-up minibatches, nothing was timed.\n", (int) numWarmupMBs);
+    sort(mbSeconds.begin(), mbSeconds.end());
+    auto percentile = [&](double p) -> double // nearest rank
+    {
+        if (mbSeconds.empty())
+            return 0;
+        size_t rankP = (size_t) ceil(p * mbSeconds.size());
+        return mbSeconds[max(rankP, (size_t) 1) - 1];
+    };
+    double sumMBSeconds = 0;
+    for (double s : mbSeconds)
+        sumMBSeconds += s;
+
+    string rankInfo;
+    if (numRanks > 1)
+        rankInfo = msra::strfun::strprintf(" (rank %d of %d)", (int) rank, (int) numRanks);
+    fprintf(stderr, "BenchmarkReader%s: Read %d minibatches, %d samples, %.1f MB in %.3f seconds: %.1f samples/s, %.2f MB/s\n",
+            rankInfo.c_str(), (int) mbSeconds.size(), (int) numSamples, numBytes / 1e6, seconds, numSamples / seconds, numBytes / 1e6 / seconds);
+    fprintf(stderr, "BenchmarkReader%s: Seconds per minibatch: mean %.5f, 50%% %.5f, 90%% %.5f, 99%% %.5f, max %.5f\n",
+            rankInfo.c_str(), mbSeconds.empty() ? 0 : sumMBSeconds / mbSeconds.size(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+    fprintf(stderr, "BenchmarkReader%s: CPU usage %.1f%% (%.2f cores busy on average)\n",
+            rankInfo.c_str(), 100 * cpuSeconds / seconds, cpuSeconds / seconds);
+
+    // totals over all ranks
+    if (numRanks > 1)
+    {
+        vector<double> totals(4);
+        totals[0] = (double) numSamples;
+        totals[1] = numBytes;
+        totals[2] = numSamples / seconds;
+        totals[3] = numBytes / seconds;
+        g_mpi->AllReduce(totals);
+        if (g_mpi->IsMainNode())
+            fprintf(stderr, "BenchmarkReader: All %d ranks read %.0f samples, %.1f MB: %.1f samples/s, %.2f MB/s (%s)\n",
+                    (int) numRanks, totals[0], totals[1] / 1e6, totals[2], totals[3] / 1e6,
+                    distributedMBReading ? "distributed reading" : "each rank read all data");
+    }
+}
+
+template void DoBenchmarkReader<float>(const ConfigParameters& config);
+template void DoBenchmarkReader<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
@@ -137,6 +280,10 @@ template void DoCreateLabelMap<double>(const ConfigParameters& config);
 //                  3)  KeepRatio           -- how many percentage of energy we want to keep
 //                  4)  AlignedSize         -- the resultant number of signular values is aligned to e.g., 32 or 64
 //                  5)  ParameterName       -- name (regex) of the parameter node we want to perform a SVD decomposition
+//          optionally:
+//                  6)  SVDMethod           -- "full" (default; on the CPU) or "randomized" (top singular values only, on deviceId;
+//                                             the KeepRatio is then the fraction of singular values kept, not of their energy)
+//                  7)  numPowerIterations  -- for "randomized": more are more accurate (default 2)
 //
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -168,7 +315,12 @@ void SVDConfigFileUsage()
 template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config)
 {
-    DEVICEID_TYPE deviceID = -1; // use CPU for SVD
+    wstring svdMethod = config(L"SVDMethod", L"full");
+    if (svdMethod != L"full" && svdMethod != L"randomized")
+        InvalidArgument("SVDMethod: '%ls' is not one of 'full', 'randomized'.", svdMethod.c_str());
+    bool randomized = svdMethod == L"randomized";
+    size_t numPowerIterations = config(L"numPowerIterations", "2");
+    DEVICEID_TYPE deviceID = randomized ? DeviceFromConfig(config) : -1; // full SVD is on the CPU
     wstring modelPath = config(L"modelPath");
     wstring outputmodelPath = config(L"outputmodelPath");
     map<wstring, float> svdconfig;
@@ -200,7 +352,7 @@ void DoParameterSVD(const ConfigParameters& config)
     ComputationNetwork net(deviceID);
     net.Load<ElemType>(modelPath);
 
-    net.PerformSVDecomposition<ElemType>(svdconfig, AlignedSize);
+    net.PerformSVDecomposition<ElemType>(svdconfig, AlignedSize, randomized, numPowerIterations);
     if (!outputmodelPath.empty())
         net.Save(outputmodelPath);
 }
@@ -208,6 +360,52 @@ void DoParameterSVD(const ConfigParameters& config)
 template void DoParameterSVD<float>(const ConfigParameters& config);
 template void DoParameterSVD<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoExportModel() - implements CNTK "exportModel" command
+// ===========================================================================
+
+//////////////////////////////////////////////////////////////////////////
+//  for action exportModel
+//      Rewrites a model with the LearnableParameter values stored in a compact format, for deployment.
+//
+//      To use this command,
+//          user need to specify:
+//                  1)  modelPath           -- path to the existing model
+//                  2)  outputModelPath     -- where to write the exported model
+//          optionally:
+//                  3)  parameterStorage    -- "fp16" (default; half the size of float, about 3 significant digits),
+//                                             "int8" (a quarter; 8 bits per value with a scale per row, as used by
+//                                             quantizeWeightsToInt8), or "full" (no conversion)
+//
+//      The exported model loads like any other (including for further training), with the values converted back to
+//      the precision of the network; the rounding is permanent.
+//////////////////////////////////////////////////////////////////////////
+template <typename ElemType>
+void DoExportModel(const ConfigParameters& config)
+{
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    wstring storageName = config(L"parameterStorage", L"fp16");
+
+    ParameterStorage storage;
+    if (storageName == L"fp16")
+        storage = ParameterStorage::fp16;
+    else if (storageName == L"int8")
+        storage = ParameterStorage::int8;
+    else if (storageName == L"full")
+        storage = ParameterStorage::full;
+    else
+        InvalidArgument("parameterStorage: '%ls' is not one of 'fp16', 'int8', 'full'.", storageName.c_str());
+
+    ComputationNetwork net(CPUDEVICE);
+    net.Load<ElemType>(modelPath);
+    net.Save(outputModelPath, FileOptions::fileOptionsBinary, storage);
+    fprintf(stderr, "exportModel: Saved %ls with %ls parameters to %ls.\n", modelPath.c_str(), storageName.c_str(), outputModelPath.c_str());
+}
+
+template void DoExportModel<float>(const ConfigParameters& config);
+template void DoExportModel<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoWriteWordAndClassInfo() - implements CNTK "writeWordAndClass" command
 // ===========================================================================
@@ -415,6 +613,7 @@ void DoWriteWordAndClassInfo(const ConfigParameters& config)
 
     std::ofstream ofvocab;
     ofvocab.open(outputVocabFile.c_str());
+    Vocabulary vocabulary;
     for (size_t i = 0; i < m_index.size(); i++)
     {
         if (nbrCls > 0)
@@ -426,9 +625,12 @@ void DoWriteWordAndClassInfo(const ConfigParameters& config)
             prevClsIdx = m_class[i];
         }
         ofvocab << "     " << i << "\t     " << m_count[i] << "\t" << m_words[i] << "\t" << clsIdx << std::endl;
+        vocabulary.Add(m_words[i], (size_t) m_count[i], (int) clsIdx);
     }
 
     ofvocab.close();
+    // the binary form, which LMSequenceReader maps instead of parsing the text (as long as the text is unchanged)
+    vocabulary.SaveBinary(Vocabulary::BinaryPath(s2ws(outputVocabFile)), s2ws(outputVocabFile));
     if (nbrCls > 0)
     {
         // write the outputs
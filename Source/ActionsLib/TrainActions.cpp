@@ -26,6 +26,12 @@
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
+#include "StartupTiming.h"
+#include "InputAndParamNodes.h"
+#include "MatrixQuantizerImpl.h"
+#include "SimpleDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
+#include "TimerUtility.h"
 
 #include <string>
 #include <chrono>
@@ -35,6 +41,7 @@
 #include <queue>
 #include <set>
 #include <memory>
+#include <future>
 
 #ifndef let
 #define let const auto
@@ -93,10 +100,46 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// whether CreateObject() may run on another thread while the main thread reads the config: not for BrainScript, which
+// instantiates the object by evaluating the config (not thread-safe); the old CNTK config is only read
+static bool CanCreateObjectsConcurrently(const ScriptableObjects::IConfigRecord&)
+{
+    return false;
+}
+static bool CanCreateObjectsConcurrently(const ConfigParameters&)
+{
+    return true;
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
     bool makeMode = config(L"makeMode", true);
+
+    // create the readers
+    // With parallelStartup, this runs on a background thread, while the GPU is selected and the network is built
+    // or loaded, since readers may take long to load their corpus descriptions (e.g. SCP and MLF files).
+    shared_ptr<DataReader<ElemType>> dataReader;
+    shared_ptr<DataReader<ElemType>> cvDataReader;
+    auto createReaders = [&]()
+    {
+        StartupTiming::Phase startupPhase("creating the readers");
+        dataReader = CreateObject<DataReader<ElemType>>(config, L"reader");
+        if (config.Exists(L"cvReader"))
+            cvDataReader = CreateObject<DataReader<ElemType>>(config, L"cvReader");
+    };
+    bool parallelStartup = config(L"parallelStartup", false);
+    if (parallelStartup && !CanCreateObjectsConcurrently(config))
+    {
+        fprintf(stderr, "WARNING: parallelStartup is not supported with BrainScript configurations and will be ignored.\n");
+        parallelStartup = false;
+    }
+    future<void> readersCreated; // (if we leave by an exception, its destructor waits for the thread, which references this frame)
+    if (parallelStartup)
+        readersCreated = async(launch::async, createReaders);
+    else
+        createReaders();
+
     DEVICEID_TYPE deviceId = DeviceFromConfig(config);
 
     // determine the network-creation function
@@ -155,12 +198,6 @@ void DoTrain(const ConfigRecordType& config)
         RuntimeError("No network builder found in the config file. NDLNetworkBuilder or SimpleNetworkBuilde must be specified");
     }
 
-    auto dataReader = CreateObject<DataReader<ElemType>>(config, L"reader");
-
-    shared_ptr<DataReader<ElemType>> cvDataReader;
-    if (config.Exists(L"cvReader"))
-        cvDataReader = CreateObject<DataReader<ElemType>>(config, L"cvReader");
-
     shared_ptr<SGD<ElemType>> optimizer;
     if (config.Exists(L"optimizer"))
     {
@@ -172,7 +209,20 @@ void DoTrain(const ConfigRecordType& config)
         optimizer = make_shared<SGD<ElemType>>(configSGD);
     }
 
-    optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
+    if (!parallelStartup)
+    {
+        optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
+        return;
+    }
+    int startEpoch;
+    ComputationNetworkPtr net = optimizer->CreateOrLoadNetwork(createNetworkFn, deviceId, makeMode, startEpoch);
+    Timer waitTimer;
+    waitTimer.Start();
+    readersCreated.get(); // (rethrows an error of the reader thread)
+    waitTimer.Stop();
+    StartupTiming::LogPhase("waiting for the readers", waitTimer.ElapsedSeconds());
+    if (net)
+        optimizer->TrainFromEpoch(net, startEpoch, dataReader.get(), cvDataReader.get());
 }
 
 namespace Microsoft { namespace MSR { namespace ScriptableObjects {
@@ -272,3 +322,142 @@ void DoEdit(const ConfigParameters& config)
 
 template void DoEdit<double>(const ConfigParameters& config);
 template void DoEdit<float>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBenchmarkGradientAggregation() - implements CNTK "benchmarkAggregation" command
+// ===========================================================================
+
+// Runs the data-parallel gradient aggregation of SGD on synthetic gradients of the shapes of a model's parameters,
+// without training, and reports the time per step, the effective bus bandwidth, and where the time went (device
+// copies, MPI, headers). This is for choosing the bucket size and gradient bits for a cluster configuration.
+// Must run under MPI (parallelTrain=true). Parameters:
+//  - modelPath: the model whose learnable parameters give the gradient shapes; deviceId: where the gradients live
+//  - numSteps (20), numWarmupSteps (2): aggregation steps timed, and run before the timing starts
+//  - minibatchSize (256): the sample count in the header of each node
+//  - gradientBits, useZeroThresholdFor1BitQuantization, gradientBucketSizeInMB, useGPUDirectGradientAggregation,
+//    useHierarchicalAllReduce, sparseGradientDensity, gradientTopKRatio: as in the DataParallelSGD section of SGD
+// The bus bandwidth is that of an allreduce of the uncompressed gradients: 2 (N-1)/N times their size per step time.
+template <typename ElemType>
+void DoBenchmarkGradientAggregation(const ConfigParameters& config)
+{
+    if (!g_mpi)
+        InvalidArgument("BenchmarkAggregation: This action requires MPI (parallelTrain=true).");
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    wstring modelPath = config(L"modelPath");
+    size_t numSteps = config(L"numSteps", "20");
+    size_t numWarmupSteps = config(L"numWarmupSteps", "2");
+    size_t minibatchSize = config(L"minibatchSize", "256");
+    size_t numGradientBits = config(L"gradientBits", 8 * sizeof(ElemType));
+    bool zeroThresholdFor1Bit = config(L"useZeroThresholdFor1BitQuantization", "true");
+    double gradientBucketSizeInMB = config(L"gradientBucketSizeInMB", "0");
+    bool gpuDirectGradientAggregation = config(L"useGPUDirectGradientAggregation", "false");
+    bool hierarchicalAllReduce = config(L"useHierarchicalAllReduce", "false");
+    double sparseGradientDensity = config(L"sparseGradientDensity", "0");
+    double gradientTopKRatio = config(L"gradientTopKRatio", "0");
+    if ((numGradientBits < 1) || (numGradientBits > 8 * sizeof(ElemType)))
+        InvalidArgument("BenchmarkAggregation: gradientBits must be in the range [1, %d].", (int) (8 * sizeof(ElemType)));
+
+    // synthetic gradients of the shapes of the model's learnable parameters (different values on each node)
+    vector<shared_ptr<Matrix<ElemType>>> gradientMatrices;
+    vector<Matrix<ElemType>*> gradients;
+    vector<wstring> gradientNames;
+    size_t numElements = 0;
+    {
+        auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+        for (const auto& nodeBase : net->GetAllNodes())
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+            if (!node || node->OperationName() != OperationNameOf(LearnableParameter) || !node->IsParameterUpdateRequired())
+                continue;
+            const Matrix<ElemType>& value = node->Value();
+            gradientMatrices.push_back(make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), deviceId));
+            gradientMatrices.back()->SetUniformRandomValue(-1, 1, (unsigned long) (gradients.size() + 1000 * g_mpi->CurrentNodeRank()));
+            gradients.push_back(gradientMatrices.back().get());
+            gradientNames.push_back(node->NodeName());
+            numElements += value.GetNumElements();
+        }
+    }
+    if (gradients.empty())
+        InvalidArgument("BenchmarkAggregation: The model '%ls' has no learnable parameters.", modelPath.c_str());
+    const double numBytes = (double) numElements * sizeof(ElemType);
+    const size_t numNodes = g_mpi->NumNodesInUse();
+    if (g_mpi->IsMainNode())
+        fprintf(stderr, "BenchmarkAggregation: %d gradient matrices, %.2f MB, on %d nodes.\n", (int) gradients.size(), numBytes / 1e6, (int) numNodes);
+
+    // the aggregator, chosen as by SGD::InitDistGradAgg()
+    unique_ptr<IDistGradAggregator<ElemType>> distGradAgg;
+    if ((numGradientBits != 8 * sizeof(ElemType)) || (gradientTopKRatio > 0))
+        distGradAgg.reset(new QuantizedDistGradAggregator<ElemType>(g_mpi, numGradientBits, zeroThresholdFor1Bit, gradientTopKRatio, /*syncStatsTrace=*/0));
+    else
+        distGradAgg.reset(new SimpleDistGradAggregator<ElemType>(g_mpi, /*useAsyncAggregation=*/false, /*syncStatsTrace=*/0, (size_t) (gradientBucketSizeInMB * 1024 * 1024),
+                                                                 gpuDirectGradientAggregation, hierarchicalAllReduce, sparseGradientDensity));
+    distGradAgg->SetGradientNames(gradientNames);
+    DistGradHeader* gradHeader = DistGradHeader::Create(0);
+
+    // run the steps; each starts on all nodes together, and ends when its results are in the gradients
+    auto synchronizeDevice = [deviceId]()
+    {
+        if (deviceId >= 0)
+            unique_ptr<MatrixComputeStreamEvent>(MatrixComputeStreamEvent::Create(deviceId))->SynchronizeEvent();
+    };
+    vector<double> stepSeconds;
+    double phaseSecondsAtStart[3] = {0, 0, 0};
+    size_t numBytesSentAtStart = 0;
+    bool hasPhases = false;
+    Timer stepTimer;
+    for (size_t step = 0; step < numWarmupSteps + numSteps; step++)
+    {
+        if (step == numWarmupSteps)
+        {
+            hasPhases = distGradAgg->GetPhaseSeconds(phaseSecondsAtStart[0], phaseSecondsAtStart[1], phaseSecondsAtStart[2]);
+            numBytesSentAtStart = distGradAgg->GetNumBytesSent();
+        }
+        gradHeader->Clear();
+        gradHeader->numSamples = minibatchSize;
+        gradHeader->numSamplesWithLabel = minibatchSize;
+        synchronizeDevice();
+        g_mpi->WaitAll();
+        stepTimer.Restart();
+        distGradAgg->AggregateGradients(gradients, gradHeader, /*epochNumber=*/0);
+        synchronizeDevice();
+        stepTimer.Stop();
+        if (step >= numWarmupSteps)
+            stepSeconds.push_back(stepTimer.ElapsedSeconds());
+    }
+    double phaseSeconds[3] = {0, 0, 0};
+    if (hasPhases)
+        distGradAgg->GetPhaseSeconds(phaseSeconds[0], phaseSeconds[1], phaseSeconds[2]);
+    const double numBytesSentPerStep = numSteps > 0 ? (double) (distGradAgg->GetNumBytesSent() - numBytesSentAtStart) / numSteps : 0;
+    DistGradHeader::Destroy(gradHeader);
+
+    // report (of this node; as the steps are synchronized, all nodes see about the same times)
+    if (stepSeconds.empty())
+        return;
+    double totalSeconds = 0;
+    for (double s : stepSeconds)
+        totalSeconds += s;
+    const double meanSeconds = totalSeconds / stepSeconds.size();
+    sort(stepSeconds.begin(), stepSeconds.end());
+    auto percentile = [&](double p) -> double // nearest rank
+    {
+        size_t rank = (size_t) ceil(p * stepSeconds.size());
+        return stepSeconds[max(rank, (size_t) 1) - 1];
+    };
+    const double algorithmBandwidth = numBytes / meanSeconds;
+    const double busBandwidth = algorithmBandwidth * 2 * (numNodes - 1) / numNodes;
+    fprintf(stderr, "BenchmarkAggregation (rank %d): %d steps, seconds per step: mean %.5f, 50%% %.5f, 90%% %.5f, max %.5f\n",
+            (int) g_mpi->CurrentNodeRank(), (int) stepSeconds.size(), meanSeconds, percentile(0.5), percentile(0.9), percentile(1.0));
+    fprintf(stderr, "BenchmarkAggregation (rank %d): algorithm bandwidth %.2f GB/s, bus bandwidth %.2f GB/s, %.2f MB handed to MPI per step\n",
+            (int) g_mpi->CurrentNodeRank(), algorithmBandwidth / 1e9, busBandwidth / 1e9, numBytesSentPerStep / 1e6);
+    if (hasPhases)
+    {
+        double deviceCopy = (phaseSeconds[0] - phaseSecondsAtStart[0]) / stepSeconds.size();
+        double mpi = (phaseSeconds[1] - phaseSecondsAtStart[1]) / stepSeconds.size();
+        double header = (phaseSeconds[2] - phaseSecondsAtStart[2]) / stepSeconds.size();
+        fprintf(stderr, "BenchmarkAggregation (rank %d): seconds per step in device copies %.5f (%.1f%%), MPI %.5f (%.1f%%), headers %.5f (%.1f%%)\n",
+                (int) g_mpi->CurrentNodeRank(), deviceCopy, 100 * deviceCopy / meanSeconds, mpi, 100 * mpi / meanSeconds, header, 100 * header / meanSeconds);
+    }
+}
+
+template void DoBenchmarkGradientAggregation<float>(const ConfigParameters& config);
+template void DoBenchmarkGradientAggregation<double>(const ConfigParameters& config);
@@ -416,7 +416,7 @@ static ConfigValuePtr MakeEvaluateThunkPtr(const ExpressionPtr &expr, const ICon
 // main evaluator function (highly recursive)
 // -----------------------------------------------------------------------
 
-// Evaluate()
+// EvaluateExpression()
 //  - input:  expression
 //  - output: ConfigValuePtr that holds the evaluated value of the expression
 //  - secondary inputs:
@@ -428,7 +428,7 @@ static ConfigValuePtr MakeEvaluateThunkPtr(const ExpressionPtr &expr, const ICon
 //  - not all nodes get their own path, in particular nodes with only one child, e.g. "-x", that would not be useful to address
 // Note that returned values may include complex value types like dictionaries (ConfigRecord) and functions (ConfigLambda).
 // TODO: This implementation takes a lot of stack space. Should break into many sub-functions.
-static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, wstring exprPath, const wstring &exprId)
+static ConfigValuePtr EvaluateExpression(const ExpressionPtr &e, const IConfigRecordPtr &scope, wstring exprPath, const wstring &exprId)
 {
     try // catch clause for this will catch error, inject this tree node's TextLocation, and rethrow
     {
@@ -742,6 +742,43 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
     }
 }
 
+// a constant expression consists only of literals and the operators applied to them (no identifiers, lambdas, or 'new')
+// Its value does not depend on the scope, so it only needs to be computed once, however often the expression is
+// evaluated in macro expansions or array initializers.
+static bool IsConstantExpression(const ExpressionPtr &e)
+{
+    if (e->isConstant < 0) // determined once per expression
+    {
+        bool isConstant;
+        if (e->op == L"d" || e->op == L"s" || e->op == L"b")
+            isConstant = true;
+        else if (e->op == L"if" || e->op == L"+(" || e->op == L"-(" || e->op == L"!(" || infixOps.find(e->op) != infixOps.end())
+        {
+            isConstant = e->namedArgs.empty();
+            for (let &arg : e->args)
+                isConstant = isConstant && IsConstantExpression(arg);
+        }
+        else
+            isConstant = false;
+        e->isConstant = isConstant ? 1 : 0;
+    }
+    return e->isConstant != 0;
+}
+
+// Evaluate() -- evaluate an expression, reusing the value of constant expressions
+// The expression path only matters for naming ComputationNodes, which constant expressions never are.
+static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, wstring exprPath, const wstring &exprId)
+{
+    if (!IsConstantExpression(e))
+        return EvaluateExpression(e, scope, exprPath, exprId);
+    if (!e->constantValue)
+        e->constantValue = EvaluateExpression(e, scope, exprPath, exprId); // (errors are not cached, and thus reported at each use)
+    if (!exprPath.empty() && !exprId.empty())
+        exprPath.append(L".");
+    exprPath.append(exprId);
+    return ConfigValuePtr(e->constantValue, MakeFailFn(e->location), exprPath);
+}
+
 static ConfigValuePtr EvaluateParse(ExpressionPtr e)
 {
     return Evaluate(e, IConfigRecordPtr(nullptr) /*top scope*/, L"", L"$");
@@ -104,26 +104,29 @@ struct Expression
     vector<ExpressionPtr> args;                                // position-dependent expression/function args
     map<wstring, pair<TextLocation, ExpressionPtr>> namedArgs; // named expression/function args; also dictionary members (loc is of the identifier)
     TextLocation location;                                     // where in the source code (for downstream error reporting)
+    // evaluator cache: a constant expression (literals and operators on them) has the same value wherever it is evaluated
+    mutable int isConstant;                                                       // -1 if not determined yet
+    mutable shared_ptr<Microsoft::MSR::ScriptableObjects::Object> constantValue; // value of a constant expression once evaluated
     // constructors
     Expression(TextLocation location)
-        : location(location), d(0.0), b(false)
+        : location(location), d(0.0), b(false), isConstant(-1)
     {
     }
     Expression(TextLocation location, wstring op)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), isConstant(-1)
     {
     }
     Expression(TextLocation location, wstring op, double d, wstring s, bool b)
-        : location(location), d(d), s(s), b(b), op(op)
+        : location(location), d(d), s(s), b(b), op(op), isConstant(-1)
     {
     }
     Expression(TextLocation location, wstring op, ExpressionPtr arg)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), isConstant(-1)
     {
         args.push_back(arg);
     }
     Expression(TextLocation location, wstring op, ExpressionPtr arg1, ExpressionPtr arg2)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), isConstant(-1)
     {
         args.push_back(arg1);
         args.push_back(arg2);
@@ -58,15 +58,17 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     L"Logistic(label, probability, tag='') = new ComputationNode [ operation = 'Logistic' ; inputs = (label : probability) /*plus the function args*/ ]\n"
     L"WeightedLogistic(label, probability, instanceWeight, tag='') = new ComputationNode [ operation = 'Logistic' ; inputs = (label : probability : instanceWeight) /*plus the function args*/ ]\n"
     L"ReconcileMBLayout(dataInput, layoutInput, tag='') = new ComputationNode [ operation = 'ReconcileMBLayout' ; inputs = (dataInput : layoutInput) /*plus the function args*/ ]\n"
-    L"Convolution(weightNode, inputValueNode, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'Convolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
-    L"MaxPooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'MaxPooling' ; inputs = input /*plus the function args*/ ]\n"
-    L"AveragePooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'AveragePooling' ; inputs = input /*plus the function args*/ ]\n"
+    L"Convolution(weightNode, inputValueNode, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, imageLayout='CHW', kernelDepth = 1, depthSubsample = 1, tag='') = new ComputationNode [ operation = 'Convolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
+    L"MaxPooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', windowDepth = 1, depthSubsample = 1, tag='') = new ComputationNode [ operation = 'MaxPooling' ; inputs = input /*plus the function args*/ ]\n"
+    L"AveragePooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', windowDepth = 1, depthSubsample = 1, tag='') = new ComputationNode [ operation = 'AveragePooling' ; inputs = input /*plus the function args*/ ]\n"
     // TODO: define DelayedValue, with negative delay for future; cannot do this yet, need to be able to say something like delay = -(^.delay)
     // aliases
     L"ColumnwiseCrossProduct = KhatriRaoProduct // deprecated \n" // TODO: should it be deprecated? It is described as easier to understand in the CNTKBook.
     L"ClassificationError = ErrorPrediction \n"
     L"Delay = PastValue \n" // TODO: should it allow negative offsets and an if test here?
     L"BatchNormalization(input, scale, bias, runMean, runInvStdDev, eval, spatial, expAvgFactor, tag='') = new ComputationNode [ operation = 'BatchNormalization' ; inputs = (input : scale : bias : runMean : runInvStdDev) /*plus the function args*/ ]\n"
+    L"HashedEmbeddingLookup(embeddingMatrix, idVectorSequence, numHashes = 1, tag='') = new ComputationNode [ operation = 'HashedEmbeddingLookup' ; inputs = (embeddingMatrix : idVectorSequence) /*plus the function args*/ ]\n"
+    L"CrossEntropyWithSampledSoftmax(labelVectorSequence, hiddenVectorSequence, outputWeights, outputBias, wordCounts, numSamples, samplingExponent = 0.75, tag='') = new ComputationNode [ operation = 'CrossEntropyWithSampledSoftmax' ; inputs = (labelVectorSequence : hiddenVectorSequence : outputWeights : outputBias : wordCounts) /*plus the function args*/ ]\n"
 // standard nodes. We use macros to define these strings.
 #define UnaryStandardNode(Op, a) L## #Op L"(" L## #a L", tag='') = new ComputationNode [ operation = '" L## #Op L"' ; inputs = " L## #a L" /*plus the function args*/ ]\n"
 #define BinaryStandardNode(Op, a, b) L## #Op L"(" L## #a L", " L## #b L", tag='') = new ComputationNode [ operation = '" L## #Op L"' ; inputs = (" L## #a L" : " L## #b L") /*plus the function args*/ ]\n"
@@ -88,12 +90,13 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     UnaryStandardNode(Dropout, activationVectorSequence)
     //BinaryStandardNode(DummyCriterionNode)
     BinaryStandardNode(ElementTimes, aMatrix, anotherMatrix)
+    BinaryStandardNode(EmbeddingLookup, embeddingMatrix, idVectorSequence)
     BinaryStandardNode(ErrorPrediction, labelVectorSequence, outVectorSequence) // CNTKBook: ClassificationError?
     UnaryStandardNode(Exp, x)
     QuaternaryStandardNode(GMMLogLikelihood, unnormalizedPriorVector, meansAsRows, logStdDevAsRows, dataVectorSequence)
     UnaryStandardNode(InvStdDev, dataVectorSequence)
     BinaryStandardNode(KhatriRaoProduct, leftMatrix, rightMatrix)
-    //BinaryStandardNode(LSTMNode)
+    QuaternaryStandardNode(LSTM, inputVectorSequence, inputWeights, recurrentWeights, bias)
     UnaryStandardNode(Log, x)
     UnaryStandardNode(LogSoftmax, z)
     //BinaryStandardNode(LookupTableNode)
@@ -19,7 +19,9 @@
 #include "SynchronousExecutionEngine.h"
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
+#include "CPUGemm.h"   // used for SetBackend()
 #include "CommonMatrix.h"
+#include "CUDADeviceCachingAllocator.h" // used for SetCachingEnabled()
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -27,6 +29,7 @@
 #include "SimpleOutputWriter.h"
 #include "BestGpu.h"
 #include "ProgressTracing.h"
+#include "StartupTiming.h"
 #include "fileutil.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
@@ -159,6 +162,13 @@ void DoCommands(const ConfigParameters& config)
         std::cerr << "Using " << numCPUThreads << " CPU threads" << endl;
     }
 
+    std::string cpuGemmBackend = config(L"cpuGemmBackend", "default");
+    if (cpuGemmBackend != "default")
+    {
+        CPUGemm::SetBackend(cpuGemmBackend);
+        std::cerr << "Using CPU GEMM backend " << CPUGemm::GetBackendName() << endl;
+    }
+
     bool progressTracing = config(L"progressTracing", false);
 
     // temporary hack to prevent users from failling for a small breaking change related to the "truncated" flag (will be redone bigger and better some day)
@@ -237,6 +247,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoWriteOutput<ElemType>(commandParams);
             }
+            else if (action[j] == "ensembleWrite")
+            {
+                DoEnsembleWriteOutput<ElemType>(commandParams);
+            }
             else if (action[j] == "devtest")
             {
                 TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -253,6 +267,14 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoCreateLabelMap<ElemType>(commandParams);
             }
+            else if (action[j] == "benchmarkAggregation")
+            {
+                DoBenchmarkGradientAggregation<ElemType>(commandParams);
+            }
+            else if (action[j] == "benchmarkReader")
+            {
+                DoBenchmarkReader<ElemType>(commandParams);
+            }
             else if (action[j] == "writeWordAndClass")
             {
                 DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -265,6 +287,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoParameterSVD<ElemType>(commandParams);
             }
+            else if (action[j] == "exportModel")
+            {
+                DoExportModel<ElemType>(commandParams);
+            }
             else
             {
                 RuntimeError("unknown action: %s  in command set: %s", action[j].c_str(), command[i].c_str());
@@ -411,9 +437,12 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     fprintf(stderr, "\n\nBrainScript -->\n\n%ls\n\n", bs.c_str());
 
+    Timer configTimer;
+    configTimer.Start();
     let expr = BS::ParseConfigExpression(bs, move(includePaths)); // parse
     let valp = BS::Evaluate(expr);                                // evaluate parse into a dictionary
     let& config = valp.AsRef<ScriptableObjects::IConfigRecord>(); // this is the dictionary
+    configTimer.Stop();
 
     // legacy parameters that have changed spelling
     if (config.Find(L"DoneFile")) // variables follow camel case (start with lower-case letters)
@@ -426,12 +455,17 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     // parallel training
     g_mpi = nullptr;
     bool paralleltrain = config(L"parallelTrain", false);
+    Timer mpiTimer;
+    mpiTimer.Start();
     if (paralleltrain)
         g_mpi = new MPIWrapper();
+    mpiTimer.Stop();
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CUDADeviceCachingAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", true));
+    fsetsequentialbuffersize(config(L"sequentialFileBufferSize", fgetsequentialbuffersize())); // for models and data files read sequentially
 
     // logging
     wstring logpath = config(L"stderr", L"");
@@ -447,6 +481,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(stderr, "%ls\n", startupMessage.c_str());
     }
 
+    // (logged here, where the log file is open)
+    StartupTiming::LogPhase("parsing the configuration", configTimer.ElapsedSeconds());
+    if (paralleltrain)
+        StartupTiming::LogPhase("initializing MPI", mpiTimer.ElapsedSeconds());
+
     // echo config info to log
     PrintBuiltInfo();
 
@@ -456,6 +495,12 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
     if (numCPUThreads > 0)
         fprintf(stderr, "Using %d CPU threads.\n", numCPUThreads);
+    wstring cpuGemmBackend = config(L"cpuGemmBackend", L"default");
+    if (cpuGemmBackend != L"default")
+    {
+        CPUGemm::SetBackend(msra::strfun::utf8(cpuGemmBackend));
+        fprintf(stderr, "Using CPU GEMM backend %s.\n", CPUGemm::GetBackendName().c_str());
+    }
 
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
@@ -488,6 +533,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    CPUGemm::PrintStatistics();
     fprintf(stderr, "COMPLETED\n"), fflush(stderr);
 
     delete g_mpi;
@@ -500,8 +546,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
 int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is a wrapper that catches & repots Win32 exceptions
 {
+    Timer configTimer;
+    configTimer.Start();
     ConfigParameters config;
     std::string rawConfigString = ConfigParameters::ParseCommandLine(argc, argv, config);
+    configTimer.Stop();
 
     // get the command param set they want
     wstring logpath = config(L"stderr", L"");
@@ -513,14 +562,19 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
     // paralleltrain training
     g_mpi = nullptr;
     bool paralleltrain = config(L"parallelTrain", "false");
+    Timer mpiTimer;
+    mpiTimer.Start();
     if (paralleltrain)
     {
         g_mpi = new MPIWrapper();
     }
+    mpiTimer.Stop();
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CUDADeviceCachingAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", true));
+    fsetsequentialbuffersize(config(L"sequentialFileBufferSize", fgetsequentialbuffersize())); // for models and data files read sequentially
 
     if (logpath != L"")
     {
@@ -569,6 +623,11 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
     config.dumpWithResolvedVariables();
     fprintf(stderr, "<<<<<<<<<<<<<<<<<<<< PROCESSED CONFIG WITH ALL VARIABLES RESOLVED <<<<<<<<<<<<<<<<<<<<\n");
 
+    // (logged here, where the log file is open)
+    StartupTiming::LogPhase("parsing the configuration", configTimer.ElapsedSeconds());
+    if (paralleltrain)
+        StartupTiming::LogPhase("initializing MPI", mpiTimer.ElapsedSeconds());
+
     fprintf(stderr, "command: ");
     for (int i = 0; i < command.size(); i++)
     {
@@ -604,6 +663,7 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    CPUGemm::PrintStatistics();
     fprintf(stderr, "COMPLETED\n"), fflush(stderr);
 
     delete g_mpi;
@@ -618,6 +678,7 @@ int wmain1(int argc, wchar_t* argv[]) // called from wmain which is a wrapper th
 {
     try
     {
+        StartupTiming::Start();
         PrintBuiltInfo(); // print build info directly in case that user provides zero argument (convenient for checking build type)
         if (argc <= 1)
             InvalidArgument("No command-line argument given.");
@@ -57,7 +57,8 @@ enum MELProperty
     melPropEvaluation,
     melPropOutput,
     melPropRecurrent,
-    melPropBatchNormMode
+    melPropBatchNormMode,
+    melPropDeviceId
 };
 
 // SetProperty - Set the Property on the passed node
@@ -442,6 +443,10 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         {
             prop = melPropRecurrent;
         }
+        else if (EqualInsensitive(propName, "deviceId"))
+        {
+            prop = melPropDeviceId;
+        }
         else
         {
             RuntimeError("Invalid property, %s, is not supported", propName.c_str());
@@ -499,6 +504,14 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
                 // what to do here?
                 break;
             }
+            case melPropDeviceId:
+            {
+                // model parallelism: DeviceTransferNodes get inserted at the cut edges when the network is compiled
+                std::string deviceId = params[2];
+                node->MoveToDevice(EqualInsensitive(deviceId, "cpu") ? CPUDEVICE : (DEVICEID_TYPE) atoi(deviceId.c_str()));
+                cn->InvalidateCompiledNetwork();
+                break;
+            }
             case melPropBatchNormMode:
             {
                 if (node->OperationName() != OperationNameOf(BatchNormalizationNode))
@@ -659,6 +672,31 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
             fprintf(stderr, "Revise node %ls using parameter file %s\n", pNodes->NodeName().c_str(), paramPath.c_str());
         }
     }
+    else if (EqualInsensitive(name, "FactorizeTimes"))
+    {
+        size_t numFixedParams = 2, numOptionalParams = 1;
+        if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
+            RuntimeError("Invalid number of parameters. Valid parameters are FactorizeTimes(timesNodeName, rankOrKeepRatio, [alignedSize=1]). "
+                         "A rankOrKeepRatio below 1 is the fraction of the sum of singular values to keep, else the rank.");
+
+        // a rank, or an energy threshold
+        double rankOrKeepRatio = params[1];
+        size_t rank = 0;
+        float keepRatio = 1.0f;
+        if (rankOrKeepRatio >= 1)
+            rank = (size_t) rankOrKeepRatio;
+        else if (rankOrKeepRatio > 0)
+            keepRatio = (float) rankOrKeepRatio;
+        else
+            RuntimeError("FactorizeTimes: rankOrKeepRatio must be positive.");
+        size_t alignedSize = params.size() > 2 ? (size_t) params[2] : 1;
+
+        NetNdl<ElemType>* netNdl;
+        vector<ComputationNodeBasePtr> nodes = FindSymbols(params[0], netNdl);
+        ProcessNDLScript(netNdl, ndlPassAll);
+        for (const auto& node : nodes)
+            netNdl->cn->template FactorizeTimesNode<ElemType>(node->NodeName(), rank, keepRatio, alignedSize);
+    }
     else
     {
         RuntimeError("Unknown Editor function %s", name.c_str());
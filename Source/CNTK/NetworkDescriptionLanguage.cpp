@@ -64,7 +64,7 @@ NDLScript<ElemType>::NDLScript(const NDLScript& copyMe)
 
     // now search the symbol table for other symbols that haven't been copied yet
     // this happens for constants defined in macros and such
-    for (std::pair<std::string, NDLNode<ElemType>*> pair : copyMe.m_symbols)
+    for (const auto& pair : copyMe.m_symbols)
     {
         // if we can't find the symbol in the copied symbol table, copy it here
         if (m_symbols.find(pair.first) == end(m_symbols))
@@ -164,12 +164,14 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(CosDistanceWithNegativeSamplesNode), L"CosWithNegSamples")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CosineNode), L"Cos")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CrossEntropyNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(CrossEntropyWithSampledSoftmaxNode), L"CEWithSampledSM")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CrossEntropyWithSoftmaxNode), L"CEWithSM")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(DiagTimesNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(DiagonalNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(DropoutNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(DummyCriterionNode), L"DummyCriterion")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ElementTimesNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(EmbeddingLookupNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ErrorPredictionNode), L"ClassificationError")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ExpNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(FutureValueNode))) ret = true;
@@ -177,6 +179,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(GMMLogLikelihoodNode), L"GMMLL")) ret = true;
 #endif
     else if (EqualInsensitive(nodeType, OperationNameOf(HardmaxNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(HashedEmbeddingLookupNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(InputValue), L"Input")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(InvStdDevNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(KhatriRaoProductNode), L"ColumnwiseCrossProduct")) ret = true;
@@ -185,6 +188,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(LogSoftmaxNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LogisticNode), L"Logistic")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LookupTableNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(LSTMNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MatrixL1RegNode), L"L1Reg")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MatrixL2RegNode), L"L2Reg")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MaxPoolingNode))) ret = true;
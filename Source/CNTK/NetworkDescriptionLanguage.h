@@ -5,6 +5,7 @@
 #pragma once
 
 #include "ComputationNetwork.h"
+#include <unordered_map>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -442,7 +443,7 @@ private:
     std::wstring m_baseName;
     std::string m_scriptString;
     std::vector<NDLNode<ElemType>*> m_script;                            // script lines in parsed node order, macros will have definition followed by body
-    std::map<std::string, NDLNode<ElemType>*, nocase_compare> m_symbols; // symbol table
+    std::unordered_map<std::string, NDLNode<ElemType>*, nocase_hash, nocase_equal> m_symbols; // symbol table (copied for each macro expansion)
     NDLNode<ElemType>* m_macroNode;                                      // set when interpretting a macro definition
     bool m_noDefinitions;                                                // no definitions can be made in this script, interpret all macro/function names as calls
     static NDLScript<ElemType> s_global;                                 // ("global"); // global script for storing macros and global nodes
@@ -1445,7 +1445,7 @@ ComputationNetworkPtr SimpleNetworkBuilder<ElemType>::BuildNetworkFromDbnFile(co
     ComputationNodePtr input, w, b, output, label, prior, scaledLogLikelihood;
     shared_ptr<PreComputedNodeBase<ElemType>> pcNodePtr;
 
-    File fstream(dbnModelFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    File fstream(dbnModelFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsSequential);
 
     if (!CheckDbnTag(fstream, "DBN\n"))
         RuntimeError("Error reading DBN file - did not find expected tag DBN\n");
@@ -297,7 +297,7 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
     else if (cnNodeType == OperationNameOf(ConvolutionNode))
     {
         if (parameter.size() != 7)
-            RuntimeError("%ls should have 7 fixed parameters[weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels,horizontalSubsample, verticalSubsample] and two optional parameters [zeroPadding = [false|yourvalue], maxTempMemSizeInSamples = [0|yourvalue], imageLayout = \"HWC\"|\"cudnn\"].", cnNodeType.c_str());
+            RuntimeError("%ls should have 7 fixed parameters[weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels,horizontalSubsample, verticalSubsample] and optional parameters [zeroPadding = [false|yourvalue], maxTempMemSizeInSamples = [0|yourvalue], imageLayout = \"HWC\"|\"cudnn\", kernelDepth = [1|yourvalue], depthSubsample = [1|yourvalue]].", cnNodeType.c_str());
 
         // setup the parameter position of children so we can hook them up later
         nodeParamCount = 2;
@@ -321,9 +321,12 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             ImageLayoutKind imageLayoutKind = ImageLayoutKindFrom(node->GetOptionalParameter("imageLayout", "HWC"));
             bool zeroPadding = node->GetOptionalParameter("zeroPadding", "false");
             size_t maxTempMemSizeInSamples = node->GetOptionalParameter("maxTempMemSizeInSamples", "0");
+            size_t kernelDepth = node->GetOptionalParameter("kernelDepth", "1"); // for inputs [W x H x D x C] (imageLayout = "cudnn")
+            size_t depthSubsample = node->GetOptionalParameter("depthSubsample", "1");
 
             nodePtr = builder.Convolution(NULL, NULL, kernelWidth, kernelHeight, outputChannels,
-                                          horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples, name);
+                                          horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples,
+                                          kernelDepth, depthSubsample, name);
         }
     }
     else if (cnNodeType == OperationNameOf(MaxPoolingNode))
@@ -349,9 +352,11 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             assert(id == 4);
 
             ImageLayoutKind imageLayoutKind = ImageLayoutKindFrom(node->GetOptionalParameter("imageLayout", "HWC"));
+            size_t windowDepth = node->GetOptionalParameter("windowDepth", "1"); // for inputs [W x H x D x C] (imageLayout = "cudnn")
+            size_t depthSubsample = node->GetOptionalParameter("depthSubsample", "1");
 
             nodePtr = builder.MaxPooling(NULL, /*inputWidth,inputHeight, channels,*/ windowWidth, windowHeight,
-                                         horizontalSubsample, verticalSubsample, imageLayoutKind, name);
+                                         horizontalSubsample, verticalSubsample, imageLayoutKind, windowDepth, depthSubsample, name);
         }
     }
     else if (cnNodeType == OperationNameOf(AveragePoolingNode))
@@ -377,9 +382,11 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             assert(id == 4);
 
             ImageLayoutKind imageLayoutKind = ImageLayoutKindFrom(node->GetOptionalParameter("imageLayout", "HWC"));
+            size_t windowDepth = node->GetOptionalParameter("windowDepth", "1");
+            size_t depthSubsample = node->GetOptionalParameter("depthSubsample", "1");
 
             nodePtr = builder.AveragePooling(NULL, /*inputWidth,inputHeight, channels,*/ windowWidth, windowHeight,
-                                             horizontalSubsample, verticalSubsample, imageLayoutKind, name);
+                                             horizontalSubsample, verticalSubsample, imageLayoutKind, windowDepth, depthSubsample, name);
         }
     }
     else if (cnNodeType == OperationNameOf(BatchNormalizationNode))
@@ -406,6 +413,39 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             nodePtr = builder.BatchNormalization(nullptr, nullptr, nullptr, nullptr, nullptr, eval, spatial, expAvgFactor, imageLayoutKind, name);
         }
     }
+    else if (cnNodeType == OperationNameOf(CrossEntropyWithSampledSoftmaxNode))
+    {
+        if (parameter.size() != 5)
+            RuntimeError("%ls should have 5 fixed parameters[labels, hidden, weights, bias, wordCounts].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 5;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            size_t numSamples = node->GetOptionalParameter("numSamples", "0");
+            double samplingExponent = node->GetOptionalParameter("samplingExponent", "0.75");
+
+            nodePtr = builder.CrossEntropyWithSampledSoftmax(nullptr, nullptr, nullptr, nullptr, nullptr, numSamples, samplingExponent, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(HashedEmbeddingLookupNode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("%ls should have 2 fixed parameters[embeddingMatrix, ids].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            size_t numHashes = node->GetOptionalParameter("numHashes", "1");
+
+            nodePtr = builder.HashedEmbeddingLookup(nullptr, nullptr, numHashes, name);
+        }
+    }
     else
     {
 
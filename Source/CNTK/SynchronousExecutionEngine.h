@@ -221,7 +221,6 @@ public:
     {
         std::vector<void*> inputs;
         std::vector<NDLNode<ElemType>*> parameter = node->GetParameters();
-        ConfigArray paramString = node->GetParamString();
 
         if (parameter.size() < 1)
         {
@@ -234,7 +233,6 @@ public:
         {
             int index = i + nodeParamStart;
             NDLNode<ElemType>* nodeParam = parameter[index];
-            std::wstring paramS = paramString[index];
 
             // default base is same as current
             std::wstring baseSymbol = baseName;
@@ -269,7 +267,15 @@ public:
         // loop through all the optional parameters processing them as necessary
         for (NDLNode<ElemType>* param : params)
         {
-            // make sure it's a "tag" optional parameter, that's all we process currently
+            // deviceId=n or deviceId=cpu places the node on that device (model parallelism; see DeviceTransferNode)
+            if (!_stricmp(param->GetName().c_str(), "deviceId"))
+            {
+                std::string value = param->GetValue();
+                compNode->MoveToDevice(!_stricmp(value.c_str(), "cpu") ? CPUDEVICE : (DEVICEID_TYPE) atoi(value.c_str()));
+                continue;
+            }
+
+            // otherwise make sure it's a "tag" optional parameter, that's all we process currently
             if (_stricmp(param->GetName().c_str(), "tag"))
                 continue;
 
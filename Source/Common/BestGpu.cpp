@@ -44,10 +44,13 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 #endif // __WINDOWS__
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <algorithm>
 
 #include <memory>
 #include "CrossProcessMutex.h"
+#include "MPIWrapper.h"
+#include "StartupTiming.h"
 
 // ---------------------------------------------------------------------------
 // BestGpu class
@@ -65,7 +68,9 @@ struct ProcessorData
     size_t cudaTotalMem;
     bool dbnFound;
     bool cnFound;
-    int deviceId; // the deviceId (cuda side) for this processor
+    int deviceId;            // the deviceId (cuda side) for this processor
+    nvmlDevice_t nvmlDevice; // its NVML handle, valid if nvmlFound
+    bool nvmlFound;
 };
 
 enum BestGpuFlags
@@ -76,6 +81,7 @@ enum BestGpuFlags
     bestGpuFavorUtilization = 4, // favor low utilization
     bestGpuFavorSpeed = 8,       // favor fastest processor
     bestGpuExclusiveLock = 16,   // obtain mutex for selected GPU
+    bestGpuTopologyAware = 32,   // favor GPUs close to those locked by others (our MPI ranks), and pin our threads to the GPU's CPUs
     bestGpuRequery = 256,        // rerun the last query, updating statistics
 };
 
@@ -119,6 +125,8 @@ public:
     std::vector<int> GetDevices(int number = AllDevices, BestGpuFlags flags = bestGpuNormal); // get multiple devices
 private:
     bool LockDevice(int deviceId, bool trial = true);
+    int TopologyDistance(int deviceId1, int deviceId2);
+    void SetCpuAffinity(int deviceId);
 };
 
 // DeviceFromConfig - Parse 'deviceId' config parameter to determine what type of behavior is desired
@@ -142,11 +150,14 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU)
         if (bestDeviceId == DEVICEID_NOTYETDETERMINED) // we only choose once
         {
             // GPU device to be auto-selected, so init our class
+            StartupTiming::Phase startupPhase("selecting the GPU");
             static BestGpu* g_bestGpu = nullptr;
             if (g_bestGpu == nullptr)
                 g_bestGpu = new BestGpu();
-            deviceId = (DEVICEID_TYPE)
-                           g_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
+            int flags = bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing;
+            if (g_mpi && g_mpi->NumNodesInUse() > 1) // ranks on the same host should sit close to each other
+                flags |= bestGpuTopologyAware;
+            deviceId = (DEVICEID_TYPE) g_bestGpu->GetDevice(BestGpuFlags(flags));
             bestDeviceId = deviceId;
         }
         else // already chosen
@@ -196,6 +207,22 @@ DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config)
         return SelectDevice((int) val, bLockGPU);
 }
 
+int GetGPUUtilization(DEVICEID_TYPE deviceId)
+{
+    static bool nvmlInitialized = (nvmlInit() == NVML_SUCCESS); // (reference-counted by NVML, so independent of BestGpu's; never shut down)
+    if (deviceId < 0 || !nvmlInitialized)
+        return -1;
+    // NVML enumerates the devices in a different order than CUDA; match them by PCI bus id
+    char pciBusId[32];
+    nvmlDevice_t device;
+    nvmlUtilization_t utilization;
+    if (cudaDeviceGetPCIBusId(pciBusId, sizeof(pciBusId), deviceId) != cudaSuccess ||
+        nvmlDeviceGetHandleByPciBusId(pciBusId, &device) != NVML_SUCCESS ||
+        nvmlDeviceGetUtilizationRates(device, &utilization) != NVML_SUCCESS)
+        return -1;
+    return (int) utilization.gpu;
+}
+
 // !!!!This is from helper_cuda.h which comes with CUDA samples!!!! Consider if it is beneficial to just include all helper_cuda.h
 // TODO: This is duplicated in GPUMatrix.cu
 // Beginning of GPU Architecture definitions
@@ -470,6 +497,7 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         // to respect other users' exclusive lock.
 
         vector<int> bestAndAvaialbe;
+        vector<int> taken;
         for (auto i : best)
         {
             if (LockDevice(i, true))
@@ -477,8 +505,25 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
                 // available
                 bestAndAvaialbe.push_back(i);
             }
+            else
+                taken.push_back(i);
         }
         best = bestAndAvaialbe;
+
+        // Since the querying lock serializes the processes on this machine, the GPUs that are taken already include
+        // those of the ranks that got here before us. Of the available GPUs, favor the ones closest to them (NVLink,
+        // same board, PCIe switch), as that is what intra-node aggregation runs over. Ties keep the score order.
+        if ((bestFlags & bestGpuTopologyAware) && !taken.empty())
+        {
+            vector<int> distance(m_deviceCount, INT_MAX);
+            for (auto i : best)
+                for (auto j : taken)
+                    distance[i] = std::min(distance[i], TopologyDistance(i, j));
+            std::stable_sort(best.begin(), best.end(), [&distance](int i, int j)
+                             {
+                                 return distance[i] < distance[j];
+                             });
+        }
         if (best.size() > number)
         {
             best.resize(number);
@@ -500,6 +545,9 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         LockDevice(best[z], false);
     }
 
+    if (bestFlags & bestGpuTopologyAware)
+        SetCpuAffinity(best[0]);
+
     return best; // return the array of the best GPUs
 }
 
@@ -543,6 +591,8 @@ void BestGpu::QueryNvmlData()
 
         if (curPd == NULL)
             continue;
+        curPd->nvmlDevice = device;
+        curPd->nvmlFound = true;
 
         // Get the memory usage, will only work for TCC drivers
         result = nvmlDeviceGetMemoryInfo(device, &memory);
@@ -635,6 +685,43 @@ bool BestGpu::LockDevice(int deviceId, bool trial)
     return true;
 }
 
+// TopologyDistance - how far apart two GPUs are in the system topology
+// returns: 0 if they are connected by NVLink, otherwise 1 + the nvmlGpuTopologyLevel_t of their common ancestor
+// (NVML_TOPOLOGY_INTERNAL for the same board, up to NVML_TOPOLOGY_SYSTEM across CPU sockets); INT_MAX if unknown
+int BestGpu::TopologyDistance(int deviceId1, int deviceId2)
+{
+    ProcessorData* pd1 = m_procData[deviceId1];
+    ProcessorData* pd2 = m_procData[deviceId2];
+    if (!m_nvmlData || !pd1->nvmlFound || !pd2->nvmlFound)
+        return INT_MAX;
+#ifdef NVML_NVLINK_MAX_LINKS // (not in older NVML versions)
+    for (unsigned int link = 0; link < NVML_NVLINK_MAX_LINKS; link++)
+    {
+        nvmlEnableState_t isActive;
+        nvmlPciInfo_t pci;
+        if (nvmlDeviceGetNvLinkState(pd1->nvmlDevice, link, &isActive) == NVML_SUCCESS && isActive == NVML_FEATURE_ENABLED &&
+            nvmlDeviceGetNvLinkRemotePciInfo(pd1->nvmlDevice, link, &pci) == NVML_SUCCESS && (int) pci.bus == pd2->deviceProp.pciBusID)
+            return 0;
+    }
+#endif
+    nvmlGpuTopologyLevel_t level;
+    if (nvmlDeviceGetTopologyCommonAncestor(pd1->nvmlDevice, pd2->nvmlDevice, &level) != NVML_SUCCESS)
+        return INT_MAX;
+    return 1 + (int) level; // (NVML_TOPOLOGY_INTERNAL is 0)
+}
+
+// SetCpuAffinity - bind this process to the CPUs (NUMA node) closest to a GPU
+// This binds the calling thread; threads created afterwards (OpenMP, readers) inherit it, so this is done at device selection.
+void BestGpu::SetCpuAffinity(int deviceId)
+{
+    if (deviceId < 0 || !m_nvmlData || !m_procData[deviceId]->nvmlFound)
+        return;
+    if (nvmlDeviceSetCpuAffinity(m_procData[deviceId]->nvmlDevice) == NVML_SUCCESS)
+        fprintf(stderr, "SetCpuAffinity: Bound threads to the CPUs closest to GPU %d.\n", deviceId);
+    else // (e.g. not supported on this platform)
+        fprintf(stderr, "SetCpuAffinity: Could not bind threads to the CPUs of GPU %d, ignoring.\n", deviceId);
+}
+
 #ifdef _WIN32
 
 #if 0
@@ -51,6 +51,7 @@ void DataReader<ElemType>::InitFromConfig(const ConfigRecordType& /*config*/)
 template <class ElemType>
 void DataReader<ElemType>::Destroy()
 {
+    m_readerThreads.clear();
     // newer code that explicitly place multiple streams for inputs
     foreach_index (i, m_ioNames) // inputNames should map to node names
     {
@@ -105,6 +106,18 @@ DataReader<ElemType>::DataReader(const ConfigRecordType& config)
         size_t nbrUttPerMinibatch = config(L"nbruttsineachrecurrentiter", (size_t) 1);
         m_dataReaders[ioName]->SetNumParallelSequences(nbrUttPerMinibatch);
     }
+
+    // read the minibatches of multiple readers concurrently, see GetMinibatch()
+    bool parallelReaders = config(L"parallelReaders", false);
+    if (parallelReaders && m_ioNames.size() > 1)
+    {
+        for (size_t i = 1; i < m_ioNames.size(); i++)
+            parallelReaders &= m_dataReaders[m_ioNames[i]]->SupportsConcurrentRead();
+        if (!parallelReaders)
+            fprintf(stderr, "WARNING: parallelReaders: not all readers after the first support concurrent reading; reading sequentially.\n");
+        for (size_t i = 1; parallelReaders && i < m_ioNames.size(); i++)
+            m_readerThreads.push_back(unique_ptr<ReaderThread>(new ReaderThread(m_dataReaders[m_ioNames[i]])));
+    }
 }
 
 template DataReader<float>::DataReader(const ConfigParameters&);
@@ -116,6 +129,7 @@ template DataReader<double>::DataReader(const ScriptableObjects::IConfigRecord&)
 template <class ElemType>
 DataReader<ElemType>::~DataReader()
 {
+    m_readerThreads.clear(); // (stop them before the readers go away)
     // free up resources
     for (size_t i = 0; i < m_ioNames.size(); i++)
         m_dataReaders[m_ioNames[i]]->Destroy();
@@ -163,6 +177,64 @@ void DataReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t e
     }
 }
 
+//SupportsDynamicDistributedMBRead - Tells if the reader supports dynamic distribution of the data for parallel training
+// Only a single reader can claim the work items; with several, they would not read the same data.
+template <class ElemType>
+bool DataReader<ElemType>::SupportsDynamicDistributedMBRead() const
+{
+    if (m_ioNames.size() != 1)
+        return false;
+
+    auto readerIter = m_dataReaders.find(m_ioNames[0]);
+    assert(readerIter != m_dataReaders.end());
+    return readerIter->second->SupportsDynamicDistributedMBRead();
+}
+
+//StartDynamicDistributedMinibatchLoop - Startup a distributed minibatch loop whose data is claimed in blocks through nextWorkItem
+// workItemSize - [in] number of samples per block
+// (see StartDistributedMinibatchLoop() for the other parameters)
+template <class ElemType>
+void DataReader<ElemType>::StartDynamicDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets,
+                                                                const std::function<size_t()>& nextWorkItem, size_t workItemSize, size_t requestedEpochSamples /* = requestDataSize*/)
+{
+    if (!SupportsDynamicDistributedMBRead())
+        LogicError("StartDynamicDistributedMinibatchLoop: the reader does not support dynamic distribution of mini-batches");
+    m_dataReaders[m_ioNames[0]]->StartDynamicDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, nextWorkItem, workItemSize, requestedEpochSamples);
+}
+
+//SupportsSamplePositionSeek - Tells if the reader can continue an epoch from a sample position (mid-epoch checkpoints)
+template <class ElemType>
+bool DataReader<ElemType>::SupportsSamplePositionSeek() const
+{
+    bool supportsSamplePositionSeek = true;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+    {
+        auto currReaderIter = m_dataReaders.find(m_ioNames[i]);
+        assert(currReaderIter != m_dataReaders.end());
+
+        supportsSamplePositionSeek &= currReaderIter->second->SupportsSamplePositionSeek();
+    }
+
+    return supportsSamplePositionSeek;
+}
+
+//GetCurrentSamplePosition - Get the number of samples handed out since the minibatch loop was started
+// All readers read the same samples, so the first one's position is that of all.
+template <class ElemType>
+size_t DataReader<ElemType>::GetCurrentSamplePosition()
+{
+    return m_dataReaders[m_ioNames[0]]->GetCurrentSamplePosition();
+}
+
+//SetCurrentSamplePosition - Continue the epoch after samplePosition samples, right after starting the minibatch loop
+// samplePosition - [in] a position returned by GetCurrentSamplePosition() in the same epoch
+template <class ElemType>
+void DataReader<ElemType>::SetCurrentSamplePosition(size_t samplePosition)
+{
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+        m_dataReaders[m_ioNames[i]]->SetCurrentSamplePosition(samplePosition);
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
@@ -182,7 +254,41 @@ bool DataReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*
     The next reader then returns the exact number of utterances per minibatch, after calling its getminibatch function.
     Then this returned number is compared against the specified number. If these two numbers are not consistent, return with logic error.
     The logic error can be avoided usually with an exchange of reading orders.
+    With 'parallelReaders', all readers after the first ignore the number they are told (SupportsConcurrentRead()), so they
+    read concurrently, each on its own thread (m_readerThreads) and into its own copy of the map; the number is checked
+    afterwards, which gives the same result as the handoff.
     */
+    if (!m_readerThreads.empty())
+    {
+        for (auto& readerThread : m_readerThreads)
+            readerThread->StartGetMinibatch(matrices);
+        exception_ptr error;
+        vector<bool> results(m_ioNames.size());
+        for (size_t i = 0; i < m_ioNames.size(); i++) // (all are waited for before an exception is rethrown)
+        {
+            try
+            {
+                results[i] = (i == 0) ? m_dataReaders[m_ioNames[0]]->GetMinibatch(matrices) : m_readerThreads[i - 1]->EndGetMinibatch();
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = current_exception();
+            }
+        }
+        if (error)
+            rethrow_exception(error);
+        for (size_t i = 0; i < m_ioNames.size(); i++)
+        {
+            bRet &= results[i];
+            thisNbr = m_dataReaders[m_ioNames[i]]->GetNumParallelSequences();
+            if (nbr > 0 && thisNbr != nbr)
+                LogicError("DataReader<ElemType>::GetMinibatch: The specified number of utterances per minibatch is not consistent to the actual number of utterances per minibatch");
+            nbr = thisNbr;
+        }
+        return bRet;
+    }
+
     for (size_t i = 0; i < m_ioNames.size(); i++)
     {
         if (nbr > 0)
@@ -196,6 +302,88 @@ bool DataReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*
     return bRet;
 }
 
+template <class ElemType>
+DataReader<ElemType>::ReaderThread::ReaderThread(IDataReader<ElemType>* reader)
+    : m_reader(reader), m_pending(false), m_stop(false), m_result(false)
+{
+    m_thread = thread([this]()
+                      {
+                          Run();
+                      });
+}
+
+template <class ElemType>
+DataReader<ElemType>::ReaderThread::~ReaderThread()
+{
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+    m_thread.join();
+}
+
+template <class ElemType>
+void DataReader<ElemType>::ReaderThread::StartGetMinibatch(const std::map<std::wstring, Matrix<ElemType>*>& matrices)
+{
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_matrices = matrices;
+        m_pending = true;
+    }
+    m_wakeUp.notify_all();
+}
+
+template <class ElemType>
+bool DataReader<ElemType>::ReaderThread::EndGetMinibatch()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_done.wait(lock, [this]()
+                {
+                    return !m_pending;
+                });
+    if (m_error)
+    {
+        exception_ptr error = m_error;
+        m_error = nullptr;
+        rethrow_exception(error);
+    }
+    return m_result;
+}
+
+template <class ElemType>
+void DataReader<ElemType>::ReaderThread::Run()
+{
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wakeUp.wait(lock, [this]()
+                      {
+                          return m_stop || m_pending;
+                      });
+        if (!m_pending) // m_stop
+            return;
+        lock.unlock();
+
+        bool result = false;
+        exception_ptr error;
+        try
+        {
+            result = m_reader->GetMinibatch(m_matrices);
+        }
+        catch (...)
+        {
+            error = current_exception();
+        }
+
+        lock.lock();
+        m_result = result;
+        m_error = error;
+        m_pending = false;
+        m_done.notify_all();
+    }
+}
+
 // GetMinibatch4SE - Get the next minibatch for SE training, including lattice, labels and phone boundary
 // latticeinput - lattice for each utterances in this minibatch
 // uids - lables stored in size_t vector instead of ElemType matrix
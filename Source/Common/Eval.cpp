@@ -129,6 +129,22 @@ void Eval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& in
     m_eval->Evaluate(inputs, outputs);
 }
 
+// Evaluate - Evaluate using caller-owned buffers, which the evaluator reads and writes directly where it can
+// inputs - map from node name to input buffer
+// outputs - map from node name to output buffer, which must be large enough to hold the output
+template <class ElemType>
+void Eval<ElemType>::Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs)
+{
+    m_eval->Evaluate(inputs, outputs);
+}
+
+// PrepareEvaluate - allocate once what Evaluate() on caller-owned buffers needs for these outputs and up to maxNumRecords records
+template <class ElemType>
+void Eval<ElemType>::PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords)
+{
+    m_eval->PrepareEvaluate(outputNodeNames, maxNumRecords);
+}
+
 // ResetState - Reset the cell state when we get the start of an utterance
 template <class ElemType>
 void Eval<ElemType>::ResetState()
@@ -84,9 +84,6 @@ void File::Init(const wchar_t* filename, int fileOptions)
         // options += L"t, ccs=";
         // options += (fileOptions & fileOptionsUnicode)?L"UNICODE":L"UTF-8";
     }
-    // add sequential flag to allocate big read buffer
-    if (fileOptions & fileOptionsSequential)
-        options += L"S";
     // now open the file
     // Special path syntax understood here:
     //  - "-" refers to stdin or stdout
@@ -113,11 +110,16 @@ void File::Init(const wchar_t* filename, int fileOptions)
         m_pcloseNeeded = true;
     }
     else
+    {
+        // add sequential flag to allocate big read buffer and have the OS read ahead (see fopenOrDie())
+        if (fileOptions & fileOptionsSequential)
+            options += L"S";
         attempt([=]() // regular file: use a retry loop
                 {
                     m_file = fopenOrDie(filename, options.c_str());
                     m_seekable = true;
                 });
+    }
 }
 
 // skip to given delimiter character
@@ -343,6 +345,34 @@ void File::ReadChars(std::wstring& val, size_t cnt, bool reset)
         SetPosition(pos);
 }
 
+// ReadBinaryArray - read an array of elements in one go
+// buffer - where to read the elements into
+// size - size of an element in bytes
+// count - number of elements to read
+void File::ReadBinaryArray(void* buffer, size_t size, size_t count)
+{
+    if (IsTextBased())
+        LogicError("ReadBinaryArray: File '%ls' is not a binary file.", m_filename.c_str());
+    attempt([&]
+            {
+                freadOrDie(buffer, size, count, m_file);
+            });
+}
+
+// WriteBinaryArray - write an array of elements in one go
+// buffer - the elements to write
+// size - size of an element in bytes
+// count - number of elements to write
+void File::WriteBinaryArray(const void* buffer, size_t size, size_t count)
+{
+    if (IsTextBased())
+        LogicError("WriteBinaryArray: File '%ls' is not a binary file.", m_filename.c_str());
+    attempt([&]
+            {
+                fwriteOrDie(buffer, size, count, m_file);
+            });
+}
+
 // WriteString - outputs a string into the file
 // str - the string to output
 // size - size of the string to output, if zero null terminated
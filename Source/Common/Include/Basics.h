@@ -12,6 +12,8 @@
 #include <string>
 #include <vector>
 #include <assert.h>
+#include <ctype.h>
+#include <wctype.h>
 #if __unix__
 #include <dlfcn.h> // for Plugin
 #endif
@@ -531,6 +533,36 @@ struct nocase_compare
     }
 };
 
+// hash and equality to match, for unordered_maps with case-insensitive key lookup
+struct nocase_hash
+{
+    size_t operator()(const string& key) const
+    {
+        size_t h = 2166136261u; // FNV-1a over the lower-cased characters
+        for (char c : key)
+            h = (h ^ (size_t) tolower((unsigned char) c)) * 16777619u;
+        return h;
+    }
+    size_t operator()(const wstring& key) const
+    {
+        size_t h = 2166136261u;
+        for (wchar_t c : key)
+            h = (h ^ (size_t) towlower(c)) * 16777619u;
+        return h;
+    }
+};
+struct nocase_equal
+{
+    bool operator()(const string& left, const string& right) const
+    {
+        return left.size() == right.size() && _stricmp(left.c_str(), right.c_str()) == 0;
+    }
+    bool operator()(const wstring& left, const wstring& right) const
+    {
+        return left.size() == right.size() && _wcsicmp(left.c_str(), right.c_str()) == 0;
+    }
+};
+
 // ----------------------------------------------------------------------------
 // random collection of stuff we needed at some place
 // ----------------------------------------------------------------------------
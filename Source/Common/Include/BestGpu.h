@@ -17,12 +17,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class ConfigParameters;
 DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config);
 DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config);
+// percent of the last NVML sample period (1/6 s to 1 s, depending on the product) during which a kernel ran on the device; -1 if unknown
+int GetGPUUtilization(DEVICEID_TYPE deviceId);
 #else
 template <class ConfigRecordType>
 static inline DEVICEID_TYPE DeviceFromConfig(const ConfigRecordType& /*config*/)
 {
     return -1 /*CPUDEVICE*/;
 } // tells runtime system to not try to use GPUs
+static inline int GetGPUUtilization(DEVICEID_TYPE /*deviceId*/)
+{
+    return -1;
+}
 // TODO: find a way to use CPUDEVICE without a huge include overhead; OK so far since CPUONLY mode is sorta special...
 #endif
 
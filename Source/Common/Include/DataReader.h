@@ -29,6 +29,12 @@
 #include "ScriptableObjects.h"
 #include <map>
 #include <string>
+#include <functional>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 // forward-declare these lattice-related types to avoid having to include and pollute everything with lattice-related headers
 namespace msra { namespace dbn {
@@ -94,6 +100,45 @@ public:
         return StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
     }
 
+    // Dynamic distribution for distributed reading: instead of a fixed subset of the data, the node reads blocks of
+    // 'workItemSize' samples of the epoch that it claims one after the other through 'nextWorkItem', which returns the
+    // index of the next block not claimed by any node yet. So faster nodes read (and train on) more of the epoch.
+    // 'subsetNum' and 'numSubsets' only size the node's minibatches, as for StartDistributedMinibatchLoop().
+    virtual bool SupportsDynamicDistributedMBRead() const
+    {
+        return false;
+    };
+    virtual void StartDynamicDistributedMinibatchLoop(size_t /*mbSize*/, size_t /*epoch*/, size_t /*subsetNum*/, size_t /*numSubsets*/,
+                                                      const std::function<size_t()>& /*nextWorkItem*/, size_t /*workItemSize*/, size_t /*requestedEpochSamples*/ = requestDataSize)
+    {
+        LogicError("This reader does not support dynamic distribution of mini-batches");
+    }
+
+    // Mid-epoch checkpoints: the sample position tells where this node is in the epoch, e.g. the number of samples that
+    // GetMinibatch() has handed out since the minibatch loop was started (readers may define it differently, see
+    // HTKMLFReader). Setting it right after starting the same minibatch loop again continues the epoch with the
+    // minibatch after that, without reading the data before it.
+    virtual bool SupportsSamplePositionSeek() const
+    {
+        return false;
+    }
+    virtual size_t GetCurrentSamplePosition()
+    {
+        LogicError("This reader does not support seeking to a sample position");
+    }
+    virtual void SetCurrentSamplePosition(size_t /*samplePosition*/)
+    {
+        LogicError("This reader does not support seeking to a sample position");
+    }
+
+    // With several reader sections, DataReader tells each reader the number of parallel sequences that the one before it
+    // returned. A reader whose minibatches do not depend on that number (SetNumParallelSequences() is ignored) may read
+    // its minibatch concurrently with the others (DataReader's 'parallelReaders' option).
+    virtual bool SupportsConcurrentRead() const
+    {
+        return false;
+    }
+
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) = 0;
     virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& /*latticeinput*/, vector<size_t>& /*uids*/, vector<size_t>& /*boundaries*/, vector<size_t>& /*extrauttmap*/)
     {
@@ -203,6 +248,31 @@ private:
     vector<wstring> m_ioNames;                          // TODO: why are these needed, why not loop over m_dataReaders?
     map<wstring, IDataReader<ElemType>*> m_dataReaders; // readers
 
+    // with 'parallelReaders': a thread for each reader after the first, which reads on the calling thread
+    class ReaderThread
+    {
+    public:
+        ReaderThread(IDataReader<ElemType>* reader);
+        ~ReaderThread();
+        void StartGetMinibatch(const std::map<std::wstring, Matrix<ElemType>*>& matrices); // (into a copy of the map)
+        bool EndGetMinibatch();                                                              // waits; rethrows the reader's exception
+
+    private:
+        void Run();
+
+        IDataReader<ElemType>* m_reader;
+        std::map<std::wstring, Matrix<ElemType>*> m_matrices; // (each reader may look up and add entries)
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp; // minibatch requested or stop
+        std::condition_variable m_done;   // minibatch read
+        bool m_pending;
+        bool m_stop;
+        bool m_result;
+        std::exception_ptr m_error;
+    };
+    vector<unique_ptr<ReaderThread>> m_readerThreads; // [i] reads for m_ioNames[i + 1]; empty unless 'parallelReaders'
+
     // Init - Reader Initialize for multiple data sets
     // config - [in] configuration parameters for the datareader
     // Sample format below for UCIReader:
@@ -263,6 +333,14 @@ public:
     virtual bool SupportsDistributedMBRead() const override;
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
 
+    virtual bool SupportsDynamicDistributedMBRead() const override;
+    virtual void StartDynamicDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets,
+                                                      const std::function<size_t()>& nextWorkItem, size_t workItemSize, size_t requestedEpochSamples = requestDataSize) override;
+
+    virtual bool SupportsSamplePositionSeek() const override;
+    virtual size_t GetCurrentSamplePosition() override;
+    virtual void SetCurrentSamplePosition(size_t samplePosition) override;
+
     // GetMinibatch - Get the next minibatch (features and labels)
     // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
     //             [out] each matrix resized if necessary containing data.
@@ -36,6 +36,16 @@ enum NodeGroup
     nodeSpecified
 };
 
+// EvalBuffer - caller-owned memory, used by the Evaluate() overload that binds it directly instead of copying it
+// As input, m_size elements holding the records of a node one after the other; as output, the capacity, which
+// Evaluate() replaces by the number of elements it wrote.
+template <class ElemType>
+struct EvalBuffer
+{
+    ElemType* m_buffer;
+    size_t m_size;
+};
+
 // IEvaluateModel - interface used by decoders and other components that need just evaluator functionality in DLL form
 template <class ElemType>
 class IEvaluateModel // Evaluate Model Interface
@@ -49,6 +59,12 @@ public:
     virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName) = 0;
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
     virtual void ResetState() = 0;
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs) = 0;
+
+    // PrepareEvaluate - for serving: allocate all that the Evaluate() overload on EvalBuffers needs for the given outputs
+    // and up to maxNumRecords records, once. From then on, that overload does not allocate memory; it must be called
+    // for exactly these outputs, and fails if given more records.
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords) = 0;
 };
 
 // GetEval - get a evaluator type from the DLL
@@ -59,6 +75,113 @@ void EVAL_API GetEval(IEvaluateModel<ElemType>** peval);
 extern "C" EVAL_API void GetEvalF(IEvaluateModel<float>** peval);
 extern "C" EVAL_API void GetEvalD(IEvaluateModel<double>** peval);
 
+// IEvaluateModelContext - evaluates the model it was created from (IEvaluateModelShared::CreateContext())
+// It holds the activations and recurrent state of one stream of evaluations. Contexts of the same model may be used
+// concurrently, but each only by one thread at a time.
+template <class ElemType>
+class IEvaluateModelContext
+{
+public:
+    virtual void Destroy() = 0;
+
+    virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName) = 0;
+    virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void ResetState() = 0;
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs) = 0;
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords) = 0; // see IEvaluateModel
+};
+
+// IEvaluateModelShared - a model that is loaded once and evaluated by any number of threads, each through its own context
+// The contexts share the model parameters. All methods may be called concurrently; destroy all contexts before the model.
+template <class ElemType>
+class IEvaluateModelShared
+{
+public:
+    virtual void Init(const std::string& config) = 0;
+    virtual void Destroy() = 0;
+
+    virtual void LoadModel(const std::wstring& modelFileName) = 0;
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup) = 0;
+    virtual IEvaluateModelContext<ElemType>* CreateContext() = 0;
+};
+
+// GetEvalShared - get a shared evaluator type from the DLL, exported like GetEval()
+template <class ElemType>
+void EVAL_API GetEvalShared(IEvaluateModelShared<ElemType>** peval);
+extern "C" EVAL_API void GetEvalSharedF(IEvaluateModelShared<float>** peval);
+extern "C" EVAL_API void GetEvalSharedD(IEvaluateModelShared<double>** peval);
+
+// GetEvalBatching - get an evaluator whose Evaluate() may be called from any number of threads at once
+// Concurrent requests are packed into one minibatch, with one parallel sequence per request, and evaluated together.
+// Each request is evaluated as a sequence of its own, so ResetState() has no effect.
+template <class ElemType>
+void EVAL_API GetEvalBatching(IEvaluateModel<ElemType>** peval);
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModel<float>** peval);
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModel<double>** peval);
+
+// IEvaluateModelStreaming - evaluates recurrent models on streams of frames (e.g. online decoding), chunk by chunk
+// The recurrent state of each stream is carried over from one chunk to the next, so each chunk only costs its own
+// frames. The chunks of all streams passed to one Evaluate() call are evaluated together, in one minibatch.
+// Only PastValue recurrences can be carried over; models that look into the future cannot be streamed.
+template <class ElemType>
+class IEvaluateModelStreaming
+{
+public:
+    virtual void Init(const std::string& config) = 0;
+    virtual void Destroy() = 0;
+
+    virtual void LoadModel(const std::wstring& modelFileName) = 0;
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup) = 0;
+
+    // a stream's state starts out empty and lives until it is closed
+    virtual size_t OpenStream() = 0;
+    virtual void CloseStream(size_t stream) = 0;
+
+    // ForkStream - open a stream whose state is a copy of that of the given stream, e.g. to try two continuations of it
+    virtual size_t ForkStream(size_t stream) = 0;
+
+    // Evaluate - evaluate the next chunk of each of the given streams
+    // inputs[i] - map from node name to the frames of the chunk of streams[i]
+    // outputs[i] - map from node name to output vector for streams[i], sized during evaluation
+    virtual void Evaluate(const std::vector<size_t>& streams,
+                          std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs,
+                          std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs) = 0;
+};
+
+// GetEvalStreaming - get a streaming evaluator from the DLL, exported like GetEval()
+template <class ElemType>
+void EVAL_API GetEvalStreaming(IEvaluateModelStreaming<ElemType>** peval);
+extern "C" EVAL_API void GetEvalStreamingF(IEvaluateModelStreaming<float>** peval);
+extern "C" EVAL_API void GetEvalStreamingD(IEvaluateModelStreaming<double>** peval);
+
+// IEvaluateModelBeamSearch - beam search with a recurrent model that predicts the next token from the previous ones
+// The model reads tokens as one-hot vectors at its only input, 'tokenInputNodeName', and gives the scores of the next
+// token (logits or log-probabilities) at 'scoreOutputNodeName'. As for IEvaluateModelStreaming, its recurrences must be
+// PastValue. Further config: endToken (token id), beamWidth=5, maxLength=100 (tokens after the prefix).
+template <class ElemType>
+class IEvaluateModelBeamSearch
+{
+public:
+    virtual void Init(const std::string& config) = 0;
+    virtual void Destroy() = 0;
+
+    virtual void LoadModel(const std::wstring& modelFileName) = 0;
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup) = 0;
+
+    // Decode - find the most likely continuations of the given prefixes (e.g. a source sentence and a separator token)
+    // prefixes[r] - the tokens of request r, at least one; all requests are decoded together
+    // nBest[r] - up to beamWidth continuations of prefixes[r] with their log-probabilities, best first; each ends with
+    //            endToken, unless it was cut off at maxLength
+    virtual void Decode(const std::vector<std::vector<size_t>>& prefixes,
+                        std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nBest) = 0;
+};
+
+// GetEvalBeamSearch - get a beam search decoder from the DLL, exported like GetEval()
+template <class ElemType>
+void EVAL_API GetEvalBeamSearch(IEvaluateModelBeamSearch<ElemType>** peval);
+extern "C" EVAL_API void GetEvalBeamSearchF(IEvaluateModelBeamSearch<float>** peval);
+extern "C" EVAL_API void GetEvalBeamSearchD(IEvaluateModelBeamSearch<double>** peval);
+
 // Data Reader class
 // interface for clients of the Data Reader
 // mirrors the IEvaluateModel interface, except the Init method is private (use the constructor)
@@ -80,6 +203,7 @@ public:
     // deviceId=auto ( can be [0,all,cpu,0:2:3,auto] define accellerators (GPUs) to use, or the CPU
     // modelPath=c:\models\model.dnn (model path, if not specified, must call LoadModel() method before Evaluate()
     // minibatchSize=1024 (minibatch size used during evaluation if < passed data size)
+    // resultCacheSize=0 (if > 0, the outputs of that many recent inputs are kept and returned for the same inputs without evaluating)
     Eval(const std::string& config);
     virtual ~Eval();
 
@@ -100,6 +224,14 @@ public:
     // inputs - map from node name to input vector
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // Evaluate - Evaluate using caller-owned buffers, which the evaluator reads and writes directly where it can
+    // inputs - map from node name to input buffer
+    // outputs - map from node name to output buffer, which must be large enough to hold the output
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs);
+
+    // PrepareEvaluate - allocate once what the overload above needs for these outputs and up to maxNumRecords records
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords);
     virtual void Init(const std::string& config);
     virtual void ResetState();
 };
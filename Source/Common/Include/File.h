@@ -34,7 +34,7 @@ enum FileOptions
     fileOptionsType = fileOptionsBinary | fileOptionsText | fileOptionsUnicode, // file types
     fileOptionsRead = 8,                                                        // open in read mode
     fileOptionsWrite = 16,                                                      // open in write mode
-    fileOptionsSequential = 32,                                                 // optimize for sequential reads (allocates big buffer)
+    fileOptionsSequential = 32,                                                 // optimize for sequential reads (big buffer, OS read-ahead; see fsetsequentialbuffersize())
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,                  // read/write mode
 };
 
@@ -204,6 +204,10 @@ public:
     void ReadChars(std::string& val, size_t cnt, bool reset = false);  // read a specified number of characters, and reset read pointer if requested
     void ReadChars(std::wstring& val, size_t cnt, bool reset = false); // read a specified number of characters, and reset read pointer if requested
 
+    // read/write 'count' elements of 'size' bytes each in one go, as stored back to back by the operators above; binary files only
+    void ReadBinaryArray(void* buffer, size_t size, size_t count);
+    void WriteBinaryArray(const void* buffer, size_t size, size_t count);
+
     File& operator>>(std::wstring& val);
     File& operator>>(std::string& val);
     File& operator>>(FileMarker marker);
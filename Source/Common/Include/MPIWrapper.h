@@ -6,6 +6,9 @@
 // and the MPI dev package on Linux (sudo apt-get install libopenmpi-dev openmpi-bin openmpi-doc)
 #include "mpi.h"
 #pragma comment(lib, "msmpi.lib")
+#if defined(OPEN_MPI) && !defined(_WIN32)
+#include "mpi-ext.h" // for MPIX_CUDA_AWARE_SUPPORT
+#endif
 
 #include <string>
 #include <array>
@@ -58,6 +61,15 @@ class MPIWrapper
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // communicators for HierarchicalAllReduce(), created on first use
+    MPI_Comm m_hostComm;   // the ranks on our host
+    MPI_Comm m_leaderComm; // one rank per host (MPI_COMM_NULL on all others)
+    int m_hostRank;        // our rank in m_hostComm
+
+    // shared counter for NextWorkItem(), created on first use (allocated on the main node only)
+    MPI_Win m_workQueueWindow;
+    unsigned long long *m_workQueueCounter;
+
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
     int MPI_Init_DL()
     {
@@ -100,7 +112,7 @@ class MPIWrapper
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_hostComm(MPI_COMM_NULL), m_leaderComm(MPI_COMM_NULL), m_hostRank(0), m_workQueueWindow(MPI_WIN_NULL), m_workQueueCounter(nullptr)
     {
         static bool initialized = false;
         if (initialized)
@@ -304,11 +316,233 @@ public:
         }
     }
 
+    // -----------------------------------------------------------------------
+    // collectives on device (GPU) buffers
+    // -----------------------------------------------------------------------
+
+    // true if MPI can read and write GPU memory directly (CUDA-aware MPI)
+    // This can only be queried from Open MPI; for other implementations (e.g. MVAPICH2 with MV2_USE_CUDA=1), set
+    // CNTK_MPI_CUDA_AWARE=1 in the environment to assert it.
+    static bool IsCUDAAware()
+    {
+        const char *env = getenv("CNTK_MPI_CUDA_AWARE");
+        if (env && *env)
+            return atoi(env) != 0;
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+        return MPIX_Query_cuda_support() != 0;
+#else
+        return false;
+#endif
+    }
+
+    // in-place sum over all nodes of 'data' by a ring allreduce (reduce-scatter followed by allgather), which only
+    // uses point-to-point transfers between neighbouring ranks. Unlike MPI_Allreduce(), it thus works on GPU buffers
+    // with any CUDA-aware MPI, which transfers them directly between the devices (peer-to-peer within a machine),
+    // without staging them in host memory, and sends 2 (N-1)/N times the data per node irrespective of N.
+    // The received chunks are summed up by the caller on its device:
+    //  - 'receiveBuffer' must hold (numElements + NumNodesInUse() - 1) / NumNodesInUse() elements
+    //  - accumulate(offset, n) must add receiveBuffer[0..n) to data[offset..offset+n), and have completed when it returns
+    template <class ElemType, class ACCUMULATE>
+    void RingAllReduce(ElemType *data, size_t numElements, ElemType *receiveBuffer, const ACCUMULATE &accumulate) const
+    {
+        const int numNodes = (int) NumNodesInUse();
+        if ((numNodes <= 1) || (Communicator() == MPI_COMM_NULL))
+            return;
+        const int rank = (int) CurrentNodeRank();
+        const int left = (rank + numNodes - 1) % numNodes;
+        const int right = (rank + 1) % numNodes;
+        const int ringTag = 32767; // the minimum MPI_TAG_UB; distinct from the tags used by the gradient aggregators
+        auto chunkBegin = [=](int chunk) { return numElements * chunk / numNodes; };
+        auto chunkSize = [=](int chunk) { return (int) (chunkBegin(chunk + 1) - chunkBegin(chunk)); };
+
+        // reduce-scatter: after step s, chunk (rank - s - 1) holds the sum over s + 2 nodes; in the end, chunk (rank + 1) is complete
+        for (int step = 0; step < numNodes - 1; step++)
+        {
+            int sendChunk = (rank - step + numNodes) % numNodes;
+            int recvChunk = (rank - step - 1 + numNodes) % numNodes;
+            MPI_Sendrecv(data + chunkBegin(sendChunk), chunkSize(sendChunk), GetDataType(data), right, ringTag,
+                         receiveBuffer, chunkSize(recvChunk), GetDataType(data), left, ringTag,
+                         Communicator(), MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+            accumulate(chunkBegin(recvChunk), (size_t) chunkSize(recvChunk));
+        }
+
+        // allgather: pass the complete chunks around the ring, straight into their place
+        for (int step = 0; step < numNodes - 1; step++)
+        {
+            int sendChunk = (rank - step + 1 + numNodes) % numNodes;
+            int recvChunk = (rank - step + numNodes) % numNodes;
+            MPI_Sendrecv(data + chunkBegin(sendChunk), chunkSize(sendChunk), GetDataType(data), right, ringTag,
+                         data + chunkBegin(recvChunk), chunkSize(recvChunk), GetDataType(data), left, ringTag,
+                         Communicator(), MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // two-level allreduce for clusters of multi-GPU hosts
+    // -----------------------------------------------------------------------
+
+    // in-place sum over all nodes that first reduces within each host (through shared memory), then allreduces
+    // across hosts among one leader rank per host, and finally broadcasts within each host. Only the leaders
+    // communicate across hosts, which cuts the inter-host traffic by the number of ranks per host.
+    // This is a collective call; all nodes must make it in the same order.
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *pData, size_t nData)
+    {
+        if ((NumNodesInUse() <= 1) || (Communicator() == MPI_COMM_NULL))
+            return;
+        CreateHostCommunicators();
+
+        MPI_Reduce(m_hostRank == 0 ? MPI_IN_PLACE : pData, pData, (int) nData, GetDataType(pData), MPI_SUM, 0, m_hostComm) || MpiFail("HierarchicalAllReduce: MPI_Reduce");
+        if (m_leaderComm != MPI_COMM_NULL)
+            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, m_leaderComm) || MpiFail("HierarchicalAllReduce: MPI_Allreduce");
+        MPI_Bcast(pData, (int) nData, GetDataType(pData), 0, m_hostComm) || MpiFail("HierarchicalAllReduce: MPI_Bcast");
+    }
+
+private:
+    void CreateHostCommunicators()
+    {
+        if (m_hostComm != MPI_COMM_NULL)
+            return;
+
+        MPI_Comm_split_type(Communicator(), MPI_COMM_TYPE_SHARED, m_myRank, MPI_INFO_NULL, &m_hostComm) || MpiFail("CreateHostCommunicators: MPI_Comm_split_type");
+        MPI_Comm_rank(m_hostComm, &m_hostRank) || MpiFail("CreateHostCommunicators: MPI_Comm_rank");
+        MPI_Comm_split(Communicator(), m_hostRank == 0 ? 0 : MPI_UNDEFINED, m_myRank, &m_leaderComm) || MpiFail("CreateHostCommunicators: MPI_Comm_split");
+
+        int numRanksOnHost, numHosts = 0;
+        MPI_Comm_size(m_hostComm, &numRanksOnHost) || MpiFail("CreateHostCommunicators: MPI_Comm_size");
+        if (m_leaderComm != MPI_COMM_NULL)
+            MPI_Comm_size(m_leaderComm, &numHosts) || MpiFail("CreateHostCommunicators: MPI_Comm_size");
+        if (IsMainNode())
+        {
+            fprintf(stderr, "mpihelper: hierarchical allreduce over %d hosts (%d ranks on ours)\n", numHosts, numRanksOnHost);
+            fflush(stderr);
+        }
+    }
+
+public:
+    // -----------------------------------------------------------------------
+    // shared work queue, for handing out work items (e.g. blocks of training data) dynamically
+    // -----------------------------------------------------------------------
+
+    // The queue is a counter on the main node that the nodes fetch-and-increment atomically through MPI one-sided
+    // communication, so that faster nodes simply claim more items, without any node having to serve requests.
+    // Starts a new round of items from 0. This is a collective call.
+    void ResetWorkQueue()
+    {
+        if (Communicator() == MPI_COMM_NULL)
+            return;
+        if (m_workQueueWindow == MPI_WIN_NULL)
+        {
+            MPI_Aint size = IsMainNode() ? sizeof(*m_workQueueCounter) : 0;
+            MPI_Win_allocate(size, sizeof(*m_workQueueCounter), MPI_INFO_NULL, Communicator(), &m_workQueueCounter, &m_workQueueWindow) || MpiFail("ResetWorkQueue: MPI_Win_allocate");
+        }
+
+        MPI_Barrier(Communicator()) || MpiFail("ResetWorkQueue: MPI_Barrier"); // (nobody claims items of the previous round anymore)
+        if (IsMainNode())
+        {
+            unsigned long long zero = 0;
+            MPI_Win_lock(MPI_LOCK_EXCLUSIVE, (int) MainNodeRank(), 0, m_workQueueWindow) || MpiFail("ResetWorkQueue: MPI_Win_lock");
+            MPI_Accumulate(&zero, 1, MPI_UNSIGNED_LONG_LONG, (int) MainNodeRank(), 0, 1, MPI_UNSIGNED_LONG_LONG, MPI_REPLACE, m_workQueueWindow) || MpiFail("ResetWorkQueue: MPI_Accumulate");
+            MPI_Win_unlock((int) MainNodeRank(), m_workQueueWindow) || MpiFail("ResetWorkQueue: MPI_Win_unlock");
+        }
+        MPI_Barrier(Communicator()) || MpiFail("ResetWorkQueue: MPI_Barrier");
+    }
+
+    // claim the next work item of the current round; returns its index (items are handed out exactly once, in increasing order)
+    size_t NextWorkItem()
+    {
+        if (m_workQueueWindow == MPI_WIN_NULL)
+            LogicError("NextWorkItem: ResetWorkQueue() must be called first");
+
+        unsigned long long one = 1, item = 0;
+        MPI_Win_lock(MPI_LOCK_SHARED, (int) MainNodeRank(), 0, m_workQueueWindow) || MpiFail("NextWorkItem: MPI_Win_lock");
+        MPI_Fetch_and_op(&one, &item, MPI_UNSIGNED_LONG_LONG, (int) MainNodeRank(), 0, MPI_SUM, m_workQueueWindow) || MpiFail("NextWorkItem: MPI_Fetch_and_op");
+        MPI_Win_unlock((int) MainNodeRank(), m_workQueueWindow) || MpiFail("NextWorkItem: MPI_Win_unlock");
+        return (size_t) item;
+    }
+
     // wait for all ranks to reach here
     void WaitAll()
     {
         MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
     }
+
+    // -----------------------------------------------------------------------
+    // elastic membership: processes joining and leaving the job (see SGD's ElasticTraining)
+    // -----------------------------------------------------------------------
+
+    // Processes join through an MPI port (MPI_Comm_accept/MPI_Comm_connect), and the members, including the new ones,
+    // continue on a communicator that spans them all. Ranks and the number of nodes change accordingly; the communicators
+    // and windows derived from the previous communicator are released. All of these are collective calls.
+
+    // main node: open a port for processes to connect to; returns its name
+    std::string OpenPort()
+    {
+        char portName[MPI_MAX_PORT_NAME];
+        MPI_Open_port(MPI_INFO_NULL, portName) || MpiFail("OpenPort: MPI_Open_port");
+        return portName;
+    }
+
+    void ClosePort(const std::string &portName)
+    {
+        MPI_Close_port(const_cast<char *>(portName.c_str())) || MpiFail("ClosePort: MPI_Close_port");
+    }
+
+    // admit a process that calls Connect(); it gets the next rank ('portName' is only used on the main node)
+    void Accept(const std::string &portName)
+    {
+        MPI_Comm intercomm, merged;
+        MPI_Comm_accept(const_cast<char *>(portName.c_str()), MPI_INFO_NULL, (int) MainNodeRank(), m_currentComm, &intercomm) || MpiFail("Accept: MPI_Comm_accept");
+        MPI_Intercomm_merge(intercomm, 0 /*low: our ranks come first*/, &merged) || MpiFail("Accept: MPI_Intercomm_merge");
+        MPI_Comm_disconnect(&intercomm) || MpiFail("Accept: MPI_Comm_disconnect");
+        ReplaceCommunicator(merged);
+    }
+
+    // join the job listening on 'portName'; blocks until the job calls Accept()
+    void Connect(const std::string &portName)
+    {
+        MPI_Comm intercomm, merged;
+        MPI_Comm_connect(const_cast<char *>(portName.c_str()), MPI_INFO_NULL, 0, m_currentComm, &intercomm) || MpiFail("Connect: MPI_Comm_connect");
+        MPI_Intercomm_merge(intercomm, 1 /*high: after the job's ranks*/, &merged) || MpiFail("Connect: MPI_Intercomm_merge");
+        MPI_Comm_disconnect(&intercomm) || MpiFail("Connect: MPI_Comm_disconnect");
+        ReplaceCommunicator(merged);
+    }
+
+    // the ranks that pass 'leave' leave the job: the others continue without them, and they continue on their own
+    // Returns false on the ranks that left.
+    bool Leave(bool leave)
+    {
+        MPI_Comm remaining;
+        MPI_Comm_split(m_currentComm, leave ? MPI_UNDEFINED : 0, m_myRank, &remaining) || MpiFail("Leave: MPI_Comm_split");
+        ReplaceCommunicator(leave ? MPI_COMM_SELF : remaining);
+        return !leave;
+    }
+
+private:
+    void ReplaceCommunicator(MPI_Comm comm)
+    {
+        // disconnect (rather than just free) everything on the previous communicator, so that processes that leave are
+        // no longer tied to the job
+        if (m_workQueueWindow != MPI_WIN_NULL)
+        {
+            MPI_Win_free(&m_workQueueWindow) || MpiFail("ReplaceCommunicator: MPI_Win_free");
+            m_workQueueCounter = nullptr;
+        }
+        if (m_leaderComm != MPI_COMM_NULL)
+            MPI_Comm_disconnect(&m_leaderComm) || MpiFail("ReplaceCommunicator: MPI_Comm_disconnect");
+        if (m_hostComm != MPI_COMM_NULL)
+            MPI_Comm_disconnect(&m_hostComm) || MpiFail("ReplaceCommunicator: MPI_Comm_disconnect");
+        if (m_currentComm != MPI_COMM_WORLD && m_currentComm != MPI_COMM_SELF)
+            MPI_Comm_disconnect(&m_currentComm) || MpiFail("ReplaceCommunicator: MPI_Comm_disconnect");
+
+        m_currentComm = comm;
+        MPI_Comm_rank(m_currentComm, &m_myRank) || MpiFail("ReplaceCommunicator: MPI_Comm_rank");
+        MPI_Comm_size(m_currentComm, &m_numMPINodes) || MpiFail("ReplaceCommunicator: MPI_Comm_size");
+        m_numNodesInUse = m_numMPINodes;
+        s_myRank = m_myRank;
+        fprintf(stderr, "mpihelper: we are now cog %d in a gearbox of %d\n", (int) m_myRank, (int) m_numMPINodes);
+        fflush(stderr);
+    }
 };
 }
 }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "TimerUtility.h"
+#include "AsyncLog.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -13,7 +14,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //
 // This is for use by the cluster management tools for indicating global progress to the user.
 //
-// This logs to stdout (not stderr) in a specific format, e.g. understood by the Philly cluster. The format is:
+// This logs to stdout (not stderr), through AsyncLog, in a specific format, e.g. understood by the Philly cluster. The format is:
 //  PROGRESS xx.xx%
 //  EVALERR xx.xx%
 //
@@ -86,7 +87,7 @@ public:
         {
             double epochProg = ((100.0f * (double) (us.m_currentStepOffset + epochNumber)) / (double) us.m_totalNumberOfSteps);
             mbProg = (mbProg * 100.0f) / (double) us.m_totalNumberOfSteps;
-            printf("PROGRESS: %.2f%%\n", epochProg + mbProg);
+            AsyncLog::Write(stdout, "PROGRESS: %.2f%%\n", epochProg + mbProg);
             us.m_progressTracingTimer.Restart();
         }
         return needToPrint;
@@ -103,7 +104,7 @@ public:
             return;
         }
 
-        printf("EVALERR: %.7f%%\n", err);
+        AsyncLog::Write(stdout, "EVALERR: %.7f%%\n", err);
     }
 };
 } } }
@@ -11,6 +11,8 @@
 #include "Matrix.h"
 #include <vector>
 #include <memory> // for shared_ptr
+#include <map>
+#include <type_traits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -133,6 +135,7 @@ public:
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
         m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_continuationMasks.clear();
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -171,6 +174,10 @@ public:
 
     const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId) const;
 
+    // flags whether the sequence continues from each frame to the frame at 'timeOffset' (false for gaps), as used by delay nodes
+    const vector<char>& GetContinuationFlags(ptrdiff_t timeOffset) const;
+    const Matrix<char>& GetContinuationMask(ptrdiff_t timeOffset, DEVICEID_TYPE deviceId) const;
+
     // compare whether two layouts are the same
     bool operator==(const MBLayout &other) const
     {
@@ -399,6 +406,15 @@ private:
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
     mutable Matrix<char> m_columnsValidityMask;
 
+    // Cached continuation flags per time offset (GetContinuationFlags()), and their copy on the device (GetContinuationMask()).
+    // Recurrent nodes on the same layout share them, instead of each making and uploading its own per minibatch.
+    struct ContinuationMask
+    {
+        vector<char> flags;             // [s + t * S]
+        shared_ptr<Matrix<char>> mask;  // [1 x S*T], created upon first request
+    };
+    mutable map<ptrdiff_t, ContinuationMask> m_continuationMasks;
+
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
     // Meant to guard in lazy creation of m_columnsValidityMask.
@@ -449,6 +465,7 @@ public:                       // TODO: make private (currently used from masking
     ptrdiff_t m_timeOffset;   // this is added to timeIdxInSeq wherever it is used
     size_t m_timeRange;       // use this to describe a custom range > 1 frame
     size_t seqIndex;          // parallel-sequence index; SIZE_MAX = all sequences in MB (most common case)  --TODO: Bad name, 'sequence' and 'parallel sequence' are two different things
+    size_t m_numSequences;    // number of consecutive parallel sequences starting at seqIndex (ignored if seqIndex == SIZE_MAX)
     MBLayoutPtr m_pMBLayout;  // layout associated with this
     bool m_broadcastAllowed;  // frame range may be broadcast from outer layout (e.g. a matrix with NULL layout and 1 column is acceptable to this frame range). Only applies when iterating over time; otherwise broadcasting is always OK.
     const FrameRange *parent; // or NULL: parent range, relative to which this FrameRange is interpreted  --TODO: not used yet
@@ -456,7 +473,7 @@ public:                       // TODO: make private (currently used from masking
 public:
     // can construct from a single size_t -> a single-frame range
     FrameRange(MBLayoutPtr pMBLayout, size_t timeIdxInSeq)
-        : timeIdxInSeq(timeIdxInSeq), m_timeOffset(0), m_timeRange(1), seqIndex(SIZE_MAX), m_pMBLayout(pMBLayout), m_broadcastAllowed(false), parent(nullptr)
+        : timeIdxInSeq(timeIdxInSeq), m_timeOffset(0), m_timeRange(1), seqIndex(SIZE_MAX), m_numSequences(1), m_pMBLayout(pMBLayout), m_broadcastAllowed(false), parent(nullptr)
     {
     }
 
@@ -487,6 +504,17 @@ public:
     {
         FrameRange ret = *this;
         ret.seqIndex = s;
+        ret.m_numSequences = 1;
+        return ret;
+    }
+
+    // create a FrameRange that accesses the consecutive parallel sequences [s, s+n)
+    // Used by recurrent loops to skip the parallel sequences that are gaps at a time step.
+    FrameRange Sequences(size_t s, size_t n) const
+    {
+        FrameRange ret = *this;
+        ret.seqIndex = s;
+        ret.m_numSequences = n;
         return ret;
     }
 
@@ -554,7 +582,7 @@ public:
     };
     IndexIteration GetSequenceRange(const shared_ptr<MBLayout> &pMBLayout) const
     {
-        return IndexIteration(seqIndex == SIZE_MAX ? 0 : seqIndex, seqIndex == SIZE_MAX ? pMBLayout->GetNumParallelSequences() : seqIndex + 1);
+        return IndexIteration(seqIndex == SIZE_MAX ? 0 : seqIndex, seqIndex == SIZE_MAX ? pMBLayout->GetNumParallelSequences() : seqIndex + m_numSequences);
     }
 
     // code that can only handle single-frame ranges will call t() to get the time index, which will throw if numFrames != 1
@@ -614,6 +642,15 @@ inline bool MBLayout::IsGap(const FrameRange &fr) const
     if (s == SIZE_MAX) // aggregate requested
         return m_timeStepHasGap[t];
 
+    // a range of parallel sequences: true if any of them is a gap
+    if (fr.m_numSequences != 1)
+    {
+        for (size_t s1 = s; s1 < s + fr.m_numSequences; s1++)
+            if (m_distanceToStart(s1, t) < 0)
+                return true;
+        return false;
+    }
+
     // determine flags from matrices
     return m_distanceToStart(s, t) < 0; // value is -1 for gaps, non-negative otherwise
 }
@@ -642,6 +679,15 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
         return false;
     }
 
+    // a range of parallel sequences: true if any of them is
+    if (fr.m_numSequences != 1)
+    {
+        for (size_t s1 = s; s1 < s + fr.m_numSequences; s1++)
+            if (IsBeyondStartOrEnd(fr.Sequence(s1)))
+                return true;
+        return false;
+    }
+
     // determine flags from matrices
     auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
     if (distanceToStart == -1) // indicates a gap
@@ -670,8 +716,8 @@ inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared
 inline const Matrix<char> &MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId) const
 {
     CheckIsValid();
-    // lazily compute the validity mask
-    if (m_columnsValidityMask.IsEmpty())
+    // lazily compute the validity mask (again if requested for another device)
+    if (m_columnsValidityMask.IsEmpty() || m_columnsValidityMask.GetDeviceId() != deviceId)
     {
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
@@ -707,6 +753,50 @@ inline const Matrix<char> &MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
     return m_columnsValidityMask;
 }
 
+// return the flags [s + t * S] whether frame (s,t) has content and its neighbor at (s,t+timeOffset) lies inside the same
+// sequence, i.e. whether a delay that reads from 'timeOffset' continues the sequence rather than crossing its start or end
+// These are determined once per minibatch and offset, and then shared by all nodes on this layout.
+inline const vector<char> &MBLayout::GetContinuationFlags(ptrdiff_t timeOffset) const
+{
+    CheckIsValid();
+    auto &continuation = m_continuationMasks[timeOffset];
+    if (continuation.flags.empty() && GetNumCols() > 0)
+    {
+        Lock();
+
+        size_t nT = GetNumTimeSteps();
+        size_t nS = GetNumParallelSequences();
+        continuation.flags.assign(nT * nS, 1);
+        for (size_t t = 0; t < nT; t++)
+        {
+            FrameRange fr(nullptr, t);
+            FrameRange frOffset = fr.WithTimeOffset(timeOffset);
+            if (!IsGap(fr) && !IsBeyondStartOrEnd(frOffset)) // short-cut for the frames without any boundary or gap
+                continue;
+            for (size_t s = 0; s < nS; s++)
+            {
+                if (IsGap(fr.Sequence(s)) || IsBeyondStartOrEnd(frOffset.Sequence(s)))
+                    continuation.flags[(t * nS) + s] = 0;
+            }
+        }
+    }
+    return continuation.flags;
+}
+
+// the same as a [1 x S*T] column mask on 'deviceId', uploaded once per minibatch, offset and device
+inline const Matrix<char> &MBLayout::GetContinuationMask(ptrdiff_t timeOffset, DEVICEID_TYPE deviceId) const
+{
+    const auto &flags = GetContinuationFlags(timeOffset);
+    auto &continuation = m_continuationMasks[timeOffset];
+    if (!continuation.mask || continuation.mask->GetDeviceId() != deviceId)
+    {
+        // (a new matrix rather than overwriting, since layouts copied through CopyFrom() may share it)
+        continuation.mask = make_shared<Matrix<char>>(deviceId);
+        continuation.mask->SetValue(1, flags.size(), deviceId, const_cast<char *>(flags.data()));
+    }
+    return *continuation.mask;
+}
+
 // class for defining an iteration over a sequence, forward and backward
 // One day, we may also have nested structures. For those, FrameRangeIterations will be able to be instantiated from FrameRange objects to loop over their nested dimension.
 class FrameRangeIteration
@@ -828,7 +918,7 @@ static inline std::pair<size_t, size_t> ColumnRangeWithMBLayoutFor(size_t numCol
         else if (fr.m_timeRange != 1)
             LogicError("DataFor: FrameRange only support per-sequence time ranges with tensor slices, not matrix slices.");
         else
-            return std::pair<size_t, size_t>(startColumn + fr.seqIndex, 1);
+            return std::pair<size_t, size_t>(startColumn + fr.seqIndex, fr.m_numSequences);
     }
 }
 
@@ -863,7 +953,7 @@ static inline std::pair<DimensionVector, DimensionVector> TensorSliceWithMBLayou
                                                                                      const MBLayoutPtr &pMBLayout /*the MB layout of 'data'*/)
 {
     std::pair<DimensionVector, DimensionVector> result;
-    typedef decltype(result.first[0]) ElemType;
+    typedef typename std::remove_reference<decltype(result.first[0])>::type ElemType;
 
     // this creates a slice for the entire matrix, which we will then narrow down
     result.first.resize(shape.size(), 0);
@@ -921,10 +1011,10 @@ static inline std::pair<DimensionVector, DimensionVector> TensorSliceWithMBLayou
     if (fr.seqIndex != SIZE_MAX /*sequence requested*/ && pMBLayout /*have sequences*/ && result.second[sequenceDim] > 1 /*>1 sequence (not broadcasting)*/)
     {
         size_t s = fr.seqIndex;
-        if (s >= result.second[sequenceDim])
+        if (s + fr.m_numSequences > result.second[sequenceDim])
             LogicError("DataFor: FrameRange specifies a paralllel-sequence index that is out of range.");
         result.first[sequenceDim] = (ElemType) s;
-        result.second[sequenceDim] = (ElemType) s + 1;
+        result.second[sequenceDim] = (ElemType) (s + fr.m_numSequences);
     }
 
     return result;
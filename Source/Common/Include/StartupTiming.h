@@ -0,0 +1,97 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "TimerUtility.h"
+#include <atomic>
+#include <cstdio>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ---------------------------------------------------------------------------
+// StartupTiming -- static helper class for logging where the time goes between process start and the first minibatch
+//
+// main() calls Start(), and SGD calls Finish() once the first minibatch has been trained. In between, each phase of
+// the startup (parsing the config, selecting the GPU, creating the readers, building or loading the network,
+// PreCompute) is timed by a Phase object from its construction to its destruction and logged to stderr as
+//  Startup: <phase> took 12.345 seconds (at 20.123 seconds)
+// where 'at' is the time since Start(). Phases may nest, and may run concurrently on several threads, whose overlap
+// then shows in these times. Outside of Start() and Finish() nothing is logged, so that the same code running later
+// (e.g. loading a model for cross-validation) is not reported as startup.
+// ---------------------------------------------------------------------------
+
+/*static*/ class StartupTiming
+{
+    std::atomic<bool> m_enabled;
+    Timer m_sinceStart;
+
+    StartupTiming()
+    {
+        m_enabled = false;
+    }
+
+    static StartupTiming& GetStaticInstance()
+    {
+        static StartupTiming us;
+        return us;
+    } // wrap static state in an accessor, so we won't need a CPP file
+
+public:
+    static bool IsEnabled()
+    {
+        return GetStaticInstance().m_enabled;
+    }
+
+    // call at process start (before any other thread is started)
+    static void Start()
+    {
+        auto& us = GetStaticInstance();
+        us.m_sinceStart.Start();
+        us.m_enabled = true;
+    }
+
+    static double SecondsSinceStart()
+    {
+        return GetStaticInstance().m_sinceStart.ElapsedSeconds();
+    }
+
+    // log a phase timed by the caller
+    static void LogPhase(const char* phase, double seconds)
+    {
+        if (IsEnabled())
+            fprintf(stderr, "Startup: %s took %.3f seconds (at %.3f seconds)\n", phase, seconds, SecondsSinceStart());
+    }
+
+    // log the total startup time and end the logging
+    static void Finish(const char* what)
+    {
+        auto& us = GetStaticInstance();
+        if (us.m_enabled.exchange(false))
+            fprintf(stderr, "Startup: %s at %.3f seconds\n", what, us.m_sinceStart.ElapsedSeconds());
+    }
+
+    // one phase: from construction to destruction
+    class Phase
+    {
+    public:
+        Phase(const char* phase)
+            : m_phase(phase)
+        {
+            m_timer.Start();
+        }
+        ~Phase()
+        {
+            m_timer.Stop();
+            LogPhase(m_phase, m_timer.ElapsedSeconds());
+        }
+
+    private:
+        Phase(const Phase&) = delete;
+        void operator=(const Phase&) = delete;
+        const char* m_phase;
+        Timer m_timer;
+    };
+};
+} } }
@@ -742,11 +742,21 @@ static inline ImageLayoutKind ImageLayoutKindFrom(const wstring& s)
 struct ImageDimensions
 {
     size_t m_width, m_height, m_numChannels;
+    size_t m_depth; // 0 for images; for volumes (rank-4 tensors, CHW only: W x H x D x C) their depth
     // interpret TensorShape as image
     ImageDimensions(const TensorShape& shape, ImageLayoutKind imageLayoutKind)
+        : m_depth(0)
     {
+        if (shape.GetRank() == 4 && imageLayoutKind == ImageLayoutKind::CHW)
+        {
+            m_width = shape[0];
+            m_height = shape[1];
+            m_depth = shape[2];
+            m_numChannels = shape[3];
+            return;
+        }
         if (shape.GetRank() != 3)
-            InvalidArgument("Convolution operation currently only supports 1D or 2D convolution on 3D tensors.");
+            InvalidArgument("Convolution operation currently only supports 1D or 2D convolution on 3D tensors, and 3D convolution on 4D tensors in the cudnn (CHW) layout.");
         if (imageLayoutKind == ImageLayoutKind::CHW)
         {
             m_width = shape[0];
@@ -762,10 +772,14 @@ struct ImageDimensions
         else
             LogicError("WHC: Invalid ImageLayoutKind");
     }
-    ImageDimensions(size_t width, size_t height, size_t numChannels)
-        : m_width(width), m_height(height), m_numChannels(numChannels)
+    ImageDimensions(size_t width, size_t height, size_t numChannels, size_t depth = 0)
+        : m_width(width), m_height(height), m_numChannels(numChannels), m_depth(depth)
     {
     }
+    bool IsVolume() const
+    {
+        return m_depth > 0;
+    }
     // intepret image as TensorShape
     static TensorShape AsTensorShape(size_t width, size_t height, size_t numChannels, ImageLayoutKind imageLayoutKind /* = ImageLayoutKind::HWC*/)
     {
@@ -778,6 +792,12 @@ struct ImageDimensions
     }
     TensorShape AsTensorShape(ImageLayoutKind imageLayoutKind)
     {
+        if (IsVolume())
+        {
+            if (imageLayoutKind != ImageLayoutKind::CHW)
+                InvalidArgument("ImageLayout: Volumes are only supported in the cudnn (CHW) layout.");
+            return TensorShape(m_width, m_height, m_depth, m_numChannels);
+        }
         return AsTensorShape(m_width, m_height, m_numChannels, imageLayoutKind);
     }
 };
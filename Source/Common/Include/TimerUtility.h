@@ -33,4 +33,7 @@ private:
     long long m_start;
     long long m_end;
 };
+
+// CPU time (user + system) that all threads of this process have consumed so far, in seconds
+double ProcessCpuSeconds();
 } } }
@@ -0,0 +1,375 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Vocabulary.h -- the words of a language model with their counts and classes, indexed by a hash table
+//
+// The text form is the vocabulary file that the "writeWordAndClass" command writes and LMSequenceReader reads
+// ('wordclass'): one line "index count word class" per word, with the indices 0..V-1. A word is looked up in an
+// open-addressing hash table (linear probing, at most half full), i.e. with one hash and usually one string comparison.
+//
+// The binary form, '<vocabulary file>.bin', which "writeWordAndClass" writes next to the text, is the in-memory image of
+// all of it, the hash table included: loading it is mapping the file into memory, without parsing or building anything.
+// It is used instead of the text as long as it matches the text file's size and modification time.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class Vocabulary
+{
+public:
+    Vocabulary()
+        : m_numClasses(0), m_mappedData(nullptr), m_mappedSize(0)
+    {
+        Clear();
+    }
+
+    ~Vocabulary()
+    {
+        Clear();
+    }
+
+    // the text file's, or its binary form if that is up to date
+    void Load(const std::wstring& textPath)
+    {
+        if (!LoadBinary(BinaryPath(textPath), textPath))
+            LoadText(textPath);
+    }
+
+    void LoadText(const std::wstring& textPath)
+    {
+        Clear();
+        std::ifstream fin(msra::strfun::utf8(textPath).c_str());
+        if (!fin)
+            RuntimeError("Vocabulary: Cannot open the vocabulary file %ls.", textPath.c_str());
+        struct Entry
+        {
+            size_t index;
+            size_t count;
+            std::string word;
+            int wordClass;
+        };
+        std::vector<Entry> entries;
+        std::string line;
+        while (std::getline(fin, line))
+        {
+            auto tokens = msra::strfun::split(line, "\t \r");
+            if (tokens.empty())
+                continue;
+            if (tokens.size() != 4)
+                RuntimeError("Vocabulary: Lines of %ls must be 'index count word class': %s", textPath.c_str(), line.c_str());
+            Entry entry;
+            entry.index = (size_t) std::stoll(tokens[0]);
+            entry.count = (size_t) std::stod(tokens[1]);
+            entry.word = tokens[2];
+            entry.wordClass = std::stoi(tokens[3]);
+            entries.push_back(entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+                  {
+                      return a.index < b.index;
+                  });
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].index != i)
+                RuntimeError("Vocabulary: The word indices in %ls must be 0..%d, each once.", textPath.c_str(), (int) entries.size() - 1);
+            Add(entries[i].word, entries[i].count, entries[i].wordClass);
+        }
+    }
+
+    // append a word, with the next index; a word that is there already gets the new index
+    size_t Add(const std::string& word, size_t count = 0, int wordClass = 0)
+    {
+        if (m_mappedData)
+            LogicError("Vocabulary: A mapped vocabulary cannot be changed.");
+        size_t index = m_counts.size();
+        m_pool.insert(m_pool.end(), word.begin(), word.end());
+        m_offsets.push_back(m_pool.size());
+        m_counts.push_back(count);
+        m_classes.push_back(wordClass);
+        m_numClasses = std::max(m_numClasses, (size_t) wordClass + 1);
+        if (2 * (index + 1) > m_slots.size())
+            Rehash(std::max((size_t) 16, 2 * m_slots.size()));
+        else
+            Insert(index);
+        SetViews();
+        return index;
+    }
+
+    // the index of a word, or -1
+    int Find(const char* word, size_t length) const
+    {
+        if (m_numWords == 0)
+            return -1;
+        const size_t mask = m_numSlots - 1;
+        for (size_t slot = Hash(word, length) & mask;; slot = (slot + 1) & mask)
+        {
+            int index = m_slotView[slot];
+            if (index < 0)
+                return -1;
+            if (WordLength(index) == length && memcmp(WordData(index), word, length) == 0)
+                return index;
+        }
+    }
+    int Find(const std::string& word) const
+    {
+        return Find(word.data(), word.size());
+    }
+
+    size_t Size() const { return m_numWords; }
+    size_t NumClasses() const { return m_numClasses; }
+    std::string Word(size_t index) const { return std::string(WordData(index), WordLength(index)); }
+    size_t Count(size_t index) const { return (size_t) m_countView[index]; }
+    int Class(size_t index) const { return m_classView[index]; }
+
+    static std::wstring BinaryPath(const std::wstring& textPath)
+    {
+        return textPath + L".bin";
+    }
+
+    // write the binary form for 'textPath', stamped with its size and time, which must be final
+    void SaveBinary(const std::wstring& binaryPath, const std::wstring& textPath) const
+    {
+        Header header = MakeHeader(textPath);
+        std::wstring tempPath = binaryPath + L".tmp";
+        FILE* f = fopenOrDie(tempPath, L"wb");
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        fwriteOrDie(m_slotView, sizeof(int32_t), m_numSlots, f);
+        fwriteOrDie(m_offsetView, sizeof(uint64_t), m_numWords + 1, f);
+        fwriteOrDie(m_countView, sizeof(uint64_t), m_numWords, f);
+        fwriteOrDie(m_classView, sizeof(int32_t), m_numWords, f);
+        const int32_t padding = 0;
+        if (m_numWords % 2)
+            fwriteOrDie(&padding, sizeof(int32_t), 1, f);
+        fwriteOrDie(m_poolView, 1, (size_t) m_offsetView[m_numWords], f);
+        fcloseOrDie(f);
+        renameOrDie(tempPath, binaryPath); // (readers never see a partial file)
+    }
+
+    // map the binary form, if there is one for the current 'textPath'
+    bool LoadBinary(const std::wstring& binaryPath, const std::wstring& textPath)
+    {
+        Clear();
+        if (!fexists(binaryPath) || !Map(binaryPath))
+            return false;
+        Header expected = MakeHeader(textPath);
+        const Header& header = *(const Header*) m_mappedData;
+        if (m_mappedSize < sizeof(Header) || memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+            header.textSize != expected.textSize || header.textTime != expected.textTime)
+        {
+            Clear();
+            return false;
+        }
+        m_numWords = (size_t) header.numWords;
+        m_numSlots = (size_t) header.numSlots;
+        m_numClasses = (size_t) header.numClasses;
+        const char* p = m_mappedData + sizeof(Header);
+        m_slotView = (const int32_t*) p;
+        p += m_numSlots * sizeof(int32_t);
+        m_offsetView = (const uint64_t*) p;
+        p += (m_numWords + 1) * sizeof(uint64_t);
+        m_countView = (const uint64_t*) p;
+        p += m_numWords * sizeof(uint64_t);
+        m_classView = (const int32_t*) p;
+        p += (m_numWords + m_numWords % 2) * sizeof(int32_t);
+        m_poolView = p;
+        if (p > m_mappedData + m_mappedSize || (size_t) (m_mappedData + m_mappedSize - p) < m_offsetView[m_numWords])
+        {
+            Clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Vocabulary(const Vocabulary&);
+    Vocabulary& operator=(const Vocabulary&);
+
+    struct Header
+    {
+        char magic[8];
+        uint64_t numWords;
+        uint64_t numSlots;
+        uint64_t numClasses;
+        uint64_t textSize; // of the text form it was made from
+        uint64_t textTime;
+    };
+
+    Header MakeHeader(const std::wstring& textPath) const
+    {
+        Header header;
+        memcpy(header.magic, "CNTKVOC1", sizeof(header.magic));
+        header.numWords = m_numWords;
+        header.numSlots = m_numSlots;
+        header.numClasses = m_numClasses;
+        header.textSize = fexists(textPath) ? (uint64_t) filesize64(textPath.c_str()) : 0;
+        header.textTime = ModificationTime(textPath);
+        return header;
+    }
+
+    // 0 if there is no such file
+    static uint64_t ModificationTime(const std::wstring& path)
+    {
+#ifdef _WIN32
+        FILETIME time;
+        if (!getfiletime(path, time))
+            return 0;
+        return ((uint64_t) time.dwHighDateTime << 32) | time.dwLowDateTime;
+#else
+        struct stat st;
+        if (stat(msra::strfun::utf8(path).c_str(), &st) != 0)
+            return 0;
+        return (uint64_t) st.st_mtime;
+#endif
+    }
+
+    // FNV-1a
+    static size_t Hash(const char* word, size_t length)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+            h = (h ^ (unsigned char) word[i]) * 1099511628211ull;
+        return (size_t) h;
+    }
+
+    // word i is [offsets[i], offsets[i + 1]) in the pool
+    const char* WordData(size_t index) const { return m_poolView + m_offsetView[index]; }
+    size_t WordLength(size_t index) const { return (size_t) (m_offsetView[index + 1] - m_offsetView[index]); }
+
+    void Insert(size_t index)
+    {
+        const size_t mask = m_slots.size() - 1;
+        size_t begin = (size_t) m_offsets[index], length = (size_t) (m_offsets[index + 1] - begin);
+        const char* word = m_pool.data() + begin;
+        for (size_t slot = Hash(word, length) & mask;; slot = (slot + 1) & mask)
+        {
+            int32_t other = m_slots[slot];
+            if (other < 0 || (m_offsets[other + 1] - m_offsets[other] == length && memcmp(m_pool.data() + m_offsets[other], word, length) == 0))
+            {
+                m_slots[slot] = (int32_t) index;
+                return;
+            }
+        }
+    }
+
+    void Rehash(size_t numSlots)
+    {
+        m_slots.assign(numSlots, -1);
+        for (size_t index = 0; index < m_counts.size(); index++)
+            Insert(index);
+    }
+
+    void SetViews()
+    {
+        m_numWords = m_counts.size();
+        m_numSlots = m_slots.size();
+        m_slotView = m_slots.data();
+        m_offsetView = m_offsets.data();
+        m_countView = m_counts.data();
+        m_classView = m_classes.data();
+        m_poolView = m_pool.data();
+    }
+
+    void Clear()
+    {
+        Unmap();
+        m_slots.clear();
+        m_offsets.assign(1, 0);
+        m_counts.clear();
+        m_classes.clear();
+        m_pool.clear();
+        m_numClasses = 0;
+        SetViews();
+    }
+
+    bool Map(const std::wstring& path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_mappedSize = (size_t) size.QuadPart;
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        m_mappedData = m_mapping ? (const char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!m_mappedData)
+        {
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            return false;
+        }
+#else
+        int fd = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        fstat(fd, &st);
+        m_mappedSize = (size_t) st.st_size;
+        void* data = m_mappedSize > 0 ? mmap(nullptr, m_mappedSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd); // the mapping stays valid
+        if (data == MAP_FAILED)
+            return false;
+        m_mappedData = (const char*) data;
+#endif
+        return true;
+    }
+
+    void Unmap()
+    {
+        if (!m_mappedData)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_mappedData);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap((void*) m_mappedData, m_mappedSize);
+#endif
+        m_mappedData = nullptr;
+        m_mappedSize = 0;
+    }
+
+    // what is built in memory
+    std::vector<int32_t> m_slots; // word index per slot, -1 if empty; a power of 2 in size
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint64_t> m_counts;
+    std::vector<int32_t> m_classes;
+    std::vector<char> m_pool; // all words, without separators
+    size_t m_numClasses;
+
+    // the arrays used for lookups, either the ones above or in the mapped file
+    size_t m_numWords;
+    size_t m_numSlots;
+    const int32_t* m_slotView;
+    const uint64_t* m_offsetView;
+    const uint64_t* m_countView;
+    const int32_t* m_classView;
+    const char* m_poolView;
+
+    const char* m_mappedData;
+    size_t m_mappedSize;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+};
+} } }
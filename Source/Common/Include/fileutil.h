@@ -41,6 +41,14 @@
 FILE* fopenOrDie(const std::string& pathname, const char* mode);
 FILE* fopenOrDie(const std::wstring& pathname, const wchar_t* mode);
 
+// ----------------------------------------------------------------------------
+// fsetsequentialbuffersize(): buffer size for files opened with 'S' (optimized
+// for sequential access), default 10 MB; applies to files opened afterwards
+// ----------------------------------------------------------------------------
+
+void fsetsequentialbuffersize(size_t bytes);
+size_t fgetsequentialbuffersize();
+
 #ifndef __unix__
 // ----------------------------------------------------------------------------
 // fsetmode(): set mode to binary or text
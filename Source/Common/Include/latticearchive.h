@@ -22,8 +22,11 @@
 #include <string>
 #include <unordered_map>
 #include <algorithm> // for find()
+#include <future>
+#include <thread>
 #include "simplesenonehmm.h"
 #include "Matrix.h"
+#include "TaskPool.h"
 
 namespace msra { namespace math {
 
@@ -965,8 +968,9 @@ public:
     // If this fails, the lattice is in unusable state, but it is OK to call fread() again to regain a usable object. I.e. this is safe to be used in retry loops.
     // This will also map the aligninfo entries to the new symbol table, through idmap.
     // V1 lattices will be converted. 'spsenoneid' is used in that process.
+    // With 'keepcompact', V2 lattices are left in their uniqued form, which takes much less memory; use expandfrom() to get a usable lattice.
     template <class IDMAP>
-    void fread(FILE* f, const IDMAP& idmap, size_t spunit)
+    void fread(FILE* f, const IDMAP& idmap, size_t spunit, bool keepcompact = false)
     {
         size_t version = freadtag(f, "LAT ");
         if (version == 1)
@@ -1058,12 +1062,33 @@ public:
                 // RuntimeError("fread: mismatching /sp/ units");
             }
             // reconstruct old lattice format from this   --TODO: remove once we change to new data representation
-            rebuildedges(info.impliedspunitid != spunit /*to be able to read somewhat broken V2 lattice archives*/);
+            if (!keepcompact)
+                rebuildedges(info.impliedspunitid != spunit /*to be able to read somewhat broken V2 lattice archives*/);
+            else
+            {
+                edges.clear();
+                align.clear();
+            }
         }
         else
             RuntimeError("fread: unsupported lattice format version");
     }
 
+    // replace this lattice by the expanded version of one read by fread() with 'keepcompact' (which is not modified)
+    void expandfrom(const lattice& compact, size_t spunit)
+    {
+        *this = compact;
+        if (!edges2.empty()) // V2 lattice in uniqued form
+            rebuildedges(info.impliedspunitid != spunit);
+    }
+
+    // approximate memory used by this lattice
+    size_t sizeinbytes() const
+    {
+        return sizeof(*this) + nodes.size() * sizeof(nodes[0]) + edges.size() * sizeof(edges[0]) + align.size() * sizeof(align[0]) +
+               edges2.size() * sizeof(edges2[0]) + uniquededgedatatokens.size() * sizeof(uniquededgedatatokens[0]);
+    }
+
     // parallel versions (defined in parallelforwardbackward.cpp)
     class parallelstate
     {
@@ -1234,12 +1259,24 @@ public:
         if (tocpaths.empty()) // nothing to read--keep silent
             return;
         fprintf(stderr, "archive: opening %d lattice-archive TOC files ('%S' etc.)..", (int) tocpaths.size(), tocpaths[0].c_str());
+        // Reading and parsing the TOC files is most of the startup time with many of them, so they are parsed in
+        // parallel on the TaskPool; the results are merged in order, as open() would.
+        std::vector<std::vector<tocentry>> entries(tocpaths.size());
+        Microsoft::MSR::CNTK::TaskPool::ParallelFor(0, tocpaths.size(), [this, &tocpaths, &entries](size_t i)
+                                                    {
+                                                        parsetoc(tocpaths[i], entries[i]);
+                                                    }); // (rethrows parse errors)
+        size_t numentries = 0;
+        for (const auto& tocentries : entries)
+            numentries += tocentries.size();
+        toc.reserve(numentries);
         size_t onepercentage = tocpaths.size() / 100 ? tocpaths.size() / 100 : 1;
         foreach_index (i, tocpaths)
         {
             if ((i % onepercentage) == 0)
                 fprintf(stderr, ".");
-            open(tocpaths[i]);
+            addtoc(entries[i]);
+            std::vector<tocentry>().swap(entries[i]); // (free the memory as we go)
         }
         fprintf(stderr, " %d total lattices referenced in %d archive files\n", (int) toc.size(), (int) archivepaths.size());
     }
@@ -1248,6 +1285,23 @@ public:
     // Can be called for multiple archives.
     // BUGBUG: NOT YET. We only really support one archive file at this point. Important to do that though.
     void open(const std::wstring& tocpath)
+    {
+        std::vector<tocentry> entries;
+        parsetoc(tocpath, entries);
+        addtoc(entries);
+    }
+
+private:
+    // one TOC line, parsed; an empty archivepath means the same archive as the line before
+    struct tocentry
+    {
+        std::wstring key;
+        std::wstring archivepath;
+        uint64_t offset;
+    };
+
+    // read and parse a TOC file; does not touch the object's state, so that several can be parsed concurrently
+    void parsetoc(const std::wstring& tocpath, std::vector<tocentry>& entries) const
     {
         // BUGBUG: we only really support one archive file at this point
         // read the TOC in one swoop
@@ -1255,14 +1309,16 @@ public:
         auto toclines = msra::files::fgetfilelines(tocpath, textbuffer);
 
         // parse it one by one
-        size_t archiveindex = SIZE_MAX; // its index
+        entries.resize(toclines.size());
+        bool havearchive = false;
         foreach_index (i, toclines)
         {
             const char* line = toclines[i];
             const char* p = strchr(line, '=');
             if (p == NULL)
                 RuntimeError("open: invalid TOC line (no = sign): %s", line);
-            const std::wstring key = msra::strfun::utf16(std::string(line, p - line));
+            tocentry& entry = entries[i];
+            entry.key = msra::strfun::utf16(std::string(line, p - line));
             p++;
             const char* q = strchr(p, '[');
             if (q == NULL)
@@ -1275,9 +1331,10 @@ public:
                     archivepath = prefixPathInToc + L"/" + archivepath;
                 }
                 // TODO: should we allow paths relative to TOC file?
-                archiveindex = getarchiveindex(archivepath);
+                entry.archivepath = archivepath;
+                havearchive = true;
             }
-            if (archiveindex == SIZE_MAX)
+            if (!havearchive)
                 RuntimeError("open: invalid TOC line (empty archive pathname): %s", line);
             char c;
             uint64_t offset;
@@ -1288,14 +1345,27 @@ public:
             if (sscanf(q, "[%" PRIu64 "]%c", &offset, &c) != 1)
 #endif
                 RuntimeError("open: invalid TOC line (bad [] expression): %s", line);
-            if (!toc.insert(make_pair(key, latticeref(offset, archiveindex))).second)
-                RuntimeError("open: TOC entry leads to duplicate key: %s", line);
+            entry.offset = offset;
+        }
+    }
+
+    // add the parsed entries of a TOC file to the table of content
+    void addtoc(const std::vector<tocentry>& entries)
+    {
+        size_t archiveindex = SIZE_MAX; // its index
+        for (const auto& entry : entries)
+        {
+            if (!entry.archivepath.empty())
+                archiveindex = getarchiveindex(entry.archivepath);
+            if (!toc.insert(make_pair(entry.key, latticeref(entry.offset, archiveindex))).second)
+                RuntimeError("open: TOC entry leads to duplicate key: %ls", entry.key.c_str());
         }
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
     }
 
+public:
     // check if a lattice for a given key is available  --do this during initial check ideally
     bool haslattice(const std::wstring& key) const
     {
@@ -1319,8 +1389,9 @@ public:
     // 'key' is supposed to be known to exist. Use haslattice() to ensure. This is because this function is called from a retry loop.
     // Lattices will have unit ids updated according to the modelsymmap.
     // V1 lattices will be converted. 'spsenoneid' is used in the conversion for optimizing storing 0-frame /sp/ aligns.
+    // With 'keepcompact', V2 lattices are returned in their uniqued form, see lattice::fread(); use expandlattice() on them.
     void getlattice(const std::wstring& key, lattice& L,
-                    size_t expectedframes = SIZE_MAX /*if unknown*/) const
+                    size_t expectedframes = SIZE_MAX /*if unknown*/, bool keepcompact = false) const
     {
         auto iter = toc.find(key);
         if (iter == toc.end())
@@ -1347,7 +1418,10 @@ public:
             // seek to start
             fsetpos(f, offset);
             // get it
-            L.fread(f, idmap, spunit);
+#ifdef HACK_IN_SILENCE
+            keepcompact = false; // the hack below works on the expanded form
+#endif
+            L.fread(f, idmap, spunit, keepcompact);
             L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
             const size_t silunit = getid(modelsymmap, "sil");
@@ -1368,6 +1442,12 @@ public:
         L.key = key;
     };
 
+    // expand a lattice obtained from getlattice() with 'keepcompact' into 'L'
+    void expandlattice(const lattice& compact, lattice& L) const
+    {
+        L.expandfrom(compact, getid(modelsymmap, "sp"));
+    }
+
     // static method for building an archive
     static void build(const std::vector<std::wstring>& infiles, const std::wstring& outpath,
                       const std::unordered_map<std::string, size_t>& modelsymmap,
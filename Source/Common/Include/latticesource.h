@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "latticearchive.h"
 
 namespace msra { namespace dbn {
@@ -37,11 +39,45 @@ class latticesource
     const msra::lattices::archive numlattices, denlattices;
     int verbosity;
 
+    // lattices read so far, in compact form, so that later epochs do not need to read and parse the archives again
+    mutable std::mutex cachemutex;
+    mutable std::unordered_map<std::wstring, std::shared_ptr<const msra::lattices::lattice>> cache; // [key] -> lattice as from getlattice() with keepcompact
+    size_t cachecapacity;                                                                          // in bytes; 0 means no caching
+    mutable size_t cachesize;
+
+    std::shared_ptr<const msra::lattices::lattice> getcompactlattice(const std::wstring& key, size_t expectedframes) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(cachemutex);
+            auto iter = cache.find(key);
+            if (iter != cache.end())
+            {
+                if (expectedframes != SIZE_MAX && iter->second->getnumframes() != expectedframes)
+                    LogicError("getlattices: number of frames mismatch between lattice and features");
+                return iter->second;
+            }
+        }
+        auto compact = std::make_shared<msra::lattices::lattice>();
+        denlattices.getlattice(key, *compact, expectedframes, true /*keepcompact*/);
+        // keep it if it fits; once the cache is full, it keeps the lattices it has, since utterances are visited in random order
+        std::lock_guard<std::mutex> lock(cachemutex);
+        const size_t bytes = compact->sizeinbytes();
+        if (cachesize + bytes <= cachecapacity && cache.insert(std::make_pair(key, compact)).second)
+            cachesize += bytes;
+        return compact;
+    }
+
 public:
     typedef msra::dbn::latticepair latticepair;
     latticesource(std::pair<std::vector<std::wstring>, std::vector<std::wstring>> latticetocs, const std::unordered_map<std::string, size_t>& modelsymmap, std::wstring RootPathInToc)
-        : numlattices(latticetocs.first, modelsymmap, RootPathInToc), denlattices(latticetocs.second, modelsymmap, RootPathInToc), verbosity(0)
+        : numlattices(latticetocs.first, modelsymmap, RootPathInToc), denlattices(latticetocs.second, modelsymmap, RootPathInToc), verbosity(0), cachecapacity(0), cachesize(0)
+    {
+    }
+
+    // keep up to this many bytes of lattices in memory across epochs (0 to disable)
+    void setcachecapacity(size_t bytes)
     {
+        cachecapacity = bytes;
     }
 
     bool empty() const
@@ -65,7 +101,10 @@ public:
     void getlattices(const std::wstring& key, std::shared_ptr<const latticepair>& L, size_t expectedframes) const
     {
         std::shared_ptr<latticepair> LP(new latticepair);
-        denlattices.getlattice(key, LP->second, expectedframes); // this loads the lattice from disk, using the existing L.second object
+        if (cachecapacity == 0)
+            denlattices.getlattice(key, LP->second, expectedframes); // this loads the lattice from disk, using the existing L.second object
+        else
+            denlattices.expandlattice(*getcompactlattice(key, expectedframes), LP->second);
         L = LP;
     }
 
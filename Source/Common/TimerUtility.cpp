@@ -7,6 +7,7 @@ static LARGE_INTEGER s_ticksPerSecond;
 static BOOL s_setFreq = QueryPerformanceFrequency(&s_ticksPerSecond);
 #else
 #include <time.h>
+#include <sys/resource.h>
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -69,4 +70,24 @@ long long Timer::ElapsedMicroseconds()
     return diff / MICRO_PER_NANO;
 #endif
 }
+
+double ProcessCpuSeconds()
+{
+#ifdef WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime; // (in units of 100 ns)
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) / 1e7;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / (double) MICRO_PER_SEC;
+#endif
+}
 } } }
@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <glob.h>
+#include <fcntl.h> // for posix_fadvise()
 #endif
 #include <stdio.h>
 #include <string.h>
@@ -229,6 +230,29 @@ FILE* fopenStdHandle(const _T* mode)
     return f;
 }
 
+// files opened for sequential access ('S') get a large buffer, and the OS is told to read ahead aggressively
+// (On Windows, 'S' itself makes the CRT open the file with FILE_FLAG_SEQUENTIAL_SCAN.)
+static size_t sequentialBufferSize = 10000000;
+
+void fsetsequentialbuffersize(size_t bytes)
+{
+    sequentialBufferSize = bytes;
+}
+
+size_t fgetsequentialbuffersize()
+{
+    return sequentialBufferSize;
+}
+
+static void fsetsequential(FILE* f)
+{
+    setvbuf(f, NULL, _IOFBF, sequentialBufferSize); // OK if it fails
+#ifdef __unix__
+    if (f != stdin && f != stdout)
+        posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL); // (a hint; OK if it fails, e.g. on a pipe)
+#endif
+}
+
 FILE* fopenOrDie(const string& pathname, const char* mode)
 {
     FILE* f = (pathname[0] == '-') ? fopenStdHandle(mode) : fopen(pathname.c_str(), mode);
@@ -236,10 +260,8 @@ FILE* fopenOrDie(const string& pathname, const char* mode)
     {
         RuntimeError("error opening file '%s': %s", pathname.c_str(), strerror(errno));
     }
-    if (strchr(mode, 'S'))
-    {                                       // if optimized for sequential access then use large buffer
-        setvbuf(f, NULL, _IOFBF, 10000000); // OK if it fails
-    }
+    if (strchr(mode, 'S')) // optimized for sequential access
+        fsetsequential(f);
     return f;
 }
 
@@ -250,10 +272,8 @@ FILE* fopenOrDie(const wstring& pathname, const wchar_t* mode)
     {
         RuntimeError("error opening file '%ls': %s", pathname.c_str(), strerror(errno));
     }
-    if (strchr(mode, 'S'))
-    {                                       // if optimized for sequential access then use large buffer
-        setvbuf(f, NULL, _IOFBF, 10000000); // OK if it fails
-    }
+    if (strchr(mode, 'S')) // optimized for sequential access
+        fsetsequential(f);
     return f;
 }
 
@@ -1813,7 +1833,13 @@ void expand_wildcards(const wstring& path, vector<wstring>& paths)
 #else
     // On Linux we have just the function for the job: glob
     glob_t globResult;
-    if (glob(wtocharpath(path.c_str()).c_str(), GLOB_TILDE, NULL, &globResult) != 0)
+    int rc = glob(wtocharpath(path.c_str()).c_str(), GLOB_TILDE, NULL, &globResult);
+    if (rc == GLOB_NOMATCH) // no matching file: empty, as on Windows
+    {
+        globfree(&globResult);
+        return;
+    }
+    if (rc != 0)
     {
         RuntimeError("error in expanding wild cards '%ls': %s", path.c_str(), strerror(errno));
     }
@@ -23,6 +23,17 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -33,15 +44,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+MatrixPool::PoolPerType<float>& MatrixPool::GetPool<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatPool;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+MatrixPool::PoolPerType<double>& MatrixPool::GetPool<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doublePool;
 }
 
 // -----------------------------------------------------------------------
@@ -82,7 +93,7 @@ void ComputationNetwork::SaveEdited(const wstring& fileName, const FileOptions f
     Save(fileName, fileFormat);
 }
 
-void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat, ParameterStorage parameterStorage) const
 {
     VerifyIsCompiled("Save");
     // In case of parallel training only the main node should we saving the model to prevent
@@ -93,13 +104,13 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
         // Saving into temporary file and then renaming it to the requested fileName
         // This is a standard trick to avoid havign corrupted model files if process dies during writing
         wstring tmpFileName = fileName + L".tmp";
-        SaveToFileImpl(tmpFileName, fileFormat);
+        SaveToFileImpl(tmpFileName, fileFormat, parameterStorage);
         renameOrDie(tmpFileName, fileName);
     }
 }
 
 // TODO: how does the file distinguish float vs double nodes?
-void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat, ParameterStorage parameterStorage) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
@@ -116,7 +127,11 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr nodePtr = nodeIter->second;
-        nodePtr->Save(fstream);
+        auto compactNode = dynamic_pointer_cast<ICompactlySaveableNode>(nodePtr);
+        if (compactNode && parameterStorage != ParameterStorage::full)
+            compactNode->Save(fstream, parameterStorage);
+        else
+            nodePtr->Save(fstream);
     }
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
@@ -238,7 +253,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
 {
     ClearNetwork();
 
-    File fstream(fileName, fileFormat | FileOptions::fileOptionsRead);
+    File fstream(fileName, fileFormat | FileOptions::fileOptionsRead | FileOptions::fileOptionsSequential);
 
     ReadPersistableParameters<ElemType>(fstream, true);
 
@@ -385,6 +400,7 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(SequenceWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(CrossEntropyWithSampledSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(ErrorPredictionNode) ||
 #ifdef COMING_SOON
         nodePtr->OperationName() == OperationNameOf(CRFNode) ||
@@ -493,6 +509,14 @@ template <class ElemType>
     }
 }
 
+// sampled-softmax criteria sample only while training, and otherwise compute the full softmax
+template <class ElemType>
+/*static*/ void ComputationNetwork::SetSampledSoftmaxTraining(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool training)
+{
+    for (const auto& node : net->GetNodesWithType(OperationNameOf(CrossEntropyWithSampledSoftmaxNode), criterionNode))
+        dynamic_pointer_cast<CrossEntropyWithSampledSoftmaxNode<ElemType>>(node)->SetTraining(training);
+}
+
 //set sequence training parameters, e.g. smoothing weight, frame drop threshhold
 template <class ElemType>
 void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
@@ -864,16 +888,166 @@ void ComputationNodeBase::EnumerateArcs(std::unordered_set<ComputationNodeBasePt
 
 // TODO: Lift this into config language, move underlying code to math lib. This should be a model-editing operation.
 
+// factor A [m x n] as redU [m x r] * redVT [r x n] by truncated SVD, with the square roots of the singular values going to both factors
+// r is 'rank' if not 0, else the smallest rank whose singular values sum to more than 'keepRatio' of their total; then rounded up
+// to a multiple of 'alignedSize' (but at most min(m,n)). The factors are computed on the CPU and returned on A's device.
+template <class ElemType>
+static size_t LowRankFactors(const Matrix<ElemType>& A, size_t rank, float keepRatio, size_t alignedSize, Matrix<ElemType>& redU, Matrix<ElemType>& redVT)
+{
+    size_t m = A.GetNumRows();
+    size_t n = A.GetNumCols();
+
+    Matrix<ElemType> S(CPUDEVICE), U(CPUDEVICE), VT(CPUDEVICE), W(CPUDEVICE);
+    Matrix<ElemType>::SVD(Matrix<ElemType>(A, CPUDEVICE), S, U, VT, W);
+
+    // A \in R^{mXn}
+    // U \in R^{mXm}
+    // VT \in R^{nXn}
+    // S \in R^{min(m,n),1}
+    // S is in descending order
+
+    size_t r = S.GetNumRows();
+    if (rank > 0)
+        r = min(rank, r);
+    else
+    {
+        ElemType totalenergy = 0.0f;
+        for (size_t i = 0; i < S.GetNumRows(); i++)
+            totalenergy += S(i, 0);
+        ElemType keepenergy = totalenergy * keepRatio;
+        ElemType runenergy = 0.0f;
+        for (size_t indx = 0; indx < S.GetNumRows(); indx++)
+        {
+            runenergy += S(indx, 0);
+            if (runenergy > keepenergy)
+            {
+                r = indx + 1;
+                break;
+            }
+        }
+    }
+
+    if (alignedSize > 0 && r % alignedSize != 0)
+    {
+        r -= r % alignedSize;
+        r = r + alignedSize > S.GetNumRows() ? S.GetNumRows() : r + alignedSize;
+    }
+    // r = (r + 7) & (~7); //  to keep the number of rows/cols of resultant matrix a multipier of 8
+    //  which can be helpful at runtime
+
+    // redU in R^ {mXr}
+    redU = U.ColumnSlice(0, r);
+
+    // redVT in R^{rXn}
+    redVT.Resize(r, n);
+    redVT.AssignRowSliceValuesOf(VT, 0, r);
+
+    Matrix<ElemType> redS(r, (size_t) 1, CPUDEVICE);
+    for (size_t i = 0; i < r; i++)
+    {
+        ElemType sqrtsigma = (ElemType) sqrt((double) S(i, 0));
+        redS(i, 0) = sqrtsigma;
+    }
+
+    redU.RowElementMultiplyWith(redS.Transpose());
+    redVT.ColumnElementMultiplyWith(redS);
+
+    redU.TransferToDeviceIfNotThere(A.GetDeviceId(), true);
+    redVT.TransferToDeviceIfNotThere(A.GetDeviceId(), true);
+    return r;
+}
+
+// orthonormalize the columns of Y [m x l] in place, as Y (Y^T Y)^(-1/2); only the small Gram matrix is decomposed on the CPU
+template <class ElemType>
+static void OrthonormalizeColumns(Matrix<ElemType>& Y)
+{
+    Matrix<ElemType> G(Y.GetDeviceId());
+    Matrix<ElemType>::Multiply(Y, true, Y, false, G);
+    Matrix<ElemType> S(CPUDEVICE), U(CPUDEVICE), VT(CPUDEVICE), W(CPUDEVICE);
+    Matrix<ElemType>::SVD(Matrix<ElemType>(G, CPUDEVICE), S, U, VT, W); // G = U S U^T
+    double minEigenvalue = S(0, 0) * 1e-12;
+    for (size_t i = 0; i < S.GetNumRows(); i++) // (directions Y does not span are dropped)
+        S(i, 0) = S(i, 0) > minEigenvalue ? (ElemType) (1 / sqrt((double) S(i, 0))) : 0;
+    U.RowElementMultiplyWith(S.Transpose());
+    U.TransferToDeviceIfNotThere(Y.GetDeviceId(), true);
+    Matrix<ElemType> Q(Y.GetDeviceId());
+    Matrix<ElemType>::Multiply(Y, U, Q);
+    Y.SetValue(Q);
+}
+
+// like LowRankFactors() with a given rank, but by randomized SVD (Halko, Martinsson & Tropp): the range of A is sampled as
+// A * Omega with a few more Gaussian columns than the rank, refined by power iterations, and only the small projection of A
+// onto it is decomposed on the CPU. The products run on A's device, so for large A on a GPU, this is much faster than a
+// full SVD, and accurate for the top singular values, which is all that is kept.
+template <class ElemType>
+static size_t RandomizedLowRankFactors(const Matrix<ElemType>& A, size_t rank, size_t alignedSize, size_t numPowerIterations, Matrix<ElemType>& redU, Matrix<ElemType>& redVT)
+{
+    const size_t oversampling = 10;
+    size_t m = A.GetNumRows();
+    size_t n = A.GetNumCols();
+    size_t r = max(min(rank, min(m, n)), (size_t) 1);
+    if (alignedSize > 0 && r % alignedSize != 0)
+    {
+        r -= r % alignedSize;
+        r = r + alignedSize > min(m, n) ? min(m, n) : r + alignedSize;
+    }
+    size_t l = min(r + oversampling, min(m, n));
+    DEVICEID_TYPE deviceId = A.GetDeviceId();
+
+    // Q [m x l]: orthonormal basis of the sampled range of A
+    Matrix<ElemType> omega = Matrix<ElemType>::RandomGaussian(n, l, (ElemType) 0, (ElemType) 1, /*seed=*/1, deviceId);
+    Matrix<ElemType> Q(deviceId), Z(deviceId);
+    Matrix<ElemType>::Multiply(A, omega, Q);
+    OrthonormalizeColumns(Q);
+    for (size_t i = 0; i < numPowerIterations; i++)
+    {
+        Matrix<ElemType>::Multiply(A, true, Q, false, Z); // [n x l]
+        OrthonormalizeColumns(Z);
+        Matrix<ElemType>::Multiply(A, Z, Q);
+        OrthonormalizeColumns(Q);
+    }
+
+    // B = Q^T A [l x n] = Ub S V^T, from B B^T = Ub S^2 Ub^T; then A ~ (Q Ub S^(1/2)) (S^(-1/2) Ub^T B)
+    Matrix<ElemType> B(deviceId), C(deviceId);
+    Matrix<ElemType>::Multiply(Q, true, A, false, B);
+    Matrix<ElemType>::Multiply(B, false, B, true, C);
+    Matrix<ElemType> S(CPUDEVICE), Ub(CPUDEVICE), VT(CPUDEVICE), W(CPUDEVICE);
+    Matrix<ElemType>::SVD(Matrix<ElemType>(C, CPUDEVICE), S, Ub, VT, W);
+    r = min(r, l);
+
+    Matrix<ElemType> redUb(CPUDEVICE), sqrtS(r, (size_t) 1, CPUDEVICE), invSqrtS(r, (size_t) 1, CPUDEVICE);
+    redUb = Ub.ColumnSlice(0, r);
+    for (size_t i = 0; i < r; i++)
+    {
+        double sqrtSigma = sqrt(sqrt(max((double) S(i, 0), 0.0)));
+        sqrtS(i, 0) = (ElemType) sqrtSigma;
+        invSqrtS(i, 0) = sqrtSigma > 0 ? (ElemType) (1 / sqrtSigma) : 0;
+    }
+    Matrix<ElemType> sqrtSRow = sqrtS.Transpose();
+    redUb.TransferToDeviceIfNotThere(deviceId, true);
+    sqrtSRow.TransferToDeviceIfNotThere(deviceId, true);
+    invSqrtS.TransferToDeviceIfNotThere(deviceId, true);
+
+    Matrix<ElemType>::Multiply(Q, redUb, redU);
+    redU.RowElementMultiplyWith(sqrtSRow);
+    Matrix<ElemType>::Multiply(redUb, true, B, false, redVT);
+    redVT.ColumnElementMultiplyWith(invSqrtS);
+    return r;
+}
+
 // ========================================
 // This function performs SVD decomposition for different groups of learnable  parameters
 // we perform SVD decomposition such that
 //  A \approx B*C, where rank(B)=rank(C)=r < rank(A)
 // After SVD decomposition, the node A will become an intermediate node whose children are B,C ;
 // B and C are two learnable parameters
+// With 'randomized', the factors are computed by randomized SVD on the network's device, and the KeepRatio is the
+// fraction of min(m,n) singular values kept (the energy of all of them is exactly what a randomized SVD does not compute).
+// The parameters of a group are decomposed concurrently if on the CPU.
 // ========================================
 // BUGBUG: this only currently works for one ElemType, not both
 template <class ElemType>
-void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize)
+void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize, bool randomized, size_t numPowerIterations)
 {
     vector<pair<vector<wstring>, float>> nodeGroups;
     wregex NameFilter;
@@ -920,6 +1094,7 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
         fprintf(stderr,
                 "--------------------------------------------------------------------------------------------\n");
 
+        vector<wstring> names;
         for (const auto& name : group.first)
         {
             if (m_nameToNodeMap.find(name) == m_nameToNodeMap.end())
@@ -927,81 +1102,65 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
                 // could be deleted in the previous groups
                 continue;
             }
+            names.push_back(name);
+        }
 
-            shared_ptr<ComputationNode<ElemType>> pNode = dynamic_pointer_cast<LearnableParameter<ElemType>>(m_nameToNodeMap[name]);
-
-            // Step 1. do SVD decomposition
-            Matrix<ElemType> A = pNode->ValueAsMatrix();
-
-            // it is a vector, no need to do it
-            if (A.GetNumCols() == 1 || A.GetNumRows() == 1)
-                continue;
-
-            size_t m = A.GetNumRows();
-            size_t n = A.GetNumCols();
-
-            Matrix<ElemType> S(-1), U(-1), VT(-1), W(-1);
-            chrono::time_point<chrono::system_clock> stTime = chrono::system_clock::now();
-            Matrix<ElemType>::SVD(A, S, U, VT, W);
-            chrono::time_point<chrono::system_clock> enTime = chrono::system_clock::now();
-
-            // A \in R^{mXn}
-            // U \in R^{mXm}
-            // VT \in R^{nXn}
-            // S \in R^{min(m,n),1}
-            // S is in descending order
-
-            ElemType totalenergy = 0.0f;
-            for (size_t i = 0; i < S.GetNumRows(); i++)
-                totalenergy += S(i, 0);
-            ElemType keepenergy = totalenergy * keepratio;
-            ElemType runenergy = 0.0f;
-
-            size_t r = 0;
-            for (size_t indx = 0; indx < S.GetNumRows(); indx++)
-            {
-                runenergy += S(indx, 0);
-                if (runenergy > keepenergy)
-                {
-                    r = indx + 1;
-                    break;
-                }
-            }
-
-            r = r > S.GetNumRows() ? S.GetNumRows() : r;
-
-            if (r % AlignedSize != 0)
+        // Step 1. do SVD decomposition, of all parameters of the group at once
+        vector<shared_ptr<Matrix<ElemType>>> redUs(names.size()), redVTs(names.size());
+        vector<size_t> ranks(names.size(), 0);
+        // exceptions must not leave an OpenMP region, so we pass the first one on after the loop
+        std::exception_ptr firstException;
+#pragma omp parallel for schedule(dynamic, 1) if (names.size() > 1 && m_deviceId < 0)
+        for (int i = 0; i < (int) names.size(); i++)
+        {
+            try
             {
-                r -= r % AlignedSize;
-                r = r + AlignedSize > S.GetNumRows() ? S.GetNumRows() : r + AlignedSize;
+                const Matrix<ElemType>& A = dynamic_pointer_cast<LearnableParameter<ElemType>>(m_nameToNodeMap.find(names[i])->second)->ValueAsMatrix();
+
+                // it is a vector, no need to do it
+                if (A.GetNumCols() == 1 || A.GetNumRows() == 1)
+                    continue;
+
+                size_t m = A.GetNumRows();
+                size_t n = A.GetNumCols();
+
+                redUs[i] = make_shared<Matrix<ElemType>>(A.GetDeviceId());
+                redVTs[i] = make_shared<Matrix<ElemType>>(A.GetDeviceId());
+                chrono::time_point<chrono::system_clock> stTime = chrono::system_clock::now();
+                if (randomized)
+                    ranks[i] = RandomizedLowRankFactors(A, (size_t) (keepratio * min(m, n)), AlignedSize, numPowerIterations, *redUs[i], *redVTs[i]);
+                else
+                    ranks[i] = LowRankFactors(A, 0, keepratio, AlignedSize, *redUs[i], *redVTs[i]);
+                chrono::time_point<chrono::system_clock> enTime = chrono::system_clock::now();
+
+                chrono::duration<double> elapsedtime = enTime - stTime;
+                size_t r = ranks[i];
+                fprintf(stderr,
+                        "Performing SVD for a %5d-by-%-5d matrix (node name: %-20ls) ---  computation time %5.2f secs ;  keep %4.1f%% %s ===> keep %5d svd values (reduce to %4.1f%% parameters) \n",
+                        (int) m, (int) n, names[i].c_str(), elapsedtime.count(),
+                        keepratio * 100, randomized ? "rank" : "energy", (int) r,
+                        ((m + n) * r + 0.0f) / m / n * 100);
             }
-            // r = (r + 7) & (~7); //  to keep the number of rows/cols of resultant matrix a multipier of 8
-            //  which can be helpful at runtime
-
-            chrono::duration<double> elapsedtime = enTime - stTime;
-            fprintf(stderr,
-                    "Performing SVD for a %5d-by-%-5d matrix (node name: %-20ls) ---  computation time %5.2f secs ;  keep %4.1f%% energy ===> keep %5d svd values (reduce to %4.1f%% parameters) \n",
-                    (int) m, (int) n, name.c_str(), elapsedtime.count(),
-                    keepratio * 100, (int) r,
-                    ((m + n) * r + 0.0f) / m / n * 100);
-
-            // redU in R^ {mXr}
-            Matrix<ElemType> redU = U.ColumnSlice(0, r);
-            Matrix<ElemType> redVT(-1);
-
-            // redVT in R^{rXn}
-            redVT.Resize(r, n);
-            redVT.AssignRowSliceValuesOf(VT, 0, r);
-
-            Matrix<ElemType> redS(r, (size_t) 1);
-            for (size_t i = 0; i < r; i++)
+            catch (...)
             {
-                ElemType sqrtsigma = (ElemType) sqrt((double) S(i, 0));
-                redS(i, 0) = sqrtsigma;
+#pragma omp critical
+                if (!firstException)
+                    firstException = std::current_exception();
             }
+        }
+        if (firstException)
+            std::rethrow_exception(firstException);
 
-            redU.RowElementMultiplyWith(redS.Transpose());
-            redVT.ColumnElementMultiplyWith(redS);
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (ranks[i] == 0) // (a vector)
+                continue;
+            const wstring& name = names[i];
+            size_t m = redUs[i]->GetNumRows();
+            size_t n = redVTs[i]->GetNumCols();
+            size_t r = ranks[i];
+            Matrix<ElemType>& redU = *redUs[i];
+            Matrix<ElemType>& redVT = *redVTs[i];
 
             // Step 2. create two new Parameter nodes and one Times node
             wstring leftChildName = name + L"-U";
@@ -1023,19 +1182,1084 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
     CompileNetwork();
 }
 
+// Replaces the weights W [m x n] of Times(W, x) by two low-rank factors, as Times(W-U, Times(W-V, x)). Unlike
+// PerformSVDecomposition(), which replaces W by the product of its factors, this changes the cost of the product itself.
+// The factors are named after the Times node; W is deleted if nothing else uses it. Returns the rank.
+template <class ElemType>
+size_t ComputationNetwork::FactorizeTimesNode(const wstring& nodeName, size_t rank, float keepRatio, size_t alignedSize)
+{
+    ComputationNodeBasePtr node = GetNodeFromName(nodeName);
+    if (node->OperationName() != OperationNameOf(TimesNode))
+        InvalidArgument("FactorizeTimesNode: %ls is a %ls node, not a Times node.", nodeName.c_str(), node->OperationName().c_str());
+    auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(node->GetInputs()[0]);
+    if (!weights || node->GetInputs()[0]->GetSampleLayout().GetRank() > 2)
+        InvalidArgument("FactorizeTimesNode: The first input of %ls is not a LearnableParameter matrix.", nodeName.c_str());
+
+    const Matrix<ElemType>& W = weights->ValueAsMatrix();
+    size_t m = W.GetNumRows();
+    size_t n = W.GetNumCols();
+    Matrix<ElemType> redU(W.GetDeviceId()), redVT(W.GetDeviceId());
+    size_t r = LowRankFactors(W, rank, keepRatio, alignedSize, redU, redVT);
+    if ((m + n) * r >= m * n)
+        fprintf(stderr, "FactorizeTimesNode: WARNING: Rank %d factors of the [%d x %d] weights of %ls are no smaller than the weights.\n",
+                (int) r, (int) m, (int) n, nodeName.c_str());
+
+    auto pLeft = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, nodeName + L"-U", m, r));
+    auto pRight = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, nodeName + L"-V", r, n));
+    pLeft->Value().SetValue(redU);
+    pRight->Value().SetValue(redVT);
+    bool updateRequired = node->GetInputs()[0]->IsParameterUpdateRequired();
+    for (ComputationNodeBasePtr factor : vector<ComputationNodeBasePtr>{pLeft, pRight})
+        factor->SetParameterUpdateRequired(updateRequired);
+
+    auto pInner = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(m_deviceId, nodeName + L"-Vx"), pRight, node->GetInputs()[1]);
+    node->SetInput(0, pLeft);
+    node->SetInput(1, pInner);
+    InvalidateCompiledNetwork();
+
+    // delete W unless it is still used
+    bool isUsed = false;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            isUsed |= (input == weights);
+    for (auto group : GetAllNodeGroups())
+        isUsed |= (find(group->begin(), group->end(), weights) != group->end());
+    if (!isUsed)
+        DeleteNode(weights->NodeName());
+
+    fprintf(stderr, "FactorizeTimesNode: %ls: [%d x %d] weights replaced by rank %d factors (%.1f%% of the parameters).\n",
+            nodeName.c_str(), (int) m, (int) n, (int) r, ((m + n) * r + 0.0f) / m / n * 100);
+    return r;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::SparsifyTimesWeights(double maxDensity)
+{
+    size_t numSparsified = 0;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const ComputationNodeBasePtr& node = iter.second;
+        if (node->GetNumInputs() != 2 || !dynamic_pointer_cast<LearnableParameter<ElemType>>(node->GetInputs()[0]))
+            continue;
+        if (node->GetInputs()[0]->GetSampleLayout().GetRank() > 2) // (batched Times)
+            continue;
+        bool sparsified = false;
+        if (auto timesNode = dynamic_pointer_cast<TimesNodeBase<ElemType, false>>(node))
+            sparsified = timesNode->SparsifyWeights(maxDensity);
+        else if (auto transposeTimesNode = dynamic_pointer_cast<TimesNodeBase<ElemType, true>>(node))
+            sparsified = transposeTimesNode->SparsifyWeights(maxDensity);
+        if (sparsified)
+            numSparsified++;
+    }
+    return numSparsified;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::QuantizeTimesWeightsToInt8()
+{
+    size_t numQuantized = 0;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const ComputationNodeBasePtr& node = iter.second;
+        if (node->GetNumInputs() != 2 || !dynamic_pointer_cast<LearnableParameter<ElemType>>(node->GetInputs()[0]))
+            continue;
+        if (node->GetInputs()[0]->GetSampleLayout().GetRank() > 2) // (batched Times)
+            continue;
+        if (auto timesNode = dynamic_pointer_cast<TimesNodeBase<ElemType, false>>(node))
+            timesNode->QuantizeWeightsToInt8();
+        else if (auto transposeTimesNode = dynamic_pointer_cast<TimesNodeBase<ElemType, true>>(node))
+            transposeTimesNode->QuantizeWeightsToInt8();
+        else
+            continue;
+        numQuantized++;
+    }
+    return numQuantized;
+}
+
+// Folds the layers following a convolution into it:
+//  - Plus(conv, b) with a per-channel LearnableParameter b becomes the initial bias;
+//  - a spatial BatchNormalization y = scale * (x - runMean) * runInvStdDev + bnBias, using its running statistics as in
+//    eval mode, scales the rows of the convolution weights by s = scale * runInvStdDev, and the bias becomes
+//    s * (b - runMean) + bnBias;
+//  - RectifiedLinear is applied by the convolution engine when writing the output.
+// Each intermediate node must be consumed only by the next one in the chain, and the weights only by the convolution.
+// The convolution node takes over the name of the last node of the chain, so that outputs keep their names.
+template <class ElemType>
+size_t ComputationNetwork::FuseConvolutionLayers()
+{
+    // count the consumers of every node; members of node groups (outputs etc.) count as used from outside
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    for (auto group : GetAllNodeGroups())
+        for (const auto& node : *group)
+            numConsumers[node]++;
+    auto consumerOf = [&](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        if (numConsumers[node] != 1)
+            return nullptr;
+        for (const auto& iter : m_nameToNodeMap)
+            for (const auto& input : iter.second->GetInputs())
+                if (input == node)
+                    return iter.second;
+        return nullptr;
+    };
+
+    vector<shared_ptr<ConvolutionNode<ElemType>>> convNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (auto convNode = dynamic_pointer_cast<ConvolutionNode<ElemType>>(iter.second))
+            convNodes.push_back(convNode);
+
+    size_t numFused = 0;
+    vector<ComputationNodeBasePtr> orphanCandidates;
+    for (const auto& convNode : convNodes)
+    {
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(convNode->GetInputs()[0]);
+        if (!weights || numConsumers[weights] != 1)
+            continue;
+        const size_t K = weights->ValueAsMatrix().GetNumRows();
+        const size_t channelDim = (convNode->GetImageLayoutKind() == ImageLayoutKind::HWC) ? 0 : 2;
+
+        vector<ComputationNodeBasePtr> chain; // nodes folded into convNode
+        ComputationNodeBasePtr last = convNode;
+
+        // Plus(conv, b) or Plus(b, conv)
+        shared_ptr<LearnableParameter<ElemType>> bias;
+        auto next = consumerOf(last);
+        if (next && next->OperationName() == OperationNameOf(PlusNode))
+        {
+            auto other = next->GetInputs()[next->GetInputs()[0] == last ? 1 : 0];
+            bias = dynamic_pointer_cast<LearnableParameter<ElemType>>(other);
+            const auto& shape = other->GetSampleLayout();
+            if (bias && !other->HasMBLayout() && shape.GetNumElements() == K && shape.GetDimPadded(channelDim) == K)
+            {
+                chain.push_back(next);
+                last = next;
+                next = consumerOf(last);
+            }
+            else
+                bias = nullptr;
+        }
+
+        // BatchNormalization(x, scale, bnBias, runMean, runInvStdDev)
+        shared_ptr<BatchNormalizationNode<ElemType>> bnNode;
+        auto bnParam = [&](size_t i) -> Matrix<ElemType>&
+        {
+            return dynamic_pointer_cast<ComputationNode<ElemType>>(bnNode->GetInputs()[i])->Value();
+        };
+        if (next && (bnNode = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(next)))
+        {
+            bool perChannel = bnNode->IsSpatial();
+            for (size_t i = 1; i < next->GetNumInputs(); i++)
+                perChannel = perChannel && bnParam(i).GetNumElements() == K;
+            if (perChannel)
+            {
+                chain.push_back(next);
+                last = next;
+                next = consumerOf(last);
+            }
+            else
+                bnNode = nullptr;
+        }
+
+        bool relu = next && next->OperationName() == OperationNameOf(RectifiedLinearNode);
+        if (relu)
+        {
+            chain.push_back(next);
+            last = next;
+        }
+
+        if (chain.empty())
+            continue;
+
+        // compute the weights and the bias
+        const DEVICEID_TYPE deviceId = weights->ValueAsMatrix().GetDeviceId();
+        Matrix<ElemType> fusedBias(deviceId);
+        if (bias)
+            fusedBias.SetValue(bias->Value().Reshaped(K, 1));
+        if (bnNode)
+        {
+            const Matrix<ElemType> scale = bnParam(1).Reshaped(K, 1);
+            const Matrix<ElemType> bnBias = bnParam(2).Reshaped(K, 1);
+            const Matrix<ElemType> runMean = bnParam(3).Reshaped(K, 1);
+            const Matrix<ElemType> runInvStdDev = bnParam(4).Reshaped(K, 1);
+
+            Matrix<ElemType> s(deviceId);
+            s.AssignElementProductOf(scale, runInvStdDev);
+            weights->ValueAsMatrix().ColumnElementMultiplyWith(s);
+
+            if (bias)
+                fusedBias -= runMean;
+            else
+                fusedBias.AssignDifferenceOf((ElemType) 0, runMean);
+            fusedBias.ElementMultiplyWith(s);
+            fusedBias += bnBias;
+        }
+        convNode->FuseBiasAndReLU(fusedBias, relu);
+
+        // rewire: consumers of the last node now read the convolution directly, which takes over its name
+        InvalidateCompiledNetwork();
+        for (const auto& iter : m_nameToNodeMap)
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == last)
+                    iter.second->SetInput(i, convNode);
+        for (auto group : GetAllNodeGroups())
+            std::replace(group->begin(), group->end(), last, (ComputationNodeBasePtr) convNode);
+        numConsumers[convNode] = numConsumers[last];
+
+        // delete from the end, so that no remaining node refers to a deleted one
+        wstring name = last->NodeName();
+        for (auto iter = chain.rbegin(); iter != chain.rend(); iter++)
+        {
+            const auto& node = *iter;
+            for (const auto& input : node->GetInputs())
+                if (input != convNode && input->OperationName() == OperationNameOf(LearnableParameter))
+                    orphanCandidates.push_back(input);
+            DeleteNode(node->NodeName());
+        }
+        RenameNode(convNode, name);
+        numFused++;
+    }
+
+    // remove the bias and BatchNormalization parameters unless something else still uses them
+    DeleteNodesIfUnused(orphanCandidates);
+
+    if (numFused > 0)
+        CompileNetwork();
+    return numFused;
+}
+
+// delete those of the nodes that are no longer input to any node nor member of a node group
+void ComputationNetwork::DeleteNodesIfUnused(const vector<ComputationNodeBasePtr>& nodes)
+{
+    for (const auto& node : nodes)
+    {
+        if (!NodeNameExists(node->NodeName()) || GetNodeFromName(node->NodeName()) != node)
+            continue;
+        bool used = false;
+        for (const auto& iter : m_nameToNodeMap)
+            for (const auto& input : iter.second->GetInputs())
+                used = used || (input == node);
+        for (auto group : GetAllNodeGroups())
+            used = used || std::find(group->begin(), group->end(), node) != group->end();
+        if (!used)
+            DeleteNode(node->NodeName());
+    }
+}
+
+size_t ComputationNetwork::PruneForInference(const vector<ComputationNodeBasePtr>& outputNodes)
+{
+    if (outputNodes.empty())
+        InvalidArgument("PruneForInference: No output nodes given.");
+    const auto reachableNodes = ComputationNodeBase::EnumerateNodes(outputNodes);
+    const set<ComputationNodeBasePtr> keep(reachableNodes.begin(), reachableNodes.end());
+
+    InvalidateCompiledNetwork();
+    m_outputNodes = outputNodes;
+    vector<wstring> unreachableNodeNames;
+    for (const auto& iter : m_nameToNodeMap)
+        if (keep.find(iter.second) == keep.end())
+            unreachableNodeNames.push_back(iter.first);
+    for (const auto& name : unreachableNodeNames)
+        DeleteNode(name);
+
+    for (const auto& node : reachableNodes)
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            node->SetParameterUpdateRequired(false);
+
+    CompileNetwork();
+    return unreachableNodeNames.size();
+}
+
+// With y = (x - mean) .* invStdDev, W * y + b = W' * x + b' where W' = W * diag(invStdDev) and b' = b - W' * mean.
+// The weights and the bias must be consumed only by this chain, and the normalization only by the Times operation.
+template <class ElemType>
+size_t ComputationNetwork::FoldMeanVarNormalization()
+{
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    for (auto group : GetAllNodeGroups())
+        for (const auto& node : *group)
+            numConsumers[node]++;
+    auto consumerOf = [&](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        if (numConsumers[node] != 1)
+            return nullptr;
+        for (const auto& iter : m_nameToNodeMap)
+            for (const auto& input : iter.second->GetInputs())
+                if (input == node)
+                    return iter.second;
+        return nullptr;
+    };
+    // mean and invStdDev must be known, i.e. parameters or precomputed
+    auto constantValueOf = [&](const ComputationNodeBasePtr& node) -> shared_ptr<ComputationNode<ElemType>>
+    {
+        auto preComputedNode = dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node);
+        if ((preComputedNode && preComputedNode->HasComputed()) || dynamic_pointer_cast<LearnableParameter<ElemType>>(node))
+            return dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        return nullptr;
+    };
+
+    vector<ComputationNodeBasePtr> normNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (iter.second->OperationName() == OperationNameOf(PerDimMeanVarNormalizationNode))
+            normNodes.push_back(iter.second);
+
+    size_t numFolded = 0;
+    vector<ComputationNodeBasePtr> orphanCandidates;
+    for (const auto& normNode : normNodes)
+    {
+        auto timesNode = consumerOf(normNode);
+        if (!timesNode || timesNode->OperationName() != OperationNameOf(TimesNode) || timesNode->GetInputs()[1] != normNode)
+            continue;
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(timesNode->GetInputs()[0]);
+        if (!weights || numConsumers[weights] != 1)
+            continue;
+        auto plusNode = consumerOf(timesNode);
+        if (!plusNode || plusNode->OperationName() != OperationNameOf(PlusNode))
+            continue;
+        auto bias = dynamic_pointer_cast<LearnableParameter<ElemType>>(plusNode->GetInputs()[plusNode->GetInputs()[0] == timesNode ? 1 : 0]);
+        if (!bias || numConsumers[bias] != 1)
+            continue;
+        auto meanNode = constantValueOf(normNode->GetInputs()[1]);
+        auto invStdDevNode = constantValueOf(normNode->GetInputs()[2]);
+        if (!meanNode || !invStdDevNode)
+            continue;
+
+        Matrix<ElemType>& W = weights->ValueAsMatrix();
+        const size_t M = W.GetNumRows();
+        const size_t N = W.GetNumCols();
+        if (meanNode->Value().GetNumElements() != N || invStdDevNode->Value().GetNumElements() != N || bias->Value().GetNumElements() != M)
+            continue;
+
+        W.RowElementMultiplyWith(invStdDevNode->Value().Reshaped(1, N));
+        Matrix<ElemType> b = bias->Value().Reshaped(M, 1);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(-1, W, false, meanNode->Value().Reshaped(N, 1), false, 1, b);
+
+        // rewire: the Times operation reads the features directly
+        InvalidateCompiledNetwork();
+        timesNode->SetInput(1, normNode->GetInputs()[0]);
+        orphanCandidates.push_back(normNode->GetInputs()[1]);
+        orphanCandidates.push_back(normNode->GetInputs()[2]);
+        DeleteNode(normNode->NodeName());
+        numFolded++;
+    }
+
+    // remove the mean and invStdDev nodes unless something else still uses them
+    DeleteNodesIfUnused(orphanCandidates);
+
+    if (numFolded > 0)
+        CompileNetwork();
+    return numFolded;
+}
+
+// Dropout is the identity in inference. A Dropout node that is itself an output (member of a node group) is kept,
+// since its name is how the output is requested.
+size_t ComputationNetwork::RemoveDropoutNodes()
+{
+    set<ComputationNodeBasePtr> groupMembers;
+    for (auto group : GetAllNodeGroups())
+        groupMembers.insert(group->begin(), group->end());
+
+    vector<ComputationNodeBasePtr> dropoutNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (iter.second->OperationName() == OperationNameOf(DropoutNode) && groupMembers.find(iter.second) == groupMembers.end())
+            dropoutNodes.push_back(iter.second);
+
+    for (const auto& dropoutNode : dropoutNodes)
+    {
+        // rewire: consumers read the input of the Dropout node directly
+        InvalidateCompiledNetwork();
+        auto input = dropoutNode->GetInputs()[0];
+        for (const auto& iter : m_nameToNodeMap)
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == dropoutNode)
+                    iter.second->SetInput(i, input);
+        DeleteNode(dropoutNode->NodeName());
+    }
+
+    if (!dropoutNodes.empty())
+        CompileNetwork();
+    return dropoutNodes.size();
+}
+
+// operations whose Value is a function of their inputs only: no attributes, no state, no randomness
+// Two nodes of such an operation on the same inputs compute the same, and one on constants computes a constant.
+static set<wstring> PureOperations()
+{
+    return set<wstring>{OperationNameOf(PlusNode), OperationNameOf(MinusNode), OperationNameOf(ElementTimesNode),
+                        OperationNameOf(TimesNode), OperationNameOf(TransposeTimesNode), OperationNameOf(DiagTimesNode),
+                        OperationNameOf(SigmoidNode), OperationNameOf(TanhNode), OperationNameOf(RectifiedLinearNode),
+                        OperationNameOf(ExpNode), OperationNameOf(LogNode), OperationNameOf(CosineNode), OperationNameOf(NegateNode),
+                        OperationNameOf(SoftmaxNode), OperationNameOf(LogSoftmaxNode), OperationNameOf(SumElementsNode),
+                        OperationNameOf(SumColumnElementsNode), OperationNameOf(RowStackNode)};
+}
+
+// the nodes that must keep their names: node-group members, and those the caller refers to by name
+set<ComputationNodeBasePtr> ComputationNetwork::NodesToKeep(const vector<ComputationNodeBasePtr>& keepNodes)
+{
+    set<ComputationNodeBasePtr> keep(keepNodes.begin(), keepNodes.end());
+    for (auto group : GetAllNodeGroups())
+        keep.insert(group->begin(), group->end());
+    return keep;
+}
+
+// Nodes are visited inputs first, so that a node is identical to an earlier one if it has the same operation and, with the
+// merges so far applied, the same inputs. Of identical nodes, the first one is kept.
+size_t ComputationNetwork::MergeIdenticalNodes(const vector<ComputationNodeBasePtr>& keepNodes)
+{
+    VerifyIsCompiled("MergeIdenticalNodes");
+    const set<wstring> pureOperations = PureOperations();
+    const set<ComputationNodeBasePtr> keep = NodesToKeep(keepNodes);
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> replacements; // merged node -> the identical one that replaces it
+    auto replacementOf = [&](const ComputationNodeBasePtr& node)
+    {
+        auto iter = replacements.find(node);
+        return iter != replacements.end() ? iter->second : node;
+    };
+    map<pair<wstring, vector<ComputationNodeBasePtr>>, ComputationNodeBasePtr> firstOfKind;
+    vector<ComputationNodeBasePtr> mergedNodes; // (in evaluation order, for the log)
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        if (node->IsLeaf() || node->IsPartOfLoop() || pureOperations.find(node->OperationName()) == pureOperations.end())
+            continue;
+        vector<ComputationNodeBasePtr> inputs;
+        for (const auto& input : node->GetInputs())
+            inputs.push_back(replacementOf(input));
+        auto key = make_pair(node->OperationName(), inputs);
+        auto iter = firstOfKind.find(key);
+        if (iter == firstOfKind.end())
+            firstOfKind[key] = node;
+        else if (keep.find(node) == keep.end())
+        {
+            replacements[node] = iter->second;
+            mergedNodes.push_back(node);
+        }
+    }
+    if (mergedNodes.empty())
+        return 0;
+
+    fprintf(stderr, "\nMergeIdenticalNodes: %d nodes are replaced by identical ones:\n", (int) mergedNodes.size());
+    for (const auto& node : mergedNodes)
+        fprintf(stderr, "\t%ls = %ls -> %ls\n", node->NodeName().c_str(), node->OperationName().c_str(), replacements[node]->NodeName().c_str());
+
+    // rewire: consumers read the node that is kept
+    InvalidateCompiledNetwork();
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+        {
+            const auto& input = iter.second->GetInputs()[i];
+            if (replacementOf(input) != input)
+                iter.second->SetInput(i, replacementOf(input));
+        }
+    }
+    for (const auto& node : mergedNodes)
+        DeleteNode(node->NodeName());
+
+    CompileNetwork();
+    return mergedNodes.size();
+}
+
+// A constant is a LearnableParameter that is not updated, or a pure operation of constants. The constants that a
+// non-constant node consumes (or that must be kept) are computed and replaced by LearnableParameters of the same names
+// that hold their values; the constants they were computed from are deleted unless still used. Results larger than
+// their inputs together (e.g. an outer product) are left to be computed.
+template <class ElemType>
+size_t ComputationNetwork::FoldConstants(const vector<ComputationNodeBasePtr>& keepNodes)
+{
+    VerifyIsCompiled("FoldConstants");
+    const set<wstring> pureOperations = PureOperations();
+    const set<ComputationNodeBasePtr> keep = NodesToKeep(keepNodes);
+
+    const vector<ComputationNodeBasePtr> evalOrder(GetEvalOrder(nullptr).begin(), GetEvalOrder(nullptr).end()); // (a copy, since we edit the network below)
+    set<ComputationNodeBasePtr> constants;
+    for (const auto& node : evalOrder)
+    {
+        bool isConstant;
+        if (node->IsLeaf())
+            isConstant = node->OperationName() == OperationNameOf(LearnableParameter) && !node->IsParameterUpdateRequired();
+        else
+        {
+            const auto& inputs = node->GetInputs();
+            isConstant = node->IsParameterOnly() && pureOperations.find(node->OperationName()) != pureOperations.end() &&
+                         dynamic_pointer_cast<ComputationNode<ElemType>>(node) &&
+                         all_of(inputs.begin(), inputs.end(), [&](const ComputationNodeBasePtr& input) { return constants.find(input) != constants.end(); });
+        }
+        if (isConstant)
+            constants.insert(node);
+    }
+
+    auto isFoldable = [&](const ComputationNodeBasePtr& node)
+    {
+        if (node->IsLeaf() || constants.find(node) == constants.end())
+            return false;
+        size_t numInputElements = 0;
+        for (const auto& input : node->GetInputs())
+            numInputElements += input->GetSampleLayout().GetNumElements();
+        return node->GetSampleLayout().GetNumElements() <= numInputElements;
+    };
+    set<ComputationNodeBasePtr> toFold;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        if (constants.find(iter.second) != constants.end())
+            continue;
+        for (const auto& input : iter.second->GetInputs())
+            if (input && isFoldable(input))
+                toFold.insert(input);
+    }
+    for (const auto& node : keep)
+        if (isFoldable(node))
+            toFold.insert(node);
+    if (toFold.empty())
+        return 0;
+
+    // compute the constants, inputs first
+    for (const auto& node : evalOrder)
+    {
+        if (node->IsLeaf() || constants.find(node) == constants.end())
+            continue;
+        node->MarkValueNonSharable(); // (allocates the Value)
+        node->RequestMatricesBeforeForwardProp(m_matrixPool);
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(nullptr));
+        node->EndForwardProp();
+        node->ReleaseMatricesAfterForwardProp(m_matrixPool);
+    }
+
+    fprintf(stderr, "\nFoldConstants: %d nodes are replaced by their values:\n", (int) toFold.size());
+    InvalidateCompiledNetwork();
+    vector<ComputationNodeBasePtr> orphanCandidates;
+    for (const auto& node : evalOrder)
+    {
+        if (toFold.find(node) == toFold.end())
+            continue;
+        fprintf(stderr, "\t%ls = %ls [%s]\n", node->NodeName().c_str(), node->OperationName().c_str(), string(node->GetSampleLayout()).c_str());
+
+        auto parameter = New<LearnableParameter<ElemType>>(node->GetDeviceId(), node->NodeName(), node->GetSampleLayout());
+        parameter->Value().SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+        ComputationNodeBasePtr constant = parameter;
+        constant->SetParameterUpdateRequired(false);
+
+        // rewire: the consumers and node groups refer to the constant instead
+        for (const auto& iter : m_nameToNodeMap)
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == node)
+                    iter.second->SetInput(i, constant);
+        for (auto group : GetAllNodeGroups())
+            std::replace(group->begin(), group->end(), node, constant);
+        m_nameToNodeMap[node->NodeName()] = constant;
+        orphanCandidates.insert(orphanCandidates.end(), node->GetInputs().begin(), node->GetInputs().end());
+        node->DetachInputs();
+    }
+
+    // remove what the constants were computed from, consumers before their inputs
+    vector<ComputationNodeBasePtr> computedFrom;
+    set<ComputationNodeBasePtr> candidates(orphanCandidates.begin(), orphanCandidates.end());
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++)
+    {
+        if (constants.find(*iter) == constants.end() || toFold.find(*iter) != toFold.end())
+            continue;
+        if (candidates.find(*iter) != candidates.end())
+        {
+            computedFrom.push_back(*iter);
+            candidates.insert((*iter)->GetInputs().begin(), (*iter)->GetInputs().end());
+        }
+    }
+    DeleteNodesIfUnused(computedFrom);
+
+    CompileNetwork();
+    return toFold.size();
+}
+
+// With s = scale .* runInvStdDev, BatchNormalization(W * x + b) = W' * x + b' where W' = diag(s) * W and
+// b' = s .* (b - runMean) + bnBias, as FuseConvolutionLayers() does for convolutions. Without a Plus(bias), the
+// BatchNormalization node is replaced by Plus(W' * x, bnBias') of the same name. The weights and the bias must be used
+// only by this chain, and each operation only by the next.
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalizationIntoTimes()
+{
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    for (auto group : GetAllNodeGroups())
+        for (const auto& node : *group)
+            numConsumers[node]++;
+
+    vector<shared_ptr<BatchNormalizationNode<ElemType>>> bnNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (auto bnNode = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(iter.second))
+            if (!bnNode->IsSpatial()) // (spatial ones follow convolutions)
+                bnNodes.push_back(bnNode);
+
+    size_t numFolded = 0;
+    vector<ComputationNodeBasePtr> orphanCandidates;
+    for (const auto& bnNode : bnNodes)
+    {
+        // [Plus(Times(W, x), b)] or Times(W, x)
+        auto input = bnNode->GetInputs()[0];
+        if (numConsumers[input] != 1)
+            continue;
+        ComputationNodeBasePtr plusNode, timesNode;
+        shared_ptr<LearnableParameter<ElemType>> bias;
+        if (input->OperationName() == OperationNameOf(PlusNode))
+        {
+            plusNode = input;
+            bool timesFirst = plusNode->GetInputs()[0]->OperationName() == OperationNameOf(TimesNode);
+            timesNode = plusNode->GetInputs()[timesFirst ? 0 : 1];
+            bias = dynamic_pointer_cast<LearnableParameter<ElemType>>(plusNode->GetInputs()[timesFirst ? 1 : 0]);
+            if (!bias || plusNode->GetInputs()[timesFirst ? 1 : 0]->HasMBLayout() || numConsumers[bias] != 1 || numConsumers[timesNode] != 1)
+                continue;
+        }
+        else
+            timesNode = input;
+        if (timesNode->OperationName() != OperationNameOf(TimesNode))
+            continue;
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(timesNode->GetInputs()[0]);
+        if (!weights || numConsumers[weights] != 1)
+            continue;
+
+        Matrix<ElemType>& W = weights->ValueAsMatrix();
+        const size_t M = W.GetNumRows();
+        auto bnParam = [&](size_t i) -> Matrix<ElemType>&
+        {
+            return dynamic_pointer_cast<ComputationNode<ElemType>>(bnNode->GetInputs()[i])->Value();
+        };
+        bool perRow = timesNode->GetSampleLayout().GetNumElements() == M && (!bias || bias->Value().GetNumElements() == M);
+        for (size_t i = 1; i < bnNode->GetInputs().size(); i++)
+            perRow = perRow && bnParam(i).GetNumElements() == M;
+        // without a Plus, the BatchNormalization bias becomes the bias
+        auto bnBiasNode = dynamic_pointer_cast<LearnableParameter<ElemType>>(bnNode->GetInputs()[2]);
+        if (!perRow || (!bias && (!bnBiasNode || numConsumers[bnBiasNode] != 1)))
+            continue;
+
+        // compute the weights and the bias
+        const DEVICEID_TYPE deviceId = W.GetDeviceId();
+        const Matrix<ElemType> scale = bnParam(1).Reshaped(M, 1);
+        const Matrix<ElemType> runMean = bnParam(3).Reshaped(M, 1);
+        const Matrix<ElemType> runInvStdDev = bnParam(4).Reshaped(M, 1);
+        Matrix<ElemType> s(deviceId);
+        s.AssignElementProductOf(scale, runInvStdDev);
+        W.ColumnElementMultiplyWith(s);
+        Matrix<ElemType> fusedBias(deviceId);
+        if (bias)
+        {
+            fusedBias.SetValue(bias->Value().Reshaped(M, 1));
+            fusedBias -= runMean;
+        }
+        else
+            fusedBias.AssignDifferenceOf((ElemType) 0, runMean);
+        fusedBias.ElementMultiplyWith(s);
+        fusedBias += bnParam(2).Reshaped(M, 1);
+        auto& biasValue = (bias ? bias : bnBiasNode)->Value();
+        biasValue.SetValue(fusedBias.Reshaped(biasValue.GetNumRows(), biasValue.GetNumCols()));
+
+        // rewire: consumers of the BatchNormalization node now read the Plus, which takes over its name
+        InvalidateCompiledNetwork();
+        wstring name = bnNode->NodeName();
+        for (size_t i = 1; i < bnNode->GetInputs().size(); i++)
+            if (bias || i != 2)
+                orphanCandidates.push_back(bnNode->GetInputs()[i]);
+        if (!plusNode)
+        {
+            plusNode = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(deviceId, name + L".foldedBias"), timesNode, (ComputationNodeBasePtr) bnBiasNode);
+        }
+        for (const auto& iter : m_nameToNodeMap)
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == bnNode)
+                    iter.second->SetInput(i, plusNode);
+        for (auto group : GetAllNodeGroups())
+            std::replace(group->begin(), group->end(), (ComputationNodeBasePtr) bnNode, plusNode);
+        numConsumers[plusNode] = numConsumers[bnNode];
+        DeleteNode(name);
+        RenameNode(plusNode, name);
+        numFolded++;
+    }
+
+    // remove the BatchNormalization parameters unless something else still uses them
+    DeleteNodesIfUnused(orphanCandidates);
+
+    if (numFolded > 0)
+        CompileNetwork();
+    return numFolded;
+}
+
+// An embedding lookup is linear in its table, e(x) = E * x for a one-hot x or the column of E selected by an id, so
+// with no nonlinearity in between, W * e(x) = (W * E) * x: the projection can be applied to the table once instead of
+// to every vector looked up, leaving a single gather. Folds Times(W, lookup(E, x)), where lookup is LookupTable,
+// EmbeddingLookup or HashedEmbeddingLookup of one id per sample, or Times with a sparse input, into the same lookup of
+// a new table W * E, which takes over the name of the Times node. The lookup must be consumed only by the Times
+// operation; W and E may be shared, since they are not changed. The table grows from E's [K x V] to [M x V]; chains
+// with M > maxGrowth * K are left alone.
+template <class ElemType>
+size_t ComputationNetwork::FoldEmbeddingProjections(double maxGrowth)
+{
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    for (auto group : GetAllNodeGroups())
+        for (const auto& node : *group)
+            numConsumers[node]++;
+    auto isLookup = [](const ComputationNodeBasePtr& node)
+    {
+        const wstring op = node->OperationName();
+        if (op == OperationNameOf(LookupTableNode) || op == OperationNameOf(EmbeddingLookupNode) || op == OperationNameOf(HashedEmbeddingLookupNode))
+            return true;
+        return op == OperationNameOf(TimesNode) && node->GetInputs()[1]->OperationName() == OperationNameOf(SparseInputValue);
+    };
+
+    vector<ComputationNodeBasePtr> timesNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (iter.second->OperationName() == OperationNameOf(TimesNode) && isLookup(iter.second->GetInputs()[1]))
+            timesNodes.push_back(iter.second);
+
+    size_t numFolded = 0;
+    vector<ComputationNodeBasePtr> orphanCandidates;
+    for (const auto& timesNode : timesNodes)
+    {
+        auto lookupNode = timesNode->GetInputs()[1];
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(timesNode->GetInputs()[0]);
+        auto table = dynamic_pointer_cast<LearnableParameter<ElemType>>(lookupNode->GetInputs()[0]);
+        if (!weights || !table || numConsumers[lookupNode] != 1)
+            continue;
+        if (timesNode->GetInputs()[0]->GetSampleLayout().GetRank() > 2 || lookupNode->GetInputs()[0]->GetSampleLayout().GetRank() > 2)
+            continue;
+
+        // one embedding per sample, all of which the projection reads
+        const Matrix<ElemType>& W = weights->ValueAsMatrix();
+        const Matrix<ElemType>& E = table->ValueAsMatrix();
+        if (W.GetNumCols() != E.GetNumRows() || lookupNode->GetSampleLayout().GetNumElements() != E.GetNumRows())
+            continue;
+        if (W.GetNumRows() > maxGrowth * E.GetNumRows())
+            continue;
+
+        // the projected table
+        wstring name = timesNode->NodeName();
+        auto folded = New<LearnableParameter<ElemType>>(E.GetDeviceId(), name + L".foldedEmbedding", TensorShape(W.GetNumRows(), E.GetNumCols()));
+        folded->Value().AssignProductOf(W, false, E, false);
+        ComputationNodeBasePtr foldedTable = folded;
+        foldedTable->SetParameterUpdateRequired(false);
+        AddNodeToNet(foldedTable);
+
+        // rewire: the lookup reads the projected table, and its consumers read the lookup, which takes over the name
+        InvalidateCompiledNetwork();
+        lookupNode->SetInput(0, foldedTable);
+        for (const auto& iter : m_nameToNodeMap)
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == timesNode)
+                    iter.second->SetInput(i, lookupNode);
+        for (auto group : GetAllNodeGroups())
+            std::replace(group->begin(), group->end(), timesNode, lookupNode);
+        numConsumers[lookupNode] = numConsumers[timesNode];
+        orphanCandidates.push_back(weights);
+        orphanCandidates.push_back(table);
+        DeleteNode(name);
+        RenameNode(lookupNode, name);
+        numFolded++;
+    }
+
+    // remove the original table and projection unless something else still uses them
+    DeleteNodesIfUnused(orphanCandidates);
+
+    if (numFolded > 0)
+        CompileNetwork();
+    return numFolded;
+}
+
+// the dense, non-empty values of the parameters and precomputed nodes
+template <class ElemType>
+vector<shared_ptr<ComputationNode<ElemType>>> ComputationNetwork::GetParameterValueNodes() const
+{
+    vector<shared_ptr<ComputationNode<ElemType>>> nodes;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(iter.second);
+        if (!node || (node->OperationName() != OperationNameOf(LearnableParameter) && !node->RequiresPreCompute()))
+            continue;
+        const auto& value = node->Value();
+        if (value.GetMatrixType() == DENSE && value.GetNumElements() > 0)
+            nodes.push_back(node);
+    }
+    return nodes;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::PackParameters()
+{
+    const size_t alignment = 64 / sizeof(ElemType); // let each value start at a cache line
+    vector<shared_ptr<ComputationNode<ElemType>>> nodes;
+    size_t numElements = 0;
+    for (const auto& node : GetParameterValueNodes<ElemType>())
+    {
+        if (node->Value().GetDeviceId() != m_deviceId)
+            continue;
+        nodes.push_back(node);
+        numElements += (node->Value().GetNumElements() + alignment - 1) / alignment * alignment;
+    }
+    if (nodes.empty())
+        return 0;
+
+    auto packedParameters = make_shared<Matrix<ElemType>>(numElements, 1, m_deviceId);
+    size_t offset = 0;
+    for (const auto& node : nodes)
+    {
+        const auto& value = node->Value();
+        auto packedValue = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), packedParameters->BufferPointer() + offset, matrixFlagDontOwnBuffer, m_deviceId);
+        packedValue->SetValue(value);
+        node->SwapValuePtr(packedValue);
+        offset += (packedValue->GetNumElements() + alignment - 1) / alignment * alignment;
+    }
+    m_parameterStorage = packedParameters;
+    return numElements;
+}
+
+// The parameter section file consists of
+//  - a header: the tag "CNTKPARM", the element size, the checksum of the values (ParameterChecksum()), the number of
+//    values, all but the tag as uint64_t;
+//  - for each value: the length of its node name, the name in UTF-8, its rows, its columns, and the file offset of its
+//    elements, all lengths and numbers as uint64_t;
+//  - the elements of the values, column-major, each value starting at a multiple of parameterSectionAlignment bytes.
+static const char parameterSectionTag[8] = { 'C', 'N', 'T', 'K', 'P', 'A', 'R', 'M' };
+static const size_t parameterSectionAlignment = 64;
+
+// FNV-1a over the names, dimensions and elements of the values that a parameter section holds, which tells whether the
+// file was written from the network as it is loaded now, rather than e.g. from an earlier version of the model
+template <class ElemType>
+uint64_t ComputationNetwork::ParameterChecksum() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* p, size_t numBytes)
+    {
+        const unsigned char* bytes = (const unsigned char*) p;
+        for (size_t i = 0; i < numBytes; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    for (const auto& node : GetParameterValueNodes<ElemType>())
+    {
+        const string name = msra::strfun::utf8(node->NodeName());
+        const auto& value = node->Value();
+        const uint64_t dims[2] = { value.GetNumRows(), value.GetNumCols() };
+        hashBytes(name.data(), name.size());
+        hashBytes(dims, sizeof(dims));
+        unique_ptr<ElemType[]> elements(value.CopyToArray());
+        hashBytes(elements.get(), value.GetNumElements() * sizeof(ElemType));
+    }
+    return hash;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::SaveParameterSection(const wstring& fileName) const
+{
+    const auto nodes = GetParameterValueNodes<ElemType>();
+
+    // lay out the index, then the elements
+    size_t indexSize = sizeof(parameterSectionTag) + 3 * sizeof(uint64_t);
+    for (const auto& node : nodes)
+        indexSize += 4 * sizeof(uint64_t) + msra::strfun::utf8(node->NodeName()).size();
+    vector<uint64_t> offsets;
+    uint64_t offset = indexSize;
+    for (const auto& node : nodes)
+    {
+        offset = (offset + parameterSectionAlignment - 1) / parameterSectionAlignment * parameterSectionAlignment;
+        offsets.push_back(offset);
+        offset += node->Value().GetNumElements() * sizeof(ElemType);
+    }
+
+    FILE* f = fopenOrDie(fileName, L"wb");
+    auto put = [&](uint64_t v)
+    {
+        fwriteOrDie(&v, sizeof(v), 1, f);
+    };
+    fwriteOrDie(parameterSectionTag, sizeof(parameterSectionTag), 1, f);
+    put(sizeof(ElemType));
+    put(ParameterChecksum<ElemType>());
+    put(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const string name = msra::strfun::utf8(nodes[i]->NodeName());
+        put(name.size());
+        fwriteOrDie(name.data(), 1, name.size(), f);
+        put(nodes[i]->Value().GetNumRows());
+        put(nodes[i]->Value().GetNumCols());
+        put(offsets[i]);
+    }
+    const vector<char> padding(parameterSectionAlignment, 0);
+    uint64_t pos = indexSize;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        fwriteOrDie(padding.data(), 1, offsets[i] - pos, f);
+        const auto& value = nodes[i]->Value();
+        unique_ptr<ElemType[]> elements(value.CopyToArray());
+        fwriteOrDie(elements.get(), sizeof(ElemType), value.GetNumElements(), f);
+        pos = offsets[i] + value.GetNumElements() * sizeof(ElemType);
+    }
+    fcloseOrDie(f);
+    return nodes.size();
+}
+
+// a file mapped read-only into memory, unmapped when destroyed
+class MappedParameterSection
+{
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+public:
+    MappedParameterSection(const wstring& fileName)
+    {
+#ifdef _WIN32
+        m_file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("MapParameterSection: Cannot open '%ls'.", fileName.c_str());
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = (size_t) size.QuadPart;
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        m_data = m_mapping ? (const char*) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!m_data)
+        {
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            RuntimeError("MapParameterSection: Cannot map '%ls'.", fileName.c_str());
+        }
+#else
+        int fd = open(msra::strfun::utf8(fileName).c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("MapParameterSection: Cannot open '%ls'.", fileName.c_str());
+        struct stat st;
+        fstat(fd, &st);
+        m_size = (size_t) st.st_size;
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // the mapping stays valid
+        if (data == MAP_FAILED)
+            RuntimeError("MapParameterSection: Cannot map '%ls'.", fileName.c_str());
+        m_data = (const char*) data;
+#endif
+    }
+
+    ~MappedParameterSection()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap((void*) m_data, m_size);
+#endif
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+};
+
+template <class ElemType>
+bool ComputationNetwork::MapParameterSection(const wstring& fileName, size_t& numMapped)
+{
+    auto section = make_shared<MappedParameterSection>(fileName);
+    const char* p = section->Data();
+    const char* end = p + section->Size();
+    auto get = [&]() -> uint64_t
+    {
+        uint64_t v;
+        if (end - p < (ptrdiff_t) sizeof(v))
+            RuntimeError("MapParameterSection: '%ls' is truncated.", fileName.c_str());
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    };
+    if (section->Size() < sizeof(parameterSectionTag) || memcmp(p, parameterSectionTag, sizeof(parameterSectionTag)) != 0)
+        RuntimeError("MapParameterSection: '%ls' is not a parameter section file.", fileName.c_str());
+    p += sizeof(parameterSectionTag);
+    if (get() != sizeof(ElemType))
+        RuntimeError("MapParameterSection: '%ls' was written for a different element type.", fileName.c_str());
+    numMapped = 0;
+    if (get() != ParameterChecksum<ElemType>()) // written for another model, or another version of it
+        return false;
+
+    const bool mapInPlace = m_deviceId == CPUDEVICE;
+    for (uint64_t n = get(); n > 0; n--)
+    {
+        const uint64_t nameLength = get();
+        if ((uint64_t) (end - p) < nameLength)
+            RuntimeError("MapParameterSection: '%ls' is truncated.", fileName.c_str());
+        const wstring name = msra::strfun::utf16(string(p, nameLength));
+        p += nameLength;
+        const size_t rows = get();
+        const size_t cols = get();
+        const uint64_t offset = get();
+        if (offset % sizeof(ElemType) != 0 || offset > section->Size() || (section->Size() - offset) / sizeof(ElemType) < rows * cols)
+            RuntimeError("MapParameterSection: '%ls' is truncated.", fileName.c_str());
+
+        if (!NodeNameExists(name)) // e.g. pruned
+            continue;
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(GetNodeFromName(name));
+        if (!node || node->Value().GetNumRows() != rows || node->Value().GetNumCols() != cols)
+            RuntimeError("MapParameterSection: The value of %ls in '%ls' does not match the model.", name.c_str(), fileName.c_str());
+
+        ElemType* elements = (ElemType*) (section->Data() + offset);
+        if (mapInPlace) // note: the pages are read-only
+            node->SwapValuePtr(make_shared<Matrix<ElemType>>(rows, cols, elements, matrixFlagDontOwnBuffer, CPUDEVICE));
+        else
+            node->Value().SetValue(rows, cols, node->Value().GetDeviceId(), elements);
+        numMapped++;
+    }
+    if (mapInPlace)
+        m_parameterStorage = section;
+    return true;
+}
+
 template void ComputationNetwork::InitLearnableParameters<float>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const float initValueScale, bool initOnCPUOnly);
 template void ComputationNetwork::Read<float>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
-template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize, bool randomized, size_t numPowerIterations);
+template size_t ComputationNetwork::FactorizeTimesNode<float>(const wstring& nodeName, size_t rank, float keepRatio, size_t alignedSize);
+template size_t ComputationNetwork::QuantizeTimesWeightsToInt8<float>();
+template size_t ComputationNetwork::SparsifyTimesWeights<float>(double maxDensity);
+template size_t ComputationNetwork::FuseConvolutionLayers<float>();
+template size_t ComputationNetwork::FoldMeanVarNormalization<float>();
+template size_t ComputationNetwork::FoldBatchNormalizationIntoTimes<float>();
+template size_t ComputationNetwork::FoldEmbeddingProjections<float>(double maxGrowth);
+template size_t ComputationNetwork::FoldConstants<float>(const vector<ComputationNodeBasePtr>& keepNodes);
+template size_t ComputationNetwork::PackParameters<float>();
+template uint64_t ComputationNetwork::ParameterChecksum<float>() const;
+template size_t ComputationNetwork::SaveParameterSection<float>(const wstring& fileName) const;
+template bool ComputationNetwork::MapParameterSection<float>(const wstring& fileName, size_t& numMapped);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
+template /*static*/ void ComputationNetwork::SetSampledSoftmaxTraining<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool training);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
 
 template void ComputationNetwork::InitLearnableParameters<double>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly);
 template void ComputationNetwork::Read<double>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
-template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize, bool randomized, size_t numPowerIterations);
+template size_t ComputationNetwork::FactorizeTimesNode<double>(const wstring& nodeName, size_t rank, float keepRatio, size_t alignedSize);
+template size_t ComputationNetwork::QuantizeTimesWeightsToInt8<double>();
+template size_t ComputationNetwork::SparsifyTimesWeights<double>(double maxDensity);
+template size_t ComputationNetwork::FuseConvolutionLayers<double>();
+template size_t ComputationNetwork::FoldMeanVarNormalization<double>();
+template size_t ComputationNetwork::FoldBatchNormalizationIntoTimes<double>();
+template size_t ComputationNetwork::FoldEmbeddingProjections<double>(double maxGrowth);
+template size_t ComputationNetwork::FoldConstants<double>(const vector<ComputationNodeBasePtr>& keepNodes);
+template size_t ComputationNetwork::PackParameters<double>();
+template uint64_t ComputationNetwork::ParameterChecksum<double>() const;
+template size_t ComputationNetwork::SaveParameterSection<double>(const wstring& fileName) const;
+template bool ComputationNetwork::MapParameterSection<double>(const wstring& fileName, size_t& numMapped);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
+template /*static*/ void ComputationNetwork::SetSampledSoftmaxTraining<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool training);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                       const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
 
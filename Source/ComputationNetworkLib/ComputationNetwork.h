@@ -17,6 +17,7 @@
 #include <string>
 #include <stdexcept>
 #include <list>
+#include <set>
 #include <vector>
 #include <algorithm>
 #include <fstream>
@@ -26,6 +27,8 @@
 #include <regex>
 #include <chrono>
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -45,6 +48,13 @@ public:
     ComputationNetwork()
         : m_randomSeedOffset(0),
           m_isCompiled(false),
+          m_gradientCheckpointing(false),
+          m_concurrentForwardProp(false),
+          m_elementwiseFusion(false),
+          m_skipGapsInLoops(false),
+          m_simpleRNNLoopFusion(false),
+          m_parametersFrozen(false),
+          m_traceLevel(0),
           m_pMBLayout(make_shared<MBLayout>())
     {
     }
@@ -83,7 +93,7 @@ public:
     template <class ElemType>
     void RereadPersistableParameters(const std::wstring& fileName)
     {
-        File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsSequential);
         ReadPersistableParameters<ElemType>(fstream, false);
     }
     // design BUGBUG: binary files do not know whether they are float or double.
@@ -111,12 +121,13 @@ public:
         return net;
     }
 
-    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+    // 'parameterStorage' selects how LearnableParameter values are stored; compact formats trade precision for size
+    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary, ParameterStorage parameterStorage = ParameterStorage::full) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
 private:
 
-    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat, ParameterStorage parameterStorage) const;
 
 public:
 
@@ -128,7 +139,12 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // The gradient of the root is seeded with 'rootGradient' (normally 1; >1 for loss scaling).
+    // If given, 'gradientReadyCallback' is called for each learnable parameter as soon as its gradient is final, i.e. once
+    // all of its consumers have been backpropagated, while the rest of the network is still being processed. This allows
+    // to start aggregating the gradients of the top layers while those of the lower layers are being computed.
+    typedef std::function<void(const ComputationNodeBasePtr&)> GradientReadyCallback;
+    void Backprop(const ComputationNodeBasePtr rootNode, double rootGradient = 1.0, const GradientReadyCallback& gradientReadyCallback = nullptr);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -137,8 +153,14 @@ public:
             ForwardProp(node);
     }
 
+    // version for a set of roots that are needed together, e.g. several outputs that share most of the network
+    // This runs a single plan over all nodes the roots depend on, in the order AllocateAllMatrices() plans for them.
+    // The plan is formed on first use and kept for this set of roots.
+    void ForwardProp(const std::vector<ComputationNodeBasePtr>& rootNodes);
+
     static void BumpEvalTimeStamp(const std::vector<ComputationNodeBasePtr>& nodes);
-    void ResetEvalTimeStamps();
+    // invalidate all m_value fields, except, with frozen parameters, those of the parameter-only nodes (unless 'evenParameterOnlyNodes')
+    void ResetEvalTimeStamps(bool evenParameterOnlyNodes = false);
 
     // and for a set of nodes
     void StartEvaluateMinibatchLoop(const ComputationNodeBasePtr& rootNode) // (ugly name; meant to be unique so we can rename if needed)
@@ -169,9 +191,12 @@ public:
     // prepares the network for computation
     // void BuildAndValidateSubNetwork(const ComputationNodeBasePtr rootNode);
 private:
-    void ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFinalValidationPass, size_t& todo);
+    void ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFinalValidationPass, size_t& todo);
+    size_t ValidateNodesUntilStable(const list<ComputationNodeBasePtr>& nodes);
+    bool ValidateNode(const ComputationNodeBasePtr& node, bool isFinalValidationPass, bool& validated, bool& changed, bool& inputsChanged);
     void ValidateSubNetwork(const ComputationNodeBasePtr& rootNode);
     void MarkValueNonSharableNodes();
+    void MarkParameterOnlyNodes();
 
 private:
     void DetermineSetOfAllRoots();
@@ -184,10 +209,40 @@ private:
     // bool BuiltAndValidatedSubNetwork(const ComputationNodeBasePtr & rootNode);
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // print matrix-pool reuse and resident bytes per device; resident sizes are accurate once a minibatch has been run
+    void PrintMatrixPoolStatistics() { m_matrixPool.PrintStatistics(); }
+    // per-node memory report after AllocateAllMatrices(): planned bytes per sample (perSample), or the actual allocations
+    void PrintMemoryReport(FILE* f, bool perSample);
+    // gradient checkpointing: drop recomputable Values after forward prop and recompute them in backprop
+    // Must be set before AllocateAllMatrices(), which decides which nodes get recomputed.
+    void SetGradientCheckpointing(bool enable) { m_gradientCheckpointing = enable; }
+    // concurrent forward prop: independent CPU nodes are run concurrently, level by level of the dependency graph
+    // Independent recurrent loops (e.g. the two directions of a bidirectional LSTM) are run concurrently on any device,
+    // on GPUs each on its own stream, and also in backprop if they are adjacent in evaluation order.
+    // Like the above, must be set before AllocateAllMatrices(), which then shares memory only across levels.
+    void SetConcurrentForwardProp(bool enable);
+    // elementwise fusion: Plus nodes that feed only a Sigmoid/Tanh/RectifiedLinear node are computed by it in one pass
+    // Also must be set before AllocateAllMatrices(), which decides which nodes are fused.
+    void SetElementwiseFusion(bool enable) { m_elementwiseFusion = enable; }
+    // skip gaps in loops: recurrent loops compute each time step only over the parallel sequences that are not gaps there
+    // Pays off for minibatches of sequences of very different lengths. Can be set at any time.
+    void SetSkipGapsInLoops(bool enable);
+    // simple-RNN loop fusion: loops of the form h = f(x + R * PastValue(h)) with a small hidden dimension run all time steps
+    // of forward prop in one call, on a GPU in one persistent kernel. Backprop still goes step by step. Can be set at any time.
+    void SetSimpleRNNLoopFusion(bool enable);
+    // frozen parameters: nothing changes the parameters anymore (inference), so the nodes computed from parameters only
+    // (e.g. a transposed weight matrix) are computed once, and kept across StartEvaluateMinibatchLoop(). Without this, they
+    // are recomputed only when a parameter's time stamp changes (UpdateWeights()) and after StartEvaluateMinibatchLoop().
+    void SetParametersFrozen(bool enable) { m_parametersFrozen = enable; }
+    // diagnostics of AllocateAllMatrices() (matrix-pool statistics) are printed if > 0
+    void SetTraceLevel(int traceLevel) { m_traceLevel = traceLevel; }
 
 private:
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
+    void PlanMemorySharing(const std::vector<ComputationNodeBasePtr>& compositeForwardPropEvalOrder,
+                           const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                           ComputationNodeBasePtr trainRootNode);
 
 public:
     // -----------------------------------------------------------------------
@@ -196,6 +251,7 @@ public:
 
     void FormNestedNetwork(const ComputationNodeBasePtr& rootNode);
     ComputationNodeBasePtr GetNestedNetwork(const ComputationNodeBasePtr& rootNode);
+    ComputationNodeBasePtr GetNestedNetwork(const std::vector<ComputationNodeBasePtr>& rootNodes);
 
     // The methods below determine evaluation order, which is tricky in presence of recurrent loops.
     // TODO: Can this be moved to a separate class?
@@ -253,6 +309,8 @@ protected:
 
 private:
     static std::shared_ptr<SEQTraversalFlowControlNode> FindInRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const ComputationNodeBasePtr& node);
+    static std::vector<int> DetermineDependencyLevels(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::vector<ComputationNodeBasePtr>& nodes);
+    static std::vector<size_t> DetermineConcurrentLoopRuns(const std::vector<ComputationNodeBasePtr>& nodes, const std::vector<int>& levels);
 
 public:
     // -----------------------------------------------------------------------
@@ -329,6 +387,7 @@ public:
 
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
+    ComputationNetworkPtr CloneSharingParameters() const;
     void CopyInputs(const std::wstring fromName, std::wstring toName);
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
@@ -338,6 +397,7 @@ public:
     void ReplaceFinalCriterionNode(wstring oldNodeName, ComputationNodeBasePtr newNode);
     void AddFeatureNode(ComputationNodeBasePtr featureNode);
     void RemoveFeatureNode(ComputationNodeBasePtr featureNode);
+    void InsertDeviceTransferNodes();
     void SetLearnableNodesBelowNeedGradient(const bool needGradient, const ComputationNodeBasePtr& rootNode = nullptr);
     void SetBatchNormlizationNodesBelowEvalMode(const bool evalMode, const ComputationNodeBasePtr& rootNode = nullptr);
 
@@ -407,6 +467,9 @@ public:
     template <class ElemType>
     static void SetDropoutRate(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 
+    template <class ElemType>
+    static void SetSampledSoftmaxTraining(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool training);
+
     template <class ElemType>
     static void SetSeqParam(ComputationNetworkPtr net,
                             const ComputationNodeBasePtr criterionNode,
@@ -442,6 +505,9 @@ public:
         return iter->second;
     }
 
+    // the learnable parameters in the order in which Backprop() reports their gradients as final (see GradientReadyCallback)
+    std::vector<ComputationNodeBasePtr> LearnableParameterNodesInGradientOrder(const ComputationNodeBasePtr& rootNode);
+
     // these are specified as such by the user
     inline std::vector<ComputationNodeBasePtr>& FeatureNodes()
     {
@@ -557,7 +623,84 @@ public:
     // -----------------------------------------------------------------------
 
     template <class ElemType>
-    void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
+    void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize, bool randomized = false, size_t numPowerIterations = 2);
+
+    // for inference: replace the weights of the Times node 'nodeName' by two low-rank factors, Times(W, x) -> Times(U, Times(V, x)),
+    // computed by truncated SVD; the rank is 'rank' if not 0, else determined by 'keepRatio' as in PerformSVDecomposition().
+    // Returns the rank used.
+    template <class ElemType>
+    size_t FactorizeTimesNode(const wstring& nodeName, size_t rank, float keepRatio, size_t alignedSize = 1);
+
+    // for inference on the CPU: let all Times operations with a LearnableParameter as their left operand use int8 weights
+    // Returns the number of nodes affected. Must be called again if the weights change.
+    template <class ElemType>
+    size_t QuantizeTimesWeightsToInt8();
+
+    // for inference on the CPU: let all Times operations whose left operand is a LearnableParameter with at most 'maxDensity'
+    // non-zero values (e.g. a pruned one) use a sparse copy of it. Returns the number of nodes affected. Takes precedence
+    // over QuantizeTimesWeightsToInt8(). Must be called again if the weights change.
+    template <class ElemType>
+    size_t SparsifyTimesWeights(double maxDensity);
+
+    // for inference: fold Convolution -> [Plus(bias)] -> [BatchNormalization] -> [RectifiedLinear] chains into the
+    // Convolution node, which then adds the bias and applies ReLU itself. Returns the number of chains fused.
+    // The network can no longer be trained or saved afterwards.
+    template <class ElemType>
+    size_t FuseConvolutionLayers();
+
+    // for inference: delete all nodes the given outputs do not depend on, such as criteria and labels, and make the given
+    // nodes the outputs. Parameters are marked as not to be updated, so that no gradients are allocated for them.
+    // Returns the number of nodes deleted.
+    size_t PruneForInference(const std::vector<ComputationNodeBasePtr>& outputNodes);
+
+    // for inference: fold PerDimMeanVarNormalization(x, mean, invStdDev) -> Times(W, .) -> Plus(., b) chains into W and b,
+    // so that the Times operation reads x directly. Returns the number of normalizations folded.
+    template <class ElemType>
+    size_t FoldMeanVarNormalization();
+
+    // for inference: delete all Dropout nodes, which are the identity then, except those that are outputs.
+    // Returns the number of nodes deleted.
+    size_t RemoveDropoutNodes();
+
+    // for inference: fold the running statistics of non-spatial BatchNormalization into a preceding
+    // Times(W, x) -> [Plus(., b)], so that only the Times and a Plus remain. Spatial BatchNormalization following a
+    // Convolution is folded by FuseConvolutionLayers(). Returns the number of BatchNormalization nodes folded.
+    template <class ElemType>
+    size_t FoldBatchNormalizationIntoTimes();
+
+    // for inference: fold Times(W, lookup(E, x)), an embedding lookup (LookupTable, EmbeddingLookup, HashedEmbeddingLookup
+    // or Times with a sparse input) followed by a projection, into one lookup of a table W * E, unless that is more than
+    // 'maxGrowth' times the size of E. Returns the number of projections folded.
+    template <class ElemType>
+    size_t FoldEmbeddingProjections(double maxGrowth = 1.0);
+
+    // graph simplification: merge nodes of the same operation on the same inputs into one, e.g. a Times of the same
+    // weights and input that several branches (macros) compute each. Only operations without attributes, state or
+    // randomness are merged, and not inside loops. The nodes deleted are logged, and their number returned. Node-group
+    // members and 'keepNodes' (which callers hold on to or refer to by name) are kept.
+    size_t MergeIdenticalNodes(const std::vector<ComputationNodeBasePtr>& keepNodes = std::vector<ComputationNodeBasePtr>());
+    // graph simplification: replace the subexpressions that depend only on parameters that are not updated (e.g. all, after
+    // PruneForInference()) by LearnableParameters that hold their values, under the same names. Returns the number replaced.
+    template <class ElemType>
+    size_t FoldConstants(const std::vector<ComputationNodeBasePtr>& keepNodes = std::vector<ComputationNodeBasePtr>());
+
+    // for inference: move the values of all dense parameters and precomputed nodes into one contiguous buffer owned by
+    // the network (and its clones). Returns the number of elements packed. The values cannot be resized afterwards.
+    template <class ElemType>
+    size_t PackParameters();
+
+    // for fast loading: write the values of all dense parameters and precomputed nodes, each aligned, into a separate
+    // file, from which a network loaded from the same model can then map them. On the CPU, the values then point
+    // read-only into the mapped file, whose pages are shared by all processes that map it; on a GPU, they are copied.
+    // The file records the checksum of the values it was written from; MapParameterSection() maps nothing and returns
+    // false if the network's values differ (a stale file, e.g. of an earlier version of the model).
+    // Return the number of values written, resp. mapped.
+    template <class ElemType>
+    size_t SaveParameterSection(const std::wstring& fileName) const;
+    template <class ElemType>
+    bool MapParameterSection(const std::wstring& fileName, size_t& numMapped);
+    template <class ElemType>
+    uint64_t ParameterChecksum() const;
 
     // -----------------------------------------------------------------------
     // construction
@@ -793,13 +936,22 @@ protected:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
         int m_steppingDirection;             // +1 if left to right (t=0..T-1), -1 if rightt to left (t=T-1..0)
+        bool m_skipGaps;                     // per time step, only compute the parallel sequences that are not gaps, see NarrowToNonGapSequences()
+        bool m_fuseSimpleRNN;                // run loops of the form h = f(x + R * PastValue(h)) in one pass, see ForwardPropSimpleRNN()
 
         SEQTraversalFlowControlNode(int loopId, ComputationNodeBasePtr cur)
             : m_loopId(loopId),
-              m_sourceNode(cur)
+              m_sourceNode(cur),
+              m_skipGaps(false),
+              m_fuseSimpleRNN(false)
         {
             SetNodeName(L"Loop_" + m_sourceNode->NodeName());
         }
+
+    private:
+        static bool NarrowToNonGapSequences(FrameRange& fr);
+        template <class ElemType>
+        static bool ForwardPropSimpleRNN(const std::vector<ComputationNodeBasePtr>& nestedNodes);
     };
 
     // -----------------------------------------------------------------------
@@ -827,6 +979,9 @@ protected:
         {
         }
         virtual void ForwardProp(const FrameRange&) override;
+        void ForwardPropConcurrently(const FrameRange&);
+        void BackpropLoopsConcurrently(const FrameRange&, size_t first, size_t last);
+        static DEVICEID_TYPE GetTopLevelNodeDeviceId(const ComputationNodeBasePtr& node);
         virtual void EndForwardProp() override
         {
         }
@@ -852,6 +1007,15 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        bool m_concurrentForwardProp;                                           // if true, ForwardProp() runs m_nestedNodesByLevel[] concurrently
+        std::vector<std::vector<ComputationNodeBasePtr>> m_nestedNodesByLevel; // [level] nodes that only depend on nodes of lower levels
+        std::vector<size_t> m_loopRunBegin;                                     // [i] first of the adjacent independent loops m_nestedNodes[i] is backpropagated together with
+
+        // parameters whose gradients are final once m_nestedNodes[i] has been backpropagated, for GradientReadyCallback
+        const std::vector<std::vector<ComputationNodeBasePtr>>& GetGradientReadyNodes();
+        std::vector<std::vector<ComputationNodeBasePtr>> m_gradientReadyNodes; // [i] (determined on first use)
+        GradientReadyCallback m_gradientReadyCallback;                          // set for the duration of ComputationNetwork::Backprop()
     };
 
 public:
@@ -907,9 +1071,28 @@ private:
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
 
+    bool m_gradientCheckpointing; // recompute cheap Values in backprop instead of holding them, see AllocateAllMatrices()
+    bool m_concurrentForwardProp; // run independent nodes concurrently, see PARTraversalFlowControlNode::ForwardProp()
+    bool m_elementwiseFusion;     // fuse Plus into a subsequent elementwise nonlinearity, see AllocateAllMatrices()
+    bool m_skipGapsInLoops;       // recurrent loops skip gap columns, see SEQTraversalFlowControlNode::NarrowToNonGapSequences()
+    bool m_simpleRNNLoopFusion;   // recurrent loops of a simple form run in one pass, see SEQTraversalFlowControlNode::ForwardPropSimpleRNN()
+    bool m_parametersFrozen;      // parameter-only Values survive ResetEvalTimeStamps(), see SetParametersFrozen()
+    int m_traceLevel;
+
+    std::shared_ptr<void> m_parameterStorage; // memory the parameter values point into, see PackParameters() and MapParameterSection()
+    void DeleteNodesIfUnused(const std::vector<ComputationNodeBasePtr>& nodes);
+    std::set<ComputationNodeBasePtr> NodesToKeep(const std::vector<ComputationNodeBasePtr>& keepNodes);
+    template <class ElemType>
+    std::vector<shared_ptr<ComputationNode<ElemType>>> GetParameterValueNodes() const;
+
+    // layout-specialized execution plans: the tensor slices the nodes of a root use, cached in the nodes
+    std::set<std::vector<size_t>> m_executionPlans; // [signature, see PrepareExecutionPlan()]
+    void PrepareExecutionPlan(const ComputationNodeBasePtr& rootNode);
+
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
+    std::map<std::vector<ComputationNodeBasePtr>, ComputationNodeBasePtr> m_nestedNetworksForSets; // [sorted out nodes] execution plan over the union, see ForwardProp()
 
     // cached quick-access list for inputs and parameters
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_inputValues;         // [out node] -> all input nodes feeding into out node
@@ -281,6 +281,8 @@ void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
                 // TODO: can we prove that 'cur' == nestedNodes.front()? If so, we won't need to store it separately.
                 rInfo.m_nestedNodes = move(nestedNodes); // TODO: make these two part of the constructor
                 rInfo.m_steppingDirection = DetermineLoopDirection(rInfo.m_nestedNodes);
+                rInfo.m_skipGaps = m_skipGapsInLoops;
+                rInfo.m_fuseSimpleRNN = m_simpleRNNLoopFusion;
                 m_allSEQNodes.push_back(make_shared<SEQTraversalFlowControlNode>(move(rInfo)));
                 loopId++; // and count it  TODO: may be removed
             }
@@ -10,6 +10,7 @@
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
 #include "TrainingNodes.h"
+#include "ReshapingNodes.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -94,6 +95,54 @@ void ComputationNetwork::CopySubTree(const ComputationNetwork& fromNet,
     }
 }
 
+// create a network with the same nodes whose LearnableParameters and precomputed statistics share their values with ours
+// This lets several threads evaluate one loaded model at once, each with its own network. All else that the nodes
+// hold, such as activations, recurrent state and the MBLayout, is the clone's own. Neither network may modify the
+// shared values while the other one runs.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters() const
+{
+    auto net = make_shared<ComputationNetwork>(m_deviceId);
+    net->SetRandomSeedOffset(m_randomSeedOffset);
+
+    // create the nodes (we use NewThis() and CopyTo() since we want the nodes under their own names)
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const ComputationNodeBasePtr& fromNode = iter.second;
+        bool isParameter = fromNode->OperationName() == OperationNameOf(LearnableParameter) || fromNode->RequiresPreCompute();
+        int flags = CopyNodeFlags::copyNodeValue | (isParameter ? CopyNodeFlags::copyNodeShareValue : 0);
+        ComputationNodeBasePtr toNode(fromNode->NewThis(fromNode->GetDeviceId(), fromNode->NodeName()));
+        fromNode->CopyTo(toNode, fromNode->NodeName(), (CopyNodeFlags) flags);
+        net->AddNodeToNet(toNode);
+    }
+
+    // connect them the way ours are
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const ComputationNodeBasePtr& fromNode = iter.second;
+        ComputationNodeBasePtr toNode = net->GetNodeFromName(fromNode->NodeName());
+        for (size_t i = 0; i < fromNode->GetNumInputs(); i++)
+            toNode->SetInput(i, net->GetNodeFromName(fromNode->GetInputs()[i]->NodeName()));
+    }
+
+    // and put them into the same node groups
+    auto copyGroup = [&](const vector<ComputationNodeBasePtr>& fromGroup, vector<ComputationNodeBasePtr>& toGroup)
+    {
+        for (const auto& node : fromGroup)
+            toGroup.push_back(net->GetNodeFromName(node->NodeName()));
+    };
+    copyGroup(m_features, net->m_features);
+    copyGroup(m_labels, net->m_labels);
+    copyGroup(m_finalCriteria, net->m_finalCriteria);
+    copyGroup(m_evalNodes, net->m_evalNodes);
+    copyGroup(m_outputNodes, net->m_outputNodes);
+    copyGroup(m_pairNodes, net->m_pairNodes);
+    net->m_parameterStorage = m_parameterStorage; // the shared values may point into it
+    net->m_parametersFrozen = m_parametersFrozen;
+
+    net->CompileNetwork();
+    return net;
+}
+
 // you can only copy inputs from nodes in the same network
 void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring toName)
 {
@@ -298,6 +347,51 @@ void ComputationNetwork::RemoveFeatureNode(ComputationNodeBasePtr featureNode)
     m_nameToNodeMap.erase(nodeName);
 }
 
+// model parallelism: redirect every input that lives on a different device than its consumer through a
+// DeviceTransferNode on the consumer's device. All consumers on the same device share one transfer node.
+void ComputationNetwork::InsertDeviceTransferNodes()
+{
+    // collect the nodes first, since we add to m_nameToNodeMap while going
+    vector<ComputationNodeBasePtr> nodes;
+    for (const auto& iter : m_nameToNodeMap)
+        nodes.push_back(iter.second);
+
+    size_t numInserted = 0;
+    for (const auto& node : nodes)
+    {
+        if (node->OperationName() == OperationNameOf(DeviceTransferNode))
+            continue;
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            ComputationNodeBasePtr input = node->GetInputs()[i];
+            if (!input || input->GetDeviceId() == node->GetDeviceId())
+                continue;
+
+            DEVICEID_TYPE deviceId = node->GetDeviceId();
+            wstring transferNodeName = input->NodeName() + (deviceId < 0 ? wstring(L".toCPU") : L".toGPU" + std::to_wstring(deviceId));
+            ComputationNodeBasePtr transferNode;
+            if (NodeNameExists(transferNodeName))
+                transferNode = GetNodeFromName(transferNodeName);
+            else
+            {
+                if (IsNodePtr<ComputationNode<float>>(input))
+                    transferNode = New<DeviceTransferNode<float>>(deviceId, transferNodeName);
+                else if (IsNodePtr<ComputationNode<double>>(input))
+                    transferNode = New<DeviceTransferNode<double>>(deviceId, transferNodeName);
+                else
+                    LogicError("InsertDeviceTransferNodes: Unexpected element type of node %ls.", input->NodeName().c_str());
+                transferNode->AttachInputs(vector<ComputationNodeBasePtr>{input});
+                AddNodeToNet(transferNode);
+                numInserted++;
+            }
+            node->SetInput(i, transferNode);
+        }
+    }
+
+    if (numInserted > 0)
+        fprintf(stderr, "\nInserted %d DeviceTransfer nodes for edges between nodes on different devices.\n", (int) numInserted);
+}
+
 // sets m_parameterUpdateRequired in all LearnableParameters feeding into the passed rootNode
 // Called from MEL  --TODO: correct?
 void ComputationNetwork::SetLearnableNodesBelowNeedGradient(const bool needGradient, const ComputationNodeBasePtr& rootNode)
@@ -10,12 +10,19 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "CUDAStreamFork.h"
+#include "ExecutionProfiler.h"
+#include "DeviceTransferMonitor.h"
+#include "TimerUtility.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <exception>
 
 using namespace std;
 
@@ -38,15 +45,60 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
+    PrepareExecutionPlan(rootNode);
 
     // traverse all nodes in the pre-determined evaluation order
     GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
 }
 
-// set the gradient matrix of a node to an 1x1 matrix containing 1.0
+void ComputationNetwork::ForwardProp(const std::vector<ComputationNodeBasePtr>& rootNodes)
+{
+    VerifyIsCompiled("ForwardProp");
+
+    // a single root has its own plan
+    if (rootNodes.size() == 1)
+    {
+        for (const auto& node : rootNodes)
+            ForwardProp(node);
+        return;
+    }
+    for (const auto& node : rootNodes)
+        PrepareExecutionPlan(node);
+    GetNestedNetwork(rootNodes)->ForwardProp(FrameRange(nullptr));
+}
+
+// make sure the nodes of a root have the whole-minibatch tensor slices cached that their ForwardProp() and BackpropTo()
+// ask for, so that they need not form them from the sample layout and MBLayout for each minibatch
+// The slices depend on the MBLayouts of the inputs (in frame mode, nearly always the same), so this is done once per
+// such signature. Nodes whose MBLayout is not that of an input, or that changed, form their slices as before.
+// The gaps in the minibatch do not matter for the slices, so they are not part of the signature.
+void ComputationNetwork::PrepareExecutionPlan(const ComputationNodeBasePtr& rootNode)
+{
+    const size_t maxPlans = 8; // more layouts than that will not repeat often enough to pay off
+
+    std::vector<size_t> signature(1, (size_t) rootNode.get());
+    for (const auto& node : InputNodes(rootNode))
+    {
+        const auto& pMBLayout = node->GetMBLayout();
+        signature.push_back((size_t) pMBLayout.get());
+        if (pMBLayout)
+        {
+            signature.push_back(pMBLayout->GetNumParallelSequences());
+            signature.push_back(pMBLayout->GetNumTimeSteps());
+        }
+    }
+    if (m_executionPlans.find(signature) != m_executionPlans.end() || m_executionPlans.size() >= maxPlans)
+        return;
+    m_executionPlans.insert(std::move(signature));
+
+    for (const auto& node : GetEvalOrder(rootNode))
+        node->CacheWholeMinibatchTensorSlices();
+}
+
+// set the gradient matrix of a node to an 1x1 matrix containing 'value' (normally 1.0)
 // Returns false if the node is not a ComputationNode<ElemType>.
 template <class ElemType>
-static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
+static bool SetGradientToScalar(ComputationNodeBasePtr nodep, double value)
 {
     auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
     bool hasMatchingType = (node != nullptr);
@@ -54,7 +106,7 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
     {
         node->Value().VerifySize(1, 1);
         node->Gradient().Resize(1, 1);
-        node->Gradient().SetValue((ElemType) 1.0);
+        node->Gradient().SetValue((ElemType) value);
     }
     return hasMatchingType;
 }
@@ -64,17 +116,44 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, double rootGradient, const GradientReadyCallback& gradientReadyCallback) // training criterion to compute the gradients for
 {
     // reset all gradients to zero (actually, internally, this is lazy, but we don't care here)
     ZeroGradients(rootNode);
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetGradientToScalarOne<float>(rootNode) && !SetGradientToScalarOne<double>(rootNode))
+    // initialize root gradient with a scalar value of 1.0 (or the loss scale)
+    if (!SetGradientToScalar<float>(rootNode, rootGradient) && !SetGradientToScalar<double>(rootNode, rootGradient))
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    nestedNetwork->m_gradientReadyCallback = gradientReadyCallback;
+    try
+    {
+        nestedNetwork->Backprop(FrameRange(nullptr), true, true);
+    }
+    catch (...)
+    {
+        nestedNetwork->m_gradientReadyCallback = nullptr;
+        throw;
+    }
+    nestedNetwork->m_gradientReadyCallback = nullptr;
+}
+
+std::vector<ComputationNodeBasePtr> ComputationNetwork::LearnableParameterNodesInGradientOrder(const ComputationNodeBasePtr& rootNode)
+{
+    auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    const auto& gradientReadyNodes = nestedNetwork->GetGradientReadyNodes();
+    std::vector<ComputationNodeBasePtr> nodes;
+    for (auto iter = gradientReadyNodes.rbegin(); iter != gradientReadyNodes.rend(); iter++) // Backprop() goes backwards
+        nodes.insert(nodes.end(), iter->begin(), iter->end());
+    // parameters that nothing consumes are never reported; they go last
+    for (const auto& node : LearnableParameterNodes(rootNode))
+    {
+        if (std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+            nodes.push_back(node);
+    }
+    return nodes;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -82,7 +161,79 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
-    m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    auto nestedNetwork = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    nestedNetwork->m_concurrentForwardProp = m_concurrentForwardProp;
+    m_nestedNetworks[rootNode] = nestedNetwork;
+}
+
+void ComputationNetwork::SetSkipGapsInLoops(bool enable)
+{
+    m_skipGapsInLoops = enable;
+    for (auto& loop : m_allSEQNodes)
+        loop->m_skipGaps = enable;
+}
+
+void ComputationNetwork::SetSimpleRNNLoopFusion(bool enable)
+{
+    m_simpleRNNLoopFusion = enable;
+    for (auto& loop : m_allSEQNodes)
+        loop->m_fuseSimpleRNN = enable;
+}
+
+void ComputationNetwork::SetConcurrentForwardProp(bool enable)
+{
+    m_concurrentForwardProp = enable;
+    for (auto& iter : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(iter.second)->m_concurrentForwardProp = enable;
+    for (auto& iter : m_nestedNetworksForSets)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(iter.second)->m_concurrentForwardProp = enable;
+}
+
+// determine the dependency level of each node in a list of top-level nodes in evaluation order (loops represented by their SEQTraversalFlowControlNode)
+// A node's level is one more than the highest level of any of its inputs, so that nodes of the same level are independent of each other.
+// This only depends on the inputs of a node, so the levels are the same in each nested network a node is part of.
+/*static*/ std::vector<int> ComputationNetwork::DetermineDependencyLevels(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::vector<ComputationNodeBasePtr>& nodes)
+{
+    std::vector<int> levels;
+    std::unordered_map<ComputationNodeBasePtr, int> levelOf;
+    for (const auto& node : nodes)
+    {
+        auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        const std::vector<ComputationNodeBasePtr>& members = recInfo ? recInfo->m_nestedNodes : std::vector<ComputationNodeBasePtr>(1, node);
+        int level = 0;
+        for (const auto& member : members)
+        {
+            for (const auto& input : member->GetInputs())
+            {
+                ComputationNodeBasePtr key = input;
+                if (input->IsPartOfLoop())
+                    key = FindInRecurrentLoops(recurrentInfo, input);
+                if (key == node)
+                    continue; // dependency inside the loop
+                auto iter = levelOf.find(key);
+                if (iter != levelOf.end())
+                    level = max(level, iter->second + 1);
+            }
+        }
+        levelOf[node] = level;
+        levels.push_back(level);
+    }
+    return levels;
+}
+
+// determine the runs of loops that are adjacent in a list of top-level nodes and of the same dependency level, thus independent
+// Returns for each node the index of the first node of its run (the node's own index if it is not part of such a run).
+// Backprop() runs these concurrently, as it is then guaranteed that all their consumers have been backpropagated before.
+/*static*/ std::vector<size_t> ComputationNetwork::DetermineConcurrentLoopRuns(const std::vector<ComputationNodeBasePtr>& nodes, const std::vector<int>& levels)
+{
+    std::vector<size_t> runBegin(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        bool continuesRun = i > 0 && levels[i] == levels[i - 1] &&
+                            dynamic_pointer_cast<SEQTraversalFlowControlNode>(nodes[i]) && dynamic_pointer_cast<SEQTraversalFlowControlNode>(nodes[i - 1]);
+        runBegin[i] = continuesRun ? runBegin[i - 1] : i;
+    }
+    return runBegin;
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -92,6 +243,34 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
     return m_nestedNetworks[rootNode];
 }
 
+// the plan for a set of roots: the global eval order restricted to the nodes the roots depend on
+// This keeps the members of each loop consecutive, and is the order AllocateAllMatrices() uses for the same roots.
+ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const std::vector<ComputationNodeBasePtr>& rootNodes)
+{
+    std::vector<ComputationNodeBasePtr> key = rootNodes;
+    sort(key.begin(), key.end());
+    key.erase(unique(key.begin(), key.end()), key.end());
+    auto iter = m_nestedNetworksForSets.find(key);
+    if (iter != m_nestedNetworksForSets.end())
+        return iter->second;
+
+    for (const auto& rootNode : key)
+        GetNestedNetwork(rootNode); // verify that all are roots of the compiled network
+    std::list<ComputationNodeBasePtr> nodesForRoots = ComputationNodeBase::EnumerateNodes(key);
+    std::set<ComputationNodeBasePtr> nodesForRootsSet(nodesForRoots.begin(), nodesForRoots.end());
+    std::list<ComputationNodeBasePtr> evalOrder;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        if (nodesForRootsSet.find(node) != nodesForRootsSet.end())
+            evalOrder.push_back(node);
+    }
+
+    auto nestedNetwork = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, evalOrder);
+    nestedNetwork->m_concurrentForwardProp = m_concurrentForwardProp;
+    m_nestedNetworksForSets[key] = nestedNetwork;
+    return nestedNetwork;
+}
+
 // -----------------------------------------------------------------------
 // PARTraversalFlowControlNode methods -- implements PAR traversal
 //
@@ -124,9 +303,50 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             nodeIter++; // and consume this node
         }
     }
+
+    // group the nodes by dependency level, for concurrent execution
+    m_concurrentForwardProp = false;
+    std::vector<int> levels = DetermineDependencyLevels(recurrentInfo, m_nestedNodes);
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        if (m_nestedNodesByLevel.size() <= levels[i])
+            m_nestedNodesByLevel.resize(levels[i] + 1);
+        m_nestedNodesByLevel[levels[i]].push_back(m_nestedNodes[i]);
+    }
+    m_loopRunBegin = DetermineConcurrentLoopRuns(m_nestedNodes, levels);
+}
+
+// the device a top-level node runs on
+/*static*/ DEVICEID_TYPE ComputationNetwork::PARTraversalFlowControlNode::GetTopLevelNodeDeviceId(const ComputationNodeBasePtr& node)
+{
+    auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+    return recInfo ? recInfo->m_sourceNode->GetDeviceId() : node->GetDeviceId();
+}
+
+static void ForwardPropTopLevelNode(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    // elementwise fusion: the consumer computes from our inputs, so we just mark ourselves as up to date
+    if (node->IsValueComputedByConsumer())
+    {
+        node->BumpEvalTimeStamp();
+        return;
+    }
+
+    {
+        ExecutionProfiler::Scope profilerScope(node->NodeName(), "forward"); // (a recurrent loop is timed as a whole)
+        DeviceTransferMonitor::Scope transferScope(node->NodeName());
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+
+    node->BumpEvalTimeStamp();
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    if (m_concurrentForwardProp)
+        return ForwardPropConcurrently(fr);
+
     for (auto& node : m_nestedNodes)
     {
         if (node->IsOutputOlderThanInputs())
@@ -135,12 +355,61 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             if (recInfo)
                 assert(recInfo->m_sourceNode->GetMBLayout() == node->GetMBLayout());
 
-            node->BeginForwardProp();
-            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
+            ForwardPropTopLevelNode(node, fr);
+        }
+    }
+}
 
-            node->BumpEvalTimeStamp();
+// same as ForwardProp(), but level by level, where the CPU nodes and the loops of a level are run concurrently
+// Other GPU nodes are run sequentially within their level. Since the nodes themselves use OpenMP,
+// this helps mostly for networks of many small operations, which is why it is optional.
+// Loops on a GPU each get their own stream. Loops are latency bound (one small step after another), so e.g.
+// the two directions of a bidirectional LSTM take about as long as one.
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropConcurrently(const FrameRange& fr)
+{
+    for (auto& levelNodes : m_nestedNodesByLevel)
+    {
+        std::vector<ComputationNodeBasePtr> concurrentNodes;
+        DEVICEID_TYPE streamDeviceId = CPUDEVICE; // the GPU of the concurrent loops, if any
+        for (auto& node : levelNodes)
+        {
+            if (!node->IsOutputOlderThanInputs())
+                continue;
+            bool isLoop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node) != nullptr;
+            if (levelNodes.size() > 1 && (isLoop || node->GetDeviceId() == CPUDEVICE))
+            {
+                if (isLoop && GetTopLevelNodeDeviceId(node) != CPUDEVICE)
+                    streamDeviceId = GetTopLevelNodeDeviceId(node);
+                // the validity mask is lazily created by the first node that needs it; do it now while we are still single-threaded
+                if (node->HasMBLayout() && node->GetMBLayout()->HasGaps())
+                    node->GetMBLayout()->GetColumnsValidityMask(node->GetDeviceId());
+                concurrentNodes.push_back(node);
+            }
+            else
+                ForwardPropTopLevelNode(node, fr);
+        }
+
+        // exceptions must not leave an OpenMP region, so we pass the first one on after the loop
+        std::exception_ptr firstException;
+        CUDAStreamFork fork(streamDeviceId, concurrentNodes.size());
+#pragma omp parallel for schedule(dynamic, 1) if (concurrentNodes.size() > 1)
+        for (int i = 0; i < (int) concurrentNodes.size(); i++)
+        {
+            try
+            {
+                CUDAStreamFork::BranchScope branch(fork, i);
+                ForwardPropTopLevelNode(concurrentNodes[i], fr);
+            }
+            catch (...)
+            {
+#pragma omp critical
+                if (!firstException)
+                    firstException = std::current_exception();
+            }
         }
+        fork.Join();
+        if (firstException)
+            std::rethrow_exception(firstException);
     }
 }
 
@@ -148,15 +417,158 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
     // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    for (size_t i = m_nestedNodes.size(); i-- > 0;) // iterate backwards over evaluation order
     {
-        auto& node = *pnode;
+        // independent loops that are adjacent in evaluation order are run together
+        if (m_concurrentForwardProp && m_loopRunBegin[i] < i)
+        {
+            BackpropLoopsConcurrently(fr, m_loopRunBegin[i], i);
+            i = m_loopRunBegin[i];
+            continue;
+        }
+
+        auto& node = m_nestedNodes[i];
+
+        // gradient checkpointing: bring back dropped input Values right before their first consumer needs them
+        // Intermediates (inputs whose Values were not held either) are recomputed first and dropped again right after.
+        for (auto& input : node->GetInputs())
+        {
+            if (input->m_recomputeValueInBackprop && !input->m_valueRecomputed)
+            {
+                std::vector<ComputationNodeBasePtr> intermediates;
+                std::function<void(const ComputationNodeBasePtr&)> recomputeIntermediates = [&](const ComputationNodeBasePtr& consumer)
+                {
+                    for (auto& intermediate : consumer->GetInputs())
+                    {
+                        if (!intermediate->m_recomputeValueWithConsumer || find(intermediates.begin(), intermediates.end(), intermediate) != intermediates.end())
+                            continue;
+                        recomputeIntermediates(intermediate);
+                        intermediate->RecomputeValueForBackprop(fr.WithLayout(intermediate->GetMBLayout()));
+                        intermediates.push_back(intermediate);
+                    }
+                };
+                recomputeIntermediates(input);
+                input->RecomputeValueForBackprop(fr.WithLayout(input->GetMBLayout()));
+                input->m_valueRecomputed = true;
+                for (auto& intermediate : intermediates)
+                    intermediate->RestoreValueAfterBackprop();
+            }
+        }
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        {
+            ExecutionProfiler::Scope profilerScope(node->NodeName(), "backward");
+            DeviceTransferMonitor::Scope transferScope(node->NodeName());
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+        }
+
+        // the recomputed Value has served its purpose; the forward-prop buffer goes back in place for the next minibatch
+        if (node->m_valueRecomputed)
+        {
+            node->RestoreValueAfterBackprop();
+            node->m_valueRecomputed = false;
+        }
+
+        // report the parameters whose last consumer this was
+        if (m_gradientReadyCallback)
+        {
+            for (const auto& parameter : GetGradientReadyNodes()[i])
+                m_gradientReadyCallback(parameter);
+        }
     }
 }
+
+// backprop the loops m_nestedNodes[first..last] concurrently, see DetermineConcurrentLoopRuns()
+// Only the iterations through time run concurrently. They only touch gradients inside their own loop; the gradients
+// into nodes outside the loop, which independent loops may share (e.g. the input of a bidirectional LSTM), are
+// computed afterwards in EndBackprop(), one loop after another.
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropLoopsConcurrently(const FrameRange& fr, size_t first, size_t last)
+{
+    DEVICEID_TYPE deviceId = GetTopLevelNodeDeviceId(m_nestedNodes[last]);
+    for (size_t i = first; i <= last; i++)
+    {
+        // the validity mask is lazily created by the first node that needs it; do it now while we are still single-threaded
+        if (m_nestedNodes[i]->HasMBLayout() && m_nestedNodes[i]->GetMBLayout()->HasGaps())
+            m_nestedNodes[i]->GetMBLayout()->GetColumnsValidityMask(deviceId);
+    }
+
+    // exceptions must not leave an OpenMP region, so we pass the first one on after the loop
+    std::exception_ptr firstException;
+    CUDAStreamFork fork(deviceId, last - first + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k <= (int) (last - first); k++)
+    {
+        try
+        {
+            CUDAStreamFork::BranchScope branch(fork, k);
+            auto& node = m_nestedNodes[last - k];
+            ExecutionProfiler::Scope profilerScope(node->NodeName(), "backward");
+            DeviceTransferMonitor::Scope transferScope(node->NodeName());
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!firstException)
+                firstException = std::current_exception();
+        }
+    }
+    fork.Join();
+    if (firstException)
+        std::rethrow_exception(firstException);
+
+    for (size_t i = last + 1; i-- > first;)
+    {
+        {
+            ExecutionProfiler::Scope profilerScope(m_nestedNodes[i]->NodeName(), "backward");
+            DeviceTransferMonitor::Scope transferScope(m_nestedNodes[i]->NodeName());
+            m_nestedNodes[i]->EndBackprop();
+        }
+        if (m_gradientReadyCallback)
+        {
+            for (const auto& parameter : GetGradientReadyNodes()[i])
+                m_gradientReadyCallback(parameter);
+        }
+    }
+}
+
+// determine, for each top-level node, the learnable parameters whose gradients are final once it has been backpropagated
+// Backprop() goes backwards over the evaluation order, so that is the parameter's consumer that comes first in evaluation order.
+// (A consumer inside a loop counts as the loop.)
+const std::vector<std::vector<ComputationNodeBasePtr>>& ComputationNetwork::PARTraversalFlowControlNode::GetGradientReadyNodes()
+{
+    if (m_gradientReadyNodes.size() == m_nestedNodes.size())
+        return m_gradientReadyNodes;
+
+    auto isParameter = [](const ComputationNodeBasePtr& node)
+    {
+        return node->GetNumInputs() == 0 && node->IsParameterUpdateRequired();
+    };
+    std::unordered_map<ComputationNodeBasePtr, size_t> firstConsumer;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        const std::vector<ComputationNodeBasePtr>& members = recInfo ? recInfo->m_nestedNodes : std::vector<ComputationNodeBasePtr>(1, m_nestedNodes[i]);
+        for (const auto& member : members)
+        {
+            for (const auto& input : member->GetInputs())
+            {
+                if (isParameter(input) && firstConsumer.find(input) == firstConsumer.end())
+                    firstConsumer[input] = i;
+            }
+        }
+    }
+    m_gradientReadyNodes.assign(m_nestedNodes.size(), std::vector<ComputationNodeBasePtr>());
+    for (const auto& node : m_nestedNodes)
+    {
+        auto iter = firstConsumer.find(node);
+        if (iter != firstConsumer.end())
+            m_gradientReadyNodes[iter->second].push_back(node);
+    }
+    return m_gradientReadyNodes;
+}
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -210,15 +622,118 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     // for every time step run through all nodes in this particular loop (treat the loop like a little ComputationNetwork)
     // Note: Currently, this is limited to linear-time loops. But nothing stops the iteration below to, e.g., be a 2D iteration over an image
     // if we implement an according FrameRangeIteration.
+    // simple recurrences can run all time steps in a single call
+    if (m_fuseSimpleRNN && (ForwardPropSimpleRNN<float>(m_nestedNodes) || ForwardPropSimpleRNN<double>(m_nestedNodes)))
+    {
+        for (auto& node : m_nestedNodes)
+            node->BumpEvalTimeStamp();
+        return;
+    }
+
     FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
     for (auto t = range.begin(); t != range.end(); t++)
     {
+        FrameRange fr = t;
+        if (m_skipGaps && !NarrowToNonGapSequences(fr))
+            continue;
         for (auto& node : m_nestedNodes)
         {
-            node->ForwardProp(t);
+            node->ForwardProp(fr);
             node->BumpEvalTimeStamp();
         }
     }
+
+    // the skipped gap columns hold whatever was in the matrices before; flatten them so that nodes outside the loop see no garbage
+    if (m_skipGaps && GetMBLayout()->HasGaps())
+    {
+        for (auto& node : m_nestedNodes)
+            node->MaskMissingValueColumnsToZero(FrameRange(GetMBLayout()));
+    }
+}
+
+// run a loop of the form h = f(x + R * PastValue(h)) (or FutureValue) over all frames in one pass, see Matrix::SimpleRNNForward()
+// with f = Sigmoid, Tanh or RectifiedLinear, R a [H x H] matrix and x an input from outside the loop with the loop's layout.
+// All four nodes get their Values as if they had been run step by step, so that Backprop() is unaffected.
+// Returns false if the loop is not of this form (or not of this ElemType), and then does nothing.
+template <class ElemType>
+/*static*/ bool ComputationNetwork::SEQTraversalFlowControlNode::ForwardPropSimpleRNN(const std::vector<ComputationNodeBasePtr>& nestedNodes)
+{
+    if (nestedNodes.size() != 4)
+        return false;
+    auto isInLoop = [&](const ComputationNodeBasePtr& node)
+    {
+        return std::find(nestedNodes.begin(), nestedNodes.end(), node) != nestedNodes.end();
+    };
+    for (auto& node : nestedNodes)
+    {
+        auto past = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+        auto future = dynamic_pointer_cast<FutureValueNode<ElemType>>(node);
+        if (!past && !future)
+            continue;
+        ComputationNodeBasePtr delay = node;
+
+        // match the pattern backwards from the delay node
+        auto nonlinearity = delay->GetInputs()[0];
+        ElementWiseOperator op;
+        if (nonlinearity->OperationName() == OperationNameOf(SigmoidNode))
+            op = ElementWiseOperator::opSigmoid;
+        else if (nonlinearity->OperationName() == OperationNameOf(TanhNode))
+            op = ElementWiseOperator::opTanh;
+        else if (nonlinearity->OperationName() == OperationNameOf(RectifiedLinearNode))
+            op = ElementWiseOperator::opLinearRectifier;
+        else
+            return false;
+        auto plus = nonlinearity->GetInputs()[0];
+        if (plus->OperationName() != OperationNameOf(PlusNode) || !isInLoop(plus))
+            return false;
+        bool timesFirst = isInLoop(plus->GetInputs()[0]);
+        auto times = plus->GetInputs()[timesFirst ? 0 : 1];
+        auto x = plus->GetInputs()[timesFirst ? 1 : 0];
+        if (times->OperationName() != OperationNameOf(TimesNode) || isInLoop(x) || times->GetInputs()[1] != delay)
+            return false;
+        auto R = times->GetInputs()[0];
+        const size_t H = delay->GetSampleMatrixNumRows();
+        if (R->HasMBLayout() || R->GetAsMatrixNumRows() != H || R->GetAsMatrixNumCols() != H ||
+            x->GetMBLayout() != delay->GetMBLayout() || x->GetSampleMatrixNumRows() != H ||
+            !Matrix<ElemType>::IsSimpleRNNForwardSupported(delay->GetDeviceId(), H))
+            return false;
+
+        Matrix<ElemType> hStart(delay->GetDeviceId());
+        Matrix<ElemType> continues(delay->GetDeviceId());
+        bool supported = past ? past->GetBoundaryConditions(hStart, continues) : future->GetBoundaryConditions(hStart, continues);
+        if (!supported)
+            return false;
+        auto valueOf = [](const ComputationNodeBasePtr& node) -> Matrix<ElemType>&
+        {
+            return dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        };
+        Matrix<ElemType>::SimpleRNNForward(valueOf(R), valueOf(x), hStart, continues,
+                                           past ? past->GetInitialActivationValue() : future->GetInitialActivationValue(), op, /*reverse=*/!past,
+                                           valueOf(delay), valueOf(times), valueOf(plus), valueOf(nonlinearity));
+        return true;
+    }
+    return false;
+}
+
+// narrow a time step to the range of parallel sequences from the first to the last one that is not a gap
+// Returns false if all parallel sequences are gaps at this time step, which then needs no computation at all.
+// Readers that assign long sequences to the first parallel sequences get the most out of this.
+/*static*/ bool ComputationNetwork::SEQTraversalFlowControlNode::NarrowToNonGapSequences(FrameRange& fr)
+{
+    const auto& pMBLayout = fr.m_pMBLayout;
+    if (!pMBLayout->IsGap(fr)) // common case: no gaps at all in this time step
+        return true;
+    size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    size_t begin = 0, end = numParallelSequences;
+    while (begin < end && pMBLayout->IsGap(fr.Sequence(begin)))
+        begin++;
+    while (end > begin && pMBLayout->IsGap(fr.Sequence(end - 1)))
+        end--;
+    if (begin == end)
+        return false;
+    if (end - begin < numParallelSequences)
+        fr = fr.Sequences(begin, end - begin);
+    return true;
 }
 
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndForwardProp() /*override*/
@@ -243,10 +758,13 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     FrameRangeIteration range(pMBLayout, m_steppingDirection);
     for (auto t = range.rbegin(); t != range.rend(); t++) // note: reverse iteration
     {
+        FrameRange fr = t;
+        if (m_skipGaps && !NarrowToNonGapSequences(fr))
+            continue;
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
-            node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
+            node2->Backprop(fr, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
         }
@@ -302,7 +820,10 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*static*/ shared_ptr<ComputationNetwork::SEQTraversalFlowControlNode> ComputationNetwork::FindInRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const ComputationNodeBasePtr& node)
 {
     // look in all recurrent loops of the network
-    // TODO: Check for IsPartOfLoop(). Also why not store the loop id in the node for direct lookup?
+    // Nodes outside loops are the common case; searching all loops for each would make the callers quadratic in large unrolled networks.
+    // TODO: Why not store the loop id in the node for direct lookup?
+    if (!node->IsPartOfLoop())
+        return nullptr;
     for (auto& iter : recurrentInfo)
         if (std::find(iter->m_nestedNodes.begin(), iter->m_nestedNodes.end(), node) != iter->m_nestedNodes.end()) // TODO: should this loop need to be a method of SEQTraversalFlowControlNode?
             return iter;
@@ -326,10 +847,15 @@ bool ComputationNetwork::SEQTraversalFlowControlNode::IsOutputOlderThanInputs()
 }
 
 // TODO: do this on PARTraversalFlowControlNode
-void ComputationNetwork::ResetEvalTimeStamps()
+// With frozen parameters, a parameter-only node, once computed, is left newer than its inputs, so it is not computed again.
+void ComputationNetwork::ResetEvalTimeStamps(bool evenParameterOnlyNodes)
 {
+    bool keepParameterOnlyNodes = m_parametersFrozen && !evenParameterOnlyNodes;
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
-        nodeIter->second->ResetEvalTimeStamp();
+    {
+        if (!keepParameterOnlyNodes || !nodeIter->second->IsParameterOnly())
+            nodeIter->second->ResetEvalTimeStamp();
+    }
 }
 
 /*static*/ void ComputationNetwork::BumpEvalTimeStamp(const vector<ComputationNodeBasePtr>& nodes)
@@ -373,6 +899,8 @@ void ComputationNetwork::InvalidateCompiledNetwork()
     m_allSEQNodes.clear();
     m_evalOrders.clear();
     m_nestedNetworks.clear();
+    m_nestedNetworksForSets.clear();
+    m_executionPlans.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
 }
@@ -390,12 +918,26 @@ void ComputationNetwork::VerifyIsCompiled(const char* where) const
 // TODO: This should be the only entry point, subsuming all other Validate, Build, etc. functions.
 // TODO: Related functions today do lots of stuff lazily. There are redundant calls. That will all be removed.
 // TODO: This is in a somewhat partial state in that we now have a global eval order (keyed by a nullptr), but don't use it yet.
+// log the time a step of CompileNetwork() took, and start timing the next one
+static void LogCompileStepTime(Timer& timer, const char* step)
+{
+    timer.Stop();
+    fprintf(stderr, "CompileNetwork: %s took %.3f seconds.\n", step, timer.ElapsedSeconds());
+    timer.Restart();
+}
+
 void ComputationNetwork::CompileNetwork()
 {
     fprintf(stderr, "\nPost-processing network...\n");
+    Timer timer;
+    timer.Start();
+
+    // STEP: Cut edges between nodes that were placed on different devices (model parallelism).
+    InsertDeviceTransferNodes();
 
     // all steps below have to be repeated for all root nodes (=nodes without parents and PreComputeNodes)
     DetermineSetOfAllRoots();
+    LogCompileStepTime(timer, "determining the roots");
 
     fprintf(stderr, "\n%d roots:\n", (int) m_allRoots.size());
     for (const auto& root : m_allRoots)
@@ -413,26 +955,32 @@ void ComputationNetwork::CompileNetwork()
     // STEP: form the m_inputValues and m_learnableParameters sets for this rootNode
     for (const auto& root : m_allRoots)
         CollectInputAndLearnableParameters(root);
+    LogCompileStepTime(timer, "forming the evaluation orders");
 
     // STEP: Discover nested loops.
     FormRecurrentLoops(nullptr); // form the global one
     for (auto& node : m_allRoots)
         FormRecurrentLoops(node);
+    LogCompileStepTime(timer, "forming the recurrent loops");
 
     // STEP: Form nested structure of PAR and SEQ traversal nodes.
+    // FormRecurrentLoops() has already done this for the roots, from their final eval orders; the loops it may still
+    // have updated afterwards are referenced, not copied, so these need not be formed again.
     for (auto& node : m_allRoots)
-        FormNestedNetwork(node);
+        if (m_nestedNetworks.find(node) == m_nestedNetworks.end())
+            FormNestedNetwork(node);
 
     // STEP: Infer node dimensions.
     // This leverages the nested structure.  TODO: ... one day
     for (auto& node : m_allRoots)
         ValidateSubNetwork(node);
+    LogCompileStepTime(timer, "validation");
 
     // STEP: Optimize the network.
-    // :)
+    MarkParameterOnlyNodes();
 
     // STEP: Some final details.
-    ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
+    ResetEvalTimeStamps(/*evenParameterOnlyNodes=*/true); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
 
     fprintf(stderr, "\nPost-processing network complete.\n");
     m_isCompiled = true;
@@ -521,18 +1069,13 @@ void ComputationNetwork::ValidateSubNetwork(const ComputationNodeBasePtr& rootNo
     // loop and validate until we are done
     // steps:
     //  - validate (not final)          // not final means no dimension checks
-    //    Keep going through the list until all nodes have been validated and all inputs have been validated as well.
+    //    Keep going until all nodes have been validated and all inputs have been validated as well.
     //  - validate (final)              // final means consistency checks
     //    Fail if any change during this stage.
-    size_t pass = 0;
-    size_t toValidate = nodes.size();
-    while (toValidate > 0)
-    {
-        pass++;
-        fprintf(stderr, "\n\nValidating for node %ls. %d nodes to process in pass %d.\n", rootNode->NodeName().c_str(), (int) toValidate, (int) pass);
-        ValidateNodes(nodes, false /*isFinalValidationPass*/, toValidate);
-    }
-    fprintf(stderr, "\n\nValidating for node %ls, final verification.\n", rootNode->NodeName().c_str());
+    fprintf(stderr, "\n\nValidating for node %ls. %d nodes to process.\n", rootNode->NodeName().c_str(), (int) nodes.size());
+    size_t numValidations = ValidateNodesUntilStable(nodes);
+    fprintf(stderr, "\n\nValidating for node %ls, final verification (after %d validations).\n", rootNode->NodeName().c_str(), (int) numValidations);
+    size_t toValidate;
     ValidateNodes(nodes, true /*isFinalValidationPass*/, toValidate);
     if (toValidate != 0)
         LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
@@ -576,122 +1119,167 @@ static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
     return make_pair(node->GetSampleLayout(), node->HasMBLayout());
 }
 
-void ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFinalValidationPass, size_t& todo)
+// validate a single node, if it is a leaf or at least one of its inputs has been validated
+// Returns whether the node is valid, i.e. it is a leaf, or all its inputs have been validated and nothing changed.
+// 'validated' tells whether Validate() was called; 'changed' whether that changed the node (or it was validated for
+// the first time), and 'inputsChanged' whether it changed any of its inputs (dimension inference into inputs).
+bool ComputationNetwork::ValidateNode(const ComputationNodeBasePtr& node, bool isFinalValidationPass, bool& validated, bool& changed, bool& inputsChanged)
+{
+    validated = changed = inputsChanged = false;
+    const auto& children = node->GetInputs();
+    const bool isLeaf = node->IsLeaf();
+    // only validate a node if it has at least one child
+    bool hasVisitedChild = false;
+    bool allChildrenVisited = true;
+    for (auto& child : children)
+    {
+        hasVisitedChild |= child->m_visited; // if not a single visited child then no point in validating
+        allChildrenVisited &= child->m_visited;
+    }
+    // if there is not at least one visited child
+    if (!hasVisitedChild && !isLeaf)
+        return false;
+
+    // got at least one child: it makes sense to call Validate()
+    // keep state
+    MBLayoutPtr oldMBLayoutPtr = node->GetMBLayout();
+    auto dim = GetDims(node);
+    vector<pair<TensorShape, bool>> childDims;
+    for (auto& child : children)
+        childDims.push_back(GetDims(child));
+    auto sampleLayout = node->GetSampleLayout();
+    bool wasVisited = node->m_visited;
+    // We do call validate(final) as many times as needed, since stuff may have changed underneath.
+    node->PrintSelfBeforeValidation();
+    node->Validate(isFinalValidationPass /*final*/); // all nodes have been visited: do verification instead of just inference
+    fprintf(stderr, " -> [%s%s]", string(node->GetSampleLayout()).c_str(), node->HasMBLayout() ? " x *" : "");
+    node->m_visited = true;
+    validated = true;
+    // also take the opportunity to propagate m_needsGradient
+    auto needsGradient = node->m_needsGradient;
+    for (auto& child : children) // TODO: do we need a check that this is stable if isFinalValidationPass?
+        node->m_needsGradient |= child->m_needsGradient;
+    // check state --node will be valid if all nodes have been visited and node has not been updated
+    bool unchanged = true;
+    unchanged &= (oldMBLayoutPtr == node->GetMBLayout());
+    unchanged &= (dim == GetDims(node));
+    unchanged &= (sampleLayout == node->GetSampleLayout());
+    unchanged &= (needsGradient == node->m_needsGradient);
+    vector<pair<TensorShape, bool>> newChildDims;
+    for (auto& child : children)
+        newChildDims.push_back(GetDims(child));
+    inputsChanged = (childDims != newChildDims);
+    changed = !unchanged || !wasVisited;
+    unchanged &= !inputsChanged;
+    if (isFinalValidationPass && !unchanged)
+        LogicError("ValidateSubNetwork: %ls %ls operation changed during final validation.", node->NodeName().c_str(), node->OperationName().c_str());
+    if (isFinalValidationPass && !allChildrenVisited)
+        LogicError("ValidateSubNetwork: %ls %ls operation in final validation although not all children were visited?", node->NodeName().c_str(), node->OperationName().c_str());
+    // if all children valid then
+    return (allChildrenVisited && unchanged) || isLeaf;
+}
+
+void ComputationNetwork::ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFinalValidationPass, size_t& todo)
 {
     todo = 0; // returns how many nodes are to be redone
     for (auto& node : nodes)
     {
-        const auto& children = node->GetInputs();
-        const bool isLeaf = node->IsLeaf();
-        // only validate a node if it has at least one child
-        bool hasVisitedChild = false;
-        bool allChildrenVisited = true;
-        for (auto& child : children)
-        {
-            hasVisitedChild |= child->m_visited; // if not a single visited child then no point in validating
-            allChildrenVisited &= child->m_visited;
-        }
-        // if there is not at least one visited child
-        bool valid = false;
-        if (hasVisitedChild || isLeaf)
-        {
-            // got at least one child: it makes sense to call Validate()
-            // keep state
-            MBLayoutPtr oldMBLayoutPtr = node->GetMBLayout();
-            auto dim = GetDims(node);
-            vector<pair<TensorShape, bool>> childDims;
-            for (auto& child : children)
-                childDims.push_back(GetDims(child));
-            auto sampleLayout = node->GetSampleLayout();
-            // We do call validate(final) as many times as needed, since stuff may have changed underneath.
-            node->PrintSelfBeforeValidation();
-            node->Validate(isFinalValidationPass /*final*/); // all nodes have been visited: do verification instead of just inference
-            fprintf(stderr, " -> [%s%s]", string(node->GetSampleLayout()).c_str(), node->HasMBLayout() ? " x *" : "");
-            node->m_visited = true;
-            // also take the opportunity to propagate m_needsGradient
-            auto needsGradient = node->m_needsGradient;
-            for (auto& child : children) // TODO: do we need a check that this is stable if isFinalValidationPass?
-                node->m_needsGradient |= child->m_needsGradient;
-            // check state --node will be valid if all nodes have been visited and node has not been updated
-            bool unchanged = true;
-            unchanged &= (oldMBLayoutPtr == node->GetMBLayout());
-            unchanged &= (dim == GetDims(node));
-            vector<pair<TensorShape, bool>> newChildDims;
-            for (auto& child : children)
-                newChildDims.push_back(GetDims(child));
-            unchanged &= (childDims == newChildDims);
-            unchanged &= (sampleLayout == node->GetSampleLayout());
-            unchanged &= (needsGradient == node->m_needsGradient);
-            if (isFinalValidationPass && !unchanged)
-                LogicError("ValidateSubNetwork: %ls %ls operation changed during final validation.", node->NodeName().c_str(), node->OperationName().c_str());
-            if (isFinalValidationPass && !allChildrenVisited)
-                LogicError("ValidateSubNetwork: %ls %ls operation in final validation although not all children were visited?", node->NodeName().c_str(), node->OperationName().c_str());
-            // if all children valid then
-            valid = (allChildrenVisited && unchanged) || isLeaf;
-        }
+        bool validated, changed, inputsChanged;
         // count those that we need to redo
-        if (!valid)
+        if (!ValidateNode(node, isFinalValidationPass, validated, changed, inputsChanged))
             todo++;
     }
 }
 
-// -----------------------------------------------------------------------
-// memory allocation
-// -----------------------------------------------------------------------
-// mark nodes that are purely induced by parameters as non-sharable and create space for value if null
-void ComputationNetwork::MarkValueNonSharableNodes()
+// non-final validation of 'nodes' (in evaluation order), driven by a worklist instead of passes over all nodes
+// A node is validated again only if something it depends on changed: an input was validated for the first time or
+// changed, or a consumer inferred new dimensions into the node (then the consumer is revisited after it). Validate()
+// depends only on the inputs, so a node whose inputs did not change is stable; the final pass verifies that.
+// The worklist is ordered by evaluation order, so each node sees its inputs' latest state; only inputs that come
+// later in the order (loops) lead to revisits. Returns the number of Validate() calls.
+size_t ComputationNetwork::ValidateNodesUntilStable(const list<ComputationNodeBasePtr>& nodes)
 {
-    const auto& nodes = GetEvalOrder(nullptr);
-    std::map<wstring, bool> allLeafDescendentsAreParameters;
-    std::list<ComputationNodeBasePtr> allLearnableParameters = GetNodesWithType(OperationNameOf(LearnableParameter));
-    // note that: we cannot use m_learnableParameters because we need all parameters node, regardless whether it requires update or not
-
-    for (auto& node : nodes)
+    vector<ComputationNodeBasePtr> order(nodes.begin(), nodes.end());
+    unordered_map<ComputationNodeBasePtr, size_t> positionOf;
+    for (size_t i = 0; i < order.size(); i++)
+        positionOf[order[i]] = i;
+    vector<vector<size_t>> inputsOf(order.size()), consumersOf(order.size()); // positions, restricted to 'nodes'
+    for (size_t i = 0; i < order.size(); i++)
     {
-        auto children = node->GetInputs();
-        wstring myname = node->NodeName();
-        bool allParameters = true;
+        for (const auto& input : order[i]->GetInputs())
+        {
+            auto iter = positionOf.find(input);
+            if (iter == positionOf.end())
+                continue;
+            inputsOf[i].push_back(iter->second);
+            consumersOf[iter->second].push_back(i);
+        }
+    }
 
-        if (children.size()) // we don't do the check for leaf node, cause all the possible leaf nodes (input/parameters/precompute node) are marked as non-sharable already
+    set<size_t> pending; // positions; ordered, so that the worklist is processed in evaluation order
+    for (size_t i = 0; i < order.size(); i++)
+        pending.insert(pending.end(), i);
+    size_t numValidations = 0;
+    while (!pending.empty())
+    {
+        size_t i = *pending.begin();
+        pending.erase(pending.begin());
+        bool validated, changed, inputsChanged;
+        ValidateNode(order[i], false /*isFinalValidationPass*/, validated, changed, inputsChanged);
+        if (!validated)
+            continue; // no input validated yet; it is queued again once one is
+        numValidations++;
+        if (changed)
+            pending.insert(consumersOf[i].begin(), consumersOf[i].end());
+        if (inputsChanged) // (this includes ourselves, to check against the changed inputs)
         {
-            for (auto child : children)
+            for (auto input : inputsOf[i])
             {
-                wstring ChildName = child->NodeName();
-                if (allLeafDescendentsAreParameters.find(ChildName) == allLeafDescendentsAreParameters.end())
-                {
-                    // not found, means it is a leaf node (we are at eval order )
-                    assert(child->IsLeaf() || child->IsPartOfLoop());
-                    if (std::find(allLearnableParameters.begin(), allLearnableParameters.end(), child) != allLearnableParameters.end())
-                    {
-                        allLeafDescendentsAreParameters[ChildName] = true;
-                    }
-                    else
-                    {
-                        allParameters = false;
-                        allLeafDescendentsAreParameters[ChildName] = false;
-                        break;
-                    }
-                }
-                else
-                {
-                    if (allLeafDescendentsAreParameters[ChildName] == false)
-                    {
-                        allParameters = false;
-                        break;
-                    }
-                }
-            }
-            allLeafDescendentsAreParameters[myname] = allParameters;
-            if (allParameters)
-            {
-                node->MarkValueNonSharable();
-            }
-            else
-            {
-                node->MarkValueSharable();
+                pending.insert(input);
+                pending.insert(consumersOf[input].begin(), consumersOf[input].end());
             }
         }
     }
+    return numValidations;
+}
+
+// -----------------------------------------------------------------------
+// memory allocation
+// -----------------------------------------------------------------------
+// mark the nodes whose Values depend on LearnableParameters only, e.g. a transposed or normalized weight matrix
+// Their inputs' time stamps change only when the parameters are updated, so ForwardProp() skips them in between.
+void ComputationNetwork::MarkParameterOnlyNodes()
+{
+    size_t numParameterOnly = 0;
+    for (auto& node : GetEvalOrder(nullptr)) // (outside of loops, inputs come before their consumers)
+    {
+        if (node->IsLeaf())
+        {
+            node->m_isParameterOnly = node->OperationName() == OperationNameOf(LearnableParameter);
+            continue;
+        }
+        const auto& inputs = node->GetInputs();
+        node->m_isParameterOnly = !node->IsPartOfLoop() && !node->HasMBLayout() &&
+                                  all_of(inputs.begin(), inputs.end(), [](const ComputationNodeBasePtr& input) { return input->IsParameterOnly(); });
+        if (node->m_isParameterOnly)
+            numParameterOnly++;
+    }
+    if (numParameterOnly > 0)
+        fprintf(stderr, "%d nodes are computed from parameters only; they are recomputed only when the parameters change.\n", (int) numParameterOnly);
+}
+
+// mark nodes that are purely induced by parameters as non-sharable and create space for value if null
+void ComputationNetwork::MarkValueNonSharableNodes()
+{
+    for (auto& node : GetEvalOrder(nullptr))
+    {
+        if (node->IsLeaf()) // all the possible leaf nodes (input/parameters/precompute node) are marked as non-sharable already
+            continue;
+        if (node->IsParameterOnly())
+            node->MarkValueNonSharable();
+        else
+            node->MarkValueSharable();
+    }
 }
 
 // this function will need to be called before actual validation and execution to
@@ -768,32 +1356,193 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
-    set<ComputationNodeBasePtr> completedEvaluate;
-    for (auto& nodeIter : compositeForwardPropEvalOrder)
+    // gradient checkpointing: decide which Values are dropped after forward prop, to be recomputed during backprop.
+    // Only PAR nodes outside loops and not feeding into a loop qualify; the SEQ traversal has no recomputation hook.
+    // A recomputation reads inputs that are either held until after the node's own backprop, or are themselves
+    // recomputed as intermediates right before it (e.g. the Plus and Times under a Sigmoid, whose Values are never held).
+    // An input that is dropped and recomputed in its own right is not used, so that recomputations never cascade;
+    // for a chain of layers this means every other layer output is held. Roots are kept since their Values are results.
+    std::unordered_set<ComputationNodeBasePtr> forwardPropRootSet(forwardPropRoots.begin(), forwardPropRoots.end());
+    if (m_gradientCheckpointing && performingBackPropagation && !g_shareNodeValueMatrices)
+        fprintf(stderr, "WARNING: gradientCheckpointing has no effect unless shareNodeValueMatrices is enabled, since Values are never released otherwise.\n");
+    auto isOutsideLoops = [&](const ComputationNodeBasePtr& node)
     {
-        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
-
-        if (nodeIter->IsPartOfLoop())
+        const auto& parents = parentsMap[node];
+        return !node->IsPartOfLoop() && none_of(parents.begin(), parents.end(), [](const ComputationNodeBasePtr& parent) { return parent->IsPartOfLoop(); });
+    };
+    std::function<bool(const ComputationNodeBasePtr&)> isAvailableForRecomputation;
+    auto canRecomputeWithConsumer = [&](const ComputationNodeBasePtr& input)
+    {
+        if (!input->IsValueRecomputable() || !isOutsideLoops(input) || input->RequiresPreCompute() || input->m_recomputeValueInBackprop ||
+            outputValueNeededDuringBackProp[input] || parentsMap[input].size() != 1 || forwardPropRootSet.find(input) != forwardPropRootSet.end())
+            return false;
+        const auto& inputs = input->GetInputs();
+        return all_of(inputs.begin(), inputs.end(), isAvailableForRecomputation);
+    };
+    isAvailableForRecomputation = [&](const ComputationNodeBasePtr& input)
+    {
+        if (input->IsLeaf() || !input->isValueSharable())
+            return true; // never released
+        if (outputValueNeededDuringBackProp[input] && !input->m_recomputeValueInBackprop)
+            return true; // held until after its own backprop, which comes after that of any of its consumers
+        return canRecomputeWithConsumer(input);
+    };
+    std::function<void(const ComputationNodeBasePtr&)> markIntermediates = [&](const ComputationNodeBasePtr& node)
+    {
+        for (auto& input : node->GetInputs())
         {
-            // TODO: use FormNestedNetwork() here to avoid completedEvaluate[] check
-            shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, nodeIter);
-            assert(recInfo != nullptr);
-            if (completedEvaluate.insert(recInfo).second)
+            if (!input->IsLeaf() && input->isValueSharable() && !outputValueNeededDuringBackProp[input])
             {
-                recInfo->RequestMatricesBeforeForwardProp(m_matrixPool);
+                input->m_recomputeValueWithConsumer = true;
+                markIntermediates(input);
+            }
+        }
+    };
+    size_t numRecomputed = 0;
+    for (auto& node : compositeForwardPropEvalOrder)
+    {
+        node->m_recomputeValueInBackprop = false;
+        node->m_valueRecomputed = false;
+        node->m_recomputeValueWithConsumer = false;
+    }
+    for (auto& node : compositeForwardPropEvalOrder)
+    {
+        if (!m_gradientCheckpointing || !performingBackPropagation || !g_shareNodeValueMatrices)
+            break;
+        if (!node->IsValueRecomputable() || !isOutsideLoops(node) || !node->isValueSharable() || node->IsLeaf() || node->RequiresPreCompute() ||
+            !outputValueNeededDuringBackProp[node] || forwardPropRootSet.find(node) != forwardPropRootSet.end())
+            continue;
+        const auto& inputs = node->GetInputs();
+        if (!all_of(inputs.begin(), inputs.end(), isAvailableForRecomputation))
+            continue;
+        markIntermediates(node);
+        node->m_recomputeValueInBackprop = true;
+        outputValueNeededDuringBackProp[node] = false; // (forward-prop Value can now be released after its last consumer)
+        numRecomputed++;
+    }
+    if (numRecomputed > 0)
+        fprintf(stderr, "Gradient checkpointing: %d node Values will be recomputed during backprop.\n", (int) numRecomputed);
+
+    // elementwise fusion: a Plus whose only consumer is a fusable nonlinearity is not computed; the consumer computes op(a + b) in one pass.
+    // The Plus still gets a gradient, but its Value is never written, so it must not be read by anyone else, nor be a root.
+    std::unordered_map<ComputationNodeBasePtr, int> numConsumers; // over the entire network, not only the current roots
+    for (auto& node : allNodesEvalOrder)
+    {
+        for (auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    size_t numFused = 0;
+    for (auto& node : compositeForwardPropEvalOrder)
+    {
+        node->m_valueComputedByConsumer = false;
+        node->m_computesValueOfInput = false;
+    }
+    for (auto& node : compositeForwardPropEvalOrder)
+    {
+        if (!m_elementwiseFusion || !node->CanFuseSumOfInput() || node->IsPartOfLoop() || node->m_recomputeValueInBackprop || node->m_recomputeValueWithConsumer)
+            continue;
+        ComputationNodeBasePtr sumNode = node->GetInputs()[0];
+        if (sumNode->OperationName() != OperationNameOf(PlusNode) || sumNode->IsPartOfLoop() || sumNode->m_recomputeValueInBackprop || sumNode->m_recomputeValueWithConsumer ||
+            sumNode->m_computesValueOfInput || numConsumers[sumNode] != 1 || forwardPropRootSet.find(sumNode) != forwardPropRootSet.end() ||
+            outputValueNeededDuringBackProp[sumNode])
+            continue;
+        sumNode->m_valueComputedByConsumer = true;
+        node->m_computesValueOfInput = true;
+        numFused++;
+    }
+    if (numFused > 0)
+        fprintf(stderr, "Elementwise fusion: %d Plus nodes are computed by their consumer.\n", (int) numFused);
+
+    // value views: a node that only looks at its input's Value as a different shape (e.g. Reshape) uses the input's matrix.
+    // That matrix then lives as long as either needs it: the input is released once the view's consumers are done (see
+    // ReleaseMatricesAfterEvalForChildren()), and is held for backprop if the view's Value is needed there. Going backwards,
+    // the latter carries through chains of views. Inputs without MBLayout are excluded, since a reshape would resize them.
+    size_t numViews = 0;
+    for (auto iter = compositeForwardPropEvalOrder.rbegin(); iter != compositeForwardPropEvalOrder.rend(); iter++)
+    {
+        auto& node = *iter;
+        node->m_valueIsViewOfInput = false;
+        if (!node->CanShareValueWithInput() || node->IsPartOfLoop() || node->m_recomputeValueInBackprop || node->m_recomputeValueWithConsumer || forwardPropRootSet.find(node) != forwardPropRootSet.end())
+            continue;
+        ComputationNodeBasePtr input = node->GetInputs()[0];
+        if (!input->HasMBLayout() || input->GetSampleMatrixNumRows() != node->GetSampleMatrixNumRows() || input->m_recomputeValueInBackprop || input->m_recomputeValueWithConsumer ||
+            input->m_valueComputedByConsumer)
+            continue;
+        node->m_valueIsViewOfInput = true;
+        outputValueNeededDuringBackProp[input] = outputValueNeededDuringBackProp[input] || outputValueNeededDuringBackProp[node];
+        numViews++;
+    }
+    if (numViews > 0)
+        fprintf(stderr, "Value views: %d nodes use their input's Value matrix.\n", (int) numViews);
 
-                for (auto& nodeLoopIter : recInfo->m_nestedNodes)
+    if (m_concurrentForwardProp)
+    {
+        // nodes of the same dependency level may run concurrently, so only release matrices after a whole level
+        for (auto& node : compositeForwardPropEvalOrder)
+            node->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[node]);
+
+        std::vector<ComputationNodeBasePtr> topLevelNodes; // with loops replaced by their SEQTraversalFlowControlNode
+        set<ComputationNodeBasePtr> loopsSeen;
+        for (auto& node : compositeForwardPropEvalOrder)
+        {
+            if (!node->IsPartOfLoop())
+                topLevelNodes.push_back(node);
+            else if (loopsSeen.insert(FindInRecurrentLoops(m_allSEQNodes, node)).second)
+                topLevelNodes.push_back(FindInRecurrentLoops(m_allSEQNodes, node));
+        }
+        std::vector<int> levels = DetermineDependencyLevels(m_allSEQNodes, topLevelNodes);
+        int numLevels = topLevelNodes.empty() ? 0 : *max_element(levels.begin(), levels.end()) + 1;
+        for (int level = 0; level < numLevels; level++)
+        {
+            for (size_t i = 0; i < topLevelNodes.size(); i++)
+            {
+                if (levels[i] == level)
+                    topLevelNodes[i]->RequestMatricesBeforeForwardProp(m_matrixPool);
+            }
+            for (size_t i = 0; i < topLevelNodes.size(); i++)
+            {
+                if (levels[i] != level)
+                    continue;
+                auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(topLevelNodes[i]);
+                if (recInfo)
                 {
-                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    for (auto& nodeLoopIter : recInfo->m_nestedNodes)
+                        ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
                 }
+                else
+                    ReleaseMatricesAfterEvalForChildren(topLevelNodes[i], parentCount);
             }
         }
-        else
+    }
+    else
+    {
+        set<ComputationNodeBasePtr> completedEvaluate;
+        for (auto& nodeIter : compositeForwardPropEvalOrder)
         {
-            nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
-            // we only release matrices for the children since the root node's informatioin will be used and should not be shared
-            // with others
-            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
+
+            if (nodeIter->IsPartOfLoop())
+            {
+                // TODO: use FormNestedNetwork() here to avoid completedEvaluate[] check
+                shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, nodeIter);
+                assert(recInfo != nullptr);
+                if (completedEvaluate.insert(recInfo).second)
+                {
+                    recInfo->RequestMatricesBeforeForwardProp(m_matrixPool);
+
+                    for (auto& nodeLoopIter : recInfo->m_nestedNodes)
+                    {
+                        ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    }
+                }
+            }
+            else
+            {
+                nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
+                // we only release matrices for the children since the root node's informatioin will be used and should not be shared
+                // with others
+                ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            }
         }
     }
 
@@ -803,10 +1552,31 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
         // now, simulate the gradient computation order to determine how to allocate matrices
         set<ComputationNodeBasePtr> completedGradient;
+        set<ComputationNodeBasePtr> recomputationBufferAllocated;
 
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
+        // loops that are backpropagated concurrently must not share gradient memory, so their gradients are only
+        // released together, when the first loop of such a run is reached (see DetermineConcurrentLoopRuns())
+        std::map<ComputationNodeBasePtr, ComputationNodeBasePtr> loopRunBegin; // [loop] first loop of its run
+        if (m_concurrentForwardProp)
+        {
+            std::vector<ComputationNodeBasePtr> topLevelNodes; // with loops replaced by their SEQTraversalFlowControlNode
+            set<ComputationNodeBasePtr> loopsSeen;
+            for (auto& node : backPropNodes)
+            {
+                if (!node->IsPartOfLoop())
+                    topLevelNodes.push_back(node);
+                else if (loopsSeen.insert(FindInRecurrentLoops(m_allSEQNodes, node)).second)
+                    topLevelNodes.push_back(FindInRecurrentLoops(m_allSEQNodes, node));
+            }
+            std::vector<size_t> runBegin = DetermineConcurrentLoopRuns(topLevelNodes, DetermineDependencyLevels(m_allSEQNodes, topLevelNodes));
+            for (size_t i = 0; i < topLevelNodes.size(); i++)
+                loopRunBegin[topLevelNodes[i]] = topLevelNodes[runBegin[i]];
+        }
+        std::vector<shared_ptr<SEQTraversalFlowControlNode>> loopsToRelease;
+
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
@@ -821,11 +1591,42 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                     // BUGBUG: naw, ^^ would not work! Wrong order! Need to rethink this. Need to make AllocateEvalMatrices() and AllocateGradientMatrices() the virtual functions.
                     recInfo->AllocateGradientMatricesForInputs(m_matrixPool);
                     // Loops are computed sample by sample so we have to allocate them all
-                    recInfo->ReleaseMatricesAfterBackprop(m_matrixPool);
+                    loopsToRelease.push_back(recInfo);
+                    if (loopRunBegin.empty() || loopRunBegin[recInfo] == recInfo)
+                    {
+                        for (auto& loop : loopsToRelease)
+                            loop->ReleaseMatricesAfterBackprop(m_matrixPool);
+                        loopsToRelease.clear();
+                    }
                 }
             }
             else
             {
+                // checkpointed inputs get a fresh buffer with the first consumer, since recomputation happens there
+                // The buffers of their intermediates are only needed during that recomputation, so they go back right away.
+                for (auto& input : n->GetInputs())
+                {
+                    if (input->m_recomputeValueInBackprop && recomputationBufferAllocated.insert(input).second)
+                    {
+                        std::vector<ComputationNodeBasePtr> intermediates;
+                        std::function<void(const ComputationNodeBasePtr&)> requestForIntermediates = [&](const ComputationNodeBasePtr& consumer)
+                        {
+                            for (auto& intermediate : consumer->GetInputs())
+                            {
+                                if (!intermediate->m_recomputeValueWithConsumer || find(intermediates.begin(), intermediates.end(), intermediate) != intermediates.end())
+                                    continue;
+                                requestForIntermediates(intermediate);
+                                intermediate->RequestMatricesForRecomputation(m_matrixPool);
+                                intermediates.push_back(intermediate);
+                            }
+                        };
+                        requestForIntermediates(input);
+                        input->RequestMatricesForRecomputation(m_matrixPool);
+                        for (auto& intermediate : intermediates)
+                            intermediate->ReleaseMatricesAfterRecomputation(m_matrixPool);
+                    }
+                }
+
                 // PAR mode: we can allocate and immediately deallocate one by one
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
@@ -834,16 +1635,272 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             }
         }
     }
+
+    if (m_traceLevel > 0)
+    {
+        m_matrixPool.PrintStatistics();
+        PlanMemorySharing(compositeForwardPropEvalOrder, parentsMap, trainRootNode); // (only reports)
+    }
+}
+
+// -----------------------------------------------------------------------
+// PlanMemorySharing() -- offline liveness analysis of Value and Gradient matrices
+//
+// This walks the same forward+backward schedule as AllocateAllMatrices() and records for each sharable
+// Value and each Gradient of a non-leaf node the interval of steps [birth, death] during which it is live.
+// The intervals are then packed into slabs (largest first; a buffer goes into the first slab none of whose
+// buffers it overlaps with), which is the classic first-fit-decreasing heuristic for interval coloring.
+// The planned footprint is the sum of slab sizes, compared against the naive one (one buffer per matrix).
+// Sizes are in elements per sample column (nodes without MBLayout count their full size).
+// Node-internal temporaries are not visible here and are not included.
+// The plan is only reported, so AllocateAllMatrices() computes it only when tracing.
+// -----------------------------------------------------------------------
+
+void ComputationNetwork::PlanMemorySharing(const std::vector<ComputationNodeBasePtr>& compositeForwardPropEvalOrder,
+                                           const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                           ComputationNodeBasePtr trainRootNode)
+{
+    struct LiveInterval
+    {
+        ComputationNodeBasePtr node;
+        bool isGradient;
+        size_t size;
+        size_t birth;
+        size_t death;
+    };
+    vector<LiveInterval> intervals;
+    map<pair<ComputationNodeBasePtr, bool>, size_t> intervalIndex; // (node, isGradient) -> index into intervals[]
+
+    auto isPlannable = [](const ComputationNodeBasePtr& node)
+    {
+        return !node->IsLeaf() && !node->RequiresPreCompute();
+    };
+    auto born = [&](const ComputationNodeBasePtr& node, bool isGradient, size_t step)
+    {
+        if (!isPlannable(node) || (!isGradient && (!node->isValueSharable() || node->IsValueViewOfInput())) || intervalIndex.find(make_pair(node, isGradient)) != intervalIndex.end())
+            return;
+        LiveInterval interval = { node, isGradient, node->GetSampleMatrixNumRows(), step, SIZE_MAX };
+        intervalIndex[make_pair(node, isGradient)] = intervals.size();
+        intervals.push_back(interval);
+    };
+    auto dies = [&](const ComputationNodeBasePtr& node, bool isGradient, size_t step)
+    {
+        auto iter = intervalIndex.find(make_pair(node, isGradient));
+        if (iter != intervalIndex.end() && intervals[iter->second].death == SIZE_MAX)
+            intervals[iter->second].death = step;
+    };
+
+    // forward: a Value is born when its node (or loop) is evaluated, and dies with its last consumer unless backprop needs it
+    size_t step = 0;
+    std::unordered_map<ComputationNodeBasePtr, size_t> parentCount;
+    for (const auto& keyValue : parentsMap)
+        parentCount[keyValue.first] = keyValue.second.size();
+    set<ComputationNodeBasePtr> completedEvaluate;
+    for (const auto& node : compositeForwardPropEvalOrder)
+    {
+        vector<ComputationNodeBasePtr> stepNodes(1, node);
+        if (node->IsPartOfLoop())
+        {
+            shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, node);
+            if (!completedEvaluate.insert(recInfo).second)
+                continue;
+            stepNodes = recInfo->m_nestedNodes;
+        }
+        for (const auto& stepNode : stepNodes)
+            born(stepNode, false, step);
+        for (const auto& stepNode : stepNodes)
+        {
+            for (size_t i = 0; i < stepNode->GetNumInputs(); i++)
+            {
+                if (i == 0 && stepNode->IsValueViewOfInput()) // (as in ReleaseMatricesAfterEvalForChildren())
+                    continue;
+                ComputationNodeBasePtr input = stepNode->GetInputs()[i];
+                while (--parentCount[input] == 0 && input->IsValueViewOfInput())
+                    input = input->GetInputs()[0];
+                if (parentCount[input] == 0 && !input->IsOutputNeededDuringBackprop())
+                    dies(input, false, step);
+            }
+        }
+        step++;
+    }
+
+    // backward: a Gradient is born when the first consumer of its node propagates into it, and dies together with
+    // the node's Value (if still live) once the node has propagated into its own inputs
+    if (trainRootNode != nullptr)
+    {
+        born(trainRootNode, true, step);
+        set<ComputationNodeBasePtr> completedGradient;
+        std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
+        for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++)
+        {
+            vector<ComputationNodeBasePtr> stepNodes(1, *iter);
+            if ((*iter)->IsPartOfLoop())
+            {
+                shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, *iter);
+                if (!completedGradient.insert(recInfo).second)
+                    continue;
+                stepNodes = recInfo->m_nestedNodes;
+            }
+            for (const auto& stepNode : stepNodes)
+            {
+                for (const auto& input : stepNode->GetInputs())
+                {
+                    if (input->NeedGradient())
+                        born(input, true, step);
+                }
+            }
+            for (const auto& stepNode : stepNodes)
+            {
+                if (stepNode != trainRootNode && stepNode->NeedGradient())
+                {
+                    dies(stepNode, true, step);
+                    dies(stepNode, false, step);
+                }
+            }
+            step++;
+        }
+    }
+
+    if (intervals.empty())
+        return;
+
+    // pack: first-fit decreasing
+    vector<size_t> order(intervals.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b)
+         {
+             return intervals[a].size > intervals[b].size;
+         });
+    vector<vector<size_t>> slabs; // [slab] -> indices into intervals[]
+    size_t naiveSize = 0;
+    size_t plannedSize = 0;
+    for (auto i : order)
+    {
+        const LiveInterval& interval = intervals[i];
+        naiveSize += interval.size;
+        auto overlaps = [&](size_t j)
+        {
+            return interval.birth <= intervals[j].death && intervals[j].birth <= interval.death;
+        };
+        size_t s;
+        for (s = 0; s < slabs.size(); s++)
+        {
+            if (none_of(slabs[s].begin(), slabs[s].end(), overlaps))
+                break;
+        }
+        if (s == slabs.size())
+        {
+            slabs.push_back(vector<size_t>());
+            plannedSize += interval.size; // first (=largest) buffer determines the slab size
+        }
+        slabs[s].push_back(i);
+    }
+
+    fprintf(stderr, "\nMemory plan: %d Value/Gradient matrices over %d steps packed into %d slabs; planned %.2f K vs. naive %.2f K elements per sample (%.1f%%).\n",
+            (int) intervals.size(), (int) step, (int) slabs.size(), plannedSize / 1024.0, naiveSize / 1024.0, 100.0 * plannedSize / max(naiveSize, (size_t) 1));
+}
+
+// -----------------------------------------------------------------------
+// PrintMemoryReport() -- bytes held per node, per kind of matrix, and per matrix-pool bucket
+//
+// Each node lists the matrices it holds (Value, Gradient, recomputation buffer, and temporaries such as convolution
+// workspaces). A matrix the pool handed to several nodes is the same object in all of them; it is counted once in the
+// totals, with the largest size any of its holders reports (and under the kind of matrix of its first holder), and the difference to the per-node sum is what sharing saves.
+// With perSample, nodes with an MBLayout report bytes per sample column (what AllocateAllMatrices() plans with, since
+// nothing is allocated before the first minibatch); otherwise the current allocations are reported, which are the
+// peak so far since matrices do not shrink.
+// -----------------------------------------------------------------------
+
+void ComputationNetwork::PrintMemoryReport(FILE* f, bool perSample)
+{
+    struct NodeUsage
+    {
+        wstring name;
+        vector<ComputationNodeBase::MatrixMemoryUsage> usage;
+        map<string, size_t> bytesPerKind;
+        size_t totalBytes = 0;
+        size_t numShared = 0;
+    };
+    map<const void*, pair<string, size_t>> matrices; // distinct matrices: kind (of the first holder) and size
+    map<const void*, size_t> numHolders;
+    vector<NodeUsage> nodes;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        NodeUsage node;
+        node.name = iter.first;
+        iter.second->GetMatrixMemoryUsage(node.usage, perSample);
+        for (const auto& matrix : node.usage)
+        {
+            node.bytesPerKind[matrix.kind] += matrix.bytes;
+            node.totalBytes += matrix.bytes;
+            auto& distinct = matrices.insert(make_pair(matrix.matrix, make_pair(string(matrix.kind), (size_t) 0))).first->second;
+            distinct.second = max(distinct.second, matrix.bytes);
+            numHolders[matrix.matrix]++;
+        }
+        nodes.push_back(move(node));
+    }
+    // second pass for the sharing counts, which are only known once all nodes are seen
+    for (auto& node : nodes)
+    {
+        for (const auto& matrix : node.usage)
+        {
+            if (numHolders[matrix.matrix] > 1)
+                node.numShared++;
+        }
+    }
+    sort(nodes.begin(), nodes.end(), [](const NodeUsage& a, const NodeUsage& b) { return a.totalBytes > b.totalBytes; });
+
+    const char* unit = perSample ? "KB (per sample for minibatch data)" : "MB";
+    const double scale = perSample ? 1024.0 : 1024.0 * 1024.0;
+    fprintf(f, "\nMemory report (%s), in %s:\n", perSample ? "planned" : "allocated", unit);
+    fprintf(f, "%12s %12s %12s %12s %12s %7s  %s\n", "value", "gradient", "recompute", "temp", "workspace", "shared", "node");
+    for (const auto& node : nodes)
+    {
+        if (node.totalBytes == 0)
+            continue;
+        auto bytesOf = [&](const char* kind)
+        {
+            auto iter = node.bytesPerKind.find(kind);
+            return (iter == node.bytesPerKind.end() ? 0 : iter->second) / scale;
+        };
+        fprintf(f, "%12.2f %12.2f %12.2f %12.2f %12.2f %7d  %ls\n", bytesOf("value"), bytesOf("gradient"), bytesOf("recompute"), bytesOf("temp"), bytesOf("workspace"),
+                (int) node.numShared, node.name.c_str());
+    }
+
+    map<string, size_t> perNodeTotals, distinctTotals;
+    for (const auto& node : nodes)
+        for (const auto& iter : node.bytesPerKind)
+            perNodeTotals[iter.first] += iter.second;
+    for (const auto& iter : matrices)
+        distinctTotals[iter.second.first] += iter.second.second;
+    size_t perNodeTotal = 0, distinctTotal = 0;
+    for (const auto& iter : perNodeTotals)
+    {
+        fprintf(f, "Total %-10s %12.2f %s as held by the nodes, %12.2f in distinct matrices\n", iter.first.c_str(), iter.second / scale, unit, distinctTotals[iter.first] / scale);
+        perNodeTotal += iter.second;
+        distinctTotal += distinctTotals[iter.first];
+    }
+    fprintf(f, "Total            %12.2f %s as held by the nodes, %12.2f in %d distinct matrices; sharing saves %.1f%%\n",
+            perNodeTotal / scale, unit, distinctTotal / scale, (int) matrices.size(), 100.0 * (perNodeTotal - distinctTotal) / max(perNodeTotal, (size_t) 1));
+    if (!perSample)
+        m_matrixPool.PrintBuckets(f);
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
     {
+        if (i == 0 && n->IsValueViewOfInput()) // a view holds on to its input's matrix until its own consumers are done
+            continue;
         ComputationNodeBasePtr pNode = n->GetInputs()[i];
-        parentCount[pNode]--;
-        if (parentCount[pNode] == 0)
+        while (--parentCount[pNode] == 0)
+        {
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
+            if (!pNode->IsValueViewOfInput())
+                break;
+            pNode = pNode->GetInputs()[0]; // the view's consumers are done, so it lets go of its input
+        }
     }
 }
 } } }
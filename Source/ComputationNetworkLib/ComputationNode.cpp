@@ -123,6 +123,23 @@ void ComputationNodeBase::ValidateBinaryReduce(bool isFinalValidationPass)
     SetDims(TensorShape(1), false);
 }
 
+// ValidateBinaryReduce() for criteria whose labels (input 0) may also be class indices: a single row, with the index of
+// the class per sample, where the predictions (input 1) have one row per class. Returns whether the labels are indices.
+bool ComputationNodeBase::ValidateBinaryReduceWithClassIndices(bool isFinalValidationPass)
+{
+    if (Input(0)->GetSampleLayout().GetNumElements() != 1 || Input(1)->GetSampleLayout().GetNumElements() <= 1)
+    {
+        ValidateBinaryReduce(isFinalValidationPass);
+        return false;
+    }
+    ComputationNodeBase::Validate(isFinalValidationPass);
+    m_pMBLayout = nullptr; // this node does not hold mini-batch data
+    if (isFinalValidationPass && (!Input(0)->HasMBLayout() || Input(0)->GetMBLayout() != Input(1)->GetMBLayout()))
+        LogicError("The class indices (input 0) of the %ls %ls operation must be a minibatch of the layout of input 1.", NodeName().c_str(), OperationName().c_str());
+    SetDims(TensorShape(1), false);
+    return true;
+}
+
 // helper function for validation
 // In complex cases of convolution, dimensions are quite difficult for a user to know/derive.
 // This is a feature that allows a node to help resizing its input node to the expected value
@@ -215,6 +232,11 @@ TensorShape ComputationNodeBase::GetTensorShape(size_t rank) const
 // get tensor shape of the slice referenced by a given FrameRange
 TensorShape ComputationNodeBase::GetTensorSliceFor(size_t rank, const FrameRange& fr) const
 {
+    // the whole minibatch is the common case; its slices are precomputed per layout
+    const TensorShape* cachedSlice = FindCachedTensorSlice(rank, fr);
+    if (cachedSlice)
+        return *cachedSlice;
+
     // form the actual tensor that describes the full object
     // Note: This may have strides.
     auto tensorShape = GetTensorShape(rank);
@@ -229,6 +251,56 @@ TensorShape ComputationNodeBase::GetTensorSliceFor(size_t rank, const FrameRange
     return tensorShape;
 }
 
+static bool IsSameTensorShape(const TensorShape& a, const TensorShape& b)
+{
+    return a.GetDims() == b.GetDims() && a.GetStrides() == b.GetStrides() && a.GetOffset() == b.GetOffset();
+}
+
+// look up the slice for a FrameRange that selects the entire minibatch, as GetTensorSliceFor() would form it
+// Returns nullptr if 'fr' selects less, or if the slice has not been cached for the current shapes.
+const TensorShape* ComputationNodeBase::FindCachedTensorSlice(size_t rank, const FrameRange& fr) const
+{
+    if (m_cachedTensorSlices.empty() || !fr.IsAllFrames() || fr.m_timeOffset != 0 || fr.seqIndex != SIZE_MAX)
+        return nullptr;
+    if (fr.m_pMBLayout != m_pMBLayout && (m_pMBLayout || !fr.m_broadcastAllowed)) // (GetTensorSliceFor() fails for these)
+        return nullptr;
+    for (const auto& entry : m_cachedTensorSlices)
+    {
+        if (entry.rank == rank && entry.pMBLayout == m_pMBLayout.get() &&
+            (!m_pMBLayout || (entry.numParallelSequences == m_pMBLayout->GetNumParallelSequences() && entry.numTimeSteps == m_pMBLayout->GetNumTimeSteps())) &&
+            IsSameTensorShape(entry.sampleLayout, m_sampleLayout))
+            return &entry.slice;
+    }
+    return nullptr;
+}
+
+void ComputationNodeBase::CacheWholeMinibatchTensorSlice(size_t rank)
+{
+    const size_t maxCachedSlices = 16; // more layouts than that are not worth remembering
+    FrameRange fr(m_pMBLayout);
+    if (FindCachedTensorSlice(rank, fr))
+        return;
+    if (m_cachedTensorSlices.size() >= maxCachedSlices)
+        m_cachedTensorSlices.erase(m_cachedTensorSlices.begin());
+    CachedTensorSlice entry;
+    entry.rank = rank;
+    entry.sampleLayout = m_sampleLayout;
+    entry.pMBLayout = m_pMBLayout.get();
+    entry.numParallelSequences = m_pMBLayout ? m_pMBLayout->GetNumParallelSequences() : 0;
+    entry.numTimeSteps = m_pMBLayout ? m_pMBLayout->GetNumTimeSteps() : 0;
+    entry.slice = GetTensorSliceFor(rank, fr);
+    m_cachedTensorSlices.push_back(std::move(entry));
+}
+
+// elementwise nodes access themselves and their inputs at the rank DetermineElementwiseTensorRank()
+void ComputationNodeBase::CacheWholeMinibatchTensorSlices()
+{
+    size_t rank = DetermineElementwiseTensorRank();
+    CacheWholeMinibatchTensorSlice(rank);
+    for (const auto& input : m_inputs)
+        input->CacheWholeMinibatchTensorSlice(rank);
+}
+
 // -----------------------------------------------------------------------
 // others
 // -----------------------------------------------------------------------
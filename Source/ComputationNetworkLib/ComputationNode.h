@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -30,7 +31,9 @@
 // version number to control how to read and write
 #define CNTK_MODEL_VERSION_1 1
 #define CNTK_MODEL_VERSION_2 2
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_2
+#define CNTK_MODEL_VERSION_3 3 // depth of convolution kernels and pooling windows
+#define CNTK_MODEL_VERSION_4 4 // storage format of LearnableParameter values (full, fp16, int8)
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_4
 
 extern bool g_shareNodeValueMatrices;
 
@@ -51,6 +54,7 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeChildren = 2,             // only copy over children links
     copyNodeAll = 3,                  // copy everything
     copyNodeChildrenCrossNetwork = 4, // allow a cross network child copy
+    copyNodeShareValue = 8,           // with copyNodeValue: share the value matrix instead of copying it, and drop the gradient
 };
 
 #pragma region base computation class
@@ -101,6 +105,17 @@ struct /*interface*/ IComputationNode
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) = 0; // request matrices that are needed for gradient computation
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) = 0;  // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
 
+    // memory report: one entry per matrix this node holds, see ComputationNetwork::PrintMemoryReport()
+    struct MatrixMemoryUsage
+    {
+        const void* matrix; // matrices shared through the matrix pool are the same object in several nodes
+        const char* kind;   // "value", "gradient", "recompute", "temp", or "workspace"
+        size_t bytes;
+    };
+    // perSample: for nodes with an MBLayout, report the bytes per sample column (the matrix-pool size hint) rather than the
+    // current allocation, which does not exist before the first minibatch
+    virtual void GetMatrixMemoryUsage(std::vector<MatrixMemoryUsage>& usage, bool perSample) const = 0;
+
     // --- optional overrides that describe a feature or property of the node
 
     virtual bool RequiresPreCompute() const = 0; // return true if the node's value should be computed before the normal training. e.g., mean and invStd of input features.
@@ -142,7 +157,7 @@ struct ComputationNetworkOwnedNodeState
     friend class ComputationNetwork;
 
     ComputationNetworkOwnedNodeState()
-        : m_needsGradient(false), m_valueSharable(true)
+        : m_needsGradient(false), m_valueSharable(true), m_recomputeValueInBackprop(false), m_valueRecomputed(false), m_recomputeValueWithConsumer(false), m_valueComputedByConsumer(false), m_computesValueOfInput(false), m_valueIsViewOfInput(false), m_isParameterOnly(false)
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
@@ -161,6 +176,12 @@ struct ComputationNetworkOwnedNodeState
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool isValueSharable() const { return m_valueSharable; }
 
+    bool IsValueRecomputedInBackprop() const { return m_recomputeValueInBackprop; }
+    bool IsValueComputedByConsumer() const { return m_valueComputedByConsumer; }
+    bool ComputesValueOfInput() const { return m_computesValueOfInput; }
+    bool IsValueViewOfInput() const { return m_valueIsViewOfInput; }
+    bool IsParameterOnly() const { return m_isParameterOnly; }
+
 protected:                // TODO: should be fully encapsulated here
 
     bool m_needsGradient; // true if this node or any children need a gradient to be computed (for own consumption or propagation to somewhere in the child tree)
@@ -168,6 +189,17 @@ protected:                // TODO: should be fully encapsulated here
     bool m_valueSharable; // a flag is needed for memory share.
                           // If it is false (e.g., learnableParameters/InputValue and those nodes are solely induced by learnableParameters),
                           // it will never be released to memory pool
+
+    bool m_recomputeValueInBackprop; // gradient checkpointing: Value is released after forward prop and recomputed during backprop
+    bool m_valueRecomputed;          // and this is true while the recomputed Value is in place (between first consumer's backprop and own backprop)
+    bool m_recomputeValueWithConsumer; // gradient checkpointing: Value is not needed in backprop, but is recomputed (and dropped again) as an intermediate of its only consumer's recomputation
+
+    bool m_valueComputedByConsumer; // elementwise fusion: ForwardProp() is skipped; the only consumer computes from this node's inputs directly
+    bool m_computesValueOfInput;    // elementwise fusion: this is that consumer
+
+    bool m_valueIsViewOfInput; // value views: m_value is Input(0)'s matrix (set by AllocateAllMatrices()), so ForwardProp() has nothing to do
+
+    bool m_isParameterOnly; // a LearnableParameter, or a node whose inputs are all parameter-only (set by CompileNetwork()), so its Value changes only when the parameters do
 private:
 
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
@@ -493,6 +525,17 @@ protected:
     size_t DetermineElementwiseTensorRank() const;                          // determine tensor rank when considering all inputs with padding
     TensorShape GetTensorSliceFor(size_t rank, const FrameRange& fr) const; // form tensor shape of the slice referenced by FrameRange
 
+public:
+
+    // precompute the whole-minibatch slices of this node and its inputs that the elementwise ForwardProp() and
+    // BackpropTo() functions ask for, for the current sample layouts and MBLayouts (see ComputationNetwork::PrepareExecutionPlan())
+    void CacheWholeMinibatchTensorSlices();
+
+private:
+
+    const TensorShape* FindCachedTensorSlice(size_t rank, const FrameRange& fr) const;
+    void CacheWholeMinibatchTensorSlice(size_t rank);
+
 public:
 
     // -----------------------------------------------------------------------
@@ -571,6 +614,10 @@ public:
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
 
+    // place this node on a different device (model parallelism); call before the network is compiled, which inserts
+    // DeviceTransferNodes wherever an input lives on another device
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) = 0;
+
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
 
@@ -622,6 +669,7 @@ protected:
     void ValidateInferBinaryInputDims();
     void ValidateBinaryZip(bool isFinalValidationPass, bool allowBroadcast);
     void ValidateBinaryReduce(bool isFinalValidationPass);
+    bool ValidateBinaryReduceWithClassIndices(bool isFinalValidationPass);
     void InferMBLayoutFromInputsForStandardCase();
     virtual void ValidateInferInputDimsFrom(const TensorShape&) = 0;    // (implemented by ComputationNode<ElemType>
 
@@ -701,6 +749,26 @@ public:
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
     bool IsOutputNeededDuringBackprop() const { return !g_shareNodeValueMatrices || m_outputNeededDuringBackprop; }
 
+    // gradient checkpointing (recompute-on-backprop)
+    // Nodes whose Value is a cheap and deterministic function of their inputs may opt in, so that their Value
+    // can be dropped after forward prop and be recomputed into a separate buffer right before backprop needs it.
+    virtual bool IsValueRecomputable() const { return false; }
+    // overridden by <ElemType> variant only
+    virtual void RequestMatricesForRecomputation(MatrixPool& matrixPool) = 0;
+    virtual void ReleaseMatricesAfterRecomputation(MatrixPool& matrixPool) = 0;
+    virtual void RecomputeValueForBackprop(const FrameRange& fr) = 0;
+    virtual void RestoreValueAfterBackprop() = 0;
+
+    // elementwise fusion
+    // Nodes that apply an elementwise op to a single input may opt in to compute op(a + b) directly from the inputs
+    // of a Plus node that feeds them, so that the sum never goes through memory. The network decides when it is safe.
+    virtual bool CanFuseSumOfInput() const { return false; }
+
+    // value views
+    // Nodes whose Value is their first input's Value matrix, element by element, only looked at as a different tensor
+    // shape (e.g. Reshape), may opt in to use the input's matrix instead of a copy. The network decides when it is safe.
+    virtual bool CanShareValueWithInput() const { return false; }
+
     // -----------------------------------------------------------------------
     // helpers for network traversal
     // -----------------------------------------------------------------------
@@ -831,6 +899,19 @@ protected:
     TensorShape m_sampleLayout; // sample layout
     MBLayoutPtr m_pMBLayout;
 
+    // whole-minibatch tensor slices, by the rank and the shapes they were formed from (see CacheWholeMinibatchTensorSlices())
+    // Only written by ComputationNetwork before a minibatch is run, so that nodes running concurrently may read them.
+    struct CachedTensorSlice
+    {
+        size_t rank;
+        TensorShape sampleLayout;
+        const MBLayout* pMBLayout;
+        size_t numParallelSequences;
+        size_t numTimeSteps;
+        TensorShape slice;
+    };
+    std::vector<CachedTensorSlice> m_cachedTensorSlices;
+
     // flags related to gradient propagation
     bool m_parameterUpdateRequired;    // update parameters? Only used for LearnableParameters.    --TODO: Should we make this a member of LearnableParameters actually? And require a type cast? Currently it is read out for all leaves.
     bool m_gradientInitialized;        // indicates whether the gradient matrix has been resized and initialized to 0
@@ -903,9 +984,22 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = UpCast(nodeP);
-            *node->m_value = *m_value;
+            if (flags & CopyNodeFlags::copyNodeShareValue)
+            {
+                node->m_value = m_value;
+                node->m_gradient = nullptr;
+                return;
+            }
+            if (m_value) // value matrices of most nodes only exist while the network is allocated
+            {
+                node->CreateMatrixIfNull(node->m_value);
+                *node->m_value = *m_value;
+            }
             if (m_gradient)
+            {
+                node->CreateMatrixIfNull(node->m_gradient);
                 *node->m_gradient = *m_gradient;
+            }
             else
                 node->m_gradient = nullptr;
         }
@@ -1045,6 +1139,18 @@ protected:
 
 public:
 
+    // Matrices that derived nodes keep as members were created on the old device; operations on them move them over
+    // to the device of the other operands on first use.
+    virtual void /*ComputationNodeBase::*/ MoveToDevice(DEVICEID_TYPE deviceId) override
+    {
+        AllowAdditionalGPU(deviceId); // so that matrices created later for this node (e.g. from the MatrixPool) stay on it
+        m_deviceId = deviceId;
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(m_deviceId, true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(m_deviceId, true);
+    }
+
     // -----------------------------------------------------------------------
     // validation
     // -----------------------------------------------------------------------
@@ -1091,6 +1197,9 @@ public:
     const Matrix<ElemType>& Value() const { return *m_value; }
     Matrix<ElemType>&       Value()       { return *m_value; }
 
+    // replace the value matrix, e.g. by one that wraps a caller's buffer during an evaluation; returns the previous one
+    shared_ptr<Matrix<ElemType>> SwapValuePtr(shared_ptr<Matrix<ElemType>> value) { m_value.swap(value); return value; }
+
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
@@ -1360,14 +1469,17 @@ public:
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_value, matrixPool);
+        if (IsValueViewOfInput())
+            m_value = Input(0)->m_value; // (the input releases it, once we are done with it, too)
+        else
+            RequestMatrixFromPool(m_value, matrixPool);
     }
 
     // release temp matrices that are only used by forward computation
     // don't release matrices that need to be used in the gradient computation
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && isValueSharable())
+        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && isValueSharable() && !IsValueViewOfInput())
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
@@ -1396,11 +1508,45 @@ public:
 
             // Release the Value matrix only if the output value is needed during backprop
             // since in the case it isn't used, we release it during forward prop itself
-            if (IsOutputNeededDuringBackprop() && m_value->GetMatrixType() != SPARSE && isValueSharable())
+            if (IsOutputNeededDuringBackprop() && m_value->GetMatrixType() != SPARSE && isValueSharable() && !IsValueViewOfInput())
                 ReleaseMatrixToPool(m_value, matrixPool);
+
+            // the buffer the Value gets recomputed into is no longer needed either
+            // (intermediates of a recomputation have released theirs already, see ReleaseMatricesAfterRecomputation())
+            if (m_recomputeValueInBackprop && m_recomputedValue != nullptr)
+                ReleaseMatrixToPool(m_recomputedValue, matrixPool);
         }
     }
 
+    // request the buffer that the Value is recomputed into during backprop (gradient checkpointing)
+    // The forward-prop Value matrix has been shared with other nodes by then, so it cannot be used.
+    virtual void RequestMatricesForRecomputation(MatrixPool& matrixPool) override
+    {
+        RequestMatrixFromPool(m_recomputedValue, matrixPool);
+    }
+
+    // an intermediate of a recomputation only needs its buffer while its consumer is being recomputed
+    virtual void ReleaseMatricesAfterRecomputation(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_recomputedValue, matrixPool);
+    }
+
+    // recompute the Value into the recomputation buffer; it stays in place until RestoreValueAfterBackprop()
+    virtual void RecomputeValueForBackprop(const FrameRange& fr) override
+    {
+        if (m_recomputedValue == nullptr)
+            LogicError("RecomputeValueForBackprop: %ls %ls operation has no recomputation buffer.", NodeName().c_str(), OperationName().c_str());
+        swap(m_value, m_recomputedValue);
+        BeginForwardProp();
+        ForwardProp(fr);
+        EndForwardProp();
+    }
+
+    virtual void RestoreValueAfterBackprop() override
+    {
+        swap(m_value, m_recomputedValue);
+    }
+
     void CreateGradientMatrixIfNull()
     {
         CreateMatrixIfNull(m_gradient);
@@ -1423,11 +1569,25 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
-    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    // helper for CopyTo() of temporaries from the matrix pool, which only exist while a network is allocated
+    static void CopyMatrixIfAllocated(const shared_ptr<Matrix<ElemType>>& from, const shared_ptr<Matrix<ElemType>>& to)
+    {
+        if (from && to)
+            *to = *from;
+    }
+
+    // 'kind' names temporaries (anything but Value, Gradient and the recomputation buffer) in the memory report
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, const char* kind = "temp")
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPtr = matrixPool.Request<ElemType>(m_deviceId, GetSampleMatrixNumRows()); // size hint is per sample, while dims may not be final yet
+            if (&matrixPtr != &m_value && &matrixPtr != &m_gradient && &matrixPtr != &m_recomputedValue)
+            {
+                auto isExpired = [](const pair<const char*, weak_ptr<Matrix<ElemType>>>& temp) { return temp.second.expired(); };
+                m_pooledTemporaries.erase(remove_if(m_pooledTemporaries.begin(), m_pooledTemporaries.end(), isExpired), m_pooledTemporaries.end());
+                m_pooledTemporaries.push_back(make_pair(kind, weak_ptr<Matrix<ElemType>>(matrixPtr)));
+            }
         }
     }
 
@@ -1439,6 +1599,20 @@ protected:
 
 public:
 
+    virtual void GetMatrixMemoryUsage(std::vector<MatrixMemoryUsage>& usage, bool perSample) const override
+    {
+        auto add = [&](const shared_ptr<Matrix<ElemType>>& matrix, const char* kind)
+        {
+            if (matrix)
+                usage.push_back(MatrixMemoryUsage{matrix.get(), kind, perSample && HasMBLayout() ? GetSampleMatrixNumRows() * sizeof(ElemType) : matrix->BufferSize()});
+        };
+        add(m_value, "value");
+        add(m_gradient, "gradient");
+        add(m_recomputedValue, "recompute");
+        for (const auto& temp : m_pooledTemporaries)
+            add(temp.second.lock(), temp.first);
+    }
+
     // -----------------------------------------------------------------------
     // miscellaneous
     // -----------------------------------------------------------------------
@@ -1527,6 +1701,8 @@ public:
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
+        static std::mutex s_constOnesMutex; // nodes may run concurrently, see PARTraversalFlowControlNode::ForwardPropConcurrently()
+        std::lock_guard<std::mutex> lock(s_constOnesMutex);
         if (s_constOnes.find(rows) == s_constOnes.end() ||
             s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
         {
@@ -1548,6 +1724,8 @@ public:
 protected:
 
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
+    shared_ptr<Matrix<ElemType>> m_recomputedValue; // buffer for gradient checkpointing, see RecomputeValueForBackprop()
+    vector<pair<const char*, weak_ptr<Matrix<ElemType>>>> m_pooledTemporaries; // other matrices from RequestMatrixFromPool(), for the memory report
 
     static std::map<size_t, std::map<size_t, Matrix<ElemType>*>> s_constOnes;
 };
@@ -1627,6 +1805,7 @@ public:
     virtual void PrintSelf(bool) const override { NOT_IMPLEMENTED; }
     virtual void ValidateInferInputDimsFrom(const TensorShape&) override { NOT_IMPLEMENTED; }
     virtual void SetInput(const size_t, const Microsoft::MSR::CNTK::ComputationNodeBase::ComputationNodeBasePtr&) override { NOT_IMPLEMENTED; }
+    virtual void MoveToDevice(DEVICEID_TYPE) override { NOT_IMPLEMENTED; }
     virtual void ZeroGradientsOfInputs(void) override { NOT_IMPLEMENTED; }
     virtual void MaskMissingValueColumnsToZero(const Microsoft::MSR::CNTK::FrameRange&) override { NOT_IMPLEMENTED; }
     virtual void MaskMissingGradientColumnsToZero(const Microsoft::MSR::CNTK::FrameRange&) override { NOT_IMPLEMENTED; }
@@ -1634,15 +1813,35 @@ public:
     virtual void InvalidateMissingGradientColumns(const Microsoft::MSR::CNTK::FrameRange&) override { NOT_IMPLEMENTED; }
     virtual void NotifyFunctionValuesMBSizeModified(void) override { NOT_IMPLEMENTED; }
     virtual std::wstring ToString(void) const override { NOT_IMPLEMENTED; }
+    virtual void RequestMatricesForRecomputation(MatrixPool&) override { NOT_IMPLEMENTED; }
+    virtual void ReleaseMatricesAfterRecomputation(MatrixPool&) override { NOT_IMPLEMENTED; }
+    virtual void RecomputeValueForBackprop(const FrameRange&) override { NOT_IMPLEMENTED; }
+    virtual void RestoreValueAfterBackprop() override { NOT_IMPLEMENTED; }
     // these are meant to be called during computation, so provide dummy implementations
     virtual bool RequiresPreCompute() const override { return false; } // return true if the node's value should be computed before the normal training. e.g., mean and invStd of input features.
     virtual void PrintSelfBeforeValidation() const override { }
     virtual void DumpNodeInfo(const bool /*printValues*/, File& fstream) const override { }
+    virtual void GetMatrixMemoryUsage(std::vector<MatrixMemoryUsage>&, bool) const override { } // we don't own matrices
 
 protected: public:                                     // needed in ComputationNetwork::FindInRecurrentLoops(), which really should be part of SEQTraversalFlowControlNode
     std::vector<ComputationNodeBasePtr> m_nestedNodes; // nodes tucked away in this node, in evaluation order
 };
 
+// =======================================================================
+// ICompactlySaveableNode -- interface implemented by nodes whose value can
+// be saved in a compact format to reduce the model size (LearnableParameter)
+// =======================================================================
+
+// how the value of a LearnableParameter is stored in the model file (model version 4 and up)
+enum class ParameterStorage : int
+{
+    full = 0, // ElemType, exact
+    fp16 = 1, // IEEE half precision, rounded to nearest
+    int8 = 2  // symmetric 8-bit per row with a float scale per row, same as CPUInt8Matrix
+};
+
+struct ICompactlySaveableNode { virtual void Save(File& fstream, ParameterStorage storage) const = 0; };
+
 // =======================================================================
 // ILateAttachingNode -- helper wrapper class for ComputationNodes that must
 // AttachInputs() late due to circular references
@@ -1699,7 +1898,9 @@ struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0;
 protected:                                                                                                                                               \
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;                                                                                    \
     using Base::BackpropTo;                                                                                                                              \
+    using Base::ComputesValueOfInput;                                                                                                                    \
     using Base::ConstOnes;                                                                                                                               \
+    using Base::CopyMatrixIfAllocated;                                                                                                                   \
     using Base::CopyTo;                                                                                                                                  \
     using Base::CreateMatrixIfNull;                                                                                                                      \
     using Base::CreateUniqId;                                                                                                                            \
@@ -1737,6 +1938,7 @@ protected:
     using Base::InvalidateMissingValueColumns;                                                                                                           \
     using Base::IsLeaf;                                                                                                                                  \
     using Base::IsOutputOlderThanInputs;                                                                                                                 \
+    using Base::IsValueViewOfInput;                                                                                                                      \
     using Base::LinkToMBLayout;                                                                                                                          \
     using Base::Load;                                                                                                                                    \
     using Base::LoadValue;                                                                                                                               \
@@ -1763,6 +1965,7 @@ protected:
     using Base::UpdateFunctionValuesSize;                                                                                                                \
     using Base::Validate;                                                                                                                                \
     using Base::ValidateBinaryReduce;                                                                                                                    \
+    using Base::ValidateBinaryReduceWithClassIndices;                                                                                                    \
     using Base::ValidateBinaryZip;                                                                                                                       \
     using Base::ValidateInferBinaryInputDims;                                                                                                            \
     using Base::ValidateInferInputDimsFrom;                                                                                                              \
@@ -1867,6 +2070,9 @@ public:
 #endif
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // a single elementwise op, cheap to redo in backprop
+    virtual bool IsValueRecomputable() const override { return true; }
+
     virtual void /*IComputationNode::*/ BeginForwardProp() override // called before first iteration step of ForwardProp()
     {
         Base::BeginForwardProp();
@@ -55,6 +55,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //     - 3 for color images, 1 for B&W images
 //     - for hidden layer: dimension of activation vector for each pixel
 //  - C' = output channels = dimension of activation vector for each pixel (also called N by NVidia, inconsistently)
+//
+// With cudnn layout, the input may also be a volume [W x H x D x C] (e.g. video, or spectro-temporal features), which
+// is convolved with kernels of depth D" ('kernelDepth', stride 'depthSubsample') into [W' x H' x D' x C'] (3D convolution),
+// through cuDNN's Nd convolutions, or a direct implementation on the CPU. The weights are then [C' x (W" * H" * D" * C)].
 template <class ElemType>
 class ConvolutionNode : public ComputationNode<ElemType>, public NumInputs<2>
 {
@@ -73,6 +77,8 @@ public:
           // initialize to dummy values so we catch missing initialization
           m_horizontalSubsample(SIZE_MAX),
           m_verticalSubsample(SIZE_MAX),
+          m_kernelDepth(1),
+          m_depthSubsample(1),
           m_zeroPadding(false),
           m_maxTempMemSizeInSamples(SIZE_MAX),
           m_imageLayoutKind(ImageLayoutKind::HWC)
@@ -80,13 +86,15 @@ public:
         SetDims(ImageDimensions::AsTensorShape(1, 1, 0, m_imageLayoutKind), 0);
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
-                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0)
+                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0, const size_t kernelDepth = 1, const size_t depthSubsample = 1)
         : Base(deviceId, name),
           m_outputChannels(outputChannels),
           m_kernelWidth(kernelWidth),
           m_kernelHeight(kernelHeight),
           m_horizontalSubsample(horizontalSubsample),
           m_verticalSubsample(verticalSubsample),
+          m_kernelDepth(kernelDepth),
+          m_depthSubsample(depthSubsample),
           m_zeroPadding(zeroPadding),
           m_maxTempMemSizeInSamples(maxTempMemSizeInSamples),
           m_imageLayoutKind(imageLayoutKind)
@@ -97,20 +105,23 @@ public:
     ConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
         : ConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"kernelHeight"), configp->Get(L"outputChannels"),
                           configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")),
-                          configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"))
+                          configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"), configp->Get(L"kernelDepth"), configp->Get(L"depthSubsample"))
     {
-        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0
+        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, kernelDepth = 1, depthSubsample = 1
         AttachInputs(configp, this->GetExpectedNumInputs());
     }
 
     void Save(File& fstream) const override
     {
+        if (m_fusedBias)
+            LogicError("%ls %ls operation: cannot save a network whose convolutions were fused for inference (FuseBiasAndReLU()).", NodeName().c_str(), OperationName().c_str());
         Base::Save(fstream);
         fstream << m_kernelWidth << m_kernelHeight << m_horizontalSubsample << m_verticalSubsample;
         uint32_t imageLayoutKind = (uint32_t) m_imageLayoutKind;
         uint32_t outputChannels = (uint32_t) m_outputChannels;
         fstream << outputChannels << imageLayoutKind;
         fstream << m_zeroPadding << m_maxTempMemSizeInSamples;
+        fstream << m_kernelDepth << m_depthSubsample;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -123,6 +134,8 @@ public:
         m_outputChannels = outputChannels;
         SetDims(ImageDimensions::AsTensorShape(1, 1, m_outputChannels, m_imageLayoutKind), 0); // TODO: needed?
         fstream >> m_zeroPadding >> m_maxTempMemSizeInSamples;
+        if (modelVersion >= CNTK_MODEL_VERSION_3)
+            fstream >> m_kernelDepth >> m_depthSubsample;
         m_factory = ConvolutionEngineFactory<ElemType>::Create(GetDeviceId(), ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
     }
 
@@ -138,18 +151,29 @@ public:
             node->m_horizontalSubsample = m_horizontalSubsample;
             node->m_verticalSubsample = m_verticalSubsample;
 
+            node->m_kernelDepth = m_kernelDepth;
+            node->m_depthSubsample = m_depthSubsample;
+
             node->m_zeroPadding = m_zeroPadding;
 
             node->m_maxTempMemSizeInSamples = m_maxTempMemSizeInSamples;
 
             node->m_imageLayoutKind = m_imageLayoutKind;
 
-            *node->m_tempMatrix = *m_tempMatrix;
+            CopyMatrixIfAllocated(m_tempMatrix, node->m_tempMatrix);
+
+            node->m_fusedBias = m_fusedBias;
+            node->m_fusedReLU = m_fusedReLU;
+
+            node->m_factory = ConvolutionEngineFactory<ElemType>::Create(node->GetDeviceId(), ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
         }
     }
 
     void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (m_fusedBias)
+            LogicError("%ls %ls operation: no gradients after fusing bias and ReLU for inference.", NodeName().c_str(), OperationName().c_str());
+
         auto sliceOutputGrad = GradientFor(fr);
         auto sliceInput1Value = Input(1)->ValueFor(fr);
 
@@ -192,7 +216,10 @@ public:
         input0.HasNan("Convolution-input0");
         sliceInput1Value.HasNan("Convolution-input1");
 #endif
-        m_convEng->Forward(*m_inT, sliceInput1Value, *m_filterT, input0, *m_convDesc, *m_outT, sliceOutputValue, *m_tempMatrix);
+        if (m_fusedBias)
+            m_convEng->ForwardBiasReLU(*m_inT, sliceInput1Value, *m_filterT, input0, *m_convDesc, *m_biasT, *m_fusedBias, m_fusedReLU, *m_outT, sliceOutputValue, *m_tempMatrix);
+        else
+            m_convEng->Forward(*m_inT, sliceInput1Value, *m_filterT, input0, *m_convDesc, *m_outT, sliceOutputValue, *m_tempMatrix);
 #if NANCHECK
         sliceOutputValue.HasNan("Convolution");
 #endif
@@ -211,6 +238,23 @@ public:
         m_convEng->BackwardBias(*m_outT, srcGrad, *m_biasT, biasGrad);
     }
 
+    // For inference: let the convolution also add the per-channel 'bias' ([outputChannels x 1], or empty for none) and,
+    // if 'relu', apply max(0, x), as done by ComputationNetwork::FuseConvolutionLayers(). Not saved; disables backprop.
+    void FuseBiasAndReLU(const Matrix<ElemType>& bias, bool relu)
+    {
+        if (!bias.IsEmpty() && (bias.GetNumRows() != m_outputChannels || bias.GetNumCols() != 1))
+            InvalidArgument("%ls %ls operation: fused bias must be a [%d x 1] vector.", NodeName().c_str(), OperationName().c_str(), (int) m_outputChannels);
+        m_fusedBias = make_shared<Matrix<ElemType>>(m_deviceId);
+        if (!bias.IsEmpty())
+            m_fusedBias->SetValue(bias);
+        m_fusedReLU = relu;
+    }
+
+    ImageLayoutKind GetImageLayoutKind() const
+    {
+        return m_imageLayoutKind;
+    }
+
     // note: this also infers dimensions from chilren
     void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
@@ -222,23 +266,27 @@ public:
 
         if (isFinalValidationPass && (inDims.m_width < m_kernelWidth || inDims.m_height < m_kernelHeight))
             InvalidArgument("%ls %ls operation requires that input width be >= kernelWidth and input height >= kernelHeight.", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && (inDims.IsVolume() ? inDims.m_depth < m_kernelDepth : m_kernelDepth != 1))
+            InvalidArgument("%ls %ls operation requires that input depth be >= kernelDepth; kernelDepth other than 1 requires an input [W x H x D x C] with imageLayout='cudnn'.", NodeName().c_str(), OperationName().c_str());
 
         // determine output tensor shape
         const int kernelWidthCenter = m_zeroPadding ? m_kernelWidth % 2 : m_kernelWidth;
         const int kernelHeightCenter = m_zeroPadding ? m_kernelHeight % 2 : m_kernelHeight;
+        const int kernelDepthCenter = m_zeroPadding ? m_kernelDepth % 2 : m_kernelDepth;
         auto outDims = ImageDimensions(
             (inDims.m_width - kernelWidthCenter) / m_horizontalSubsample + 1,
             (inDims.m_height - kernelHeightCenter) / m_verticalSubsample + 1,
-            m_outputChannels);
+            m_outputChannels,
+            inDims.IsVolume() ? (inDims.m_depth - kernelDepthCenter) / m_depthSubsample + 1 : 0);
 
-        size_t weightCols = m_kernelWidth * m_kernelHeight * inDims.m_numChannels;
+        size_t weightCols = m_kernelWidth * m_kernelHeight * m_kernelDepth * inDims.m_numChannels;
 
         // check/infer input [0] (weights)
         // BUGBUG: For now, we treat the weights as a 2D matrix. They should be a tensor proper.
         Input(0)->ValidateInferInputDimsFrom(TensorShape(m_outputChannels, weightCols));
 
         if (isFinalValidationPass && (Input(0)->GetAsMatrixNumCols() != weightCols || Input(0)->GetAsMatrixNumRows() != m_outputChannels))
-            LogicError("convolutionWeight matrix %ls should have dimension [%d, %d] which is [outputChannels, kernelWidth * kernelHeight * inputChannels]", Input(0)->NodeName().c_str(), (int) m_outputChannels, (int) weightCols);
+            LogicError("convolutionWeight matrix %ls should have dimension [%d, %d] which is [outputChannels, kernelWidth * kernelHeight * kernelDepth * inputChannels]", Input(0)->NodeName().c_str(), (int) m_outputChannels, (int) weightCols);
 
         // that's our dimension
         SetDims(outDims.AsTensorShape(m_imageLayoutKind), true);
@@ -254,17 +302,19 @@ public:
             //       Why not just pass everything to the engine creator, and get one object that holds everything.
             if (m_convEng == nullptr)
                 m_convEng = m_factory->CreateConvEngine(m_deviceId, m_maxTempMemSizeInSamples);
+            // (a depth of 0 keeps images 4D; volumes are 5D throughout, even where a depth is 1)
+            const size_t volume = inDims.IsVolume() ? 1 : 0;
             if (m_inT == nullptr)
-                m_inT = m_factory->CreateTensor(inDims.m_width, inDims.m_height, inDims.m_numChannels, 1);
+                m_inT = m_factory->CreateTensor(inDims.m_width, inDims.m_height, inDims.m_numChannels, 1, inDims.m_depth);
             if (m_filterT == nullptr)
-                m_filterT = m_factory->CreateFilter(m_kernelWidth, m_kernelHeight, inDims.m_numChannels, m_outputChannels);
+                m_filterT = m_factory->CreateFilter(m_kernelWidth, m_kernelHeight, inDims.m_numChannels, m_outputChannels, volume * m_kernelDepth);
             if (m_outT == nullptr)
-                m_outT = m_factory->CreateTensor(outDims.m_width, outDims.m_height, outDims.m_numChannels, 1);
+                m_outT = m_factory->CreateTensor(outDims.m_width, outDims.m_height, outDims.m_numChannels, 1, outDims.m_depth);
             if (m_convDesc == nullptr)
-                m_convDesc = m_factory->CreateConvDescriptor(*m_inT, *m_filterT, m_horizontalSubsample, m_verticalSubsample, m_zeroPadding);
+                m_convDesc = m_factory->CreateConvDescriptor(*m_inT, *m_filterT, m_horizontalSubsample, m_verticalSubsample, m_zeroPadding, m_depthSubsample);
             // REVIEW alexeyk: create per-channel bias (shared across all pixels). Consider adding other types of biases.
             if (m_biasT == nullptr)
-                m_biasT = m_factory->CreateTensor(1, 1, outDims.m_numChannels, 1);
+                m_biasT = m_factory->CreateTensor(1, 1, outDims.m_numChannels, 1, volume);
         }
     }
 
@@ -282,6 +332,11 @@ public:
         fstream << string(str);
         sprintf(str, "Output[Width:%lu, Height:%lu, Channels:%lu]  \n", outDims.m_width, outDims.m_height, outDims.m_numChannels);
         fstream << string(str);
+        if (inDims.IsVolume())
+        {
+            sprintf(str, "Depth[Input:%lu, Kernel:%lu, SubSample:%lu, Output:%lu]  \n", inDims.m_depth, m_kernelDepth, m_depthSubsample, outDims.m_depth);
+            fstream << string(str);
+        }
         sprintf(str, "zeroPadding=%ls  maxTempMemSizeInSamples=%lu\n", m_zeroPadding ? L"true" : L"false", m_maxTempMemSizeInSamples);
         fstream << string(str);
     }
@@ -295,7 +350,7 @@ public:
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_tempMatrix, matrixPool);
+        RequestMatrixFromPool(m_tempMatrix, matrixPool, "workspace"); // convolution-engine (e.g. cuDNN) workspace
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -309,12 +364,16 @@ private:
     size_t m_outputChannels;
     size_t m_kernelWidth, m_kernelHeight;
     size_t m_horizontalSubsample, m_verticalSubsample;
+    size_t m_kernelDepth, m_depthSubsample; // 1 unless the input is a volume
     bool m_zeroPadding;
     bool m_1DConvolutionOnGPUSparse;
 
     shared_ptr<Matrix<ElemType>> m_tempMatrix;
     size_t m_maxTempMemSizeInSamples; // can change during runtime
 
+    shared_ptr<Matrix<ElemType>> m_fusedBias; // if not null, Forward adds this bias (unless empty) and optionally applies ReLU
+    bool m_fusedReLU = false;
+
     ImageLayoutKind m_imageLayoutKind; // how to interpret the tensor (which dimensions are X/Y and C)
 
     std::unique_ptr<ConvolutionEngineFactory<ElemType>> m_factory;
@@ -347,23 +406,29 @@ public:
           m_windowHeight(SIZE_MAX),
           m_horizontalSubsample(SIZE_MAX),
           m_verticalSubsample(SIZE_MAX),
+          m_windowDepth(1),
+          m_depthSubsample(1),
           m_imageLayoutKind(ImageLayoutKind::HWC)
     {
     }
-    PoolingNodeBase(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind)
+    PoolingNodeBase(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
+                    const size_t windowDepth = 1, const size_t depthSubsample = 1)
         : Base(deviceId, name),
           m_windowWidth(windowWidth),
           m_windowHeight(windowHeight),
           m_horizontalSubsample(horizontalSubsample),
           m_verticalSubsample(verticalSubsample),
+          m_windowDepth(windowDepth),
+          m_depthSubsample(depthSubsample),
           m_imageLayoutKind(imageLayoutKind)
     {
         m_factory = ConvolutionEngineFactory<ElemType>::Create(deviceId, ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
     }
     PoolingNodeBase(const ScriptableObjects::IConfigRecordPtr configp)
-        : PoolingNodeBase(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"windowWidth"), configp->Get(L"windowHeight"), configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")))
+        : PoolingNodeBase(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"windowWidth"), configp->Get(L"windowHeight"), configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")),
+                          configp->Get(L"windowDepth"), configp->Get(L"depthSubsample"))
     {
-        // input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample
+        // input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, windowDepth = 1, depthSubsample = 1
         AttachInputs(configp, this->GetExpectedNumInputs());
     }
 
@@ -373,6 +438,7 @@ public:
         uint32_t imageLayoutKind = (uint32_t) m_imageLayoutKind;
         uint32_t windowWidth = (uint32_t) m_windowWidth;
         fstream << windowWidth << imageLayoutKind << m_windowHeight << m_horizontalSubsample << m_verticalSubsample;
+        fstream << m_windowDepth << m_depthSubsample;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -380,6 +446,8 @@ public:
         Base::Load(fstream, modelVersion);
         uint32_t imageLayoutKind, windowWidth;
         fstream >> windowWidth >> imageLayoutKind >> m_windowHeight >> m_horizontalSubsample >> m_verticalSubsample;
+        if (modelVersion >= CNTK_MODEL_VERSION_3)
+            fstream >> m_windowDepth >> m_depthSubsample;
         m_windowWidth = windowWidth;
         m_imageLayoutKind = (ImageLayoutKind) imageLayoutKind;
         m_factory = ConvolutionEngineFactory<ElemType>::Create(GetDeviceId(), ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
@@ -398,10 +466,15 @@ public:
             node->m_horizontalSubsample = m_horizontalSubsample;
             node->m_verticalSubsample = m_verticalSubsample;
 
+            node->m_windowDepth = m_windowDepth;
+            node->m_depthSubsample = m_depthSubsample;
+
             node->m_inputSizePerSample = m_inputSizePerSample;
             node->m_outputSizePerSample = m_outputSizePerSample;
 
             node->m_imageLayoutKind = m_imageLayoutKind;
+
+            node->m_factory = ConvolutionEngineFactory<ElemType>::Create(node->GetDeviceId(), ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
         }
     }
 
@@ -444,14 +517,17 @@ public:
 
         if (isFinalValidationPass && (inDims.m_width < m_windowWidth || inDims.m_height < m_windowHeight))
             InvalidArgument("PoolingNodeBase: inputWidth must >= windowWidth and inputHeight must >= windowHeight.");
+        if (isFinalValidationPass && (inDims.IsVolume() ? inDims.m_depth < m_windowDepth : m_windowDepth != 1))
+            InvalidArgument("PoolingNodeBase: inputDepth must >= windowDepth; windowDepth other than 1 requires an input [W x H x D x C] with imageLayout='cudnn'.");
 
         // determine output tensor shape
         auto outDims = ImageDimensions(
             (inDims.m_width - m_windowWidth) / m_horizontalSubsample + 1,
             (inDims.m_height - m_windowHeight) / m_verticalSubsample + 1,
-            inDims.m_numChannels);
+            inDims.m_numChannels,
+            inDims.IsVolume() ? (inDims.m_depth - m_windowDepth) / m_depthSubsample + 1 : 0);
 
-        m_inputSizePerSample = inDims.m_width * inDims.m_height * inDims.m_numChannels;
+        m_inputSizePerSample = inDims.m_width * inDims.m_height * max(inDims.m_depth, (size_t) 1) * inDims.m_numChannels;
 
         SetDims(outDims.AsTensorShape(m_imageLayoutKind), true);
 
@@ -465,12 +541,18 @@ public:
             if (m_poolEng == nullptr)
                 m_poolEng = m_factory->CreatePoolEngine(m_deviceId);
             if (m_inT == nullptr)
-                m_inT = m_factory->CreateTensor(inDims.m_width, inDims.m_height, inDims.m_numChannels, 1);
+                m_inT = m_factory->CreateTensor(inDims.m_width, inDims.m_height, inDims.m_numChannels, 1, inDims.m_depth);
             if (m_outT == nullptr)
-                m_outT = m_factory->CreateTensor(outDims.m_width, outDims.m_height, outDims.m_numChannels, 1);
+                m_outT = m_factory->CreateTensor(outDims.m_width, outDims.m_height, outDims.m_numChannels, 1, outDims.m_depth);
         }
     }
 
+    // the depth of the window for the pooling descriptor: 0 unless the input is a volume
+    size_t WindowDepthForDescriptor() const
+    {
+        return m_inT->volumetric() ? m_windowDepth : 0;
+    }
+
     void DumpNodeInfo(const bool printValues, File& fstream) const override
     {
         Base::DumpNodeInfo(printValues, fstream);
@@ -491,6 +573,7 @@ public:
 protected:
     size_t m_windowWidth, m_windowHeight;
     size_t m_horizontalSubsample, m_verticalSubsample;
+    size_t m_windowDepth, m_depthSubsample; // 1 unless the input is a volume
     size_t m_inputSizePerSample, m_outputSizePerSample;
 
     ImageLayoutKind m_imageLayoutKind; // how to interpret the tensor (which dimensions are X/Y and C)
@@ -515,6 +598,8 @@ protected:                                  \
     using Base::m_windowHeight;             \
     using Base::m_horizontalSubsample;      \
     using Base::m_verticalSubsample;        \
+    using Base::m_depthSubsample;           \
+    using Base::WindowDepthForDescriptor;   \
     using Base::m_inputSizePerSample;       \
     using Base::m_outputSizePerSample;      \
     \
@@ -539,8 +624,9 @@ public:
         : Base(deviceId, name)
     {
     }
-    MaxPoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind)
-        : Base(deviceId, name, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayoutKind)
+    MaxPoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
+                   const size_t windowDepth = 1, const size_t depthSubsample = 1)
+        : Base(deviceId, name, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayoutKind, windowDepth, depthSubsample)
     {
     }
     MaxPoolingNode(const ScriptableObjects::IConfigRecordPtr configp)
@@ -552,7 +638,8 @@ public:
     {
         Base::Validate(isFinalValidationPass);
         if (isFinalValidationPass && m_poolDesc == nullptr)
-            m_poolDesc = m_factory->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Max, m_windowWidth, m_windowHeight, m_horizontalSubsample, m_verticalSubsample, 0, 0);
+            m_poolDesc = m_factory->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Max, m_windowWidth, m_windowHeight, m_horizontalSubsample, m_verticalSubsample, 0, 0,
+                                                         WindowDepthForDescriptor(), m_depthSubsample, 0);
     }
 };
 
@@ -578,8 +665,9 @@ public:
         : Base(deviceId, name)
     {
     }
-    AveragePoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind)
-        : Base(deviceId, name, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayoutKind)
+    AveragePoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
+                       const size_t windowDepth = 1, const size_t depthSubsample = 1)
+        : Base(deviceId, name, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayoutKind, windowDepth, depthSubsample)
     {
     }
     AveragePoolingNode(const ScriptableObjects::IConfigRecordPtr configp)
@@ -591,7 +679,8 @@ public:
     {
         Base::Validate(isFinalValidationPass);
         if (isFinalValidationPass && m_poolDesc == nullptr)
-            m_poolDesc = m_factory->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Average, m_windowWidth, m_windowHeight, m_horizontalSubsample, m_verticalSubsample, 0, 0);
+            m_poolDesc = m_factory->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Average, m_windowWidth, m_windowHeight, m_horizontalSubsample, m_verticalSubsample, 0, 0,
+                                                         WindowDepthForDescriptor(), m_depthSubsample, 0);
     }
 };
 
@@ -20,6 +20,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 // ErrorPredictionNode (label, prediction)   or ErrorPredictionNode (prediction, label)
 // performs classification and error counting
+// The labels may also be class indices [1 x T], as input 0 (see ValidateBinaryReduceWithClassIndices()).
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -35,7 +36,7 @@ class ErrorPredictionNode : public ComputationNodeNonLooping /*ComputationNode*/
 public:
     DeclareConstructorFromConfig(ErrorPredictionNode);
     ErrorPredictionNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_classIndices(false)
     {
     }
 
@@ -56,7 +57,10 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        Input(0)->ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
+        if (m_classIndices)
+            m_maxIndexes0->SetValue(Input(0)->ValueFor(fr));
+        else
+            Input(0)->ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
         Input(1)->ValueFor(fr).VectorMax(*m_maxIndexes1, *m_maxValues, true, m_topK);
         MaskMissingColumnsToZero(*m_maxIndexes0, Input(0)->GetMBLayout(), fr);
         MaskMissingColumnsToZero(*m_maxIndexes1, Input(1)->GetMBLayout(), fr);
@@ -71,7 +75,7 @@ public:
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
-        ValidateBinaryReduce(isFinalValidationPass);
+        m_classIndices = ValidateBinaryReduceWithClassIndices(isFinalValidationPass);
 
         m_topK = 1;
         // TODO: Make topK a constructor parameter
@@ -100,9 +104,10 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<ErrorPredictionNode<ElemType>>(nodeP);
-            *node->m_maxIndexes0 = *m_maxIndexes0;
-            *node->m_maxIndexes1 = *m_maxIndexes1;
-            *node->m_maxValues = *m_maxValues;
+            CopyMatrixIfAllocated(m_maxIndexes0, node->m_maxIndexes0);
+            CopyMatrixIfAllocated(m_maxIndexes1, node->m_maxIndexes1);
+            CopyMatrixIfAllocated(m_maxValues, node->m_maxValues);
+            node->m_classIndices = m_classIndices;
         }
     }
     // request matrices needed to do node function value evaluation
@@ -128,6 +133,7 @@ private:
     shared_ptr<Matrix<ElemType>> m_maxIndexes0, m_maxIndexes1;
     shared_ptr<Matrix<ElemType>> m_maxValues;
     int m_topK;
+    bool m_classIndices; // input 0 holds the index of the label, see Validate()
 };
 
 template class ErrorPredictionNode<float>;
@@ -29,7 +29,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>
+class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>, public ICompactlySaveableNode
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembersBoilerplate;
@@ -89,12 +89,22 @@ public:
     }
 
     virtual void Save(File& fstream) const override
+    {
+        Save(fstream, ParameterStorage::full);
+    }
+
+    // save with the value in full precision or in a compact format (see SaveCompactValue())
+    virtual void Save(File& fstream, ParameterStorage storage) const override
     {
         Base::Save(fstream);
         fstream << m_parameterUpdateRequired;
         fstream << (size_t) 0 /*#rows in a legacy file format*/ << (size_t) 0 /*#cols in a legacy file format*/;
         m_sampleLayout.Save(fstream);
-        fstream << Value();
+        fstream << (int) storage;
+        if (storage == ParameterStorage::full)
+            fstream << Value();
+        else
+            SaveCompactValue(fstream, storage);
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -114,7 +124,13 @@ public:
             if (cols > 1) // in some legacy format, last tensor dimension was split off as an explicit column dimension
                 sampleLayout.AppendInPlace(sampleLayout.GetRank(), cols);
         }
-        LoadValue(fstream);
+        int storage = (int) ParameterStorage::full;
+        if (modelVersion >= CNTK_MODEL_VERSION_4)
+            fstream >> storage;
+        if (storage == (int) ParameterStorage::full)
+            LoadValue(fstream);
+        else
+            LoadCompactValue(fstream, (ParameterStorage) storage);
         SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
         VerifyDataSize(Value());      // sanity check
     }
@@ -208,6 +224,170 @@ public:
 
         PrintNodeValuesToFile(printValues, fstream);
     }
+
+private:
+    // compact value formats
+    // Both are written as
+    //  BCompactValue rows cols <payload> checksum ECompactValue
+    // where the payload is
+    //  - fp16: rows x cols IEEE half floats (column-major)
+    //  - int8: rows float scales, then rows x cols signed bytes (column-major); value = scale[row] * byte
+    // and the checksum is the CRC-32 of the payload, so that a corrupted or truncated file is detected at load time
+    // rather than silently evaluating garbage. On load, values are converted back to ElemType, i.e. the loss of
+    // precision is permanent, but the network is otherwise unchanged. Compact formats require binary files.
+    void SaveCompactValue(File& fstream, ParameterStorage storage) const
+    {
+        if (fstream.IsTextBased())
+            InvalidArgument("LearnableParameter %ls: Compact parameter storage requires a binary model file.", NodeName().c_str());
+
+        const size_t rows = Value().GetNumRows();
+        const size_t cols = Value().GetNumCols();
+        std::unique_ptr<ElemType[]> values(Value().CopyToArray()); // column-major
+        unsigned int checksum;
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCompactValue");
+        fstream << rows << cols;
+        if (storage == ParameterStorage::fp16)
+        {
+            std::vector<unsigned short> halves(rows * cols);
+            for (size_t k = 0; k < halves.size(); k++)
+                halves[k] = FloatToHalf((float) values[k]);
+            fstream.WriteBinaryArray(halves.data(), sizeof(unsigned short), halves.size());
+            checksum = Crc32(halves.data(), halves.size() * sizeof(unsigned short));
+        }
+        else if (storage == ParameterStorage::int8)
+        {
+            // per-row scale max|a_ij| / 127, matching CPUInt8Matrix, so that quantizeWeightsToInt8 reproduces these bytes exactly
+            std::vector<float> scales(rows, 0.0f);
+            for (size_t j = 0; j < cols; j++)
+                for (size_t i = 0; i < rows; i++)
+                    scales[i] = std::max(scales[i], fabsf((float) values[j * rows + i]));
+            for (size_t i = 0; i < rows; i++)
+                scales[i] /= 127;
+            std::vector<signed char> bytes(rows * cols);
+            for (size_t j = 0; j < cols; j++)
+                for (size_t i = 0; i < rows; i++)
+                    bytes[j * rows + i] = scales[i] == 0 ? 0 : (signed char) std::max(-127L, std::min(127L, lrintf((float) values[j * rows + i] / scales[i])));
+            fstream.WriteBinaryArray(scales.data(), sizeof(float), scales.size());
+            fstream.WriteBinaryArray(bytes.data(), sizeof(signed char), bytes.size());
+            checksum = Crc32(bytes.data(), bytes.size(), Crc32(scales.data(), scales.size() * sizeof(float)));
+        }
+        else
+            LogicError("SaveCompactValue: Invalid parameter storage %d.", (int) storage);
+        fstream << (int) checksum;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECompactValue");
+    }
+
+    void LoadCompactValue(File& fstream, ParameterStorage storage)
+    {
+        size_t rows, cols;
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCompactValue");
+        fstream >> rows >> cols;
+        std::vector<ElemType> values(rows * cols);
+        unsigned int checksum;
+        if (storage == ParameterStorage::fp16)
+        {
+            std::vector<unsigned short> halves(rows * cols);
+            fstream.ReadBinaryArray(halves.data(), sizeof(unsigned short), halves.size());
+            checksum = Crc32(halves.data(), halves.size() * sizeof(unsigned short));
+            for (size_t k = 0; k < values.size(); k++)
+                values[k] = (ElemType) HalfToFloat(halves[k]);
+        }
+        else if (storage == ParameterStorage::int8)
+        {
+            std::vector<float> scales(rows);
+            std::vector<signed char> bytes(rows * cols);
+            fstream.ReadBinaryArray(scales.data(), sizeof(float), scales.size());
+            fstream.ReadBinaryArray(bytes.data(), sizeof(signed char), bytes.size());
+            checksum = Crc32(bytes.data(), bytes.size(), Crc32(scales.data(), scales.size() * sizeof(float)));
+            for (size_t j = 0; j < cols; j++)
+                for (size_t i = 0; i < rows; i++)
+                    values[j * rows + i] = (ElemType) (scales[i] * bytes[j * rows + i]);
+        }
+        else
+            RuntimeError("LearnableParameter %ls: Unknown parameter storage %d; the model was saved by a newer version or is corrupted.", NodeName().c_str(), (int) storage);
+        int savedChecksum;
+        fstream >> savedChecksum;
+        if ((unsigned int) savedChecksum != checksum)
+            RuntimeError("LearnableParameter %ls: Checksum mismatch in the compact value; the model file is corrupted.", NodeName().c_str());
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECompactValue");
+
+        CreateMatrixIfNull(m_value);
+        Value().SetValue(rows, cols, m_deviceId, values.data(), matrixFlagNormal);
+    }
+
+    // IEEE 754 single to half precision, round to nearest even; overflows to infinity, NaN stays NaN
+    static unsigned short FloatToHalf(float f)
+    {
+        unsigned int x;
+        memcpy(&x, &f, sizeof(x));
+        const unsigned int sign = (x >> 16) & 0x8000;
+        const unsigned int biasedExponent = (x >> 23) & 0xff;
+        unsigned int mantissa = x & 0x7fffff;
+        if (biasedExponent == 0xff) // infinity or NaN
+            return (unsigned short) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        const int exponent = (int) biasedExponent - 127 + 15;
+        if (exponent >= 31)
+            return (unsigned short) (sign | 0x7c00);
+        unsigned int half, rest, halfway;
+        if (exponent <= 0) // half subnormal (or zero)
+        {
+            if (exponent < -10)
+                return (unsigned short) sign;
+            mantissa |= 0x800000;
+            const int shift = 14 - exponent;
+            half = mantissa >> shift;
+            rest = mantissa & ((1u << shift) - 1);
+            halfway = 1u << (shift - 1);
+        }
+        else
+        {
+            half = ((unsigned int) exponent << 10) | (mantissa >> 13);
+            rest = mantissa & 0x1fff;
+            halfway = 0x1000;
+        }
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++; // (a carry into the exponent is correct, up to infinity)
+        return (unsigned short) (sign | half);
+    }
+
+    static float HalfToFloat(unsigned short h)
+    {
+        const unsigned int sign = (unsigned int) (h & 0x8000) << 16;
+        const unsigned int exponent = (h >> 10) & 0x1f;
+        const unsigned int mantissa = h & 0x3ff;
+        unsigned int x;
+        if (exponent == 0x1f) // infinity or NaN
+            x = sign | 0x7f800000 | (mantissa << 13);
+        else if (exponent != 0)
+            x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        else // zero or subnormal: mantissa * 2^-24, exact in float
+        {
+            const float f = mantissa * (1.0f / (1 << 24));
+            return sign ? -f : f;
+        }
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    // CRC-32 (IEEE 802.3); pass the previous result as 'crc' to continue over several buffers
+    static unsigned int Crc32(const void* data, size_t numBytes, unsigned int crc = 0)
+    {
+        unsigned int table[256];
+        for (unsigned int n = 0; n < 256; n++)
+        {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        const unsigned char* bytes = (const unsigned char*) data;
+        crc = ~crc;
+        for (size_t i = 0; i < numBytes; i++)
+            crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
 };
 
 // -----------------------------------------------------------------------
@@ -573,4 +753,224 @@ public:
 
 template class LookupTableNode<float>;
 template class LookupTableNode<double>;
+
+// -----------------------------------------------------------------------
+// EmbeddingLookupNode (embeddingMatrix, ids)
+// looks up columns of an embedding matrix [dim x vocabSize] by ids given directly as dense input [k x *], e.g. the
+// word or item ids of a sample as read by the reader, instead of a one-hot sparse input to LookupTable or Times.
+// The output stacks the k embeddings of each sample [dim*k x *]. Negative ids (e.g. padding) yield zero vectors.
+// The gradient of the embedding matrix is scattered into a SparseBlockCol matrix with one block per distinct id in
+// the minibatch, so that SGD only updates those columns.
+// Note that ids are stored as ElemType, i.e. as float they are exact only up to 2^24.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class EmbeddingLookupNode : public ComputationNode<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"EmbeddingLookup";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(EmbeddingLookupNode);
+    EmbeddingLookupNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (inputIndex != 0)
+            LogicError("%ls %ls operation: The ids have no gradient.", NodeName().c_str(), OperationName().c_str());
+
+        // gaps must neither contribute nor create blocks
+        MaskMissingColumnsTo(Input(1)->Value(), Input(1)->GetMBLayout(), fr, (ElemType) -1);
+        Matrix<ElemType> ids = Input(1)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+
+        auto sliceOutputGradReshaped = sliceOutputGrad.Reshaped(Input(0)->GetAsMatrixNumRows(), ids.GetNumElements());
+        Input(0)->GradientAsMatrix().DoScatterColumnsOf(1, ids, sliceOutputGradReshaped, 1);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 1; }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        Matrix<ElemType> ids = Input(1)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+
+        auto sliceOutputValueReshaped = sliceOutputValue.Reshaped(Input(0)->GetAsMatrixNumRows(), ids.GetNumElements());
+        sliceOutputValueReshaped.DoGatherColumnsOf(0, ids, Input(0)->ValueAsMatrix(), 1);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+
+        if (isFinalValidationPass && !HasMBLayout())
+            InvalidArgument("%ls %ls operation can only operate on minibatches.", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && Input(0)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires the embedding matrix to not be minibatch data (must not have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+
+        size_t idsInEachSample = Input(1)->GetSampleMatrixNumRows();
+        SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * idsInEachSample), true);
+    }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // as for Times with a sparse input, the gradient of the embedding is allocated as a sparse matrix directly, not from the pool
+        if (Input(0)->NeedGradient())
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+};
+
+template class EmbeddingLookupNode<float>;
+template class EmbeddingLookupNode<double>;
+
+// -----------------------------------------------------------------------
+// HashedEmbeddingLookupNode (embeddingMatrix, ids)
+// like EmbeddingLookup, but for vocabularies too large for one column per id (e.g. tens of millions of sparse
+// features): each id is hashed into one of the numBuckets columns of the embedding matrix [dim x numBuckets], so that
+// its size is bounded independent of the vocabulary (feature hashing, Weinberger et al., ICML 2009). With numHashes > 1,
+// the embedding of an id is the sum of the columns of numHashes independent hash functions, which makes it unlikely
+// that two frequent ids collide in all of them. The ids need not be contiguous; negative ids yield zero vectors.
+// The hashed indices are computed by one kernel per call (the same on CPU and GPU) and are not stored, and
+// the lookup and its gradient use the same gather/scatter as EmbeddingLookup, one pass per hash function.
+// Note that ids are stored as ElemType, i.e. as float they are exact only up to 2^24; larger ids are rounded, which
+// just makes them share an embedding.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class HashedEmbeddingLookupNode : public ComputationNode<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"HashedEmbeddingLookup";
+    }
+
+public:
+    HashedEmbeddingLookupNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numHashes = 1)
+        : Base(deviceId, name),
+          m_numHashes(numHashes)
+    {
+    }
+    HashedEmbeddingLookupNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : HashedEmbeddingLookupNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numHashes"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numHashes;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numHashes;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<HashedEmbeddingLookupNode<ElemType>>(nodeP);
+            node->m_numHashes = m_numHashes;
+        }
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (inputIndex != 0)
+            LogicError("%ls %ls operation: The ids have no gradient.", NodeName().c_str(), OperationName().c_str());
+
+        // gaps must neither contribute nor create blocks
+        MaskMissingColumnsTo(Input(1)->Value(), Input(1)->GetMBLayout(), fr, (ElemType) -1);
+        Matrix<ElemType> ids = Input(1)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+
+        auto sliceOutputGradReshaped = sliceOutputGrad.Reshaped(Input(0)->GetAsMatrixNumRows(), ids.GetNumElements());
+        m_hashedIds->AssignHashedIndicesOf(ids, Input(0)->GetAsMatrixNumCols(), m_numHashes);
+        for (size_t h = 0; h < m_numHashes; h++)
+            Input(0)->GradientAsMatrix().DoScatterColumnsOf(1, m_hashedIds->ColumnSlice(h, 1), sliceOutputGradReshaped, 1);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 1; }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        Matrix<ElemType> ids = Input(1)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+
+        auto sliceOutputValueReshaped = sliceOutputValue.Reshaped(Input(0)->GetAsMatrixNumRows(), ids.GetNumElements());
+        m_hashedIds->AssignHashedIndicesOf(ids, Input(0)->GetAsMatrixNumCols(), m_numHashes);
+        for (size_t h = 0; h < m_numHashes; h++)
+            sliceOutputValueReshaped.DoGatherColumnsOf(h == 0 ? 0 : 1, m_hashedIds->ColumnSlice(h, 1), Input(0)->ValueAsMatrix(), 1);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+
+        if (m_numHashes == 0)
+            InvalidArgument("%ls %ls operation requires numHashes to be at least 1.", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && !HasMBLayout())
+            InvalidArgument("%ls %ls operation can only operate on minibatches.", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && Input(0)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires the embedding matrix to not be minibatch data (must not have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+
+        size_t idsInEachSample = Input(1)->GetSampleMatrixNumRows();
+        SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * idsInEachSample), true);
+    }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // as for EmbeddingLookup, the gradient of the embedding only holds the buckets seen in the minibatch
+        if (Input(0)->NeedGradient())
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_hashedIds, matrixPool);
+    }
+
+    // release temp matrices that are no longer needed after all the children's gradients are computed
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_hashedIds, matrixPool);
+    }
+
+private:
+    size_t m_numHashes;
+    shared_ptr<Matrix<ElemType>> m_hashedIds; // [#ids x numHashes] bucket of each id under each hash function
+};
+
+template class HashedEmbeddingLookupNode<float>;
+template class HashedEmbeddingLookupNode<double>;
 } } }
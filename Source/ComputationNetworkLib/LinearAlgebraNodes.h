@@ -9,6 +9,7 @@
 #include "ConvolutionalNodes.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "CPUInt8Matrix.h"
 
 #include <unordered_set>
 #include <map>
@@ -179,6 +180,11 @@ template class NegateNode<double>;
 // TimesNodeBase (A, B)
 // shared code of TimesNode and TransposeTimesNode (which transposes A)
 // right operand and output can have MB layout, while left operand cannot
+// For inference, A can be replaced by an int8-quantized copy (QuantizeWeightsToInt8()), or, if mostly zeros (e.g. pruned),
+// by a sparse copy (SparsifyWeights()), which are used on the CPU.
+// Batched form: if A is a 3D tensor [M x K x N] (TransposeTimes: [K x M x N]) and B's samples are [K x N], the output
+// samples are [M x N], where slice n of the output is A[:,:,n] (transposed) times slice n of B, e.g. one product per
+// head or class. All N products of a minibatch are computed by one batched GEMM call.
 // -----------------------------------------------------------------------
 
 template <class ElemType, bool m_transpose>
@@ -193,8 +199,22 @@ public:
     {
     }
 
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TimesNodeBase<ElemType, m_transpose>>(nodeP);
+            node->m_int8Weights = m_int8Weights; // read-only once quantized, so it can be shared
+            node->m_sparseWeights = m_sparseWeights; // likewise
+        }
+    }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (IsBatched())
+            return BackpropToBatched(inputIndex, fr);
+
         if (inputIndex == 0) // left derivative
         {
             // this potentially computes inner products over time, so we use the Masked- variants
@@ -202,11 +222,12 @@ public:
             auto sliceInput1Value = Input(1)->MaskedValueFor(fr);
             auto& input0Grad = Input(0)->GradientAsMatrix();
 
+            bool transpose = m_transpose; // (assigning to a non-const variable avoids a compiler warning C4127: conditional expression is constant)
+
             // currently we only support one combination when the input is sparse.
             if (sliceInput1Value.GetMatrixType() == SPARSE && Input(0)->Gradient().GetMatrixType() == DENSE && sliceOutputGrad.GetMatrixType() == DENSE)
-                Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+                Input(0)->Gradient().SwitchToMatrixType(SPARSE, SparseGradientFormat(), false);
 
-            bool transpose = m_transpose; // (assigning to a non-const variable avoids a compiler warning C4127: conditional expression is constant)
             if (!transpose)
                 Matrix<ElemType>::MultiplyAndAdd(sliceOutputGrad, false, sliceInput1Value, true, input0Grad);
             else
@@ -228,6 +249,12 @@ public:
         return false;
     }
 
+    // gradient checkpointing: a consumer's recomputation may redo the product, since the operands are still held for our own backprop
+    virtual bool IsValueRecomputable() const override
+    {
+        return true;
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         // right operand and output can have MB layout, while left operand cannot
@@ -236,8 +263,30 @@ public:
 #if DUMPOUTPUT
         Input(0)->ValueAsMatrix().Print("TimesNode - Input0");
 #endif
-        // BUGBUG: This uses correct Matrix dimensions when multiplying with a non-minibatch only by luck. To be fixed when we allow to apply TimesNode to a subset of tensor dimensions.
-        sliceOutputValue.AssignProductOf(Input(0)->ValueAsMatrix(), m_transpose, sliceInput1Value, false);
+        if (IsBatched())
+        {
+            size_t M, K, N;
+            GetBatchDims(M, K, N);
+            size_t T = sliceOutputValue.GetNumCols();
+            if (T > 0)
+                Matrix<ElemType>::MultiplyAndWeightedAddStridedBatched(1, Input(0)->Value(), m_transpose, M * K, sliceInput1Value, false, K,
+                                                                       0, sliceOutputValue, M, M, T, K, N);
+        }
+        else if (m_sparseWeights && sliceInput1Value.GetDeviceId() == CPUDEVICE && sliceInput1Value.GetMatrixType() == DENSE)
+        {
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_sparseWeights, m_transpose, sliceInput1Value, false, 0, sliceOutputValue);
+        }
+        else if (m_int8Weights && sliceInput1Value.GetDeviceId() == CPUDEVICE && sliceInput1Value.GetMatrixType() == DENSE &&
+            sliceInput1Value.GetNumRows() == m_int8Weights->GetNumCols() &&
+            sliceOutputValue.GetNumRows() == m_int8Weights->GetNumRows() && sliceOutputValue.GetNumCols() == sliceInput1Value.GetNumCols())
+        {
+            m_int8Weights->Multiply(sliceInput1Value.BufferPointer(), sliceInput1Value.GetNumCols(), sliceOutputValue.BufferPointer());
+        }
+        else
+        {
+            // BUGBUG: This uses correct Matrix dimensions when multiplying with a non-minibatch only by luck. To be fixed when we allow to apply TimesNode to a subset of tensor dimensions.
+            sliceOutputValue.AssignProductOf(Input(0)->ValueAsMatrix(), m_transpose, sliceInput1Value, false);
+        }
 #if NANCHECK
         sliceOutputValue.HasNan("Times");
 #endif
@@ -253,6 +302,22 @@ public:
             InvalidArgument("%ls Times operation requires the first factor to not be minibatch data (must not have an MBLayout).", NodeName().c_str());
         InferMBLayoutFromInputsForStandardCase();
 
+        if (IsBatched())
+        {
+            size_t M, K, N;
+            GetBatchDims(M, K, N);
+            if (!Input(1)->HasMBLayout())
+                InvalidArgument("%ls Times operation with a 3D first factor requires the second factor to be minibatch data.", NodeName().c_str());
+            Input(1)->ValidateInferInputDimsFrom(TensorShape(K, N));
+            SetDims(TensorShape(M, N), true);
+            const auto& sampleLayout1 = Input(1)->GetSampleLayout();
+            if (isFinalValidationPass && (sampleLayout1.GetRank() != 2 || sampleLayout1[0] != K || sampleLayout1[1] != N))
+                InvalidArgument("%ls Times operation with a 3D first factor [%d x %d x %d] requires samples of dimension [%d x %d] as the second factor, but they are %s.",
+                                NodeName().c_str(), (int) Input(0)->GetSampleLayout()[0], (int) Input(0)->GetSampleLayout()[1], (int) N, (int) K, (int) N,
+                                string(sampleLayout1).c_str());
+            return;
+        }
+
         // support automatic dimension inference for learnable parameters
         size_t rows0 = Input(0)->GetAsMatrixNumRows(), cols0 = Input(0)->GetAsMatrixNumCols();
         bool transpose = m_transpose; // (assigning to a non-const variable avoids a compiler warning C4127: conditional expression is constant)
@@ -293,13 +358,114 @@ public:
         if (Input(0)->NeedGradient() && Input(1)->Value().GetMatrixType() == SPARSE)
         {
             Input(0)->CreateGradientMatrixIfNull();
-            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, SparseGradientFormat(), false);
         }
 
         // we need to call base allocation at end since we will need to allocate special ones first
         // so that the default allocator will not allocate it again.
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
+
+private:
+    bool IsBatched() const
+    {
+        return Input(0)->GetSampleLayout().GetRank() == 3;
+    }
+    // A is [M x K x N] or, transposed, [K x M x N]
+    void GetBatchDims(size_t& M, size_t& K, size_t& N) const
+    {
+        const auto& shape = Input(0)->GetSampleLayout();
+        bool transpose = m_transpose; // (avoids C4127, see above)
+        M = transpose ? shape[1] : shape[0];
+        K = transpose ? shape[0] : shape[1];
+        N = shape[2];
+    }
+
+    // Slice n of a minibatch of B (and of the output) is the n-th group of K (M) rows of its matrix, which the batched
+    // GEMM addresses through the leading dimension and a stride of K (M). Slice n of A is the n-th [M x K] block.
+    void BackpropToBatched(const size_t inputIndex, const FrameRange& fr)
+    {
+        size_t M, K, N;
+        GetBatchDims(M, K, N);
+        if (inputIndex == 0) // left derivative: dA_n += dC_n * B_n' (TransposeTimes: B_n * dC_n')
+        {
+            // this computes inner products over time, so we use the Masked- variants
+            auto sliceOutputGrad = MaskedGradientFor(fr);
+            auto sliceInput1Value = Input(1)->MaskedValueFor(fr);
+            size_t T = sliceOutputGrad.GetNumCols();
+            if (T == 0)
+                return;
+            bool transpose = m_transpose; // (avoids C4127, see above)
+            if (!transpose)
+                Matrix<ElemType>::MultiplyAndWeightedAddStridedBatched(1, sliceOutputGrad, false, M, sliceInput1Value, true, K, 1, Input(0)->Gradient(), M * K, M, K, T, N);
+            else
+                Matrix<ElemType>::MultiplyAndWeightedAddStridedBatched(1, sliceInput1Value, false, K, sliceOutputGrad, true, M, 1, Input(0)->Gradient(), M * K, K, M, T, N);
+        }
+        else // right derivative: dB_n += A_n' * dC_n (TransposeTimes: A_n * dC_n)
+        {
+            auto sliceInput1Grad = Input(1)->GradientFor(fr);
+            auto sliceOutputGrad = GradientFor(fr);
+            size_t T = sliceOutputGrad.GetNumCols();
+            if (T == 0)
+                return;
+            Matrix<ElemType>::MultiplyAndWeightedAddStridedBatched(1, Input(0)->Value(), !m_transpose, M * K, sliceOutputGrad, false, M, 1, sliceInput1Grad, K, K, T, M, N);
+        }
+    }
+
+public:
+    // The gradient of the weight w.r.t. a sparse input only has values in the columns (Times) or rows (TransposeTimes)
+    // that correspond to the input's non-zero rows, e.g. the words in the minibatch, and is kept block-sparse like that,
+    // so that the SGD update only touches those.
+    MatrixFormat SparseGradientFormat() const
+    {
+        bool transpose = m_transpose; // (avoids C4127, see above)
+        return transpose ? MatrixFormat::matrixFormatSparseBlockRow : MatrixFormat::matrixFormatSparseBlockCol;
+    }
+
+    // inference only: quantize the current value of the left operand (a weight matrix) to int8, and from now on use that
+    // on the CPU. The original values are left untouched, so backprop, GPU evaluation and saving still see the full precision.
+    void QuantizeWeightsToInt8()
+    {
+        const auto& weights = Input(0)->ValueAsMatrix();
+        ElemType* values = weights.CopyToArray();
+        m_int8Weights = make_shared<CPUInt8Matrix<ElemType>>(values, weights.GetNumRows(), weights.GetNumCols(), m_transpose);
+        delete[] values;
+    }
+
+    // inference only: if at most 'maxDensity' of the values of the left operand (a weight matrix) are non-zero, keep a sparse
+    // copy of it and from now on use that on the CPU, like QuantizeWeightsToInt8(). Returns whether it did.
+    bool SparsifyWeights(double maxDensity)
+    {
+        const auto& weights = Input(0)->ValueAsMatrix();
+        size_t rows = weights.GetNumRows();
+        size_t cols = weights.GetNumCols();
+        ElemType* values = weights.CopyToArray();
+        vector<CPUSPARSE_INDEX_TYPE> colStarts(1, 0), rowIds;
+        vector<ElemType> nzValues;
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t i = 0; i < rows; i++)
+            {
+                if (values[j * rows + i] != 0)
+                {
+                    rowIds.push_back((CPUSPARSE_INDEX_TYPE) i);
+                    nzValues.push_back(values[j * rows + i]);
+                }
+            }
+            colStarts.push_back((CPUSPARSE_INDEX_TYPE) rowIds.size());
+        }
+        delete[] values;
+        if (nzValues.size() > maxDensity * rows * cols)
+            return false;
+
+        m_sparseWeights = make_shared<Matrix<ElemType>>(rows, cols, CPUDEVICE, SPARSE, matrixFormatSparseCSC);
+        m_sparseWeights->SetMatrixFromCSCFormat(colStarts.data(), rowIds.data(), nzValues.data(), nzValues.size(), rows, cols);
+        return true;
+    }
+
+private:
+    shared_ptr<CPUInt8Matrix<ElemType>> m_int8Weights;
+    shared_ptr<Matrix<ElemType>> m_sparseWeights; // (CSC, on the CPU)
 };
 
 // -----------------------------------------------------------------------
@@ -509,8 +675,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<DiagTimesNode<ElemType>>(nodeP);
-            *node->m_innerproduct = *m_innerproduct;
-            *node->m_rightGradient = *m_rightGradient;
+            CopyMatrixIfAllocated(m_innerproduct, node->m_innerproduct);
+            CopyMatrixIfAllocated(m_rightGradient, node->m_rightGradient);
         }
     }
     // request matrices that are needed for gradient computation
@@ -835,11 +1001,11 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CosDistanceNode<ElemType>>(nodeP);
-            *node->m_invNorm0 = *m_invNorm0;
-            *node->m_invNorm1 = *m_invNorm1;
-            *node->m_leftTerm = *m_leftTerm;
-            *node->m_rightTerm = *m_rightTerm;
-            *node->m_temp = *m_temp;
+            CopyMatrixIfAllocated(m_invNorm0, node->m_invNorm0);
+            CopyMatrixIfAllocated(m_invNorm1, node->m_invNorm1);
+            CopyMatrixIfAllocated(m_leftTerm, node->m_leftTerm);
+            CopyMatrixIfAllocated(m_rightTerm, node->m_rightTerm);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -981,6 +1147,7 @@ public:
     {
     }
 
+    // The cosines and their gradients are each computed in one pass over the inputs, see Matrix::AssignCosDistanceWithShiftNegOf().
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
@@ -989,108 +1156,9 @@ public:
         Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
         Matrix<ElemType> sliceThisGrad = GradientFor(fr);
 
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), sliceInputGrad, sliceThisGrad);
-    }
-
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
-    {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm = leftTerm - rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
-
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
-
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
-
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
+        sliceInputGrad.AddCosDistanceWithShiftNegGradientOf(/*wrtB=*/inputIndex == 1, sliceThisGrad, sliceOutputValue, sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1, shift, negNumber);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1099,31 +1167,15 @@ public:
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
-
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
-
-        // compute the right values
-        // Again, the ouput is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
+        m_invNorm0->AssignVectorNorm2Of(sliceInput0Value, true);
+        m_invNorm0->AssignElementInverseOf(*m_invNorm0);
+        m_invNorm1->AssignVectorNorm2Of(sliceInput1Value, true);
+        m_invNorm1->AssignElementInverseOf(*m_invNorm1);
 
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        // a matrix of (negNumber+1, cols): the cosine of each column of input 0 with that of input 1, and with negNumber shifted ones
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
+        sliceOutputValue.AssignCosDistanceWithShiftNegOf(sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1, shift, negNumber);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1152,12 +1204,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
-            *node->m_invNorm0 = *m_invNorm0;
-            *node->m_invNorm1 = *m_invNorm1;
-            *node->m_invNormSquare = *m_invNormSquare;
-            *node->m_leftTerm = *m_leftTerm;
-            *node->m_rightTerm = *m_rightTerm;
-            *node->m_temp = *m_temp;
+            CopyMatrixIfAllocated(m_invNorm0, node->m_invNorm0);
+            CopyMatrixIfAllocated(m_invNorm1, node->m_invNorm1);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1166,16 +1214,6 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-    }
-
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1184,21 +1222,12 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceWithNegativeSamplesNode<float>;
@@ -8,8 +8,10 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "Basics.h"
 #include "Matrix.h"
@@ -17,52 +19,172 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// MatrixPool -- pool of dense matrices that can be shared between nodes whose lifetimes do not overlap
+//
+// Released matrices are bucketed by device and by capacity. A request hands back the
+// smallest released matrix on the same device whose capacity covers the requested size,
+// or else the largest one (which will then grow), so that a matrix that already holds a big
+// activation is not handed to a tiny one and vice versa, avoiding reallocation per minibatch.
+//
+// All sizes in here are size hints, i.e. elements per sample column (the rows of a node's
+// sample matrix), since requests are made before the minibatch size is known. The capacity
+// of a pooled matrix is the largest size hint of any node it was handed to; its actual
+// allocation, which grows with the minibatch, is not compared against the hints.
+// -----------------------------------------------------------------------
+
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>> m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    template <class ElemType>
+    struct PoolPerType
+    {
+        // per device: capacity -> released matrices
+        map<DEVICEID_TYPE, multimap<size_t, shared_ptr<Matrix<ElemType>>>> m_released;
+        // all matrices ever handed out by this pool, and their capacity
+        map<Matrix<ElemType>*, size_t> m_capacity;
+        vector<shared_ptr<Matrix<ElemType>>> m_allMatrices;
+        // statistics, per device
+        map<DEVICEID_TYPE, size_t> m_inUseElements;
+        map<DEVICEID_TYPE, size_t> m_peakInUseElements;
+        map<DEVICEID_TYPE, size_t> m_numRequests;
+        map<DEVICEID_TYPE, size_t> m_numReused;
+
+        void Clear()
+        {
+            m_released.clear();
+            m_capacity.clear();
+            m_allMatrices.clear();
+            m_inUseElements.clear();
+            m_peakInUseElements.clear();
+            m_numRequests.clear();
+            m_numReused.clear();
+        }
+    };
+
+    PoolPerType<float> m_floatPool;
+    PoolPerType<double> m_doublePool;
+
+    template <class ElemType>
+    PoolPerType<ElemType>& GetPool();
+
+    template <class ElemType>
+    void PrintStatistics(FILE* f, const char* typeName)
+    {
+        PoolPerType<ElemType>& pool = GetPool<ElemType>();
+        map<DEVICEID_TYPE, size_t> numMatrices, residentBytes;
+        for (const auto& matrixPtr : pool.m_allMatrices)
+        {
+            DEVICEID_TYPE deviceId = matrixPtr->GetDeviceId();
+            numMatrices[deviceId]++;
+            residentBytes[deviceId] += matrixPtr->GetMatrixType() == SPARSE ? 0 : matrixPtr->BufferSize();
+        }
+        for (const auto& iter : numMatrices)
+        {
+            DEVICEID_TYPE deviceId = iter.first;
+            fprintf(f, "MatrixPool<%s> device %d: %d matrices for %d requests (%d reused), resident %.2f MB, peak in-use %.2f K elements per sample\n",
+                    typeName, (int) deviceId, (int) iter.second, (int) pool.m_numRequests[deviceId], (int) pool.m_numReused[deviceId],
+                    residentBytes[deviceId] / (1024.0 * 1024.0), pool.m_peakInUseElements[deviceId] / 1024.0);
+        }
+    }
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    void PrintBuckets(FILE* f, const char* typeName)
+    {
+        PoolPerType<ElemType>& pool = GetPool<ElemType>();
+        map<pair<DEVICEID_TYPE, size_t>, pair<size_t, size_t>> buckets; // (device, capacity) -> (number of matrices, resident bytes)
+        for (const auto& matrixPtr : pool.m_allMatrices)
+        {
+            auto& bucket = buckets[make_pair(matrixPtr->GetDeviceId(), pool.m_capacity[matrixPtr.get()])];
+            bucket.first++;
+            bucket.second += matrixPtr->GetMatrixType() == SPARSE ? 0 : matrixPtr->BufferSize();
+        }
+        for (const auto& iter : buckets)
+            fprintf(f, "MatrixPool<%s> device %d, capacity %8d elements per sample: %3d matrices, resident %10.2f MB\n",
+                    typeName, (int) iter.first.first, (int) iter.first.second, (int) iter.second.first, iter.second.second / (1024.0 * 1024.0));
+    }
 
 public:
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
     void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        PoolPerType<ElemType>& pool = GetPool<ElemType>();
         if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
             RuntimeError("MatrixPool::Release: freeMatrix should not be null or sparse.");
+
+        DEVICEID_TYPE deviceId = freeMatrix->GetDeviceId();
+        auto& releasedMatrices = pool.m_released[deviceId];
 #ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
+        for (const auto& iter : releasedMatrices)
         {
-            if (releasedMatrices[i] == freeMatrix)
+            if (iter.second == freeMatrix)
                 RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
         }
-
 #endif
-        releasedMatrices.push_back(freeMatrix);
+        size_t capacity = pool.m_capacity[freeMatrix.get()]; // (0 if the matrix did not come from this pool)
+        size_t& inUse = pool.m_inUseElements[deviceId];
+        inUse -= min(inUse, capacity);
+
+        releasedMatrices.insert(make_pair(capacity, freeMatrix));
     }
 
+    // get a matrix for the given device that was used for (at least) 'numElementsHint' elements per sample if possible
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId, size_t numElementsHint = 0)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        PoolPerType<ElemType>& pool = GetPool<ElemType>();
+        auto& releasedMatrices = pool.m_released[deviceId];
         shared_ptr<Matrix<ElemType>> matrixPtr;
         if (releasedMatrices.empty())
         {
             matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            pool.m_allMatrices.push_back(matrixPtr);
         }
         else
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            // best fit: smallest capacity that is large enough, else the largest one we have
+            auto iter = releasedMatrices.lower_bound(numElementsHint);
+            if (iter == releasedMatrices.end())
+                --iter;
+            matrixPtr = iter->second;
+            releasedMatrices.erase(iter);
+            pool.m_numReused[deviceId]++;
         }
 
         if (!matrixPtr) // this can't really happen
             LogicError("MatrixPool::Request: failed to get a valid matrix.");
 
+        size_t& capacity = pool.m_capacity[matrixPtr.get()];
+        capacity = max(capacity, numElementsHint);
+        size_t& inUse = pool.m_inUseElements[deviceId];
+        inUse += capacity;
+        size_t& peak = pool.m_peakInUseElements[deviceId];
+        peak = max(peak, inUse);
+        pool.m_numRequests[deviceId]++;
+
         return matrixPtr;
     }
+
+    // print number of matrices, reuse, and resident bytes per device
+    // Resident bytes reflect the actual allocations, which only exist once the first minibatch has run.
+    void PrintStatistics(FILE* f = stderr)
+    {
+        PrintStatistics<float>(f, "float");
+        PrintStatistics<double>(f, "double");
+    }
+
+    // the same per capacity bucket (the size hint, i.e. elements per sample column, that matrices are matched by)
+    void PrintBuckets(FILE* f = stderr)
+    {
+        PrintBuckets<float>(f, "float");
+        PrintBuckets<double>(f, "double");
+    }
+
+    // drop all pool state; matrices already handed out remain owned by their nodes
+    void Clear()
+    {
+        m_floatPool.Clear();
+        m_doublePool.Clear();
+    }
 };
 } } }
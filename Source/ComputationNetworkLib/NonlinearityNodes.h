@@ -43,6 +43,14 @@ public:
     {
         size_t rank = DetermineElementwiseTensorRank();
         auto result = ValueTensorFor(rank, fr);
+        if (ComputesValueOfInput()) // input is a Plus node whose Value is not computed: apply op to the sum of its inputs in one pass
+        {
+            const auto& summands = Input(0)->GetInputs();
+            auto input0 = dynamic_pointer_cast<ComputationNode<ElemType>>(summands[0])->ValueTensorFor(rank, fr.AllowBroadcast());
+            auto input1 = dynamic_pointer_cast<ComputationNode<ElemType>>(summands[1])->ValueTensorFor(rank, fr.AllowBroadcast());
+            result.DoBinaryOpOf(0, input0, input1, 1, OpOfSum());
+            return;
+        }
         auto input = Input(0)->ValueTensorFor(rank, fr);
         result.DoUnaryOpOf(0, input, 1, opForward);
     }
@@ -76,6 +84,30 @@ public:
     {
         return !gradientFromOutput;
     }
+
+    // a single elementwise op, cheap to redo in backprop
+    virtual bool IsValueRecomputable() const override
+    {
+        return true;
+    }
+
+    // the ops that have a fused variant op(a + b); backprop is unaffected since it only uses the output
+    virtual bool CanFuseSumOfInput() const override
+    {
+        return gradientFromOutput && OpOfSum() != opForward;
+    }
+
+private:
+    static ElementWiseOperator OpOfSum()
+    {
+        switch (opForward)
+        {
+        case opSigmoid:         return opSigmoidOfSum;
+        case opTanh:            return opTanhOfSum;
+        case opLinearRectifier: return opLinearRectifierOfSum;
+        default:                return opForward; // no fused variant
+        }
+    }
 };
 
 #define UnaryElementWiseWithOpCodeNodeBaseMembers UsingComputationNodeMembersBoilerplate;
@@ -180,7 +212,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SoftmaxNodeBase<ElemType>>(nodeP);
-            *node->m_gradientTemp = *m_gradientTemp;
+            CopyMatrixIfAllocated(m_gradientTemp, node->m_gradientTemp);
         }
     }
 
@@ -258,7 +290,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SoftmaxNode<ElemType>>(nodeP);
-            *node->m_diff = *m_diff;
+            CopyMatrixIfAllocated(m_diff, node->m_diff);
         }
     }
     // request matrices that are needed for gradient computation
@@ -331,7 +363,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LogSoftmaxNode<ElemType>>(nodeP);
-            *node->m_softmax = *m_softmax;
+            CopyMatrixIfAllocated(m_softmax, node->m_softmax);
         }
     }
     // request matrices that are needed for gradient computation
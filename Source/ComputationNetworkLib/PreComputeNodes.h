@@ -58,6 +58,7 @@ public:
         return true;
     }
 
+
     virtual void Save(File& fstream) const override
     {
         Base::Save(fstream);
@@ -184,6 +185,26 @@ public:
         // LogicError("Mean operation should not be involved in the gradient calculation.");
     }
 
+    // for precomputing on several workers, each over its share of the data: the statistics accumulated so far,
+    // which the caller replaces by the ones merged across workers before MarkComputed(true)
+    size_t GetNumAccumulatedSamples() const
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: GetNumAccumulatedSamples() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        return m_numSamples;
+    }
+    void SetNumAccumulatedSamples(size_t numSamples)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: SetNumAccumulatedSamples() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        m_numSamples = numSamples;
+    }
+    virtual Matrix<ElemType>& AccumulatedMean() = 0;
+    virtual Matrix<ElemType>* AccumulatedVariance() // (around AccumulatedMean())
+    {
+        return nullptr;
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -246,6 +267,11 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual Matrix<ElemType>& AccumulatedMean() override
+    {
+        return Value();
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -323,24 +349,16 @@ public:
             Value().SetValue(0); // also set this because not doing it may flag during debugging; avoids special-casing this
         }
         else // finalize
-        {
-            ElemType sqrtFloor = 1e-10f;
-            m_var.InplaceTruncateBottom(sqrtFloor); // prevent too small variance (and negative square roots due to numeric inaccuracy)
-#if NANCHECK
-            m_var.HasNan("MarkComputed-InplaceTruncateBottom");
-#endif
-            m_var.InplaceSqrt();
-
-#if NANCHECK
-            m_var.HasNan("MarkComputed-InplaceSqrt");
-#endif
-            m_var.ElementInverse();
+            UpdateInvStdDev();
+    }
 
-#if NANCHECK
-            m_var.HasNan("MarkComputed-ElementInverse()");
-#endif
-            Value().SetValue(m_var);
-        }
+    virtual Matrix<ElemType>& AccumulatedMean() override
+    {
+        return m_mean;
+    }
+    virtual Matrix<ElemType>* AccumulatedVariance() override
+    {
+        return &m_var;
     }
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
@@ -382,6 +400,7 @@ public:
 #if NANCHECK
         m_var.HasNan("InvStdDev-m_var");
 #endif
+        UpdateInvStdDev(); // running estimate, used when training while accumulating (SGD's 'streamingPreCompute')
 
 #if 0   // BUGBUG: This is the correct version, but it will break test cases, so do this later. MeanNode does it right already.
         m_numSamples += Input(0)->GetMBLayout()->GetActualNumSamples();
@@ -403,6 +422,27 @@ public:
     }
 
 private:
+    // Value() = 1/sqrt(variance accumulated so far); m_var itself keeps accumulating
+    void UpdateInvStdDev()
+    {
+        ElemType sqrtFloor = 1e-10f;
+        Value().SetValue(m_var);
+        Value().InplaceTruncateBottom(sqrtFloor); // prevent too small variance (and negative square roots due to numeric inaccuracy)
+#if NANCHECK
+        Value().HasNan("UpdateInvStdDev-InplaceTruncateBottom");
+#endif
+        Value().InplaceSqrt();
+
+#if NANCHECK
+        Value().HasNan("UpdateInvStdDev-InplaceSqrt");
+#endif
+        Value().ElementInverse();
+
+#if NANCHECK
+        Value().HasNan("UpdateInvStdDev-ElementInverse()");
+#endif
+    }
+
     Matrix<ElemType> m_mean;
     Matrix<ElemType> m_var;
     Matrix<ElemType> m_temp;
@@ -112,13 +112,15 @@ private:
 protected:
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId),
+          m_maskedGradient(deviceId)
     {
         Init(TensorShape(), (ElemType) DEFAULT_HIDDEN_ACTIVATION);
     }
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name, ElemType initialActivationValue, const TensorShape& sampleLayout, size_t timeStep)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId),
+          m_maskedGradient(deviceId)
     {
         Init(sampleLayout, initialActivationValue);
         m_timeStep = (int) timeStep; // TODO: pass this to Init() instead as well
@@ -203,19 +205,13 @@ public:
             //       m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed));
             if (m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed)) // true if at least one parallel sequence has a boundary or gap
             {
-                size_t mNbr = m_pMBLayout->GetNumParallelSequences();
-                for (size_t id = 0; id < mNbr; id++)
+                // don't propagate boundary frames or gaps: mask them out with the layout's continuation mask
+                if (AnyContinues(fr))
                 {
-                    // assert(m_pShiftedMBLayout->Is(id, t, SequenceStart_or_End | MinibatchPackingFlags::NoFeature) ==
-                    //       m_pMBLayout->IsGap(fr.Sequence(id)) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)));
-                    if (!(m_pMBLayout->IsGap(fr.Sequence(id)) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))) // don't propagate boundary frames or gaps
-                    {
-                        Matrix<ElemType> frm = GradientFor(fr.Sequence(id));
-                        // TODO: use delayed FrameRange here as well
-                        // Matrix<ElemType> to = Input(0)->GradientFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
-                        Matrix<ElemType> to = Input(0)->GradientFor(frDelayed.Sequence(id));
-                        to += frm;
-                    }
+                    m_maskedGradient.SetValue(GradientFor(fr));
+                    m_maskedGradient.MaskColumnsValue(DataWithMBLayoutFor(ContinuationMask(), fr, m_pMBLayout), 0);
+                    Matrix<ElemType> to = Input(0)->GradientFor(frDelayed);
+                    to += m_maskedGradient;
                 }
             }
             else // operate on entire time step in one go (over all parallel sequences)
@@ -244,6 +240,7 @@ public:
         return false;
     }
 
+
     virtual void EndForwardProp() override // called after last iteration step of ForwardProp()
     {
         // In truncated BPTT, we carry over left-to-right state across minibatches.
@@ -292,52 +289,30 @@ public:
         size_t t = fr.t();
         int t_delayed = (int) (t + direction * m_timeStep); // this might end up outside the current window
 
-        Matrix<ElemType> inp; // ((DEVICEID_TYPE)m_value.GetDeviceId());
+        Matrix<ElemType> out = ValueFor(fr);
 
-        // if any sequence at this time step has a boundary flag, then process one by one
-        // TODO: Would there be an efficiency gain from grouping consecutive sequences with identical flags?
+        // if any sequence at this time step has a boundary flag, then it gets the initial value instead, through the layout's
+        // continuation mask; if all of them have, there may not even be a delayed value to copy (e.g. in the first minibatch)
         // assert(m_pShiftedMBLayout->Is(t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed));
-        if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed))
+        bool hasBoundary = m_pMBLayout->IsBeyondStartOrEnd(frDelayed);
+        if (hasBoundary && !AnyContinues(fr))
         {
-            for (size_t id = 0; id < GetNumParallelSequences(); id++)
-            {
-                if (m_pMBLayout->IsGap(fr.Sequence(id))) // if output is in a gap then don't bother filling it
-                    continue;
-
-                Matrix<ElemType> out = ValueFor(fr.Sequence(id));
-
-                // assert(m_pShiftedMBLayout->Is(id, t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)));
-                if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))
-                    out.SetValue(m_initialActivationValue); // crossed a boundary
-                else                                        // not a boundary: just copy the delayed value
-                {
-                    // inside the sequence: access delayed value
-                    if (t_delayed < 0)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
-                    else if (t_delayed >= T)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
-                    else
-                        inp = Input(0)->ValueFor(frDelayed.Sequence(id));
-                    // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
-
-                    out.SetValue(inp);
-                }
-            }
+            out.SetValue(m_initialActivationValue); // all crossed a boundary
+            return;
         }
-        else // frame has no boundary flags: use ValueFor directly (still may have a gap here)
-        {
-            Matrix<ElemType> out = ValueFor(fr);
 
-            if (t_delayed < 0)
-                inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout);
-            else if (t_delayed >= T)
-                inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout);
-            else
-                inp = Input(0)->ValueFor(frDelayed);
-            // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed));
+        Matrix<ElemType> inp; // ((DEVICEID_TYPE)m_value.GetDeviceId());
+        if (t_delayed < 0)
+            inp = DataWithMBLayoutFor(m_delayedValue, WithSequencesOf(fr, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation)), m_delayedActivationMBLayout); // delay reaches in previous minibatch
+        else if (t_delayed >= T)
+            inp = DataWithMBLayoutFor(m_delayedValue, WithSequencesOf(fr, FrameRange(m_delayedActivationMBLayout, t_delayed - T)), m_delayedActivationMBLayout); // delay reaches in previous minibatch
+        else
+            inp = Input(0)->ValueFor(frDelayed);
+        // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed));
 
-            out.SetValue(inp);
-        }
+        out.SetValue(inp); // (gaps get copied as well; they are don't-cares)
+        if (hasBoundary)
+            out.MaskColumnsValue(DataWithMBLayoutFor(ContinuationMask(), fr, m_pMBLayout), m_initialActivationValue); // crossed a boundary
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -345,11 +320,89 @@ public:
         ValidateUnaryMap(isFinalValidationPass);
     }
 
+private:
+    // 'frTime' restricted to the same parallel sequences as 'fr'
+    static FrameRange WithSequencesOf(const FrameRange& fr, const FrameRange& frTime)
+    {
+        return fr.seqIndex == SIZE_MAX ? frTime : frTime.Sequences(fr.seqIndex, fr.m_numSequences);
+    }
+
+    // Which frames continue their sequence in the delayed frame is determined once per minibatch by the MBLayout, and
+    // uploaded once as a column mask shared by all delay nodes on it. A time step with boundaries (or gaps) is then a copy
+    // of all parallel sequences and a masked fill, both on the device, rather than a copy per sequence.
+    const Matrix<char>& ContinuationMask() const
+    {
+        return m_pMBLayout->GetContinuationMask(direction * m_timeStep, m_deviceId);
+    }
+
+    // does any sequence of the time step 'fr' continue in the delayed frame? (from the host copy of the mask)
+    bool AnyContinues(const FrameRange& fr) const
+    {
+        const size_t S = GetNumParallelSequences();
+        const auto& continues = m_pMBLayout->GetContinuationFlags(direction * m_timeStep);
+        auto sequenceRange = fr.GetSequenceRange(m_pMBLayout); // (the loop may have narrowed fr to the parallel sequences that are not gaps)
+        for (size_t s = sequenceRange.begin(); s < sequenceRange.end(); s++)
+        {
+            if (continues[s + fr.t() * S])
+                return true;
+        }
+        return false;
+    }
+
+public:
     virtual int /*IRecurrentNode::*/ GetRecurrenceSteppingDirection() const override
     {
         return -direction;
     }
 
+    ElemType GetInitialActivationValue() const
+    {
+        return m_initialActivationValue;
+    }
+
+    // the boundary conditions of ForwardProp() for all frames at once, for loops that run the recurrence in one pass
+    // (see Matrix::SimpleRNNForward()): continues(s,t) = 1 where the delayed frame lies inside the sequence, and
+    // hStart(:,s) the delayed value of the first frame of the iteration if that lies in the previous minibatch.
+    // Returns false for a time step other than 1, which is not supported there.
+    bool GetBoundaryConditions(Matrix<ElemType>& hStart, Matrix<ElemType>& continues) const
+    {
+        if (m_timeStep != 1)
+            return false;
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        const size_t tFirst = direction < 0 ? 0 : T - 1; // first frame of the iteration
+        std::vector<ElemType> continuesHost(S * T);
+        bool needsCarriedState = false;
+        for (size_t t = 0; t < T; t++)
+        {
+            FrameRange fr(m_pMBLayout, t);
+            FrameRange frDelayed = fr.WithTimeOffset(direction);
+            for (size_t s = 0; s < S; s++)
+            {
+                bool continuing = !m_pMBLayout->IsGap(fr.Sequence(s)) && !m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(s));
+                continuesHost[s + t * S] = continuing ? (ElemType) 1 : 0;
+                if (continuing && t == tFirst)
+                    needsCarriedState = true;
+            }
+        }
+        continues.SetValue(S, T, m_deviceId, continuesHost.data());
+
+        if (!needsCarriedState)
+        {
+            hStart.Resize(GetSampleMatrixNumRows(), S);
+            hStart.SetValue(0);
+        }
+        else // delay reaches into the previous minibatch, as in ForwardProp()
+        {
+            size_t T_delayedActivation = m_delayedActivationMBLayout ? m_delayedActivationMBLayout->GetNumTimeSteps() : 0;
+            if (T_delayedActivation == 0 || m_delayedActivationMBLayout->GetNumParallelSequences() != S)
+                return false;
+            size_t tDelayed = direction < 0 ? T_delayedActivation - 1 : 0;
+            hStart.SetValue(m_delayedValue.ColumnSlice(tDelayed * S, S));
+        }
+        return true;
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -442,11 +495,28 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    // Streaming evaluation (CNTKEvalStreaming), where the parallel sequences of consecutive minibatches are not the same
+    // streams, carries the state over by itself: after ForwardProp(), it takes each stream's last frames from the
+    // input values kept for the next minibatch, and before the next one, it sets the frames the delay reaches into,
+    // 'numTimeSteps' (>= m_timeStep) frames for each of the 'numParallelSequences' sequences of that minibatch.
+    int GetTimeStep() const { return m_timeStep; }
+    const Matrix<ElemType>& GetDelayedValue() const { return m_delayedValue; }
+    void SetDelayedValue(const Matrix<ElemType>& value, size_t numParallelSequences, size_t numTimeSteps)
+    {
+        if (value.GetNumCols() != numParallelSequences * numTimeSteps)
+            LogicError("SetDelayedValue: %d columns given for %d parallel sequences of %d time steps.", (int) value.GetNumCols(), (int) numParallelSequences, (int) numTimeSteps);
+        m_delayedValue.SetValue(value);
+        if (!m_delayedActivationMBLayout)
+            m_delayedActivationMBLayout = make_shared<MBLayout>();
+        m_delayedActivationMBLayout->Init(numParallelSequences, numTimeSteps);
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
     MBLayoutPtr m_delayedActivationMBLayout; // layout for m_delayedValue
     int m_timeStep;                          // delay in frames (typ. 1)
+    Matrix<ElemType> m_maskedGradient;       // (BackpropTo() of a time step with boundaries)
     function<void()> m_attachInputsFn;       // for late expansion of inputs (scripting)
 };
 
@@ -530,6 +600,325 @@ public:
 template class FutureValueNode<float>;
 template class FutureValueNode<double>;
 
+// -----------------------------------------------------------------------
+// LSTMNode (input, W, R, b) -- fused LSTM layer over whole sequences
+//
+// Computes a standard LSTM without peepholes over all frames of the minibatch:
+//   z_t = W x_t + R h_{t-1} + b        (4H rows: gates i, f, o, then cell input g)
+//   i_t, f_t, o_t = sigmoid(z_t[0:3H]); g_t = tanh(z_t[3H:4H])
+//   c_t = f_t .* c_{t-1} + i_t .* g_t
+//   h_t = o_t .* tanh(c_t)             (node output)
+// with W: [4H x inDim], R: [4H x H], b: [4H x 1]. h_{-1} and c_{-1} are 0 at sequence start,
+// and are carried over from the previous minibatch for sequences that continue (truncated BPTT).
+//
+// Unlike a network built from PastValue/Times/Plus/Sigmoid/ElementTimes nodes, the input
+// projection of all frames is done as one GEMM, and each time step needs only one GEMM plus
+// two tensor ops for the gate nonlinearities, instead of a dozen nodes each with its own
+// output matrix and kernel launches. The node is not a recurrent loop node; it runs its own
+// recurrence over all frames in ForwardProp() and backpropagates through time in one go.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class LSTMNode : public ComputationNode<ElemType>, public NumInputs<4>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"LSTM";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(LSTMNode);
+    LSTMNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name),
+          m_carriedH(deviceId),
+          m_carriedC(deviceId),
+          m_gatesGradientValid(false)
+    {
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        if (isFinalValidationPass && !Input(0)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires its input to be minibatch data (must have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+        InferMBLayoutFromInputsForStandardCase();
+
+        // the hidden dimension is determined by the recurrent weights R: [4H x H]
+        size_t hiddenDim = Input(2)->GetAsMatrixNumCols();
+        size_t inputDim = Input(0)->GetSampleMatrixNumRows();
+        Input(1)->ValidateInferInputDimsFrom(TensorShape(4 * hiddenDim, inputDim));
+        Input(3)->ValidateInferInputDimsFrom(TensorShape(4 * hiddenDim, 1));
+
+        if (isFinalValidationPass)
+        {
+            if (hiddenDim == 0 || Input(2)->GetAsMatrixNumRows() != 4 * hiddenDim)
+                InvalidArgument("%ls %ls operation: recurrent weights must be [4H x H], but are [%d x %d].", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(2)->GetAsMatrixNumRows(), (int) hiddenDim);
+            if (Input(1)->GetAsMatrixNumRows() != 4 * hiddenDim || Input(1)->GetAsMatrixNumCols() != inputDim)
+                InvalidArgument("%ls %ls operation: input weights must be [%d x %d], but are [%d x %d].", NodeName().c_str(), OperationName().c_str(),
+                                (int) (4 * hiddenDim), (int) inputDim, (int) Input(1)->GetAsMatrixNumRows(), (int) Input(1)->GetAsMatrixNumCols());
+            if (Input(3)->GetAsMatrixNumRows() != 4 * hiddenDim || Input(3)->GetAsMatrixNumCols() != 1)
+                InvalidArgument("%ls %ls operation: bias must be [%d x 1], but is [%d x %d].", NodeName().c_str(), OperationName().c_str(),
+                                (int) (4 * hiddenDim), (int) Input(3)->GetAsMatrixNumRows(), (int) Input(3)->GetAsMatrixNumCols());
+        }
+
+        SetDims(TensorShape(hiddenDim), true);
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        if (!fr.IsAllFrames())
+            LogicError("%ls %ls operation cannot be part of a recurrent loop; it runs the recurrence over all frames itself.", NodeName().c_str(), OperationName().c_str());
+
+        const size_t H = GetSampleMatrixNumRows();
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        const size_t N = S * T;
+
+        m_gates->Resize(4 * H, N);
+        m_cells->Resize(H, N);
+        m_tanhCells->Resize(H, N);
+        m_prevH->Resize(H, N);
+        m_prevC->Resize(H, N);
+        Matrix<ElemType>& output = Value();
+
+        // input projection of all frames at once, plus bias
+        Matrix<ElemType>::Multiply(Input(1)->ValueAsMatrix(), false, Input(0)->ValueFor(fr), false, *m_gates);
+        TensorView<ElemType>(*m_gates).AddCopyOf(TensorView<ElemType>(Input(3)->ValueAsMatrix()));
+
+        const bool haveCarriedState = m_carriedH.GetNumCols() == S && m_carriedH.GetNumRows() == H;
+        for (size_t t = 0; t < T; t++)
+        {
+            auto hPrev = m_prevH->ColumnSlice(t * S, S);
+            auto cPrev = m_prevC->ColumnSlice(t * S, S);
+            if (t > 0)
+            {
+                TensorView<ElemType>(hPrev).AssignCopyOf(TensorView<ElemType>(output.ColumnSlice((t - 1) * S, S)));
+                TensorView<ElemType>(cPrev).AssignCopyOf(TensorView<ElemType>(m_cells->ColumnSlice((t - 1) * S, S)));
+            }
+            else if (haveCarriedState)
+            {
+                TensorView<ElemType>(hPrev).AssignCopyOf(TensorView<ElemType>(m_carriedH));
+                TensorView<ElemType>(cPrev).AssignCopyOf(TensorView<ElemType>(m_carriedC));
+            }
+            else
+            {
+                hPrev.SetValue(0);
+                cPrev.SetValue(0);
+            }
+            ZeroColumnsAtSequenceStart(hPrev, t);
+            ZeroColumnsAtSequenceStart(cPrev, t);
+
+            auto z = m_gates->ColumnSlice(t * S, S);
+            Matrix<ElemType>::MultiplyAndAdd(Input(2)->ValueAsMatrix(), false, hPrev, false, z);
+            auto sigmoidGates = GateRows(z, 0, 3 * H);
+            auto cellInput = GateRows(z, 3 * H, 4 * H);
+            sigmoidGates.AssignSigmoidOf(sigmoidGates);
+            cellInput.AssignTanhOf(cellInput);
+
+            auto c = m_cells->ColumnSlice(t * S, S);
+            auto tanhC = m_tanhCells->ColumnSlice(t * S, S);
+            TensorView<ElemType> cView(c);
+            cView.AssignElementwiseProductOf(GateRows(z, H, 2 * H), TensorView<ElemType>(cPrev));
+            cView.AddElementwiseProductOf(GateRows(z, 0, H), cellInput);
+            TensorView<ElemType>(tanhC).AssignTanhOf(cView);
+            TensorView<ElemType>(output.ColumnSlice(t * S, S)).AssignElementwiseProductOf(GateRows(z, 2 * H, 3 * H), TensorView<ElemType>(tanhC));
+        }
+        // gap columns must not leak into the weight gradient of R
+        MaskMissingColumnsToZero(*m_prevH, m_pMBLayout, fr);
+    }
+
+    virtual void /*IComputationNode::*/ EndForwardProp() override
+    {
+        // carry the last state over to the next minibatch if any sequence continues there
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        if (m_pMBLayout->HasSequenceBeyondEnd() && T > 0)
+        {
+            m_carriedH.SetValue(Value().ColumnSlice((T - 1) * S, S));
+            m_carriedC.SetValue(m_cells->ColumnSlice((T - 1) * S, S));
+        }
+        else
+        {
+            m_carriedH.Resize(0, 0);
+            m_carriedC.Resize(0, 0);
+        }
+        Base::EndForwardProp();
+    }
+
+    virtual void /*IComputationNode::*/ BeginBackprop() override
+    {
+        Base::BeginBackprop();
+        m_gatesGradientValid = false;
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (!fr.IsAllFrames())
+            LogicError("%ls %ls operation cannot be part of a recurrent loop; it runs the recurrence over all frames itself.", NodeName().c_str(), OperationName().c_str());
+
+        // the gradient w.r.t. the pre-activations is shared by all inputs, so compute it once per backprop pass
+        if (!m_gatesGradientValid)
+        {
+            BackpropThroughTime(fr);
+            m_gatesGradientValid = true;
+        }
+
+        if (inputIndex == 0) // input
+        {
+            auto sliceInputGrad = Input(0)->GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndAdd(Input(1)->ValueAsMatrix(), true, *m_gatesGradient, false, sliceInputGrad);
+        }
+        else if (inputIndex == 1) // input weights
+        {
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, Input(0)->MaskedValueFor(fr), true, Input(1)->GradientAsMatrix());
+        }
+        else if (inputIndex == 2) // recurrent weights
+        {
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, *m_prevH, true, Input(2)->GradientAsMatrix());
+        }
+        else if (inputIndex == 3) // bias
+        {
+            const Matrix<ElemType>& ones = ConstOnes(m_gatesGradient->GetNumCols(), 1, m_gatesGradient->GetDeviceId());
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, ones, false, Input(3)->GradientAsMatrix());
+        }
+    }
+
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
+    {
+        return childIndex <= 2; // x for dW, W for dx, R for the recurrence; the bias is not needed
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_gates, matrixPool);
+        RequestMatrixFromPool(m_cells, matrixPool);
+        RequestMatrixFromPool(m_tanhCells, matrixPool);
+        RequestMatrixFromPool(m_prevH, matrixPool);
+        RequestMatrixFromPool(m_prevC, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_gatesGradient, matrixPool);
+        RequestMatrixFromPool(m_hGradientNext, matrixPool);
+        RequestMatrixFromPool(m_cGradientNext, matrixPool);
+        RequestMatrixFromPool(m_cGradient, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gates, matrixPool);
+        ReleaseMatrixToPool(m_cells, matrixPool);
+        ReleaseMatrixToPool(m_tanhCells, matrixPool);
+        ReleaseMatrixToPool(m_prevH, matrixPool);
+        ReleaseMatrixToPool(m_prevC, matrixPool);
+        ReleaseMatrixToPool(m_gatesGradient, matrixPool);
+        ReleaseMatrixToPool(m_hGradientNext, matrixPool);
+        ReleaseMatrixToPool(m_cGradientNext, matrixPool);
+        ReleaseMatrixToPool(m_cGradient, matrixPool);
+    }
+
+private:
+    // view onto rows [begin, end) of a [4H x S] gate slice
+    static TensorView<ElemType> GateRows(const Matrix<ElemType>& gates, size_t begin, size_t end)
+    {
+        TensorShape shape(gates.GetNumRows(), gates.GetNumCols());
+        shape.NarrowTo(0, begin, end);
+        return TensorView<ElemType>(gates, shape);
+    }
+
+    // zero the state of all parallel sequences that begin at frame t
+    void ZeroColumnsAtSequenceStart(Matrix<ElemType>& state, size_t t) const
+    {
+        FrameRange frPrev = FrameRange(m_pMBLayout, t).WithTimeOffset(-1);
+        if (!m_pMBLayout->IsBeyondStartOrEnd(frPrev))
+            return;
+        for (size_t s = 0; s < state.GetNumCols(); s++)
+            if (m_pMBLayout->IsBeyondStartOrEnd(frPrev.Sequence(s)))
+                state.ColumnSlice(s, 1).SetValue(0);
+    }
+
+    // compute m_gatesGradient (gradient w.r.t. the pre-activations z) for all frames, backwards through time
+    void BackpropThroughTime(const FrameRange& fr)
+    {
+        const size_t H = GetSampleMatrixNumRows();
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+
+        m_gatesGradient->Resize(4 * H, S * T);
+        m_hGradientNext->Resize(H, S);
+        m_cGradientNext->Resize(H, S);
+        m_cGradient->Resize(H, S);
+        m_hGradientNext->SetValue(0);
+        m_cGradientNext->SetValue(0);
+
+        // gaps must not contribute
+        MaskMissingGradientColumnsToZero(fr);
+
+        TensorView<ElemType> dh(*m_hGradientNext), dcNext(*m_cGradientNext), dc(*m_cGradient);
+        for (size_t t = T; t-- > 0;)
+        {
+            auto z = m_gates->ColumnSlice(t * S, S);
+            auto dz = m_gatesGradient->ColumnSlice(t * S, S);
+            TensorView<ElemType> tanhC(m_tanhCells->ColumnSlice(t * S, S));
+            TensorView<ElemType> cPrev(m_prevC->ColumnSlice(t * S, S));
+            auto gateI = GateRows(z, 0, H), gateF = GateRows(z, H, 2 * H), gateO = GateRows(z, 2 * H, 3 * H), cellInput = GateRows(z, 3 * H, 4 * H);
+
+            // total gradient w.r.t. h_t: from the output, plus from the recurrence into frame t+1
+            dh.AddCopyOf(TensorView<ElemType>(Gradient().ColumnSlice(t * S, S)));
+
+            // output gate
+            auto dzO = GateRows(dz, 2 * H, 3 * H);
+            dzO.AssignElementwiseProductOf(dh, tanhC);
+            dzO.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(dzO, gateO);
+
+            // cell: dc = dcNext + (dh .* o) .* tanh'(c)
+            dc.AssignElementwiseProductOf(dh, gateO);
+            dc.AssignElementwiseProductWithTanhDerivativeFromOutputOf(dc, tanhC);
+            dc.AddCopyOf(dcNext);
+
+            // input gate, forget gate, cell input
+            auto dzI = GateRows(dz, 0, H), dzF = GateRows(dz, H, 2 * H), dzG = GateRows(dz, 3 * H, 4 * H);
+            dzI.AssignElementwiseProductOf(dc, cellInput);
+            dzI.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(dzI, gateI);
+            dzF.AssignElementwiseProductOf(dc, cPrev);
+            dzF.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(dzF, gateF);
+            dzG.AssignElementwiseProductOf(dc, gateI);
+            dzG.AssignElementwiseProductWithTanhDerivativeFromOutputOf(dzG, cellInput);
+
+            // propagate into frame t-1, except across sequence boundaries
+            dcNext.AssignElementwiseProductOf(dc, gateF);
+            m_hGradientNext->AssignProductOf(Input(2)->ValueAsMatrix(), true, dz, false);
+            ZeroColumnsAtSequenceStart(*m_hGradientNext, t);
+            ZeroColumnsAtSequenceStart(*m_cGradientNext, t);
+        }
+        MaskMissingColumnsToZero(*m_gatesGradient, m_pMBLayout, fr);
+    }
+
+    Matrix<ElemType> m_carriedH; // h and c of the last frame, for sequences that continue into the next minibatch
+    Matrix<ElemType> m_carriedC;
+    bool m_gatesGradientValid;   // m_gatesGradient is up to date for the current backprop pass
+
+    shared_ptr<Matrix<ElemType>> m_gates;     // [4H x N] gate activations i, f, o, g
+    shared_ptr<Matrix<ElemType>> m_cells;     // [H x N] c_t
+    shared_ptr<Matrix<ElemType>> m_tanhCells; // [H x N] tanh(c_t)
+    shared_ptr<Matrix<ElemType>> m_prevH;     // [H x N] h_{t-1} as used in frame t
+    shared_ptr<Matrix<ElemType>> m_prevC;     // [H x N] c_{t-1} as used in frame t
+    shared_ptr<Matrix<ElemType>> m_gatesGradient;
+    shared_ptr<Matrix<ElemType>> m_hGradientNext;
+    shared_ptr<Matrix<ElemType>> m_cGradientNext;
+    shared_ptr<Matrix<ElemType>> m_cGradient;
+};
+
+template class LSTMNode<float>;
+template class LSTMNode<double>;
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
@@ -158,6 +158,8 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsValueViewOfInput()) // our Value is the input's matrix
+            return;
         ValueFor(fr).SetValue(Input(0)->ValueFor(fr));
     }
 
@@ -166,6 +168,12 @@ public:
         Input(inputIndex)->GradientFor(fr).SetValue(GradientFor(fr));
     }
 
+    // the matrix is the same, only the sample layout differs
+    virtual bool CanShareValueWithInput() const override
+    {
+        return true;
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override
     {
         return false;
@@ -184,6 +192,84 @@ private:
 template class ReshapeNode<float>;
 template class ReshapeNode<double>;
 
+// -----------------------------------------------------------------------
+// DeviceTransferNode (input) -- copy of the input on the device of this node
+//
+// For model parallelism, nodes can be placed on different devices (NDL optional parameter deviceId=..., or MEL
+// SetProperty(node, deviceId, ...)). ComputationNetwork::CompileNetwork() cuts every edge between nodes on different
+// devices by inserting one of these on the consumer's device, so that the value is transferred once per minibatch
+// (and the gradient once back), instead of Matrix moving the input's own matrices back and forth.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DeviceTransferNode : public UnaryElementWiseNode<ElemType>
+{
+    typedef UnaryElementWiseNode<ElemType> Base;
+    UsingUnaryElementwiseNodeBaseMembers;
+    static const std::wstring TypeName()
+    {
+        return L"DeviceTransfer";
+    }
+
+public:
+    DeviceTransferNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_transferBuffer(make_shared<Matrix<ElemType>>(deviceId))
+    {
+    }
+    DeclareConstructorFromConfigWithNumInputs(DeviceTransferNode);
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        Transfer(Input(0)->ValueFor(fr), sliceOutputValue, /*accumulate=*/false);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
+    {
+        Matrix<ElemType> sliceInputGrad = Input(0)->GradientFor(fr);
+        Transfer(GradientFor(fr), sliceInputGrad, /*accumulate=*/true);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
+    {
+        return false;
+    }
+
+private:
+    // to = from, or to += from, where 'to' lives on a different device than 'from'
+    void Transfer(const Matrix<ElemType>& from, Matrix<ElemType>& to, bool accumulate)
+    {
+        if (from.GetDeviceId() == to.GetDeviceId())
+        {
+            if (accumulate)
+                to += from;
+            else
+                to.SetValue(from);
+            return;
+        }
+        // 'to' may be a slice view, which cannot change devices, so we go through a buffer that can.
+        // It is emptied before moving it to the source device, to not copy stale content along.
+        Matrix<ElemType>& buffer = *m_transferBuffer;
+        buffer.Resize(0, 0);
+        buffer.TransferToDeviceIfNotThere(from.GetDeviceId(), true);
+        buffer.SetValue(from);
+        buffer.TransferToDeviceIfNotThere(to.GetDeviceId(), true);
+        if (accumulate)
+            to += buffer;
+        else
+            to.SetValue(buffer);
+    }
+
+    shared_ptr<Matrix<ElemType>> m_transferBuffer;
+};
+
+template class DeviceTransferNode<float>;
+template class DeviceTransferNode<double>;
+
 // -----------------------------------------------------------------------
 // ReconcileMBLayout (dataInput, layoutInput)
 // This node copies data from 'dataInput' while it propagates the minibatch-layout information from 'layoutInput'.
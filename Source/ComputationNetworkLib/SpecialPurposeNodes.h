@@ -249,7 +249,7 @@ public:
     }
 
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
-    // If we want to speed up we need to replace following code with a several specialized GPU functions
+    // The mixture is combined in the log domain, like LogSoftmax, so that no per-component likelihood is exponentiated before normalization.
     /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, Matrix<ElemType>& logstddev,
                                                      const Matrix<ElemType>& feature, Matrix<ElemType>& prior, Matrix<ElemType>& stddev, Matrix<ElemType>& normedDeviationVectors,
                                                      Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
@@ -259,9 +259,7 @@ public:
         size_t featureDim = feature.GetNumRows();
 
         // compute prior which is softmax of unnormedPrior
-        prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
-
-        prior.InplaceExp();
+        prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior, exponentiated below
 
         // compute stddev
         stddev.AssignExpOf(logstddev);
@@ -296,22 +294,20 @@ public:
         temp.InplaceLog();
         temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
         posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
-        posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
+        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // log likelihood for each component and sample is now computed and stored in posterior
 
         normedDeviation.Reshape(numComponent, numSamples); // reshape back
         posterior.Reshape(numComponent, numSamples);       // reshape back
 
-        // compute posterior <-- prior_i * likelihood_i
-        if (unnormedPrior.GetNumCols() == numSamples) // each sample has different prior
-            posterior.ElementMultiplyWith(prior);
-        else // all samples share the same prior
-            posterior.ColumnElementMultiplyWith(prior);
+        // compute posterior <-- log prior_i + log likelihood_i
+        Matrix<ElemType>::ScaleAndAdd(1, prior, posterior); // prior has one column per sample, or one that all samples share
+        prior.InplaceExp();
 
-        // compute GMM log-likelihood
-        Matrix<ElemType>::Multiply(ConstOnes(1, numComponent, posterior.GetDeviceId()), false, posterior, false, functionValues); // functionValues <-- total likelihood
-        posterior.RowElementDivideBy(functionValues);                                                                             // posterior <-- per-comp likelihood / total likelihood
-        functionValues.InplaceLog();                                                                                              // log likelihood
+        // compute GMM log-likelihood log sum_i exp(posterior_i) and the posterior as their log-softmax
+        temp.AssignLogSoftmaxOf(posterior, true);               // temp <-- log (per-comp likelihood / total likelihood)
+        posterior -= temp;                                      // each row is now the log of the total likelihood
+        functionValues.AssignRowSliceValuesOf(posterior, 0, 1); // log likelihood
+        posterior.AssignExpOf(temp);
 
 #if DUMPOUTPUT
         temp.Print("temp", 0, min(5, temp.GetNumRows() - 1), 0, min(10, temp.GetNumCols() - 1));
@@ -356,11 +352,11 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<GMMLogLikelihoodNode<ElemType>>(nodeP);
-            *node->m_prior = *m_prior;
-            *node->m_normedDeviation = *m_normedDeviation;
-            *node->m_normedDeviationVectors = *m_normedDeviationVectors;
-            *node->m_stddev = *m_stddev;
-            *node->m_posterior = *m_posterior;
+            CopyMatrixIfAllocated(m_prior, node->m_prior);
+            CopyMatrixIfAllocated(m_normedDeviation, node->m_normedDeviation);
+            CopyMatrixIfAllocated(m_normedDeviationVectors, node->m_normedDeviationVectors);
+            CopyMatrixIfAllocated(m_stddev, node->m_stddev);
+            CopyMatrixIfAllocated(m_posterior, node->m_posterior);
         }
     }
 
@@ -564,9 +560,9 @@ public:
         {
             auto node = dynamic_pointer_cast<SequenceWithSoftmaxNode<ElemType>>(nodeP);
 
-            *node->m_logSoftmaxOfRight = *m_logSoftmaxOfRight;
-            *node->m_softmaxOfRight = *m_softmaxOfRight;
-            *node->m_gammaFromLattice = *m_gammaFromLattice;
+            CopyMatrixIfAllocated(m_logSoftmaxOfRight, node->m_logSoftmaxOfRight);
+            CopyMatrixIfAllocated(m_softmaxOfRight, node->m_softmaxOfRight);
+            CopyMatrixIfAllocated(m_gammaFromLattice, node->m_gammaFromLattice);
             node->m_fsSmoothingWeight = m_fsSmoothingWeight;
             node->m_frameDropThreshold = m_frameDropThreshold;
             node->m_doReferenceAlignment = m_doReferenceAlignment;
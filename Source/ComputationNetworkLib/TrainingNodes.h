@@ -85,7 +85,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SquareErrorNode<ElemType>>(nodeP);
-            *node->m_leftMinusRight = *m_leftMinusRight;
+            CopyMatrixIfAllocated(m_leftMinusRight, node->m_leftMinusRight);
         }
     }
 
@@ -113,6 +113,8 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// The labels may also be class indices [1 x T] instead of one-hot columns (see ValidateBinaryReduceWithClassIndices()):
+// then the target logits are looked up by index, and no label matrix of the size of the prediction is ever needed.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -128,16 +130,23 @@ class CrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*Computati
 public:
     DeclareConstructorFromConfigWithNumInputs(CrossEntropyWithSoftmaxNode);
     CrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_fused(false), m_classIndices(false)
     {
     }
 
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
         FrameRange fr(Input(0)->GetMBLayout());
+        if (m_classIndices && inputIndex == 0)
+            InvalidArgument("%ls %ls operation cannot compute the gradient for class indices.", NodeName().c_str(), OperationName().c_str());
         // left input is scalar
         if (inputIndex == 0) // left derivative
         {
+            if (m_fused) // the fused forward pass only kept the log-sum-exp; labels rarely need a gradient
+            {
+                m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
+                MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
+            }
 #if DUMPOUTPUT
             *m_logSoftmaxOfRight.Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
@@ -161,7 +170,12 @@ public:
 #endif
 
             auto gradient = Input(1)->GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, Input(0)->ValueFor(fr), gradient);
+            if (m_classIndices) // softmax - 1 at the label's row, likewise
+                Matrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(Gradient(), *m_labelIndices, Input(1)->ValueFor(fr), *m_logSumExpOfRight, gradient);
+            else if (m_fused) // softmax - labels, straight into the input gradient
+                Matrix<ElemType>::SoftmaxCrossEntropyBackward(Gradient(), Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_logSumExpOfRight, gradient);
+            else
+                Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, Input(0)->ValueFor(fr), gradient);
 #if DUMPOUTPUT
             Input(1)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -176,15 +190,37 @@ public:
         return false;
     }
 
+    // the output-sized temporaries are only sized (in ForwardProp()) when the fused pass cannot be used
     virtual void UpdateFunctionMBSize() override
     {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
     }
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
+        // class indices: the same fused pass, with gaps masked to index -1, which it skips
+        if (m_classIndices)
+        {
+            m_labelIndices->SetValue(Input(0)->ValueFor(fr));
+            MaskMissingColumnsTo(*m_labelIndices, Input(0)->GetMBLayout(), fr, (ElemType) -1);
+            Matrix<ElemType>::IndexedSoftmaxCrossEntropyForward(*m_labelIndices, Input(1)->ValueFor(fr), *m_logSumExpOfRight, Value());
+#if NANCHECK
+            Value().HasNan("CrossEntropyWithSoftmax");
+#endif
+            return;
+        }
+        // dense labels: one pass over the logits, keeping only their log-sum-exp per column for the gradient.
+        // Gaps are masked to zero labels, which the fused pass skips.
+        m_fused = Input(0)->Value().GetMatrixType() == DENSE && Input(1)->Value().GetMatrixType() == DENSE;
+        if (m_fused)
+        {
+            Matrix<ElemType>::SoftmaxCrossEntropyForward(Input(0)->MaskedValueFor(fr), Input(1)->ValueFor(fr), *m_logSumExpOfRight, Value());
+#if NANCHECK
+            Value().HasNan("CrossEntropyWithSoftmax");
+#endif
+            return;
+        }
         // first compute the softmax (column-wise)
         // Note that we need both log and non-log for gradient computation.
         m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
@@ -205,7 +241,7 @@ public:
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
-        ValidateBinaryReduce(isFinalValidationPass);
+        m_classIndices = ValidateBinaryReduceWithClassIndices(isFinalValidationPass);
     }
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -214,8 +250,12 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            *node->m_logSoftmaxOfRight = *m_logSoftmaxOfRight;
-            *node->m_softmaxOfRight = *m_softmaxOfRight;
+            CopyMatrixIfAllocated(m_logSoftmaxOfRight, node->m_logSoftmaxOfRight);
+            CopyMatrixIfAllocated(m_softmaxOfRight, node->m_softmaxOfRight);
+            CopyMatrixIfAllocated(m_logSumExpOfRight, node->m_logSumExpOfRight);
+            CopyMatrixIfAllocated(m_labelIndices, node->m_labelIndices);
+            node->m_fused = m_fused;
+            node->m_classIndices = m_classIndices;
         }
     }
 
@@ -225,11 +265,17 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
         RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
+        RequestMatrixFromPool(m_labelIndices, matrixPool);
     }
 
 protected:
     shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
     shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight; // [1 x T], for the gradient of the fused pass
+    shared_ptr<Matrix<ElemType>> m_labelIndices;     // [1 x T], the class indices with the gaps masked to -1
+    bool m_fused;                                     // whether the last ForwardProp() used the fused pass (dense labels)
+    bool m_classIndices;                              // the labels are class indices, see Validate()
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -325,8 +371,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyNode<ElemType>>(nodeP);
-            *node->m_logOfRight = *m_logOfRight;
-            *node->m_leftDivRight = *m_leftDivRight;
+            CopyMatrixIfAllocated(m_logOfRight, node->m_logOfRight);
+            CopyMatrixIfAllocated(m_leftDivRight, node->m_leftDivRight);
         }
     }
 
@@ -430,7 +476,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<MatrixL1RegNode<ElemType>>(nodeP);
-            *node->m_gradientOfL1Norm = *m_gradientOfL1Norm;
+            CopyMatrixIfAllocated(m_gradientOfL1Norm, node->m_gradientOfL1Norm);
         }
     }
 
@@ -695,6 +741,394 @@ private:
 template class NoiseContrastiveEstimationNode<float>;
 template class NoiseContrastiveEstimationNode<double>;
 
+// -----------------------------------------------------------------------
+// CrossEntropyWithSampledSoftmaxNode (labels, hidden, weights, bias, wordCounts)
+//  - labels: one-hot, dense or sparse [vocab_size x T]
+//  - hidden: hidden layer activity [hdsize x T]
+//  - weights: output embedding [hdsize x vocab_size]
+//  - bias: [vocab_size x 1]
+//  - wordCounts: unigram counts of the words [vocab_size x 1], e.g. a non-learnable parameter read from a file; the
+//           proposal distribution is proportional to (count + 1)^samplingExponent, so that every word can be drawn
+//
+// Sampled softmax (Jean et al., 2015): while training, the criterion is the cross entropy of a softmax over only the
+// target word and numSamples words drawn from the proposal distribution, with each logit corrected by the log of the
+// number of times its word is expected to be drawn. The draws are shared by all frames of the minibatch, so that the
+// logits are one [numSamples x hdsize] x [hdsize x T] product, and the gradients to the weights and the bias are
+// scattered into the columns of the sampled and the target words only, instead of being products over the whole
+// vocabulary. The words are drawn on the device, from an alias table that is built once on the CPU.
+// Outside of training (see SetTraining(), which SGD calls for the duration of each epoch), the value is that of the
+// full softmax, i.e. that of CrossEntropyWithSoftmax(labels, weights' * hidden + bias).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CrossEntropyWithSampledSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<5>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"CrossEntropyWithSampledSoftmax";
+    }
+
+    // our inputs
+    static const size_t LABELDATA = 0;
+    static const size_t INPUTDATA = 1;
+    static const size_t EMBEDDINGMATRIX = 2;
+    static const size_t BIAS = 3;
+    static const size_t WORDCOUNTS = 4;
+
+public:
+    CrossEntropyWithSampledSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples = 0, double samplingExponent = 0.75)
+        : Base(deviceId, name),
+          m_numSamples(numSamples),
+          m_samplingExponent(samplingExponent),
+          m_training(false),
+          m_randomSeed(1),
+          m_needRecomputeGradientToSoftmaxInput(false),
+          m_aliasProb(deviceId),
+          m_aliasIndex(deviceId),
+          m_wordIndex(deviceId),
+          m_logExpectedCount(deviceId),
+          m_randomBuckets(deviceId),
+          m_randomCoins(deviceId),
+          m_samples(deviceId),
+          m_labelIndex(deviceId),
+          m_sampledWeights(deviceId),
+          m_labelWeights(deviceId),
+          m_targetLogits(deviceId),
+          m_logSoftmax(deviceId),
+          m_grdToSoftMaxInput(deviceId),
+          m_grdToSampledLogits(deviceId),
+          m_grdToTargetLogits(deviceId),
+          m_temp(deviceId)
+    {
+    }
+    CrossEntropyWithSampledSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : CrossEntropyWithSampledSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numSamples"), configp->Get(L"samplingExponent"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numSamples << m_samplingExponent;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numSamples >> m_samplingExponent;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<CrossEntropyWithSampledSoftmaxNode<ElemType>>(nodeP);
+            node->m_numSamples = m_numSamples;
+            node->m_samplingExponent = m_samplingExponent;
+            node->m_training = m_training;
+            node->m_randomSeed = m_randomSeed;
+        }
+    }
+
+    // special methods for this node type which ComputationNetwork knows about and calls to pass parameters
+    void SetTraining(bool training)
+    {
+        m_training = training;
+    }
+
+    void SetRandomSeed(const unsigned long val)
+    {
+        m_randomSeed = val;
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (!m_training)
+            LogicError("%ls %ls operation computes gradients only while training.", NodeName().c_str(), OperationName().c_str());
+        if (inputIndex == LABELDATA || inputIndex == WORDCOUNTS)
+            InvalidArgument("%ls %ls operation cannot compute the gradient for its labels or word counts.", NodeName().c_str(), OperationName().c_str());
+
+        FrameRange fr(Input(LABELDATA)->GetMBLayout());
+        ComputeSoftMaxPartial();
+        const size_t numCols = m_grdToTargetLogits.GetNumCols();
+
+        switch (inputIndex)
+        {
+        case INPUTDATA:
+        {
+            // the target words' weights scaled by their gradients, plus the sampled words' weights times theirs
+            auto gradient = Input(INPUTDATA)->GradientFor(fr);
+            const size_t hdSize = gradient.GetNumRows();
+            TensorView<ElemType>(gradient, TensorShape(hdSize, numCols))
+                .AddElementwiseProductOf(TensorView<ElemType>(m_labelWeights, TensorShape(hdSize, numCols)), TensorView<ElemType>(m_grdToTargetLogits, TensorShape(1, numCols)));
+            Matrix<ElemType>::MultiplyAndAdd(m_sampledWeights, false, m_grdToSampledLogits, false, gradient);
+            break;
+        }
+        case EMBEDDINGMATRIX:
+        {
+            // only the columns of the sampled and the target words
+            auto hidden = Input(INPUTDATA)->ValueFor(fr);
+            const size_t hdSize = hidden.GetNumRows();
+            Matrix<ElemType>& gradient = Input(EMBEDDINGMATRIX)->GradientAsMatrix();
+            m_temp.AssignProductOf(hidden, false, m_grdToSampledLogits, true); // [hdsize x numSamples]
+            gradient.DoScatterColumnsOf(1, m_samples, m_temp, 1);
+            m_temp.Resize(hdSize, numCols);
+            TensorView<ElemType>(m_temp, TensorShape(hdSize, numCols))
+                .AssignElementwiseProductOf(TensorView<ElemType>(hidden, TensorShape(hdSize, numCols)), TensorView<ElemType>(m_grdToTargetLogits, TensorShape(1, numCols)));
+            gradient.DoScatterColumnsOf(1, m_labelIndex, m_temp, 1);
+            break;
+        }
+        case BIAS:
+        {
+            // likewise, with the sampled words' gradients summed over the frames
+            Matrix<ElemType> gradient = AsRow(Input(BIAS)->GradientAsMatrix());
+            m_temp.Resize(m_numSamples, 1);
+            TensorView<ElemType>(m_temp, TensorShape(m_numSamples, 1)).AssignCopyOf(TensorView<ElemType>(m_grdToSampledLogits, TensorShape(m_numSamples, numCols)));
+            gradient.DoScatterColumnsOf(1, m_samples, AsRow(m_temp), 1);
+            gradient.DoScatterColumnsOf(1, m_labelIndex, m_grdToTargetLogits, 1);
+            break;
+        }
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+private:
+    // view of a [n x 1] or [1 x n] matrix as [1 x n], i.e. with one column per word, for DoGather/ScatterColumnsOf()
+    static Matrix<ElemType> AsRow(const Matrix<ElemType>& m)
+    {
+        return m.Reshaped(1, m.GetNumElements());
+    }
+
+    // Vose's alias method: word k is drawn by picking k uniformly, then keeping it with probability aliasProb[k] and
+    // taking aliasIndex[k] otherwise. Also sets the word indices 0..vocab_size-1, and the log of the expected number
+    // of times each word is drawn, log(numSamples * p(word)).
+    void BuildAliasTable()
+    {
+        const Matrix<ElemType>& wordCounts = Input(WORDCOUNTS)->Value();
+        const size_t vocabSize = wordCounts.GetNumElements();
+        unique_ptr<ElemType[]> counts(wordCounts.CopyToArray());
+
+        vector<double> p(vocabSize);
+        double sum = 0;
+        for (size_t k = 0; k < vocabSize; k++)
+        {
+            if (counts[k] < 0)
+                InvalidArgument("%ls %ls operation: The word counts must not be negative.", NodeName().c_str(), OperationName().c_str());
+            sum += p[k] = pow(counts[k] + 1.0, m_samplingExponent);
+        }
+
+        vector<ElemType> aliasProb(vocabSize, 1), aliasIndex(vocabSize), wordIndex(vocabSize), logExpectedCount(vocabSize);
+        vector<double> scaled(vocabSize);
+        vector<size_t> small, large;
+        for (size_t k = 0; k < vocabSize; k++)
+        {
+            p[k] /= sum;
+            scaled[k] = p[k] * vocabSize;
+            (scaled[k] < 1 ? small : large).push_back(k);
+            aliasIndex[k] = wordIndex[k] = (ElemType) k;
+            logExpectedCount[k] = (ElemType) log(m_numSamples * p[k]);
+        }
+        while (!small.empty() && !large.empty())
+        {
+            size_t s = small.back(), l = large.back();
+            small.pop_back();
+            large.pop_back();
+            aliasProb[s] = (ElemType) scaled[s];
+            aliasIndex[s] = (ElemType) l;
+            scaled[l] += scaled[s] - 1;
+            (scaled[l] < 1 ? small : large).push_back(l);
+        }
+        // (the words left in either list have scaled probability 1 up to rounding, and keep aliasProb 1)
+
+        m_aliasProb.SetValue(1, vocabSize, m_aliasProb.GetDeviceId(), aliasProb.data(), matrixFlagNormal);
+        m_aliasIndex.SetValue(1, vocabSize, m_aliasIndex.GetDeviceId(), aliasIndex.data(), matrixFlagNormal);
+        m_wordIndex.SetValue(1, vocabSize, m_wordIndex.GetDeviceId(), wordIndex.data(), matrixFlagNormal);
+        m_logExpectedCount.SetValue(1, vocabSize, m_logExpectedCount.GetDeviceId(), logExpectedCount.data(), matrixFlagNormal);
+    }
+
+    // draw m_numSamples words into m_samples [1 x numSamples], on the device
+    void DrawSamples()
+    {
+        const size_t vocabSize = m_wordIndex.GetNumCols();
+        m_randomBuckets.Resize(1, m_numSamples);
+        m_randomBuckets.SetUniformRandomValue(0, (ElemType) vocabSize, m_randomSeed);
+        m_randomBuckets.InplaceTruncateTop((ElemType) (vocabSize - 1)); // (the upper bound may be drawn)
+        m_randomCoins.Resize(1, m_numSamples);
+        m_randomCoins.SetUniformRandomValue(0, 1, m_randomSeed + 1);
+        m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other nodes
+
+        // (the gathers truncate the random bucket to its index)
+        m_samples.Resize(1, m_numSamples);
+        m_samples.DoGatherColumnsOf(0, m_randomBuckets, m_aliasProb, 1);
+        TensorView<ElemType>(m_randomCoins, TensorShape(1, m_numSamples)).AssignLTOf(TensorView<ElemType>(m_randomCoins, TensorShape(1, m_numSamples)), TensorView<ElemType>(m_samples, TensorShape(1, m_numSamples)));
+        m_samples.DoGatherColumnsOf(0, m_randomBuckets, m_wordIndex, 1);
+        m_randomBuckets.DoGatherColumnsOf(0, m_randomBuckets, m_aliasIndex, 1);
+        TensorView<ElemType>(m_samples, TensorShape(1, m_numSamples))
+            .AssignCondOf(TensorView<ElemType>(m_randomCoins, TensorShape(1, m_numSamples)), TensorView<ElemType>(m_samples, TensorShape(1, m_numSamples)), TensorView<ElemType>(m_randomBuckets, TensorShape(1, m_numSamples)));
+    }
+
+    // gradient of cross entropy w.r.t. to the logits: (softmax - 1 at the target word) * gradient, 0 in gaps
+    void ComputeSoftMaxPartial()
+    {
+        if (m_needRecomputeGradientToSoftmaxInput)
+        {
+            FrameRange fr(Input(LABELDATA)->GetMBLayout());
+            m_grdToSoftMaxInput.AssignExpOf(m_logSoftmax);
+            MaskMissingColumnsToZero(m_grdToSoftMaxInput, Input(LABELDATA)->GetMBLayout(), fr);
+            Matrix<ElemType>::Scale(Gradient(), m_grdToSoftMaxInput);
+            m_grdToTargetLogits.AssignRowSliceValuesOf(m_grdToSoftMaxInput, 0, 1);
+            m_grdToSampledLogits.AssignRowSliceValuesOf(m_grdToSoftMaxInput, 1, m_numSamples);
+            m_temp.Resize(1, m_grdToTargetLogits.GetNumCols());
+            m_temp.SetValue(1);
+            MaskMissingColumnsToZero(m_temp, Input(LABELDATA)->GetMBLayout(), fr);
+            Matrix<ElemType>::Scale(Gradient(), m_temp);
+            m_grdToTargetLogits -= m_temp;
+            m_needRecomputeGradientToSoftmaxInput = false;
+        }
+    }
+
+public:
+    virtual void UpdateFunctionMBSize() override
+    {
+        // TODO: Resize temp matrices here (not doing so does not really fail since for full matrices, class Matrix will resize by itself)
+    }
+
+    // -sum(log softmax of the target word)
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(LABELDATA)->GetMBLayout());
+        auto hidden = Input(INPUTDATA)->ValueFor(fr);
+        const Matrix<ElemType>& weights = Input(EMBEDDINGMATRIX)->ValueAsMatrix();
+        Matrix<ElemType> bias = AsRow(Input(BIAS)->Value());
+        const size_t hdSize = hidden.GetNumRows();
+        const size_t numCols = hidden.GetNumCols();
+        const size_t vocabSize = weights.GetNumCols();
+
+        // the index of each frame's target word, as [1 x vocab_size] * one-hot [vocab_size x T], so that sparse labels work too
+        if (m_wordIndex.GetNumCols() != vocabSize)
+            BuildAliasTable();
+        Matrix<ElemType>::Multiply(m_wordIndex, false, Input(LABELDATA)->ValueFor(fr), false, m_labelIndex);
+
+        // the target words' logits, weights(:,y)' * hidden + bias(y)
+        m_labelWeights.Resize(hdSize, numCols);
+        m_labelWeights.DoGatherColumnsOf(0, m_labelIndex, weights, 1);
+        m_targetLogits.Resize(1, numCols);
+        TensorView<ElemType>(m_targetLogits, TensorShape(1, numCols))
+            .AssignElementwiseProductOf(TensorView<ElemType>(m_labelWeights, TensorShape(hdSize, numCols)), TensorView<ElemType>(hidden, TensorShape(hdSize, numCols)));
+        m_targetLogits.DoGatherColumnsOf(1, m_labelIndex, bias, 1);
+
+        if (m_training)
+        {
+            DrawSamples();
+
+            // row 0 of the logits is the target word, rows 1..numSamples are the samples; all minus the log of their expected
+            // count, and a sample that happens to be a frame's target word is removed from that frame's softmax
+            m_sampledWeights.Resize(hdSize, m_numSamples);
+            m_sampledWeights.DoGatherColumnsOf(0, m_samples, weights, 1);
+            m_temp.AssignProductOf(m_sampledWeights, true, hidden, false); // [numSamples x T]
+            m_grdToSampledLogits.Resize(1, m_numSamples);                  // (used as temp here)
+            m_grdToSampledLogits.DoGatherColumnsOf(0, m_samples, bias, 1);
+            m_grdToSampledLogits.DoGatherColumnsOf(1, m_samples, m_logExpectedCount, -1);
+            TensorView<ElemType>(m_temp, TensorShape(m_numSamples, numCols)).AddCopyOf(TensorView<ElemType>(m_grdToSampledLogits, TensorShape(m_numSamples, 1)));
+            TensorView<ElemType>(m_temp, TensorShape(m_numSamples, numCols))
+                .AddEQOf(TensorView<ElemType>(m_samples, TensorShape(m_numSamples, 1)), TensorView<ElemType>(m_labelIndex, TensorShape(1, numCols)), (ElemType) -1e4);
+            m_targetLogits.DoGatherColumnsOf(1, m_labelIndex, m_logExpectedCount, -1);
+
+            m_logSoftmax.Resize(m_numSamples + 1, numCols);
+            m_logSoftmax.AssignToRowSliceValuesOf(m_targetLogits, 0, 1);
+            m_logSoftmax.AssignToRowSliceValuesOf(m_temp, 1, m_numSamples);
+            m_logSoftmax.InplaceLogSoftmax(true);
+            m_temp.AssignRowSliceValuesOf(m_logSoftmax, 0, 1);
+            m_temp *= -1;
+        }
+        else
+        {
+            // full softmax: log sum exp(logits) - target logit, where the former is the difference of any row of the logits
+            // and that row of the log softmax
+            m_logSoftmax.AssignProductOf(weights, true, hidden, false); // [vocab_size x T]
+            TensorView<ElemType>(m_logSoftmax, TensorShape(vocabSize, numCols)).AddCopyOf(TensorView<ElemType>(bias, TensorShape(vocabSize, 1)));
+            m_temp.AssignRowSliceValuesOf(m_logSoftmax, 0, 1);
+            m_temp -= m_targetLogits;
+            m_logSoftmax.InplaceLogSoftmax(true);
+            m_targetLogits.AssignRowSliceValuesOf(m_logSoftmax, 0, 1); // (used as temp here)
+            m_temp -= m_targetLogits;
+        }
+
+        // flatten all gaps to zero, such that gaps will contribute zero to the sum
+        MaskMissingColumnsToZero(m_temp, Input(LABELDATA)->GetMBLayout(), fr);
+        Value().AssignSumOfElements(m_temp);
+#if NANCHECK
+        Value().HasNan("CrossEntropyWithSampledSoftmax");
+#endif
+        m_needRecomputeGradientToSoftmaxInput = m_training;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            size_t vocabSize = Input(EMBEDDINGMATRIX)->GetAsMatrixNumCols();
+            if (Input(INPUTDATA)->GetSampleMatrixNumRows() != Input(EMBEDDINGMATRIX)->GetAsMatrixNumRows())
+                LogicError("The matrix dimension for hidden and weights in the %ls %ls operation does not match.", NodeName().c_str(), OperationName().c_str());
+            if (Input(LABELDATA)->GetSampleMatrixNumRows() != vocabSize || Input(BIAS)->GetSampleLayout().GetNumElements() != vocabSize ||
+                Input(WORDCOUNTS)->GetSampleLayout().GetNumElements() != vocabSize)
+                LogicError("The labels, the bias and the word counts of the %ls %ls operation must have one row per column of the weights.", NodeName().c_str(), OperationName().c_str());
+            if (!Input(LABELDATA)->HasMBLayout() || Input(LABELDATA)->GetMBLayout() != Input(INPUTDATA)->GetMBLayout() ||
+                Input(EMBEDDINGMATRIX)->HasMBLayout() || Input(BIAS)->HasMBLayout() || Input(WORDCOUNTS)->HasMBLayout())
+                LogicError("%ls %ls operation requires inputs 0 and 1 to be the same minibatch, and inputs 2 to 4 to be parameters.", NodeName().c_str(), OperationName().c_str());
+            if (m_numSamples == 0)
+                InvalidArgument("%ls %ls operation: numSamples must be positive.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+protected:
+    size_t m_numSamples;
+    double m_samplingExponent;
+    bool m_training;
+    unsigned long m_randomSeed;
+    bool m_needRecomputeGradientToSoftmaxInput;
+
+    // the proposal distribution, from BuildAliasTable(), each [1 x vocab_size]
+    Matrix<ElemType> m_aliasProb;
+    Matrix<ElemType> m_aliasIndex;
+    Matrix<ElemType> m_wordIndex; // 0..vocab_size-1
+    Matrix<ElemType> m_logExpectedCount;
+
+    // the draws of the minibatch, each [1 x numSamples]
+    Matrix<ElemType> m_randomBuckets;
+    Matrix<ElemType> m_randomCoins;
+    Matrix<ElemType> m_samples; // the word indices
+
+    Matrix<ElemType> m_labelIndex;     // [1 x T] index of each frame's target word
+    Matrix<ElemType> m_sampledWeights; // [hdsize x numSamples] columns of the weights of the samples
+    Matrix<ElemType> m_labelWeights;   // [hdsize x T] columns of the weights of the target words
+    Matrix<ElemType> m_targetLogits;   // [1 x T]
+    Matrix<ElemType> m_logSoftmax;     // [(numSamples + 1) x T] while training (row 0: target word), [vocab_size x T] otherwise
+
+    // gradient of cross entropy with respect to the logits, and its rows for the target and the sampled words
+    Matrix<ElemType> m_grdToSoftMaxInput;
+    Matrix<ElemType> m_grdToSampledLogits;
+    Matrix<ElemType> m_grdToTargetLogits;
+    Matrix<ElemType> m_temp;
+};
+
+template class CrossEntropyWithSampledSoftmaxNode<float>;
+template class CrossEntropyWithSampledSoftmaxNode<double>;
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -705,6 +1139,11 @@ template class NoiseContrastiveEstimationNode<double>;
 //  - Input(1) [hdsize x T] hidden layer activation to the node in. for a simple rnn, this is the hidden layer activty
 //  - Input(2) [hdsize x vocab_size] weight matrix in, for speed-up, as per word matrix can be simply obtained as column slice
 //  - Input(3) [nbr_cls x T] clsprob in dense matrix in. This input, if applied softmax on, is the posterior probabilty of class given observations
+//
+// The frames of the minibatch are grouped by class, so that each class present takes one GEMM of its weight columns with
+// the hidden vectors of all its frames, and one column-wise softmax, instead of a GEMV and a softmax per frame. Only the
+// grouping is done on the host, from one copy of the [4 x T] label matrix per minibatch, which may reside on either device;
+// everything else, including the selection of the target words and classes and all gradients, runs where the data are.
 // -----------------------------------------------------------------------
 
 // calculates: -sum(left_i * log(softmax_i(right))) for class given history and for word given history
@@ -731,12 +1170,23 @@ public:
         : Base(deviceId, name),
           m_logSoftmax(deviceId),
           m_softMax(deviceId),
+          m_wordTargets(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_clsSoftmax(deviceId),
+          m_clsTargets(deviceId),
+          m_frameColumns(deviceId),
+          m_targetInClass(deviceId),
+          m_classOfColumn(deviceId),
+          m_wordIota(deviceId),
+          m_clsIota(deviceId),
+          m_sortedInput(deviceId),
+          m_sortedInputGradient(deviceId),
+          m_temp(deviceId)
     {
     }
 
+
     // compute gradients to input observations, the weights to the observations, and the class log posterior probabilites
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
@@ -746,53 +1196,34 @@ public:
 
         ComputeSoftMaxPartial();
 
-        Matrix<ElemType> grd_t;
-        Matrix<ElemType> grd_to_wgt_t;
-
-        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
+        switch (inputIndex)
+        {
+        case 1:
+            // gradient to input: per class, W_c * grd_c, then back to the columns of the frames
+            m_sortedInputGradient.Resize(m_sortedInput.GetNumRows(), m_sortedInput.GetNumCols());
+            for (const auto& block : m_classBlocks)
             {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                Matrix<ElemType> lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t c_t = (size_t) lbl_t(1, 0);
-                size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
-
-                // compute prb - 1 and prb
-                Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-                Matrix<ElemType> grd_to_soft_max_input = m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd);
-                Matrix<ElemType> grd_to_cls_prob = DataWithMBLayoutFor(m_clsLogSoftmax, fr, Input(CLASSPROBINDATA)->GetMBLayout());
-
-                switch (inputIndex)
-                {
-                case 1:
-                    // gradient to input
-                    grd_t = Input(INPUTDATA)->GradientFor(fr);
-                    Matrix<ElemType>::MultiplyAndAdd(weightForClass, false, grd_to_soft_max_input, true, grd_t);
-                    break;
-                case 2:
-                    // gradient to input weight
-                    grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                    Matrix<ElemType>::MultiplyAndAdd(obs, false, grd_to_soft_max_input, false, grd_to_wgt_t);
-                    break;
-                case 3:
-                    grd_t = Input(CLASSPROBINDATA)->GradientFor(fr);
-                    grd_t.SetValue(DataWithMBLayoutFor(m_clsSoftmax, fr, Input(CLASSPROBINDATA)->GetMBLayout()));
-                    ComputeCEPartialToSoftmaxInputs(grd_t, Gradient(), c_t);
-                    break;
-                }
-
-                sz += nbr_wrd;
+                Matrix<ElemType> grd_c = m_sortedInputGradient.ColumnSlice(block.firstFrame, block.numFrames);
+                Matrix<ElemType>::Multiply(WeightsFor(Input(EMBEDDINGMATRIX)->ValueAsMatrix(), block), false, BlockOf(m_grdToSoftMaxInput, block), false, grd_c);
             }
+            Input(INPUTDATA)->Gradient().DoScatterColumnsOf(1, m_frameColumns, m_sortedInputGradient, 1);
+            break;
+        case 2:
+            // gradient to input weight: per class, obs_c * grd_c'
+            for (const auto& block : m_classBlocks)
+            {
+                Matrix<ElemType> grd_to_wgt_c = WeightsFor(Input(EMBEDDINGMATRIX)->GradientAsMatrix(), block);
+                Matrix<ElemType>::MultiplyAndAdd(m_sortedInput.ColumnSlice(block.firstFrame, block.numFrames), false, BlockOf(m_grdToSoftMaxInput, block), true, grd_to_wgt_c);
+            }
+            break;
+        case 3:
+            // gradient to class log posterior: softmax - 1 at the class of the frame, 0 in gaps
+            m_temp.AssignDifferenceOf(m_clsSoftmax, m_clsTargets);
+            MaskMissingColumnsToZero(m_temp, Input(CLASSPROBINDATA)->GetMBLayout(), FrameRange(Input(CLASSPROBINDATA)->GetMBLayout()));
+            Matrix<ElemType>::Scale(Gradient(), m_temp);
+            Input(CLASSPROBINDATA)->Gradient() += m_temp;
+            break;
+        }
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -801,47 +1232,123 @@ public:
     }
 
 private:
-    void ComputeCEPartialToSoftmaxInputs(Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& gradientValues, size_t y_t)
+    // the frames of one class; their columns in the sorted input, and their [numWords x numFrames] block in the packed buffers
+    struct ClassBlock
     {
-        Matrix<ElemType>::MinusOneAt(inputGradientValues, y_t);
-        Matrix<ElemType>::Scale(gradientValues, inputGradientValues);
-    }
+        size_t firstWord, numWords; // the class's range of word indices, i.e. of columns of the weight matrix
+        size_t firstFrame, numFrames;
+        size_t offset; // into the packed buffers
+    };
 
-    // gradient of cross entropy w.r.t. to input to softmax
-    void ComputeSoftMaxPartial()
+    // view of a class's block of a packed [1 x m_totalNbrWords] buffer as a [numWords x numFrames] matrix
+    static Matrix<ElemType> BlockOf(const Matrix<ElemType>& packed, const ClassBlock& block)
     {
-        if (m_needRecomputeGradientToSoftmaxInput)
-        {
-            m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
+        Matrix<ElemType> view = packed.ColumnSlice(block.offset, block.numWords * block.numFrames);
+        view.Reshape(block.numWords, block.numFrames);
+        return view;
+    }
 
-            const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-            const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-            size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-            for (size_t s = 0; s < nS; s++)
-                for (size_t t = 0; t < nT; t++)
-                {
-                    FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
+    static Matrix<ElemType> WeightsFor(const Matrix<ElemType>& weights, const ClassBlock& block)
+    {
+        return weights.ColumnSlice(block.firstWord, block.numWords); // [hdSize x numWords]
+    }
 
-                    // if (Input(LABELDATA)->GetMBLayout()->IsGap(s, t))  // skip gaps
-                    if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                        continue;
+    // [1 x n] matrix of 0..n-1, grown as needed
+    static void SetIota(Matrix<ElemType>& iota, size_t n)
+    {
+        if (iota.GetNumCols() >= n)
+            return;
+        vector<ElemType> values(n);
+        for (size_t i = 0; i < n; i++)
+            values[i] = (ElemType) i;
+        iota.SetValue(1, n, iota.GetDeviceId(), values.data(), matrixFlagNormal);
+    }
 
-                    Matrix<ElemType> lbl_t = Input(LABELDATA)->ValueFor(fr);
-                    size_t y_t = (size_t) lbl_t(0, 0);     // word index
-                    size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                    size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                    size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
+    // upload a host vector as a [1 x n] matrix, e.g. of indices
+    static void SetRow(Matrix<ElemType>& m, const vector<ElemType>& values)
+    {
+        if (values.empty())
+            m.Resize(1, 0);
+        else
+            m.SetValue(1, values.size(), m.GetDeviceId(), const_cast<ElemType*>(values.data()), matrixFlagNormal);
+    }
 
-                    Matrix<ElemType> softMax = m_softMax.ColumnSlice(sz, nbr_wrd);
+    // read the labels and group the frames by class, into m_classBlocks and the index rows
+    void GroupFramesByClass()
+    {
+        const auto& pMBLayout = Input(LABELDATA)->GetMBLayout();
+        const Matrix<ElemType>& labels = Input(LABELDATA)->Value(); // [4 x (T * S)]
+        const size_t numCols = labels.GetNumCols();
+        unique_ptr<ElemType[]> labelsOnHost(labels.CopyToArray()); // (one transfer for the whole minibatch)
+        auto label = [&](size_t row, size_t col)
+        {
+            return (size_t) labelsOnHost[col * 4 + row];
+        };
 
-                    size_t idx_in_class = y_t - lft_bnd;
-                    ComputeCEPartialToSoftmaxInputs(softMax, Gradient(), idx_in_class);
+        // frames of each class, in column order
+        vector<vector<size_t>> framesOfClass(m_nbrCls);
+        vector<ElemType> classOfColumn(numCols, -1); // -1 for gaps, which then match no class
+        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
+        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
+        for (size_t t = 0; t < nT; t++)
+            for (size_t s = 0; s < nS; s++)
+            {
+                FrameRange fr = FrameRange(pMBLayout, t).Sequence(s);
+                if (pMBLayout->IsGap(fr)) // skip gaps
+                    continue;
+                size_t j = t * nS + s;
+                size_t y_t = label(0, j), c_t = label(1, j), lft_bnd = label(2, j), rgt_bnd = label(3, j);
+                if (rgt_bnd <= lft_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Encountered a class of size 0. This sample seems to lack an NoInput flag.");
+                if (y_t < lft_bnd || y_t >= rgt_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Word index out of bounds of class-member index range (word not a class member).");
+                if (c_t >= m_nbrCls)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Class index %d out of range of the %d classes.", (int) c_t, (int) m_nbrCls);
+                framesOfClass[c_t].push_back(j);
+                classOfColumn[j] = (ElemType) c_t;
+            }
 
-                    m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd).SetValue(softMax);
+        // blocks of the classes present, with the frames sorted by class
+        vector<ElemType> frameColumns, targetInClass;
+        m_classBlocks.clear();
+        size_t maxNumWords = 0;
+        m_totalNbrWords = 0;
+        for (const auto& frames : framesOfClass)
+        {
+            if (frames.empty())
+                continue;
+            ClassBlock block;
+            block.firstWord = label(2, frames.front());
+            block.numWords = label(3, frames.front()) - block.firstWord;
+            block.firstFrame = frameColumns.size();
+            block.numFrames = frames.size();
+            block.offset = m_totalNbrWords;
+            for (size_t j : frames)
+            {
+                if (label(2, j) != block.firstWord || label(3, j) != block.firstWord + block.numWords)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): The frames of class %d have different word ranges.", (int) label(1, j));
+                frameColumns.push_back((ElemType) j);
+                targetInClass.push_back((ElemType) (label(0, j) - block.firstWord));
+            }
+            m_classBlocks.push_back(block);
+            maxNumWords = max(maxNumWords, block.numWords);
+            m_totalNbrWords += block.numWords * block.numFrames;
+        }
 
-                    sz += nbr_wrd;
-                }
+        SetRow(m_frameColumns, frameColumns);
+        SetRow(m_targetInClass, targetInClass);
+        SetRow(m_classOfColumn, classOfColumn);
+        SetIota(m_wordIota, maxNumWords);
+        SetIota(m_clsIota, m_nbrCls);
+    }
 
+    // gradient of cross entropy w.r.t. to input to softmax: (softmax - 1 at the target word) * gradient
+    void ComputeSoftMaxPartial()
+    {
+        if (m_needRecomputeGradientToSoftmaxInput)
+        {
+            m_grdToSoftMaxInput.AssignDifferenceOf(m_softMax, m_wordTargets);
+            Matrix<ElemType>::Scale(Gradient(), m_grdToSoftMaxInput);
             m_needRecomputeGradientToSoftmaxInput = false;
         }
     }
@@ -855,101 +1362,48 @@ public:
     // -sum(left_i * log(softmax_i(right)))
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        if (Input(LABELDATA)->Value().GetDeviceId() != CPUDEVICE)
-            LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): The label matrix is not using CPU device. This will make computation slow, even though the label data is probably saved on GPU. Because of the external loop over time with explicit class id retrieved from the label matrix, the computation will be very slow if the label matrix is saved on GPU. However, this is only a constraint for label matrix and other matrices such as data are suggested to reside on GPU. ");
-        // TODO: Get the label matrix into location=Both state.
-
         auto& functionValues = Value();
 
         const size_t hdSize = Input(INPUTDATA)->GetSampleMatrixNumRows(); // hdSize
         assert(m_nbrCls == Input(CLASSPROBINDATA)->GetSampleMatrixNumRows());
 
-        // compute the class posteriors
+        // compute the class posteriors, and the one-hot targets of the classes ([nbr_cls x T]; gap columns are all 0)
+        GroupFramesByClass();
         m_clsLogSoftmax = Input(CLASSPROBINDATA)->Value();
         m_clsLogSoftmax.InplaceLogSoftmax(true);   // log
+        MaskMissingColumnsToZero(m_clsLogSoftmax, Input(CLASSPROBINDATA)->GetMBLayout(), FrameRange(Input(CLASSPROBINDATA)->GetMBLayout()));
         m_clsSoftmax.AssignExpOf(m_clsLogSoftmax); // non-log
+        m_clsTargets.Resize(m_nbrCls, m_classOfColumn.GetNumCols());
+        TensorView<ElemType>(m_clsTargets, TensorShape(m_nbrCls, m_classOfColumn.GetNumCols()))
+            .AssignEQOf(TensorView<ElemType>(m_clsIota.ColumnSlice(0, m_nbrCls), TensorShape(m_nbrCls, 1)), TensorView<ElemType>(m_classOfColumn, TensorShape(1, m_classOfColumn.GetNumCols())));
+
+        // the hidden vectors of the frames, sorted by class
+        m_sortedInput.Resize(hdSize, m_frameColumns.GetNumCols());
+        m_sortedInput.DoGatherColumnsOf(0, m_frameColumns, Input(INPUTDATA)->Value(), 1);
+
+        // buffers to hold the class-conditioned distributions, one [nbr_wrd x numFrames] block per class, concatenated
+        m_softMax.Resize(1, m_totalNbrWords);
+        m_logSoftmax.Resize(1, m_totalNbrWords);
+        m_wordTargets.Resize(1, m_totalNbrWords);
+        for (const auto& block : m_classBlocks)
+        {
+            // log softmax(W_c' x) for all frames of the class
+            Matrix<ElemType> logSoftMax_c = BlockOf(m_logSoftmax, block);
+            Matrix<ElemType>::Multiply(WeightsFor(Input(EMBEDDINGMATRIX)->ValueAsMatrix(), block), true, m_sortedInput.ColumnSlice(block.firstFrame, block.numFrames), false, logSoftMax_c);
+            logSoftMax_c.InplaceLogSoftmax(true);
+
+            // one-hot targets: row index == the word's index in the class
+            TensorView<ElemType>(BlockOf(m_wordTargets, block), TensorShape(block.numWords, block.numFrames))
+                .AssignEQOf(TensorView<ElemType>(m_wordIota.ColumnSlice(0, block.numWords), TensorShape(block.numWords, 1)),
+                            TensorView<ElemType>(m_targetInClass.ColumnSlice(block.firstFrame, block.numFrames), TensorShape(1, block.numFrames)));
+        }
+        // and non-log version
+        m_softMax.AssignExpOf(m_logSoftmax);
 
-        // create a large workspace to contain all class-conditioned probs concatenated
-        // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
-        // TODO: should we pull this iteration into an iterator, to reduce the code dup?
-        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0;
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
-            {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t lft_bnd = (size_t) lbl_t(2, 0);
-                size_t rgt_bnd = (size_t) lbl_t(3, 0);
-                size_t nbr_wrd = (rgt_bnd - lft_bnd); // number of words in the class
-                if (nbr_wrd == 0)
-                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Encountered a class of size 0. This sample seems to lack an NoInput flag.");
-
-                sz += nbr_wrd;
-            }
-        m_totalNbrWords = sz; // total size of concatenated vector
-
-        // buffer to hold the concatenated class-conditioned prob vectors
-        m_softMax.Resize(1, sz);
-        m_logSoftmax.Resize(1, sz);
-
-        // accumulate objective
-        functionValues.SetValue(0);
-        sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
-            {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t y_t = (size_t) lbl_t(0, 0);     // current word token index
-                size_t c_t = (size_t) lbl_t(1, 0);     // current word token's class index
-                size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
-
-                // now get views of various arrays that correspond to the index range of words belonging to this class
-
-                // get hidden vectors for the words in this class
-                Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
-
-                // buffer to hold the class-conditional distribution
-                Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-                Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
-
-                Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-
-                // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-                // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-                obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-                logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
-
-                // log softmax(W x_t)
-                logSoftMax_t.InplaceLogSoftmax(false);
-
-                // and non-log version
-                softMax_t.SetValue(logSoftMax_t);
-                softMax_t.InplaceExp();
-                // we now have a column vector of class-conditional probabilities over the class members
-
-                // add  the word's class-conditional log posterior
-                if (y_t < lft_bnd || y_t >= rgt_bnd)
-                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Word index out of bounds of class-member index range (word not a class member).");
-                size_t idx_in_class = y_t - lft_bnd;
-                Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
-
-                // add the class log posterior probability
-                Matrix<ElemType>::AddElementToElement(m_clsLogSoftmax, c_t, t, functionValues, 0, 0); // (1x1)
-
-                sz += nbr_wrd;
-            }
-
+        // the words' class-conditional log posteriors plus the classes' log posteriors
+        functionValues.AssignInnerProductOfMatrices(m_wordTargets, m_logSoftmax);
+        m_temp.AssignInnerProductOfMatrices(m_clsTargets, m_clsLogSoftmax);
+        functionValues += m_temp;
         functionValues *= (-1);
 
 #if NANCHECK
@@ -979,17 +1433,29 @@ public:
     }
 
 protected:
+    // class-conditioned distributions over the words of each class, and the one-hot targets, packed by class (see ClassBlock)
     Matrix<ElemType> m_logSoftmax;
     Matrix<ElemType> m_softMax;
+    Matrix<ElemType> m_wordTargets;
+    // gradient of cross entropy with respect to the input of softmax, packed like m_softMax
+    Matrix<ElemType> m_grdToSoftMaxInput;
+    bool m_needRecomputeGradientToSoftmaxInput;
 
     Matrix<ElemType> m_clsLogSoftmax;
     Matrix<ElemType> m_clsSoftmax;
+    Matrix<ElemType> m_clsTargets; // [nbr_cls x T] one-hot
 
-    // gradient of cross entropy with respect to the input of softmax
-    // a 1 row by \sum_t m_nbrWordsInEachTime[t] vector
-    // one slice of size m_nbrWordsInEachTime[t] saves the input to softmax for word y_t
-    Matrix<ElemType> m_grdToSoftMaxInput;
-    bool m_needRecomputeGradientToSoftmaxInput;
+    // from GroupFramesByClass(), as [1 x n] rows
+    vector<ClassBlock> m_classBlocks;
+    Matrix<ElemType> m_frameColumns;  // column of each frame in the input, sorted by class
+    Matrix<ElemType> m_targetInClass; // index of each frame's word within its class, sorted by class
+    Matrix<ElemType> m_classOfColumn; // class of each column, -1 for gaps
+    Matrix<ElemType> m_wordIota;      // 0..max number of words in a class
+    Matrix<ElemType> m_clsIota;       // 0..nbr_cls-1
+
+    Matrix<ElemType> m_sortedInput; // [hdSize x number of frames] the hidden vectors in the order of m_frameColumns
+    Matrix<ElemType> m_sortedInputGradient;
+    Matrix<ElemType> m_temp;
 
     size_t m_nbrCls;
     size_t m_totalNbrWords;
@@ -1045,6 +1511,7 @@ public:
     {
     }
 
+
     // compute posterior probability of label y at position t
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
@@ -1132,21 +1599,8 @@ public:
         BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
         PostProbCompute(postprob, alpha, beta);
 
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
+        firstLbl = FirstLabelAt(lbls, 0);
+        lastLbl = FirstLabelAt(lbls, nObs - 1);
 
         functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
 
@@ -1154,25 +1608,13 @@ public:
         ElemType fAlpha;
         fAlpha = a.LogAddSumOfElements();
 
-        // transition score
+        // transition score: sum_t pair_scores(j_{t+1}, i_t) = <lbls[:, 1:], pair_scores * lbls[:, :-1]>, computed on the device
         ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
+        if (nObs > 1)
         {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
+            Matrix<ElemType> transitions(lbls.GetDeviceId());
+            transitions.AssignProductOf(pair_scores, false, lbls.ColumnSlice(0, nObs - 1), false);
+            tscore = Matrix<ElemType>::InnerProductOfMatrices(lbls.ColumnSlice(1, nObs - 1), transitions);
         }
         tscore += functionValues.Get00Element(); // correct path score
         tscore -= fAlpha;                        // reduced by the scores from all paths
@@ -1187,36 +1629,24 @@ public:
                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
     {
         // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
+        int firstLbl = FirstLabelAt(lbls, 0);
+
+        Matrix<ElemType>::RCRFForwardCompute(alpha, pos_scores, pair_scores, firstLbl);
+    }
 
-        int firstLbl = -1;
+    // the label of column t of the one-hot 'lbls', or -1; only that column is copied to the host
+    static int FirstLabelAt(const Matrix<ElemType>& lbls, size_t t)
+    {
+        int label = -1;
+        ElemType* column = lbls.ColumnSlice(t, 1).CopyToArray();
         for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
+            if (column[ik] != 0)
             {
-                firstLbl = ik;
+                label = ik;
                 break;
             }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
+        delete[] column;
+        return label;
     }
 
     // compute backward algorithm
@@ -1444,9 +1874,9 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LogisticNode<ElemType>>(nodeP);
-            *node->m_classZeroLabels = *m_classZeroLabels;
-            *node->m_result = *m_result;
-            *node->m_temp = *m_temp;
+            CopyMatrixIfAllocated(m_classZeroLabels, node->m_classZeroLabels);
+            CopyMatrixIfAllocated(m_result, node->m_result);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
         }
     }
 
@@ -1462,6 +1892,9 @@ template class LogisticNode<double>;
 // -----------------------------------------------------------------------
 // DropoutNode (input) -- perform drop-out
 // Output is scaled such that no post-scaling is necessary.
+// The mask is not stored: it is a function of a per-minibatch seed and the element's position in the minibatch
+// (Matrix::DoDropoutOf()), which backprop evaluates again. This saves a matrix the size of the output per node, and the
+// random-number and masking passes that produced it.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -1478,7 +1911,7 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_dropoutRate(0)
+          m_dropoutRate(0), m_maskSeed(0)
     {
         m_randomSeed = (unsigned long) CreateUniqId();
     }
@@ -1489,7 +1922,7 @@ public:
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
         if (m_dropoutRate > 0)
-            sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
+            sliceInput0Grad.DoDropoutOf(1, sliceOutputGrad, m_dropoutRate, m_maskSeed, MaskCounterOffset(fr)); // (the same mask as in ForwardProp())
         else
             sliceInput0Grad += sliceOutputGrad;
     }
@@ -1509,12 +1942,12 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
+    // each minibatch gets a new mask; in loops, the time steps of a minibatch share the seed and differ by position
+    virtual void BeginForwardProp() override
     {
-        Base::UpdateFunctionMBSize();
-        // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
-            m_maskOfDropout->Resize(Input(0)->Value());
+        Base::BeginForwardProp();
+        m_maskSeed = m_randomSeed;
+        m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other dropout nodes
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1523,14 +1956,7 @@ public:
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
         if (m_dropoutRate > 0)
-        {
-            // determine drop-out mask for this minibatch
-            auto sliceMask = DataFor(*m_maskOfDropout, fr);
-            sliceMask.SetUniformRandomMask((ElemType) m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)) /*pre-scaled*/, m_randomSeed);
-            m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other dropout nodes
-            // apply dropout mask
-            sliceOutputValue.AssignElementProductOf(sliceMask, sliceInput0Value);
-        }
+            sliceOutputValue.DoDropoutOf(0, sliceInput0Value, m_dropoutRate, m_maskSeed, MaskCounterOffset(fr)); // output is pre-scaled
         else
         {
             sliceOutputValue.SetValue(sliceInput0Value);
@@ -1563,28 +1989,20 @@ public:
             auto node = dynamic_pointer_cast<DropoutNode<ElemType>>(nodeP);
             node->m_dropoutRate = m_dropoutRate;
             node->m_randomSeed = m_randomSeed;
-            node->m_maskOfDropout = m_maskOfDropout;
+            node->m_maskSeed = m_maskSeed;
         }
     }
-    // request matrices needed to do node function value evaluation
-    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
-    }
 
-    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
-    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+private:
+    // position of the first element of the frame range within the minibatch, where its mask counters start
+    size_t MaskCounterOffset(const FrameRange& fr) const
     {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        return ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, m_pMBLayout).first * Value().GetNumRows();
     }
 
-private:
     double m_dropoutRate;
-    unsigned long m_randomSeed;
-
-    shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    unsigned long m_randomSeed; // for the next minibatch
+    unsigned long m_maskSeed;   // of the current minibatch
 };
 
 template class DropoutNode<float>;
@@ -1791,9 +2209,9 @@ public:
             {
                 auto dims = ImageDimensions(shape, m_imageLayoutKind);
                 if (m_inT == nullptr)
-                    m_inT = m_factory->CreateTensor(dims.m_width, dims.m_height, dims.m_numChannels, 1);
+                    m_inT = m_factory->CreateTensor(dims.m_width, dims.m_height, dims.m_numChannels, 1, dims.m_depth);
                 if (m_scaleBiasT == nullptr)
-                    m_scaleBiasT = m_factory->CreateTensor(1, 1, dims.m_numChannels, 1);
+                    m_scaleBiasT = m_factory->CreateTensor(1, 1, dims.m_numChannels, 1, dims.IsVolume() ? 1 : 0);
             }
             else
             {
@@ -1842,6 +2260,11 @@ public:
         m_eval = bnEvalMode;
     }
 
+    bool IsSpatial() const
+    {
+        return m_spatial;
+    }
+
 private:
     struct VersionInfo
     {
@@ -16,6 +16,7 @@
 #endif
 #include "BestGpu.h"
 #include "MPIWrapper.h"
+#include <set>
 
 // TODO: Get rid of this global
 Microsoft::MSR::CNTK::MPIWrapper* g_mpi = nullptr;
@@ -43,63 +44,188 @@ extern "C" EVAL_API void GetEvalD(IEvaluateModel<double>** peval)
 }
 
 template <class ElemType>
-void CNTKEval<ElemType>::Init(const std::string& config)
+void EVAL_API GetEvalShared(IEvaluateModelShared<ElemType>** peval)
 {
-    m_start = 0;
-    m_config.Parse(config);
-    if (m_config.Exists("modelPath"))
-    {
-        std::wstring path = m_config("modelPath");
-        LoadModel(path);
-    }
-    size_t nThreads = m_config("numCPUThreads", "1");
-    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    *peval = new CNTKEvalShared<ElemType>();
+}
 
-    g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+extern "C" EVAL_API void GetEvalSharedF(IEvaluateModelShared<float>** peval)
+{
+    GetEvalShared(peval);
+}
+extern "C" EVAL_API void GetEvalSharedD(IEvaluateModelShared<double>** peval)
+{
+    GetEvalShared(peval);
 }
 
-// Destroy - cleanup and remove this class
-// NOTE: this destroys the object, and it can't be used past this point
 template <class ElemType>
-void CNTKEval<ElemType>::Destroy()
+void EVAL_API GetEvalBatching(IEvaluateModel<ElemType>** peval)
 {
-    // cleanup everything
-    m_net.reset();
-    delete m_reader;
-    delete m_writer;
-    delete this;
+    *peval = new CNTKEvalBatching<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModel<float>** peval)
+{
+    GetEvalBatching(peval);
+}
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModel<double>** peval)
+{
+    GetEvalBatching(peval);
 }
 
-// LoadModel - load a model from the specified path
-// modelFileName - file holding the model to load
 template <class ElemType>
-void CNTKEval<ElemType>::LoadModel(const std::wstring& modelFileName)
+void EVAL_API GetEvalStreaming(IEvaluateModelStreaming<ElemType>** peval)
 {
-    DEVICEID_TYPE deviceId = DeviceFromConfig(m_config);
-    fprintf(stderr, "DeviceID=%d\n", (int) deviceId);
-    m_net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    *peval = new CNTKEvalStreaming<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalStreamingF(IEvaluateModelStreaming<float>** peval)
+{
+    GetEvalStreaming(peval);
+}
+extern "C" EVAL_API void GetEvalStreamingD(IEvaluateModelStreaming<double>** peval)
+{
+    GetEvalStreaming(peval);
 }
 
-// GetNodeDimensions - Get the node dimensions of the specified nodes
-// dimensions - map from name of node to dimension of the node, will be appended to for Input/Output scenarios
-// nodeGroup - type of node we are requesting (input/output/specified)
-// NOTE: when nodeGroup==specified the dimensions map is expected to be populated with the string names of the nodes requested, dimensions will be modified return the current value.
 template <class ElemType>
-void CNTKEval<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+void EVAL_API GetEvalBeamSearch(IEvaluateModelBeamSearch<ElemType>** peval)
+{
+    *peval = new CNTKEvalBeamSearch<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalBeamSearchF(IEvaluateModelBeamSearch<float>** peval)
+{
+    GetEvalBeamSearch(peval);
+}
+extern "C" EVAL_API void GetEvalBeamSearchD(IEvaluateModelBeamSearch<double>** peval)
+{
+    GetEvalBeamSearch(peval);
+}
+
+// helpers shared by CNTKEval, CNTKEvalShared and CNTKEvalContext
+
+template <class ElemType>
+static ComputationNetworkPtr LoadNetwork(const ConfigParameters& config, const std::wstring& modelFileName)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    fprintf(stderr, "DeviceID=%d\n", (int) deviceId);
+    ComputationNetworkPtr net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+
+    // optionally drop everything but what the outputs need and Dropout, and fold the input normalization and
+    // BatchNormalization into the adjacent layers
+    bool optimizeForInference = config(L"optimizeForInference", false);
+    if (optimizeForInference)
+    {
+        vector<wstring> outputNodeNames = config(L"outputNodeNames", ConfigParameters::Array(stringargvector()));
+        vector<ComputationNodeBasePtr> outputNodes;
+        for (const auto& name : outputNodeNames)
+            outputNodes.push_back(net->GetNodeFromName(name));
+        if (outputNodes.empty())
+            outputNodes = net->OutputNodes();
+        size_t numPruned = net->PruneForInference(outputNodes);
+        size_t numFolded = net->FoldMeanVarNormalization<ElemType>();
+        size_t numDropout = net->RemoveDropoutNodes();
+        size_t numBatchNorm = net->FoldBatchNormalizationIntoTimes<ElemType>();
+        size_t numMerged = net->MergeIdenticalNodes();
+        size_t numConstants = net->FoldConstants<ElemType>(); // (all parameters are constants now)
+        fprintf(stderr, "optimizeForInference: deleted %d nodes not needed for the outputs, folded %d input normalizations.\n", (int) numPruned, (int) numFolded);
+        fprintf(stderr, "optimizeForInference: deleted %d Dropout nodes, folded %d BatchNormalization nodes into Times operations.\n", (int) numDropout, (int) numBatchNorm);
+        fprintf(stderr, "optimizeForInference: merged %d identical nodes, replaced %d subexpressions of parameters by their values.\n", (int) numMerged, (int) numConstants);
+    }
+
+    // optionally pre-multiply the projections following embedding lookups into the embedding tables
+    bool foldEmbeddingProjections = config(L"foldEmbeddingProjections", false);
+    if (foldEmbeddingProjections)
+    {
+        double maxGrowth = config(L"embeddingProjectionMaxGrowth", 1.0);
+        size_t numFolded = net->FoldEmbeddingProjections<ElemType>(maxGrowth);
+        fprintf(stderr, "foldEmbeddingProjections: folded %d projections into embedding tables.\n", (int) numFolded);
+    }
+
+    // optionally fold bias, BatchNormalization and ReLU into the preceding convolutions
+    bool fuseConvolutionLayers = config(L"fuseConvolutionLayers", false);
+    if (fuseConvolutionLayers)
+    {
+        size_t numFused = net->FuseConvolutionLayers<ElemType>();
+        fprintf(stderr, "fuseConvolutionLayers: fused the layers following %d Convolution operations.\n", (int) numFused);
+    }
+
+    // optionally run the weight matrices of Times operations as int8 (CPU only)
+    bool quantizeWeightsToInt8 = config(L"quantizeWeightsToInt8", false);
+    if (quantizeWeightsToInt8)
+    {
+        if (deviceId != CPUDEVICE)
+            fprintf(stderr, "quantizeWeightsToInt8: WARNING: int8 weights are only used on the CPU, but the model is on device %d.\n", (int) deviceId);
+        size_t numQuantized = net->QuantizeTimesWeightsToInt8<ElemType>();
+        fprintf(stderr, "quantizeWeightsToInt8: %d Times operations will use int8 weights.\n", (int) numQuantized);
+    }
+
+    // optionally run the weight matrices of Times operations that are mostly zeros (e.g. pruned ones) as sparse matrices (CPU only)
+    double sparseWeightsMaxDensity = config(L"sparseWeightsMaxDensity", 0.0);
+    if (sparseWeightsMaxDensity > 0)
+    {
+        if (deviceId != CPUDEVICE)
+            fprintf(stderr, "sparseWeightsMaxDensity: WARNING: sparse weights are only used on the CPU, but the model is on device %d.\n", (int) deviceId);
+        size_t numSparsified = net->SparsifyTimesWeights<ElemType>(sparseWeightsMaxDensity);
+        fprintf(stderr, "sparseWeightsMaxDensity: %d Times operations will use sparse weights.\n", (int) numSparsified);
+    }
+
+    // last, as the steps above may still change the parameters
+    // With a parameterFile, the values are mapped from there, which the first process to load the model creates
+    // (under a temporary name, so that others never map a partial file). A file that was written from other values,
+    // e.g. of the model before it was retrained, is replaced.
+    if (config.Exists("parameterFile"))
+    {
+        std::wstring parameterFile = config(L"parameterFile");
+        size_t numMapped = 0;
+        if (!fexists(parameterFile) || !net->MapParameterSection<ElemType>(parameterFile, numMapped))
+        {
+            if (fexists(parameterFile))
+                fprintf(stderr, "parameterFile: %ls was written for different parameter values, writing it again.\n", parameterFile.c_str());
+            std::wstring tempFile = parameterFile + L".tmp" + std::to_wstring(GetCurrentProcessId());
+            net->SaveParameterSection<ElemType>(tempFile);
+            try
+            {
+                renameOrDie(tempFile, parameterFile);
+            }
+            catch (const std::exception&)
+            {
+                if (!fexists(parameterFile)) // rather than created by another process meanwhile
+                    throw;
+                unlinkOrDie(tempFile);
+            }
+            if (!net->MapParameterSection<ElemType>(parameterFile, numMapped)) // (e.g. replaced meanwhile by a process loading another model)
+                RuntimeError("parameterFile: %ls does not match the parameter values of the model.", parameterFile.c_str());
+        }
+        fprintf(stderr, "parameterFile: mapped %d parameter values from %ls.\n", (int) numMapped, parameterFile.c_str());
+    }
+    else if (optimizeForInference)
+    {
+        size_t numPacked = net->PackParameters<ElemType>();
+        fprintf(stderr, "optimizeForInference: packed %d parameter elements into one buffer.\n", (int) numPacked);
+    }
+
+    // nothing changes the parameters from here on, so what is computed from them alone is computed once
+    net->SetParametersFrozen(true);
+    return net;
+}
+
+static void GetNetworkNodeDimensions(const ComputationNetworkPtr& net, std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
 {
-    if (m_net == NULL)
+    if (net == NULL)
     {
         for (auto iter = dimensions.begin(); iter != dimensions.end(); iter++)
             iter->second = 0;
         return;
     }
 
-    const auto& outputNodes = m_net->OutputNodes();
+    const auto& outputNodes = net->OutputNodes();
     switch (nodeGroup)
     {
     case nodeInput:
     {
-        auto& nodes = m_net->InputNodes(outputNodes[0]);
+        auto& nodes = net->InputNodes(outputNodes[0]);
         for (auto& node : nodes)
         {
             std::wstring name = node->NodeName();
@@ -122,57 +248,290 @@ void CNTKEval<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimen
     case nodeSpecified:
         for (auto iter = dimensions.begin(); iter != dimensions.end(); iter++)
         {
-            auto node = m_net->GetNodeFromName(iter->first);
+            auto node = net->GetNodeFromName(iter->first);
             iter->second = node->GetSampleMatrixNumRows();
         }
         break;
     }
 }
 
-// StartEvaluateMinibatchLoop - Prepare network for Evaluate() calls.
-// ouputNodeName - name of node that will be evaluated
+// the optional cache of recent results ('resultCacheSize' results; statistics every 'resultCacheLogInterval' lookups)
 template <class ElemType>
-void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNodeName)
+static shared_ptr<EvalResultCache<ElemType>> CreateResultCache(const ConfigParameters& config)
 {
-    m_net->StartEvaluateMinibatchLoop(m_net->GetNodeFromName(outputNodeName));
+    size_t resultCacheSize = config(L"resultCacheSize", (size_t) 0);
+    if (resultCacheSize == 0)
+        return nullptr;
+    size_t logInterval = config(L"resultCacheLogInterval", (size_t) 0);
+    return make_shared<EvalResultCache<ElemType>>(resultCacheSize, logInterval);
 }
 
-// Evaluate - Evalute using the model with the given inputs and outputs
-// inputs - map from node name to input vector
-// outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
+// evaluate 'net' on 'inputs' into 'outputs', creating the reader and writer on first use
 template <class ElemType>
-void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+static void EvaluateNetwork(const ComputationNetworkPtr& net, EvalReader<ElemType>*& reader, EvalWriter<ElemType>*& writer,
+                            std::map<std::wstring, size_t>& dimensions, size_t start, size_t minibatchSize,
+                            std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
 {
-    size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
     // get the evaluation names from the output string
     vector<wstring> outNodeNames;
 
     ConfigParameters config;
-    // config["deviceId"] = to_string(m_net->GetDeviceId());
+    // config["deviceId"] = to_string(net->GetDeviceId());
 
     // create the reader if necessary
-    if (m_reader == nullptr)
+    if (reader == nullptr)
     {
-        m_reader = new EvalReader<ElemType>(config);
+        reader = new EvalReader<ElemType>(config);
     }
 
     // now set the data in the reader
-    GetNodeDimensions(m_dimensions, nodeInput);
-    m_reader->SetData(&inputs, &m_dimensions);
-    m_reader->SetBoundary(m_start);
+    GetNetworkNodeDimensions(net, dimensions, nodeInput);
+    reader->SetData(&inputs, &dimensions);
+    reader->SetBoundary(start);
     // create the reader if necessary
-    if (m_writer == nullptr)
+    if (writer == nullptr)
     {
-        m_writer = new EvalWriter<ElemType>(config);
+        writer = new EvalWriter<ElemType>(config);
     }
 
     // now set the data in the reader
-    GetNodeDimensions(m_dimensions, nodeOutput);
-    m_writer->SetData(&outputs, &m_dimensions);
+    GetNetworkNodeDimensions(net, dimensions, nodeOutput);
+    writer->SetData(&outputs, &dimensions);
 
     // call the evaluator
-    SimpleOutputWriter<ElemType> eval(m_net);
-    eval.WriteOutput(*m_reader, minibatchSize, *m_writer, outNodeNames);
+    SimpleOutputWriter<ElemType> eval(net);
+    eval.WriteOutput(*reader, minibatchSize, *writer, outNodeNames);
+}
+
+// evaluate 'net' on caller-owned buffers
+// There is one sequence, which continues the one of the previous call unless 'start' changed (ResetState()), like in EvalReader.
+// Apart from (re-)allocating the matrices, which a prepared binding never does, nothing here allocates once the binding's
+// vectors have grown to the number of inputs and outputs.
+template <class ElemType>
+static void EvaluateNetworkOnBuffers(const ComputationNetworkPtr& net, EvalBufferBinding<ElemType>& binding, size_t start,
+                                     std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs)
+{
+    // (re-)allocate only when the outputs asked for change
+    std::vector<ComputationNodeBasePtr>& outputNodes = binding.m_requestedOutputs;
+    outputNodes.clear();
+    for (const auto& iter : outputs)
+        outputNodes.push_back(net->GetNodeFromName(iter.first));
+    if (outputNodes != binding.m_outputNodes)
+    {
+        if (binding.m_maxNumRecords > 0)
+            InvalidArgument("Evaluate: The outputs asked for are not the ones PrepareEvaluate() was called for.");
+        net->AllocateAllMatrices({}, outputNodes, nullptr);
+        net->StartEvaluateMinibatchLoop(outputNodes);
+        binding.m_outputNodes = outputNodes;
+    }
+
+    // all inputs must hold the same number of records
+    std::vector<ComputationNodeBasePtr>& inputNodes = binding.m_inputNodes;
+    inputNodes.clear();
+    size_t numRecords = 0;
+    for (const auto& iter : inputs)
+    {
+        auto node = net->GetNodeFromName(iter.first);
+        size_t rows = node->GetSampleMatrixNumRows();
+        size_t recordCount = iter.second.m_size / rows;
+        if (!inputNodes.empty() && recordCount != numRecords)
+            RuntimeError("Record Count of %ls (%lux%lu) does not match the record count of previous entries (%lu).", iter.first.c_str(), rows, recordCount, numRecords);
+        numRecords = recordCount;
+        inputNodes.push_back(node);
+    }
+    if (binding.m_maxNumRecords > 0 && numRecords > binding.m_maxNumRecords)
+        InvalidArgument("Evaluate: %d records given, but PrepareEvaluate() was called for up to %d.", (int) numRecords, (int) binding.m_maxNumRecords);
+
+    auto pMBLayout = net->GetMBLayoutPtr();
+    pMBLayout->Init(1, numRecords);
+    pMBLayout->AddSequence(0, 0, start == binding.m_lastStart ? -1 : 0, numRecords + 1); // fake end beyond the minibatch, see EvalReader
+    binding.m_lastStart = start;
+
+    // bind the inputs: on the CPU, the input nodes take views of the caller's buffers as their values until we return
+    auto& ownValues = binding.m_ownValues;
+    if (binding.m_inputViews.size() < inputNodes.size())
+        binding.m_inputViews.resize(inputNodes.size());
+    ownValues.resize(inputNodes.size());
+    auto restoreValues = [&]()
+    {
+        for (size_t i = 0; i < inputNodes.size(); i++)
+            if (ownValues[i])
+            {
+                inputNodes[i]->As<ComputationNode<ElemType>>()->SwapValuePtr(ownValues[i]); // (returns the view, which we keep)
+                ownValues[i].reset();
+            }
+    };
+    try
+    {
+        size_t i = 0;
+        for (auto& iter : inputs)
+        {
+            auto node = inputNodes[i]->As<ComputationNode<ElemType>>();
+            size_t rows = node->GetSampleMatrixNumRows();
+            if (node->Value().GetDeviceId() == CPUDEVICE)
+            {
+                auto& view = binding.m_inputViews[i];
+                if (!view)
+                    view = make_shared<Matrix<ElemType>>(CPUDEVICE);
+                view->SetValue(rows, numRecords, CPUDEVICE, iter.second.m_buffer, matrixFlagNormal | matrixFlagDontOwnBuffer);
+                ownValues[i] = node->SwapValuePtr(view);
+            }
+            else
+                node->Value().SetValue(rows, numRecords, node->Value().GetDeviceId(), iter.second.m_buffer);
+            node->NotifyFunctionValuesMBSizeModified();
+            i++;
+        }
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+        net->ForwardProp(outputNodes);
+
+        // copy the outputs straight into the caller's buffers (in the order of 'outputs', like 'outputNodes')
+        auto outputIter = outputs.begin();
+        for (const auto& node : outputNodes)
+        {
+            const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+            auto& buffer = (outputIter++)->second;
+            if (value.GetNumElements() > buffer.m_size)
+                RuntimeError("Evaluate: The buffer for %ls holds %lu elements, but the output has %lu.", node->NodeName().c_str(), buffer.m_size, value.GetNumElements());
+            buffer.m_size = value.CopyToArray(buffer.m_buffer, buffer.m_size);
+        }
+    }
+    catch (...)
+    {
+        restoreValues();
+        throw;
+    }
+    restoreValues();
+}
+
+// allocate the matrices of 'net' for 'outputNodeNames' and 'maxNumRecords' records: a forward pass on that many records
+// of zeros grows every value and temporary to its largest size, which later, smaller minibatches reuse
+template <class ElemType>
+static void PrepareNetworkForBuffers(const ComputationNetworkPtr& net, EvalBufferBinding<ElemType>& binding,
+                                     const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords)
+{
+    if (maxNumRecords == 0)
+        InvalidArgument("PrepareEvaluate: maxNumRecords must be at least 1.");
+
+    std::vector<ComputationNodeBasePtr> outputNodes;
+    for (const auto& name : outputNodeNames)
+        outputNodes.push_back(net->GetNodeFromName(name));
+    net->StartEvaluateMinibatchLoop(outputNodes); // (for InputNodes(); the matrices are allocated by the warm-up)
+
+    std::set<ComputationNodeBasePtr> inputNodes;
+    for (const auto& node : outputNodes)
+        for (const auto& input : net->InputNodes(node))
+            inputNodes.insert(input);
+
+    std::map<std::wstring, std::vector<ElemType>> inputData, outputData;
+    std::map<std::wstring, EvalBuffer<ElemType>> inputs, outputs;
+    for (const auto& node : inputNodes)
+    {
+        auto& data = inputData[node->NodeName()];
+        data.assign(node->GetSampleMatrixNumRows() * maxNumRecords, 0);
+        inputs[node->NodeName()] = EvalBuffer<ElemType>{data.data(), data.size()};
+    }
+    for (const auto& node : outputNodes)
+    {
+        auto& data = outputData[node->NodeName()];
+        data.resize(node->GetSampleMatrixNumRows() * maxNumRecords);
+        outputs[node->NodeName()] = EvalBuffer<ElemType>{data.data(), data.size()};
+    }
+
+    binding.m_maxNumRecords = 0; // (not yet: the outputs may differ from the last call's)
+    EvaluateNetworkOnBuffers(net, binding, SIZE_MAX, inputs, outputs);
+    binding.m_maxNumRecords = maxNumRecords;
+    binding.m_lastStart = SIZE_MAX; // the first call starts a new sequence, as without the warm-up
+}
+
+template <class ElemType>
+void CNTKEval<ElemType>::Init(const std::string& config)
+{
+    m_start = 0;
+    m_config.Parse(config);
+    m_resultCache = CreateResultCache<ElemType>(m_config);
+    if (m_config.Exists("modelPath"))
+    {
+        std::wstring path = m_config("modelPath");
+        LoadModel(path);
+    }
+    size_t nThreads = m_config("numCPUThreads", "1");
+    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+
+    g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+}
+
+// Destroy - cleanup and remove this class
+// NOTE: this destroys the object, and it can't be used past this point
+template <class ElemType>
+void CNTKEval<ElemType>::Destroy()
+{
+    // cleanup everything
+    if (m_resultCache)
+        m_resultCache->LogStatistics();
+    m_net.reset();
+    delete m_reader;
+    delete m_writer;
+    delete this;
+}
+
+// LoadModel - load a model from the specified path
+// modelFileName - file holding the model to load
+template <class ElemType>
+void CNTKEval<ElemType>::LoadModel(const std::wstring& modelFileName)
+{
+    m_net = LoadNetwork<ElemType>(m_config, modelFileName);
+    if (m_resultCache)
+        m_resultCache->SetModel(m_net, false);
+}
+
+// GetNodeDimensions - Get the node dimensions of the specified nodes
+// dimensions - map from name of node to dimension of the node, will be appended to for Input/Output scenarios
+// nodeGroup - type of node we are requesting (input/output/specified)
+// NOTE: when nodeGroup==specified the dimensions map is expected to be populated with the string names of the nodes requested, dimensions will be modified return the current value.
+template <class ElemType>
+void CNTKEval<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+{
+    GetNetworkNodeDimensions(m_net, dimensions, nodeGroup);
+}
+
+// StartEvaluateMinibatchLoop - Prepare network for Evaluate() calls.
+// ouputNodeName - name of node that will be evaluated
+template <class ElemType>
+void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNodeName)
+{
+    m_net->StartEvaluateMinibatchLoop(m_net->GetNodeFromName(outputNodeName));
+}
+
+// Evaluate - Evalute using the model with the given inputs and outputs
+// inputs - map from node name to input vector
+// outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
+template <class ElemType>
+void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    if (m_resultCache && m_resultCache->Lookup(inputs, outputs))
+        return;
+    size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
+    EvaluateNetwork(m_net, m_reader, m_writer, m_dimensions, m_start, minibatchSize, inputs, outputs);
+    m_binding.m_outputNodes.clear(); // SimpleOutputWriter allocated the matrices for its roots
+    if (m_resultCache)
+        m_resultCache->Insert(inputs, outputs);
+}
+
+template <class ElemType>
+void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs)
+{
+    if (m_resultCache && m_resultCache->Lookup(inputs, outputs))
+        return;
+    EvaluateNetworkOnBuffers(m_net, m_binding, m_start, inputs, outputs);
+    if (m_resultCache)
+        m_resultCache->Insert(inputs, outputs);
+}
+
+template <class ElemType>
+void CNTKEval<ElemType>::PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords)
+{
+    PrepareNetworkForBuffers(m_net, m_binding, outputNodeNames, maxNumRecords);
 }
 
 // ResetState - Reset the cell state when we get start of an utterance
@@ -182,7 +541,907 @@ void CNTKEval<ElemType>::ResetState()
     m_start = 1 - m_start;
 }
 
+// ---------------------------------------------------------------------------
+// CNTKEvalShared
+// ---------------------------------------------------------------------------
+
+template <class ElemType>
+void CNTKEvalShared<ElemType>::Init(const std::string& config)
+{
+    m_config.Parse(config);
+    m_resultCache = CreateResultCache<ElemType>(m_config);
+    if (m_config.Exists("modelPath"))
+    {
+        std::wstring path = m_config("modelPath");
+        LoadModel(path);
+    }
+    size_t nThreads = m_config("numCPUThreads", "1");
+    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+
+    g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+}
+
+// Destroy - cleanup and remove this class
+// NOTE: all contexts created from this model must have been destroyed before
+template <class ElemType>
+void CNTKEvalShared<ElemType>::Destroy()
+{
+    if (m_resultCache)
+        m_resultCache->LogStatistics();
+    m_net.reset();
+    delete this;
+}
+
+template <class ElemType>
+void CNTKEvalShared<ElemType>::LoadModel(const std::wstring& modelFileName)
+{
+    ComputationNetworkPtr net = LoadNetwork<ElemType>(m_config, modelFileName);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_net = net;
+    if (m_resultCache)
+        m_resultCache->SetModel(m_net, false);
+}
+
+template <class ElemType>
+void CNTKEvalShared<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+{
+    std::lock_guard<std::mutex> lock(m_mutex); // InputNodes() caches its result in the network
+    GetNetworkNodeDimensions(m_net, dimensions, nodeGroup);
+}
+
+// CreateContext - the context evaluates its own copy of the network, which shares our parameters
+template <class ElemType>
+IEvaluateModelContext<ElemType>* CNTKEvalShared<ElemType>::CreateContext()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_net == nullptr)
+        LogicError("CreateContext: No model loaded.");
+    size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
+    return new CNTKEvalContext<ElemType>(m_net->CloneSharingParameters(), minibatchSize, m_resultCache);
+}
+
+// ---------------------------------------------------------------------------
+// CNTKEvalContext
+// ---------------------------------------------------------------------------
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::Destroy()
+{
+    m_net.reset();
+    delete m_reader;
+    delete m_writer;
+    delete this;
+}
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNodeName)
+{
+    m_net->StartEvaluateMinibatchLoop(m_net->GetNodeFromName(outputNodeName));
+}
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    if (m_resultCache && m_resultCache->Lookup(inputs, outputs))
+        return;
+    EvaluateNetwork(m_net, m_reader, m_writer, m_dimensions, m_start, m_minibatchSize, inputs, outputs);
+    m_binding.m_outputNodes.clear(); // SimpleOutputWriter allocated the matrices for its roots
+    if (m_resultCache)
+        m_resultCache->Insert(inputs, outputs);
+}
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs)
+{
+    if (m_resultCache && m_resultCache->Lookup(inputs, outputs))
+        return;
+    EvaluateNetworkOnBuffers(m_net, m_binding, m_start, inputs, outputs);
+    if (m_resultCache)
+        m_resultCache->Insert(inputs, outputs);
+}
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords)
+{
+    PrepareNetworkForBuffers(m_net, m_binding, outputNodeNames, maxNumRecords);
+}
+
+template <class ElemType>
+void CNTKEvalContext<ElemType>::ResetState()
+{
+    m_start = 1 - m_start;
+}
+
+// ---------------------------------------------------------------------------
+// CNTKEvalBatching
+// ---------------------------------------------------------------------------
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::Init(const std::string& config)
+{
+    m_config.Parse(config);
+    m_resultCache = CreateResultCache<ElemType>(m_config);
+    size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
+    m_maxBatchSamples = m_config(L"maxBatchSamples", minibatchSize);
+    m_maxBatchLatency = std::chrono::milliseconds((size_t) m_config(L"maxBatchLatencyMs", (size_t) 2));
+    if (m_config.Exists("modelPath"))
+    {
+        std::wstring path = m_config("modelPath");
+        LoadModel(path);
+    }
+    size_t nThreads = m_config("numCPUThreads", "1");
+    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+
+    g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+}
+
+// Destroy - cleanup and remove this class
+// NOTE: requests still queued are evaluated first; no Evaluate() call may be made after this
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::Destroy()
+{
+    StopWorker();
+    if (m_resultCache)
+        m_resultCache->LogStatistics();
+    m_net.reset();
+    delete this;
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::LoadModel(const std::wstring& modelFileName)
+{
+    StopWorker();
+    m_net = LoadNetwork<ElemType>(m_config, modelFileName);
+    if (m_resultCache)
+        m_resultCache->SetModel(m_net, true); // (each request is a sequence of its own)
+    m_inputDimensions.clear();
+    GetNetworkNodeDimensions(m_net, m_inputDimensions, nodeInput);
+    m_outputNodes.clear();
+    StartWorker();
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+{
+    std::lock_guard<std::mutex> lock(m_netMutex);
+    GetNetworkNodeDimensions(m_net, dimensions, nodeGroup);
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& /*outputNodeName*/)
+{
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::ResetState()
+{
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    if (m_net == nullptr)
+        LogicError("Evaluate: No model loaded.");
+
+    // all inputs must hold the same number of records, see EvalReader::SetData()
+    size_t numRecords = 0;
+    for (const auto& iter : inputs)
+    {
+        auto dim = m_inputDimensions.find(iter.first);
+        if (dim == m_inputDimensions.end())
+            InvalidArgument("Evaluate: '%ls' is not an input of the model.", iter.first.c_str());
+        size_t recordCount = iter.second->size() / dim->second;
+        if (numRecords != 0 && recordCount != numRecords)
+            RuntimeError("Record Count of %ls (%lux%lu) does not match the record count of previous entries (%lu).", iter.first.c_str(), dim->second, recordCount, numRecords);
+        numRecords = recordCount;
+    }
+    if (m_resultCache && m_resultCache->Lookup(inputs, outputs))
+        return;
+
+    Request request{&inputs, &outputs, numRecords, std::chrono::steady_clock::now(), false, nullptr};
+    {
+        std::unique_lock<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(&request);
+        m_queuedRecords += numRecords;
+        m_requestQueued.notify_one();
+        m_requestDone.wait(lock, [&] { return request.done; });
+    }
+    if (request.error)
+        std::rethrow_exception(request.error);
+    if (m_resultCache)
+        m_resultCache->Insert(inputs, outputs);
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs)
+{
+    std::map<std::wstring, std::vector<ElemType>> inputVectors, outputVectors;
+    std::map<std::wstring, std::vector<ElemType>*> inputPtrs, outputPtrs;
+    for (const auto& iter : inputs)
+    {
+        inputVectors[iter.first].assign(iter.second.m_buffer, iter.second.m_buffer + iter.second.m_size);
+        inputPtrs[iter.first] = &inputVectors[iter.first];
+    }
+    for (const auto& iter : outputs)
+        outputPtrs[iter.first] = &outputVectors[iter.first];
+
+    Evaluate(inputPtrs, outputPtrs);
+
+    for (auto& iter : outputs)
+    {
+        const auto& output = outputVectors[iter.first];
+        if (output.size() > iter.second.m_size)
+            RuntimeError("Evaluate: The buffer for %ls holds %lu elements, but the output has %lu.", iter.first.c_str(), iter.second.m_size, output.size());
+        std::copy(output.begin(), output.end(), iter.second.m_buffer);
+        iter.second.m_size = output.size();
+    }
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::PrepareEvaluate(const std::vector<std::wstring>&, size_t)
+{
+    LogicError("PrepareEvaluate: Not supported by the batching evaluator, which copies each request into a shared minibatch.");
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::StartWorker()
+{
+    m_stopWorker = false;
+    m_worker = std::thread([this] { WorkerLoop(); });
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::StopWorker()
+{
+    if (!m_worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopWorker = true;
+    }
+    m_requestQueued.notify_one();
+    m_worker.join();
+}
+
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::WorkerLoop()
+{
+    for (;;)
+    {
+        std::vector<Request*> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_requestQueued.wait(lock, [&] { return m_stopWorker || !m_queue.empty(); });
+            if (m_queue.empty()) // stopping
+                return;
+
+            // give more requests until the oldest one's deadline to arrive, unless there are enough already
+            m_requestQueued.wait_until(lock, m_queue.front()->arrivalTime + m_maxBatchLatency,
+                                       [&] { return m_stopWorker || m_queuedRecords >= m_maxBatchSamples; });
+
+            // take requests in order of arrival while the padded minibatch stays within the limit; always at least one
+            size_t maxRecords = 0;
+            while (!m_queue.empty())
+            {
+                Request* request = m_queue.front();
+                size_t newMaxRecords = max(maxRecords, request->numRecords);
+                if (!batch.empty() && (batch.size() + 1) * newMaxRecords > m_maxBatchSamples)
+                    break;
+                batch.push_back(request);
+                maxRecords = newMaxRecords;
+                m_queuedRecords -= request->numRecords;
+                m_queue.pop_front();
+            }
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            std::lock_guard<std::mutex> lock(m_netMutex);
+            EvaluateBatch(batch);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            for (auto request : batch)
+            {
+                request->error = error;
+                request->done = true;
+            }
+        }
+        m_requestDone.notify_all();
+    }
+}
+
+// evaluate the requests as one minibatch: request s becomes parallel sequence s, padded with a gap to the longest one
+template <class ElemType>
+void CNTKEvalBatching<ElemType>::EvaluateBatch(const std::vector<Request*>& batch)
+{
+    const size_t numSequences = batch.size();
+    size_t numTimeSteps = 0;
+    for (auto request : batch)
+        numTimeSteps = max(numTimeSteps, request->numRecords);
+
+    // evaluate the union of the outputs asked for
+    std::set<std::wstring> outputNames;
+    for (auto request : batch)
+        for (const auto& iter : *request->outputs)
+            outputNames.insert(iter.first);
+    std::vector<ComputationNodeBasePtr> outputNodes;
+    for (const auto& name : outputNames)
+        outputNodes.push_back(m_net->GetNodeFromName(name));
+    if (outputNodes != m_outputNodes)
+    {
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+        m_outputNodes = outputNodes;
+    }
+
+    auto pMBLayout = m_net->GetMBLayoutPtr();
+    pMBLayout->Init(numSequences, numTimeSteps);
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        pMBLayout->AddSequence(s, s, 0, batch[s]->numRecords);
+        pMBLayout->AddGap(s, batch[s]->numRecords, numTimeSteps);
+    }
+
+    // interleave the requests' records: column t * numSequences + s holds record t of request s
+    std::vector<ComputationNodeBasePtr> inputNodes;
+    std::vector<ElemType> buffer;
+    for (const auto& dim : m_inputDimensions)
+    {
+        const size_t rows = dim.second;
+        buffer.assign(rows * numSequences * numTimeSteps, 0); // gaps are zero
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            auto iter = batch[s]->inputs->find(dim.first);
+            if (iter == batch[s]->inputs->end())
+                InvalidArgument("Evaluate: No data for the input '%ls'.", dim.first.c_str());
+            const ElemType* data = iter->second->data();
+            for (size_t t = 0; t < batch[s]->numRecords; t++)
+                memcpy(&buffer[(t * numSequences + s) * rows], data + t * rows, rows * sizeof(ElemType));
+        }
+        auto node = m_net->GetNodeFromName(dim.first);
+        auto& value = node->As<ComputationNode<ElemType>>()->Value();
+        value.SetValue(rows, numSequences * numTimeSteps, value.GetDeviceId(), buffer.data());
+        node->NotifyFunctionValuesMBSizeModified();
+        inputNodes.push_back(node);
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+    m_net->ForwardProp(outputNodes);
+
+    // hand each request its columns
+    for (const auto& node : outputNodes)
+    {
+        const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+        const size_t rows = value.GetNumRows();
+        const bool hasMBLayout = node->HasMBLayout();
+        std::unique_ptr<ElemType[]> values(value.CopyToArray());
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            auto iter = batch[s]->outputs->find(node->NodeName());
+            if (iter == batch[s]->outputs->end())
+                continue;
+            std::vector<ElemType>& output = *iter->second;
+            if (!hasMBLayout) // the same for all requests
+            {
+                output.assign(values.get(), values.get() + value.GetNumElements());
+                continue;
+            }
+            output.resize(rows * batch[s]->numRecords);
+            for (size_t t = 0; t < batch[s]->numRecords; t++)
+                memcpy(&output[t * rows], values.get() + (t * numSequences + s) * rows, rows * sizeof(ElemType));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CNTKEvalStreaming
+// ---------------------------------------------------------------------------
+
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::Init(const std::string& config)
+{
+    m_config.Parse(config);
+    if (m_config.Exists("modelPath"))
+    {
+        std::wstring path = m_config("modelPath");
+        LoadModel(path);
+    }
+    size_t nThreads = m_config("numCPUThreads", "1");
+    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+
+    g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+}
+
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::Destroy()
+{
+    m_streams.clear();
+    m_net.reset();
+    delete this;
+}
+
+// LoadModel - load the model; the state of all open streams refers to the previous one and is discarded
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::LoadModel(const std::wstring& modelFileName)
+{
+    ComputationNetworkPtr net = LoadNetwork<ElemType>(m_config, modelFileName);
+    std::vector<shared_ptr<PastValueNode<ElemType>>> delayNodes;
+    int maxTimeStep = 0;
+    for (const auto& node : net->GetAllNodes())
+    {
+        auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+        if (pastValueNode)
+        {
+            delayNodes.push_back(pastValueNode);
+            maxTimeStep = max(maxTimeStep, pastValueNode->GetTimeStep());
+        }
+        else if (dynamic_pointer_cast<IRecurrentNode>(node))
+            InvalidArgument("LoadModel: The node '%ls' (%ls) depends on frames of later chunks; only PastValue recurrences can be streamed.",
+                            node->NodeName().c_str(), node->OperationName().c_str());
+    }
+
+    m_net = net;
+    m_delayNodes = delayNodes;
+    m_maxTimeStep = maxTimeStep;
+    m_inputDimensions.clear();
+    GetNetworkNodeDimensions(m_net, m_inputDimensions, nodeInput);
+    m_outputNodes.clear();
+    for (auto& stream : m_streams)
+        stream.second = StreamState{ 0, std::vector<shared_ptr<Matrix<ElemType>>>(m_delayNodes.size()) };
+}
+
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+{
+    GetNetworkNodeDimensions(m_net, dimensions, nodeGroup);
+}
+
+template <class ElemType>
+size_t CNTKEvalStreaming<ElemType>::OpenStream()
+{
+    size_t stream = m_nextStream++;
+    m_streams[stream] = StreamState{ 0, std::vector<shared_ptr<Matrix<ElemType>>>(m_delayNodes.size()) };
+    return stream;
+}
+
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::CloseStream(size_t stream)
+{
+    if (m_streams.erase(stream) == 0)
+        InvalidArgument("CloseStream: %d is not an open stream.", (int) stream);
+}
+
+// ForkStream - the copy shares the histories, which UpdateHistories() replaces rather than modifies
+template <class ElemType>
+size_t CNTKEvalStreaming<ElemType>::ForkStream(size_t stream)
+{
+    auto iter = m_streams.find(stream);
+    if (iter == m_streams.end())
+        InvalidArgument("ForkStream: %d is not an open stream.", (int) stream);
+    size_t fork = m_nextStream++;
+    m_streams[fork] = iter->second;
+    return fork;
+}
+
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::Evaluate(const std::vector<size_t>& streams,
+                                           std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs,
+                                           std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs)
+{
+    if (m_net == nullptr)
+        LogicError("Evaluate: No model loaded.");
+    const size_t numSequences = streams.size();
+    if (inputs.size() != numSequences || outputs.size() != numSequences)
+        InvalidArgument("Evaluate: Expected inputs and outputs for each of the %d streams.", (int) numSequences);
+    if (numSequences == 0)
+        return;
+
+    // evaluate the union of the outputs asked for
+    std::set<std::wstring> outputNames;
+    for (const auto& output : outputs)
+        for (const auto& iter : output)
+            outputNames.insert(iter.first);
+    std::vector<ComputationNodeBasePtr> outputNodes;
+    for (const auto& name : outputNames)
+        outputNodes.push_back(m_net->GetNodeFromName(name));
+
+    std::vector<size_t> numFrames;
+    ForwardChunks(streams, inputs, outputNodes, numFrames);
+
+    // hand each stream its columns
+    for (const auto& node : outputNodes)
+    {
+        const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+        const size_t rows = value.GetNumRows();
+        const bool hasMBLayout = node->HasMBLayout();
+        std::unique_ptr<ElemType[]> values(value.CopyToArray());
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            auto iter = outputs[s].find(node->NodeName());
+            if (iter == outputs[s].end())
+                continue;
+            std::vector<ElemType>& output = *iter->second;
+            if (!hasMBLayout) // the same for all streams
+            {
+                output.assign(values.get(), values.get() + value.GetNumElements());
+                continue;
+            }
+            output.resize(rows * numFrames[s]);
+            for (size_t t = 0; t < numFrames[s]; t++)
+                memcpy(&output[t * rows], values.get() + (t * numSequences + s) * rows, rows * sizeof(ElemType));
+        }
+    }
+}
+
+// ForwardChunks - evaluate the chunks as one minibatch: stream s becomes parallel sequence s, padded with a gap to the longest chunk
+// Each sequence is declared to have begun up to m_maxTimeStep frames before the minibatch, as far as the stream goes back,
+// so that the PastValue nodes take those frames from their delayed value, which we set to the streams' histories.
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::ForwardChunks(const std::vector<size_t>& streams,
+                                                const std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs,
+                                                const std::vector<ComputationNodeBasePtr>& outputNodes, std::vector<size_t>& numFrames)
+{
+    const size_t numSequences = streams.size();
+    std::vector<StreamState*> states;
+    for (auto stream : streams)
+    {
+        auto iter = m_streams.find(stream);
+        if (iter == m_streams.end())
+            InvalidArgument("Evaluate: %d is not an open stream.", (int) stream);
+        if (find(states.begin(), states.end(), &iter->second) != states.end())
+            InvalidArgument("Evaluate: The stream %d is given more than once.", (int) stream);
+        states.push_back(&iter->second);
+    }
+
+    // the chunk lengths, from the first input
+    numFrames.assign(numSequences, 0);
+    size_t numTimeSteps = 0;
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        for (const auto& dim : m_inputDimensions)
+        {
+            auto iter = inputs[s].find(dim.first);
+            if (iter == inputs[s].end())
+                InvalidArgument("Evaluate: No data for the input '%ls'.", dim.first.c_str());
+            size_t n = iter->second->size() / dim.second;
+            if (dim.first != m_inputDimensions.begin()->first && n != numFrames[s])
+                InvalidArgument("Evaluate: The inputs of stream %d differ in their number of frames.", (int) streams[s]);
+            numFrames[s] = n;
+        }
+        numTimeSteps = max(numTimeSteps, numFrames[s]);
+    }
+
+    if (outputNodes != m_outputNodes)
+    {
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+        m_outputNodes = outputNodes;
+    }
+
+    auto pMBLayout = m_net->GetMBLayoutPtr();
+    pMBLayout->Init(numSequences, numTimeSteps);
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        if (numFrames[s] == 0)
+        {
+            pMBLayout->AddGap(s, 0, numTimeSteps);
+            continue;
+        }
+        ptrdiff_t begin = -(ptrdiff_t) min(states[s]->m_numFramesSeen, (size_t) m_maxTimeStep);
+        pMBLayout->AddSequence(s, s, begin, numFrames[s]);
+        pMBLayout->AddGap(s, numFrames[s], numTimeSteps);
+    }
+
+    // interleave the chunks' frames: column t * numSequences + s holds frame t of stream s
+    std::vector<ComputationNodeBasePtr> inputNodes;
+    std::vector<ElemType> buffer;
+    for (const auto& dim : m_inputDimensions)
+    {
+        const size_t rows = dim.second;
+        buffer.assign(rows * numSequences * numTimeSteps, 0); // gaps are zero
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            const ElemType* data = inputs[s].find(dim.first)->second->data();
+            for (size_t t = 0; t < numFrames[s]; t++)
+                memcpy(&buffer[(t * numSequences + s) * rows], data + t * rows, rows * sizeof(ElemType));
+        }
+        auto node = m_net->GetNodeFromName(dim.first);
+        auto& value = node->As<ComputationNode<ElemType>>()->Value();
+        value.SetValue(rows, numSequences * numTimeSteps, value.GetDeviceId(), buffer.data());
+        node->NotifyFunctionValuesMBSizeModified();
+        inputNodes.push_back(node);
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+    SetDelayedValues(states);
+    m_net->ForwardProp(outputNodes);
+    UpdateHistories(states, numFrames);
+
+    for (size_t s = 0; s < numSequences; s++)
+        states[s]->m_numFramesSeen += numFrames[s];
+}
+
+// set each PastValue node's delayed value to the histories of the streams, as if it were the previous minibatch
+// Column k * numSequences + s holds frame k of the history of stream s; a stream without history leaves zeros, which
+// are never read, since its sequence does not reach back that far.
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::SetDelayedValues(const std::vector<StreamState*>& states)
+{
+    const size_t numSequences = states.size();
+    for (size_t i = 0; i < m_delayNodes.size(); i++)
+    {
+        const auto& node = m_delayNodes[i];
+        const ComputationNodeBase& nodeBase = *node;
+        const size_t rows = nodeBase.GetSampleLayout().GetNumElements();
+        const size_t numHistoryFrames = node->GetTimeStep();
+        Matrix<ElemType> delayedValue(rows, numSequences * numHistoryFrames, nodeBase.GetDeviceId());
+        delayedValue.SetValue(0);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            const auto& history = states[s]->m_history[i];
+            if (!history)
+                continue;
+            for (size_t k = 0; k < numHistoryFrames; k++)
+                delayedValue.SetColumnSlice(history->ColumnSlice(k, 1), k * numSequences + s, 1);
+        }
+        node->SetDelayedValue(delayedValue, numSequences, numHistoryFrames);
+    }
+}
+
+// keep the last frames of each PastValue node's input per stream, i.e. of the history followed by the chunk
+template <class ElemType>
+void CNTKEvalStreaming<ElemType>::UpdateHistories(const std::vector<StreamState*>& states, const std::vector<size_t>& numFrames)
+{
+    const size_t numSequences = states.size();
+    const size_t numTimeSteps = *max_element(numFrames.begin(), numFrames.end());
+    for (size_t i = 0; i < m_delayNodes.size(); i++)
+    {
+        const auto& node = m_delayNodes[i];
+        const Matrix<ElemType>& input = node->GetDelayedValue(); // the input's value of this minibatch
+        if (input.GetNumCols() != numSequences * numTimeSteps) // not needed for the outputs asked for
+            continue;
+        const size_t rows = input.GetNumRows();
+        const size_t numHistoryFrames = node->GetTimeStep();
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            if (numFrames[s] == 0)
+                continue;
+            const size_t numNew = min(numFrames[s], numHistoryFrames);
+            const size_t numOld = numHistoryFrames - numNew;
+            auto history = make_shared<Matrix<ElemType>>(rows, numHistoryFrames, input.GetDeviceId());
+            history->SetValue(0);
+            const auto& oldHistory = states[s]->m_history[i];
+            if (oldHistory && numOld > 0)
+                history->SetColumnSlice(oldHistory->ColumnSlice(numNew, numOld), 0, numOld);
+            for (size_t k = 0; k < numNew; k++)
+            {
+                size_t t = numFrames[s] - numNew + k;
+                history->SetColumnSlice(input.ColumnSlice(t * numSequences + s, 1), numOld + k, 1);
+            }
+            states[s]->m_history[i] = history;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CNTKEvalBeamSearch
+// ---------------------------------------------------------------------------
+
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::Init(const std::string& config)
+{
+    m_config.Parse(config);
+    m_tokenInputName = (std::wstring) m_config("tokenInputNodeName");
+    m_scoreOutputName = (std::wstring) m_config("scoreOutputNodeName");
+    m_endToken = m_config("endToken");
+    m_beamWidth = m_config("beamWidth", "5");
+    m_maxLength = m_config("maxLength", "100");
+    if (m_beamWidth == 0 || m_maxLength == 0)
+        InvalidArgument("Init: beamWidth and maxLength must be positive.");
+
+    m_streaming.Init(config); // (loads the model if 'modelPath' is given)
+    if (m_streaming.GetNetwork())
+        BindModel();
+}
+
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::Destroy()
+{
+    m_scoreOutput.reset();
+    delete this;
+}
+
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::LoadModel(const std::wstring& modelFileName)
+{
+    m_streaming.LoadModel(modelFileName);
+    BindModel();
+}
+
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup)
+{
+    m_streaming.GetNodeDimensions(dimensions, nodeGroup);
+}
+
+// find the token input and the score output, which must be as wide as the vocabulary
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::BindModel()
+{
+    ComputationNetworkPtr net = m_streaming.GetNetwork();
+    std::map<std::wstring, size_t> inputDimensions;
+    GetNetworkNodeDimensions(net, inputDimensions, nodeInput);
+    if (inputDimensions.size() != 1 || inputDimensions.begin()->first != m_tokenInputName)
+        InvalidArgument("LoadModel: The model must have exactly one input, the token input '%ls'.", m_tokenInputName.c_str());
+    m_vocabularySize = inputDimensions.begin()->second;
+
+    m_scoreOutput = net->GetNodeFromName(m_scoreOutputName);
+    if (!m_scoreOutput->HasMBLayout() || m_scoreOutput->GetSampleLayout().GetNumElements() != m_vocabularySize)
+        InvalidArgument("LoadModel: The score output '%ls' must give %d scores per token.", m_scoreOutputName.c_str(), (int) m_vocabularySize);
+    if (m_endToken >= m_vocabularySize)
+        InvalidArgument("LoadModel: endToken (%d) is not in the vocabulary (%d tokens).", (int) m_endToken, (int) m_vocabularySize);
+}
+
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::AppendOneHot(std::vector<ElemType>& frames, size_t token) const
+{
+    if (token >= m_vocabularySize)
+        InvalidArgument("Decode: The token %d is not in the vocabulary (%d tokens).", (int) token, (int) m_vocabularySize);
+    frames.resize(frames.size() + m_vocabularySize, 0);
+    frames[frames.size() - m_vocabularySize + token] = 1;
+}
+
+// Decode - step by step: evaluate the newest token of every open hypothesis (at first, the whole prefix), then replace
+// the hypotheses of each request by the best 'beamWidth' of their extensions. An extension that ends with endToken (or
+// reaches maxLength) goes to the n-best list instead, and a request is done once that has 'beamWidth' entries or no
+// hypotheses are left open. One extension per (hypothesis, token) among each hypothesis's 'beamWidth' best tokens is
+// enough, since no more than 'beamWidth' extensions of one hypothesis can survive.
+template <class ElemType>
+void CNTKEvalBeamSearch<ElemType>::Decode(const std::vector<std::vector<size_t>>& prefixes,
+                                          std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nBest)
+{
+    ComputationNetworkPtr net = m_streaming.GetNetwork();
+    if (net == nullptr)
+        LogicError("Decode: No model loaded.");
+    const size_t numRequests = prefixes.size();
+    const size_t topK = min(m_beamWidth, m_vocabularySize);
+    nBest.clear();
+    nBest.resize(numRequests);
+
+    // the open hypotheses of each request, and their streams and next frames in the order they are evaluated
+    std::vector<std::vector<Hypothesis>> beams(numRequests);
+    std::vector<size_t> streams;
+    std::vector<std::vector<ElemType>> frames;
+    auto closeStreams = [&]()
+    {
+        for (auto stream : streams)
+            m_streaming.CloseStream(stream);
+        streams.clear();
+    };
+
+    Matrix<ElemType> lastScores(net->GetDeviceId());
+    Matrix<ElemType> logProbs(net->GetDeviceId());
+    Matrix<ElemType> topIndexes(net->GetDeviceId());
+    Matrix<ElemType> topValues(net->GetDeviceId());
+    try
+    {
+        for (size_t r = 0; r < numRequests; r++)
+        {
+            if (prefixes[r].empty())
+                InvalidArgument("Decode: The prefix of request %d is empty.", (int) r);
+            streams.push_back(m_streaming.OpenStream());
+            frames.push_back(std::vector<ElemType>());
+            for (auto token : prefixes[r])
+                AppendOneHot(frames.back(), token);
+            beams[r].push_back(Hypothesis{ streams.back(), std::vector<size_t>(), 0 });
+        }
+
+        while (!streams.empty())
+        {
+            // evaluate all open hypotheses in one minibatch
+            const size_t numStreams = streams.size();
+            std::vector<std::map<std::wstring, std::vector<ElemType>*>> inputs(numStreams);
+            for (size_t s = 0; s < numStreams; s++)
+                inputs[s][m_tokenInputName] = &frames[s];
+            std::vector<size_t> numFrames;
+            m_streaming.ForwardChunks(streams, inputs, { m_scoreOutput }, numFrames);
+
+            // the log-probabilities after the last frame of each stream, and their 'topK' best, on the device
+            const Matrix<ElemType>& scores = m_scoreOutput->As<ComputationNode<ElemType>>()->Value();
+            if (scores.GetNumCols() == numStreams) // one frame each, as in all steps but the first
+                logProbs.AssignLogSoftmaxOf(scores, true);
+            else
+            {
+                lastScores.Resize(m_vocabularySize, numStreams);
+                for (size_t s = 0; s < numStreams; s++)
+                    lastScores.SetColumnSlice(scores.ColumnSlice((numFrames[s] - 1) * numStreams + s, 1), s, 1);
+                logProbs.AssignLogSoftmaxOf(lastScores, true);
+            }
+            logProbs.VectorMax(topIndexes, topValues, true, (int) topK);
+            std::unique_ptr<ElemType[]> indexes(topIndexes.CopyToArray());
+            std::unique_ptr<ElemType[]> values(topValues.CopyToArray());
+
+            // the best extensions of each request's hypotheses, which are columns [column, column + beams[r].size())
+            std::vector<size_t> nextStreams;
+            std::vector<std::vector<ElemType>> nextFrames;
+            size_t column = 0;
+            for (size_t r = 0; r < numRequests; r++)
+            {
+                std::vector<Hypothesis>& beam = beams[r];
+                std::vector<std::pair<double, std::pair<size_t, size_t>>> candidates; // (score, (hypothesis, token))
+                for (size_t h = 0; h < beam.size(); h++, column++)
+                    for (size_t k = 0; k < topK; k++)
+                        candidates.push_back(std::make_pair(beam[h].m_score + values[column * topK + k], std::make_pair(h, (size_t) indexes[column * topK + k])));
+                const size_t numBest = min(m_beamWidth, candidates.size());
+                std::partial_sort(candidates.begin(), candidates.begin() + numBest, candidates.end(),
+                                  [](const std::pair<double, std::pair<size_t, size_t>>& a, const std::pair<double, std::pair<size_t, size_t>>& b)
+                                  {
+                                      return a.first > b.first;
+                                  });
+
+                std::vector<Hypothesis> next;
+                for (size_t i = 0; i < numBest && nBest[r].size() < m_beamWidth; i++)
+                {
+                    const Hypothesis& parent = beam[candidates[i].second.first];
+                    const size_t token = candidates[i].second.second;
+                    std::vector<size_t> tokens(parent.m_tokens);
+                    tokens.push_back(token);
+                    if (token == m_endToken || tokens.size() >= m_maxLength)
+                        nBest[r].push_back(std::make_pair(tokens, candidates[i].first));
+                    else
+                        next.push_back(Hypothesis{ m_streaming.ForkStream(parent.m_stream), tokens, candidates[i].first });
+                }
+                if (nBest[r].size() >= m_beamWidth) // done
+                {
+                    for (const auto& hypothesis : next)
+                        m_streaming.CloseStream(hypothesis.m_stream);
+                    next.clear();
+                }
+                for (const auto& hypothesis : next)
+                {
+                    nextStreams.push_back(hypothesis.m_stream);
+                    nextFrames.push_back(std::vector<ElemType>());
+                    AppendOneHot(nextFrames.back(), hypothesis.m_tokens.back());
+                }
+                beam.swap(next);
+            }
+
+            closeStreams(); // the parents'
+            streams.swap(nextStreams);
+            frames.swap(nextFrames);
+        }
+    }
+    catch (...)
+    {
+        closeStreams();
+        throw;
+    }
+
+    for (auto& list : nBest)
+        std::stable_sort(list.begin(), list.end(), [](const std::pair<std::vector<size_t>, double>& a, const std::pair<std::vector<size_t>, double>& b)
+                         {
+                             return a.second > b.second;
+                         });
+}
+
 // instantiate all the combinations we expect to be used
 template class CNTKEval<double>;
 template class CNTKEval<float>;
+template class CNTKEvalShared<double>;
+template class CNTKEvalShared<float>;
+template class CNTKEvalContext<double>;
+template class CNTKEvalContext<float>;
+template class CNTKEvalBatching<double>;
+template class CNTKEvalBatching<float>;
+template class CNTKEvalStreaming<double>;
+template class CNTKEvalStreaming<float>;
+template class CNTKEvalBeamSearch<double>;
+template class CNTKEvalBeamSearch<float>;
 } } }
@@ -9,15 +9,44 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <exception>
 
 #include "Eval.h"
 #include "EvalReader.h"
 #include "EvalWriter.h"
+#include "EvalResultCache.h"
 
 #include "ComputationNetwork.h"
+#include "RecurrentNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// EvalBufferBinding - what Evaluate() on caller-owned buffers keeps from one call to the next
+// The vectors below the line are reused by each call. Once prepared (PrepareEvaluate()), the matrices are allocated for
+// m_maxNumRecords records, so that a call with no more records than that allocates nothing.
+template <class ElemType>
+struct EvalBufferBinding
+{
+    std::vector<ComputationNodeBasePtr> m_outputNodes; // roots the matrices are allocated for
+    size_t m_lastStart;                                // the evaluator's m_start in the previous call, to detect ResetState()
+    size_t m_maxNumRecords;                            // 0 if not prepared
+
+    std::vector<ComputationNodeBasePtr> m_requestedOutputs;
+    std::vector<ComputationNodeBasePtr> m_inputNodes;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_inputViews; // [input] on the CPU: a matrix over the caller's buffer
+    std::vector<shared_ptr<Matrix<ElemType>>> m_ownValues;  // [input] the node's own value while the view stands in for it
+
+    EvalBufferBinding()
+        : m_lastStart(SIZE_MAX), m_maxNumRecords(0)
+    {
+    }
+};
+
 template <class ElemType>
 class CNTKEval : public IEvaluateModel<ElemType>
 {
@@ -28,11 +57,13 @@ class CNTKEval : public IEvaluateModel<ElemType>
     ComputationNetworkPtr m_net;
     std::map<std::wstring, size_t> m_dimensions;
     size_t m_start;
+    EvalBufferBinding<ElemType> m_binding;
+    shared_ptr<EvalResultCache<ElemType>> m_resultCache; // optional
 
 public:
     // constructor
     CNTKEval()
-        : m_reader(nullptr), m_net(nullptr)
+        : m_reader(nullptr), m_writer(nullptr), m_net(nullptr)
     {
     }
 
@@ -54,8 +85,236 @@ public:
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
 
+    // Evaluate - Evaluate using caller-owned buffers
+    // On the CPU, the input nodes use the input buffers directly during the call; on a GPU, they are copied there once.
+    // The outputs are copied into the output buffers straight from the nodes.
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs);
+
+    // PrepareEvaluate - allocate everything the overload above needs for these outputs and up to maxNumRecords records
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords);
+
+    virtual void Init(const std::string& config);
+    virtual void Destroy();
+    virtual void ResetState();
+};
+
+// CNTKEvalContext - evaluates a clone of a CNTKEvalShared model that shares its parameters
+template <class ElemType>
+class CNTKEvalContext : public IEvaluateModelContext<ElemType>
+{
+    EvalReader<ElemType>* m_reader;
+    EvalWriter<ElemType>* m_writer;
+    ComputationNetworkPtr m_net;
+    std::map<std::wstring, size_t> m_dimensions;
+    size_t m_start;
+    size_t m_minibatchSize;
+    EvalBufferBinding<ElemType> m_binding;
+    shared_ptr<EvalResultCache<ElemType>> m_resultCache; // the model's, shared by all its contexts; optional
+
+public:
+    CNTKEvalContext(ComputationNetworkPtr net, size_t minibatchSize, shared_ptr<EvalResultCache<ElemType>> resultCache)
+        : m_reader(nullptr), m_writer(nullptr), m_net(net), m_start(0), m_minibatchSize(minibatchSize), m_resultCache(resultCache)
+    {
+    }
+
+    virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName);
+    virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs);
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords);
+    virtual void Destroy();
+    virtual void ResetState();
+};
+
+// CNTKEvalShared - a model loaded once, which any number of threads evaluate through their own CNTKEvalContext
+// The network loaded here is never evaluated itself; each context evaluates a clone of it.
+template <class ElemType>
+class CNTKEvalShared : public IEvaluateModelShared<ElemType>
+{
+    ConfigParameters m_config;
+    ComputationNetworkPtr m_net;
+    shared_ptr<EvalResultCache<ElemType>> m_resultCache; // optional
+    std::mutex m_mutex; // GetNodeDimensions() and CreateContext() may be called concurrently
+
+public:
+    CNTKEvalShared()
+        : m_net(nullptr)
+    {
+    }
+
+    virtual void LoadModel(const std::wstring& modelFileName);
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup);
+
+    // CreateContext - create an evaluator for one thread, see IEvaluateModelContext
+    virtual IEvaluateModelContext<ElemType>* CreateContext();
+
+    virtual void Init(const std::string& config);
+    virtual void Destroy();
+};
+
+// CNTKEvalBatching - evaluates the requests of concurrent callers together
+// Evaluate() queues the request and waits. A worker thread packs the requests that arrive within 'maxBatchLatencyMs' of
+// the oldest one, up to 'maxBatchSamples' columns including padding, into one minibatch with one parallel sequence per
+// request, runs ForwardProp() once for all of them, and hands each caller its columns of the outputs.
+template <class ElemType>
+class CNTKEvalBatching : public IEvaluateModel<ElemType>
+{
+    struct Request
+    {
+        std::map<std::wstring, std::vector<ElemType>*>* inputs;
+        std::map<std::wstring, std::vector<ElemType>*>* outputs;
+        size_t numRecords;
+        std::chrono::steady_clock::time_point arrivalTime;
+        bool done;
+        std::exception_ptr error;
+    };
+
+    ConfigParameters m_config;
+    ComputationNetworkPtr m_net;
+    std::map<std::wstring, size_t> m_inputDimensions; // fixed once loaded, so callers can use them without locking
+    std::vector<ComputationNodeBasePtr> m_outputNodes; // roots the matrices are currently allocated for
+    shared_ptr<EvalResultCache<ElemType>> m_resultCache; // optional; looked up before a request is queued
+    size_t m_maxBatchSamples;
+    std::chrono::milliseconds m_maxBatchLatency;
+
+    std::mutex m_netMutex; // held by the worker while it evaluates
+    std::mutex m_queueMutex;
+    std::condition_variable m_requestQueued;
+    std::condition_variable m_requestDone;
+    std::deque<Request*> m_queue;
+    size_t m_queuedRecords;
+    bool m_stopWorker;
+    std::thread m_worker;
+
+    void StartWorker();
+    void StopWorker();
+    void WorkerLoop();
+    void EvaluateBatch(const std::vector<Request*>& batch);
+
+public:
+    CNTKEvalBatching()
+        : m_net(nullptr), m_maxBatchSamples(0), m_maxBatchLatency(0), m_queuedRecords(0), m_stopWorker(false)
+    {
+    }
+
+    virtual void LoadModel(const std::wstring& modelFileName);
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup);
+
+    // StartEvaluateMinibatchLoop - nothing to do; each minibatch evaluates the outputs its requests ask for
+    virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName);
+
+    // Evaluate - like CNTKEval::Evaluate(), but may be called concurrently; returns when the request's outputs are set
+    virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // Evaluate - the requests are copied into the minibatch anyway, so this goes through the overload above
+    virtual void Evaluate(std::map<std::wstring, EvalBuffer<ElemType>>& inputs, std::map<std::wstring, EvalBuffer<ElemType>>& outputs);
+
+    // PrepareEvaluate - not supported: the minibatches are made of whatever requests arrive together
+    virtual void PrepareEvaluate(const std::vector<std::wstring>& outputNodeNames, size_t maxNumRecords);
+
     virtual void Init(const std::string& config);
     virtual void Destroy();
+
+    // ResetState - nothing to do, since every request is evaluated as a sequence of its own
     virtual void ResetState();
 };
+
+// CNTKEvalStreaming - evaluates chunks of many streams, carrying each stream's recurrent state over between chunks
+// The chunks of one Evaluate() call become the parallel sequences of one minibatch. Since those are different streams
+// from call to call, the PastValue nodes get the state of the streams at hand before, and give it back after, each
+// minibatch. Not thread-safe; use one object per thread.
+template <class ElemType>
+class CNTKEvalStreaming : public IEvaluateModelStreaming<ElemType>
+{
+    struct StreamState
+    {
+        size_t m_numFramesSeen;
+        std::vector<shared_ptr<Matrix<ElemType>>> m_history; // [delay node] last frames of its input, the latest in the last column
+    };
+
+    ConfigParameters m_config;
+    ComputationNetworkPtr m_net;
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_delayNodes;
+    int m_maxTimeStep;
+    std::map<std::wstring, size_t> m_inputDimensions;
+    std::vector<ComputationNodeBasePtr> m_outputNodes; // roots the matrices are currently allocated for
+    std::map<size_t, StreamState> m_streams;
+    size_t m_nextStream;
+
+    void SetDelayedValues(const std::vector<StreamState*>& states);
+    void UpdateHistories(const std::vector<StreamState*>& states, const std::vector<size_t>& numFrames);
+
+public:
+    CNTKEvalStreaming()
+        : m_net(nullptr), m_maxTimeStep(0), m_nextStream(0)
+    {
+    }
+
+    virtual void LoadModel(const std::wstring& modelFileName);
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup);
+
+    virtual size_t OpenStream();
+    virtual void CloseStream(size_t stream);
+    virtual size_t ForkStream(size_t stream);
+
+    virtual void Evaluate(const std::vector<size_t>& streams,
+                          std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs,
+                          std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs);
+
+    // ForwardChunks - Evaluate() without handing out the outputs: they are left in the values of 'outputNodes', where
+    // column t * streams.size() + s holds frame t of streams[s]; numFrames[s] is the length of the chunk of streams[s]
+    void ForwardChunks(const std::vector<size_t>& streams,
+                       const std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs,
+                       const std::vector<ComputationNodeBasePtr>& outputNodes, std::vector<size_t>& numFrames);
+    ComputationNetworkPtr GetNetwork() const
+    {
+        return m_net;
+    }
+
+    virtual void Init(const std::string& config);
+    virtual void Destroy();
+};
+
+// CNTKEvalBeamSearch - beam search on a CNTKEvalStreaming, with one stream per hypothesis
+// A hypothesis is extended by forking its stream, which shares the parent's PastValue histories (they are never
+// modified, only replaced). Each step evaluates the newest token of all hypotheses of all requests as one minibatch,
+// and the best 'beamWidth' next tokens of each hypothesis are found on the model's device, so only those are copied
+// to the host.
+template <class ElemType>
+class CNTKEvalBeamSearch : public IEvaluateModelBeamSearch<ElemType>
+{
+    struct Hypothesis
+    {
+        size_t m_stream;
+        std::vector<size_t> m_tokens; // after the prefix
+        double m_score;               // log-probability of m_tokens
+    };
+
+    ConfigParameters m_config;
+    CNTKEvalStreaming<ElemType> m_streaming; // (its Destroy() is never called, since that deletes it)
+    std::wstring m_tokenInputName;
+    std::wstring m_scoreOutputName;
+    ComputationNodeBasePtr m_scoreOutput;
+    size_t m_vocabularySize;
+    size_t m_endToken;
+    size_t m_beamWidth;
+    size_t m_maxLength;
+
+    void BindModel();
+    void AppendOneHot(std::vector<ElemType>& frames, size_t token) const;
+
+public:
+    CNTKEvalBeamSearch()
+        : m_vocabularySize(0), m_endToken(0), m_beamWidth(0), m_maxLength(0)
+    {
+    }
+
+    virtual void LoadModel(const std::wstring& modelFileName);
+    virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup);
+
+    virtual void Decode(const std::vector<std::vector<size_t>>& prefixes,
+                        std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nBest);
+
+    virtual void Init(const std::string& config);
+    virtual void Destroy();
+};
 } } }
@@ -0,0 +1,250 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalResultCache.h -- the outputs of recent Evaluate() calls, by their inputs ('resultCacheSize')
+//
+// A service that sees the same inputs again and again (e.g. popular queries) need not run ForwardProp() for them. The
+// key is made of the names and values of the inputs and the names of the requested outputs. A 64-bit hash of it finds
+// the entry; the stored key is then compared in full, so that a collision is never taken for a hit. Once there are
+// more than 'capacity' entries, the least recently used one is dropped.
+//
+// Only models whose outputs depend on the inputs alone can be cached: not those with state that carries over from
+// one call to the next (PastValue etc.), unless each call is a sequence of its own. The cache is cleared when a model
+// is loaded. All methods are thread-safe.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Eval.h"
+#include "ComputationNetwork.h"
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class EvalResultCache
+{
+public:
+    struct Statistics
+    {
+        size_t numLookups;
+        size_t numHits;
+        size_t numEntries;
+    };
+
+    // logInterval - if not 0, the statistics are printed every that many lookups
+    EvalResultCache(size_t capacity, size_t logInterval)
+        : m_capacity(capacity), m_logInterval(logInterval), m_enabled(false), m_numLookups(0), m_numHits(0)
+    {
+    }
+
+    // a new model: drop the old one's results, and see whether this one's can be cached
+    // callsAreIndependent - the evaluator starts a new sequence in each call anyway (e.g. CNTKEvalBatching)
+    void SetModel(const ComputationNetworkPtr& net, bool callsAreIndependent)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_enabled = true;
+        for (const auto& node : net->GetAllNodes())
+        {
+            if (!callsAreIndependent && dynamic_pointer_cast<IStatefulNode>(node))
+            {
+                fprintf(stderr, "resultCacheSize: WARNING: Results are not cached, since the output depends on earlier calls through %ls (%ls).\n",
+                        node->NodeName().c_str(), node->OperationName().c_str());
+                m_enabled = false;
+                break;
+            }
+        }
+    }
+
+    // if the result for these inputs is cached, set the outputs to it and return true
+    template <class InputMap, class OutputMap>
+    bool Lookup(const InputMap& inputs, OutputMap& outputs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_enabled)
+            return false;
+        m_numLookups++;
+        bool found = false;
+        uint64_t hash = Hash(inputs, outputs);
+        auto range = m_index.equal_range(hash);
+        for (auto iter = range.first; iter != range.second; iter++)
+        {
+            auto entry = iter->second;
+            if (!entry->Matches(inputs, outputs))
+                continue;
+            m_entries.splice(m_entries.begin(), m_entries, entry); // most recently used
+            auto output = entry->m_outputs.begin();
+            for (auto& iter2 : outputs)
+                SetOutput(iter2.first, iter2.second, (output++)->second);
+            m_numHits++;
+            found = true;
+            break;
+        }
+        if (m_logInterval > 0 && m_numLookups % m_logInterval == 0)
+            PrintStatistics();
+        return found;
+    }
+
+    // remember the outputs for these inputs
+    template <class InputMap, class OutputMap>
+    void Insert(const InputMap& inputs, const OutputMap& outputs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_enabled || m_capacity == 0)
+            return;
+        uint64_t hash = Hash(inputs, outputs);
+        auto range = m_index.equal_range(hash);
+        for (auto iter = range.first; iter != range.second; iter++)
+            if (iter->second->Matches(inputs, outputs)) // (another thread was faster)
+                return;
+
+        m_entries.push_front(Entry());
+        Entry& entry = m_entries.front();
+        entry.m_hash = hash;
+        for (const auto& iter : inputs)
+        {
+            auto data = Data(iter.second);
+            entry.m_inputs.push_back(std::make_pair(iter.first, std::vector<ElemType>(data.first, data.first + data.second)));
+        }
+        for (const auto& iter : outputs)
+        {
+            auto data = Data(iter.second);
+            entry.m_outputs.push_back(std::make_pair(iter.first, std::vector<ElemType>(data.first, data.first + data.second)));
+        }
+        m_index.insert(std::make_pair(hash, m_entries.begin()));
+
+        if (m_entries.size() > m_capacity) // drop the least recently used
+        {
+            auto last = std::prev(m_entries.end());
+            auto range2 = m_index.equal_range(last->m_hash);
+            for (auto iter = range2.first; iter != range2.second; iter++)
+            {
+                if (iter->second == last)
+                {
+                    m_index.erase(iter);
+                    break;
+                }
+            }
+            m_entries.pop_back();
+        }
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return Statistics{m_numLookups, m_numHits, m_entries.size()};
+    }
+
+    void LogStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_enabled)
+            PrintStatistics();
+    }
+
+private:
+    void PrintStatistics() const // (caller holds the lock)
+    {
+        fprintf(stderr, "resultCache: %d lookups, %d hits (%.1f%%), %d of %d entries used\n",
+                (int) m_numLookups, (int) m_numHits, m_numLookups > 0 ? 100.0 * m_numHits / m_numLookups : 0.0, (int) m_entries.size(), (int) m_capacity);
+    }
+
+    typedef std::vector<std::pair<std::wstring, std::vector<ElemType>>> NamedVectors; // in the order of the maps' keys
+
+    struct Entry
+    {
+        uint64_t m_hash;
+        NamedVectors m_inputs;
+        NamedVectors m_outputs; // only the names are part of the key
+
+        template <class InputMap, class OutputMap>
+        bool Matches(const InputMap& inputs, const OutputMap& outputs) const
+        {
+            if (inputs.size() != m_inputs.size() || outputs.size() != m_outputs.size())
+                return false;
+            auto input = m_inputs.begin();
+            for (const auto& iter : inputs)
+            {
+                auto data = Data(iter.second);
+                if (iter.first != input->first || data.second != input->second.size() ||
+                    (data.second > 0 && memcmp(data.first, input->second.data(), data.second * sizeof(ElemType)) != 0))
+                    return false;
+                input++;
+            }
+            auto output = m_outputs.begin();
+            for (const auto& iter : outputs)
+                if (iter.first != (output++)->first)
+                    return false;
+            return true;
+        }
+    };
+
+    // the two kinds of data that Evaluate() takes
+    static std::pair<const ElemType*, size_t> Data(const std::vector<ElemType>* v)
+    {
+        return std::make_pair(v->data(), v->size());
+    }
+    static std::pair<const ElemType*, size_t> Data(const EvalBuffer<ElemType>& buffer)
+    {
+        return std::make_pair((const ElemType*) buffer.m_buffer, buffer.m_size);
+    }
+    static void SetOutput(const std::wstring&, std::vector<ElemType>* v, const std::vector<ElemType>& value)
+    {
+        v->assign(value.begin(), value.end());
+    }
+    static void SetOutput(const std::wstring& name, EvalBuffer<ElemType>& buffer, const std::vector<ElemType>& value)
+    {
+        if (value.size() > buffer.m_size)
+            RuntimeError("Evaluate: The buffer for %ls holds %lu elements, but the output has %lu.", name.c_str(), buffer.m_size, value.size());
+        std::copy(value.begin(), value.end(), buffer.m_buffer);
+        buffer.m_size = value.size();
+    }
+
+    // FNV-1a
+    static void HashBytes(uint64_t& hash, const void* p, size_t numBytes)
+    {
+        const unsigned char* bytes = (const unsigned char*) p;
+        for (size_t i = 0; i < numBytes; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    template <class InputMap, class OutputMap>
+    static uint64_t Hash(const InputMap& inputs, const OutputMap& outputs)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (const auto& iter : inputs)
+        {
+            auto data = Data(iter.second);
+            HashBytes(hash, iter.first.data(), iter.first.size() * sizeof(wchar_t));
+            HashBytes(hash, &data.second, sizeof(data.second));
+            HashBytes(hash, data.first, data.second * sizeof(ElemType));
+        }
+        for (const auto& iter : outputs)
+            HashBytes(hash, iter.first.data(), (iter.first.size() + 1) * sizeof(wchar_t)); // (incl. the terminator, to separate the names)
+        return hash;
+    }
+
+    size_t m_capacity;
+    size_t m_logInterval;
+    bool m_enabled; // false for models with state that carries over from call to call
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_multimap<uint64_t, typename std::list<Entry>::iterator> m_index;
+    size_t m_numLookups;
+    size_t m_numHits;
+};
+} } }
@@ -19,6 +19,8 @@
 using namespace System;
 using namespace System::Collections::Generic;
 using namespace System::Collections;
+using namespace System::Runtime::InteropServices;
+using namespace System::Threading::Tasks;
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft {
@@ -36,21 +38,24 @@ template<typename ElemType>
 public ref class IEvaluateModelManaged : IDisposable
 {
     typedef std::pair<std::wstring, std::vector<ElemType>*> MapEntry;
+    typedef std::map<std::wstring, EvalBuffer<ElemType>> BufferMap;
 
 public:
     /// <summary>Initializes a new instance of the <see cref="IEvaluateModelManaged"> class.</summary>
     /// <param name="funcName">Factory function name for retrieving the native model from the dll.</param>
     IEvaluateModelManaged(String^ funcName)
+        : m_concurrent(false), m_evalLock(gcnew Object())
     {
-        pin_ptr<const WCHAR> dllname = PtrToStringChars("evaldll.dll");
-        auto hModule = LoadLibrary(dllname);
+        GetModel(funcName);
+    }
 
-        msclr::interop::marshal_context context;
-        const std::string func = context.marshal_as<std::string>(funcName);
-        auto procAddress = GetProcAddress(hModule, func.c_str());
-        auto getEvalProc = (GetEvalProc<ElemType>)procAddress;
-        pin_ptr <IEvaluateModel<ElemType>*> p_eval = &m_eval;
-        getEvalProc(p_eval);
+    /// <summary>Initializes a new instance of the <see cref="IEvaluateModelManaged"> class.</summary>
+    /// <param name="funcName">Factory function name for retrieving the native model from the dll.</param>
+    /// <param name="concurrent">Whether the native model may be evaluated from several threads at once (GetEvalBatching).</param>
+    IEvaluateModelManaged(String^ funcName, bool concurrent)
+        : m_concurrent(concurrent), m_evalLock(gcnew Object())
+    {
+        GetModel(funcName);
     }
 
     /// <summary>Initializes the model evaluation library with a CNTK configuration</summary>
@@ -161,6 +166,122 @@ public:
         return outputMap[outputKey];
     }
 
+    /// <summary>Evaluates the model on caller-owned arrays, without copying them</summary>
+    /// <remarks>The arrays are pinned for the duration of the call and bound to the network directly, so repeated calls
+    /// with arrays of the same sizes do not allocate native memory. Each input array holds the records of its node one
+    /// after the other; each output array must be large enough for the output of its node.</remarks>
+    /// <param name="inputs">Input node name to input data</param>
+    /// <param name="outputs">Output node name to preallocated output array</param>
+    /// <returns>Output node name to the number of elements written to its array</returns>
+    Dictionary<String^, int>^ Evaluate(Dictionary<String^, array<ElemType>^>^ inputs, Dictionary<String^, array<ElemType>^>^ outputs)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        List<GCHandle>^ pins = gcnew List<GCHandle>();
+        try
+        {
+            BufferMap stdInputs;
+            BufferMap stdOutputs;
+            PinArrays(inputs, stdInputs, pins);
+            PinArrays(outputs, stdOutputs, pins);
+
+            // the non-batching evaluator holds per-call state; callers of the same instance take turns
+            if (m_concurrent)
+            {
+                m_eval->Evaluate(stdInputs, stdOutputs);
+            }
+            else
+            {
+                Threading::Monitor::Enter(m_evalLock);
+                try
+                {
+                    m_eval->Evaluate(stdInputs, stdOutputs);
+                }
+                finally
+                {
+                    Threading::Monitor::Exit(m_evalLock);
+                }
+            }
+
+            Dictionary<String^, int>^ sizes = gcnew Dictionary<String^, int>();
+            for each (auto item in outputs)
+            {
+                pin_ptr<const WCHAR> key = PtrToStringChars(item.Key);
+                sizes->Add(item.Key, (int) stdOutputs[std::wstring(key)].m_size);
+            }
+            return sizes;
+        }
+        catch (const std::exception& e)
+        {
+            throw gcnew InvalidOperationException(gcnew String(e.what()));
+        }
+        finally
+        {
+            for each (GCHandle pin in pins)
+            {
+                pin.Free();
+            }
+        }
+    }
+
+    /// <summary>Allocates once all that Evaluate() on caller-owned arrays needs for the given outputs</summary>
+    /// <remarks>Afterwards, that Evaluate() must be called for exactly these outputs and at most maxNumRecords
+    /// records, and the native evaluator does not allocate memory in it.</remarks>
+    /// <param name="outputNodeNames">The output nodes that will be evaluated</param>
+    /// <param name="maxNumRecords">The largest number of records that will be passed</param>
+    void PrepareEvaluate(List<String^>^ outputNodeNames, int maxNumRecords)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        std::vector<std::wstring> stdOutputNodeNames;
+        for each (String^ name in outputNodeNames)
+        {
+            pin_ptr<const WCHAR> key = PtrToStringChars(name);
+            stdOutputNodeNames.push_back(std::wstring(key));
+        }
+
+        try
+        {
+            Threading::Monitor::Enter(m_evalLock);
+            try
+            {
+                m_eval->PrepareEvaluate(stdOutputNodeNames, (size_t) maxNumRecords);
+            }
+            finally
+            {
+                Threading::Monitor::Exit(m_evalLock);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw gcnew InvalidOperationException(gcnew String(e.what()));
+        }
+    }
+
+    /// <summary>Evaluates the model on caller-owned arrays on a thread-pool thread</summary>
+    /// <remarks>The arrays must not be touched until the task has completed. With an instance created for
+    /// batching, the requests of concurrent callers are evaluated together in one minibatch; otherwise they
+    /// are evaluated one after the other.</remarks>
+    /// <param name="inputs">Input node name to input data</param>
+    /// <param name="outputs">Output node name to preallocated output array</param>
+    /// <returns>A task yielding output node name to the number of elements written to its array</returns>
+    Task<Dictionary<String^, int>^>^ EvaluateAsync(Dictionary<String^, array<ElemType>^>^ inputs, Dictionary<String^, array<ElemType>^>^ outputs)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        EvaluateRequest^ request = gcnew EvaluateRequest(this, inputs, outputs);
+        return Task::Run(gcnew Func<Dictionary<String^, int>^>(request, &EvaluateRequest::Run));
+    }
+
     ~IEvaluateModelManaged()
     {
         if (m_eval == nullptr)
@@ -185,6 +306,73 @@ private:
     // Native model evaluation instance
     IEvaluateModel<ElemType> *m_eval;
 
+    // Whether m_eval may be called concurrently; if not, calls are serialized through m_evalLock
+    bool m_concurrent;
+    Object^ m_evalLock;
+
+    /// <summary>Retrieves the native model from the dll</summary>
+    /// <param name="funcName">Factory function name for retrieving the native model from the dll.</param>
+    void GetModel(String^ funcName)
+    {
+        pin_ptr<const WCHAR> dllname = PtrToStringChars("evaldll.dll");
+        auto hModule = LoadLibrary(dllname);
+
+        msclr::interop::marshal_context context;
+        const std::string func = context.marshal_as<std::string>(funcName);
+        auto procAddress = GetProcAddress(hModule, func.c_str());
+        auto getEvalProc = (GetEvalProc<ElemType>)procAddress;
+        pin_ptr <IEvaluateModel<ElemType>*> p_eval = &m_eval;
+        getEvalProc(p_eval);
+    }
+
+    /// <summary>The arguments of an EvaluateAsync() call, evaluated on a thread-pool thread</summary>
+    ref class EvaluateRequest
+    {
+    public:
+        EvaluateRequest(IEvaluateModelManaged^ model, Dictionary<String^, array<ElemType>^>^ inputs, Dictionary<String^, array<ElemType>^>^ outputs)
+            : m_model(model), m_inputs(inputs), m_outputs(outputs)
+        {
+        }
+
+        Dictionary<String^, int>^ Run()
+        {
+            return m_model->Evaluate(m_inputs, m_outputs);
+        }
+
+    private:
+        IEvaluateModelManaged^ m_model;
+        Dictionary<String^, array<ElemType>^>^ m_inputs;
+        Dictionary<String^, array<ElemType>^>^ m_outputs;
+    };
+
+    /// <summary>Pins each array and enters it into a native buffer map</summary>
+    /// <param name="arrays">The CLI arrays by node name</param>
+    /// <param name="buffers">The native buffer map to fill</param>
+    /// <param name="pins">Receives the handles of the pinned arrays, to be freed by the caller</param>
+    void PinArrays(Dictionary<String^, array<ElemType>^>^ arrays, BufferMap& buffers, List<GCHandle>^ pins)
+    {
+        if (arrays == nullptr)
+        {
+            return;
+        }
+
+        for each (auto item in arrays)
+        {
+            if (item.Value == nullptr)
+            {
+                throw gcnew ArgumentNullException(item.Key);
+            }
+
+            GCHandle pin = GCHandle::Alloc(item.Value, GCHandleType::Pinned);
+            pins->Add(pin);
+            pin_ptr<const WCHAR> key = PtrToStringChars(item.Key);
+            EvalBuffer<ElemType> buffer;
+            buffer.m_buffer = (ElemType*) pin.AddrOfPinnedObject().ToPointer();
+            buffer.m_size = item.Value->Length;
+            buffers[std::wstring(key)] = buffer;
+        }
+    }
+
     /// <summary>Copies a list of element types from a CLI structure to a native structure
     /// <param name="list">The CLI list of items</param>
     /// <returns>A native vector of items</returns>
@@ -211,6 +399,12 @@ public:
         : IEvaluateModelManaged("GetEvalF")
     {
     }
+
+    /// <param name="batching">Whether to evaluate the requests of concurrent callers together (GetEvalBatchingF)</param>
+    IEvaluateModelManagedF::IEvaluateModelManagedF(bool batching)
+        : IEvaluateModelManaged(batching ? "GetEvalBatchingF" : "GetEvalF", batching)
+    {
+    }
 };
 
 /// <summary>Managed double-specific model evaluation class</summary>
@@ -222,6 +416,12 @@ public:
         : IEvaluateModelManaged("GetEvalD")
     {
     }
+
+    /// <param name="batching">Whether to evaluate the requests of concurrent callers together (GetEvalBatchingD)</param>
+    IEvaluateModelManagedD::IEvaluateModelManagedD(bool batching)
+        : IEvaluateModelManaged(batching ? "GetEvalBatchingD" : "GetEvalD", batching)
+    {
+    }
 };
 
 // This method tricks the compiler into emitting the methods of the classes
@@ -231,14 +431,18 @@ void emit()
 {
     IEvaluateModelManagedF f;
     f.Init("");
-    f.Evaluate(nullptr, nullptr);
+    f.Evaluate((Dictionary<String^, List<float>^>^) nullptr, (Dictionary<String^, List<float>^>^) nullptr);
     f.Evaluate(nullptr, "", 0);
+    f.Evaluate((Dictionary<String^, array<float>^>^) nullptr, (Dictionary<String^, array<float>^>^) nullptr);
+    f.EvaluateAsync(nullptr, nullptr);
     f.LoadModel("");
 
     IEvaluateModelManagedD d;
     d.Init("");
-    d.Evaluate(nullptr, nullptr);
+    d.Evaluate((Dictionary<String^, List<double>^>^) nullptr, (Dictionary<String^, List<double>^>^) nullptr);
     d.Evaluate(nullptr, "", 0);
+    d.Evaluate((Dictionary<String^, array<double>^>^) nullptr, (Dictionary<String^, array<double>^>^) nullptr);
+    d.EvaluateAsync(nullptr, nullptr);
     d.LoadModel("");
 }
 }
@@ -0,0 +1,146 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncLog.cpp -- progress output written by a background thread
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "AsyncLog.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct AsyncLogRecord
+{
+    FILE* m_stream;
+    std::string m_text;
+};
+
+// (never destroyed: the writer thread runs until the process ends)
+struct AsyncLogState
+{
+    std::mutex m_mutex;
+    std::condition_variable m_recordsQueued;
+    std::condition_variable m_recordsWritten;
+    std::vector<AsyncLogRecord> m_queue;
+    size_t m_numQueued;  // records ever queued
+    size_t m_numWritten; // records ever written and flushed
+
+    AsyncLogState()
+        : m_numQueued(0), m_numWritten(0)
+    {
+    }
+};
+
+static std::once_flag s_startOnce;
+static AsyncLogState* s_state = nullptr;
+static std::atomic<bool> s_started(false);
+
+static void WriteRecords(AsyncLogState& state)
+{
+    std::vector<AsyncLogRecord> records;
+    std::vector<FILE*> streams;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(state.m_mutex);
+            state.m_recordsQueued.wait(lock, [&state]()
+                                       {
+                                           return !state.m_queue.empty();
+                                       });
+            records.swap(state.m_queue); // (m_queue gets the previous batch's capacity)
+        }
+        streams.clear();
+        for (const auto& record : records)
+        {
+            fwrite(record.m_text.data(), 1, record.m_text.size(), record.m_stream);
+            if (std::find(streams.begin(), streams.end(), record.m_stream) == streams.end())
+                streams.push_back(record.m_stream);
+        }
+        for (auto stream : streams)
+            fflush(stream);
+        {
+            std::lock_guard<std::mutex> lock(state.m_mutex);
+            state.m_numWritten += records.size();
+        }
+        state.m_recordsWritten.notify_all();
+        records.clear();
+    }
+}
+
+/*static*/ void AsyncLog::Start()
+{
+    std::call_once(s_startOnce, []()
+                   {
+                       s_state = new AsyncLogState();
+                       std::thread(WriteRecords, std::ref(*s_state)).detach();
+                       s_started = true;
+                       atexit(&AsyncLog::Flush);
+                   });
+}
+
+/*static*/ bool AsyncLog::IsStarted()
+{
+    return s_started;
+}
+
+/*static*/ int AsyncLog::Write(FILE* stream, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = VWrite(stream, format, args);
+    va_end(args);
+    return result;
+}
+
+/*static*/ int AsyncLog::VWrite(FILE* stream, const char* format, va_list args)
+{
+    if (!s_started)
+        return vfprintf(stream, format, args);
+
+    AsyncLogRecord record;
+    record.m_stream = stream;
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+#ifdef _MSC_VER
+    int n = _vscprintf(format, argsCopy); // (VS2013's vsnprintf() returns -1 if the buffer is too small)
+#else
+    int n = vsnprintf(nullptr, 0, format, argsCopy);
+#endif
+    va_end(argsCopy);
+    if (n <= 0)
+        return n;
+    record.m_text.resize(n + 1); // (incl. '\0')
+    vsnprintf(&record.m_text[0], record.m_text.size(), format, args);
+    record.m_text.resize(n);
+
+    {
+        std::lock_guard<std::mutex> lock(s_state->m_mutex);
+        s_state->m_queue.push_back(std::move(record));
+        s_state->m_numQueued++;
+    }
+    s_state->m_recordsQueued.notify_one();
+    return n;
+}
+
+/*static*/ void AsyncLog::Flush()
+{
+    if (!s_started)
+        return;
+    std::unique_lock<std::mutex> lock(s_state->m_mutex);
+    size_t numQueued = s_state->m_numQueued;
+    s_state->m_recordsWritten.wait(lock, [numQueued]()
+                                   {
+                                       return s_state->m_numWritten >= numQueued;
+                                   });
+}
+} } }
@@ -0,0 +1,38 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncLog.h -- progress output written by a background thread (SGD's 'asyncProgressLog')
+//
+// Writing and flushing the log on the training thread costs milliseconds per line when the log is on a network share.
+// Once started, Write() only formats the text and appends a record (stream, text) to a queue, under a lock that is held
+// just for the append; a writer thread takes the queued records all at once, writes them in order, and flushes each
+// stream it wrote to. Until then, and in processes that never start it, Write() is a plain vfprintf().
+//
+// Output that is written directly to the same stream may appear ahead of lines still in the queue; Flush() waits until
+// the queue has been written, and is called where the order matters (e.g. at the end of an epoch, and at exit).
+//
+
+#pragma once
+
+#include "MemAllocator.h" // for MATH_API
+#include <cstdarg>
+#include <cstdio>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API AsyncLog
+{
+public:
+    // start the writer thread; from now on, Write() queues
+    static void Start();
+    static bool IsStarted();
+
+    // returns the number of characters, as printf() does
+    static int Write(FILE* stream, const char* format, ...);
+    static int VWrite(FILE* stream, const char* format, va_list args);
+
+    // wait until all that was queued so far is written and flushed
+    static void Flush();
+};
+} } }
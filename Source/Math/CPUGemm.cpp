@@ -0,0 +1,435 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUGemm.cpp -- runtime-selectable GEMM backends for CPUMatrix (see CPUGemm.h)
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "CPUGemm.h"
+#include <omp.h>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <float.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#else
+#include <dlfcn.h>
+#endif
+
+#ifndef USE_MKL
+#include <acml.h> // requires ACML 5.3.1 and above
+#else
+#include <mkl.h> // requires MKL 10.0 and above
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+enum GemmBackend
+{
+    gemmVendor,   // whatever we are linked against (ACML or MKL)
+    gemmOpenBLAS, // OpenBLAS, loaded at runtime
+    gemmBuiltin,  // our own blocked kernel
+    gemmNumBackends,
+    gemmAuto = gemmNumBackends // pick per shape class
+};
+
+static const char* BackendName(int backend)
+{
+    switch (backend)
+    {
+#ifndef USE_MKL
+    case gemmVendor:   return "acml";
+#else
+    case gemmVendor:   return "mkl";
+#endif
+    case gemmOpenBLAS: return "openblas";
+    case gemmBuiltin:  return "builtin";
+    case gemmAuto:     return "auto";
+    default:           return "?";
+    }
+}
+
+// -----------------------------------------------------------------------
+// vendor BLAS (the library we are linked against)
+// -----------------------------------------------------------------------
+
+static void VendorGemm(bool transA, bool transB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc)
+{
+#ifndef USE_MKL
+    sgemm(transA ? 'T' : 'N', transB ? 'T' : 'N', m, n, k, alpha, const_cast<float*>(a), lda, const_cast<float*>(b), ldb, beta, c, ldc);
+#else
+    cblas_sgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+#endif
+}
+
+static void VendorGemm(bool transA, bool transB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc)
+{
+#ifndef USE_MKL
+    dgemm(transA ? 'T' : 'N', transB ? 'T' : 'N', m, n, k, alpha, const_cast<double*>(a), lda, const_cast<double*>(b), ldb, beta, c, ldc);
+#else
+    cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+#endif
+}
+
+// -----------------------------------------------------------------------
+// OpenBLAS, found at runtime through its CBLAS entry points
+// -----------------------------------------------------------------------
+
+class OpenBLASLibrary
+{
+    // CBLAS enum values, to not depend on cblas.h
+    enum { CblasColMajorValue = 102, CblasNoTransValue = 111, CblasTransValue = 112 };
+    typedef void (*SGemmFunction)(int, int, int, int, int, int, float, const float*, int, const float*, int, float, float*, int);
+    typedef void (*DGemmFunction)(int, int, int, int, int, int, double, const double*, int, const double*, int, double, double*, int);
+
+    SGemmFunction m_sgemm;
+    DGemmFunction m_dgemm;
+
+    OpenBLASLibrary()
+        : m_sgemm(nullptr), m_dgemm(nullptr)
+    {
+        // we never unload it; there is only one, and it lives as long as the process
+#ifdef _WIN32
+        for (const wchar_t* name : {L"libopenblas.dll", L"openblas.dll"})
+        {
+            HMODULE module = LoadLibraryW(name);
+            if (module)
+            {
+                m_sgemm = (SGemmFunction) GetProcAddress(module, "cblas_sgemm");
+                m_dgemm = (DGemmFunction) GetProcAddress(module, "cblas_dgemm");
+                break;
+            }
+        }
+#else
+        for (const char* name : {"libopenblas.so.0", "libopenblas.so"})
+        {
+            void* handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+            if (handle)
+            {
+                m_sgemm = (SGemmFunction) dlsym(handle, "cblas_sgemm");
+                m_dgemm = (DGemmFunction) dlsym(handle, "cblas_dgemm");
+                break;
+            }
+        }
+#endif
+        if (!m_sgemm || !m_dgemm)
+            m_sgemm = nullptr, m_dgemm = nullptr;
+    }
+
+public:
+    static const OpenBLASLibrary& Get()
+    {
+        static once_flag initialized;
+        static OpenBLASLibrary* library;
+        call_once(initialized, []() { library = new OpenBLASLibrary(); });
+        return *library;
+    }
+
+    bool IsAvailable() const { return m_sgemm != nullptr; }
+
+    void Gemm(bool transA, bool transB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc) const
+    {
+        m_sgemm(CblasColMajorValue, transA ? CblasTransValue : CblasNoTransValue, transB ? CblasTransValue : CblasNoTransValue, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+    void Gemm(bool transA, bool transB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc) const
+    {
+        m_dgemm(CblasColMajorValue, transA ? CblasTransValue : CblasNoTransValue, transB ? CblasTransValue : CblasNoTransValue, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+};
+
+// -----------------------------------------------------------------------
+// built-in GEMM
+//
+// Classic three-level blocking: k is cut into KC-deep slices; for each, B is packed into zero-padded NR-column
+// slivers and A into MC x KC blocks of MR-row slivers, such that the MR x NR micro-kernel streams both operands
+// contiguously, keeps its accumulators in registers, and needs no edge cases. The micro-kernel is plain C++ that
+// the compiler vectorizes along MR. Threads work on independent (MC x NCB) tiles of c.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class BuiltinGemm
+{
+    static const int MR = 8;    // micro-tile rows (one or two SIMD registers)
+    static const int NR = 4;    // micro-tile columns
+    static const int MC = 128;  // rows of A per packed block (MC x KC is sized for L2)
+    static const int KC = 256;  // depth of a slice (an MR x KC and a KC x NR sliver fit into L1)
+    static const int NCB = 256; // columns of c per parallel tile
+
+    static void MicroKernel(int kc, const ElemType* pa, const ElemType* pb, ElemType alpha, ElemType* c, int ldc, int mr, int nr)
+    {
+        ElemType acc[NR][MR] = {};
+        for (int p = 0; p < kc; p++, pa += MR, pb += NR)
+            for (int j = 0; j < NR; j++)
+                for (int i = 0; i < MR; i++)
+                    acc[j][i] += pa[i] * pb[j];
+        for (int j = 0; j < nr; j++)
+            for (int i = 0; i < mr; i++)
+                c[i + (size_t) j * ldc] += alpha * acc[j][i];
+    }
+
+public:
+    static void Run(bool transA, bool transB, int m, int n, int k, ElemType alpha, const ElemType* a, int lda, const ElemType* b, int ldb, ElemType beta, ElemType* c, int ldc)
+    {
+        // c = beta * c  (without reading c if beta == 0, as BLAS does)
+        if (beta != 1)
+        {
+#pragma omp parallel for
+            for (int j = 0; j < n; j++)
+            {
+                ElemType* cj = c + (size_t) j * ldc;
+                for (int i = 0; i < m; i++)
+                    cj[i] = beta == 0 ? 0 : beta * cj[i];
+            }
+        }
+        if (k == 0 || alpha == 0)
+            return;
+
+        const int numBSlivers = (n + NR - 1) / NR;
+        const int numRowBlocks = (m + MC - 1) / MC;
+        const int numColBlocks = (n + NCB - 1) / NCB;
+        vector<ElemType> packedB((size_t) numBSlivers * NR * KC);
+        for (int pc = 0; pc < k; pc += KC)
+        {
+            const int kc = min(KC, k - pc);
+
+            // pack B[pc:pc+kc, :]
+#pragma omp parallel for
+            for (int js = 0; js < numBSlivers; js++)
+            {
+                ElemType* pb = &packedB[(size_t) js * NR * kc];
+                for (int p = 0; p < kc; p++)
+                    for (int j = 0; j < NR; j++)
+                    {
+                        const int col = js * NR + j;
+                        const int row = pc + p;
+                        pb[p * NR + j] = col >= n ? 0 : transB ? b[col + (size_t) row * ldb] : b[row + (size_t) col * ldb];
+                    }
+            }
+
+            // compute the tiles of c
+#pragma omp parallel for schedule(dynamic)
+            for (int tile = 0; tile < numRowBlocks * numColBlocks; tile++)
+            {
+                const int i0 = (tile / numColBlocks) * MC;
+                const int j0 = (tile % numColBlocks) * NCB;
+                const int mc = min(MC, m - i0);
+                const int nc = min(NCB, n - j0);
+                const int numASlivers = (mc + MR - 1) / MR;
+
+                // pack A[i0:i0+mc, pc:pc+kc]
+                vector<ElemType> packedA((size_t) numASlivers * MR * kc);
+                for (int is = 0; is < numASlivers; is++)
+                {
+                    ElemType* pa = &packedA[(size_t) is * MR * kc];
+                    for (int p = 0; p < kc; p++)
+                        for (int i = 0; i < MR; i++)
+                        {
+                            const int row = i0 + is * MR + i;
+                            const int col = pc + p;
+                            pa[p * MR + i] = row >= m ? 0 : transA ? a[col + (size_t) row * lda] : a[row + (size_t) col * lda];
+                        }
+                }
+
+                for (int jj = 0; jj < nc; jj += NR)
+                {
+                    const ElemType* pb = &packedB[(size_t)((j0 + jj) / NR) * NR * kc];
+                    for (int is = 0; is < numASlivers; is++)
+                    {
+                        const int ii = is * MR;
+                        MicroKernel(kc, &packedA[(size_t) is * MR * kc], pb, alpha, c + (i0 + ii) + (size_t)(j0 + jj) * ldc, ldc, min(MR, mc - ii), min(NR, nc - jj));
+                    }
+                }
+            }
+        }
+    }
+};
+
+// -----------------------------------------------------------------------
+// dispatch, autotuning, and statistics
+// -----------------------------------------------------------------------
+
+static atomic<int> s_backend(gemmVendor);
+
+static bool IsBackendAvailable(int backend)
+{
+    return backend != gemmOpenBLAS || OpenBLASLibrary::Get().IsAvailable();
+}
+
+template <class ElemType>
+static void RunBackend(int backend, bool transA, bool transB, int m, int n, int k, ElemType alpha, const ElemType* a, int lda, const ElemType* b, int ldb, ElemType beta, ElemType* c, int ldc)
+{
+    switch (backend)
+    {
+    case gemmVendor:   VendorGemm(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc); break;
+    case gemmOpenBLAS: OpenBLASLibrary::Get().Gemm(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc); break;
+    case gemmBuiltin:  BuiltinGemm<ElemType>::Run(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc); break;
+    default:           LogicError("CPUGemm: invalid backend %d.", backend);
+    }
+}
+
+// per-call statistics, per element type and backend
+struct GemmStatistics
+{
+    atomic<unsigned long long> m_numCalls;
+    atomic<unsigned long long> m_nanoseconds;
+    atomic<unsigned long long> m_flops;
+};
+static GemmStatistics s_statistics[2][gemmNumBackends]; // [isDouble][backend]; static, hence zero-initialized
+
+// Shape classes for autotuning: each of m, n, k falls into one of 4 size ranges, and there are 4 transpose
+// combinations. An entry is 1 + the chosen backend, or 0 if that class has not been tuned yet.
+static const int numSizeRanges = 4;
+static atomic<int> s_tunedBackend[2][4][numSizeRanges * numSizeRanges * numSizeRanges];
+static mutex s_tuningMutex;
+
+static int SizeRange(int d)
+{
+    return d <= 16 ? 0 : d <= 128 ? 1 : d <= 1024 ? 2 : 3;
+}
+
+// time the available backends on scratch matrices of the given shape, and return the fastest
+// Dimensions are capped so that tuning for a huge product does not itself take long.
+template <class ElemType>
+static int Autotune(bool transA, bool transB, int m, int n, int k)
+{
+    m = min(m, 2048), n = min(n, 2048), k = min(k, 2048);
+    vector<ElemType> a((size_t) m * k, (ElemType) 0.01), b((size_t) k * n, (ElemType) 0.01), c((size_t) m * n);
+    const int lda = transA ? k : m;
+    const int ldb = transB ? n : k;
+
+    int bestBackend = gemmVendor;
+    double bestTime = DBL_MAX;
+    for (int backend = 0; backend < gemmNumBackends; backend++)
+    {
+        if (!IsBackendAvailable(backend))
+            continue;
+        RunBackend<ElemType>(backend, transA, transB, m, n, k, 1, a.data(), lda, b.data(), ldb, 0, c.data(), m); // warm up (threads, caches, lazy init)
+        auto start = chrono::high_resolution_clock::now();
+        double elapsed;
+        int reps = 0;
+        do
+        {
+            RunBackend<ElemType>(backend, transA, transB, m, n, k, 1, a.data(), lda, b.data(), ldb, 0, c.data(), m);
+            reps++;
+            elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        } while (elapsed < 2e-3 && reps < 20);
+        if (elapsed / reps < bestTime)
+        {
+            bestTime = elapsed / reps;
+            bestBackend = backend;
+        }
+    }
+    fprintf(stderr, "CPUGemm: using %s for %s products of shape class [%d x %d] * [%d x %d]%s%s (%.1f GFlop/s)\n",
+            BackendName(bestBackend), sizeof(ElemType) == sizeof(double) ? "double" : "float", m, k, k, n,
+            transA ? ", A transposed" : "", transB ? ", B transposed" : "", 2.0 * m * n * k / bestTime * 1e-9);
+    return bestBackend;
+}
+
+template <class ElemType>
+static int SelectBackend(bool transA, bool transB, int m, int n, int k)
+{
+    int backend = s_backend;
+    if (backend != gemmAuto)
+        return backend;
+    atomic<int>& tuned = s_tunedBackend[sizeof(ElemType) == sizeof(double)][transA * 2 + transB][(SizeRange(m) * numSizeRanges + SizeRange(n)) * numSizeRanges + SizeRange(k)];
+    int entry = tuned;
+    if (entry == 0)
+    {
+        lock_guard<mutex> lock(s_tuningMutex);
+        entry = tuned;
+        if (entry == 0) // (another thread may have beaten us to it)
+            tuned = entry = 1 + Autotune<ElemType>(transA, transB, m, n, k);
+    }
+    return entry - 1;
+}
+
+template <class ElemType>
+/*static*/ void CPUGemm::Gemm(bool transA, bool transB, int m, int n, int k, ElemType alpha, const ElemType* a, int lda, const ElemType* b, int ldb, ElemType beta, ElemType* c, int ldc)
+{
+    int backend = SelectBackend<ElemType>(transA, transB, m, n, k);
+
+    auto start = chrono::high_resolution_clock::now();
+    RunBackend(backend, transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    auto nanoseconds = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+
+    GemmStatistics& statistics = s_statistics[sizeof(ElemType) == sizeof(double)][backend];
+    statistics.m_numCalls++;
+    statistics.m_nanoseconds += (unsigned long long) nanoseconds;
+    statistics.m_flops += 2ull * m * n * k;
+}
+
+/*static*/ void CPUGemm::SetBackend(const string& name)
+{
+    for (int backend = 0; backend <= gemmAuto; backend++)
+    {
+        if (name != BackendName(backend) && !(backend == gemmVendor && name == "default"))
+            continue;
+        if (!IsBackendAvailable(backend))
+            RuntimeError("CPUGemm: GEMM backend '%s' is not available on this machine; available are: %s", name.c_str(), GetAvailableBackends().c_str());
+        s_backend = backend;
+        return;
+    }
+    InvalidArgument("CPUGemm: unknown GEMM backend '%s'; available are: %s", name.c_str(), GetAvailableBackends().c_str());
+}
+
+/*static*/ string CPUGemm::GetBackendName()
+{
+    return BackendName(s_backend);
+}
+
+/*static*/ string CPUGemm::GetAvailableBackends()
+{
+    string names;
+    for (int backend = 0; backend <= gemmAuto; backend++)
+    {
+        if (!IsBackendAvailable(backend))
+            continue;
+        if (!names.empty())
+            names += ", ";
+        names += BackendName(backend);
+    }
+    return names;
+}
+
+/*static*/ void CPUGemm::PrintStatistics(FILE* f)
+{
+    for (int isDouble = 0; isDouble < 2; isDouble++)
+    {
+        for (int backend = 0; backend < gemmNumBackends; backend++)
+        {
+            const GemmStatistics& statistics = s_statistics[isDouble][backend];
+            unsigned long long numCalls = statistics.m_numCalls;
+            if (numCalls == 0)
+                continue;
+            double seconds = statistics.m_nanoseconds * 1e-9;
+            fprintf(f, "CPUGemm<%s> %s: %llu calls, %.3f seconds total, %.1f microseconds per call, %.2f GFlop/s\n",
+                    isDouble ? "double" : "float", BackendName(backend), numCalls, seconds, seconds / numCalls * 1e6,
+                    seconds > 0 ? statistics.m_flops / seconds * 1e-9 : 0.0);
+        }
+    }
+}
+
+/*static*/ void CPUGemm::ResetStatistics()
+{
+    for (auto& statisticsPerType : s_statistics)
+    {
+        for (auto& statistics : statisticsPerType)
+        {
+            statistics.m_numCalls = 0;
+            statistics.m_nanoseconds = 0;
+            statistics.m_flops = 0;
+        }
+    }
+}
+
+template void CPUGemm::Gemm<float>(bool transA, bool transB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc);
+template void CPUGemm::Gemm<double>(bool transA, bool transB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc);
+} } }
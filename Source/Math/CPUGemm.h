@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUGemm.h -- runtime-selectable GEMM backends for CPUMatrix
+//
+// CPUMatrix::MultiplyAndWeightedAdd() routes all dense products through CPUGemm::Gemm(), which dispatches to one of
+//  - "acml" or "mkl": the BLAS library this binary was built against (the default)
+//  - "openblas":      OpenBLAS, loaded at runtime if libopenblas can be found (no build or link dependency)
+//  - "builtin":       a portable cache-blocked kernel that needs no BLAS library at all
+//  - "auto":          times the available backends the first time a shape class is seen, and uses the fastest for it
+// The choice is made at startup through the 'cpuGemmBackend' config parameter, so that one binary can use whatever
+// is fastest on the machine it happens to run on.
+//
+// Every call is timed per backend, so that the time spent in GEMM can be compared against the rest (PrintStatistics()).
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include <string>
+#include <stdio.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CPUGemm
+{
+public:
+    // select the backend by name (see above); throws if the backend is unknown or not available on this machine
+    static void SetBackend(const std::string& name);
+    static std::string GetBackendName();
+    // names of the backends that can be used on this machine
+    static std::string GetAvailableBackends();
+
+    // c = alpha * op(a) * op(b) + beta * c, all column-major; op(a) is m x k, op(b) is k x n  (c is not read if beta == 0)
+    template <class ElemType>
+    static void Gemm(bool transA, bool transB, int m, int n, int k, ElemType alpha, const ElemType* a, int lda, const ElemType* b, int ldb, ElemType beta, ElemType* c, int ldc);
+
+    // number of calls, time, and GFlop/s per backend since the last reset
+    static void PrintStatistics(FILE* f = stderr);
+    static void ResetStatistics();
+};
+} } }
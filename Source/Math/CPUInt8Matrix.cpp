@@ -0,0 +1,103 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUInt8Matrix.cpp -- int8-quantized weight matrix for CPU inference (see CPUInt8Matrix.h)
+//
+
+#include "stdafx.h"
+#include "CPUInt8Matrix.h"
+#include "CPUSIMDKernels.h"
+#include <omp.h>
+#include <math.h>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+/*static*/ float CPUInt8Matrix<ElemType>::Quantize(const ElemType* values, size_t stride, size_t n, signed char* quantized)
+{
+    float maxAbs = 0;
+    for (size_t i = 0; i < n; i++)
+        maxAbs = std::max(maxAbs, fabsf((float) values[i * stride]));
+    if (maxAbs == 0)
+    {
+        std::fill(quantized, quantized + n, (signed char) 0);
+        return 0;
+    }
+    const float invScale = 127 / maxAbs;
+    for (size_t i = 0; i < n; i++)
+        quantized[i] = (signed char) lrintf((float) values[i * stride] * invScale); // (within [-127, 127] by construction)
+    return maxAbs / 127;
+}
+
+template <class ElemType>
+CPUInt8Matrix<ElemType>::CPUInt8Matrix(const ElemType* a, size_t rows, size_t cols, bool transpose)
+    : m_numRows(transpose ? cols : rows),
+      m_numCols(transpose ? rows : cols),
+      m_rowStride((m_numCols + rowAlignment - 1) / rowAlignment * rowAlignment),
+      m_values(m_numRows * m_rowStride, 0),
+      m_scales(m_numRows)
+{
+#pragma omp parallel for
+    for (long i = 0; i < (long) m_numRows; i++)
+    {
+        // op(a)[i, p] is a[i + p * rows], or a[p + i * rows] if transposed
+        if (transpose)
+            m_scales[i] = Quantize(a + i * rows, 1, m_numCols, &m_values[i * m_rowStride]);
+        else
+            m_scales[i] = Quantize(a + i, rows, m_numCols, &m_values[i * m_rowStride]);
+    }
+}
+
+template <class ElemType>
+void CPUInt8Matrix<ElemType>::Multiply(const ElemType* b, size_t n, ElemType* c) const
+{
+    if (n == 0 || m_numRows == 0)
+        return;
+    const size_t m = m_numRows;
+    const size_t k = m_numCols;
+
+    // quantize the columns of b, each with its own scale, since activations can differ a lot between samples
+    std::vector<signed char> bValues(n * m_rowStride, 0);
+    std::vector<float> bScales(n);
+#pragma omp parallel for
+    for (long j = 0; j < (long) n; j++)
+        bScales[j] = Quantize(b + j * k, 1, k, &bValues[j * m_rowStride]);
+
+    // Work on blocks of rows x columns, such that the weight rows and activation columns of a block stay in cache.
+    const size_t rowBlock = 64;
+    const size_t colBlock = 32;
+    const long numRowBlocks = (long) ((m + rowBlock - 1) / rowBlock);
+#pragma omp parallel for
+    for (long rb = 0; rb < numRowBlocks; rb++)
+    {
+        int dots[colBlock];
+        const size_t iEnd = std::min(m, (rb + 1) * rowBlock);
+        for (size_t j0 = 0; j0 < n; j0 += colBlock)
+        {
+            const size_t nc = std::min(colBlock, n - j0);
+            const signed char* bBlock = &bValues[j0 * m_rowStride];
+            for (size_t i = rb * rowBlock; i < iEnd; i++)
+            {
+                const signed char* row = &m_values[i * m_rowStride];
+                if (!CPUSIMDKernels::TryInt8DotProducts(row, bBlock, m_rowStride, nc, m_rowStride, dots))
+                {
+                    for (size_t j = 0; j < nc; j++)
+                    {
+                        int dot = 0;
+                        for (size_t p = 0; p < k; p++)
+                            dot += row[p] * bBlock[j * m_rowStride + p];
+                        dots[j] = dot;
+                    }
+                }
+                for (size_t j = 0; j < nc; j++)
+                    c[i + (j0 + j) * m] = (ElemType)(dots[j] * m_scales[i] * bScales[j0 + j]);
+            }
+        }
+    }
+}
+
+template class CPUInt8Matrix<float>;
+template class CPUInt8Matrix<double>;
+} } }
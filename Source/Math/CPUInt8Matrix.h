@@ -0,0 +1,57 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUInt8Matrix.h -- a weight matrix quantized to int8, for CPU inference with quantized GEMMs
+//
+// Row i of the matrix is stored as int8 values q[i, :] and one scale s[i], such that a[i, :] ~= s[i] * q[i, :],
+// with s[i] = max |a[i, :]| / 127 (symmetric, so that zero stays exact). Multiply() quantizes the columns of its
+// right operand the same way on the fly, computes the products in int32, and scales the result back.
+// Compared to ColumnQuantizer, which packs a few bits per value for gradient exchange, the values here are whole
+// bytes laid out such that the dot products can run directly on the quantized data.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include <vector>
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class MATH_API CPUInt8Matrix
+{
+public:
+    // quantize the column-major [rows x cols] matrix 'a', or its transpose if 'transpose'
+    CPUInt8Matrix(const ElemType* a, size_t rows, size_t cols, bool transpose);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+
+    // c = this * b, with b [GetNumCols() x n] and c [GetNumRows() x n], both dense and column-major
+    void Multiply(const ElemType* b, size_t n, ElemType* c) const;
+
+private:
+    // rows are zero-padded to a multiple of this, for the SIMD dot products
+    static const size_t rowAlignment = 32;
+
+    // quantize 'n' values to int8 with a symmetric range, and return the scale
+    static float Quantize(const ElemType* values, size_t stride, size_t n, signed char* quantized);
+
+    size_t m_numRows;
+    size_t m_numCols;
+    size_t m_rowStride;                // m_numCols rounded up to rowAlignment
+    std::vector<signed char> m_values; // row-major [m_numRows x m_rowStride]
+    std::vector<float> m_scales;       // [m_numRows]
+};
+} } }
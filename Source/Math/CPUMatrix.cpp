@@ -10,6 +10,9 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPUSIMDKernels.h"
+#include "CPUGemm.h"
+#include "TaskPool.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -139,10 +142,25 @@ CPUMatrix<ElemType>::CPUMatrix(FILE* f, const char* matrixName)
 
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
+// Large arrays are zeroed by the OpenMP threads, each its contiguous share, as the 'omp parallel for' loops below
+// partition them. The OS places a page on the NUMA node of the thread that touches it first, so on multi-socket
+// machines each thread then mostly works on local memory (given threads stay put, e.g. OMP_PROC_BIND=true).
 template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
-    ElemType* p = new ElemType[n]();
+    ElemType* p;
+    if (n * sizeof(ElemType) < 4 * 1024 * 1024)
+        p = new ElemType[n]();
+    else
+    {
+        p = new ElemType[n];
+#pragma omp parallel
+        {
+            size_t numThreads = omp_get_num_threads(), thread = omp_get_thread_num();
+            size_t begin = n * thread / numThreads, end = n * (thread + 1) / numThreads;
+            memset(p + begin, 0, sizeof(ElemType) * (end - begin));
+        }
+    }
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
         for (size_t i = 0; i < n; i++)
@@ -639,6 +657,116 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddFoldedPositiveAndShiftedNegSample(c
     NOT_IMPLEMENTED;
 }
 
+// this(:,j) = beta * this(:,j) + alpha * a(:,idx[j]); negative indices add nothing
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumElements() != GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoGatherColumnsOf: Output dimensions [%d x %d] do not match the index (%d elements) or the input [%d x %d].",
+                        (int) GetNumRows(), (int) GetNumCols(), (int) idx.GetNumElements(), (int) a.GetNumRows(), (int) a.GetNumCols());
+    for (size_t j = 0; j < idx.GetNumElements(); j++)
+        if (idx.m_pArray[j] >= (ElemType) a.GetNumCols())
+            InvalidArgument("DoGatherColumnsOf: Index %d is out of range [0, %d).", (int) idx.m_pArray[j], (int) a.GetNumCols());
+
+    auto& us = *this;
+    long n = (long) GetNumCols(), m = (long) GetNumRows();
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        long ja = (long) idx.m_pArray[j];
+        for (long i = 0; i < m; i++)
+        {
+            ElemType v = (beta == 0) ? 0 : beta * us(i, j); // (beta == 0 overwrites, also uninitialized values)
+            us(i, j) = (ja < 0) ? v : v + alpha * a(i, ja);
+        }
+    }
+
+    return *this;
+}
+
+// this = beta * this; this(:,idx[j]) += alpha * a(:,j); repeated indices are summed, negative ones skipped
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumElements() != a.GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: Input dimensions [%d x %d] do not match the index (%d elements) or the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) idx.GetNumElements(), (int) GetNumRows(), (int) GetNumCols());
+    for (size_t j = 0; j < idx.GetNumElements(); j++)
+        if (idx.m_pArray[j] >= (ElemType) GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Index %d is out of range [0, %d).", (int) idx.m_pArray[j], (int) GetNumCols());
+
+    if (beta == 0)
+        SetValue(0);
+    else if (beta != 1)
+        Scale(beta, *this);
+
+    auto& us = *this;
+    long n = (long) a.GetNumCols(), m = (long) GetNumRows();
+
+    // serial over j since indices may repeat; the rows of one column are contiguous
+    for (long j = 0; j < n; j++)
+    {
+        long jus = (long) idx.m_pArray[j];
+        if (jus < 0)
+            continue;
+        for (long i = 0; i < m; i++)
+            us(i, jus) += alpha * a(i, j);
+    }
+
+    return *this;
+}
+
+// this = beta * this + a .* mask, with the mask drawn per element by PhiloxUniform(seed, counterOffset + k), see Matrix::DoDropoutOf()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoDropoutOf(ElemType beta, const CPUMatrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset)
+{
+    if (a.GetNumRows() != GetNumRows() || a.GetNumCols() != GetNumCols())
+        InvalidArgument("DoDropoutOf: The input dimensions [%d x %d] do not match the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) GetNumRows(), (int) GetNumCols());
+
+    auto& us = *this;
+    long n = (long) GetNumCols(), m = (long) GetNumRows();
+    const float rate = (float) dropoutRate;
+    const ElemType scale = (ElemType) (1 / (1 - dropoutRate));
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        for (long i = 0; i < m; i++)
+        {
+            ElemType v = (beta == 0) ? 0 : beta * us(i, j); // (beta == 0 overwrites, also uninitialized values)
+            if (PhiloxUniform(seed, counterOffset + (size_t) j * m + i) >= rate)
+                v += scale * a(i, j);
+            us(i, j) = v;
+        }
+    }
+
+    return *this;
+}
+
+// this(k,h) = FeatureHash(ids[k], h) % numBuckets, or -1 for negative ids, see Matrix::AssignHashedIndicesOf()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignHashedIndicesOf(const CPUMatrix<ElemType>& ids, size_t numBuckets, size_t numHashes)
+{
+    if (numBuckets == 0 || (size_t) (ElemType) (numBuckets - 1) != numBuckets - 1 || (unsigned int) numBuckets != numBuckets)
+        InvalidArgument("AssignHashedIndicesOf: %d buckets cannot be indexed exactly in this precision.", (int) numBuckets);
+
+    const long n = (long) ids.GetNumElements();
+    Resize(n, numHashes);
+    auto& us = *this;
+
+#pragma omp parallel for
+    for (long k = 0; k < n; k++)
+    {
+        ElemType id = ids.m_pArray[k];
+        for (size_t h = 0; h < numHashes; h++)
+            us(k, h) = (id < 0) ? (ElemType) -1 : (ElemType) (FeatureHash((unsigned long long) id, (unsigned int) h) % (unsigned int) numBuckets);
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType> CPUMatrix<ElemType>::Transpose()
 {
@@ -846,8 +974,8 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     // if it's externally managed, then populate the structure
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
-        // free previous array allocation if any before overwriting
-        if (m_pArray != nullptr)
+        // free previous array allocation if any before overwriting (unless it was external, too)
+        if (m_pArray != nullptr && !m_externalBuffer)
             delete[] m_pArray;
 
         m_pArray = pArray;
@@ -1334,6 +1462,295 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
         return 1;
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients,
+                               CPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType beta1,
+                               ElemType beta2,
+                               ElemType epsilon,
+                               ElemType biasCorrection1,
+                               ElemType biasCorrection2,
+                               bool updateValues)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    ElemType* grad = gradients.m_pArray;
+    ElemType* smoothMom = m_pArray;     // first moment
+    ElemType* smoothSqr = m_pArray + n; // second moment
+    ElemType* val = functionValues.m_pArray;
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = grad[i];
+        ElemType mom = beta1 * smoothMom[i] + (1 - beta1) * g;
+        ElemType sqr = beta2 * smoothSqr[i] + (1 - beta2) * g * g;
+        smoothMom[i] = mom;
+        smoothSqr[i] = sqr;
+
+        ElemType u = mom * biasCorrection1 / (sqrt(sqr * biasCorrection2) + epsilon);
+        if (updateValues)
+            val[i] -= learnRatePerSample * u;
+        else
+            grad[i] = u;
+    }
+}
+
+// one element of a fused optimizer step; the same arithmetic as the unfused UpdateWeightsS() sequence, see _multiTensorUpdate()
+template <class ElemType>
+static inline void MultiTensorUpdateElement(const MultiTensorUpdateParams<ElemType>& p, const MultiTensorUpdateTensor<ElemType>& t, size_t i)
+{
+    ElemType* sm = t.smoothedGradient;
+    const size_t n = t.size;
+    ElemType g = t.gradient[i];
+    ElemType v = t.value[i];
+
+    if (p.clipThreshold > 0)
+        g = max(-p.clipThreshold, min(p.clipThreshold, g));
+    if (p.L2RegWeight > 0)
+        g += p.L2RegWeight * v;
+
+    switch (p.rule)
+    {
+    case MultiTensorUpdateRule::NormalGrad:
+        sm[i] = (1 - p.momentum) * p.learnRatePerSample * g + p.momentum * sm[i];
+        v -= sm[i];
+        break;
+    case MultiTensorUpdateRule::NesterovGrad:
+        sm[i] = (1 - p.momentum) * p.learnRatePerSample * g + p.momentum * sm[i];
+        v -= p.momentum * sm[i];
+        v -= (1 - p.momentum) * p.learnRatePerSample * g;
+        break;
+    case MultiTensorUpdateRule::Adagrad:
+        sm[i] += g * g;
+        g /= sqrt(sm[i] + (ElemType) 1e-16);
+        v -= p.learnRatePerSample * g;
+        break;
+    case MultiTensorUpdateRule::FSAdagrad:
+    {
+        ElemType adaSqr = p.adaWeight * sm[i] + (1.0f - p.adaWeight) * g * g;
+        sm[i] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w = t.adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+        if (p.momentum > 0.0f)
+        {
+            g = p.momentum * sm[n + i] + (1.0f - p.momentum) * g;
+            sm[n + i] = g;
+        }
+        v -= p.learnRatePerSample * g;
+        break;
+    }
+    case MultiTensorUpdateRule::RmsProp:
+    {
+        ElemType* avars = sm;
+        ElemType* signs = sm + n;
+        ElemType* steps = sm + 2 * n;
+        avars[i] = p.rmsGamma * avars[i] + (ElemType(1.0) - p.rmsGamma) * (g * g);
+        const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+        if (signs[i] * grad_sign > 0)
+            steps[i] = min(steps[i] * p.rmsWgtInc, p.rmsWgtMax);
+        else
+            steps[i] = max(steps[i] * p.rmsWgtDec, p.rmsWgtMin);
+        g *= steps[i] / sqrt(avars[i] + (ElemType) 1e-6f);
+        signs[i] = (ElemType) grad_sign;
+        v -= p.learnRatePerSample * g;
+        break;
+    }
+    case MultiTensorUpdateRule::Adam:
+    {
+        ElemType mom = p.adamBeta1 * sm[i] + (1 - p.adamBeta1) * g;
+        ElemType sqr = p.adamBeta2 * sm[n + i] + (1 - p.adamBeta2) * g * g;
+        sm[i] = mom;
+        sm[n + i] = sqr;
+        v -= p.learnRatePerSample * mom * p.adamBiasCorrection1 / (sqrt(sqr * p.adamBiasCorrection2) + p.adamEpsilon);
+        break;
+    }
+    }
+
+    // L1 regularizer with proximal gradient descent method, as InplaceSoftThreshold()
+    if (p.L1Threshold > 0)
+        v = v > p.L1Threshold ? v - p.L1Threshold : v < -p.L1Threshold ? v + p.L1Threshold : 0;
+
+    t.value[i] = v;
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorUpdate(const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params)
+{
+    // cut all parameters into chunks, so that small and large parameters alike are spread over the threads
+    const size_t chunkSize = 4096;
+    std::vector<std::pair<size_t, size_t>> chunks; // (tensor index, first element)
+    for (size_t k = 0; k < tensors.size(); k++)
+        for (size_t begin = 0; begin < tensors[k].size; begin += chunkSize)
+            chunks.push_back(std::make_pair(k, begin));
+
+#pragma omp parallel for schedule(dynamic, 4)
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        const auto& t = tensors[chunks[c].first];
+        const size_t end = min(chunks[c].second + chunkSize, t.size);
+        for (size_t i = chunks[c].second; i < end; i++)
+            MultiTensorUpdateElement(params, t, i);
+    }
+}
+
+// see Matrix<ElemType>::SimpleRNNForward(); one GEMM per time step over all parallel sequences
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::SimpleRNNForward(const CPUMatrix<ElemType>& R, const CPUMatrix<ElemType>& X, const CPUMatrix<ElemType>& hStart, const CPUMatrix<ElemType>& continues,
+                                                      ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                                      CPUMatrix<ElemType>& delayed, CPUMatrix<ElemType>& product, CPUMatrix<ElemType>& sum, CPUMatrix<ElemType>& hidden)
+{
+    const size_t H = R.GetNumRows();
+    const size_t S = continues.GetNumRows();
+    const size_t T = continues.GetNumCols();
+    for (size_t step = 0; step < T; step++)
+    {
+        const size_t t = reverse ? T - 1 - step : step;
+        const size_t tPrev = reverse ? t + 1 : t - 1; // (only used if step > 0)
+        for (size_t s = 0; s < S; s++)
+        {
+            for (size_t i = 0; i < H; i++)
+            {
+                ElemType v;
+                if (continues(s, t) == 0)
+                    v = initialValue;
+                else if (step == 0)
+                    v = hStart(i, s);
+                else
+                    v = hidden(i, tPrev * S + s);
+                delayed(i, t * S + s) = v;
+            }
+        }
+        auto productSlice = product.ColumnSlice(t * S, S);
+        MultiplyAndWeightedAdd(1, R, false, delayed.ColumnSlice(t * S, S), false, 0, productSlice);
+#pragma omp parallel for
+        for (long j = (long) (t * S); j < (long) ((t + 1) * S); j++)
+        {
+            for (size_t i = 0; i < H; i++)
+            {
+                ElemType z = X(i, j) + product(i, j);
+                sum(i, j) = z;
+                hidden(i, j) = nonlinearity == ElementWiseOperator::opSigmoid ? Sigmoid(z) : nonlinearity == ElementWiseOperator::opTanh ? tanh_(z) : z > 0 ? z : 0;
+            }
+        }
+    }
+}
+
+// see Matrix<ElemType>::SoftmaxCrossEntropyForward(); parallel over columns, each read once per pass
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::SoftmaxCrossEntropyForward(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& criterion)
+{
+    const long M = (long) logits.GetNumRows();
+    const long N = (long) logits.GetNumCols();
+    double sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+    for (long j = 0; j < N; j++)
+    {
+        const ElemType* y = labels.m_pArray + (size_t) j * M;
+        const ElemType* z = logits.m_pArray + (size_t) j * M;
+        ElemType colMax = z[0];
+        for (long i = 1; i < M; i++)
+            colMax = max(colMax, z[i]);
+        ElemType colSum = 0;
+        for (long i = 0; i < M; i++)
+            colSum += exp_(z[i] - colMax);
+        const ElemType lse = colMax + log_(colSum);
+        ElemType colCriterion = 0;
+        for (long i = 0; i < M; i++)
+            if (y[i] != 0)
+                colCriterion += y[i] * (lse - z[i]);
+        logSumExp(0, j) = lse;
+        sum += colCriterion;
+    }
+    criterion(0, 0) = (ElemType) sum;
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::SoftmaxCrossEntropyBackward(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                                                 CPUMatrix<ElemType>& logitsGradient)
+{
+    const long M = (long) logits.GetNumRows();
+    const long N = (long) logits.GetNumCols();
+    const ElemType g = gradient(0, 0);
+#pragma omp parallel for
+    for (long j = 0; j < N; j++)
+    {
+        const ElemType lse = logSumExp(0, j);
+        for (long i = 0; i < M; i++)
+            logitsGradient(i, j) += g * (exp_(logits(i, j) - lse) - labels(i, j));
+    }
+}
+
+// see Matrix<ElemType>::IndexedSoftmaxCrossEntropyForward(); like SoftmaxCrossEntropyForward(), with the target logit looked up
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyForward(const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& criterion)
+{
+    const long M = (long) logits.GetNumRows();
+    const long N = (long) logits.GetNumCols();
+    double sum = 0;
+    long numOutOfRange = 0;
+#pragma omp parallel for reduction(+ : sum, numOutOfRange)
+    for (long j = 0; j < N; j++)
+    {
+        const ElemType label = labelIndices.m_pArray[j];
+        logSumExp(0, j) = 0;
+        if (label < 0)
+            continue;
+        if (label >= M)
+        {
+            numOutOfRange++;
+            continue;
+        }
+        const ElemType* z = logits.m_pArray + (size_t) j * M;
+        ElemType colMax = z[0];
+        for (long i = 1; i < M; i++)
+            colMax = max(colMax, z[i]);
+        ElemType colSum = 0;
+        for (long i = 0; i < M; i++)
+            colSum += exp_(z[i] - colMax);
+        const ElemType lse = colMax + log_(colSum);
+        logSumExp(0, j) = lse;
+        sum += lse - z[(long) label];
+    }
+    if (numOutOfRange > 0)
+        InvalidArgument("IndexedSoftmaxCrossEntropyForward: %d label indices are not less than the number of classes (%d).", (int) numOutOfRange, (int) M);
+    criterion(0, 0) = (ElemType) sum;
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                                                        CPUMatrix<ElemType>& logitsGradient)
+{
+    const long M = (long) logits.GetNumRows();
+    const long N = (long) logits.GetNumCols();
+    const ElemType g = gradient(0, 0);
+#pragma omp parallel for
+    for (long j = 0; j < N; j++)
+    {
+        const ElemType label = labelIndices.m_pArray[j];
+        if (label < 0)
+            continue;
+        const ElemType lse = logSumExp(0, j);
+        for (long i = 0; i < M; i++)
+            logitsGradient(i, j) += g * exp_(logits(i, j) - lse);
+        logitsGradient((long) label, j) -= g;
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1424,10 +1841,13 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 }
 
 template <typename ElemType>
-void CPUMatrix<ElemType>::CopySection(size_t /*numRows*/, size_t /*numCols*/, ElemType* /*dst*/, size_t /*colStride*/) const
+void CPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
-    // REVIEW alexeyk: currently not used by CPU, but implement when possible.
-    RuntimeError("Not implemented.");
+    if (numRows > m_numRows || numCols > m_numCols || colStride < numRows)
+        InvalidArgument("CopySection: invalid section size.");
+
+    for (size_t j = 0; j < numCols; j++)
+        memcpy(dst + j * colStride, m_pArray + LocateColumn(j), sizeof(ElemType) * numRows);
 }
 
 template <class ElemType>
@@ -2074,6 +2494,10 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSigmoidOf(const CPUMatrix<ElemTy
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (sizeof(ElemType) == sizeof(float) &&
+        CPUSIMDKernels::TryUnaryOp(opSigmoid, 0, reinterpret_cast<const float*>(a.m_pArray), 1, reinterpret_cast<float*>(m_pArray), GetNumElements()))
+        return *this;
+
 #pragma omp parallel for
     foreach_coord (i, j, us)
     {
@@ -2190,6 +2614,10 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTanhOf(const CPUMatrix<ElemType>
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (sizeof(ElemType) == sizeof(float) &&
+        CPUSIMDKernels::TryUnaryOp(opTanh, 0, reinterpret_cast<const float*>(a.m_pArray), 1, reinterpret_cast<float*>(m_pArray), GetNumElements()))
+        return *this;
+
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
     for (long j = 0; j < n; j++)
@@ -2229,7 +2657,14 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
-    if (isColWise)
+    if (isColWise && sizeof(ElemType) == sizeof(float) && CPUSIMDKernels::IsAvailable())
+    {
+        size_t m = GetNumRows();
+#pragma omp parallel for
+        foreach_column (j, a)
+            CPUSIMDKernels::TryLogSoftmax(reinterpret_cast<const float*>(a.m_pArray + a.LocateColumn(j)), reinterpret_cast<float*>(m_pArray + LocateColumn(j)), m);
+    }
+    else if (isColWise)
     {
 #pragma omp parallel for
         foreach_column (j, a)
@@ -2391,6 +2826,10 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignExpOf(const CPUMatrix<ElemType>&
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (sizeof(ElemType) == sizeof(float) &&
+        CPUSIMDKernels::TryUnaryOp(opExp, 0, reinterpret_cast<const float*>(a.m_pArray), 1, reinterpret_cast<float*>(m_pArray), GetNumElements()))
+        return *this;
+
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
     for (long j = 0; j < n; j++)
@@ -2880,7 +3319,19 @@ void CPUMatrix<ElemType>::VectorSum(const CPUMatrix<ElemType>& a, CPUMatrix<Elem
 
     assert(m > 0 && n > 0); // converting from size_t to int may cause overflow
 
-    if (isColWise) // col-wise
+    if (isColWise && sizeof(ElemType) == sizeof(float) && CPUSIMDKernels::IsAvailable())
+    {
+        c.Resize(1, n);
+
+#pragma omp parallel for
+        foreach_column (j, a)
+        {
+            float v;
+            CPUSIMDKernels::TrySum(reinterpret_cast<const float*>(a.m_pArray + a.LocateColumn(j)), m, v);
+            c(0, j) = (ElemType) v;
+        }
+    }
+    else if (isColWise) // col-wise
     {
         c.Resize(1, n);
 
@@ -3121,24 +3572,23 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignKhatriRaoProductOf(const CPUMatr
     if (cols != b.GetNumCols())
         InvalidArgument("a.GetNumCols() != b.GetNumCols()");
 
-    long rowsA = (long) a.GetNumRows();
-    long rowsB = (long) b.GetNumRows();
+    const size_t rowsA = a.GetNumRows();
+    const size_t rowsB = b.GetNumRows();
     Resize(rowsA * rowsB, cols);
 
-#ifdef __INTEL_COMPILER // TODO: check this
-#pragma simd statement
-#endif
+    // one job per column and row of b: a run of rowsA consecutive outputs, a's column times one element of b, in a loop
+    // the compiler vectorizes
+    const ElemType* pa = a.m_pArray;
+    const ElemType* pb = b.m_pArray;
+    ElemType* pus = m_pArray;
 #pragma omp parallel for
-    for (long k = 0; k < cols; k++)
+    for (long job = 0; job < (long) (cols * rowsB); job++)
     {
-        long jj = 0;
-        for (long j = 0; j < rowsB; j++)
-        {
-            for (long i = 0; i < rowsA; i++)
-            {
-                (*this)(jj++, k) = a(i, k) * b(j, k);
-            }
-        }
+        const ElemType bjk = pb[job]; // (element j of column k is at j + k * rowsB, which is the job index)
+        const ElemType* ak = pa + (job / rowsB) * rowsA;
+        ElemType* us = pus + (size_t) job * rowsA;
+        for (size_t i = 0; i < rowsA; i++)
+            us[i] = ak[i] * bjk;
     }
 
     return *this;
@@ -3170,52 +3620,40 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddColumnReshapeProductOf(const CPUMat
     if (rowsC != GetNumRows() || cols != GetNumCols())
         InvalidArgument("AddColumnReshapeProductOf: This matrix does not have the right size.");
 
-    auto& us = *this;
-
+    // per column t: a matrix-vector product with contiguous inner loops, which the compiler vectorizes
+    const ElemType* pa = a.m_pArray;
+    const ElemType* pb = b.m_pArray;
+    ElemType* pus = m_pArray;
     if (transposeAColumn)
     {
-        // find nrows and ncols of tbe reshaped a
-        long nrows = rowsB;
-        long ncols = rowsC;
-
-#ifdef __INTEL_COMPILER // TODO: check this
-#pragma simd statement
-#endif
+        // us(j, t) += sum_i a(i + j * rowsB, t) * b(i, t): dot products of contiguous rows
 #pragma omp parallel for
-        foreach_column (t, a)
+        for (long t = 0; t < cols; t++)
         {
-            size_t k = 0;
-            for (size_t j = 0; j < ncols; j++) // row and col is transposed
+            const ElemType* bt = pb + (size_t) t * rowsB;
+            for (long j = 0; j < rowsC; j++)
             {
+                const ElemType* aj = pa + (size_t) t * rowsA + (size_t) j * rowsB;
                 ElemType v = 0;
-                for (size_t i = 0; i < nrows; i++)
-                {
-                    v += a(k, t) * b(i, t);
-                    k++;
-                }
-                us(j, t) += v;
+                for (long i = 0; i < rowsB; i++)
+                    v += aj[i] * bt[i];
+                pus[j + (size_t) t * rowsC] += v;
             }
         }
     }
     else
     {
-        size_t ncols = rowsB;
-        size_t nrows = rowsC;
-
-#ifdef __INTEL_COMPILER // TODO: check this
-#pragma simd statement
-#endif
+        // us(i, t) += sum_j a(i + j * rowsC, t) * b(j, t): a sum of scaled contiguous columns
 #pragma omp parallel for
-        foreach_column (t, a)
+        for (long t = 0; t < cols; t++)
         {
-            size_t k = 0;
-            for (size_t j = 0; j < ncols; j++)
+            ElemType* ust = pus + (size_t) t * rowsC;
+            for (long j = 0; j < rowsB; j++)
             {
-                for (size_t i = 0; i < nrows; i++)
-                {
-                    us(i, t) += a(k, t) * b(j, t);
-                    k++;
-                }
+                const ElemType* aj = pa + (size_t) t * rowsA + (size_t) j * rowsC;
+                const ElemType bj = pb[j + (size_t) t * rowsB];
+                for (long i = 0; i < rowsC; i++)
+                    ust[i] += aj[i] * bj;
             }
         }
     }
@@ -3431,12 +3869,13 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
             ElemType* curMax = maxValues.m_pArray;
             for (int icol = 0; icol < n; icol++, curVal += m, curIdx += topK, curMax += topK)
             {
-                // Partial sort, descending order.
-                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(),
-                                 [curVal](const int& a, const int& b)
-                                 {
-                                     return curVal[a] > curVal[b];
-                                 });
+                // Partial sort, descending order; equal values by index, as on the GPU.
+                auto better = [curVal](const int& a, const int& b)
+                {
+                    return curVal[a] > curVal[b] || (curVal[a] == curVal[b] && a < b);
+                };
+                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(), better);
+                std::sort(indices.begin(), indices.begin() + topK, better);
                 // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
                 // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
                 for (int i = 0; i < topK; i++)
@@ -3982,34 +4421,18 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
 
     int m, n, k, l;
     int lda, ldb, ldc;
-#ifndef USE_MKL
-    char transA, transB;
-#else
-    CBLAS_TRANSPOSE mklTransA;
-    CBLAS_TRANSPOSE mklTransB;
-#endif
 
     if (transposeA)
     {
         m = (int) a.GetNumCols();
         k = (int) a.GetNumRows();
         lda = k;
-#ifndef USE_MKL
-        transA = (char) MatrixTranspose::Trans;
-#else
-        mklTransA = CBLAS_TRANSPOSE::CblasTrans;
-#endif
     }
     else
     {
         m = (int) a.GetNumRows();
         k = (int) a.GetNumCols();
         lda = m;
-#ifndef USE_MKL
-        transA = (char) MatrixTranspose::NoTrans;
-#else
-        mklTransA = CBLAS_TRANSPOSE::CblasNoTrans;
-#endif
     }
 
     if (transposeB)
@@ -4017,22 +4440,12 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
         l = (int) b.GetNumCols();
         n = (int) b.GetNumRows();
         ldb = n;
-#ifndef USE_MKL
-        transB = (char) MatrixTranspose::Trans;
-#else
-        mklTransB = CBLAS_TRANSPOSE::CblasTrans;
-#endif
     }
     else
     {
         l = (int) b.GetNumRows();
         n = (int) b.GetNumCols();
         ldb = l;
-#ifndef USE_MKL
-        transB = (char) MatrixTranspose::NoTrans;
-#else
-        mklTransB = CBLAS_TRANSPOSE::CblasNoTrans;
-#endif
     }
 
     assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
@@ -4047,22 +4460,35 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
 
     ldc = (int) c.GetNumRows();
 
-    if (sizeof(ElemType) == sizeof(double))
+    // the BLAS library is selected at runtime, see CPUGemm.h
+    CPUGemm::Gemm<ElemType>(transposeA, transposeB, m, n, k, alpha, a.m_pArray, lda, b.m_pArray, ldb, beta, c.m_pArray, ldc);
+}
+
+// batched c_i = alpha * op(a_i) * op(b_i) + beta * c_i, see Matrix::MultiplyAndWeightedAddStridedBatched()
+// Small products do not keep the BLAS threads busy, so these run side by side, one thread each; large ones run one
+// after the other, each using all threads.
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiplyAndWeightedAddStridedBatched(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                               const CPUMatrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                               ElemType beta, CPUMatrix<ElemType>& c, size_t strideC,
+                                                               size_t m, size_t n, size_t k, size_t batchCount)
+{
+    if (batchCount == 0 || m == 0 || n == 0)
+        return;
+    const int lda = (int) a.GetNumRows(), ldb = (int) b.GetNumRows(), ldc = (int) c.GetNumRows();
+    const ElemType* pa = a.m_pArray;
+    const ElemType* pb = b.m_pArray;
+    ElemType* pc = c.m_pArray;
+    if ((double) m * n * k < 128.0 * 128 * 128 && batchCount > 1)
     {
-#ifndef USE_MKL
-        dgemm(transA, transB, m, n, k, alpha, reinterpret_cast<double*>(a.m_pArray), lda, reinterpret_cast<double*>(b.m_pArray), ldb, beta, reinterpret_cast<double*>(c.m_pArray), ldc);
-#else
-        cblas_dgemm((CBLAS_ORDER) BLAS_COLMAJOR mklTransA, mklTransB, m, n, k, alpha, reinterpret_cast<double*>(a.m_pArray), lda, reinterpret_cast<double*>(b.m_pArray), ldb, beta, reinterpret_cast<double*>(c.m_pArray), ldc);
-#endif
+#pragma omp parallel for
+        for (long i = 0; i < (long) batchCount; i++)
+            CPUGemm::Gemm<ElemType>(transposeA, transposeB, (int) m, (int) n, (int) k, alpha, pa + i * strideA, lda, pb + i * strideB, ldb, beta, pc + i * strideC, ldc);
     }
     else
     {
-#pragma warning(suppress : 4244)
-#ifndef USE_MKL
-        sgemm(BLAS_COLMAJOR transA, transB, m, n, k, alpha, reinterpret_cast<float*>(a.m_pArray), lda, reinterpret_cast<float*>(b.m_pArray), ldb, beta, reinterpret_cast<float*>(c.m_pArray), ldc);
-#else
-        cblas_sgemm((CBLAS_ORDER) BLAS_COLMAJOR mklTransA, mklTransB, m, n, k, alpha, reinterpret_cast<float*>(a.m_pArray), lda, reinterpret_cast<float*>(b.m_pArray), ldb, beta, reinterpret_cast<float*>(c.m_pArray), ldc);
-#endif
+        for (size_t i = 0; i < batchCount; i++)
+            CPUGemm::Gemm<ElemType>(transposeA, transposeB, (int) m, (int) n, (int) k, alpha, pa + i * strideA, lda, pb + i * strideB, ldb, beta, pc + i * strideC, ldc);
     }
 }
 
@@ -5201,6 +5627,80 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOfWithShift(const
     return *this;
 }
 
+// cosine distance with negative samples (DSSM), in one pass
+// a and b are [m x n]; invNormA and invNormB hold the inverse norms of their columns, as row vectors [1 x n].
+// Row 0 of the output [(negnumber+1) x n] is the cosine of each column j of a with column j of b, and row i > 0 that with
+// column (j + shift + i - 1) % n of b, like the product of AssignElementProductOfWithShiftNeg() and InnerProductWithShiftNeg().
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNegOf: Matrix is empty.");
+
+    const long m = (long) a.GetNumRows(), n = (long) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n || invNormA.GetNumElements() != n || invNormB.GetNumElements() != n)
+        InvalidArgument("AssignCosDistanceWithShiftNegOf: The input matrix dimensions do not match.");
+
+    Resize(negnumber + 1, n);
+    auto& us = *this;
+    const long rows = (long) negnumber + 1;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        for (long i = 0; i < rows; i++)
+        {
+            long k = i == 0 ? j : (long) ((j + shift + i - 1) % n);
+            ElemType sum = 0;
+            for (long r = 0; r < m; r++)
+                sum += a(r, j) * b(r, k);
+            us(i, j) = sum * invNormA.m_pArray[j] * invNormB.m_pArray[k];
+        }
+    }
+    return *this;
+}
+
+// [this] += the gradient of AssignCosDistanceWithShiftNegOf() w.r.t. a (or b if 'wrtB'), given its value and gradient
+// For a column j of a and its i-th partner k in b, d cos / d a_j = b_k / (|a_j| |b_k|) - cos a_j / |a_j|^2, and symmetrically for b_k.
+// Each column of the result sums over all outputs that involve it, so that there is one pass without any temporaries.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(bool wrtB, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value,
+                                                                               const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB,
+                                                                               size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AddCosDistanceWithShiftNegGradientOf: Matrix is empty.");
+
+    const long m = (long) a.GetNumRows(), n = (long) a.GetNumCols();
+    const long rows = (long) negnumber + 1;
+    if (b.GetNumRows() != m || b.GetNumCols() != n || GetNumRows() != m || GetNumCols() != n ||
+        gradient.GetNumRows() != rows || gradient.GetNumCols() != n || value.GetNumRows() != rows || value.GetNumCols() != n)
+        InvalidArgument("AddCosDistanceWithShiftNegGradientOf: The input matrix dimensions do not match.");
+
+    auto& us = *this;
+    const CPUMatrix<ElemType>& self = wrtB ? b : a;         // the input we differentiate w.r.t.
+    const CPUMatrix<ElemType>& other = wrtB ? a : b;
+    const CPUMatrix<ElemType>& invNormSelf = wrtB ? invNormB : invNormA;
+    const CPUMatrix<ElemType>& invNormOther = wrtB ? invNormA : invNormB;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType invNormJ = invNormSelf.m_pArray[j];
+        for (long i = 0; i < rows; i++)
+        {
+            // the output (i, col) that column j contributes to, and the column of the other input it is paired with
+            long currshift = i == 0 ? 0 : (long) ((shift + i - 1) % n);
+            long col = wrtB ? (j + n - currshift) % n : j;
+            long k = wrtB ? col : (j + currshift) % n;
+            ElemType g = gradient(i, col);
+            ElemType otherWeight = g * invNormJ * invNormOther.m_pArray[k];
+            ElemType selfWeight = g * value(i, col) * invNormJ * invNormJ;
+            for (long r = 0; r < m; r++)
+                us(r, j) += otherWeight * other(r, k) - selfWeight * self(r, j);
+        }
+    }
+    return *this;
+}
+
 #pragma endregion Static BLAS Functions
 
 // 'double' version of LogAdd
@@ -5218,6 +5718,34 @@ ElemType CPUMatrix<ElemType>::LogAddSumOfElements() const
     return fAlpha;
 }
 
+// alpha(k, t) = log sum_j exp(alpha(j, t - 1) + pair_scores(k, j)) + pos_scores(k, t), where alpha(j, -1) is 0 for the start label, LZERO otherwise
+template <class ElemType>
+void CPUMatrix<ElemType>::RCRFForwardCompute(CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+    int iNumPos = (int) pos_scores.GetNumCols();
+    int iNumLab = (int) pos_scores.GetNumRows();
+
+    alpha.Resize(iNumLab, iNumPos);
+
+    for (int t = 0; t < iNumPos; t++)
+    {
+#pragma omp parallel for
+        for (int k = 0; k < iNumLab; k++)
+        {
+            ElemType fTmp = (ElemType) LZERO;
+            for (int j = 0; j < iNumLab; j++)
+            {
+                ElemType fAlpha = (j == startLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
+                if (t > 0)
+                    fAlpha = alpha(j, t - 1);
+                fTmp = (ElemType) LogAddD(fTmp, fAlpha + pair_scores(k, j));
+            }
+            alpha(k, t) = fTmp + pos_scores(k, t); // include position dependent score
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
                                               const CPUMatrix<ElemType>& lbls,
@@ -5483,6 +6011,7 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     mkl_set_num_threads(numThreads);
 #endif
 #endif
+    TaskPool::SetNumThreads(numThreads); // the same core budget
     return numThreads;
 }
 
@@ -5672,6 +6201,68 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     }
 }
 
+// reduction of the columns of contiguous [rows x cols] inputs into a contiguous column, e.g. the gradient of a bias
+// The generic loops above reduce innermost, which here walks each row with a stride of 'rows' and leaves all but one
+// core idle. Instead, the loop over columns goes outside, so that the inner loop runs over contiguous rows, with the
+// rows in blocks that stay in the cache. Blocks of rows and chunks of columns go to separate threads; the partial sums
+// of the column chunks are added up at the end. Returns false if the operation is not of this form.
+template <class ElemType, typename OPFN, size_t N>
+static bool TensorOpColumnReduction(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    if (regularOpDims.size() != 1 || reducingOpDims.size() != 1)
+        return false;
+    for (size_t i = 0; i < N; i++)
+        if (regularStrides[i][0] != 1)
+            return false;
+    const size_t rows = regularOpDims[0];
+    const size_t cols = reducingOpDims[0];
+    const size_t rowBlockSize = 256;
+    const size_t numRowBlocks = (rows + rowBlockSize - 1) / rowBlockSize;
+    const size_t minColsPerChunk = 64;
+    const size_t numThreads = (size_t) omp_get_max_threads();
+    const size_t numColChunks = max((size_t) 1, min(numThreads / numRowBlocks, cols / minColsPerChunk));
+    const size_t colsPerChunk = (cols + numColChunks - 1) / numColChunks;
+
+    std::vector<double> partials(rows * numColChunks, 0.0); // [rows x numColChunks], accumulated in double like the loops above
+#pragma omp parallel for
+    for (long task = 0; task < (long) (numRowBlocks * numColChunks); task++)
+    {
+        const size_t rowBegin = (task % numRowBlocks) * rowBlockSize;
+        const size_t rowEnd = min(rowBegin + rowBlockSize, rows);
+        const size_t chunk = task / numRowBlocks;
+        const size_t colEnd = min((chunk + 1) * colsPerChunk, cols);
+        double* sums = partials.data() + chunk * rows;
+        for (size_t col = chunk * colsPerChunk; col < colEnd; col++)
+        {
+            array<ElemType*, N> p;
+            for (size_t i = 0; i < N - 1; i++)
+                p[i] = pointers[i] + col * reducingStrides[i][0];
+            p[N - 1] = pointers[N - 1]; // (output, unused by opfn)
+            for (size_t row = rowBegin; row < rowEnd; row++)
+            {
+                sums[row] += opfn(p);
+                for (size_t i = 0; i < N - 1; i++)
+                    p[i]++;
+            }
+        }
+    }
+
+    ElemType* pout = pointers[N - 1];
+    for (size_t row = 0; row < rows; row++)
+    {
+        double sum = 0;
+        for (size_t chunk = 0; chunk < numColChunks; chunk++)
+            sum += partials[row + chunk * rows];
+        ElemType val = (ElemType) sum * alpha;
+        if (beta != 0)
+            val += beta * pout[row];
+        pout[row] = val;
+    }
+    return true;
+}
+
 // tensor operation, generalized in number of arguments, operation already provided as a lambda
 // This function now expands into different k.
 template <class ElemType, typename OPFN, size_t N>
@@ -5682,6 +6273,8 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
 {
     for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
+    if (TensorOpColumnReduction(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     size_t dims = regularOpDims.size();
     switch (dims)
     {
@@ -5721,6 +6314,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               },                                                       \
                               offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
+    // contiguous float data without reduction (e.g. Sigmoid over a minibatch) goes to the SIMD kernels if they support the op
+    if (sizeof(ElemType) == sizeof(float) && reducingOpDims.empty() && regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1 &&
+        CPUSIMDKernels::TryUnaryOp(op, (float) beta, reinterpret_cast<const float*>(a.m_pArray + offsets[0]), (float) alpha, reinterpret_cast<float*>(m_pArray + offsets[1]), regularOpDims[0]))
+        return;
+
     array<ElemType*, 2> pointers = {a.m_pArray, m_pArray};
     switch (op)
     {
@@ -5746,6 +6344,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               },                                                       \
                               offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
+    if (sizeof(ElemType) == sizeof(float) && reducingOpDims.empty() && regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1 && regularStrides[2][0] == 1 &&
+        CPUSIMDKernels::TryBinaryOp(op, (float) beta, reinterpret_cast<const float*>(a.m_pArray + offsets[0]), reinterpret_cast<const float*>(b.m_pArray + offsets[1]), (float) alpha,
+                                    reinterpret_cast<float*>(m_pArray + offsets[2]), regularOpDims[0]))
+        return;
+
     array<ElemType*, 3> pointers = {a.m_pArray, b.m_pArray, m_pArray};
     switch (op)
     {
@@ -83,6 +83,18 @@ public:
                      ElemType RMS_WGT_DEC,
                      ElemType RMS_WGT_MIN,
                      const bool needAveMultiplier);
+    void Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+              ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection1, ElemType biasCorrection2, bool updateValues);
+    static void MultiTensorUpdate(const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params);
+    static void SimpleRNNForward(const CPUMatrix<ElemType>& R, const CPUMatrix<ElemType>& X, const CPUMatrix<ElemType>& hStart, const CPUMatrix<ElemType>& continues,
+                                 ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                 CPUMatrix<ElemType>& delayed, CPUMatrix<ElemType>& product, CPUMatrix<ElemType>& sum, CPUMatrix<ElemType>& hidden);
+    static void SoftmaxCrossEntropyForward(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& criterion);
+    static void SoftmaxCrossEntropyBackward(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                            CPUMatrix<ElemType>& logitsGradient);
+    static void IndexedSoftmaxCrossEntropyForward(const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& criterion);
+    static void IndexedSoftmaxCrossEntropyBackward(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp,
+                                                   CPUMatrix<ElemType>& logitsGradient);
 
     void Reshape(const size_t numRows, const size_t numCols);
     void Resize(const size_t numRows, const size_t numCols, bool growOnly = true); // by default we only reallocate if need to grow
@@ -276,6 +288,11 @@ public:
     CPUMatrix<ElemType>& AssignPositiveAndShiftedNegSample(const CPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     CPUMatrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const CPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
 
+    CPUMatrix<ElemType>& DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+    CPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+    CPUMatrix<ElemType>& DoDropoutOf(ElemType beta, const CPUMatrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset);
+    CPUMatrix<ElemType>& AssignHashedIndicesOf(const CPUMatrix<ElemType>& ids, size_t numBuckets, size_t numHashes);
+
     void VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<ElemType>& maxValues, const bool isColWise, int topK = 1) const;
     void VectorMin(CPUMatrix<ElemType>& minIndexes, CPUMatrix<ElemType>& minValues, const bool isColWise) const;
 
@@ -327,6 +344,10 @@ public:
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c);
+    static void MultiplyAndWeightedAddStridedBatched(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                     const CPUMatrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                     ElemType beta, CPUMatrix<ElemType>& c, size_t strideC,
+                                                     size_t m, size_t n, size_t k, size_t batchCount);
 
     static void ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>& c);
     static void AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
@@ -380,6 +401,10 @@ public:
     CPUMatrix<ElemType>& GetARowByIndex(const CPUMatrix<ElemType>& a, const size_t index);
     static void ConductRowElementMultiplyWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const size_t shift, bool bFirstmatrixfixed);
     CPUMatrix<ElemType>& AssignElementProductOfWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift);
+    CPUMatrix<ElemType>& AssignCosDistanceWithShiftNegOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, size_t negnumber);
+    CPUMatrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(bool wrtB, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value,
+                                                              const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB,
+                                                              size_t shift, size_t negnumber);
 
 public:
     friend File& operator>>(File& stream, CPUMatrix<ElemType>& us)
@@ -394,8 +419,11 @@ public:
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+            for (size_t i = 0; i < numRows * numCols; ++i)
+                stream >> d_array[i];
+        else
+            stream.ReadBinaryArray(d_array, sizeof(ElemType), numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
         if (us.m_matrixName)
@@ -416,8 +444,11 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.m_pArray[i];
+        if (stream.IsTextBased())
+            for (size_t i = 0; i < us.GetNumElements(); ++i)
+                stream << us.m_pArray[i];
+        else
+            stream.WriteBinaryArray(us.m_pArray, sizeof(ElemType), us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -427,6 +458,8 @@ public:
 
 public:
     // for RCRF
+    static void RCRFForwardCompute(CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl);
     static void RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
                                     const CPUMatrix<ElemType>& lbls,
                                     const CPUMatrix<ElemType>& pair_scores);
@@ -0,0 +1,464 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUSIMDKernels.cpp -- AVX2/FMA implementations of the hot CPUMatrix element-wise ops and reductions
+//
+// The kernels are compiled for AVX2 via function attributes, so the rest of the library keeps its baseline
+// instruction set and still runs on older CPUs; IsAvailable() decides at runtime whether they may be called.
+// Each kernel processes a contiguous range serially; the Parallel...() wrappers split large ranges for OpenMP
+// (the OpenMP-outlined functions are not compiled for AVX2, hence the kernels must not contain OpenMP regions).
+//
+
+#include "stdafx.h"
+#include "CPUSIMDKernels.h"
+#include <immintrin.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define SIMD_TARGET // MSVC generates AVX2 code for intrinsics irrespective of /arch
+#else
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// runtime CPU detection
+// -----------------------------------------------------------------------
+
+static bool DetectAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool hasFMA = (info[2] & (1 << 12)) != 0;
+    bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    if (!hasFMA || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6) // (the OS must also save the YMM registers)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+/*static*/ bool CPUSIMDKernels::IsAvailable()
+{
+    static const bool isAvailable = DetectAVX2();
+    return isAvailable;
+}
+
+// -----------------------------------------------------------------------
+// vector math on 8 floats
+// -----------------------------------------------------------------------
+
+// exp() with a Cephes-style minimax polynomial; relative error is about 2 ulp
+SIMD_TARGET static inline __m256 Exp8(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-87.3365447504f));
+
+    // exp(x) = 2^n * exp(r) with n = round(x / ln 2), r = x - n ln 2 (ln 2 split in two for precision)
+    __m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+
+    __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894E-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201E-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, one));
+
+    __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(0x7f)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+SIMD_TARGET static inline __m256 Sigmoid8(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(one, _mm256_add_ps(one, Exp8(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+// tanh(x) = 2 sigmoid(2x) - 1, except near 0 where that loses relative precision and an odd polynomial is used
+SIMD_TARGET static inline __m256 Tanh8(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 large = _mm256_fmsub_ps(_mm256_set1_ps(2.0f), Sigmoid8(_mm256_add_ps(x, x)), one);
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_fmadd_ps(x2, _mm256_set1_ps(-17.0f / 315), _mm256_set1_ps(2.0f / 15));
+    p = _mm256_fmadd_ps(x2, p, _mm256_set1_ps(-1.0f / 3));
+    __m256 small = _mm256_fmadd_ps(_mm256_mul_ps(x, x2), p, x);
+    __m256 absX = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    return _mm256_blendv_ps(large, small, _mm256_cmp_ps(absX, _mm256_set1_ps(0.1f), _CMP_LT_OQ));
+}
+
+SIMD_TARGET static inline float HorizontalSum(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+SIMD_TARGET static inline float HorizontalMax(__m256 v)
+{
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+// -----------------------------------------------------------------------
+// the element-wise ops, matching the definitions in TensorOps.h
+// -----------------------------------------------------------------------
+
+#define DefSIMDUnaryOp(op, expr)                    \
+    struct SIMD##op                                 \
+    {                                               \
+        SIMD_TARGET static inline __m256 Apply(__m256 a) \
+        {                                           \
+            return expr;                            \
+        }                                           \
+    }
+
+DefSIMDUnaryOp(Copy, a);
+DefSIMDUnaryOp(Sigmoid, Sigmoid8(a));
+DefSIMDUnaryOp(Tanh, Tanh8(a));
+DefSIMDUnaryOp(Exp, Exp8(a));
+DefSIMDUnaryOp(LinearRectifier, _mm256_max_ps(a, _mm256_setzero_ps()));
+
+#define DefSIMDBinaryOp(op, expr)                             \
+    struct SIMD##op                                           \
+    {                                                         \
+        SIMD_TARGET static inline __m256 Apply(__m256 a, __m256 b) \
+        {                                                     \
+            return expr;                                      \
+        }                                                     \
+    }
+
+DefSIMDBinaryOp(Sum, _mm256_add_ps(a, b));
+DefSIMDBinaryOp(Difference, _mm256_sub_ps(a, b));
+DefSIMDBinaryOp(ElementwiseProduct, _mm256_mul_ps(a, b));
+DefSIMDBinaryOp(SigmoidOfSum, Sigmoid8(_mm256_add_ps(a, b)));
+DefSIMDBinaryOp(TanhOfSum, Tanh8(_mm256_add_ps(a, b)));
+DefSIMDBinaryOp(LinearRectifierOfSum, _mm256_max_ps(_mm256_add_ps(a, b), _mm256_setzero_ps()));
+DefSIMDBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput, _mm256_mul_ps(a, _mm256_mul_ps(b, _mm256_sub_ps(_mm256_set1_ps(1.0f), b))));
+DefSIMDBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput, _mm256_mul_ps(a, _mm256_fnmadd_ps(b, b, _mm256_set1_ps(1.0f))));
+DefSIMDBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, _mm256_and_ps(a, _mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_GT_OQ)));
+
+#undef DefSIMDUnaryOp
+#undef DefSIMDBinaryOp
+
+// -----------------------------------------------------------------------
+// loops
+// -----------------------------------------------------------------------
+
+// c = beta * c + alpha * v, where c is not read if beta == 0
+SIMD_TARGET static inline void Store8(float* c, __m256 v, float beta, float alpha)
+{
+    if (alpha != 1)
+        v = _mm256_mul_ps(_mm256_set1_ps(alpha), v);
+    if (beta != 0)
+        v = _mm256_fmadd_ps(_mm256_set1_ps(beta), _mm256_loadu_ps(c), v);
+    _mm256_storeu_ps(c, v);
+}
+
+template <class OP>
+SIMD_TARGET static void UnaryLoop(float beta, const float* a, float alpha, float* c, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        Store8(c + i, OP::Apply(_mm256_loadu_ps(a + i)), beta, alpha);
+    if (i < n) // the tail goes through a padded buffer, so that it is computed exactly like the rest
+    {
+        float ta[8] = {0}, tc[8] = {0};
+        std::copy(a + i, a + n, ta);
+        if (beta != 0)
+            std::copy(c + i, c + n, tc);
+        Store8(tc, OP::Apply(_mm256_loadu_ps(ta)), beta, alpha);
+        std::copy(tc, tc + (n - i), c + i);
+    }
+}
+
+template <class OP>
+SIMD_TARGET static void BinaryLoop(float beta, const float* a, const float* b, float alpha, float* c, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        Store8(c + i, OP::Apply(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)), beta, alpha);
+    if (i < n)
+    {
+        float ta[8] = {0}, tb[8] = {0}, tc[8] = {0};
+        std::copy(a + i, a + n, ta);
+        std::copy(b + i, b + n, tb);
+        if (beta != 0)
+            std::copy(c + i, c + n, tc);
+        Store8(tc, OP::Apply(_mm256_loadu_ps(ta), _mm256_loadu_ps(tb)), beta, alpha);
+        std::copy(tc, tc + (n - i), c + i);
+    }
+}
+
+// below this many elements, OpenMP costs more than it gains
+static const size_t simdChunkSize = 16384;
+
+template <class OP>
+static void ParallelUnaryLoop(float beta, const float* a, float alpha, float* c, size_t n)
+{
+    if (n <= simdChunkSize)
+        return UnaryLoop<OP>(beta, a, alpha, c, n);
+    long numChunks = (long) ((n + simdChunkSize - 1) / simdChunkSize);
+#pragma omp parallel for
+    for (long k = 0; k < numChunks; k++)
+    {
+        size_t begin = k * simdChunkSize;
+        size_t end = std::min(n, begin + simdChunkSize);
+        UnaryLoop<OP>(beta, a + begin, alpha, c + begin, end - begin);
+    }
+}
+
+template <class OP>
+static void ParallelBinaryLoop(float beta, const float* a, const float* b, float alpha, float* c, size_t n)
+{
+    if (n <= simdChunkSize)
+        return BinaryLoop<OP>(beta, a, b, alpha, c, n);
+    long numChunks = (long) ((n + simdChunkSize - 1) / simdChunkSize);
+#pragma omp parallel for
+    for (long k = 0; k < numChunks; k++)
+    {
+        size_t begin = k * simdChunkSize;
+        size_t end = std::min(n, begin + simdChunkSize);
+        BinaryLoop<OP>(beta, a + begin, b + begin, alpha, c + begin, end - begin);
+    }
+}
+
+SIMD_TARGET static void LogSoftmaxKernel(const float* a, float* c, size_t n)
+{
+    // max first, to avoid overflow of exp()
+    __m256 vMax = _mm256_set1_ps(-FLT_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        vMax = _mm256_max_ps(vMax, _mm256_loadu_ps(a + i));
+    float maxV = HorizontalMax(vMax);
+    for (size_t k = i; k < n; k++)
+        maxV = std::max(maxV, a[k]);
+
+    const __m256 vMaxV = _mm256_set1_ps(maxV);
+    __m256 vSum = _mm256_setzero_ps();
+    for (i = 0; i + 8 <= n; i += 8)
+        vSum = _mm256_add_ps(vSum, Exp8(_mm256_sub_ps(_mm256_loadu_ps(a + i), vMaxV)));
+    float sum = HorizontalSum(vSum);
+    for (size_t k = i; k < n; k++)
+        sum += expf(a[k] - maxV);
+
+    const __m256 vLogSum = _mm256_set1_ps(maxV + logf(sum));
+    for (i = 0; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(c + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), vLogSum));
+    for (size_t k = i; k < n; k++)
+        c[k] = a[k] - (maxV + logf(sum));
+}
+
+SIMD_TARGET static float SumKernel(const float* a, size_t n)
+{
+    // 4 independent accumulators to hide the latency of the adds
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        s0 = _mm256_add_ps(s0, _mm256_loadu_ps(a + i));
+        s1 = _mm256_add_ps(s1, _mm256_loadu_ps(a + i + 8));
+        s2 = _mm256_add_ps(s2, _mm256_loadu_ps(a + i + 16));
+        s3 = _mm256_add_ps(s3, _mm256_loadu_ps(a + i + 24));
+    }
+    for (; i + 8 <= n; i += 8)
+        s0 = _mm256_add_ps(s0, _mm256_loadu_ps(a + i));
+    float sum = HorizontalSum(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+// dot products of one int8 vector with 'n' others, 4 at a time so that each load of 'a' is used 4 times
+// The int8 values are widened to int16, multiplied and pairwise added into int32 by madd, which cannot overflow.
+SIMD_TARGET static inline int HorizontalSumInt(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+SIMD_TARGET static inline __m256i LoadInt8AsInt16(const signed char* p)
+{
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+SIMD_TARGET static void Int8DotProductsKernel(const signed char* a, const signed char* b, size_t ldb, size_t n, size_t k, int* results)
+{
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        const signed char* b0 = b + j * ldb;
+        __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256(), s2 = _mm256_setzero_si256(), s3 = _mm256_setzero_si256();
+        for (size_t p = 0; p < k; p += 16)
+        {
+            __m256i va = LoadInt8AsInt16(a + p);
+            s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(va, LoadInt8AsInt16(b0 + p)));
+            s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(va, LoadInt8AsInt16(b0 + ldb + p)));
+            s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(va, LoadInt8AsInt16(b0 + 2 * ldb + p)));
+            s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(va, LoadInt8AsInt16(b0 + 3 * ldb + p)));
+        }
+        results[j] = HorizontalSumInt(s0);
+        results[j + 1] = HorizontalSumInt(s1);
+        results[j + 2] = HorizontalSumInt(s2);
+        results[j + 3] = HorizontalSumInt(s3);
+    }
+    for (; j < n; j++)
+    {
+        __m256i s = _mm256_setzero_si256();
+        for (size_t p = 0; p < k; p += 16)
+            s = _mm256_add_epi32(s, _mm256_madd_epi16(LoadInt8AsInt16(a + p), LoadInt8AsInt16(b + j * ldb + p)));
+        results[j] = HorizontalSumInt(s);
+    }
+}
+
+// -----------------------------------------------------------------------
+// entry points
+// -----------------------------------------------------------------------
+
+#define CaseSIMDUnaryOp(oper)                                     \
+    case ElementWiseOperator::op##oper:                           \
+        ParallelUnaryLoop<SIMD##oper>(beta, a, alpha, c, n); \
+        return true
+
+/*static*/ bool CPUSIMDKernels::TryUnaryOp(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n)
+{
+    if (!IsAvailable())
+        return false;
+    switch (op)
+    {
+        CaseSIMDUnaryOp(Copy);
+        CaseSIMDUnaryOp(Sigmoid);
+        CaseSIMDUnaryOp(Tanh);
+        CaseSIMDUnaryOp(Exp);
+        CaseSIMDUnaryOp(LinearRectifier);
+    default:
+        return false;
+    }
+}
+
+#define CaseSIMDBinaryOp(oper)                                       \
+    case ElementWiseOperator::op##oper:                              \
+        ParallelBinaryLoop<SIMD##oper>(beta, a, b, alpha, c, n); \
+        return true
+
+/*static*/ bool CPUSIMDKernels::TryBinaryOp(ElementWiseOperator op, float beta, const float* a, const float* b, float alpha, float* c, size_t n)
+{
+    if (!IsAvailable())
+        return false;
+    switch (op)
+    {
+        CaseSIMDBinaryOp(Sum);
+        CaseSIMDBinaryOp(Difference);
+        CaseSIMDBinaryOp(ElementwiseProduct);
+        CaseSIMDBinaryOp(SigmoidOfSum);
+        CaseSIMDBinaryOp(TanhOfSum);
+        CaseSIMDBinaryOp(LinearRectifierOfSum);
+        CaseSIMDBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput);
+        CaseSIMDBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput);
+        CaseSIMDBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+    default:
+        return false;
+    }
+}
+
+#undef CaseSIMDUnaryOp
+#undef CaseSIMDBinaryOp
+
+/*static*/ bool CPUSIMDKernels::TryLogSoftmax(const float* a, float* c, size_t n)
+{
+    if (!IsAvailable() || n == 0)
+        return false;
+    LogSoftmaxKernel(a, c, n);
+    return true;
+}
+
+/*static*/ bool CPUSIMDKernels::TrySum(const float* a, size_t n, float& sum)
+{
+    if (!IsAvailable())
+        return false;
+    sum = SumKernel(a, n);
+    return true;
+}
+
+// 4 x 16 outputs in 8 registers; per input channel, two loads of weights and four broadcasts of input values
+SIMD_TARGET static void ConvolutionBlockKernel(const float* const* src, const float* const* weights, size_t numTaps, size_t C, size_t ldw, float* out)
+{
+    __m256 acc00 = _mm256_setzero_ps(), acc01 = _mm256_setzero_ps();
+    __m256 acc10 = _mm256_setzero_ps(), acc11 = _mm256_setzero_ps();
+    __m256 acc20 = _mm256_setzero_ps(), acc21 = _mm256_setzero_ps();
+    __m256 acc30 = _mm256_setzero_ps(), acc31 = _mm256_setzero_ps();
+    for (size_t t = 0; t < numTaps; t++)
+    {
+        const float* s0 = src[4 * t];
+        const float* s1 = src[4 * t + 1];
+        const float* s2 = src[4 * t + 2];
+        const float* s3 = src[4 * t + 3];
+        const float* w = weights[t];
+        for (size_t c = 0; c < C; c++, w += ldw)
+        {
+            const __m256 w0 = _mm256_loadu_ps(w);
+            const __m256 w1 = _mm256_loadu_ps(w + 8);
+            __m256 a = _mm256_broadcast_ss(s0 + c);
+            acc00 = _mm256_fmadd_ps(a, w0, acc00);
+            acc01 = _mm256_fmadd_ps(a, w1, acc01);
+            a = _mm256_broadcast_ss(s1 + c);
+            acc10 = _mm256_fmadd_ps(a, w0, acc10);
+            acc11 = _mm256_fmadd_ps(a, w1, acc11);
+            a = _mm256_broadcast_ss(s2 + c);
+            acc20 = _mm256_fmadd_ps(a, w0, acc20);
+            acc21 = _mm256_fmadd_ps(a, w1, acc21);
+            a = _mm256_broadcast_ss(s3 + c);
+            acc30 = _mm256_fmadd_ps(a, w0, acc30);
+            acc31 = _mm256_fmadd_ps(a, w1, acc31);
+        }
+    }
+    _mm256_storeu_ps(out, acc00);
+    _mm256_storeu_ps(out + 8, acc01);
+    _mm256_storeu_ps(out + 16, acc10);
+    _mm256_storeu_ps(out + 24, acc11);
+    _mm256_storeu_ps(out + 32, acc20);
+    _mm256_storeu_ps(out + 40, acc21);
+    _mm256_storeu_ps(out + 48, acc30);
+    _mm256_storeu_ps(out + 56, acc31);
+}
+
+/*static*/ bool CPUSIMDKernels::TryConvolutionBlock(const float* const* src, const float* const* weights, size_t numTaps, size_t C, size_t ldw, float* out)
+{
+    if (!IsAvailable())
+        return false;
+    ConvolutionBlockKernel(src, weights, numTaps, C, ldw, out);
+    return true;
+}
+
+/*static*/ bool CPUSIMDKernels::TryInt8DotProducts(const signed char* a, const signed char* b, size_t ldb, size_t n, size_t k, int* results)
+{
+    if (!IsAvailable() || k % 16 != 0)
+        return false;
+    Int8DotProductsKernel(a, b, ldb, n, k, results);
+    return true;
+}
+} } }
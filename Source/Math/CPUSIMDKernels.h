@@ -0,0 +1,43 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUSIMDKernels.h -- explicitly vectorized (AVX2/FMA) kernels for the hot CPUMatrix element-wise ops and reductions
+//
+// All kernels operate on contiguous arrays (float, or int8 for quantized inference). They are compiled for AVX2
+// irrespective of the compiler flags, and are only called if the CPU supports AVX2 and FMA (checked once at runtime),
+// so CPUMatrix can call them unconditionally through the Try...() functions and fall back to its scalar code if they
+// return false.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct CPUSIMDKernels
+{
+    // true if the CPU (and OS) support AVX2 and FMA; determined once
+    static bool IsAvailable();
+
+    // c[i] = beta * c[i] + alpha * op(a[i]) for n contiguous elements  (c is not read if beta == 0)
+    // Returns false if 'op' has no SIMD implementation, or SIMD is not available.
+    static bool TryUnaryOp(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n);
+    // c[i] = beta * c[i] + alpha * op(a[i], b[i])
+    static bool TryBinaryOp(ElementWiseOperator op, float beta, const float* a, const float* b, float alpha, float* c, size_t n);
+
+    // c[0..n) = a[0..n) - log(sum(exp(a[0..n))))  (c may be a)
+    static bool TryLogSoftmax(const float* a, float* c, size_t n);
+    // sum of n contiguous elements, computed with 4 x 8 partial sums
+    static bool TrySum(const float* a, size_t n, float& sum);
+
+    // results[j] = sum_p a[p] * b[p + j * ldb] for j < n, over int8 vectors of length k (k must be a multiple of 16)
+    static bool TryInt8DotProducts(const signed char* a, const signed char* b, size_t ldb, size_t n, size_t k, int* results);
+
+    // block of 4 x 16 convolution outputs, for DirectConvolutionEngine:
+    // out[i * 16 + k] = sum_{t < numTaps} sum_{c < C} src[4 * t + i][c] * weights[t][c * ldw + k]  for i < 4, k < 16
+    static bool TryConvolutionBlock(const float* const* src, const float* const* weights, size_t numTaps, size_t C, size_t ldw, float* out);
+};
+} } }
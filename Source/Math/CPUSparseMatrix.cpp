@@ -17,6 +17,8 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <algorithm>
+#include <vector>
 #ifdef LEAKDETECT
 #include <vld.h>
 #endif
@@ -663,38 +665,44 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     if (rhs.GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
+    const size_t rows = lhs.GetNumRows();
+    const ElemType* lhsArray = lhs.BufferPointer();
+    ElemType* cArray = c.BufferPointer();
     if (!transposeA && !transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        // c(:,j) only depends on rhs(:,j), so the columns are computed in parallel
+#pragma omp parallel for
+        for (long j = 0; j < (long) rhs.GetNumCols(); j++)
         {
-            size_t start = rhs.m_compIndex[j]; // ColLocation
-            size_t end = rhs.m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
+            ElemType* cCol = cArray + j * rows;
+            for (size_t p = rhs.m_compIndex[j]; p < rhs.m_compIndex[j + 1]; p++)
             {
-                size_t i = rhs.m_unCompIndex[p]; // RowLocation
-                ElemType val = rhs.m_pArray[p];
-
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, j) += alpha * lhs(h, i) * val;
-                }
+                const ElemType* lhsCol = lhsArray + rhs.m_unCompIndex[p] * rows;
+                ElemType val = alpha * rhs.m_pArray[p];
+                for (size_t h = 0; h < rows; h++)
+                    cCol[h] += lhsCol[h] * val;
             }
         }
     }
     else if (!transposeA && transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        // c(:,i) receives from every column of rhs that has a value in row i; to avoid write conflicts, each thread
+        // takes a range of the rows of c and goes through all of rhs
+        const long numRanges = (long) min((size_t) omp_get_max_threads(), (rows + 31) / 32);
+#pragma omp parallel for
+        for (long r = 0; r < numRanges; r++)
         {
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+            const size_t hBegin = rows * r / numRanges;
+            const size_t hEnd = rows * (r + 1) / numRanges;
+            for (size_t j = 0; j < rhs.GetNumCols(); j++)
             {
-                size_t i = rhs.m_unCompIndex[p];
-                ElemType val = rhs.m_pArray[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
+                const ElemType* lhsCol = lhsArray + j * rows;
+                for (size_t p = rhs.m_compIndex[j]; p < rhs.m_compIndex[j + 1]; p++)
                 {
-                    c(h, i) += alpha * lhs(h, j) * val;
+                    ElemType* cCol = cArray + rhs.m_unCompIndex[p] * rows;
+                    ElemType val = alpha * rhs.m_pArray[p];
+                    for (size_t h = hBegin; h < hEnd; h++)
+                        cCol[h] += lhsCol[h] * val;
                 }
             }
         }
@@ -709,6 +717,70 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     }
 }
 
+// c = alpha * op(lhs) * rhs + beta * c, with a CSC lhs, e.g. pruned weights times dense activations
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    size_t m = transposeA ? lhs.GetNumCols() : lhs.GetNumRows();
+    size_t k = transposeA ? lhs.GetNumRows() : lhs.GetNumCols();
+    size_t l = transposeB ? rhs.GetNumCols() : rhs.GetNumRows();
+    size_t n = transposeB ? rhs.GetNumRows() : rhs.GetNumCols();
+
+    if (k != l)
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    if (transposeB || lhs.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    if (beta == 0)
+        c.Resize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    // c(:,j) only depends on rhs(:,j), so the columns are computed in parallel
+    const ElemType* rhsArray = rhs.BufferPointer();
+    ElemType* cArray = c.BufferPointer();
+    const size_t rhsRows = rhs.GetNumRows();
+#pragma omp parallel for
+    for (long j = 0; j < (long) n; j++)
+    {
+        const ElemType* rhsCol = rhsArray + j * rhsRows;
+        ElemType* cCol = cArray + j * m;
+        if (transposeA)
+        {
+            // c(i,j) = dot(lhs(:,i), rhs(:,j)), over the values of column i of lhs only
+            for (size_t i = 0; i < m; i++)
+            {
+                ElemType sum = 0;
+                for (size_t p = lhs.m_compIndex[i]; p < lhs.m_compIndex[i + 1]; p++)
+                    sum += lhs.m_pArray[p] * rhsCol[lhs.m_unCompIndex[p]];
+                cCol[i] = alpha * sum + (beta == 0 ? 0 : beta * cCol[i]);
+            }
+        }
+        else
+        {
+            // c(:,j) += lhs(:,h) * rhs(h,j) for each h, over the values of column h of lhs only
+            if (beta == 0)
+                memset(cCol, 0, sizeof(ElemType) * m);
+            else if (beta != 1)
+                for (size_t i = 0; i < m; i++)
+                    cCol[i] *= beta;
+            for (size_t h = 0; h < k; h++)
+            {
+                ElemType val = alpha * rhsCol[h];
+                if (val == 0)
+                    continue;
+                for (size_t p = lhs.m_compIndex[h]; p < lhs.m_compIndex[h + 1]; p++)
+                    cCol[lhs.m_unCompIndex[p]] += lhs.m_pArray[p] * val;
+            }
+        }
+    }
+}
+
 //c = alpha * op(lhs) * op(rhs)
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -749,42 +821,22 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         c.SetFormat(matrixFormatSparseBlockCol);
         c.Resize(m, n, m * min(n, rhs.m_nz), true, false);
 
+        // assign the blocks: one per word (row of rhs), in order of first occurrence
         map<size_t, size_t> w2Id;
+        vector<size_t> blockOf(rhs.m_compIndex[rhs.GetNumCols()]); // [p] -> block id of rhs value p
         for (size_t j = 0; j < rhs.GetNumCols(); j++)
         { // j ranges over batches
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+            for (size_t p = rhs.m_compIndex[j]; p < rhs.m_compIndex[j + 1]; p++)
             {
                 size_t i = rhs.m_unCompIndex[p]; // i ranges over words
-                ElemType val = rhs.m_pArray[p];  // 1 for(i, j)
-
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
+                auto iter = w2Id.find(i);
+                if (iter == w2Id.end())
                 {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
+                    iter = w2Id.insert(make_pair(i, w2Id.size())).first;
                     c.m_blockIds[c.m_blockSize] = i;
                     c.m_blockSize++;
                 }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.m_pArray[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.m_pArray[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
+                blockOf[p] = iter->second;
             }
         }
         c.m_nz = c.m_blockSize * m;
@@ -793,6 +845,29 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         {
             LogicError("sparse matrix out of range.");
         }
+        memset(c.m_pArray, 0, sizeof(ElemType) * c.m_nz);
+
+        // accumulate; a block receives from every column that has the word, so each thread takes a range of the hidden dimension
+        const size_t rows = lhs.GetNumRows();
+        const ElemType* lhsArray = lhs.BufferPointer();
+        const long numRanges = (long) min((size_t) omp_get_max_threads(), (rows + 31) / 32);
+#pragma omp parallel for
+        for (long r = 0; r < numRanges; r++)
+        {
+            const size_t hBegin = rows * r / numRanges;
+            const size_t hEnd = rows * (r + 1) / numRanges;
+            for (size_t j = 0; j < rhs.GetNumCols(); j++)
+            {
+                const ElemType* lhsCol = lhsArray + j * rows;
+                for (size_t p = rhs.m_compIndex[j]; p < rhs.m_compIndex[j + 1]; p++)
+                {
+                    ElemType* block = c.m_pArray + blockOf[p] * rows;
+                    ElemType val = alpha * rhs.m_pArray[p]; // 1 for(i, j)
+                    for (size_t h = hBegin; h < hEnd; h++) // h range over hidden layer
+                        block[h] += lhsCol[h] * val;
+                }
+            }
+        }
         // c.SetFormat(matrixFormatSparseBlockCol);
     }
     else if (transposeA && !transposeB)
@@ -805,6 +880,143 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
     }
 }
 
+// c = alpha * lhs * rhs^T, with lhs in CSC format and c in SparseBlockRow format
+// This is the gradient of a transposed weight multiplied by a sparse input (TransposeTimes): only the rows of lhs that
+// have values (e.g. the words in the minibatch) become blocks of c, so its size and the cost of the subsequent
+// sparse NormalGrad()/Adagrad() are independent of the number of rows (e.g. the vocabulary size).
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                               const CPUMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c)
+{
+    if (!c.OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndAdd:  one of the input matrix is empty.");
+
+    size_t m = transposeA ? lhs.GetNumCols() : lhs.GetNumRows();
+    size_t k = transposeA ? lhs.GetNumRows() : lhs.GetNumCols();
+    size_t l = transposeB ? rhs.GetNumCols() : rhs.GetNumRows();
+    size_t n = transposeB ? rhs.GetNumRows() : rhs.GetNumCols();
+
+    if (k != l)
+        InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a and b must match.");
+
+    if (transposeA || !transposeB || lhs.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    c.Reset();
+
+    // the rows of lhs with values, in increasing order, are the block ids of c
+    std::vector<size_t> rows(lhs.m_unCompIndex + lhs.m_compIndex[0], lhs.m_unCompIndex + lhs.m_compIndex[k]);
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    c.SetFormat(matrixFormatSparseBlockRow);
+    c.Resize(m, n, max(rows.size(), (size_t) 1) * n, true, false);
+    c.m_blockSize = rows.size();
+    c.m_nz = c.m_blockSize * n;
+    std::copy(rows.begin(), rows.end(), c.m_blockIds);
+    memset(c.m_pArray, 0, sizeof(ElemType) * c.m_nz);
+
+    const size_t firstValue = lhs.m_compIndex[0];
+    std::vector<size_t> blockOf(lhs.m_compIndex[k] - firstValue); // [p - firstValue] -> block id of lhs value p
+#pragma omp parallel for
+    for (long p = (long) firstValue; p < (long) lhs.m_compIndex[k]; p++)
+        blockOf[p - firstValue] = std::lower_bound(rows.begin(), rows.end(), (size_t) lhs.m_unCompIndex[p]) - rows.begin();
+
+    // a block receives from every column of lhs that has a value in its row, so each thread takes a range of the columns of c
+    const long numRanges = (long) min((size_t) omp_get_max_threads(), (n + 31) / 32);
+#pragma omp parallel for
+    for (long r = 0; r < numRanges; r++)
+    {
+        const size_t dBegin = n * r / numRanges;
+        const size_t dEnd = n * (r + 1) / numRanges;
+        for (size_t j = 0; j < k; j++)
+        {
+            const ElemType* rhsCol = rhs.BufferPointer() + j * rhs.GetNumRows(); // column j of rhs = column j of rhs^T, contiguous
+            for (size_t p = lhs.m_compIndex[j]; p < lhs.m_compIndex[j + 1]; p++)
+            {
+                ElemType val = alpha * lhs.m_pArray[p];
+                ElemType* block = c.m_pArray + blockOf[p - firstValue] * n;
+                for (size_t d = dBegin; d < dEnd; d++)
+                    block[d] += val * rhsCol[d];
+            }
+        }
+    }
+}
+
+// this = beta * this; this(:,idx[j]) += alpha * a(:,j), keeping this in SparseBlockCol format with one block per column
+// with values (beta must be 0 or 1). New blocks are merged with the existing ones, e.g. when an embedding is shared.
+template <class ElemType>
+CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (idx.GetNumElements() != a.GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: Input dimensions [%d x %d] do not match the index (%d elements) or the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) idx.GetNumElements(), (int) GetNumRows(), (int) GetNumCols());
+
+    if (beta == 0)
+        Reset();
+    else if (beta != 1)
+        NOT_IMPLEMENTED;
+
+    if (m_format != matrixFormatSparseBlockCol)
+    {
+        if (m_nz != 0)
+            NOT_IMPLEMENTED;
+        this->SetFormat(matrixFormatSparseBlockCol);
+    }
+
+    const ElemType* idxArray = idx.BufferPointer();
+    size_t m = GetNumRows();
+
+    // the block ids of the result: the existing ones plus the new indices, in increasing order
+    std::vector<size_t> oldIds(m_blockSize);
+    for (size_t b = 0; b < m_blockSize; b++)
+        oldIds[b] = m_blockIds[b] - m_blockIdShift;
+    std::vector<size_t> ids = oldIds;
+    for (size_t j = 0; j < a.GetNumCols(); j++)
+    {
+        if (idxArray[j] < 0)
+            continue;
+        if (idxArray[j] >= (ElemType) GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Index %d is out of range [0, %d).", (int) idxArray[j], (int) GetNumCols());
+        ids.push_back((size_t) idxArray[j]);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<ElemType> oldValues(m_nzValues, m_nzValues + m_nz);
+
+    Resize(m, GetNumCols(), max(ids.size(), (size_t) 1) * m, true, false);
+    m_blockSize = ids.size();
+    m_blockIdShift = 0;
+    m_nz = m_blockSize * m;
+    std::copy(ids.begin(), ids.end(), m_blockIds);
+    memset(m_pArray, 0, sizeof(ElemType) * m_nz);
+
+    for (size_t b = 0; b < oldIds.size(); b++)
+    {
+        size_t pos = std::lower_bound(ids.begin(), ids.end(), oldIds[b]) - ids.begin();
+        std::copy(oldValues.begin() + b * m, oldValues.begin() + (b + 1) * m, m_pArray + pos * m);
+    }
+    for (size_t j = 0; j < a.GetNumCols(); j++)
+    {
+        if (idxArray[j] < 0)
+            continue;
+        size_t pos = std::lower_bound(ids.begin(), ids.end(), (size_t) idxArray[j]) - ids.begin();
+        ElemType* block = m_pArray + pos * m;
+        const ElemType* col = a.BufferPointer() + j * m;
+        for (size_t i = 0; i < m; i++)
+            block[i] += alpha * col[i];
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, CPUMatrix<ElemType>& rhs)
 {
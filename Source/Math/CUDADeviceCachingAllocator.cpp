@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "CUDADeviceCachingAllocator.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for CUDA_CALL, GetStream()
+#include <cuda_runtime_api.h>
+#endif
+#include <algorithm>
+#include <memory>
+#include <new>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool CUDADeviceCachingAllocator::s_cachingEnabled = true;
+
+void CUDADeviceCachingAllocator::SetCachingEnabled(bool enabled)
+{
+    s_cachingEnabled = enabled;
+}
+
+CUDADeviceCachingAllocator& CUDADeviceCachingAllocator::ForDevice(int deviceId)
+{
+    // never destroyed: at process exit, the CUDA runtime may already be gone
+    static std::mutex allocatorsMutex;
+    static std::map<int, CUDADeviceCachingAllocator*> allocators;
+    std::lock_guard<std::mutex> lock(allocatorsMutex);
+    auto& allocator = allocators[deviceId];
+    if (allocator == nullptr)
+        allocator = new CUDADeviceCachingAllocator(deviceId);
+    return *allocator;
+}
+
+CUDADeviceCachingAllocator::CUDADeviceCachingAllocator(int deviceId)
+    : m_deviceId(deviceId)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+int CUDADeviceCachingAllocator::GetDeviceId() const
+{
+    return m_deviceId;
+}
+
+// Sizes are rounded up to 1/4 of their power of two (at least to 512 bytes), so that matrices that grow a little do
+// not each need a new buffer, while wasting at most 25%.
+/*static*/ size_t CUDADeviceCachingAllocator::SizeClass(size_t size)
+{
+    const size_t minStep = 512;
+    size_t powerOfTwo = 1;
+    while (powerOfTwo <= size / 2)
+        powerOfTwo *= 2;
+    size_t step = std::max(minStep, powerOfTwo / 4);
+    return std::max((size_t) 1, (size + step - 1) / step) * step;
+}
+
+CUDADeviceCachingAllocator::Statistics CUDADeviceCachingAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void CUDADeviceCachingAllocator::PrintStatistics(FILE* f) const
+{
+    Statistics stats = GetStatistics();
+    const double MB = 1024.0 * 1024.0;
+    fprintf(f, "CUDADeviceCachingAllocator device %d: %d allocations (%d from cache), in use %.2f MB, cached %.2f MB, peak %.2f MB\n",
+            m_deviceId, (int) stats.numAllocations, (int) stats.numCacheHits, stats.bytesInUse / MB, stats.bytesCached / MB, stats.peakBytes / MB);
+}
+
+#ifndef CPUONLY
+// out of device memory is reported as std::bad_alloc, like out of host memory, so that callers can tell it from other failures
+static void ThrowIfOutOfMemory(cudaError_t rc, int deviceId, size_t size)
+{
+    if (rc != cudaErrorMemoryAllocation)
+        return;
+    cudaGetLastError(); // clear the error
+    fprintf(stderr, "CUDADeviceCachingAllocator: out of memory on device %d, allocating %.2f MB\n", deviceId, size / (1024.0 * 1024.0));
+    throw std::bad_alloc();
+}
+
+void* CUDADeviceCachingAllocator::Malloc(size_t size)
+{
+    if (size == 0)
+        return nullptr;
+    PrepareDevice(m_deviceId);
+    if (!s_cachingEnabled)
+    {
+        void* p;
+        cudaError_t rc = cudaMalloc(&p, size);
+        ThrowIfOutOfMemory(rc, m_deviceId, size);
+        CUDA_CALL(rc);
+        return p;
+    }
+
+    void* stream = (void*) GetStream();
+    size_t sizeClass = SizeClass(size);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.numAllocations++;
+        auto freeList = m_freeLists.find(std::make_pair(stream, sizeClass));
+        if (freeList != m_freeLists.end() && !freeList->second.empty())
+        {
+            void* p = freeList->second.back();
+            freeList->second.pop_back();
+            m_inUse[p] = Buffer{sizeClass, stream};
+            m_stats.numCacheHits++;
+            m_stats.bytesCached -= sizeClass;
+            m_stats.bytesInUse += sizeClass;
+            return p;
+        }
+    }
+
+    void* p;
+    cudaError_t rc = cudaMalloc(&p, sizeClass);
+    if (rc == cudaErrorMemoryAllocation)
+    {
+        cudaGetLastError(); // clear the error
+        ReleaseCached();
+        rc = cudaMalloc(&p, sizeClass);
+    }
+    ThrowIfOutOfMemory(rc, m_deviceId, sizeClass);
+    CUDA_CALL(rc);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inUse[p] = Buffer{sizeClass, stream};
+    m_stats.bytesInUse += sizeClass;
+    m_stats.peakBytes = std::max(m_stats.peakBytes, m_stats.bytesInUse + m_stats.bytesCached);
+    return p;
+}
+
+void CUDADeviceCachingAllocator::Free(void* p)
+{
+    Free(p, false);
+}
+
+void CUDADeviceCachingAllocator::Free(void* p, bool ignoreCUDARetCode)
+{
+    if (p == nullptr)
+        return;
+    if (s_cachingEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto buffer = m_inUse.find(p);
+        if (buffer != m_inUse.end()) // else allocated while caching was disabled
+        {
+            m_freeLists[std::make_pair(buffer->second.stream, buffer->second.size)].push_back(p);
+            m_stats.bytesInUse -= buffer->second.size;
+            m_stats.bytesCached += buffer->second.size;
+            m_inUse.erase(buffer);
+            return;
+        }
+    }
+    PrepareDevice(m_deviceId);
+    if (ignoreCUDARetCode)
+        cudaFree(p);
+    else
+        CUDA_CALL(cudaFree(p));
+}
+
+void CUDADeviceCachingAllocator::ReleaseCached()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PrepareDevice(m_deviceId);
+    for (auto& freeList : m_freeLists)
+    {
+        for (void* p : freeList.second)
+            CUDA_CALL(cudaFree(p));
+        m_stats.bytesCached -= freeList.first.second * freeList.second.size();
+    }
+    m_freeLists.clear();
+}
+#else
+// Dummy definitions when compiling for CPUONLY
+void* CUDADeviceCachingAllocator::Malloc(size_t)
+{
+    return nullptr;
+}
+
+void CUDADeviceCachingAllocator::Free(void*)
+{
+}
+
+void CUDADeviceCachingAllocator::Free(void*, bool)
+{
+}
+
+void CUDADeviceCachingAllocator::ReleaseCached()
+{
+}
+#endif
+} } }
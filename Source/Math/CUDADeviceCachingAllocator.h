@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CUDADeviceCachingAllocator.h -- device memory allocator that keeps freed buffers for reuse
+//
+// cudaFree() implicitly synchronizes the device, and cudaMalloc() often does, which serializes the otherwise asynchronous
+// compute and transfer streams whenever a matrix is resized. This allocator, through which TracingGPUMemoryAllocator
+// routes all GPUMatrix/GPUSparseMatrix buffers, returns freed buffers to free lists instead, one per size class and
+// stream, and hands them out again to allocations of the same size class on the same stream. Since work on one stream
+// executes in order, a buffer freed while kernels using it are still queued can be reused right away on that stream.
+// If cudaMalloc() runs out of memory, all cached buffers of the device are released and the allocation is retried; if
+// that fails too, std::bad_alloc is thrown (see SGD's 'recoverFromOutOfMemory').
+//
+
+#pragma once
+
+#include "MemAllocator.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CUDADeviceCachingAllocator : public MemAllocator
+{
+public:
+    struct Statistics
+    {
+        size_t numAllocations; // Malloc() calls
+        size_t numCacheHits;   // ... served from the free lists
+        size_t bytesInUse;     // handed out and not freed
+        size_t bytesCached;    // freed and kept for reuse
+        size_t peakBytes;      // high-water mark of bytesInUse + bytesCached, i.e. of the memory obtained from CUDA
+    };
+
+    CUDADeviceCachingAllocator(int deviceId);
+
+    // the allocator of a device, created on first use; lives until the end of the process
+    static CUDADeviceCachingAllocator& ForDevice(int deviceId);
+
+    // with caching disabled (e.g. for cuda-memcheck), Malloc() and Free() call cudaMalloc() and cudaFree() directly
+    static void SetCachingEnabled(bool enabled);
+
+    int GetDeviceId() const;
+    void* Malloc(size_t size) override; // for use on the current compute stream (GetStream())
+    void Free(void* p) override;
+    void Free(void* p, bool ignoreCUDARetCode); // for buffers freed during shutdown, when CUDA may be gone
+
+    // return all cached buffers to CUDA; called when cudaMalloc() fails, but may also be used before handing
+    // memory to another library
+    void ReleaseCached();
+
+    Statistics GetStatistics() const;
+    void PrintStatistics(FILE* f) const;
+
+private:
+    static size_t SizeClass(size_t size);
+
+    struct Buffer
+    {
+        size_t size;  // size class
+        void* stream; // cudaStream_t the buffer was allocated for
+    };
+
+    int m_deviceId;
+    mutable std::mutex m_mutex;
+    std::map<void*, Buffer> m_inUse;
+    std::map<std::pair<void*, size_t>, std::vector<void*>> m_freeLists; // [(stream, size class)]
+    Statistics m_stats;
+
+    static bool s_cachingEnabled;
+};
+} } }
@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "CUDAStreamFork.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for CUDA_CALL, GetStream(), SetStream()
+#include <cuda_runtime_api.h>
+#endif
+#include <map>
+#include <mutex>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifndef CPUONLY
+// the streams of the branches, created on first use; never destroyed, like the per-stream cuBLAS handles that get bound to them
+static cudaStream_t GetBranchStream(int deviceId, size_t branch)
+{
+    static std::mutex streamsMutex;
+    static std::map<std::pair<int, size_t>, cudaStream_t> streams;
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    auto& stream = streams[std::make_pair(deviceId, branch)];
+    if (stream == nullptr)
+        CUDA_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking)); // not ordered with the default stream, see header
+    return stream;
+}
+
+CUDAStreamFork::CUDAStreamFork(int deviceId, size_t numBranches)
+    : m_deviceId(deviceId), m_originStream((void*) GetStream()), m_joined(deviceId < 0)
+{
+    if (m_deviceId < 0)
+        return;
+    PrepareDevice(m_deviceId);
+    cudaEvent_t forked;
+    CUDA_CALL(cudaEventCreateWithFlags(&forked, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(forked, (cudaStream_t) m_originStream));
+    for (size_t i = 0; i < numBranches; i++)
+    {
+        cudaStream_t stream = GetBranchStream(m_deviceId, i);
+        CUDA_CALL(cudaStreamWaitEvent(stream, forked, 0));
+        m_streams.push_back(stream);
+    }
+    cudaEventDestroy(forked); // (released once the waits are done)
+}
+
+CUDAStreamFork::~CUDAStreamFork()
+{
+    if (!m_joined)
+    {
+        try
+        {
+            Join();
+        }
+        catch (...) // (must not throw from a destructor; the error will show up again with the next CUDA call)
+        {
+        }
+    }
+}
+
+void CUDAStreamFork::Join()
+{
+    if (m_joined)
+        return;
+    m_joined = true;
+    for (auto stream : m_streams)
+    {
+        cudaEvent_t done;
+        CUDA_CALL(cudaEventCreateWithFlags(&done, cudaEventDisableTiming));
+        CUDA_CALL(cudaEventRecord(done, (cudaStream_t) stream));
+        CUDA_CALL(cudaStreamWaitEvent((cudaStream_t) m_originStream, done, 0));
+        cudaEventDestroy(done);
+    }
+}
+
+CUDAStreamFork::BranchScope::BranchScope(const CUDAStreamFork& fork, size_t branch)
+    : m_prevStream((void*) GetStream()), m_active(fork.m_deviceId >= 0)
+{
+    if (!m_active)
+        return;
+    if (branch >= fork.m_streams.size())
+        LogicError("CUDAStreamFork: Branch index %d out of range.", (int) branch);
+    CUDA_CALL(cudaSetDevice(fork.m_deviceId)); // (the thread may be new, so PrepareDevice()'s cache does not apply)
+    SetStream((cudaStream_t) fork.m_streams[branch]);
+}
+
+CUDAStreamFork::BranchScope::~BranchScope()
+{
+    if (m_active)
+        SetStream((cudaStream_t) m_prevStream);
+}
+#else
+// Dummy definitions when compiling for CPUONLY
+CUDAStreamFork::CUDAStreamFork(int deviceId, size_t)
+    : m_deviceId(deviceId), m_originStream(nullptr), m_joined(true)
+{
+}
+
+CUDAStreamFork::~CUDAStreamFork()
+{
+}
+
+void CUDAStreamFork::Join()
+{
+}
+
+CUDAStreamFork::BranchScope::BranchScope(const CUDAStreamFork&, size_t)
+    : m_prevStream(nullptr), m_active(false)
+{
+}
+
+CUDAStreamFork::BranchScope::~BranchScope()
+{
+}
+#endif
+} } }
@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CUDAStreamFork.h -- run independent pieces of GPU work concurrently, each on its own stream
+//
+// A fork makes each branch's stream wait for the work issued so far on the current thread's stream, and Join() makes
+// the current stream wait for all branches, so that the branches appear to the rest of the work as if they had been
+// issued on the current stream. The branch streams do not synchronize with the default stream, so the branches
+// overlap with each other. A branch may be issued from another thread than the one that created the fork.
+// For CPU devices and in CPU-only builds, all of this does nothing.
+//
+
+#pragma once
+
+#include "MemAllocator.h" // for MATH_API
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CUDAStreamFork
+{
+public:
+    CUDAStreamFork(int deviceId, size_t numBranches);
+    ~CUDAStreamFork(); // joins if Join() was not called, e.g. because a branch threw
+
+    void Join();
+
+    // routes the current thread's GPUMatrix work to the stream of one branch for the scope
+    class MATH_API BranchScope
+    {
+    public:
+        BranchScope(const CUDAStreamFork& fork, size_t branch);
+        ~BranchScope();
+
+    private:
+        BranchScope(const BranchScope&) = delete;
+        void operator=(const BranchScope&) = delete;
+        void* m_prevStream; // cudaStream_t
+        bool m_active;
+    };
+
+private:
+    CUDAStreamFork(const CUDAStreamFork&) = delete;
+    void operator=(const CUDAStreamFork&) = delete;
+
+    int m_deviceId;
+    void* m_originStream;         // cudaStream_t of the thread that forked
+    std::vector<void*> m_streams; // cudaStream_t per branch
+    bool m_joined;
+};
+} } }
@@ -137,7 +137,8 @@ public:
                 // quantize
                 size_t ij = ColMIDX(i, colIdx, M);
                 ElemType val = inMat[ij] + inResidual[ij];
-                QWordVal qval = valQ.Quantize<ZeroThresholdFor1Bit>(val);
+                // Explicit use of 'template' keyword is needed to compile with GCC
+                QWordVal qval = valQ.template Quantize<ZeroThresholdFor1Bit>(val);
 
                 // compute residual
                 ElemType uval = valQ.Unquantize(qval);
@@ -37,6 +37,7 @@
 #define CPUSPARSE_INDEX_TYPE int // to be consistent with cuSparse but limited the possible size of the matrix.
 
 MATH_API DEVICEID_TYPE EnforceOneGPUOnly(DEVICEID_TYPE requestedDeviceId);
+MATH_API void AllowAdditionalGPU(DEVICEID_TYPE deviceId);
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -113,6 +114,10 @@ enum ElementWiseOperator
     opElementwiseProductWithLinearRectifierDerivativeFromOutput,
     opElementwiseProductWithLogDerivativeFromOutput,
     opElementwiseProductWithCosDerivative,
+    // binary ops that fuse a sum with a subsequent nonlinearity (elementwise fusion of Plus -> Sigmoid etc.)
+    opSigmoidOfSum,
+    opTanhOfSum,
+    opLinearRectifierOfSum,
     // binary ops for indexing
     // opIndex,
     // ternary
@@ -160,7 +165,10 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithTanhDerivativeFromOutput);            \
     Macro(ElementwiseProductWithLinearRectifierDerivativeFromOutput); \
     Macro(ElementwiseProductWithLogDerivativeFromOutput);             \
-    Macro(ElementwiseProductWithCosDerivative); \
+    Macro(ElementwiseProductWithCosDerivative);                       \
+    Macro(SigmoidOfSum);                                              \
+    Macro(TanhOfSum);                                                 \
+    Macro(LinearRectifierOfSum);                                      \
 //Macro(Index);
 
 #define ForAllTernaryOps(Macro) \
@@ -178,6 +186,7 @@ enum MatrixFlagBitPosition
     bitPosCompressed = 2,       // a compressed sparse format (CSC/CSR)
     bitPosDontOwnBuffer = 3,    // buffer is not owned by this matrix
     bitPosSetValueOnDevice = 4, // in a setValue situation, the copy from buffer is already on the device
+    bitPosSetValueAsync = 5,    // in a setValue situation, the buffer is page-locked host memory that may be uploaded asynchronously
 };
 
 enum MatrixFormat
@@ -204,6 +213,48 @@ enum MatrixFlags
     matrixFlagNormal = 0,
     matrixFlagDontOwnBuffer = 1 << bitPosDontOwnBuffer,       // the matrix memory pointers are externally managed, don't allocate/free or attempt to copy to another location
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
+    matrixFlagSetValueAsync = 1 << bitPosSetValueAsync,       // SetValue() or SetMatrixFromCSCFormat() call has page-locked host buffers that must stay unchanged until WaitForAsyncSetValues()
+};
+
+// -----------------------------------------------------------------------
+// fused optimizer step over many parameters, see Matrix<ElemType>::MultiTensorUpdate()
+// -----------------------------------------------------------------------
+
+enum class MultiTensorUpdateRule : int
+{
+    NormalGrad,   // momentum SGD; smoothed gradient: the momentum
+    NesterovGrad, // same with Nesterov momentum
+    Adagrad,      // smoothed gradient: the accumulated squares
+    FSAdagrad,    // smoothed gradient: [adagrad state | momentum]
+    RmsProp,      // smoothed gradient: [avars | signs | steps]
+    Adam,         // smoothed gradient: [first moment | second moment]
+};
+
+// scalars shared by all parameters of a fused step; same meaning as the arguments of SGD::UpdateWeightsS()
+template <class ElemType>
+struct MultiTensorUpdateParams
+{
+    MultiTensorUpdateRule rule;
+    ElemType learnRatePerSample;
+    ElemType momentum;      // per minibatch
+    ElemType clipThreshold; // truncate gradients to [-clipThreshold, clipThreshold]; 0 for no clipping
+    ElemType L2RegWeight;   // already multiplied by the minibatch size
+    ElemType L1Threshold;   // soft-threshold of the L1 proximal step (learnRatePerSample * L1RegWeight * minibatch size); 0 for none
+    ElemType adaWeight;     // FSAdagrad: weight of the previous state
+    ElemType rmsGamma, rmsWgtInc, rmsWgtMax, rmsWgtDec, rmsWgtMin; // RmsProp
+    ElemType adamBeta1, adamBeta2, adamEpsilon;                    // Adam
+    ElemType adamBiasCorrection1, adamBiasCorrection2;             // Adam: 1 / (1 - beta^step) of the two moments
+};
+
+// one dense parameter of a fused step; pointers into device memory for GPU steps
+template <class ElemType>
+struct MultiTensorUpdateTensor
+{
+    ElemType* value;
+    ElemType* gradient;
+    ElemType* smoothedGradient; // as many blocks of 'size' elements as the rule needs
+    size_t size;
+    ElemType adaMul; // FSAdagrad: this parameter's multiplier, see Matrix<ElemType>::FSAdagradScalars()
 };
 
 // -----------------------------------------------------------------------
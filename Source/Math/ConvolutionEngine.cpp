@@ -6,9 +6,551 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnConvolutionEngine.h"
+#include "CPUSIMDKernels.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Convolution of volumetric tensors on the CPU, for the cuDNN layout (ImageLayoutKind::CHW), so that models trained with
+// cuDNN's Nd convolutions also run without it. Each channel of a sample is W x H x D, W varying fastest; the weights of
+// output channel k are C x D" x H" x W" at offset k * C*D"*H"*W" in the weight matrix's buffer, which is how cuDNN reads
+// them. This is a direct implementation that visits every pair of output position and kernel tap; it runs in parallel
+// over samples (over output channels for the filter gradient), and is the generic fallback rather than a tuned kernel.
+template <class ElemType>
+class VolumetricConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using typename Base::Tensor4D;
+    using typename Base::Filter;
+    using typename Base::ConvDesc;
+
+public:
+    void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                 const Tensor4D& outT, Mat& out, Mat& /*workspace*/) override
+    {
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
+        assert(inT.n() == in.GetNumCols());
+        assert(filterT.k() == filter.GetNumRows());
+        assert(filterT.w() * filterT.h() * filterT.d() * filterT.c() == filter.GetNumCols());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
+        VerifyOnCPU(in, filter, out);
+
+        const Geometry g(inT, filterT, convDesc, outT);
+        const ElemType* pin = in.BufferPointer();
+        const ElemType* pfilter = filter.BufferPointer();
+        ElemType* pout = out.BufferPointer();
+#pragma omp parallel for
+        for (long n = 0; n < (long) inT.n(); n++)
+        {
+            const ElemType* x = pin + n * g.inSize;
+            ElemType* y = pout + n * g.outSize;
+            std::fill(y, y + g.outSize, (ElemType) 0);
+            for (size_t k = 0; k < g.k; k++)
+                g.ForEachTap(k, [=](size_t i, size_t f, size_t o)
+                             {
+                                 y[o] += x[i] * pfilter[f];
+                             });
+        }
+    }
+
+    // adds to 'grad', as cuDNN does
+    void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                      const Tensor4D& gradT, Mat& grad, Mat& /*workspace*/) override
+    {
+        assert(srcGradT.w() * srcGradT.h() * srcGradT.d() * srcGradT.c() == srcGrad.GetNumRows());
+        assert(gradT.w() * gradT.h() * gradT.d() * gradT.c() == grad.GetNumRows());
+        assert(gradT.n() == grad.GetNumCols());
+        VerifyOnCPU(srcGrad, filter, grad);
+
+        const Geometry g(gradT, filterT, convDesc, srcGradT);
+        const ElemType* psrcGrad = srcGrad.BufferPointer();
+        const ElemType* pfilter = filter.BufferPointer();
+        ElemType* pgrad = grad.BufferPointer();
+#pragma omp parallel for
+        for (long n = 0; n < (long) gradT.n(); n++)
+        {
+            const ElemType* dy = psrcGrad + n * g.outSize;
+            ElemType* dx = pgrad + n * g.inSize;
+            for (size_t k = 0; k < g.k; k++)
+                g.ForEachTap(k, [=](size_t i, size_t f, size_t o)
+                             {
+                                 dx[i] += dy[o] * pfilter[f];
+                             });
+        }
+    }
+
+    // adds to 'filter', as cuDNN does
+    void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
+                        const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        assert(srcGradT.w() * srcGradT.h() * srcGradT.d() * srcGradT.c() == srcGrad.GetNumRows());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
+        assert(filterT.w() * filterT.h() * filterT.d() * filterT.c() == filter.GetNumCols());
+        VerifyOnCPU(in, srcGrad, filter);
+
+        const Geometry g(inT, filterT, convDesc, srcGradT);
+        const ElemType* psrcGrad = srcGrad.BufferPointer();
+        const ElemType* pin = in.BufferPointer();
+        ElemType* pfilter = filter.BufferPointer();
+        // (each output channel has weights of its own, so they can be accumulated without races)
+#pragma omp parallel for
+        for (long k = 0; k < (long) g.k; k++)
+        {
+            for (size_t n = 0; n < inT.n(); n++)
+            {
+                const ElemType* x = pin + n * g.inSize;
+                const ElemType* dy = psrcGrad + n * g.outSize;
+                g.ForEachTap(k, [=](size_t i, size_t f, size_t o)
+                             {
+                                 pfilter[f] += dy[o] * x[i];
+                             });
+            }
+        }
+    }
+
+    void AddBias(const Tensor4D& outT, const Mat& out, const Tensor4D& biasT, const Mat& bias, Mat& dst) override
+    {
+        assert(biasT.c() == outT.c());
+        assert(bias.GetNumElements() == outT.c());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
+        assert(dst.GetNumRows() == out.GetNumRows() && dst.GetNumCols() == out.GetNumCols());
+        UNUSED(biasT);
+        VerifyOnCPU(out, bias, dst);
+
+        const size_t planeSize = outT.w() * outT.h() * outT.d();
+        const ElemType* pout = out.BufferPointer();
+        const ElemType* pbias = bias.BufferPointer();
+        ElemType* pdst = dst.BufferPointer();
+#pragma omp parallel for
+        for (long n = 0; n < (long) outT.n(); n++)
+            for (size_t c = 0; c < outT.c(); c++)
+            {
+                size_t offset = (n * outT.c() + c) * planeSize;
+                for (size_t j = 0; j < planeSize; j++)
+                    pdst[offset + j] = pout[offset + j] + pbias[c];
+            }
+    }
+
+    // adds to 'biasGrad', as cuDNN does
+    void BackwardBias(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& biasT, Mat& biasGrad) override
+    {
+        assert(biasT.c() == srcGradT.c());
+        assert(biasGrad.GetNumElements() == srcGradT.c());
+        UNUSED(biasT);
+        VerifyOnCPU(srcGrad, srcGrad, biasGrad);
+
+        const size_t planeSize = srcGradT.w() * srcGradT.h() * srcGradT.d();
+        const ElemType* psrcGrad = srcGrad.BufferPointer();
+        ElemType* pbiasGrad = biasGrad.BufferPointer();
+#pragma omp parallel for
+        for (long c = 0; c < (long) srcGradT.c(); c++)
+        {
+            ElemType sum = 0;
+            for (size_t n = 0; n < srcGradT.n(); n++)
+            {
+                const ElemType* dy = psrcGrad + (n * srcGradT.c() + c) * planeSize;
+                for (size_t j = 0; j < planeSize; j++)
+                    sum += dy[j];
+            }
+            pbiasGrad[c] += sum;
+        }
+    }
+
+    void NormalizeBatch(const Tensor4D&, const Mat&, const Tensor4D&, const Mat&, const Mat&,
+                        bool, double, Mat&, Mat&, Mat&, Mat&, Mat&) override
+    {
+        RuntimeError("Batch normalization of volumetric tensors requires cuDNN.");
+    }
+
+    void NormalizeBatchInference(const Tensor4D&, const Mat&, const Tensor4D&, const Mat&, const Mat&,
+                                 bool, const Mat&, const Mat&, Mat&) override
+    {
+        RuntimeError("Batch normalization of volumetric tensors requires cuDNN.");
+    }
+
+    void BackwardNormalizeBatch(const Tensor4D&, const Mat&, const Mat&, Mat&,
+                                const Tensor4D&, const Mat&, bool, const Mat&, const Mat&, Mat&, Mat&) override
+    {
+        RuntimeError("Batch normalization of volumetric tensors requires cuDNN.");
+    }
+
+    static void VerifyOnCPU(const Mat& a, const Mat& b, const Mat& c)
+    {
+        for (const Mat* m : {&a, &b, &c})
+            if (m->GetMatrixType() != MatrixType::DENSE || m->GetCurrentMatrixLocation() != CurrentDataLocation::CPU)
+                RuntimeError("Volumetric (3-D) convolution and pooling on the GPU require cuDNN; without it, they only run on the CPU, on dense data.");
+    }
+
+private:
+    // sizes of the input, filter and output of one sample, and the offsets of the taps
+    struct Geometry
+    {
+        size_t w, h, d, c;    // input
+        size_t fw, fh, fd, k; // filter
+        size_t ow, oh, od;    // output
+        size_t sw, sh, sd;    // strides
+        int pw, ph, pd;       // padding (cuDNN's: half the kernel)
+        size_t inSize, outSize;
+
+        Geometry(const Tensor4D& inT, const Filter& filterT, const ConvDesc& convDesc, const Tensor4D& outT)
+            : w(inT.w()), h(inT.h()), d(inT.d()), c(inT.c()),
+              fw(filterT.w()), fh(filterT.h()), fd(filterT.d()), k(filterT.k()),
+              ow(outT.w()), oh(outT.h()), od(outT.d()),
+              sw(convDesc.wStride()), sh(convDesc.hStride()), sd(convDesc.dStride()),
+              pw(convDesc.padding() ? (int) fw / 2 : 0), ph(convDesc.padding() ? (int) fh / 2 : 0), pd(convDesc.padding() ? (int) fd / 2 : 0),
+              inSize(w * h * d * c), outSize(ow * oh * od * outT.c())
+        {
+            assert(filterT.c() == c && outT.c() == k);
+        }
+
+        // calls f(input offset, filter offset, output offset) for each output position of channel k and each kernel tap
+        // that falls inside the input; the offsets are within a sample, and within the filter
+        template <class F>
+        void ForEachTap(size_t kk, const F& f) const
+        {
+            for (size_t oz = 0; oz < od; oz++)
+                for (size_t oy = 0; oy < oh; oy++)
+                    for (size_t ox = 0; ox < ow; ox++)
+                    {
+                        const size_t o = ((kk * od + oz) * oh + oy) * ow + ox;
+                        const int z0 = (int) (oz * sd) - pd, y0 = (int) (oy * sh) - ph, x0 = (int) (ox * sw) - pw;
+                        for (size_t cc = 0; cc < c; cc++)
+                            for (size_t fz = 0; fz < fd; fz++)
+                            {
+                                const int z = z0 + (int) fz;
+                                if (z < 0 || z >= (int) d)
+                                    continue;
+                                for (size_t fy = 0; fy < fh; fy++)
+                                {
+                                    const int y = y0 + (int) fy;
+                                    if (y < 0 || y >= (int) h)
+                                        continue;
+                                    const size_t rowOffset = ((cc * d + z) * h + y) * w;
+                                    const size_t filterRowOffset = (((kk * c + cc) * fd + fz) * fh + fy) * fw;
+                                    for (size_t fx = 0; fx < fw; fx++)
+                                    {
+                                        const int x = x0 + (int) fx;
+                                        if (x >= 0 && x < (int) w)
+                                            f(rowOffset + x, filterRowOffset + fx, o);
+                                    }
+                                }
+                            }
+                    }
+        }
+    };
+};
+
+// Batch normalization of dense data on the CPU, for DefaultConvolutionEngine. The batch statistics (mean and biased
+// variance over the minibatch, and over the pixels of a channel if spatial), the epsilon and the gradients are those of
+// the cuDNN engine; runMean and runInvStdDev are exponential averages of the batch mean and inverse standard deviation,
+// and inference normalizes with them. The backward pass adds to the input gradient and overwrites the scale and bias
+// gradients, as cuDNN does.
+// A sample is viewed as [outer x C x inner], C being the number of channels (or of elements, if not spatial): with HWC,
+// the channel varies fastest (inner = 1), with CHW slowest (outer = 1). The sums run in parallel over blocks of
+// channels and chunks of samples, into partial sums that are added up at the end; the element-wise passes run in
+// parallel over rows of C x inner elements. The innermost loops run over contiguous elements (channels with HWC,
+// pixels with CHW), which the compiler vectorizes.
+template <class ElemType>
+class CPUBatchNormalization
+{
+public:
+    typedef Matrix<ElemType> Mat;
+
+    static bool IsOnCPU(const Mat& in, const Mat& out)
+    {
+        return in.GetMatrixType() == MatrixType::DENSE && in.GetCurrentMatrixLocation() == CurrentDataLocation::CPU &&
+               out.GetMatrixType() == MatrixType::DENSE && out.GetCurrentMatrixLocation() == CurrentDataLocation::CPU;
+    }
+
+    void Forward(const ConvolutionTensor4D& inT, const Mat& in, const Mat& scale, const Mat& bias, bool spatial, ImageLayoutKind imageLayoutKind,
+                 double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev)
+    {
+        const Shape s(inT, spatial, imageLayoutKind);
+        const size_t N = in.GetNumCols();
+        assert(in.GetNumRows() == s.SampleSize() && out.GetNumRows() == in.GetNumRows() && out.GetNumCols() == N);
+        assert(scale.GetNumElements() == s.C && runMean.GetNumElements() == s.C && saveMean.GetNumElements() >= s.C);
+        const ElemType* x = in.BufferPointer();
+        const double count = (double) (N * s.outer * s.inner);
+
+        // mean, then the variance as the mean of the squared deviations (more accurate than E[x^2] - E[x]^2)
+        Reduce(s, N, [x, &s](size_t offset, size_t, size_t nc, double* sum, double*)
+               {
+                   SumRow(s.inner, nc, x + offset, sum);
+               });
+        m_mean.resize(s.C);
+        for (size_t c = 0; c < s.C; c++)
+            m_mean[c] = m_sum[c] / count;
+        const double* mean = m_mean.data();
+        Reduce(s, N, [x, mean, &s](size_t offset, size_t c0, size_t nc, double* sum, double*)
+               {
+                   SumSquaredDeviationsRow(s.inner, nc, x + offset, mean + c0, sum);
+               });
+
+        const ElemType* pscale = scale.BufferPointer();
+        const ElemType* pbias = bias.BufferPointer();
+        ElemType* prunMean = runMean.BufferPointer();
+        ElemType* prunInvStdDev = runInvStdDev.BufferPointer();
+        ElemType* psaveMean = saveMean.BufferPointer();
+        ElemType* psaveInvStdDev = saveInvStdDev.BufferPointer();
+        m_a.resize(s.C);
+        m_b.resize(s.C);
+        for (size_t c = 0; c < s.C; c++)
+        {
+            const double invStdDev = 1 / sqrt(m_sum[c] / count + Epsilon());
+            psaveMean[c] = (ElemType) m_mean[c];
+            psaveInvStdDev[c] = (ElemType) invStdDev;
+            prunMean[c] = (ElemType) ((1 - expAvgFactor) * prunMean[c] + expAvgFactor * m_mean[c]);
+            prunInvStdDev[c] = (ElemType) ((1 - expAvgFactor) * prunInvStdDev[c] + expAvgFactor * invStdDev);
+            m_a[c] = (ElemType) (pscale[c] * invStdDev);
+            m_b[c] = (ElemType) (pbias[c] - m_mean[c] * pscale[c] * invStdDev);
+        }
+        Affine(s, N, x, out.BufferPointer());
+    }
+
+    void ForwardInference(const ConvolutionTensor4D& inT, const Mat& in, const Mat& scale, const Mat& bias, bool spatial, ImageLayoutKind imageLayoutKind,
+                          const Mat& runMean, const Mat& runInvStdDev, Mat& out)
+    {
+        const Shape s(inT, spatial, imageLayoutKind);
+        assert(in.GetNumRows() == s.SampleSize() && out.GetNumRows() == in.GetNumRows() && out.GetNumCols() == in.GetNumCols());
+        assert(scale.GetNumElements() == s.C && runMean.GetNumElements() == s.C && runInvStdDev.GetNumElements() == s.C);
+        const ElemType* pscale = scale.BufferPointer();
+        const ElemType* pbias = bias.BufferPointer();
+        const ElemType* prunMean = runMean.BufferPointer();
+        const ElemType* prunInvStdDev = runInvStdDev.BufferPointer();
+        m_a.resize(s.C);
+        m_b.resize(s.C);
+        for (size_t c = 0; c < s.C; c++)
+        {
+            m_a[c] = pscale[c] * prunInvStdDev[c];
+            m_b[c] = pbias[c] - prunMean[c] * m_a[c];
+        }
+        Affine(s, in.GetNumCols(), in.BufferPointer(), out.BufferPointer());
+    }
+
+    void Backward(const ConvolutionTensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, bool spatial, ImageLayoutKind imageLayoutKind,
+                  const Mat& saveMean, const Mat& saveInvStdDev, Mat& scaleGrad, Mat& biasGrad)
+    {
+        const Shape s(inT, spatial, imageLayoutKind);
+        const size_t N = in.GetNumCols();
+        assert(in.GetNumRows() == s.SampleSize() && srcGrad.GetNumRows() == in.GetNumRows() && srcGrad.GetNumCols() == N);
+        assert(grad.GetNumRows() == in.GetNumRows() && grad.GetNumCols() == N);
+        assert(scale.GetNumElements() == s.C && saveMean.GetNumElements() >= s.C && saveInvStdDev.GetNumElements() >= s.C);
+        assert(scaleGrad.GetNumElements() == s.C && biasGrad.GetNumElements() == s.C);
+        const ElemType* x = in.BufferPointer();
+        const ElemType* dy = srcGrad.BufferPointer();
+        const double count = (double) (N * s.outer * s.inner);
+
+        // sum of dy (the bias gradient) and of dy * (x - mean)
+        const ElemType* psaveMean = saveMean.BufferPointer();
+        m_mean.assign(psaveMean, psaveMean + s.C);
+        const double* mean = m_mean.data();
+        Reduce(s, N, [x, dy, mean, &s](size_t offset, size_t c0, size_t nc, double* sum, double* sum2)
+               {
+                   SumRow(s.inner, nc, dy + offset, sum);
+                   SumProductsRow(s.inner, nc, dy + offset, x + offset, mean + c0, sum2);
+               });
+
+        // dx += k * (dy - dBias / count - xhat * dScale / count)  with k = scale * invStdDev, xhat = (x - mean) * invStdDev,
+        // which is dx += a * dy + b * x + r
+        const ElemType* pscale = scale.BufferPointer();
+        const ElemType* psaveInvStdDev = saveInvStdDev.BufferPointer();
+        ElemType* pscaleGrad = scaleGrad.BufferPointer();
+        ElemType* pbiasGrad = biasGrad.BufferPointer();
+        m_a.resize(s.C);
+        m_b.resize(s.C);
+        m_r.resize(s.C);
+        for (size_t c = 0; c < s.C; c++)
+        {
+            const double invStdDev = psaveInvStdDev[c];
+            const double dBias = m_sum[c];
+            const double dScale = m_sum2[c] * invStdDev;
+            const double k = pscale[c] * invStdDev;
+            const double b = -k * dScale * invStdDev / count;
+            pbiasGrad[c] = (ElemType) dBias;
+            pscaleGrad[c] = (ElemType) dScale;
+            m_a[c] = (ElemType) k;
+            m_b[c] = (ElemType) b;
+            m_r[c] = (ElemType) (-k * dBias / count - b * m_mean[c]);
+        }
+        const ElemType* a = m_a.data();
+        const ElemType* bb = m_b.data();
+        const ElemType* r = m_r.data();
+        ElemType* dx = grad.BufferPointer();
+        const size_t rowSize = s.C * s.inner;
+#pragma omp parallel for
+        for (long row = 0; row < (long) (N * s.outer); row++)
+            BackwardRow(s.C, s.inner, dy + row * rowSize, x + row * rowSize, a, bb, r, dx + row * rowSize);
+    }
+
+private:
+    static const size_t BlockChannels = 64; // channels per job of Reduce()
+    static const size_t MaxJobs = 256;      // jobs of Reduce() at most, unless there are more blocks of channels
+
+    static double Epsilon()
+    {
+        return 1e-5; // CUDNN_BN_MIN_EPSILON, which the cuDNN engine passes
+    }
+
+    struct Shape
+    {
+        size_t outer, C, inner;
+
+        Shape(const ConvolutionTensor4D& inT, bool spatial, ImageLayoutKind imageLayoutKind)
+        {
+            const size_t pixels = inT.w() * inT.h() * inT.d();
+            outer = 1;
+            inner = 1;
+            if (!spatial)
+                C = pixels * inT.c();
+            else if (imageLayoutKind == ImageLayoutKind::HWC)
+                outer = pixels, C = inT.c();
+            else
+                C = inT.c(), inner = pixels;
+        }
+
+        size_t SampleSize() const
+        {
+            return outer * C * inner;
+        }
+    };
+
+    // Calls f(offset, c0, nc, sum, sum2) for each row of C x inner elements of the minibatch and each block of channels
+    // [c0, c0 + nc); f adds to sum[0..nc) and sum2[0..nc). The totals over all rows go to m_sum and m_sum2.
+    template <class F>
+    void Reduce(const Shape& s, size_t N, const F& f)
+    {
+        const size_t numBlocks = (s.C + BlockChannels - 1) / BlockChannels;
+        const size_t numChunks = std::max((size_t) 1, std::min(N, MaxJobs / numBlocks));
+        m_partialSums.assign(numBlocks * numChunks * 2 * BlockChannels, 0);
+        double* partialSums = m_partialSums.data();
+#pragma omp parallel for
+        for (long job = 0; job < (long) (numBlocks * numChunks); job++)
+        {
+            const size_t block = job / numChunks, chunk = job % numChunks;
+            const size_t c0 = block * BlockChannels, nc = std::min(BlockChannels, s.C - c0);
+            double* sum = partialSums + job * 2 * BlockChannels;
+            for (size_t n = chunk * N / numChunks; n < (chunk + 1) * N / numChunks; n++)
+                for (size_t o = 0; o < s.outer; o++)
+                    f((n * s.outer + o) * s.C * s.inner + c0 * s.inner, c0, nc, sum, sum + BlockChannels);
+        }
+        m_sum.assign(s.C, 0);
+        m_sum2.assign(s.C, 0);
+        for (size_t job = 0; job < numBlocks * numChunks; job++)
+        {
+            const size_t c0 = job / numChunks * BlockChannels, nc = std::min(BlockChannels, s.C - c0);
+            for (size_t c = 0; c < nc; c++)
+            {
+                m_sum[c0 + c] += partialSums[job * 2 * BlockChannels + c];
+                m_sum2[c0 + c] += partialSums[job * 2 * BlockChannels + BlockChannels + c];
+            }
+        }
+    }
+
+    // y = m_a[c] * x + m_b[c]
+    void Affine(const Shape& s, size_t N, const ElemType* x, ElemType* y) const
+    {
+        const ElemType* a = m_a.data();
+        const ElemType* b = m_b.data();
+        const size_t rowSize = s.C * s.inner;
+#pragma omp parallel for
+        for (long row = 0; row < (long) (N * s.outer); row++)
+            AffineRow(s.C, s.inner, x + row * rowSize, a, b, y + row * rowSize);
+    }
+
+    // the row functions: 'nc' (or C) channels of 'inner' contiguous elements each
+
+    static void SumRow(size_t inner, size_t nc, const ElemType* x, double* sum)
+    {
+        if (inner == 1)
+        {
+            for (size_t c = 0; c < nc; c++)
+                sum[c] += x[c];
+            return;
+        }
+        for (size_t c = 0; c < nc; c++, x += inner)
+        {
+            double v = 0;
+            for (size_t i = 0; i < inner; i++)
+                v += x[i];
+            sum[c] += v;
+        }
+    }
+
+    static void SumSquaredDeviationsRow(size_t inner, size_t nc, const ElemType* x, const double* mean, double* sum)
+    {
+        if (inner == 1)
+        {
+            for (size_t c = 0; c < nc; c++)
+                sum[c] += (x[c] - mean[c]) * (x[c] - mean[c]);
+            return;
+        }
+        for (size_t c = 0; c < nc; c++, x += inner)
+        {
+            const double m = mean[c];
+            double v = 0;
+            for (size_t i = 0; i < inner; i++)
+                v += (x[i] - m) * (x[i] - m);
+            sum[c] += v;
+        }
+    }
+
+    static void SumProductsRow(size_t inner, size_t nc, const ElemType* dy, const ElemType* x, const double* mean, double* sum)
+    {
+        if (inner == 1)
+        {
+            for (size_t c = 0; c < nc; c++)
+                sum[c] += dy[c] * (x[c] - mean[c]);
+            return;
+        }
+        for (size_t c = 0; c < nc; c++, x += inner, dy += inner)
+        {
+            const double m = mean[c];
+            double v = 0;
+            for (size_t i = 0; i < inner; i++)
+                v += dy[i] * (x[i] - m);
+            sum[c] += v;
+        }
+    }
+
+    static void AffineRow(size_t C, size_t inner, const ElemType* x, const ElemType* a, const ElemType* b, ElemType* y)
+    {
+        if (inner == 1)
+        {
+            for (size_t c = 0; c < C; c++)
+                y[c] = a[c] * x[c] + b[c];
+            return;
+        }
+        for (size_t c = 0; c < C; c++, x += inner, y += inner)
+        {
+            const ElemType ac = a[c], bc = b[c];
+            for (size_t i = 0; i < inner; i++)
+                y[i] = ac * x[i] + bc;
+        }
+    }
+
+    static void BackwardRow(size_t C, size_t inner, const ElemType* dy, const ElemType* x, const ElemType* a, const ElemType* b, const ElemType* r, ElemType* dx)
+    {
+        if (inner == 1)
+        {
+            for (size_t c = 0; c < C; c++)
+                dx[c] += a[c] * dy[c] + b[c] * x[c] + r[c];
+            return;
+        }
+        for (size_t c = 0; c < C; c++, dy += inner, x += inner, dx += inner)
+        {
+            const ElemType ac = a[c], bc = b[c], rc = r[c];
+            for (size_t i = 0; i < inner; i++)
+                dx[i] += ac * dy[i] + bc * x[i] + rc;
+        }
+    }
+
+    std::vector<double> m_partialSums; // [job][2][BlockChannels]
+    std::vector<double> m_sum, m_sum2; // [C]
+    std::vector<double> m_mean;
+    std::vector<ElemType> m_a, m_b, m_r; // per-channel coefficients of the element-wise passes
+};
+
 template <class ElemType>
 class DefaultConvolutionEngine : public ConvolutionEngine<ElemType>
 {
@@ -20,8 +562,8 @@ public:
     using typename Base::ConvDesc;
 
 public:
-    DefaultConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
-        : m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples)
+    DefaultConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples, ImageLayoutKind imageLayoutKind)
+        : m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_gpuSparseOpt(false), m_gpuSparse1D(false), m_imageLayoutKind(imageLayoutKind)
     {
     }
 
@@ -29,6 +571,9 @@ public:
     void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                  const Tensor4D& outT, Mat& out, Mat& workspace) override
     {
+        if (inT.volumetric())
+            return m_volumetric.Forward(inT, in, filterT, filter, convDesc, outT, out, workspace);
+
         assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(filterT.k() == filter.GetNumRows());
@@ -119,6 +664,9 @@ public:
     void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                       const Tensor4D& gradT, Mat& grad, Mat& workspace) override
     {
+        if (gradT.volumetric())
+            return m_volumetric.BackwardData(srcGradT, srcGrad, filterT, filter, convDesc, gradT, grad, workspace);
+
         assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
         assert(filterT.k() == filter.GetNumRows());
@@ -170,6 +718,9 @@ public:
     void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
                         const Filter& filterT, Mat& filter, bool allowReuse, Mat& workspace) override
     {
+        if (inT.volumetric())
+            return m_volumetric.BackwardFilter(srcGradT, srcGrad, inT, in, convDesc, filterT, filter, allowReuse, workspace);
+
         assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
         assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
@@ -252,6 +803,9 @@ public:
 
     void AddBias(const Tensor4D& outT, const Mat& out, const Tensor4D& biasT, const Mat& bias, Mat& dst) override
     {
+        if (outT.volumetric())
+            return m_volumetric.AddBias(outT, out, biasT, bias, dst);
+
         assert(biasT.c() == outT.c());
         assert(biasT.w() == 1);
         assert(biasT.h() == 1);
@@ -268,6 +822,9 @@ public:
 
     void BackwardBias(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& biasT, Mat& biasGrad) override
     {
+        if (srcGradT.volumetric())
+            return m_volumetric.BackwardBias(srcGradT, srcGrad, biasT, biasGrad);
+
         assert(biasT.c() == srcGradT.c());
         assert(biasT.w() == 1);
         assert(biasT.h() == 1);
@@ -286,64 +843,535 @@ public:
     void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                         bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev) override
     {
-        UNUSED(inT);
-        UNUSED(in);
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(expAvgFactor);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        VerifyBatchNormOnCPU(in, out);
+        m_batchNorm.Forward(inT, in, scale, bias, spatial, m_imageLayoutKind, expAvgFactor, runMean, runInvStdDev, out, saveMean, saveInvStdDev);
     }
 
     void NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                  bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
     {
-        UNUSED(inT);
-        UNUSED(in);
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        RuntimeError("Not yet implemented.");
+        VerifyBatchNormOnCPU(in, out);
+        m_batchNorm.ForwardInference(inT, in, scale, bias, spatial, m_imageLayoutKind, runMean, runInvStdDev, out);
     }
 
     void BackwardNormalizeBatch(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                 const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
                                 Mat& scaleGrad, Mat& biasGrad) override
     {
-        UNUSED(inT);
-        UNUSED(in);
-        UNUSED(srcGrad);
-        UNUSED(grad);
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(scaleGrad);
-        UNUSED(biasGrad);
-        UNUSED(spatial);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        VerifyBatchNormOnCPU(in, grad);
+        m_batchNorm.Backward(inT, in, srcGrad, grad, scale, spatial, m_imageLayoutKind, saveMean, saveInvStdDev, scaleGrad, biasGrad);
     }
 
 private:
+    static void VerifyBatchNormOnCPU(const Mat& in, const Mat& out)
+    {
+        if (!CPUBatchNormalization<ElemType>::IsOnCPU(in, out))
+            RuntimeError("Batch normalization on the GPU requires cuDNN; without it, it only runs on the CPU, on dense data.");
+    }
+
     size_t m_maxTempMemSizeInSamples;
     Mat m_ones;
     bool m_gpuSparseOpt;
     bool m_gpuSparse1D;
+    ImageLayoutKind m_imageLayoutKind; // for the channels of spatial batch normalization
+    VolumetricConvolutionEngine<ElemType> m_volumetric; // for volumetric tensors, which the unpacking does not handle
+    CPUBatchNormalization<ElemType> m_batchNorm;
+};
+
+// Convolution engine for dense data on the CPU that computes the convolution directly from the input, without
+// unpacking the input patches into a temporary matrix (im2col) as DefaultConvolutionEngine does. It uses the same
+// data layout as DefaultConvolutionEngine (HWC: channel varies fastest, then row, then column, one sample per column),
+// so the two are interchangeable.
+// Forward uses
+//  - for 3x3 kernels with stride 1: Winograd's minimal filtering F(2x2, 3x3), which needs 16 instead of 36
+//    multiplications per channel pair and 2x2 output tile;
+//  - otherwise: a direct loop that accumulates the contribution of each kernel tap and input channel to a block of
+//    output channels, so that each weight row is reused across a whole output column while it is in cache.
+// In both cases the innermost loop runs over contiguous output channels, which the compiler vectorizes.
+// Everything else (data on the GPU, sparse input, the backward passes) is delegated to DefaultConvolutionEngine.
+template <class ElemType>
+class DirectConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using typename Base::Tensor4D;
+    using typename Base::Filter;
+    using typename Base::ConvDesc;
+
+public:
+    DirectConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples, ImageLayoutKind imageLayoutKind)
+        : m_legacy(deviceId, maxTempMemSizeInSamples, imageLayoutKind), m_legacyForward(false)
+    {
+    }
+
+public:
+    void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                 const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.n() == in.GetNumCols());
+        assert(filterT.k() == filter.GetNumRows());
+        assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
+        assert(inT.c() == filterT.c());
+        assert(outT.c() == filterT.k());
+
+        m_legacyForward = !IsOnCPU(in, filter, out) || inT.volumetric();
+        if (m_legacyForward)
+            return m_legacy.Forward(inT, in, filterT, filter, convDesc, outT, out, workspace);
+
+        ForwardCPU(inT, in, filterT, filter, convDesc, nullptr, false, outT, out);
+    }
+
+    void ForwardBiasReLU(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                         const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        m_legacyForward = !IsOnCPU(in, filter, out) || (!bias.IsEmpty() && bias.GetCurrentMatrixLocation() != CurrentDataLocation::CPU) || inT.volumetric();
+        if (m_legacyForward)
+            return Base::ForwardBiasReLU(inT, in, filterT, filter, convDesc, biasT, bias, relu, outT, out, workspace);
+
+        assert(bias.IsEmpty() || bias.GetNumElements() == outT.c());
+        ForwardCPU(inT, in, filterT, filter, convDesc, bias.IsEmpty() ? nullptr : bias.BufferPointer(), relu, outT, out);
+    }
+
+    void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                      const Tensor4D& gradT, Mat& grad, Mat& workspace) override
+    {
+        m_legacy.BackwardData(srcGradT, srcGrad, filterT, filter, convDesc, gradT, grad, workspace);
+    }
+
+    void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
+                        const Filter& filterT, Mat& filter, bool allowReuse, Mat& workspace) override
+    {
+        // the packed input can only be reused if the legacy engine computed it in Forward()
+        m_legacy.BackwardFilter(srcGradT, srcGrad, inT, in, convDesc, filterT, filter, allowReuse && m_legacyForward, workspace);
+    }
+
+    void AddBias(const Tensor4D& outT, const Mat& out, const Tensor4D& biasT, const Mat& bias, Mat& dst) override
+    {
+        m_legacy.AddBias(outT, out, biasT, bias, dst);
+    }
+
+    void BackwardBias(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& biasT, Mat& biasGrad) override
+    {
+        m_legacy.BackwardBias(srcGradT, srcGrad, biasT, biasGrad);
+    }
+
+    void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
+                        bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev) override
+    {
+        m_legacy.NormalizeBatch(inT, in, scaleBiasT, scale, bias, spatial, expAvgFactor, runMean, runInvStdDev, out, saveMean, saveInvStdDev);
+    }
+
+    void NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
+                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
+    {
+        m_legacy.NormalizeBatchInference(inT, in, scaleBiasT, scale, bias, spatial, runMean, runInvStdDev, out);
+    }
+
+    void BackwardNormalizeBatch(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
+                                const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
+                                Mat& scaleGrad, Mat& biasGrad) override
+    {
+        m_legacy.BackwardNormalizeBatch(inT, in, srcGrad, grad, scaleBiasT, scale, spatial, saveMean, saveInvStdDev, scaleGrad, biasGrad);
+    }
+
+private:
+    // block of output rows x channels that ForwardDirect() accumulates at a time, see CPUSIMDKernels::TryConvolutionBlock()
+    static const size_t BlockRows = 4;
+    static const size_t BlockChannels = 16;
+
+    // Element (k, c, row r, column s) of the filter, where row and column are the kernel positions along the image
+    // height and width; see CPUMatrix::AssignPackedConvolutionInput() for the layout of the unpacked input.
+    static ElemType FilterAt(const ElemType* filter, size_t K, const Filter& filterT, size_t k, size_t c, size_t r, size_t s)
+    {
+        return filter[k + (c * filterT.w() * filterT.h() + s * filterT.h() + r) * K];
+    }
+
+    static bool IsOnCPU(const Mat& in, const Mat& filter, const Mat& out)
+    {
+        return in.GetMatrixType() == MatrixType::DENSE && in.GetCurrentMatrixLocation() == CurrentDataLocation::CPU &&
+               filter.GetCurrentMatrixLocation() == CurrentDataLocation::CPU && out.GetCurrentMatrixLocation() == CurrentDataLocation::CPU;
+    }
+
+    // the epilogue of the forward pass: optional per-channel bias and ReLU
+    static ElemType Epilogue(ElemType v, const ElemType* bias, size_t k, bool relu)
+    {
+        if (bias)
+            v += bias[k];
+        return (relu && v < 0) ? 0 : v;
+    }
+
+    void ForwardCPU(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                    const ElemType* bias, bool relu, const Tensor4D& outT, Mat& out)
+    {
+        out.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+        out.Resize(outT.w() * outT.h() * outT.c(), inT.n());
+
+        if (filterT.w() == 3 && filterT.h() == 3 && convDesc.wStride() == 1 && convDesc.hStride() == 1)
+            ForwardWinograd(inT, in, filterT, filter, convDesc, bias, relu, outT, out);
+        else
+            ForwardDirect(inT, in, filterT, filter, convDesc, bias, relu, outT, out);
+    }
+
+    static bool TryConvolutionBlock(const float* const* src, const float* const* weights, size_t numTaps, size_t C, size_t ldw, float* out)
+    {
+        return CPUSIMDKernels::TryConvolutionBlock(src, weights, numTaps, C, ldw, out);
+    }
+    static bool TryConvolutionBlock(const double* const*, const double* const*, size_t, size_t, size_t, double*)
+    {
+        return false;
+    }
+
+    void ForwardDirect(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                       const ElemType* bias, bool relu, const Tensor4D& outT, Mat& out)
+    {
+        const size_t C = inT.c(), K = outT.c();
+        const size_t inH = inT.h(), inW = inT.w(), outH = outT.h(), outW = outT.w();
+        const size_t kH = filterT.h(), kW = filterT.w();
+        const size_t vStride = convDesc.hStride(), hStride = convDesc.wStride();
+        const long padH = convDesc.padding() ? (long) kH / 2 : 0;
+        const long padW = convDesc.padding() ? (long) kW / 2 : 0;
+
+        // rearrange the filter to [tap][c][k], with k padded to whole blocks, so that the inner loop reads contiguous
+        // output channels
+        const size_t Kp = (K + BlockChannels - 1) / BlockChannels * BlockChannels;
+        const ElemType* f = filter.BufferPointer();
+        m_weights.assign(kH * kW * C * Kp, 0);
+        for (size_t s = 0; s < kW; s++)
+            for (size_t r = 0; r < kH; r++)
+                for (size_t c = 0; c < C; c++)
+                    for (size_t k = 0; k < K; k++)
+                        m_weights[((s * kH + r) * C + c) * Kp + k] = FilterAt(f, K, filterT, k, c, r, s);
+        m_zeros.assign(C, 0); // stands in for input pixels in the padding
+
+        const ElemType* inData = in.BufferPointer();
+        ElemType* outData = out.BufferPointer();
+        const size_t inDim = inT.w() * inT.h() * C, outDim = outT.w() * outT.h() * K;
+        const ElemType* weights = m_weights.data();
+        const ElemType* zeros = m_zeros.data();
+
+        // one job per output column of a sample; its output (outH x K values) is contiguous
+#pragma omp parallel for
+        for (long job = 0; job < (long) (inT.n() * outW); job++)
+        {
+            const size_t n = job / outW, wcol = job % outW;
+            const ElemType* inSample = inData + n * inDim;
+            ElemType* outColumn = outData + n * outDim + wcol * outH * K;
+            std::vector<const ElemType*> src(kH * kW * BlockRows); // input pixels of each tap for the rows of a block
+            std::vector<const ElemType*> tapWeights(kH * kW);
+            ElemType acc[BlockRows * BlockChannels];
+
+            // accumulate a block of BlockRows x BlockChannels outputs over all taps and input channels
+            for (size_t wrow0 = 0; wrow0 < outH; wrow0 += BlockRows)
+            {
+                size_t numTaps = 0;
+                for (size_t s = 0; s < kW; s++)
+                {
+                    const long y = (long) (wcol * hStride + s) - padW;
+                    if (y < 0 || y >= (long) inW)
+                        continue;
+                    for (size_t r = 0; r < kH; r++, numTaps++)
+                    {
+                        for (size_t i = 0; i < BlockRows; i++)
+                        {
+                            const long x = (long) ((wrow0 + i) * vStride + r) - padH;
+                            src[numTaps * BlockRows + i] = (wrow0 + i >= outH || x < 0 || x >= (long) inH) ? zeros : inSample + (x + y * inH) * C;
+                        }
+                        tapWeights[numTaps] = weights + (s * kH + r) * C * Kp;
+                    }
+                }
+
+                for (size_t k0 = 0; k0 < Kp; k0 += BlockChannels)
+                {
+                    if (k0 > 0) // advance to this block of channels
+                        for (size_t t = 0; t < numTaps; t++)
+                            tapWeights[t] += BlockChannels;
+                    if (!TryConvolutionBlock(src.data(), tapWeights.data(), numTaps, C, Kp, acc))
+                    {
+                        std::fill(acc, acc + BlockRows * BlockChannels, (ElemType) 0);
+                        for (size_t t = 0; t < numTaps; t++)
+                            for (size_t c = 0; c < C; c++)
+                                for (size_t i = 0; i < BlockRows; i++)
+                                {
+                                    const ElemType a = src[t * BlockRows + i][c];
+                                    const ElemType* w = tapWeights[t] + c * Kp;
+                                    for (size_t k = 0; k < BlockChannels; k++)
+                                        acc[i * BlockChannels + k] += a * w[k];
+                                }
+                    }
+                    for (size_t i = 0; i < BlockRows && wrow0 + i < outH; i++)
+                        for (size_t k = 0; k < BlockChannels && k0 + k < K; k++)
+                            outColumn[(wrow0 + i) * K + k0 + k] = Epilogue(acc[i * BlockChannels + k], bias, k0 + k, relu);
+                }
+            }
+        }
+    }
+
+    // Winograd F(2x2, 3x3), see A. Lavin, S. Gray, "Fast Algorithms for Convolutional Neural Networks", 2015:
+    //   Y = A^T [ (G g G^T) .* (B^T d B) ] A
+    // for each 2x2 output tile Y, computed from the 4x4 input tile d, summed over the input channels.
+    // The sum over the channels amounts to 16 independent matrix products, one per tile element, which are computed
+    // in blocks of BlockRows tiles x BlockChannels output channels like the taps in ForwardDirect().
+    void ForwardWinograd(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                         const ElemType* bias, bool relu, const Tensor4D& outT, Mat& out)
+    {
+        const size_t C = inT.c(), K = outT.c();
+        const size_t inH = inT.h(), inW = inT.w(), outH = outT.h(), outW = outT.w();
+        const long pad = convDesc.padding() ? 1 : 0;
+
+        // filter transform U = G g G^T, stored as [e][c][k] with e = 4 * i + j the element of the 4x4 tile
+        const size_t Kp = (K + BlockChannels - 1) / BlockChannels * BlockChannels;
+        const ElemType* f = filter.BufferPointer();
+        m_weights.assign(16 * C * Kp, 0);
+        for (size_t c = 0; c < C; c++)
+        {
+            for (size_t k = 0; k < K; k++)
+            {
+                ElemType g[3][3], t[4][3];
+                for (size_t r = 0; r < 3; r++)
+                    for (size_t s = 0; s < 3; s++)
+                        g[r][s] = FilterAt(f, K, filterT, k, c, r, s);
+                for (size_t s = 0; s < 3; s++)
+                {
+                    t[0][s] = g[0][s];
+                    t[1][s] = (g[0][s] + g[1][s] + g[2][s]) / 2;
+                    t[2][s] = (g[0][s] - g[1][s] + g[2][s]) / 2;
+                    t[3][s] = g[2][s];
+                }
+                for (size_t i = 0; i < 4; i++)
+                {
+                    ElemType* u = m_weights.data() + (4 * i * C + c) * Kp + k;
+                    u[0 * C * Kp] = t[i][0];
+                    u[1 * C * Kp] = (t[i][0] + t[i][1] + t[i][2]) / 2;
+                    u[2 * C * Kp] = (t[i][0] - t[i][1] + t[i][2]) / 2;
+                    u[3 * C * Kp] = t[i][2];
+                }
+            }
+        }
+        m_zeros.assign(C, 0); // stands in for missing tiles at the end of a row
+
+        const ElemType* inData = in.BufferPointer();
+        ElemType* outData = out.BufferPointer();
+        const size_t inDim = inT.w() * inT.h() * C, outDim = outT.w() * outT.h() * K;
+        const ElemType* weights = m_weights.data();
+        const ElemType* zeros = m_zeros.data();
+        const size_t tilesH = (outH + 1) / 2, tilesW = (outW + 1) / 2;
+
+        // one job per row of tiles (along the image width) of a sample
+#pragma omp parallel for
+        for (long job = 0; job < (long) (inT.n() * tilesH); job++)
+        {
+            const size_t n = job / tilesH, tileRow = job % tilesH;
+            const ElemType* inSample = inData + n * inDim;
+            ElemType* outSample = outData + n * outDim;
+            std::vector<ElemType> V(BlockRows * 16 * C);                // transformed input tiles, [tile][e][c]
+            std::vector<ElemType> M(16 * BlockRows * BlockChannels);   // their products with U, [e][tile][k]
+
+            for (size_t tile0 = 0; tile0 < tilesW; tile0 += BlockRows)
+            {
+                const size_t numTiles = min(tilesW - tile0, BlockRows);
+
+                // input transform V = B^T d B
+                for (size_t t = 0; t < numTiles; t++)
+                {
+                    const long x0 = (long) (2 * tileRow) - pad, y0 = (long) (2 * (tile0 + t)) - pad;
+                    for (size_t c = 0; c < C; c++)
+                    {
+                        ElemType d[4][4], b[4][4];
+                        for (long i = 0; i < 4; i++)
+                            for (long j = 0; j < 4; j++)
+                            {
+                                const long x = x0 + i, y = y0 + j;
+                                d[i][j] = (x < 0 || x >= (long) inH || y < 0 || y >= (long) inW) ? 0 : inSample[(x + y * inH) * C + c];
+                            }
+                        for (size_t j = 0; j < 4; j++)
+                        {
+                            b[0][j] = d[0][j] - d[2][j];
+                            b[1][j] = d[1][j] + d[2][j];
+                            b[2][j] = d[2][j] - d[1][j];
+                            b[3][j] = d[1][j] - d[3][j];
+                        }
+                        ElemType* v = V.data() + t * 16 * C + c;
+                        for (size_t i = 0; i < 4; i++)
+                        {
+                            v[(4 * i + 0) * C] = b[i][0] - b[i][2];
+                            v[(4 * i + 1) * C] = b[i][1] + b[i][2];
+                            v[(4 * i + 2) * C] = b[i][2] - b[i][1];
+                            v[(4 * i + 3) * C] = b[i][1] - b[i][3];
+                        }
+                    }
+                }
+
+                for (size_t k0 = 0; k0 < Kp; k0 += BlockChannels)
+                {
+                    // M[e] = V[e] U[e], summed over the input channels
+                    for (size_t e = 0; e < 16; e++)
+                    {
+                        const ElemType* src[BlockRows];
+                        for (size_t t = 0; t < BlockRows; t++)
+                            src[t] = t < numTiles ? V.data() + (t * 16 + e) * C : zeros;
+                        const ElemType* u = weights + e * C * Kp + k0;
+                        ElemType* m = M.data() + e * BlockRows * BlockChannels;
+                        if (!TryConvolutionBlock(src, &u, 1, C, Kp, m))
+                        {
+                            std::fill(m, m + BlockRows * BlockChannels, (ElemType) 0);
+                            for (size_t c = 0; c < C; c++)
+                                for (size_t t = 0; t < BlockRows; t++)
+                                {
+                                    const ElemType a = src[t][c];
+                                    for (size_t k = 0; k < BlockChannels; k++)
+                                        m[t * BlockChannels + k] += a * u[c * Kp + k];
+                                }
+                        }
+                    }
+
+                    // output transform Y = A^T M A, clipped at the image border
+                    for (size_t t = 0; t < numTiles; t++)
+                    {
+                        const size_t wrow0 = 2 * tileRow, wcol0 = 2 * (tile0 + t);
+                        for (size_t k = 0; k < BlockChannels && k0 + k < K; k++)
+                        {
+                            auto mAt = [&](size_t e) { return M[(e * BlockRows + t) * BlockChannels + k]; };
+                            ElemType a[2][4], y[2][2];
+                            for (size_t j = 0; j < 4; j++)
+                            {
+                                a[0][j] = mAt(0 + j) + mAt(4 + j) + mAt(8 + j);
+                                a[1][j] = mAt(4 + j) - mAt(8 + j) - mAt(12 + j);
+                            }
+                            for (size_t i = 0; i < 2; i++)
+                            {
+                                y[i][0] = a[i][0] + a[i][1] + a[i][2];
+                                y[i][1] = a[i][1] - a[i][2] - a[i][3];
+                            }
+                            for (size_t i = 0; i < 2 && wrow0 + i < outH; i++)
+                                for (size_t j = 0; j < 2 && wcol0 + j < outW; j++)
+                                    outSample[(wrow0 + i + (wcol0 + j) * outH) * K + k0 + k] = Epilogue(y[i][j], bias, k0 + k, relu);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    DefaultConvolutionEngine<ElemType> m_legacy;
+    bool m_legacyForward;           // Forward() was delegated to m_legacy
+    std::vector<ElemType> m_weights; // rearranged or transformed filter
+    std::vector<ElemType> m_zeros;
 };
 
 template class ConvolutionEngine<float>;
 template class ConvolutionEngine<double>;
 
+// Pooling of volumetric tensors on the CPU, in the layout of VolumetricConvolutionEngine. Like cuDNN, average pooling
+// divides by the number of input elements inside the window (padding excluded), and max pooling passes the gradient
+// to the first maximal element of the window.
+template <class ElemType>
+class VolumetricPoolingEngine : public PoolingEngine<ElemType>
+{
+public:
+    using Base = PoolingEngine<ElemType>;
+    using typename Base::Tensor4D;
+    using typename Base::PoolDesc;
+    using typename Base::Mat;
+
+public:
+    void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
+    {
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
+        assert(inT.n() == in.GetNumCols() && outT.n() == out.GetNumCols());
+        VolumetricConvolutionEngine<ElemType>::VerifyOnCPU(in, in, out);
+
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const size_t inSize = in.GetNumRows(), outSize = out.GetNumRows();
+        const ElemType* pin = in.BufferPointer();
+        ElemType* pout = out.BufferPointer();
+#pragma omp parallel for
+        for (long n = 0; n < (long) inT.n(); n++)
+        {
+            const ElemType* x = pin + n * inSize;
+            ElemType* y = pout + n * outSize;
+            ForEachWindow(inT, poolDesc, outT, [=](size_t o, const size_t* taps, size_t numTaps)
+                          {
+                              ElemType v = isMax ? x[taps[0]] : 0;
+                              for (size_t i = 0; i < numTaps; i++)
+                                  v = isMax ? std::max(v, x[taps[i]]) : v + x[taps[i]];
+                              y[o] = isMax ? v : v / (ElemType) numTaps;
+                          });
+        }
+    }
+
+    // adds to 'grad', as cuDNN does
+    void Backward(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
+    {
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
+        assert(out.GetNumRows() == srcGrad.GetNumRows() && out.GetNumCols() == srcGrad.GetNumCols());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
+        assert(in.GetNumRows() == grad.GetNumRows() && in.GetNumCols() == grad.GetNumCols());
+        VolumetricConvolutionEngine<ElemType>::VerifyOnCPU(in, srcGrad, grad);
+        UNUSED(out);
+
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const size_t inSize = in.GetNumRows(), outSize = out.GetNumRows();
+        const ElemType* pin = in.BufferPointer();
+        const ElemType* psrcGrad = srcGrad.BufferPointer();
+        ElemType* pgrad = grad.BufferPointer();
+#pragma omp parallel for
+        for (long n = 0; n < (long) inT.n(); n++)
+        {
+            const ElemType* x = pin + n * inSize;
+            const ElemType* dy = psrcGrad + n * outSize;
+            ElemType* dx = pgrad + n * inSize;
+            ForEachWindow(inT, poolDesc, outT, [=](size_t o, const size_t* taps, size_t numTaps)
+                          {
+                              if (isMax)
+                              {
+                                  size_t argmax = taps[0];
+                                  for (size_t i = 1; i < numTaps; i++)
+                                      if (x[taps[i]] > x[argmax])
+                                          argmax = taps[i];
+                                  dx[argmax] += dy[o];
+                              }
+                              else
+                              {
+                                  for (size_t i = 0; i < numTaps; i++)
+                                      dx[taps[i]] += dy[o] / (ElemType) numTaps;
+                              }
+                          });
+        }
+    }
+
+private:
+    // calls f(output offset, input offsets, number of input offsets) for each window of one sample that has at least one
+    // input element inside it
+    template <class F>
+    static void ForEachWindow(const Tensor4D& inT, const PoolDesc& poolDesc, const Tensor4D& outT, const F& f)
+    {
+        const size_t w = inT.w(), h = inT.h(), d = inT.d();
+        std::vector<size_t> taps(poolDesc.w() * poolDesc.h() * poolDesc.d());
+        for (size_t c = 0; c < outT.c(); c++)
+            for (size_t oz = 0; oz < outT.d(); oz++)
+                for (size_t oy = 0; oy < outT.h(); oy++)
+                    for (size_t ox = 0; ox < outT.w(); ox++)
+                    {
+                        const int z0 = (int) (oz * poolDesc.dStride()) - (int) poolDesc.dPad();
+                        const int y0 = (int) (oy * poolDesc.hStride()) - (int) poolDesc.hPad();
+                        const int x0 = (int) (ox * poolDesc.wStride()) - (int) poolDesc.wPad();
+                        size_t numTaps = 0;
+                        for (int z = std::max(z0, 0); z < std::min(z0 + (int) poolDesc.d(), (int) d); z++)
+                            for (int y = std::max(y0, 0); y < std::min(y0 + (int) poolDesc.h(), (int) h); y++)
+                                for (int x = std::max(x0, 0); x < std::min(x0 + (int) poolDesc.w(), (int) w); x++)
+                                    taps[numTaps++] = ((c * d + z) * h + y) * w + x;
+                        if (numTaps > 0)
+                            f(((c * outT.d() + oz) * outT.h() + oy) * outT.w() + ox, taps.data(), numTaps);
+                    }
+    }
+};
+
 template <class ElemType>
 class DefaultPoolingEngine : public PoolingEngine<ElemType>
 {
@@ -356,6 +1384,9 @@ public:
 public:
     void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
     {
+        if (inT.volumetric())
+            return m_volumetric.Forward(inT, in, poolDesc, outT, out);
+
         assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
@@ -379,6 +1410,9 @@ public:
 
     void Backward(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
     {
+        if (inT.volumetric())
+            return m_volumetric.Backward(outT, out, srcGrad, poolDesc, inT, in, grad);
+
         assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
         assert(out.GetNumRows() == srcGrad.GetNumRows());
@@ -404,6 +1438,168 @@ public:
         else
             assert(false);
     }
+
+private:
+    VolumetricPoolingEngine<ElemType> m_volumetric;
+};
+
+// Pooling of dense data on the CPU, for DirectConvolutionEngine's factory. The results are those of DefaultPoolingEngine
+// (HWC layout, no padding; the max gradient goes to each input that equals the maximum, the average is over the whole
+// window), which it delegates everything else to. A job is a block of channels of one sample, so that no two jobs write
+// to the same element, although windows may overlap; the innermost loops run over the contiguous channels of a pixel,
+// which the compiler vectorizes, and a block of channels of a window stays in cache while it is visited.
+template <class ElemType>
+class DirectPoolingEngine : public PoolingEngine<ElemType>
+{
+public:
+    using Base = PoolingEngine<ElemType>;
+    using typename Base::Tensor4D;
+    using typename Base::PoolDesc;
+    using typename Base::Mat;
+
+public:
+    void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
+    {
+        if (inT.volumetric() || !IsOnCPU(in) || !IsOnCPU(out))
+            return m_legacy.Forward(inT, in, poolDesc, outT, out);
+
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.n() == in.GetNumCols());
+        out.Resize(outT.w() * outT.h() * outT.c(), in.GetNumCols());
+
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const Geometry g(inT, poolDesc, outT);
+        const ElemType* x = in.BufferPointer();
+        ElemType* y = out.BufferPointer();
+#pragma omp parallel for
+        for (long job = 0; job < (long) (in.GetNumCols() * g.numBlocks); job++)
+        {
+            const size_t n = job / g.numBlocks, c0 = job % g.numBlocks * BlockChannels, nc = std::min(BlockChannels, g.C - c0);
+            const ElemType* xs = x + n * g.inSize + c0;
+            ElemType* ys = y + n * g.outSize + c0;
+            for (size_t wcol = 0; wcol < g.outW; wcol++)
+                for (size_t wrow = 0; wrow < g.outH; wrow++)
+                {
+                    ElemType* yo = ys + g.OutOffset(wrow, wcol);
+                    const ElemType* window = xs + g.WindowOffset(wrow, wcol);
+                    for (size_t c = 0; c < nc; c++)
+                        yo[c] = isMax ? window[c] : 0;
+                    for (size_t s = 0; s < g.windowW; s++)
+                        for (size_t r = 0; r < g.windowH; r++)
+                        {
+                            const ElemType* xi = window + g.TapOffset(r, s);
+                            if (isMax)
+                            {
+                                for (size_t c = 0; c < nc; c++)
+                                    yo[c] = xi[c] > yo[c] ? xi[c] : yo[c];
+                            }
+                            else
+                            {
+                                for (size_t c = 0; c < nc; c++)
+                                    yo[c] += xi[c];
+                            }
+                        }
+                    if (!isMax)
+                        for (size_t c = 0; c < nc; c++)
+                            yo[c] /= (ElemType) g.windowSize;
+                }
+        }
+    }
+
+    void Backward(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
+    {
+        if (inT.volumetric() || !IsOnCPU(in) || !IsOnCPU(out) || !IsOnCPU(srcGrad) || !IsOnCPU(grad))
+            return m_legacy.Backward(outT, out, srcGrad, poolDesc, inT, in, grad);
+
+        assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
+        assert(out.GetNumRows() == srcGrad.GetNumRows() && out.GetNumCols() == srcGrad.GetNumCols());
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(in.GetNumRows() == grad.GetNumRows() && in.GetNumCols() == grad.GetNumCols());
+
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const Geometry g(inT, poolDesc, outT);
+        const ElemType* x = in.BufferPointer();
+        const ElemType* y = out.BufferPointer();
+        const ElemType* dy = srcGrad.BufferPointer();
+        ElemType* dx = grad.BufferPointer();
+#pragma omp parallel for
+        for (long job = 0; job < (long) (in.GetNumCols() * g.numBlocks); job++)
+        {
+            const size_t n = job / g.numBlocks, c0 = job % g.numBlocks * BlockChannels, nc = std::min(BlockChannels, g.C - c0);
+            const ElemType* xs = x + n * g.inSize + c0;
+            const ElemType* ys = y + n * g.outSize + c0;
+            const ElemType* dys = dy + n * g.outSize + c0;
+            ElemType* dxs = dx + n * g.inSize + c0;
+            for (size_t wcol = 0; wcol < g.outW; wcol++)
+                for (size_t wrow = 0; wrow < g.outH; wrow++)
+                {
+                    const size_t outOffset = g.OutOffset(wrow, wcol), windowOffset = g.WindowOffset(wrow, wcol);
+                    const ElemType* yo = ys + outOffset;
+                    const ElemType* dyo = dys + outOffset;
+                    for (size_t s = 0; s < g.windowW; s++)
+                        for (size_t r = 0; r < g.windowH; r++)
+                        {
+                            const size_t tap = windowOffset + g.TapOffset(r, s);
+                            const ElemType* xi = xs + tap;
+                            ElemType* dxi = dxs + tap;
+                            if (isMax)
+                            {
+                                for (size_t c = 0; c < nc; c++)
+                                    dxi[c] += xi[c] == yo[c] ? dyo[c] : 0;
+                            }
+                            else
+                            {
+                                for (size_t c = 0; c < nc; c++)
+                                    dxi[c] += dyo[c] / (ElemType) g.windowSize;
+                            }
+                        }
+                }
+        }
+    }
+
+private:
+    static const size_t BlockChannels = 64;
+
+    static bool IsOnCPU(const Mat& m)
+    {
+        return m.GetMatrixType() == MatrixType::DENSE && m.GetCurrentMatrixLocation() == CurrentDataLocation::CPU;
+    }
+
+    // offsets within a sample, in the layout of CPUMatrix::AssignMaxPoolingResult(): (channel + (row + col * height) * C)
+    struct Geometry
+    {
+        size_t C, inH, outW, outH;
+        size_t windowW, windowH, windowSize;
+        size_t hStride, vStride; // along the columns (width) and the rows (height)
+        size_t inSize, outSize, numBlocks;
+
+        Geometry(const Tensor4D& inT, const PoolDesc& poolDesc, const Tensor4D& outT)
+            : C(inT.c()), inH(inT.h()), outW(outT.w()), outH(outT.h()),
+              windowW(poolDesc.w()), windowH(poolDesc.h()), windowSize(poolDesc.w() * poolDesc.h()),
+              hStride(poolDesc.wStride()), vStride(poolDesc.hStride()),
+              inSize(inT.w() * inT.h() * inT.c()), outSize(outT.w() * outT.h() * outT.c()),
+              numBlocks((inT.c() + BlockChannels - 1) / BlockChannels)
+        {
+            assert(outT.c() == C);
+        }
+
+        size_t OutOffset(size_t wrow, size_t wcol) const
+        {
+            return (wrow + wcol * outH) * C;
+        }
+        // the first pixel of the window of output (wrow, wcol)
+        size_t WindowOffset(size_t wrow, size_t wcol) const
+        {
+            return (wrow * vStride + wcol * hStride * inH) * C;
+        }
+        // pixel (r, s) of a window, relative to its first
+        size_t TapOffset(size_t r, size_t s) const
+        {
+            return (r + s * inH) * C;
+        }
+    };
+
+    DefaultPoolingEngine<ElemType> m_legacy;
 };
 
 template class PoolingEngine<float>;
@@ -427,36 +1623,53 @@ public:
     using typename Base::PoolEnginePtr;
 
 public:
-    Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) override
+    // 'direct' selects DirectConvolutionEngine and DirectPoolingEngine instead of DefaultConvolutionEngine and DefaultPoolingEngine
+    DefaultConvolutionEngineFactory(bool direct, ImageLayoutKind imageLayoutKind)
+        : m_direct(direct), m_imageLayoutKind(imageLayoutKind)
     {
-        return std::make_unique<ConvolutionTensor4D>(w, h, c, n);
     }
 
-    FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k) override
+    Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d) override
     {
-        return std::make_unique<Filter>(w, h, c, k);
+        return std::make_unique<ConvolutionTensor4D>(w, h, c, n, d);
     }
 
-    ConvDescPtr CreateConvDescriptor(const Tensor4D& /*inT*/, const Filter& /*filterT*/,
-                                     size_t wStride, size_t hStride, bool padding) override
+    FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d) override
     {
-        return std::make_unique<ConvDesc>(wStride, hStride, padding);
+        return std::make_unique<Filter>(w, h, c, k, d);
     }
 
-    PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) override
+    ConvDescPtr CreateConvDescriptor(const Tensor4D& inT, const Filter& filterT,
+                                     size_t wStride, size_t hStride, bool padding, size_t dStride) override
     {
-        return std::make_unique<PoolDesc>(kind, w, h, wStride, hStride, wPad, hPad);
+        if (inT.volumetric() != filterT.volumetric())
+            InvalidArgument("CreateConvDescriptor: The input and the filter must both be volumetric, or neither.");
+        return std::make_unique<ConvDesc>(wStride, hStride, padding, dStride);
+    }
+
+    PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad,
+                                     size_t d, size_t dStride, size_t dPad) override
+    {
+        return std::make_unique<PoolDesc>(kind, w, h, wStride, hStride, wPad, hPad, d, dStride, dPad);
     }
 
     ConvEnginePtr CreateConvEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples) override
     {
-        return std::make_unique<DefaultConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples);
+        if (m_direct)
+            return std::make_unique<DirectConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples, m_imageLayoutKind);
+        return std::make_unique<DefaultConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples, m_imageLayoutKind);
     }
 
     PoolEnginePtr CreatePoolEngine(DEVICEID_TYPE /*deviceId*/) override
     {
+        if (m_direct)
+            return std::make_unique<DirectPoolingEngine<ElemType>>();
         return std::make_unique<DefaultPoolingEngine<ElemType>>();
     }
+
+private:
+    bool m_direct;
+    ImageLayoutKind m_imageLayoutKind;
 };
 
 template <class ElemType>
@@ -467,6 +1680,8 @@ std::unique_ptr<ConvolutionEngineFactory<ElemType>> ConvolutionEngineFactory<Ele
         // REVIEW alexeyk: make cuDNN default when running on GPU and compiled with cuDNN, add config parameter to enable runtime switch between implementations.
         if (deviceId >= 0 && CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId) && imageLayoutKind == ImageLayoutKind::CHW)
             return Create(deviceId, EngineType::CuDnn, imageLayoutKind);
+        else if (deviceId < 0)
+            return Create(deviceId, EngineType::Direct, imageLayoutKind);
         else
             return Create(deviceId, EngineType::Legacy, imageLayoutKind);
     }
@@ -478,13 +1693,13 @@ std::unique_ptr<ConvolutionEngineFactory<ElemType>> ConvolutionEngineFactory<Ele
             return std::make_unique<CuDnnConvolutionEngineFactory<ElemType>>();
         RuntimeError("cuDNN convolution engine is not supported, check the device id and whether the code was compiled with cuDNN.");
     }
-    else if (engType == EngineType::Legacy)
+    else if (engType == EngineType::Legacy || engType == EngineType::Direct)
     {
         // REVIEW alexeyk: temp hack to allow this to work in MEL scenarios. InvalidArgument should be used instead.
         if (imageLayoutKind != ImageLayoutKind::HWC)
             fprintf(stderr, "WARNING: trying to use cuDNN on unsupported platform. It is safe to ignore the warning if it's produced during model editing command.\n");
         // InvalidArgument("ConvolutionEngineFactory: ImageLayout '%s' is not compatible with the legacy convolution engine.", ToString(imageLayoutKind).c_str());
-        return std::make_unique<DefaultConvolutionEngineFactory<ElemType>>();
+        return std::make_unique<DefaultConvolutionEngineFactory<ElemType>>(engType == EngineType::Direct, imageLayoutKind);
     }
 
     RuntimeError("Not supported convolution engine type: %d.", (int)engType);
@@ -22,6 +22,8 @@
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // REVIEW alexeyk: this is a temp class until we have generic tensor suport in CNTK.
+// Despite the name, a tensor may be volumetric: 5-D (W,H,D,C,N), with a depth for e.g. video or spectro-temporal
+// features. Each channel is stored as W x H x D, W varying fastest. A depth of 0 (the default) means 4-D; d() is 1 then.
 class ConvolutionTensor4D
 {
 public:
@@ -33,6 +35,14 @@ public:
     {
         return m_h;
     }
+    size_t d() const
+    {
+        return m_d;
+    }
+    bool volumetric() const
+    {
+        return m_volumetric;
+    }
     size_t c() const
     {
         return m_c;
@@ -47,10 +57,12 @@ public:
     }
 
 public:
-    ConvolutionTensor4D(size_t w = 1, size_t h = 1, size_t c = 1, size_t n = 1)
+    ConvolutionTensor4D(size_t w = 1, size_t h = 1, size_t c = 1, size_t n = 1, size_t d = 0)
     {
         m_w = w;
         m_h = h;
+        m_d = d > 0 ? d : 1;
+        m_volumetric = d > 0;
         m_c = c;
         m_n = n;
     }
@@ -67,6 +79,8 @@ public:
 private:
     size_t m_w;
     size_t m_h;
+    size_t m_d;
+    bool m_volumetric;
     size_t m_c;
     size_t m_n;
 };
@@ -82,6 +96,14 @@ public:
     {
         return m_h;
     }
+    size_t d() const
+    {
+        return m_d;
+    }
+    bool volumetric() const
+    {
+        return m_volumetric;
+    }
     size_t c() const
     {
         return m_c;
@@ -92,10 +114,13 @@ public:
     }
 
 public:
-    ConvolutionFilter(size_t w = 1, size_t h = 1, size_t c = 1, size_t k = 1)
+    // d - depth of a volumetric filter, or 0
+    ConvolutionFilter(size_t w = 1, size_t h = 1, size_t c = 1, size_t k = 1, size_t d = 0)
     {
         m_w = w;
         m_h = h;
+        m_d = d > 0 ? d : 1;
+        m_volumetric = d > 0;
         m_c = c;
         m_k = k;
     }
@@ -110,6 +135,8 @@ public:
 private:
     size_t m_w;
     size_t m_h;
+    size_t m_d;
+    bool m_volumetric;
     size_t m_c;
     size_t m_k;
 };
@@ -128,16 +155,22 @@ public:
     {
         return m_hStride;
     }
+    // Stride in d-dimension.
+    size_t dStride() const
+    {
+        return m_dStride;
+    }
     bool padding() const
     {
         return m_padding;
     }
 
 public:
-    ConvolutionDescriptor(size_t wStride = 1, size_t hStride = 1, bool padding = false)
+    ConvolutionDescriptor(size_t wStride = 1, size_t hStride = 1, bool padding = false, size_t dStride = 1)
     {
         m_wStride = wStride;
         m_hStride = hStride;
+        m_dStride = dStride;
         m_padding = padding;
     }
 
@@ -150,6 +183,7 @@ public:
 private:
     size_t m_wStride;
     size_t m_hStride;
+    size_t m_dStride;
     bool m_padding;
 };
 
@@ -176,6 +210,14 @@ public:
     {
         return m_h;
     }
+    size_t d() const
+    {
+        return m_d;
+    }
+    bool volumetric() const
+    {
+        return m_volumetric;
+    }
     // Horizontal stride (in w-dimension).
     size_t wStride() const
     {
@@ -186,6 +228,11 @@ public:
     {
         return m_hStride;
     }
+    // Stride in d-dimension.
+    size_t dStride() const
+    {
+        return m_dStride;
+    }
     // Horizontal pad (in w-dimension).
     size_t wPad() const
     {
@@ -196,17 +243,28 @@ public:
     {
         return m_hPad;
     }
+    // Pad in d-dimension.
+    size_t dPad() const
+    {
+        return m_dPad;
+    }
 
 public:
-    PoolingDescriptor(PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad)
+    // d - depth of the window for volumetric tensors, or 0
+    PoolingDescriptor(PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad,
+                      size_t d = 0, size_t dStride = 1, size_t dPad = 0)
     {
         m_kind = kind;
         m_w = w;
         m_h = h;
+        m_d = d > 0 ? d : 1;
+        m_volumetric = d > 0;
         m_wStride = wStride;
         m_hStride = hStride;
+        m_dStride = dStride;
         m_wPad = wPad;
         m_hPad = hPad;
+        m_dPad = dPad;
     }
 
 public:
@@ -219,10 +277,14 @@ private:
     PoolKind m_kind;
     size_t m_w;
     size_t m_h;
+    size_t m_d;
+    bool m_volumetric;
     size_t m_wStride;
     size_t m_hStride;
+    size_t m_dStride;
     size_t m_wPad;
     size_t m_hPad;
+    size_t m_dPad;
 };
 
 template <class ElemType>
@@ -241,6 +303,18 @@ public:
     virtual void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                          const Tensor4D& outT, Mat& out, Mat& workspace) = 0;
 
+    // Forward() followed by adding the per-channel 'bias' (unless empty) and, if 'relu', max(0, x); for inference.
+    // Engines may apply bias and ReLU while writing the output instead of making extra passes over it.
+    virtual void ForwardBiasReLU(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                                 const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace)
+    {
+        Forward(inT, in, filterT, filter, convDesc, outT, out, workspace);
+        if (!bias.IsEmpty())
+            AddBias(outT, out, biasT, bias, out);
+        if (relu)
+            out.InplaceTruncateBottom(0);
+    }
+
     virtual void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                               const Tensor4D& gradT, Mat& grad, Mat& workspace) = 0;
 
@@ -309,11 +383,15 @@ public:
     ConvolutionEngineFactory() = default;
     virtual ~ConvolutionEngineFactory() = default;
 
-    virtual Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) = 0;
-    virtual FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k) = 0;
+    // A depth ('d') other than 0 makes tensors, filters and pooling windows volumetric, for 3-D convolution and pooling;
+    // all tensors of an operation must be alike in that. cuDNN runs those through its Nd descriptors; otherwise a direct
+    // CPU implementation for ImageLayoutKind::CHW (the cuDNN layout) is used, so that such models also run without a GPU.
+    virtual Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d = 0) = 0;
+    virtual FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d = 0) = 0;
     virtual ConvDescPtr CreateConvDescriptor(const Tensor4D& inT, const Filter& filterT,
-                                             size_t wStride, size_t hStride, bool padding) = 0;
-    virtual PoolDescPtr CreatePoolDescriptor(PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) = 0;
+                                             size_t wStride, size_t hStride, bool padding, size_t dStride = 1) = 0;
+    virtual PoolDescPtr CreatePoolDescriptor(PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad,
+                                             size_t d = 0, size_t dStride = 1, size_t dPad = 0) = 0;
     // virtual Tensor4DPtr CreateLrnDescriptor() = 0;
 
     virtual ConvEnginePtr CreateConvEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples) = 0;
@@ -323,7 +401,8 @@ public:
     {
         Auto,
         CuDnn,
-        Legacy
+        Legacy,
+        Direct // CPU: direct (and Winograd) convolution without unpacking the input; otherwise as Legacy
     };
     static std::unique_ptr<ConvolutionEngineFactory<ElemType>> Create(DEVICEID_TYPE deviceId, EngineType engType, ImageLayoutKind imageLayoutKind);
 
@@ -8,6 +8,8 @@
 #include "GPUMatrix.h"
 #ifdef USE_CUDNN
 #include <cudnn.h>
+#include <mutex>
+#include <stdlib.h>
 
 template <>
 const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x)
@@ -39,15 +41,16 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId
 
 #ifdef USE_CUDNN
 
+// Volumetric tensors, and the filters, convolutions and pooling windows that go with them, use the Nd descriptors
+// (NCDHW, 3 spatial dimensions); all others keep the 4d/2d ones.
 class CuDnnTensor4D : public ConvolutionTensor4D
 {
 public:
-    CuDnnTensor4D(size_t w, size_t h, size_t c, size_t n, cudnnDataType_t dataType)
-        : ConvolutionTensor4D(w, h, c, n), m_dataType(dataType), m_tensor(nullptr)
+    CuDnnTensor4D(size_t w, size_t h, size_t c, size_t n, size_t d, cudnnDataType_t dataType)
+        : ConvolutionTensor4D(w, h, c, n, d), m_dataType(dataType), m_tensor(nullptr)
     {
         CUDNN_CALL(cudnnCreateTensorDescriptor(&m_tensor));
-        CUDNN_CALL(cudnnSetTensor4dDescriptor(m_tensor, TENSOR_FORMAT, dataType,
-                                              static_cast<int>(n), static_cast<int>(c), static_cast<int>(h), static_cast<int>(w)));
+        SetDescriptor();
     }
 
 public:
@@ -68,11 +71,23 @@ public:
     void setN(size_t newN) override
     {
         ConvolutionTensor4D::setN(newN);
-        CUDNN_CALL(cudnnSetTensor4dDescriptor(m_tensor, TENSOR_FORMAT, m_dataType,
-                                              static_cast<int>(n()), static_cast<int>(c()), static_cast<int>(h()), static_cast<int>(w())));
+        SetDescriptor();
     }
 
 private:
+    void SetDescriptor()
+    {
+        if (!volumetric())
+        {
+            CUDNN_CALL(cudnnSetTensor4dDescriptor(m_tensor, TENSOR_FORMAT, m_dataType,
+                                                  static_cast<int>(n()), static_cast<int>(c()), static_cast<int>(h()), static_cast<int>(w())));
+            return;
+        }
+        int dims[5] = {static_cast<int>(n()), static_cast<int>(c()), static_cast<int>(d()), static_cast<int>(h()), static_cast<int>(w())};
+        int strides[5] = {dims[1] * dims[2] * dims[3] * dims[4], dims[2] * dims[3] * dims[4], dims[3] * dims[4], dims[4], 1};
+        CUDNN_CALL(cudnnSetTensorNdDescriptor(m_tensor, m_dataType, 5, dims, strides));
+    }
+
     cudnnDataType_t m_dataType;
     cudnnTensorDescriptor_t m_tensor;
 };
@@ -80,12 +95,20 @@ private:
 class CuDnnFilter : public ConvolutionFilter
 {
 public:
-    CuDnnFilter(size_t w, size_t h, size_t c, size_t k, cudnnDataType_t dataType)
-        : ConvolutionFilter(w, h, c, k), m_filter(nullptr)
+    CuDnnFilter(size_t w, size_t h, size_t c, size_t k, size_t d, cudnnDataType_t dataType)
+        : ConvolutionFilter(w, h, c, k, d), m_filter(nullptr)
     {
         CUDNN_CALL(cudnnCreateFilterDescriptor(&m_filter));
-        CUDNN_CALL(cudnnSetFilter4dDescriptor_v4(m_filter, dataType, FILTER_FORMAT,
-                                                 static_cast<int>(k), static_cast<int>(c), static_cast<int>(h), static_cast<int>(w)));
+        if (!volumetric())
+        {
+            CUDNN_CALL(cudnnSetFilter4dDescriptor_v4(m_filter, dataType, FILTER_FORMAT,
+                                                     static_cast<int>(k), static_cast<int>(c), static_cast<int>(h), static_cast<int>(w)));
+        }
+        else
+        {
+            int dims[5] = {static_cast<int>(k), static_cast<int>(c), static_cast<int>(d), static_cast<int>(h), static_cast<int>(w)};
+            CUDNN_CALL(cudnnSetFilterNdDescriptor_v4(m_filter, dataType, FILTER_FORMAT, 5, dims));
+        }
     }
 
 public:
@@ -110,14 +133,25 @@ private:
 class CuDnnConvolutionDescriptor : public ConvolutionDescriptor
 {
 public:
-    CuDnnConvolutionDescriptor(size_t wStride, size_t hStride, size_t wPad, size_t hPad)
-        : ConvolutionDescriptor(wStride, hStride, wPad > 0 || hPad > 0), m_conv(nullptr)
+    // 'volumetric' - for tensors and filters with a depth (Nd descriptors)
+    CuDnnConvolutionDescriptor(size_t wStride, size_t hStride, size_t wPad, size_t hPad, bool volumetric, size_t dStride, size_t dPad, cudnnDataType_t dataType)
+        : ConvolutionDescriptor(wStride, hStride, wPad > 0 || hPad > 0 || dPad > 0, dStride), m_conv(nullptr)
     {
         CUDNN_CALL(cudnnCreateConvolutionDescriptor(&m_conv));
-        CUDNN_CALL(cudnnSetConvolution2dDescriptor(m_conv,
-                                                   static_cast<int>(hPad), static_cast<int>(wPad),
-                                                   static_cast<int>(hStride), static_cast<int>(wStride),
-                                                   1, 1, CUDNN_CROSS_CORRELATION));
+        if (!volumetric)
+        {
+            CUDNN_CALL(cudnnSetConvolution2dDescriptor(m_conv,
+                                                       static_cast<int>(hPad), static_cast<int>(wPad),
+                                                       static_cast<int>(hStride), static_cast<int>(wStride),
+                                                       1, 1, CUDNN_CROSS_CORRELATION));
+        }
+        else
+        {
+            int pads[3] = {static_cast<int>(dPad), static_cast<int>(hPad), static_cast<int>(wPad)};
+            int strides[3] = {static_cast<int>(dStride), static_cast<int>(hStride), static_cast<int>(wStride)};
+            int upscales[3] = {1, 1, 1};
+            CUDNN_CALL(cudnnSetConvolutionNdDescriptor(m_conv, 3, pads, strides, upscales, CUDNN_CROSS_CORRELATION, dataType));
+        }
     }
 
 public:
@@ -142,17 +176,27 @@ private:
 class CuDnnPoolingDescriptor : public PoolingDescriptor
 {
 public:
-    CuDnnPoolingDescriptor(PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad)
-        : PoolingDescriptor(kind, w, h, wStride, hStride, wPad, hPad), m_pool(nullptr)
+    CuDnnPoolingDescriptor(PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad, size_t d, size_t dStride, size_t dPad)
+        : PoolingDescriptor(kind, w, h, wStride, hStride, wPad, hPad, d, dStride, dPad), m_pool(nullptr)
     {
         assert(kind == PoolKind::Max || kind == PoolKind::Average);
 
+        cudnnPoolingMode_t mode = kind == PoolKind::Max ? CUDNN_POOLING_MAX : CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING;
         CUDNN_CALL(cudnnCreatePoolingDescriptor(&m_pool));
-        CUDNN_CALL(cudnnSetPooling2dDescriptor(m_pool,
-                                               kind == PoolKind::Max ? CUDNN_POOLING_MAX : CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING,
-                                               static_cast<int>(h), static_cast<int>(w),
-                                               static_cast<int>(hPad), static_cast<int>(wPad),
-                                               static_cast<int>(hStride), static_cast<int>(wStride)));
+        if (!volumetric())
+        {
+            CUDNN_CALL(cudnnSetPooling2dDescriptor(m_pool, mode,
+                                                   static_cast<int>(h), static_cast<int>(w),
+                                                   static_cast<int>(hPad), static_cast<int>(wPad),
+                                                   static_cast<int>(hStride), static_cast<int>(wStride)));
+        }
+        else
+        {
+            int window[3] = {static_cast<int>(d), static_cast<int>(h), static_cast<int>(w)};
+            int pads[3] = {static_cast<int>(dPad), static_cast<int>(hPad), static_cast<int>(wPad)};
+            int strides[3] = {static_cast<int>(dStride), static_cast<int>(hStride), static_cast<int>(wStride)};
+            CUDNN_CALL(cudnnSetPoolingNdDescriptor(m_pool, mode, 3, window, pads, strides));
+        }
     }
 
 public:
@@ -223,6 +267,72 @@ const float Consts<float>::Zero = 0;
 template <>
 const double Consts<double>::Zero = 0;
 
+// Process-wide cache of the algorithms chosen by the cuDNN auto-tuner, keyed by GPU model, cuDNN version, element
+// type, tensor/filter/convolution shapes and workspace limit. So a shape is benchmarked only once per process, also
+// when the minibatch size alternates (e.g. a smaller last minibatch, or evaluation with another minibatch size).
+// If the environment variable CNTK_CUDNN_ALGO_CACHE names a file, the cache is loaded from it on first use and new
+// results are appended to it, so that later runs on the same kind of GPU skip auto-tuning altogether.
+// Each line of the file is <key><TAB><algorithm>; several processes may append to the same file.
+class CuDnnAlgoCache
+{
+public:
+    static CuDnnAlgoCache& Instance()
+    {
+        static CuDnnAlgoCache cache;
+        return cache;
+    }
+
+    bool Find(const std::string& key, int& algo)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(key);
+        if (entry == m_entries.end())
+            return false;
+        algo = entry->second;
+        return true;
+    }
+
+    void Add(const std::string& key, int algo)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_entries.insert(std::make_pair(key, algo)).second || m_path.empty())
+            return;
+        // a single short write, so that lines from concurrent processes do not interleave
+        std::string line = key + "\t" + std::to_string(algo) + "\n";
+        FILE* f = fopen(m_path.c_str(), "a");
+        if (f == nullptr)
+            return; // the cache is an optimization only
+        fwrite(line.data(), 1, line.size(), f);
+        fclose(f);
+    }
+
+private:
+    CuDnnAlgoCache()
+    {
+        const char* path = getenv("CNTK_CUDNN_ALGO_CACHE");
+        if (path == nullptr || *path == 0)
+            return;
+        m_path = path;
+        FILE* f = fopen(m_path.c_str(), "r");
+        if (f == nullptr)
+            return; // not created yet
+        char buf[1024];
+        while (fgets(buf, sizeof(buf), f) != nullptr)
+        {
+            std::string line(buf);
+            size_t tab = line.rfind('\t');
+            if (tab == std::string::npos || tab == 0)
+                continue; // torn or foreign line
+            m_entries[line.substr(0, tab)] = atoi(line.c_str() + tab + 1);
+        }
+        fclose(f);
+    }
+
+    std::mutex m_mutex;
+    std::string m_path;
+    std::map<std::string, int> m_entries;
+};
+
 template <typename ElemType>
 class CuDnnConvolutionEngine : public ConvolutionEngine<ElemType>
 {
@@ -233,14 +343,20 @@ public:
     using typename Base::Filter;
     using typename Base::ConvDesc;
 
-    CuDnnConvolutionEngine(size_t maxTempMemSizeInSamples)
-        : m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_cudnn(nullptr), m_curMBSize(0)
+    CuDnnConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
+        : m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_workspace(SharedWorkspace(deviceId)), m_cudnn(nullptr), m_fwdMBSize(0), m_backDataMBSize(0), m_backFiltMBSize(0)
     {
         CUDNN_CALL(cudnnCreate(&m_cudnn));
         CUDNN_CALL(cudnnSetStream(m_cudnn, GetStream()));
         m_fwdAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
         m_backDataAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
         m_backFiltAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
+
+        int deviceId = 0;
+        cudaDeviceProp props = {0};
+        CUDA_CALL(cudaGetDevice(&deviceId));
+        CUDA_CALL(cudaGetDeviceProperties(&props, deviceId));
+        m_algoKeyPrefix = msra::strprintf("%s|cudnn %d|%d", props.name, (int) cudnnGetVersion(), (int) sizeof(ElemType));
     }
 
     ~CuDnnConvolutionEngine()
@@ -254,61 +370,58 @@ public:
 
 public:
     void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                 const Tensor4D& outT, Mat& out, Mat& workspace) override
+                 const Tensor4D& outT, Mat& out, Mat& /*workspace*/) override
     {
-        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(filterT.k() == filter.GetNumRows());
-        assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
+        assert(filterT.w() * filterT.h() * filterT.d() * filterT.c() == filter.GetNumCols());
         assert(inT.c() == filterT.c());
         assert(outT.c() == filterT.k());
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestForwardAlgo(t(inT), f(filterT), cd(convDesc), t(outT));
-        if (m_fwdAlgo.memory > 0)
-            workspace.Resize((m_fwdAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        Mat& workspace = Workspace(m_fwdAlgo.memory);
         // Perform forward convolution operation.
         CUDNN_CALL(cudnnConvolutionForward(m_cudnn, &C::One, t(inT), ptr(in), f(filterT), ptr(filter), cd(convDesc), m_fwdAlgo.algo,
                                            ptr(workspace), m_fwdAlgo.memory, &C::Zero, t(outT), ptr(out)));
     }
 
     void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                      const Tensor4D& gradT, Mat& grad, Mat& workspace) override
+                      const Tensor4D& gradT, Mat& grad, Mat& /*workspace*/) override
     {
-        assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
+        assert(srcGradT.w() * srcGradT.h() * srcGradT.d() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
         assert(filterT.k() == filter.GetNumRows());
-        assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
+        assert(filterT.w() * filterT.h() * filterT.d() * filterT.c() == filter.GetNumCols());
         assert(srcGradT.c() == filterT.k());
         assert(gradT.c() == filterT.c());
-        assert(gradT.w() * gradT.h() * gradT.c() == grad.GetNumRows());
+        assert(gradT.w() * gradT.h() * gradT.d() * gradT.c() == grad.GetNumRows());
         assert(gradT.n() == grad.GetNumCols());
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestBackwardDataAlgo(f(filterT), t(srcGradT), cd(convDesc), t(gradT));
-        if (m_backDataAlgo.memory > 0)
-            workspace.Resize((m_backDataAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        Mat& workspace = Workspace(m_backDataAlgo.memory);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardData(m_cudnn, &C::One, f(filterT), ptr(filter), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backDataAlgo.algo,
                                                 ptr(workspace), m_backDataAlgo.memory, &C::One, t(gradT), ptr(grad)));
     }
 
     void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
-                        const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& workspace) override
+                        const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& /*workspace*/) override
     {
-        assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
+        assert(srcGradT.w() * srcGradT.h() * srcGradT.d() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
-        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(srcGradT.c() == filterT.k());
         assert(inT.c() == filterT.c());
         assert(filterT.k() == filter.GetNumRows());
-        assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
+        assert(filterT.w() * filterT.h() * filterT.d() * filterT.c() == filter.GetNumCols());
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestBackwardFilterAlgo(t(inT), t(srcGradT), cd(convDesc), f(filterT));
-        if (m_backFiltAlgo.memory > 0)
-            workspace.Resize((m_backFiltAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        Mat& workspace = Workspace(m_backFiltAlgo.memory);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardFilter(m_cudnn, &C::One, t(inT), ptr(in), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backFiltAlgo.algo,
                                                   ptr(workspace), m_backFiltAlgo.memory, &C::One, f(filterT), ptr(filter)));
@@ -320,7 +433,7 @@ public:
         assert(biasT.w() == 1);
         assert(biasT.h() == 1);
         assert(biasT.n() == 1);
-        assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
 
         CUDNN_CALL(cudnnAddTensor(m_cudnn, &C::One, t(outT), ptr(out), &C::Zero, t(outT), ptr(dst)));
@@ -340,7 +453,7 @@ public:
     void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                         bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev) override
     {
-        const size_t crowIn = inT.w() * inT.h() * inT.c();
+        const size_t crowIn = inT.w() * inT.h() * inT.d() * inT.c();
         UNUSED(crowIn); // crowIn used only in asserts.
         if (spatial)
         {
@@ -376,7 +489,7 @@ public:
     void NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                  bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
     {
-        const size_t crowIn = inT.w() * inT.h() * inT.c();
+        const size_t crowIn = inT.w() * inT.h() * inT.d() * inT.c();
 
         if (spatial)
         {
@@ -423,7 +536,7 @@ public:
             assert(scaleBiasT.h() == inT.h());
         }
         assert(scaleBiasT.n() == 1);
-        const size_t crowIn = inT.w() * inT.h() * inT.c();
+        const size_t crowIn = inT.w() * inT.h() * inT.d() * inT.c();
         assert(crowIn == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(saveMean.GetNumElements() >= scale.GetNumElements());
@@ -440,19 +553,59 @@ public:
     }
 
 private:
+    // The workspace passed in by the node is not used. cuDNN needs a workspace only for the duration of a call, and all
+    // engines issue their calls on the same stream, so the engines of a device share one buffer that grows to the
+    // largest requirement, instead of each convolution node holding its own from forward prop through backprop.
+    // This leaves memory for larger minibatches, and for the faster algorithms that need more workspace.
+    static std::shared_ptr<Mat> SharedWorkspace(DEVICEID_TYPE deviceId)
+    {
+        static std::mutex mutex;
+        static std::map<DEVICEID_TYPE, std::weak_ptr<Mat>> workspaces;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<Mat> workspace = workspaces[deviceId].lock();
+        if (!workspace)
+        {
+            workspace = std::make_shared<Mat>(deviceId);
+            workspaces[deviceId] = workspace;
+        }
+        return workspace;
+    }
+
+    Mat& Workspace(size_t bytes)
+    {
+        size_t numElements = (bytes + sizeof(ElemType) - 1) / sizeof(ElemType);
+        if (m_workspace->GetNumElements() < numElements)
+            m_workspace->Resize(numElements, 1);
+        return *m_workspace;
+    }
+
     void FindBestForwardAlgo(const CuDnnTensor4D& inT, const CuDnnFilter& filtT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnTensor4D& outT)
     {
         // Need to re-run auto-tuner in case batch size has been changed.
         // We assume no other dimensions of tensors can change so we don't check it.
         // REVIEW alexeyk: is this a safe assumption? Can convolution configuration change in runtime?
-        if (m_fwdAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_curMBSize && outT.n() == m_curMBSize)
+        if (m_fwdAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_fwdMBSize && outT.n() == m_fwdMBSize)
             return;
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.d() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        std::string key = AlgoKey("fwd", inT, filtT, convDesc, maxMem);
+        int algo;
+        if (CuDnnAlgoCache::Instance().Find(key, algo))
+        {
+            size_t memory;
+            if (cudnnGetConvolutionForwardWorkspaceSize(m_cudnn, inT, filtT, convDesc, outT, (cudnnConvolutionFwdAlgo_t) algo, &memory) == CUDNN_STATUS_SUCCESS && memory <= maxMem)
+            {
+                m_fwdMBSize = inT.n();
+                m_fwdAlgo.algo = (cudnnConvolutionFwdAlgo_t) algo;
+                m_fwdAlgo.status = CUDNN_STATUS_SUCCESS;
+                m_fwdAlgo.memory = memory;
+                return;
+            }
+        }
         const int MaxAlgoCount = 10;
         int calgo = 0;
         cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount];
         CUDNN_CALL(cudnnFindConvolutionForwardAlgorithm(m_cudnn, inT, filtT, convDesc, outT, MaxAlgoCount, &calgo, algoPerf));
         assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
         auto res = std::find_if(algoPerf, algoPerf + calgo,
                                 [=](const cudnnConvolutionFwdAlgoPerf_t& cur)
                                 {
@@ -460,20 +613,35 @@ private:
                                 });
         if (res == algoPerf + calgo)
             RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionForward.");
-        m_curMBSize = inT.n();
+        m_fwdMBSize = inT.n();
         m_fwdAlgo = *res;
+        CuDnnAlgoCache::Instance().Add(key, (int) res->algo);
     }
 
     void FindBestBackwardDataAlgo(const CuDnnFilter& filtT, const CuDnnTensor4D& srcGradT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnTensor4D& gradT)
     {
-        if (m_backDataAlgo.status == CUDNN_STATUS_SUCCESS && srcGradT.n() == m_curMBSize && gradT.n() == m_curMBSize)
+        if (m_backDataAlgo.status == CUDNN_STATUS_SUCCESS && srcGradT.n() == m_backDataMBSize && gradT.n() == m_backDataMBSize)
             return;
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : gradT.w() * gradT.h() * gradT.d() * gradT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        std::string key = AlgoKey("bwdData", gradT, filtT, convDesc, maxMem);
+        int algo;
+        if (CuDnnAlgoCache::Instance().Find(key, algo))
+        {
+            size_t memory;
+            if (cudnnGetConvolutionBackwardDataWorkspaceSize(m_cudnn, filtT, srcGradT, convDesc, gradT, (cudnnConvolutionBwdDataAlgo_t) algo, &memory) == CUDNN_STATUS_SUCCESS && memory <= maxMem)
+            {
+                m_backDataMBSize = srcGradT.n();
+                m_backDataAlgo.algo = (cudnnConvolutionBwdDataAlgo_t) algo;
+                m_backDataAlgo.status = CUDNN_STATUS_SUCCESS;
+                m_backDataAlgo.memory = memory;
+                return;
+            }
+        }
         const int MaxAlgoCount = 10;
         int calgo = 0;
         cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount];
         CUDNN_CALL(cudnnFindConvolutionBackwardDataAlgorithm(m_cudnn, filtT, srcGradT, convDesc, gradT, MaxAlgoCount, &calgo, algoPerf));
         assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : gradT.w() * gradT.h() * gradT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
         auto res = std::find_if(algoPerf, algoPerf + calgo,
                                 [=](const cudnnConvolutionBwdDataAlgoPerf_t& cur)
                                 {
@@ -481,20 +649,35 @@ private:
                                 });
         if (res == algoPerf + calgo)
             RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardData.");
-        m_curMBSize = srcGradT.n();
+        m_backDataMBSize = srcGradT.n();
         m_backDataAlgo = *res;
+        CuDnnAlgoCache::Instance().Add(key, (int) res->algo);
     }
 
     void FindBestBackwardFilterAlgo(const CuDnnTensor4D& inT, const CuDnnTensor4D& srcGradT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnFilter& filtT)
     {
-        if (m_backFiltAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_curMBSize && srcGradT.n() == m_curMBSize)
+        if (m_backFiltAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_backFiltMBSize && srcGradT.n() == m_backFiltMBSize)
             return;
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.d() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        std::string key = AlgoKey("bwdFilter", inT, filtT, convDesc, maxMem);
+        int algo;
+        if (CuDnnAlgoCache::Instance().Find(key, algo))
+        {
+            size_t memory;
+            if (cudnnGetConvolutionBackwardFilterWorkspaceSize(m_cudnn, inT, srcGradT, convDesc, filtT, (cudnnConvolutionBwdFilterAlgo_t) algo, &memory) == CUDNN_STATUS_SUCCESS && memory <= maxMem)
+            {
+                m_backFiltMBSize = inT.n();
+                m_backFiltAlgo.algo = (cudnnConvolutionBwdFilterAlgo_t) algo;
+                m_backFiltAlgo.status = CUDNN_STATUS_SUCCESS;
+                m_backFiltAlgo.memory = memory;
+                return;
+            }
+        }
         const int MaxAlgoCount = 10;
         int calgo = 0;
         cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount];
         CUDNN_CALL(cudnnFindConvolutionBackwardFilterAlgorithm(m_cudnn, inT, srcGradT, convDesc, filtT, MaxAlgoCount, &calgo, algoPerf));
         assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
         auto res = std::find_if(algoPerf, algoPerf + calgo,
                                 [=](const cudnnConvolutionBwdFilterAlgoPerf_t& cur)
                                 {
@@ -502,8 +685,23 @@ private:
                                 });
         if (res == algoPerf + calgo)
             RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardFilter.");
-        m_curMBSize = inT.n();
+        m_backFiltMBSize = inT.n();
         m_backFiltAlgo = *res;
+        CuDnnAlgoCache::Instance().Add(key, (int) res->algo);
+    }
+
+    // key into CuDnnAlgoCache; 'inT' is the input of the forward convolution (the gradient w.r.t. it for BackwardData)
+    std::string AlgoKey(const char* op, const CuDnnTensor4D& inT, const CuDnnFilter& filtT, const CuDnnConvolutionDescriptor& convDesc, size_t maxMem) const
+    {
+        std::string key = msra::strprintf("%s|%s|in %dx%dx%dx%d|filter %dx%dx%dx%d|stride %dx%d pad %d|ws %llu",
+                                          m_algoKeyPrefix.c_str(), op,
+                                          (int) inT.w(), (int) inT.h(), (int) inT.c(), (int) inT.n(),
+                                          (int) filtT.w(), (int) filtT.h(), (int) filtT.c(), (int) filtT.k(),
+                                          (int) convDesc.wStride(), (int) convDesc.hStride(), (int) convDesc.padding(),
+                                          (unsigned long long) maxMem);
+        if (inT.volumetric()) // (appended, so that the keys of existing cache files stay valid)
+            key += msra::strprintf("|depth in %d filter %d stride %d", (int) inT.d(), (int) filtT.d(), (int) convDesc.dStride());
+        return key;
     }
 
 private:
@@ -511,9 +709,14 @@ private:
 
     // REVIEW alexeyk: currently limit is set once in ctor though in CNTK it can be, theoretically, changed in runtime.
     size_t m_maxTempMemSizeInSamples;
+    std::shared_ptr<Mat> m_workspace;
     cudnnHandle_t m_cudnn;
-    // Current mini-batch size, needed for re-computing statistics in auto-tuner.
-    size_t m_curMBSize;
+    // Mini-batch size each algorithm was selected for, needed for re-computing statistics in auto-tuner.
+    size_t m_fwdMBSize;
+    size_t m_backDataMBSize;
+    size_t m_backFiltMBSize;
+    // GPU model, cuDNN version and element type, the part of the CuDnnAlgoCache key common to all shapes
+    std::string m_algoKeyPrefix;
     cudnnConvolutionFwdAlgoPerf_t m_fwdAlgo;
     cudnnConvolutionBwdDataAlgoPerf_t m_backDataAlgo;
     cudnnConvolutionBwdFilterAlgoPerf_t m_backFiltAlgo;
@@ -548,9 +751,9 @@ public:
 public:
     void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
     {
-        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
-        assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
 
         CUDNN_CALL(cudnnPoolingForward(m_cudnn, p(poolDesc), &C::One, t(inT), ptr(in), &C::Zero, t(outT), ptr(out)));
@@ -558,11 +761,11 @@ public:
 
     void Backward(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
     {
-        assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
+        assert(outT.w() * outT.h() * outT.d() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
         assert(out.GetNumRows() == srcGrad.GetNumRows());
         assert(out.GetNumCols() == srcGrad.GetNumCols());
-        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.w() * inT.h() * inT.d() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(in.GetNumRows() == grad.GetNumRows());
         assert(in.GetNumCols() == grad.GetNumCols());
@@ -578,60 +781,64 @@ private:
 };
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t w, size_t h, size_t c, size_t n)
+typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d)
 {
     // REVIEW alexeyk: assert fires in GCC but not in VC++.
     // static_assert(false, "cuDNN engine currently supports only single and double precision tensors.");
 }
 template <>
-typename CuDnnConvolutionEngineFactory<float>::Tensor4DPtr CuDnnConvolutionEngineFactory<float>::CreateTensor(size_t w, size_t h, size_t c, size_t n)
+typename CuDnnConvolutionEngineFactory<float>::Tensor4DPtr CuDnnConvolutionEngineFactory<float>::CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d)
 {
-    return std::make_unique<CuDnnTensor4D>(w, h, c, n, CUDNN_DATA_FLOAT);
+    return std::make_unique<CuDnnTensor4D>(w, h, c, n, d, CUDNN_DATA_FLOAT);
 }
 template <>
-typename CuDnnConvolutionEngineFactory<double>::Tensor4DPtr CuDnnConvolutionEngineFactory<double>::CreateTensor(size_t w, size_t h, size_t c, size_t n)
+typename CuDnnConvolutionEngineFactory<double>::Tensor4DPtr CuDnnConvolutionEngineFactory<double>::CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d)
 {
-    return std::make_unique<CuDnnTensor4D>(w, h, c, n, CUDNN_DATA_DOUBLE);
+    return std::make_unique<CuDnnTensor4D>(w, h, c, n, d, CUDNN_DATA_DOUBLE);
 }
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t w, size_t h, size_t c, size_t k)
+typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d)
 {
     // REVIEW alexeyk: assert fires in GCC but not in VC++.
     // static_assert(false, "cuDNN engine currently supports only single and double precision filters.");
 }
 template <>
-typename CuDnnConvolutionEngineFactory<float>::FilterPtr CuDnnConvolutionEngineFactory<float>::CreateFilter(size_t w, size_t h, size_t c, size_t k)
+typename CuDnnConvolutionEngineFactory<float>::FilterPtr CuDnnConvolutionEngineFactory<float>::CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d)
 {
-    return std::make_unique<CuDnnFilter>(w, h, c, k, CUDNN_DATA_FLOAT);
+    return std::make_unique<CuDnnFilter>(w, h, c, k, d, CUDNN_DATA_FLOAT);
 }
 template <>
-typename CuDnnConvolutionEngineFactory<double>::FilterPtr CuDnnConvolutionEngineFactory<double>::CreateFilter(size_t w, size_t h, size_t c, size_t k)
+typename CuDnnConvolutionEngineFactory<double>::FilterPtr CuDnnConvolutionEngineFactory<double>::CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d)
 {
-    return std::make_unique<CuDnnFilter>(w, h, c, k, CUDNN_DATA_DOUBLE);
+    return std::make_unique<CuDnnFilter>(w, h, c, k, d, CUDNN_DATA_DOUBLE);
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D& /*inT*/, const Filter& filterT, size_t wStride, size_t hStride, bool padding)
+    const Tensor4D& inT, const Filter& filterT, size_t wStride, size_t hStride, bool padding, size_t dStride)
 {
+    if (inT.volumetric() != filterT.volumetric())
+        InvalidArgument("CreateConvDescriptor: The input and the filter must both be volumetric, or neither.");
     size_t wPad = padding ? filterT.w() / 2 : 0;
     size_t hPad = padding ? filterT.h() / 2 : 0;
-    return std::make_unique<CuDnnConvolutionDescriptor>(wStride, hStride, wPad, hPad);
+    size_t dPad = padding ? filterT.d() / 2 : 0;
+    return std::make_unique<CuDnnConvolutionDescriptor>(wStride, hStride, wPad, hPad, inT.volumetric(), dStride, dPad,
+                                                        sizeof(ElemType) == sizeof(float) ? CUDNN_DATA_FLOAT : CUDNN_DATA_DOUBLE);
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::PoolDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreatePoolDescriptor(
-    typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad)
+    typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad, size_t d, size_t dStride, size_t dPad)
 {
-    return std::make_unique<CuDnnPoolingDescriptor>(kind, w, h, wStride, hStride, wPad, hPad);
+    return std::make_unique<CuDnnPoolingDescriptor>(kind, w, h, wStride, hStride, wPad, hPad, d, dStride, dPad);
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvEnginePtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvEngine(
-    DEVICEID_TYPE /*deviceId*/, size_t maxTempMemSizeInSamples)
+    DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
 {
-    return std::make_unique<CuDnnConvolutionEngine<ElemType>>(maxTempMemSizeInSamples);
+    return std::make_unique<CuDnnConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples);
 }
 
 template <class ElemType>
@@ -644,27 +851,27 @@ typename CuDnnConvolutionEngineFactory<ElemType>::PoolEnginePtr CuDnnConvolution
 #else
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t, size_t, size_t, size_t)
+typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled without USE_CUDNN macro.");
 }
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t, size_t, size_t, size_t)
+typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled without USE_CUDNN macro.");
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D&, const Filter&, size_t, size_t, bool)
+    const Tensor4D&, const Filter&, size_t, size_t, bool, size_t)
 {
     RuntimeError("The code is compiled without USE_CUDNN macro.");
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::PoolDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreatePoolDescriptor(
-    typename PoolDesc::PoolKind, size_t, size_t, size_t, size_t, size_t, size_t)
+    typename PoolDesc::PoolKind, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled without USE_CUDNN macro.");
 }
@@ -27,11 +27,12 @@ public:
     using typename Base::PoolEnginePtr;
 
 public:
-    Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) override;
-    FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k) override;
+    Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n, size_t d) override;
+    FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k, size_t d) override;
     ConvDescPtr CreateConvDescriptor(const Tensor4D& inT, const Filter& filterT,
-                                     size_t wStride, size_t hStride, bool padding) override;
-    PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) override;
+                                     size_t wStride, size_t hStride, bool padding, size_t dStride) override;
+    PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad,
+                                     size_t d, size_t dStride, size_t dPad) override;
 
     ConvEnginePtr CreateConvEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples) override;
     PoolEnginePtr CreatePoolEngine(DEVICEID_TYPE deviceId) override;
@@ -0,0 +1,117 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DeviceTransferMonitor.cpp -- finds the matrix transfers between devices that Matrix operations do implicitly
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "DeviceTransferMonitor.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::atomic<int> s_mode(DeviceTransferMonitor::allow);
+
+// the current thread's scope
+#ifdef _WIN32
+__declspec(thread)
+#else
+__thread
+#endif
+    const std::wstring* t_scope = nullptr;
+
+// [scope, rows, cols, from device, to device] -> count, bytes
+typedef std::tuple<std::wstring, size_t, size_t, int, int> TransferKey;
+struct TransferTotals
+{
+    size_t count;
+    size_t numBytes;
+};
+static std::mutex s_mutex; // transfers come from the OpenMP threads of concurrent forward prop, too
+static std::map<TransferKey, TransferTotals> s_totals;
+
+/*static*/ void DeviceTransferMonitor::SetMode(Mode mode)
+{
+    s_mode = mode;
+}
+
+/*static*/ DeviceTransferMonitor::Mode DeviceTransferMonitor::GetMode()
+{
+    return (Mode) s_mode.load(std::memory_order_relaxed);
+}
+
+/*static*/ DeviceTransferMonitor::Mode DeviceTransferMonitor::ParseMode(const std::wstring& mode)
+{
+    if (!_wcsicmp(mode.c_str(), L"allow"))
+        return allow;
+    else if (!_wcsicmp(mode.c_str(), L"trace"))
+        return trace;
+    else if (!_wcsicmp(mode.c_str(), L"fail"))
+        return fail;
+    InvalidArgument("implicitDeviceTransfers: '%ls' is not one of 'allow', 'trace', 'fail'.", mode.c_str());
+}
+
+/*static*/ const std::wstring* DeviceTransferMonitor::Enter(const std::wstring* name)
+{
+    const std::wstring* outer = t_scope;
+    t_scope = name;
+    return outer;
+}
+
+static std::string DeviceName(int deviceId)
+{
+    return deviceId < 0 ? std::string("CPU") : msra::strfun::strprintf("GPU %d", deviceId);
+}
+
+/*static*/ void DeviceTransferMonitor::OnImplicitTransfer(size_t numRows, size_t numCols, size_t numBytes, int fromDeviceId, int toDeviceId)
+{
+    Mode mode = GetMode();
+    if (mode == allow)
+        return;
+    std::wstring scope = t_scope ? *t_scope : std::wstring(L"(outside of forward/backward)");
+    if (mode == fail && t_scope)
+        RuntimeError("Implicit transfer of a [%d x %d] matrix from %s to %s in %ls (implicitDeviceTransfers=fail).",
+                     (int) numRows, (int) numCols, DeviceName(fromDeviceId).c_str(), DeviceName(toDeviceId).c_str(), scope.c_str());
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto& totals = s_totals[TransferKey(scope, numRows, numCols, fromDeviceId, toDeviceId)];
+    totals.count++;
+    totals.numBytes += numBytes;
+}
+
+/*static*/ void DeviceTransferMonitor::WriteSummary(FILE* f)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_totals.empty())
+        return;
+    typedef std::pair<TransferKey, TransferTotals> Entry;
+    std::vector<Entry> sorted(s_totals.begin(), s_totals.end());
+    std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b)
+              {
+                  return a.second.numBytes > b.second.numBytes;
+              });
+    fprintf(f, "\nImplicit device transfers:\n");
+    fprintf(f, "%10s %12s  %-14s %-8s %-8s %s\n", "count", "MB", "matrix", "from", "to", "in");
+    for (const auto& entry : sorted)
+    {
+        const TransferKey& key = entry.first;
+        fprintf(f, "%10d %12.3f  %-14s %-8s %-8s %ls\n", (int) entry.second.count, entry.second.numBytes / 1048576.0,
+                msra::strfun::strprintf("[%d x %d]", (int) std::get<1>(key), (int) std::get<2>(key)).c_str(),
+                DeviceName(std::get<3>(key)).c_str(), DeviceName(std::get<4>(key)).c_str(), std::get<0>(key).c_str());
+    }
+    fprintf(f, "\n");
+}
+
+/*static*/ void DeviceTransferMonitor::Reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_totals.clear();
+}
+} } }
@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DeviceTransferMonitor.h -- finds the matrix transfers between devices that Matrix operations do implicitly
+//
+// A Matrix operation whose operands live on different devices first moves them to a common one (see
+// Matrix::DecideAndMoveToRightDevice()). That keeps things working, but a matrix that goes back and forth every
+// minibatch can easily cost more than the computation, and nothing tells. In 'trace' mode, each implicit transfer is
+// counted per (scope, matrix size, direction), where the scope is the node being computed (set by ComputationNetwork
+// through Scope objects), and WriteSummary() lists them. In 'fail' mode, an implicit transfer inside a scope throws
+// instead. Explicit transfers (TransferToDeviceIfNotThere() etc.) are never counted.
+//
+
+#pragma once
+
+#include "MemAllocator.h" // for MATH_API
+#include <cstdio>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API DeviceTransferMonitor
+{
+public:
+    enum Mode
+    {
+        allow, // (default) not monitored
+        trace,
+        fail
+    };
+    static void SetMode(Mode mode);
+    static Mode GetMode();
+    // "allow", "trace", or "fail"
+    static Mode ParseMode(const std::wstring& mode);
+
+    // implicit transfers on the current thread are attributed to 'name' (e.g. the node being computed) from
+    // construction to destruction; scopes nest
+    class Scope
+    {
+    public:
+        Scope(const std::wstring& name)
+            : m_outer(Enter(&name))
+        {
+        }
+        ~Scope()
+        {
+            Enter(m_outer);
+        }
+
+    private:
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+        const std::wstring* m_outer;
+    };
+
+    // called by Matrix for every implicit transfer (if the mode is not 'allow')
+    static void OnImplicitTransfer(size_t numRows, size_t numCols, size_t numBytes, int fromDeviceId, int toDeviceId);
+
+    // the transfers counted since the last Reset(), most bytes first
+    static void WriteSummary(FILE* f);
+    static void Reset();
+
+private:
+    static const std::wstring* Enter(const std::wstring* name); // sets the current thread's scope; returns the previous one
+};
+} } }
@@ -0,0 +1,249 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "ExecutionProfiler.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for CUDA_CALL, GetStream(), PrepareDevice()
+#include <cuda_runtime_api.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::atomic<ExecutionProfiler*> s_activeProfiler(nullptr);
+
+/*static*/ ExecutionProfiler* ExecutionProfiler::Active()
+{
+    return s_activeProfiler.load(std::memory_order_relaxed);
+}
+
+/*static*/ void ExecutionProfiler::Start(int deviceId)
+{
+    if (!Active())
+        s_activeProfiler = new ExecutionProfiler(deviceId);
+}
+
+/*static*/ void ExecutionProfiler::Stop()
+{
+    delete s_activeProfiler.exchange(nullptr);
+}
+
+ExecutionProfiler::ExecutionProfiler(int deviceId)
+    : m_deviceId(deviceId), m_gpuStart(nullptr), m_numMinibatches(0)
+{
+#ifdef CPUONLY
+    m_deviceId = -1;
+#else
+    if (m_deviceId >= 0)
+    {
+        PrepareDevice(m_deviceId);
+        m_gpuStart = GetCUDAEvent();
+        CUDA_CALL(cudaEventRecord((cudaEvent_t) m_gpuStart, GetStream()));
+    }
+#endif
+    m_hostStart = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ExecutionProfiler::~ExecutionProfiler()
+{
+#ifndef CPUONLY
+    if (m_deviceId >= 0)
+    {
+        cudaDeviceSynchronize();
+        for (const auto& event : m_pending)
+        {
+            if (event.gpuBegin)
+                m_freeCUDAEvents.push_back(event.gpuBegin);
+            if (event.gpuEnd)
+                m_freeCUDAEvents.push_back(event.gpuEnd);
+        }
+        m_freeCUDAEvents.push_back(m_gpuStart);
+        for (auto event : m_freeCUDAEvents)
+            cudaEventDestroy((cudaEvent_t) event);
+    }
+#endif
+}
+
+// microseconds since Start()
+double ExecutionProfiler::HostTime() const
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (std::chrono::duration<double>(now).count() - m_hostStart) * 1e6;
+}
+
+void* ExecutionProfiler::GetCUDAEvent()
+{
+#ifndef CPUONLY
+    if (m_freeCUDAEvents.empty())
+    {
+        cudaEvent_t event;
+        CUDA_CALL(cudaEventCreate(&event));
+        return event;
+    }
+    void* event = m_freeCUDAEvents.back();
+    m_freeCUDAEvents.pop_back();
+    return event;
+#else
+    return nullptr;
+#endif
+}
+
+size_t ExecutionProfiler::BeginEvent(const std::wstring& name, const char* category)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Event event;
+    event.name = name;
+    event.category = category;
+    auto threadIndex = m_threadIndices.find(std::this_thread::get_id());
+    if (threadIndex == m_threadIndices.end())
+        threadIndex = m_threadIndices.insert(std::make_pair(std::this_thread::get_id(), m_threadIndices.size())).first;
+    event.threadIndex = threadIndex->second;
+    event.gpuBegin = nullptr;
+    event.gpuEnd = nullptr;
+    event.gpuBeginTime = 0;
+    event.gpuDuration = 0;
+#ifndef CPUONLY
+    if (m_deviceId >= 0)
+    {
+        event.gpuBegin = GetCUDAEvent();
+        CUDA_CALL(cudaEventRecord((cudaEvent_t) event.gpuBegin, GetStream()));
+    }
+#endif
+    event.hostBegin = HostTime();
+    event.hostEnd = event.hostBegin;
+    m_pending.push_back(std::move(event));
+    return m_pending.size() - 1;
+}
+
+void ExecutionProfiler::EndEvent(size_t index)
+{
+    double hostEnd = HostTime();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& event = m_pending[index];
+    event.hostEnd = hostEnd;
+#ifndef CPUONLY
+    if (m_deviceId >= 0)
+    {
+        event.gpuEnd = GetCUDAEvent();
+        CUDA_CALL(cudaEventRecord((cudaEvent_t) event.gpuEnd, GetStream()));
+    }
+#endif
+}
+
+void ExecutionProfiler::EndMinibatch()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+#ifndef CPUONLY
+    if (m_deviceId >= 0)
+        CUDA_CALL(cudaDeviceSynchronize()); // the events may be on several streams
+#endif
+    for (auto& event : m_pending)
+    {
+#ifndef CPUONLY
+        if (event.gpuBegin && event.gpuEnd)
+        {
+            float beginTime, duration; // (milliseconds)
+            CUDA_CALL(cudaEventElapsedTime(&beginTime, (cudaEvent_t) m_gpuStart, (cudaEvent_t) event.gpuBegin));
+            CUDA_CALL(cudaEventElapsedTime(&duration, (cudaEvent_t) event.gpuBegin, (cudaEvent_t) event.gpuEnd));
+            event.gpuBeginTime = beginTime * 1e3;
+            event.gpuDuration = duration * 1e3;
+        }
+        if (event.gpuBegin)
+            m_freeCUDAEvents.push_back(event.gpuBegin);
+        if (event.gpuEnd)
+            m_freeCUDAEvents.push_back(event.gpuEnd);
+        event.gpuBegin = event.gpuEnd = nullptr;
+#endif
+        auto& totals = m_totals[std::make_pair(std::string(event.category), event.name)];
+        totals.count++;
+        totals.hostTime += event.hostEnd - event.hostBegin;
+        totals.gpuTime += event.gpuDuration;
+        m_trace.push_back(std::move(event));
+    }
+    m_pending.clear();
+    m_numMinibatches++;
+}
+
+void ExecutionProfiler::WriteSummary(FILE* f) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool gpu = m_deviceId >= 0;
+    auto timeOf = [gpu](const Totals& totals) { return gpu ? totals.gpuTime : totals.hostTime; };
+
+    std::map<std::string, Totals> categoryTotals;
+    for (const auto& iter : m_totals)
+    {
+        auto& totals = categoryTotals[iter.first.first];
+        totals.count += iter.second.count;
+        totals.hostTime += iter.second.hostTime;
+        totals.gpuTime += iter.second.gpuTime;
+    }
+
+    fprintf(f, "\nExecution profile of %d minibatches (times in ms per minibatch%s):\n",
+            (int) m_numMinibatches, gpu ? "; GPU: between CUDA events around each node or phase" : "");
+    size_t numMinibatches = std::max(m_numMinibatches, (size_t) 1);
+    fprintf(f, "%12s %12s %10s  %s\n", "host", gpu ? "GPU" : "", "calls", "category");
+    for (const auto& iter : categoryTotals)
+    {
+        fprintf(f, "%12.3f %12s %10.1f  %s\n", iter.second.hostTime / 1e3 / numMinibatches,
+                gpu ? msra::strfun::strprintf("%.3f", iter.second.gpuTime / 1e3 / numMinibatches).c_str() : "",
+                (double) iter.second.count / numMinibatches, iter.first.c_str());
+    }
+
+    typedef std::pair<std::pair<std::string, std::wstring>, Totals> Entry;
+    std::vector<Entry> sorted(m_totals.begin(), m_totals.end());
+    std::sort(sorted.begin(), sorted.end(), [&](const Entry& a, const Entry& b)
+              {
+                  return timeOf(a.second) > timeOf(b.second);
+              });
+    fprintf(f, "\n%12s %12s %10s  %-12s %s\n", "host", gpu ? "GPU" : "", "calls", "category", "node or phase");
+    for (const auto& iter : sorted)
+    {
+        fprintf(f, "%12.3f %12s %10.1f  %-12s %ls\n", iter.second.hostTime / 1e3 / numMinibatches,
+                gpu ? msra::strfun::strprintf("%.3f", iter.second.gpuTime / 1e3 / numMinibatches).c_str() : "",
+                (double) iter.second.count / numMinibatches, iter.first.first.c_str(), iter.first.second.c_str());
+    }
+    fprintf(f, "\n");
+}
+
+static std::string JsonEscaped(const std::string& s)
+{
+    std::string escaped;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char) c < 0x20)
+            escaped += msra::strfun::strprintf("\\u%04x", (int) c);
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+// Chrome trace event format: complete events ("ph":"X"), process 0 holding the host threads, process 1 the GPU
+void ExecutionProfiler::WriteChromeTrace(const std::wstring& path) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FILE* f = _wfopen(path.c_str(), L"w");
+    if (!f)
+        RuntimeError("ExecutionProfiler: Cannot open '%ls' for writing.", path.c_str());
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"host\"}}");
+    if (m_deviceId >= 0)
+        fprintf(f, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU %d\"}}", m_deviceId);
+    for (const auto& event : m_trace)
+    {
+        std::string name = JsonEscaped(msra::strfun::utf8(event.name));
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                name.c_str(), event.category, (int) event.threadIndex, event.hostBegin, event.hostEnd - event.hostBegin);
+        if (m_deviceId >= 0)
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+                    name.c_str(), event.category, event.gpuBeginTime, event.gpuDuration);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+} } }
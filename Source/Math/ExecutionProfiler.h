@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ExecutionProfiler.h -- where the time of a minibatch goes: per node and per training phase
+//
+// While a profiler is started, ComputationNetwork times the forward and backward pass of each node, and SGD the reading,
+// gradient aggregation and parameter update of each minibatch, through Scope objects. Each event gets the host wall time
+// of the thread that issued it and, on a GPU, the time between CUDA events recorded on that thread's stream before and
+// after it, i.e. the time its kernels took where they ran rather than where they were launched. The GPU times are
+// collected in EndMinibatch(), which waits for the device, so training is slower while profiling.
+// The results are per-(category, name) totals (WriteSummary()) and a timeline in the Chrome trace event format
+// (WriteChromeTrace(); load it into chrome://tracing or Perfetto).
+//
+
+#pragma once
+
+#include "MemAllocator.h" // for MATH_API
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API ExecutionProfiler
+{
+public:
+    // the started profiler, or nullptr if none
+    static ExecutionProfiler* Active();
+    // deviceId is the device whose kernels to time (< 0: host times only)
+    static void Start(int deviceId);
+    static void Stop();
+
+    // one event: from construction to destruction on the current thread; does nothing if no profiler is started
+    class Scope
+    {
+    public:
+        Scope(const std::wstring& name, const char* category)
+            : m_profiler(Active()), m_event(m_profiler ? m_profiler->BeginEvent(name, category) : 0)
+        {
+        }
+        ~Scope()
+        {
+            if (m_profiler)
+                m_profiler->EndEvent(m_event);
+        }
+
+    private:
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+        ExecutionProfiler* m_profiler;
+        size_t m_event;
+    };
+
+    size_t BeginEvent(const std::wstring& name, const char* category);
+    void EndEvent(size_t event);
+
+    // collect the events of the minibatch (waits for the device)
+    void EndMinibatch();
+    size_t GetNumMinibatches() const
+    {
+        return m_numMinibatches;
+    }
+
+    // per category, then per node/phase, sorted by total time (GPU time if measured, else host time)
+    void WriteSummary(FILE* f) const;
+    void WriteChromeTrace(const std::wstring& path) const;
+
+private:
+    ExecutionProfiler(int deviceId);
+    ~ExecutionProfiler();
+    ExecutionProfiler(const ExecutionProfiler&) = delete;
+    void operator=(const ExecutionProfiler&) = delete;
+
+    void* GetCUDAEvent(); // cudaEvent_t, from m_freeCUDAEvents
+
+    struct Event
+    {
+        std::wstring name;
+        const char* category;
+        size_t threadIndex;
+        double hostBegin, hostEnd; // microseconds since Start()
+        void* gpuBegin;            // cudaEvent_t, or nullptr if not timed on the GPU
+        void* gpuEnd;
+        double gpuBeginTime, gpuDuration; // microseconds (gpuBeginTime since Start()), filled in by EndMinibatch()
+    };
+    struct Totals
+    {
+        size_t count;
+        double hostTime, gpuTime; // microseconds
+    };
+
+    double HostTime() const;
+
+    int m_deviceId;
+    double m_hostStart; // (seconds on the steady clock)
+    void* m_gpuStart;   // cudaEvent_t recorded by Start()
+
+    mutable std::mutex m_mutex; // events come from the OpenMP threads of concurrent forward prop
+    std::map<std::thread::id, size_t> m_threadIndices;
+    std::vector<Event> m_pending; // of the current minibatch
+    std::vector<void*> m_freeCUDAEvents;
+
+    size_t m_numMinibatches;
+    std::vector<Event> m_trace; // collected events
+    std::map<std::pair<std::string, std::wstring>, Totals> m_totals;
+};
+} } }
@@ -2,6 +2,8 @@
 #include "Basics.h"
 #include "GPUDataTransferer.h"
 #include "GPUMatrix.h"
+#include <map>
+#include <mutex>
 
 #pragma comment(lib, "cudart.lib")
 
@@ -85,6 +87,7 @@ GPUDataTransferer<ElemType>::GPUDataTransferer(int deviceId, bool useConcurrentS
     // Note: Do NOT use cudaEventBlockingSync (which supposedly yields the process)--it will totally break cudaEventSynchronize(), causing it to take 50 or 100 ms randomly.
     cudaEventCreateWithFlags(&m_fetchCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
     cudaEventCreateWithFlags(&m_assignCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    cudaEventCreateWithFlags(&m_computeReachedEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
 
 #pragma warning(disable : 4127)
     if (useConcurrentStreams && (m_fetchStream == NULL))
@@ -98,6 +101,7 @@ template <class ElemType>
 GPUDataTransferer<ElemType>::~GPUDataTransferer()
 {
     // BUGBUG: we don't destroy our streams (they are static variables); we need a static destructor, I am too lazy now
+    cudaEventDestroy(m_computeReachedEvent);
     cudaEventDestroy(m_assignCompleteEvent);
     cudaEventDestroy(m_fetchCompleteEvent);
 }
@@ -121,10 +125,16 @@ void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUAsync()
 
 template <class ElemType>
 void GPUDataTransferer<ElemType>::CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer)
+{
+    CopyBytesCPUToGPUAsync(cpuBuffer, numElements * sizeof(ElemType), gpuBuffer);
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::CopyBytesCPUToGPUAsync(const void* cpuBuffer, size_t numBytes, void* gpuBuffer)
 {
     PrepareDevice(m_deviceId);
 
-    cudaMemcpyAsync(gpuBuffer, cpuBuffer, numElements * sizeof(ElemType), cudaMemcpyHostToDevice, m_assignStream) || "cudaMemcpyAsync failed";
+    cudaMemcpyAsync(gpuBuffer, cpuBuffer, numBytes, cudaMemcpyHostToDevice, m_assignStream) || "cudaMemcpyAsync failed";
     cudaEventRecord(m_assignCompleteEvent, m_assignStream) || "cudaEventRecord failed";
 }
 
@@ -136,6 +146,45 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
     SyncEvent(m_assignCompleteEvent);
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::CopyCPUToGPUAsyncForCompute(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer)
+{
+    BeginCopyCPUToGPUAsyncForCompute();
+    CopyCPUToGPUAsync(cpuBuffer, numElements, gpuBuffer);
+    EndCopyCPUToGPUAsyncForCompute();
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::BeginCopyCPUToGPUAsyncForCompute()
+{
+    PrepareDevice(m_deviceId);
+
+    // the compute stream may still be reading the previous content of the target buffers
+    cudaEventRecord(m_computeReachedEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(m_assignStream, m_computeReachedEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::EndCopyCPUToGPUAsyncForCompute()
+{
+    PrepareDevice(m_deviceId);
+
+    // m_assignCompleteEvent was recorded after the last copy
+    cudaStreamWaitEvent(GetStream(), m_assignCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+/*static*/ GPUDataTransferer<ElemType>& GPUDataTransferer<ElemType>::GetAsyncSetValueTransferer(int deviceId)
+{
+    static std::mutex transferersMutex;
+    static std::map<int, std::unique_ptr<GPUDataTransferer<ElemType>>> transferers;
+    std::lock_guard<std::mutex> lock(transferersMutex);
+    auto& transferer = transferers[deviceId];
+    if (!transferer)
+        transferer.reset(new GPUDataTransferer<ElemType>(deviceId, true /*useConcurrentStreams*/));
+    return *transferer;
+}
+
 //explicit
 template class GPUDataTransferer<float>;
 template class GPUDataTransferer<double>;
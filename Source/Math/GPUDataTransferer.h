@@ -25,6 +25,20 @@ public:
     void CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer);
     void WaitForCopyCPUToGPUAsync();
 
+    // Upload to a buffer used by the compute stream without blocking the host: the copy starts once the work queued
+    // on the compute stream so far is done, and work queued afterwards waits for it. 'cpuBuffer' must be page-locked
+    // and must not be modified before WaitForCopyCPUToGPUAsync() returns.
+    void CopyCPUToGPUAsyncForCompute(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer);
+
+    // The same for several buffers that are uploaded together, e.g. the values and indices of a sparse matrix:
+    // BeginCopyCPUToGPUAsyncForCompute(), CopyBytesCPUToGPUAsync() for each buffer, then EndCopyCPUToGPUAsyncForCompute().
+    void BeginCopyCPUToGPUAsyncForCompute();
+    void CopyBytesCPUToGPUAsync(const void* cpuBuffer, size_t numBytes, void* gpuBuffer);
+    void EndCopyCPUToGPUAsyncForCompute();
+
+    // the transferer used by the uploads with matrixFlagSetValueAsync, one per device
+    static GPUDataTransferer<ElemType>& GetAsyncSetValueTransferer(int deviceId);
+
 #ifndef CPUONLY
     static cudaStream_t GetFetchStream();
 #endif // !CPUONLY
@@ -41,6 +55,7 @@ private:
 
     mutable cudaEvent_t m_fetchCompleteEvent;
     mutable cudaEvent_t m_assignCompleteEvent;
+    mutable cudaEvent_t m_computeReachedEvent;
 #endif // !CPUONLY
 
     int m_deviceId;
@@ -15,6 +15,8 @@
 #include "GPUSparseMatrix.h"
 #include "GPUTensor.h"
 #include "CommonMatrix.h"
+#include "GPUDataTransferer.h"
+#include "CUDADeviceCachingAllocator.h"
 #define TENSOR_OPS_DECL __device__ __host__
 #include "TensorOps.h"
 #include "device_launch_parameters.h"
@@ -24,7 +26,9 @@
 #include <curand_kernel.h>
 #include "cublas_v2.h"
 #include <assert.h>
+#include <map>
 #include <memory>
+#include <mutex>
 
 #pragma comment(lib, "cudart.lib") // instruct linker to reference these libs
 #pragma comment(lib, "cublas.lib")
@@ -45,9 +49,11 @@ bool do_sync = true;
 
 #define UNCONST(t, c, uc) GPUMatrix<t>& uc = const_cast<GPUMatrix<t>&>(c);
 
-#ifdef _WIN32
 // thread local storage to access the current stream, initalize to default stream
+#ifdef _WIN32
 __declspec(thread)
+#else
+__thread
 #endif
     cudaStream_t t_stream = cudaStreamDefault;
 
@@ -141,11 +147,7 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
-    PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    CUDADeviceCachingAllocator::ForDevice(deviceId).Free((void*) bufferPtr, ignoreCUDARetCode);
 
     if (IsTraceEnabled())
     {
@@ -158,12 +160,7 @@ void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr,
 template <typename AllocatedElemType>
 AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size_t numElements)
 {
-    AllocatedElemType* deviceBufferPtr;
-
-    PrepareDevice(deviceId);
-    CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
-
-    return deviceBufferPtr;
+    return (AllocatedElemType*) CUDADeviceCachingAllocator::ForDevice(deviceId).Malloc(sizeof(AllocatedElemType) * numElements);
 }
 
 std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(int deviceId)
@@ -181,16 +178,23 @@ std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(
     }
 }
 
+// the device last set by PrepareDevice(); per thread, as is CUDA's current device (threads may drive different GPUs)
+#ifdef _WIN32
+__declspec(thread)
+#else
+__thread
+#endif
+    DEVICEID_TYPE t_currentDevice = AUTOPLACEMATRIX; // set to anything valid
+
 // PrepareDevice - Setup the correct cuda context for an operation
 // deviceId - the device on which the operation will take place
 void PrepareDevice(DEVICEID_TYPE deviceId)
 {
-    static DEVICEID_TYPE currentDevice = AUTOPLACEMATRIX; // set to anything valid
     // and if we last set the device to be this device we are good
-    if (deviceId == currentDevice)
+    if (deviceId == t_currentDevice)
         return;
     CUDA_CALL(cudaSetDevice(deviceId));
-    currentDevice = deviceId;
+    t_currentDevice = deviceId;
 }
 
 #pragma region DeviceBoundNumber class
@@ -244,6 +248,50 @@ cublasHandle_t _initCUBLAS(int devId)
     return cuHandle;
 }
 
+// the handle GetCublasHandleForStream() returned last on this thread, and for which device and stream
+#ifdef _WIN32
+static __declspec(thread)
+#else
+static __thread
+#endif
+    cublasHandle_t t_streamCuHandle = NULL;
+#ifdef _WIN32
+static __declspec(thread)
+#else
+static __thread
+#endif
+    cudaStream_t t_streamCuHandleStream = cudaStreamDefault;
+#ifdef _WIN32
+static __declspec(thread)
+#else
+static __thread
+#endif
+    int t_streamCuHandleDevice = -1;
+
+// GetCublasHandleForStream - get the cublas handle for a non-default stream, created on first use and bound to that stream
+// Like the per-device handles, these are never freed; streams are expected to be few and long-lived.
+// A thread mostly issues to one stream, so the handle is looked up in the shared map only when the thread's stream or
+// device changes; the common case takes no lock.
+static cublasHandle_t GetCublasHandleForStream(int computeDevice, cudaStream_t stream)
+{
+    if (t_streamCuHandle != NULL && t_streamCuHandleStream == stream && t_streamCuHandleDevice == computeDevice)
+        return t_streamCuHandle;
+
+    static std::mutex handlesMutex;
+    static std::map<std::pair<int, cudaStream_t>, cublasHandle_t> handles;
+    std::lock_guard<std::mutex> lock(handlesMutex);
+    cublasHandle_t& cuHandle = handles[std::make_pair(computeDevice, stream)];
+    if (cuHandle == NULL)
+    {
+        cuHandle = _initCUBLAS<float>(computeDevice);
+        CUBLAS_CALL(cublasSetStream(cuHandle, stream));
+    }
+    t_streamCuHandle = cuHandle;
+    t_streamCuHandleStream = stream;
+    t_streamCuHandleDevice = computeDevice;
+    return cuHandle;
+}
+
 // GetBestGPUDeviceId - Get the best GPU DeviceId, based on cuda information
 // Returns -1 if no GPUs can be used.
 //  TODO: should be replaced by BestGpu class instead, it's much better
@@ -313,6 +361,12 @@ void GPUMatrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId)
     CUDA_CALL(cudaSetDevice(deviceId));
 }
 
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::WaitForAsyncSetValues(DEVICEID_TYPE deviceId)
+{
+    GPUDataTransferer<ElemType>::GetAsyncSetValueTransferer(deviceId).WaitForCopyCPUToGPUAsync();
+}
+
 template <class ElemType>
 /*static*/ DEVICEID_TYPE GPUMatrix<ElemType>::GetBestGPUDeviceId() // returns -1 if no GPUs can be used
 {
@@ -1026,6 +1080,122 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddFoldedPositiveAndShiftedNegSample(c
     return *this;
 }
 
+// this(:,j) = beta * this(:,j) + alpha * a(:,idx[j]); negative indices add nothing
+// Indices are not range-checked on the GPU; out-of-range ones are skipped.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumElements() != GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoGatherColumnsOf: Output dimensions [%d x %d] do not match the index (%d elements) or the input [%d x %d].",
+                        (int) GetNumRows(), (int) GetNumCols(), (int) idx.GetNumElements(), (int) a.GetNumRows(), (int) a.GetNumCols());
+    if (IsEmpty())
+        return *this;
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _doGatherColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, beta, idx.m_pArray, a.m_pArray, (CUDA_LONG) a.GetNumCols(), alpha, N, (CUDA_LONG) GetNumRows());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
+// this = beta * this; this(:,idx[j]) += alpha * a(:,j); repeated indices are summed (atomically), negative ones skipped
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumElements() != a.GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: Input dimensions [%d x %d] do not match the index (%d elements) or the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) idx.GetNumElements(), (int) GetNumRows(), (int) GetNumCols());
+
+    if (beta == 0)
+        SetValue(0);
+    else if (beta != 1)
+        Scale(beta, *this);
+    if (a.IsEmpty())
+        return *this;
+
+    CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _doScatterColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, (CUDA_LONG) GetNumCols(), idx.m_pArray, a.m_pArray, alpha, N, (CUDA_LONG) GetNumRows());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
+// this = beta * this + a .* mask, see Matrix::DoDropoutOf(); one pass, without a mask or random-number buffer
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoDropoutOf(ElemType beta, const GPUMatrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset)
+{
+    if (a.GetNumRows() != GetNumRows() || a.GetNumCols() != GetNumCols())
+        InvalidArgument("DoDropoutOf: The input dimensions [%d x %d] do not match the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) GetNumRows(), (int) GetNumCols());
+    if (IsEmpty())
+        return *this;
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _doDropoutOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, beta, a.m_pArray, (float) dropoutRate, (ElemType) (1 / (1 - dropoutRate)),
+                                                                                         seed, (unsigned long long) counterOffset, N);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
+// this(k,h) = FeatureHash(ids[k], h) % numBuckets, or -1 for negative ids, see Matrix::AssignHashedIndicesOf()
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignHashedIndicesOf(const GPUMatrix<ElemType>& ids, size_t numBuckets, size_t numHashes)
+{
+    if (numBuckets == 0 || (size_t) (ElemType) (numBuckets - 1) != numBuckets - 1 || (unsigned int) numBuckets != numBuckets)
+        InvalidArgument("AssignHashedIndicesOf: %d buckets cannot be indexed exactly in this precision.", (int) numBuckets);
+
+    Resize(ids.GetNumElements(), numHashes);
+    if (IsEmpty())
+        return *this;
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _assignHashedIndicesOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, ids.m_pArray, (CUDA_LONG) ids.GetNumElements(), (unsigned int) numBuckets, N);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType> GPUMatrix<ElemType>::Transpose() const
 {
@@ -1050,6 +1220,11 @@ cublasHandle_t GPUMatrix<ElemType>::GetCublasHandle(int computeDevice /*=-1*/)
 
     if (computeDevice < 0 || computeDevice >= MaxGpus)
         LogicError("GetCublasHandle: Maximum GPU exceeded");
+    // Work issued on other streams may come from other threads, so those streams get their own handle each, bound to
+    // the stream once, rather than re-binding a shared handle under a concurrent user.
+    if (t_stream != cudaStreamDefault)
+        return GetCublasHandleForStream(computeDevice, t_stream);
+
     cublasHandle_t cuHandle = s_cuHandle[computeDevice];
     if (cuHandle == NULL)
     {
@@ -1264,7 +1439,12 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
         PrepareDevice();
         if (pArray != NULL)
         {
-            if (!(matrixFlags & matrixFormatRowMajor))
+            if (!(matrixFlags & (matrixFormatRowMajor | matrixFlagSetValueOnDevice)) && (matrixFlags & matrixFlagSetValueAsync))
+            {
+                // page-locked host buffer: upload on the transfer stream, ordered with the compute stream, without blocking the host
+                GPUDataTransferer<ElemType>::GetAsyncSetValueTransferer(m_computeDevice).CopyCPUToGPUAsyncForCompute(pArray, GetNumElements(), m_pArray);
+            }
+            else if (!(matrixFlags & matrixFormatRowMajor))
             {
                 CUDA_CALL(cudaMemcpy(m_pArray, pArray, sizeof(ElemType) * GetNumElements(), (matrixFlags & matrixFlagSetValueOnDevice) ? cudaMemcpyDeviceToDevice : cudaMemcpyHostToDevice));
             }
@@ -1569,6 +1749,156 @@ ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
     }
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients,
+                               GPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType beta1,
+                               ElemType beta2,
+                               ElemType epsilon,
+                               ElemType biasCorrection1,
+                               ElemType biasCorrection2,
+                               bool updateValues)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _adam<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(n, gradients.m_pArray, m_pArray, m_pArray + n, functionValues.m_pArray,
+                                                                                 learnRatePerSample, beta1, beta2, epsilon, biasCorrection1, biasCorrection2, updateValues);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params)
+{
+    // one block per chunk of each parameter; the descriptors and each parameter's first block go to the device in one copy
+    const CUDA_LONG chunkSize = 4 * GridDim::maxThreadsPerBlock;
+    const size_t numTensors = tensors.size();
+    const size_t tensorBytes = sizeof(MultiTensorUpdateTensor<ElemType>) * numTensors;
+    std::vector<char> descriptors(tensorBytes + sizeof(CUDA_LONG) * numTensors);
+    memcpy(descriptors.data(), tensors.data(), tensorBytes);
+    CUDA_LONG* firstBlocks = reinterpret_cast<CUDA_LONG*>(descriptors.data() + tensorBytes);
+    CUDA_LONG numBlocks = 0;
+    for (size_t k = 0; k < numTensors; k++)
+    {
+        firstBlocks[k] = numBlocks;
+        numBlocks += (CUDA_LONG) ((tensors[k].size + chunkSize - 1) / chunkSize);
+    }
+    if (numBlocks == 0)
+        return;
+
+    PrepareDevice(deviceId);
+    char* d_descriptors = TracingGPUMemoryAllocator::Allocate<char>(deviceId, descriptors.size());
+    CUDA_CALL(cudaMemcpyAsync(d_descriptors, descriptors.data(), descriptors.size(), cudaMemcpyHostToDevice, t_stream));
+    _multiTensorUpdate<ElemType><<<numBlocks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(reinterpret_cast<const MultiTensorUpdateTensor<ElemType>*>(d_descriptors),
+                                                                                           reinterpret_cast<const CUDA_LONG*>(d_descriptors + tensorBytes),
+                                                                                           (CUDA_LONG) numTensors, chunkSize, params);
+    // the allocator reuses the buffer on this stream only, i.e. after the kernel
+    TracingGPUMemoryAllocator::Free<char>(deviceId, d_descriptors);
+}
+
+// shared memory of _simpleRNNForward(): R and h_{t-1}; 48 KB is available on all devices we support
+template <class ElemType>
+static size_t SimpleRNNForwardSharedMemory(size_t hiddenDim)
+{
+    return (hiddenDim * hiddenDim + hiddenDim) * sizeof(ElemType);
+}
+
+template <class ElemType>
+/*static*/ bool GPUMatrix<ElemType>::IsSimpleRNNForwardSupported(size_t hiddenDim)
+{
+    return hiddenDim > 0 && SimpleRNNForwardSharedMemory<ElemType>(hiddenDim) <= 48 * 1024;
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SimpleRNNForward(const GPUMatrix<ElemType>& R, const GPUMatrix<ElemType>& X, const GPUMatrix<ElemType>& hStart, const GPUMatrix<ElemType>& continues,
+                                                      ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                                      GPUMatrix<ElemType>& delayed, GPUMatrix<ElemType>& product, GPUMatrix<ElemType>& sum, GPUMatrix<ElemType>& hidden)
+{
+    const size_t H = R.GetNumRows();
+    const size_t S = continues.GetNumRows();
+    const size_t T = continues.GetNumCols();
+    if (!IsSimpleRNNForwardSupported(H))
+        InvalidArgument("SimpleRNNForward: Hidden dimension %d too large for shared memory.", (int) H);
+    if (S * T == 0)
+        return;
+
+    // one warp per 32 rows, up to one thread per row
+    const int numThreads = (int) min((size_t) GridDim::maxThreadsPerBlock, (H + 31) / 32 * 32);
+    PrepareDevice(R.GetComputeDeviceId());
+    _simpleRNNForward<ElemType><<<(int) S, numThreads, SimpleRNNForwardSharedMemory<ElemType>(H), t_stream>>>(
+        R.m_pArray, X.m_pArray, hStart.m_pArray, continues.m_pArray, initialValue, (int) nonlinearity, reverse, (CUDA_LONG) H, (CUDA_LONG) S, (CUDA_LONG) T,
+        delayed.m_pArray, product.m_pArray, sum.m_pArray, hidden.m_pArray);
+}
+
+// see Matrix<ElemType>::SoftmaxCrossEntropyForward(); one block per column, then a sum over the columns' criteria
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion)
+{
+    const CUDA_LONG M = (CUDA_LONG) logits.GetNumRows();
+    const CUDA_LONG N = (CUDA_LONG) logits.GetNumCols();
+    if (M == 0 || N == 0)
+    {
+        criterion.SetValue(0);
+        return;
+    }
+    logits.PrepareDevice();
+    GPUMatrix<ElemType> columnCriteria(1, N, logits.GetComputeDeviceId());
+    _softmaxCrossEntropyForward<ElemType><<<N, 512, 0, t_stream>>>(labels.m_pArray, logits.m_pArray, logSumExp.m_pArray, columnCriteria.m_pArray, M);
+    criterion.AssignSumOfElements(columnCriteria);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                                                 GPUMatrix<ElemType>& logitsGradient)
+{
+    const CUDA_LONG n = (CUDA_LONG) logits.GetNumElements();
+    if (n == 0)
+        return;
+    logits.PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    _softmaxCrossEntropyBackward<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(gradient.m_pArray, labels.m_pArray, logits.m_pArray, logSumExp.m_pArray,
+                                                                                                       logitsGradient.m_pArray, (CUDA_LONG) logits.GetNumRows(), n);
+}
+
+// see Matrix<ElemType>::IndexedSoftmaxCrossEntropyForward(); like SoftmaxCrossEntropyForward(), without reading labels column-sized
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion)
+{
+    const CUDA_LONG M = (CUDA_LONG) logits.GetNumRows();
+    const CUDA_LONG N = (CUDA_LONG) logits.GetNumCols();
+    if (M == 0 || N == 0)
+    {
+        criterion.SetValue(0);
+        return;
+    }
+    logits.PrepareDevice();
+    GPUMatrix<ElemType> columnCriteria(1, N, logits.GetComputeDeviceId());
+    _indexedSoftmaxCrossEntropyForward<ElemType><<<N, 512, 0, t_stream>>>(labelIndices.m_pArray, logits.m_pArray, logSumExp.m_pArray, columnCriteria.m_pArray, M);
+    criterion.AssignSumOfElements(columnCriteria);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                                                        GPUMatrix<ElemType>& logitsGradient)
+{
+    const CUDA_LONG n = (CUDA_LONG) logits.GetNumElements();
+    if (n == 0)
+        return;
+    logits.PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    _indexedSoftmaxCrossEntropyBackward<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(gradient.m_pArray, labelIndices.m_pArray, logits.m_pArray, logSumExp.m_pArray,
+                                                                                                              logitsGradient.m_pArray, (CUDA_LONG) logits.GetNumRows(), n);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1628,13 +1958,23 @@ size_t GPUMatrix<ElemType>::LocateColumn(const size_t col) const
     return col * m_numRows; // matrix in column-wise storage
 }
 
+// read a scalar result back to the host, after the work queued before it on this thread's stream
+// Only that stream is waited for. (A plain cudaMemcpy() goes through the legacy default stream, which waits for the
+// whole device, or, if the compute stream is a non-blocking one, for the wrong work.)
 template <class ElemType>
-ElemType GPUMatrix<ElemType>::Get00Element() const
+static ElemType FetchScalar(const ElemType* d_value)
 {
     ElemType res = 0;
-    CUDA_CALL(cudaMemcpy(&res, m_pArray, sizeof(ElemType), cudaMemcpyDeviceToHost));
+    CUDA_CALL(cudaMemcpyAsync(&res, d_value, sizeof(ElemType), cudaMemcpyDeviceToHost, t_stream));
+    CUDA_CALL(cudaStreamSynchronize(t_stream));
     return res;
 }
+
+template <class ElemType>
+ElemType GPUMatrix<ElemType>::Get00Element() const
+{
+    return FetchScalar(m_pArray);
+}
 #pragma endregion Basic Operators
 
 #pragma region Member BLAS Functions
@@ -2563,7 +2903,7 @@ ElemType GPUMatrix<ElemType>::SumOfElements() const
 
     // WARNING: THIS kernel is not the most efficient way!
     _reductionSum<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, d_sum, (CUDA_LONG) GetNumElements());
-    CUDA_CALL(cudaMemcpy(&h_sum, d_sum, sizeof(ElemType), cudaMemcpyDeviceToHost));
+    h_sum = FetchScalar(d_sum);
     TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, d_sum);
     return h_sum;
 }
@@ -2581,7 +2921,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSumOfElements(const GPUMatrix<El
     if (do_sync)
         CUDA_CALL(cudaEventCreate(&done));
     // WARNING: THIS kernel is not the most efficient way!
-    _reductionSumAndAssign<ElemType><<<1, 1024>>>(m_pArray, a.m_pArray, (CUDA_LONG) a.GetNumElements(), (CUDA_LONG) GetNumElements());
+    _reductionSumAndAssign<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, a.m_pArray, (CUDA_LONG) a.GetNumElements(), (CUDA_LONG) GetNumElements());
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
     if (do_sync)
@@ -2892,13 +3232,14 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignKhatriRaoProductOf(const GPUMatr
     CUDA_LONG rowsA = (CUDA_LONG) a.GetNumRows();
     CUDA_LONG rowsB = (CUDA_LONG) b.GetNumRows();
     Resize(rowsA * rowsB, cols);
-    float N = (float) GetNumElements();
-    int blocksPerGrid = (int) ceil(N / GridDim::maxThreadsPerBlock);
+    const CUDA_LONG tiles = CeilDiv(rowsA, KhatriRaoTileA) * CeilDiv(rowsB, KhatriRaoTileB);
+    const dim3 grid(tiles, min(cols, (CUDA_LONG) 65535));
+    const dim3 block(KhatriRaoTileA, KhatriRaoRowsPerPass);
     a.PrepareDevice();
     cudaEvent_t done = nullptr;
     if (do_sync)
         CUDA_CALL(cudaEventCreate(&done));
-    _assignKhatriRaoProductOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, a.m_pArray, b.m_pArray, rowsA, rowsB, cols);
+    _assignKhatriRaoProductOf<ElemType><<<grid, block, 0, t_stream>>>(m_pArray, a.m_pArray, b.m_pArray, rowsA, rowsB, cols);
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
     if (do_sync)
@@ -2909,6 +3250,9 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignKhatriRaoProductOf(const GPUMatr
     return *this;
 }
 
+// a's column height from which AddColumnReshapeProductOf() runs as a batched GEMM rather than one thread per output
+static const CUDA_LONG KhatriRaoMinRowsForGemm = 1024;
+
 //column-wise reshaped product. Used to compute KhatriRaoProduct Gradient
 //   this = reshape each column of a from (K1xK2,1) to (K1, K2)
 //   if each column of a is not transposed, each (K1, K2) times each column of b (K2, frames).
@@ -2934,6 +3278,16 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddColumnReshapeProductOf(const GPUMat
     if (rowsC != GetNumRows() || cols != GetNumCols())
         InvalidArgument("AddColumnReshapeProductOf: This matrix does not have the right size.");
 
+    // Large factors: one matrix-vector product per column, as a batched GEMM. Each column of a is the [rowsC x rowsB]
+    // matrix (transposed: [rowsB x rowsC]) whose leading dimension is the row count of this view of a's buffer.
+    // The kernel below, with one thread per output, loops serially over the rowsB products of each output.
+    if (rowsA >= KhatriRaoMinRowsForGemm)
+    {
+        GPUMatrix<ElemType> aColumns(transposeAColumn ? rowsB : rowsC, (size_t) (transposeAColumn ? rowsC : rowsB) * cols, a.GetComputeDeviceId(), a.m_pArray, matrixFlagDontOwnBuffer);
+        MultiplyAndWeightedAddStridedBatched(1, aColumns, transposeAColumn, rowsA, b, false, rowsB, 1, *this, rowsC, rowsC, 1, rowsB, cols);
+        return *this;
+    }
+
     float N = (float) GetNumElements();
     int blocksPerGrid = (int) ceil(N / GridDim::maxThreadsPerBlock);
     a.PrepareDevice();
@@ -2969,7 +3323,7 @@ ElemType GPUMatrix<ElemType>::FrobeniusNorm() const
     ElemType h_sum = 0;
     // WARNING: THIS kernel is not the most efficient way!
     _reductionSum2<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, d_sum, (CUDA_LONG) GetNumElements(), true);
-    CUDA_CALL(cudaMemcpy(&h_sum, d_sum, sizeof(ElemType), cudaMemcpyDeviceToHost));
+    h_sum = FetchScalar(d_sum);
     TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, d_sum);
 
     return (h_sum);
@@ -3001,7 +3355,7 @@ ElemType GPUMatrix<ElemType>::MatrixNormInf() const
     ElemType h_maxAbs = 0;
     // WARNING: THIS kernel is not the most efficient way!
     _reductionMatrixNormInf<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, d_maxAbs, (CUDA_LONG) GetNumElements());
-    CUDA_CALL(cudaMemcpy(&h_maxAbs, d_maxAbs, sizeof(ElemType), cudaMemcpyDeviceToHost));
+    h_maxAbs = FetchScalar(d_maxAbs);
     TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, d_maxAbs);
     return h_maxAbs;
 }
@@ -3024,7 +3378,7 @@ ElemType GPUMatrix<ElemType>::MatrixNorm0() const
     ElemType h_nz = 0;
     // WARNING: THIS kernel is not the most efficient way!
     _reductionMatrixNorm0<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, d_nz, (CUDA_LONG) GetNumElements());
-    CUDA_CALL(cudaMemcpy(&h_nz, d_nz, sizeof(ElemType), cudaMemcpyDeviceToHost));
+    h_nz = FetchScalar(d_nz);
     TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, d_nz);
     return h_nz;
 }
@@ -3156,6 +3510,19 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
     maxValues.Resize(topK, n);
     maxIndexes.Resize(topK, n);
 
+    // small k (the usual case, e.g. top-5 error, or n-best output of a large vocabulary): select per column
+    if (topK <= topKSelectMaxK)
+    {
+        _vectorTopK<ElemType><<<n, topKSelectThreads, 0, t_stream>>>(us.m_pArray, maxIndexes.m_pArray, maxValues.m_pArray, m, topK);
+        if (do_sync)
+            CUDA_CALL(cudaEventRecord(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventSynchronize(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventDestroy(done));
+        return;
+    }
+
     // To sort matrix columns we use 2-pass _stable_ sort algorithm:
     // 1. Sort by values (descending) with corresponding row/col indexes.
     // 2. Sort by col indices (ascending) with corresponding values/row indices.
@@ -3547,6 +3914,25 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+// float/double overloads of cublasSgemmBatched()/cublasDgemmBatched() and, with CUDA 8, of their strided variants
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float** A, int lda, const float** B, int ldb, const float* beta, float** C, int ldc, int batchCount)
+{
+    return cublasSgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double** A, int lda, const double** B, int ldb, const double* beta, double** C, int ldc, int batchCount)
+{
+    return cublasDgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
+#if CUDA_VERSION >= 8000
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, long long strideA, const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A, int lda, long long strideA, const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#endif
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3586,6 +3972,46 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
     c.m_numCols = n;
 }
 
+// batched c_i = alpha * op(a_i) * op(b_i) + beta * c_i, see Matrix::MultiplyAndWeightedAddStridedBatched()
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiplyAndWeightedAddStridedBatched(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                               const GPUMatrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                               ElemType beta, GPUMatrix<ElemType>& c, size_t strideC,
+                                                               size_t m, size_t n, size_t k, size_t batchCount)
+{
+    if (batchCount == 0 || m == 0 || n == 0)
+        return;
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    cublasHandle_t cuHandle = GetCublasHandle(c.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    int lda = (int) a.m_numRows, ldb = (int) b.m_numRows, ldc = (int) c.m_numRows;
+#if CUDA_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.m_pArray, lda, (long long) strideA, b.m_pArray, ldb, (long long) strideB,
+                                          &beta, c.m_pArray, ldc, (long long) strideC, (int) batchCount));
+#else
+    // the pointer-array interface: the pointers of all a_i, b_i, c_i go to the device in one copy
+    std::vector<ElemType*> pointers(3 * batchCount);
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        pointers[i] = a.m_pArray + i * strideA;
+        pointers[batchCount + i] = b.m_pArray + i * strideB;
+        pointers[2 * batchCount + i] = c.m_pArray + i * strideC;
+    }
+    const size_t numBytes = pointers.size() * sizeof(ElemType*);
+    char* d_pointers = TracingGPUMemoryAllocator::Allocate<char>(c.GetComputeDeviceId(), numBytes);
+    CUDA_CALL(cudaMemcpyAsync(d_pointers, pointers.data(), numBytes, cudaMemcpyHostToDevice, t_stream));
+    ElemType** d_a = reinterpret_cast<ElemType**>(d_pointers);
+    CUBLAS_CALL(cublas_gemmBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, (const ElemType**) d_a, lda, (const ElemType**) (d_a + batchCount), ldb,
+                                   &beta, d_a + 2 * batchCount, ldc, (int) batchCount));
+    // the allocator reuses the buffer on this stream only, i.e. after the GEMMs
+    TracingGPUMemoryAllocator::Free<char>(c.GetComputeDeviceId(), d_pointers);
+#endif
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -4642,6 +5068,69 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignElementProductOfWithShift(const
     return *this;
 }
 
+// cosine distance with negative samples (DSSM) in one kernel, see CPUMatrix::AssignCosDistanceWithShiftNegOf()
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNegOf: Matrix is empty.");
+
+    const int m = (int) a.GetNumRows();
+    const int n = (int) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n || invNormA.GetNumElements() != n || invNormB.GetNumElements() != n)
+        InvalidArgument("AssignCosDistanceWithShiftNegOf: The input matrix dimensions do not match.");
+
+    Resize(nt + 1, n);
+
+    dim3 thread_tail(DEFAULT_THREAD_PER_DIM, DEFAULT_THREAD_PER_DIM);
+    dim3 block_tail((nt + 1 + DEFAULT_THREAD_PER_DIM - 1) / DEFAULT_THREAD_PER_DIM, (n + DEFAULT_THREAD_PER_DIM - 1) / DEFAULT_THREAD_PER_DIM);
+
+    a.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _assignCosDistanceWithShiftNeg<ElemType><<<block_tail, thread_tail, 0, t_stream>>>(m_pArray, a.m_pArray, b.m_pArray, invNormA.m_pArray, invNormB.m_pArray, m, n, shift, nt + 1);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return *this;
+}
+
+// [this] += its gradient w.r.t. a (or b if 'wrtB'), in one kernel
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const bool wrtB, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                                               const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                                               const size_t shift, const size_t nt)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AddCosDistanceWithShiftNegGradientOf: Matrix is empty.");
+
+    const int m = (int) a.GetNumRows();
+    const int n = (int) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n || GetNumRows() != m || GetNumCols() != n ||
+        gradient.GetNumRows() != nt + 1 || gradient.GetNumCols() != n || value.GetNumRows() != nt + 1 || value.GetNumCols() != n)
+        InvalidArgument("AddCosDistanceWithShiftNegGradientOf: The input matrix dimensions do not match.");
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addCosDistanceWithShiftNegGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, wrtB, gradient.m_pArray, value.m_pArray, a.m_pArray, b.m_pArray,
+                                                                                                              invNormA.m_pArray, invNormB.m_pArray, m, n, shift, nt + 1);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return *this;
+}
+
 //sequence training
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::DropFrame(const GPUMatrix<ElemType>& label, const GPUMatrix<ElemType>& gamma, const ElemType& threshhold)
@@ -4717,6 +5206,35 @@ ElemType GPUMatrix<ElemType>::LogAddSumOfElements() const
     return h_sum;
 }
 
+// see CPUMatrix::RCRFForwardCompute(); the recursion over t runs inside a single block, instead of one launch per time step
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardCompute(GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+    if (pos_scores.IsEmpty() || pair_scores.IsEmpty())
+        LogicError("RCRFForwardCompute: one of the input matrices is empty.");
+
+    size_t iNumLab = pos_scores.GetNumRows();
+    size_t iNumPos = pos_scores.GetNumCols();
+    if (pair_scores.GetNumRows() != iNumLab || pair_scores.GetNumCols() != iNumLab)
+        LogicError("RCRFForwardCompute: matrix dimensions mismatched.");
+
+    pos_scores.PrepareDevice();
+    alpha.Resize(iNumLab, iNumPos);
+
+    int threadsPerBlock = (int) min(iNumLab, (size_t) GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _rcrfForwardCompute<ElemType><<<1, threadsPerBlock, 0, t_stream>>>(alpha.m_pArray, pos_scores.m_pArray, pair_scores.m_pArray, iNumPos, iNumLab, startLbl);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::RCRFBackwardCompute(
     const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
@@ -43,11 +43,40 @@ typedef struct CUstream_st* cudaStream_t;
 #endif
 
 // Stream management functions
+// The stream is per thread, so that independent work (e.g. evaluating a branch, uploading a prefetched minibatch,
+// aggregating gradients) can be issued from different threads onto different streams of the same device.
 void MATH_API SetStream(cudaStream_t stream);
 cudaStream_t MATH_API GetStream();
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// GPUStreamScope -- route all GPUMatrix/GPUSparseMatrix operations of the current thread to a stream until the end of the scope
+// Work on different streams is not ordered; use cudaEventRecord()/cudaStreamWaitEvent() where results cross streams.
+// -----------------------------------------------------------------------
+
+class GPUStreamScope
+{
+public:
+    GPUStreamScope(cudaStream_t stream)
+        : m_prevStream(GetStream())
+    {
+        SetStream(stream);
+    }
+    ~GPUStreamScope()
+    {
+        SetStream(m_prevStream);
+    }
+
+private:
+    GPUStreamScope(const GPUStreamScope&) = delete;
+    void operator=(const GPUStreamScope&) = delete;
+    cudaStream_t m_prevStream;
+};
+} } }
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
 // -----------------------------------------------------------------------
 // DeviceBoundNumber -- This class represents a number which resides on a particular device. Use it to avoid unnecessary transfers between CPU and GPU
 // -----------------------------------------------------------------------
@@ -147,6 +176,7 @@ public:
 
     static void SetDevice(DEVICEID_TYPE deviceId);
     static DEVICEID_TYPE GetBestGPUDeviceId();
+    static void WaitForAsyncSetValues(DEVICEID_TYPE deviceId);
     int GetComputeDeviceId() const;
     DEVICEID_TYPE PrepareDevice(DEVICEID_TYPE deviceId = -1) const;
 
@@ -178,6 +208,19 @@ public:
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    void Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+              ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection1, ElemType biasCorrection2, bool updateValues);
+    static void MultiTensorUpdate(DEVICEID_TYPE deviceId, const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params);
+    static void SimpleRNNForward(const GPUMatrix<ElemType>& R, const GPUMatrix<ElemType>& X, const GPUMatrix<ElemType>& hStart, const GPUMatrix<ElemType>& continues,
+                                 ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                 GPUMatrix<ElemType>& delayed, GPUMatrix<ElemType>& product, GPUMatrix<ElemType>& sum, GPUMatrix<ElemType>& hidden);
+    static bool IsSimpleRNNForwardSupported(size_t hiddenDim);
+    static void SoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion);
+    static void SoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                            GPUMatrix<ElemType>& logitsGradient);
+    static void IndexedSoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion);
+    static void IndexedSoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                                   GPUMatrix<ElemType>& logitsGradient);
 
     void Reshape(const size_t numRows, const size_t numCols);
     void Resize(const size_t numRows, const size_t numCols, bool growOnly = true); // by default we only reallocate if need to grow
@@ -353,6 +396,11 @@ public:
     GPUMatrix<ElemType>& AssignPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     GPUMatrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
 
+    GPUMatrix<ElemType>& DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+    GPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+    GPUMatrix<ElemType>& DoDropoutOf(ElemType beta, const GPUMatrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset);
+    GPUMatrix<ElemType>& AssignHashedIndicesOf(const GPUMatrix<ElemType>& ids, size_t numBuckets, size_t numHashes);
+
     void VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<ElemType>& maxValues, const bool isColWise) const;
     void VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<ElemType>& maxValues, const bool isColWise, int topK) const;
     void VectorMin(GPUMatrix<ElemType>& minIndexes, GPUMatrix<ElemType>& minValues, const bool isColWise) const;
@@ -409,6 +457,10 @@ public:
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c);
+    static void MultiplyAndWeightedAddStridedBatched(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                     const GPUMatrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                     ElemType beta, GPUMatrix<ElemType>& c, size_t strideC,
+                                                     size_t m, size_t n, size_t k, size_t batchCount);
 
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c);
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -467,8 +519,14 @@ public:
     static void ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed);
 
     GPUMatrix<ElemType>& AssignElementProductOfWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift);
+    GPUMatrix<ElemType>& AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt);
+    GPUMatrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(const bool wrtB, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                              const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                              const size_t shift, const size_t nt);
 
 public:
+    static void RCRFForwardCompute(GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl);
     static void RCRFBackwardCompute(
         const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
         const GPUMatrix<ElemType>& lbls,
@@ -494,8 +552,11 @@ public:
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+            for (size_t i = 0; i < numRows * numCols; ++i)
+                stream >> d_array[i];
+        else
+            stream.ReadBinaryArray(d_array, sizeof(ElemType), numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
         delete[] d_array;
@@ -515,8 +576,11 @@ public:
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
+        if (stream.IsTextBased())
+            for (size_t i = 0; i < us.GetNumElements(); ++i)
+                stream << pArray[i];
+        else
+            stream.WriteBinaryArray(pArray, sizeof(ElemType), us.GetNumElements());
         delete[] pArray;
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
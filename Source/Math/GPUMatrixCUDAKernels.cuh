@@ -502,6 +502,67 @@ __global__ void _assignRepeatOf(ElemType* dest, ElemType* src, const CUDA_LONG N
     dest[id] = src[IDX2C(srcRow, srcCol, srcRows)];
 }
 
+// us(:,j) = beta * us(:,j) + alpha * a(:,idx[j]), one thread per element of us
+template <class ElemType>
+__global__ void _doGatherColumnsOf(ElemType* us, const ElemType beta, const ElemType* idx, const ElemType* a, const CUDA_LONG aCols, const ElemType alpha, const CUDA_LONG N, const CUDA_LONG numRows)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CUDA_LONG col = id / numRows;
+    CUDA_LONG row = id - (col * numRows);
+    CUDA_LONG aCol = (CUDA_LONG) idx[col];
+
+    ElemType v = (beta == 0) ? 0 : beta * us[id]; // (beta == 0 overwrites, also uninitialized values)
+    if (aCol >= 0 && aCol < aCols)
+        v += alpha * a[IDX2C(row, aCol, numRows)];
+    us[id] = v;
+}
+
+// us(:,idx[j]) += alpha * a(:,j), one thread per element of a
+template <class ElemType>
+__global__ void _doScatterColumnsOf(ElemType* us, const CUDA_LONG usCols, const ElemType* idx, const ElemType* a, const ElemType alpha, const CUDA_LONG N, const CUDA_LONG numRows)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CUDA_LONG col = id / numRows;
+    CUDA_LONG row = id - (col * numRows);
+    CUDA_LONG usCol = (CUDA_LONG) idx[col];
+
+    if (usCol >= 0 && usCol < usCols)
+        atomicAdd(&us[IDX2C(row, usCol, numRows)], alpha * a[id]);
+}
+
+// us = beta * us + a .* mask, the mask drawn per element, see Matrix::DoDropoutOf()
+template <class ElemType>
+__global__ void _doDropoutOf(ElemType* us, const ElemType beta, const ElemType* a, const float dropoutRate, const ElemType scale, const unsigned long long seed, const unsigned long long counterOffset, const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    ElemType v = (beta == 0) ? 0 : beta * us[id]; // (beta == 0 overwrites, also uninitialized values)
+    if (PhiloxUniform(seed, counterOffset + id) >= dropoutRate)
+        v += scale * a[id];
+    us[id] = v;
+}
+
+// us(k,h) = FeatureHash(ids[k], h) % numBuckets, or -1 for negative ids; one thread per element of us
+template <class ElemType>
+__global__ void _assignHashedIndicesOf(ElemType* us, const ElemType* ids, const CUDA_LONG numIds, const unsigned int numBuckets, const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CUDA_LONG h = id / numIds;
+    ElemType v = ids[id - h * numIds];
+    us[id] = (v < 0) ? (ElemType) -1 : (ElemType) (FeatureHash((unsigned long long) v, (unsigned int) h) % numBuckets);
+}
+
 template <class ElemType>
 __global__ void _addToRowRepeatValuesOf(ElemType* dest, ElemType* src, const CUDA_LONG N, const CUDA_LONG srcRows, const CUDA_LONG srcCols, const CUDA_LONG destRows)
 {
@@ -654,6 +715,16 @@ __global__ void _assignElementProductOf(
     us[id] = a[id] * b[id];
 }
 
+// Khatri-Rao product (column-wise Kronecker product) in tiles of KhatriRaoTileA x KhatriRaoTileB elements of a
+// column's product: the block stages the tile's elements of a and b in shared memory, so that each is read from
+// global memory once per tile instead of once per output, and each warp writes a run of KhatriRaoTileA consecutive
+// outputs per element of b. There is no division per element.
+// grid: x = tiles of a column, y = columns (strided by gridDim.y, which is limited to 65535)
+// block: KhatriRaoTileA x KhatriRaoRowsPerPass threads
+static const CUDA_LONG KhatriRaoTileA = 32;
+static const CUDA_LONG KhatriRaoTileB = 32;
+static const CUDA_LONG KhatriRaoRowsPerPass = 8;
+
 template <class ElemType>
 __global__ void _assignKhatriRaoProductOf(
     ElemType* us,
@@ -663,18 +734,38 @@ __global__ void _assignKhatriRaoProductOf(
     const CUDA_LONG rowsB,
     const CUDA_LONG cols)
 {
-    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    __shared__ ElemType aTile[KhatriRaoTileA];
+    __shared__ ElemType bTile[KhatriRaoTileB];
 
-    const CUDA_LONG rows = rowsA * rowsB;
-    const CUDA_LONG col = id / rows;
-    if (col >= cols)
-        return;
+    const CUDA_LONG tilesA = (rowsA + KhatriRaoTileA - 1) / KhatriRaoTileA;
+    const CUDA_LONG rowA0 = (blockIdx.x % tilesA) * KhatriRaoTileA;
+    const CUDA_LONG rowB0 = (blockIdx.x / tilesA) * KhatriRaoTileB;
+    const CUDA_LONG tid = threadIdx.y * KhatriRaoTileA + threadIdx.x;
+    const CUDA_LONG rowA = rowA0 + threadIdx.x;
 
-    const CUDA_LONG row = id % rows;
-    const CUDA_LONG rowB = row / rowsA;
-    const CUDA_LONG rowA = row % rowsA;
+    for (CUDA_LONG col = blockIdx.y; col < cols; col += gridDim.y)
+    {
+        // the first warp loads the elements of a, the second those of b
+        if (tid < KhatriRaoTileA)
+        {
+            if (rowA0 + tid < rowsA)
+                aTile[tid] = a[rowA0 + tid + (size_t) col * rowsA];
+        }
+        else if (tid < KhatriRaoTileA + KhatriRaoTileB)
+        {
+            if (rowB0 + tid - KhatriRaoTileA < rowsB)
+                bTile[tid - KhatriRaoTileA] = b[rowB0 + tid - KhatriRaoTileA + (size_t) col * rowsB];
+        }
+        __syncthreads();
 
-    us[id] = a[rowA + col * rowsA] * b[rowB + col * rowsB];
+        if (rowA < rowsA)
+        {
+            ElemType* usCol = us + (size_t) col * rowsA * rowsB;
+            for (CUDA_LONG j = threadIdx.y; j < KhatriRaoTileB && rowB0 + j < rowsB; j += KhatriRaoRowsPerPass)
+                usCol[rowA + (size_t) (rowB0 + j) * rowsA] = aTile[threadIdx.x] * bTile[j];
+        }
+        __syncthreads(); // (before the next column overwrites the tiles)
+    }
 }
 
 template <class ElemType>
@@ -1442,6 +1533,28 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+template <class ElemType>
+__global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothMom, ElemType* smoothSqr, ElemType* val,
+                      ElemType lr, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection1, ElemType biasCorrection2, bool updateValues)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < size; idx += stride)
+    {
+        ElemType g = grad[idx];
+        ElemType mom = beta1 * smoothMom[idx] + (1.0f - beta1) * g;
+        ElemType sqr = beta2 * smoothSqr[idx] + (1.0f - beta2) * g * g;
+        smoothMom[idx] = mom;
+        smoothSqr[idx] = sqr;
+
+        ElemType u = mom * biasCorrection1 / (sqrt(sqr * biasCorrection2) + epsilon);
+        if (updateValues)
+            val[idx] -= lr * u;
+        else
+            grad[idx] = u;
+    }
+}
+
 template <class ElemType>
 __global__ void _rmsprop_init(
     ElemType* avars, ElemType* signs, ElemType* steps,
@@ -1511,6 +1624,324 @@ __global__ void _rmsprop(
         multipliers[i] = temp;
 }
 
+// fused optimizer step over many parameters, see Matrix<ElemType>::MultiTensorUpdate()
+// Each block updates one chunk of one parameter; firstBlocks[k] is the first block of parameter k.
+// The arithmetic follows _adagrad(), _fsadagrad(), _rmsprop() etc. as launched by the unfused SGD::UpdateWeightsS().
+template <class ElemType>
+__global__ void _multiTensorUpdate(
+    const MultiTensorUpdateTensor<ElemType>* tensors,
+    const CUDA_LONG* firstBlocks,
+    const CUDA_LONG numTensors,
+    const CUDA_LONG chunkSize,
+    const MultiTensorUpdateParams<ElemType> p)
+{
+    // find this block's parameter
+    CUDA_LONG lo = 0, hi = numTensors - 1;
+    while (lo < hi)
+    {
+        CUDA_LONG mid = (lo + hi + 1) / 2;
+        if (firstBlocks[mid] <= (CUDA_LONG) blockIdx.x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    const MultiTensorUpdateTensor<ElemType> t = tensors[lo];
+    const CUDA_LONG n = (CUDA_LONG) t.size;
+    const CUDA_LONG begin = (blockIdx.x - firstBlocks[lo]) * chunkSize;
+    const CUDA_LONG end = min(begin + chunkSize, n);
+    ElemType* sm = t.smoothedGradient;
+
+    for (CUDA_LONG i = begin + threadIdx.x; i < end; i += blockDim.x)
+    {
+        ElemType g = t.gradient[i];
+        ElemType v = t.value[i];
+
+        if (p.clipThreshold > 0)
+            g = max(-p.clipThreshold, min(p.clipThreshold, g));
+        if (p.L2RegWeight > 0)
+            g += p.L2RegWeight * v;
+
+        switch (p.rule)
+        {
+        case MultiTensorUpdateRule::NormalGrad:
+            sm[i] = (1 - p.momentum) * p.learnRatePerSample * g + p.momentum * sm[i];
+            v -= sm[i];
+            break;
+        case MultiTensorUpdateRule::NesterovGrad:
+            sm[i] = (1 - p.momentum) * p.learnRatePerSample * g + p.momentum * sm[i];
+            v -= p.momentum * sm[i];
+            v -= (1 - p.momentum) * p.learnRatePerSample * g;
+            break;
+        case MultiTensorUpdateRule::Adagrad:
+            sm[i] += g * g;
+            g /= sqrt(sm[i] + (ElemType) 1e-16f);
+            v -= p.learnRatePerSample * g;
+            break;
+        case MultiTensorUpdateRule::FSAdagrad:
+        {
+            ElemType adaSqr = p.adaWeight * sm[i] + (1.0f - p.adaWeight) * g * g;
+            sm[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w;
+                if (sizeof(ElemType) == sizeof(double))
+                    w = t.adaMul * rsqrt(adaSqr);
+                else
+                    w = t.adaMul * rsqrtf(adaSqr);
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+            if (p.momentum > 0.0f)
+            {
+                g = p.momentum * sm[n + i] + (1.0f - p.momentum) * g;
+                sm[n + i] = g;
+            }
+            v -= p.learnRatePerSample * g;
+            break;
+        }
+        case MultiTensorUpdateRule::RmsProp:
+        {
+            ElemType* avars = sm;
+            ElemType* signs = sm + n;
+            ElemType* steps = sm + 2 * n;
+            avars[i] = p.rmsGamma * avars[i] + (ElemType(1.0) - p.rmsGamma) * (g * g);
+            const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+            if (signs[i] * grad_sign > 0)
+                steps[i] = min(steps[i] * p.rmsWgtInc, p.rmsWgtMax);
+            else
+                steps[i] = max(steps[i] * p.rmsWgtDec, p.rmsWgtMin);
+            g *= steps[i] / sqrt(avars[i] + (ElemType) 1e-6f);
+            signs[i] = grad_sign;
+            v -= p.learnRatePerSample * g;
+            break;
+        }
+        case MultiTensorUpdateRule::Adam:
+        {
+            ElemType mom = p.adamBeta1 * sm[i] + (1.0f - p.adamBeta1) * g;
+            ElemType sqr = p.adamBeta2 * sm[n + i] + (1.0f - p.adamBeta2) * g * g;
+            sm[i] = mom;
+            sm[n + i] = sqr;
+            v -= p.learnRatePerSample * mom * p.adamBiasCorrection1 / (sqrt(sqr * p.adamBiasCorrection2) + p.adamEpsilon);
+            break;
+        }
+        }
+
+        // L1 regularizer with proximal gradient descent method, as _inplaceSoftThreshold()
+        if (p.L1Threshold > 0)
+        {
+            if (v > p.L1Threshold)
+                v -= p.L1Threshold;
+            else if (v < -p.L1Threshold)
+                v += p.L1Threshold;
+            else
+                v = 0;
+        }
+
+        t.value[i] = v;
+    }
+}
+
+// simple recurrence over all frames, see Matrix<ElemType>::SimpleRNNForward()
+// One block per parallel sequence, which iterates over time itself, so the whole loop is a single launch.
+// R is staged in shared memory once (followed by h_{t-1}); each thread computes rows of R h_{t-1}.
+// A thread reads back h of the previous step written by other threads of the block, which __syncthreads() makes visible.
+template <class ElemType>
+__global__ void _simpleRNNForward(
+    const ElemType* R,
+    const ElemType* X,
+    const ElemType* hStart,
+    const ElemType* continues,
+    const ElemType initialValue,
+    const int nonlinearity,
+    const bool reverse,
+    const CUDA_LONG H,
+    const CUDA_LONG S,
+    const CUDA_LONG T,
+    ElemType* delayed,
+    ElemType* product,
+    ElemType* sum,
+    ElemType* hidden)
+{
+    extern __shared__ char sharedMemory[];
+    ElemType* Rs = (ElemType*) sharedMemory; // [H x H], column-major like R
+    ElemType* hPrev = Rs + H * H;            // [H]
+    const CUDA_LONG s = blockIdx.x;
+
+    for (CUDA_LONG k = threadIdx.x; k < H * H; k += blockDim.x)
+        Rs[k] = R[k];
+
+    for (CUDA_LONG step = 0; step < T; step++)
+    {
+        const CUDA_LONG t = reverse ? T - 1 - step : step;
+        const CUDA_LONG j = t * S + s;                          // column of this frame
+        const CUDA_LONG jPrev = (reverse ? t + 1 : t - 1) * S + s; // (only used if step > 0)
+        const bool continuing = continues[s + t * S] != 0;
+        __syncthreads(); // R staged; h of the previous step written, and hPrev no longer read
+        for (CUDA_LONG i = threadIdx.x; i < H; i += blockDim.x)
+        {
+            ElemType v = !continuing ? initialValue : step == 0 ? hStart[i + s * H] : hidden[i + jPrev * H];
+            hPrev[i] = v;
+            delayed[i + j * H] = v;
+        }
+        __syncthreads();
+        for (CUDA_LONG i = threadIdx.x; i < H; i += blockDim.x)
+        {
+            ElemType z = 0;
+            for (CUDA_LONG k = 0; k < H; k++)
+                z += Rs[i + k * H] * hPrev[k];
+            product[i + j * H] = z;
+            z += X[i + j * H];
+            sum[i + j * H] = z;
+            if (nonlinearity == (int) ElementWiseOperator::opSigmoid)
+                z = Sigmoid(z);
+            else if (nonlinearity == (int) ElementWiseOperator::opTanh)
+                z = tanh_(z);
+            else if (z < 0)
+                z = 0;
+            hidden[i + j * H] = z;
+        }
+    }
+}
+
+// reduces partials[0..511] of a block of 512 threads into partials[0], with max (isMax) or +; all threads must call it
+template <class ElemType>
+__device__ void _reduceBlock512(ElemType* partials, const bool isMax)
+{
+    for (int s = 256; s > 0; s >>= 1)
+    {
+        __syncthreads();
+        if (threadIdx.x < s)
+            partials[threadIdx.x] = isMax ? max(partials[threadIdx.x], partials[threadIdx.x + s]) : partials[threadIdx.x] + partials[threadIdx.x + s];
+    }
+    __syncthreads();
+}
+
+// fused softmax and cross entropy, see GPUMatrix<ElemType>::SoftmaxCrossEntropyForward(). Each block of 512 threads
+// processes one column: max, log-sum-exp, and the column's criterion, without writing anything column-sized.
+template <class ElemType>
+__global__ void _softmaxCrossEntropyForward(
+    const ElemType* labels,
+    const ElemType* logits,
+    ElemType* logSumExp,
+    ElemType* columnCriteria,
+    const CUDA_LONG numRows)
+{
+    __shared__ ElemType partials[512];
+    const ElemType* y = labels + (size_t) blockIdx.x * numRows;
+    const ElemType* z = logits + (size_t) blockIdx.x * numRows;
+
+    ElemType colMax = z[0];
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        colMax = max(colMax, z[i]);
+    partials[threadIdx.x] = colMax;
+    _reduceBlock512(partials, true);
+    colMax = partials[0];
+    __syncthreads(); // (all have read partials[0])
+
+    ElemType colSum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        colSum += exp_(z[i] - colMax);
+    partials[threadIdx.x] = colSum;
+    _reduceBlock512(partials, false);
+    const ElemType lse = colMax + log_(partials[0]);
+    __syncthreads();
+
+    ElemType colCriterion = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        if (y[i] != 0) // (so that all-zero label columns are ignored even if their logits are not finite)
+            colCriterion += y[i] * (lse - z[i]);
+    partials[threadIdx.x] = colCriterion;
+    _reduceBlock512(partials, false);
+    if (threadIdx.x == 0)
+    {
+        logSumExp[blockIdx.x] = lse;
+        columnCriteria[blockIdx.x] = partials[0];
+    }
+}
+
+// logitsGradient += gradient[0] * (softmax(logits) - labels), with the softmax recomputed from the log-sum-exp of the forward pass
+template <class ElemType>
+__global__ void _softmaxCrossEntropyBackward(
+    const ElemType* gradient,
+    const ElemType* labels,
+    const ElemType* logits,
+    const ElemType* logSumExp,
+    ElemType* logitsGradient,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    logitsGradient[id] += gradient[0] * (exp_(logits[id] - logSumExp[id / numRows]) - labels[id]);
+}
+
+// the same as _softmaxCrossEntropyForward(), with the label of the column given as its row index; the blocks of columns
+// without a label (negative index) end right away
+template <class ElemType>
+__global__ void _indexedSoftmaxCrossEntropyForward(
+    const ElemType* labelIndices,
+    const ElemType* logits,
+    ElemType* logSumExp,
+    ElemType* columnCriteria,
+    const CUDA_LONG numRows)
+{
+    __shared__ ElemType partials[512];
+    const ElemType label = labelIndices[blockIdx.x];
+    if (label < 0) // (the same for all threads of the block)
+    {
+        if (threadIdx.x == 0)
+        {
+            logSumExp[blockIdx.x] = 0;
+            columnCriteria[blockIdx.x] = 0;
+        }
+        return;
+    }
+    const ElemType* z = logits + (size_t) blockIdx.x * numRows;
+
+    ElemType colMax = z[0];
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        colMax = max(colMax, z[i]);
+    partials[threadIdx.x] = colMax;
+    _reduceBlock512(partials, true);
+    colMax = partials[0];
+    __syncthreads(); // (all have read partials[0])
+
+    ElemType colSum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        colSum += exp_(z[i] - colMax);
+    partials[threadIdx.x] = colSum;
+    _reduceBlock512(partials, false);
+    if (threadIdx.x == 0)
+    {
+        const ElemType lse = colMax + log_(partials[0]);
+        logSumExp[blockIdx.x] = lse;
+        columnCriteria[blockIdx.x] = lse - z[(CUDA_LONG) label];
+    }
+}
+
+// logitsGradient += gradient[0] * (softmax(logits) - 1 at the label's row), in columns that have a label
+template <class ElemType>
+__global__ void _indexedSoftmaxCrossEntropyBackward(
+    const ElemType* gradient,
+    const ElemType* labelIndices,
+    const ElemType* logits,
+    const ElemType* logSumExp,
+    ElemType* logitsGradient,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG j = id / numRows;
+    const ElemType label = labelIndices[j];
+    if (label < 0)
+        return;
+    logitsGradient[id] += gradient[0] * (exp_(logits[id] - logSumExp[j]) - (id - j * numRows == (CUDA_LONG) label ? 1 : 0));
+}
+
 template <class ElemType>
 __global__ void _rescaleToRange(
     ElemType* a,
@@ -3116,6 +3547,67 @@ __global__ void _denseMulSparseCSCTransposeToSparseBlockCol(
     }
 }
 
+// resultValues(:,blockOfCol[j]) += alpha * a(:,j) for a SparseBlockCol result, one thread per element of a
+// columns with a negative block id are skipped
+template <class ElemType>
+__global__ void _scatterColumnsToSparseBlockCol(
+    const ElemType alpha,
+    const ElemType* a,
+    const size_t numRows,
+    const size_t numCols,
+    const GPUSPARSE_INDEX_TYPE* blockOfCol,
+    ElemType* resultValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG col = index / numRows;
+    if (col >= numCols)
+        return;
+    const CUDA_LONG row = index - numRows * col;
+
+    const CUDA_LONG block = blockOfCol[col];
+    if (block >= 0)
+        atomicAdd(&resultValues[IDX2C(row, block, numRows)], alpha * a[index]);
+}
+
+// backward pass from hidden layer to a transposed feature weight (TransposeTimes)
+//result (sparse BlockRow)= alpha * (lhs (sparse CSC) X rhs^T (dense)
+//each block is one row of the result, stored contiguously
+//assume resultValues are 0-initialized
+template <class ElemType>
+__global__ void _sparseCSCMulDenseTransposeToSparseBlockRow(
+    const ElemType alpha,
+    const ElemType* lhsNZValues,
+    const GPUSPARSE_INDEX_TYPE* lhsRows,
+    const GPUSPARSE_INDEX_TYPE* lhsCols,
+    const GPUSPARSE_INDEX_TYPE* lhsRowIdx,
+    const size_t numColsLhs,
+    const ElemType* rhsValues,
+    const size_t numRowsRhs,
+    ElemType* resultValues,
+    GPUSPARSE_INDEX_TYPE* resultBlockIds)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG lhsCol = index / numRowsRhs; // rhsCol == lhsCol
+    if (lhsCol >= numColsLhs)
+        return;
+    const CUDA_LONG rhsRow = index - numRowsRhs * lhsCol; // resultCol == rhsRow
+
+    // each thread handles one [row, col] combination of rhs
+    ElemType rhsValue = alpha * rhsValues[IDX2C(rhsRow, lhsCol, numRowsRhs)];
+
+    CUDA_LONG start = lhsCols[lhsCol];
+    CUDA_LONG end = lhsCols[lhsCol + 1];
+
+    for (CUDA_LONG p = start; p < end; p++)
+    {
+        CUDA_LONG resultRow = lhsRowIdx[p]; // block id of lhsRows[p]
+        if (rhsRow == 0)
+            resultBlockIds[resultRow] = lhsRows[p]; // indicate which row it actually points to
+
+        atomicAdd(&resultValues[IDX2C(rhsRow, resultRow, numRowsRhs)], lhsNZValues[p] * rhsValue);
+    }
+}
+
 // gradients update
 template <class ElemType>
 __global__ void _scaleSparseBlockAndAddToDense(
@@ -4545,6 +5037,71 @@ __global__ void _assignElementProductOfWithShift(
     us[id] = a[id] * b[tmpidb];
 }
 
+// cosine distance with negative samples, see GPUMatrix::AssignCosDistanceWithShiftNegOf(); one thread per output element
+template <class ElemType>
+__global__ void _assignCosDistanceWithShiftNeg(
+    ElemType* us,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M, // a.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne)
+{
+    CUDA_LONG idx = blockDim.x * blockIdx.x + threadIdx.x;
+    CUDA_LONG idy = blockDim.y * blockIdx.y + threadIdx.y;
+
+    if (idx >= NTPlusOne || idy >= M)
+        return;
+
+    CUDA_LONG col_b = idx == 0 ? idy : (idy + shift + idx - 1) % M;
+    ElemType sum = 0;
+    for (CUDA_LONG i = 0; i < N; ++i)
+        sum += a[IDX2C(i, idy, N)] * b[IDX2C(i, col_b, N)];
+    us[IDX2C(idx, idy, NTPlusOne)] = sum * invNormA[idy] * invNormB[col_b];
+}
+
+// and its gradient w.r.t. a (or b if wrtB), accumulated; one thread per element of the input, consecutive threads go down a column
+template <class ElemType>
+__global__ void _addCosDistanceWithShiftNegGradient(
+    ElemType* us,
+    const bool wrtB,
+    const ElemType* gradient,
+    const ElemType* value,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M, // a.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N * M)
+        return;
+    CUDA_LONG r = id % N;
+    CUDA_LONG j = id / N;
+
+    const ElemType* self = wrtB ? b : a;
+    const ElemType* other = wrtB ? a : b;
+    const ElemType invNormJ = wrtB ? invNormB[j] : invNormA[j];
+    const ElemType* invNormOther = wrtB ? invNormA : invNormB;
+    const ElemType selfElement = self[IDX2C(r, j, N)];
+    ElemType sum = 0;
+    for (CUDA_LONG i = 0; i < NTPlusOne; i++)
+    {
+        CUDA_LONG currshift = i == 0 ? 0 : (shift + i - 1) % M;
+        CUDA_LONG col = wrtB ? (j + M - currshift) % M : j; // the output column
+        CUDA_LONG k = wrtB ? col : (j + currshift) % M;     // and the column of the other input
+        ElemType g = gradient[IDX2C(i, col, NTPlusOne)];
+        sum += g * invNormJ * (invNormOther[k] * other[IDX2C(r, k, N)] - value[IDX2C(i, col, NTPlusOne)] * invNormJ * selfElement);
+    }
+    us[id] += sum;
+}
+
 // minus 1 at a specific position
 template <class ElemType>
 __global__ void _minusOneAt(
@@ -4559,6 +5116,31 @@ __global__ void _minusOneAt(
         c[id] = c[id] - 1.0;
 }
 
+// the kernel function for RCRF forward computation, all time steps in one launch
+// a single block: the threads stride over the labels k, and each time step waits for the previous one at __syncthreads()
+template <class ElemType>
+__global__ void _rcrfForwardCompute(
+    ElemType* alpha,
+    const ElemType* pos_scores,
+    const ElemType* pair_scores,
+    const size_t iNumPos, const size_t iNumLab, const int startLbl)
+{
+    for (int t = 0; t < iNumPos; t++)
+    {
+        for (int k = threadIdx.x; k < iNumLab; k += blockDim.x)
+        {
+            ElemType fTmp = LZERO;
+            for (int j = 0; j < iNumLab; j++)
+            {
+                ElemType fAlpha = (t > 0) ? alpha[IDX2C(j, t - 1, iNumLab)] : ((j == startLbl) ? (ElemType) 0 : (ElemType) LZERO);
+                fTmp = logaddk(fTmp, fAlpha + pair_scores[IDX2C(k, j, iNumLab)]);
+            }
+            alpha[IDX2C(k, t, iNumLab)] = fTmp + pos_scores[IDX2C(k, t, iNumLab)];
+        }
+        __syncthreads();
+    }
+}
+
 // the kernel function for RCRF backward computation
 // assume a column slice of input and output
 template <class ElemType>
@@ -4950,6 +5532,76 @@ __global__ void _copyTopKResults(const uint64_t* indexes, const ElemType* values
     maxValues[id] = values[icol * crow + irow];
 }
 
+// top-k selection per column for small k, without sorting the column: one block per column
+// Each thread keeps the best k of its strided share of the column, sorted, in local memory (a single pass over the
+// column). The block then merges the threads' lists: in each of k rounds, it finds the best of the threads' list heads
+// by a shared-memory reduction, writes it out, and its thread moves on to its next candidate.
+// Order: by value descending; equal values by row index ascending (as the radix-sort path).
+static const int topKSelectMaxK = 32;
+static const int topKSelectThreads = 256;
+
+template <class ElemType>
+__device__ __forceinline__ bool _topKBetter(ElemType v, CUDA_LONG i, ElemType w, CUDA_LONG j, CUDA_LONG numRows)
+{
+    if (j >= numRows) // (w is no candidate)
+        return i < numRows;
+    return i < numRows && (v > w || (v == w && i < j));
+}
+
+template <class ElemType>
+__global__ void _vectorTopK(const ElemType* us, ElemType* maxIndexes, ElemType* maxValues, const CUDA_LONG numRows, const int topK)
+{
+    __shared__ ElemType s_val[topKSelectThreads];
+    __shared__ CUDA_LONG s_idx[topKSelectThreads];
+    __shared__ int s_owner[topKSelectThreads];
+
+    const ElemType* col = us + (size_t) blockIdx.x * numRows;
+    ElemType vals[topKSelectMaxK];
+    CUDA_LONG idxs[topKSelectMaxK];
+    int count = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += blockDim.x)
+    {
+        ElemType v = col[i];
+        if (count == topK && !(v > vals[topK - 1])) // (i is larger than all kept indices, so equal values lose)
+            continue;
+        int pos = count < topK ? count++ : topK - 1;
+        for (; pos > 0 && v > vals[pos - 1]; pos--)
+        {
+            vals[pos] = vals[pos - 1];
+            idxs[pos] = idxs[pos - 1];
+        }
+        vals[pos] = v;
+        idxs[pos] = i;
+    }
+
+    int head = 0;
+    for (int r = 0; r < topK; r++)
+    {
+        s_val[threadIdx.x] = head < count ? vals[head] : 0;
+        s_idx[threadIdx.x] = head < count ? idxs[head] : numRows;
+        s_owner[threadIdx.x] = threadIdx.x;
+        __syncthreads();
+        for (int s = blockDim.x / 2; s > 0; s >>= 1)
+        {
+            if (threadIdx.x < s && _topKBetter(s_val[threadIdx.x + s], s_idx[threadIdx.x + s], s_val[threadIdx.x], s_idx[threadIdx.x], numRows))
+            {
+                s_val[threadIdx.x] = s_val[threadIdx.x + s];
+                s_idx[threadIdx.x] = s_idx[threadIdx.x + s];
+                s_owner[threadIdx.x] = s_owner[threadIdx.x + s];
+            }
+            __syncthreads();
+        }
+        if (threadIdx.x == 0)
+        {
+            maxValues[(size_t) blockIdx.x * topK + r] = s_val[0];
+            maxIndexes[(size_t) blockIdx.x * topK + r] = (ElemType) s_idx[0];
+        }
+        if (threadIdx.x == s_owner[0])
+            head++;
+        __syncthreads(); // (before s_* are overwritten)
+    }
+}
+
 template <int BlockSize, class ElemType>
 __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemType* c, CUDA_LONG crowB, CUDA_LONG ccol)
 {
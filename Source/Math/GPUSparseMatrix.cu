@@ -11,11 +11,14 @@
 
 #include "GPUSparseMatrix.h"
 #include "GPUMatrix.h"
+#include "GPUDataTransferer.h"
 #include <cuda_runtime.h>
 #include <cusparse_v2.h>
 #include "cublas_v2.h"
 #include "GPUMatrixCUDAKernels.cuh"
 #include <functional>
+#include <algorithm>
+#include <vector>
 #include "CommonMatrix.h"
 #include <iostream> // for cout/cerr
 #include <assert.h>
@@ -25,11 +28,11 @@ typedef unsigned char byte;
 #pragma warning(disable : 4267) // conversion from 'size_t' to 'unsigned int'; happens in CUDA <<<a,b>>> syntax if a and b are size_t
 #pragma warning(disable : 4127) // conditional expression is constant; "if (sizeof(ElemType)==sizeof(float))" triggers this
 
-#ifdef _WIN32
 // thread local storage to access the current stream, initalize to default stream
+#ifdef _WIN32
 extern __declspec(thread)
 #else
-static
+extern __thread
 #endif
     cudaStream_t t_stream;
 
@@ -936,6 +939,57 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     }
 }
 
+// upload on the transfer stream, ordered after the work queued on the compute stream so far and before the work queued after it;
+// 'h_row' goes to RowLocation() and 'h_col' to ColLocation(), i.e. which of them are the compressed indices depends on 'format'
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromHostBuffersAsync(const MatrixFormat format, const CPUSPARSE_INDEX_TYPE* h_row, const CPUSPARSE_INDEX_TYPE* h_col, const ElemType* h_Val,
+                                                              const size_t nz, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+
+    if (h_row == nullptr || h_col == nullptr || h_Val == nullptr)
+        LogicError("SetMatrixFromHostBuffersAsync: nullptr passed in.");
+
+    PrepareDevice();
+
+    // The number of non-zeros varies from minibatch to minibatch, and reallocating synchronizes the device.
+    // So when the buffer has to grow, leave room for somewhat larger minibatches to come.
+    size_t numNZElemToReserve = nz;
+    if (BufferSizeNeeded(numRows, numCols, nz, format) > m_totalBufferSizeAllocated)
+        numNZElemToReserve += nz / 2;
+    Resize(numRows, numCols, numNZElemToReserve, format, true /*growOnly*/, false /*keepExistingValues*/);
+    SetNzCount(nz);
+
+    auto& transferer = GPUDataTransferer<ElemType>::GetAsyncSetValueTransferer(m_computeDevice);
+    transferer.BeginCopyCPUToGPUAsyncForCompute();
+    transferer.CopyBytesCPUToGPUAsync(h_Val, NzSize(), BufferPointer());
+    transferer.CopyBytesCPUToGPUAsync(h_row, RowSize(), RowLocation());
+    transferer.CopyBytesCPUToGPUAsync(h_col, ColSize(), ColLocation());
+    transferer.EndCopyCPUToGPUAsyncForCompute();
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSRFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                                            const size_t nz, const size_t numRows, const size_t numCols)
+{
+    // the indices would have to be converted through a temp buffer that is not page-locked
+    if (sizeof(CPUSPARSE_INDEX_TYPE) != sizeof(GPUSPARSE_INDEX_TYPE))
+        return SetMatrixFromCSRFormat(h_CSRRow, h_Col, h_Val, nz, numRows, numCols);
+
+    SetMatrixFromHostBuffersAsync(matrixFormatSparseCSR, h_CSRRow, h_Col, h_Val, nz, numRows, numCols);
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                            const size_t nz, const size_t numRows, const size_t numCols)
+{
+    if (sizeof(CPUSPARSE_INDEX_TYPE) != sizeof(GPUSPARSE_INDEX_TYPE))
+        return SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols);
+
+    SetMatrixFromHostBuffersAsync(matrixFormatSparseCSC, h_Row, h_CSCCol, h_Val, nz, numRows, numCols);
+}
+
 // this function will allocate memory while the caller needs to release it
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_CSCCol, GPUSPARSE_INDEX_TYPE*& h_Row, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const
@@ -1325,6 +1379,167 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
     }
 }
 
+// backward pass from hidden layer to a transposed feature weight (TransposeTimes)
+// sparse X dense^T = sparse, with one block per row of lhs that has values
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                               const GPUMatrix<ElemType>& rhs, const bool transposeB, GPUSparseMatrix<ElemType>& c)
+{
+    if (!c.OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (lhs.GetComputeDeviceId() != rhs.GetComputeDeviceId())
+        RuntimeError("GPUSparseMatrix::MultiplyAndAdd: All matrices must be on the same GPU");
+
+    int m = transposeA ? (int) lhs.GetNumCols() : (int) lhs.GetNumRows();
+    int k = transposeA ? (int) lhs.GetNumRows() : (int) lhs.GetNumCols();
+    int l = transposeB ? (int) rhs.GetNumCols() : (int) rhs.GetNumRows();
+    int n = transposeB ? (int) rhs.GetNumRows() : (int) rhs.GetNumCols();
+
+    if (k != l)
+        InvalidArgument("GPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a and b must match.");
+
+    if (transposeA || !transposeB || lhs.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    c.SetFormat(matrixFormatSparseBlockRow);
+
+    rhs.PrepareDevice();
+
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+
+    c.m_blockSize = lhs.IdentifyRowsWithValues();
+    size_t nnz = n * c.m_blockSize;
+    c.Resize(m, n, nnz, true, false);
+    c.m_nz = nnz;
+    CUDA_CALL(cudaMemset(c.BufferPointer(), 0, sizeof(ElemType) * (c.m_elemSizeAllocated)));
+    CUDA_CALL(cudaMemset(c.BlockId2ColOrRow(), 0, sizeof(GPUSPARSE_INDEX_TYPE) * (c.m_blockSize)));
+
+    LONG64 N = (LONG64) rhs.GetNumElements(); // here we process for each row in rhs and each column in lhs (==columns in rhs)
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _sparseCSCMulDenseTransposeToSparseBlockRow<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        alpha,
+        lhs.BufferPointer(),
+        lhs.RowLocation(),
+        lhs.ColLocation(),
+        lhs.m_rowToId,
+        k,
+        rhs.BufferPointer(),
+        n,
+        c.BufferPointer(),
+        c.BlockId2ColOrRow());
+
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+// this = beta * this; this(:,idx[j]) += alpha * a(:,j), keeping this in SparseBlockCol format with one block per column
+// with values (beta must be 0 or 1). New blocks are merged with the existing ones, e.g. when an embedding is shared.
+// The block ids are determined on the host: the index has only one element per sample and lookup.
+template <class ElemType>
+GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (idx.GetNumElements() != a.GetNumCols() || a.GetNumRows() != GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: Input dimensions [%d x %d] do not match the index (%d elements) or the output [%d x %d].",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) idx.GetNumElements(), (int) GetNumRows(), (int) GetNumCols());
+
+    if (beta == 0)
+        Reset();
+    else if (beta != 1)
+        NOT_IMPLEMENTED;
+
+    if (m_format != matrixFormatSparseBlockCol)
+    {
+        if (m_nz != 0)
+            NOT_IMPLEMENTED;
+        SetFormat(matrixFormatSparseBlockCol);
+    }
+
+    PrepareDevice();
+    size_t m = GetNumRows();
+    size_t numColsA = a.GetNumCols();
+
+    std::vector<ElemType> h_idx(numColsA);
+    if (numColsA > 0)
+        CUDA_CALL(cudaMemcpy(h_idx.data(), idx.BufferPointer(), sizeof(ElemType) * numColsA, cudaMemcpyDeviceToHost));
+    std::vector<GPUSPARSE_INDEX_TYPE> oldIds(m_blockSize);
+    if (m_blockSize > 0)
+        CUDA_CALL(cudaMemcpy(oldIds.data(), BlockId2ColOrRow(), sizeof(GPUSPARSE_INDEX_TYPE) * m_blockSize, cudaMemcpyDeviceToHost));
+
+    // the block ids of the result: the existing ones plus the new indices, in increasing order
+    std::vector<GPUSPARSE_INDEX_TYPE> ids = oldIds;
+    for (size_t j = 0; j < numColsA; j++)
+    {
+        if (h_idx[j] < 0)
+            continue;
+        if (h_idx[j] >= (ElemType) GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Index %d is out of range [0, %d).", (int) h_idx[j], (int) GetNumCols());
+        ids.push_back((GPUSPARSE_INDEX_TYPE) h_idx[j]);
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    // target block of each column of a, followed by that of each existing block
+    std::vector<GPUSPARSE_INDEX_TYPE> blockOf(numColsA + oldIds.size());
+    for (size_t j = 0; j < numColsA; j++)
+        blockOf[j] = (h_idx[j] < 0) ? -1 : (GPUSPARSE_INDEX_TYPE)(lower_bound(ids.begin(), ids.end(), (GPUSPARSE_INDEX_TYPE) h_idx[j]) - ids.begin());
+    for (size_t b = 0; b < oldIds.size(); b++)
+        blockOf[numColsA + b] = (GPUSPARSE_INDEX_TYPE)(lower_bound(ids.begin(), ids.end(), oldIds[b]) - ids.begin());
+
+    GPUMatrix<ElemType> oldValues(GetComputeDeviceId());
+    if (m_nz > 0)
+    {
+        oldValues.Resize(m, m_blockSize);
+        CUDA_CALL(cudaMemcpy(oldValues.BufferPointer(), BufferPointer(), sizeof(ElemType) * m_nz, cudaMemcpyDeviceToDevice));
+    }
+
+    Resize(m, GetNumCols(), max(ids.size(), (size_t) 1) * m, true, false);
+    m_blockSize = ids.size();
+    m_nz = m_blockSize * m;
+    CUDA_CALL(cudaMemset(BufferPointer(), 0, sizeof(ElemType) * m_nz));
+    if (m_blockSize > 0)
+        CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), ids.data(), sizeof(GPUSPARSE_INDEX_TYPE) * m_blockSize, cudaMemcpyHostToDevice));
+
+    GPUSPARSE_INDEX_TYPE* d_blockOf = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(GetComputeDeviceId(), max(blockOf.size(), (size_t) 1));
+    if (!blockOf.empty())
+        CUDA_CALL(cudaMemcpy(d_blockOf, blockOf.data(), sizeof(GPUSPARSE_INDEX_TYPE) * blockOf.size(), cudaMemcpyHostToDevice));
+
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    if (!oldIds.empty())
+    {
+        int blocksPerGrid = (int) ceil(((double) oldValues.GetNumElements()) / GridDim::maxThreadsPerBlock);
+        _scatterColumnsToSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+            1, oldValues.BufferPointer(), m, oldIds.size(), d_blockOf + numColsA, BufferPointer());
+    }
+    if (numColsA > 0)
+    {
+        int blocksPerGrid = (int) ceil(((double) a.GetNumElements()) / GridDim::maxThreadsPerBlock);
+        _scatterColumnsToSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+            alpha, a.BufferPointer(), m, numColsA, d_blockOf, BufferPointer());
+    }
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(GetComputeDeviceId(), d_blockOf);
+
+    return *this;
+}
+
 //find the rows of rhs with values
 template <class ElemType>
 size_t GPUSparseMatrix<ElemType>::IdentifyRowsWithValues() const
@@ -1547,6 +1762,8 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 //-------------------------------------------------------------------------
 
 //sparse X dense = dense
+// transposeD is passed to csrmm2 as the operation on b, so that no transposed copy of b is made; cuSPARSE supports it
+// only if a is not transposed
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
                                                        const GPUMatrix<ElemType>& b, const bool transposeD, ElemType beta, GPUMatrix<ElemType>& c)
@@ -1554,7 +1771,7 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     if (a.m_format != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
 
-    if (transposeD)
+    if (transposeA && transposeD)
         NOT_IMPLEMENTED;
 
     if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != a.GetComputeDeviceId()))
@@ -1568,9 +1785,10 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
     cusparseSetMatIndexBase(descr, CUSPARSE_INDEX_BASE_ZERO);
     cusparseOperation_t oper = transposeA ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
+    cusparseOperation_t operB = transposeD ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
 
     int m = (int) a.GetNumRows();
-    int n = (int) b.GetNumCols();
+    int n = (int) (transposeD ? b.GetNumRows() : b.GetNumCols());
     assert(n == (int) c.GetNumCols());
     int k = (int) a.GetNumCols();
 
@@ -1579,13 +1797,13 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
         CUDA_CALL(cudaEventCreate(&done));
     if (sizeof(ElemType) == sizeof(float))
     {
-        CUSPARSE_CALL(cusparseScsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<float*>(&alpha), descr, reinterpret_cast<const float*>(a.BufferPointer()),
+        CUSPARSE_CALL(cusparseScsrmm2(cusparseHandle, oper, operB, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<float*>(&alpha), descr, reinterpret_cast<const float*>(a.BufferPointer()),
                                      a.RowLocation(), a.ColLocation(), reinterpret_cast<float*>(b.BufferPointer()),
                                      (int) b.GetNumRows(), reinterpret_cast<float*>(&beta), reinterpret_cast<float*>(c.BufferPointer()), (int) c.GetNumRows()));
     }
     else
     {
-        CUSPARSE_CALL(cusparseDcsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<double*>(&alpha), descr, reinterpret_cast<const double*>(a.BufferPointer()),
+        CUSPARSE_CALL(cusparseDcsrmm2(cusparseHandle, oper, operB, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<double*>(&alpha), descr, reinterpret_cast<const double*>(a.BufferPointer()),
                                      a.RowLocation(), a.ColLocation(), reinterpret_cast<double*>(b.BufferPointer()),
                                      (int) b.GetNumRows(), reinterpret_cast<double*>(&beta), reinterpret_cast<double*>(c.BufferPointer()), (int) c.GetNumRows()));
     }
@@ -265,6 +265,13 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
 
+    // Same from page-locked host buffers without blocking the host (cf. SetValue() with matrixFlagSetValueAsync). The buffers
+    // must not be modified before Matrix::WaitForAsyncSetValues() for this device returns.
+    void SetMatrixFromCSRFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                     const size_t nz, const size_t numRows, const size_t numCols);
+    void SetMatrixFromCSCFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                     const size_t nz, const size_t numRows, const size_t numCols);
+
     // Gets sparse matrix in CSR format. this acts as deep copy. All passed pointers must be NULL. the function will allocate memory itself.
     void GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
@@ -328,7 +335,10 @@ public:
                                        const bool transposeD, ElemType beta, GPUMatrix<ElemType>& C);
     static void MultiplyAndAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA, const GPUSparseMatrix<ElemType>& rhs,
                                const bool transposeB, GPUSparseMatrix<ElemType>& c);
+    static void MultiplyAndAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& lhs, const bool transposeA, const GPUMatrix<ElemType>& rhs,
+                               const bool transposeB, GPUSparseMatrix<ElemType>& c);
     static void ScaleAndAdd(const ElemType alpha, const GPUSparseMatrix<ElemType>& lhs, GPUMatrix<ElemType>& c);
+    GPUSparseMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
     static void ConvolveAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA, const GPUSparseMatrix<ElemType>& rhs,
                                        const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
     static void TensorShuffleScaleAndAdd(ElemType keepWeight, const GPUSparseMatrix<ElemType>& a, size_t D, size_t S, size_t M, size_t K, size_t T, ElemType scaleFactor, const GPUSparseMatrix<ElemType>& b, GPUSparseMatrix<ElemType>& c);
@@ -365,6 +375,8 @@ public:
 
 private:
     void* ReserveTempHostBuffer(const size_t sizeInByte) const;
+    void SetMatrixFromHostBuffersAsync(const MatrixFormat format, const CPUSPARSE_INDEX_TYPE* h_row, const CPUSPARSE_INDEX_TYPE* h_col, const ElemType* h_Val,
+                                       const size_t nz, const size_t numRows, const size_t numCols);
     template <class OutType, class InType>
     static void CopyBuffer(OutType* outBuffer, const InType* inBuffer, const size_t size);
 
@@ -15,6 +15,7 @@
 #include "CommonMatrix.h"
 #define TENSOR_OPS_DECL __device__ __host__
 #include "TensorOps.h"
+#include "CUDADeviceCachingAllocator.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
 #include "cublas_v2.h"
@@ -33,11 +34,13 @@
 
 extern bool do_sync;
 
-#ifdef _WIN32
 // thread local storage to access the current stream, initalize to default stream
-__declspec(thread)
+#ifdef _WIN32
+extern __declspec(thread)
+#else
+extern __thread
 #endif
-    extern cudaStream_t t_stream;
+    cudaStream_t t_stream;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -621,6 +624,283 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
         CUDA_CALL(cudaEventDestroy(done));
 }
 
+// -----------------------------------------------------------------------
+// kernel and launch  --reduction of contiguous columns
+// -----------------------------------------------------------------------
+
+// Reducing [rows x cols] inputs with contiguous columns into one column (e.g. the gradient of a bias) would, with too
+// few rows to give each thread its own, run into the block-per-element reduction above, where neighboring threads
+// read elements that are 'rows' apart, and chunks are combined with atomicAdd(). Instead, this is done in two stages:
+// Stage 1 has the threads of a warp on neighboring rows, so that reads are coalesced, and the warps of a block plus
+// a grid-stride loop on different columns, and leaves one partial sum per row and block row of the grid. Stage 2 adds
+// those up per row. The partial sums are added in a fixed order, so the result is deterministic.
+
+static const C_int columnReductionTileRows = 32; // threads in X, one warp
+static const C_int columnReductionTileCols = 16; // threads in Y
+
+template <class ElemType, C_size_t N>
+__global__ void _launchColumnReductionStage1(FixedArray<ElemType*, N> pointers, ElementWiseOperator op, FixedArray<C_int, N> colStrides,
+                                             CUDA_LONG numRows, CUDA_LONG numCols, ReduceElemType* partials)
+{
+    __shared__ ReduceElemType tile[columnReductionTileCols][columnReductionTileRows];
+    CUDA_LONG row = blockIdx.x * columnReductionTileRows + threadIdx.x;
+    ReduceElemType sum = 0;
+    if (row < numRows)
+    {
+        for (CUDA_LONG col = blockIdx.y * columnReductionTileCols + threadIdx.y; col < numCols; col += gridDim.y * columnReductionTileCols)
+        {
+            FixedArray<ElemType*, N> p = pointers;
+            for (C_size_t i = 0; i < N - 1; i++)
+                p[i] += row + col * colStrides[i];
+            sum += TensorOps<ElemType>::Compute(p, op);
+        }
+    }
+    tile[threadIdx.y][threadIdx.x] = sum;
+    __syncthreads();
+    if (threadIdx.y == 0 && row < numRows)
+    {
+        for (C_int y = 1; y < columnReductionTileCols; y++)
+            sum += tile[y][threadIdx.x];
+        partials[row + blockIdx.y * numRows] = sum;
+    }
+}
+
+template <class ElemType>
+__global__ void _launchColumnReductionStage2(ElemType beta, ElemType* pout, ElemType alpha, const ReduceElemType* partials, CUDA_LONG numRows, CUDA_LONG numPartials)
+{
+    CUDA_LONG row = GridDim::GetLinearThreadId();
+    if (row >= numRows)
+        return;
+    ReduceElemType sum = 0;
+    for (CUDA_LONG k = 0; k < numPartials; k++)
+        sum += partials[row + k * numRows];
+    ElemType val = (ElemType) sum * alpha;
+    if (beta != 0)
+        val += beta * pout[row];
+    pout[row] = val;
+}
+
+// returns false if the operation is not a reduction of contiguous columns, or if there are enough rows for the regular launch
+template <class ElemType, C_size_t N>
+static bool TryLaunchColumnReduction(ElemType beta, const array<ElemType*, N>& pointerVector, ElemType alpha, ElementWiseOperator op,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    if (regularOpDims.size() != 1 || reducingOpDims.size() != 1 || reducingOpDims[0] <= 1)
+        return false;
+    for (C_size_t i = 0; i < N; i++)
+        if (regularStrides[i][0] != 1)
+            return false;
+    let numRows = (CUDA_LONG) regularOpDims[0];
+    let numCols = (CUDA_LONG) reducingOpDims[0];
+    let& props = GridDim::GetDeviceProps();
+    if (GridDim(numRows).m_blocksPerGrid >= props.multiProcessorCount) // enough rows to keep the GPU busy with one thread per row
+        return false;
+
+    array<C_int, N> colStrideVector;
+    for (C_size_t i = 0; i < N; i++)
+        colStrideVector[i] = (C_int) reducingStrides[i][0];
+    FixedArray<C_int, N> colStrides(colStrideVector);
+    FixedArray<ElemType*, N> pointers(pointerVector);
+
+    // enough blocks to fill the GPU a few times over, but no more than there are tiles of columns
+    let numBlocksX = CeilDiv(numRows, columnReductionTileRows);
+    let numBlocksY = max((CUDA_LONG) 1, min(CeilDiv(4 * props.multiProcessorCount, numBlocksX), CeilDiv(numCols, columnReductionTileCols)));
+
+    int deviceId;
+    CUDA_CALL(cudaGetDevice(&deviceId));
+    auto& allocator = CUDADeviceCachingAllocator::ForDevice(deviceId);
+    let partials = (ReduceElemType*) allocator.Malloc(sizeof(ReduceElemType) * numRows * numBlocksY);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _launchColumnReductionStage1<ElemType, N><<<dim3(numBlocksX, numBlocksY), dim3(columnReductionTileRows, columnReductionTileCols), 0, t_stream>>>(pointers, op, colStrides, numRows, numCols, partials);
+    GridDim grid(numRows);
+    _launchColumnReductionStage2<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointerVector[N - 1], alpha, partials, numRows, numBlocksY);
+    allocator.Free(partials); // (cached per stream, so not reused before the kernels above are done)
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// kernel and launch  --linear, all operands contiguous and of the same shape
+// -----------------------------------------------------------------------
+
+// With a single dimension that has stride 1 for all operands and no reduction (e.g. the sum of two matrices of the same
+// dimensions), there is no index to compute. Then, if all pointers are aligned for it, each thread loads and stores
+// 16 bytes per operand at a time (float4 or double2), in a grid-stride loop; elements beyond the last whole vector are
+// done one by one. (Linear unary ops are expanded per op instead, see LaunchUnaryTensorOp().)
+
+template <class ElemType>
+struct TensorOpVector;
+template <>
+struct TensorOpVector<float>
+{
+    typedef float4 type;
+    static const C_int size = 4;
+};
+template <>
+struct TensorOpVector<double>
+{
+    typedef double2 type;
+    static const C_int size = 2;
+};
+
+template <class ElemType, C_size_t N>
+__global__ void _launchLinearTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+                                      CUDA_LONG numVectors, CUDA_LONG numElements)
+{
+    typedef typename TensorOpVector<ElemType>::type VectorType;
+    const C_int V = TensorOpVector<ElemType>::size;
+    const CUDA_LONG numThreads = gridDim.x * blockDim.x;
+    for (CUDA_LONG id = GridDim::GetLinearThreadId(); id < numVectors; id += numThreads)
+    {
+        VectorType in[N]; // (the last one is the output)
+        for (C_size_t i = 0; i < N - 1; i++)
+            in[i] = ((const VectorType*) pointers[i])[id];
+        if (beta != 0)
+            in[N - 1] = ((const VectorType*) pointers[N - 1])[id];
+        for (C_int j = 0; j < V; j++)
+        {
+            FixedArray<ElemType*, N> p = pointers;
+            for (C_size_t i = 0; i < N; i++)
+                p[i] = (ElemType*) &in[i] + j;
+            ElemType val = TensorOps<ElemType>::Compute(p, op) * alpha;
+            if (beta != 0)
+                val += beta * *p[N - 1];
+            *p[N - 1] = val;
+        }
+        ((VectorType*) pointers[N - 1])[id] = in[N - 1];
+    }
+    for (CUDA_LONG id = numVectors * V + GridDim::GetLinearThreadId(); id < numElements; id += numThreads)
+    {
+        FixedArray<ElemType*, N> p = pointers;
+        for (C_size_t i = 0; i < N; i++)
+            p[i] += id;
+        ElemType val = TensorOps<ElemType>::Compute(p, op) * alpha;
+        if (beta != 0)
+            val += beta * *p[N - 1];
+        *p[N - 1] = val;
+    }
+}
+
+// returns false if the operation is not linear
+template <class ElemType, C_size_t N>
+static bool TryLaunchLinearTensorOp(ElemType beta, const array<ElemType*, N>& pointerVector, ElemType alpha, ElementWiseOperator op,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                    const SmallVector<size_t>& reducingOpDims)
+{
+    if (regularOpDims.size() != 1 || reducingOpDims.size() != 0)
+        return false;
+    bool aligned = true;
+    for (C_size_t i = 0; i < N; i++)
+    {
+        if (regularStrides[i][0] != 1)
+            return false;
+        if ((size_t) pointerVector[i] % sizeof(typename TensorOpVector<ElemType>::type) != 0)
+            aligned = false;
+    }
+    let numElements = (CUDA_LONG) regularOpDims[0];
+    let numVectors = aligned ? numElements / TensorOpVector<ElemType>::size : 0;
+    let numRemaining = numElements - numVectors * TensorOpVector<ElemType>::size;
+
+    // one vector per thread, but no more threads than the GPU can hold at once; these loop over the rest
+    let& props = GridDim::GetDeviceProps();
+    GridDim grid(max(numVectors, numRemaining));
+    let maxBlocks = props.multiProcessorCount * max(1, props.maxThreadsPerMultiProcessor / grid.m_threadsPerBlock);
+    let numBlocks = min(grid.m_blocksPerGrid, maxBlocks);
+
+    FixedArray<ElemType*, N> pointers(pointerVector);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _launchLinearTensorOp<ElemType, N><<<numBlocks, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, numVectors, numElements);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// kernel and launch  --two dimensions without reduction
+// -----------------------------------------------------------------------
+
+// The general kernel maps the thread index back to the tensor index with a division and a modulo per dimension. The
+// most common two-dimensional case, a broadcast of a column or row (e.g. adding a bias, [rows x cols] + [rows x 1] or
+// [rows x cols] + [1 x cols]), instead uses a two-dimensional grid: threads in X on neighboring rows, so that reads
+// and writes are coalesced, and threads in Y plus a grid-stride loop on columns.
+
+static const C_int tensorOp2DTileRows = 32; // threads in X, one warp
+static const C_int tensorOp2DTileCols = 8;  // threads in Y
+
+template <class ElemType, C_size_t N>
+__global__ void _launchTensorOp2D(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+                                  FixedArray<C_int, N> rowStrides, FixedArray<C_int, N> colStrides, CUDA_LONG numRows, CUDA_LONG numCols)
+{
+    CUDA_LONG row = blockIdx.x * tensorOp2DTileRows + threadIdx.x;
+    if (row >= numRows)
+        return;
+    for (C_size_t i = 0; i < N; i++)
+        pointers[i] += row * rowStrides[i];
+    for (CUDA_LONG col = blockIdx.y * tensorOp2DTileCols + threadIdx.y; col < numCols; col += gridDim.y * tensorOp2DTileCols)
+    {
+        FixedArray<ElemType*, N> p = pointers;
+        for (C_size_t i = 0; i < N; i++)
+            p[i] += col * colStrides[i];
+        ElemType val = TensorOps<ElemType>::Compute(p, op) * alpha;
+        if (beta != 0)
+            val += beta * *p[N - 1];
+        *p[N - 1] = val;
+    }
+}
+
+// returns false if the operation is not two-dimensional with contiguous output rows, or has too few rows to fill a warp
+template <class ElemType, C_size_t N>
+static bool TryLaunchTensorOp2D(ElemType beta, const array<ElemType*, N>& pointerVector, ElemType alpha, ElementWiseOperator op,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                const SmallVector<size_t>& reducingOpDims)
+{
+    if (regularOpDims.size() != 2 || reducingOpDims.size() != 0 || regularStrides[N - 1][0] != 1 || regularOpDims[0] < tensorOp2DTileRows)
+        return false;
+    let numRows = (CUDA_LONG) regularOpDims[0];
+    let numCols = (CUDA_LONG) regularOpDims[1];
+    array<ptrdiff_t, N> rowStrideVector, colStrideVector;
+    for (C_size_t i = 0; i < N; i++)
+    {
+        rowStrideVector[i] = regularStrides[i][0];
+        colStrideVector[i] = regularStrides[i][1];
+    }
+    FixedArray<C_int, N> rowStrides(rowStrideVector);
+    FixedArray<C_int, N> colStrides(colStrideVector);
+    FixedArray<ElemType*, N> pointers(pointerVector);
+
+    // no more blocks than the GPU can hold at once, nor than there are tiles of columns
+    let& props = GridDim::GetDeviceProps();
+    let maxBlocks = props.multiProcessorCount * max(1, props.maxThreadsPerMultiProcessor / (tensorOp2DTileRows * tensorOp2DTileCols));
+    let numBlocksX = CeilDiv(numRows, tensorOp2DTileRows);
+    let numBlocksY = max((CUDA_LONG) 1, min(min(CeilDiv(maxBlocks, numBlocksX), CeilDiv(numCols, tensorOp2DTileCols)), (CUDA_LONG) props.maxGridSize[1]));
+
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _launchTensorOp2D<ElemType, N><<<dim3(numBlocksX, numBlocksY), dim3(tensorOp2DTileRows, tensorOp2DTileCols), 0, t_stream>>>(beta, pointers, alpha, op, rowStrides, colStrides, numRows, numCols);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // kernel and launch  --linear unary
 // -----------------------------------------------------------------------
@@ -729,6 +1009,12 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 {
     for (C_size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
+    if (TryLaunchColumnReduction(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
+    if (TryLaunchLinearTensorOp(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims))
+        return;
+    if (TryLaunchTensorOp2D(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims))
+        return;
     size_t dims = regularOpDims.size();
     switch (dims)
     {
@@ -11,6 +11,12 @@
 #include "GPUWatcher.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
+#include <nvml.h>                // (see BestGpu.cpp)
+#pragma comment(lib, "nvml.lib")
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 int GPUWatcher::GetGPUIdWithTheMostFreeMemory()
 {
@@ -53,12 +59,117 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int devId)
         return free;
 }
 
+// ---------------------------------------------------------------------------
+// sampling mode
+// ---------------------------------------------------------------------------
+
+struct GPUWatcher::Sampler
+{
+    nvmlDevice_t device;
+    double intervalSeconds;
+
+    std::thread thread;
+    mutable std::mutex mutex; // guards everything below
+    std::condition_variable stopped;
+    bool stop;
+    GPUActivity activity;
+
+    // one sample; values NVML cannot tell for this device count as 0
+    void Sample()
+    {
+        GPUActivity sample;
+        nvmlUtilization_t utilization;
+        if (nvmlDeviceGetUtilizationRates(device, &utilization) == NVML_SUCCESS)
+        {
+            sample.smUtilization = utilization.gpu;
+            sample.memoryUtilization = utilization.memory;
+        }
+        unsigned int kbps;
+        if (nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_TX_BYTES, &kbps) == NVML_SUCCESS)
+            sample.pcieTxMBps = kbps / 1024.0;
+        if (nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_RX_BYTES, &kbps) == NVML_SUCCESS)
+            sample.pcieRxMBps = kbps / 1024.0;
+        unsigned int milliwatts;
+        if (nvmlDeviceGetPowerUsage(device, &milliwatts) == NVML_SUCCESS)
+            sample.powerWatts = milliwatts / 1000.0;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        activity.numSamples++;
+        activity.smUtilization += sample.smUtilization;
+        activity.memoryUtilization += sample.memoryUtilization;
+        activity.pcieTxMBps += sample.pcieTxMBps;
+        activity.pcieRxMBps += sample.pcieRxMBps;
+        activity.powerWatts += sample.powerWatts;
+    }
+};
+
+void GPUWatcher::StartSampling(int deviceId, double intervalSeconds)
+{
+    StopSampling();
+    if (deviceId < 0 || intervalSeconds <= 0 || nvmlInit() != NVML_SUCCESS)
+        return;
+    // NVML enumerates the devices in a different order than CUDA; match them by PCI bus id
+    char pciBusId[32];
+    nvmlDevice_t device;
+    if (cudaDeviceGetPCIBusId(pciBusId, sizeof(pciBusId), deviceId) != cudaSuccess ||
+        nvmlDeviceGetHandleByPciBusId(pciBusId, &device) != NVML_SUCCESS)
+    {
+        nvmlShutdown();
+        return;
+    }
+
+    m_sampler = new Sampler();
+    m_sampler->device = device;
+    m_sampler->intervalSeconds = intervalSeconds;
+    m_sampler->stop = false;
+    Sampler* sampler = m_sampler;
+    m_sampler->thread = std::thread([sampler]()
+                                    {
+                                        std::unique_lock<std::mutex> lock(sampler->mutex);
+                                        while (!sampler->stop)
+                                        {
+                                            lock.unlock();
+                                            sampler->Sample();
+                                            lock.lock();
+                                            sampler->stopped.wait_for(lock, std::chrono::duration<double>(sampler->intervalSeconds), [sampler]()
+                                                                      {
+                                                                          return sampler->stop;
+                                                                      });
+                                        }
+                                    });
+}
+
+void GPUWatcher::StopSampling()
+{
+    if (!m_sampler)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_sampler->mutex);
+        m_sampler->stop = true;
+    }
+    m_sampler->stopped.notify_one();
+    m_sampler->thread.join();
+    delete m_sampler;
+    m_sampler = nullptr;
+    nvmlShutdown(); // (reference-counted)
+}
+
+GPUActivity GPUWatcher::GetActivity() const
+{
+    if (!m_sampler)
+        return GPUActivity();
+    std::lock_guard<std::mutex> lock(m_sampler->mutex);
+    return m_sampler->activity;
+}
+
 GPUWatcher::GPUWatcher(void)
+    : m_sampler(nullptr)
 {
 }
 
 GPUWatcher::~GPUWatcher(void)
 {
+    StopSampling();
 }
 
 #endif // CPUONLY
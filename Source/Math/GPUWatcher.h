@@ -7,6 +7,38 @@
 
 #include "GPUMatrix.h"
 
+// what a GPU was doing, as sampled through NVML: sums over the samples taken so far, so that the difference of two
+// snapshots is the activity in between
+struct GPUActivity
+{
+    size_t numSamples;
+    double smUtilization;     // percent of the time a kernel was running
+    double memoryUtilization; // percent of the time device memory was being read or written
+    double pcieTxMBps;        // PCIe throughput, device to host
+    double pcieRxMBps;        // ... and host to device
+    double powerWatts;
+
+    GPUActivity()
+        : numSamples(0), smUtilization(0), memoryUtilization(0), pcieTxMBps(0), pcieRxMBps(0), powerWatts(0)
+    {
+    }
+    // the mean of the samples since 'earlier'
+    GPUActivity MeanSince(const GPUActivity& earlier) const
+    {
+        GPUActivity mean;
+        mean.numSamples = numSamples - earlier.numSamples;
+        if (mean.numSamples > 0)
+        {
+            mean.smUtilization = (smUtilization - earlier.smUtilization) / mean.numSamples;
+            mean.memoryUtilization = (memoryUtilization - earlier.memoryUtilization) / mean.numSamples;
+            mean.pcieTxMBps = (pcieTxMBps - earlier.pcieTxMBps) / mean.numSamples;
+            mean.pcieRxMBps = (pcieRxMBps - earlier.pcieRxMBps) / mean.numSamples;
+            mean.powerWatts = (powerWatts - earlier.powerWatts) / mean.numSamples;
+        }
+        return mean;
+    }
+};
+
 class MATH_API GPUWatcher
 {
 public:
@@ -14,4 +46,14 @@ public:
     static int GetGPUIdWithTheMostFreeMemory();
     GPUWatcher(void);
     ~GPUWatcher(void);
+
+    // sampling mode: a background thread samples the device's activity every 'intervalSeconds' until StopSampling()
+    // (or destruction); without NVML or for a device it does not know, no samples are taken
+    void StartSampling(int deviceId, double intervalSeconds);
+    void StopSampling();
+    GPUActivity GetActivity() const; // (thread-safe)
+
+private:
+    struct Sampler;
+    Sampler* m_sampler; // (not a smart pointer, to keep STL types out of the DLL interface)
 };
@@ -12,8 +12,10 @@
 #include "GPUMatrix.h"
 #include "GPUSparseMatrix.h"
 #include "File.h"
+#include "DeviceTransferMonitor.h"
 #include <assert.h>
 #include <math.h>
+#include <set>
 #include "GPUWatcher.h" // bring in this class as well so that it gets exported from this DLL
 #ifndef CPUONLY
 #pragma comment(lib, "MathCUDA.lib") // built by CNTKMathCUDA project
@@ -171,10 +173,19 @@
 // After selecting a device id, always run the result through this function, which will cache the first choice.
 // TODO: This is a stop-gap. It will be cleaned up once we also fix the GPU late-locking bug.
 //       The correct fix is to always route GPU selection through a single function in the first place.
+// GPUs that nodes were explicitly placed on for model parallelism (see ComputationNode::MoveToDevice()); these are let through
+static std::set<DEVICEID_TYPE>& AdditionalGPUs()
+{
+    static std::set<DEVICEID_TYPE> additionalGPUs;
+    return additionalGPUs;
+}
+
 DEVICEID_TYPE EnforceOneGPUOnly(DEVICEID_TYPE requestedDeviceId)
 {
     if (requestedDeviceId < 0) // only apply this to GPU ids
         return requestedDeviceId;
+    if (AdditionalGPUs().find(requestedDeviceId) != AdditionalGPUs().end())
+        return requestedDeviceId;
     static DEVICEID_TYPE theGPUId = DEVICEID_NOTYETDETERMINED;
     if (theGPUId == DEVICEID_NOTYETDETERMINED)
         theGPUId = requestedDeviceId;
@@ -190,6 +201,13 @@ DEVICEID_TYPE EnforceOneGPUOnly(DEVICEID_TYPE requestedDeviceId)
     return theGPUId;
 }
 
+// AllowAdditionalGPU - exempt a GPU from EnforceOneGPUOnly(), for nodes that are explicitly placed on it
+void AllowAdditionalGPU(DEVICEID_TYPE deviceId)
+{
+    if (deviceId >= 0)
+        AdditionalGPUs().insert(deviceId);
+}
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 #pragma region Constructors, destructors and other static matrix builders
@@ -576,6 +594,13 @@ void Matrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId)
         GPUMatrix<ElemType>::SetDevice(deviceId);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::WaitForAsyncSetValues(DEVICEID_TYPE deviceId)
+{
+    if (deviceId >= 0)
+        GPUMatrix<ElemType>::WaitForAsyncSetValues(deviceId);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Read(File& stream)
 {
@@ -1241,14 +1266,17 @@ void Matrix<ElemType>::SetValue(const size_t rIdx, const size_t cIdx, ElemType v
 // read features
 template <class ElemType>
 void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
-                                              const size_t nz, const size_t numRows, const size_t numCols)
+                                              const size_t nz, const size_t numRows, const size_t numCols, const size_t matrixFlags)
 {
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED,
                             m_CPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols),
-                            m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols));
+                            if (matrixFlags & matrixFlagSetValueAsync)
+                                m_GPUSparseMatrix->SetMatrixFromCSCFormatAsync(h_CSCCol, h_Row, h_Val, nz, numRows, numCols);
+                            else
+                                m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols));
 }
 
 template <class ElemType>
@@ -1451,7 +1479,7 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
 }
 
 template <class ElemType>
-void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+/*static*/ void Matrix<ElemType>::FSAdagradScalars(size_t mbSize, ElemType& adaWeight, ElemType& adaMul)
 {
     // TODO: The values of 'adagradT' and 'targetadagradavdenom' are currently hardcoded constants taken from DBN (empirically determined).
     // These should be made configurable if needed
@@ -1461,7 +1489,15 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
 
     static ElemType aggadagradsqrframes = 0;
     aggadagradsqrframes = adagradkeepweight * aggadagradsqrframes + (1.0f - adagradkeepweight) * mbSize;
-    const ElemType targetadagradavdenom_x_sqrtadagradsqrframes = static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+    adaWeight = adagradkeepweight;
+    adaMul = static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+{
+    ElemType adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes;
+    FSAdagradScalars(mbSize, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
 
     DISPATCH_MATRIX_ON_FLAG(&gradients,
                             &gradients,
@@ -1473,6 +1509,146 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::Adam(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample,
+                            const ElemType beta1, const ElemType beta2, const ElemType epsilon, const size_t step, const bool updateValues)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    // the moment estimates start at 0 and are biased towards it in the first steps
+    const ElemType biasCorrection1 = (ElemType)(1 / (1 - pow((double) beta1, (double) step)));
+    const ElemType biasCorrection2 = (ElemType)(1 / (1 - pow((double) beta2, (double) step)));
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            &gradients,
+                            m_CPUMatrix->Adam(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, beta1, beta2, epsilon, biasCorrection1, biasCorrection2, updateValues);
+                            SetDataLocation(CPU),
+                            m_GPUMatrix->Adam(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, beta1, beta2, epsilon, biasCorrection1, biasCorrection2, updateValues);
+                            SetDataLocation(GPU),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params)
+{
+    if (tensors.empty())
+        return;
+
+    if (deviceId == CPUDEVICE)
+        CPUMatrix<ElemType>::MultiTensorUpdate(tensors, params);
+    else
+        GPUMatrix<ElemType>::MultiTensorUpdate(deviceId, tensors, params);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::SimpleRNNForward(const Matrix<ElemType>& R, const Matrix<ElemType>& X, const Matrix<ElemType>& hStart, const Matrix<ElemType>& continues,
+                                                   ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                                   Matrix<ElemType>& delayed, Matrix<ElemType>& product, Matrix<ElemType>& sum, Matrix<ElemType>& hidden)
+{
+    const size_t H = R.GetNumRows();
+    const size_t S = continues.GetNumRows();
+    if (R.GetNumCols() != H || X.GetNumRows() != H || hStart.GetNumRows() != H || hStart.GetNumCols() != S || X.GetNumCols() != S * continues.GetNumCols())
+        InvalidArgument("SimpleRNNForward: Inconsistent dimensions.");
+    if (nonlinearity != ElementWiseOperator::opSigmoid && nonlinearity != ElementWiseOperator::opTanh && nonlinearity != ElementWiseOperator::opLinearRectifier)
+        InvalidArgument("SimpleRNNForward: Unsupported nonlinearity.");
+    DecideAndMoveToRightDevice(R, X, hStart, continues);
+    for (auto* m : {&delayed, &product, &sum, &hidden})
+    {
+        m->_transferToDevice(R.GetDeviceId());
+        m->Resize(H, X.GetNumCols());
+    }
+
+    if (R.GetDeviceId() == CPUDEVICE)
+        CPUMatrix<ElemType>::SimpleRNNForward(*R.m_CPUMatrix, *X.m_CPUMatrix, *hStart.m_CPUMatrix, *continues.m_CPUMatrix, initialValue, nonlinearity, reverse,
+                                              *delayed.m_CPUMatrix, *product.m_CPUMatrix, *sum.m_CPUMatrix, *hidden.m_CPUMatrix);
+    else
+        GPUMatrix<ElemType>::SimpleRNNForward(*R.m_GPUMatrix, *X.m_GPUMatrix, *hStart.m_GPUMatrix, *continues.m_GPUMatrix, initialValue, nonlinearity, reverse,
+                                              *delayed.m_GPUMatrix, *product.m_GPUMatrix, *sum.m_GPUMatrix, *hidden.m_GPUMatrix);
+}
+
+template <class ElemType>
+/*static*/ bool Matrix<ElemType>::IsSimpleRNNForwardSupported(DEVICEID_TYPE deviceId, size_t hiddenDim)
+{
+    return deviceId == CPUDEVICE || GPUMatrix<ElemType>::IsSimpleRNNForwardSupported(hiddenDim);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::SoftmaxCrossEntropyForward(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp, Matrix<ElemType>& criterion)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("SoftmaxCrossEntropyForward: labels and logits must have the same dimensions.");
+    if (labels.GetMatrixType() != DENSE || logits.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    DecideAndMoveToRightDevice(logits, labels);
+    logSumExp._transferToDevice(logits.GetDeviceId());
+    criterion._transferToDevice(logits.GetDeviceId());
+    logSumExp.Resize(1, logits.GetNumCols());
+    criterion.Resize(1, 1);
+
+    if (logits.GetDeviceId() == CPUDEVICE)
+        CPUMatrix<ElemType>::SoftmaxCrossEntropyForward(*labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *criterion.m_CPUMatrix);
+    else
+        GPUMatrix<ElemType>::SoftmaxCrossEntropyForward(*labels.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix, *criterion.m_GPUMatrix);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::SoftmaxCrossEntropyBackward(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                                              Matrix<ElemType>& logitsGradient)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols() ||
+        logitsGradient.GetNumRows() != logits.GetNumRows() || logitsGradient.GetNumCols() != logits.GetNumCols() ||
+        logSumExp.GetNumElements() != logits.GetNumCols() || gradient.GetNumElements() != 1)
+        InvalidArgument("SoftmaxCrossEntropyBackward: Inconsistent dimensions.");
+    if (labels.GetMatrixType() != DENSE || logits.GetMatrixType() != DENSE || logitsGradient.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    DecideAndMoveToRightDevice(logitsGradient, logits, labels, logSumExp);
+    gradient._transferToDevice(logitsGradient.GetDeviceId());
+
+    if (logitsGradient.GetDeviceId() == CPUDEVICE)
+        CPUMatrix<ElemType>::SoftmaxCrossEntropyBackward(*gradient.m_CPUMatrix, *labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *logitsGradient.m_CPUMatrix);
+    else
+        GPUMatrix<ElemType>::SoftmaxCrossEntropyBackward(*gradient.m_GPUMatrix, *labels.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix, *logitsGradient.m_GPUMatrix);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::IndexedSoftmaxCrossEntropyForward(const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp, Matrix<ElemType>& criterion)
+{
+    if (labelIndices.GetNumElements() != logits.GetNumCols())
+        InvalidArgument("IndexedSoftmaxCrossEntropyForward: There must be one label index per column of the logits.");
+    if (labelIndices.GetMatrixType() != DENSE || logits.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    DecideAndMoveToRightDevice(logits, labelIndices);
+    logSumExp._transferToDevice(logits.GetDeviceId());
+    criterion._transferToDevice(logits.GetDeviceId());
+    logSumExp.Resize(1, logits.GetNumCols());
+    criterion.Resize(1, 1);
+
+    if (logits.GetDeviceId() == CPUDEVICE)
+        CPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyForward(*labelIndices.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *criterion.m_CPUMatrix);
+    else
+        GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyForward(*labelIndices.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix, *criterion.m_GPUMatrix);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                                                     Matrix<ElemType>& logitsGradient)
+{
+    if (labelIndices.GetNumElements() != logits.GetNumCols() ||
+        logitsGradient.GetNumRows() != logits.GetNumRows() || logitsGradient.GetNumCols() != logits.GetNumCols() ||
+        logSumExp.GetNumElements() != logits.GetNumCols() || gradient.GetNumElements() != 1)
+        InvalidArgument("IndexedSoftmaxCrossEntropyBackward: Inconsistent dimensions.");
+    if (labelIndices.GetMatrixType() != DENSE || logits.GetMatrixType() != DENSE || logitsGradient.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    DecideAndMoveToRightDevice(logitsGradient, logits, labelIndices, logSumExp);
+    gradient._transferToDevice(logitsGradient.GetDeviceId());
+
+    if (logitsGradient.GetDeviceId() == CPUDEVICE)
+        CPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(*gradient.m_CPUMatrix, *labelIndices.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *logitsGradient.m_CPUMatrix);
+    else
+        GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(*gradient.m_GPUMatrix, *labelIndices.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix, *logitsGradient.m_GPUMatrix);
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_GAMMA,
@@ -1871,6 +2047,90 @@ Matrix<ElemType>& Matrix<ElemType>::AddFoldedPositiveAndShiftedNegSample(const M
     return *this;
 }
 
+// this(:,j) = beta * this(:,j) + alpha * a(:,idx[j]), where idx holds one column index of a per column of this.
+// Negative indices denote gaps; their columns receive no contribution from a.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoGatherColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha)
+{
+    DecideAndMoveToRightDevice(*this, idx, a);
+
+    if (GetMatrixType() != DENSE || idx.GetMatrixType() != DENSE || a.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DoGatherColumnsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha),
+                            m_GPUMatrix->DoGatherColumnsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+// this = beta * this, then this(:,idx[j]) += alpha * a(:,j) for all columns j of a, summing over repeated indices.
+// Negative indices are skipped. If this is sparse, it is kept in SparseBlockCol format with one block per column
+// that received a value, so that e.g. the gradient of an embedding only stores the rows looked up in the minibatch;
+// in this case beta must be 0 or 1.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha)
+{
+    DecideAndMoveToRightDevice(*this, idx, a);
+
+    if (idx.GetMatrixType() != DENSE || a.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DoScatterColumnsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha),
+                            m_GPUMatrix->DoScatterColumnsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha),
+                            m_CPUSparseMatrix->DoScatterColumnsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha),
+                            m_GPUSparseMatrix->DoScatterColumnsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha));
+
+    return *this;
+}
+
+// this = beta * this + a .* mask, where mask(k) of the k-th element (column-major) is 0 with probability dropoutRate and
+// 1 / (1 - dropoutRate) otherwise, drawn with PhiloxUniform(seed, counterOffset + k). The same arguments give the same
+// mask, so that e.g. backprop can apply it again without it having been stored.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoDropoutOf(ElemType beta, const Matrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset)
+{
+    DecideAndMoveToRightDevice(*this, a);
+
+    if (GetMatrixType() != DENSE || a.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DoDropoutOf(beta, *a.m_CPUMatrix, dropoutRate, seed, counterOffset),
+                            m_GPUMatrix->DoDropoutOf(beta, *a.m_GPUMatrix, dropoutRate, seed, counterOffset),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+// this(k,h) = FeatureHash(ids[k], h) % numBuckets, a [ids.GetNumElements() x numHashes] matrix of bucket indices for
+// the elements of ids (column-major) under numHashes independent hash functions. Negative ids (gaps, padding) map to -1,
+// which DoGatherColumnsOf() and DoScatterColumnsOf() skip. The hashes are the same on the CPU and the GPU.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignHashedIndicesOf(const Matrix<ElemType>& ids, size_t numBuckets, size_t numHashes)
+{
+    DecideAndMoveToRightDevice(*this, ids);
+
+    if (GetMatrixType() != DENSE || ids.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignHashedIndicesOf(*ids.m_CPUMatrix, numBuckets, numHashes),
+                            m_GPUMatrix->AssignHashedIndicesOf(*ids.m_GPUMatrix, numBuckets, numHashes),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignDifferenceOf(const ElemType alpha, const Matrix<ElemType>& a)
 {
@@ -3382,6 +3642,8 @@ void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>&
 {
     if (IsEmpty())
         LogicError("VectorMax: Matrix is empty.");
+    if (topK < 1 || topK > (int) (isColWise ? GetNumRows() : GetNumCols()))
+        InvalidArgument("VectorMax: topK (%d) must be between 1 and the vector dimension (%d).", topK, (int) (isColWise ? GetNumRows() : GetNumCols()));
 
     DecideAndMoveToRightDevice(*this, maxIndexes, maxValues);
     maxIndexes.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
@@ -3551,6 +3813,13 @@ void Matrix<ElemType>::_transferToDevice(int to_id, bool ismoved, bool emptyTran
     if (to_id == from_id) // nothing to do
         return;
 
+    // this is where operations move their operands behind the caller's back
+    if (!emptyTransfer && DeviceTransferMonitor::GetMode() != DeviceTransferMonitor::allow)
+    {
+        size_t numElements = (m_matrixType == MatrixType::SPARSE) ? NzCount() : GetNumElements();
+        DeviceTransferMonitor::OnImplicitTransfer(GetNumRows(), GetNumCols(), numElements * sizeof(ElemType), from_id, to_id);
+    }
+
     if (OwnBuffer())
         _transferFromDeviceToDevice(from_id, to_id, ismoved, emptyTransfer);
     else
@@ -4051,8 +4320,21 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     if (c.GetDeviceId() < 0) // CPU
     {
         if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        {
+            if (b.GetMatrixType() == MatrixType::DENSE && c.GetMatrixType() == MatrixType::SPARSE) // TransposeTimes gradient
+            {
+                CPUSparseMatrix<ElemType>::MultiplyAndAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, *c.m_CPUSparseMatrix);
+                c.SetDataLocation(CPU, SPARSE);
+            }
+            else if (b.GetMatrixType() == MatrixType::DENSE && c.GetMatrixType() == MatrixType::DENSE) // e.g. pruned weights
+            {
+                CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+                c.SetDataLocation(CPU, DENSE);
+            }
+            else
+                NOT_IMPLEMENTED;
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -4083,8 +4365,13 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
         }
         else if (a.m_matrixType == MatrixType::SPARSE && b.m_matrixType == c.m_matrixType && b.m_matrixType == MatrixType::DENSE) // Sparse*Dense+Dense
         {
-            GPUMatrix<ElemType> second = transposeB ? b.m_GPUMatrix->Transpose() : *b.m_GPUMatrix;
-            GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, second, false, beta, *c.m_GPUMatrix);
+            if (transposeA && transposeB) // (cuSPARSE cannot transpose both)
+            {
+                GPUMatrix<ElemType> second = b.m_GPUMatrix->Transpose();
+                GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, second, false, beta, *c.m_GPUMatrix);
+            }
+            else // b is used in place, transposed or not
+                GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix);
             c.SetDataLocation(GPU, DENSE);
         }
         else if (a.m_matrixType == MatrixType::DENSE && b.m_matrixType == MatrixType::SPARSE && c.m_matrixType == MatrixType::DENSE) // Dense*Sparse + Dense
@@ -4118,6 +4405,11 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
             GPUSparseMatrix<ElemType>::MultiplyAndAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUSparseMatrix, transposeB, *c.m_GPUSparseMatrix);
             c.SetDataLocation(GPU, SPARSE);
         }
+        else if (a.m_matrixType == MatrixType::SPARSE && b.m_matrixType == MatrixType::DENSE && c.m_matrixType == MatrixType::SPARSE) // TransposeTimes gradient
+        {
+            GPUSparseMatrix<ElemType>::MultiplyAndAdd(alpha, *a.m_GPUSparseMatrix, transposeA, *b.m_GPUMatrix, transposeB, *c.m_GPUSparseMatrix);
+            c.SetDataLocation(GPU, SPARSE);
+        }
         else if (a.m_matrixType == b.m_matrixType && b.m_matrixType == c.m_matrixType && a.m_matrixType == MatrixType::SPARSE)
         {
             GPUSparseMatrix<ElemType> firstDummy = alpha == 1 ? *a.m_GPUSparseMatrix : (*a.m_GPUSparseMatrix) * alpha;
@@ -4165,6 +4457,44 @@ template <class ElemType>
                             NOT_IMPLEMENTED);
 }
 
+// verify that the batchCount submatrices [rows x cols] at multiples of 'stride' lie within x
+template <class ElemType>
+static void VerifyStridedBatch(const char* what, const Matrix<ElemType>& x, size_t rows, size_t cols, size_t stride, size_t batchCount)
+{
+    if (x.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    const size_t ld = x.GetNumRows();
+    if (rows > ld || (batchCount - 1) * stride + (cols - 1) * ld + rows > x.GetNumElements())
+        InvalidArgument("MultiplyAndWeightedAddStridedBatched: %d submatrices [%d x %d] with stride %d do not fit into %s [%d x %d].",
+                        (int) batchCount, (int) rows, (int) cols, (int) stride, what, (int) x.GetNumRows(), (int) x.GetNumCols());
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiplyAndWeightedAddStridedBatched(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                                       const Matrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                                       ElemType beta, Matrix<ElemType>& c, size_t strideC,
+                                                                       size_t m, size_t n, size_t k, size_t batchCount)
+{
+    if (batchCount == 0)
+        return;
+    if (m == 0 || n == 0 || k == 0)
+        InvalidArgument("MultiplyAndWeightedAddStridedBatched: Empty product [%d x %d] * [%d x %d].", (int) m, (int) k, (int) k, (int) n);
+    if (strideC == 0 && batchCount > 1)
+        InvalidArgument("MultiplyAndWeightedAddStridedBatched: The results must not overlap (strideC = 0).");
+    VerifyStridedBatch("a", a, transposeA ? k : m, transposeA ? m : k, strideA, batchCount);
+    VerifyStridedBatch("b", b, transposeB ? n : k, transposeB ? k : n, strideB, batchCount);
+    VerifyStridedBatch("c", c, m, n, strideC, batchCount);
+
+    DecideAndMoveToRightDevice(a, b, c);
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::MultiplyAndWeightedAddStridedBatched(alpha, *a.m_CPUMatrix, transposeA, strideA, *b.m_CPUMatrix, transposeB, strideB, beta, *c.m_CPUMatrix, strideC, m, n, k, batchCount),
+                            GPUMatrix<ElemType>::MultiplyAndWeightedAddStridedBatched(alpha, *a.m_GPUMatrix, transposeA, strideA, *b.m_GPUMatrix, transposeB, strideB, beta, *c.m_GPUMatrix, strideC, m, n, k, batchCount),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
 /// <param name="a">Input matrix</param>
 /// <param name="transposeA">Whether matrix a is transposed</param>
@@ -4858,6 +5188,54 @@ void Matrix<ElemType>::InnerProductWithShiftNeg(const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCosDistanceWithShiftNegOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNegOf: Matrix is empty.");
+
+    DecideAndMoveToRightDevice(a, b, *this);
+    DecideAndMoveToRightDevice(a, invNormA, invNormB);
+
+    if (a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE || invNormA.GetMatrixType() != DENSE || invNormB.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignCosDistanceWithShiftNegOf(*a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, negnumber),
+                            m_GPUMatrix->AssignCosDistanceWithShiftNegOf(*a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, negnumber),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(bool wrtB, const Matrix<ElemType>& gradient, const Matrix<ElemType>& value,
+                                                                         const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB,
+                                                                         size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AddCosDistanceWithShiftNegGradientOf: Matrix is empty.");
+
+    DecideAndMoveToRightDevice(*this, gradient, value);
+    DecideAndMoveToRightDevice(*this, a, b);
+    DecideAndMoveToRightDevice(*this, invNormA, invNormB);
+
+    if (GetMatrixType() != DENSE || gradient.GetMatrixType() != DENSE || value.GetMatrixType() != DENSE ||
+        a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE || invNormA.GetMatrixType() != DENSE || invNormB.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            m_CPUMatrix->AddCosDistanceWithShiftNegGradientOf(wrtB, *gradient.m_CPUMatrix, *value.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, negnumber),
+                            m_GPUMatrix->AddCosDistanceWithShiftNegGradientOf(wrtB, *gradient.m_GPUMatrix, *value.m_GPUMatrix, *a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, negnumber),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::GetARowByIndex(const Matrix<ElemType>& a, size_t index)
 {
@@ -4929,6 +5307,25 @@ Matrix<ElemType>& Matrix<ElemType>::AssignElementProductOfWithShift(const Matrix
     return *this;
 }
 
+template <class ElemType>
+void Matrix<ElemType>::RCRFForwardCompute(Matrix<ElemType>& alpha, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int startLbl)
+{
+    DecideAndMoveToRightDevice(pos_scores, pair_scores, alpha);
+
+    DISPATCH_MATRIX_ON_FLAG(&pos_scores,
+                            &alpha,
+                            CPUMatrix<ElemType>::RCRFForwardCompute(
+                                *alpha.m_CPUMatrix,
+                                *pos_scores.m_CPUMatrix,
+                                *pair_scores.m_CPUMatrix, startLbl),
+                            GPUMatrix<ElemType>::RCRFForwardCompute(
+                                *alpha.m_GPUMatrix,
+                                *pos_scores.m_GPUMatrix,
+                                *pair_scores.m_GPUMatrix, startLbl),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
                                            Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
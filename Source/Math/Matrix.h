@@ -112,6 +112,8 @@ public:
     static Matrix<ElemType> RandomGaussian(const size_t rows, const size_t cols, const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED, DEVICEID_TYPE deviceId = AUTOPLACEMATRIX);
 
     static void SetDevice(DEVICEID_TYPE deviceId);
+    // block until the host buffers passed to SetValue() or SetMatrixFromCSCFormat() with matrixFlagSetValueAsync for this device may be reused
+    static void WaitForAsyncSetValues(DEVICEID_TYPE deviceId);
 
     void Clear();
     ~Matrix();
@@ -198,6 +200,41 @@ public:
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    // smoothed gradient: [first moment | second moment]; 'step' counts the updates including this one, for the bias correction
+    // With updateValues false, the Adam direction is left in 'gradients' instead of being applied (LAMB scales it first).
+    void Adam(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample,
+              const ElemType beta1, const ElemType beta2, const ElemType epsilon, const size_t step, const bool updateValues);
+    // the scalars of the next FSAdagrad() step; each call advances the running frame count that FSAdagrad() keeps
+    static void FSAdagradScalars(size_t mbSize, ElemType& adaWeight, ElemType& adaMul);
+    // update many dense parameters on one device in a single pass per element (one kernel launch on the GPU):
+    // truncation clipping, L2, the rule's update of value and smoothed gradient, and L1, as SGD::UpdateWeightsS() does
+    static void MultiTensorUpdate(DEVICEID_TYPE deviceId, const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params);
+
+    // forward prop of a simple recurrence h_t = f(x_t + R h_{t-1}) over all frames of a minibatch in one pass, on the GPU
+    // in a single persistent kernel that holds R in shared memory. Columns are frames in minibatch order (t * S + s).
+    // h_{t-1} is initialValue where continues(s,t) == 0 (sequence start, gap); otherwise it is the previous frame's h,
+    // or hStart(:,s) for t = 0 (state carried over from the previous minibatch). 'reverse' runs from the last frame
+    // (h_{t+1} instead). Writes h_{t-1}, R h_{t-1}, their sum with x_t, and h_t, as the nodes of the loop would.
+    // nonlinearity is opSigmoid, opTanh or opLinearRectifier.
+    static void SimpleRNNForward(const Matrix<ElemType>& R, const Matrix<ElemType>& X, const Matrix<ElemType>& hStart, const Matrix<ElemType>& continues,
+                                 ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                 Matrix<ElemType>& delayed, Matrix<ElemType>& product, Matrix<ElemType>& sum, Matrix<ElemType>& hidden);
+    // whether R of this hidden dimension fits the kernel's shared memory (always true on the CPU)
+    static bool IsSimpleRNNForwardSupported(DEVICEID_TYPE deviceId, size_t hiddenDim);
+
+    // fused softmax and cross entropy, column-wise: one pass over the logits computes, per column j, the log-sum-exp
+    // logSumExp(0,j) = log sum_i exp(logits(i,j)), and criterion = -sum_ij labels(i,j) * log softmax_i(logits(:,j)) [1 x 1].
+    // Only nonzero labels contribute, so a column whose labels are all zero (e.g. a masked gap) does not, whatever its logits.
+    // The backward pass adds gradient [1 x 1] * (softmax(logits) - labels) to logitsGradient, from logSumExp. Dense only.
+    static void SoftmaxCrossEntropyForward(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp, Matrix<ElemType>& criterion);
+    static void SoftmaxCrossEntropyBackward(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                            Matrix<ElemType>& logitsGradient);
+    // the same, with the labels given as class indices [1 x T] instead of one-hot columns: the label of column j is row
+    // labelIndices(0,j), which must be less than the number of rows of the logits. A negative index means no label (e.g. a
+    // masked gap): the column contributes neither to the criterion nor to the gradient.
+    static void IndexedSoftmaxCrossEntropyForward(const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp, Matrix<ElemType>& criterion);
+    static void IndexedSoftmaxCrossEntropyBackward(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp,
+                                                   Matrix<ElemType>& logitsGradient);
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other)
@@ -253,8 +290,9 @@ public:
     {
         SetValue(MakeNan(__LINE__));
     }
+    // with matrixFlagSetValueAsync, the buffers are page-locked, and a GPU matrix is uploaded without blocking (the CPU ignores the flag)
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
-                                const size_t nz, const size_t numRows, const size_t numCols);
+                                const size_t nz, const size_t numRows, const size_t numCols, const size_t matrixFlags = matrixFlagNormal);
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
@@ -396,6 +434,14 @@ public:
     Matrix<ElemType>& AssignPositiveAndShiftedNegSample(const Matrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     Matrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const Matrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
 
+    // column gather/scatter by index, e.g. for embeddings; idx holds one column index per element (as ElemType), negative ones are skipped
+    Matrix<ElemType>& DoGatherColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);  // this(:,j) = beta * this(:,j) + alpha * a(:,idx[j])
+    Matrix<ElemType>& DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha); // this = beta * this; this(:,idx[j]) += alpha * a(:,j)
+    // this = beta * this + a .* mask, with a dropout mask that is a function of (seed, counterOffset + element index)
+    Matrix<ElemType>& DoDropoutOf(ElemType beta, const Matrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset);
+    // this(k,h) = FeatureHash(ids[k], h) % numBuckets for numHashes hash functions, or -1 for negative ids; e.g. as column indices for DoGatherColumnsOf()
+    Matrix<ElemType>& AssignHashedIndicesOf(const Matrix<ElemType>& ids, size_t numBuckets, size_t numHashes);
+
     bool IsValid() const;
     bool IsEqualTo(const Matrix<ElemType>& a, const ElemType threshold = 1e-8) const;
 
@@ -425,6 +471,7 @@ public:
     Matrix<ElemType>& AssignSignOf(const Matrix<ElemType>& a);
     Matrix<ElemType>& AddSignOf(const Matrix<ElemType>& a);
     void VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise) const;
+    // the topK largest values of each column and their row indexes, best first (equal values: lower index first)
     void VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise, int topK) const;
     void VectorMin(Matrix<ElemType>& minIndexes, Matrix<ElemType>& minValues, const bool isColWise) const;
 
@@ -486,6 +533,14 @@ public:
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c);
+    // batched SGEMM: c_i = alpha * op(a_i) * op(b_i) + beta * c_i for i < batchCount, where op(a_i) is m x k, op(b_i) is k x n,
+    // and x_i is the submatrix that starts at element i * strideX of x's buffer and has x's number of rows as its leading
+    // dimension; e.g. with strideB = k and b of k*batchCount rows, b_i is the i-th group of k rows. A stride of 0 uses the
+    // same matrix for all i (not allowed for c). Dense only; c is not resized. One library call for many small products.
+    static void MultiplyAndWeightedAddStridedBatched(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, size_t strideA,
+                                                     const Matrix<ElemType>& b, const bool transposeB, size_t strideB,
+                                                     ElemType beta, Matrix<ElemType>& c, size_t strideC,
+                                                     size_t m, size_t n, size_t k, size_t batchCount);
     static void ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
 
     static void ScaleAndAdd(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
@@ -537,8 +592,17 @@ public:
     Matrix<ElemType>& GetARowByIndex(const Matrix<ElemType>& a, size_t index);
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
+    // cosine distances of the columns of a with those of b and with 'negnumber' shifted ones (DSSM), given the inverse column norms, in one pass
+    Matrix<ElemType>& AssignCosDistanceWithShiftNegOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber);
+    // [this] += the gradient of the above w.r.t. a (or b if 'wrtB'), in one pass
+    Matrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(bool wrtB, const Matrix<ElemType>& gradient, const Matrix<ElemType>& value,
+                                                           const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB,
+                                                           size_t shift, size_t negnumber);
 
 public:
+    static void RCRFForwardCompute(Matrix<ElemType>& alpha, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                   const int startLbl); // the time 0 start symbol in the output layer
+
     static void RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
                                     Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
                                     const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift);
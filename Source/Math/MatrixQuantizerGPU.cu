@@ -155,6 +155,19 @@ void MatrixQuantizerGPU<ElemType>::SyncAssignCompleteEvent(cudaStream_t computes
     // According to NVidia (Jiri Kraus), this works as expected.
 }
 
+template <class ElemType>
+char* MatrixQuantizerGPU<ElemType>::GetMappedDevicePointer(QuantizedMatrix<ElemType>& qMatrix)
+{
+    assert(qMatrix.GetDeviceId() == CPUDEVICE);
+    void* devicePointer = nullptr;
+    if (cudaHostGetDevicePointer(&devicePointer, qMatrix.GetArray(), 0 /*flags 'must be 0'*/) != cudaSuccess)
+    {
+        cudaGetLastError(); // (not an error for us; clear it)
+        return nullptr;
+    }
+    return (char*) devicePointer;
+}
+
 template <class ElemType>
 QuantizedMatrix<ElemType>& MatrixQuantizerGPU<ElemType>::GetTempGPUQuantizedMatrix(size_t numRows, size_t numCols, size_t nBits, bool& newlyAllocated)
 {
@@ -238,6 +251,19 @@ void MatrixQuantizerGPU<ElemType>::QuantizeAsync(const Matrix<ElemType>& inMatri
         Sync();
     }
 
+    // A CPU-side result in page-locked memory is written by the kernel directly, without a GPU buffer and fetch
+    char* outMapped = (outQMatrix.GetDeviceId() == CPUDEVICE) ? GetMappedDevicePointer(outQMatrix) : nullptr;
+    if (outMapped != nullptr)
+    {
+        _QuantizeMatrix<ElemType>(inMatrix.BufferPointer(), inResidual.BufferPointer(),
+                                  inMatrix.GetNumRows(), inMatrix.GetNumCols(),
+                                  outMapped, nBits, GetComputeStream(),
+                                  outResidual.BufferPointer(), zeroThresholdFor1Bit);
+        RecordQuantizeCompleteEvent(GetComputeStream());
+        m_quantizeOpIncludedFetch = false;
+        return;
+    }
+
     bool GPUMatrixNewlyAllocated = false;
     QuantizedMatrix<ElemType>& outQMatrixGPU = (outQMatrix.GetDeviceId() == CPUDEVICE) ? GetTempGPUQuantizedMatrix(outQMatrix.GetNumRows(), outQMatrix.GetNumCols(), nBits, GPUMatrixNewlyAllocated) : outQMatrix;
 
@@ -332,6 +358,35 @@ void MatrixQuantizerGPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& in
     RecordQuantizeCompleteEvent(GetComputeStream());
 }
 
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeAndAccumulateAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix)
+{
+    assert(outMatrix.GetDeviceId() == this->GetDeviceId());
+
+    PrepareDevice(this->GetDeviceId());
+
+    // the device-side addresses of all inputs; if any CPU-side one is not mapped, we go through the GPU buffer one by one
+    std::vector<const char*> buffers;
+    for (auto inQMatrix : inQMatrices)
+    {
+        assert((inQMatrix->GetNumRows() == outMatrix.GetNumRows()) && (inQMatrix->GetNumCols() == outMatrix.GetNumCols()));
+        assert(inQMatrix->GetNumBits() == inQMatrices[0]->GetNumBits());
+        const char* buffer = (inQMatrix->GetDeviceId() == CPUDEVICE) ? GetMappedDevicePointer(*inQMatrix) : inQMatrix->GetArray();
+        if (buffer == nullptr)
+            return MatrixQuantizerImpl<ElemType>::UnquantizeAndAccumulateAsync(inQMatrices, outMatrix);
+        buffers.push_back(buffer);
+    }
+    if (buffers.empty())
+        return;
+
+    _UnquantizeAndSumMatrices(buffers, inQMatrices[0]->GetSize(),
+                              outMatrix.BufferPointer(), outMatrix.GetNumRows(), outMatrix.GetNumCols(),
+                              inQMatrices[0]->GetNumBits(), /*add=*/false, GetComputeStream());
+
+    // Record the event of unquantization
+    RecordQuantizeCompleteEvent(GetComputeStream());
+}
+
 template <class ElemType>
 void MatrixQuantizerGPU<ElemType>::WaitUnquantizeAsyncDone()
 {
@@ -29,6 +29,9 @@ public:
     void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) override;
     void WaitUnquantizeAsyncDone() override;
 
+    // one kernel for all of them, reading CPU-side (page-locked) matrices directly
+    void UnquantizeAndAccumulateAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix) override;
+
 private:
     // Helper function to get a temporary intermediate matrix on the GPU to store quantization results
     QuantizedMatrix<ElemType>& GetTempGPUQuantizedMatrix(size_t numRows, size_t numCols, size_t nBits, bool& newlyAllocated);
@@ -45,6 +48,10 @@ private:
     // wait for the assign stream operations, scheduled so far, to finish
     void SyncAssignCompleteEvent(cudaStream_t computestream) const;
 
+    // the device-side address of a CPU-side QuantizedMatrix (page-locked memory is mapped into the device's address space),
+    // or nullptr if it is not mapped, e.g. not page-locked
+    static char* GetMappedDevicePointer(QuantizedMatrix<ElemType>& qMatrix);
+
     // for concurrent computation and memcpy
     //  - assign to GPU : CPU-to-GPU,started by CPU when data read; flags assigncomplete
     //  - GPU-side operation        --waits for assigncomplete; flags quantizecomplete
@@ -2,6 +2,7 @@
 
 #include "ColumnQuantizer.h"
 #include "QuantizedMatrix.h"
+#include <vector>
 
 #ifdef _WIN32
 #ifdef MATH_EXPORTS
@@ -33,6 +34,17 @@ public:
     virtual void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) = 0;
     virtual void WaitUnquantizeAsyncDone() = 0;
 
+    // outMatrix = sum of the unquantized inQMatrices (e.g. the quantized gradients of all nodes); wait with WaitUnquantizeAsyncDone()
+    virtual void UnquantizeAndAccumulateAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix)
+    {
+        for (size_t k = 0; k < inQMatrices.size(); k++)
+        {
+            if (k > 0)
+                WaitUnquantizeAsyncDone();
+            UnquantizeAsync(*inQMatrices[k], outMatrix, /*add=*/k > 0);
+        }
+    }
+
 protected:
     MatrixQuantizerImpl(int deviceId)
         : m_deviceId(deviceId)
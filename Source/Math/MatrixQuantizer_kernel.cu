@@ -5,6 +5,7 @@
 #include <cuda_runtime.h>
 #include <cuda_runtime_api.h>
 #include <device_launch_parameters.h>
+#include <vector>
 
 #include "ValueQuantizer.h"
 #include "ColumnQuantizer.h"
@@ -128,63 +129,74 @@ __device__ void allreduce(T& var)
 
 #define REDUCTION_BLOCK_SIZE 128 // 256 is much worse; 64 is somewhat worse
 
-// version optimized for collated memory access
+// quantize one column per *block*, in a single pass over the data: the block's threads first compute the column's
+// quantization range (collated, thread t summing rows t, t + REDUCTION_BLOCK_SIZE, ...), and then quantize its QWords
+// (thread t quantizing QWords t, t + REDUCTION_BLOCK_SIZE, ..., each writing the new residual of its rows at once).
+// 'qpackage' may be mapped page-locked host memory, in which case the results go straight to the CPU-side buffer.
 template <class ElemType, bool ZeroThresholdFor1Bit>
-__global__ void _ComputeQuantiStatParj(const ElemType* us, const ElemType* inResidual, long M, long N, size_t ldNbits, char* qpackage)
+__global__ void _QuantizeColumnj(const ElemType* us, const ElemType* curResidual, long M, long N, size_t ldNbits, size_t numQWordsPerCol,
+                                 char* qpackage, ElemType* newResidual)
 {
-    size_t subset = threadIdx.x; // first thread computes 0, 64, 128; second thread 1, 65, 129 etc.
-    size_t j = blockIdx.x;       // we process one column per *block*, j=column index; note: j is never out of range
+    size_t subset = threadIdx.x; // first thread computes 0, 128, 256; second thread 1, 129, 257 etc.
+    size_t j = blockIdx.x;       // j=column index; note: j is never out of range
 
-    size_t rows = M; // we compute from 0..rows-1
     size_t bits = 1 << ldNbits;
-    const size_t colSizeByte = Microsoft::MSR::CNTK::QuantizedColumn<ElemType>::QuantizedColumnSize(bits, rows);
+    const size_t colSizeByte = Microsoft::MSR::CNTK::QuantizedColumn<ElemType>::QuantizedColumnSize(bits, M);
     auto& qcol = *(Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qpackage[colSizeByte * j];
 
-    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType>::ComputeRangeStatColjSubset<ZeroThresholdFor1Bit>(us, inResidual, M, j, bits, qcol.lower, qcol.upper,
+    // range: computed by all threads, written by the first
+    __shared__ ElemType lower, upper;
+    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType>::ComputeRangeStatColjSubset<ZeroThresholdFor1Bit>(us, curResidual, M, j, bits, lower, upper,
                                                                                                       subset, REDUCTION_BLOCK_SIZE, allreduce<ElemType, REDUCTION_BLOCK_SIZE>, allreduce<unsigned int, REDUCTION_BLOCK_SIZE>);
+    __syncthreads();
+    if (subset == 0)
+    {
+        qcol.lower = lower;
+        qcol.upper = upper;
+    }
+
+    // quantize, writing the residual
+    const Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, lower, upper);
+    for (size_t iQWord = subset; iQWord < numQWordsPerCol; iQWord += REDUCTION_BLOCK_SIZE)
+        qcol.bits[iQWord] = q.QuantizeOneQWord<ZeroThresholdFor1Bit>(us, curResidual, M, iQWord, M, numQWordsPerCol, j, newResidual);
 }
 
-//caller: griddim and blockdim should be both 1d
-//total thread number is: totalNumQWordsAlMatrix = numCols() * numQWordsPerCol
-//called to quantize a GPU matrix
-template <class ElemType, bool ZeroThresholdFor1Bit>
-__global__ void _QuantizeStripjOneQWord(
-    const ElemType* us,
-    ElemType* curResidual,
-    long M, long N,
-    char* qMat,
-    size_t qColSize,
-    size_t numQWordsPerCol,
-    size_t ldNbits,
-    ElemType* newResidual)
+template <class ElemType>
+__global__ void UnquantizeStripejOneQWord(ElemType* us, const long M, const long N, const char* qpackage, size_t colsize, size_t numQWordsPerCol, size_t ldNbits, bool add)
 {
+    // this follows the same as  quantizestripej()
     // map our thread index into a linear index
     const size_t linindex = ParallelizeOverRangeIndex();
-
     // map to (QWord index, column index)
     const size_t j = linindex / numQWordsPerCol;
+
     if (j >= N) // out of col range
         return;
 
     const size_t iQWord = linindex % numQWordsPerCol;
 
-    // get data pointers to the quantized column
-    auto& qCol = *(Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qMat[qColSize * j];
+    // get data pointers and quantizer
+    const auto& qcol = *(const Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qpackage[colsize * j];
+    const ElemType lower = qcol.lower;
+    const ElemType upper = qcol.upper;
+    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, lower, upper);
+    // unquantize from this one QWord
+    q.UnquantizeOneQWord(us, M, iQWord, M, numQWordsPerCol, j, qcol.bits[iQWord], add);
+}
 
-    // and quantizer
-    const Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, qCol.lower, qCol.upper);
+#define UNQUANTIZE_SUM_MAX_PACKAGES 64
 
-    // quantize one QWord to qCol[iQWord]
-    qCol.bits[iQWord] = q.QuantizeOneQWord<ZeroThresholdFor1Bit>(us, curResidual, M, iQWord, M, numQWordsPerCol, j, newResidual);
-}
+struct QuantizationPackages
+{
+    const char* p[UNQUANTIZE_SUM_MAX_PACKAGES];
+    size_t num;
+};
 
+// same thread layout as UnquantizeStripejOneQWord(), summing up the QWords of all packages at this position
 template <class ElemType>
-__global__ void UnquantizeStripejOneQWord(ElemType* us, const long M, const long N, const char* qpackage, size_t colsize, size_t numQWordsPerCol, size_t ldNbits, bool add)
+__global__ void UnquantizeAndSumStripejOneQWord(ElemType* us, const long M, const long N, QuantizationPackages packages, size_t colsize, size_t numQWordsPerCol, size_t ldNbits, bool add)
 {
-    // this follows the same as  quantizestripej()
-    // map our thread index into a linear index
     const size_t linindex = ParallelizeOverRangeIndex();
-    // map to (QWord index, column index)
     const size_t j = linindex / numQWordsPerCol;
 
     if (j >= N) // out of col range
@@ -192,13 +204,13 @@ __global__ void UnquantizeStripejOneQWord(ElemType* us, const long M, const long
 
     const size_t iQWord = linindex % numQWordsPerCol;
 
-    // get data pointers and quantizer
-    const auto& qcol = *(const Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qpackage[colsize * j];
-    const ElemType lower = qcol.lower;
-    const ElemType upper = qcol.upper;
-    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, lower, upper);
-    // unquantize from this one QWord
-    q.UnquantizeOneQWord(us, M, iQWord, M, numQWordsPerCol, j, qcol.bits[iQWord], add);
+    // the rows of this QWord belong to this thread only, so they are accumulated in place
+    for (size_t p = 0; p < packages.num; p++)
+    {
+        const auto& qcol = *(const Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &packages.p[p][colsize * j];
+        Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+        q.UnquantizeOneQWord(us, M, iQWord, M, numQWordsPerCol, j, qcol.bits[iQWord], add || p > 0);
+    }
 }
 
 //maybe should move out into another class?
@@ -222,52 +234,27 @@ void _QuantizeMatrix(
         LogicError("quantizestripe: dimension of patch to be quantized does not match residual buffer");
         if (gpubuffer.size() == 0)      // empty buffer: empty matrix, we are done (explicit test needed since launch will fail with 0 threads)
         return;*/
-    // determine mean and variance -> value range (stored in quant package)   --for 1 bit, refine it in a second pass
-    const size_t ldNbits = ValueQuantizer<ElemType>::ld(Nbits);
-
-    size_t nRow = M;
-    size_t nCol = N;
-    dim3 mvgriddim, mvblockdim;
-    // using specialized CUDA code (not shared with CPU) for collated memory access
-    // each thread column computes 'warpsize' elements
-    mvgriddim = (unsigned int) nCol; // column number
-    mvblockdim = REDUCTION_BLOCK_SIZE;
-
-    if (zeroThresholdFor1Bit)
-    {
-        _ComputeQuantiStatParj<ElemType, true><<<mvgriddim, mvblockdim, 0, stream>>>(us, curResidual, M, N, ldNbits, qPackage);
-    }
-    else
-    {
-        _ComputeQuantiStatParj<ElemType, false><<<mvgriddim, mvblockdim, 0, stream>>>(us, curResidual, M, N, ldNbits, qPackage);
-    }
-
-    // quantize data (also computing the residual at once)
+    // quantize data (also computing the residual at once), one column per block, see _QuantizeColumnj()
     // optimizing for collated memory access:
     //  - each 32-bit word represents an interleaved (not consecutive) set of floats -> parallel threads can do collated accesses
     // example:
     //  - total number of 32-bit words(1-bit quant): 1100 * 2048 / 32 = 70k
-    //  - thread x dimension: index into 32-bit word (e.g. 1100/32 = 35 threads)
-    //  - thread y dimension and thread position: column (e.g. 2048)
-    //  - using 128 threads on one proc -> 70k/128 = 550 blocks
-    //  - threads are indexed by a global index into quantized 32-bit words in increasing order; each thread must
-    //     - re-linearize block index and thread index
-    //     - map to (i,j) coordinate (start of the set of floats)
-
-    const size_t numQWordsPerCol = Microsoft::MSR::CNTK::ColumnQuantizer<ElemType>::QWordsPerCol(nRow, Nbits);
-    const size_t totalQWords = nCol * numQWordsPerCol;
-
-    const size_t colsizebyte = Microsoft::MSR::CNTK::QuantizedColumn<ElemType>::QuantizedColumnSize(Nbits, nRow);
+    //  - block: column (e.g. 2048 blocks)
+    //  - thread: index into 32-bit word (e.g. 1100/32 = 35 of the 128 threads busy)
+    if (N == 0)
+        return;
+    const size_t ldNbits = ValueQuantizer<ElemType>::ld(Nbits);
+    const size_t numQWordsPerCol = Microsoft::MSR::CNTK::ColumnQuantizer<ElemType>::QWordsPerCol(M, Nbits);
 
-    dim3 griddim, blockdim;
-    ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
+    dim3 griddim = (unsigned int) N;
+    dim3 blockdim = REDUCTION_BLOCK_SIZE;
     if (zeroThresholdFor1Bit)
     {
-        _QuantizeStripjOneQWord<ElemType, true><<<griddim, blockdim, 0, stream>>>(us, curResidual, M, N, qPackage, colsizebyte, numQWordsPerCol, ldNbits, newResidual);
+        _QuantizeColumnj<ElemType, true><<<griddim, blockdim, 0, stream>>>(us, curResidual, M, N, ldNbits, numQWordsPerCol, qPackage, newResidual);
     }
     else
     {
-        _QuantizeStripjOneQWord<ElemType, false><<<griddim, blockdim, 0, stream>>>(us, curResidual, M, N, qPackage, colsizebyte, numQWordsPerCol, ldNbits, newResidual);
+        _QuantizeColumnj<ElemType, false><<<griddim, blockdim, 0, stream>>>(us, curResidual, M, N, ldNbits, numQWordsPerCol, qPackage, newResidual);
     }
 }
 
@@ -302,6 +289,37 @@ void _UnquantizeMatrix(const char* gpuBuffer, size_t gpuBufferSize,
     ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
     UnquantizeStripejOneQWord<<<griddim, blockdim, 0, stream>>>(us, M, N, gpuBuffer, colsize, numQWordsPerCol, ldNbits, add);
 }
+
+// unquantize and sum up several quantization packages of the same shape (e.g. one from each node) in one pass;
+// the packages may be in mapped page-locked host memory, and each of them is read exactly once
+template <class ElemType>
+void _UnquantizeAndSumMatrices(const std::vector<const char*>& gpuBuffers, size_t gpuBufferSize,
+                               ElemType* us, long M, long N,
+                               size_t nBits, bool add, cudaStream_t stream)
+{
+    size_t qSize = QuantizedColumn<ElemType>::QuantizedColumnSize(nBits, M) * N;
+    if (qSize != gpuBufferSize)
+        LogicError("unquantizeandsum: dimension of patch to be unquantized does not match size of quantized data");
+    if (gpuBufferSize == 0)
+        return;
+
+    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
+    const size_t numQWordsPerCol = ColumnQuantizer<ElemType>::QWordsPerCol(M, nBits);
+    const size_t totalQWords = N * numQWordsPerCol;
+    const size_t colsize = QuantizedColumn<ElemType>::QuantizedColumnSize(nBits, M);
+
+    dim3 griddim, blockdim;
+    ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
+    // (the pointers are passed by value, UNQUANTIZE_SUM_MAX_PACKAGES at a time)
+    for (size_t first = 0; first < gpuBuffers.size(); first += UNQUANTIZE_SUM_MAX_PACKAGES)
+    {
+        QuantizationPackages packages;
+        packages.num = gpuBuffers.size() - first < UNQUANTIZE_SUM_MAX_PACKAGES ? gpuBuffers.size() - first : UNQUANTIZE_SUM_MAX_PACKAGES;
+        for (size_t p = 0; p < packages.num; p++)
+            packages.p[p] = gpuBuffers[first + p];
+        UnquantizeAndSumStripejOneQWord<<<griddim, blockdim, 0, stream>>>(us, M, N, packages, colsize, numQWordsPerCol, ldNbits, add || first > 0);
+    }
+}
 }
 }
 }
@@ -176,6 +176,18 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSRFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                                            const size_t nz, const size_t numRows, const size_t numCols)
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormatAsync(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                            const size_t nz, const size_t numRows, const size_t numCols)
+{
+}
+
 // forward pass from feature to hidden layer
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -190,6 +202,18 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                               const GPUMatrix<ElemType>& rhs, const bool transposeB, GPUSparseMatrix<ElemType>& c)
+{
+}
+
+template <class ElemType>
+GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
+
 // used for gradients udpate
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const GPUSparseMatrix<ElemType>& lhs, GPUMatrix<ElemType>& rhs)
@@ -735,6 +759,9 @@ DeviceBoundNumber<ElemType>::~DeviceBoundNumber()
 template <class ElemType>
 void GPUMatrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId){};
 
+template <class ElemType>
+void GPUMatrix<ElemType>::WaitForAsyncSetValues(DEVICEID_TYPE){};
+
 // GetBestGPUDeviceId - Get the best GPU DeviceId, based on cuda information
 //  TODO: should be replaced by BestGpu class instead, it's much better
 template <class ElemType>
@@ -921,6 +948,30 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddFoldedPositiveAndShiftedNegSample(c
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoDropoutOf(ElemType beta, const GPUMatrix<ElemType>& a, double dropoutRate, unsigned long long seed, size_t counterOffset)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignHashedIndicesOf(const GPUMatrix<ElemType>& ids, size_t numBuckets, size_t numHashes)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType> GPUMatrix<ElemType>::Transpose() const
 {
@@ -1025,6 +1076,52 @@ ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients, ElemType R
     return 0;
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                               ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection1, ElemType biasCorrection2, bool updateValues)
+{
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, const std::vector<MultiTensorUpdateTensor<ElemType>>& tensors, const MultiTensorUpdateParams<ElemType>& params)
+{
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SimpleRNNForward(const GPUMatrix<ElemType>& R, const GPUMatrix<ElemType>& X, const GPUMatrix<ElemType>& hStart, const GPUMatrix<ElemType>& continues,
+                                                      ElemType initialValue, ElementWiseOperator nonlinearity, bool reverse,
+                                                      GPUMatrix<ElemType>& delayed, GPUMatrix<ElemType>& product, GPUMatrix<ElemType>& sum, GPUMatrix<ElemType>& hidden)
+{
+}
+
+template <class ElemType>
+/*static*/ bool GPUMatrix<ElemType>::IsSimpleRNNForwardSupported(size_t hiddenDim)
+{
+    return false;
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion)
+{
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                                                 GPUMatrix<ElemType>& logitsGradient)
+{
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyForward(const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& criterion)
+{
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::IndexedSoftmaxCrossEntropyBackward(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp,
+                                                                        GPUMatrix<ElemType>& logitsGradient)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1497,6 +1594,20 @@ void GPUMatrix<ElemType>::ConductRowElementMultiplyWithShift(const GPUMatrix<Ele
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt)
+{
+    return (*this);
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const bool wrtB, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                                               const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                                               const size_t shift, const size_t nt)
+{
+    return (*this);
+}
+
 template <class ElemType>
 DeviceBoundNumber<ElemType> GPUMatrix<ElemType>::Sum_AsDeviceBoundNum() const
 {
@@ -1764,6 +1875,13 @@ template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiplyAndWeightedAddStridedBatched(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, size_t strideA,
+                                                               const GPUMatrix<ElemType>& /*b*/, const bool transposeB, size_t strideB,
+                                                               ElemType beta, GPUMatrix<ElemType>& c, size_t strideC,
+                                                               size_t m, size_t n, size_t k, size_t batchCount)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndAdd(const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB, GPUMatrix<ElemType>& c)
@@ -1988,6 +2106,12 @@ ElemType GPUMatrix<ElemType>::LogAddSumOfElements() const
     return ElemType(0);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardCompute(GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::RCRFBackwardCompute(
     const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
@@ -2056,6 +2180,11 @@ void MatrixQuantizerGPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& in
 {
 }
 
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeAndAccumulateAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix)
+{
+}
+
 template <class ElemType>
 void MatrixQuantizerGPU<ElemType>::WaitUnquantizeAsyncDone()
 {
@@ -2115,6 +2244,33 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
 {
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::CopyCPUToGPUAsyncForCompute(ElemType*, size_t, ElemType*)
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::BeginCopyCPUToGPUAsyncForCompute()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::CopyBytesCPUToGPUAsync(const void*, size_t, void*)
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::EndCopyCPUToGPUAsyncForCompute()
+{
+}
+
+template <class ElemType>
+/*static*/ GPUDataTransferer<ElemType>& GPUDataTransferer<ElemType>::GetAsyncSetValueTransferer(int)
+{
+    static GPUDataTransferer<ElemType> dummy(-1, false);
+    return dummy;
+}
+
 #pragma endregion GPUDataTransferer functions
 
 template class GPUMatrix<char>;
@@ -2137,27 +2293,27 @@ template <class ElemType>
 void* GPUMatrix<ElemType>::s_curandGenerator = NULL;
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t, size_t, size_t, size_t)
+typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled with CPUONLY macro.");
 }
 
 template <class ElemType>
-typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t, size_t, size_t, size_t)
+typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngineFactory<ElemType>::CreateFilter(size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled without CPUONLY macro.");
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D&, const Filter&, size_t, size_t, bool)
+    const Tensor4D&, const Filter&, size_t, size_t, bool, size_t)
 {
     RuntimeError("The code is compiled without CPUONLY macro.");
 }
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::PoolDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreatePoolDescriptor(
-    typename PoolDesc::PoolKind, size_t, size_t, size_t, size_t, size_t, size_t)
+    typename PoolDesc::PoolKind, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t)
 {
     RuntimeError("The code is compiled without CPUONLY macro.");
 }
@@ -2199,7 +2355,21 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int /*devId*/)
     return 0;
 }
 
+void GPUWatcher::StartSampling(int /*deviceId*/, double /*intervalSeconds*/)
+{
+}
+
+void GPUWatcher::StopSampling()
+{
+}
+
+GPUActivity GPUWatcher::GetActivity() const
+{
+    return GPUActivity();
+}
+
 GPUWatcher::GPUWatcher(void)
+    : m_sampler(nullptr)
 {
 }
 
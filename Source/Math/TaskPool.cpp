@@ -0,0 +1,236 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TaskPool.cpp -- the worker threads that the whole process shares for CPU tasks
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "TaskPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct TaskPoolWorker
+{
+    std::mutex m_mutex;
+    std::deque<std::function<void()>> m_tasks;
+};
+
+// (never destroyed: joining the threads while the DLL is unloaded would deadlock)
+struct TaskPoolState
+{
+    static const size_t maxWorkers = 1024;
+    TaskPoolWorker* m_workers[maxWorkers]; // only grows, so that stealing needs no lock; the first m_numActive take tasks
+    std::atomic<size_t> m_numWorkers;
+    std::atomic<size_t> m_numActive;
+    std::atomic<ptrdiff_t> m_numQueued; // (briefly -1 if a task is taken before Push() counts it)
+    std::atomic<size_t> m_nextWorker;   // round robin for tasks from other threads
+    std::mutex m_mutex;                 // for growing, and for waiting
+    std::condition_variable m_workAvailable;
+
+    TaskPoolState()
+        : m_numWorkers(0), m_numActive(0), m_numQueued(0), m_nextWorker(0)
+    {
+    }
+};
+
+static std::once_flag s_initOnce;
+static TaskPoolState* s_state = nullptr;
+
+// the index of the current thread's worker, or SIZE_MAX if it is not one
+#ifdef _WIN32
+__declspec(thread)
+#else
+__thread
+#endif
+    size_t t_workerIndex = SIZE_MAX;
+
+static bool TakeTask(TaskPoolState& state, size_t index, std::function<void()>& task)
+{
+    // the latest of our own
+    {
+        TaskPoolWorker& self = *state.m_workers[index];
+        std::lock_guard<std::mutex> lock(self.m_mutex);
+        if (!self.m_tasks.empty())
+        {
+            task = std::move(self.m_tasks.back());
+            self.m_tasks.pop_back();
+            state.m_numQueued--;
+            return true;
+        }
+    }
+    // else the oldest of another worker's, including those that are no longer active
+    const size_t numWorkers = state.m_numWorkers;
+    for (size_t k = 1; k < numWorkers; k++)
+    {
+        TaskPoolWorker& victim = *state.m_workers[(index + k) % numWorkers];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if (!victim.m_tasks.empty())
+        {
+            task = std::move(victim.m_tasks.front());
+            victim.m_tasks.pop_front();
+            state.m_numQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void RunWorker(TaskPoolState& state, size_t index)
+{
+    t_workerIndex = index;
+    omp_set_num_threads(1); // the pool's threads already take up the core budget
+    for (;;)
+    {
+        std::function<void()> task;
+        if (index < state.m_numActive && TakeTask(state, index, task))
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state.m_mutex);
+        state.m_workAvailable.wait(lock, [&state, index]()
+                                   {
+                                       return index < state.m_numActive && state.m_numQueued > 0;
+                                   });
+    }
+}
+
+static TaskPoolState& State()
+{
+    std::call_once(s_initOnce, []()
+                   {
+                       s_state = new TaskPoolState();
+                   });
+    if (s_state->m_numActive == 0) // (not set yet)
+        TaskPool::SetNumThreads(0);
+    return *s_state;
+}
+
+/*static*/ void TaskPool::SetNumThreads(size_t numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max((size_t) std::thread::hardware_concurrency(), (size_t) 1);
+    numThreads = std::min(numThreads, TaskPoolState::maxWorkers);
+    std::call_once(s_initOnce, []()
+                   {
+                       s_state = new TaskPoolState();
+                   });
+    TaskPoolState& state = *s_state;
+    {
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        while (state.m_numWorkers < numThreads)
+        {
+            size_t index = state.m_numWorkers;
+            state.m_workers[index] = new TaskPoolWorker();
+            state.m_numWorkers++;
+            std::thread([&state, index]()
+                        {
+                            RunWorker(state, index);
+                        }).detach();
+        }
+        state.m_numActive = numThreads;
+    }
+    state.m_workAvailable.notify_all(); // more workers may take tasks now
+}
+
+/*static*/ size_t TaskPool::GetNumThreads()
+{
+    return State().m_numActive;
+}
+
+/*static*/ void TaskPool::Push(std::function<void()>&& task)
+{
+    TaskPoolState& state = State();
+    const size_t numActive = state.m_numActive;
+    size_t index = t_workerIndex;
+    if (index >= numActive)
+        index = state.m_nextWorker++ % numActive;
+    {
+        TaskPoolWorker& worker = *state.m_workers[index];
+        std::lock_guard<std::mutex> lock(worker.m_mutex);
+        worker.m_tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(state.m_mutex); // (so that no worker misses it between its check and its wait)
+        state.m_numQueued++;
+    }
+    // any worker may steal it, but the sleeping ones wait on the same condition, whether active or not
+    state.m_workAvailable.notify_all();
+}
+
+// the helpers join only while indices are left, so the caller never waits for one that has not started
+struct ParallelForState
+{
+    std::atomic<size_t> m_next;
+    size_t m_end;
+    const std::function<void(size_t)>* m_body;
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    size_t m_numRunning;
+    std::exception_ptr m_error;
+
+    void Run()
+    {
+        try
+        {
+            for (size_t i = m_next++; i < m_end; i = m_next++)
+                (*m_body)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+                m_error = std::current_exception();
+            m_next = m_end; // skip the rest
+        }
+    }
+};
+
+/*static*/ void TaskPool::ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body)
+{
+    if (end <= begin)
+        return;
+    auto state = std::make_shared<ParallelForState>();
+    state->m_next = begin;
+    state->m_end = end;
+    state->m_body = &body;
+    state->m_numRunning = 0;
+
+    const size_t numHelpers = std::min(GetNumThreads(), end - begin) - 1;
+    for (size_t k = 0; k < numHelpers; k++)
+        Push([state]()
+             {
+                 {
+                     std::lock_guard<std::mutex> lock(state->m_mutex);
+                     if (state->m_next >= state->m_end) // (the caller may have returned)
+                         return;
+                     state->m_numRunning++;
+                 }
+                 state->Run();
+                 {
+                     std::lock_guard<std::mutex> lock(state->m_mutex);
+                     state->m_numRunning--;
+                 }
+                 state->m_done.notify_all();
+             });
+
+    state->Run();
+    std::unique_lock<std::mutex> lock(state->m_mutex);
+    state->m_done.wait(lock, [&state]()
+                       {
+                           return state->m_numRunning == 0;
+                       });
+    if (state->m_error)
+        std::rethrow_exception(state->m_error);
+}
+} } }
@@ -0,0 +1,54 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TaskPool.h -- the worker threads that the whole process shares for CPU tasks (readers, lattice processing, ...)
+//
+// One pool instead of threads per component, so that the components together do not oversubscribe the cores. Its size
+// is the core budget 'numCPUThreads' (CPUMatrix::SetNumThreads() sets it, together with the size of the OpenMP team),
+// hardware_concurrency() until then. Each worker has a deque of its own: a task submitted by a worker goes to the back of
+// its deque, which the worker takes from first, latest first; an idle worker steals the oldest task of another one.
+// Tasks from other threads are dealt to the workers round robin. OpenMP regions inside a task run on the task's thread
+// only, since the pool's threads already take up the budget.
+//
+// A task must not wait for a task it submitted with Submit() (all workers might be waiting); ParallelFor() may be
+// nested, since its caller runs the loop, too.
+//
+
+#pragma once
+
+#include "MemAllocator.h" // for MATH_API
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API TaskPool
+{
+public:
+    // the number of workers that take tasks; 0 for hardware_concurrency()
+    static void SetNumThreads(size_t numThreads);
+    static size_t GetNumThreads();
+
+    // run 'work' on a worker; the future returns its result, or rethrows its exception
+    template <class ResultType>
+    static std::future<ResultType> Submit(const std::function<ResultType()>& work)
+    {
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(work);
+        auto result = task->get_future();
+        Push([task]()
+             {
+                 (*task)(); // (exceptions go to the future)
+             });
+        return result;
+    }
+
+    // run body(i) for all i in [begin, end), on the calling thread and up to GetNumThreads() - 1 workers; rethrows the
+    // first exception, after which the remaining indices are skipped
+    static void ParallelFor(size_t begin, size_t end, const std::function<void(size_t)>& body);
+
+private:
+    static void Push(std::function<void()>&& task);
+};
+} } }
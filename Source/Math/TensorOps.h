@@ -83,6 +83,40 @@ DECL ElemType Sigmoid(ElemType z)
 #endif
 }
 
+// counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011)
+// The result is a function of (seed, counter) only, so e.g. a dropout mask can be computed again where it is needed
+// instead of being stored, and each element can compute its own without any generator state.
+DECL float PhiloxUniform(unsigned long long seed, unsigned long long counter) // uniformly distributed in [0, 1)
+{
+    unsigned int c0 = (unsigned int) counter, c1 = (unsigned int) (counter >> 32), c2 = 0, c3 = 0;
+    unsigned int k0 = (unsigned int) seed, k1 = (unsigned int) (seed >> 32);
+    for (int round = 0; round < 10; round++)
+    {
+        unsigned long long p0 = 0xD2511F53ull * c0;
+        unsigned long long p1 = 0xCD9E8D57ull * c2;
+        c0 = (unsigned int) (p1 >> 32) ^ c1 ^ k0;
+        c1 = (unsigned int) p1;
+        c2 = (unsigned int) (p0 >> 32) ^ c3 ^ k1;
+        c3 = (unsigned int) p0;
+        k0 += 0x9E3779B9; // (Weyl sequence for the round keys)
+        k1 += 0xBB67AE85;
+    }
+    return (c0 >> 8) * (1.0f / 16777216.0f); // 24 bits, exact in float
+}
+
+// feature hashing: a well-mixed 32-bit hash of an id, e.g. to map a huge sparse vocabulary onto a fixed number of
+// embedding columns; different seeds give independent hash functions (finalizer of MurmurHash3, Appleby 2011)
+DECL unsigned int FeatureHash(unsigned long long id, unsigned int seed)
+{
+    unsigned long long h = id ^ (seed * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return (unsigned int) h;
+}
+
 template <class ElemType>
 DECL ElemType SigmoidDerivative(ElemType z)
 {
@@ -226,6 +260,9 @@ DefBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput, a*(1 - b * b));
 DefBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, b > 0 ? a : 0);
 DefBinaryOp(ElementwiseProductWithLogDerivativeFromOutput, a* exp_(-b));
 DefBinaryOp(ElementwiseProductWithCosDerivative, a * -sin_(b)); // note: b = input for cos()
+DefBinaryOp(SigmoidOfSum, Sigmoid(a + b));
+DefBinaryOp(TanhOfSum, tanh_(a + b));
+DefBinaryOp(LinearRectifierOfSum, a + b > 0 ? a + b : 0);
 //DefBinaryOp(Index, IndexElement(a, b, i));  // note: this one uses the third argument
 
 #pragma pop_macro("DefBinaryOp")
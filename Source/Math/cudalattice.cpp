@@ -13,6 +13,7 @@
 #include "cudalib.h"        // generic CUDA helpers
 #include "cudadevice.h"
 #include <math.h>
+#include <algorithm>
 #include <memory> // for auto_ptr
 #include <assert.h>
 #include <float.h>
@@ -30,15 +31,29 @@ class vectorbaseimpl : public /*interface*/ VECTORTYPE, // user-type interface;
 {
     typedef typename VECTORTYPE::elemtype elemtype; // (for convenience)
     size_t capacity;                                // amount of allocated storage (like capacity() vs. vectorref::n = size())
+    // asynchronous assign() goes through a page-locked staging buffer; 'uploaded' marks the end of the last upload
+    elemtype *staging;
+    size_t stagingcapacity;
+    void *uploaded;
     void release()
     {
         ondevice no(deviceid);
+        if (uploaded)
+        {
+            waitevent(uploaded);
+            deleteevent(uploaded);
+            uploaded = NULL;
+        }
+        if (staging)
+            freehostbytes(staging);
+        staging = NULL;
+        stagingcapacity = 0;
         free(this->reset(NULL, 0));
     }
 
 public:
     vectorbaseimpl(size_t deviceid)
-        : capacity(0), objectondevice(deviceid)
+        : capacity(0), staging(NULL), stagingcapacity(0), uploaded(NULL), objectondevice(deviceid)
     {
     }
     ~vectorbaseimpl()
@@ -49,11 +64,12 @@ public:
     {
         if (sz > capacity) // need to grow
         {
-            ondevice no(deviceid);                          // switch to desired CUDA card
-            cuda_ptr<elemtype> pnew = malloc<elemtype>(sz); // allocate memory inside CUDA device (or throw)
-            capacity = sz;                                  // if succeeded then: remember
-            cuda_ptr<elemtype> p = this->reset(pnew, sz);   //  and swap the pointers and update n
-            free(p);                                        //  then release the old one
+            ondevice no(deviceid);                                      // switch to desired CUDA card
+            size_t newcapacity = std::max(sz, capacity + capacity / 2); // grow geometrically, so that lattices that get a little larger each time do not reallocate each time
+            cuda_ptr<elemtype> pnew = malloc<elemtype>(newcapacity);    // allocate memory inside CUDA device (or throw)
+            capacity = newcapacity;                                     // if succeeded then: remember
+            cuda_ptr<elemtype> p = this->reset(pnew, sz);               //  and swap the pointers and update n
+            free(p);                                                    //  then release the old one
         }
         else // not growing: keep same allocation
             this->reset(this->get(), sz);
@@ -66,7 +82,28 @@ public:
     {
         allocate(nelem);       // assign will resize the target appropriately
         ondevice no(deviceid); // switch to desired CUDA card
-        if (nelem > 0)
+        if (nelem > 0 && !synchronize)
+        {
+            // copy to the staging buffer and upload from there, so that we need not wait for the work queued before
+            // (e.g. the acoustic model's forward pass), and the caller may reuse 'p' right away
+            if (uploaded)
+                waitevent(uploaded); // previous upload from the staging buffer done
+            else
+                uploaded = newevent();
+            if (nelem > stagingcapacity) // (grows with the device buffer)
+            {
+                if (staging)
+                    freehostbytes(staging);
+                staging = NULL;
+                stagingcapacity = 0;
+                staging = (elemtype *) mallochostbytes(capacity * sizeof(elemtype));
+                stagingcapacity = capacity;
+            }
+            ::memcpy(staging, p, nelem * sizeof(elemtype));
+            memcpyh2dasync(this->get().get(), 0, staging, nelem * sizeof(elemtype));
+            recordevent(uploaded);
+        }
+        else if (nelem > 0)
             memcpy(this->get(), 0, p, nelem);
         if (synchronize)
             join();
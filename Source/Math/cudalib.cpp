@@ -10,6 +10,7 @@
 #include <cuda.h>             // for device API
 #include "cudalib.h"
 #include "cudadevice.h"
+#include "CUDADeviceCachingAllocator.h"
 #include <string>
 #include <assert.h>
 #include <cublas_v2.h>
@@ -50,29 +51,36 @@ static int curStack = 0;
 static size_t deviceStack[stackSize] = {0};
 
 // memory allocation
+// Device buffers come from the device's caching allocator: the lattice vectors are reallocated as the lattice sizes vary
+// from utterance to utterance, and cudaFree() would synchronize the device each time. (The allocator releases its cache
+// and retries when cudaMalloc() fails.)
+static Microsoft::MSR::CNTK::CUDADeviceCachingAllocator &currentdeviceallocator()
+{
+    int deviceid;
+    cudaGetDevice(&deviceid) || "cudaGetDevice failed";
+    return Microsoft::MSR::CNTK::CUDADeviceCachingAllocator::ForDevice(deviceid);
+}
+
 void *mallocbytes(size_t nelem, size_t sz)
 {
-    for (size_t retry = 0;; retry++)
-    {
-        try
-        {
-            // fprintf (stderr, "mallocbytes: allocating %d elements of size %d, %d bytes\n", (int) nelem, (int) sz, (int) (nelem * sz));        // comment out by [v-hansu] to get rid out annoying output
-            void *p;
-            cudaMalloc(&p, nelem * sz) || "cudaMalloc failed";
-            return p;
-        }
-        catch (const std::exception &e)
-        {
-            fprintf(stderr, "mallocbytes: failed with error %s\n", e.what());
-            if (retry >= 5)
-                throw;
-        }
-    }
+    return currentdeviceallocator().Malloc(nelem * sz);
 }
 
 void freebytes(void *p)
 {
-    cudaFree(p) || "cudaFree failed";
+    currentdeviceallocator().Free(p);
+}
+
+void *mallochostbytes(size_t nbytes)
+{
+    void *p;
+    cudaHostAlloc(&p, nbytes, cudaHostAllocDefault) || "cudaHostAlloc failed";
+    return p;
+}
+
+void freehostbytes(void *p)
+{
+    cudaFreeHost(p) || "cudaFreeHost failed";
 }
 
 void memcpyh2d(void *dst, size_t byteoffset, const void *src, size_t nbytes)
@@ -84,5 +92,32 @@ void memcpyd2h(void *dst, const void *src, size_t byteoffset, size_t nbytes)
 {
     cudaMemcpy(dst, byteoffset + (const char *) src, nbytes, cudaMemcpyDeviceToHost) || "cudaMemcpy failed";
 }
+
+void memcpyh2dasync(void *dst, size_t byteoffset, const void *src, size_t nbytes)
+{
+    cudaMemcpyAsync(byteoffset + (char *) dst, src, nbytes, cudaMemcpyHostToDevice, GetCurrentStream()) || "cudaMemcpyAsync failed";
+}
+
+void *newevent()
+{
+    cudaEvent_t ev;
+    cudaEventCreateWithFlags(&ev, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    return ev;
+}
+
+void recordevent(void *ev)
+{
+    cudaEventRecord((cudaEvent_t) ev, GetCurrentStream()) || "cudaEventRecord failed";
+}
+
+void waitevent(void *ev)
+{
+    cudaEventSynchronize((cudaEvent_t) ev) || "cudaEventSynchronize failed";
+}
+
+void deleteevent(void *ev)
+{
+    cudaEventDestroy((cudaEvent_t) ev) || "cudaEventDestroy failed";
+}
 };
 };
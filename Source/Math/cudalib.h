@@ -31,6 +31,16 @@ void free(cuda_ptr<T> p)
 
 void memcpyh2d(void *dst, size_t byteoffset, const void *src, size_t nbytes);
 void memcpyd2h(void *dst, const void *src, size_t byteoffset, size_t nbytes);
+
+// asynchronous uploads: the source must be page-locked and must not change until the copy is done, which an event
+// recorded after it tells
+void *mallochostbytes(size_t nbytes); // page-locked
+void freehostbytes(void *p);
+void memcpyh2dasync(void *dst, size_t byteoffset, const void *src, size_t nbytes); // on the current stream
+void *newevent();
+void recordevent(void *ev); // marks the work queued on the current stream so far
+void waitevent(void *ev);   // until that work is done
+void deleteevent(void *ev);
 template <typename T>
 void memcpy(cuda_ptr<T> dst, size_t dstoffset, const T *src, size_t nelem)
 {
@@ -9,6 +9,7 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "BinaryReader.h"
+#include <future>
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
@@ -27,20 +28,77 @@ void BinaryReader<ElemType>::Destroy()
 // sectionRoot - section whose children we will enumrate
 // NOTE: called recursively to obtain full section heirarchy
 template <class ElemType>
-void BinaryReader<ElemType>::LoadSections(Section* sectionRoot, MappingType mapping, size_t windowSize)
+void BinaryReader<ElemType>::LoadSections(Section* sectionRoot, MappingType mapping, size_t windowSize, std::map<std::wstring, Section*, nocase_compare>& sections)
 {
     int sectionCount = sectionRoot->GetSectionCount();
     for (int i = 0; i < sectionCount; ++i)
     {
         Section* newSection = sectionRoot->ReadSection(i, mapping, windowSize);
-        auto found = m_sections.find(newSection->GetName());
-        if (found != m_sections.end())
+        auto found = sections.find(newSection->GetName());
+        if (found != sections.end())
         {
             RuntimeError("LoadSections, duplicate section name %ls already defined previously", newSection->GetName().c_str());
         }
-        m_sections[newSection->GetName()] = newSection;
+        sections[newSection->GetName()] = newSection;
         // load in any subsections
-        LoadSections(newSection, mapping, windowSize);
+        LoadSections(newSection, mapping, windowSize, sections);
+    }
+}
+
+// ReadShardIndex - read the index of a sharded file (see shardIndexMagic)
+// path - file given in the config
+// shards - [out] number of records and path of each shard
+// returns - false if the file is not an index
+template <class ElemType>
+bool BinaryReader<ElemType>::ReadShardIndex(const std::wstring& path, vector<std::pair<size_t, std::wstring>>& shards)
+{
+    FILE* f = _wfopen(path.c_str(), L"rb");
+    if (f == nullptr)
+        return false; // (opening it as a section file reports the error)
+    std::string magic(strlen(shardIndexMagic), '\0');
+    bool isIndex = fread(&magic[0], 1, magic.size(), f) == magic.size() && magic == shardIndexMagic;
+    fclose(f);
+    if (!isIndex)
+        return false;
+
+    vector<std::wstring> lines;
+    File(path, fileOptionsRead | fileOptionsText).GetLines(lines);
+    for (size_t i = 1; i < lines.size(); i++)
+    {
+        if (lines[i].empty())
+            continue;
+        size_t pos = lines[i].find(L' ');
+        if (pos == std::wstring::npos)
+            RuntimeError("BinaryReader: Malformed line '%ls' in shard index %ls.", lines[i].c_str(), path.c_str());
+        shards.push_back(make_pair((size_t) std::stoull(lines[i].substr(0, pos)), lines[i].substr(pos + 1)));
+    }
+    if (shards.empty())
+        RuntimeError("BinaryReader: Shard index %ls lists no shards.", path.c_str());
+    return true;
+}
+
+// InitShardBlocks - lay out the order of the records in a sweep: the first block of each shard, then the second, ...
+// blockSize - records per block
+template <class ElemType>
+void BinaryReader<ElemType>::InitShardBlocks(size_t blockSize)
+{
+    m_blocks.clear();
+    m_blockStarts.clear();
+    if (m_shards.size() == 1) // a single shard is read in order
+        blockSize = m_totalSamples;
+    blockSize = max(blockSize, (size_t) 1);
+    size_t blockStart = 0;
+    for (size_t firstRecord = 0; blockStart < m_totalSamples; firstRecord += blockSize)
+    {
+        for (size_t k = 0; k < m_shards.size(); k++)
+        {
+            if (firstRecord >= m_shards[k].numRecords)
+                continue;
+            ShardBlock block = {k, firstRecord, min(blockSize, m_shards[k].numRecords - firstRecord)};
+            m_blocks.push_back(block);
+            m_blockStarts.push_back(blockStart);
+            blockStart += block.numRecords;
+        }
     }
 }
 
@@ -56,6 +114,9 @@ void BinaryReader<ElemType>::LoadSections(Section* sectionRoot, MappingType mapp
 //    c:\speech\mnist\mnist_features.bin
 //      c:\speech\mnist\mnist_labels.bin
 //  }
+//  # for sharded files (see BinaryWriter's wshards), a minibatch is read from all shards in parallel,
+//  # taking this many consecutive records of a shard at a time
+//  shardBlockSize=256
 //]
 
 static vector<wstring> GetCommaSeparatedItems(const ConfigParameters& config, wstring key)
@@ -95,29 +156,48 @@ void BinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
     }
     else
     {
+        // each file is either a plain file or the index of a sharded file; shard k of the dataset consists of shard k of each file
         for (int i = 0; i < files.size(); ++i)
         {
-            SectionFile* secFile = new SectionFile(files[i], fileOptionsRead, 0);
-            size_t records = secFile->FileSection()->GetRecordCount();
-
-            // if we haven't set the total records yet, set it
-            SectionFlags flags = secFile->FileSection()->GetFlags();
-            if (m_totalSamples == 0 && !(flags & flagAuxilarySection))
-            {
-                m_totalSamples = records;
-            }
-            else // otherwise we want to check to make sure it's the same
+            vector<std::pair<size_t, std::wstring>> shardFiles;
+            if (!ReadShardIndex(files[i], shardFiles))
+                shardFiles.push_back(make_pair(SIZE_MAX, files[i]));
+            if (i == 0)
+                m_shards.resize(shardFiles.size());
+            else if (shardFiles.size() != m_shards.size())
+                RuntimeError("BinaryReader: %ls has %d shards, but %ls has %d.", files[i].c_str(), (int) shardFiles.size(), files[0].c_str(), (int) m_shards.size());
+
+            for (size_t k = 0; k < shardFiles.size(); k++)
             {
-                if (records != m_totalSamples && !(flags & flagAuxilarySection))
-                    RuntimeError("multiple files have different record counts, cannot be used together!");
-            }
+                SectionFile* secFile = new SectionFile(shardFiles[k].second, fileOptionsRead, 0);
+                size_t records = secFile->FileSection()->GetRecordCount();
+                if (shardFiles[k].first != SIZE_MAX && shardFiles[k].first != records)
+                    RuntimeError("BinaryReader: Shard %ls has %d records, but its index says %d.", shardFiles[k].second.c_str(), (int) records, (int) shardFiles[k].first);
+
+                // if we haven't set the total records yet, set it
+                SectionFlags flags = secFile->FileSection()->GetFlags();
+                if (m_shards[k].numRecords == 0 && !(flags & flagAuxilarySection))
+                {
+                    m_shards[k].numRecords = records;
+                }
+                else // otherwise we want to check to make sure it's the same
+                {
+                    if (records != m_shards[k].numRecords && !(flags & flagAuxilarySection))
+                        RuntimeError("multiple files have different record counts, cannot be used together!");
+                }
 
-            m_secFiles.push_back(secFile);
+                m_secFiles.push_back(secFile);
 
-            // now get all the sections out of the file
-            Section* section = secFile->FileSection();
-            LoadSections(section, mapping, windowSize);
+                // now get all the sections out of the file
+                Section* section = secFile->FileSection();
+                LoadSections(section, mapping, windowSize, m_shards[k].sections);
+            }
         }
+        for (const auto& shard : m_shards)
+            m_totalSamples += shard.numRecords;
+        if (!m_shards.empty())
+            m_sections = m_shards[0].sections;
+        InitShardBlocks(readerConfig(L"shardBlockSize", (size_t) 256));
     }
     // initialize all the variables
     m_mbStartSample = m_epoch = m_epochStartSample = 0;
@@ -193,6 +273,17 @@ BinaryReader<ElemType>::~BinaryReader()
 template <class ElemType>
 void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
 {
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+// StartDistributedMinibatchLoop - as StartMinibatchLoop(), but each GetMinibatch() returns only this worker's share of the minibatch
+// subsetNum - [in] this worker's rank
+// numSubsets - [in] number of workers
+template <class ElemType>
+void BinaryReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+{
+    m_subsetNum = subsetNum;
+    m_numSubsets = numSubsets;
     m_mbSize = mbSize;
     if (requestedEpochSamples == requestDataSize)
     {
@@ -208,10 +299,10 @@ void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, siz
 }
 
 // CheckEndDataset - Check to see if we have arrived at the end of the dataset
-// actualmbsize - [in] the actual size of the dataset we are requesting,
+// actualmbsize - [in] the actual size of the dataset we are requesting, [out] reduced at the end of the epoch or dataset
 // returns - true if there we hit dataset end, false otherwise
 template <class ElemType>
-bool BinaryReader<ElemType>::CheckEndDataset(size_t actualmbsize)
+bool BinaryReader<ElemType>::CheckEndDataset(size_t& actualmbsize)
 {
     size_t epochEnd = m_epochSize;
     size_t epochSample = m_mbStartSample % m_epochSize;
@@ -264,67 +355,67 @@ bool BinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType
     if (endOfDataset)
         return false;
 
+    // this worker's share of the minibatch
+    size_t firstRecord = epochStartSample + actualmbsize * m_subsetNum / m_numSubsets;
+    size_t numRecords = epochStartSample + actualmbsize * (m_subsetNum + 1) / m_numSubsets - firstRecord;
+    size_t firstBlock = std::upper_bound(m_blockStarts.begin(), m_blockStarts.end(), firstRecord) - m_blockStarts.begin() - 1;
+
     for (auto value : matrices)
     {
         wstring matrixName = value.first;
-        Section* section = m_sections[matrixName];
         Matrix<ElemType>* gpuData = value.second;
-        size_t rows = section->GetElementsPerRecord();
-        SectionData dataType;
-        size_t dataSize;
-        section->GetDataTypeSize(dataType, dataSize);
+        size_t rows;
+        GetRecordSection(m_sections[matrixName], rows);
 
-        // if the data types are not as expected
-        if (dataType != sectionDataFloat || dataSize != sizeof(ElemType))
+        // the data of 'n' records of a block, from the mapped file
+        auto getRecords = [&](const ShardBlock& block, size_t offset, size_t n) -> ElemType*
         {
-            // if it's a label type, may need to get a subsection
-            if (section->GetSectionType() == sectionTypeLabel)
+            size_t shardRows;
+            Section* section = GetRecordSection(m_shards[block.shard].sections[matrixName], shardRows);
+            ElemType* data = (ElemType*) section->EnsureElements((block.firstRecord + offset) * shardRows, shardRows * sizeof(ElemType) * n);
+            // make sure that the data is as expected
+            if (!!(section->GetFlags() & flagAuxilarySection) || section->GetElementSize() != sizeof(ElemType))
             {
-                bool categoryLabelFound = false;
-                SectionLabel* sectionLabel = (SectionLabel*) section;
-                // category type, check to see if we saved it
-                if (sectionLabel->GetLabelKind() == labelCategory)
-                {
-                    Section* sectionCategory = NULL;
-                    for (int i = 0; i < section->GetSectionCount(); ++i)
-                    {
-                        sectionCategory = section->ReadSection(i);
-
-                        // found the category labels, so pass them on
-                        if (sectionCategory->GetSectionType() == sectionTypeCategoryLabel)
-                        {
-                            section = sectionCategory;
-                            rows = section->GetElementsPerRecord();
-                            section->GetDataTypeSize(dataType, dataSize);
-                            categoryLabelFound = true;
-                            break;
-                        }
-                    }
-                    if (!categoryLabelFound)
-                    {
-                        RuntimeError("Category Labels not saved in file, either save, or support creation in BinaryReader");
-                    }
-                }
+                RuntimeError("GetMinibatch: Section %ls Auxilary section specified, and/or element size %lld mismatch", section->GetName().c_str(), section->GetElementSize());
             }
+            return data;
+        };
 
-            // make sure we are good now
-            if (dataType != sectionDataFloat || dataSize != sizeof(ElemType))
-            {
-                RuntimeError("Category Labels not saved in file, either save, or support creation in BinaryReader");
-            }
+        if (numRecords == 0) // (more workers than records)
+        {
+            gpuData->Resize(rows, 0);
+            continue;
         }
-        size_t size = rows * dataSize * actualmbsize;
-        size_t index = epochStartSample * section->GetElementsPerRecord();
-        ElemType* data = (ElemType*) section->EnsureElements(index, size);
-        // ElemType* data = section->GetElement<ElemType>(epochStartSample*section->GetElementsPerRecord());
-        // data = (ElemType*)section->EnsureMapped(data, size);
-
-        // make sure that the data is as expected
-        if (!!(section->GetFlags() & flagAuxilarySection) || section->GetElementSize() != sizeof(ElemType))
+        size_t offset = firstRecord - m_blockStarts[firstBlock];
+        if (offset + numRecords <= m_blocks[firstBlock].numRecords) // all in one block: take it from the mapped file directly
         {
-            RuntimeError("GetMinibatch: Section %ls Auxilary section specified, and/or element size %lld mismatch", section->GetName().c_str(), section->GetElementSize());
+            gpuData->SetValue(rows, numRecords, gpuData->GetDeviceId(), getRecords(m_blocks[firstBlock], offset, numRecords));
+            continue;
         }
-        gpuData->SetValue(rows, actualmbsize, gpuData->GetDeviceId(), data);
+
+        // spans blocks: gather them in the buffer, one thread per shard
+        m_buffer.resize(rows * numRecords);
+        std::map<size_t, std::vector<size_t>> shardBlocks; // [shard] -> blocks to copy
+        for (size_t i = firstBlock; i < m_blocks.size() && m_blockStarts[i] < firstRecord + numRecords; i++)
+            shardBlocks[m_blocks[i].shard].push_back(i);
+        std::vector<std::future<void>> copies;
+        for (auto& pair : shardBlocks)
+        {
+            std::vector<size_t> blocks = pair.second;
+            copies.push_back(std::async(std::launch::async, [&, blocks]()
+                                        {
+                                            for (size_t i : blocks)
+                                            {
+                                                size_t begin = max(firstRecord, m_blockStarts[i]);
+                                                size_t end = min(firstRecord + numRecords, m_blockStarts[i] + m_blocks[i].numRecords);
+                                                const ElemType* data = getRecords(m_blocks[i], begin - m_blockStarts[i], end - begin);
+                                                std::copy(data, data + (end - begin) * rows, m_buffer.begin() + (begin - firstRecord) * rows);
+                                            }
+                                        }));
+        }
+        for (auto& copy : copies)
+            copy.get();
+        gpuData->SetValue(rows, numRecords, gpuData->GetDeviceId(), m_buffer.data());
     }
 
     // advance to the next minibatch
@@ -334,6 +425,59 @@ bool BinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType
     return true;
 }
 
+// GetRecordSection - Get the section that holds an input's records as ElemType values
+// section - [in] the input's section; for category labels, their category label subsection is returned
+// rows - [out] the number of values per record
+template <class ElemType>
+Section* BinaryReader<ElemType>::GetRecordSection(Section* section, size_t& rows)
+{
+    rows = section->GetElementsPerRecord();
+    SectionData dataType;
+    size_t dataSize;
+    section->GetDataTypeSize(dataType, dataSize);
+
+    // if the data types are not as expected
+    if (dataType != sectionDataFloat || dataSize != sizeof(ElemType))
+    {
+        // if it's a label type, may need to get a subsection
+        if (section->GetSectionType() == sectionTypeLabel)
+        {
+            bool categoryLabelFound = false;
+            SectionLabel* sectionLabel = (SectionLabel*) section;
+            // category type, check to see if we saved it
+            if (sectionLabel->GetLabelKind() == labelCategory)
+            {
+                Section* sectionCategory = NULL;
+                for (int i = 0; i < section->GetSectionCount(); ++i)
+                {
+                    sectionCategory = section->ReadSection(i);
+
+                    // found the category labels, so pass them on
+                    if (sectionCategory->GetSectionType() == sectionTypeCategoryLabel)
+                    {
+                        section = sectionCategory;
+                        rows = section->GetElementsPerRecord();
+                        section->GetDataTypeSize(dataType, dataSize);
+                        categoryLabelFound = true;
+                        break;
+                    }
+                }
+                if (!categoryLabelFound)
+                {
+                    RuntimeError("Category Labels not saved in file, either save, or support creation in BinaryReader");
+                }
+            }
+        }
+
+        // make sure we are good now
+        if (dataType != sectionDataFloat || dataSize != sizeof(ElemType))
+        {
+            RuntimeError("Category Labels not saved in file, either save, or support creation in BinaryReader");
+        }
+    }
+    return section;
+}
+
 //SetupEpoch - Setup the proper position in the file, and other variable settings to start a particular epoch
 template <class ElemType>
 void BinaryReader<ElemType>::SetupEpoch()
@@ -10,10 +10,16 @@
 #include "Config.h"
 #include <string>
 #include <map>
+#include <memory>
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Sharded datasets: BinaryWriter with wshards=N splits the records into N contiguous ranges and writes each to its own
+// file, <wfile>.shard<k>; <wfile> itself becomes a text index: this magic line, then one line '<records> <path>' per shard.
+// BinaryReader accepts such an index wherever it accepts a file.
+static const char* const shardIndexMagic = "BinaryReaderShards";
+
 enum SectionData
 {
     // section data type
@@ -558,7 +564,27 @@ private:
 
     int m_traceLevel;
     vector<SectionFile*> m_secFiles;
-    std::map<std::wstring, Section*, nocase_compare> m_sections;
+    std::map<std::wstring, Section*, nocase_compare> m_sections; // (of the first shard)
+
+    // the dataset's shards; a dataset of plain files is a single shard
+    struct Shard
+    {
+        size_t numRecords;
+        std::map<std::wstring, Section*, nocase_compare> sections;
+    };
+    vector<Shard> m_shards;
+    // a sweep reads the shards interleaved in blocks, so that a minibatch is read from all shards at once, one thread each
+    struct ShardBlock
+    {
+        size_t shard;
+        size_t firstRecord; // within the shard
+        size_t numRecords;
+    };
+    vector<ShardBlock> m_blocks;
+    vector<size_t> m_blockStarts; // [i] first record of block i in the sweep
+    vector<ElemType> m_buffer;     // the minibatch, if it spans blocks
+    size_t m_subsetNum;            // distributed reading: this worker reads its share of each minibatch
+    size_t m_numSubsets;
 
     /**
     for reading one line per file, i.e., a file has only one line of data
@@ -568,9 +594,12 @@ private:
     vector<FILE*> m_fStream;
 
     void SetupEpoch();
-    void LoadSections(Section* parentSection, MappingType mapping, size_t windowSize);
+    void LoadSections(Section* parentSection, MappingType mapping, size_t windowSize, std::map<std::wstring, Section*, nocase_compare>& sections);
+    static bool ReadShardIndex(const std::wstring& path, vector<std::pair<size_t, std::wstring>>& shards);
+    void InitShardBlocks(size_t blockSize);
+    Section* GetRecordSection(Section* section, size_t& rows);
     void DisplayProperties();
-    bool CheckEndDataset(size_t actualmbsize);
+    bool CheckEndDataset(size_t& actualmbsize);
 
 public:
     template <class ConfigRecordType>
@@ -585,11 +614,16 @@ public:
     }
     virtual void Destroy();
     BinaryReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_subsetNum(0), m_numSubsets(1)
     {
     }
     virtual ~BinaryReader();
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     size_t GetNumParallelSequences()
@@ -597,6 +631,10 @@ public:
         return 1;
     }
     void SetNumParallelSequences(const size_t){};
+    bool SupportsConcurrentRead() const override
+    {
+        return true;
+    }
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
         pMBLayout->CopyFrom(m_pMBLayout);
@@ -634,6 +672,15 @@ private:
     // create the section map for the API
     std::map<std::wstring, SectionType, nocase_compare> m_sectionInfo;
 
+    // sharded datasets (wshards > 1): a shard writer per shard, written in parallel
+    std::vector<std::unique_ptr<BinaryWriter<ElemType>>> m_shards;
+    std::vector<size_t> m_shardFirstRecords; // [k] first record of shard k, and the end
+    std::wstring m_fileSuffix;               // a shard writer's suffix to the file names
+    size_t m_shardRecords;                   // a shard writer's number of records; 0 if not a shard
+    template <class ConfigRecordType>
+    void InitShards(const ConfigRecordType& config, size_t numShards);
+    bool SaveShards(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized);
+
     // create a section from config parameters
     Section* CreateSection(const ConfigParameters& config, Section* parentSection, size_t p_records, size_t p_windowSize = 0);
     Section* CreateSection(const ScriptableObjects::IConfigRecord& config, Section* parentSection, size_t p_records, size_t p_windowSize = 0);
@@ -652,10 +699,12 @@ public:
     // DataWriter Constructor
     // config - [in] configuration parameters for the datareader
     BinaryWriter(const ConfigParameters& config)
+        : m_shardRecords(0)
     {
         Init(config);
     }
     BinaryWriter()
+        : m_shardRecords(0)
     {
     }
     // Destroy - cleanup and remove this class
@@ -10,6 +10,7 @@
 #define DATAWRITER_EXPORTS // creating the exports here
 #include "DataWriter.h"
 #include "BinaryReader.h"
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -27,6 +28,7 @@ BinaryWriter<ElemType>::~BinaryWriter()
 {
     // clear the section references, they will be delted by the sectionFile destructors
     m_sections.clear();
+    m_shards.clear();
 
     // delete all the sectionfiles
     for (auto pair : m_secFiles)
@@ -51,6 +53,9 @@ BinaryWriter<ElemType>::~BinaryWriter()
 //  #wrecords - number of records we should allocate space for in the file
 //  # files cannot be expanded, so this should be large enough. If known modify this element in config before creating file
 //  wrecords=50000
+//  #wshards - split the records into this many shards, each written to its own files (wfile.shard0, ...) in parallel;
+//  # each wfile becomes the index of its shards, which BinaryReader reads in place of the file. default 1 (no sharding)
+//  #wshards=8
 //  features=[
 //    dim=784
 //    start=1
@@ -145,6 +150,10 @@ Section* BinaryWriter<ElemType>::CreateSection(const ConfigParameters& config, S
         sectionType = foundType;
     }
 
+    // a shard holds its part of the records (label mappings are the same in all shards)
+    if (m_shardRecords > 0 && sectionType != sectionTypeLabelMapping)
+        records = m_shardRecords;
+
     // calculate number of bytes = dim*elementSize*records
     size_t dataOnlySize = records * elementSize * dim;
     size_t dataSize = dataOnlySize + sectionHeaderMin;
@@ -154,6 +163,7 @@ Section* BinaryWriter<ElemType>::CreateSection(const ConfigParameters& config, S
     if (config.ExistsCurrent(L"wfile"))
     {
         std::wstring wfile = config(L"wfile");
+        wfile += m_fileSuffix;
         auto secFile = m_secFiles.find(wfile);
         if (secFile != m_secFiles.end())
         {
@@ -372,12 +382,61 @@ void BinaryWriter<ElemType>::InitFromConfig(const ConfigRecordType& config)
     m_recordCurrent = 0;
     m_recordMax = config(L"wrecords", (size_t) 0);
     m_traceLevel = config(L"traceLevel", 0);
+    if (m_shardRecords > 0) // a shard writer: the rest is set up by InitShards()
+    {
+        CreateSection(config, NULL, m_shardRecords);
+        return;
+    }
     m_uniqueID = (WORD) GetTickCount();
 
+    size_t numShards = config(L"wshards", (size_t) 1);
+    if (numShards > 1)
+    {
+        InitShards(config, numShards);
+        return;
+    }
+
     // get the configuration, this will recursively go down and create all subfiles/sections as well
     CreateSection(config, NULL, m_recordMax);
 }
 
+// InitShards - create the shard writers, and write the index of each file
+// config - the configuration for the binary writer
+// numShards - number of shards, each gets a contiguous range of records
+template <class ElemType>
+template <class ConfigRecordType>
+void BinaryWriter<ElemType>::InitShards(const ConfigRecordType& config, size_t numShards)
+{
+    if (m_recordMax < numShards)
+        InvalidArgument("BinaryWriter: 'wshards' (%d) must not be larger than 'wrecords' (%d).", (int) numShards, (int) m_recordMax);
+    for (size_t k = 0; k <= numShards; k++)
+        m_shardFirstRecords.push_back(k * m_recordMax / numShards);
+    for (size_t k = 0; k < numShards; k++)
+    {
+        std::unique_ptr<BinaryWriter<ElemType>> shard(new BinaryWriter<ElemType>());
+        shard->m_fileSuffix = msra::strfun::wstrprintf(L".shard%d", (int) k);
+        shard->m_shardRecords = m_shardFirstRecords[k + 1] - m_shardFirstRecords[k];
+        shard->m_uniqueID = m_uniqueID;
+        shard->InitFromConfig(config);
+        m_shards.push_back(std::move(shard));
+    }
+    // all shards have the same sections
+    m_sections = m_shards[0]->m_sections;
+
+    // the index, in place of each file
+    for (auto pair : m_shards[0]->m_secFiles)
+    {
+        std::wstring path = pair.first.substr(0, pair.first.size() - m_shards[0]->m_fileSuffix.size());
+        FILE* index = fopenOrDie(path, L"wt");
+        fprintfOrDie(index, "%s\n", shardIndexMagic);
+        for (size_t k = 0; k < numShards; k++)
+            fprintfOrDie(index, "%d %ls%ls\n", (int) m_shards[k]->m_shardRecords, path.c_str(), m_shards[k]->m_fileSuffix.c_str());
+        fcloseOrDie(index);
+        if (m_traceLevel > 0)
+            fprintf(stderr, "BinaryWriter: writing %ls in %d shards\n", path.c_str(), (int) numShards);
+    }
+}
+
 // GetSections - Get the sections of the file
 // sections - a map of section name to section. Data sepcifications from config file will be used to determine where and how to save data
 template <class ElemType>
@@ -411,10 +470,15 @@ bool BinaryWriter<ElemType>::SaveData(size_t recordStart, const std::map<std::ws
         RuntimeError("Caching with binary writer, records skip from %ld to %ld", m_recordCurrent, recordStart);
     }
     bool written = false;
-    for (auto pair : m_sections)
+    if (!m_shards.empty())
+        written = SaveShards(recordStart, matrices, numRecords, datasetSize, byteVariableSized);
+    else
     {
-        Section* section = pair.second;
-        written = section->SaveData(recordStart, matrices, numRecords, datasetSize, byteVariableSized) || written;
+        for (auto pair : m_sections)
+        {
+            Section* section = pair.second;
+            written = section->SaveData(recordStart, matrices, numRecords, datasetSize, byteVariableSized) || written;
+        }
     }
     // the current record we expect to write next
     m_recordCurrent = recordStart + numRecords;
@@ -422,12 +486,58 @@ bool BinaryWriter<ElemType>::SaveData(size_t recordStart, const std::map<std::ws
     return written;
 }
 
+// SaveShards - save data into the shards the records belong to, in parallel
+// parameters as for SaveData()
+template <class ElemType>
+bool BinaryWriter<ElemType>::SaveShards(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized)
+{
+    if (datasetSize != m_recordMax)
+        RuntimeError("BinaryWriter: A sharded dataset must have exactly 'wrecords' (%d) records, not %d.", (int) m_recordMax, (int) datasetSize);
+    size_t pass = recordStart / datasetSize;
+    size_t record = recordStart % datasetSize;
+    if (record + numRecords > datasetSize)
+        RuntimeError("BinaryWriter: Records to save must not wrap around the end of the dataset.");
+
+    std::vector<std::future<bool>> saves;
+    for (size_t k = 0; k < m_shards.size(); k++)
+    {
+        size_t begin = max(record, m_shardFirstRecords[k]);
+        size_t end = min(record + numRecords, m_shardFirstRecords[k + 1]);
+        if (begin >= end)
+            continue;
+        // point at the shard's records in each data buffer
+        std::map<std::wstring, void*, nocase_compare> shardMatrices;
+        for (auto pair : matrices)
+        {
+            auto iter = m_sections.find(pair.first);
+            size_t recordSize = iter != m_sections.end() ? iter->second->GetElementSize() * iter->second->GetElementsPerRecord() : 0;
+            shardMatrices[pair.first] = (char*) pair.second + (begin - record) * recordSize;
+        }
+        size_t shardSize = m_shardFirstRecords[k + 1] - m_shardFirstRecords[k];
+        size_t shardRecordStart = pass * shardSize + begin - m_shardFirstRecords[k];
+        BinaryWriter<ElemType>* shard = m_shards[k].get();
+        saves.push_back(std::async(std::launch::async, [=]()
+                                   {
+                                       return shard->SaveData(shardRecordStart, shardMatrices, end - begin, shardSize, byteVariableSized);
+                                   }));
+    }
+    bool written = false;
+    for (auto& save : saves)
+        written = save.get() || written;
+    // (a shard is complete before the dataset is)
+    return written || (pass == 0 && record + numRecords < datasetSize);
+}
+
 // SaveMapping - save a map into the file
 // saveId - name of the section to save into
 // labelMapping - map we are saving to the file
 template <class ElemType>
 void BinaryWriter<ElemType>::SaveMapping(std::wstring saveId, const std::map<typename BinaryWriter<ElemType>::LabelIdType, typename BinaryWriter<ElemType>::LabelType>& labelMapping)
 {
+    for (auto& shard : m_shards)
+        shard->SaveMapping(saveId, labelMapping);
+    if (!m_shards.empty())
+        return;
     Section* section = m_sections[saveId];
     if (section->GetSectionType() == sectionTypeLabelMapping)
     {
@@ -234,6 +234,8 @@ void DSSMReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
 template <class ElemType>
 DSSMReader<ElemType>::~DSSMReader()
 {
+    if (m_pendingPrefetch.valid()) // (the prefetch uses members that are destroyed before the future)
+        m_pendingPrefetch.wait();
     ReleaseMemory();
 }
 
@@ -279,6 +281,21 @@ size_t RoundUp(size_t value, size_t size)
 template <class ElemType>
 void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
 {
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+//StartDistributedMinibatchLoop - Startup a distributed minibatch loop for parallel training
+// subsetNum - [in] the subset number of the current node in a group of parallel training nodes
+// numSubsets - [in] total number of nodes participating in the parallel training
+// Each node reads its contiguous part of each minibatch, see GetWorkerRange().
+template <class ElemType>
+void DSSMReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+{
+    WaitForPrefetch(); // (a prefetch of the previous loop must not write into the buffers any longer)
+    m_prefetchStart = SIZE_MAX;
+    m_subsetNum = subsetNum;
+    m_numSubsets = numSubsets;
+
     size_t mbStartSample = m_epoch * m_epochSize;
     if (m_totalSamples == 0)
     {
@@ -334,21 +351,37 @@ bool DSSMReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*
     Matrix<ElemType>& labels = *matrices[m_labelsName]; // will change this part later.
 
     size_t actualMBSize = (m_readNextSample + m_mbSize > m_totalSamples) ? m_totalSamples - m_readNextSample : m_mbSize;
+    size_t start, numToRead; // this worker's part of the minibatch
+    GetWorkerRange(m_readNextSample, start, numToRead);
 
-    featuresQ.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
-    featuresD.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+    // take the batch that was assembled in the background if it is this one, else assemble it now
+    WaitForPrefetch();
+    if (m_prefetchStart == start && m_prefetchSize == numToRead)
+    {
+        std::swap(m_currentQuery, m_prefetchQuery);
+        std::swap(m_currentDoc, m_prefetchDoc);
+    }
+    else
+    {
+        dssm_queryInput.Fill_Batch(start, numToRead, m_currentQuery);
+        dssm_docInput.Fill_Batch(start, numToRead, m_currentDoc);
+    }
+    m_prefetchStart = SIZE_MAX;
+    m_readNextSample += actualMBSize;
 
-    /*
-    featuresQ.Resize(dssm_queryInput.numRows, actualMBSize);
-    featuresD.Resize(dssm_docInput.numRows, actualMBSize);
-    */
+    // assemble the next one while this one is used
+    if (m_readNextSample < m_totalSamples)
+    {
+        size_t nextStart, nextNumToRead;
+        GetWorkerRange(m_readNextSample, nextStart, nextNumToRead);
+        StartPrefetch(nextStart, nextNumToRead);
+    }
 
-    // fprintf(stderr, "featuresQ\n");
-    dssm_queryInput.Next_Batch(featuresQ, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\nfeaturesD\n");
-    dssm_docInput.Next_Batch(featuresD, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\n\n\n");
-    m_readNextSample += actualMBSize;
+    featuresQ.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+    featuresD.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+    dssm_queryInput.Set_Batch(featuresQ, m_currentQuery);
+    dssm_docInput.Set_Batch(featuresD, m_currentDoc);
+    actualMBSize = numToRead; // (the labels are for this worker's part)
     /*
                 featuresQ.Print("featuresQ");
                 fprintf(stderr, "\n");
@@ -415,6 +448,38 @@ bool DSSMReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*
     return true;
 }
 
+// GetWorkerRange - the records of the minibatch starting at mbStart that this worker reads
+template <class ElemType>
+void DSSMReader<ElemType>::GetWorkerRange(size_t mbStart, size_t& start, size_t& size) const
+{
+    size_t actualMBSize = min(m_mbSize, m_totalSamples - mbStart);
+    size_t begin = actualMBSize * m_subsetNum / m_numSubsets;
+    size_t end = actualMBSize * (m_subsetNum + 1) / m_numSubsets;
+    start = mbStart + begin;
+    size = end - begin;
+}
+
+// StartPrefetch - assemble the CSC arrays of a minibatch on a background thread
+// Only the mapped files and the m_prefetch* buffers are touched, so this runs concurrently with the use of the current minibatch.
+template <class ElemType>
+void DSSMReader<ElemType>::StartPrefetch(size_t start, size_t size)
+{
+    m_prefetchStart = start;
+    m_prefetchSize = size;
+    m_pendingPrefetch = std::async(std::launch::async, [this, start, size]()
+                                   {
+                                       dssm_queryInput.Fill_Batch(start, size, m_prefetchQuery);
+                                       dssm_docInput.Fill_Batch(start, size, m_prefetchDoc);
+                                   });
+}
+
+template <class ElemType>
+void DSSMReader<ElemType>::WaitForPrefetch()
+{
+    if (m_pendingPrefetch.valid())
+        m_pendingPrefetch.get(); // (rethrows)
+}
+
 // GetLabelMapping - Gets the label mapping from integer index to label type
 // returns - a map from numeric datatype to native label type
 template <class ElemType>
@@ -470,6 +535,7 @@ bool DSSMReader<ElemType>::DataEnd(EndDataType endDataType)
 
 template <class ElemType>
 DSSM_BinaryInput<ElemType>::DSSM_BinaryInput()
+    : offsets_orig(NULL), data_orig(NULL), m_dim(0), mbSize(0), offsets(NULL)
 {
 }
 template <class ElemType>
@@ -522,11 +588,11 @@ void DSSM_BinaryInput<ElemType>::Init(wstring fileName, size_t dim)
 
     int64_t header_size = numRows * sizeof(int64_t) + offsets_padding;
 
-    void* offsets_orig = MapViewOfFile(m_filemap,     // handle to map object
-                                       FILE_MAP_READ, // get correct permissions
-                                       HIDWORD(base_offset),
-                                       LODWORD(base_offset),
-                                       header_size);
+    offsets_orig = MapViewOfFile(m_filemap,     // handle to map object
+                                 FILE_MAP_READ, // get correct permissions
+                                 HIDWORD(base_offset),
+                                 LODWORD(base_offset),
+                                 header_size);
 
     offsets_buffer = (char*) offsets_orig + offsets_padding;
 
@@ -542,32 +608,16 @@ void DSSM_BinaryInput<ElemType>::Init(wstring fileName, size_t dim)
     int64_t data_padding = header_offset % sysGran;
     header_offset -= data_padding;
 
-    void* data_orig = MapViewOfFile(m_filemap,     // handle to map object
-                                    FILE_MAP_READ, // get correct permissions
-                                    HIDWORD(header_offset),
-                                    LODWORD(header_offset),
-                                    0);
+    data_orig = MapViewOfFile(m_filemap,     // handle to map object
+                              FILE_MAP_READ, // get correct permissions
+                              HIDWORD(header_offset),
+                              LODWORD(header_offset),
+                              0);
     data_buffer = (char*) data_orig + data_padding;
 }
 template <class ElemType>
 bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
 {
-    if (values == NULL || mbSize < minibatchSize)
-    {
-        if (values != NULL)
-        {
-            free(values);
-            free(colIndices);
-            free(rowIndices);
-        }
-
-        values = (ElemType*) malloc(sizeof(ElemType) * MAX_BUFFER * minibatchSize);
-        colIndices = (int32_t*) malloc(sizeof(int32_t) * (minibatchSize + 1));
-        rowIndices = (int32_t*) malloc(sizeof(int32_t) * MAX_BUFFER * minibatchSize);
-        // fprintf(stderr, "values  size: %d",sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        // fprintf(stderr, "colindi size: %d",sizeof(int32_t)*MAX_BUFFER*(1+minibatchSize));
-        // fprintf(stderr, "rowindi size: %d",sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-    }
     if (minibatchSize > mbSize)
     {
         mbSize = minibatchSize;
@@ -578,71 +628,33 @@ bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
 template <class ElemType>
 bool DSSM_BinaryInput<ElemType>::Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* /*ordering*/)
 {
-    /*
-    int devId = matrices.GetDeviceId();
-    matrices.TransferFromDeviceToDevice(devId, -1);
-    */
-
-    int32_t cur_index = 0;
-
-    for (int c = 0; c < numToRead; c++, cur++)
-    {
-        // int64_t cur_offset = offsets[ordering[cur]];
-        int64_t cur_offset = offsets[cur];
-        // int64_t cur_offset = offsets[ordering[c]];
-        // int32_t nnz;
-        colIndices[c] = cur_index;
-        int32_t nnz = *(int32_t*) ((char*) data_buffer + cur_offset);
-        // memcpy(&nnz, (char*)data_buffer + cur_offset, sizeof(int32_t));
-        memcpy(values + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t), sizeof(ElemType) * nnz);
-        memcpy(rowIndices + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t) + sizeof(ElemType) * nnz, sizeof(int32_t) * nnz);
-        /**
-        fprintf(stderr, "%4d (%3d, %6d): ", c, nnz, cur_index + nnz);
-        for (int i = 0; i < nnz; i++)
-        {
-            fprintf(stderr, "%d:%.f ", rowIndices[cur_index+i], values[cur_index+i]);
-            // matrices.SetValue(rowIndices[cur_index + i], c, values[cur_index + i]);
-        }
-        fprintf(stderr, "\n");
-        **/
-
-        cur_index += nnz;
-    }
-    colIndices[numToRead] = cur_index;
-    /*
-    int col = 0;
-    for (int c = 0; c < cur_index; c++)
+    Fill_Batch(cur, numToRead, m_batch);
+    Set_Batch(matrices, m_batch);
+    return true;
+}
+template <class ElemType>
+void DSSM_BinaryInput<ElemType>::Fill_Batch(size_t cur, size_t numToRead, DSSM_Batch<ElemType>& batch) const
+{
+    // record: int32 nnz, ElemType values[nnz], int32 rowIndices[nnz]
+    batch.colIndices.resize(numToRead + 1);
+    batch.values.clear();
+    batch.rowIndices.clear();
+    for (size_t c = 0; c < numToRead; c++, cur++)
     {
-        if (colIndices[col] == c)
-        {
-            fprintf(stderr, "\n%4d: ", col);
-            col++;
-        }
-        fprintf(stderr, "%d:%.f ", rowIndices[c], values[c]);
+        const char* record = (const char*) data_buffer + offsets[cur];
+        int32_t nnz = *(const int32_t*) record;
+        const ElemType* values = (const ElemType*) (record + sizeof(int32_t));
+        const int32_t* rowIndices = (const int32_t*) (record + sizeof(int32_t) + sizeof(ElemType) * nnz);
+        batch.colIndices[c] = (int32_t) batch.values.size();
+        batch.values.insert(batch.values.end(), values, values + nnz);
+        batch.rowIndices.insert(batch.rowIndices.end(), rowIndices, rowIndices + nnz);
     }
-    */
-    /*
-    fprintf(stderr, "\nXXXX nnz: %d\n", cur_index);
-    fprintf(stderr, "XXXX max values read: %d vs %d\n", sizeof(ElemType)*cur_index, sizeof(ElemType)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX max indices read: %d vs %d\n", sizeof(int32_t)*cur_index, sizeof(int32_t)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX sizeof(int32_t) = %d, sizeof(int) = %d\n", sizeof(int32_t), sizeof(int));
-    */
-    /*
-        values = (ElemType*)malloc(sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        colIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*(minibatchSize+1));
-        rowIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-        */
-
-    matrices.SetMatrixFromCSCFormat(colIndices, rowIndices, values, cur_index, m_dim, numToRead);
-    // matrices.Print("actual values");
-    // exit(1);
-    /*
-    matrices.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense);
-    matrices.Print("featuresQ");
-    exit(1);
-    matrices.TransferFromDeviceToDevice(-1,devId);
-    */
-    return true;
+    batch.colIndices[numToRead] = (int32_t) batch.values.size();
+}
+template <class ElemType>
+void DSSM_BinaryInput<ElemType>::Set_Batch(Matrix<ElemType>& matrices, const DSSM_Batch<ElemType>& batch) const
+{
+    matrices.SetMatrixFromCSCFormat(batch.colIndices.data(), batch.rowIndices.data(), batch.values.data(), batch.values.size(), m_dim, batch.colIndices.size() - 1);
 }
 
 template <class ElemType>
@@ -661,18 +673,8 @@ void DSSM_BinaryInput<ElemType>::Dispose()
     {
         free(offsets); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
     }
-    if (values != NULL)
-    {
-        free(values); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (rowIndices != NULL)
-    {
-        free(rowIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (colIndices != NULL)
-    {
-        free(colIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
+    offsets_orig = data_orig = NULL;
+    offsets = NULL;
 }
 
 template <class ElemType>
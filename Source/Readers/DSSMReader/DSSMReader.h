@@ -12,6 +12,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,6 +24,15 @@ enum LabelKind
     labelOther = 3,      // some other type of label
 };
 
+// the CSC arrays of one minibatch of a DSSM_BinaryInput, assembled off the training thread
+template <class ElemType>
+struct DSSM_Batch
+{
+    std::vector<ElemType> values;
+    std::vector<int32_t> rowIndices;
+    std::vector<int32_t> colIndices;
+};
+
 template <class ElemType>
 class DSSM_BinaryInput
 {
@@ -43,12 +53,9 @@ private:
 
     size_t m_dim;
     size_t mbSize;
-    size_t MAX_BUFFER = 300;
 
-    ElemType* values;    // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    int64_t* offsets;    // = (int*)malloc(sizeof(int)* 230 * 1024);
-    int32_t* colIndices; // = (int*)malloc(sizeof(int)* (batchsize + 1));
-    int32_t* rowIndices; // = (int*)malloc(sizeof(int)* MAX_BUFFER * batchsize);
+    int64_t* offsets; // = (int*)malloc(sizeof(int)* 230 * 1024);
+    DSSM_Batch<ElemType> m_batch;
 
 public:
     int64_t numRows;
@@ -60,6 +67,9 @@ public:
     void Init(std::wstring fileName, size_t dim);
     bool SetupEpoch(size_t minibatchSize);
     bool Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* ordering);
+    // Next_Batch() in two steps: Fill_Batch() only reads the mapped file, and may run on another thread
+    void Fill_Batch(size_t cur, size_t numToRead, DSSM_Batch<ElemType>& batch) const;
+    void Set_Batch(Matrix<ElemType>& matrices, const DSSM_Batch<ElemType>& batch) const;
     void Dispose();
 };
 
@@ -118,6 +128,20 @@ private:
     std::map<LabelIdType, LabelType> m_mapIdToLabel;
     std::map<LabelType, LabelIdType> m_mapLabelToId;
 
+    // distributed reading: each worker reads its part of each minibatch
+    size_t m_subsetNum;
+    size_t m_numSubsets;
+
+    // the next minibatch of this worker is assembled in the background while the current one is used
+    std::future<void> m_pendingPrefetch;
+    size_t m_prefetchStart;
+    size_t m_prefetchSize;
+    DSSM_Batch<ElemType> m_prefetchQuery, m_prefetchDoc;
+    DSSM_Batch<ElemType> m_currentQuery, m_currentDoc;
+    void GetWorkerRange(size_t mbStart, size_t& start, size_t& size) const;
+    void StartPrefetch(size_t start, size_t size);
+    void WaitForPrefetch();
+
     // caching support
     DataReader<ElemType>* m_cachingReader;
     DataWriter<ElemType>* m_cachingWriter;
@@ -150,7 +174,7 @@ public:
     }
     virtual void Destroy();
     DSSMReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_subsetNum(0), m_numSubsets(1), m_prefetchStart(SIZE_MAX), m_prefetchSize(0)
     {
         m_qfeaturesBuffer = NULL;
         m_dfeaturesBuffer = NULL;
@@ -158,6 +182,11 @@ public:
     }
     virtual ~DSSMReader();
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     size_t GetNumParallelSequences()
@@ -165,6 +194,10 @@ public:
         return 1;
     }
     void SetNumParallelSequences(const size_t){};
+    bool SupportsConcurrentRead() const override
+    {
+        return true;
+    }
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
         pMBLayout->CopyFrom(m_pMBLayout);
@@ -26,6 +26,7 @@
 #include "ScriptableObjects.h"
 #include "HTKMLFReader.h"
 #include "TimerUtility.h"
+#include <set>
 #ifdef LEAKDETECT
 #include <vld.h> // for memory leak detection
 #endif
@@ -194,15 +195,18 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         else
             type = (const wstring&) thisLabel(L"type", L"category"); // outputs should default to category
 
-        if (!_wcsicmp(type.c_str(), L"category"))
+        // 'index' delivers the class indices themselves, [1 x T], e.g. for CrossEntropyWithSoftmax with many classes
+        bool labelsAsIndices = !_wcsicmp(type.c_str(), L"index");
+        if (!_wcsicmp(type.c_str(), L"category") || labelsAsIndices)
             m_nameToTypeMap[labelNames[i]] = InputOutputTypes::category;
         else
-            InvalidArgument("label type must be 'category'");
+            InvalidArgument("label type must be 'category' or 'index'");
+        m_labelsAsIndicesMultiIO.push_back(labelsAsIndices);
 
         statelistpaths.push_back(thisLabel(L"labelMappingFile", L""));
 
         m_labelNameToIdMap[labelNames[i]] = iLabel;
-        m_labelNameToDimMap[labelNames[i]] = m_labelDims[i];
+        m_labelNameToDimMap[labelNames[i]] = labelsAsIndices ? 1 : m_labelDims[i]; // (the rows of the minibatch; m_labelDims is the number of classes)
         mlfpaths.clear();
         if (thisLabel.ExistsCurrent(L"mlfFile"))
         {
@@ -230,6 +234,8 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         wstring labelToTargetMappingFile(thisLabel(L"labelToTargetMappingFile", L""));
         if (labelToTargetMappingFile != L"")
         {
+            if (labelsAsIndices)
+                InvalidArgument("labelType 'index' cannot be used with a labelToTargetMappingFile.");
             std::vector<std::vector<ElemType>> labelToTargetMap;
             m_convertLabelsToTargetsMultiIO.push_back(true);
             if (thisLabel.Exists(L"targetDim"))
@@ -299,6 +305,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 
     m_frameMode = readerConfig(L"frameMode", true);
     m_verbosity = readerConfig(L"verbosity", 2);
+    m_readAhead = readerConfig(L"readAhead", false);
 
     // determine if we partial minibatches are desired
     wstring minibatchMode(readerConfig(L"minibatchMode", L"partial"));
@@ -315,15 +322,10 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     numFiles = 0;
     foreach_index (i, scriptpaths)
     {
-        vector<wstring> filelist;
         std::wstring scriptpath = scriptpaths[i];
         fprintf(stderr, "reading script file %ls ...", scriptpath.c_str());
-        size_t n = 0;
-        for (msra::files::textreader reader(scriptpath); reader && filelist.size() <= firstfilesonly /*optimization*/;)
-        {
-            filelist.push_back(reader.wgetline());
-            n++;
-        }
+        vector<wstring> filelist = ReadScriptFile(scriptpath, firstfilesonly);
+        size_t n = filelist.size();
 
         fprintf(stderr, " %lu entries\n", n);
 
@@ -346,8 +348,10 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
             // third, join the rootpath with each entry in filelist
             if (!rootpath.empty())
             {
-                for (wstring& path : filelist)
+#pragma omp parallel for
+                for (int k = 0; k < (int) filelist.size(); k++)
                 {
+                    wstring& path = filelist[k];
                     if (path.find_first_of(L'=') != wstring::npos)
                     {
                         vector<wstring> strarr = msra::strfun::split(path, L"=");
@@ -385,8 +389,11 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
                        do not want different scp files everytime you move or create new features
                        */
             wstring scpdircached;
-            for (auto& entry : filelist)
-                ExpandDotDotDot(entry, scriptpath, scpdircached);
+            if (!filelist.empty())
+                ExpandDotDotDot(filelist[0], scriptpath, scpdircached); // (determines scpdircached, which the others then only read)
+#pragma omp parallel for
+            for (int k = 1; k < (int) filelist.size(); k++)
+                ExpandDotDotDot(filelist[k], scriptpath, scpdircached);
         }
 
         infilesmulti.push_back(std::move(filelist));
@@ -430,6 +437,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     //    statelistpath = readerConfig(L"statelist");
 
     double htktimetoframe = 100000.0; // default is 10ms
+    const wstring mlfcachedir = readerConfig(L"mlfCacheDir", L"");
     // std::vector<msra::asr::htkmlfreader<msra::asr::htkmlfentry,msra::lattices::lattice::htkmlfwordsequence>> labelsmulti;
     std::vector<std::map<std::wstring, std::vector<msra::asr::htkmlfentry>>> labelsmulti;
     // std::vector<std::wstring> pagepath;
@@ -437,7 +445,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     {
         const msra::lm::CSymbolSet* wordmap = unigram ? &unigramsymbols : NULL;
         msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence>
-        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe); // label MLF
+        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe, mlfcachedir); // label MLF
         // get the temp file name for the page file
 
         // Make sure 'msra::asr::htkmlfreader' type has a move constructor
@@ -453,10 +461,19 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 
         m_lattices.reset(new msra::dbn::latticesource(latticetocs, m_hset.getsymmap(), RootPathInLatticeTocs));
         m_lattices->setverbosity(m_verbosity);
+        // keep lattices in memory in compact form across epochs, up to this many MB (0: read them from the archives each time)
+        m_lattices->setcachecapacity(readerConfig(L"latticeCacheMB", (size_t) 0) * 1024 * 1024);
 
         // now get the frame source. This has better randomization and doesn't create temp files
-        m_frameSource.reset(new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode));
+        auto frameSource = new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode);
+        m_frameSource.reset(frameSource);
         m_frameSource->setverbosity(m_verbosity);
+        // page in upcoming chunks on this many background threads (0: page in when needed)
+        frameSource->setchunkiothreads(readerConfig(L"numChunkIOThreads", (size_t) 0));
+        // reference chunk data in memory-mapped feature archives rather than copying them
+        frameSource->setmapfeatures(readerConfig(L"mapFeatureArchives", false));
+        // utterance mode: group utterances of similar length into the same minibatches
+        frameSource->setbucketsize(readerConfig(L"bucketSize", (size_t) 0));
     }
     else if (!_wcsicmp(readMethod.c_str(), L"rollingWindow"))
     {
@@ -609,15 +626,10 @@ void HTKMLFReader<ElemType>::PrepareForWriting(const ConfigRecordType& readerCon
     numFiles = 0;
     foreach_index (i, scriptpaths)
     {
-        vector<wstring> filelist;
         std::wstring scriptpath = scriptpaths[i];
         fprintf(stderr, "reading script file %ls ...", scriptpath.c_str());
-        size_t n = 0;
-        for (msra::files::textreader reader(scriptpath); reader && filelist.size() <= firstfilesonly /*optimization*/;)
-        {
-            filelist.push_back(reader.wgetline());
-            n++;
-        }
+        vector<wstring> filelist = ReadScriptFile(scriptpath, firstfilesonly);
+        size_t n = filelist.size();
 
         fprintf(stderr, " %d entries\n", (int) n);
 
@@ -642,6 +654,10 @@ void HTKMLFReader<ElemType>::StartDistributedMinibatchLoop(size_t requestedMBSiz
     assert(subsetNum < numSubsets);
     assert(((subsetNum == 0) && (numSubsets == 1)) || this->SupportsDistributedMBRead());
 
+    // the read-ahead thread of the previous epoch may still be running ahead
+    StopReadAhead();
+    m_readAheadThisEpoch = false;
+
     m_mbNumTimeSteps = requestedMBSize; // note: ignored in frame mode and full-sequence mode
 
     m_numSeqsPerMB = m_numSeqsPerMBForAllEpochs[epoch];
@@ -664,6 +680,7 @@ void HTKMLFReader<ElemType>::StartDistributedMinibatchLoop(size_t requestedMBSiz
     // In frame mode, m_numSeqsPerMB must be 1. However, the returned layout has one 1-frame sequence per frame.
     m_sentenceEnd.assign(m_numSeqsPerMB, true);
     m_processedFrame.assign(m_numSeqsPerMB, 0);
+    m_bufferPosition.assign(m_numSeqsPerMB, 0);
     m_numFramesToProcess.assign(m_numSeqsPerMB, 0);
     m_switchFrame.assign(m_numSeqsPerMB, 0);
     m_numValidFrames.assign(m_numSeqsPerMB, 0);
@@ -703,6 +720,24 @@ void HTKMLFReader<ElemType>::StartDistributedMinibatchLoop(size_t requestedMBSiz
     m_checkDictionaryKeys = true;
 }
 
+// StartDynamicDistributedMinibatchLoop - like StartDistributedMinibatchLoop(), but instead of reading the chunks of subset 'subsetNum',
+// the minibatch iterator reads all data in the blocks of 'workItemSize' frames that it claims through 'nextWorkItem'
+template <class ElemType>
+void HTKMLFReader<ElemType>::StartDynamicDistributedMinibatchLoop(size_t requestedMBSize, size_t epoch, size_t subsetNum, size_t numSubsets,
+                                                                  const std::function<size_t()>& nextWorkItem, size_t workItemSize, size_t requestedEpochSamples /*= requestDataSize*/)
+{
+    if (!SupportsDynamicDistributedMBRead())
+        LogicError("StartDynamicDistributedMinibatchLoop: dynamic distribution of mini-batches is only supported for training or testing with a chunked frame source");
+    if (workItemSize == 0)
+        InvalidArgument("StartDynamicDistributedMinibatchLoop: workItemSize must not be 0");
+
+    m_nextWorkItem = nextWorkItem;
+    m_workItemSize = workItemSize;
+    StartDistributedMinibatchLoop(requestedMBSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+    m_nextWorkItem = nullptr; // (the minibatch iterator has its own copy)
+    m_workItemSize = 0;
+}
+
 template <class ElemType>
 void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
@@ -735,7 +770,15 @@ void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size
         requestedEpochSamples = totalFrames;
     }
 
-    m_mbiter.reset(new msra::dbn::minibatchiterator(*m_frameSource, epoch, requestedEpochSamples, mbSize, subsetNum, numSubsets, datapasses));
+    if (m_workItemSize > 0)
+    {
+        // In frame mode, each node gets its share of the minibatch size, as it would with a fixed subset.
+        // In utterance mode, the parallel sequences have already been shared out above.
+        size_t nodeMBSize = m_frameMode ? max(mbSize / numSubsets, (size_t) 1) : mbSize;
+        m_mbiter.reset(new msra::dbn::minibatchiterator(*m_frameSource, epoch, requestedEpochSamples, nodeMBSize, m_nextWorkItem, m_workItemSize));
+    }
+    else
+        m_mbiter.reset(new msra::dbn::minibatchiterator(*m_frameSource, epoch, requestedEpochSamples, mbSize, subsetNum, numSubsets, datapasses));
     // Advance the MB iterator until we find some data or reach the end of epoch
     while ((m_mbiter->currentmbframes() == 0) && *m_mbiter)
     {
@@ -746,6 +789,8 @@ void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size
     if (!(*m_mbiter))
         m_noData = true;
 
+    m_readAheadThisEpoch = m_readAhead && (m_workItemSize == 0);
+
     if (!m_featuresBufferMultiIO.empty())
     {
         if (m_featuresBufferMultiIO[0] != nullptr) // check first feature, if it isn't NULL, safe to assume all are not NULL?
@@ -795,6 +840,28 @@ void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size
 
         ReNewBufferForMultiIO(u);
     }
+    m_samplePosition = m_bufferPosition[0];
+}
+
+// continue the epoch at a position returned by GetCurrentSamplePosition(), right after the minibatch loop was started
+// The utterance source is position-addressable, so we just reposition the minibatch iterator and get the utterance there.
+template <class ElemType>
+void HTKMLFReader<ElemType>::SetCurrentSamplePosition(size_t samplePosition)
+{
+    if (!SupportsSamplePositionSeek())
+        LogicError("SetCurrentSamplePosition: seeking is only supported for training or testing with one parallel sequence and without truncation");
+    if (m_readingAhead)
+        LogicError("SetCurrentSamplePosition: must be called right after starting the minibatch loop");
+
+    m_mbiter->seek(samplePosition);
+    // Advance the MB iterator until we find some data or reach the end of epoch
+    while ((m_mbiter->currentmbframes() == 0) && *m_mbiter)
+    {
+        (*m_mbiter)++;
+    }
+    m_noData = !(*m_mbiter);
+    ReNewBufferForMultiIO(0);
+    m_samplePosition = m_bufferPosition[0];
 }
 
 template <class ElemType>
@@ -831,18 +898,23 @@ template <class ElemType>
 bool HTKMLFReader<ElemType>::GetMinibatch4SEToTrainOrTest(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput,
                                                           std::vector<size_t>& uids, std::vector<size_t>& boundaries, std::vector<size_t>& extrauttmap)
 {
+    const auto& extraSeqsPerMB = m_readingAhead ? m_current.extraSeqsPerMB : m_extraSeqsPerMB;
+    const auto& extraLattices = m_readingAhead ? m_current.extraLattices : m_extraLatticeBufferMultiUtt;
+    const auto& extraLabelsIDs = m_readingAhead ? m_current.extraLabelsIDs : m_extraLabelsIDBufferMultiUtt;
+    const auto& extraPhoneboundaryIDs = m_readingAhead ? m_current.extraPhoneboundaryIDs : m_extraPhoneboundaryIDBufferMultiUtt;
+
     latticeinput.clear();
     uids.clear();
     boundaries.clear();
     extrauttmap.clear();
-    for (size_t i = 0; i < m_extraSeqsPerMB.size(); i++)
+    for (size_t i = 0; i < extraSeqsPerMB.size(); i++)
     {
-        latticeinput.push_back(m_extraLatticeBufferMultiUtt[i]);
-        uids.insert(uids.end(), m_extraLabelsIDBufferMultiUtt[i].begin(), m_extraLabelsIDBufferMultiUtt[i].end());
-        boundaries.insert(boundaries.end(), m_extraPhoneboundaryIDBufferMultiUtt[i].begin(), m_extraPhoneboundaryIDBufferMultiUtt[i].end());
+        latticeinput.push_back(extraLattices[i]);
+        uids.insert(uids.end(), extraLabelsIDs[i].begin(), extraLabelsIDs[i].end());
+        boundaries.insert(boundaries.end(), extraPhoneboundaryIDs[i].begin(), extraPhoneboundaryIDs[i].end());
     }
 
-    extrauttmap.insert(extrauttmap.end(), m_extraSeqsPerMB.begin(), m_extraSeqsPerMB.end());
+    extrauttmap.insert(extrauttmap.end(), extraSeqsPerMB.begin(), extraSeqsPerMB.end());
     return true;
 }
 
@@ -873,12 +945,7 @@ bool HTKMLFReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType
 template <class ElemType>
 bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Matrix<ElemType>*>& matrices)
 {
-    size_t id;
-    size_t dim;
-    bool skip = false;
-
     // on first minibatch, make sure we can supply data for requested nodes
-    std::map<std::wstring, size_t>::iterator iter;
     if (m_checkDictionaryKeys)
     {
         for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
@@ -887,7 +954,93 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                 RuntimeError("minibatch requested for input node %ls not found in reader - cannot generate input\n", iter->first.c_str());
         }
         m_checkDictionaryKeys = false;
+
+        m_nodeDevices.clear();
+        for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
+            m_nodeDevices[iter->first] = iter->second->GetDeviceId();
+    }
+
+    if (!m_readAheadThisEpoch)
+    {
+        if (!ReadMinibatchToTrainOrTest(m_nodeDevices))
+            return false;
+        CopyMinibatchToMatrices(matrices, m_featuresBufferMultiIO, m_labelsBufferMultiIO, m_mbNumTimeSteps * m_numSeqsPerMB, false /*async: buffers are refilled right away*/);
+        return true;
+    }
+
+    if (!m_readingAhead)
+        StartReadAhead();
+
+    // m_current is about to go back to the thread for refilling
+    WaitForAsyncUploads();
+
+    {
+        std::unique_lock<std::mutex> lock(m_readAheadMutex);
+        m_nextFilled.wait(lock, [this]()
+                          {
+                              return m_nextReady;
+                          });
+        if (!m_next.hasData) // end of epoch (or error): leave it in place, so that we keep returning false
+        {
+            if (m_next.error)
+                std::rethrow_exception(m_next.error);
+            return false;
+        }
+        std::swap(m_current, m_next); // m_next now holds the buffers of the previous minibatch, for reuse
+        m_nextReady = false;
     }
+    m_nextConsumed.notify_all();
+
+    CopyMinibatchToMatrices(matrices, m_current.features, m_current.labels, m_current.pMBLayout->GetNumCols(), true /*async*/);
+    return true;
+}
+
+// block until the uploads of the buffers passed to CopyMinibatchToMatrices() with 'async' are done
+template <class ElemType>
+void HTKMLFReader<ElemType>::WaitForAsyncUploads()
+{
+    std::set<DEVICEID_TYPE> devices;
+    for (const auto& nodeDevice : m_nodeDevices)
+        if (nodeDevice.second >= 0 && devices.insert(nodeDevice.second).second)
+            Matrix<ElemType>::WaitForAsyncSetValues(nodeDevice.second);
+}
+
+// copy the assembled minibatch from the (pinned) host buffers to the matrices of the requested inputs
+// With 'async', uploads to GPU matrices do not block, and the buffers must be left alone until WaitForAsyncUploads().
+template <class ElemType>
+void HTKMLFReader<ElemType>::CopyMinibatchToMatrices(std::map<std::wstring, Matrix<ElemType>*>& matrices, const std::vector<std::shared_ptr<ElemType>>& features,
+                                                     const std::vector<std::shared_ptr<ElemType>>& labels, size_t numCols, bool async)
+{
+    for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
+    {
+        // dereference matrix that corresponds to key (input/output name) and
+        // populate based on whether its a feature or a label
+        Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
+        // the buffers were allocated for the device of the matrix (AllocateIntermediateBuffer()), i.e. pinned for GPUs
+        size_t matrixFlags = (async && data.GetDeviceId() >= 0) ? matrixFlagSetValueAsync : matrixFlagNormal;
+        if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
+        {
+            size_t id = m_featureNameToIdMap[iter->first];
+            size_t dim = m_featureNameToDimMap[iter->first];
+            data.SetValue(dim, numCols, data.GetDeviceId(), features[id].get(), matrixFlags);
+        }
+        else if (m_nameToTypeMap[iter->first] == InputOutputTypes::category)
+        {
+            size_t id = m_labelNameToIdMap[iter->first];
+            size_t dim = m_labelNameToDimMap[iter->first];
+            data.SetValue(dim, numCols, data.GetDeviceId(), labels[id].get(), matrixFlags);
+        }
+    }
+}
+
+// assemble the next minibatch in m_featuresBufferMultiIO and m_labelsBufferMultiIO (allocated for 'nodeDevices'),
+// and set m_pMBLayout and the other information about it; returns false at the end of the epoch
+template <class ElemType>
+bool HTKMLFReader<ElemType>::ReadMinibatchToTrainOrTest(const std::map<std::wstring, DEVICEID_TYPE>& nodeDevices)
+{
+    size_t id;
+    size_t dim;
+    bool skip = false;
 
     Timer aggregateTimer;
     if (m_verbosity > 2)
@@ -975,7 +1128,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             m_pMBLayout->AddSequence(NEW_SEQUENCE_ID, i, 0, m_numValidFrames[i]);
 
                         m_extraSeqsPerMB.push_back(i);
-                        fillOneUttDataforParallelmode(matrices, 0, m_numValidFrames[i], i, i);
+                        fillOneUttDataforParallelmode(nodeDevices, 0, m_numValidFrames[i], i, i);
                         if (m_latticeBufferMultiUtt[i] != nullptr)
                         {
                             m_extraLatticeBufferMultiUtt.push_back(m_latticeBufferMultiUtt[i]);
@@ -1023,7 +1176,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                                     m_extraLabelsIDBufferMultiUtt.push_back(m_labelsIDBufferMultiUtt[src]);
                                     m_extraPhoneboundaryIDBufferMultiUtt.push_back(m_phoneboundaryIDBufferMultiUtt[src]);
                                 }
-                                fillOneUttDataforParallelmode(matrices, m_numValidFrames[des], framenum, des, src);
+                                fillOneUttDataforParallelmode(nodeDevices, m_numValidFrames[des], framenum, des, src);
                                 m_pMBLayout->AddSequence(NEW_SEQUENCE_ID, des, m_numValidFrames[des], m_numValidFrames[des] + framenum);
 
                                 ReNewBufferForMultiIO(src);
@@ -1043,25 +1196,6 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                     for (size_t i = 0; i < m_numSeqsPerMB; i++)
                         m_pMBLayout->AddGap(i, m_numValidFrames[i], m_mbNumTimeSteps);
                 } // if (!frameMode)
-
-                for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
-                {
-                    // dereference matrix that corresponds to key (input/output name) and
-                    // populate based on whether its a feature or a label
-                    Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
-                    if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
-                    {
-                        id = m_featureNameToIdMap[iter->first];
-                        dim = m_featureNameToDimMap[iter->first];
-                        data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_featuresBufferMultiIO[id].get(), matrixFlagNormal);
-                    }
-                    else if (m_nameToTypeMap[iter->first] == InputOutputTypes::category)
-                    {
-                        id = m_labelNameToIdMap[iter->first];
-                        dim = m_labelNameToDimMap[iter->first];
-                        data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_labelsBufferMultiIO[id].get(), matrixFlagNormal);
-                    }
-                }
             }
         }
         else // if m_truncated
@@ -1118,11 +1252,10 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                     }
                     actualmbsize[i] = m_mbNumTimeSteps;
                     const size_t endFr = startFr + actualmbsize[i]; // actual end frame index of this segment
-                    for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
+                    for (auto iter = nodeDevices.begin(); iter != nodeDevices.end(); iter++)
                     {
-                        // dereference matrix that corresponds to key (input/output name) and
                         // populate based on whether its a feature or a label
-                        Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
+                        DEVICEID_TYPE deviceId = iter->second;
 
                         if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
                         {
@@ -1132,7 +1265,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             if ((m_featuresBufferMultiIO[id] == nullptr) ||
                                 (m_featuresBufferAllocatedMultiIO[id] < (dim * m_mbNumTimeSteps * m_numSeqsPerMB)) /*buffer size changed. can be partial minibatch*/)
                             {
-                                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                                 m_featuresBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
                             }
 
@@ -1160,7 +1293,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             if ((m_labelsBufferMultiIO[id] == nullptr) ||
                                 (m_labelsBufferAllocatedMultiIO[id] < (dim * m_mbNumTimeSteps * m_numSeqsPerMB)))
                             {
-                                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                                 m_labelsBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
                             }
 
@@ -1182,11 +1315,10 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                     assert(endFr == m_numFramesToProcess[i]);            // we are at the end
 
                     // fill frames for the tail of this utterance
-                    for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
+                    for (auto iter = nodeDevices.begin(); iter != nodeDevices.end(); iter++)
                     {
-                        // dereference matrix that corresponds to key (input/output name) and
                         // populate based on whether its a feature or a label
-                        Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
+                        DEVICEID_TYPE deviceId = iter->second;
 
                         if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
                         {
@@ -1196,7 +1328,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             if ((m_featuresBufferMultiIO[id] == nullptr) ||
                                 (m_featuresBufferAllocatedMultiIO[id] < (dim * m_mbNumTimeSteps * m_numSeqsPerMB)) /*buffer size changed. can be partial minibatch*/)
                             {
-                                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                                 m_featuresBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
                             }
 
@@ -1226,7 +1358,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             if ((m_labelsBufferMultiIO[id] == nullptr) ||
                                 (m_labelsBufferAllocatedMultiIO[id] < (dim * m_mbNumTimeSteps * m_numSeqsPerMB)))
                             {
-                                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                                 m_labelsBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
                             }
                             for (size_t j = startFr, k = 0; j < endFr; j++, k++)
@@ -1258,11 +1390,9 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                             m_pMBLayout->AddSequence(NEW_SEQUENCE_ID, i, startT, startT + m_numFramesToProcess[i]);
 
                             // copy the data
-                            for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
+                            for (auto iter = nodeDevices.begin(); iter != nodeDevices.end(); iter++)
                             {
-                                // dereference matrix that corresponds to key (input/output name) and
                                 // populate based on whether its a feature or a label
-                                // Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
 
                                 if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
                                 {
@@ -1318,29 +1448,13 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                 }
             } // for (size_t i = 0; i < m_numSeqsPerMB; i++)
             // we are done filling all parallel sequences
-
-            for (auto iter = matrices.begin(); iter != matrices.end(); iter++)
-            {
-                // dereference matrix that corresponds to key (input/output name) and
-                // populate based on whether its a feature or a label
-                Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
-                if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
-                {
-                    id = m_featureNameToIdMap[iter->first];
-                    dim = m_featureNameToDimMap[iter->first];
-                    data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_featuresBufferMultiIO[id].get(), matrixFlagNormal);
-                }
-                else if (m_nameToTypeMap[iter->first] == InputOutputTypes::category)
-                {
-                    id = m_labelNameToIdMap[iter->first];
-                    dim = m_labelNameToDimMap[iter->first];
-                    data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_labelsBufferMultiIO[id].get(), matrixFlagNormal);
-                }
-            }
             skip = false;
         }           // if truncated then else
     } while (skip); // keep going if we didn't get the right size minibatch
 
+    // the utterance that the next minibatch starts with (if SupportsSamplePositionSeek(), that is all the reader holds)
+    m_samplePosition = m_bufferPosition[0];
+
     if (m_verbosity > 2)
     {
         aggregateTimer.Stop();
@@ -1351,10 +1465,107 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
     return true;
 }
 
+// Start the read-ahead thread for the rest of the epoch, on the first GetMinibatch() (when we know the devices).
+template <class ElemType>
+void HTKMLFReader<ElemType>::StartReadAhead()
+{
+    for (MinibatchBuffers* buffers : {&m_current, &m_next})
+    {
+        buffers->features.assign(m_featuresBufferMultiIO.size(), nullptr);
+        buffers->featuresAllocated.assign(m_featuresBufferMultiIO.size(), 0);
+        buffers->labels.assign(m_labelsBufferMultiIO.size(), nullptr);
+        buffers->labelsAllocated.assign(m_labelsBufferMultiIO.size(), 0);
+        buffers->pMBLayout = make_shared<MBLayout>();
+        buffers->hasData = false;
+        buffers->error = nullptr;
+    }
+    // until the first minibatch is returned, report what we did before
+    SwapMinibatchBuffers(m_current);
+
+    m_nextReady = false;
+    m_stopReadAhead = false;
+    m_readingAhead = true;
+    m_readAheadThread = std::thread([this]()
+                                    {
+                                        ReadAhead();
+                                    });
+}
+
+template <class ElemType>
+void HTKMLFReader<ElemType>::StopReadAhead()
+{
+    if (!m_readAheadThread.joinable())
+        return;
+    {
+        std::unique_lock<std::mutex> lock(m_readAheadMutex);
+        m_stopReadAhead = true;
+    }
+    m_nextConsumed.notify_all();
+    m_readAheadThread.join();
+    WaitForAsyncUploads(); // the buffers of m_current may get written again without read-ahead
+    m_readingAhead = false;
+    m_nextReady = false;
+}
+
+// Runs on m_readAheadThread: assemble minibatches and hand them over through m_next until the end of the epoch.
+template <class ElemType>
+void HTKMLFReader<ElemType>::ReadAhead()
+{
+    for (;;)
+    {
+        bool hasData = false;
+        std::exception_ptr error;
+        try
+        {
+            hasData = ReadMinibatchToTrainOrTest(m_nodeDevices);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_readAheadMutex);
+            m_nextConsumed.wait(lock, [this]()
+                                {
+                                    return m_stopReadAhead || !m_nextReady;
+                                });
+            if (m_stopReadAhead)
+                return;
+            SwapMinibatchBuffers(m_next);
+            m_next.hasData = hasData;
+            m_next.error = error;
+            m_nextReady = true;
+        }
+        m_nextFilled.notify_all();
+
+        if (!hasData) // end of epoch (or error), which GetMinibatch() will keep reporting
+            return;
+    }
+}
+
+// Exchange the output buffers of the minibatch just assembled with 'buffers', and copy the information about it.
+template <class ElemType>
+void HTKMLFReader<ElemType>::SwapMinibatchBuffers(MinibatchBuffers& buffers)
+{
+    std::swap(buffers.features, m_featuresBufferMultiIO);
+    std::swap(buffers.featuresAllocated, m_featuresBufferAllocatedMultiIO);
+    std::swap(buffers.labels, m_labelsBufferMultiIO);
+    std::swap(buffers.labelsAllocated, m_labelsBufferAllocatedMultiIO);
+    buffers.pMBLayout->CopyFrom(m_pMBLayout);
+    buffers.sentenceEnd = m_sentenceEnd;
+    buffers.switchFrame = m_switchFrame;
+    buffers.extraLattices = m_extraLatticeBufferMultiUtt;
+    buffers.extraLabelsIDs = m_extraLabelsIDBufferMultiUtt;
+    buffers.extraPhoneboundaryIDs = m_extraPhoneboundaryIDBufferMultiUtt;
+    buffers.extraSeqsPerMB = m_extraSeqsPerMB;
+    buffers.samplePosition = m_samplePosition;
+}
+
 // copy an utterance into the minibatch given a location (parallel-sequence index, start frame)
 // TODO: This should use DataFor(). But for that, DataFor() will have to move out from ComputationNode. Ah, it has!
 template <class ElemType>
-void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(std::map<std::wstring, Matrix<ElemType>*>& matrices, size_t startFr,
+void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(const std::map<std::wstring, DEVICEID_TYPE>& nodeDevices, size_t startFr,
                                                            size_t framenum, size_t channelIndex, size_t sourceChannelIndex)
 {
     size_t id;
@@ -1362,12 +1573,10 @@ void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(std::map<std::wstring
     size_t numOfFea = m_featuresBufferMultiIO.size();
     size_t numOfLabel = m_labelsBufferMultiIO.size();
 
-    typename std::map<std::wstring, Matrix<ElemType>*>::iterator iter;
-    for (iter = matrices.begin(); iter != matrices.end(); iter++)
+    for (auto iter = nodeDevices.begin(); iter != nodeDevices.end(); iter++)
     {
-        // dereference matrix that corresponds to key (input/output name) and
         // populate based on whether its a feature or a label
-        Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
+        DEVICEID_TYPE deviceId = iter->second;
 
         if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
         {
@@ -1376,12 +1585,16 @@ void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(std::map<std::wstring
 
             if (m_featuresBufferMultiIO[id] == nullptr || m_featuresBufferAllocatedMultiIO[id] < dim * m_mbNumTimeSteps * m_numSeqsPerMB)
             {
-                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                m_featuresBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                 memset(m_featuresBufferMultiIO[id].get(), 0, sizeof(ElemType) * dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                 m_featuresBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
             }
 
-            if (sizeof(ElemType) == sizeof(float))
+            if (m_numSeqsPerMB == 1) // (e.g. frame mode) the target columns are consecutive, too: copy all frames at once
+            {
+                memcpy_s(&m_featuresBufferMultiIO[id].get()[startFr * dim], sizeof(ElemType) * dim * framenum, &m_featuresBufferMultiUtt[sourceChannelIndex].get()[m_featuresStartIndexMultiUtt[id + sourceChannelIndex * numOfFea]], sizeof(ElemType) * dim * framenum);
+            }
+            else if (sizeof(ElemType) == sizeof(float))
             {
                 for (size_t j = 0, k = startFr; j < framenum; j++, k++) // column major, so iterate columns
                 {
@@ -1406,16 +1619,23 @@ void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(std::map<std::wstring
             dim = m_labelNameToDimMap[iter->first];
             if (m_labelsBufferMultiIO[id] == nullptr || m_labelsBufferAllocatedMultiIO[id] < dim * m_mbNumTimeSteps * m_numSeqsPerMB)
             {
-                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(data.GetDeviceId(), dim * m_mbNumTimeSteps * m_numSeqsPerMB);
+                m_labelsBufferMultiIO[id] = AllocateIntermediateBuffer(deviceId, dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                 memset(m_labelsBufferMultiIO[id].get(), 0, sizeof(ElemType) * dim * m_mbNumTimeSteps * m_numSeqsPerMB);
                 m_labelsBufferAllocatedMultiIO[id] = dim * m_mbNumTimeSteps * m_numSeqsPerMB;
             }
 
-            for (size_t j = 0, k = startFr; j < framenum; j++, k++)
+            if (m_numSeqsPerMB == 1)
+            {
+                memcpy_s(&m_labelsBufferMultiIO[id].get()[startFr * dim], sizeof(ElemType) * dim * framenum, &m_labelsBufferMultiUtt[sourceChannelIndex].get()[m_labelsStartIndexMultiUtt[id + sourceChannelIndex * numOfLabel]], sizeof(ElemType) * dim * framenum);
+            }
+            else
             {
-                for (int d = 0; d < dim; d++)
+                for (size_t j = 0, k = startFr; j < framenum; j++, k++)
                 {
-                    m_labelsBufferMultiIO[id].get()[(k * m_numSeqsPerMB + channelIndex) * dim + d] = m_labelsBufferMultiUtt[sourceChannelIndex].get()[j * dim + d + m_labelsStartIndexMultiUtt[id + sourceChannelIndex * numOfLabel]];
+                    for (int d = 0; d < dim; d++)
+                    {
+                        m_labelsBufferMultiIO[id].get()[(k * m_numSeqsPerMB + channelIndex) * dim + d] = m_labelsBufferMultiUtt[sourceChannelIndex].get()[j * dim + d + m_labelsStartIndexMultiUtt[id + sourceChannelIndex * numOfLabel]];
+                    }
                 }
             }
         }
@@ -1541,6 +1761,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToWrite(std::map<std::wstring, Matrix<E
 template <class ElemType>
 bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
 {
+    m_bufferPosition[i] = m_mbiter->currentmbstartframe() - m_mbiter->range().first; // (at end of epoch, where a seek ends it again)
     if (m_noData)
     {
         if ((i == 0) && !m_truncated)
@@ -1606,8 +1827,10 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
         }
         assert(actualmbsizeOri == m_mbiter->currentmbframes());
 
+        // (in frame mode, a minibatch of frames at once: the columns are copied in parallel)
         if (sizeof(ElemType) == sizeof(float))
         {
+#pragma omp parallel for schedule(static) if (actualmbsizeOri > 256)
             for (int k = 0; k < actualmbsizeOri; k++) // column major, so iterate columns
             {
                 // copy over the entire column at once, need to do this because SSEMatrix may have gaps at the end of the columns
@@ -1616,6 +1839,7 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
         }
         else
         {
+#pragma omp parallel for schedule(static) if (actualmbsizeOri > 256)
             for (int k = 0; k < actualmbsizeOri; k++) // column major, so iterate columns in outside loop
             {
                 for (int d = 0; d < featOri.rows(); d++)
@@ -1648,6 +1872,11 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
                 }
             }
         }
+        else if (m_labelsAsIndicesMultiIO[id]) // (dim is 1)
+        {
+            for (int k = 0; k < actualmbsizeOri; k++)
+                m_labelsBufferMultiUtt[i].get()[k + m_labelsStartIndexMultiUtt[id + i * numOfLabel]] = (ElemType) uids[k];
+        }
         else
         {
             // loop through the columns and set one value to 1
@@ -1802,7 +2031,7 @@ bool HTKMLFReader<ElemType>::DataEnd(EndDataType endDataType)
         break;
     case endDataSentence:
         if (m_truncated)
-            ret = m_sentenceEnd[0];
+            ret = m_readingAhead ? m_current.sentenceEnd[0] : m_sentenceEnd[0];
         else
             ret = true; // useless in current condition
         break;
@@ -1813,24 +2042,26 @@ bool HTKMLFReader<ElemType>::DataEnd(EndDataType endDataType)
 template <class ElemType>
 void HTKMLFReader<ElemType>::SetSentenceEndInBatch(vector<size_t>& sentenceEnd)
 {
-    sentenceEnd.resize(m_switchFrame.size());
-    for (size_t i = 0; i < m_switchFrame.size(); i++)
-        sentenceEnd[i] = m_switchFrame[i];
+    const vector<size_t>& switchFrame = m_readingAhead ? m_current.switchFrame : m_switchFrame;
+    sentenceEnd.resize(switchFrame.size());
+    for (size_t i = 0; i < switchFrame.size(); i++)
+        sentenceEnd[i] = switchFrame[i];
 }
 
 template <class ElemType>
 void HTKMLFReader<ElemType>::CopyMBLayoutTo(MBLayoutPtr pMBLayout)
 {
-    pMBLayout->CopyFrom(m_pMBLayout);
+    pMBLayout->CopyFrom(m_readingAhead ? m_current.pMBLayout : m_pMBLayout);
 }
 
 template <class ElemType>
 size_t HTKMLFReader<ElemType>::GetNumParallelSequences()
 {
+    const MBLayoutPtr& pMBLayout = m_readingAhead ? m_current.pMBLayout : m_pMBLayout;
     if (!m_frameMode)
-        if (m_numSeqsPerMB != m_pMBLayout->GetNumParallelSequences())
+        if (m_numSeqsPerMB != pMBLayout->GetNumParallelSequences())
             LogicError("HTKMLFReader: Number of parallel sequences in m_pMBLayout did not get set to m_numSeqsPerMB.");
-    return m_pMBLayout->GetNumParallelSequences(); // (this function is only used for validation anyway)
+    return pMBLayout->GetNumParallelSequences(); // (this function is only used for validation anyway)
 }
 
 // GetFileConfigNames - determine the names of the features and labels sections in the config file
@@ -1889,6 +2120,50 @@ void HTKMLFReader<ElemType>::ExpandDotDotDot(wstring& featPath, const wstring& s
         featPath = featPath.substr(0, pos) + scpDirCached + featPath.substr(pos + 3);
 }
 
+// read the entries of a script file (up to 'firstFilesOnly' + 1 of them, for testing)
+// The file is read in one go and the lines are converted in parallel, which matters for scripts with millions of
+// entries. Lines end as for textreader: LF, CRLF, or CR.
+template <class ElemType>
+/*static*/ vector<wstring> HTKMLFReader<ElemType>::ReadScriptFile(const wstring& scriptPath, size_t firstFilesOnly)
+{
+    vector<char> buffer;
+    {
+        auto_file_ptr f(fopenOrDie(scriptPath, L"rb"));
+        freadOrDie(buffer, filesize(f), f);
+    }
+
+    vector<pair<size_t, size_t>> lines; // [begin, end) in 'buffer'
+    for (size_t pos = 0; pos < buffer.size() && lines.size() <= firstFilesOnly;)
+    {
+        size_t end = pos;
+        while (end < buffer.size() && buffer[end] != '\n' && buffer[end] != '\r')
+            end++;
+        lines.push_back(make_pair(pos, end));
+        pos = end;
+        if (pos < buffer.size() && buffer[pos++] == '\r' && pos < buffer.size() && buffer[pos] == '\n')
+            pos++;
+    }
+
+    vector<wstring> filelist(lines.size());
+    std::exception_ptr error;
+#pragma omp parallel for
+    for (int i = 0; i < (int) lines.size(); i++)
+    {
+        try
+        {
+            filelist[i] = msra::strfun::utf16(string(buffer.data() + lines[i].first, lines[i].second - lines[i].first));
+        }
+        catch (...) // (an exception must not leave the parallel region)
+        {
+#pragma omp critical
+            error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+    return filelist;
+}
+
 template <class ElemType>
 unique_ptr<CUDAPageLockedMemAllocator>& HTKMLFReader<ElemType>::GetCUDAAllocator(int deviceID)
 {
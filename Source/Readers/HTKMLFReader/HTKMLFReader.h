@@ -8,6 +8,10 @@
 #include "DataReader.h"
 #include "Config.h" // for intargvector
 #include "CUDAPageLockedMemAllocator.h"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -28,6 +32,8 @@ private:
     bool m_truncated;
     bool m_frameMode;
     vector<size_t> m_processedFrame; // [seq index] (truncated BPTT only) current time step (cursor)
+    vector<size_t> m_bufferPosition; // [seq index] position in the epoch (frames into it) of the utterance held for each parallel sequence
+    size_t m_samplePosition;         // position of the next minibatch, see GetCurrentSamplePosition()
     intargvector m_numSeqsPerMBForAllEpochs;
     size_t m_numSeqsPerMB;      // requested number of parallel sequences
     size_t m_mbNumTimeSteps;    // number of time steps  to fill/filled (note: for frame randomization, this the #frames, and not 1 as later reported)
@@ -41,6 +47,10 @@ private:
     size_t m_extraNumSeqs;
     bool m_noData;
     bool m_trainOrTest; // if false, in file writing mode
+
+    // set during StartDynamicDistributedMinibatchLoop(): blocks of the epoch are claimed through m_nextWorkItem (0: no dynamic distribution)
+    std::function<size_t()> m_nextWorkItem;
+    size_t m_workItemSize;
     using LabelType = typename IDataReader<ElemType>::LabelType;
     using LabelIdType = typename IDataReader<ElemType>::LabelIdType;
 
@@ -82,6 +92,7 @@ private:
     bool m_checkDictionaryKeys;
     bool m_convertLabelsToTargets;
     std::vector<bool> m_convertLabelsToTargetsMultiIO;
+    std::vector<bool> m_labelsAsIndicesMultiIO; // labelType=index: one row with the class index per frame, instead of one-hot
     std::vector<std::vector<std::wstring>> m_inputFilesMultiIO;
 
     size_t m_inputFileIndex;
@@ -92,14 +103,60 @@ private:
 
     int m_verbosity;
 
+    // Read-ahead (readAhead=true): while the network trains on one minibatch, a background thread assembles the next
+    // one (advancing m_mbiter and copying the utterance stripes into the buffers above), so that GetMinibatch() only
+    // needs to copy the ready buffers to the device. Since the buffers are page-locked, that copy is queued on a transfer
+    // stream without blocking (matrixFlagSetValueAsync); a buffer pair goes back to the thread only after its upload has
+    // completed, so that the two pairs form a ring that the thread fills while the other is being uploaded. Finished minibatches are swapped out of the buffers above
+    // together with everything the accessors report about them (layout, sentence ends, lattices).
+    struct MinibatchBuffers
+    {
+        std::vector<std::shared_ptr<ElemType>> features; // [feature id], as m_featuresBufferMultiIO
+        std::vector<size_t> featuresAllocated;
+        std::vector<std::shared_ptr<ElemType>> labels; // [label id], as m_labelsBufferMultiIO
+        std::vector<size_t> labelsAllocated;
+        MBLayoutPtr pMBLayout;
+        vector<bool> sentenceEnd;
+        vector<size_t> switchFrame;
+        std::vector<shared_ptr<const msra::dbn::latticepair>> extraLattices;
+        std::vector<std::vector<size_t>> extraLabelsIDs;
+        std::vector<std::vector<size_t>> extraPhoneboundaryIDs;
+        std::vector<size_t> extraSeqsPerMB;
+        size_t samplePosition;
+        bool hasData; // false at end of epoch
+        std::exception_ptr error;
+    };
+
+    bool m_readAhead;
+    bool m_readAheadThisEpoch;                            // not with dynamic distribution, which talks to MPI from the reading thread
+    bool m_readingAhead;                                  // the thread owns the reader state; accessors use m_current
+    std::map<std::wstring, DEVICEID_TYPE> m_nodeDevices; // of the requested inputs, for allocating the buffers
+    MinibatchBuffers m_current;                           // returned by the last GetMinibatch()
+    MinibatchBuffers m_next;                              // ready (if m_nextReady), or to be recycled by the thread
+    bool m_nextReady;
+    bool m_stopReadAhead;
+    std::thread m_readAheadThread;
+    std::mutex m_readAheadMutex;
+    std::condition_variable m_nextConsumed;
+    std::condition_variable m_nextFilled;
+
+    void StartReadAhead();
+    void StopReadAhead();
+    void ReadAhead();
+    void SwapMinibatchBuffers(MinibatchBuffers& buffers);
+    void CopyMinibatchToMatrices(std::map<std::wstring, Matrix<ElemType>*>& matrices, const std::vector<std::shared_ptr<ElemType>>& features,
+                                 const std::vector<std::shared_ptr<ElemType>>& labels, size_t numCols, bool async);
+    void WaitForAsyncUploads();
+
     template <class ConfigRecordType>
     void PrepareForTrainingOrTesting(const ConfigRecordType& config);
     template <class ConfigRecordType>
     void PrepareForWriting(const ConfigRecordType& config);
 
     bool GetMinibatchToTrainOrTest(std::map<std::wstring, Matrix<ElemType>*>& matrices);
+    bool ReadMinibatchToTrainOrTest(const std::map<std::wstring, DEVICEID_TYPE>& nodeDevices);
     bool GetMinibatch4SEToTrainOrTest(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, std::vector<size_t>& extrauttmap);
-    void fillOneUttDataforParallelmode(std::map<std::wstring, Matrix<ElemType>*>& matrices, size_t startFr, size_t framenum, size_t channelIndex, size_t sourceChannelIndex);
+    void fillOneUttDataforParallelmode(const std::map<std::wstring, DEVICEID_TYPE>& nodeDevices, size_t startFr, size_t framenum, size_t channelIndex, size_t sourceChannelIndex);
     bool GetMinibatchToWrite(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     void StartMinibatchLoopToTrainOrTest(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize);
@@ -109,6 +166,10 @@ private:
 
     size_t GetNumParallelSequences();
     void SetNumParallelSequences(const size_t){};
+    bool SupportsConcurrentRead() const override
+    {
+        return true;
+    }
 
     template <class ConfigRecordType>
     void GetDataNamesFromConfig(const ConfigRecordType& readerConfig, std::vector<std::wstring>& features, std::vector<std::wstring>& labels,
@@ -117,6 +178,7 @@ private:
     size_t ReadLabelToTargetMappingFile(const std::wstring& labelToTargetMappingFile, const std::wstring& labelListFile, std::vector<std::vector<ElemType>>& labelToTargetMap);
 
     void ExpandDotDotDot(wstring& featPath, const wstring& scpPath, wstring& scpDirCached);
+    static vector<wstring> ReadScriptFile(const wstring& scriptPath, size_t firstFilesOnly);
 
     enum InputOutputTypes
     {
@@ -140,7 +202,7 @@ public:
     // TODO: this ^^ does not seem to belong here.
 
     HTKMLFReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_samplePosition(0), m_workItemSize(0), m_readAhead(false), m_readAheadThisEpoch(false), m_readingAhead(false), m_nextReady(false), m_stopReadAhead(false)
     {
     }
     template <class ConfigRecordType>
@@ -159,6 +221,7 @@ public:
     }
     virtual ~HTKMLFReader()
     {
+        StopReadAhead();
     }
 
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize)
@@ -173,6 +236,27 @@ public:
 
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
 
+    virtual bool SupportsDynamicDistributedMBRead() const override
+    {
+        return SupportsDistributedMBRead() && m_trainOrTest;
+    }
+
+    virtual void StartDynamicDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets,
+                                                      const std::function<size_t()>& nextWorkItem, size_t workItemSize, size_t requestedEpochSamples = requestDataSize) override;
+
+    // Mid-epoch checkpoints: the sample position is the frame in the epoch's randomized timeline at which the next minibatch
+    // starts. Only when a minibatch is a single utterance (or a block of frames) does the reader hold nothing else at that
+    // point, so that starting over from there continues the epoch exactly; with parallel or truncated sequences, it does not.
+    virtual bool SupportsSamplePositionSeek() const override
+    {
+        return m_trainOrTest && m_frameSource && !m_truncated && (m_numSeqsPerMB == 1);
+    }
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_readingAhead ? m_current.samplePosition : m_samplePosition;
+    }
+    virtual void SetCurrentSamplePosition(size_t samplePosition) override;
+
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
     virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName);
     virtual void SetLabelMapping(const std::wstring& sectionName, const std::map<LabelIdType, LabelType>& labelMapping);
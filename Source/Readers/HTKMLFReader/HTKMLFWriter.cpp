@@ -39,6 +39,8 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     size_t numFiles;
     size_t firstfilesonly = SIZE_MAX; // set to a lower value for testing
 
+    sampPeriod = 100000;
+
     vector<wstring> outputNames = writerConfig(L"outputNodeNames", ConfigRecordType::Array(stringargvector()));
     if (outputNames.size() < 1)
         RuntimeError("writer needs at least one outputNodeName specified in config");
@@ -69,6 +71,26 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
         {
             RuntimeError("HTKMLFWriter::Init: output type for writer output expected to be Real");
         }
+
+        // archive="path" writes all utterances into one file, and their index to archiveIndex (default: path.scp)
+        // instead of one file per scp entry. (Compression is not supported by the HTK reader, so there is none.)
+        quantizeOutputs.push_back(thisOutput(L"quantize", false));
+        wstring archivePath = thisOutput(L"archive", "");
+        archivePaths.push_back(archivePath);
+        archiveWriters.push_back(nullptr);
+        archiveIndexFiles.push_back(nullptr);
+        archiveFrames.push_back(0);
+        if (!archivePath.empty())
+        {
+            if (quantizeOutputs[i])
+                InvalidArgument("HTKMLFWriter::Init: 'quantize' is not supported for archives, since the scale of each dimension is taken from the whole file.");
+            wstring indexPath = thisOutput.Exists("archiveIndex") ? (wstring) thisOutput(L"archiveIndex") : archivePath + L".scp";
+            msra::files::make_intermediate_dirs(archivePath);
+            msra::files::make_intermediate_dirs(indexPath);
+            archiveWriters[i] = make_shared<msra::asr::htkfeatwriter>(archivePath, "USER", udims[i], sampPeriod);
+            archiveIndexFiles[i] = fopenOrDie(indexPath, L"wt");
+            fprintf(stderr, "HTKMLFWriter::Init: writing output %ls to archive %ls, index %ls\n", outputNames[i].c_str(), archivePath.c_str(), indexPath.c_str());
+        }
     }
 
     numFiles = 0;
@@ -94,12 +116,28 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
         outputFiles.push_back(filelist);
     }
     outputFileIndex = 0;
-    sampPeriod = 100000;
+}
+
+// finish the archives: the frame count in the header is only known now
+template <class ElemType>
+void HTKMLFWriter<ElemType>::CloseArchives()
+{
+    foreach_index (id, archiveWriters)
+    {
+        if (!archiveWriters[id])
+            continue;
+        archiveWriters[id]->close(archiveFrames[id]);
+        archiveWriters[id].reset();
+        fcloseOrDie(archiveIndexFiles[id]);
+        archiveIndexFiles[id] = nullptr;
+        fprintf(stderr, "HTKMLFWriter: wrote %d frames to archive %ls\n", (int) archiveFrames[id], archivePaths[id].c_str());
+    }
 }
 
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    CloseArchives();
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
@@ -129,7 +167,7 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
         assert(outputData.GetNumRows() == dim);
         dim;
 
-        Save(outFile, outputData);
+        Save(id, outFile, outputData);
     }
 
     outputFileIndex++;
@@ -138,7 +176,7 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
 }
 
 template <class ElemType>
-void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& outputData)
+void HTKMLFWriter<ElemType>::Save(size_t id, std::wstring& outputFile, Matrix<ElemType>& outputData)
 {
     msra::dbn::matrix output;
     output.resize(outputData.GetNumRows(), outputData.GetNumCols());
@@ -156,11 +194,37 @@ void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& ou
     const size_t nansinf = output.countnaninf();
     if (nansinf > 0)
         fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
+
+    if (archiveWriters[id])
+    {
+        // append the frames; the scp entry is the logical name of the utterance in the index
+        if (output.cols() == 0)
+        {
+            fprintf(stderr, "evaluate: skipping %ls, which has no frames\n", outputFile.c_str());
+            return;
+        }
+        if (archiveFrames[id] + output.cols() > INT_MAX)
+            RuntimeError("HTKMLFWriter: Archive %ls exceeds the maximum number of frames of an HTK file.", archivePaths[id].c_str());
+        m_frame.resize(output.rows());
+        for (size_t j = 0; j < output.cols(); j++)
+        {
+            for (size_t i = 0; i < output.rows(); i++)
+                m_frame[i] = output(i, j);
+            archiveWriters[id]->write(m_frame);
+        }
+        fprintfOrDie(archiveIndexFiles[id], "%ls=%ls[%d,%d]\n", outputFile.c_str(), archivePaths[id].c_str(), (int) archiveFrames[id], (int) (archiveFrames[id] + output.cols() - 1));
+        archiveFrames[id] += output.cols();
+        return;
+    }
+
     // save it
     msra::files::make_intermediate_dirs(outputFile);
     msra::util::attempt(5, [&]()
                         {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
+                            if (quantizeOutputs[id])
+                                msra::asr::htkfeatwriter::writequantized(outputFile, "USER", this->sampPeriod, output);
+                            else
+                                msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
                         });
 
     fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
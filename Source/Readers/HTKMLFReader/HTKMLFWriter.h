@@ -8,8 +8,13 @@
 #include "DataWriter.h"
 #include "ScriptableObjects.h"
 #include <map>
+#include <memory>
 #include <vector>
 
+namespace msra { namespace asr {
+class htkfeatwriter;
+} }
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
@@ -25,10 +30,20 @@ private:
     std::map<std::wstring, size_t> outputNameToTypeMap;
     unsigned int sampPeriod;
     size_t outputFileIndex;
-    void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
+    void Save(size_t id, std::wstring& outputFile, Matrix<ElemType>& outputData);
     ElemType* m_tempArray;
     size_t m_tempArraySize;
 
+    // archive mode: all utterances of an output are appended to one HTK file, and the output's scp entries become
+    // index lines 'name=archive[start,end]' that the reader takes as input
+    std::vector<std::wstring> archivePaths;                                // [id]; empty: one file per utterance
+    std::vector<std::shared_ptr<msra::asr::htkfeatwriter>> archiveWriters; // [id]
+    std::vector<FILE*> archiveIndexFiles;                                  // [id]
+    std::vector<size_t> archiveFrames;                                     // [id] frames written so far
+    std::vector<float> m_frame;
+    std::vector<bool> quantizeOutputs; // [id] write 8-bit quantized files (see htkfeatio::quantizedmagic())
+    void CloseArchives();
+
     enum OutputTypes
     {
         outputReal,
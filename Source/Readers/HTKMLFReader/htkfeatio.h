@@ -21,7 +21,16 @@
 #include <wchar.h>
 #include "simplesenonehmm.h"
 #include <array>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "minibatchsourcehelpers.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace msra { namespace asr {
 
@@ -137,6 +146,15 @@ protected:
     static const int HASZEROC = 020000;  // _0 0'th Cepstra included
     static const int HASVQ = 040000;     // _V has VQ index attached
     static const int HASTHIRD = 0100000; // _T has Delta-Delta-Delta index attached
+
+    // 8-bit quantized features (our own extension, a quarter of the size of floats): the file starts with this magic,
+    // followed by a regular HTK header with sampsize = dim bytes, then the per-dimension a and b, then one byte per
+    // value; values are decompressed as (byte + b) / a, like HTK's 16-bit compression. Frames stay randomly accessible,
+    // so these files can be archives read with the a=b[s,e] syntax.
+    static const char* quantizedmagic()
+    {
+        return "CNTK-Q8"; // (8 bytes with the terminating 0)
+    }
 };
 
 // ===========================================================================
@@ -150,7 +168,7 @@ class htkfeatwriter : protected htkfeatio
     vector<float> tmp;
 
 public:
-    short parsekind(const string& str)
+    static short parsekind(const string& str)
     {
         vector<string> params = msra::strfun::split(str, ";");
         if (params.empty())
@@ -302,6 +320,55 @@ public:
         // rename to final destination
         // (This would only fail in strange circumstances such as accidental multiple processes writing to the same file.)
         renameOrDie(tmppath, path);
+#endif
+    }
+    // write an entire utterance in the 8-bit quantized format (see quantizedmagic())
+    // Each dimension is scaled linearly from its range within the utterance to [0,255].
+    template <class MATRIX>
+    static void writequantized(const wstring& path, const string& kindstr, unsigned int period, const MATRIX& feat)
+    {
+        wstring tmppath = path + L"$$"; // tmp path for make-mode compliant
+        unlinkOrDie(path);              // delete if old file is already there
+        size_t featdim = feat.rows();
+        size_t numframes = feat.cols();
+        if (featdim > SHRT_MAX || numframes > INT_MAX)
+            RuntimeError("writequantized: utterance too large for an HTK header");
+        vector<float> a(featdim, 1.0f), b(featdim, 0.0f);
+        for (size_t k = 0; k < featdim && numframes > 0; k++)
+        {
+            float minval = feat(k, 0), maxval = feat(k, 0);
+            for (size_t t = 1; t < numframes; t++)
+            {
+                minval = min(minval, (float) feat(k, t));
+                maxval = max(maxval, (float) feat(k, t));
+            }
+            if (maxval > minval)
+                a[k] = 255.0f / (maxval - minval);
+            b[k] = minval * a[k];
+        }
+        vector<unsigned char> values(featdim * numframes);
+        for (size_t t = 0; t < numframes; t++)
+            for (size_t k = 0; k < featdim; k++)
+                values[t * featdim + k] = (unsigned char) max(0.0f, min(255.0f, floorf(feat(k, t) * a[k] - b[k] + 0.5f)));
+        // write it out, in HTK byte order
+        fileheader H;
+        H.nsamples = (int) numframes;
+        H.sampperiod = period;
+        H.sampsize = (short) featdim;
+        H.sampkind = parsekind(kindstr);
+        H.byteswap();
+        msra::util::byteswap(a);
+        msra::util::byteswap(b);
+        auto_file_ptr f(fopenOrDie(tmppath, L"wbS"));
+        fwriteOrDie(quantizedmagic(), 1, 8, f);
+        H.write(f);
+        fwriteOrDie(a, f);
+        fwriteOrDie(b, f);
+        fwriteOrDie(values, f);
+        fflushOrDie(f);
+        f = NULL;
+#ifdef _WIN32 // BUGBUG: and on Linux??
+        renameOrDie(tmppath, path);
 #endif
     }
 };
@@ -317,6 +384,116 @@ public:
 // are sequential anyway. In conjunction with a big buffer, this makes a huge difference.
 // ===========================================================================
 
+// ===========================================================================
+// mappedfile -- read-only memory mapping of an entire feature file
+// The pages come straight from the OS page cache, which is shared by all processes that map the same file,
+// e.g. several training processes on one machine. Use mappedfile::map() to share one mapping per file in a process.
+// ===========================================================================
+
+class mappedfile
+{
+    mappedfile(const mappedfile&);
+    void operator=(const mappedfile&);
+
+    const char* p; // start of mapped file
+    uint64_t size; // size of file in bytes
+#ifdef _WIN32
+    HANDLE hfile, hmapping;
+#endif
+
+public:
+    mappedfile(const wstring& path)
+        : p(nullptr), size(0)
+    {
+#ifdef _WIN32
+        hmapping = NULL;
+        hfile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hfile == INVALID_HANDLE_VALUE)
+            RuntimeError("mappedfile: cannot open '%ls', error 0x%x", path.c_str(), GetLastError());
+        LARGE_INTEGER filesize;
+        if (GetFileSizeEx(hfile, &filesize))
+            size = filesize.QuadPart;
+        if (size > 0)
+        {
+            hmapping = CreateFileMapping(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (hmapping != NULL)
+                p = (const char*) MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0);
+            if (p == nullptr)
+            {
+                DWORD error = GetLastError();
+                unmap();
+                RuntimeError("mappedfile: cannot map '%ls', error 0x%x", path.c_str(), error);
+            }
+        }
+#else
+        int fd = open(wtocharpath(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("mappedfile: cannot open '%ls': %s", path.c_str(), strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+            size = st.st_size;
+        if (size > 0)
+            p = (const char*) mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // (the mapping keeps the file referenced)
+        if (p == MAP_FAILED)
+        {
+            p = nullptr;
+            RuntimeError("mappedfile: cannot map '%ls': %s", path.c_str(), strerror(errno));
+        }
+#endif
+    }
+    ~mappedfile()
+    {
+        unmap();
+    }
+
+    // get the process-wide mapping of a file, mapping it if it is not mapped at the moment
+    static shared_ptr<const mappedfile> map(const wstring& path)
+    {
+        static std::mutex mutex;
+        static std::map<wstring, weak_ptr<const mappedfile>> mappings;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto mapping = mappings[path].lock();
+        if (!mapping)
+        {
+            mapping = make_shared<mappedfile>(path);
+            mappings[path] = mapping;
+        }
+        return mapping;
+    }
+
+    // get 'n' bytes at byte offset 'offset'
+    // This starts reading the pages ahead, so that the first accesses do not fault them in one by one.
+    const char* getdata(uint64_t offset, uint64_t n) const
+    {
+        if (offset + n > size)
+            RuntimeError("mappedfile: range [%llu, %llu) is beyond end of file (%llu bytes)", (unsigned long long) offset, (unsigned long long) (offset + n), (unsigned long long) size);
+#ifndef _WIN32
+        const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+        const uint64_t pagebegin = offset / pagesize * pagesize;
+        madvise((void*) (p + pagebegin), (size_t) (offset + n - pagebegin), MADV_WILLNEED); // (only a hint)
+#endif
+        return p + offset;
+    }
+
+private:
+    void unmap()
+    {
+#ifdef _WIN32
+        if (p)
+            UnmapViewOfFile(p);
+        if (hmapping != NULL)
+            CloseHandle(hmapping);
+        if (hfile != INVALID_HANDLE_VALUE)
+            CloseHandle(hfile);
+#else
+        if (p)
+            munmap((void*) p, size);
+#endif
+        p = nullptr;
+    }
+};
+
 class htkfeatreader : protected htkfeatio
 {
     // information on current file
@@ -329,6 +506,7 @@ class htkfeatreader : protected htkfeatio
 
     bool addEnergy;                      // add in energy as data is read (will all have zero values)
     bool compressed;                     // is compressed to 16-bit values
+    bool quantized;                      // is quantized to 8-bit values (our own format, see htkfeatio::quantizedmagic())
     bool hascrcc;                        // need to skip crcc
     vector<float> a, b;                  // for decompression
     vector<short> tmp;                   // for decompression
@@ -336,6 +514,8 @@ class htkfeatreader : protected htkfeatio
     size_t curframe;                     // current # samples read so far
     size_t numframes;                    // number of samples for current logical file
     size_t energyElements;               // how many energy elements to add if addEnergy is true
+    shared_ptr<const mappedfile> currentmapping; // mapping last returned by map()
+    wstring mappedpath;                          // ...and its physical path
 
 public:
     // parser for complex a=b[s,e] syntax
@@ -365,6 +545,11 @@ public:
         }
 
     public:
+        parsedpath() // (for arrays that are filled in later)
+            : s(0), e(0), isarchive(false), isidxformat(false)
+        {
+        }
+
         // constructor parses a=b[s,e] syntax and fills in the file
         // Can be used implicitly e.g. by passing a string to open().
         parsedpath(const wstring& pathParam)
@@ -444,8 +629,16 @@ private:
         // read the header (12 bytes for htk feature files)
         fileheader H;
         isidxformat = ppath.isidxformat;
+        bool quantized = false;
         if (!isidxformat)
+        {
+            char magic[8];
+            freadOrDie(magic, 1, sizeof(magic), f);
+            quantized = memcmp(magic, quantizedmagic(), sizeof(magic)) == 0;
+            if (!quantized) // a regular HTK file
+                fsetpos(f, (uint64_t) 0);
             H.read(f);
+        }
         else // read header of idxfile
             H.idxRead(f);
 
@@ -489,6 +682,8 @@ private:
         if (H.sampkind & HASTHIRD)
             kind += "_T";
         bool compressed = (H.sampkind & HASCOMPX) != 0;
+        if (compressed && quantized)
+            RuntimeError("htkfeatreader: quantized file '%ls' must not be HTK-compressed", physpath.c_str());
         bool hascrcc = (H.sampkind & HASCRCC) != 0;
         if (H.sampkind & HASZEROM)
             kind += "_Z";
@@ -507,7 +702,7 @@ private:
         }
 
         // other checks
-        size_t bytesPerValue = isidxformat ? 1 : (compressed ? sizeof(short) : sizeof(float));
+        size_t bytesPerValue = (isidxformat || quantized) ? 1 : (compressed ? sizeof(short) : sizeof(float));
 
         if (H.sampsize % bytesPerValue != 0)
             RuntimeError("htkfeatreader:sample size not multiple of dimension");
@@ -515,11 +710,12 @@ private:
 
         // read the values for decompressing
         vector<float> a, b;
-        if (compressed)
+        if (compressed || quantized)
         {
             freadOrDie(a, dim, f);
             freadOrDie(b, dim, f);
-            H.nsamples -= 4; // these are counted as 4 frames--that's the space they use
+            if (compressed)
+                H.nsamples -= 4; // these are counted as 4 frames--that's the space they use
             if (needbyteswapping)
             {
                 msra::util::byteswap(a);
@@ -536,6 +732,7 @@ private:
         this->f.swap(f); // note: this will get the previous f auto-closed at the end of this function
         this->needbyteswapping = needbyteswapping;
         this->compressed = compressed;
+        this->quantized = quantized;
         this->a.swap(a);
         this->b.swap(b);
         this->vecbytesize = H.sampsize;
@@ -619,7 +816,7 @@ public:
     {
         if (curframe >= numframes)
             RuntimeError("htkfeatreader:attempted to read beyond end");
-        if (!compressed && !isidxformat) // not compressed--the easy one
+        if (!compressed && !quantized && !isidxformat) // not compressed--the easy one
         {
             freadOrDie(v, featdim, f);
             if (needbyteswapping)
@@ -633,6 +830,13 @@ public:
             foreach_index (k, v)
                 v[k] = (float) tmpByteVector[k];
         }
+        else if (quantized)
+        {
+            freadOrDie(tmpByteVector, featdim, f);
+            v.resize(featdim);
+            foreach_index (k, v)
+                v[k] = (tmpByteVector[k] + b[k]) / a[k];
+        }
         else // need to decompress
         {
             // read into temp vector
@@ -650,6 +854,33 @@ public:
     template <class MATRIX>
     void read(MATRIX& feat, size_t ts, size_t te)
     {
+        // compressed frames: read the range in one go, and decompress the frames in parallel
+        if ((compressed || quantized) && !addEnergy)
+        {
+            const size_t n = te - ts;
+            if (curframe + n > numframes)
+                RuntimeError("htkfeatreader:attempted to read beyond end");
+            if (quantized)
+                freadOrDie(tmpByteVector, featdim * n, f);
+            else
+            {
+                freadOrDie(tmp, featdim * n, f);
+                if (needbyteswapping)
+                    msra::util::byteswap(tmp);
+            }
+            const size_t dim = featdim;
+#pragma omp parallel for if (n * dim >= 100000)
+            for (long long t = 0; t < (long long) n; t++)
+            {
+                for (size_t k = 0; k < dim; k++)
+                {
+                    const float value = quantized ? tmpByteVector[t * dim + k] : tmp[t * dim + k];
+                    feat(k, ts + t) = (value + b[k]) / a[k];
+                }
+            }
+            curframe += n;
+            return;
+        }
         // read vectors from file and push to our target structure
         vector<float> v(featdim + energyElements);
         for (size_t t = ts; t < te; t++)
@@ -694,6 +925,31 @@ public:
             throw;
         }
     }
+    // map an entire utterance directly from the file, without copying, if the file allows it
+    // Returns false, and the caller should read() it instead, unless the data are stored as uncompressed floats in
+    // native byte order, and no energy elements are to be added. On success, the frames are at 'data' with a
+    // stride of 'dim' floats, and stay valid as long as 'mapping' is held.
+    bool map(const parsedpath& ppath, const string& kindstr, const unsigned int period, const size_t dim, shared_ptr<const mappedfile>& mapping, const float*& data)
+    {
+        // open the file to get its format and the range (we will not read from it)
+        size_t numframes = open(ppath);
+        if (dim != featdim + energyElements)
+            LogicError("map: called with wrong dimension");
+        if (kindstr != featkind || period != featperiod)
+            LogicError("map: attempting to mixing different feature kinds");
+        if (compressed || quantized || isidxformat || needbyteswapping || addEnergy || vecbytesize != featdim * sizeof(float))
+            return false;
+
+        if (!currentmapping || physicalpath != mappedpath) // (consecutive utterances mostly come from the same archive)
+        {
+            currentmapping = mappedfile::map(physicalpath);
+            mappedpath = physicalpath;
+        }
+        const uint64_t dataoffset = physicaldatastart + (ppath.isarchive ? ppath.s * vecbytesize : 0);
+        data = (const float*) currentmapping->getdata(dataoffset, numframes * vecbytesize);
+        mapping = currentmapping;
+        return true;
+    }
     // read an entire utterance into a virgen, allocatable matrix
     // Matrix type needs to have operator(i,j) and resize(n,m)
     template <class MATRIX>
@@ -767,7 +1023,7 @@ private:
 public:
     // parse format with original HTK state align MLF format and state list
     void parsewithstatelist(const vector<char*>& toks, const unordered_map<std::string, size_t>& statelisthash, const double htkTimeToFrame,
-                            std::unordered_map<std::string, size_t>& hmmnamehash)
+                            const std::unordered_map<std::string, size_t>& hmmnamehash)
     {
         size_t ts, te;
         parseframerange(toks, ts, te, htkTimeToFrame);
@@ -813,10 +1069,24 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
 {
     wstring curpath;                                 // for error messages
     unordered_map<std::string, size_t> statelistmap; // for state <=> index
+    size_t statelisthash;                            // (identifies the state list in the binary cache, see read())
     map<wstring, WORDSEQUENCE> wordsequences;        // [key] word sequences (if we are building word entries as well, for MMI)
     std::unordered_map<std::string, size_t> symmap;
 
-    void strtok(char* s, const char* delim, vector<char*>& toks)
+    // an MLF entry, parsed (possibly concurrently with others) but not yet added
+    struct parsedentry
+    {
+        wstring key; // (empty if skipped)
+        vector<ENTRY> entries;
+        WORDSEQUENCE wordsequence;
+        bool haswordsequence;
+        parsedentry()
+            : haswordsequence(false)
+        {
+        }
+    };
+
+    static void strtok(char* s, const char* delim, vector<char*>& toks)
     {
         toks.resize(0);
         char* context = nullptr;
@@ -844,11 +1114,11 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
         return lines;
     }
 
+    // parse one MLF entry into 'result'; this does not modify the reader, so entries can be parsed concurrently
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    void parseentry(const vector<std::string>& lines, size_t line, const set<wstring>& restricttokeys,
-                    const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
-                    vector<typename WORDSEQUENCE::word>& wordseqbuffer, vector<typename WORDSEQUENCE::aligninfo>& alignseqbuffer,
-                    const double htkTimeToFrame)
+    void parseentry(vector<std::string>& lines, size_t line, const set<wstring>& restricttokeys,
+                    const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, parsedentry& result,
+                    const double htkTimeToFrame) const
     {
         size_t idx = 0;
         string filename = lines[idx++];
@@ -881,17 +1151,16 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
         if (!restricttokeys.empty() && restricttokeys.find(key) == restricttokeys.end())
             return;
 
-        vector<ENTRY>& entries = (*this)[key]; // this creates a new entry
-        if (!entries.empty())
-            malformed(msra::strfun::strprintf("duplicate entry '%ls'", key.c_str()));
+        result.key = key;
+        vector<ENTRY>& entries = result.entries;
         entries.resize(e - s);
-        wordseqbuffer.resize(0);
-        alignseqbuffer.resize(0);
+        vector<typename WORDSEQUENCE::word>& wordseqbuffer = result.wordsequence.words;
+        vector<typename WORDSEQUENCE::aligninfo>& alignseqbuffer = result.wordsequence.align;
         vector<char*> toks;
         for (size_t i = s; i < e; i++)
         {
             // We can mutate the original string as it is no longer needed after tokenization
-            strtok(const_cast<char*>(lines[i].c_str()), " \t", toks);
+            strtok(&lines[i][0], " \t", toks);
             if (statelistmap.size() == 0)
                 entries[i - s].parse(toks, htkTimeToFrame);
             else
@@ -943,13 +1212,23 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
             }
             // if (sentstart < 0 || sentend < 0 || silence < 0)
             //    LogicError("parseentry: word map must contain !silence, !sent_start, and !sent_end");
-            // implant
-            auto& wordsequence = wordsequences[key]; // this creates the map entry
-            wordsequence.words = wordseqbuffer;      // makes a copy
-            wordsequence.align = alignseqbuffer;
+            result.haswordsequence = true; // (recorded in a separate map)
         }
     }
 
+    // add a parsed entry
+    void addentry(parsedentry& parsed)
+    {
+        if (parsed.key.empty())
+            return;
+        vector<ENTRY>& entries = (*this)[parsed.key]; // this creates a new entry
+        if (!entries.empty())
+            malformed(msra::strfun::strprintf("duplicate entry '%ls'", parsed.key.c_str()));
+        entries = std::move(parsed.entries);
+        if (parsed.haswordsequence)
+            wordsequences[parsed.key] = std::move(parsed.wordsequence); // this creates the map entry
+    }
+
 public:
     // return if input statename is sil state (hard code to compared first 3 chars with "sil")
     bool issilstate(const string& statename) const // (later use some configuration table)
@@ -976,6 +1255,7 @@ public:
 
     // constructor reads multiple MLF files
     htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath = L"", const double htkTimeToFrame = 100000.0)
+        : statelisthash(0)
     {
         // read state list
         if (stateListPath != L"")
@@ -988,8 +1268,11 @@ public:
 
     // alternate constructor that optionally also reads word alignments (for MMI training); triggered by providing a 'wordmap'
     // (We cannot use an optional arg in the constructor aboe because it interferes with teh template resolution.)
+    // With a 'cachedir', parsed MLFs are cached there in binary form, see read().
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame)
+    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame,
+                 const wstring& cachedir = wstring())
+        : statelisthash(0)
     {
         // read state list
         if (stateListPath != L"")
@@ -997,13 +1280,14 @@ public:
 
         // read MLF(s) --note: there can be multiple, so this is a loop
         foreach_index (i, paths)
-            read(paths[i], restricttokeys, wordmap, unitmap, htkTimeToFrame);
+            read(paths[i], restricttokeys, wordmap, unitmap, htkTimeToFrame, cachedir);
     }
 
     // phone boundary
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
     htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
                  const double htkTimeToFrame, const msra::asr::simplesenonehmm& hset)
+        : statelisthash(0)
     {
         if (stateListPath != L"")
             readstatelist(stateListPath);
@@ -1013,23 +1297,66 @@ public:
     }
 
     // note: this function is not designed to be pretty but to be fast
+    // The file is read in blocks and split into entries on this thread; the entries are parsed in batches, in parallel.
+    // With a 'cachedir', the parsed entries are also written there in binary form, which later runs read instead of
+    // the MLF as long as the MLF and the state list do not change. This is not done when reading word sequences or phone
+    // boundaries or when restricted to some keys.
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    void read(const wstring& path, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame)
+    void read(const wstring& path, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame,
+              const wstring& cachedir = wstring())
     {
         if (!restricttokeys.empty() && this->size() >= restricttokeys.size()) // no need to even read the file if we are there (we support multiple files)
             return;
 
+        wstring cachepath;
+        if (!cachedir.empty() && restricttokeys.empty() && !wordmap && symmap.empty())
+        {
+            cachepath = mlfcachepath(cachedir, path);
+            if (readcache(cachepath, path, htkTimeToFrame))
+                return;
+        }
+
         fprintf(stderr, "htkmlfreader: reading MLF file %ls ...", path.c_str());
         curpath = path; // for error messages only
+        const size_t numentriesbefore = this->size();
 
         auto_file_ptr f(fopenOrDie(path, L"rb"));
         std::string headerLine = fgetline(f);
         if (headerLine != "#!MLF!#")
             malformed("header missing");
 
+        // entries are collected and then parsed in batches, in parallel
+        const size_t parsebatchsize = 4096;
+        std::vector<std::vector<string>> pendingentries;
+        std::vector<size_t> pendinglinenums;
+        auto parsepending = [&]()
+        {
+            std::vector<parsedentry> parsed(pendingentries.size());
+            std::vector<std::exception_ptr> errors(pendingentries.size());
+#pragma omp parallel for schedule(dynamic, 64)
+            for (int k = 0; k < (int) pendingentries.size(); k++)
+            {
+                try
+                {
+                    parseentry(pendingentries[k], pendinglinenums[k], restricttokeys, wordmap, unitmap, parsed[k], htkTimeToFrame);
+                }
+                catch (...) // (an exception must not leave the parallel region)
+                {
+                    errors[k] = std::current_exception();
+                }
+            }
+            for (size_t k = 0; k < parsed.size(); k++)
+            {
+                if (errors[k])
+                    std::rethrow_exception(errors[k]);
+                if (restricttokeys.empty() || (this->size() < restricttokeys.size()))
+                    addentry(parsed[k]);
+            }
+            pendingentries.clear();
+            pendinglinenums.clear();
+        };
+
         // Read the file in blocks and parse MLF entries
-        std::vector<typename WORDSEQUENCE::word> wordsequencebuffer;
-        std::vector<typename WORDSEQUENCE::aligninfo> alignsequencebuffer;
         size_t readBlockSize = 1000000;
         std::vector<char> currBlockBuf(readBlockSize + 1);
         size_t currLineNum = 1;
@@ -1057,12 +1384,11 @@ public:
                 currMLFLines.push_back(mlfLine);
                 if ((mlfLine[0] == '.') && (mlfLine[1] == 0)) // utterance end delimiter: a single dot on a line
                 {
-                    if (restricttokeys.empty() || (this->size() < restricttokeys.size()))
-                    {
-                        parseentry(currMLFLines, currLineNum - currMLFLines.size(), restricttokeys, wordmap, unitmap, wordsequencebuffer, alignsequencebuffer, htkTimeToFrame);
-                    }
-
+                    pendinglinenums.push_back(currLineNum - currMLFLines.size());
+                    pendingentries.push_back(std::move(currMLFLines));
                     currMLFLines.clear();
+                    if (pendingentries.size() >= parsebatchsize)
+                        parsepending();
                 }
             };
 
@@ -1094,14 +1420,140 @@ public:
                 nextReadSize = readBlockSize;
             }
         }
+        parsepending();
 
         if (!currMLFLines.empty())
             malformed("unexpected end in mid-utterance");
 
         curpath.clear();
         fprintf(stderr, " total %lu entries\n", this->size());
+
+        if (!cachepath.empty() && numentriesbefore == 0) // (the cache holds the entries of a single MLF)
+            writecache(cachepath, path, htkTimeToFrame);
+    }
+
+private:
+    // binary MLF cache: header, then per utterance the key (UTF-8) and the entries
+    struct mlfcacheheader
+    {
+        char magic[8]; // "MLFCACHE"
+        uint32_t version;
+        uint32_t entrysize;     // sizeof(ENTRY)
+        uint64_t mlfsize;       // size of the MLF file it was made from
+        uint64_t statelisthash; // of the state list it was parsed with
+        double htktimetoframe;
+        uint64_t numkeys;
+    };
+    static const uint32_t mlfcacheversion = 1;
+
+    // one cache file per MLF path, in 'cachedir'
+    static wstring mlfcachepath(const wstring& cachedir, const wstring& path)
+    {
+        size_t pos = path.find_last_of(L"/\\");
+        wstring name = pos == wstring::npos ? path : path.substr(pos + 1);
+        return cachedir + L"/" + name + msra::strfun::wstrprintf(L".%016llx.mlfcache", (unsigned long long) std::hash<wstring>()(path));
+    }
+
+    mlfcacheheader makecacheheader(const wstring& path, const double htkTimeToFrame) const
+    {
+        mlfcacheheader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "MLFCACHE", sizeof(header.magic));
+        header.version = mlfcacheversion;
+        header.entrysize = (uint32_t) sizeof(ENTRY);
+        header.mlfsize = (uint64_t) filesize(path.c_str());
+        header.statelisthash = (uint64_t) statelisthash;
+        header.htktimetoframe = htkTimeToFrame;
+        return header;
+    }
+
+    // read the entries from the cache if it is there and up to date; returns false otherwise
+    bool readcache(const wstring& cachepath, const wstring& path, const double htkTimeToFrame)
+    {
+        if (!fexists(cachepath) || !msra::files::fuptodate(cachepath, path))
+            return false;
+        vector<char> buffer;
+        {
+            auto_file_ptr f(fopenOrDie(cachepath, L"rb"));
+            freadOrDie(buffer, filesize(f), f);
+        }
+        mlfcacheheader expected = makecacheheader(path, htkTimeToFrame);
+        if (buffer.size() < sizeof(mlfcacheheader))
+            return false;
+        mlfcacheheader header;
+        memcpy(&header, buffer.data(), sizeof(header));
+        expected.numkeys = header.numkeys;
+        if (memcmp(&header, &expected, sizeof(header)) != 0)
+        {
+            fprintf(stderr, "htkmlfreader: ignoring outdated cache %ls\n", cachepath.c_str());
+            return false;
+        }
+
+        // the keys come in order, so they are appended at the end of the map
+        const char* p = buffer.data() + sizeof(header);
+        const char* end = buffer.data() + buffer.size();
+        for (uint64_t k = 0; k < header.numkeys; k++)
+        {
+            uint32_t keylen;
+            uint64_t numentries;
+            if (end - p < (ptrdiff_t) sizeof(keylen))
+                RuntimeError("htkmlfreader: cache %ls is truncated", cachepath.c_str());
+            memcpy(&keylen, p, sizeof(keylen));
+            p += sizeof(keylen);
+            if (end - p < (ptrdiff_t) (keylen + sizeof(numentries)))
+                RuntimeError("htkmlfreader: cache %ls is truncated", cachepath.c_str());
+            wstring key = msra::strfun::utf16(string(p, keylen));
+            p += keylen;
+            memcpy(&numentries, p, sizeof(numentries));
+            p += sizeof(numentries);
+            if ((uint64_t) (end - p) < numentries * sizeof(ENTRY))
+                RuntimeError("htkmlfreader: cache %ls is truncated", cachepath.c_str());
+            auto iter = this->emplace_hint(this->end(), std::move(key), vector<ENTRY>((size_t) numentries));
+            if (numentries > 0)
+                memcpy(iter->second.data(), p, (size_t) numentries * sizeof(ENTRY));
+            p += numentries * sizeof(ENTRY);
+        }
+        fprintf(stderr, "htkmlfreader: read %lu entries of MLF file %ls from cache %ls\n", (unsigned long) header.numkeys, path.c_str(), cachepath.c_str());
+        return true;
+    }
+
+    // write the entries to the cache; failing to is not an error
+    // Several processes may do this at once (e.g. MPI workers), so each writes a file of its own and renames it.
+    void writecache(const wstring& cachepath, const wstring& path, const double htkTimeToFrame) const
+    {
+        wstring tmppath = cachepath + msra::strfun::wstrprintf(L".%d.tmp", (int) GetCurrentProcessId());
+        try
+        {
+            mlfcacheheader header = makecacheheader(path, htkTimeToFrame);
+            header.numkeys = this->size();
+            auto_file_ptr f(fopenOrDie(tmppath, L"wb"));
+            fwriteOrDie(&header, sizeof(header), 1, f);
+            for (const auto& entry : *this)
+            {
+                string key = msra::strfun::utf8(entry.first);
+                uint32_t keylen = (uint32_t) key.size();
+                uint64_t numentries = entry.second.size();
+                fwriteOrDie(&keylen, sizeof(keylen), 1, f);
+                fwriteOrDie(key.data(), 1, keylen, f);
+                fwriteOrDie(&numentries, sizeof(numentries), 1, f);
+                if (numentries > 0)
+                    fwriteOrDie(entry.second.data(), sizeof(ENTRY), entry.second.size(), f);
+            }
+            if (fclose(f) != 0)
+                RuntimeError("error closing %ls", tmppath.c_str());
+            if (fexists(cachepath))
+                _wunlink(cachepath.c_str()); // (outdated, or just written by someone else)
+            renameOrDie(tmppath, cachepath);
+            fprintf(stderr, "htkmlfreader: cached MLF file %ls in %ls\n", path.c_str(), cachepath.c_str());
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "htkmlfreader: could not write cache %ls (%s), ignoring\n", cachepath.c_str(), e.what());
+            _wunlink(tmppath.c_str());
+        }
     }
 
+public:
     // read state list, index is from 0
     void readstatelist(const wstring& stateListPath = L"")
     {
@@ -1115,6 +1567,7 @@ public:
             {
                 statelistmap[lines[index]] = index;
                 issilstatetable.push_back(issilstate(lines[index]));
+                statelisthash = statelisthash * 31 + std::hash<string>()(lines[index]); // (for the MLF cache)
             }
             if (index != statelistmap.size())
                 RuntimeError("readstatelist: lines (%d) not equal to statelistmap size (%d)", (int) index, (int) statelistmap.size());
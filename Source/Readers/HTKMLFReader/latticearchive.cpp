@@ -18,6 +18,7 @@
 #include <set>
 #include <unordered_map>
 #include <regex>
+#include <omp.h>
 
 #pragma warning(disable : 4996)
 namespace msra { namespace lattices {
@@ -102,36 +103,67 @@ static size_t tryfind(const MAPTYPE &map, const KEYTYPE &key, VALTYPE deflt)
     std::set<std::wstring> seenkeys; // (keep track of seen keys; throw error for duplicate keys)
     msra::files::make_intermediate_dirs(outpath);
 
-    auto_file_ptr f = fopenOrDie(outpath, L"wb");
-    auto_file_ptr ftoc = fopenOrDie(tocpath, L"wb");
-    size_t brokeninputfiles = 0;
+    // get keys
+    std::vector<std::wstring> keys(infiles.size());
     foreach_index (i, infiles)
     {
         const std::wstring &inlatpath = infiles[i];
-        fprintf(stderr, "build: processing lattice '%ls'\n", inlatpath.c_str());
-
-        // get key
         std::wstring key = regex_replace(inlatpath, wregex(L"=.*"), wstring()); // delete mapping
         key = regex_replace(key, wregex(L".*[\\\\/]"), wstring());              // delete path
         key = regex_replace(key, wregex(L"\\.[^\\.\\\\/:]*$"), wstring());      // delete extension (or not if none)
         if (!seenkeys.insert(key).second)
             RuntimeError("build: duplicate key for lattice '%ls'", inlatpath.c_str());
+        keys[i] = key;
+    }
 
-        // we fail all the time due to totally broken HDecode/copy process, OK if not too many files are missing
-        bool latticeread = false;
-        try
+    // Reading and converting the lattices dominates, so a block of them is read in parallel, and then written out
+    // in input order. The archive and TOC are therefore the same as when built one by one.
+    auto_file_ptr f = fopenOrDie(outpath, L"wb");
+    auto_file_ptr ftoc = fopenOrDie(tocpath, L"wb");
+    size_t brokeninputfiles = 0;
+    const size_t blocksize = 16 * (size_t) omp_get_max_threads();
+    for (size_t begin = 0; begin < infiles.size(); begin += blocksize)
+    {
+        const size_t end = min(begin + blocksize, infiles.size());
+        std::vector<lattice> lattices(end - begin);
+        std::vector<std::string> readerrors(end - begin);
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < (int) (end - begin); k++)
         {
-            // fetch lattice
-            lattice L;
-            if (!numermode)
-                L.fromhtklattice(inlatpath, modelsymmap); // read HTK lattice
-            else
-                L.frommlf(key, modelsymmap, labels, unigram, unigramsymbols); // read MLF into a numerator lattice
-            latticeread = true;
+            const size_t i = begin + k;
+            // we fail all the time due to totally broken HDecode/copy process, OK if not too many files are missing
+            try
+            {
+                // fetch lattice
+                if (!numermode)
+                    lattices[k].fromhtklattice(infiles[i], modelsymmap); // read HTK lattice
+                else
+                    lattices[k].frommlf(keys[i], modelsymmap, labels, unigram, unigramsymbols); // read MLF into a numerator lattice
+            }
+            catch (const exception &e) // (exceptions must not leave the parallel region)
+            {
+                readerrors[k] = e.what();
+                if (readerrors[k].empty())
+                    readerrors[k] = "unknown error";
+            }
+        }
+
+        for (size_t i = begin; i < end; i++)
+        {
+            const std::wstring &inlatpath = infiles[i];
+            const std::wstring &key = keys[i];
+            fprintf(stderr, "build: processing lattice '%ls'\n", inlatpath.c_str());
+            if (!readerrors[i - begin].empty())
+            {
+                // we ignore read failures
+                fprintf(stderr, "ERROR: skipping unreadable lattice '%ls': %s\n", inlatpath.c_str(), readerrors[i - begin].c_str());
+                brokeninputfiles++;
+                continue;
+            }
 
             // write to archive
             uint64_t offset = fgetpos(f);
-            L.fwrite(f);
+            lattices[i - begin].fwrite(f);
             fflushOrDie(f);
 
             // write reference to TOC file   --note: TOC file is a headerless UTF8 file; so don't use fprintf %ls format (default code page)
@@ -140,14 +172,6 @@ static size_t tryfind(const MAPTYPE &map, const KEYTYPE &key, VALTYPE deflt)
 
             fprintf(stderr, "written lattice to offset %llu as '%ls'\n", offset, key.c_str());
         }
-        catch (const exception &e)
-        {
-            if (latticeread)
-                throw; // write failure
-            // we ignore read failures
-            fprintf(stderr, "ERROR: skipping unreadable lattice '%ls': %s\n", inlatpath.c_str(), e.what());
-            brokeninputfiles++;
-        }
     }
 
     // write out the unit map
@@ -670,6 +694,10 @@ void lattice::frommlf(const wstring &key, const std::unordered_map<std::string,
     size_t lmend = unigramsymbols["</s>"];
     size_t sentstart = unigramsymbols["!sent_start"];
     size_t sentend = unigramsymbols["!sent_end"];
+    vector<int> lmwords(transcript.words.size());
+    foreach_index (j, transcript.words)
+        lmwords[j] = (int) (transcript.words[j].wordindex == sentend ? lmend : transcript.words[j].wordindex); // use </s> for score lookup
+    unigram.score(lmwords.data(), 1, lmwords.size(), lmscores.data());
 
     // create the lattice
     nodes.resize(transcript.words.size() + 1);
@@ -700,10 +728,8 @@ void lattice::frommlf(const wstring &key, const std::unordered_map<std::string,
         {
             if (j != (int) transcript.words.size() - 1)
                 LogicError("frommlf: found an !sent_end token not at the end position");
-            wid = lmend; // use </s> for score lookup
         }
-        const int iwid = (int) wid;
-        e.l = (wid != sentstart && wid != silence) ? (float) unigram.score(&iwid, 1) : 0.0f;
+        e.l = (wid != sentstart && wid != silence) ? lmscores[j] : 0.0f;
 
         // alignment
         e.implysp = 0;
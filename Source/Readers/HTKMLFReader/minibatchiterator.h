@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include "ssematrix.h"
 #include "latticearchive.h"        // for reading HTK phoneme lattices (MMI training)
 #include "simple_checked_arrays.h" // for const_array_ref
@@ -100,6 +101,12 @@ class minibatchiterator
     size_t subsetnum;
     size_t numsubsets;
 
+    // dynamic distribution instead of a fixed subset: the epoch is cut into blocks of 'workitemframes' frames, and we read
+    // the blocks whose indices 'nextworkitem' hands out to us (no dynamic distribution: workitemframes == 0)
+    std::function<size_t()> nextworkitem;
+    size_t workitemframes;
+    size_t workitemendframe; // end of the block being read
+
     std::vector<msra::dbn::matrix> featbuf;                                                      // buffer for holding curernt minibatch's frames
     std::vector<std::vector<size_t>> uids;                                                       // buffer for storing current minibatch's frame-level label sequence
     std::vector<const_array_ref<msra::lattices::lattice::htkmlfwordsequence::word>> transcripts; // buffer for storing current minibatch's word-level label sequences (if available and used; empty otherwise)
@@ -133,7 +140,8 @@ private:
         }
         // process one mini-batch (accumulation and update)
         assert(requestedmbframes > 0);
-        const size_t requestedframes = min(requestedmbframes, epochendframe - mbstartframe); // (< mbsize at end)
+        const size_t endframe = (workitemframes > 0) ? workitemendframe : epochendframe;
+        const size_t requestedframes = min(requestedmbframes, endframe - mbstartframe); // (< mbsize at end)
         assert(requestedframes > 0);
         source.getbatch(mbstartframe, requestedframes, subsetnum, numsubsets, mbframesadvanced, featbuf, uids, transcripts, lattices, sentendmark, phoneboundaries);
         timegetbatch = source.gettimegetbatch();
@@ -163,6 +171,23 @@ private:
         if (!hasdata())
             LogicError("minibatchiterator: access beyond end of epoch");
     }
+    // dynamic distribution: move to the first utterance in the next block that we get, or to the end if none is left
+    void claimworkitem()
+    {
+        for (;;)
+        {
+            const size_t blockbeginframe = epochstartframe + nextworkitem() * workitemframes;
+            if (blockbeginframe >= epochendframe)
+            {
+                mbstartframe = epochendframe;
+                return;
+            }
+            workitemendframe = min(blockbeginframe + workitemframes, epochendframe);
+            mbstartframe = source.firstvalidglobalts(blockbeginframe);
+            if (mbstartframe < workitemendframe) // (else no utterance starts in this block)
+                return;
+        }
+    }
 
 public:
     // interface: for (minibatchiterator i (...), i, i++) { ... }
@@ -173,6 +198,8 @@ public:
           requestedmbframes(requestedmbframes),
           subsetnum(subsetnum),
           numsubsets(numsubsets),
+          workitemframes(0),
+          workitemendframe(0),
           datapasses(datapasses),
           timegetbatch(0),
           timechecklattice(0)
@@ -194,6 +221,8 @@ public:
           requestedmbframes(requestedmbframes),
           subsetnum(subsetnum),
           numsubsets(numsubsets),
+          workitemframes(0),
+          workitemendframe(0),
           datapasses(datapasses),
           timegetbatch(0),
           timechecklattice(0)
@@ -206,6 +235,31 @@ public:
         fillorclear(); // get the first batch
     }
 
+    // mbiterator constructor for dynamic distribution of the data among nodes, see nextworkitem
+    minibatchiterator(msra::dbn::minibatchsource &source, size_t epoch, size_t epochframes, size_t requestedmbframes, const std::function<size_t()> &nextworkitem, size_t workitemframes)
+        : source(source),
+          epochstartframe(epoch * epochframes),
+          epochendframe(epochstartframe + epochframes),
+          requestedmbframes(requestedmbframes),
+          subsetnum(0),
+          numsubsets(1),
+          nextworkitem(nextworkitem),
+          workitemframes(workitemframes),
+          workitemendframe(0),
+          datapasses(1),
+          timegetbatch(0),
+          timechecklattice(0)
+    {
+        if (workitemframes == 0)
+            InvalidArgument("minibatchiterator: work items must not be empty");
+        firstvalidepochstartframe = source.firstvalidglobalts(epochstartframe);
+        fprintf(stderr, "minibatchiterator: epoch %d: frames [%d..%d] (first utterance at frame %d), dynamically distributed in blocks of %d frames\n",
+                (int) epoch, (int) epochstartframe, (int) epochendframe, (int) firstvalidepochstartframe, (int) workitemframes);
+        datapass = 0;
+        claimworkitem();
+        fillorclear(); // get the first batch
+    }
+
     // need virtual destructor to ensure proper destruction
     virtual ~minibatchiterator()
     {
@@ -222,6 +276,8 @@ public:
     {
         checkhasdata();
         mbstartframe += mbframesadvanced;
+        if ((workitemframes > 0) && (mbstartframe >= workitemendframe))
+            claimworkitem();
         // if we hit the end, we will get mbstartframe >= epochendframe <=> !hasdata()
         // (most likely actually mbstartframe > epochendframe since the last utterance likely crosses the epoch boundary)
         // in case of multiple datapasses, reset to start when hitting the end
@@ -234,6 +290,18 @@ public:
         fillorclear();
     }
 
+    // continue the epoch at the first valid start frame at or after 'framesintoepoch' frames into it
+    // Positions taken from currentmbstartframe() (relative to range().first) are valid, so this is where that minibatch started.
+    void seek(size_t framesintoepoch)
+    {
+        if (workitemframes > 0)
+            LogicError("minibatchiterator: cannot seek with dynamic distribution");
+        const size_t globalts = epochstartframe + framesintoepoch;
+        mbstartframe = (globalts < epochendframe) ? source.firstvalidglobalts(globalts) : globalts;
+        datapass = 0;
+        fillorclear();
+    }
+
     // accessors to current minibatch
     size_t currentmbstartframe() const
     {
@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
+#include <string.h>      // for memcpy()
+#include <type_traits>
 #ifndef __unix__
 #include "ssematrix.h" // for matrix type
 #endif
@@ -24,14 +26,19 @@ namespace msra { namespace dbn {
 // ---------------------------------------------------------------------------
 
 // implant a sub-vector into a vector, for use in augmentneighbors
+// All vector types used with this (std::vector, array_ref, matrix columns) store their elements contiguously, so this
+// is a memcpy(), which the C runtime does with the widest vector instructions the CPU has.
 template <class INV, class OUTV>
 static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv)
 {
+    static_assert(std::is_same<typename std::decay<decltype(inv[0])>::type, typename std::decay<decltype(outv[0])>::type>::value,
+                  "copytosubvector: element types must match");
     size_t subdim = inv.size();
     assert(outv.size() % subdim == 0);
+    if (subdim == 0)
+        return;
     size_t k0 = subvecindex * subdim;
-    foreach_index (k, inv)
-        outv[k + k0] = inv[k];
+    memcpy(&outv[k0], &inv[0], subdim * sizeof(inv[0]));
 }
 
 // compute the augmentation extent (how many frames added on each side)
@@ -169,7 +176,12 @@ static void augmentneighbors(const std::vector<std::vector<float>>& frames, cons
                              size_t ts, size_t te, // range [ts,te)
                              MATRIX& v)
 {
-    for (size_t t = ts; t < te; t++)
+    if (ts >= te)
+        return;
+    augmentationextent(frames[ts].size(), v.col(0).size()); // (check here: no exceptions from within the parallel loop)
+    // frames are independent, and context windows of many frames are many large copies
+#pragma omp parallel for schedule(static)
+    for (int t = (int) ts; t < (int) te; t++)
     {
         auto v_t = v.col(t - ts); // the vector to fill in
         augmentneighbors(frames, boundaryflags, t, v_t);
@@ -182,7 +194,8 @@ static void augmentneighbors(const std::vector<std::vector<float>>& frames, cons
                              size_t ts, size_t te, // range [ts,te)
                              MATRIX& v)
 {
-    for (size_t t = ts; t < te; t++)
+#pragma omp parallel for schedule(static)
+    for (int t = (int) ts; t < (int) te; t++)
     {
         auto v_t = v.col(t - ts); // the vector to fill in
         augmentneighbors(frames, boundaryflags, t, leftextent, rightextent, v_t);
@@ -14,9 +14,22 @@
 #include <unordered_map>
 #include <algorithm> // for various sort() calls
 #include <math.h>
+#ifdef _MSC_VER
+#include <xmmintrin.h> // for _mm_prefetch()
+#endif
 
 namespace msra { namespace lm {
 
+// hint to pull a cache line in ahead of its use; does not fault on any address
+static inline void prefetch(const void *p)
+{
+#ifdef _MSC_VER
+    _mm_prefetch((const char *) p, _MM_HINT_T0);
+#else
+    __builtin_prefetch(p);
+#endif
+}
+
 // ===========================================================================
 // core LM interface -- LM scores are accessed through this exclusively
 // ===========================================================================
@@ -694,6 +707,26 @@ public:
             return foundcoord(1, k.m, i_m);
     }
 
+    // for batched lookups: pull in what looking up the first token of 'k' will touch; a word a few steps ahead gets
+    // prefetchmap() first and prefetchunigram() once its w2id[] entry has arrived. Returns the unigram coord of the
+    // token (invalid if unknown), for the caller to prefetch its own data with.
+    inline void prefetchmap(const key &k) const
+    {
+        if (k.m > 0 && k.mgram[0] >= 0 && k.mgram[0] < (int) w2id.size())
+            prefetch(&w2id[k.mgram[0]]);
+    }
+    inline coord prefetchunigram(const key &k) const
+    {
+        if (k.m == 0)
+            return coord(false);
+        index_t i = find_child(0, 0, map(k.mgram[0]));
+        if (i == nindex)
+            return coord(false);
+        if (M > 1) // the range of its children is read next
+            prefetch(&firsts[1][i]);
+        return coord(1, i);
+    }
+
     // truncate a key to the m-gram length supported by this
     inline key truncate(const key &k) const
     {
@@ -1129,6 +1162,12 @@ public:
         c.validate();
         return data[c.m][c.i];
     }
+    // prefetch an element that may be accessed soon (no-op for invalid or absent ones)
+    inline void prefetch(const mgram_map::coord &c) const
+    {
+        if (c.valid() && c.m < data.size() && c.i < data[c.m].size())
+            msra::lm::prefetch(&data[c.m][c.i]);
+    }
     // create entire vector (for random-access situations).
     void assign(int m, size_t size, const DATATYPE &value)
     {
@@ -1228,6 +1267,30 @@ public:
         } // and go again with the shortened history
     }
 
+    // batched score(): scores[k] = score(mgrams + k * m, m) for n m-grams stored back to back, e.g. all tokens of a
+    // sentence or all histories to be expanded. Lookups are mostly cache misses into large tables, so while m-gram k is
+    // scored, the first-level entries of m-gram k + prefetchdistance/2 and the id map of k + prefetchdistance are
+    // pulled in, to overlap their latency with the work at hand.
+    void score(const int *mgrams, int m, size_t n, float *scores) const
+    {
+        const size_t prefetchdistance = 8;
+        for (size_t k = 0; k < n; k++)
+        {
+            if (k + prefetchdistance < n)
+                map.prefetchmap(map.truncate(mgram_map::key(mgrams + (k + prefetchdistance) * m, m)));
+            if (k + prefetchdistance / 2 < n)
+            {
+                const mgram_map::key ahead = map.truncate(mgram_map::key(mgrams + (k + prefetchdistance / 2) * m, m));
+                const mgram_map::coord c = map.prefetchunigram(ahead);
+                if (ahead.order() == 1) // it is the predicted word
+                    logP.prefetch(c);
+                else // a history; its back-off weight is needed when the m-gram is not found
+                    logB.prefetch(c);
+            }
+            scores[k] = (float) score(mgrams + k * m, m);
+        }
+    }
+
     // same as score() but without optimizations (for reference)
     // ... this is really no longer needed
     virtual double score_unoptimized(const int *mgram, int m) const
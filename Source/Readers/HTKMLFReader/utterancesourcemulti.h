@@ -10,9 +10,15 @@
 #include "Basics.h"         // for attempt()
 #include "htkfeatio.h"      // for htkmlfreader
 #include "latticearchive.h" // for reading HTK phoneme lattices (MMI training)
+#include "TaskPool.h"       // for paging in the background
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
 #include "unordered_set"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <mutex>
 
 namespace msra { namespace dbn {
 
@@ -42,6 +48,19 @@ class minibatchutterancesourcemulti : public minibatchsource
     const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts; // (used for getting word-level transcripts)
                                                                                          // std::vector<map<wstring,msra::lattices::lattice::htkmlfwordsequence>> allwordtranscripts;
     // data store (incl. paging in/out of features and lattices)
+    // view on the frames of an utterance inside a memory-mapped feature file
+    // Columns are not padded, so this is only meant for element-wise access, as by getbatch().
+    class mappedframes : public msra::dbn::matrixbase
+    {
+    public:
+        mappedframes(const float *data, size_t featdim, size_t numframes)
+        {
+            p = const_cast<float *>(data); // (read-only mapping; we never write to it)
+            numrows = featdim;
+            numcols = numframes;
+            colstride = featdim;
+        }
+    };
     struct utterancedesc // data descriptor for one utterance
     {
         msra::asr::htkfeatreader::parsedpath parsedpath; // archive filename and frame range in that file
@@ -87,6 +106,8 @@ class minibatchutterancesourcemulti : public minibatchsource
         mutable msra::dbn::matrix frames;                                           // stores all frames consecutively (mutable since this is a cache)
         size_t totalframes;                                                         // total #frames for all utterances in this chunk
         mutable std::vector<shared_ptr<const latticesource::latticepair>> lattices; // (may be empty if none)
+        mutable std::vector<shared_ptr<mappedframes>> mappedutterances;             // [utteranceindex] if paged in by mapping the feature files instead (then 'frames' is empty)
+        mutable std::vector<shared_ptr<const msra::asr::mappedfile>> mappings;      // ...the files they point into
 
         // construction
         utterancechunkdata()
@@ -117,6 +138,8 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("getutteranceframes: called when data have not been paged in");
             const size_t ts = firstframes[i];
             const size_t n = numframes(i);
+            if (!mappedutterances.empty())
+                return msra::dbn::matrixstripe(*mappedutterances[i], 0, n);
             return msra::dbn::matrixstripe(frames, ts, n);
         }
         shared_ptr<const latticesource::latticepair> getutterancelattice(size_t i) const // return the frame set for a given utterance
@@ -130,11 +153,13 @@ class minibatchutterancesourcemulti : public minibatchsource
         // test if data is in memory at the moment
         bool isinram() const
         {
-            return !frames.empty();
+            return !frames.empty() || !mappedutterances.empty();
         }
         // page in data for this chunk
         // We pass in the feature info variables by ref which will be filled lazily upon first read
-        void requiredata(string &featkind, size_t &featdim, unsigned int &sampperiod, const latticesource &latticesource, int verbosity = 0) const
+        // If 'latticemutex' is given, lattice reads are serialized through it (latticesource shares one file handle).
+        // With 'mapfeatures', the feature files are memory-mapped instead of read where their format allows.
+        void requiredata(string &featkind, size_t &featdim, unsigned int &sampperiod, const latticesource &latticesource, int verbosity = 0, std::mutex *latticemutex = nullptr, bool mapfeatures = false) const
         {
             if (numutterances() == 0)
                 LogicError("requiredata: cannot page in virgin block");
@@ -150,18 +175,26 @@ class minibatchutterancesourcemulti : public minibatchsource
                     fprintf(stderr, "requiredata: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n", (int) featdim, featkind.c_str(), sampperiod / 1e4);
                 }
                 // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
-                frames.resize(featdim, totalframes);
+                const bool mapped = mapfeatures && mapdata(reader, featkind, featdim, sampperiod);
+                if (!mapped)
+                    frames.resize(featdim, totalframes);
                 if (!latticesource.empty())
                     lattices.resize(utteranceset.size());
                 foreach_index (i, utteranceset)
                 {
                     // fprintf (stderr, ".");
                     // read features for this file
-                    auto uttframes = getutteranceframes(i);                                                    // matrix stripe for this utterance (currently unfilled)
-                    reader.read(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
+                    auto uttframes = getutteranceframes(i); // matrix stripe for this utterance (currently unfilled unless mapped)
+                    if (!mapped)
+                        reader.read(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
                     // page in lattice data
                     if (!latticesource.empty())
+                    {
+                        std::unique_lock<std::mutex> lock;
+                        if (latticemutex)
+                            lock = std::unique_lock<std::mutex>(*latticemutex);
                         latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
+                    }
                 }
                 // fprintf (stderr, "\n");
                 if (verbosity)
@@ -173,6 +206,26 @@ class minibatchutterancesourcemulti : public minibatchsource
                 throw;
             }
         }
+        // map the frames of all utterances from their feature files instead of reading them
+        // Returns false if any of the files cannot be mapped (e.g. compressed or in foreign byte order).
+        bool mapdata(msra::asr::htkfeatreader &reader, const string &featkind, size_t featdim, unsigned int sampperiod) const
+        {
+            std::vector<shared_ptr<mappedframes>> utterances;
+            std::vector<shared_ptr<const msra::asr::mappedfile>> files;
+            foreach_index (i, utteranceset)
+            {
+                shared_ptr<const msra::asr::mappedfile> file;
+                const float *data;
+                if (!reader.map(utteranceset[i].parsedpath, featkind, sampperiod, featdim, file, data))
+                    return false;
+                utterances.push_back(make_shared<mappedframes>(data, featdim, numframes(i)));
+                if (files.empty() || files.back() != file)
+                    files.push_back(file);
+            }
+            mappedutterances.swap(utterances);
+            mappings.swap(files);
+            return true;
+        }
         // page out data for this chunk
         void releasedata() const
         {
@@ -182,9 +235,31 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("releasedata: called when data is not memory");
             // release frames
             frames.resize(0, 0);
+            mappedutterances.clear();
+            mappings.clear(); // (unmapped once no other chunk refers to the file)
             // release lattice data
             lattices.clear();
         }
+        // page out data for this chunk, but free the memory on a background thread
+        std::future<void> releasedataasync() const
+        {
+            if (numutterances() == 0)
+                LogicError("releasedata: cannot page out virgin block");
+            if (!isinram())
+                LogicError("releasedata: called when data is not memory");
+            auto releasedframes = std::make_shared<msra::dbn::matrix>(std::move(frames)); // leaves 'frames' empty
+            auto releasedlattices = std::make_shared<std::vector<shared_ptr<const latticesource::latticepair>>>(std::move(lattices));
+            auto releasedmappings = std::make_shared<std::vector<shared_ptr<const msra::asr::mappedfile>>>(std::move(mappings));
+            lattices.clear();
+            mappings.clear();
+            mappedutterances.clear();
+            return Microsoft::MSR::CNTK::TaskPool::Submit<void>([releasedframes, releasedlattices, releasedmappings]() mutable
+                                                                {
+                                                                    releasedframes.reset();
+                                                                    releasedlattices.reset();
+                                                                    releasedmappings.reset();
+                                                                });
+        }
     };
     std::vector<std::vector<utterancechunkdata>> allchunks;           // set of utterances organized in chunks, referred to by an iterator (not an index)
     std::vector<unique_ptr<biggrowablevector<CLASSIDTYPE>>> classids; // [classidsbegin+t] concatenation of all state sequences
@@ -240,6 +315,19 @@ class minibatchutterancesourcemulti : public minibatchsource
     };
     std::vector<std::vector<chunk>> randomizedchunks; // utterance chunks after being brought into random order (we randomize within a rolling window over them)
     size_t chunksinram;                               // (for diagnostics messages)
+
+    // asynchronous paging (setchunkiothreads()): up to 'chunkiothreads' chunks are paged in on background threads
+    // ahead of need--in utterance mode those of the upcoming utterances, in frame mode the ones following the current window--
+    // and released chunks are freed in the background; 0 means to page in synchronously when a chunk is first touched
+    size_t chunkiothreads;
+    bool mapfeatures; // page in by memory-mapping the feature archives where possible (setmapfeatures())
+    size_t bucketsize; // utterance mode: sort runs of this many randomized utterances by length (setbucketsize()); 0: off
+    std::map<const utterancechunkdata *, std::future<void>> pendingpageins; // [chunk of first feature stream] -> page-in of all feature streams
+    std::vector<std::future<void>> pendingpageouts;
+    std::mutex latticemutex; // for page-ins running concurrently
+    size_t pageinsahead;     // (diagnostics) page-ins started ahead of need
+    size_t pageinstalls;     // (diagnostics) ... of which getbatch() had to wait for
+    double pageinstalltime;  // (diagnostics) time spent waiting for them
     struct utteranceref                               // describes the underlying random utterance associated with an utterance position
     {
         size_t chunkindex;     // lives in this chunk (index into randomizedchunks[])
@@ -389,7 +477,7 @@ public:
     minibatchutterancesourcemulti(const std::vector<std::vector<wstring>> &infiles, const std::vector<map<wstring, std::vector<msra::asr::htkmlfentry>>> &labels,
                                   std::vector<size_t> vdim, std::vector<size_t> udim, std::vector<size_t> leftcontext, std::vector<size_t> rightcontext, size_t randomizationrange,
                                   const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode)
-        : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), timegetbatch(0), verbosity(2)
+        : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), chunkiothreads(0), mapfeatures(false), bucketsize(0), pageinsahead(0), pageinstalls(0), pageinstalltime(0), timegetbatch(0), verbosity(2)
     // [v-hansu] change framemode (lattices.empty()) into framemode (false) to run utterance mode without lattice
     // you also need to change another line, search : [v-hansu] comment out to run utterance mode without lattice
     {
@@ -424,6 +512,30 @@ public:
             // lattices.push_back(shared_ptr<latticesource>(new latticesource(latticetocs, modelsymmap)));
         }
 
+        // parse the script entries of all streams up front, in parallel; with millions of utterances, this dominates the startup
+        // The archives themselves are not touched here; their headers are read when their chunks are first paged in.
+        std::vector<std::vector<msra::asr::htkfeatreader::parsedpath>> parsedpaths(infiles.size());
+        foreach_index (m, infiles)
+        {
+            parsedpaths[m].resize(infiles[m].size());
+            std::exception_ptr error;
+#pragma omp parallel for
+            for (int i = 0; i < (int) infiles[m].size(); i++)
+            {
+                try
+                {
+                    parsedpaths[m][i] = msra::asr::htkfeatreader::parsedpath(infiles[m][i]);
+                }
+                catch (...) // (an exception must not leave the parallel region)
+                {
+#pragma omp critical
+                    error = std::current_exception();
+                }
+            }
+            if (error)
+                std::rethrow_exception(error);
+        }
+
         // first check consistency across feature streams
         // We'll go through the SCP files for each stream to make sure the duration is consistent
         // If not, we'll plan to ignore the utterance, and inform the user
@@ -442,8 +554,7 @@ public:
 
             foreach_index (i, infiles[m])
             {
-                utterancedesc utterance(msra::asr::htkfeatreader::parsedpath(infiles[m][i]), 0); // mseltzer - is this foolproof for multiio? is classids always non-empty?
-                const size_t uttframes = utterance.numframes();                                  // will throw if frame bounds not given --required to be given in this mode
+                const size_t uttframes = parsedpaths[m][i].numframes(); // will throw if frame bounds not given --required to be given in this mode
                 // we need at least 2 frames for boundary markers to work
                 if (uttframes < 2)
                     RuntimeError("minibatchutterancesource: utterances < 2 frames not supported");
@@ -507,7 +618,7 @@ public:
 
                 if (uttisvalid[i])
                 {
-                    utterancedesc utterance(msra::asr::htkfeatreader::parsedpath(infiles[m][i]), labels.empty() ? 0 : classidsbegin[i]); // mseltzer - is this foolproof for multiio? is classids always non-empty?
+                    utterancedesc utterance(std::move(parsedpaths[m][i]), labels.empty() ? 0 : classidsbegin[i]); // mseltzer - is this foolproof for multiio? is classids always non-empty?
                     const size_t uttframes = utterance.numframes();                                                                      // will throw if frame bounds not given --required to be given in this mode
                     assert(uttframes == uttduration[i]);                                                                                 // ensure nothing funky happened
                     // already performed these checks above
@@ -750,6 +861,12 @@ private:
         if (sweep == currentsweep)                    // already got this one--nothing to do
             return sweep;
 
+        // page-ins ahead of need refer to the randomized chunk sequence we are about to replace
+        waitforpaging();
+        if (chunkiothreads > 0 && pageinsahead > 0)
+            fprintf(stderr, "lazyrandomization: %d chunks were paged in ahead of need, %d of them stalled reading for %.2f seconds in total\n",
+                    (int) pageinsahead, (int) pageinstalls, pageinstalltime);
+
         currentsweep = sweep;
         if (verbosity > 0)
             fprintf(stderr, "lazyrandomization: re-randomizing for sweep %d in %s mode\n", (int) currentsweep, framemode ? "frame" : "utterance");
@@ -904,6 +1021,40 @@ private:
                 }
             }
 
+            // bucketing: sort each run of 'bucketsize' consecutive positions by utterance length, so that the utterances
+            // the reader puts side by side into a minibatch have similar lengths, and little of it is padding.
+            // Runs alternate between ascending and descending order, so that neighbouring runs also meet at similar lengths.
+            // A run that would move an utterance out of the chunk window of its new position is left as it is.
+            if (bucketsize > 1)
+            {
+                auto numframesof = [&](const utteranceref &uttref)
+                {
+                    return randomizedchunks[0][uttref.chunkindex].getchunkdata().numframes(uttref.utteranceindex);
+                };
+                std::vector<utteranceref> run;
+                size_t numunsorted = 0;
+                for (size_t begin = 0; begin < randomizedutterancerefs.size(); begin += bucketsize)
+                {
+                    const size_t end = min(begin + bucketsize, randomizedutterancerefs.size());
+                    const bool descending = (begin / bucketsize) % 2 != 0;
+                    run.assign(randomizedutterancerefs.begin() + begin, randomizedutterancerefs.begin() + end);
+                    std::stable_sort(run.begin(), run.end(), [&](const utteranceref &a, const utteranceref &b)
+                                     {
+                                         return descending ? numframesof(a) > numframesof(b) : numframesof(a) < numframesof(b);
+                                     });
+                    bool valid = true;
+                    for (size_t pos = begin; pos < end && valid; pos++)
+                        valid = positionchunkwindows[pos].isvalidforthisposition(run[pos - begin]);
+                    if (valid)
+                        std::copy(run.begin(), run.end(), randomizedutterancerefs.begin() + begin);
+                    else
+                        numunsorted++;
+                }
+                if (verbosity > 0 && numunsorted > 0)
+                    fprintf(stderr, "lazyrandomization: %d of %d runs of %d utterances left unsorted (chunk window constraints)\n",
+                            (int) numunsorted, (int) ((randomizedutterancerefs.size() + bucketsize - 1) / bucketsize), (int) bucketsize);
+            }
+
             // place the randomized utterances on the global timeline so we can find them by globalts
             size_t t = sweepts;
             foreach_index (i, randomizedutterancerefs)
@@ -1057,9 +1208,115 @@ private:
         return sweep;
     }
 
+    // wait for a page-in of randomized chunk k ahead of need, if any
+    // If it failed, the chunk is left paged out, and requirerandomizedchunk() will try again synchronously.
+    void waitforpagein(size_t k)
+    {
+        auto iter = pendingpageins.find(&randomizedchunks[0][k].getchunkdata());
+        if (iter == pendingpageins.end())
+            return;
+        std::future<void> pagein = std::move(iter->second);
+        pendingpageins.erase(iter);
+        if (pagein.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            auto_timer stalltimer;
+            pagein.wait();
+            pageinstalls++;
+            pageinstalltime += stalltimer;
+        }
+        try
+        {
+            pagein.get();
+            chunksinram++;
+        }
+        catch (const std::exception &e)
+        {
+            fprintf(stderr, "waitforpagein: paging in randomized chunk %d ahead of need failed, retrying: %s\n", (int) k, e.what());
+        }
+    }
+
+    // wait for all background paging, e.g. before the randomized chunk sequence changes
+    void waitforpaging()
+    {
+        while (!pendingpageins.empty())
+        {
+            auto iter = pendingpageins.begin();
+            auto iterchunk = std::find_if(randomizedchunks[0].begin(), randomizedchunks[0].end(), [&](const chunk &c)
+                                      {
+                                          return &c.getchunkdata() == iter->first;
+                                      });
+            waitforpagein(iterchunk - randomizedchunks[0].begin());
+        }
+        for (auto &pageout : pendingpageouts)
+            pageout.get();
+        pendingpageouts.clear();
+    }
+
+    // start paging in randomized chunk k in the background (all feature streams)
+    void pageinahead(size_t k)
+    {
+        std::vector<const utterancechunkdata *> chunkdatas;
+        foreach_index (m, randomizedchunks)
+            chunkdatas.push_back(&randomizedchunks[m][k].getchunkdata());
+        if (chunkdatas[0]->isinram() || pendingpageins.find(chunkdatas[0]) != pendingpageins.end())
+            return;
+        if (verbosity)
+            fprintf(stderr, "pageinahead: paging in randomized chunk %d (frame range [%d..%d]) in the background\n", (int) k, (int) randomizedchunks[0][k].globalts, (int) (randomizedchunks[0][k].globalte() - 1));
+        pendingpageins[chunkdatas[0]] = Microsoft::MSR::CNTK::TaskPool::Submit<void>([this, chunkdatas]()
+                                                                                     {
+                                                                                         try
+                                                                                         {
+                                                                                             foreach_index (m, chunkdatas)
+                                                                                             {
+                                                                                                 msra::util::attempt(5, [&]() // (reading from network)
+                                                                                                                     {
+                                                                                                                         chunkdatas[m]->requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, 0, &latticemutex, mapfeatures);
+                                                                                                                     });
+                                                                                             }
+                                                                                         }
+                                                                                         catch (...) // leave all feature streams paged out
+                                                                                         {
+                                                                                             for (auto chunkdata : chunkdatas)
+                                                                                                 if (chunkdata->isinram())
+                                                                                                     chunkdata->releasedata();
+                                                                                             throw;
+                                                                                         }
+                                                                                     });
+        pageinsahead++;
+    }
+
+    // start paging in the chunks that will be needed soonest, as long as fewer than 'chunkiothreads' page-ins are running
+    // Chunks are only considered within [windowbegin, windowend), which getbatch() keeps in RAM.
+    void pageinahead(const std::vector<size_t> &upcomingchunks, const size_t windowbegin, const size_t windowend, const size_t subsetnum, const size_t numsubsets)
+    {
+        // first retire page-outs that are done, so that errors surface
+        for (size_t i = 0; i < pendingpageouts.size();)
+        {
+            if (pendingpageouts[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                pendingpageouts[i].get();
+                pendingpageouts.erase(pendingpageouts.begin() + i);
+            }
+            else
+                i++;
+        }
+        // the first page-in determines the feature kind, which concurrent page-ins would race for
+        foreach_index (m, featdim)
+            if (featdim[m] == 0)
+                return;
+        for (size_t k : upcomingchunks)
+        {
+            if (pendingpageins.size() >= chunkiothreads)
+                break;
+            if (k >= windowbegin && k < windowend && (k % numsubsets) == subsetnum)
+                pageinahead(k);
+        }
+    }
+
     // helper to page out a chunk with log message
     void releaserandomizedchunk(size_t k)
     {
+        waitforpagein(k);
         size_t numreleased = 0;
         foreach_index (m, randomizedchunks)
         {
@@ -1069,7 +1326,10 @@ private:
                 if (verbosity)
                     fprintf(stderr, "releaserandomizedchunk: paging out randomized chunk %d (frame range [%d..%d]), %d resident in RAM\n",
                             (int) k, (int) randomizedchunks[m][k].globalts, (int) (randomizedchunks[m][k].globalte() - 1), (int) (chunksinram - 1));
-                chunkdata.releasedata();
+                if (chunkiothreads > 0)
+                    pendingpageouts.push_back(chunkdata.releasedataasync());
+                else
+                    chunkdata.releasedata();
                 numreleased++;
             }
         }
@@ -1094,6 +1354,8 @@ private:
         if (chunkindex < windowbegin || chunkindex >= windowend)
             LogicError("requirerandomizedchunk: requested utterance outside in-memory chunk range");
 
+        waitforpagein(chunkindex);
+
         foreach_index (m, randomizedchunks)
         {
             auto &chunk = randomizedchunks[m][chunkindex];
@@ -1113,7 +1375,7 @@ private:
                     fprintf(stderr, "feature set %d: requirerandomizedchunk: paging in randomized chunk %d (frame range [%d..%d]), %d resident in RAM\n", m, (int) chunkindex, (int) chunk.globalts, (int) (chunk.globalte() - 1), (int) (chunksinram + 1));
                 msra::util::attempt(5, [&]() // (reading from network)
                                     {
-                                        chunkdata.requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, verbosity);
+                                        chunkdata.requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, verbosity, &latticemutex, mapfeatures);
                                     });
             }
             chunksinram++;
@@ -1159,11 +1421,36 @@ private:
     }
 
 public:
+    ~minibatchutterancesourcemulti()
+    {
+        waitforpaging();
+    }
+
     void setverbosity(int newverbosity)
     {
         verbosity = newverbosity;
     }
 
+    // number of chunks to page in concurrently ahead of need (0: synchronous paging)
+    void setchunkiothreads(size_t numthreads)
+    {
+        chunkiothreads = numthreads;
+    }
+
+    // page in features by memory-mapping the archives instead of reading them, if stored as native floats
+    // Chunks then refer to the OS page cache directly, which is shared with other processes mapping the same files.
+    void setmapfeatures(bool map)
+    {
+        mapfeatures = map;
+    }
+
+    // utterance mode: after randomizing, sort runs of 'n' consecutive utterances by length (0 or 1: no bucketing)
+    // Takes effect at the next randomization, so this is meant to be called right after construction.
+    void setbucketsize(size_t n)
+    {
+        bucketsize = n;
+    }
+
     // get the next minibatch
     // A minibatch is made up of one or more utterances.
     // We will return less than 'framesrequested' unless the first utterance is too long.
@@ -1222,6 +1509,16 @@ public:
                 if ((randomizedutterancerefs[pos].chunkindex % numsubsets) == subsetnum)
                     readfromdisk |= requirerandomizedchunk(randomizedutterancerefs[pos].chunkindex, windowbegin, windowend); // (window range passed in for checking only)
 
+            // page in the chunks of the next utterances in the background, as far as their windows are covered by the current one
+            if (chunkiothreads > 0)
+            {
+                std::vector<size_t> upcomingchunks;
+                for (size_t pos = epos; pos < numutterances && positionchunkwindows[pos].windowend() <= windowend && upcomingchunks.size() < 4 * chunkiothreads; pos++)
+                    if (!randomizedchunks[0][randomizedutterancerefs[pos].chunkindex].getchunkdata().isinram())
+                        upcomingchunks.push_back(randomizedutterancerefs[pos].chunkindex);
+                pageinahead(upcomingchunks, windowbegin, windowend, subsetnum, numsubsets);
+            }
+
             // Note that the above loop loops over all chunks incl. those that we already should have.
             // This has an effect, e.g., if 'numsubsets' has changed (we will fill gaps).
 
@@ -1293,19 +1590,20 @@ public:
                     assert(n == uttframes.cols() && uttref.numframes == n && chunkdata.numframes(uttref.utteranceindex) == n);
 
                     // copy the frames and class labels
-                    for (size_t t = 0; t < n; t++) // t = time index into source utterance
+                    size_t leftextent, rightextent;
+                    if (leftcontext[i] == 0 && rightcontext[i] == 0)
+                    {
+                        leftextent = rightextent = augmentationextent(uttframes.rows(), vdim[i]);
+                    }
+                    else
+                    {
+                        leftextent = leftcontext[i];
+                        rightextent = rightcontext[i];
+                    }
+                    // context expansion of the frames of an utterance: independent copies, done in parallel
+#pragma omp parallel for schedule(static)
+                    for (int t = 0; t < (int) n; t++) // t = time index into source utterance
                     {
-                        size_t leftextent, rightextent;
-                        // page in the needed range of frames
-                        if (leftcontext[i] == 0 && rightcontext[i] == 0)
-                        {
-                            leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
-                        }
-                        else
-                        {
-                            leftextent = leftcontext[i];
-                            rightextent = rightcontext[i];
-                        }
                         augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], t + tspos);
                         // augmentneighbors(uttframevectors, noboundaryflags, t, feat[i], t + tspos);
                     }
@@ -1371,8 +1669,20 @@ public:
             for (size_t k = windowbegin; k < windowend; k++)
                 if ((k % numsubsets) == subsetnum)                                     // in MPI mode, we skip chunks this way
                     readfromdisk |= requirerandomizedchunk(k, windowbegin, windowend); // (window range passed in for checking only, redundant here)
-            for (size_t k = windowend; k < randomizedchunks[0].size(); k++)
+            // with asynchronous paging, keep the next 'chunkiothreads' chunks of ours, which are paged in ahead of need
+            size_t aheadend = windowend;
+            for (size_t n = 0; aheadend < randomizedchunks[0].size() && n < chunkiothreads; aheadend++)
+                if ((aheadend % numsubsets) == subsetnum)
+                    n++;
+            for (size_t k = aheadend; k < randomizedchunks[0].size(); k++)
                 releaserandomizedchunk(k);
+            if (chunkiothreads > 0)
+            {
+                std::vector<size_t> upcomingchunks;
+                for (size_t k = windowend; k < aheadend; k++)
+                    upcomingchunks.push_back(k);
+                pageinahead(upcomingchunks, windowbegin, aheadend, subsetnum, numsubsets);
+            }
 
             // determine the true #frames we return--it is less than mbframes in the case of MPI/data-parallel sub-set mode
             // First determine it for all nodes, then pick the min over all nodes, as to give all the same #frames for better load balancing.
@@ -1412,10 +1722,13 @@ public:
             }
 
             // return randomized frames for the time range of those utterances
-            size_t currmpinodeframecount = 0;
+            // First determine the frames we return, in order; then gather them into the columns of feat[] and uids[].
+            // Each frame goes to a column of its own, so the gathering is done in parallel.
+            std::vector<const frameref *> gatheredframes;
+            gatheredframes.reserve(feat[0].cols());
             for (size_t j = 0; j < mbframes; j++)
             {
-                if (currmpinodeframecount >= feat[0].cols()) // MPI/data-parallel mode: all nodes return the same #frames, which is how feat(,) is allocated
+                if (gatheredframes.size() >= feat[0].cols()) // MPI/data-parallel mode: all nodes return the same #frames, which is how feat(,) is allocated
                     break;
 
                 // map to time index inside arrays
@@ -1428,7 +1741,13 @@ public:
 
                 // random utterance
                 readfromdisk |= requirerandomizedchunk(frameref.chunkindex, windowbegin, windowend); // (this is just a check; should not actually page in anything)
+                gatheredframes.push_back(&frameref);
+            }
 
+#pragma omp parallel for schedule(static)
+            for (int currmpinodeframecount = 0; currmpinodeframecount < (int) gatheredframes.size(); currmpinodeframecount++)
+            {
+                const frameref &frameref = *gatheredframes[currmpinodeframecount];
                 foreach_index (i, randomizedchunks)
                 {
                     const auto &chunk = randomizedchunks[i][frameref.chunkindex];
@@ -1462,8 +1781,6 @@ public:
                             uids[k][currmpinodeframecount] = frameclassids[k][t];
                     }
                 }
-
-                currmpinodeframecount++;
             }
         }
         timegetbatch = timergetbatch;
@@ -10,8 +10,11 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "ConcStack.h"
+#include "fileutil.h"
+#include "CUDAPageLockedMemAllocator.h"
 #include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <sstream> // TODO: this should go away once we update the parameter parsing
 #include <unordered_map>
 #include <opencv2/opencv.hpp>
@@ -95,6 +98,15 @@ public:
     // virtual void Init(const ScriptableObjects::IConfigRecord & config) override { InitFromConfig(config); }
 
     void Apply(cv::Mat& mat)
+    {
+        bool flip;
+        Apply(mat, flip);
+        if (flip)
+            cv::flip(mat, mat, 1);
+    }
+
+    // crop only, and return whether the crop is to be flipped; the fused path flips after resizing
+    void Apply(cv::Mat& mat, bool& flip)
     {
         auto seed = m_seed;
         auto rng = m_rngs.pop_or_create([seed]()
@@ -121,12 +133,17 @@ public:
             RuntimeError("Jitter type currently not implemented.");
         }
         mat = mat(GetCropRect(m_cropType, mat.rows, mat.cols, ratio, *rng));
-        if (m_hFlip && std::bernoulli_distribution()(*rng))
-            cv::flip(mat, mat, 1);
+        flip = m_hFlip && std::bernoulli_distribution()(*rng);
 
         m_rngs.push(std::move(rng));
     }
 
+    // smallest crop, relative to the shorter side of the image
+    double GetMinCropRatio() const
+    {
+        return m_cropRatioMin;
+    }
+
 private:
     using UniRealT = std::uniform_real_distribution<double>;
     using UniIntT = std::uniform_int_distribution<int>;
@@ -257,6 +274,12 @@ public:
         if (mat.type() != CV_MAKETYPE(m_dataType, m_imgChannels))
             mat.convertTo(mat, m_dataType);
 
+        Resize(mat);
+    }
+
+    // resize to width x height, keeping the element type
+    void Resize(cv::Mat& mat)
+    {
         auto seed = m_seed;
         auto rng = m_rngs.pop_or_create([seed]()
                                         {
@@ -270,6 +293,15 @@ public:
         m_rngs.push(std::move(rng));
     }
 
+    size_t GetWidth() const
+    {
+        return m_imgWidth;
+    }
+    size_t GetHeight() const
+    {
+        return m_imgHeight;
+    }
+
 private:
     using UniIntT = std::uniform_int_distribution<int>;
 
@@ -335,6 +367,11 @@ public:
             mat = mat - m_meanImg;
     }
 
+    const cv::Mat& GetMeanImage() const
+    {
+        return m_meanImg;
+    }
+
 private:
     cv::Mat m_meanImg;
 };
@@ -343,25 +380,62 @@ private:
 // ImageReader
 
 template <class ElemType>
-static void CopyFromImage(const cv::Mat& src, std::vector<ElemType>& dst, size_t ivDst, bool transpose);
+static void CopyFromImage(const cv::Mat& src, ElemType* dst, size_t ivDst, bool transpose);
 
-static std::launch GetLaunchPolicy(bool prefetch)
+// Get the dimensions of a JPEG image from its frame header, without decoding it.
+// Returns false if the data is not a JPEG image.
+static bool GetJpegSize(const unsigned char* data, size_t size, int& rows, int& cols)
 {
-    return prefetch ? std::launch::async : std::launch::deferred;
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) // SOI
+        return false;
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+            return false;
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) // fill byte
+        {
+            pos++;
+            continue;
+        }
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 9 > size)
+                return false;
+            rows = (data[pos + 5] << 8) | data[pos + 6];
+            cols = (data[pos + 7] << 8) | data[pos + 8];
+            return rows > 0 && cols > 0;
+        }
+        if (marker == 0xDA || marker == 0xD9) // start of scan or end of image before any frame header
+            return false;
+        pos += 2 + length;
+    }
+    return false;
 }
 
 template <class ElemType>
 ImageReader<ElemType>::ImageReader()
-    : m_seed(0), m_rng(m_seed), m_imgListRand(true), m_pMBLayout(make_shared<MBLayout>()), m_mbFmt(DataFormat::NCHW)
+    : m_seed(0), m_rng(m_seed), m_fusedTransforms(false), m_decodeDownscale(false), m_packed(false), m_chunkSize(256), m_prefetch(true), m_prefetchDepth(1), m_numCPUThreads(0), m_deviceId(CPUDEVICE), m_stopPrefetch(false), m_imgListRand(true), m_pMBLayout(make_shared<MBLayout>()), m_mbFmt(DataFormat::NCHW)
 {
-    m_transforms.push_back(std::make_unique<CropTransform>(m_seed));
-    m_transforms.push_back(std::make_unique<ScaleTransform>(sizeof(ElemType) == 4 ? CV_32F : CV_64F, m_seed));
-    m_transforms.push_back(std::make_unique<MeanTransform>());
+    auto crop = std::make_unique<CropTransform>(m_seed);
+    auto scale = std::make_unique<ScaleTransform>(sizeof(ElemType) == 4 ? CV_32F : CV_64F, m_seed);
+    auto mean = std::make_unique<MeanTransform>();
+    m_cropTransform = crop.get();
+    m_scaleTransform = scale.get();
+    m_meanTransform = mean.get();
+    m_transforms.push_back(std::move(crop));
+    m_transforms.push_back(std::move(scale));
+    m_transforms.push_back(std::move(mean));
 }
 
 template <class ElemType>
 ImageReader<ElemType>::~ImageReader()
 {
+    StopPrefetching();
+    CloseShardFiles();
 }
 
 template <class ElemType>
@@ -401,37 +475,65 @@ void ImageReader<ElemType>::InitFromConfig(const ConfigRecordType& config)
     for (auto& t : m_transforms)
         t->Init(featSect.second);
 
+    m_fusedTransforms = featSect.second(L"fusedTransforms", false);
+    m_decodeDownscale = featSect.second(L"decodeDownscale", false);
+    m_fusedMean.clear();
+    const cv::Mat& meanImg = m_meanTransform->GetMeanImage();
+    if (m_fusedTransforms && meanImg.size() == cv::Size(static_cast<int>(w), static_cast<int>(h)))
+    {
+        cv::Mat mean;
+        meanImg.convertTo(mean, sizeof(ElemType) == 4 ? CV_32F : CV_64F);
+        assert(mean.isContinuous() && mean.rows * mean.cols * mean.channels() == m_featDim);
+        auto data = reinterpret_cast<const ElemType*>(mean.ptr());
+        m_fusedMean.assign(data, data + m_featDim);
+    }
+
     SectionT labSect{gettter("labelDim")};
     m_labName = msra::strfun::utf16(labSect.first);
     m_labDim = labSect.second("labelDim");
 
-    std::string mapPath = config(L"file");
-    std::ifstream mapFile(mapPath);
-    if (!mapFile)
-        RuntimeError("Could not open %s for reading.", mapPath.c_str());
-
-    std::string line{""};
-    for (size_t cline = 0; std::getline(mapFile, line); cline++)
-    {
-        std::stringstream ss{line};
-        std::string imgPath;
-        std::string clsId;
-        if (!std::getline(ss, imgPath, '\t') || !std::getline(ss, clsId, '\t'))
-            RuntimeError("Invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.", mapPath.c_str(), static_cast<int>(cline));
-        m_files.push_back({imgPath, std::stoi(clsId)});
-    }
-
     std::string rand = config(L"randomize", "auto");
     if (AreEqual(rand, "none"))
         m_imgListRand = false;
     else if (!AreEqual(rand, "auto"))
         RuntimeError("Only Auto and None are currently supported.");
 
+    m_packed = config.Exists(L"packedIndex");
+    if (m_packed)
+    {
+        m_chunkSize = config(L"chunkSize", (size_t) 256);
+        if (m_chunkSize == 0)
+            RuntimeError("chunkSize must be at least 1.");
+        LoadPackedIndex(config(L"packedIndex"));
+        RandomizePackedSamples(false);
+    }
+    else
+    {
+        std::string mapPath = config(L"file");
+        std::ifstream mapFile(mapPath);
+        if (!mapFile)
+            RuntimeError("Could not open %s for reading.", mapPath.c_str());
+
+        std::string line{""};
+        for (size_t cline = 0; std::getline(mapFile, line); cline++)
+        {
+            std::stringstream ss{line};
+            std::string imgPath;
+            std::string clsId;
+            if (!std::getline(ss, imgPath, '\t') || !std::getline(ss, clsId, '\t'))
+                RuntimeError("Invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.", mapPath.c_str(), static_cast<int>(cline));
+            m_files.push_back({imgPath, std::stoi(clsId)});
+        }
+    }
+
     m_prefetch = config(L"prefetch", true);
+    m_prefetchDepth = config(L"prefetchDepth", (size_t) 1);
+    if (m_prefetchDepth == 0)
+        RuntimeError("prefetchDepth must be at least 1.");
 
-    int cthread = config(L"numCPUThreads", 0);
-    if (cthread > 0)
-        omp_set_num_threads(cthread);
+    m_numCPUThreads = config(L"numCPUThreads", 0);
+    if (m_numCPUThreads > 0)
+        omp_set_num_threads(m_numCPUThreads);
 
     m_epochStart = 0;
     m_mbStart = 0;
@@ -439,9 +541,86 @@ void ImageReader<ElemType>::InitFromConfig(const ConfigRecordType& config)
 //template<class ElemType> virtual void ImageReader<ElemType>::Init(const ConfigParameters & config);
 //template<class ElemType> virtual void ImageReader<ElemType>::Init(const ScriptableObjects::IConfigRecord & config);
 
+// Read the index written by PackImages.py, with lines of the form
+// <shard file><tab><byte offset><tab><size in bytes><tab><numerical label>
+// Relative shard paths are relative to the directory of the index.
+template <class ElemType>
+void ImageReader<ElemType>::LoadPackedIndex(const std::string& indexPath)
+{
+    std::ifstream indexFile(indexPath);
+    if (!indexFile)
+        RuntimeError("Could not open %s for reading.", indexPath.c_str());
+
+    size_t pos = indexPath.find_last_of("/\\");
+    std::string indexDir = (pos == std::string::npos) ? std::string() : indexPath.substr(0, pos + 1);
+
+    std::unordered_map<std::string, size_t> shardIds;
+    std::string line{""};
+    for (size_t cline = 0; std::getline(indexFile, line); cline++)
+    {
+        std::stringstream ss{line};
+        std::string shardPath, offset, size, clsId;
+        if (!std::getline(ss, shardPath, '\t') || !std::getline(ss, offset, '\t') || !std::getline(ss, size, '\t') || !std::getline(ss, clsId, '\t'))
+            RuntimeError("Invalid packed index format, must contain 4 tab-delimited columns: %s, line: %d.", indexPath.c_str(), static_cast<int>(cline));
+
+        auto shard = shardIds.find(shardPath);
+        if (shard == shardIds.end())
+        {
+            bool isAbsolute = shardPath[0] == '/' || shardPath[0] == '\\' || shardPath.find(':') != std::string::npos;
+            m_shardPaths.push_back(isAbsolute ? shardPath : indexDir + shardPath);
+            shard = shardIds.insert({shardPath, m_shardPaths.size() - 1}).first;
+        }
+
+        PackedSample s;
+        s.shard = shard->second;
+        s.offset = std::stoull(offset);
+        s.size = std::stoull(size);
+        s.label = std::stoi(clsId);
+
+        // a chunk is a run of up to m_chunkSize consecutive samples of one shard
+        if (m_packedIndex.empty() || m_packedIndex.back().shard != s.shard || m_packedIndex.size() - m_chunkBegins.back() >= m_chunkSize)
+            m_chunkBegins.push_back(m_packedIndex.size());
+        m_packedIndex.push_back(s);
+    }
+    m_shardFiles.assign(m_shardPaths.size(), nullptr);
+}
+
+// (Re-)build the epoch order of the packed samples, shuffling whole chunks if 'randomize'.
+template <class ElemType>
+void ImageReader<ElemType>::RandomizePackedSamples(bool randomize)
+{
+    std::vector<size_t> chunks(m_chunkBegins.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+        chunks[i] = i;
+    if (randomize)
+        std::shuffle(chunks.begin(), chunks.end(), m_rng);
+
+    m_packedSamples.clear();
+    m_packedSamples.reserve(m_packedIndex.size());
+    for (size_t chunk : chunks)
+    {
+        size_t begin = m_chunkBegins[chunk];
+        size_t end = (chunk + 1 < m_chunkBegins.size()) ? m_chunkBegins[chunk + 1] : m_packedIndex.size();
+        m_packedSamples.insert(m_packedSamples.end(), m_packedIndex.begin() + begin, m_packedIndex.begin() + end);
+    }
+}
+
+template <class ElemType>
+void ImageReader<ElemType>::CloseShardFiles()
+{
+    for (auto& f : m_shardFiles)
+    {
+        if (f)
+            fclose(f);
+        f = nullptr;
+    }
+}
+
 template <class ElemType>
 void ImageReader<ElemType>::Destroy()
 {
+    StopPrefetching();
+    CloseShardFiles();
 }
 
 template <class ElemType>
@@ -452,30 +631,128 @@ void ImageReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t
     assert(subsetNum < numSubsets);
     assert(requestedEpochSamples > 0);
 
+    // the prefetch thread of the previous epoch may still be running ahead
+    StopPrefetching();
+
     m_subsetNum = subsetNum;
     m_numSubsets = numSubsets;
 
-    if (m_imgListRand)
+    if (m_packed)
+        RandomizePackedSamples(m_imgListRand);
+    else if (m_imgListRand)
         std::shuffle(m_files.begin(), m_files.end(), m_rng);
 
-    m_epochSize = (requestedEpochSamples == requestDataSize ? m_files.size() : requestedEpochSamples);
+    m_epochSize = (requestedEpochSamples == requestDataSize ? NumSamples() : requestedEpochSamples);
     m_mbSize = mbSize;
     // REVIEW alexeyk: if user provides epoch size explicitly then we assume epoch size is a multiple of mbsize, is this ok?
     assert(requestedEpochSamples == requestDataSize || (m_epochSize % m_mbSize) == 0);
     m_epoch = epoch;
     m_epochStart = m_epoch * m_epochSize;
-    if (m_epochStart >= m_files.size())
+    if (m_epochStart >= NumSamples())
     {
         m_epochStart = 0;
         m_mbStart = 0;
     }
 
-    m_featBuf.resize(m_mbSize * m_featDim);
-    m_labBuf.resize(m_mbSize * m_labDim);
-    m_mbPrefetchFut = std::async(GetLaunchPolicy(m_prefetch), [this]()
-                                 {
-                                     return ReadImages();
-                                 });
+    m_buffers.resize(m_prefetch ? m_prefetchDepth : 1);
+    m_freeBuffers.clear();
+    m_readyBuffers.clear();
+    for (size_t i = 0; i < m_buffers.size(); i++)
+    {
+        AllocateBuffer(m_buffers[i], m_deviceId);
+        m_freeBuffers.push_back(i);
+    }
+
+    if (m_prefetch)
+    {
+        m_stopPrefetch = false;
+        m_prefetchThread = std::thread([this]()
+                                       {
+                                           PrefetchImages();
+                                       });
+    }
+}
+
+// Runs on m_prefetchThread: fill free buffers in minibatch order until the end of the epoch.
+template <class ElemType>
+void ImageReader<ElemType>::PrefetchImages()
+{
+    // OpenMP settings are per thread, so numCPUThreads must be applied to this one as well
+    if (m_numCPUThreads > 0)
+        omp_set_num_threads(m_numCPUThreads);
+
+    for (;;)
+    {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_bufferFreed.wait(lock, [this]()
+                               {
+                                   return m_stopPrefetch || !m_freeBuffers.empty();
+                               });
+            if (m_stopPrefetch)
+                return;
+            i = m_freeBuffers.front();
+            m_freeBuffers.pop_front();
+        }
+
+        MinibatchBuffer& buffer = m_buffers[i];
+        try
+        {
+            buffer.mbSize = ReadImages(buffer);
+        }
+        catch (...)
+        {
+            buffer.mbSize = 0;
+            buffer.error = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_readyBuffers.push_back(i);
+        }
+        m_bufferReady.notify_all();
+
+        if (buffer.mbSize == 0) // end of epoch (or error), which GetMinibatch() will keep reporting
+            return;
+    }
+}
+
+template <class ElemType>
+void ImageReader<ElemType>::StopPrefetching()
+{
+    if (!m_prefetchThread.joinable())
+        return;
+    {
+        std::unique_lock<std::mutex> lock(m_prefetchMutex);
+        m_stopPrefetch = true;
+    }
+    m_bufferFreed.notify_all();
+    m_prefetchThread.join();
+}
+
+// allocate a buffer for a full minibatch; page-locked memory if it is meant for a GPU
+template <class ElemType>
+void ImageReader<ElemType>::AllocateBuffer(MinibatchBuffer& buffer, DEVICEID_TYPE deviceId)
+{
+    auto allocate = [deviceId](size_t numElements) -> std::shared_ptr<ElemType>
+    {
+        if (deviceId >= 0)
+            return std::shared_ptr<ElemType>((ElemType*) CUDAPageLockedMemAllocator::Malloc(sizeof(ElemType) * numElements, deviceId), [deviceId](ElemType* p)
+                                             {
+                                                 CUDAPageLockedMemAllocator::Free(p, deviceId);
+                                             });
+        else
+            return std::shared_ptr<ElemType>(new ElemType[numElements], [](ElemType* p)
+                                             {
+                                                 delete[] p;
+                                             });
+    };
+    buffer.feat = allocate(m_mbSize * m_featDim);
+    buffer.lab = allocate(m_mbSize * m_labDim);
+    buffer.deviceId = deviceId;
+    buffer.mbSize = 0;
+    buffer.error = nullptr;
 }
 
 template <class ElemType>
@@ -485,24 +762,56 @@ bool ImageReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>
     assert(matrices.find(m_featName) != matrices.end());
     assert(m_mbSize > 0);
 
-    size_t mbSize = m_mbPrefetchFut.valid() ? m_mbPrefetchFut.get() : 0;
+    size_t i = 0;
+    if (!m_prefetch)
+        m_buffers[i].mbSize = ReadImages(m_buffers[i]);
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_prefetchMutex);
+        m_bufferReady.wait(lock, [this]()
+                           {
+                               return !m_readyBuffers.empty();
+                           });
+        i = m_readyBuffers.front();
+        m_readyBuffers.pop_front();
+    }
 
+    MinibatchBuffer& buffer = m_buffers[i];
+    size_t mbSize = buffer.mbSize;
     if (mbSize == 0)
+    {
+        // end of epoch: leave the buffer in the queue, so that we keep returning false
+        if (m_prefetch)
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_readyBuffers.push_front(i);
+        }
+        if (buffer.error)
+            std::rethrow_exception(buffer.error);
         return false;
+    }
 
     Matrix<ElemType>& features = *matrices[m_featName];
-    features.SetValue(m_featDim, mbSize, features.GetDeviceId(), m_featBuf.data(), matrixFlagNormal);
+    features.SetValue(m_featDim, mbSize, features.GetDeviceId(), buffer.feat.get(), matrixFlagNormal);
 
     Matrix<ElemType>& labels = *matrices[m_labName];
-    labels.SetValue(m_labDim, mbSize, labels.GetDeviceId(), m_labBuf.data(), matrixFlagNormal);
+    labels.SetValue(m_labDim, mbSize, labels.GetDeviceId(), buffer.lab.get(), matrixFlagNormal);
 
     m_pMBLayout->InitAsFrameMode(mbSize);
 
-    // It is safe to run prefetching with just one buffer as SetValue is synchronous so there will be no race.
-    m_mbPrefetchFut = std::async(GetLaunchPolicy(m_prefetch), [this]()
-                                 {
-                                     return ReadImages();
-                                 });
+    // SetValue() is synchronous, so the buffer can be reused right away;
+    // switch it to page-locked memory if the minibatches turned out to go to a GPU
+    m_deviceId = features.GetDeviceId();
+    if (buffer.deviceId != m_deviceId)
+        AllocateBuffer(buffer, m_deviceId);
+    if (m_prefetch)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_prefetchMutex);
+            m_freeBuffers.push_back(i);
+        }
+        m_bufferFreed.notify_all();
+    }
 
     return true;
 }
@@ -520,7 +829,7 @@ bool ImageReader<ElemType>::DataEnd(EndDataType endDataType)
         ret = m_mbStart < m_epochStart + m_epochSize;
         break;
     case endDataSet:
-        ret = m_mbStart >= m_files.size();
+        ret = m_mbStart >= NumSamples();
         break;
     case endDataSentence:
         ret = true;
@@ -537,58 +846,173 @@ void ImageReader<ElemType>::SetRandomSeed(unsigned int seed)
 }
 
 template <class ElemType>
-size_t ImageReader<ElemType>::ReadImages()
+size_t ImageReader<ElemType>::ReadImages(MinibatchBuffer& buffer)
 {
-    if (m_mbStart >= m_files.size() || m_mbStart >= m_epochStart + m_epochSize)
+    if (m_mbStart >= NumSamples() || m_mbStart >= m_epochStart + m_epochSize)
         return 0;
 
     size_t mbLim = m_mbStart + m_mbSize;
-    if (mbLim > m_files.size())
-        mbLim = m_files.size();
+    if (mbLim > NumSamples())
+        mbLim = NumSamples();
 
-    std::fill(m_labBuf.begin(), m_labBuf.end(), static_cast<ElemType>(0));
+    ElemType* featBuf = buffer.feat.get();
+    ElemType* labBuf = buffer.lab.get();
+    std::fill(labBuf, labBuf + m_mbSize * m_labDim, static_cast<ElemType>(0));
 
     size_t actualMBSize = mbLim - m_mbStart;
     size_t iStart = actualMBSize * m_subsetNum / m_numSubsets;
     size_t iLim = actualMBSize * (m_subsetNum + 1) / m_numSubsets;
     size_t subsetSize = iLim - iStart;
 
-#pragma omp parallel for ordered schedule(dynamic)
+    // In packed mode, fetch the encoded images of our slice with one read per run of adjacent samples,
+    // which is typically one or two reads per minibatch.
+    std::vector<size_t> encodedPos;
+    if (m_packed)
+    {
+        const PackedSample* samples = m_packedSamples.data() + m_mbStart + iStart;
+        encodedPos.resize(subsetSize);
+        size_t totalSize = 0;
+        for (size_t i = 0; i < subsetSize; i++)
+        {
+            encodedPos[i] = totalSize;
+            totalSize += samples[i].size;
+        }
+        m_readBuffer.resize(totalSize);
+
+        for (size_t runStart = 0, runEnd; runStart < subsetSize; runStart = runEnd)
+        {
+            for (runEnd = runStart + 1; runEnd < subsetSize; runEnd++)
+            {
+                const auto& prev = samples[runEnd - 1];
+                if (samples[runEnd].shard != prev.shard || samples[runEnd].offset != prev.offset + prev.size)
+                    break;
+            }
+            FILE*& f = m_shardFiles[samples[runStart].shard];
+            if (!f)
+                f = fopenOrDie(m_shardPaths[samples[runStart].shard], "rb");
+            size_t runSize = (runEnd < subsetSize ? encodedPos[runEnd] : totalSize) - encodedPos[runStart];
+            fsetpos(f, samples[runStart].offset);
+            freadOrDie(m_readBuffer.data() + encodedPos[runStart], 1, runSize, f);
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic)
     for (long long i = 0; i < static_cast<long long>(subsetSize); i++)
     {
-        const auto& p = m_files[m_mbStart + iStart + i];
-        cv::Mat img{cv::imread(p.first, cv::IMREAD_COLOR)};
-        if (!img.data)
-            RuntimeError("Cannot read image file %s", p.first.c_str());
-        for (auto& t : m_transforms)
-            t->Apply(img);
+        cv::Mat img;
+        int label;
+        if (!m_packed)
+        {
+            const auto& p = m_files[m_mbStart + iStart + i];
+            if (!m_decodeDownscale)
+                img = cv::imread(p.first, cv::IMREAD_COLOR);
+            else
+            {
+                // we need the JPEG header to pick the scale, so read the file ourselves
+                std::ifstream file(p.first, std::ios::binary);
+                std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                if (!encoded.empty())
+                    img = DecodeImage(encoded.data(), encoded.size());
+            }
+            if (!img.data)
+                RuntimeError("Cannot read image file %s", p.first.c_str());
+            label = p.second;
+        }
+        else
+        {
+            const auto& s = m_packedSamples[m_mbStart + iStart + i];
+            img = DecodeImage(m_readBuffer.data() + encodedPos[i], s.size);
+            if (!img.data)
+                RuntimeError("Cannot decode image at offset %llu of %s", (unsigned long long) s.offset, m_shardPaths[s.shard].c_str());
+            label = s.label;
+        }
 
-        assert(img.rows * img.cols * img.channels() == m_featDim);
-        // When IMREAD_COLOR is used, OpenCV stores image in BGR format.
-        // Transpose is required if requested mini-batch format is NCHW.
-        CopyFromImage(img, m_featBuf, m_featDim * i, m_mbFmt == DataFormat::NCHW);
-        m_labBuf[m_labDim * i + p.second] = 1;
+        if (m_fusedTransforms)
+            ApplyFusedTransforms(img, featBuf + m_featDim * i);
+        else
+        {
+            for (auto& t : m_transforms)
+                t->Apply(img);
+
+            assert(img.rows * img.cols * img.channels() == m_featDim);
+            // When IMREAD_COLOR is used, OpenCV stores image in BGR format.
+            // Transpose is required if requested mini-batch format is NCHW.
+            CopyFromImage(img, featBuf, m_featDim * i, m_mbFmt == DataFormat::NCHW);
+        }
+        labBuf[m_labDim * i + label] = 1;
     }
 
     m_mbStart += actualMBSize;
     return subsetSize;
 }
 
+// Decode an image from memory, if decodeDownscale at the smallest 1/2^k of its size that still leaves the smallest
+// crop at least as large as the target size.
+template <class ElemType>
+cv::Mat ImageReader<ElemType>::DecodeImage(const unsigned char* data, size_t size) const
+{
+    int flags = cv::IMREAD_COLOR;
+    int rows, cols;
+    if (m_decodeDownscale && GetJpegSize(data, size, rows, cols))
+    {
+        double minCrop = std::min(rows, cols) * m_cropTransform->GetMinCropRatio();
+        double target = (double) std::max(m_scaleTransform->GetWidth(), m_scaleTransform->GetHeight());
+        if (minCrop >= 8 * target)
+            flags = cv::IMREAD_REDUCED_COLOR_8;
+        else if (minCrop >= 4 * target)
+            flags = cv::IMREAD_REDUCED_COLOR_4;
+        else if (minCrop >= 2 * target)
+            flags = cv::IMREAD_REDUCED_COLOR_2;
+    }
+    cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<unsigned char*>(data));
+    return cv::imdecode(encoded, flags);
+}
+
+// Equivalent of running m_transforms followed by CopyFromImage(), but resizing the 8-bit crop directly
+// (instead of a floating-point copy of it) and converting the result only once.
+template <class ElemType>
+void ImageReader<ElemType>::ApplyFusedTransforms(cv::Mat& img, ElemType* dst)
+{
+    bool flip;
+    m_cropTransform->Apply(img, flip); // a view into the decoded image, no copy
+    m_scaleTransform->Resize(img);
+    if (flip)
+        cv::flip(img, img, 1);
+
+    assert(img.type() == CV_8UC3 && img.isContinuous());
+    assert(img.rows * img.cols * img.channels() == m_featDim);
+    const unsigned char* src = img.ptr();
+    const ElemType* mean = m_fusedMean.empty() ? nullptr : m_fusedMean.data();
+    size_t crow = img.rows * img.cols;
+    size_t ccol = img.channels();
+    bool transpose = m_mbFmt == DataFormat::NCHW;
+    for (size_t irow = 0; irow < crow; irow++)
+    {
+        for (size_t icol = 0; icol < ccol; icol++)
+        {
+            size_t iSrc = irow * ccol + icol;
+            ElemType v = static_cast<ElemType>(src[iSrc]);
+            if (mean)
+                v -= mean[iSrc];
+            dst[transpose ? icol * crow + irow : iSrc] = v;
+        }
+    }
+}
+
 template class ImageReader<double>;
 template class ImageReader<float>;
 
 template <class ElemType>
-static void CopyFromImage(const cv::Mat& src, std::vector<ElemType>& dst, size_t ivDst, bool transpose)
+static void CopyFromImage(const cv::Mat& src, ElemType* dst, size_t ivDst, bool transpose)
 {
     assert(src.isContinuous());
     assert(src.channels() == 3);
 
     size_t count = src.rows * src.cols * src.channels();
-    assert(ivDst + count <= dst.size());
 
     auto data = reinterpret_cast<const ElemType*>(src.ptr());
     if (!transpose)
-        std::copy(data, data + count, dst.begin() + ivDst);
+        std::copy(data, data + count, dst + ivDst);
     else
     {
         size_t crow = src.rows * src.cols;
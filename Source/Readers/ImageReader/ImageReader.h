@@ -9,13 +9,24 @@
 #include "DataReader.h"
 #include <random>
 #include <memory>
-#include <future>
 #include <array>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace cv {
+class Mat;
+}
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // REVIEW alexeyk: can't put it into ImageReader itself as ImageReader is a template.
 class ITransform;
+class CropTransform;
+class ScaleTransform;
+class MeanTransform;
 
 template <class ElemType>
 class ImageReader : public IDataReader<ElemType>
@@ -83,6 +94,18 @@ private:
     std::mt19937 m_rng;
 
     std::vector<std::unique_ptr<ITransform>> m_transforms;
+    CropTransform* m_cropTransform; // the elements of m_transforms, for the fused path
+    ScaleTransform* m_scaleTransform;
+    MeanTransform* m_meanTransform;
+
+    // Fused path (fusedTransforms=true): crop and resize the 8-bit decoded image, and subtract the mean while
+    // converting it to ElemType and to the minibatch format in one pass into the minibatch buffer, rather than
+    // running m_transforms one by one on floating-point copies of the full image.
+    bool m_fusedTransforms;
+    std::vector<ElemType> m_fusedMean; // mean image as HWC ElemType; empty if none
+    // Let libjpeg decode at 1/2, 1/4 or 1/8 of the size (decodeDownscale=true) where even the smallest crop
+    // is still at least as large as the target size.
+    bool m_decodeDownscale;
 
     std::wstring m_featName;
     std::wstring m_labName;
@@ -93,6 +116,27 @@ private:
     using StrIntPairT = std::pair<std::string, int>;
     std::vector<StrIntPairT> m_files;
 
+    // Packed mode (packedIndex=...): instead of one file per image, the encoded images are stored back to back in a few
+    // large shard files written by PackImages.py, and m_packedSamples holds their location. Randomization shuffles the
+    // order of chunks of m_chunkSize consecutive samples, so that the samples of a minibatch slice are (mostly) adjacent
+    // in a shard and can be fetched with one large sequential read; shuffle the samples once when packing them.
+    struct PackedSample
+    {
+        size_t shard;  // index into m_shardPaths
+        uint64_t offset;
+        size_t size;   // of the encoded image, in bytes
+        int label;
+    };
+
+    bool m_packed;
+    size_t m_chunkSize;
+    std::vector<std::string> m_shardPaths;
+    std::vector<FILE*> m_shardFiles;            // opened on first use
+    std::vector<PackedSample> m_packedIndex;   // in file order
+    std::vector<size_t> m_chunkBegins;         // index into m_packedIndex of the first sample of each chunk
+    std::vector<PackedSample> m_packedSamples; // in epoch order
+    std::vector<unsigned char> m_readBuffer;
+
     size_t m_epochSize;
     size_t m_mbSize;
     size_t m_epoch;
@@ -103,10 +147,30 @@ private:
     size_t m_subsetNum;
     size_t m_numSubsets;
 
+    // Prefetching: a dedicated thread decodes and transforms the next m_prefetchDepth minibatches (in parallel with
+    // OpenMP, using m_numCPUThreads) into a ring of host buffers while the current one is being trained on.
+    // Buffers are page-locked once we know that the minibatches go to a GPU, for faster host-to-device copies.
+    struct MinibatchBuffer
+    {
+        std::shared_ptr<ElemType> feat;
+        std::shared_ptr<ElemType> lab;
+        DEVICEID_TYPE deviceId; // device the buffers were allocated for (pinned if >= 0)
+        size_t mbSize;          // number of samples read into it; 0 at end of epoch
+        std::exception_ptr error;
+    };
+
     bool m_prefetch;
-    std::future<size_t> m_mbPrefetchFut;
-    std::vector<ElemType> m_featBuf;
-    std::vector<ElemType> m_labBuf;
+    size_t m_prefetchDepth;
+    int m_numCPUThreads;
+    DEVICEID_TYPE m_deviceId; // device of the minibatch matrices, as last seen by GetMinibatch()
+    std::vector<MinibatchBuffer> m_buffers;
+    std::deque<size_t> m_freeBuffers;  // indices into m_buffers of buffers the prefetch thread can fill
+    std::deque<size_t> m_readyBuffers; // ... and of filled buffers, in minibatch order
+    std::thread m_prefetchThread;
+    std::mutex m_prefetchMutex;
+    std::condition_variable m_bufferFreed;
+    std::condition_variable m_bufferReady;
+    bool m_stopPrefetch;
 
     bool m_imgListRand;
 
@@ -114,6 +178,18 @@ private:
     DataFormat m_mbFmt;
 
 private:
-    size_t ReadImages();
+    size_t NumSamples() const
+    {
+        return m_packed ? m_packedSamples.size() : m_files.size();
+    }
+    void LoadPackedIndex(const std::string& indexPath);
+    void RandomizePackedSamples(bool randomize);
+    void CloseShardFiles();
+    size_t ReadImages(MinibatchBuffer& buffer);
+    cv::Mat DecodeImage(const unsigned char* data, size_t size) const;
+    void ApplyFusedTransforms(cv::Mat& img, ElemType* dst);
+    void PrefetchImages();
+    void StopPrefetching();
+    void AllocateBuffer(MinibatchBuffer& buffer, DEVICEID_TYPE deviceId);
 };
 } } }
@@ -0,0 +1,63 @@
+# Packs the images listed in an ImageReader map file into a few large shard files plus an index, for use with
+# ImageReader's packedIndex option. Reading the shards streams large sequential blocks instead of opening one
+# small file per sample, which matters a lot on network file systems.
+#
+# Input: map file with lines <path to image><tab><numerical label>, as for ImageReader's 'file' option.
+# Output: <prefix>.<k>.bin, the encoded images (unchanged, e.g. JPEG) stored back to back, and
+#         <prefix>.idx, with lines <shard file><tab><byte offset><tab><size in bytes><tab><numerical label>.
+#
+# ImageReader randomizes the order of chunks of consecutive samples only, so the samples should be shuffled once
+# here (the default) rather than packed class by class.
+#
+# Example:
+#   python PackImages.py --shardSize 1024 train_map.txt /data/ImageNet/train_packed
+
+import argparse
+import os
+import random
+
+def main():
+    parser = argparse.ArgumentParser(description = 'Pack images and labels into shard files for ImageReader.')
+    parser.add_argument('mapFile', help = 'map file: <path to image><tab><numerical label>')
+    parser.add_argument('prefix', help = 'output prefix: writes <prefix>.<k>.bin and <prefix>.idx')
+    parser.add_argument('--shardSize', type = int, default = 1024, help = 'approximate shard size in MB (default: 1024)')
+    parser.add_argument('--noShuffle', action = 'store_true', help = 'keep the order of the map file')
+    parser.add_argument('--seed', type = int, default = 1, help = 'random seed for shuffling (default: 1)')
+    args = parser.parse_args()
+
+    samples = []
+    with open(args.mapFile) as mapFile:
+        for cline, line in enumerate(mapFile):
+            cols = line.rstrip('\r\n').split('\t')
+            if len(cols) < 2:
+                raise ValueError('Invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.' % (args.mapFile, cline))
+            samples.append((cols[0], int(cols[1])))
+
+    if not args.noShuffle:
+        random.Random(args.seed).shuffle(samples)
+
+    # shard paths in the index are relative to its directory, so that packed data sets can be moved around
+    shardLimit = args.shardSize * 1024 * 1024
+    shard = None
+    shardId = -1
+    offset = 0
+    with open(args.prefix + '.idx', 'w') as index:
+        for imgPath, label in samples:
+            with open(imgPath, 'rb') as img:
+                data = img.read()
+            if shard is None or (offset > 0 and offset + len(data) > shardLimit):
+                if shard is not None:
+                    shard.close()
+                shardId += 1
+                shardPath = '%s.%d.bin' % (args.prefix, shardId)
+                shard = open(shardPath, 'wb')
+                shardName = os.path.basename(shardPath)
+                offset = 0
+            shard.write(data)
+            index.write('%s\t%d\t%d\t%d\n' % (shardName, offset, len(data), label))
+            offset += len(data)
+    if shard is not None:
+        shard.close()
+
+if __name__ == '__main__':
+    main()
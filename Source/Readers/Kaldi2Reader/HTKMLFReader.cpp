@@ -46,6 +46,7 @@ void HTKMLFReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
 {
     m_mbiter = NULL;
     m_frameSource = NULL;
+    m_readAheadSource = NULL;
     m_lattices = NULL;
     m_seqTrainDeriv = NULL;
     m_uttDerivBuffer = NULL;
@@ -557,6 +558,14 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     {
         RuntimeError("readMethod must be rollingWindow or blockRandomize");
     }
+
+    // Reads minibatches ahead in the background; this hides the latency of
+    // Kaldi feature pipes and of paging in chunks in utterance mode.
+    size_t readAheadDepth = readerConfig(L"readAheadDepth", (size_t) 0);
+    if (readAheadDepth > 0)
+    {
+        m_readAheadSource = new msra::dbn::minibatchreadaheadsource(*m_frameSource, readAheadDepth);
+    }
 }
 
 // Loads input and output data for training and testing. Below we list the
@@ -674,6 +683,11 @@ HTKMLFReader<ElemType>::~HTKMLFReader()
         delete m_mbiter;
         m_mbiter = NULL;
     }
+    if (m_readAheadSource != NULL) // (before the source it reads from)
+    {
+        delete m_readAheadSource;
+        m_readAheadSource = NULL;
+    }
     if (m_frameSource != NULL)
     {
         delete m_frameSource;
@@ -813,6 +827,11 @@ void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size
         m_mbiter = NULL;
     }
     msra::dbn::minibatchsource* source = m_frameSource;
+    if (m_readAheadSource != NULL)
+    {
+        m_readAheadSource->startepoch((epoch + 1) * requestedEpochSamples); // (as computed by the minibatchiterator)
+        source = m_readAheadSource;
+    }
     size_t currentMBSize = (m_framemode == true) ? mbSize : 1;
     m_mbiter = new msra::dbn::minibatchiterator(*source, epoch, requestedEpochSamples, currentMBSize, datapasses);
 
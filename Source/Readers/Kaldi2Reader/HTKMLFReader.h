@@ -8,6 +8,7 @@
 #include "DataReader.h"
 #include "KaldiSequenceTrainingDerivative.h"
 #include "UtteranceDerivativeBuffer.h"
+#include "readaheadsource.h"
 #include "Config.h" // for intargvector
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -19,7 +20,7 @@ private:
     msra::dbn::minibatchiterator* m_mbiter;
     msra::dbn::minibatchsource* m_frameSource;
     vector<msra::asr::FeatureSection*> m_trainingOrTestingFeatureSections;
-    // msra::dbn::minibatchreadaheadsource* m_readAheadSource;
+    msra::dbn::minibatchreadaheadsource* m_readAheadSource; // wraps m_frameSource if readAheadDepth > 0
     msra::dbn::FileEvalSource* m_fileEvalSource;
     vector<msra::asr::FeatureSection*> m_writingFeatureSections;
     msra::dbn::latticesource* m_lattices;
@@ -4,6 +4,7 @@
 #include "Matrix.h"
 #include "basetypes.h"
 #include "UtteranceDerivativeComputationInterface.h"
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,6 +24,10 @@ private:
     kaldi::RandomAccessCompactLatticeReader* m_denlatReader;
     kaldi::RandomAccessInt32VectorReader* m_aliReader;
 
+    // Derivatives of several utterances are computed concurrently; the Kaldi
+    // readers are not thread-safe, so accesses to them are serialized.
+    mutable std::mutex m_readerMutex;
+
     // Rescores the lattice with the lastest posteriors from the neural network.
     void LatticeAcousticRescore(const wstring& uttID,
                                 const Matrix<ElemType>& outputs,
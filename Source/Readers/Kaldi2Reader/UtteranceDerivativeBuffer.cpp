@@ -138,11 +138,20 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 m_uttPool[uttID].progress += numFrames;
                 if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
+                    // Computes the derivative in the background. Elements of
+                    // <m_uttPool> do not move when others are inserted, and
+                    // this one is not touched until it has been waited for.
+                    UtteranceDerivativeUnit* unit = &m_uttPool[uttID];
+                    UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface = m_derivativeInterface;
+                    m_pendingDerivatives[uttID] = std::async(
+                        std::launch::async, [uttID, unit, derivativeInterface]()
+                        {
+                            derivativeInterface->ComputeDerivative(
+                                uttID,
+                                unit->logLikelihood,
+                                &unit->derivative,
+                                &unit->objective);
+                        });
                     m_uttPool[uttID].hasDerivative = true;
                     m_uttPool[uttID].progress = 0;
                     m_uttReady[m_uttPool[uttID].streamID] = true;
@@ -198,6 +207,8 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
                              uttID.c_str());
             }
 
+            WaitForDerivative(uttID);
+
             // Assign the derivatives.
             assert(uttID == uttInfoInMinibatch[i][j].first);
             size_t startFrame = uttInfoInMinibatch[i][j].second.first;
@@ -264,6 +275,20 @@ bool UtteranceDerivativeBuffer<ElemType>::GetObjective(
     return true;
 }
 
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForDerivative(
+    const wstring& uttID)
+{
+    auto iter = m_pendingDerivatives.find(uttID);
+    if (iter == m_pendingDerivatives.end())
+    {
+        return;
+    }
+    std::future<void> pending = std::move(iter->second);
+    m_pendingDerivatives.erase(iter);
+    pending.get();
+}
+
 template <class ElemType>
 bool UtteranceDerivativeBuffer<ElemType>::HasResourceForDerivative(
     const wstring& uttID) const
@@ -307,6 +332,11 @@ bool UtteranceDerivativeBuffer<ElemType>::CompareUttInfo(
 template <class ElemType>
 void UtteranceDerivativeBuffer<ElemType>::ResetEpoch()
 {
+    // Lets computations in flight finish before their buffers go away.
+    while (!m_pendingDerivatives.empty())
+    {
+        WaitForDerivative(m_pendingDerivatives.begin()->first);
+    }
     m_needLikelihood = true;
     m_currentObj = 0;
     m_epochEnd = false;
@@ -4,12 +4,17 @@
 #include "basetypes.h"
 #include "Sequences.h"
 #include "UtteranceDerivativeComputationInterface.h"
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This class "gules" together the log-likelihood from different minibatches,
 // and then calls <UtteranceDerivativeComputationInterface> class to compute
-// the derivative for given utterance.
+// the derivative for given utterance. The derivative of an utterance is
+// computed asynchronously as soon as its log-likelihood is complete, so that
+// the derivatives of the streams are computed concurrently with each other
+// and with the forward passes for the streams still being read; it is waited
+// for when it is first needed in GetDerivative().
 template <class ElemType>
 class UtteranceDerivativeBuffer
 {
@@ -44,6 +49,14 @@ private:
     unordered_map<wstring, UtteranceDerivativeUnit> m_uttPool;
     UtteranceDerivativeComputationInterface<ElemType>* m_derivativeInterface;
 
+    // Derivative computations in flight, by utterance. Declared after
+    // <m_uttPool> so that they are waited for before it is destroyed.
+    unordered_map<wstring, std::future<void>> m_pendingDerivatives;
+
+    // Waits for the derivative of <uttID> if it is still being computed;
+    // rethrows errors of the computation.
+    void WaitForDerivative(const wstring& uttID);
+
     // <uttInfoInMinibatch> is a vector of vector of the following:
     //     uttID startFrameIndexInMinibatch numFrames
     void ProcessUttInfo(
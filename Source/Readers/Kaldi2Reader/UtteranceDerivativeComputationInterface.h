@@ -11,7 +11,8 @@ class UtteranceDerivativeComputationInterface
 {
 public:
     // Computes derivative and objective for given utterance ID and
-    // log-likelihood from neural network output.
+    // log-likelihood from neural network output. This may be called
+    // concurrently for different utterances.
     virtual bool ComputeDerivative(const wstring& /*uttID*/,
                                    const Matrix<ElemType>& /*logLikelihood*/,
                                    Matrix<ElemType>* /*derivative*/,
@@ -563,6 +563,12 @@ void LMBatchSequenceParser<NumType, LabelType>::ParseInit(LPCWSTR fileName, size
 
 template <typename NumType, typename LabelType>
 long LMBatchSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<LabelType> *labels, std::vector<NumType> *numbers, std::vector<SequencePosition> *seqPos)
+{
+    return Parse(recordsRequested, labels, numbers, seqPos, &mSentenceIndex2SentenceInfo);
+}
+
+template <typename NumType, typename LabelType>
+long LMBatchSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<LabelType> *labels, std::vector<NumType> *numbers, std::vector<SequencePosition> *seqPos, std::vector<stSentenceInfo> *sentences)
 {
     long linecnt;
     linecnt = ::LMSequenceParser<NumType, LabelType>::Parse(recordsRequested, labels, numbers, seqPos);
@@ -576,12 +582,12 @@ long LMBatchSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
         stinfo.sLen = iln;
         stinfo.sBegin = prvat;
         stinfo.sEnd = ptr->labelPos;
-        mSentenceIndex2SentenceInfo.push_back(stinfo);
+        sentences->push_back(stinfo);
 
         prvat = ptr->labelPos;
     }
 
-    assert(mSentenceIndex2SentenceInfo.size() == linecnt);
+    assert(sentences->size() == linecnt);
     return linecnt;
 }
 
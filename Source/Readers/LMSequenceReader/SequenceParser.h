@@ -489,6 +489,11 @@ protected:
     FILE *mFile;
     std::wstring mFileName;
 
+    // distributed reading: the lines are dealt out to the shards round-robin, and only this shard's are parsed
+    size_t m_shardIndex;
+    size_t m_numShards;
+    size_t m_lineIndex; // of the next line in the file
+
 public:
     using SequenceParser<NumType, LabelType>::m_dimFeatures;
     using SequenceParser<NumType, LabelType>::m_dimLabelsIn;
@@ -513,6 +518,9 @@ public:
     LMSequenceParser()
     {
         mFile = nullptr;
+        m_shardIndex = 0;
+        m_numShards = 1;
+        m_lineIndex = 0;
     };
     ~LMSequenceParser()
     {
@@ -545,6 +553,7 @@ public:
 
         if (mFile)
             fclose(mFile);
+        m_lineIndex = 0;
 
         if (_wfopen_s(&mFile, fileName, L"rt") != 0)
             Microsoft::MSR::CNTK::Warning("cannot open file %s", fileName);
@@ -554,6 +563,14 @@ public:
     {
         if (mFile)
             fseek(mFile, 0, SEEK_SET);
+        m_lineIndex = 0;
+    }
+
+    // from now on, parse only the lines of shard 'shardIndex' of 'numShards' (takes effect with the next ParseReset())
+    void SetShard(size_t shardIndex, size_t numShards)
+    {
+        m_shardIndex = shardIndex;
+        m_numShards = numShards;
     }
 
     // Parse - Parse the data
@@ -583,6 +600,8 @@ public:
 
         while (recordCount < recordsRequested && fgets(ch2, MAXSTRING, mFile) != nullptr)
         {
+            if (m_lineIndex++ % m_numShards != m_shardIndex) // another shard's line: skip it before tokenizing
+                continue;
 
             string ch = ch2;
             std::vector<string> vstr;
@@ -643,4 +662,6 @@ public:
     // seqPos - pointers to the other two arrays showing positions of each sequence
     // returns - number of records actually read, if the end of file is reached the return value will be < requested records
     long Parse(size_t recordsRequested, std::vector<LabelType> *labels, std::vector<NumType> *numbers, std::vector<SequencePosition> *seqPos);
+    // same, but appending the sentences to 'sentences' rather than to mSentenceIndex2SentenceInfo (for parsing ahead on another thread)
+    long Parse(size_t recordsRequested, std::vector<LabelType> *labels, std::vector<NumType> *numbers, std::vector<SequencePosition> *seqPos, std::vector<stSentenceInfo> *sentences);
 };
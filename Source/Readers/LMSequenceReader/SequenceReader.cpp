@@ -58,29 +58,38 @@ size_t SequenceReader<ElemType>::RecordsToRead(size_t mbStartSample, bool tail)
 template <class ElemType>
 typename IDataReader<ElemType>::LabelIdType SequenceReader<ElemType>::GetIdFromLabel(const std::string& labelValue, LabelInfo& labelInfo)
 {
-    auto found = labelInfo.mapLabelToId.find(labelValue);
+    int found = labelInfo.vocabulary ? labelInfo.vocabulary->Find(labelValue) : -1;
     string unk = this->mUnk;
     // not yet found, add to the map
-    if (found == labelInfo.mapLabelToId.end())
+    if (found < 0)
     {
-        found = labelInfo.mapLabelToId.find(unk);
-        if (found == labelInfo.mapLabelToId.end())
+        found = labelInfo.vocabulary ? labelInfo.vocabulary->Find(unk) : -1;
+        if (found < 0)
             RuntimeError("%s not in vocabulary", labelValue.c_str());
     }
-    return found->second;
+    return (LabelIdType) found;
+}
+
+// SetLabelVocabulary - use 'vocabulary' for the labels' IDs (the ID of a label is its index)
+template <class ElemType>
+void SequenceReader<ElemType>::SetLabelVocabulary(LabelInfo& labelInfo, const std::shared_ptr<Vocabulary>& vocabulary)
+{
+    labelInfo.vocabulary = vocabulary;
+    labelInfo.mapIdToLabel.clear();
+    labelInfo.idMax = (LabelIdType) vocabulary->Size();
 }
 
 template <class ElemType>
 bool SequenceReader<ElemType>::CheckIdFromLabel(const std::string& labelValue, const LabelInfo& labelInfo, unsigned& labelId)
 {
-    auto found = labelInfo.mapLabelToId.find(labelValue);
+    int found = labelInfo.vocabulary ? labelInfo.vocabulary->Find(labelValue) : -1;
 
     // not yet found, add to the map
-    if (found == labelInfo.mapLabelToId.end())
+    if (found < 0)
     {
         return false;
     }
-    labelId = found->second;
+    labelId = (unsigned) found;
     return true;
 }
 
@@ -324,12 +333,12 @@ void SequenceReader<ElemType>::WriteLabelFile()
         // write out the label file if they don't have one
         if (!labelInfo.fileToWrite.empty())
         {
-            if (labelInfo.mapIdToLabel.size() > 0)
+            if (labelInfo.vocabulary && labelInfo.vocabulary->Size() > 0)
             {
                 File labelFile(labelInfo.fileToWrite, fileOptionsWrite | fileOptionsText);
-                for (int i = 0; i < labelInfo.mapIdToLabel.size(); ++i)
+                for (size_t i = 0; i < labelInfo.vocabulary->Size(); ++i)
                 {
-                    labelFile << labelInfo.mapIdToLabel[i] << '\n';
+                    labelFile << labelInfo.vocabulary->Word(i) << '\n';
                 }
                 labelInfo.fileToWrite.clear();
             }
@@ -476,14 +485,9 @@ void SequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
             nwords = labelConfig(L"labelDim");
             if (wClassFile != L"")
             {
-                ReadClassInfo(wClassFile, class_size,
-                              word4idx,
-                              idx4word,
-                              idx4class,
-                              idx4cnt,
-                              nwords,
-                              mUnk, m_noiseSampler,
-                              false);
+                m_vocabulary = LoadClassInfo(wClassFile, class_size,
+                                             nwords,
+                                             mUnk, m_noiseSampler);
             }
 
             std::vector<string> arrayLabels;
@@ -491,36 +495,17 @@ void SequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
             if (fexists(labelPath))
             {
                 LoadLabelFile(labelPath, arrayLabels);
-                for (int i = 0; i < arrayLabels.size(); ++i)
-                {
-                    LabelType label = arrayLabels[i];
-                    m_labelInfo[index].mapIdToLabel[i] = label;
-                    m_labelInfo[index].mapLabelToId[label] = i;
-                }
-                m_labelInfo[index].idMax = (LabelIdType) arrayLabels.size();
+                auto vocabulary = std::make_shared<Vocabulary>();
+                for (const auto& label : arrayLabels)
+                    vocabulary->Add(label);
+                SetLabelVocabulary(m_labelInfo[index], vocabulary);
                 m_labelInfo[index].mapName = labelPath;
             }
             else
             {
                 if (wClassFile != L"")
                 {
-                    ReadClassInfo(wClassFile, class_size,
-                                  word4idx,
-                                  idx4word,
-                                  idx4class,
-                                  idx4cnt,
-                                  nwords, mUnk, m_noiseSampler,
-                                  false);
-                    int iMax = -1, i;
-                    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
-                    {
-                        LabelType label = ptr->first;
-                        i = ptr->second;
-                        iMax = max(i, iMax);
-                        m_labelInfo[index].mapIdToLabel[i] = label;
-                        m_labelInfo[index].mapLabelToId[label] = i;
-                    }
-                    m_labelInfo[index].idMax = (LabelIdType)(iMax + 1);
+                    SetLabelVocabulary(m_labelInfo[index], m_vocabulary);
                 }
                 m_labelInfo[index].mapName = labelPath;
 
@@ -606,6 +591,35 @@ void SequenceReader<ElemType>::ReadWord(char* word, FILE* fin)
     word[a] = 0;
 }
 
+// LoadClassInfo - load the word class file ("index count word class" per line, or its binary form, see Vocabulary.h),
+// check it against the vocabulary size and the unk symbol, and set up the noise sampler from the word counts
+template <class ElemType>
+std::shared_ptr<Vocabulary> SequenceReader<ElemType>::LoadClassInfo(const wstring& vocfile, int& class_size,
+                                                                    int nwords,
+                                                                    string mUnk,
+                                                                    noiseSampler<long>& m_noiseSampler)
+{
+    auto vocabulary = std::make_shared<Vocabulary>();
+    vocabulary->Load(vocfile);
+    class_size = max((int) vocabulary->NumClasses(), 1);
+
+    if (vocabulary->Size() < nwords)
+    {
+        LogicError("SequenceReader::ReadClassInfo the actual number of words %d is smaller than the specified vocabulary size %d. Check if labelDim is too large. ", (int) vocabulary->Size(), (int) nwords);
+    }
+    std::vector<double> counts(vocabulary->Size());
+    for (size_t i = 0; i < counts.size(); i++)
+        counts[i] = (double) vocabulary->Count(i);
+    m_noiseSampler = noiseSampler<long>(counts);
+
+    // check if unk is the same used in vocabulary file
+    if (vocabulary->Find(mUnk) < 0)
+    {
+        LogicError("SequenceReader::ReadClassInfo unk symbol %s is not in vocabulary file", mUnk.c_str());
+    }
+    return vocabulary;
+}
+
 template <class ElemType>
 void SequenceReader<ElemType>::ReadClassInfo(const wstring& vocfile, int& class_size,
                                              map<string, int>& word4idx,
@@ -617,55 +631,14 @@ void SequenceReader<ElemType>::ReadClassInfo(const wstring& vocfile, int& class_
                                              noiseSampler<long>& m_noiseSampler,
                                              bool /*flatten*/)
 {
-    string tmp_vocfile(vocfile.begin(), vocfile.end()); // convert from wstring to string
-    string strtmp;
-    size_t cnt;
-    int clsidx, b;
-    class_size = 0;
-
-    string line;
-    vector<string> tokens;
-    ifstream fin;
-    fin.open(tmp_vocfile.c_str());
-    if (!fin)
+    auto vocabulary = LoadClassInfo(vocfile, class_size, nwords, mUnk, m_noiseSampler);
+    for (int b = 0; b < (int) vocabulary->Size(); b++)
     {
-        RuntimeError("cannot open word class file");
-    }
-
-    while (getline(fin, line))
-    {
-        line = trim(line);
-        tokens = msra::strfun::split(line, "\t ");
-        assert(tokens.size() == 4);
-
-        b = stoi(tokens[0]);
-        cnt = (size_t) stof(tokens[1]);
-        strtmp = tokens[2];
-        clsidx = stoi(tokens[3]);
-
-        idx4cnt[b] = cnt;
+        string strtmp = vocabulary->Word(b);
+        idx4cnt[b] = vocabulary->Count(b);
         word4idx[strtmp] = b;
         idx4word[b] = strtmp;
-
-        idx4class[b] = clsidx;
-        class_size = max(class_size, clsidx);
-    }
-    fin.close();
-    class_size++;
-
-    if (idx4class.size() < nwords)
-    {
-        LogicError("SequenceReader::ReadClassInfo the actual number of words %d is smaller than the specified vocabulary size %d. Check if labelDim is too large. ", (int) idx4class.size(), (int) nwords);
-    }
-    std::vector<double> counts(idx4cnt.size());
-    for (const auto& p : idx4cnt)
-        counts[p.first] = (double) p.second;
-    m_noiseSampler = noiseSampler<long>(counts);
-
-    // check if unk is the same used in vocabulary file
-    if (word4idx.find(mUnk.c_str()) == word4idx.end())
-    {
-        LogicError("SequenceReader::ReadClassInfo unk symbol %s is not in vocabulary file", mUnk.c_str());
+        idx4class[b] = vocabulary->Class(b);
     }
 }
 
@@ -1030,7 +1003,7 @@ void SequenceReader<ElemType>::GetLabelOutput(std::map<std::wstring, Matrix<Elem
         }
         else if (readerMode == ReaderMode::Class)
         {
-            int clsidx = idx4class[wrd];
+            int clsidx = GetWordClass(wrd);
             if (class_size > 0)
             {
                 labels->SetValue(1, j, (ElemType) clsidx);
@@ -1070,6 +1043,28 @@ void SequenceReader<ElemType>::GetInputProb(std::map<std::wstring, Matrix<ElemTy
     m_idx2probRead = true;
 }
 
+// fill a sparse feature matrix with the one-hot columns m_featureData[firstSample..firstSample+numCols)
+// The CSC arrays are built on the CPU and handed over in a single SetMatrixFromCSCFormat() call, which copies them
+// directly to the matrix's device. This replaces numCols element-wise SetValue() calls (each a host/device round trip
+// for a GPU matrix) and never materializes a dense dim x numCols matrix.
+template <class ElemType>
+void SequenceReader<ElemType>::SetOneHotFeatures(Matrix<ElemType>& features, size_t dim, size_t firstSample, size_t numCols)
+{
+    m_featuresCSCCol.resize(numCols + 1);
+    m_featuresCSCRow.resize(numCols);
+    m_featuresCSCVal.assign(numCols, (ElemType) 1);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        size_t idx = (size_t) m_featureData[firstSample + j];
+        if (idx >= dim)
+            RuntimeError("SetOneHotFeatures: word index %d exceeds the input dimension %d.", (int) idx, (int) dim);
+        m_featuresCSCCol[j] = (CPUSPARSE_INDEX_TYPE) j;
+        m_featuresCSCRow[j] = (CPUSPARSE_INDEX_TYPE) idx;
+    }
+    m_featuresCSCCol[numCols] = (CPUSPARSE_INDEX_TYPE) numCols;
+    features.SetMatrixFromCSCFormat(m_featuresCSCCol.data(), m_featuresCSCRow.data(), m_featuresCSCVal.data(), numCols, dim, numCols);
+}
+
 template <class ElemType>
 void SequenceReader<ElemType>::GetInputToClass(std::map<std::wstring, Matrix<ElemType>*>& matrices)
 {
@@ -1089,7 +1084,7 @@ void SequenceReader<ElemType>::GetInputToClass(std::map<std::wstring, Matrix<Ele
     m_id2classLocal->TransferFromDeviceToDevice(curDevId, CPUDEVICE, true, false, false);
     for (size_t j = 0; j < nwords; j++)
     {
-        int clsidx = idx4class[(int) j];
+        int clsidx = GetWordClass(j);
         (*m_id2classLocal)(j, 0) = (float) clsidx;
     }
     m_id2classLocal->TransferFromDeviceToDevice(CPUDEVICE, curDevId, true, false, false);
@@ -1120,7 +1115,7 @@ void SequenceReader<ElemType>::GetClassInfo()
     int prvcls = -1;
     for (size_t j = 0; j < nwords; j++)
     {
-        clsidx = idx4class[(int) j];
+        clsidx = GetWordClass(j);
         if (prvcls != clsidx && clsidx > prvcls)
         {
             if (prvcls >= 0)
@@ -1208,18 +1203,17 @@ bool SequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
         // loop through all the samples
         int j = 0;
         Matrix<ElemType>& features = *matrices[m_featuresName];
+        bool denseFeatures = false;
         if (matrices.find(m_featuresName) != matrices.end())
         {
             if (features.GetMatrixType() == MatrixType::DENSE)
             {
                 features.Resize(labelInfo.dim, actualmbsize, false);
                 features.SetValue(0);
+                denseFeatures = true;
             }
             else
-            {
-                features.Resize(labelInfo.dim, actualmbsize);
-                features.Reset();
-            }
+                SetOneHotFeatures(features, labelInfo.dim, m_mbStartSample, actualmbsize);
         }
 
         for (size_t jSample = m_mbStartSample; j < actualmbsize; ++j, ++jSample)
@@ -1231,7 +1225,7 @@ bool SequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
             size_t idx = (size_t) m_featureData[jRand];
             m_featuresBuffer[j * labelInfo.dim + idx] = (ElemType) 1;
 
-            if (matrices.find(m_featuresName) != matrices.end())
+            if (denseFeatures)
                 features.SetValue(idx, j, (ElemType) 1);
         }
 
@@ -1316,8 +1310,13 @@ const std::map<typename IDataReader<ElemType>::LabelIdType, typename IDataReader
     {
         return m_cachingReader->GetLabelMapping(sectionName);
     }
-    const LabelInfo& labelInfo = m_labelInfo[(m_labelInfo[labelInfoOut].type == labelNextWord) ? labelInfoIn : labelInfoOut];
+    LabelInfo& labelInfo = m_labelInfo[(m_labelInfo[labelInfoOut].type == labelNextWord) ? labelInfoIn : labelInfoOut];
 
+    if (labelInfo.mapIdToLabel.empty() && labelInfo.vocabulary)
+    {
+        for (size_t i = 0; i < labelInfo.vocabulary->Size(); ++i)
+            labelInfo.mapIdToLabel[(LabelIdType) i] = labelInfo.vocabulary->Word(i);
+    }
     return labelInfo.mapIdToLabel;
 }
 
@@ -1333,12 +1332,15 @@ void SequenceReader<ElemType>::SetLabelMapping(const std::wstring& /*sectionName
     }
     LabelInfo& labelInfo = m_labelInfo[(m_labelInfo[labelInfoOut].type == labelNextWord) ? labelInfoIn : labelInfoOut];
 
-    labelInfo.mapIdToLabel = labelMapping;
-    labelInfo.mapLabelToId.clear();
-    for (std::pair<unsigned, LabelType> var : labelMapping)
+    auto vocabulary = std::make_shared<Vocabulary>();
+    for (const auto& var : labelMapping)
     {
-        labelInfo.mapLabelToId[var.second] = var.first;
+        if (var.first != vocabulary->Size())
+            RuntimeError("SetLabelMapping: The label IDs must be 0..%d.", (int) labelMapping.size() - 1);
+        vocabulary->Add(var.second);
     }
+    labelInfo.vocabulary = vocabulary;
+    labelInfo.mapIdToLabel = labelMapping;
 }
 
 // GetData - Gets metadata from the specified section (into CPU memory)
@@ -1452,14 +1454,9 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
             nwords = labelConfig(L"labelDim");
             if (wClassFile != L"")
             {
-                ReadClassInfo(wClassFile, class_size,
-                              word4idx,
-                              idx4word,
-                              idx4class,
-                              idx4cnt,
-                              nwords,
-                              mUnk, m_noiseSampler,
-                              false);
+                m_vocabulary = LoadClassInfo(wClassFile, class_size,
+                                             nwords,
+                                             mUnk, m_noiseSampler);
             }
 
             std::vector<string> arrayLabels;
@@ -1467,41 +1464,21 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
             if (fexists(labelPath))
             {
                 LoadLabelFile(labelPath, arrayLabels);
-                for (int i = 0; i < arrayLabels.size(); ++i)
-                {
-                    LabelType label = arrayLabels[i];
-                    m_labelInfo[index].mapIdToLabel[i] = label;
-                    m_labelInfo[index].mapLabelToId[label] = i;
-                }
-                m_labelInfo[index].idMax = (LabelIdType) arrayLabels.size();
+                auto vocabulary = std::make_shared<Vocabulary>();
+                for (const auto& label : arrayLabels)
+                    vocabulary->Add(label);
+                SetLabelVocabulary(m_labelInfo[index], vocabulary);
                 m_labelInfo[index].mapName = labelPath;
             }
             else
             {
                 if (wClassFile != L"")
                 {
-                    ReadClassInfo(wClassFile, class_size,
-                                  word4idx,
-                                  idx4word,
-                                  idx4class,
-                                  idx4cnt,
-                                  nwords,
-                                  mUnk, m_noiseSampler,
-                                  false);
-                    if (word4idx.size() != nwords)
-                    {
-                        LogicError("BatchSequenceReader::Init : vocabulary size %d from setup file and %d from that in word class file %ls is not consistent", (int) nwords, (int) word4idx.size(), wClassFile.c_str());
-                    }
-                    int iMax = -1, i;
-                    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
+                    if (m_vocabulary->Size() != nwords)
                     {
-                        LabelType label = ptr->first;
-                        i = ptr->second;
-                        iMax = max(i, iMax);
-                        m_labelInfo[index].mapIdToLabel[i] = label;
-                        m_labelInfo[index].mapLabelToId[label] = i;
+                        LogicError("BatchSequenceReader::Init : vocabulary size %d from setup file and %d from that in word class file %ls is not consistent", (int) nwords, (int) m_vocabulary->Size(), wClassFile.c_str());
                     }
-                    m_labelInfo[index].idMax = (LabelIdType)(iMax + 1);
+                    SetLabelVocabulary(m_labelInfo[index], m_vocabulary);
                 }
                 m_labelInfo[index].mapName = labelPath;
 
@@ -1584,6 +1561,16 @@ void BatchSequenceReader<ElemType>::Reset()
 
 template <class ElemType>
 void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+{
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+// StartDistributedMinibatchLoop - Startup a distributed minibatch loop for parallel training
+// subsetNum - [in] the subset number of the current node in a group of parallel training nodes
+// numSubsets - [in] total number of nodes participating in the parallel training
+// The lines (sentences) of the corpus are dealt out to the nodes round-robin, and each node parses only its own.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
     // if we aren't currently caching, see if we can use a cache
     if (!m_cachingReader && !m_cachingWriter)
@@ -1596,7 +1583,7 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     // if we are reading from the cache, do so now and return
     if (m_cachingReader)
     {
-        m_cachingReader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        m_cachingReader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
         return;
     }
 
@@ -1668,11 +1655,56 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_clsinfoRead = false;
     m_idx2clsRead = false;
 
+    CancelBlockPrefetch(); // (it continues where the previous loop stopped)
+    m_parser.SetShard(subsetNum, numSubsets);
     m_parser.ParseReset();
 
     Reset();
 }
 
+// GetNextBlock - parse the next block of sentences into m_labelTemp and m_parser.mSentenceIndex2SentenceInfo, after Reset()
+// The block comes from the parse in flight, if any; then the parse of the one after it is started in the background.
+// returns - the number of sentences, 0 at the end of the data
+template <class ElemType>
+long BatchSequenceReader<ElemType>::GetNextBlock()
+{
+    if (!m_pendingBlock.valid())
+        StartBlockPrefetch();
+    long numRead = m_pendingBlock.get(); // (rethrows a parse error)
+    m_labelTemp.swap(m_prefetchLabels);
+    m_featureTemp.swap(m_prefetchFeatures);
+    m_parser.mSentenceIndex2SentenceInfo.swap(m_prefetchSentences);
+    if (numRead > 0)
+        StartBlockPrefetch();
+    return numRead;
+}
+
+// StartBlockPrefetch - parse the next block into the m_prefetch* buffers on a background thread
+// Only the parser's file and those buffers are touched, so this runs while the current block is being used.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::StartBlockPrefetch()
+{
+    m_pendingBlock = std::async(std::launch::async, [this]()
+                                {
+                                    m_prefetchLabels.clear();
+                                    m_prefetchFeatures.clear();
+                                    m_prefetchSentences.clear();
+                                    std::vector<SequencePosition> seqPos;
+                                    return m_parser.Parse(CACHE_BLOG_SIZE, &m_prefetchLabels, &m_prefetchFeatures, &seqPos, &m_prefetchSentences);
+                                });
+}
+
+// CancelBlockPrefetch - wait for the parse in flight, and drop its block
+template <class ElemType>
+void BatchSequenceReader<ElemType>::CancelBlockPrefetch()
+{
+    if (m_pendingBlock.valid())
+    {
+        m_pendingBlock.wait();
+        m_pendingBlock = std::future<long>();
+    }
+}
+
 template <class ElemType>
 size_t BatchSequenceReader<ElemType>::FindNextSentences(size_t numRead)
 {
@@ -1754,14 +1786,12 @@ bool BatchSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample*/
     LabelInfo& labelInfo = m_labelInfo[nextWord ? labelInfoIn : labelInfoOut];
 
     // see how many we already read
-    std::vector<SequencePosition> seqPos;
-
     size_t sLn = FindNextSentences(mNumRead);
     if (sLn == 0)
     {
         Reset();
 
-        mNumRead = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos);
+        mNumRead = GetNextBlock();
         firstPosInSentence = mLastPosInSentence;
         if (mNumRead == 0)
             return false;
@@ -1893,36 +1923,34 @@ bool BatchSequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<E
         }
 
         // copy m_featureData to matrix
-        // m_featureData is a sparse, already with interleaved parallel sequences. We copy it into a dense matrix.
-        // we always copy it to cpu first and then convert to gpu if gpu is desired.
-        DEVICEID_TYPE featureDeviceId = features.GetDeviceId();
-        features.TransferFromDeviceToDevice(featureDeviceId, CPUDEVICE, false, true, false);
-
-        if (features.GetMatrixType() == MatrixType::DENSE)
+        // m_featureData is a sparse, already with interleaved parallel sequences.
+        // A sparse input matrix receives it as CSC in one transfer, on whatever device it lives on.
+        // For a dense one, we copy it to cpu first and then convert to gpu if gpu is desired.
+        if (features.GetMatrixType() == MatrixType::SPARSE)
+            SetOneHotFeatures(features, labelInfo.dim, 0, actualmbsize);
+        else
         {
+            DEVICEID_TYPE featureDeviceId = features.GetDeviceId();
+            features.TransferFromDeviceToDevice(featureDeviceId, CPUDEVICE, false, true, false);
+
             features.Resize(labelInfo.dim, actualmbsize);
             features.SetValue(0);
-        }
-        else
-        {
-            features.Resize(labelInfo.dim, actualmbsize, actualmbsize);
-            features.Reset();
-        }
 
-        for (size_t j = 0; j < actualmbsize; ++j) // note: this is a loop over matrix columns, not time steps or parallel sequences
-        {
-            // vector of feature data goes into matrix column
-            size_t idx = (size_t) m_featureData[j]; // one-hot index of the word, indexed by column (i.e. already interleaved)
+            for (size_t j = 0; j < actualmbsize; ++j) // note: this is a loop over matrix columns, not time steps or parallel sequences
+            {
+                // vector of feature data goes into matrix column
+                size_t idx = (size_t) m_featureData[j]; // one-hot index of the word, indexed by column (i.e. already interleaved)
+
+                features.SetValue(idx, j, (ElemType) 1);
 
-            features.SetValue(idx, j, (ElemType) 1);
+                // actual time position
+                // size_t timeIdx = (size_t)j / mToProcess.size();
+                // size_t uttIdx = (size_t)fmod(j, mToProcess.size()); // parallel-sequence index
+            }
 
-            // actual time position
-            // size_t timeIdx = (size_t)j / mToProcess.size();
-            // size_t uttIdx = (size_t)fmod(j, mToProcess.size()); // parallel-sequence index
+            features.TransferFromDeviceToDevice(CPUDEVICE, featureDeviceId, false, false, false);
         }
 
-        features.TransferFromDeviceToDevice(CPUDEVICE, featureDeviceId, false, false, false);
-
         // TODO: move these two methods to startMiniBatchLoop()
         if (readerMode == ReaderMode::Class)
         {
@@ -2099,7 +2127,7 @@ void BatchSequenceReader<ElemType>::GetLabelOutput(std::map<std::wstring,
             }
             else if (readerMode == ReaderMode::Class)
             {
-                int clsidx = idx4class[wrd];
+                int clsidx = GetWordClass(wrd);
                 if (class_size > 0)
                 {
 
@@ -2151,15 +2179,9 @@ int BatchSequenceReader<ElemType>::GetSentenceEndIdFromOutputLabel()
 
     // now get the labels
     LabelInfo& labelIn = m_labelInfo[labelInfoIn];
-    auto found = word4idx.find(labelIn.endSequence);
-
-    // not yet found, add to the map
-    if (found != word4idx.end())
-    {
-        return (int) found->second;
-    }
-    else
+    if (!m_vocabulary)
         return -1;
+    return m_vocabulary->Find(labelIn.endSequence); // (-1 if not found)
 }
 
 template class BatchSequenceReader<double>;
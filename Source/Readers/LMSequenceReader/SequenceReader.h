@@ -12,8 +12,11 @@
 #include "Config.h"
 #include "SequenceParser.h"
 #include "RandomOrdering.h"
+#include "Vocabulary.h"
 #include <string>
 #include <map>
+#include <memory>
+#include <future>
 #include <vector>
 #include <random>
 
@@ -123,10 +126,7 @@ public:
     using LabelType = typename IDataReader<ElemType>::LabelType;
     using LabelIdType = typename IDataReader<ElemType>::LabelIdType;
 
-    map<string, int> word4idx;
-    map<int, string> idx4word;
-    map<int, int> idx4class;
-    map<int, size_t> idx4cnt;
+    std::shared_ptr<Vocabulary> m_vocabulary; // from the 'wordclass' file: words, counts, classes
     int nwords, dims, nsamps, nglen, nmefeats;
     Matrix<ElemType>* m_id2classLocal;  // CPU version
     Matrix<ElemType>* m_classInfoLocal; // CPU version
@@ -193,6 +193,11 @@ protected:
     bool m_endReached;
     int m_traceLevel;
 
+    // CSC arrays for SetOneHotFeatures(), kept across minibatches to avoid reallocation
+    std::vector<CPUSPARSE_INDEX_TYPE> m_featuresCSCCol;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_featuresCSCRow;
+    std::vector<ElemType> m_featuresCSCVal;
+
     // feature and label data are parallel arrays
     std::vector<ElemType> m_featureData;
     std::vector<LabelIdType> m_labelIdData;
@@ -204,8 +209,8 @@ protected:
     struct LabelInfo
     {
         LabelKind type; // labels are categories, create mapping table
-        std::map<LabelIdType, LabelType> mapIdToLabel;
-        std::map<LabelType, LabelIdType> mapLabelToId;
+        std::shared_ptr<Vocabulary> vocabulary;         // label -> ID
+        std::map<LabelIdType, LabelType> mapIdToLabel; // ID -> label, made from 'vocabulary' when asked for
         LabelIdType idMax;         // maximum label ID we have encountered so far
         LabelIdType dim;           // maximum label ID we will ever see (used for array dimensions)
         std::string beginSequence; // starting sequence string (i.e. <s>)
@@ -229,6 +234,11 @@ protected:
     void LoadLabelFile(const std::wstring& filePath, std::vector<LabelType>& retLabels);
 
     LabelIdType GetIdFromLabel(const std::string& label, LabelInfo& labelInfo);
+    void SetLabelVocabulary(LabelInfo& labelInfo, const std::shared_ptr<Vocabulary>& vocabulary);
+    int GetWordClass(size_t wrd) const
+    {
+        return m_vocabulary && wrd < m_vocabulary->Size() ? m_vocabulary->Class(wrd) : 0;
+    }
     bool CheckIdFromLabel(const std::string& labelValue, const LabelInfo& labelInfo, unsigned& labelId);
 
     virtual bool EnsureDataAvailable(size_t mbStartSample, bool endOfDataCheck = false);
@@ -246,6 +256,10 @@ public:
     {
         InitFromConfig(config);
     }
+    static std::shared_ptr<Vocabulary> LoadClassInfo(const wstring& vocfile, int& class_size,
+                                                     int nwords,
+                                                     string mUnk,
+                                                     noiseSampler<long>& m_noiseSampler);
     static void ReadClassInfo(const wstring& vocfile, int& class_size,
                               map<string, int>& word4idx,
                               map<int, string>& idx4word,
@@ -260,6 +274,7 @@ public:
     void GetLabelOutput(std::map<std::wstring, Matrix<ElemType>*>& matrices,
                         size_t m_mbStartSample, size_t actualmbsize);
     void GetInputToClass(std::map<std::wstring, Matrix<ElemType>*>& matrices);
+    void SetOneHotFeatures(Matrix<ElemType>& features, size_t dim, size_t firstSample, size_t numCols);
 
     void GetInputProb(std::map<std::wstring, Matrix<ElemType>*>& matrices);
     void GetClassInfo();
@@ -320,11 +335,10 @@ public:
     using SequenceReader<ElemType>::m_labelInfo;
     using SequenceReader<ElemType>::labelInfoIn;
     using SequenceReader<ElemType>::nwords;
-    using SequenceReader<ElemType>::ReadClassInfo;
+    using SequenceReader<ElemType>::LoadClassInfo;
     using SequenceReader<ElemType>::LoadLabelFile;
-    using SequenceReader<ElemType>::word4idx;
-    using SequenceReader<ElemType>::idx4word;
-    using SequenceReader<ElemType>::idx4cnt;
+    using SequenceReader<ElemType>::m_vocabulary;
+    using SequenceReader<ElemType>::SetLabelVocabulary;
     using SequenceReader<ElemType>::mUnk;
     using SequenceReader<ElemType>::m_mbStartSample;
     using SequenceReader<ElemType>::m_epoch;
@@ -363,12 +377,13 @@ public:
     using SequenceReader<ElemType>::m_idx2clsRead;
     using SequenceReader<ElemType>::m_featuresBufferRowIdx;
     using SequenceReader<ElemType>::m_sequence;
-    using SequenceReader<ElemType>::idx4class;
+    using SequenceReader<ElemType>::GetWordClass;
     using SequenceReader<ElemType>::m_indexer;
     using SequenceReader<ElemType>::m_noiseSampler;
     using SequenceReader<ElemType>::readerMode;
     using SequenceReader<ElemType>::GetIdFromLabel;
     using SequenceReader<ElemType>::GetInputToClass;
+    using SequenceReader<ElemType>::SetOneHotFeatures;
     using SequenceReader<ElemType>::GetClassInfo;
     using IDataReader<ElemType>::mRequestedNumParallelSequences;
 
@@ -388,6 +403,15 @@ private:
 
     MBLayoutPtr m_pMBLayout;
 
+    // the next block of sentences is parsed on a background thread while the current one is cut into minibatches
+    std::future<long> m_pendingBlock;
+    std::vector<LabelType> m_prefetchLabels;
+    std::vector<ElemType> m_prefetchFeatures;
+    std::vector<stSentenceInfo> m_prefetchSentences;
+    long GetNextBlock();
+    void StartBlockPrefetch();
+    void CancelBlockPrefetch();
+
 public:
     vector<bool> mProcessed;
     LMBatchSequenceParser<ElemType, LabelType> m_parser;
@@ -400,6 +424,10 @@ public:
         mNumRead = 0;
         mSentenceEnd = false;
     }
+    ~BatchSequenceReader()
+    {
+        CancelBlockPrefetch(); // (it uses the parser and buffers)
+    }
 
     template <class ConfigRecordType>
     void InitFromConfig(const ConfigRecordType&);
@@ -438,6 +466,11 @@ public:
                         size_t m_mbStartSample, size_t actualmbsize);
 
     void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return (m_cachingReader == nullptr) || m_cachingReader->SupportsDistributedMBRead();
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
     bool EnsureDataAvailable(size_t mbStartSample, size_t& firstPosInSentence);
     size_t GetNumParallelSequences();
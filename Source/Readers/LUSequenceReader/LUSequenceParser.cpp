@@ -45,7 +45,7 @@ template class LUSequenceParser<double, std::string>;
 template class LUSequenceParser<double, std::wstring>;
 
 template <class NumType, class LabelType>
-long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const map<wstring, long> &inputlabel2id, const map<wstring, long> &outputlabel2id, bool canMultiplePassData)
+long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const map<wstring, long> &inputlabel2id, const map<wstring, long> &outputlabel2id, bool canMultiplePassData, std::vector<stSentenceInfo> *sentences)
 {
     fprintf(stderr, "BatchLUSequenceParser: Parsing input data...\n");
 
@@ -57,7 +57,8 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
     long orgRecordCount = (long) labels->size();
     long lineCount = 0;
     long tokenCount = 0;
-    bool bAtEOS = false; // whether the reader is at the end of sentence position
+    bool bAtEOS = false;        // whether the reader is at the end of sentence position
+    bool bSkippedToken = false; // whether the other shard's sentence being skipped has tokens so far
     SequencePosition sequencePositionLast(0, 0, 0);
 
     wstring ch;
@@ -79,6 +80,30 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
 
         std::vector<wstring> vstr;
         bool bBlankLine = (ch.length() == 0);
+
+        // another shard's sentence: only find its end, the same way as below, without tokenizing or looking up labels
+        if (m_sentenceIndex % m_numShards != m_shardIndex)
+        {
+            size_t firstSpace = ch.find(L' ');
+            bool isToken = !bBlankLine && firstSpace != wstring::npos; // (lines of one column are ignored below)
+            bool isEnd = bBlankLine && bSkippedToken;
+            if (isToken)
+            {
+                wstring first = ch.substr(0, firstSpace);
+                wstring last = ch.substr(ch.rfind(L' ') + 1);
+                isEnd = wtrim(last) == m_endSequenceOut || wtrim(first) == m_endTag;
+            }
+            if (isEnd)
+            {
+                m_sentenceIndex++;
+                bAtEOS = true;
+                bSkippedToken = false;
+            }
+            else if (isToken)
+                bSkippedToken = true;
+            continue;
+        }
+
         if (bBlankLine && !bAtEOS && input->size() > 0 && labels->size() > 0)
         {
             AddOneItem(labels, input, seqPos, lineCount, recordCount, orgRecordCount, sequencePositionLast);
@@ -140,7 +165,7 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
         stinfo.sLen = iln;
         stinfo.sBegin = prvat;
         stinfo.sEnd = (int) ptr->labelPos;
-        mSentenceIndex2SentenceInfo.push_back(stinfo);
+        sentences->push_back(stinfo);
 
         prvat = (int) ptr->labelPos;
     }
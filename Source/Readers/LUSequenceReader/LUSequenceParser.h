@@ -140,6 +140,11 @@ public:
     std::wstring mFileName;
     vector<stSentenceInfo> mSentenceIndex2SentenceInfo;
 
+    // distributed reading: the sentences are dealt out to the shards round-robin, and only this shard's are parsed
+    size_t m_shardIndex;
+    size_t m_numShards;
+    size_t m_sentenceIndex; // of the next sentence in the file
+
 public:
     using LUSequenceParser<NumType, LabelType>::m_dimFeatures;
     using LUSequenceParser<NumType, LabelType>::m_dimLabelsIn;
@@ -156,7 +161,8 @@ public:
     using LUSequenceParser<NumType, LabelType>::m_labels;
     using LUSequenceParser<NumType, LabelType>::m_beginSequence;
     using LUSequenceParser<NumType, LabelType>::m_endSequence;
-    BatchLUSequenceParser(){};
+    BatchLUSequenceParser()
+        : m_shardIndex(0), m_numShards(1), m_sentenceIndex(0){};
     ~BatchLUSequenceParser()
     {
         mFile.close();
@@ -180,6 +186,7 @@ public:
 
         mUnkStr = unkstr;
 
+        m_sentenceIndex = 0;
         mFile.close();
 #ifdef __unix__
         mFile.open(ws2s(fileName), wifstream::in);
@@ -192,6 +199,7 @@ public:
 
     void ParseReset()
     {
+        m_sentenceIndex = 0;
         mFile.close();
 #ifdef __unix__
         mFile.open(ws2s(mFileName), wifstream::in);
@@ -202,6 +210,13 @@ public:
             RuntimeError("cannot open file %ls", mFileName.c_str());
     }
 
+    // from now on, parse only the sentences of shard 'shardIndex' of 'numShards' (takes effect with the next ParseReset())
+    void SetShard(size_t shardIndex, size_t numShards)
+    {
+        m_shardIndex = shardIndex;
+        m_numShards = numShards;
+    }
+
     void AddOneItem(std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, long& lineCount,
                     long& recordCount, long orgRecordCount, SequencePosition& sequencePositionLast)
     {
@@ -211,6 +226,7 @@ public:
 
         recordCount = (long) labels->size() - orgRecordCount;
         lineCount++;
+        m_sentenceIndex++;
     }
 
     // Parse - Parse the data
@@ -225,7 +241,12 @@ public:
     // numbers - pointer to vector to return the numbers
     // seqPos - pointers to the other two arrays showing positions of each sequence
     // returns - number of records actually read, if the end of file is reached the return value will be < requested records
-    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const map<wstring, long>& inputlabel2id, const map<wstring, long>& outputlabel2id, bool mAllowMultPassData = false);
+    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const map<wstring, long>& inputlabel2id, const map<wstring, long>& outputlabel2id, bool mAllowMultPassData = false)
+    {
+        return Parse(recordsRequested, labels, input, seqPos, inputlabel2id, outputlabel2id, mAllowMultPassData, &mSentenceIndex2SentenceInfo);
+    }
+    // same, but appending the sentences to 'sentences' rather than to mSentenceIndex2SentenceInfo (for parsing ahead on another thread)
+    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const map<wstring, long>& inputlabel2id, const map<wstring, long>& outputlabel2id, bool mAllowMultPassData, std::vector<stSentenceInfo>* sentences);
 };
 }
 }
@@ -13,6 +13,7 @@
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
+#include <algorithm>
 #include <fstream>
 #include <random> // std::default_random_engine
 #include "fileutil.h"
@@ -34,6 +35,7 @@ long LUSequenceReader<ElemType>::GetIdFromLabel(const LabelType& labelValue, Lab
 template <class ElemType>
 BatchLUSequenceReader<ElemType>::~BatchLUSequenceReader()
 {
+    CancelBlockPrefetch(); // (it uses the parser and buffers)
     for (int index = labelInfoMin; index < labelInfoMax; ++index)
     {
         delete[] m_labelInfo[index].m_id2classLocal;
@@ -463,6 +465,16 @@ void BatchLUSequenceReader<ElemType>::Reset()
 
 template <class ElemType>
 void BatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+{
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+// StartDistributedMinibatchLoop - Startup a distributed minibatch loop for parallel training
+// subsetNum - [in] the subset number of the current node in a group of parallel training nodes
+// numSubsets - [in] total number of nodes participating in the parallel training
+// The sentences of the corpus are dealt out to the nodes round-robin, and each node parses only its own.
+template <class ElemType>
+void BatchLUSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
     if (m_featuresBuffer == NULL)
     {
@@ -511,9 +523,56 @@ void BatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t e
 
     Reset();
 
+    CancelBlockPrefetch(); // (it continues where the previous loop stopped)
+    m_parser.SetShard(subsetNum, numSubsets);
     m_parser.ParseReset(); // restart from the corpus beginning
 }
 
+// GetNextBlock - parse the next block of sentences into m_labelTemp, m_featureTemp, and m_parser.mSentenceIndex2SentenceInfo, after Reset()
+// The block comes from the parse in flight, if any; then the parse of the one after it is started in the background.
+// returns - the number of sentences, 0 at the end of the data
+template <class ElemType>
+long BatchLUSequenceReader<ElemType>::GetNextBlock()
+{
+    if (!m_pendingBlock.valid())
+        StartBlockPrefetch();
+    long numRead = m_pendingBlock.get(); // (rethrows a parse error)
+    m_labelTemp.swap(m_prefetchLabels);
+    m_featureTemp.swap(m_prefetchFeatures);
+    m_parser.mSentenceIndex2SentenceInfo.swap(m_prefetchSentences);
+    if (numRead > 0)
+        StartBlockPrefetch();
+    return numRead;
+}
+
+// StartBlockPrefetch - parse the next block into the m_prefetch* buffers on a background thread
+// Only the parser's file and those buffers are touched (the label maps are only read), so this runs while the current block is being used.
+template <class ElemType>
+void BatchLUSequenceReader<ElemType>::StartBlockPrefetch()
+{
+    const LabelInfo& featIn = m_labelInfo[labelInfoIn];
+    const LabelInfo& labelIn = m_labelInfo[labelInfoOut];
+    m_pendingBlock = std::async(std::launch::async, [this, &featIn, &labelIn]()
+                                {
+                                    m_prefetchLabels.clear();
+                                    m_prefetchFeatures.clear();
+                                    m_prefetchSentences.clear();
+                                    std::vector<SequencePosition> seqPos;
+                                    return m_parser.Parse(CACHE_BLOG_SIZE, &m_prefetchLabels, &m_prefetchFeatures, &seqPos, featIn.word4idx, labelIn.word4idx, mAllowMultPassData, &m_prefetchSentences);
+                                });
+}
+
+// CancelBlockPrefetch - wait for the parse in flight, and drop its block
+template <class ElemType>
+void BatchLUSequenceReader<ElemType>::CancelBlockPrefetch()
+{
+    if (m_pendingBlock.valid())
+    {
+        m_pendingBlock.wait();
+        m_pendingBlock = std::future<long>();
+    }
+}
+
 template <class ElemType>
 size_t BatchLUSequenceReader<ElemType>::FindNextSentences(size_t numRead)
 {
@@ -630,11 +689,8 @@ bool BatchLUSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample
 
     // now get the labels
     LabelInfo& featIn = m_labelInfo[labelInfoIn];
-    LabelInfo& labelIn = m_labelInfo[labelInfoOut];
 
     // see how many we already read
-    std::vector<SequencePosition> seqPos;
-
     if (mTotalSentenceSofar > m_epochSize)
     {
         m_pMBLayout->Init(1, 0);
@@ -655,7 +711,7 @@ bool BatchLUSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample
         {
             Reset();
 
-            mNumRead = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos, featIn.word4idx, labelIn.word4idx, mAllowMultPassData);
+            mNumRead = GetNextBlock();
             if (mNumRead == 0)
             {
                 fprintf(stderr, "EnsureDataAvailable: No more data.\n");
@@ -844,20 +900,30 @@ bool BatchLUSequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix
         Matrix<ElemType>& features = *matrices[m_featuresName];
 
         // loop through all the samples and create a one-hot representation, or multi-hot in some conditions (TODO: which condition)
+        // A dense input is assembled in a CPU matrix and copied over. For a sparse input, we collect the CSC arrays
+        // directly and hand them to the matrix in one call, which copies them straight to its device.
+        bool sparse = features.GetMatrixType() == SPARSE;
         Matrix<ElemType> locObs(CPUDEVICE);
-        if (features.GetMatrixType() == DENSE)
-            locObs.SwitchToMatrixType(DENSE, features.GetFormat(), false);
+        std::vector<CPUSPARSE_INDEX_TYPE> cscCol, cscRow;
+        if (sparse)
+        {
+            cscCol.reserve(actualmbsize + 1);
+            cscRow.reserve(actualmbsize * m_wordContext.size());
+        }
         else
-            locObs.SwitchToMatrixType(SPARSE, matrixFormatSparseCSC, false);
-
-        locObs.Resize(featInfo.dim * m_wordContext.size(), actualmbsize);
-        locObs.SetValue(0);
+        {
+            locObs.SwitchToMatrixType(DENSE, features.GetFormat(), false);
+            locObs.Resize(featInfo.dim * m_wordContext.size(), actualmbsize);
+            locObs.SetValue(0);
+        }
 
         assert(m_featureWordContext.size() == actualmbsize);
         for (size_t j = 0; j < actualmbsize; ++j) // loop over matrix columns
         {
             size_t s = j % mSentenceEndAt.size(); // get the parallel sequence index
             size_t t = j / mSentenceEndAt.size(); // and the time step
+            if (sparse)
+                cscCol.push_back((CPUSPARSE_INDEX_TYPE) cscRow.size());
 
             // vector of feature data goes into matrix column
             // Each column is a (featInfo.dim x m_wordContext.size()) tensor, i.e. one sub-column per word in the context.
@@ -883,14 +949,33 @@ bool BatchLUSequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix
                     // if (m_pMBLayout->IsGap(s, t))    // verify that these are marked as NoInput
                     //    LogicError("BatchLUSequenceReader::GetMinibatch: Inconsistent NoInput flag");
 
-                    locObs.SetValue(idx + jj * featInfo.dim, j, (ElemType) 1);
+                    if (sparse)
+                        cscRow.push_back((CPUSPARSE_INDEX_TYPE) (idx + jj * featInfo.dim));
+                    else
+                        locObs.SetValue(idx + jj * featInfo.dim, j, (ElemType) 1);
                 }
             }
+            // CSC wants increasing row indices within a column; a bag of words may be unordered or repeat a word
+            if (sparse)
+            {
+                auto colBegin = cscRow.begin() + cscCol.back();
+                std::sort(colBegin, cscRow.end());
+                cscRow.erase(std::unique(colBegin, cscRow.end()), cscRow.end());
+            }
         }
 
-        locObs.SetPreferredDeviceId(features.GetDeviceId()); // needed, otherwise SetValue() below will inherit CPUDEVICE a as target
-        // Note: This is not efficient, as it first moves locObs to GPU, and then copies it. What is the correct way of doing this?
-        features.SetValue(locObs);
+        if (sparse)
+        {
+            cscCol.push_back((CPUSPARSE_INDEX_TYPE) cscRow.size());
+            std::vector<ElemType> cscVal(cscRow.size(), (ElemType) 1);
+            features.SetMatrixFromCSCFormat(cscCol.data(), cscRow.data(), cscVal.data(), cscRow.size(), featInfo.dim * m_wordContext.size(), actualmbsize);
+        }
+        else
+        {
+            locObs.SetPreferredDeviceId(features.GetDeviceId()); // needed, otherwise SetValue() below will inherit CPUDEVICE a as target
+            // Note: This is not efficient, as it first moves locObs to GPU, and then copies it. What is the correct way of doing this?
+            features.SetValue(locObs);
+        }
 
         // fill in the label matrix
         GetLabelOutput(matrices, m_labelInfo[labelInfoOut], actualmbsize);
@@ -1270,11 +1355,18 @@ void MultiIOBatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordTy
 
 template <class ElemType>
 void MultiIOBatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+{
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+// the readers shard their files alike, so that they stay aligned
+template <class ElemType>
+void MultiIOBatchLUSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
     // run for each reader
     for (typename map<wstring, BatchLUSequenceReader<ElemType>*>::iterator p = mReader.begin(); p != mReader.end(); p++)
     {
-        (p->second)->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        (p->second)->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
     }
 }
 
@@ -16,6 +16,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -269,6 +270,15 @@ private:
     bool mSentenceEnd;
     bool mSentenceBegin;
 
+    // the next block of sentences is parsed on a background thread while the current one is cut into minibatches
+    std::future<long> m_pendingBlock;
+    std::vector<vector<LabelIdType>> m_prefetchFeatures;
+    std::vector<LabelIdType> m_prefetchLabels;
+    std::vector<stSentenceInfo> m_prefetchSentences;
+    long GetNextBlock();
+    void StartBlockPrefetch();
+    void CancelBlockPrefetch();
+
 public:
     vector<bool> mProcessed;
     BatchLUSequenceParser<ElemType, LabelType> m_parser;
@@ -325,6 +335,11 @@ public:
                           LabelInfo& labelInfo, size_t actualmbsize);
 
     void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     bool EnsureDataAvailable(size_t mbStartSample);
@@ -420,6 +435,7 @@ public:
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples);
+    void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples) override;
 
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout);
 
@@ -228,7 +228,7 @@ void SparseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 
 template <class ElemType>
 SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
-    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0)
+    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0), m_nextTicket(0), m_servingTicket(0)
 {
     std::string name = msra::strfun::utf8(m_fileName);
     m_inFile.open(name, ifstream::binary | ifstream::in);
@@ -406,6 +406,8 @@ void SparseBinaryInput<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, s
 {
 
     m_nextMB = 0;
+    m_nextTicket = 0;
+    m_servingTicket = 0;
 
     m_mbSize = mbSize / numSubsets;
 
@@ -598,7 +600,7 @@ size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<st
     for (int32_t c = 0; c < m_labels.size(); c++)
     {
         // fprintf(stderr, "read labels %d.\n", c);
-        int32_t numCols = m_mappedNumCols[m_labels[c]];
+        int32_t numCols = m_mappedNumCols.at(m_labels[c]); // note: may run on several threads at once
 
         ElemType* vals = (ElemType*) ((char*) data_buffer + buffer_offset);
         buffer_offset += sizeof(ElemType) * curMBSize * numCols;
@@ -616,32 +618,47 @@ size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<st
     return (size_t) curMBSize;
 }
 
+// hand out the ticket for the next call to FillMatrices(); call on the main thread, in minibatch order
 template <class ElemType>
-size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices)
+size_t SparseBinaryInput<ElemType>::ReserveMinibatch()
+{
+    return m_nextTicket++;
+}
+
+// decode the next minibatch into 'matrices'
+// Several calls may run concurrently, each into its own set of matrices. They take their raw (micro-)minibatches
+// from the read thread strictly in ticket order, so minibatches come out in file order; the decoding itself, which
+// for click-through-sized samples is the bulk of the work, then proceeds in parallel.
+template <class ElemType>
+size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices, size_t ticket)
 {
 
     // fprintf(stderr, "start fill matrices\n");
-    size_t curSize = 0;
     for (auto mat : matrices)
     {
         mat.second->SetMaxRows(m_mbSize);
         mat.second->Clear();
     }
-    void* data_buffer;
-    // fprintf(stderr, "start while\n");
-    // clock_t start_w = clock();
-    // while (curSize + m_microBatchSize <= m_mbSize && (data_buffer = m_dataToConsume.pop()) != nullptr) {
-    while (curSize + m_microBatchSize <= m_mbSize && m_nextMB < m_epochSize)
-    {
-        data_buffer = m_dataToConsume.pop();
-        // clock_t in_w = clock();
-        // start_w = in_w - start_w;
-        // fprintf(stderr, "start read mb\tIt took me %d clicks (%f seconds).\n", start_w, ((float)start_w) / CLOCKS_PER_SEC);
-        // start_w = in_w;
-        // fprintf(stderr, "start read mb\n");
+    std::vector<void*> dataBuffers;
+    {
+        std::unique_lock<std::mutex> lock(m_fillMutex);
+        m_fillTurn.wait(lock, [this, ticket]()
+                        {
+                            return m_servingTicket == ticket;
+                        });
+        while ((dataBuffers.size() + 1) * m_microBatchSize <= m_mbSize && m_nextMB < m_epochSize)
+        {
+            dataBuffers.push_back(m_dataToConsume.pop());
+            m_nextMB++;
+        }
+        m_servingTicket++;
+    }
+    m_fillTurn.notify_all();
+
+    size_t curSize = 0;
+    for (void* data_buffer : dataBuffers)
+    {
         curSize += ReadMinibatch(data_buffer, matrices);
-        // fprintf(stderr, "end read mb\n");
-        m_nextMB++;
         m_dataToProduce.push(data_buffer);
     }
     // fprintf(stderr, "end fill matrices\n");
@@ -704,12 +721,18 @@ void LibSVMBinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& reader
         m_mbSize = m_dataInput->GetMBSize();
     }
 
+    // number of minibatches decoded ahead, each on its own thread into its own pinned host buffers
+    m_numPrefetchBuffers = readerConfig(L"numPrefetchBuffers", (size_t) 2);
+    if (m_numPrefetchBuffers == 0)
+        InvalidArgument("LibSVMBinaryReader: numPrefetchBuffers must be at least 1.");
+
     m_prefetchEnabled = true;
 }
 
 template <class ElemType>
 void LibSVMBinaryReader<ElemType>::Destroy()
 {
+    WaitForPrefetch();
 }
 
 template <class ElemType>
@@ -737,6 +760,7 @@ void LibSVMBinaryReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize,
     reader_series = new marker_series(L"Base Reader");
     cur_read = 0;
 #endif
+    WaitForPrefetch(); // fills still pending from an epoch that was not read to its end
     m_dataInput->StartDistributedMinibatchLoop(mbSize, subsetNum, numSubsets);
 }
 
@@ -745,16 +769,40 @@ void LibSVMBinaryReader<ElemType>::CheckDataMatrices(std::map<std::wstring, Matr
 {
     if (m_dataMatrices.empty())
     {
-        for (auto inmat : matrices)
+        m_dataMatrices.resize(m_numPrefetchBuffers);
+        for (auto& set : m_dataMatrices)
         {
-            shared_ptr<BinaryMatrix<ElemType>> mat = m_dataInput->CreateMatrix(inmat.first, inmat.second->GetDeviceId());
-            if (mat != nullptr)
+            for (auto inmat : matrices)
             {
-                m_dataMatrices[inmat.first] = mat;
+                shared_ptr<BinaryMatrix<ElemType>> mat = m_dataInput->CreateMatrix(inmat.first, inmat.second->GetDeviceId());
+                if (mat != nullptr)
+                {
+                    set[inmat.first] = mat;
+                }
             }
         }
     }
 }
+
+// start decoding the next minibatch into m_dataMatrices[set]
+template <class ElemType>
+void LibSVMBinaryReader<ElemType>::LaunchFill(size_t set)
+{
+    size_t ticket = m_dataInput->ReserveMinibatch();
+    m_pendingAsyncGetMinibatch.push_back(std::async(std::launch::async, [this, set, ticket]()
+                                                    {
+                                                        return m_dataInput->FillMatrices(m_dataMatrices[set], ticket);
+                                                    }));
+}
+
+template <class ElemType>
+void LibSVMBinaryReader<ElemType>::WaitForPrefetch()
+{
+    for (auto& pending : m_pendingAsyncGetMinibatch)
+        pending.wait();
+    m_pendingAsyncGetMinibatch.clear();
+    m_nextMatrixSet = 0;
+}
 template <class ElemType>
 void LibSVMBinaryReader<ElemType>::DoDSSMMatrix(Matrix<ElemType>& mat, size_t actualMBSize)
 {
@@ -791,21 +839,20 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<El
     size_t actualMBSize = 0;
     if (m_prefetchEnabled)
     {
-        if (!m_pendingAsyncGetMinibatch.valid())
+        if (m_pendingAsyncGetMinibatch.empty())
         {
             // fprintf(stderr, "not valid\n");
             CheckDataMatrices(matrices);
-            m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
-                                                    {
-                                                        return m_dataInput->FillMatrices(m_dataMatrices);
-                                                    });
+            for (size_t set = 0; set < m_dataMatrices.size(); set++)
+                LaunchFill(set);
         }
 //fprintf(stderr, "before get.\n");
 //timer = clock();
 #if DEBUG
         reader_series->write_flag(_T("before get."));
 #endif
-        actualMBSize = m_pendingAsyncGetMinibatch.get();
+        actualMBSize = m_pendingAsyncGetMinibatch.front().get();
+        m_pendingAsyncGetMinibatch.pop_front();
 #if DEBUG
         reader_series->write_flag(_T("after get."));
 #endif
@@ -814,6 +861,7 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<El
 
         if (actualMBSize == 0)
         {
+            WaitForPrefetch(); // the fills behind this one found the epoch exhausted as well
             return false;
         }
 
@@ -821,7 +869,7 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<El
 #if DEBUG
         reader_series->write_flag(_T("starting fill."));
 #endif
-        for (auto matrix : m_dataMatrices)
+        for (auto matrix : m_dataMatrices[m_nextMatrixSet])
         {
             auto findMat = matrices.find(matrix.first);
             if (findMat != matrices.end())
@@ -837,11 +885,9 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<El
         {
             DoDSSMMatrix(*(findMat->second), actualMBSize);
         }
-        m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
-                                                {
-                                                    // CheckDataMatrices(matrices);
-                                                    return m_dataInput->FillMatrices(m_dataMatrices);
-                                                });
+        // the set has been copied out, reuse it for the minibatch after the ones already pending
+        LaunchFill(m_nextMatrixSet);
+        m_nextMatrixSet = (m_nextMatrixSet + 1) % m_dataMatrices.size();
     }
 #if DEBUG
     cur_read++;
@@ -154,7 +154,8 @@ public:
     void ReadMinibatches(size_t* read_order, size_t numToRead);
     size_t ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
     // void GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
-    size_t FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
+    size_t ReserveMinibatch();
+    size_t FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices, size_t ticket);
     size_t GetMBSize()
     {
         return m_mbSize;
@@ -222,6 +223,12 @@ private:
 #endif
     BlockingQueue<void*> m_dataToProduce;
     BlockingQueue<void*> m_dataToConsume;
+
+    // FillMatrices() may run on several threads; each takes its raw minibatches in the order of its ticket
+    std::mutex m_fillMutex;
+    std::condition_variable m_fillTurn;
+    size_t m_nextTicket;    // next ticket handed out by ReserveMinibatch()
+    size_t m_servingTicket; // ticket whose turn it is to take raw minibatches
 };
 
 template <class ElemType>
@@ -246,7 +253,7 @@ public:
     virtual void Destroy();
 
     LibSVMBinaryReader()
-        : DSSMLabels(nullptr), DSSMCols(0)
+        : DSSMLabels(nullptr), DSSMCols(0), m_numPrefetchBuffers(2), m_nextMatrixSet(0)
     {
         m_pMBLayout = make_shared<MBLayout>();
     };
@@ -295,12 +302,17 @@ private:
     void DoDSSMMatrix(Matrix<ElemType>& mat, size_t actualMBSize);
 
     void CheckDataMatrices(std::map<std::wstring, Matrix<ElemType>*>& matrices);
+    void LaunchFill(size_t set);
+    void WaitForPrefetch();
     MBLayoutPtr m_pMBLayout;
     ConfigParameters m_readerConfig;
 
     std::shared_ptr<SparseBinaryInput<ElemType>> m_dataInput;
 
-    std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>> m_dataMatrices;
+    // sets of pinned host buffers, each holding one decoded minibatch, filled round-robin
+    std::vector<std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>> m_dataMatrices;
+    size_t m_numPrefetchBuffers;
+    size_t m_nextMatrixSet; // set holding the next minibatch to return
 
     unsigned long m_randomize; // randomization range
 
@@ -316,6 +328,6 @@ private:
     bool m_partialMinibatch; // a partial minibatch is allowed
 
     bool m_prefetchEnabled;
-    std::future<size_t> m_pendingAsyncGetMinibatch;
+    std::deque<std::future<size_t>> m_pendingAsyncGetMinibatch; // one per set, in minibatch order
 };
 } } }
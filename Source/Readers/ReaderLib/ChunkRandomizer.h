@@ -0,0 +1,296 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ChunkRandomizer.h -- the order in which a worker visits the sequences (or frames) of a deserializer
+//
+// Two-level randomization with a sliding window: each sweep over the data shuffles the order of the chunks, and the
+// sequences (in frame mode: the frames) of the 'randomizationWindow' chunks that are currently resident form a pool
+// that the next item is drawn from at random. When all items of a chunk have been drawn, the chunk is released and the
+// next chunk in the sweep's order enters the pool. So only the window's chunks are in memory, yet items mix across
+// much more than one window's worth of data; the chunk that enters next is read ahead on the TaskPool.
+// Without randomization, the data is visited in its original order, a chunk at a time.
+//
+// Distributed reading shards by chunk (chunk i goes to worker i % numWorkers), so that a worker only reads its chunks.
+// Each worker takes 1/numWorkers of the epoch's samples from its own stream of sweeps; an epoch starts where the
+// previous one ended if read in order, otherwise its start is found by replaying the sweep on the sequence
+// descriptions, without reading data. The random numbers only depend on sweep and worker rank, so the order is the
+// same when training is restarted from a checkpoint, and a position within the epoch is all that a mid-epoch
+// checkpoint needs to record to continue it with the same sequences.
+//
+// Unlike RandomOrdering, this is thread-safe: several threads may draw from the same randomizer.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h" // for requestDataSize
+#include "DataDeserializer.h"
+#include "TaskPool.h"
+#include <algorithm>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// a sequence, or in frame mode a single frame of it, in a loaded chunk
+struct SequenceReference
+{
+    ChunkPtr m_chunk;
+    size_t m_indexInChunk;
+    size_t m_firstSample;
+    size_t m_numberOfSamples;
+};
+
+class ChunkRandomizer
+{
+public:
+    // randomizationWindow: number of chunks whose sequences are drawn from at a time; 0 means no randomization
+    ChunkRandomizer(IDataDeserializerPtr deserializer, size_t randomizationWindow, bool frameMode)
+        : m_deserializer(deserializer), m_randomize(randomizationWindow > 0), m_windowSize(max(randomizationWindow, (size_t) 1)), m_frameMode(frameMode), m_workerRank(SIZE_MAX), m_numWorkers(0), m_workerSweepSamples(0), m_position(SIZE_MAX), m_epochStart(0), m_epochEnd(0), m_sweep(0), m_nextChunkPos(0), m_poolNext(0), m_dryRun(false)
+    {
+        m_chunkSequences.resize(m_deserializer->GetNumChunks());
+        m_chunkSamples.assign(m_chunkSequences.size(), 0);
+        for (size_t i = 0; i < m_chunkSequences.size(); i++)
+        {
+            m_deserializer->GetSequencesForChunk(i, m_chunkSequences[i]);
+            for (const auto& sequence : m_chunkSequences[i])
+                m_chunkSamples[i] += sequence.m_numberOfSamples;
+        }
+    }
+
+    // samples a worker sees in one sweep over its chunks
+    size_t GetWorkerSweepSamples() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_workerSweepSamples;
+    }
+
+    // epochSize is the total over all workers; requestDataSize means one sweep
+    void StartEpoch(size_t epoch, size_t epochSize, size_t workerRank, size_t numWorkers)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (workerRank != m_workerRank || numWorkers != m_numWorkers)
+        {
+            m_workerRank = workerRank;
+            m_numWorkers = numWorkers;
+            m_workerChunks.clear();
+            m_workerSweepSamples = 0;
+            for (size_t i = m_workerRank; i < m_chunkSequences.size(); i += m_numWorkers)
+            {
+                m_workerChunks.push_back(i);
+                m_workerSweepSamples += m_chunkSamples[i];
+            }
+            m_position = SIZE_MAX; // forget where we are
+        }
+
+        size_t workerEpochSize;
+        if (epochSize == requestDataSize)
+            workerEpochSize = m_workerSweepSamples;
+        else
+            workerEpochSize = epochSize / m_numWorkers + (m_workerRank < epochSize % m_numWorkers ? 1 : 0);
+
+        size_t epochStart = epoch * workerEpochSize;
+        m_epochStart = epochStart;
+        m_epochEnd = epochStart + workerEpochSize;
+        if (m_workerSweepSamples == 0) // more workers than chunks: this one gets nothing
+            m_position = m_epochEnd;
+        else if (epochStart != m_position)
+            Seek(epochStart);
+    }
+
+    // samples drawn by this worker since the start of the epoch
+    size_t GetPositionInEpoch() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_position - m_epochStart;
+    }
+
+    // continue the epoch after 'position' samples of this worker (a value returned by GetPositionInEpoch() after
+    // starting the same epoch with the same parameters); only the sequence descriptions are replayed to get there
+    void SeekInEpoch(size_t position)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_workerSweepSamples == 0) // (nothing to read)
+            return;
+        if (m_epochStart + position != m_position)
+            Seek(m_epochStart + position);
+    }
+
+    // the next sequence (frame) of the epoch; false at the end of the epoch
+    bool GetNext(SequenceReference& result)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_position >= m_epochEnd)
+            return false;
+        Item item = DrawItem();
+        result.m_chunk = GetChunk(item.m_chunkPos);
+        result.m_indexInChunk = item.m_indexInChunk;
+        result.m_firstSample = item.m_firstSample;
+        result.m_numberOfSamples = item.m_numberOfSamples;
+        ReleaseItem(item);
+        return true;
+    }
+
+private:
+    struct Item
+    {
+        size_t m_chunkPos; // index into m_chunkOrder
+        size_t m_indexInChunk;
+        size_t m_firstSample;
+        size_t m_numberOfSamples;
+    };
+
+    void StartSweep(size_t sweep)
+    {
+        m_sweep = sweep;
+        std::seed_seq seed{(unsigned int) sweep, (unsigned int) m_workerRank};
+        m_rng.seed(seed);
+        m_chunkOrder = m_workerChunks;
+        if (m_randomize)
+            std::shuffle(m_chunkOrder.begin(), m_chunkOrder.end(), m_rng);
+        m_remaining.assign(m_chunkOrder.size(), 0);
+        m_pool.clear();
+        m_poolNext = 0;
+        m_residentChunks.clear();
+        m_pendingChunks.clear(); // (reads in flight are finished by the pool and dropped)
+        m_nextChunkPos = 0;
+        while (m_nextChunkPos < m_windowSize && m_nextChunkPos < m_chunkOrder.size())
+            AdmitChunk();
+    }
+
+    // add the next chunk of the sweep's order to the pool
+    void AdmitChunk()
+    {
+        size_t chunkPos = m_nextChunkPos++;
+        for (const auto& sequence : m_chunkSequences[m_chunkOrder[chunkPos]])
+        {
+            if (m_frameMode)
+            {
+                for (size_t t = 0; t < sequence.m_numberOfSamples; t++)
+                    m_pool.push_back(Item{chunkPos, sequence.m_indexInChunk, t, 1});
+            }
+            else
+                m_pool.push_back(Item{chunkPos, sequence.m_indexInChunk, 0, sequence.m_numberOfSamples});
+            m_remaining[chunkPos] += m_frameMode ? sequence.m_numberOfSamples : 1;
+        }
+        if (m_remaining[chunkPos] == 0) // (no sequences: take the next one instead)
+        {
+            if (m_nextChunkPos < m_chunkOrder.size())
+                AdmitChunk();
+            return;
+        }
+        if (!m_dryRun)
+        {
+            StartReadingChunk(chunkPos);
+            StartReadingChunk(m_nextChunkPos); // read ahead the one that enters next
+        }
+    }
+
+    Item DrawItem()
+    {
+        if (m_poolNext >= m_pool.size())
+            StartSweep(m_sweep + 1); // (a sweep ends with an empty pool)
+        if (!m_randomize) // in order
+            return m_pool[m_poolNext++];
+        std::uniform_int_distribution<size_t> pick(0, m_pool.size() - 1);
+        std::swap(m_pool[pick(m_rng)], m_pool.back());
+        Item item = m_pool.back();
+        m_pool.pop_back();
+        return item;
+    }
+
+    // account for a drawn item; releases its chunk when it was its last
+    void ReleaseItem(const Item& item)
+    {
+        m_position += item.m_numberOfSamples;
+        if (--m_remaining[item.m_chunkPos] > 0)
+            return;
+        m_residentChunks.erase(item.m_chunkPos);
+        if (!m_randomize && m_poolNext == m_pool.size())
+        {
+            m_pool.clear();
+            m_poolNext = 0;
+        }
+        if (m_nextChunkPos < m_chunkOrder.size())
+            AdmitChunk();
+    }
+
+    // position at the first sequence (frame) at or after 'position' in the worker's stream of sweeps
+    void Seek(size_t position)
+    {
+        size_t sweep = position / m_workerSweepSamples;
+        m_dryRun = true;
+        StartSweep(sweep);
+        m_position = sweep * m_workerSweepSamples;
+        while (m_position < position)
+            ReleaseItem(DrawItem());
+        m_dryRun = false;
+        for (size_t chunkPos = 0; chunkPos < m_nextChunkPos; chunkPos++)
+            if (m_remaining[chunkPos] > 0)
+                StartReadingChunk(chunkPos);
+        StartReadingChunk(m_nextChunkPos);
+    }
+
+    void StartReadingChunk(size_t chunkPos)
+    {
+        if (chunkPos >= m_chunkOrder.size() || m_residentChunks.find(chunkPos) != m_residentChunks.end() || m_pendingChunks.find(chunkPos) != m_pendingChunks.end())
+            return;
+        IDataDeserializerPtr deserializer = m_deserializer;
+        size_t chunkId = m_chunkOrder[chunkPos];
+        m_pendingChunks[chunkPos] = TaskPool::Submit<ChunkPtr>([deserializer, chunkId]()
+                                                                {
+                                                                    return deserializer->GetChunk(chunkId);
+                                                                });
+    }
+
+    ChunkPtr GetChunk(size_t chunkPos)
+    {
+        auto iter = m_residentChunks.find(chunkPos);
+        if (iter != m_residentChunks.end())
+            return iter->second;
+        StartReadingChunk(chunkPos); // (no-op if already being read)
+        auto pending = m_pendingChunks.find(chunkPos);
+        ChunkPtr chunk = pending->second.get(); // (rethrows read errors)
+        m_pendingChunks.erase(pending);
+        m_residentChunks[chunkPos] = chunk;
+        return chunk;
+    }
+
+    mutable std::mutex m_mutex;
+
+    IDataDeserializerPtr m_deserializer;
+    bool m_randomize;
+    size_t m_windowSize; // in chunks
+    bool m_frameMode;
+    std::vector<std::vector<SequenceDescription>> m_chunkSequences; // [chunkId]
+    std::vector<size_t> m_chunkSamples;                             // [chunkId]
+
+    // sharding
+    size_t m_workerRank;
+    size_t m_numWorkers;
+    std::vector<size_t> m_workerChunks;
+    size_t m_workerSweepSamples;
+
+    // current position; m_position counts samples over the worker's sweeps
+    size_t m_position;
+    size_t m_epochStart;
+    size_t m_epochEnd;
+
+    // state of the current sweep
+    size_t m_sweep;
+    std::mt19937 m_rng;
+    std::vector<size_t> m_chunkOrder; // [chunkPos] -> chunkId
+    size_t m_nextChunkPos;            // the chunk that enters the pool next
+    std::vector<size_t> m_remaining;  // [chunkPos] items not drawn yet
+    std::vector<Item> m_pool;
+    size_t m_poolNext; // without randomization, items are taken from the front
+    bool m_dryRun;     // replaying the sweep to find a position: do not read chunks
+
+    std::map<size_t, ChunkPtr> m_residentChunks;              // [chunkPos]
+    std::map<size_t, std::future<ChunkPtr>> m_pendingChunks; // [chunkPos]
+};
+} } }
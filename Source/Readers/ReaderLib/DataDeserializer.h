@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DataDeserializer.h -- what a data format provides to the reader pipeline (see PipelineReader.h)
+//
+// A deserializer exposes its data as chunks of sequences. A chunk is the unit of paging and of randomization: large
+// enough to be read efficiently (e.g. a few MB of a file), small enough that a randomization window of several chunks
+// fits into memory. The descriptions of all sequences are known upfront (e.g. from an index or a first pass over the
+// data); GetChunk() reads the data of a chunk, and is called on the pipeline's worker threads, for different chunks
+// concurrently. A sequence has the same number of samples in all streams (frame-synchronous, as in all our readers).
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct StreamDescription
+{
+    std::wstring m_name;      // name of the input the stream is read into
+    size_t m_sampleDimension; // elements per sample
+    bool m_isSparse;          // sparse samples are read into sparse inputs as CSC
+};
+
+struct SequenceDescription
+{
+    size_t m_indexInChunk;
+    size_t m_numberOfSamples;
+};
+
+// the data of one stream of one sequence
+struct SequenceData
+{
+    size_t m_numberOfSamples;
+    std::vector<float> m_values;        // dense: [sampleDimension x numberOfSamples] column-major; sparse: the non-zero values
+    std::vector<int32_t> m_indices;     // sparse: the row of each non-zero value
+    std::vector<size_t> m_sampleStarts; // sparse: [numberOfSamples + 1] where the non-zero values of each sample begin
+};
+
+class Chunk
+{
+public:
+    virtual ~Chunk() {}
+    // get the samples [firstSample, firstSample + numberOfSamples) of a sequence of this chunk, one entry per stream
+    // (In frame mode, samples of a sequence are requested one at a time.)
+    // This is called from one thread at a time, but not necessarily from the thread that read the chunk.
+    virtual void GetSamples(size_t indexInChunk, size_t firstSample, size_t numberOfSamples, std::vector<SequenceData>& result) = 0;
+};
+typedef std::shared_ptr<Chunk> ChunkPtr;
+
+class IDataDeserializer
+{
+public:
+    virtual ~IDataDeserializer() {}
+    virtual std::vector<StreamDescription> GetStreamDescriptions() const = 0;
+    virtual size_t GetNumChunks() const = 0;
+    virtual void GetSequencesForChunk(size_t chunkId, std::vector<SequenceDescription>& result) const = 0;
+    // read a chunk; must be thread-safe for different chunks
+    virtual ChunkPtr GetChunk(size_t chunkId) = 0;
+};
+typedef std::shared_ptr<IDataDeserializer> IDataDeserializerPtr;
+} } }
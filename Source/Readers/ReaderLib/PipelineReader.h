@@ -0,0 +1,164 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PipelineReader.h -- an IDataReader composed of a deserializer, a ChunkRandomizer and a SequencePacker
+//
+// This is the redesign sketched in DataReader_v2.txt: a data format only implements IDataDeserializer (DataDeserializer.h),
+// and a reader for it derives from PipelineReader and hands its deserializer to InitPipeline() from Init(). Chunked
+// randomization, reading ahead on the process-wide TaskPool, distributed reading, and packing into the MBLayout then
+// come with it. Asynchronous prefetch of whole minibatches is the PrefetchingDataReader that SGD wraps every reader in.
+//
+// Config (in the reader section):
+//   randomize = "auto" (default) | "none"
+//   randomizationWindow = 32      -- number of chunks whose sequences are drawn from at a time
+//   frameMode = true (default)    -- randomize and pack frames instead of sequences
+//   nbruttsineachrecurrentiter = 1 -- sequence mode: number of parallel sequences
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "DataDeserializer.h"
+#include "ChunkRandomizer.h"
+#include "SequencePacker.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class PipelineReader : public IDataReader<ElemType>
+{
+public:
+    PipelineReader()
+        : m_pMBLayout(make_shared<MBLayout>()), m_frameMode(true), m_numParallelSequences(1), m_mbSize(0), m_numWorkers(1), m_epochEnded(true)
+    {
+    }
+
+    virtual void Destroy() override
+    {
+        delete this;
+    }
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (!m_randomizer)
+            LogicError("PipelineReader: InitPipeline() was not called.");
+        m_mbSize = mbSize;
+        m_numWorkers = numSubsets;
+        m_randomizer->StartEpoch(epoch, requestedEpochSamples, subsetNum, numSubsets);
+        m_epochEnded = false;
+    }
+
+    virtual bool SupportsSamplePositionSeek() const override
+    {
+        return true;
+    }
+
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_randomizer->GetPositionInEpoch();
+    }
+
+    virtual void SetCurrentSamplePosition(size_t samplePosition) override
+    {
+        m_randomizer->SeekInEpoch(samplePosition);
+        m_epochEnded = false;
+    }
+
+    virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) override
+    {
+        // each worker reads its share of the samples; in sequence mode whole sequences, until the share is reached
+        size_t workerMBSize = max(m_mbSize / m_numWorkers, (size_t) 1);
+        m_sequences.clear();
+        size_t numSamples = 0;
+        SequenceReference sequence;
+        while (numSamples < workerMBSize && m_randomizer->GetNext(sequence))
+        {
+            m_sequences.push_back(sequence);
+            numSamples += sequence.m_numberOfSamples;
+        }
+        if (m_sequences.empty())
+        {
+            m_epochEnded = true;
+            return false;
+        }
+        size_t numParallelSequences = max(m_numParallelSequences / m_numWorkers, (size_t) 1);
+        m_packer->Pack(m_sequences, numParallelSequences, m_frameMode, matrices, m_pMBLayout);
+        m_sequences.clear(); // (releases the chunks)
+        return true;
+    }
+
+    virtual size_t GetNumParallelSequences() override
+    {
+        return m_pMBLayout->GetNumParallelSequences();
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        pMBLayout->CopyFrom(m_pMBLayout);
+    }
+
+    virtual bool DataEnd(EndDataType endDataType) override
+    {
+        switch (endDataType)
+        {
+        case endDataEpoch:
+        case endDataSet:
+            return m_epochEnded;
+        case endDataSentence: // each minibatch consists of whole sequences or frames
+            return true;
+        default:
+            return false;
+        }
+    }
+
+protected:
+    // called by the derived reader's Init() with its deserializer
+    template <class ConfigRecordType>
+    void InitPipeline(IDataDeserializerPtr deserializer, const ConfigRecordType& readerConfig)
+    {
+        bool randomize = true;
+        if (readerConfig.Exists(L"randomize"))
+        {
+            wstring randomizeString = readerConfig(L"randomize");
+            if (!_wcsicmp(randomizeString.c_str(), L"none"))
+                randomize = false;
+            else if (_wcsicmp(randomizeString.c_str(), L"auto"))
+                InvalidArgument("PipelineReader: 'randomize' must be 'auto' or 'none'; use 'randomizationWindow' for the window size.");
+        }
+        size_t randomizationWindow = randomize ? (size_t) readerConfig(L"randomizationWindow", (size_t) 32) : 0;
+        m_frameMode = readerConfig(L"frameMode", true);
+        intargvector numberOfuttsPerMinibatch = readerConfig(L"nbruttsineachrecurrentiter", ConfigRecordType::Array(intargvector(vector<int>{1})));
+        m_numParallelSequences = m_frameMode ? 1 : numberOfuttsPerMinibatch[0];
+
+        m_randomizer = make_shared<ChunkRandomizer>(deserializer, randomizationWindow, m_frameMode);
+        m_packer = make_shared<SequencePacker<ElemType>>(deserializer->GetStreamDescriptions());
+    }
+
+private:
+    shared_ptr<ChunkRandomizer> m_randomizer;
+    shared_ptr<SequencePacker<ElemType>> m_packer;
+    MBLayoutPtr m_pMBLayout;
+    bool m_frameMode;
+    size_t m_numParallelSequences;
+    size_t m_mbSize;
+    size_t m_numWorkers;
+    bool m_epochEnded;
+    std::vector<SequenceReference> m_sequences;
+};
+} } }
@@ -0,0 +1,145 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SequencePacker.h -- packs the sequences of a minibatch into the input matrices and the MBLayout
+//
+// In frame mode, each item is one frame and becomes one column. Otherwise the sequences are distributed over up to
+// numParallelSequences rows, each to the currently shortest row, and the rows are padded with gaps to the longest.
+// Column (t * numParallelSequences + s) holds time step t of row s, as everywhere else.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "DataDeserializer.h"
+#include "ChunkRandomizer.h" // for SequenceReference
+#include "Sequences.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class SequencePacker
+{
+public:
+    SequencePacker(const std::vector<StreamDescription>& streams)
+        : m_streams(streams)
+    {
+    }
+
+    void Pack(const std::vector<SequenceReference>& sequences, size_t numParallelSequences, bool frameMode,
+              std::map<std::wstring, Matrix<ElemType>*>& matrices, const MBLayoutPtr& pMBLayout)
+    {
+        // place the sequences
+        size_t numRows, numTimeSteps;
+        std::vector<size_t> rowOf(sequences.size()), beginOf(sequences.size());
+        if (frameMode)
+        {
+            numRows = sequences.size();
+            numTimeSteps = 1;
+            for (size_t i = 0; i < sequences.size(); i++)
+            {
+                if (sequences[i].m_numberOfSamples != 1)
+                    LogicError("SequencePacker: Frame mode expects single frames.");
+                rowOf[i] = i;
+                beginOf[i] = 0;
+            }
+            pMBLayout->InitAsFrameMode(numRows);
+        }
+        else
+        {
+            numRows = max(min(numParallelSequences, sequences.size()), (size_t) 1);
+            std::vector<size_t> rowLengths(numRows, 0);
+            for (size_t i = 0; i < sequences.size(); i++)
+            {
+                rowOf[i] = std::min_element(rowLengths.begin(), rowLengths.end()) - rowLengths.begin();
+                beginOf[i] = rowLengths[rowOf[i]];
+                rowLengths[rowOf[i]] += sequences[i].m_numberOfSamples;
+            }
+            numTimeSteps = *std::max_element(rowLengths.begin(), rowLengths.end());
+            pMBLayout->Init(numRows, numTimeSteps);
+            for (size_t i = 0; i < sequences.size(); i++)
+                pMBLayout->AddSequence(NEW_SEQUENCE_ID, rowOf[i], beginOf[i], beginOf[i] + sequences[i].m_numberOfSamples);
+            for (size_t s = 0; s < numRows; s++)
+                if (rowLengths[s] < numTimeSteps)
+                    pMBLayout->AddGap(s, rowLengths[s], numTimeSteps);
+        }
+
+        // fetch the data from the chunks
+        std::vector<std::vector<SequenceData>> data(sequences.size());
+        for (size_t i = 0; i < sequences.size(); i++)
+            sequences[i].m_chunk->GetSamples(sequences[i].m_indexInChunk, sequences[i].m_firstSample, sequences[i].m_numberOfSamples, data[i]);
+
+        // write each stream that is asked for
+        size_t numCols = numRows * numTimeSteps;
+        for (size_t k = 0; k < m_streams.size(); k++)
+        {
+            auto iter = matrices.find(m_streams[k].m_name);
+            if (iter == matrices.end())
+                continue;
+            Matrix<ElemType>& matrix = *iter->second;
+            size_t dim = m_streams[k].m_sampleDimension;
+            if (m_streams[k].m_isSparse && matrix.GetMatrixType() == MatrixType::SPARSE)
+            {
+                // CSC, built column by column; gap columns stay empty
+                std::vector<size_t> sequenceAt(numCols, SIZE_MAX);
+                for (size_t i = 0; i < sequences.size(); i++)
+                    for (size_t t = 0; t < sequences[i].m_numberOfSamples; t++)
+                        sequenceAt[(beginOf[i] + t) * numRows + rowOf[i]] = i;
+                m_cscCol.assign(1, 0);
+                m_cscRow.clear();
+                m_cscVal.clear();
+                for (size_t j = 0; j < numCols; j++)
+                {
+                    size_t i = sequenceAt[j];
+                    if (i != SIZE_MAX)
+                    {
+                        const SequenceData& sd = data[i][k];
+                        size_t t = j / numRows - beginOf[i];
+                        for (size_t n = sd.m_sampleStarts[t]; n < sd.m_sampleStarts[t + 1]; n++)
+                        {
+                            m_cscRow.push_back((CPUSPARSE_INDEX_TYPE) sd.m_indices[n]);
+                            m_cscVal.push_back((ElemType) sd.m_values[n]);
+                        }
+                    }
+                    m_cscCol.push_back((CPUSPARSE_INDEX_TYPE) m_cscRow.size());
+                }
+                matrix.SetMatrixFromCSCFormat(m_cscCol.data(), m_cscRow.data(), m_cscVal.data(), m_cscRow.size(), dim, numCols);
+            }
+            else if (matrix.GetMatrixType() == MatrixType::SPARSE)
+                RuntimeError("SequencePacker: Dense stream '%ls' cannot be read into a sparse input.", m_streams[k].m_name.c_str());
+            else
+            {
+                m_dense.assign(dim * numCols, 0);
+                for (size_t i = 0; i < sequences.size(); i++)
+                {
+                    const SequenceData& sd = data[i][k];
+                    for (size_t t = 0; t < sequences[i].m_numberOfSamples; t++)
+                    {
+                        ElemType* column = &m_dense[((beginOf[i] + t) * numRows + rowOf[i]) * dim];
+                        if (m_streams[k].m_isSparse) // scatter
+                        {
+                            for (size_t n = sd.m_sampleStarts[t]; n < sd.m_sampleStarts[t + 1]; n++)
+                                column[sd.m_indices[n]] = (ElemType) sd.m_values[n];
+                        }
+                        else
+                            std::copy(sd.m_values.begin() + t * dim, sd.m_values.begin() + (t + 1) * dim, column);
+                    }
+                }
+                matrix.SetValue(dim, numCols, matrix.GetDeviceId(), m_dense.data(), matrixFlagNormal);
+            }
+        }
+    }
+
+private:
+    std::vector<StreamDescription> m_streams;
+    // buffers, kept across minibatches
+    std::vector<ElemType> m_dense;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_cscCol, m_cscRow;
+    std::vector<ElemType> m_cscVal;
+};
+} } }
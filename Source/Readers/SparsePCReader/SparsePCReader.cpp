@@ -27,39 +27,22 @@ DWORD LODWORD(size_t size)
 template <class ElemType>
 SparsePCReader<ElemType>::~SparsePCReader()
 {
-    if (m_filemap != NULL)
-    {
-        UnmapViewOfFile(m_filemap);
-    }
+    if (m_pendingPrefetch.valid()) // (the prefetch reads the mapped file)
+        m_pendingPrefetch.wait();
 
     if (m_dataBuffer != NULL)
     {
         UnmapViewOfFile(m_dataBuffer);
     }
 
-    CloseHandle(m_hndl);
-
-    for (int i = 0; i < m_featureCount; i++)
+    if (m_filemap != NULL)
     {
-        if (m_values[i] != NULL)
-        {
-            free(m_values[i]);
-        }
-
-        if (m_rowIndices[i] != NULL)
-        {
-            free(m_rowIndices[i]);
-        }
-
-        if (m_colIndices[i] != NULL)
-        {
-            free(m_colIndices[i]);
-        }
+        CloseHandle(m_filemap);
     }
 
-    if (m_labelsBuffer != NULL)
+    if (m_hndl != INVALID_HANDLE_VALUE)
     {
-        free(m_labelsBuffer);
+        CloseHandle(m_hndl);
     }
 }
 
@@ -109,9 +92,6 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 
     m_featureNames = std::vector<std::wstring>(m_featureCount);
     m_dims = std::vector<size_t>(m_featureCount);
-    m_values = std::vector<ElemType*>(m_featureCount);
-    m_rowIndices = std::vector<int32_t*>(m_featureCount);
-    m_colIndices = std::vector<int32_t*>(m_featureCount);
 
     for (int i = 0; i < m_featureCount; i++)
     {
@@ -143,38 +123,121 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
                                          HIDWORD(0),
                                          LODWORD(0),
                                          0);
+
+    IndexRecords();
 }
 
-//StartMinibatchLoop - Startup a minibatch loop
-// mbSize - [in] size of the minibatch (number of Samples, etc.)
-// epoch - [in] epoch number for this loop --ignored
-// requestedEpochSamples - [in] number of samples to randomize --ignored
+// IndexRecords - find the offsets of the records, from their headers
+// Records are variable-length: per feature an int32 nnz, nnz values, nnz row indices; then the label, and the optional verification code.
+template <class ElemType>
+void SparsePCReader<ElemType>::IndexRecords()
+{
+    m_recordOffsets.clear();
+    int64_t offset = 0;
+    while (offset < m_filePositionMax)
+    {
+        m_recordOffsets.push_back(offset);
+        for (int i = 0; i < m_featureCount; i++)
+        {
+            int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + offset);
+            offset += sizeof(int32_t) + (sizeof(ElemType) + sizeof(int32_t)) * nnz;
+        }
+        offset += sizeof(ElemType);
+        if (m_verificationCode != 0)
+            offset += sizeof(int32_t);
+    }
+    if (offset != m_filePositionMax)
+        RuntimeError("SparsePCReader: The last record of %ls is truncated.", m_file.c_str());
+}
+
+// FillBatch - gather the CSC arrays and labels of a range of records
+// This only reads the mapped file, so it may run on a background thread.
 template <class ElemType>
-void SparsePCReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples*/)
+void SparsePCReader<ElemType>::FillBatch(size_t firstRecord, size_t numRecords, SparsePCBatch<ElemType>& batch) const
 {
-    if (m_values[0] == NULL || m_miniBatchSize != mbSize)
+    batch.values.resize(m_featureCount);
+    batch.rowIndices.resize(m_featureCount);
+    batch.colIndices.resize(m_featureCount);
+    for (int i = 0; i < m_featureCount; i++)
     {
-        m_miniBatchSize = mbSize;
+        batch.values[i].clear();
+        batch.values[i].reserve(m_dims[i] * numRecords / m_sparsenessFactor);
+        batch.rowIndices[i].clear();
+        batch.rowIndices[i].reserve(m_dims[i] * numRecords / m_sparsenessFactor);
+        batch.colIndices[i].resize(numRecords + 1);
+    }
+    batch.labels.resize(numRecords);
+    batch.numRecords = numRecords;
 
+    for (size_t j = 0; j < numRecords; j++)
+    {
+        const char* record = (const char*) m_dataBuffer + m_recordOffsets[firstRecord + j];
         for (int i = 0; i < m_featureCount; i++)
         {
-            if (m_values[i] != NULL)
-            {
-                free(m_values[i]);
-                free(m_colIndices[i]);
-                free(m_rowIndices[i]);
-                free(m_labelsBuffer);
-            }
-
-            m_values[i] = (ElemType*) malloc(sizeof(ElemType) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_rowIndices[i] = (int32_t*) malloc(sizeof(int32_t) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_colIndices[i] = (int32_t*) malloc(sizeof(int32_t) * (m_miniBatchSize + 1));
-            m_labelsBuffer = (ElemType*) malloc(sizeof(ElemType) * m_miniBatchSize);
+            batch.colIndices[i][j] = (int32_t) batch.values[i].size();
+
+            int32_t nnz = *(const int32_t*) record;
+            record += sizeof(int32_t);
+
+            const ElemType* values = (const ElemType*) record;
+            batch.values[i].insert(batch.values[i].end(), values, values + nnz);
+            record += (sizeof(ElemType) * nnz);
+
+            const int32_t* rowIndices = (const int32_t*) record;
+            batch.rowIndices[i].insert(batch.rowIndices[i].end(), rowIndices, rowIndices + nnz);
+            record += (sizeof(int32_t) * nnz);
+        }
+
+        batch.labels[j] = *(const ElemType*) record;
+        record += sizeof(ElemType);
+
+        if (m_verificationCode != 0)
+        {
+            int32_t verifCode = *(const int32_t*) record;
+
+            if (verifCode != m_verificationCode)
+                RuntimeError("Verification code did not match (expected %d) - error in reading data", m_verificationCode);
         }
     }
 
+    for (int i = 0; i < m_featureCount; i++)
+        batch.colIndices[i][numRecords] = (int32_t) batch.values[i].size();
+}
+
+template <class ElemType>
+void SparsePCReader<ElemType>::WaitForPrefetch()
+{
+    if (m_pendingPrefetch.valid())
+        m_pendingPrefetch.get(); // (rethrows)
+}
+
+//StartMinibatchLoop - Startup a minibatch loop
+// mbSize - [in] size of the minibatch (number of Samples, etc.)
+// epoch - [in] epoch number for this loop --ignored
+// requestedEpochSamples - [in] number of samples to randomize --ignored
+template <class ElemType>
+void SparsePCReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+{
+    StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+}
+
+//StartDistributedMinibatchLoop - Startup a distributed minibatch loop for parallel training
+// subsetNum - [in] the subset number of the current node in a group of parallel training nodes
+// numSubsets - [in] total number of nodes participating in the parallel training
+// Each node reads the records [subsetNum * R / numSubsets, (subsetNum + 1) * R / numSubsets) of the R records, in minibatches of mbSize / numSubsets.
+template <class ElemType>
+void SparsePCReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t subsetNum, size_t numSubsets, size_t /*requestedEpochSamples*/)
+{
+    WaitForPrefetch(); // (a prefetch of the previous loop must not write into the buffer any longer)
+    m_prefetchRecord = SIZE_MAX;
+
+    m_miniBatchSize = mbSize;
+    m_workerMiniBatchSize = max(mbSize / numSubsets, (size_t) 1);
+
     // reset the next read sample
-    m_currOffset = 0;
+    size_t numRecords = m_recordOffsets.size();
+    m_currRecord = numRecords * subsetNum / numSubsets;
+    m_endRecord = numRecords * (subsetNum + 1) / numSubsets;
 }
 
 // GetMinibatch - Get the next minibatch (features and labels)
@@ -189,10 +252,10 @@ bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
         return false;
 
     // Return early (for debugging purposes)
-    if (m_maxReadData > 0 && m_currOffset >= m_maxReadData)
+    if (m_maxReadData > 0 && m_currRecord < m_endRecord && m_recordOffsets[m_currRecord] >= m_maxReadData)
         return false;
 
-    if (m_currOffset >= m_filePositionMax)
+    if (m_currRecord >= m_endRecord)
         return false;
 
     Matrix<ElemType>* labels = nullptr; // labels to return, or NULL if no labels in matrix set
@@ -205,64 +268,36 @@ bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
             RuntimeError("SparsePCReader only supports single label value per column but the network expected %d.", (int) labels->GetNumRows());
     }
 
-    std::vector<int32_t> currIndex = std::vector<int32_t>(m_featureCount);
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        currIndex[i] = 0;
-    }
-
-    size_t j = 0;
-
-    for (j = 0; j < m_miniBatchSize && m_currOffset < m_filePositionMax; j++)
+    // take the minibatch that was assembled in the background if it is this one, else assemble it now
+    size_t j = min(m_workerMiniBatchSize, m_endRecord - m_currRecord);
+    WaitForPrefetch();
+    if (m_prefetchRecord == m_currRecord && m_prefetchBatch.numRecords == j)
+        std::swap(m_currentBatch, m_prefetchBatch);
+    else
+        FillBatch(m_currRecord, j, m_currentBatch);
+    m_prefetchRecord = SIZE_MAX;
+    m_currRecord += j;
+
+    // assemble the next one while this one is used
+    if (m_currRecord < m_endRecord)
     {
-        for (int i = 0; i < m_featureCount; i++)
-        {
-            m_colIndices[i][j] = currIndex[i];
-
-            int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
-            m_currOffset += sizeof(int32_t);
-
-            if (nnz > m_dims[i] / m_sparsenessFactor)
-            {
-                RuntimeError("Input data is too dense - not enough memory allocated");
-            }
-
-            memcpy(m_values[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(ElemType) * nnz);
-            m_currOffset += (sizeof(ElemType) * nnz);
-
-            memcpy(m_rowIndices[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(int32_t) * nnz);
-            m_currOffset += (sizeof(int32_t) * nnz);
-
-            currIndex[i] += nnz;
-        }
-
-        ElemType label = *(ElemType*) ((char*) m_dataBuffer + m_currOffset);
-        m_labelsBuffer[j] = label;
-        m_currOffset += sizeof(ElemType);
-
-        if (m_verificationCode != 0)
-        {
-            int32_t verifCode = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
-
-            if (verifCode != m_verificationCode)
-            {
-                RuntimeError("Verification code did not match (expected %d) - error in reading data", m_verificationCode);
-                return false;
-            }
-
-            m_currOffset += sizeof(int32_t);
-        }
+        size_t nextRecord = m_currRecord;
+        size_t nextNumRecords = min(m_workerMiniBatchSize, m_endRecord - m_currRecord);
+        m_prefetchRecord = nextRecord;
+        m_pendingPrefetch = std::async(std::launch::async, [this, nextRecord, nextNumRecords]()
+                                       {
+                                           FillBatch(nextRecord, nextNumRecords, m_prefetchBatch);
+                                       });
     }
 
     for (int i = 0; i < m_featureCount; i++)
     {
-        m_colIndices[i][j] = currIndex[i];
         Matrix<ElemType>& features = *matrices[m_featureNames[i]];
 
         if (features.GetFormat() != MatrixFormat::matrixFormatSparseCSC)
             features.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
 
-        features.SetMatrixFromCSCFormat(m_colIndices[i], m_rowIndices[i], m_values[i], currIndex[i], m_dims[i], j);
+        features.SetMatrixFromCSCFormat(m_currentBatch.colIndices[i].data(), m_currentBatch.rowIndices[i].data(), m_currentBatch.values[i].data(), m_currentBatch.values[i].size(), m_dims[i], j);
     }
 
     if (m_returnDense || m_doGradientCheck)
@@ -277,7 +312,7 @@ bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
     {
         labels->Resize(1, j);
         labels->SetValue((ElemType) 0);
-        labels->SetValue(1, j, labels->GetDeviceId(), m_labelsBuffer, 0);
+        labels->SetValue(1, j, labels->GetDeviceId(), m_currentBatch.labels.data(), 0);
     }
 
     // create the MBLayout
@@ -300,10 +335,10 @@ bool SparsePCReader<ElemType>::DataEnd(EndDataType endDataType)
         assert(false);
         break;
     case endDataEpoch:
-        ret = (m_currOffset >= m_filePositionMax);
+        ret = (m_currRecord >= m_endRecord);
         break;
     case endDataSet:
-        ret = (m_currOffset >= m_filePositionMax);
+        ret = (m_currRecord >= m_endRecord);
         break;
     case endDataSentence: // for fast reader each minibatch is considered a "sentence", so always true --huh?
         ret = true;
@@ -12,9 +12,21 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// the CSC arrays and labels of one minibatch, assembled off the training thread
+template <class ElemType>
+struct SparsePCBatch
+{
+    std::vector<std::vector<ElemType>> values;     // [feature]
+    std::vector<std::vector<int32_t>> rowIndices;  // [feature]
+    std::vector<std::vector<int32_t>> colIndices;  // [feature]
+    std::vector<ElemType> labels;
+    size_t numRecords;
+};
+
 template <class ElemType>
 class SparsePCReader : public IDataReader<ElemType>
 {
@@ -32,25 +44,37 @@ private:
     bool m_returnDense;
     size_t m_sparsenessFactor;
     int32_t m_verificationCode;
-    std::vector<ElemType*> m_values;
-    std::vector<int32_t*> m_rowIndices;
-    std::vector<int32_t*> m_colIndices;
-    ElemType* m_labelsBuffer;
     MBLayoutPtr m_pMBLayout;
 
     HANDLE m_hndl;
     HANDLE m_filemap;
     void* m_dataBuffer;
     int64_t m_filePositionMax;
-    int64_t m_currOffset;
+    std::vector<int64_t> m_recordOffsets; // [record] file offset, from one pass over the record headers in Init()
     int m_traceLevel;
 
+    // the records [m_currRecord, m_endRecord) remain to be read by this worker
+    // With distributed reading, each worker reads a contiguous range of the records, in minibatches of its share of the size.
+    size_t m_currRecord;
+    size_t m_endRecord;
+    size_t m_workerMiniBatchSize;
+
+    // the next minibatch is assembled in the background while the current one is used
+    std::future<void> m_pendingPrefetch;
+    size_t m_prefetchRecord; // first record of the prefetched minibatch, or SIZE_MAX
+    SparsePCBatch<ElemType> m_prefetchBatch;
+    SparsePCBatch<ElemType> m_currentBatch;
+
+    void IndexRecords();
+    void FillBatch(size_t firstRecord, size_t numRecords, SparsePCBatch<ElemType>& batch) const;
+    void WaitForPrefetch();
+
     std::map<LabelIdType, LabelType> m_mapIdToLabel;
     std::map<LabelType, LabelIdType> m_mapLabelToId;
 
 public:
     SparsePCReader()
-        : m_pMBLayout(make_shared<MBLayout>()){};
+        : m_miniBatchSize(0), m_pMBLayout(make_shared<MBLayout>()), m_hndl(INVALID_HANDLE_VALUE), m_filemap(NULL), m_dataBuffer(NULL), m_currRecord(0), m_endRecord(0), m_workerMiniBatchSize(0), m_prefetchRecord(SIZE_MAX){};
     virtual ~SparsePCReader();
     virtual void Destroy();
     template <class ConfigRecordType>
@@ -64,6 +88,11 @@ public:
         InitFromConfig(config);
     }
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     size_t GetNumParallelSequences()
@@ -71,6 +100,10 @@ public:
         return m_pMBLayout->GetNumParallelSequences();
     }
     void SetNumParallelSequences(const size_t){};
+    bool SupportsConcurrentRead() const override
+    {
+        return true;
+    }
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
         pMBLayout->CopyFrom(m_pMBLayout);
@@ -319,6 +319,8 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
     m_readNextSample = 0;
     m_traceLevel = readerConfig(L"traceLevel", 0);
     m_parser.SetTraceLevel(m_traceLevel);
+    // parse large text files on several threads, in blocks of parseBlockSize MB
+    m_parser.SetNumThreads(readerConfig(L"parseThreads", (size_t) 1), readerConfig(L"parseBlockSize", (size_t) 8) * 1024 * 1024);
 
     m_prefetchEnabled = readerConfig(L"prefetch", false);
     // set the feature count to at least one (we better have one feature...)
@@ -386,6 +388,11 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
     size_t bufSize = max(dimFeatures * 16, (size_t) 256 * 1024);
     m_parser.ParseInit(file.c_str(), startFeatures, dimFeatures, startLabels, dimLabels, bufSize);
 
+    // keep the parsed records in a binary cache, which later runs map instead of parsing the text again
+    std::wstring parseCacheDir = readerConfig(L"parseCacheDir", L"");
+    if (!parseCacheDir.empty())
+        m_parser.EnableCache(parseCacheDir);
+
     // if we have labels, we need a label Mapping file, it will be a file with one label per line
     if (m_labelType != labelNone)
     {
@@ -656,6 +663,9 @@ void UCIFastReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_
 {
     m_subsetNum = subsetNum;
     m_numSubsets = numSubsets;
+    // all subsets read the whole file, so let one of them write the parse cache
+    if (subsetNum != 0)
+        m_parser.DisableCacheWriting();
     if (mOneLinePerFile)
         mbSize = mRequestedNumParallelSequences; // each file has only one observation, therefore the number of data to read is the number of files
 
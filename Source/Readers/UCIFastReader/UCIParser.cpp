@@ -7,9 +7,16 @@
 
 #include "stdafx.h"
 #include "Basics.h"
+#include "fileutil.h"
 #include "UCIParser.h"
 #include <stdexcept>
 #include <stdint.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if WIN32
 #define ftell64 _ftelli64
@@ -237,16 +244,38 @@ void UCIParser<NumType, LabelType>::Init()
     m_pFile = NULL;
     m_stateTable = new DWORD[AllStateMax * 256];
     SetupStateTables();
+    m_numThreads = 1;
+    m_blockSize = 0;
+    m_blocksLaunched = 0;
+    m_readPosition = 0;
+    m_bufferStale = false;
+    m_block = NULL;
+    m_cacheFile = NULL;
+    m_cacheLabelsFile = NULL;
+    m_cacheRecords = 0;
+    m_cacheLabelPosition = 0;
 }
 
 // Parser destructor
 template <typename NumType, typename LabelType>
 UCIParser<NumType, LabelType>::~UCIParser()
 {
-    delete m_stateTable;
-    delete m_fileBuffer;
+    if (m_cacheFile != NULL)
+        AbandonCache("the file was not parsed to its end");
+    DiscardBlocks();
+    delete[] m_stateTable;
+    CloseFile();
+}
+
+// CloseFile - close the open file and free the read buffer
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::CloseFile()
+{
+    delete[] m_fileBuffer;
+    m_fileBuffer = NULL;
     if (m_pFile)
         fclose(m_pFile);
+    m_pFile = NULL;
 }
 
 // DoneWithLabel - Called when a string label is found
@@ -360,8 +389,13 @@ void UCIParser<NumType, LabelType>::ParseInit(LPCWSTR fileName, size_t startFeat
     m_bufferStart = startPosition;
 
     // if we have a file already open, cleanup
-    if (m_pFile != NULL)
-        UCIParser<NumType, LabelType>::~UCIParser();
+    if (m_cacheFile != NULL)
+        AbandonCache("another file is being parsed");
+    m_cache.reset();
+    m_cachePath.clear();
+    DiscardBlocks();
+    CloseFile();
+    m_fileName = fileName;
 
     errno_t err = _wfopen_s(&m_pFile, fileName, L"rb");
     if (err)
@@ -380,6 +414,8 @@ void UCIParser<NumType, LabelType>::ParseInit(LPCWSTR fileName, size_t startFeat
 template <typename NumType, typename LabelType>
 int64_t UCIParser<NumType, LabelType>::GetFilePosition()
 {
+    if (m_cache)
+        return (int64_t) m_cacheRecords;
     int64_t position = ftell64(m_pFile);
     if (position == -1L)
         RuntimeError("UCIParser::GetFilePosition - error retrieving file position in file");
@@ -393,6 +429,22 @@ int64_t UCIParser<NumType, LabelType>::GetFilePosition()
 template <typename NumType, typename LabelType>
 void UCIParser<NumType, LabelType>::SetFilePosition(int64_t position)
 {
+    if (m_cache) // position is a record index
+    {
+        m_cacheRecords = 0;
+        m_cacheLabelPosition = 0;
+        ParseMode parseMode = m_parseMode;
+        m_parseMode = ParseLineCount;
+        ParseCache((size_t) position, NULL, NULL);
+        m_parseMode = parseMode;
+        return;
+    }
+    if (m_cacheFile != NULL && position != m_byteCounter)
+        AbandonCache("the file was repositioned before its end was reached");
+
+    DiscardBlocks();
+    m_bufferStale = false;
+
     int rc = _fseeki64(m_pFile, position, SEEK_SET);
     if (rc)
         RuntimeError("UCIParser::SetFilePosition - error seeking in file");
@@ -411,6 +463,14 @@ void UCIParser<NumType, LabelType>::SetFilePosition(int64_t position)
 template <typename NumType, typename LabelType>
 bool UCIParser<NumType, LabelType>::HasMoreData()
 {
+    if (m_cache)
+        return m_cacheRecords < m_cache->header->numRecords;
+    // parallel parsing: assume that the blocks in flight have records (Parse() also tolerates if not)
+    if (!m_blocks.empty())
+        return true;
+    if (m_bufferStale)
+        SetFilePosition(m_byteCounter);
+
     long long byteCounter = m_byteCounter;
     size_t bufferIndex = m_byteCounter - m_bufferStart;
 
@@ -479,6 +539,166 @@ void UCIParser<NumType, LabelType>::SetTraceLevel(int traceLevel)
     m_traceLevel = traceLevel;
 }
 
+// SetNumThreads - Parse records (ParseNormal mode) with this many threads, in blocks of about blockSize bytes
+// numThreads - 1 (default) parses on the calling thread
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::SetNumThreads(size_t numThreads, size_t blockSize)
+{
+    if (blockSize == 0)
+        RuntimeError("UCIParser::SetNumThreads - block size must not be 0");
+    DiscardBlocks();
+    m_numThreads = std::max(numThreads, (size_t) 1);
+    m_blockSize = blockSize;
+    m_workers.clear();
+    if (m_numThreads > 1)
+    {
+        for (size_t i = 0; i < m_numThreads; i++)
+            m_workers.push_back(std::unique_ptr<UCIParser>(new UCIParser()));
+    }
+}
+
+// DiscardBlocks - wait for and drop all blocks in flight, e.g. when repositioning
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::DiscardBlocks()
+{
+    for (auto& block : m_blocks)
+    {
+        if (block->parsed.valid())
+            block->parsed.wait(); // (the worker refers to the block)
+    }
+    m_blocks.clear();
+    m_blocksLaunched = 0;
+}
+
+// LaunchBlock - read the next block of text and start parsing it on a worker
+// The block is cut after its last newline, so that records never straddle two blocks.
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::LaunchBlock()
+{
+    std::unique_ptr<ParsedBlock> block(new ParsedBlock());
+    block->start = m_readPosition;
+    block->nextRecord = 0;
+
+    int rc = _fseeki64(m_pFile, m_readPosition, SEEK_SET);
+    if (rc)
+        RuntimeError("UCIParser::LaunchBlock - error seeking in file");
+    std::vector<BYTE>& data = block->data;
+    size_t end;
+    for (;;)
+    {
+        size_t have = data.size();
+        size_t bytesToRead = (size_t) min((int64_t) m_blockSize, m_fileSize - m_readPosition - (int64_t) have);
+        data.resize(have + bytesToRead);
+        if (fread(data.data() + have, 1, bytesToRead, m_pFile) != bytesToRead)
+            RuntimeError("UCIParser::LaunchBlock - error reading file");
+        if (m_readPosition + (int64_t) data.size() >= m_fileSize)
+        {
+            end = data.size(); // the last block takes the rest of the file
+            break;
+        }
+        for (end = data.size(); end > have && data[end - 1] != '\n'; end--)
+            ;
+        if (end > have)
+            break;
+        // no newline yet: a record longer than the block size, keep reading
+    }
+    data.resize(end);
+    m_readPosition += end;
+
+    // with at most m_numThreads blocks in flight, the worker of the block m_numThreads back is done with it
+    UCIParser* worker = m_workers[m_blocksLaunched++ % m_numThreads].get();
+    worker->m_startLabels = m_startLabels;
+    worker->m_dimLabels = m_dimLabels;
+    worker->m_startFeatures = m_startFeatures;
+    worker->m_dimFeatures = m_dimFeatures;
+    worker->m_parseMode = ParseNormal;
+    worker->m_traceLevel = 0;
+    ParsedBlock* parsedBlock = block.get();
+    block->parsed = std::async(std::launch::async, [worker, parsedBlock]()
+                               {
+                                   worker->ParseBlock(*parsedBlock);
+                               });
+    m_blocks.push_back(std::move(block));
+}
+
+// ParseBlock - (worker) parse the text of a block into the block's result vectors
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::ParseBlock(ParsedBlock& block)
+{
+    // the state machine reads the block as if it were the whole file, all in one buffer
+    m_fileBuffer = block.data.data();
+    m_bufferSize = block.data.size();
+    m_fileSize = block.start + (int64_t) block.data.size();
+    PrepareStartPosition(block.start);
+    m_block = &block;
+    try
+    {
+        ParseText(SIZE_MAX, &block.numbers, &block.labels);
+    }
+    catch (...)
+    {
+        m_fileBuffer = NULL; // (not ours)
+        m_block = NULL;
+        throw;
+    }
+    m_fileBuffer = NULL;
+    m_block = NULL;
+}
+
+// ParseParallel - Parse() with worker threads
+// Records are returned in file order. Text after the last newline of the file is ignored.
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseParallel(size_t recordsRequested, std::vector<NumType>* numbers, std::vector<LabelType>* labels)
+{
+    assert(numbers != NULL || m_dimFeatures == 0);
+
+    if (m_blocks.empty())
+        m_readPosition = m_byteCounter; // (at the start of a line after SetFilePosition() or a previous Parse())
+    m_bufferStale = true;               // LaunchBlock() reads from the file behind the state machine's back
+
+    long TickStart = GetTickCount();
+    long recordCount = 0;
+    while (recordCount < recordsRequested)
+    {
+        // keep all workers busy
+        while (m_blocks.size() < m_numThreads && m_readPosition < m_fileSize)
+            LaunchBlock();
+        if (m_blocks.empty())
+            break; // end of file
+
+        ParsedBlock& block = *m_blocks.front();
+        if (block.parsed.valid())
+            block.parsed.get(); // wait for it (rethrows errors from the worker)
+
+        size_t numRecords = min(recordsRequested - recordCount, block.recordEnd.size() - block.nextRecord);
+        if (numRecords > 0)
+        {
+            size_t first = block.nextRecord;
+            size_t last = first + numRecords - 1;
+            size_t numbersBegin = (first == 0) ? 0 : block.numbersEnd[first - 1];
+            size_t labelsBegin = (first == 0) ? 0 : block.labelsEnd[first - 1];
+            if (numbers != NULL)
+                numbers->insert(numbers->end(), block.numbers.begin() + numbersBegin, block.numbers.begin() + block.numbersEnd[last]);
+            if (labels != NULL)
+                labels->insert(labels->end(), block.labels.begin() + labelsBegin, block.labels.begin() + block.labelsEnd[last]);
+            block.nextRecord += numRecords;
+            recordCount += (long) numRecords;
+            m_byteCounter = block.recordEnd[last];
+        }
+        if (block.nextRecord == block.recordEnd.size())
+        {
+            m_byteCounter = block.start + (int64_t) block.data.size();
+            m_blocks.pop_front();
+        }
+    }
+
+    long TickStop = GetTickCount();
+
+    if (m_traceLevel > 2)
+        fprintf(stderr, "\n%ld ms, %ld records parsed on %d threads\n\n", TickStop - TickStart, recordCount, (int) m_numThreads);
+    return recordCount;
+}
+
 // Parse - Parse the data
 // recordsRequested - number of records requested
 // numbers - pointer to vector to return the numbers (must be allocated)
@@ -490,6 +710,41 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     assert(numbers != NULL || m_dimFeatures == 0 || m_parseMode == ParseLineCount);
     assert(labels != NULL || m_dimLabels == 0 || m_parseMode == ParseLineCount);
 
+    if (m_cache)
+        return ParseCache(recordsRequested, numbers, labels);
+
+    // the cache records a pass over the whole file from its start
+    if (m_cacheFile == NULL && !m_cachePath.empty() && m_byteCounter == 0 && m_parseMode == ParseNormal)
+        StartCache();
+    else if (m_cacheFile != NULL && m_parseMode != ParseNormal)
+        AbandonCache("records were skipped");
+    if (m_cacheFile != NULL && (numbers == NULL || (labels == NULL && m_dimLabels > 0)))
+        AbandonCache("not all values were requested");
+    size_t numbersBegin = numbers ? numbers->size() : 0;
+    size_t labelsBegin = labels ? labels->size() : 0;
+
+    long recordCount;
+    if (m_parseMode == ParseNormal && m_numThreads > 1)
+        recordCount = ParseParallel(recordsRequested, numbers, labels);
+    else
+        recordCount = ParseText(recordsRequested, numbers, labels);
+
+    if (m_cacheFile != NULL)
+    {
+        WriteCache(numbers, numbersBegin, labels, labelsBegin, recordCount);
+        if (m_cacheFile != NULL && m_byteCounter >= m_fileSize)
+            FinishCache();
+    }
+    return recordCount;
+}
+
+// ParseText - Parse() from the text file, on the calling thread
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseText(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels)
+{
+    if (m_bufferStale) // continue where parallel parsing left off
+        SetFilePosition(m_byteCounter);
+
     // transfer to member variables
     m_numbers = numbers;
     m_labels = labels;
@@ -610,6 +865,12 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
             // intentional fall-through
             case LineCountEOL:
                 recordCount++; // done with another record
+                if (m_block != NULL) // parsing a block for ParseParallel(): remember where the record ends
+                {
+                    m_block->numbersEnd.push_back(m_block->numbers.size());
+                    m_block->labelsEnd.push_back(m_block->labels.size());
+                    m_block->recordEnd.push_back(m_byteCounter + 1);
+                }
                 if (m_traceLevel > 1)
                 {
                     // print progress dots
@@ -733,6 +994,341 @@ void UCIParser<double, std::string>::StoreLastLabel()
     PrepareStartNumber();
 }
 
+// ---------------------------------------------------------------------------
+// binary cache of parsed records
+// Layout: CacheHeader | numRecords x dimFeatures NumType values, one record after the other (page-aligned) |
+//         labels, each as a uint32_t byte count followed by the bytes of the label.
+// ---------------------------------------------------------------------------
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t elemSize;
+    uint64_t sourceHash;
+    uint64_t numRecords;
+    uint64_t dimFeatures;
+    uint64_t dimLabels;
+    uint64_t featuresOffset;
+    uint64_t labelsOffset;
+    uint64_t labelsSize;
+};
+static const char s_cacheMagic[8] = {'U', 'C', 'I', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t s_cacheVersion = 1;
+static const uint64_t s_cacheFeaturesOffset = 4096;
+
+// labels are stored as bytes: strings as such, numbers in binary
+static void SerializeLabel(const std::string& label, FILE* f)
+{
+    uint32_t size = (uint32_t) label.size();
+    fwriteOrDie(&size, sizeof(size), 1, f);
+    fwriteOrDie(label.data(), 1, size, f);
+}
+template <typename LabelType>
+static void SerializeLabel(const LabelType& label, FILE* f)
+{
+    uint32_t size = sizeof(label);
+    fwriteOrDie(&size, sizeof(size), 1, f);
+    fwriteOrDie(&label, sizeof(label), 1, f);
+}
+static void DeserializeLabel(const char* data, uint32_t size, std::string& label)
+{
+    label.assign(data, size);
+}
+template <typename LabelType>
+static void DeserializeLabel(const char* data, uint32_t size, LabelType& label)
+{
+    if (size != sizeof(label))
+        RuntimeError("UCIParser: invalid label in cache");
+    memcpy(&label, data, sizeof(label));
+}
+
+// read-only mapping of a cache file
+template <typename NumType, typename LabelType>
+struct UCIParser<NumType, LabelType>::CacheMapping
+{
+    const char* data;
+    uint64_t size;
+    const CacheHeader* header;
+#ifdef _WIN32
+    HANDLE hFile, hMapping;
+#endif
+
+    CacheMapping(const std::wstring& path)
+        : data(nullptr), size(0), header(nullptr)
+    {
+#ifdef _WIN32
+        hMapping = NULL;
+        hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+            RuntimeError("UCIParser: cannot open cache '%ls', error 0x%x", path.c_str(), GetLastError());
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(hFile, &fileSize))
+            size = fileSize.QuadPart;
+        if (size > 0)
+        {
+            hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (hMapping != NULL)
+                data = (const char*) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (data == nullptr)
+        {
+            DWORD error = GetLastError();
+            Unmap();
+            RuntimeError("UCIParser: cannot map cache '%ls', error 0x%x", path.c_str(), error);
+        }
+#else
+        int fd = open(wtocharpath(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("UCIParser: cannot open cache '%ls': %s", path.c_str(), strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+            size = st.st_size;
+        void* p = (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd); // (the mapping keeps the file referenced)
+        if (p == MAP_FAILED)
+            RuntimeError("UCIParser: cannot map cache '%ls'", path.c_str());
+        data = (const char*) p;
+#endif
+        if (size >= sizeof(CacheHeader))
+            header = (const CacheHeader*) data;
+    }
+    ~CacheMapping()
+    {
+        Unmap();
+    }
+
+private:
+    void Unmap()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (hMapping != NULL)
+            CloseHandle(hMapping);
+        if (hFile != INVALID_HANDLE_VALUE)
+            CloseHandle(hFile);
+#else
+        if (data)
+            munmap((void*) data, size);
+#endif
+        data = nullptr;
+    }
+};
+
+// EnableCache - Cache the parsed records in a binary file in cacheDir
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::EnableCache(const std::wstring& cacheDir)
+{
+    if (m_pFile == NULL)
+        LogicError("UCIParser::EnableCache - ParseInit() must be called first");
+
+    size_t pos = m_fileName.find_last_of(L"/\\");
+    std::wstring baseName = (pos == std::wstring::npos) ? m_fileName : m_fileName.substr(pos + 1);
+    std::wstring cachePath = cacheDir + L"/" + baseName + msra::strfun::wstrprintf(L".%016llx.cache", (unsigned long long) ComputeSourceHash());
+
+    if (fexists(cachePath))
+    {
+        try
+        {
+            if (OpenCache(cachePath))
+                return;
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "UCIParser: cannot use cache %ls, will rewrite it: %s\n", cachePath.c_str(), e.what());
+        }
+    }
+    m_cachePath = cachePath;
+}
+
+// DisableCacheWriting - Do not write a cache
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::DisableCacheWriting()
+{
+    if (m_cacheFile != NULL)
+        AbandonCache("cache writing was disabled");
+    m_cachePath.clear();
+}
+
+// ComputeSourceHash - hash identifying the text file and the way it is parsed
+// Hashing all of a file of many GB would defeat the purpose, so this hashes its size and 16 evenly spaced 64 KB samples.
+template <typename NumType, typename LabelType>
+uint64_t UCIParser<NumType, LabelType>::ComputeSourceHash()
+{
+    uint64_t hash = 14695981039346656037ull; // 64-bit FNV-1a
+    auto add = [&hash](const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ ((const BYTE*) data)[i]) * 1099511628211ull;
+    };
+    uint64_t params[] = {(uint64_t) m_fileSize, m_startFeatures, m_dimFeatures, m_startLabels, m_dimLabels, sizeof(NumType), sizeof(LabelType), s_cacheVersion};
+    add(params, sizeof(params));
+
+    const int numSamples = 16;
+    const int64_t sampleSize = 64 * 1024;
+    std::vector<BYTE> sample(sampleSize);
+    for (int i = 0; i < numSamples; i++)
+    {
+        int64_t offset = std::max(m_fileSize - sampleSize, (int64_t) 0) * i / (numSamples - 1);
+        int rc = _fseeki64(m_pFile, offset, SEEK_SET);
+        if (rc)
+            RuntimeError("UCIParser::EnableCache - error seeking in file");
+        add(sample.data(), fread(sample.data(), 1, sample.size(), m_pFile));
+    }
+    SetFilePosition(m_byteCounter); // (restore the state machine's view of the file)
+    return hash;
+}
+
+// OpenCache - map an existing cache and parse from it from now on
+// returns - false if it does not match the file
+template <typename NumType, typename LabelType>
+bool UCIParser<NumType, LabelType>::OpenCache(const std::wstring& cachePath)
+{
+    std::unique_ptr<CacheMapping> cache(new CacheMapping(cachePath));
+    const CacheHeader* header = cache->header;
+    if (header == nullptr || memcmp(header->magic, s_cacheMagic, sizeof(s_cacheMagic)) != 0 || header->version != s_cacheVersion)
+        RuntimeError("not a cache file of this version");
+    if (header->elemSize != sizeof(NumType) || header->dimFeatures != m_dimFeatures || header->dimLabels != m_dimLabels)
+        return false;
+    if (header->featuresOffset + header->numRecords * header->dimFeatures * sizeof(NumType) > header->labelsOffset || header->labelsOffset + header->labelsSize > cache->size)
+        RuntimeError("cache file is truncated");
+
+    fprintf(stderr, "UCIParser: reading %llu records from cache %ls\n", (unsigned long long) header->numRecords, cachePath.c_str());
+    DiscardBlocks();
+    m_cache = std::move(cache);
+    SetFilePosition(0);
+    return true;
+}
+
+// ParseCache - Parse() from the binary cache
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseCache(size_t recordsRequested, std::vector<NumType>* numbers, std::vector<LabelType>* labels)
+{
+    const CacheHeader& header = *m_cache->header;
+    size_t recordCount = (size_t) min((uint64_t) recordsRequested, header.numRecords - m_cacheRecords);
+    if (m_parseMode == ParseNormal && numbers != NULL)
+    {
+        const NumType* features = (const NumType*) (m_cache->data + header.featuresOffset) + m_cacheRecords * m_dimFeatures;
+        numbers->insert(numbers->end(), features, features + recordCount * m_dimFeatures);
+    }
+
+    // labels have variable size, so walk over them
+    const char* labelData = m_cache->data + header.labelsOffset;
+    size_t numLabels = recordCount * m_dimLabels;
+    for (size_t i = 0; i < numLabels; i++)
+    {
+        uint32_t size;
+        if (m_cacheLabelPosition + sizeof(size) > header.labelsSize)
+            RuntimeError("UCIParser: label section of cache is truncated");
+        memcpy(&size, labelData + m_cacheLabelPosition, sizeof(size));
+        m_cacheLabelPosition += sizeof(size);
+        if (m_cacheLabelPosition + size > header.labelsSize)
+            RuntimeError("UCIParser: label section of cache is truncated");
+        if (m_parseMode == ParseNormal && labels != NULL)
+        {
+            LabelType label;
+            DeserializeLabel(labelData + m_cacheLabelPosition, size, label);
+            labels->push_back(std::move(label));
+        }
+        m_cacheLabelPosition += size;
+    }
+    m_cacheRecords += recordCount;
+    return (long) recordCount;
+}
+
+// StartCache - start recording a pass over the file into a (temporary) cache file
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::StartCache()
+{
+    msra::files::make_intermediate_dirs(m_cachePath);
+    m_cacheFile = fopenOrDie(m_cachePath + L".tmp", L"wb");
+    m_cacheLabelsFile = fopenOrDie(m_cachePath + L".labels.tmp", L"w+b");
+    fsetpos(m_cacheFile, s_cacheFeaturesOffset); // header is written when complete
+    m_cacheRecords = 0;
+    if (m_traceLevel > 0)
+        fprintf(stderr, "UCIParser: writing cache %ls while parsing\n", m_cachePath.c_str());
+}
+
+// WriteCache - append the records just parsed to the cache being written
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::WriteCache(const std::vector<NumType>* numbers, size_t numbersBegin, const std::vector<LabelType>* labels, size_t labelsBegin, long recordCount)
+{
+    // the cache has a fixed number of values per record; at the end of the file, Parse() may have left values of an unterminated last line
+    size_t numNumbers = recordCount * m_dimFeatures;
+    size_t numLabels = recordCount * m_dimLabels;
+    size_t numbersAdded = numbers->size() - numbersBegin;
+    size_t labelsAdded = labels ? labels->size() - labelsBegin : 0;
+    bool atEnd = m_byteCounter >= m_fileSize;
+    if (numbersAdded < numNumbers || labelsAdded < numLabels || (!atEnd && (numbersAdded != numNumbers || labelsAdded != numLabels)))
+    {
+        AbandonCache("records do not all have the configured number of values");
+        return;
+    }
+    if (numNumbers > 0)
+        fwriteOrDie(numbers->data() + numbersBegin, sizeof(NumType), numNumbers, m_cacheFile);
+    for (size_t i = 0; i < numLabels; i++)
+        SerializeLabel((*labels)[labelsBegin + i], m_cacheLabelsFile);
+    m_cacheRecords += recordCount;
+}
+
+// FinishCache - complete the cache after the end of the file was reached
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::FinishCache()
+{
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_cacheMagic, sizeof(s_cacheMagic));
+    header.version = s_cacheVersion;
+    header.elemSize = sizeof(NumType);
+    header.sourceHash = 0; // (encoded in the file name)
+    header.numRecords = m_cacheRecords;
+    header.dimFeatures = m_dimFeatures;
+    header.dimLabels = m_dimLabels;
+    header.featuresOffset = s_cacheFeaturesOffset;
+    header.labelsOffset = s_cacheFeaturesOffset + m_cacheRecords * m_dimFeatures * sizeof(NumType);
+    header.labelsSize = fgetpos(m_cacheLabelsFile);
+
+    // append the labels
+    fsetpos(m_cacheLabelsFile, (uint64_t) 0);
+    std::vector<char> buffer(1024 * 1024);
+    for (uint64_t copied = 0; copied < header.labelsSize;)
+    {
+        size_t n = (size_t) min((uint64_t) buffer.size(), header.labelsSize - copied);
+        freadOrDie(buffer.data(), 1, n, m_cacheLabelsFile);
+        fwriteOrDie(buffer.data(), 1, n, m_cacheFile);
+        copied += n;
+    }
+    fsetpos(m_cacheFile, (uint64_t) 0);
+    fwriteOrDie(&header, sizeof(header), 1, m_cacheFile);
+    fflushOrDie(m_cacheFile);
+    fcloseOrDie(m_cacheFile);
+    fcloseOrDie(m_cacheLabelsFile);
+    m_cacheFile = NULL;
+    m_cacheLabelsFile = NULL;
+    unlinkOrDie(m_cachePath + L".labels.tmp");
+    renameOrDie(m_cachePath + L".tmp", m_cachePath); // so that a reader never sees a partial cache
+    fprintf(stderr, "UCIParser: wrote %llu records to cache %ls\n", (unsigned long long) m_cacheRecords, m_cachePath.c_str());
+    m_cachePath.clear();
+}
+
+// AbandonCache - stop and delete the cache being written; it will be written by a later run
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::AbandonCache(const char* reason)
+{
+    if (m_cacheFile != NULL)
+    {
+        fclose(m_cacheFile);
+        fclose(m_cacheLabelsFile);
+        m_cacheFile = NULL;
+        m_cacheLabelsFile = NULL;
+        _wunlink((m_cachePath + L".tmp").c_str());
+        _wunlink((m_cachePath + L".labels.tmp").c_str());
+        fprintf(stderr, "UCIParser: not writing cache %ls because %s\n", m_cachePath.c_str(), reason);
+    }
+    m_cachePath.clear();
+}
+
 #ifdef STANDALONE
 int wmain(int argc, wchar_t *argv[])
 {
@@ -11,6 +11,9 @@
 #include <assert.h>
 #include <stdint.h>
 #include <algorithm>
+#include <deque>
+#include <future>
+#include <memory>
 
 #ifdef min
 #undef min
@@ -109,6 +112,40 @@ private:
     std::vector<LabelType> *m_labels; // pointer to vector to append with labels (may be numeric)
     // FUTURE: do we want a vector to collect string labels in the non string label case? (signifies an error)
 
+    // parallel parsing (SetNumThreads()): the file is read in newline-aligned blocks, which worker parsers parse
+    // concurrently; the results are handed out in file order, the records of a block not requested yet on the next call
+    struct ParsedBlock
+    {
+        std::vector<BYTE> data;         // text of the block
+        int64_t start;                  // file position of data[0]
+        std::vector<NumType> numbers;   // results
+        std::vector<LabelType> labels;  // ...
+        std::vector<size_t> numbersEnd; // [record] end of the record's numbers in 'numbers'
+        std::vector<size_t> labelsEnd;  // [record] end of the record's labels in 'labels'
+        std::vector<int64_t> recordEnd; // [record] file position after the record
+        size_t nextRecord;              // first record not handed out yet
+        std::future<void> parsed;
+    };
+    size_t m_numThreads;
+    size_t m_blockSize;                                // bytes of text per block
+    std::vector<std::unique_ptr<UCIParser>> m_workers; // [i] parses every m_numThreads-th block
+    std::deque<std::unique_ptr<ParsedBlock>> m_blocks; // blocks in flight, in file order
+    size_t m_blocksLaunched;
+    int64_t m_readPosition; // file position where the next block starts
+    bool m_bufferStale;     // m_fileBuffer does not hold the text at m_byteCounter
+    ParsedBlock *m_block;   // (worker) block being parsed, to record where records end
+
+    // binary cache of the parsed records (EnableCache()): written during the first sequential pass over the whole file,
+    // and memory-mapped and read instead of the text file once it exists; file positions are then record indices
+    struct CacheMapping;
+    std::wstring m_fileName;
+    std::unique_ptr<CacheMapping> m_cache; // cache being read, if any
+    std::wstring m_cachePath;              // cache to write if not being read (empty: none)
+    FILE *m_cacheFile;                     // cache being written (NULL if not recording)
+    FILE *m_cacheLabelsFile;               // ...and its labels, appended to it when complete
+    uint64_t m_cacheRecords;               // records written so far, or next record to read
+    uint64_t m_cacheLabelPosition;         // (reading) offset of the next record's labels in the label section
+
     // SetState for a particular value
     void SetState(int value, ParseState m_current_state, ParseState next_state);
 
@@ -132,6 +169,35 @@ private:
     // returns - number of records read
     size_t UpdateBuffer();
 
+    // ParseParallel - Parse() with worker threads
+    long ParseParallel(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels);
+
+    // LaunchBlock - read the next block of text and start parsing it on a worker
+    void LaunchBlock();
+
+    // ParseBlock - (worker) parse the text of a block into the block's result vectors
+    void ParseBlock(ParsedBlock &block);
+
+    // DiscardBlocks - wait for and drop all blocks in flight, e.g. when repositioning
+    void DiscardBlocks();
+
+    // CloseFile - close the open file and free the read buffer
+    void CloseFile();
+
+    // ParseText - Parse() from the text file, on the calling thread
+    long ParseText(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels);
+
+    // ParseCache - Parse() from the binary cache
+    long ParseCache(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels);
+
+    // cache support, see EnableCache()
+    uint64_t ComputeSourceHash();
+    bool OpenCache(const std::wstring &cachePath);
+    void StartCache();
+    void WriteCache(const std::vector<NumType> *numbers, size_t numbersBegin, const std::vector<LabelType> *labels, size_t labelsBegin, long recordCount);
+    void FinishCache();
+    void AbandonCache(const char *reason);
+
 public:
     // UCIParser constructor
     UCIParser();
@@ -164,6 +230,10 @@ public:
     // traceLevel - traceLevel, zero means no output, 1 epoch related output, > 1 all output
     void SetTraceLevel(int traceLevel);
 
+    // SetNumThreads - Parse records (ParseNormal mode) with this many threads, in blocks of about blockSize bytes
+    // numThreads - 1 (default) parses on the calling thread
+    void SetNumThreads(size_t numThreads, size_t blockSize = 8 * 1024 * 1024);
+
     // ParseInit - Initialize a parse of a file
     // fileName - path to the file to open
     // startFeatures - column (zero based) where features start
@@ -184,6 +254,15 @@ public:
     int64_t GetFilePosition();
     void SetFilePosition(int64_t position);
 
+    // EnableCache - Cache the parsed records in a binary file in cacheDir, named after a hash of the text file's
+    // size, samples of its content, and the parse parameters. If the cache exists, it is memory-mapped and all
+    // further parsing comes from it; otherwise it is written during the first pass over the whole file from its
+    // start in ParseNormal mode, and abandoned if that pass is interrupted by repositioning. Call after ParseInit().
+    void EnableCache(const std::wstring &cacheDir);
+
+    // DisableCacheWriting - Do not write a cache (e.g. leave that to one of several processes reading the file)
+    void DisableCacheWriting();
+
     // HasMoreData - test if the current dataset have more data
     // returns - true if it does, false if not
     bool HasMoreData();
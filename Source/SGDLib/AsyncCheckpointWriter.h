@@ -0,0 +1,156 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncCheckpointWriter.h -- moves model and checkpoint files to their final location in a background thread
+//
+// Writing a large model plus the optimizer state to a network file system stalls training (and, in parallel training,
+// all other ranks waiting at the next collective). Instead, SGD serializes the files into a staging directory, preferably
+// in host memory (e.g. /dev/shm), and hands them to this class, which copies them to their final path in a background
+// thread and renames them into place when complete, so that a reader never sees a partial file.
+// Obsolete files can be removed through the same queue, so that they disappear only after their successors are in place.
+// Jobs are processed in order; Wait() blocks until all are done and rethrows any error from the background thread.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class AsyncCheckpointWriter
+{
+public:
+    AsyncCheckpointWriter(const std::wstring& stagingDir)
+        : m_stagingDir(stagingDir), m_busy(false), m_stop(false)
+    {
+        if (m_stagingDir.empty())
+            InvalidArgument("AsyncCheckpointWriter: staging directory must not be empty.");
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    ~AsyncCheckpointWriter()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        m_thread.join();
+    }
+
+    // where to write a file that is meant to end up at 'finalPath'
+    std::wstring StagingPath(const std::wstring& finalPath) const
+    {
+        size_t pos = finalPath.find_last_of(L"/\\");
+        std::wstring fileName = (pos == std::wstring::npos) ? finalPath : finalPath.substr(pos + 1);
+        std::wstring stagingPath = m_stagingDir + L"/" + fileName;
+        msra::files::make_intermediate_dirs(stagingPath);
+        return stagingPath;
+    }
+
+    // move a file written to StagingPath(finalPath) to 'finalPath' in the background
+    void Commit(const std::wstring& stagingPath, const std::wstring& finalPath)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::make_pair(stagingPath, finalPath));
+        }
+        m_wakeUp.notify_all();
+    }
+
+    // delete a file in the background, after all files committed before are in place
+    void Remove(const std::wstring& path)
+    {
+        Commit(std::wstring(), path);
+    }
+
+    // block until all committed files are in place
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_jobs.empty() && !m_busy; });
+        if (m_error)
+        {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wakeUp.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) // m_stop
+                return;
+            auto job = m_jobs.front();
+            m_jobs.pop_front();
+            m_busy = true;
+            lock.unlock();
+
+            std::exception_ptr error;
+            try
+            {
+                if (job.first.empty())
+                    _wunlink(job.second.c_str()); // Remove(); may not exist, e.g. the checkpoint before the first one
+                else
+                    Move(job.first, job.second);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            m_busy = false;
+            if (error && !m_error)
+                m_error = error;
+            m_done.notify_all();
+        }
+    }
+
+    // copy to a temporary next to the final file, then rename, as in ComputationNetwork::Save()
+    static void Move(const std::wstring& stagingPath, const std::wstring& finalPath)
+    {
+        std::wstring tmpPath = finalPath + L".tmp";
+        msra::files::make_intermediate_dirs(finalPath);
+        {
+            FILE* in = fopenOrDie(stagingPath, L"rb");
+            FILE* out = fopenOrDie(tmpPath, L"wb");
+            std::vector<char> buffer(16 * 1024 * 1024);
+            size_t n;
+            while ((n = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+                fwriteOrDie(buffer.data(), 1, n, out);
+            if (ferror(in))
+                RuntimeError("AsyncCheckpointWriter: error reading '%ls'.", stagingPath.c_str());
+            fflushOrDie(out);
+            fcloseOrDie(out);
+            fcloseOrDie(in);
+        }
+        renameOrDie(tmpPath, finalPath);
+        unlinkOrDie(stagingPath);
+    }
+
+    std::wstring m_stagingDir;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp; // new job or stop
+    std::condition_variable m_done;   // job finished
+    std::deque<std::pair<std::wstring, std::wstring>> m_jobs;
+    bool m_busy;
+    bool m_stop;
+    std::exception_ptr m_error;
+};
+} } }
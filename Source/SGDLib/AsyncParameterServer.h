@@ -0,0 +1,309 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncParameterServer.h -- asynchronous parameter-server training with bounded staleness
+//
+// The main node keeps a master copy of the model in CPU memory, which a background thread serves to all workers
+// (including the main node itself). Every 'syncPeriod' minibatches, a worker pushes the change of its local model
+// since the last model it received (a weight delta) to the server, without waiting. The server adds the delta to the
+// master model and sends the updated master model back. When it arrives, the worker continues from the master model
+// plus whatever it has learned locally in the meantime, and pushes again when due. A worker only blocks if the reply
+// is not there after 'maxStaleness' minibatches, so slow nodes delay only themselves instead of every allreduce.
+//
+// The deltas of all workers are summed, as in Downpour SGD; the learning rate should be chosen accordingly.
+// At the end of an epoch, all workers push their remaining changes and pull the final master model, so that they all
+// end the epoch with identical parameters.
+//
+// MPI is initialized with MPI_THREAD_SERIALIZED, so all MPI calls made by the server thread and the training thread
+// go through one mutex, and only non-blocking calls are made while holding it.
+//
+
+#pragma once
+
+#include "MPIWrapper.h"
+#include "FlatParameterCopy.h"
+#include "TimerUtility.h"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class AsyncParameterServer
+{
+public:
+    // syncPeriod: minibatches between pushes; maxStaleness: minibatches a worker may run ahead of its pending pull
+    AsyncParameterServer(MPIWrapper* mpi, size_t syncPeriod, size_t maxStaleness, int syncStatsTrace)
+        : m_mpi(mpi), m_syncPeriod(syncPeriod), m_maxStaleness(maxStaleness), m_syncStatsTrace(syncStatsTrace), m_numElements(0),
+          m_pushRequest(MPI_REQUEST_NULL), m_pullRequest(MPI_REQUEST_NULL), m_pullPending(false), m_numMBsSincePush(0),
+          m_numPushes(0), m_secondsWaiting(0), m_stopServer(false)
+    {
+        if (m_syncPeriod == 0)
+            InvalidArgument("AsyncParameterServer: syncPeriod must be at least 1.");
+    }
+
+    ~AsyncParameterServer()
+    {
+        if (m_serverThread.joinable())
+        {
+            m_stopServer = true;
+            m_serverThread.join();
+        }
+    }
+
+    // Called by all workers at the start of each epoch: start from the main node's model, and start serving it.
+    void BeginEpoch(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        if (m_numElements == 0)
+            Allocate(learnableNodes);
+
+        FlatParameterCopy::Get(learnableNodes, m_reference);
+        m_mpi->Bcast(m_reference.data(), m_numElements, m_mpi->MainNodeRank());
+        FlatParameterCopy::Set(learnableNodes, m_reference);
+
+        m_pullPending = false;
+        m_numMBsSincePush = 0;
+
+        if (m_mpi->IsMainNode())
+        {
+            m_master = m_reference;
+            for (size_t worker = 0; worker < m_serverPushBuffers.size(); worker++)
+                PostServerReceive(worker);
+            m_stopServer = false;
+            m_serverThread = std::thread([this]() { ServerLoop(); });
+        }
+    }
+
+    // Called by all workers after each minibatch's model update.
+    void Sync(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        m_numMBsSincePush++;
+
+        // take the fresh model if it has arrived, or wait for it if we would otherwise run too far ahead
+        if (m_pullPending && (m_numMBsSincePush >= m_maxStaleness || TestPull()))
+            CompletePull(learnableNodes);
+
+        if (!m_pullPending && m_numMBsSincePush >= m_syncPeriod)
+        {
+            Push(learnableNodes);
+            if (m_maxStaleness == 0)
+                CompletePull(learnableNodes);
+        }
+    }
+
+    // Called by all workers at the end of each epoch. On return, all workers have the same, complete model.
+    void EndEpoch(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        // push what is left, and wait until everybody has done that
+        if (m_pullPending)
+            CompletePull(learnableNodes);
+        Push(learnableNodes);
+        CompletePull(learnableNodes);
+        Barrier();
+
+        // now the master model is final; pull it (pushing an all-zero delta)
+        Push(learnableNodes);
+        CompletePull(learnableNodes);
+        Barrier(); // (after this, the server has no more requests to serve)
+
+        if (m_mpi->IsMainNode())
+        {
+            m_stopServer = true;
+            m_serverThread.join();
+            // the server thread has stopped, so MPI can be called directly again
+            for (size_t worker = 0; worker < m_serverPushBuffers.size(); worker++)
+            {
+                MPI_Cancel(&m_serverPushRequests[worker]) || MpiFail("AsyncParameterServer: MPI_Cancel");
+                MPI_Wait(&m_serverPushRequests[worker], MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Wait");
+                MPI_Wait(&m_serverReplyRequests[worker], MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Wait");
+            }
+        }
+        MPI_Wait(&m_pushRequest, MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Wait");
+    }
+
+private:
+    static const int pushTag = 32765;
+    static const int pullTag = 32766;
+
+    void Allocate(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        m_numElements = FlatParameterCopy::GetNumElements<ElemType>(learnableNodes);
+        if (m_numElements > INT_MAX)
+            RuntimeError("AsyncParameterServer: models with more than %d parameters are not supported.", INT_MAX);
+
+        m_reference.resize(m_numElements);
+        m_current.resize(m_numElements);
+        m_pushBuffer.resize(m_numElements);
+        m_pullBuffer.resize(m_numElements);
+
+        if (m_mpi->IsMainNode())
+        {
+            size_t numWorkers = m_mpi->NumNodesInUse();
+            m_serverPushBuffers.assign(numWorkers, std::vector<ElemType>(m_numElements));
+            m_serverReplyBuffers.assign(numWorkers, std::vector<ElemType>(m_numElements));
+            m_serverPushRequests.assign(numWorkers, MPI_REQUEST_NULL);
+            m_serverReplyRequests.assign(numWorkers, MPI_REQUEST_NULL);
+        }
+    }
+
+    // send the change since the last received model, and post the receive for the reply
+    void Push(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        assert(!m_pullPending);
+        FlatParameterCopy::Get(learnableNodes, m_current);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mpiMutex);
+            MPI_Wait(&m_pushRequest, MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Wait"); // (the server has received it already)
+        }
+#pragma omp parallel for
+        for (long i = 0; i < (long) m_numElements; i++)
+            m_pushBuffer[i] = m_current[i] - m_reference[i];
+        m_reference.swap(m_current);
+
+        int server = (int) m_mpi->MainNodeRank();
+        std::lock_guard<std::mutex> lock(m_mpiMutex);
+        MPI_Irecv(m_pullBuffer.data(), (int) m_numElements, MPIWrapper::GetDataType(m_pullBuffer.data()), server, pullTag, m_mpi->Communicator(), &m_pullRequest) || MpiFail("AsyncParameterServer: MPI_Irecv");
+        MPI_Isend(m_pushBuffer.data(), (int) m_numElements, MPIWrapper::GetDataType(m_pushBuffer.data()), server, pushTag, m_mpi->Communicator(), &m_pushRequest) || MpiFail("AsyncParameterServer: MPI_Isend");
+
+        m_pullPending = true;
+        m_numMBsSincePush = 0;
+        m_numPushes++;
+    }
+
+    bool TestPull()
+    {
+        std::lock_guard<std::mutex> lock(m_mpiMutex);
+        int flag = 0;
+        MPI_Test(&m_pullRequest, &flag, MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Test");
+        return flag != 0;
+    }
+
+    // wait for the reply to the last push, and continue from it plus the local changes made since the push
+    void CompletePull(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        assert(m_pullPending);
+        Timer waitTimer;
+        waitTimer.Start();
+        while (!TestPull()) // (not MPI_Wait, which would block the server thread on the main node)
+            std::this_thread::yield();
+        waitTimer.Stop();
+        m_secondsWaiting += waitTimer.ElapsedSeconds();
+
+        FlatParameterCopy::Get(learnableNodes, m_current);
+#pragma omp parallel for
+        for (long i = 0; i < (long) m_numElements; i++)
+            m_current[i] = m_pullBuffer[i] + (m_current[i] - m_reference[i]);
+        FlatParameterCopy::Set(learnableNodes, m_current);
+        m_reference.swap(m_pullBuffer);
+        m_pullPending = false;
+
+        if (m_syncStatsTrace > 0 && m_numPushes % m_syncStatsTrace == 0)
+        {
+            fprintf(stderr, "\t\t-----(parameter server stats) %d-th push, %5.2f seconds waiting for the server\n", (int) m_numPushes, m_secondsWaiting);
+            m_secondsWaiting = 0;
+        }
+    }
+
+    void Barrier()
+    {
+        MPI_Request request;
+        {
+            std::lock_guard<std::mutex> lock(m_mpiMutex);
+            MPI_Ibarrier(m_mpi->Communicator(), &request) || MpiFail("AsyncParameterServer: MPI_Ibarrier");
+        }
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mpiMutex);
+                int flag = 0;
+                MPI_Test(&request, &flag, MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Test");
+                if (flag)
+                    break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // main node only: receive the next push of 'worker'
+    void PostServerReceive(size_t worker)
+    {
+        std::vector<ElemType>& buffer = m_serverPushBuffers[worker];
+        MPI_Irecv(buffer.data(), (int) m_numElements, MPIWrapper::GetDataType(buffer.data()), (int) worker, pushTag, m_mpi->Communicator(), &m_serverPushRequests[worker]) || MpiFail("AsyncParameterServer: MPI_Irecv");
+    }
+
+    // main node only: apply the workers' deltas in the order they arrive, and answer each with the current master model
+    void ServerLoop()
+    {
+        while (!m_stopServer)
+        {
+            bool idle = true;
+            for (size_t worker = 0; worker < m_serverPushBuffers.size(); worker++)
+            {
+                int flag = 0;
+                {
+                    std::lock_guard<std::mutex> lock(m_mpiMutex);
+                    MPI_Test(&m_serverPushRequests[worker], &flag, MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Test");
+                }
+                if (!flag)
+                    continue;
+                idle = false;
+
+                // (the worker has received our previous reply before it pushed again, so its buffer is free)
+                const std::vector<ElemType>& delta = m_serverPushBuffers[worker];
+                std::vector<ElemType>& reply = m_serverReplyBuffers[worker];
+#pragma omp parallel for
+                for (long i = 0; i < (long) m_numElements; i++)
+                {
+                    m_master[i] += delta[i];
+                    reply[i] = m_master[i];
+                }
+
+                std::lock_guard<std::mutex> lock(m_mpiMutex);
+                MPI_Wait(&m_serverReplyRequests[worker], MPI_STATUS_IGNORE) || MpiFail("AsyncParameterServer: MPI_Wait");
+                MPI_Isend(reply.data(), (int) m_numElements, MPIWrapper::GetDataType(reply.data()), (int) worker, pullTag, m_mpi->Communicator(), &m_serverReplyRequests[worker]) || MpiFail("AsyncParameterServer: MPI_Isend");
+                PostServerReceive(worker);
+            }
+            if (idle)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    MPIWrapper* m_mpi;
+    size_t m_syncPeriod;
+    size_t m_maxStaleness;
+    int m_syncStatsTrace;
+    size_t m_numElements; // total number of learnable parameters
+
+    // MPI must not be called concurrently by the training thread and the server thread
+    std::mutex m_mpiMutex;
+
+    // worker state
+    std::vector<ElemType> m_reference;  // the last model received from the server (plus what has been pushed since)
+    std::vector<ElemType> m_current;    // scratch copy of the local model
+    std::vector<ElemType> m_pushBuffer; // delta in flight to the server
+    std::vector<ElemType> m_pullBuffer; // master model in flight from the server
+    MPI_Request m_pushRequest;
+    MPI_Request m_pullRequest;
+    bool m_pullPending;
+    size_t m_numMBsSincePush;
+
+    size_t m_numPushes;
+    double m_secondsWaiting;
+
+    // server state (main node only)
+    std::vector<ElemType> m_master;
+    std::vector<std::vector<ElemType>> m_serverPushBuffers;  // [worker]
+    std::vector<std::vector<ElemType>> m_serverReplyBuffers; // [worker]
+    std::vector<MPI_Request> m_serverPushRequests;
+    std::vector<MPI_Request> m_serverReplyRequests;
+    std::thread m_serverThread;
+    std::atomic<bool> m_stopServer;
+};
+} } }
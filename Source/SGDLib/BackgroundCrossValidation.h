@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BackgroundCrossValidation.h -- cross-validation on a device of its own, while training goes on (SGD's 'cvDeviceId')
+//
+// After each epoch, the model is saved to a temporary file, and a background thread loads its parameters into a
+// network on the CV device and evaluates the validation set there; meanwhile the next epoch is trained. The jobs run
+// one after the other, in the order of the epochs. Learning-rate control uses the latest CV result that is available:
+// at the end of epoch i, SGD waits for the result of epoch i - maxDelay at most (cvMaxDelay, default 1), so that the
+// decisions lag by at most that many epochs. Results are logged as they are collected, with the epoch they belong to.
+//
+// The CV network is the model file's, so that it evaluates what is saved; its reader is the validation reader, which
+// only the background thread uses.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReader.h"
+#include "SimpleEvaluator.h"
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class BackgroundCrossValidation
+{
+public:
+    BackgroundCrossValidation(DEVICEID_TYPE deviceId, size_t maxDelay, const std::wstring& tempModelPath)
+        : m_deviceId(deviceId), m_maxDelay(maxDelay), m_tempModelPath(tempModelPath)
+    {
+        if (deviceId >= 0)
+            AllowAdditionalGPU(deviceId); // (exempt from EnforceOneGPUOnly())
+    }
+
+    ~BackgroundCrossValidation()
+    {
+        for (auto& job : m_jobs) // (results no longer wanted, but the threads must not outlive the reader)
+            job.m_scores.wait();
+    }
+
+    size_t GetMaxDelay() const
+    {
+        return m_maxDelay;
+    }
+
+    // snapshot the network after 'epoch' (0-based) and queue its evaluation
+    void Start(ComputationNetworkPtr net, size_t epoch, IDataReader<ElemType>* validationSetDataReader,
+               const std::vector<std::wstring>& evalNodeNames, size_t mbSize)
+    {
+        std::wstring modelPath = m_tempModelPath + msra::strfun::wstrprintf(L".%d", (int) epoch);
+        net->Save(modelPath);
+
+        std::shared_future<std::vector<double>> previous;
+        if (!m_jobs.empty())
+            previous = m_jobs.back().m_scores;
+        DEVICEID_TYPE deviceId = m_deviceId;
+        ComputationNetworkPtr* cvNet = &m_net; // (only ever touched by the jobs, one at a time)
+        Job job;
+        job.m_epoch = epoch;
+        job.m_scores = std::async(std::launch::async, [=]()
+                                  {
+                                      if (previous.valid())
+                                          previous.wait();
+                                      if (!*cvNet)
+                                          *cvNet = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+                                      else
+                                          (*cvNet)->RereadPersistableParameters<ElemType>(modelPath);
+                                      _wunlink(modelPath.c_str());
+                                      SimpleEvaluator<ElemType> evaluator(*cvNet, 100, 0, nullptr);
+                                      return evaluator.Evaluate(validationSetDataReader, evalNodeNames, mbSize);
+                                  }).share();
+        m_jobs.push_back(job);
+    }
+
+    // Collect the results that are ready, waiting for those up to epoch 'currentEpoch' - maxDelay, or for all
+    // ('waitForAll'). Returns them as (epoch, scores), in the order of the epochs. Rethrows a failed job's exception.
+    std::vector<std::pair<size_t, std::vector<double>>> Collect(size_t currentEpoch, bool waitForAll)
+    {
+        std::vector<std::pair<size_t, std::vector<double>>> results;
+        while (!m_jobs.empty())
+        {
+            Job& job = m_jobs.front();
+            bool mustWait = waitForAll || job.m_epoch + m_maxDelay <= currentEpoch;
+            if (!mustWait && job.m_scores.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                break;
+            results.push_back(std::make_pair(job.m_epoch, job.m_scores.get()));
+            m_jobs.pop_front();
+        }
+        return results;
+    }
+
+private:
+    struct Job
+    {
+        size_t m_epoch;
+        std::shared_future<std::vector<double>> m_scores;
+    };
+
+    DEVICEID_TYPE m_deviceId;
+    size_t m_maxDelay;
+    std::wstring m_tempModelPath;
+    ComputationNetworkPtr m_net; // on m_deviceId, created by the first job
+    std::deque<Job> m_jobs;      // in the order of the epochs
+};
+} } }
@@ -0,0 +1,158 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CachingDataReader.h -- replay the minibatches of a pass over the start of an epoch from memory
+//
+// The learning-rate search trains several times on the same first samples of an epoch with the same minibatch size.
+// This reader passes the first such pass through from the reader it wraps and keeps copies (in CPU RAM) of the input
+// matrices and layouts; later passes with the same epoch, minibatch size and number of samples replay them instead of
+// reading the data again. Readers that rely on the two-forward-pass interface (GetMinibatchCopy()) are never cached.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Sequences.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class CachingDataReader : public IDataReader<ElemType>
+{
+    struct Minibatch
+    {
+        std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> inputs;
+        MBLayoutPtr layout;
+    };
+
+public:
+    CachingDataReader(IDataReader<ElemType>& reader)
+        : m_reader(reader), m_mbSize(0), m_epoch(SIZE_MAX), m_requestedEpochSamples(0), m_complete(false), m_replaying(false), m_uncacheable(false), m_next(0)
+    {
+    }
+
+    virtual void Init(const ConfigParameters&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Destroy() override
+    {
+    }
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        m_next = 0;
+        m_replaying = !m_uncacheable && m_complete && mbSize == m_mbSize && epoch == m_epoch && requestedEpochSamples == m_requestedEpochSamples;
+        if (m_replaying)
+            return;
+
+        // a different pass: read it from the wrapped reader, and record it
+        m_minibatches.clear();
+        m_complete = false;
+        m_mbSize = mbSize;
+        m_epoch = epoch;
+        m_requestedEpochSamples = requestedEpochSamples;
+        m_reader.StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+    }
+
+    virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) override
+    {
+        if (m_replaying)
+        {
+            if (m_next >= m_minibatches.size())
+                return false;
+            const Minibatch& minibatch = m_minibatches[m_next++];
+            for (auto& iter : matrices)
+            {
+                auto input = minibatch.inputs.find(iter.first);
+                if (input == minibatch.inputs.end())
+                    LogicError("CachingDataReader: Input '%ls' was not read in the recorded pass.", iter.first.c_str());
+                iter.second->SetValue(*input->second);
+            }
+            return true;
+        }
+
+        if (!m_reader.GetMinibatch(matrices))
+        {
+            m_complete = !m_uncacheable;
+            return false;
+        }
+        if (!m_uncacheable)
+        {
+            Minibatch minibatch;
+            for (const auto& iter : matrices)
+                minibatch.inputs[iter.first] = std::make_shared<Matrix<ElemType>>(*iter.second, CPUDEVICE);
+            minibatch.layout = make_shared<MBLayout>();
+            m_reader.CopyMBLayoutTo(minibatch.layout);
+            m_minibatches.push_back(std::move(minibatch));
+        }
+        return true;
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        if (m_replaying)
+            pMBLayout->CopyFrom(m_minibatches[m_next - 1].layout);
+        else
+            m_reader.CopyMBLayoutTo(pMBLayout);
+    }
+
+    virtual size_t GetNumParallelSequences() override
+    {
+        return m_reader.GetNumParallelSequences();
+    }
+    virtual bool RequireSentenceSeg() const override
+    {
+        return m_reader.RequireSentenceSeg();
+    }
+    virtual bool DataEnd(EndDataType endDataType) override
+    {
+        return m_replaying ? false : m_reader.DataEnd(endDataType);
+    }
+
+    // the two-forward-pass interface makes the minibatches depend on the model, so they cannot be replayed
+    virtual bool GetMinibatchCopy(std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                                  std::map<std::wstring, Matrix<ElemType>*>& matrices,
+                                  MBLayoutPtr pMBLayout) override
+    {
+        if (m_replaying)
+            return false;
+        bool copied = m_reader.GetMinibatchCopy(uttInfo, matrices, pMBLayout);
+        if (copied)
+        {
+            m_uncacheable = true;
+            m_minibatches.clear();
+        }
+        return copied;
+    }
+    virtual bool SetNetOutput(const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                              const Matrix<ElemType>& outputs,
+                              const MBLayoutPtr pMBLayout) override
+    {
+        return m_replaying ? false : m_reader.SetNetOutput(uttInfo, outputs, pMBLayout);
+    }
+
+private:
+    IDataReader<ElemType>& m_reader;
+
+    // the recorded pass
+    size_t m_mbSize;
+    size_t m_epoch;
+    size_t m_requestedEpochSamples;
+    std::vector<Minibatch> m_minibatches;
+    bool m_complete; // m_minibatches holds the whole pass
+
+    bool m_replaying;
+    bool m_uncacheable;
+    size_t m_next; // next minibatch to replay
+};
+} } }
@@ -440,6 +440,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             return (m_numSubminibatches = actualnumSubminibatches);
         }
 
+        // start the cached minibatch over, cut into more sub-minibatches (after running out of memory)
+        // Returns the actual number, which is no larger than that of the parallel sequences.
+        size_t Resplit(size_t requestedSubminibatches)
+        {
+            size_t nParallelSequences = m_MBLayoutCache->GetNumParallelSequences();
+            for (auto& x : m_cachedGradient) // (discard the sub-minibatches done so far)
+                x.second->SetValue((ElemType) 0);
+            m_NetCriterionAccumulator->SetValue((ElemType) 0);
+            m_NetEvaluationAccumulator->SetValue((ElemType) 0);
+            return (m_numSubminibatches = requestedSubminibatches > nParallelSequences ? nParallelSequences : requestedSubminibatches);
+        }
+
+        // the cached number of parallel sequences, i.e. the most sub-minibatches there can be
+        size_t GetNumParallelSequences() const
+        {
+            return m_MBLayoutCache->GetNumParallelSequences();
+        }
+
+        // stateful nodes carry their state from one minibatch to the next per sub-minibatch, so their number may not change
+        bool HasStatefulNodes() const
+        {
+            return !m_NetStatefulNodes.empty();
+        }
+
         void DecimateLattices(
             LatticePtr decimatedLattices,         /* output: lattices after decimation*/
             BoundariesPtr decimatedBoundaryPtr,   /* output: boundary after decimation*/
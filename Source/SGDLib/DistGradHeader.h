@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 struct DistGradHeader
@@ -9,6 +11,10 @@ public:
     size_t numSamplesWithLabel;
     double criterion;
 
+    // throughput of the nodes (samples per second, for visibility), aggregated as minimum and maximum; 0 if unknown
+    double minSamplesPerSecond;
+    double maxSamplesPerSecond;
+
     // variable-size array
     int numEvalNode;
     double evalErrors[1];
@@ -39,6 +45,9 @@ public:
             numSamples += other->numSamples;
             numSamplesWithLabel += other->numSamplesWithLabel;
             criterion += other->criterion;
+            if ((other->minSamplesPerSecond > 0) && ((minSamplesPerSecond == 0) || (other->minSamplesPerSecond < minSamplesPerSecond)))
+                minSamplesPerSecond = other->minSamplesPerSecond;
+            maxSamplesPerSecond = std::max(maxSamplesPerSecond, other->maxSamplesPerSecond);
             for (int i = 0; i < numEvalNode; i++)
             {
                 evalErrors[i] += other->evalErrors[i];
@@ -56,6 +65,8 @@ public:
         numSamples = 0;
         numSamplesWithLabel = 0;
         criterion = 0;
+        minSamplesPerSecond = 0;
+        maxSamplesPerSecond = 0;
         for (int i = 0; i < numEvalNode; i++)
         {
             evalErrors[i] = 0;
@@ -70,6 +81,8 @@ public:
         std::swap(first.numSamples, second.numSamples);
         std::swap(first.numSamplesWithLabel, second.numSamplesWithLabel);
         std::swap(first.criterion, second.criterion);
+        std::swap(first.minSamplesPerSecond, second.minSamplesPerSecond);
+        std::swap(first.maxSamplesPerSecond, second.maxSamplesPerSecond);
         for (int i = 0; i < first.numEvalNode; i++)
         {
             std::swap(first.evalErrors[i], second.evalErrors[i]);
@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Distillation.h -- knowledge distillation: soft targets from a teacher network, computed during training (SGD's 'teacherModelPath')
+//
+// The teacher, a trained model, is loaded frozen onto 'teacherDeviceId' (by default the student's device) and run forward on
+// each minibatch the student trains on; its inputs are the student's inputs of the same names, copied over. The soft targets
+// softmax(z / distillationTemperature) of its output z (logits) are written into the student's input node
+// 'distillationTargetNodeName', which the reader does not provide and which the student's criterion uses, e.g.
+// CrossEntropyWithSoftmax(softTargets, z). With distillationTopK > 0, only the k largest probabilities of each sample are
+// kept and renormalized, and only those are moved from the teacher's device to the student's.
+//
+// The soft targets exist for the training data only, so there is no cross-validation; sub-minibatches and
+// dataParallelDevices are not supported either.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class Distillation
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    Distillation(DEVICEID_TYPE teacherDeviceId, double temperature, size_t topK)
+        : m_temperature(temperature), m_topK(topK), m_probs(teacherDeviceId), m_topIndexes(teacherDeviceId), m_topValues(teacherDeviceId)
+    {
+        if (temperature <= 0)
+            InvalidArgument("distillationTemperature must be positive.");
+    }
+
+    // load the teacher and find the nodes to connect; 'inputMatrices' are the student's inputs as read (without the target)
+    void Init(const wstring& teacherModelPath, const wstring& teacherOutputNodeName, const ComputationNodeBasePtr& targetNode,
+              const std::map<std::wstring, Matrix<ElemType>*>& inputMatrices)
+    {
+        fprintf(stderr, "Distillation: loading the teacher from %ls.\n", teacherModelPath.c_str());
+        m_teacher = ComputationNetwork::CreateFromFile<ElemType>(m_probs.GetDeviceId(), teacherModelPath);
+        m_teacherOutputBase = m_teacher->GetNodeFromName(teacherOutputNodeName);
+        m_teacherOutput = dynamic_pointer_cast<ComputationNode<ElemType>>(m_teacherOutputBase);
+        m_targetNode = dynamic_pointer_cast<ComputationNode<ElemType>>(targetNode);
+        if (!m_teacherOutput || !m_targetNode)
+            InvalidArgument("Distillation: The teacher output and the target must have the student's element type.");
+        if (m_targetNode->OperationName() != OperationNameOf(InputValue))
+            InvalidArgument("Distillation: The target %ls must be an InputValue node, not %ls.", m_targetNode->NodeName().c_str(), m_targetNode->OperationName().c_str());
+        if (m_teacherOutput->GetSampleMatrixNumRows() != m_targetNode->GetSampleMatrixNumRows())
+            InvalidArgument("Distillation: The teacher output %ls has dimension %d, but the target %ls has %d.",
+                            m_teacherOutput->NodeName().c_str(), (int) m_teacherOutput->GetSampleMatrixNumRows(),
+                            m_targetNode->NodeName().c_str(), (int) m_targetNode->GetSampleMatrixNumRows());
+        if (m_topK >= m_targetNode->GetSampleMatrixNumRows())
+            m_topK = 0; // (all of them)
+
+        // evaluation orders exist for roots only, so the output (typically an input to the criterion) is made an output node
+        auto& outputNodes = m_teacher->OutputNodes();
+        if (std::find(outputNodes.begin(), outputNodes.end(), m_teacherOutputBase) == outputNodes.end())
+        {
+            outputNodes.push_back(m_teacherOutputBase);
+            m_teacher->InvalidateCompiledNetwork(); // prepare to re-compile
+            m_teacher->CompileNetwork();
+        }
+        for (const auto& input : m_teacher->InputNodes(m_teacherOutputBase))
+        {
+            if (inputMatrices.find(input->NodeName()) == inputMatrices.end())
+                InvalidArgument("Distillation: The teacher's input %ls is not an input of the student.", input->NodeName().c_str());
+            m_teacherInputs.push_back(input);
+        }
+
+        m_teacher->AllocateAllMatrices({m_teacherOutputBase}, {}, nullptr);
+    }
+
+    void StartEpoch()
+    {
+        m_teacher->StartEvaluateMinibatchLoop(m_teacherOutputBase);
+    }
+
+    // run the teacher on the student's current minibatch and set the student's target
+    void ComputeSoftTargets(const ComputationNetworkPtr& net, const std::map<std::wstring, Matrix<ElemType>*>& inputMatrices)
+    {
+        for (const auto& input : m_teacherInputs)
+        {
+            Matrix<ElemType> copy(*inputMatrices.find(input->NodeName())->second); // (on the student's device)
+            copy.TransferToDeviceIfNotThere(m_teacher->GetDeviceId(), true);
+            dynamic_pointer_cast<ComputationNode<ElemType>>(input)->Value().SetValue(copy);
+            input->NotifyFunctionValuesMBSizeModified();
+        }
+        m_teacher->GetMBLayoutPtr()->CopyFrom(net->GetMBLayoutPtr());
+        ComputationNetwork::BumpEvalTimeStamp(m_teacherInputs);
+        m_teacher->ForwardProp(m_teacherOutputBase);
+
+        // soft targets
+        const Matrix<ElemType>& z = m_teacherOutput->Value();
+        if (m_temperature != 1)
+        {
+            m_probs.SetValue(z);
+            m_probs *= (ElemType) (1 / m_temperature);
+            m_probs.InplaceLogSoftmax(true);
+        }
+        else
+            m_probs.AssignLogSoftmaxOf(z, true);
+        m_probs.InplaceExp();
+
+        Matrix<ElemType>& target = m_targetNode->Value();
+        if (m_topK == 0)
+        {
+            Matrix<ElemType> copy(m_probs);
+            copy.TransferToDeviceIfNotThere(target.GetDeviceId(), true);
+            target.SetValue(copy);
+        }
+        else
+        {
+            // only the top k of each column go to the student's device, as a sparse matrix
+            m_probs.VectorMax(m_topIndexes, m_topValues, true, (int) m_topK);
+            const size_t numRows = m_probs.GetNumRows();
+            const size_t numCols = m_probs.GetNumCols();
+            ElemType* indexes = m_topIndexes.CopyToArray();
+            ElemType* values = m_topValues.CopyToArray();
+            std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1), rowIds(numCols * m_topK);
+            std::vector<ElemType> nzValues(numCols * m_topK);
+            std::vector<std::pair<CPUSPARSE_INDEX_TYPE, ElemType>> column(m_topK);
+            for (size_t j = 0; j < numCols; j++)
+            {
+                ElemType sum = 0;
+                for (size_t i = 0; i < m_topK; i++)
+                {
+                    column[i] = std::make_pair((CPUSPARSE_INDEX_TYPE) indexes[j * m_topK + i], values[j * m_topK + i]);
+                    sum += column[i].second;
+                }
+                std::sort(column.begin(), column.end()); // (row ids in increasing order)
+                for (size_t i = 0; i < m_topK; i++)
+                {
+                    rowIds[j * m_topK + i] = column[i].first;
+                    nzValues[j * m_topK + i] = sum > 0 ? column[i].second / sum : 0;
+                }
+                colStarts[j + 1] = (CPUSPARSE_INDEX_TYPE) ((j + 1) * m_topK);
+            }
+            delete[] indexes;
+            delete[] values;
+
+            Matrix<ElemType> sparse(numRows, numCols, target.GetDeviceId(), SPARSE, matrixFormatSparseCSC);
+            sparse.SetMatrixFromCSCFormat(colStarts.data(), rowIds.data(), nzValues.data(), nzValues.size(), numRows, numCols);
+            sparse.SwitchToMatrixType(DENSE, matrixFormatDense, true);
+            target.SetValue(sparse);
+        }
+        m_targetNode->NotifyFunctionValuesMBSizeModified();
+        m_targetNode->BumpEvalTimeStamp();
+    }
+
+private:
+    double m_temperature;
+    size_t m_topK; // 0: all
+
+    ComputationNetworkPtr m_teacher;
+    ComputationNodeBasePtr m_teacherOutputBase;
+    ComputationNodePtr m_teacherOutput;
+    std::vector<ComputationNodeBasePtr> m_teacherInputs;
+    ComputationNodePtr m_targetNode; // in the student
+
+    // on the teacher's device
+    Matrix<ElemType> m_probs;
+    Matrix<ElemType> m_topIndexes;
+    Matrix<ElemType> m_topValues;
+};
+} } }
@@ -0,0 +1,196 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ElasticTraining.h -- data-parallel workers joining and leaving a running job (ParallelTrain's 'elasticPortFile')
+//
+// The job started by mpiexec is the core; its main node opens an MPI port and writes the port's name to the port file.
+// A process started later on its own, with the same config and elasticJoin=true, loads the latest checkpoint like a
+// restarted job, puts a request file next to the port file, and connects to the port. At the end of each epoch, once
+// the checkpoint is written, the members admit the waiting processes and broadcast the main node's model and training
+// state to them; the next epoch's data is sharded over all ranks there are then.
+//
+// A joined process that gets SIGTERM (e.g. the notice of a preemptible VM) leaves at the end of the current epoch: the
+// others continue without it, and it disconnects and ends. The core's ranks cannot leave, since MPI ties them together;
+// on SIGTERM there, all stop after the epoch's checkpoint, to be restarted from it. A process that dies without notice
+// still ends the job (that would take a fault-tolerant MPI).
+//
+// Connecting separately started processes requires MPI's dynamic process support (e.g. ompi-server for Open MPI), and
+// the port file must be on a file system that all of them see.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "MPIWrapper.h"
+#include "fileutil.h"
+#include <array>
+#include <csignal>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class ElasticTraining
+{
+public:
+    enum class MembershipChange
+    {
+        None,
+        Changed, // ranks left or joined; the training state has to be broadcast
+        Left,    // this process has left the job
+        Stop     // a core rank was asked to stop: all stop
+    };
+
+    ElasticTraining(const std::wstring& portFile, bool isJoiner)
+        : m_portFile(portFile), m_isJoiner(isJoiner)
+    {
+        s_signalReceived = 0;
+        std::signal(SIGTERM, &OnSignal);
+        if (!isJoiner && g_mpi->IsMainNode())
+        {
+            m_portName = g_mpi->OpenPort();
+            FILE* f = fopenOrDie(m_portFile, L"w");
+            fprintf(f, "%s\n", m_portName.c_str());
+            fcloseOrDie(f);
+            fprintf(stderr, "ElasticTraining: accepting workers at the end of each epoch; port published in %ls\n", m_portFile.c_str());
+        }
+    }
+
+    ~ElasticTraining()
+    {
+        if (!m_portName.empty())
+        {
+            _wunlink(m_portFile.c_str());
+            g_mpi->ClosePort(m_portName);
+        }
+        std::signal(SIGTERM, SIG_DFL);
+    }
+
+    bool IsJoiner() const
+    {
+        return m_isJoiner;
+    }
+
+    // a joining process: connect to the job, which admits it at the end of its current epoch
+    void Join()
+    {
+        fprintf(stderr, "ElasticTraining: waiting for the job's port file %ls\n", m_portFile.c_str());
+        while (!fexists(m_portFile))
+            ::Sleep(1000);
+        char portName[MPI_MAX_PORT_NAME + 1] = {0};
+        FILE* f = fopenOrDie(m_portFile, L"r");
+        if (!fgets(portName, sizeof(portName), f))
+            RuntimeError("ElasticTraining: could not read the port name from %ls", m_portFile.c_str());
+        fcloseOrDie(f);
+        std::string port = portName;
+        while (!port.empty() && (port.back() == '\n' || port.back() == '\r'))
+            port.pop_back();
+
+        // the request is only a marker; the main node removes it when it admits us
+        std::wstring requestFile = msra::strfun::wstrprintf(L"%ls.join.%d.%d", m_portFile.c_str(), (int) GetCurrentProcessId(), (int) time(nullptr));
+        fcloseOrDie(fopenOrDie(requestFile, L"w"));
+        fprintf(stderr, "ElasticTraining: joining the job\n");
+        g_mpi->Connect(port);
+
+        // take part in admitting those that joined at the same time, after us
+        int numRemaining = 0;
+        g_mpi->Bcast(&numRemaining, 1, g_mpi->MainNodeRank());
+        Admit(numRemaining);
+    }
+
+    // at the end of an epoch, on all members: let the ranks go that were asked to leave, and admit the waiting processes
+    MembershipChange UpdateMembership()
+    {
+        bool signalReceived = s_signalReceived != 0;
+        std::array<int, 2> numRequests; // [0]: to leave, [1]: to stop
+        numRequests[0] = signalReceived && m_isJoiner ? 1 : 0;
+        numRequests[1] = signalReceived && !m_isJoiner ? 1 : 0;
+        g_mpi->AllReduce(numRequests);
+        if (numRequests[1] > 0)
+            return MembershipChange::Stop;
+        bool changed = false;
+        if (numRequests[0] > 0)
+        {
+            fprintf(stderr, "ElasticTraining: %d workers leaving\n", numRequests[0]);
+            if (!g_mpi->Leave(signalReceived))
+                return MembershipChange::Left;
+            changed = true;
+        }
+
+        int numJoining = 0;
+        if (g_mpi->IsMainNode())
+        {
+            std::vector<std::wstring> requestFiles;
+            expand_wildcards(m_portFile + L".join.*", requestFiles);
+            for (const auto& requestFile : requestFiles)
+                _wunlink(requestFile.c_str());
+            numJoining = (int) requestFiles.size();
+        }
+        g_mpi->Bcast(&numJoining, 1, g_mpi->MainNodeRank());
+        if (numJoining > 0)
+        {
+            fprintf(stderr, "ElasticTraining: %d workers joining\n", numJoining);
+            Admit(numJoining);
+            changed = true;
+        }
+        return changed ? MembershipChange::Changed : MembershipChange::None;
+    }
+
+    // after a change: the main node's parameters, optimizer state, and the scalars of the training state, to all
+    void BroadcastState(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& scalars)
+    {
+        g_mpi->Bcast(scalars.data(), scalars.size(), g_mpi->MainNodeRank());
+        auto smoothedGradientIter = smoothedGradients.begin();
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+        {
+            BroadcastMatrix(dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value());
+            BroadcastMatrix(*smoothedGradientIter);
+        }
+    }
+
+private:
+    static void OnSignal(int)
+    {
+        s_signalReceived = 1;
+    }
+
+    // accept 'numJoining' processes, one at a time; each takes part in admitting the ones after it
+    void Admit(int numJoining)
+    {
+        for (int k = 0; k < numJoining; k++)
+        {
+            g_mpi->Accept(m_portName);
+            int numRemaining = numJoining - k - 1;
+            g_mpi->Bcast(&numRemaining, 1, g_mpi->MainNodeRank()); // (for the new member)
+        }
+    }
+
+    static void BroadcastMatrix(Matrix<ElemType>& m)
+    {
+        std::array<size_t, 2> dims = {m.GetNumRows(), m.GetNumCols()};
+        g_mpi->Bcast(dims.data(), dims.size(), g_mpi->MainNodeRank()); // (state that is sized on first use may be empty on the joiners)
+        if (dims[0] * dims[1] == 0)
+        {
+            m.Resize(dims[0], dims[1]);
+            return;
+        }
+        std::unique_ptr<ElemType[]> buffer(g_mpi->IsMainNode() ? m.CopyToArray() : new ElemType[dims[0] * dims[1]]);
+        g_mpi->Bcast(buffer.get(), dims[0] * dims[1], g_mpi->MainNodeRank());
+        m.SetValue(dims[0], dims[1], m.GetDeviceId(), buffer.get(), matrixFlagNormal);
+    }
+
+    std::wstring m_portFile;
+    bool m_isJoiner;        // started with elasticJoin, i.e. not a rank of the core job
+    std::string m_portName; // on the core's main node
+    static volatile sig_atomic_t s_signalReceived;
+};
+
+template <class ElemType>
+volatile sig_atomic_t ElasticTraining<ElemType>::s_signalReceived = 0;
+} } }
@@ -0,0 +1,216 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EnsembleOutputWriter.h -- the outputs of several models on the same data, which is read only once ('ensembleWrite')
+//
+// Each minibatch is read into the first model's inputs and copied from there into the inputs of the others, by name.
+// Then all models run their forward pass, at the same time if each has a device of its own. Each model's outputs are
+// written to <outputPath>.<node>.model<i>, in the text format of SimpleOutputWriter; with 'writeAverage', the average
+// over the models goes to <outputPath>.<node>, for which all models must give outputs of the same dimensions.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "fileutil.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <memory>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class EnsembleOutputWriter
+{
+public:
+    EnsembleOutputWriter(const std::vector<ComputationNetworkPtr>& nets)
+        : m_nets(nets)
+    {
+        if (m_nets.empty())
+            InvalidArgument("EnsembleOutputWriter: No models given.");
+    }
+
+    void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, const std::wstring& outputPath, std::vector<std::wstring> outputNodeNames,
+                     bool writeEach, bool writeAverage, size_t numOutputSamples = requestDataSize)
+    {
+        const size_t numModels = m_nets.size();
+        msra::files::make_intermediate_dirs(outputPath);
+
+        // the same outputs of all models; by default, the first model's output nodes
+        if (outputNodeNames.empty())
+        {
+            fprintf(stderr, "OutputNodeNames are not specified, using the default outputnodes of the first model.\n");
+            if (m_nets[0]->OutputNodes().empty())
+                LogicError("There is no default output node specified in the network.");
+            for (const auto& node : m_nets[0]->OutputNodes())
+                outputNodeNames.push_back(node->NodeName());
+        }
+        std::vector<std::vector<ComputationNodeBasePtr>> outputNodes(numModels); // [model][output]
+        for (size_t m = 0; m < numModels; m++)
+        {
+            for (const auto& name : outputNodeNames)
+                outputNodes[m].push_back(m_nets[m]->GetNodeFromName(name));
+            m_nets[m]->AllocateAllMatrices({}, outputNodes[m], nullptr);
+        }
+
+        // the first model's feature nodes are read into; the others' get copies, by name
+        auto& featureNodes = m_nets[0]->FeatureNodes();
+        std::map<std::wstring, Matrix<ElemType>*> inputMatrices;
+        for (const auto& node : featureNodes)
+            inputMatrices[node->NodeName()] = &node->As<ComputationNode<ElemType>>()->Value();
+        std::vector<std::vector<ComputationNodeBasePtr>> copiedInputs(numModels); // [model][feature node of the first model]
+        for (size_t m = 1; m < numModels; m++)
+            for (const auto& node : featureNodes)
+                copiedInputs[m].push_back(m_nets[m]->GetNodeFromName(node->NodeName()));
+
+        // the forward passes run concurrently if no two models share a device
+        std::vector<DEVICEID_TYPE> deviceIds;
+        for (const auto& net : m_nets)
+            deviceIds.push_back(net->GetDeviceId());
+        std::sort(deviceIds.begin(), deviceIds.end());
+        bool concurrent = numModels > 1 && std::adjacent_find(deviceIds.begin(), deviceIds.end()) == deviceIds.end();
+        fprintf(stderr, "EnsembleOutputWriter: %d models, evaluated %s.\n", (int) numModels, concurrent ? "concurrently" : "one after the other");
+
+        std::vector<std::unique_ptr<ofstream>> eachStreams;    // [output * numModels + model]
+        std::vector<std::unique_ptr<ofstream>> averageStreams; // [output]
+        for (size_t i = 0; i < outputNodeNames.size(); i++)
+        {
+            std::wstring path = outputPath + L"." + outputNodeNames[i];
+            if (writeAverage)
+                averageStreams.push_back(OpenStream(path));
+            for (size_t m = 0; writeEach && m < numModels; m++)
+                eachStreams.push_back(OpenStream(path + msra::strfun::wstrprintf(L".model%d", (int) m)));
+        }
+
+        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+        for (size_t m = 0; m < numModels; m++)
+            m_nets[m]->StartEvaluateMinibatchLoop(outputNodes[m]);
+
+        size_t totalEpochSamples = 0;
+        size_t numMBsRun = 0;
+        size_t tempArraySize = 0;
+        ElemType* tempArray = nullptr;
+        std::vector<ElemType> sum;
+        size_t actualMBSize;
+        while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_nets[0], nullptr, false, false, inputMatrices, actualMBSize))
+        {
+            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+            for (size_t m = 1; m < numModels; m++)
+            {
+                m_nets[m]->GetMBLayoutPtr()->CopyFrom(m_nets[0]->GetMBLayoutPtr());
+                for (size_t k = 0; k < featureNodes.size(); k++)
+                {
+                    auto node = copiedInputs[m][k]->As<ComputationNode<ElemType>>();
+                    CopyValue(featureNodes[k]->As<ComputationNode<ElemType>>()->Value(), node->Value());
+                    node->NotifyFunctionValuesMBSizeModified();
+                }
+                ComputationNetwork::BumpEvalTimeStamp(copiedInputs[m]);
+            }
+
+            if (actualMBSize == 0)
+                continue;
+            if (concurrent)
+            {
+                std::vector<std::future<void>> forwardProps;
+                for (size_t m = 0; m < numModels; m++)
+                {
+                    ComputationNetworkPtr net = m_nets[m];
+                    const auto& roots = outputNodes[m];
+                    forwardProps.push_back(std::async(std::launch::async, [net, &roots]()
+                                                      {
+                                                          net->ForwardProp(roots);
+                                                      }));
+                }
+                for (auto& forwardProp : forwardProps) // (wait for all before rethrowing a failure)
+                    forwardProp.wait();
+                for (auto& forwardProp : forwardProps)
+                    forwardProp.get();
+            }
+            else
+            {
+                for (size_t m = 0; m < numModels; m++)
+                    m_nets[m]->ForwardProp(outputNodes[m]);
+            }
+
+            for (size_t i = 0; i < outputNodeNames.size(); i++)
+            {
+                size_t rows = 0, cols = 0;
+                for (size_t m = 0; m < numModels; m++)
+                {
+                    const Matrix<ElemType>& outputValues = outputNodes[m][i]->As<ComputationNode<ElemType>>()->Value();
+                    outputValues.CopyToArray(tempArray, tempArraySize);
+                    if (writeEach)
+                        WriteColumns(*eachStreams[i * numModels + m], tempArray, outputValues.GetNumRows(), outputValues.GetNumCols());
+                    if (!writeAverage)
+                        continue;
+                    if (m == 0)
+                    {
+                        rows = outputValues.GetNumRows();
+                        cols = outputValues.GetNumCols();
+                        sum.assign(tempArray, tempArray + rows * cols);
+                        continue;
+                    }
+                    if (outputValues.GetNumRows() != rows || outputValues.GetNumCols() != cols)
+                        RuntimeError("EnsembleOutputWriter: Output %ls of model %d has dimensions [%d x %d], but that of the first model [%d x %d]; cannot average them.",
+                                     outputNodeNames[i].c_str(), (int) m, (int) outputValues.GetNumRows(), (int) outputValues.GetNumCols(), (int) rows, (int) cols);
+                    for (size_t j = 0; j < sum.size(); j++)
+                        sum[j] += tempArray[j];
+                }
+                if (writeAverage)
+                {
+                    for (auto& value : sum)
+                        value /= (ElemType) numModels;
+                    WriteColumns(*averageStreams[i], sum.data(), rows, cols);
+                }
+            }
+
+            totalEpochSamples += actualMBSize;
+            fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", ++numMBsRun, actualMBSize);
+        }
+
+        fprintf(stderr, "Total Samples Evaluated = %lu\n", totalEpochSamples);
+        delete[] tempArray;
+    }
+
+private:
+    static std::unique_ptr<ofstream> OpenStream(const std::wstring& path)
+    {
+#ifdef _MSC_VER
+        return std::unique_ptr<ofstream>(new ofstream(path.c_str()));
+#else
+        return std::unique_ptr<ofstream>(new ofstream(wtocharpath(path).c_str()));
+#endif
+    }
+
+    // one line per column, as SimpleOutputWriter writes them
+    static void WriteColumns(ofstream& outputStream, const ElemType* values, size_t rows, size_t cols)
+    {
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t k = 0; k < rows; k++)
+                outputStream << *values++ << " ";
+            outputStream << endl;
+        }
+    }
+
+    // an input of the first model into that of another, which may be on another device
+    static void CopyValue(const Matrix<ElemType>& from, Matrix<ElemType>& to)
+    {
+        DEVICEID_TYPE deviceId = to.GetDeviceId();
+        to.SetValue(from); // (this takes 'from's device, ...)
+        if (to.GetDeviceId() != deviceId)
+            to.TransferToDeviceIfNotThere(deviceId, true); // (... so move it back)
+    }
+
+    std::vector<ComputationNetworkPtr> m_nets;
+};
+} } }
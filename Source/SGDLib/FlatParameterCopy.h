@@ -0,0 +1,61 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// FlatParameterCopy.h -- copy all learnable parameters of a model into/from one contiguous CPU buffer (for exchanging them over MPI)
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <list>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+/*static*/ struct FlatParameterCopy
+{
+    // total number of values of the parameters that are being learned (IsParameterUpdateRequired())
+    template <class ElemType>
+    static size_t GetNumElements(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        size_t numElements = 0;
+        for (auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                numElements += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements();
+        }
+        return numElements;
+    }
+
+    // buffer must hold GetNumElements() values
+    template <class ElemType>
+    static void Get(const std::list<ComputationNodeBasePtr>& learnableNodes, std::vector<ElemType>& buffer)
+    {
+        size_t offset = 0;
+        for (auto& node : learnableNodes)
+        {
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            const Matrix<ElemType>& mat = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            mat.CopySection(mat.GetNumRows(), mat.GetNumCols(), buffer.data() + offset, mat.GetNumRows());
+            offset += mat.GetNumElements();
+        }
+    }
+
+    template <class ElemType>
+    static void Set(const std::list<ComputationNodeBasePtr>& learnableNodes, std::vector<ElemType>& buffer)
+    {
+        size_t offset = 0;
+        for (auto& node : learnableNodes)
+        {
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            Matrix<ElemType>& mat = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), buffer.data() + offset);
+            offset += mat.GetNumElements();
+        }
+    }
+};
+} } }
@@ -0,0 +1,125 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GradientAccumulator.h -- gradients summed over several minibatches before each update (SGD's 'gradientAccumulationSteps')
+//
+// The minibatches that the reader delivers are taken in groups of K. The gradients of all but the last of a group are
+// set aside and added up; after backprop of the last, their sum is added to its gradients, which are then aggregated
+// across workers and applied as those of a single minibatch of all the group's samples. Since learning rate and momentum
+// are per sample, the update is that of the large minibatch, while only one minibatch at a time has to fit into memory,
+// and there is one allreduce per group instead of per minibatch. At the end of the data, the update is done with the
+// samples of the incomplete group.
+//
+// Unlike sub-minibatches (numSubminibatches, maxSamplesInRAM), the reader never has to deliver the large minibatch.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include <list>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class GradientAccumulator
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    GradientAccumulator(size_t numSteps)
+        : m_numSteps(numSteps), m_numMinibatches(0), m_hasGradients(false)
+    {
+        Reset(0);
+    }
+
+    // a group has been started but not updated yet
+    bool HasPending() const
+    {
+        return m_numMinibatches > 0;
+    }
+
+    // After forward and backprop of a minibatch: returns whether the parameters are to be updated now. If so, the
+    // learnable nodes' gradients hold the sum over the group, and the Get...() functions return the group's totals.
+    // 'hasGradients' is false if no backprop was done (no data, or the learning rate is too small); 'isLast' forces the
+    // end of the group. The criterion values are only collected if 'collectCriteria'.
+    bool Add(const std::list<ComputationNodeBasePtr>& learnableNodes, const ComputationNodeBasePtr& criterionNode,
+             const std::vector<ComputationNodeBasePtr>& evaluationNodes, size_t actualMBSize, size_t numSamplesWithLabel,
+             bool hasGradients, bool isLast, bool collectCriteria)
+    {
+        if (m_numMinibatches == 0)
+            Reset(evaluationNodes.size());
+        m_numMinibatches++;
+        if (actualMBSize > 0)
+        {
+            m_numSamples += actualMBSize;
+            m_numSamplesWithLabel += numSamplesWithLabel;
+            if (collectCriteria)
+            {
+                m_criterion += criterionNode->Get00Element();
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    m_evalErrors[i] += evaluationNodes[i]->Get00Element();
+            }
+        }
+
+        bool isUpdateStep = isLast || m_numMinibatches >= m_numSteps;
+        if (m_accumulatedGradients.size() != learnableNodes.size())
+            m_accumulatedGradients.assign(learnableNodes.size(), nullptr);
+        size_t k = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, k++)
+        {
+            if (!(*nodeIter)->IsParameterUpdateRequired())
+                continue;
+            Matrix<ElemType>& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Gradient();
+            auto& accumulated = m_accumulatedGradients[k];
+            if (hasGradients)
+            {
+                if (!m_hasGradients) // (first of the group: no need to clear)
+                {
+                    if (isUpdateStep)
+                        continue; // the gradients are the sum already
+                    if (!accumulated)
+                        accumulated = make_shared<Matrix<ElemType>>(gradient.GetDeviceId());
+                    accumulated->SetValue(gradient);
+                }
+                else
+                    *accumulated += gradient;
+            }
+            if (isUpdateStep && m_hasGradients)
+                gradient.SetValue(*accumulated);
+        }
+        m_hasGradients |= hasGradients;
+
+        if (isUpdateStep)
+            m_numMinibatches = 0; // (the totals remain valid until the next Add())
+        return isUpdateStep;
+    }
+
+    // totals of the group, valid after Add() returned true
+    size_t GetNumSamples() const { return m_numSamples; }
+    size_t GetNumSamplesWithLabel() const { return m_numSamplesWithLabel; }
+    double GetCriterion() const { return m_criterion; }
+    double GetEvalError(size_t i) const { return m_evalErrors[i]; }
+
+private:
+    void Reset(size_t numEvaluationNodes)
+    {
+        m_hasGradients = false;
+        m_numSamples = 0;
+        m_numSamplesWithLabel = 0;
+        m_criterion = 0;
+        m_evalErrors.assign(numEvaluationNodes, 0.0);
+    }
+
+    size_t m_numSteps;
+    size_t m_numMinibatches; // of the current group, so far
+    bool m_hasGradients;     // m_accumulatedGradients hold the sum of the current group's gradients so far
+    std::vector<shared_ptr<Matrix<ElemType>>> m_accumulatedGradients; // in the order of the learnable nodes
+    size_t m_numSamples;
+    size_t m_numSamplesWithLabel;
+    double m_criterion;
+    std::vector<double> m_evalErrors;
+};
+} } }
@@ -0,0 +1,270 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HogwildTraining.h -- lock-free multithreaded training on the CPU (SGD's 'hogwildThreads')
+//
+// With small matrices, OpenMP inside the kernels does not keep the cores busy. Instead, N workers each run forward and
+// backprop of their own share of the minibatch (split as for LocalDataParallel), with activations and gradients of their
+// own: the network is worker 0, the others are replicas of it. The replicas' learnable parameters are not copies but
+// views of the network's, and each worker applies its gradient to them as soon as its backprop is done, without waiting
+// for the others (Hogwild). Sparse gradients (e.g. of a LookupTable) only touch the columns that were seen, so that
+// collisions are rare for sparse models. Optionally ('hogwildLocking=striped'), each parameter's update takes one of a
+// fixed set of locks, so that no two workers update the same parameter at once.
+//
+// The update is that of plain SGD with momentum; each worker keeps its own momentum. The kernels of the workers run on
+// one core each.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "TaskPool.h"
+#include <functional>
+#include <list>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class HogwildTraining
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    HogwildTraining(size_t numWorkers, bool useStripedLocks)
+        : m_numWorkers(numWorkers), m_useStripedLocks(useStripedLocks), m_numSamplesWithLabel(0)
+    {
+    }
+
+    size_t GetNumWorkers() const
+    {
+        return m_workers.size();
+    }
+
+    // Create the replicas by loading the network from a temporary model file, and let them share the network's parameters.
+    // prepareNetwork() applies the options that SGD sets on the network before allocating it.
+    void Init(ComputationNetworkPtr net, const std::wstring& tempModelPath,
+              const std::list<ComputationNodeBasePtr>& learnableNodes,
+              const std::vector<ComputationNodeBasePtr>& evaluationNodes, const ComputationNodeBasePtr& criterionNode,
+              const std::function<void(ComputationNetworkPtr)>& prepareNetwork)
+    {
+        if (net->GetDeviceId() != CPUDEVICE)
+            InvalidArgument("hogwildThreads requires the network to be on the CPU.");
+
+        m_workers.resize(m_numWorkers);
+        m_workers[0].m_net = net;
+        m_workers[0].m_criterionNode = criterionNode;
+        m_workers[0].m_evaluationNodes = evaluationNodes;
+        m_workers[0].m_learnableNodes = learnableNodes;
+        net->Save(tempModelPath);
+        for (size_t k = 1; k < m_workers.size(); k++)
+        {
+            Worker& worker = m_workers[k];
+            worker.m_net = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, tempModelPath);
+            worker.m_criterionNode = worker.m_net->GetNodeFromName(criterionNode->NodeName());
+            for (const auto& node : evaluationNodes)
+                worker.m_evaluationNodes.push_back(worker.m_net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : learnableNodes)
+                worker.m_learnableNodes.push_back(worker.m_net->GetNodeFromName(node->NodeName()));
+            prepareNetwork(worker.m_net);
+            worker.m_net->AllocateAllMatrices(worker.m_evaluationNodes, {}, worker.m_criterionNode);
+            for (const auto& node : worker.m_net->FeatureNodes())
+                worker.m_inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            for (const auto& node : worker.m_net->LabelNodes())
+                worker.m_inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        }
+        _wunlink(tempModelPath.c_str());
+
+        for (auto& worker : m_workers)
+            for (const auto& node : worker.m_learnableNodes)
+                worker.m_smoothedGradients.push_back(Matrix<ElemType>(CPUDEVICE));
+        ShareParameters();
+        fprintf(stderr, "HogwildTraining: %d workers share the network's parameters%s.\n",
+                (int) m_workers.size(), m_useStripedLocks ? ", with striped locks" : "");
+    }
+
+    // start an epoch (or a trial in a learning-rate search)
+    void StartEpoch()
+    {
+        ShareParameters(); // (the network's parameters may have been reloaded)
+        for (size_t k = 1; k < m_workers.size(); k++)
+        {
+            Worker& worker = m_workers[k];
+            worker.m_net->StartEvaluateMinibatchLoop(worker.m_evaluationNodes);
+            worker.m_net->StartEvaluateMinibatchLoop(worker.m_criterionNode);
+        }
+    }
+
+    // Split the minibatch that was read into the network's inputs: the replicas get their shares, the network keeps
+    // the first. Remembers the number of samples with labels of the whole minibatch (see GetNumSamplesWithLabel()).
+    void DistributeMinibatch(ComputationNetworkPtr net, std::map<std::wstring, Matrix<ElemType>*>& inputMatrices, size_t actualMBSize)
+    {
+        m_numSamplesWithLabel = net->GetNumSamplesWithLabel(actualMBSize);
+        int numWorkers = (int) m_workers.size();
+        for (size_t k = 1; k < m_workers.size(); k++)
+        {
+            Worker& worker = m_workers[k];
+            std::map<std::wstring, Matrix<ElemType>*> decimatedMB;
+            MBLayoutPtr pDecimatedMBLayout;
+            DataReaderHelpers::DecimateMinibatch(inputMatrices, decimatedMB, net->GetMBLayoutPtr(), pDecimatedMBLayout, numWorkers, (int) k);
+            for (auto& iter : decimatedMB)
+            {
+                auto input = worker.m_inputMatrices.find(iter.first);
+                if (input != worker.m_inputMatrices.end())
+                    input->second->SetValue(*iter.second);
+                delete iter.second;
+            }
+            worker.m_net->GetMBLayoutPtr()->CopyFrom(pDecimatedMBLayout);
+            NotifyInputsModified(worker.m_net, worker.m_inputMatrices);
+        }
+        DataReaderHelpers::DecimateMinibatch(inputMatrices, numWorkers, 0, net->GetMBLayoutPtr());
+        NotifyInputsModified(net, inputMatrices);
+        for (auto& worker : m_workers)
+            worker.m_actualMBSize = worker.m_net->DetermineActualMBSizeFromFeatures(); // (fewer parallel sequences than workers leave some without data)
+    }
+
+    size_t GetNumSamplesWithLabel() const
+    {
+        return m_numSamplesWithLabel;
+    }
+
+    // forward, backprop and update of all shares concurrently, each worker with the gradient of its own share
+    // learnRatePerSample = 0 skips backprop and update.
+    void ForwardBackpropAndUpdate(double learnRatePerSample, double momentumPerSample, bool useNesterovMomentum)
+    {
+        int numOmpThreads = omp_get_max_threads();
+        omp_set_num_threads(1); // (the pool's workers already run their kernels on one core)
+        try
+        {
+            TaskPool::ParallelFor(0, m_workers.size(), [this, learnRatePerSample, momentumPerSample, useNesterovMomentum](size_t k)
+                                  {
+                                      Worker& worker = m_workers[k];
+                                      if (worker.m_actualMBSize == 0)
+                                          return;
+                                      worker.m_net->ForwardProp(worker.m_evaluationNodes);
+                                      worker.m_net->ForwardProp(worker.m_criterionNode);
+                                      if (learnRatePerSample == 0)
+                                          return;
+                                      worker.m_net->Backprop(worker.m_criterionNode);
+                                      Update(worker, learnRatePerSample, momentumPerSample, useNesterovMomentum);
+                                  });
+        }
+        catch (...)
+        {
+            omp_set_num_threads(numOmpThreads);
+            throw;
+        }
+        omp_set_num_threads(numOmpThreads);
+        for (auto& worker : m_workers)
+            for (const auto& node : worker.m_learnableNodes)
+                node->BumpEvalTimeStamp(); // (all of them see the updates)
+    }
+
+    // add the criterion values of all shares (1x1 matrices) to the accumulators
+    void AccumulateCriteria(Matrix<ElemType>& epochCriterion, Matrix<ElemType>& epochEvalErrors)
+    {
+        for (auto& worker : m_workers)
+        {
+            if (worker.m_actualMBSize == 0)
+                continue;
+            Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(worker.m_criterionNode)->Value(),
+                                                  0, 0, epochCriterion, 0, 0);
+            for (size_t i = 0; i < worker.m_evaluationNodes.size(); i++)
+                Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(worker.m_evaluationNodes[i])->Value(),
+                                                      0, 0, epochEvalErrors, 0, i);
+        }
+    }
+
+private:
+    struct Worker
+    {
+        ComputationNetworkPtr m_net;
+        ComputationNodeBasePtr m_criterionNode;
+        std::vector<ComputationNodeBasePtr> m_evaluationNodes;
+        std::list<ComputationNodeBasePtr> m_learnableNodes; // in the order of the network's
+        std::vector<Matrix<ElemType>> m_smoothedGradients;  // the worker's own momentum, one per learnable node
+        std::map<std::wstring, Matrix<ElemType>*> m_inputMatrices;
+        size_t m_actualMBSize;
+
+        Worker()
+            : m_actualMBSize(0)
+        {
+        }
+    };
+
+    static const size_t numLockStripes = 64;
+
+    // point the replicas' parameters at the network's buffers
+    void ShareParameters()
+    {
+        for (size_t k = 1; k < m_workers.size(); k++)
+        {
+            auto replicaNodeIter = m_workers[k].m_learnableNodes.begin();
+            for (const auto& node : m_workers[0].m_learnableNodes)
+            {
+                Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+                Matrix<ElemType>& replicaValue = dynamic_pointer_cast<ComputationNode<ElemType>>(*replicaNodeIter++)->Value();
+                if (replicaValue.BufferPointer() != value.BufferPointer())
+                    replicaValue.SetValue(value.GetNumRows(), value.GetNumCols(), CPUDEVICE, value.BufferPointer(), matrixFlagDontOwnBuffer);
+            }
+        }
+    }
+
+    // w -= lr * g, with momentum, into the shared parameters
+    void Update(Worker& worker, double learnRatePerSample, double momentumPerSample, bool useNesterovMomentum)
+    {
+        const ElemType momentum = (ElemType) pow(momentumPerSample, (double) worker.m_actualMBSize); // (as MomentumPerMB() in SGD.cpp)
+        size_t i = 0;
+        for (auto nodeIter = worker.m_learnableNodes.begin(); nodeIter != worker.m_learnableNodes.end(); nodeIter++, i++)
+        {
+            if (!(*nodeIter)->IsParameterUpdateRequired())
+                continue;
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            Matrix<ElemType>& value = node->Value();
+            Matrix<ElemType>& smoothedGradient = worker.m_smoothedGradients[i];
+            if (smoothedGradient.GetNumElements() != value.GetNumElements())
+            {
+                smoothedGradient.Resize(value.GetNumRows(), value.GetNumCols());
+                smoothedGradient.SetValue(0);
+            }
+            if (m_useStripedLocks)
+            {
+                std::lock_guard<std::mutex> lock(m_lockStripes[i % numLockStripes]);
+                smoothedGradient.NormalGrad(node->Gradient(), value, (ElemType) learnRatePerSample, momentum, useNesterovMomentum);
+            }
+            else
+                smoothedGradient.NormalGrad(node->Gradient(), value, (ElemType) learnRatePerSample, momentum, useNesterovMomentum);
+        }
+    }
+
+    // reader-facing bookkeeping after the inputs were replaced, as GetMinibatchIntoNetwork() does it
+    static void NotifyInputsModified(ComputationNetworkPtr net, const std::map<std::wstring, Matrix<ElemType>*>& inputMatrices)
+    {
+        for (size_t pass = 0; pass < 2; pass++)
+        {
+            auto& nodes = (pass == 0) ? net->FeatureNodes() : net->LabelNodes();
+            for (auto& node : nodes)
+            {
+                if (inputMatrices.find(node->NodeName()) == inputMatrices.end())
+                    continue;
+                node->NotifyFunctionValuesMBSizeModified();
+                node->BumpEvalTimeStamp();
+            }
+        }
+    }
+
+    size_t m_numWorkers;
+    bool m_useStripedLocks;
+    std::vector<Worker> m_workers;            // [0] is the network itself
+    std::mutex m_lockStripes[numLockStripes]; // parameter i takes lock i % numLockStripes
+    size_t m_numSamplesWithLabel;             // of the whole minibatch
+};
+} } }
@@ -2,6 +2,7 @@
 
 #include "DistGradHeader.h"
 #include "MPIWrapper.h"
+#include <atomic>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -10,7 +11,7 @@ class IDistGradAggregator
 {
 public:
     IDistGradAggregator(MPIWrapper* mpi)
-        : m_mpi(mpi)
+        : m_mpi(mpi), m_numBytesSent(0)
     {
     }
 
@@ -21,6 +22,28 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Overlapping the aggregation with backprop: after BeginOverlappedAggregation(), each gradient is reported through
+    // NotifyGradientReady() as soon as it is final, and the aggregator may start reducing it right away. The subsequent
+    // AggregateGradients() call (with the same gradients) completes the aggregation.
+    // The gradients must be listed in the order in which they become ready, which must be the same on all nodes.
+    virtual bool SupportsOverlappedAggregation() const
+    {
+        return false;
+    }
+
+    virtual void BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& /*gradients*/)
+    {
+    }
+
+    virtual void NotifyGradientReady(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
+    // the names of the parameters whose gradients are passed to AggregateGradients(), in the same order (for logging)
+    virtual void SetGradientNames(const std::vector<std::wstring>& /*names*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -36,14 +59,31 @@ public:
         m_mpi->WaitAll();
     }
 
+    // seconds this node has spent so far in the phases of the aggregation, if the aggregator records them: copying
+    // gradients between device and host memory (including packing them), exchanging the gradients through MPI, and
+    // exchanging the headers. As transfers overlap, these are the times the calling thread waited in each phase.
+    virtual bool GetPhaseSeconds(double& /*deviceCopySeconds*/, double& /*mpiSeconds*/, double& /*headerSeconds*/) const
+    {
+        return false;
+    }
+
+    // gradient payload this node has handed to MPI so far: the reduced buffers, or the encoded gradients sent to each
+    // peer (what actually goes over the wire also depends on the MPI implementation)
+    size_t GetNumBytesSent() const
+    {
+        return m_numBytesSent;
+    }
+
 protected:
     MPIWrapper* m_mpi;
+    std::atomic<size_t> m_numBytesSent; // (updated from the async aggregation thread)
 };
 
-#define UsingIDistGradAggregatorMembers           \
+#define UsingIDistGradAggregatorMembers                  \
     \
-protected:                                        \
-    using IDistGradAggregator<ElemType>::m_mpi;   \
-    using IDistGradAggregator<ElemType>::NumProc; \
+protected:                                               \
+    using IDistGradAggregator<ElemType>::m_mpi;          \
+    using IDistGradAggregator<ElemType>::m_numBytesSent; \
+    using IDistGradAggregator<ElemType>::NumProc;        \
     using IDistGradAggregator<ElemType>::MyRank
 } } }
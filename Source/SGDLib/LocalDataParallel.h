@@ -0,0 +1,295 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LocalDataParallel.h -- data-parallel training on several GPUs of one process (SGD's 'dataParallelDevices')
+//
+// The network is replicated onto each of the additional devices. Each minibatch, as read by the one reader, is split
+// by parallel sequences (in frame mode: by frames), the way DecimateMinibatch() splits it among MPI ranks: the network
+// keeps the first share, the replicas get theirs copied over. All of them then run forward and backprop concurrently,
+// each from its own thread, and the replicas' gradients are summed into the network's own, peer-to-peer. SGD updates
+// the network as usual, after which the new parameter values are copied out to the replicas again.
+//
+// Only the learnable parameters are kept in sync. Other state, such as the running statistics of BatchNormalization,
+// is that of the network's own share of the data.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class LocalDataParallel
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    LocalDataParallel(const std::vector<DEVICEID_TYPE>& devices)
+        : m_devices(devices), m_numSamplesWithLabel(0), m_netHasData(false)
+    {
+    }
+
+    size_t GetNumDevices() const
+    {
+        return m_replicas.size() + 1;
+    }
+
+    // Create the replicas by loading the network from a temporary model file onto each device.
+    // prepareNetwork() applies the options that SGD sets on the network before allocating it.
+    void Init(ComputationNetworkPtr net, const std::wstring& tempModelPath,
+              const std::list<ComputationNodeBasePtr>& learnableNodes,
+              const std::vector<ComputationNodeBasePtr>& evaluationNodes, const ComputationNodeBasePtr& criterionNode,
+              const std::function<void(ComputationNetworkPtr)>& prepareNetwork)
+    {
+        for (auto deviceId : m_devices)
+            if (deviceId < 0 || deviceId == net->GetDeviceId())
+                InvalidArgument("dataParallelDevices: %d is not a GPU other than the network's own (%d).", (int) deviceId, (int) net->GetDeviceId());
+
+        net->Save(tempModelPath);
+        for (auto deviceId : m_devices)
+        {
+            AllowAdditionalGPU(deviceId); // (exempt from EnforceOneGPUOnly())
+            m_replicas.push_back(Replica());
+            Replica& replica = m_replicas.back();
+            replica.m_net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, tempModelPath);
+            replica.m_criterionNode = replica.m_net->GetNodeFromName(criterionNode->NodeName());
+            for (const auto& node : evaluationNodes)
+                replica.m_evaluationNodes.push_back(replica.m_net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : learnableNodes)
+                replica.m_learnableNodes.push_back(replica.m_net->GetNodeFromName(node->NodeName()));
+            prepareNetwork(replica.m_net);
+            replica.m_net->AllocateAllMatrices(replica.m_evaluationNodes, {}, replica.m_criterionNode);
+            for (const auto& node : replica.m_net->FeatureNodes())
+                replica.m_inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            for (const auto& node : replica.m_net->LabelNodes())
+                replica.m_inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            replica.m_transferBuffer = make_shared<Matrix<ElemType>>(net->GetDeviceId());
+            fprintf(stderr, "LocalDataParallel: Replicated the network onto GPU %d.\n", (int) deviceId);
+        }
+        _wunlink(tempModelPath.c_str());
+    }
+
+    // start an epoch (or a trial in a learning-rate search) from the network's current parameters
+    void StartEpoch(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        CopyParametersToReplicas(learnableNodes);
+        for (auto& replica : m_replicas)
+        {
+            replica.m_net->StartEvaluateMinibatchLoop(replica.m_evaluationNodes);
+            replica.m_net->StartEvaluateMinibatchLoop(replica.m_criterionNode);
+        }
+    }
+
+    // Split the minibatch that was read into the network's inputs: the replicas get their shares, the network keeps
+    // the first. Remembers the number of samples with labels of the whole minibatch (see GetNumSamplesWithLabel()).
+    void DistributeMinibatch(ComputationNetworkPtr net, std::map<std::wstring, Matrix<ElemType>*>& inputMatrices, size_t actualMBSize)
+    {
+        m_numSamplesWithLabel = net->GetNumSamplesWithLabel(actualMBSize);
+        int numWorkers = (int) GetNumDevices();
+        for (size_t k = 0; k < m_replicas.size(); k++)
+        {
+            Replica& replica = m_replicas[k];
+            std::map<std::wstring, Matrix<ElemType>*> decimatedMB;
+            MBLayoutPtr pDecimatedMBLayout;
+            DataReaderHelpers::DecimateMinibatch(inputMatrices, decimatedMB, net->GetMBLayoutPtr(), pDecimatedMBLayout, numWorkers, (int) k + 1);
+            for (auto& iter : decimatedMB)
+            {
+                auto input = replica.m_inputMatrices.find(iter.first);
+                if (input != replica.m_inputMatrices.end())
+                {
+                    iter.second->TransferToDeviceIfNotThere(replica.m_net->GetDeviceId(), true);
+                    input->second->SetValue(*iter.second);
+                }
+                delete iter.second;
+            }
+            replica.m_net->GetMBLayoutPtr()->CopyFrom(pDecimatedMBLayout);
+            NotifyInputsModified(replica.m_net, replica.m_inputMatrices);
+            replica.m_actualMBSize = replica.m_net->DetermineActualMBSizeFromFeatures();
+        }
+        DataReaderHelpers::DecimateMinibatch(inputMatrices, numWorkers, 0, net->GetMBLayoutPtr());
+        NotifyInputsModified(net, inputMatrices);
+        m_netHasData = net->DetermineActualMBSizeFromFeatures() > 0; // (fewer parallel sequences than devices leave some without data)
+    }
+
+    size_t GetNumSamplesWithLabel() const
+    {
+        return m_numSamplesWithLabel;
+    }
+
+    // forward and backprop of all shares, each device from its own thread; the network's own from the calling one
+    void ForwardAndBackprop(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode,
+                            const std::vector<ComputationNodeBasePtr>& evaluationNodes, bool doBackprop, double lossScale)
+    {
+        std::vector<std::future<void>> replicasDone;
+        for (auto& replica : m_replicas)
+        {
+            if (replica.m_actualMBSize == 0)
+                continue;
+            Replica* r = &replica;
+            replicasDone.push_back(std::async(std::launch::async, [r, doBackprop, lossScale]()
+                                              {
+                                                  r->m_net->ForwardProp(r->m_evaluationNodes);
+                                                  r->m_net->ForwardProp(r->m_criterionNode);
+                                                  if (doBackprop)
+                                                      r->m_net->Backprop(r->m_criterionNode, lossScale);
+                                              }));
+        }
+        if (m_netHasData)
+        {
+            net->ForwardProp(evaluationNodes);
+            net->ForwardProp(criterionNode);
+            if (doBackprop)
+                net->Backprop(criterionNode, lossScale);
+        }
+        for (auto& done : replicasDone)
+            done.get(); // (rethrows)
+    }
+
+    // sum the replicas' gradients into the network's
+    void AggregateGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        for (const auto& node : learnableNodes)
+        {
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            Matrix<ElemType>& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+            if (!m_netHasData) // the network's gradients are from an earlier minibatch
+            {
+                const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+                gradient.Resize(value.GetNumRows(), value.GetNumCols());
+                gradient.SetValue(0);
+            }
+        }
+        for (auto& replica : m_replicas)
+        {
+            if (replica.m_actualMBSize == 0)
+                continue;
+            auto replicaNodeIter = replica.m_learnableNodes.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, replicaNodeIter++)
+            {
+                if (!(*nodeIter)->IsParameterUpdateRequired())
+                    continue;
+                Matrix<ElemType>& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Gradient();
+                Transfer(dynamic_pointer_cast<ComputationNode<ElemType>>(*replicaNodeIter)->Gradient(), gradient, *replica.m_transferBuffer, /*accumulate=*/true);
+            }
+        }
+    }
+
+    // add the criterion values of all shares (1x1 matrices) to the accumulators, which live on the network's device
+    void AccumulateCriteria(const ComputationNodeBasePtr& criterionNode, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                            Matrix<ElemType>& epochCriterion, Matrix<ElemType>& epochEvalErrors)
+    {
+        if (m_netHasData)
+            AccumulateCriteria(criterionNode, evaluationNodes, epochCriterion, epochEvalErrors, nullptr);
+        for (auto& replica : m_replicas)
+            if (replica.m_actualMBSize > 0)
+                AccumulateCriteria(replica.m_criterionNode, replica.m_evaluationNodes, epochCriterion, epochEvalErrors, replica.m_transferBuffer.get());
+    }
+
+    // after the update: copy the new parameters out to the replicas
+    void CopyParametersToReplicas(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        for (auto& replica : m_replicas)
+        {
+            auto replicaNodeIter = replica.m_learnableNodes.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, replicaNodeIter++)
+            {
+                Matrix<ElemType>& replicaValue = dynamic_pointer_cast<ComputationNode<ElemType>>(*replicaNodeIter)->Value();
+                Transfer(dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value(), replicaValue, *replica.m_transferBuffer, /*accumulate=*/false);
+                (*replicaNodeIter)->BumpEvalTimeStamp();
+            }
+        }
+    }
+
+private:
+    struct Replica
+    {
+        ComputationNetworkPtr m_net;
+        ComputationNodeBasePtr m_criterionNode;
+        std::vector<ComputationNodeBasePtr> m_evaluationNodes;
+        std::list<ComputationNodeBasePtr> m_learnableNodes; // in the order of the network's
+        std::map<std::wstring, Matrix<ElemType>*> m_inputMatrices;
+        size_t m_actualMBSize;
+        shared_ptr<Matrix<ElemType>> m_transferBuffer; // for copies between the replica's device and the network's
+
+        Replica()
+            : m_actualMBSize(0)
+        {
+        }
+    };
+
+    // reader-facing bookkeeping after the inputs were replaced, as GetMinibatchIntoNetwork() does it
+    static void NotifyInputsModified(ComputationNetworkPtr net, const std::map<std::wstring, Matrix<ElemType>*>& inputMatrices)
+    {
+        for (size_t pass = 0; pass < 2; pass++)
+        {
+            auto& nodes = (pass == 0) ? net->FeatureNodes() : net->LabelNodes();
+            for (auto& node : nodes)
+            {
+                if (inputMatrices.find(node->NodeName()) == inputMatrices.end())
+                    continue;
+                node->NotifyFunctionValuesMBSizeModified();
+                node->BumpEvalTimeStamp();
+            }
+        }
+    }
+
+    // to = from, or to += from, where 'to' may live on another device than 'from' (cf. DeviceTransferNode)
+    static void Transfer(const Matrix<ElemType>& from, Matrix<ElemType>& to, Matrix<ElemType>& buffer, bool accumulate)
+    {
+        if (from.GetDeviceId() == to.GetDeviceId())
+        {
+            if (accumulate)
+                to += from;
+            else
+                to.SetValue(from);
+            return;
+        }
+        buffer.Resize(0, 0); // (so that no stale content is moved along)
+        buffer.TransferToDeviceIfNotThere(from.GetDeviceId(), true);
+        buffer.SetValue(from);
+        buffer.TransferToDeviceIfNotThere(to.GetDeviceId(), true);
+        if (accumulate)
+            to += buffer;
+        else
+            to.SetValue(buffer);
+    }
+
+    static void AccumulateCriteria(const ComputationNodeBasePtr& criterionNode, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                   Matrix<ElemType>& epochCriterion, Matrix<ElemType>& epochEvalErrors, Matrix<ElemType>* buffer)
+    {
+        auto accumulate = [&](const ComputationNodeBasePtr& node, Matrix<ElemType>& accumulator, size_t j)
+        {
+            const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            if (buffer && value.GetDeviceId() != accumulator.GetDeviceId())
+            {
+                buffer->Resize(0, 0);
+                buffer->TransferToDeviceIfNotThere(value.GetDeviceId(), true);
+                buffer->SetValue(value);
+                buffer->TransferToDeviceIfNotThere(accumulator.GetDeviceId(), true);
+                Matrix<ElemType>::AddElementToElement(*buffer, 0, 0, accumulator, 0, j);
+            }
+            else
+                Matrix<ElemType>::AddElementToElement(value, 0, 0, accumulator, 0, j);
+        };
+        accumulate(criterionNode, epochCriterion, 0);
+        for (size_t i = 0; i < evaluationNodes.size(); i++)
+            accumulate(evaluationNodes[i], epochEvalErrors, i);
+    }
+
+    std::vector<DEVICEID_TYPE> m_devices;
+    std::vector<Replica> m_replicas;
+    size_t m_numSamplesWithLabel; // of the whole minibatch
+    bool m_netHasData;            // the network's own share is not empty
+};
+} } }
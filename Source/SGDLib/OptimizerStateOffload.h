@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// OptimizerStateOffload.h -- the optimizer state in host memory instead of on the GPU (SGD's 'offloadOptimizerState')
+//
+// The smoothed gradients (momentum; the squares of AdaGrad, RmsProp, FSAdaGrad, Adam) take one to three times the memory
+// of the parameters. With offloading, they live in page-locked host memory, and only one parameter's state at a time is
+// on the GPU: for each update, it is copied into a working buffer on the device, updated there together with the
+// parameter, and copied back. This costs two transfers of the state per update, in exchange for the device memory of
+// all but the largest state. The state is a regular CPU matrix otherwise (checkpoints, learning-rate search snapshots).
+//
+// The state is moved into page-locked memory once its size is final (some update rules size it on first use).
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "Matrix.h"
+#include <map>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class OptimizerStateOffload
+{
+public:
+    OptimizerStateOffload(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId), m_allocator(deviceId), m_deviceState(deviceId)
+    {
+        if (deviceId < 0)
+            InvalidArgument("offloadOptimizerState requires the network to be on a GPU.");
+    }
+
+    // the state of a parameter, as SGD creates it (zeroed, in host memory)
+    Matrix<ElemType> CreateState(size_t numRows, size_t numCols) const
+    {
+        return Matrix<ElemType>(numRows, numCols, CPUDEVICE);
+    }
+
+    // copy the state into the device buffer, for one update
+    // From page-locked memory, the copy is asynchronous: the update's kernels wait for it, the host does not.
+    Matrix<ElemType>& Fetch(const Matrix<ElemType>& hostState)
+    {
+        if (hostState.IsEmpty())
+        {
+            m_deviceState.Resize(0, 0); // (sized by the update)
+            return m_deviceState;
+        }
+        auto pinned = m_pinnedBuffers.find(&hostState);
+        bool isPinned = pinned != m_pinnedBuffers.end() && pinned->second.get() == hostState.BufferPointer();
+        m_deviceState.SetValue(hostState.GetNumRows(), hostState.GetNumCols(), m_deviceId, hostState.BufferPointer(),
+                               isPinned ? matrixFlagSetValueAsync : matrixFlagNormal);
+        return m_deviceState;
+    }
+
+    // copy the updated state from the device buffer back into host memory
+    void Store(Matrix<ElemType>& hostState)
+    {
+        Matrix<ElemType>::WaitForAsyncSetValues(m_deviceId); // (Fetch()'s copy may still be reading the host buffer)
+        const size_t numRows = m_deviceState.GetNumRows();
+        const size_t numCols = m_deviceState.GetNumCols();
+        auto& pinned = m_pinnedBuffers[&hostState];
+        if (!pinned || pinned.get() != hostState.BufferPointer() || hostState.GetNumRows() != numRows || hostState.GetNumCols() != numCols)
+        {
+            size_t numBytes = numRows * numCols * sizeof(ElemType);
+            ElemType* p = numBytes > 0 ? (ElemType*) m_allocator.Malloc(numBytes) : nullptr;
+            if (p == nullptr) // (nothing to pin)
+            {
+                hostState.Resize(numRows, numCols);
+                pinned.reset();
+            }
+            else
+            {
+                auto buffer = std::shared_ptr<ElemType>(p, [this](ElemType* q)
+                                                        {
+                                                            m_allocator.Free(q);
+                                                        });
+                hostState.SetValue(numRows, numCols, CPUDEVICE, p, matrixFlagDontOwnBuffer);
+                pinned = buffer; // (frees the buffer the state had been pinned to before, if any)
+            }
+        }
+        if (numRows * numCols > 0)
+            m_deviceState.CopySection(numRows, numCols, hostState.BufferPointer(), numRows); // (synchronous, so the host buffer is free again)
+    }
+
+    // device memory: that of the largest state
+    size_t GetDeviceBufferSize() const
+    {
+        return m_deviceState.BufferSize();
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    CUDAPageLockedMemAllocator m_allocator;
+    Matrix<ElemType> m_deviceState;                                    // working buffer, reused for all parameters
+    std::map<const Matrix<ElemType>*, std::shared_ptr<ElemType>> m_pinnedBuffers; // the host states' page-locked memory
+};
+} } }
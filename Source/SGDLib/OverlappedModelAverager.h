@@ -0,0 +1,145 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// OverlappedModelAverager.h -- model averaging for ModelAveragingSGD that does not stall training
+//
+// Instead of averaging the current models of all nodes while everybody waits, each sync takes a snapshot of the
+// local model and starts a non-blocking MPI_Iallreduce of it, which completes while the next block of minibatches
+// is trained. At the following sync, the average replaces the snapshot in the local model, keeping the local
+// progress made in the meantime:
+//      W <- W_global + (W - S)
+// where S is the snapshot and W_global the model obtained from the averages with block momentum eta (BMUF):
+//      G <- eta * G + (average - W_global);  W_global <- W_global + G
+// With eta = 0, W_global is just the average of the snapshots.
+//
+// MPI is initialized with MPI_THREAD_SERIALIZED, so the background reduction is a non-blocking collective that the
+// training thread drives with MPI_Test() after every minibatch, rather than a thread of its own.
+//
+
+#pragma once
+
+#include "MPIWrapper.h"
+#include "FlatParameterCopy.h"
+#include <climits>
+#include <list>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class OverlappedModelAverager
+{
+public:
+    OverlappedModelAverager(MPIWrapper* mpi, double blockMomentum)
+        : m_mpi(mpi), m_blockMomentum(blockMomentum), m_numElements(0), m_request(MPI_REQUEST_NULL), m_pending(false), m_haveGlobalModel(false)
+    {
+        if ((m_blockMomentum < 0) || (m_blockMomentum >= 1))
+            InvalidArgument("OverlappedModelAverager: blockMomentum must be in the range [0, 1).");
+    }
+
+    ~OverlappedModelAverager()
+    {
+        if (m_pending)
+            MPI_Wait(&m_request, MPI_STATUS_IGNORE);
+    }
+
+    // Blend in the result of the previous sync, and start averaging a snapshot of the current model.
+    // Returns the number of samples processed by all nodes since the last sync, like SGD::ModelAveragingSync().
+    size_t Sync(int nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        if (m_numElements == 0)
+            Allocate(learnableNodes);
+
+        int nTotalSamples = nSamplesSinceLastSync;
+        m_mpi->AllReduce(&nTotalSamples, 1);
+        ElemType factor = (nTotalSamples <= 0) ? (ElemType) 1 / m_mpi->NumNodesInUse() : (ElemType) nSamplesSinceLastSync / nTotalSamples;
+
+        Complete(learnableNodes);
+
+        FlatParameterCopy::Get(learnableNodes, m_snapshot);
+#pragma omp parallel for
+        for (long i = 0; i < (long) m_numElements; i++)
+            m_average[i] = factor * m_snapshot[i];
+        MPI_Iallreduce(MPI_IN_PLACE, m_average.data(), (int) m_numElements, MPIWrapper::GetDataType(m_average.data()), MPI_SUM, m_mpi->Communicator(), &m_request) || MpiFail("OverlappedModelAverager: MPI_Iallreduce");
+        m_pending = true;
+
+        return nTotalSamples;
+    }
+
+    // Let MPI make progress on the pending reduction; call between syncs (e.g. after each minibatch).
+    void Progress()
+    {
+        if (!m_pending)
+            return;
+        int flag = 0;
+        MPI_Test(&m_request, &flag, MPI_STATUS_IGNORE) || MpiFail("OverlappedModelAverager: MPI_Test");
+    }
+
+    // Finish the pending reduction at the end of an epoch; the caller then makes the models identical with a regular
+    // (blocking) model averaging, from which the next epoch starts afresh.
+    void EndEpoch(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        Complete(learnableNodes);
+        m_haveGlobalModel = false;
+        m_momentum.assign(m_numElements, 0);
+    }
+
+private:
+    // Wait for the pending reduction, if any, and blend it into the local model.
+    void Complete(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        if (!m_pending)
+            return;
+        MPI_Wait(&m_request, MPI_STATUS_IGNORE) || MpiFail("OverlappedModelAverager: MPI_Wait");
+        m_pending = false;
+
+        if (!m_haveGlobalModel)
+        {
+            m_global = m_average;
+            m_haveGlobalModel = true;
+        }
+        else
+        {
+#pragma omp parallel for
+            for (long i = 0; i < (long) m_numElements; i++)
+            {
+                m_momentum[i] = (ElemType) m_blockMomentum * m_momentum[i] + (m_average[i] - m_global[i]);
+                m_global[i] += m_momentum[i];
+            }
+        }
+
+        FlatParameterCopy::Get(learnableNodes, m_current);
+#pragma omp parallel for
+        for (long i = 0; i < (long) m_numElements; i++)
+            m_current[i] = m_global[i] + (m_current[i] - m_snapshot[i]);
+        FlatParameterCopy::Set(learnableNodes, m_current);
+    }
+
+    void Allocate(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        m_numElements = FlatParameterCopy::GetNumElements<ElemType>(learnableNodes);
+        if (m_numElements > INT_MAX)
+            RuntimeError("OverlappedModelAverager: models with more than %d parameters are not supported.", INT_MAX);
+
+        m_snapshot.resize(m_numElements);
+        m_average.resize(m_numElements);
+        m_global.resize(m_numElements);
+        m_momentum.assign(m_numElements, 0);
+        m_current.resize(m_numElements);
+    }
+
+    MPIWrapper* m_mpi;
+    double m_blockMomentum;
+    size_t m_numElements;
+
+    std::vector<ElemType> m_snapshot; // local model at the last sync
+    std::vector<ElemType> m_average;  // its weighted average over all nodes, being reduced in place
+    std::vector<ElemType> m_global;   // W_global
+    std::vector<ElemType> m_momentum; // G
+    std::vector<ElemType> m_current;  // scratch copy of the local model
+    MPI_Request m_request;
+    bool m_pending;
+    bool m_haveGlobalModel;
+};
+} } }
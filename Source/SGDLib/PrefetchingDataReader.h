@@ -0,0 +1,226 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PrefetchingDataReader.h -- read the next minibatch on a background thread while the current one is being trained on
+//
+// GetMinibatch() hands out the minibatch read ahead (copied into the caller's matrices on the device, so that the
+// network's input buffers keep their addresses), then starts reading the next one from the wrapped reader into buffers
+// of its own. The wrapped reader sees the same sequence of calls as without read-ahead, except that
+// DataEnd(endDataSentence), which SGD calls after each minibatch, is issued right after reading that minibatch; its
+// result is kept for SGD's call. All other calls first wait for the read in flight (the minibatch is kept).
+// The sample position (mid-epoch checkpoints) is that after the minibatch last handed out, recorded when it was read;
+// setting it drops the minibatch read ahead.
+// Readers in two-forward-pass mode (GetMinibatchCopy()) are passed through without read-ahead.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Sequences.h"
+#include <future>
+#include <map>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class PrefetchingDataReader : public IDataReader<ElemType>
+{
+public:
+    PrefetchingDataReader(IDataReader<ElemType>& reader)
+        : m_reader(reader), m_layout(make_shared<MBLayout>()), m_sentenceEnd(false), m_hasPrefetched(false), m_prefetchedDataRead(false), m_prefetchLayout(make_shared<MBLayout>()), m_prefetchSentenceEnd(false), m_samplePosition(0), m_prefetchSamplePosition(0), m_passThrough(false)
+    {
+    }
+    ~PrefetchingDataReader()
+    {
+        WaitForPrefetch();
+    }
+
+    virtual void Init(const ConfigParameters&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Destroy() override
+    {
+    }
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        WaitForPrefetch();
+        m_hasPrefetched = false; // belongs to the previous loop
+        m_reader.StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        m_samplePosition = 0;
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return m_reader.SupportsDistributedMBRead();
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+    {
+        WaitForPrefetch();
+        m_hasPrefetched = false;
+        m_reader.StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+        m_samplePosition = 0;
+    }
+    // (no dynamic distribution: its work-item callback talks to the other nodes, which must not happen from the read-ahead thread)
+
+    virtual bool SupportsSamplePositionSeek() const override
+    {
+        return !m_passThrough && m_reader.SupportsSamplePositionSeek();
+    }
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_samplePosition;
+    }
+    virtual void SetCurrentSamplePosition(size_t samplePosition) override
+    {
+        WaitForPrefetch();
+        m_hasPrefetched = false; // read before the new position
+        m_reader.SetCurrentSamplePosition(samplePosition);
+        m_samplePosition = samplePosition;
+    }
+
+    virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) override
+    {
+        if (m_passThrough)
+            return m_reader.GetMinibatch(matrices);
+
+        bool wasDataRead;
+        WaitForPrefetch();
+        if (m_hasPrefetched)
+        {
+            m_hasPrefetched = false;
+            wasDataRead = m_prefetchedDataRead;
+            if (wasDataRead)
+            {
+                for (auto& iter : matrices)
+                {
+                    auto prefetchMatrix = m_prefetchMatrices.find(iter.first);
+                    if (prefetchMatrix == m_prefetchMatrices.end())
+                        LogicError("PrefetchingDataReader: No matching prefetch matrix found for matrix named %ls.", iter.first.c_str());
+                    iter.second->SetValue(*prefetchMatrix->second);
+                }
+                std::swap(m_layout, m_prefetchLayout);
+                m_sentenceEnd = m_prefetchSentenceEnd;
+                m_samplePosition = m_prefetchSamplePosition;
+            }
+        }
+        else // first minibatch of the loop
+        {
+            wasDataRead = ReadMinibatch(matrices, m_layout, m_sentenceEnd, m_samplePosition);
+            if (wasDataRead)
+            {
+                m_prefetchMatrices.clear();
+                for (const auto& iter : matrices)
+                    m_prefetchMatrices[iter.first] = make_shared<Matrix<ElemType>>(iter.second->GetDeviceId());
+            }
+        }
+
+        if (wasDataRead)
+        {
+            DEVICEID_TYPE deviceId = matrices.empty() ? CPUDEVICE : matrices.begin()->second->GetDeviceId();
+            m_pendingPrefetch = std::async(std::launch::async, [this, deviceId]()
+                                           {
+                                               // Set the device since this will execute on a new thread
+                                               Matrix<ElemType>::SetDevice(deviceId);
+
+                                               std::map<std::wstring, Matrix<ElemType>*> prefetchMatrices;
+                                               for (auto& iter : m_prefetchMatrices)
+                                                   prefetchMatrices[iter.first] = iter.second.get();
+                                               return ReadMinibatch(prefetchMatrices, m_prefetchLayout, m_prefetchSentenceEnd, m_prefetchSamplePosition);
+                                           });
+        }
+        return wasDataRead;
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        if (m_passThrough)
+            m_reader.CopyMBLayoutTo(pMBLayout);
+        else
+            pMBLayout->CopyFrom(m_layout);
+    }
+    virtual bool DataEnd(EndDataType endDataType) override
+    {
+        if (!m_passThrough && endDataType == endDataSentence)
+            return m_sentenceEnd;
+        WaitForPrefetch();
+        return m_reader.DataEnd(endDataType);
+    }
+
+    virtual size_t GetNumParallelSequences() override
+    {
+        WaitForPrefetch();
+        return m_reader.GetNumParallelSequences();
+    }
+    virtual bool RequireSentenceSeg() const override
+    {
+        return m_reader.RequireSentenceSeg();
+    }
+
+    virtual bool GetMinibatchCopy(std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                                  std::map<std::wstring, Matrix<ElemType>*>& matrices,
+                                  MBLayoutPtr pMBLayout) override
+    {
+        WaitForPrefetch();
+        bool copied = m_reader.GetMinibatchCopy(uttInfo, matrices, pMBLayout);
+        if (copied)
+            m_passThrough = true; // the minibatches depend on the model outputs, so they cannot be read ahead
+        return copied;
+    }
+    virtual bool SetNetOutput(const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                              const Matrix<ElemType>& outputs,
+                              const MBLayoutPtr pMBLayout) override
+    {
+        WaitForPrefetch();
+        return m_reader.SetNetOutput(uttInfo, outputs, pMBLayout);
+    }
+
+private:
+    // one minibatch from the wrapped reader, with its layout, the DataEnd() result that SGD will ask for, and the
+    // wrapped reader's sample position after it (if it has one)
+    bool ReadMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices, MBLayoutPtr layout, bool& sentenceEnd, size_t& samplePosition)
+    {
+        if (!m_reader.GetMinibatch(matrices))
+            return false;
+        m_reader.CopyMBLayoutTo(layout);
+        sentenceEnd = m_reader.DataEnd(endDataSentence);
+        if (m_reader.SupportsSamplePositionSeek())
+            samplePosition = m_reader.GetCurrentSamplePosition();
+        return true;
+    }
+
+    // the read in flight must complete before the wrapped reader is used otherwise
+    void WaitForPrefetch()
+    {
+        if (m_pendingPrefetch.valid())
+        {
+            m_prefetchedDataRead = m_pendingPrefetch.get();
+            m_hasPrefetched = true;
+        }
+    }
+
+    IDataReader<ElemType>& m_reader;
+
+    MBLayoutPtr m_layout; // of the minibatch last handed out
+    bool m_sentenceEnd;
+
+    std::future<bool> m_pendingPrefetch;
+    bool m_hasPrefetched; // m_pendingPrefetch has completed, its minibatch was not handed out yet
+    bool m_prefetchedDataRead;
+    std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> m_prefetchMatrices;
+    MBLayoutPtr m_prefetchLayout;
+    bool m_prefetchSentenceEnd;
+
+    size_t m_samplePosition; // after the minibatch last handed out
+    size_t m_prefetchSamplePosition;
+
+    bool m_passThrough;
+};
+} } }
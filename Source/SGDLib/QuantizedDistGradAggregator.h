@@ -0,0 +1,365 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedDistGradAggregator.h -- gradient aggregation with compressed communication
+//
+// Each node compresses its gradients before exchanging them, in one of two ways:
+//  - N-bit quantization (gradientBits = 1, 2, 4, 8, or 16): every column is quantized by MatrixQuantizerImpl, as in
+//    1-bit SGD; 1 bit sends 1/32 of the float data
+//  - top-k sparsification (gradientTopKRatio > 0): only the largest values by magnitude are sent, as (index, value) pairs
+// Whatever was not sent (the quantization error, or the values that did not make it into the top k) is kept as a
+// residual and added to the next minibatch's gradient (error feedback), so that it is delayed rather than lost.
+//
+// With adaptiveGradientBits, the number of bits is chosen per gradient, between gradientBitsMin and gradientBitsMax.
+// Vectors (biases, batch-normalization parameters) are small and sensitive and always get gradientBitsMax; the others
+// start at gradientBits. Every few minibatches, the norm of each gradient and of its residual after quantization are
+// sampled; at the start of each epoch, the ratio of the two, summed over all nodes, decides: a residual that is larger
+// than the gradient means that the error feedback falls behind, and the bits are doubled; one that is much smaller means
+// that fewer bits would do, and they are halved. The decisions and statistics are logged per gradient.
+//
+// The compressed gradients are exchanged by all nodes with all nodes, and every node sums them up in rank order, so that
+// all nodes end up with bit-identical aggregates. Unlike the 1-bit SGD aggregator, the data is not striped (reduced and
+// re-quantized by a different node for each stripe), so each node receives (N-1) compressed gradients.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "MatrixQuantizerImpl.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <climits>
+#include <math.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class QuantizedDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    // numBits: bits per value for quantization (the initial ones if adaptiveBits, between minBits and maxBits);
+    // topKRatio: if > 0, send this fraction of each gradient's values instead
+    QuantizedDistGradAggregator(MPIWrapper* mpi, size_t numBits, bool zeroThresholdFor1Bit, double topKRatio, int syncStatsTrace,
+                                bool adaptiveBits = false, size_t minBits = 1, size_t maxBits = 8)
+        : IDistGradAggregator<ElemType>(mpi), m_numBits(numBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_topKRatio(topKRatio), m_adaptiveBits(adaptiveBits), m_minBits(minBits), m_maxBits(maxBits), m_adaptiveEpoch(-1), m_initialized(false), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    {
+        if (m_topKRatio > 0)
+        {
+            if (m_topKRatio > 1)
+                InvalidArgument("QuantizedDistGradAggregator: gradientTopKRatio must be in the range (0, 1].");
+            if (m_adaptiveBits)
+                InvalidArgument("QuantizedDistGradAggregator: adaptiveGradientBits cannot be combined with gradientTopKRatio.");
+        }
+        else
+        {
+            ValueQuantizer<ElemType>::ld(m_numBits); // fails if not a power of two
+            if (m_numBits >= 8 * sizeof(ElemType))
+                InvalidArgument("QuantizedDistGradAggregator: gradientBits must be less than %d.", (int) (8 * sizeof(ElemType)));
+            if (m_adaptiveBits)
+            {
+                ValueQuantizer<ElemType>::ld(m_minBits);
+                ValueQuantizer<ElemType>::ld(m_maxBits);
+                if (m_minBits > m_maxBits || m_maxBits >= 8 * sizeof(ElemType))
+                    InvalidArgument("QuantizedDistGradAggregator: gradientBitsMin must not exceed gradientBitsMax, which must be less than %d.", (int) (8 * sizeof(ElemType)));
+                m_numBits = std::min(std::max(m_numBits, m_minBits), m_maxBits);
+            }
+        }
+    }
+
+    void SetGradientNames(const std::vector<std::wstring>& names) override
+    {
+        m_gradientNames = names;
+    }
+
+    // Aggregate the gradient matrices across all nodes
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) override
+    {
+        // (the residuals are carried across epochs)
+        if (!m_initialized)
+            Initialize(gradients, headerCPU->numEvalNode);
+        if (m_adaptiveBits && (epochNumber != m_adaptiveEpoch))
+        {
+            if (m_adaptiveEpoch >= 0)
+                AdaptBits(epochNumber);
+            m_adaptiveEpoch = epochNumber;
+        }
+
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        // If the current node did not process any samples, it only contributes its residuals
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        AggregateHeaders(headerCPU);
+        if (m_topKRatio > 0)
+            AggregateTopK(gradients);
+        else
+            AggregateQuantized(gradients);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", aggregationTimer.ElapsedSeconds());
+        }
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // one entry of a sparsified gradient
+    struct SparseValue
+    {
+        unsigned int index; // into the gradient, viewed as a vector
+        ElemType value;
+    };
+
+    void Initialize(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNode)
+    {
+        int deviceId = gradients[0]->GetDeviceId();
+        for (auto gradient : gradients)
+        {
+            // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
+            if (gradient->GetMatrixType() != DENSE)
+                RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+        }
+
+        DistGradHeader* header = DistGradHeader::Create(numEvalNode);
+        m_headerSize = header->Size();
+        DistGradHeader::Destroy(header);
+        m_allHeaders.resize(NumProc() * m_headerSize);
+
+        if (m_topKRatio > 0)
+        {
+            for (auto gradient : gradients)
+            {
+                size_t numElements = gradient->GetNumElements();
+                if (numElements > UINT_MAX)
+                    RuntimeError("QuantizedDistGradAggregator: gradients of more than 4G elements cannot be sparsified.");
+                size_t k = std::max((size_t) 1, (size_t) ceil(m_topKRatio * numElements));
+                m_topKResiduals.push_back(std::vector<ElemType>(numElements, 0));
+                m_topKSendBuffers.push_back(std::vector<SparseValue>(k));
+                m_topKRecvBuffers.push_back(std::vector<SparseValue>(k * NumProc()));
+            }
+            fprintf(stderr, "QuantizedDistGradAggregator: sending the top %.3g%% of each gradient's values.\n", 100 * m_topKRatio);
+        }
+        else
+        {
+            if (deviceId != CPUDEVICE)
+                m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
+            m_quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(deviceId, /*useAsync=*/false));
+            m_quantizedGradients.resize(gradients.size());
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                size_t numRows = gradients[i]->GetNumRows(), numCols = gradients[i]->GetNumCols();
+                m_residuals.push_back(std::unique_ptr<Matrix<ElemType>>(new Matrix<ElemType>(numRows, numCols, deviceId)));
+                m_residuals.back()->SetValue(0);
+                bool isVector = (numRows == 1) || (numCols == 1);
+                AllocateQuantizedGradients(i, (m_adaptiveBits && isVector) ? m_maxBits : m_numBits);
+            }
+            if (m_adaptiveBits)
+            {
+                m_adaptiveStats.assign(2 * gradients.size(), 0);
+                fprintf(stderr, "QuantizedDistGradAggregator: quantizing the gradients to %d..%d bits, adapted per gradient (vectors: %d bits, others initially: %d bits).\n",
+                        (int) m_minBits, (int) m_maxBits, (int) m_maxBits, (int) m_numBits);
+            }
+            else
+                fprintf(stderr, "QuantizedDistGradAggregator: quantizing the gradients to %d bits.\n", (int) m_numBits);
+        }
+        m_initialized = true;
+    }
+
+    // the quantized gradients of all nodes, received into CPU memory (ours at index MyRank())
+    void AllocateQuantizedGradients(size_t i, size_t numBits)
+    {
+        std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>& quantizedGradients = m_quantizedGradients[i];
+        size_t numRows = m_residuals[i]->GetNumRows(), numCols = m_residuals[i]->GetNumCols();
+        quantizedGradients.clear();
+        for (size_t j = 0; j < NumProc(); j++)
+            quantizedGradients.push_back(std::unique_ptr<QuantizedMatrix<ElemType>>(new QuantizedMatrix<ElemType>(numRows, numCols, numBits, CPUDEVICE, m_allocator.get())));
+    }
+
+    // choose each gradient's bits for the epoch from the residual statistics of the previous one (of all nodes, so that
+    // all nodes decide the same)
+    void AdaptBits(int epochNumber)
+    {
+        const double raiseAbove = 1.0;  // residual norm / gradient norm above which the bits are doubled
+        const double lowerBelow = 0.25; // ... and below which they are halved
+
+        m_mpi->AllReduce(m_adaptiveStats);
+        bool log = m_mpi->IsMainNode();
+        if (log)
+            fprintf(stderr, "QuantizedDistGradAggregator: gradient bits for epoch %d:\n", epochNumber + 1);
+        size_t numBytes = 0, numBytesFloat = 0;
+        for (size_t i = 0; i < m_quantizedGradients.size(); i++)
+        {
+            size_t bits = m_quantizedGradients[i][0]->GetNumBits(), newBits = bits;
+            double residualSqr = m_adaptiveStats[2 * i], gradientSqr = m_adaptiveStats[2 * i + 1];
+            double ratio = gradientSqr > 0 ? sqrt(residualSqr / gradientSqr) : 0;
+            if (gradientSqr > 0 && ratio > raiseAbove && bits < m_maxBits)
+                newBits = bits * 2;
+            else if (gradientSqr > 0 && ratio < lowerBelow && bits > m_minBits)
+                newBits = bits / 2;
+            if (newBits != bits)
+                AllocateQuantizedGradients(i, newBits);
+
+            const Matrix<ElemType>& residual = *m_residuals[i];
+            numBytes += m_quantizedGradients[i][0]->GetSize();
+            numBytesFloat += residual.GetNumElements() * sizeof(ElemType);
+            if (log)
+                fprintf(stderr, "\t%ls [%d x %d]: residual/gradient %.3f, %d -> %d bits\n",
+                        i < m_gradientNames.size() ? m_gradientNames[i].c_str() : msra::strfun::wstrprintf(L"gradient %d", (int) i).c_str(),
+                        (int) residual.GetNumRows(), (int) residual.GetNumCols(), ratio, (int) bits, (int) newBits);
+        }
+        if (log)
+            fprintf(stderr, "QuantizedDistGradAggregator: %.1f KB per node and minibatch (%.1f%% of uncompressed).\n",
+                    numBytes / 1024.0, numBytesFloat > 0 ? 100.0 * numBytes / numBytesFloat : 0.0);
+        std::fill(m_adaptiveStats.begin(), m_adaptiveStats.end(), 0.0);
+    }
+
+    // exchange the headers of all nodes, and sum them up (in rank order, so that all nodes get the same result)
+    void AggregateHeaders(DistGradHeader* headerCPU)
+    {
+        if (headerCPU->Size() != m_headerSize)
+            LogicError("QuantizedDistGradAggregator: unexpected header size.");
+        MPI_Allgather(headerCPU, (int) m_headerSize, MPI_CHAR, m_allHeaders.data(), (int) m_headerSize, MPI_CHAR, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+        for (size_t j = 0; j < NumProc(); j++)
+            headerCPU->Aggregate((DistGradHeader*) &m_allHeaders[j * m_headerSize], /*add=*/j > 0);
+    }
+
+    void AggregateQuantized(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        const size_t numProc = NumProc(), myRank = MyRank();
+        std::vector<MPI_Request> requests;
+        requests.reserve(gradients.size() * 2 * (numProc - 1));
+        const size_t adaptiveStatsPeriod = 16; // (the norms cost a GPU sync each)
+        bool sampleStats = m_adaptiveBits && (m_iterationCount % adaptiveStatsPeriod == 1);
+
+        // quantize gradient + residual, keeping the quantization error as the new residual, and start sending it to each
+        // node while the next gradient is being quantized
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            QuantizedMatrix<ElemType>& ours = *m_quantizedGradients[i][myRank];
+            if (sampleStats)
+                m_adaptiveStats[2 * i + 1] += pow((double) gradients[i]->FrobeniusNorm(), 2);
+            m_quantizer->QuantizeAsync(*gradients[i], *m_residuals[i], ours, *m_residuals[i], m_zeroThresholdFor1Bit);
+            m_quantizer->WaitQuantizeAsyncDone();
+            if (sampleStats)
+                m_adaptiveStats[2 * i] += pow((double) m_residuals[i]->FrobeniusNorm(), 2);
+
+            for (size_t j = 0; j < numProc; j++)
+            {
+                if (j == myRank)
+                    continue;
+                QuantizedMatrix<ElemType>& theirs = *m_quantizedGradients[i][j];
+                requests.push_back(MPI_Request());
+                MPI_Irecv(theirs.GetArray(), (int) theirs.GetSize(), MPI_CHAR, (int) j, (int) i, m_mpi->Communicator(), &requests.back()) || MpiFail("MPI_Irecv");
+                requests.push_back(MPI_Request());
+                MPI_Isend(ours.GetArray(), (int) ours.GetSize(), MPI_CHAR, (int) j, (int) i, m_mpi->Communicator(), &requests.back()) || MpiFail("MPI_Isend");
+                m_numBytesSent += ours.GetSize();
+            }
+        }
+        MPI_Waitall((int) requests.size(), requests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+        // the aggregate is the sum of the unquantized gradients of all nodes (including our own quantized one)
+        // (on the GPU in one pass over all of them, reading them straight from the page-locked buffers)
+        std::vector<QuantizedMatrix<ElemType>*> quantizedGradients(numProc);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            for (size_t j = 0; j < numProc; j++)
+                quantizedGradients[j] = m_quantizedGradients[i][j].get();
+            m_quantizer->UnquantizeAndAccumulateAsync(quantizedGradients, *gradients[i]);
+            m_quantizer->WaitUnquantizeAsyncDone();
+        }
+    }
+
+    void AggregateTopK(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        std::vector<MPI_Request> requests(gradients.size());
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            // accumulate the residual, and select the k values of largest magnitude
+            std::vector<ElemType>& residual = m_topKResiduals[i];
+            std::unique_ptr<ElemType[]> values(gradients[i]->CopyToArray());
+            for (size_t p = 0; p < residual.size(); p++)
+                residual[p] += values[p];
+
+            std::vector<unsigned int> indices(residual.size());
+            for (size_t p = 0; p < indices.size(); p++)
+                indices[p] = (unsigned int) p;
+            std::vector<SparseValue>& sendBuffer = m_topKSendBuffers[i];
+            std::nth_element(indices.begin(), indices.begin() + (sendBuffer.size() - 1), indices.end(), [&residual](unsigned int a, unsigned int b)
+                             {
+                                 return fabs(residual[a]) > fabs(residual[b]);
+                             });
+
+            // what is sent is taken off the residual
+            for (size_t p = 0; p < sendBuffer.size(); p++)
+            {
+                sendBuffer[p].index = indices[p];
+                sendBuffer[p].value = residual[indices[p]];
+                residual[indices[p]] = 0;
+            }
+
+            size_t messageSize = sendBuffer.size() * sizeof(SparseValue);
+            MPI_Iallgather(sendBuffer.data(), (int) messageSize, MPI_CHAR, m_topKRecvBuffers[i].data(), (int) messageSize, MPI_CHAR, m_mpi->Communicator(), &requests[i]) || MpiFail("MPI_Iallgather");
+            m_numBytesSent += messageSize;
+        }
+
+        // scatter-add the values of all nodes into dense gradients
+        std::vector<ElemType> sum;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            MPI_Wait(&requests[i], MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+            sum.assign(gradients[i]->GetNumElements(), 0);
+            for (const auto& entry : m_topKRecvBuffers[i])
+                sum[entry.index] += entry.value;
+            gradients[i]->SetValue(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), gradients[i]->GetDeviceId(), sum.data());
+        }
+    }
+
+private:
+    size_t m_numBits;
+    bool m_zeroThresholdFor1Bit;
+    double m_topKRatio;
+
+    // adaptive bits
+    bool m_adaptiveBits;
+    size_t m_minBits;
+    size_t m_maxBits;
+    int m_adaptiveEpoch;                       // the epoch m_adaptiveStats are collected for
+    std::vector<double> m_adaptiveStats;       // [2 * gradient index + 0/1] sampled squared norms of the residual/gradient
+    std::vector<std::wstring> m_gradientNames; // [gradient index]
+
+    bool m_initialized;
+    size_t m_headerSize;
+    std::vector<char> m_allHeaders; // [NumProc() x m_headerSize]
+
+    // quantization
+    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> m_quantizer;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;                                // [gradient index]
+    std::vector<std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>> m_quantizedGradients; // [gradient index][node rank]
+
+    // top-k sparsification (on the CPU)
+    std::vector<std::vector<ElemType>> m_topKResiduals;      // [gradient index]
+    std::vector<std::vector<SparseValue>> m_topKSendBuffers; // [gradient index] k entries
+    std::vector<std::vector<SparseValue>> m_topKRecvBuffers; // [gradient index] k entries per node, in rank order
+
+    int m_syncStatsTrace;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+};
+} } }
@@ -7,13 +7,30 @@
 #include "NonlinearityNodes.h"          // for DropoutNode
 #include "PreComputeNodes.h"            // for PrecomputeNode
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "InputAndParamNodes.h"         // for LearnableParameter
+#include "TrainingNodes.h"              // for BatchNormalizationNode
+#include "CachingDataReader.h"
+#include "PrefetchingDataReader.h"
 #include "DataReaderHelpers.h"
 #include "MatrixQuantizerImpl.h"
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
 #include "AllReduceDistGradAggregator.h"
 #endif
 #include "SimpleDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
+#include "AsyncParameterServer.h"
+#include "OverlappedModelAverager.h"
+#include "LocalDataParallel.h"
+#include "HogwildTraining.h"
+#include "GradientAccumulator.h"
+#include "ElasticTraining.h"
+#include "AsyncCheckpointWriter.h"
 #include "ProgressTracing.h"
+#include "StartupTiming.h"
+#include "AsyncLog.h"
+#include "CUDADeviceCachingAllocator.h"
+#include "ExecutionProfiler.h"
+#include "DeviceTransferMonitor.h"
 
 #include <map>
 #include <set>
@@ -40,13 +57,23 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
                           IDataReader<ElemType>* trainSetDataReader,
                           IDataReader<ElemType>* validationSetDataReader,
                           const bool makeMode)
+{
+    int startEpoch;
+    ComputationNetworkPtr net = CreateOrLoadNetwork(createNetworkFn, deviceId, makeMode, startEpoch);
+    if (net)
+        TrainFromEpoch(net, startEpoch, trainSetDataReader, validationSetDataReader);
+}
+
+template <class ElemType>
+ComputationNetworkPtr SGD<ElemType>::CreateOrLoadNetwork(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                                                         const bool makeMode, int& startEpoch)
 {
     // determine which epoch to start with, including recoveing a checkpoint if any and 'makeMode' enabled
-    int startEpoch = DetermineStartEpoch(makeMode);
+    startEpoch = DetermineStartEpoch(makeMode);
     if (startEpoch == m_maxEpochs)
     {
         fprintf(stderr, "No further training is necessary.\n");
-        return;
+        return nullptr;
     }
 
     wstring modelFileName = GetModelNameForEpoch(int(startEpoch) - 1);
@@ -54,7 +81,11 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
         fprintf(stderr, "Starting from checkpoint. Load Network From File %ls.\n", modelFileName.c_str());
 
     // create or load from checkpoint
-    shared_ptr<ComputationNetwork> net = startEpoch < 0 ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    shared_ptr<ComputationNetwork> net;
+    {
+        StartupTiming::Phase startupPhase(startEpoch < 0 ? "building the network" : "loading the model");
+        net = startEpoch < 0 ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    }
 
     // log the device we are computing on
     if (net->GetDeviceId() < 0)
@@ -66,6 +97,14 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     // strategy should be to run the initializer above on mpiRank==0, and then broadcast parameters.
 
     startEpoch = max(startEpoch, 0);
+    return net;
+}
+
+template <class ElemType>
+void SGD<ElemType>::TrainFromEpoch(ComputationNetworkPtr net, int startEpoch,
+                                   IDataReader<ElemType>* trainSetDataReader,
+                                   IDataReader<ElemType>* validationSetDataReader)
+{
     m_needAdaptRegularization = false;
 
     TrainOrAdaptModel(startEpoch, net, net, nullptr, trainSetDataReader, validationSetDataReader);
@@ -128,6 +167,8 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
 // -----------------------------------------------------------------------
 
 static double MomentumPerMB(double momentumPerSample, size_t minibatchSize);
+template <class ElemType>
+static void PrintOptimizerStateMemory(FILE* f, const std::list<ComputationNodeBasePtr>& learnableNodes, const std::list<Matrix<ElemType>>& smoothedGradients);
 
 template <class ElemType>
 void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
@@ -163,6 +204,15 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
     }
 
+    // the criteria may have been found by name, so they are kept as they are
+    if (m_simplifyGraph)
+    {
+        std::vector<ComputationNodeBasePtr> keepNodes(criterionNodes.begin(), criterionNodes.end());
+        keepNodes.insert(keepNodes.end(), evaluationNodes.begin(), evaluationNodes.end());
+        net->MergeIdenticalNodes(keepNodes);
+        net->FoldConstants<ElemType>(keepNodes);
+    }
+
     std::vector<ComputationNodeBasePtr> additionalNodesToEvaluate;
     auto& outputNodes = net->OutputNodes();
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), outputNodes.cbegin(), outputNodes.cend());
@@ -171,7 +221,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    auto prepareNetwork = [this](ComputationNetworkPtr n) // (also applied to the replicas for dataParallelDevices)
+    {
+        n->SetTraceLevel(m_traceLevel);
+        n->SetGradientCheckpointing(m_gradientCheckpointing);
+        n->SetConcurrentForwardProp(m_concurrentForwardProp);
+        n->SetElementwiseFusion(m_elementwiseFusion);
+        n->SetSkipGapsInLoops(m_skipGapsInLoops);
+        n->SetSimpleRNNLoopFusion(m_simpleRNNLoopFusion);
+    };
+    prepareNetwork(net);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
+    if (m_memoryReport)
+        net->PrintMemoryReport(stderr, /*perSample=*/true);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
     // TODO: instead, remember the nodes directly, to be able to handle both float and double nodes; current version will crash for mixed networks
@@ -188,6 +250,22 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
     }
 
+    // knowledge distillation: the target input is computed by the teacher rather than read
+    if (!m_teacherModelPath.empty())
+    {
+        if (m_teacherOutputNodeName.empty() || m_distillationTargetNodeName.empty())
+            InvalidArgument("teacherModelPath requires teacherOutputNodeName and distillationTargetNodeName.");
+        if (!m_dataParallelDevices.empty())
+            InvalidArgument("Distillation (teacherModelPath) is not supported with dataParallelDevices.");
+        if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
+            InvalidArgument("Distillation (teacherModelPath) does not support cross-validation, since soft targets are only computed for the training data.");
+        auto targetNode = net->GetNodeFromName(m_distillationTargetNodeName);
+        inputMatrices->erase(m_distillationTargetNodeName);
+        DEVICEID_TYPE teacherDeviceId = m_teacherDeviceId != DEVICEID_NOTYETDETERMINED ? m_teacherDeviceId : net->GetDeviceId();
+        m_distillation.reset(new Distillation<ElemType>(teacherDeviceId, m_distillationTemperature, m_distillationTopK));
+        m_distillation->Init(m_teacherModelPath, m_teacherOutputNodeName, targetNode, *inputMatrices);
+    }
+
     // get hmm file for sequence training
     bool isSequenceTrainingCriterion = (criterionNodes[0]->OperationName() == L"SequenceWithSoftmax");
     if (isSequenceTrainingCriterion)
@@ -198,6 +276,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         trainSetDataReader->GetHmmData(hmm);
     }
 
+    // keep the training data in memory after the first epoch; later epochs replay it instead of reading it again
+    if (m_trainingDataCache != L"none")
+    {
+        if (m_epochSize != requestDataSize)
+            InvalidArgument("trainingDataCache requires each epoch to be a whole sweep over the data (epochSize=0).");
+        if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+            InvalidArgument("trainingDataCache is not supported with more than one MPI worker.");
+        if (isSequenceTrainingCriterion)
+            InvalidArgument("trainingDataCache is not supported for sequence training, whose reader also provides lattices.");
+        DEVICEID_TYPE cacheDeviceId = m_trainingDataCache == L"host" ? CPUDEVICE : net->GetDeviceId();
+        m_trainingDataCacheReader.reset(new TrainingDataCache<ElemType>(cacheDeviceId, m_trainingDataCacheMaxMB << 20));
+    }
+
     // used for KLD regularized adaptation. For all other adaptation techniques
     // use MEL to edit the model and using normal training algorithm
     // TODO: Should this be done in SGD::Adapt()?
@@ -227,16 +318,26 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto& learnableNodes = net->LearnableParameterNodes(criterionNodes[0]);
     std::list<Matrix<ElemType>> smoothedGradients;
 
+    if (m_offloadOptimizerState && net->GetDeviceId() < 0)
+        fprintf(stderr, "WARNING: offloadOptimizerState has no effect for a network on the CPU.\n");
+    else if (m_offloadOptimizerState && !m_optimizerStateOffload)
+        m_optimizerStateOffload.reset(new OptimizerStateOffload<ElemType>(net->GetDeviceId()));
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
         ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-        smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
-                                                     node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+        if (m_optimizerStateOffload)
+            smoothedGradients.push_back(m_optimizerStateOffload->CreateState(node->Value().GetNumRows(), node->Value().GetNumCols()));
+        else
+            smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
+                                                         node->Value().GetNumCols(),
+                                                         node->GetDeviceId()));
     }
+    if (m_memoryReport)
+        PrintOptimizerStateMemory(stderr, learnableNodes, smoothedGradients);
 
     double epochCriterion, avgCriterion, prevCriterion, lrControlCriterion;
     lrControlCriterion = epochCriterion = avgCriterion = prevCriterion = std::numeric_limits<double>::infinity();
+    double cvControlCriterion = std::numeric_limits<double>::infinity(); // latest CV result (background CV: none may be in yet)
     size_t epochsNotCountedInAvgCriterion = startEpoch % m_learnRateAdjustInterval;
 
     std::vector<double> epochEvalErrors(evaluationNodes.size(), std::numeric_limits<double>::infinity());
@@ -262,8 +363,49 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     {
         InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
     }
+    else if ((m_parallelizationMethod == ParallelizationMethod::AsyncParameterServerSGD) && (m_parameterServer == nullptr))
+    {
+        m_parameterServer = new AsyncParameterServer<ElemType>(g_mpi, m_parameterServerSyncPeriod, m_parameterServerMaxStaleness, m_syncStatsTrace);
+    }
+    else if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) && m_overlapModelAveraging && (m_modelAverager == nullptr))
+    {
+        m_modelAverager = new OverlappedModelAverager<ElemType>(g_mpi, m_blockMomentum);
+    }
+    if (!m_elasticPortFile.empty() && (m_elastic == nullptr))
+    {
+        if (m_elasticJoin && startEpoch == 0)
+            InvalidArgument("elasticJoin requires the model and checkpoint files of the job to join, to start from.");
+        m_elastic = new ElasticTraining<ElemType>(m_elasticPortFile, m_elasticJoin);
+    }
+    if (!m_checkPointStagingDir.empty() && (m_checkPointWriter == nullptr))
+    {
+        m_checkPointWriter = new AsyncCheckpointWriter(m_checkPointStagingDir);
+    }
+    if (m_asyncProgressLog)
+        AsyncLog::Start();
+    if (m_gpuSamplingInterval > 0 && net->GetDeviceId() >= 0 && !m_gpuWatcher)
+    {
+        m_gpuWatcher.reset(new GPUWatcher());
+        m_gpuWatcher->StartSampling(net->GetDeviceId(), m_gpuSamplingInterval);
+    }
+    if (!m_metricsFile.empty() && !m_trainingMetrics)
+    {
+        wstring metricsFile = m_metricsFile;
+        int rank = 0;
+        if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+        {
+            rank = (int) g_mpi->CurrentNodeRank();
+            metricsFile += msra::strfun::wstrprintf(L".rank%d", rank);
+        }
+        m_trainingMetrics.reset(new TrainingMetrics(metricsFile, m_metricsExportInterval, rank, net->GetDeviceId(), m_gpuWatcher.get()));
+    }
     // precompute mean and invStdDev nodes and save initial model
-    if (PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || startEpoch == 0)
+    bool didPreCompute;
+    {
+        StartupTiming::Phase startupPhase("PreCompute");
+        didPreCompute = PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices);
+    }
+    if (didPreCompute || startEpoch == 0)
     {
         // Synchronize all ranks before writing the model to ensure that
         // everyone is done loading the model
@@ -275,6 +417,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         net->Save(GetModelNameForEpoch(int(startEpoch) - 1));
     }
 
+    // single-process data parallelism: replicate the network, including its precomputed statistics, onto the other GPUs
+    if (!m_dataParallelDevices.empty() && (m_localDataParallel == nullptr))
+    {
+        if (isSequenceTrainingCriterion || (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode))
+            InvalidArgument("dataParallelDevices is not supported with sequence training or KL-regularized adaptation.");
+        m_localDataParallel = new LocalDataParallel<ElemType>(m_dataParallelDevices);
+        m_localDataParallel->Init(net, m_modelPath + L".replica", learnableNodes, evaluationNodes, criterionNodes[0], prepareNetwork);
+    }
+
+    // lock-free multithreaded training on the CPU: the replicas share the network's parameters
+    if (m_hogwildThreads > 1 && (m_hogwild == nullptr))
+    {
+        if (isSequenceTrainingCriterion || (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode) || m_distillation)
+            InvalidArgument("hogwildThreads is not supported with sequence training, KL-regularized adaptation or distillation.");
+        m_hogwild = new HogwildTraining<ElemType>(m_hogwildThreads, m_hogwildStripedLocks);
+        m_hogwild->Init(net, m_modelPath + L".replica", learnableNodes, evaluationNodes, criterionNodes[0], prepareNetwork);
+    }
+
     bool learnRateInitialized = false;
     if (startEpoch > 0)
     {
@@ -315,6 +475,54 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                   m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
     }
 
+    if (m_cvDeviceId != DEVICEID_NOTYETDETERMINED && validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
+    {
+        if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+            InvalidArgument("cvDeviceId is not supported with parallel training; cross-validation runs on all nodes then.");
+        m_backgroundCV.reset(new BackgroundCrossValidation<ElemType>(m_cvDeviceId, m_cvMaxDelay, m_modelPath + L".cv"));
+    }
+
+    // elastic training: the training state that carries over to the next epoch, from the main node to processes that join
+    auto broadcastElasticState = [&](int& nextEpoch)
+    {
+        std::vector<double> state = {(double) nextEpoch, learnRatePerSample, (double) totalSamplesSeen, prevCriterion, avgCriterion, cvControlCriterion,
+                                     (double) epochsNotCountedInAvgCriterion, (double) learnRateReduced, (double) learnRateInitialized, learningRateAdjustmentFactor,
+                                     (double) dropOutSeed, prevDropoutRate, (double) m_prevChosenMinibatchSize, m_lossScale, (double) m_numMBsSinceLossScaleChange,
+                                     (double) m_numParameterUpdates, m_lastFinishedEpochTrainLoss};
+        state.insert(state.end(), prevLearnRates.begin(), prevLearnRates.end());
+        m_elastic->BroadcastState(learnableNodes, smoothedGradients, state);
+        size_t k = 0;
+        nextEpoch = (int) state[k++];
+        learnRatePerSample = state[k++];
+        totalSamplesSeen = (size_t) state[k++];
+        prevCriterion = state[k++];
+        avgCriterion = state[k++];
+        cvControlCriterion = state[k++];
+        epochsNotCountedInAvgCriterion = (size_t) state[k++];
+        learnRateReduced = state[k++] != 0;
+        learnRateInitialized = state[k++] != 0;
+        learningRateAdjustmentFactor = state[k++];
+        dropOutSeed = (unsigned long) state[k++];
+        prevDropoutRate = state[k++];
+        m_prevChosenMinibatchSize = (size_t) state[k++];
+        m_lossScale = state[k++];
+        m_numMBsSinceLossScaleChange = (size_t) state[k++];
+        m_numParameterUpdates = (size_t) state[k++];
+        m_lastFinishedEpochTrainLoss = state[k++];
+        std::copy(state.begin() + k, state.end(), prevLearnRates.begin());
+
+        // the gradient aggregator is set up for a fixed set of nodes (this drops the residuals of compressed aggregation)
+        delete m_distGradAgg;
+        m_distGradAgg = nullptr;
+        InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
+    };
+    if (m_elastic && m_elastic->IsJoiner())
+    {
+        m_elastic->Join();
+        broadcastElasticState(startEpoch);
+        fprintf(stderr, "ElasticTraining: joined as worker %d of %d, continuing with epoch %d\n", (int) g_mpi->CurrentNodeRank(), (int) g_mpi->NumNodesInUse(), startEpoch + 1);
+    }
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -413,12 +621,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         fprintf(stderr, "Starting Epoch %d: learning rate per sample = %f  effective momentum = %f  momentum as time constant = %.1f samples\n",
                 i + 1, learnRatePerSample, MomentumPerMB(momentumPerSample, actualMinibatchSize), momentumAsTimeConstant);
 
+        IDataReader<ElemType>* epochDataReader = trainSetDataReader;
+        if (m_trainingDataCacheReader)
+        {
+            m_trainingDataCacheReader->SetReader(trainSetDataReader);
+            epochDataReader = m_trainingDataCacheReader.get();
+        }
         TrainOneEpoch(net,
                       refNet,
                       refNode,
                       i,
                       m_epochSize,
-                      trainSetDataReader,
+                      epochDataReader,
                       learnRatePerSample,
                       chosenMinibatchSize,
                       featureNodes,
@@ -427,7 +641,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                       evaluationNodes,
                       inputMatrices,
                       learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors, totalSamplesSeen);
+                      epochCriterion, epochEvalErrors, totalSamplesSeen,
+                      "", /*midEpochCheckPoints=*/true);
+
+        if (!m_streamingPreComputeNodes.empty())
+            FinishStreamingPreCompute();
 
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
@@ -478,46 +696,70 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                         i + 1, (int) m_maxEpochs, evalNodeNames[j].c_str(), epochEvalErrors[j]);
             }
         }
+        if (m_memoryReport)
+        {
+            net->PrintMemoryReport(stderr, /*perSample=*/false);
+            PrintOptimizerStateMemory(stderr, learnableNodes, smoothedGradients);
+        }
+        if ((m_traceLevel > 0 || m_memoryReport) && net->GetDeviceId() >= 0)
+            CUDADeviceCachingAllocator::ForDevice(net->GetDeviceId()).PrintStatistics(stderr);
 
-        if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+        // cross-validation runs on all nodes, each on its share of the data
+        // With a cvDeviceId, it runs in the background instead, and the results of earlier epochs are picked up here.
+        if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
         {
-            if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
+            vector<wstring> cvSetTrainAndEvalNodes;
+            if (criterionNodes.size() > 0)
             {
-                SimpleEvaluator<ElemType> evalforvalidation(net);
-                vector<wstring> cvSetTrainAndEvalNodes;
-                if (criterionNodes.size() > 0)
-                {
-                    cvSetTrainAndEvalNodes.push_back(criterionNodes[0]->NodeName());
-                }
-                if (evaluationNodes.size() > 0)
-                {
-                    cvSetTrainAndEvalNodes.push_back(evaluationNodes[0]->NodeName());
-                }
+                cvSetTrainAndEvalNodes.push_back(criterionNodes[0]->NodeName());
+            }
+            if (evaluationNodes.size() > 0)
+            {
+                cvSetTrainAndEvalNodes.push_back(evaluationNodes[0]->NodeName());
+            }
+
+            std::vector<std::pair<size_t, vector<double>>> cvResults;
+            if (m_backgroundCV)
+            {
+                m_backgroundCV->Start(net, i, validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                cvResults = m_backgroundCV->Collect(i, /*waitForAll=*/false);
+            }
+            else
+            {
+                SimpleEvaluator<ElemType> evalforvalidation(net, 100, 0, g_mpi);
+                cvResults.push_back(std::make_pair((size_t) i, evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i])));
+            }
 
-                vector<double> vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
-                fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", i + 1, (int) m_maxEpochs, vScore[0]);
+            for (const auto& cvResult : cvResults)
+            {
+                const vector<double>& vScore = cvResult.second;
+                fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", (int) cvResult.first + 1, (int) m_maxEpochs, vScore[0]);
                 if (vScore.size() > 1)
                 {
                     fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
                 }
                 fprintf(stderr, "\n");
 
-                if (m_useCVSetControlLRIfCVExists)
+                if (m_useEvalCriterionControlLR && vScore.size() > 1)
                 {
-                    if (m_useEvalCriterionControlLR && vScore.size() > 1)
-                    {
-                        lrControlCriterion = vScore[1];
-                    }
-                    else
-                    {
-                        lrControlCriterion = vScore[0]; // the first one is the training criterion
-                    }
+                    cvControlCriterion = vScore[1];
+                }
+                else
+                {
+                    cvControlCriterion = vScore[0]; // the first one is the training criterion
                 }
             }
+
+            // (until the first background result is in, infinity, which the adjustment below ignores)
+            if (m_useCVSetControlLRIfCVExists)
+            {
+                lrControlCriterion = cvControlCriterion;
+            }
         }
 
         // broadcast epochCriterion to make sure each processor will have the same learning rate schedule
-        if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) && (g_mpi->NumNodesInUse() > 1))
+        if (((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) || (m_parallelizationMethod == ParallelizationMethod::AsyncParameterServerSGD)) &&
+            (g_mpi->NumNodesInUse() > 1))
         {
             g_mpi->Bcast(&epochCriterion, 1, g_mpi->MainNodeRank());
             g_mpi->Bcast(&lrControlCriterion, 1, g_mpi->MainNodeRank());
@@ -544,6 +786,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             {
                 if (m_loadBestModel)
                 {
+                    WaitForCheckPointFiles();
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     fprintf(stderr, "Loading previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
@@ -623,28 +866,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // persist model and check-point info
         if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+            SaveModel(net, GetModelNameForEpoch(i));
+        SaveCheckPointInfo(i, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
+        if (m_numMBsToCheckPoint > 0)
+            DeleteMidEpochCheckPointFiles(i);
+        if (!m_keepCheckPointFiles)
         {
-            net->Save(GetModelNameForEpoch(i));
-            SaveCheckPointInfo(i, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
-            if (!m_keepCheckPointFiles)
+            // delete previous checkpoint file to save space
+            if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
             {
-                // delete previous checkpoint file to save space
-                if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
+                if (epochsSinceLastLearnRateAdjust != 1)
                 {
-                    if (epochsSinceLastLearnRateAdjust != 1)
-                    {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
-                    }
-                    if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
-                    {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
-                    }
+                    DeleteCheckPointFiles(i - 1);
                 }
-                else
+                if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                 {
-                    _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                    DeleteCheckPointFiles(i - m_learnRateAdjustInterval);
                 }
             }
+            else
+            {
+                DeleteCheckPointFiles(i - 1);
+            }
         }
 
         if (learnRatePerSample < 1e-12)
@@ -652,9 +895,56 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             fprintf(stderr, "learnRate per sample is reduced to %.8g which is below 1e-12. stop training.\n",
                     learnRatePerSample);
         }
+
+        // elastic training: workers leave and join here, between the checkpoint and the next epoch
+        if (m_elastic && i + 1 < (int) m_maxEpochs)
+        {
+            auto change = m_elastic->UpdateMembership();
+            if (change == ElasticTraining<ElemType>::MembershipChange::Stop)
+            {
+                fprintf(stderr, "ElasticTraining: stopping after epoch %d as requested; restart from its checkpoint to continue.\n", i + 1);
+                break;
+            }
+            else if (change == ElasticTraining<ElemType>::MembershipChange::Left)
+            {
+                fprintf(stderr, "ElasticTraining: left the job after epoch %d.\n", i + 1);
+                break;
+            }
+            else if (change == ElasticTraining<ElemType>::MembershipChange::Changed)
+            {
+                int nextEpoch = i + 1;
+                broadcastElasticState(nextEpoch);
+                fprintf(stderr, "ElasticTraining: continuing with %d workers\n", (int) g_mpi->NumNodesInUse());
+            }
+        }
     }
     // --- END OF MAIN EPOCH LOOP
 
+    if (m_checkPointWriter != nullptr)
+    {
+        m_checkPointWriter->Wait();
+    }
+    m_trainingMetrics.reset(); // (writes the last snapshot)
+    m_gpuWatcher.reset();
+    m_distillation.reset();
+    if (m_backgroundCV)
+    {
+        for (const auto& cvResult : m_backgroundCV->Collect(m_maxEpochs, /*waitForAll=*/true))
+        {
+            const vector<double>& vScore = cvResult.second;
+            fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", (int) cvResult.first + 1, (int) m_maxEpochs, vScore[0]);
+            if (vScore.size() > 1)
+            {
+                fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
+            }
+            fprintf(stderr, "\n");
+        }
+        m_backgroundCV.reset();
+    }
+    m_trainingDataCacheReader.reset();
+    delete m_elastic; // (closes the port)
+    m_elastic = nullptr;
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     if (g_mpi != nullptr)
@@ -704,13 +994,19 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     /*out*/ double& epochCriterion,
                                     /*out*/ std::vector<double>& epochEvalErrors,
                                     /*out*/ size_t& totalSamplesSeen,
-                                    std::string prefixMsg)
+                                    std::string prefixMsg,
+                                    bool midEpochCheckPoints)
 {
     double totalTimeInMBs = 0; // use double since timer has sub-microsecond time resolution
     double epochCriterionLastMBs = 0;
+    GPUActivity gpuActivityLastMBs = m_gpuWatcher ? m_gpuWatcher->GetActivity() : GPUActivity();
 
     int numSamplesLastMBs = 0;
     std::vector<double> epochEvalErrorsLastMBs(epochEvalErrors.size(), 0);
+    double minNodeSamplesPerSecondLastMBs = 0; // slowest and fastest node in data-parallel training (0: none reported)
+    double maxNodeSamplesPerSecondLastMBs = 0;
+    if (m_trainingMetrics)
+        m_trainingMetrics->m_epoch = epochNumber + 1;
 
     // initialize statistics
     size_t totalEpochSamples = 0;
@@ -730,7 +1026,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                    (epochNumber >= m_parallelizationStartEpochNum));
     bool useModelAveraging = ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) &&
                               (epochNumber >= m_parallelizationStartEpochNum));
-    bool useParallelTrain = useGradientAggregation || useModelAveraging;
+    bool useParameterServer = ((m_parallelizationMethod == ParallelizationMethod::AsyncParameterServerSGD) &&
+                               (epochNumber >= m_parallelizationStartEpochNum) && (g_mpi->NumNodesInUse() > 1));
+    bool useParallelTrain = useGradientAggregation || useModelAveraging || useParameterServer;
 
     // MA-related variables
     size_t nSamplesSinceLastModelSync = 0;
@@ -739,21 +1037,73 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     float nSecondsSinceLastMAPerfReport = 0;
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    bool overlapGradientAggregation = useGradientAggregation && m_overlapGradientAggregation && m_distGradAgg->SupportsOverlappedAggregation();
     if (useGradientAggregation)
     {
         epochCriterion = double(0.0);
         epochEvalErrors.assign(epochEvalErrors.size(), double(0.0));
     }
 
+    // sampled-softmax criteria sample until the end of the epoch; cross-validation and other evaluations use the full softmax
+    ComputationNetwork::SetSampledSoftmaxTraining<ElemType>(net, criterionNodes[0], true);
+
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
     m_numMBsToCUDAProfile = 0;
 
+    // per-node and per-phase timing of the first minibatches of this epoch
+    size_t numMBsToProfileExecution = m_numMBsToProfileExecution;
+    m_numMBsToProfileExecution = 0;
+    auto finishExecutionProfiling = [&]()
+    {
+        auto executionProfiler = ExecutionProfiler::Active();
+        if (!executionProfiler)
+            return;
+        executionProfiler->WriteSummary(stderr);
+        wstring traceFile = m_executionTraceFile.empty() ? m_modelPath + L".trace.json" : m_executionTraceFile;
+        if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+            traceFile += msra::strfun::wstrprintf(L".rank%d", (int) g_mpi->CurrentNodeRank());
+        executionProfiler->WriteChromeTrace(traceFile);
+        fprintf(stderr, "Execution trace written to %ls\n", traceFile.c_str());
+        ExecutionProfiler::Stop();
+    };
+    if (numMBsToProfileExecution > 0 && (m_localDataParallel || m_hogwild))
+    {
+        fprintf(stderr, "WARNING: numMBsToProfileExecution is not supported with dataParallelDevices or hogwildThreads and will be ignored.\n");
+        numMBsToProfileExecution = 0;
+    }
+    if (numMBsToProfileExecution > 0)
+        ExecutionProfiler::Start(net->GetDeviceId());
+
+    DeviceTransferMonitor::SetMode(m_implicitDeviceTransfers);
+
     bool useDistributedMBReading = useParallelTrain &&
                                    m_enableDistributedMBReading &&
                                    trainSetDataReader->SupportsDistributedMBRead();
-    if (useDistributedMBReading)
+    bool useDynamicDataDistribution = useDistributedMBReading && m_dynamicDataDistribution;
+    if (useDynamicDataDistribution && !trainSetDataReader->SupportsDynamicDistributedMBRead())
+    {
+        fprintf(stderr, "WARNING: dynamicDataDistribution is not supported by this reader; distributing the data statically.\n");
+        useDynamicDataDistribution = false;
+    }
+    // read the next minibatch while this one is trained on
+    // Not for sequence training, whose reader also hands out lattices per minibatch (GetMinibatch4SE()).
+    unique_ptr<PrefetchingDataReader<ElemType>> prefetchingReader;
+    if (m_prefetchMinibatches && !useDynamicDataDistribution && criterionNodes[0]->OperationName() != L"SequenceWithSoftmax")
+    {
+        prefetchingReader.reset(new PrefetchingDataReader<ElemType>(*trainSetDataReader));
+        trainSetDataReader = prefetchingReader.get();
+    }
+
+    if (useDynamicDataDistribution)
+    {
+        // the epoch is handed out in blocks through a counter on the main node, so faster nodes get more of it
+        g_mpi->ResetWorkQueue();
+        trainSetDataReader->StartDynamicDistributedMinibatchLoop(tunedMBSize, epochNumber, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(),
+                                                                 []() { return g_mpi->NextWorkItem(); }, tunedMBSize * m_workItemSizeInMinibatches, epochSize);
+    }
+    else if (useDistributedMBReading)
     {
         trainSetDataReader->StartDistributedMinibatchLoop(tunedMBSize, epochNumber, g_mpi->CurrentNodeRank(),
                                                           g_mpi->NumNodesInUse(), epochSize);
@@ -763,6 +1113,39 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, epochSize);
     }
 
+    // mid-epoch checkpoints: continue the epoch from the last one if it was interrupted, and write them as it proceeds
+    // They need all nodes at the same model after each update, and a reader that can report and restore its position.
+    bool useMidEpochCheckPoints = midEpochCheckPoints && (m_numMBsToCheckPoint > 0);
+    if (useMidEpochCheckPoints && (useModelAveraging || useParameterServer || useDynamicDataDistribution || (useGradientAggregation && m_bufferedAsyncGradientAggregation) ||
+                                   !trainSetDataReader->SupportsSamplePositionSeek()))
+    {
+        fprintf(stderr, "WARNING: numMBsToCheckPoint is not supported with this reader or parallelization method; no mid-epoch checkpoints are written.\n");
+        useMidEpochCheckPoints = false;
+    }
+    if (useMidEpochCheckPoints)
+    {
+        MidEpochState midEpochState;
+        if (LoadMidEpochCheckPoint(net, epochNumber, tunedMBSize, epochEvalErrors.size(), midEpochState, smoothedGradients))
+        {
+            numMBsRun = (int) midEpochState.numMBsRun;
+            totalEpochSamples = midEpochState.totalEpochSamples;
+            totalSamplesSeen += midEpochState.totalEpochSamples;
+            epochCriterion = epochCriterionLastMBs = midEpochState.epochCriterion;
+            epochEvalErrors = epochEvalErrorsLastMBs = midEpochState.epochEvalErrors;
+            if (!useGradientAggregation)
+            {
+                localEpochCriterion.SetValue((ElemType) epochCriterion);
+                vector<ElemType> evalErrors(epochEvalErrors.begin(), epochEvalErrors.end());
+                if (!evalErrors.empty())
+                    localEpochEvalErrors.SetValue(1, evalErrors.size(), net->GetDeviceId(), evalErrors.data());
+            }
+            size_t rank = (g_mpi != nullptr) ? g_mpi->CurrentNodeRank() : 0;
+            trainSetDataReader->SetCurrentSamplePosition(midEpochState.samplePositions[rank]);
+            fprintf(stderr, "Continuing epoch %d from its mid-epoch checkpoint after %d minibatches (%d samples).\n",
+                    epochNumber + 1, numMBsRun, (int) totalEpochSamples);
+        }
+    }
+
     net->StartEvaluateMinibatchLoop(evaluationNodes);
     net->StartEvaluateMinibatchLoop(criterionNodes);
     if (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode)
@@ -773,6 +1156,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // prepare for sub-minibatching
     // Sub-minibatching is used if a single minibatch is too large to fit into GPU RAM.
     DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
+    GradientAccumulator<ElemType> gradientAccumulator(m_gradientAccumulationSteps);
     size_t numSubminibatchesNeeded = 0;
     if (m_maxSamplesInRAM < SIZE_MAX || m_numSubminiBatches > 1) // user-specified maximum number of samples that fit into GPU RAM; or 0 if not enabled
     {
@@ -790,8 +1174,29 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
     }
     // this is non-trivial, we need a manager object to handle this
-    if (numSubminibatchesNeeded > 1)
+    if (numSubminibatchesNeeded > 1 && m_localDataParallel)
+        InvalidArgument("Sub-minibatches (maxSamplesInRAM, numSubminibatches) are not supported with dataParallelDevices.");
+    if (numSubminibatchesNeeded > 1 && m_hogwild)
+        InvalidArgument("Sub-minibatches (maxSamplesInRAM, numSubminibatches) are not supported with hogwildThreads.");
+    if (numSubminibatchesNeeded > 1 && m_distillation)
+        InvalidArgument("Sub-minibatches (maxSamplesInRAM, numSubminibatches) are not supported with distillation (teacherModelPath).");
+    if (m_recoverFromOutOfMemory && (m_localDataParallel || m_hogwild || m_distillation))
+        InvalidArgument("recoverFromOutOfMemory is not supported with dataParallelDevices, hogwildThreads, or distillation (teacherModelPath).");
+    if (numSubminibatchesNeeded > 1 || m_recoverFromOutOfMemory)
         smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes);
+    size_t numOutOfMemoryRecoveries = 0;
+    if (m_localDataParallel)
+        m_localDataParallel->StartEpoch(learnableNodes);
+    if (m_hogwild)
+        m_hogwild->StartEpoch();
+    if (m_pruningTargetSparsity > 0)
+    {
+        if (!m_weightPruning)
+            m_weightPruning.reset(new WeightPruning<ElemType>(m_pruningTargetSparsity, m_pruningStartEpoch, m_pruningEndEpoch));
+        m_weightPruning->StartEpoch(epochNumber, learnableNodes);
+    }
+    if (m_distillation)
+        m_distillation->StartEpoch();
 
     // The following is a special feature only supported by the Kaldi2Reader for more efficient sequence training.
     // This attemps to compute the error signal for the whole utterance, which will
@@ -811,10 +1216,23 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
         }
     }
+    if (useParameterServer)
+    {
+        fprintf(stderr, ", AsyncParameterServerSGD training (MyRank = %d, NumNodes = %d, SyncPeriod = %d, MaxStaleness = %d)",
+                (int) g_mpi->CurrentNodeRank(), (int) g_mpi->NumNodesInUse(), (int) m_parameterServerSyncPeriod, (int) m_parameterServerMaxStaleness);
+    }
+    if (m_localDataParallel)
+        fprintf(stderr, ", data-parallel on %d GPUs of this process", (int) m_localDataParallel->GetNumDevices());
+    if (m_hogwild)
+        fprintf(stderr, ", Hogwild on %d CPU threads", (int) m_hogwild->GetNumWorkers());
     if (useDistributedMBReading)
     {
         fprintf(stderr, ", distributed reading is ENABLED");
+        if (useDynamicDataDistribution)
+            fprintf(stderr, " (dynamic, in blocks of %d minibatches)", (int) m_workItemSizeInMinibatches);
     }
+    if (m_gradientAccumulationSteps > 1)
+        fprintf(stderr, ", accumulating gradients over %d minibatches", (int) m_gradientAccumulationSteps);
     if (numSubminibatchesNeeded > 1)
     {
         if (m_maxSamplesInRAM < SIZE_MAX)
@@ -824,6 +1242,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
     fprintf(stderr, ".\n");
 
+    if (useParameterServer)
+    {
+        m_parameterServer->BeginEpoch(learnableNodes);
+    }
+
     Timer timer;
     timer.Start();
 
@@ -835,10 +1258,20 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
-        bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, criterionNodes[0],
-                                                                      useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize);
-        if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
-            break;                                                                // end of epoch
+        bool wasDataRead;
+        {
+            ExecutionProfiler::Scope profilerScope(L"GetMinibatch", "reader");
+            TrainingMetrics::ScopedTime readerTime(m_trainingMetrics ? &m_trainingMetrics->m_readerWait : nullptr);
+            wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, criterionNodes[0],
+                                                                     useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize);
+        }
+        bool isEndOfData = false;
+        if (!wasDataRead && (!useDistributedMBReading || useParameterServer || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
+        {
+            if (!gradientAccumulator.HasPending())
+                break; // end of epoch
+            isEndOfData = true; // one more pass, without data, to apply the gradients of the incomplete group
+        }
 
         // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
         // Must not touch them.
@@ -846,6 +1279,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (!wasDataRead)
             actualMBSize = 0; // (undefined if !wasDataRead)
 
+        // with dataParallelDevices, the minibatch is shared out among the GPUs; actualMBSize remains that of all of it
+        if (m_localDataParallel && actualMBSize > 0)
+            m_localDataParallel->DistributeMinibatch(net, *inputMatrices, actualMBSize);
+        else if (m_hogwild && actualMBSize > 0)
+            m_hogwild->DistributeMinibatch(net, *inputMatrices, actualMBSize);
+
         nSamplesSinceLastModelSync += actualMBSize;
 
         // node data was changed
@@ -878,57 +1317,132 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                               (ElemType)(1.0 - m_adaptationRegWeight),
                                               dynamic_pointer_cast<ComputationNode<ElemType>>(labelNodes[0])->Value());
             }
+            if (m_distillation)
+                m_distillation->ComputeSoftTargets(net, *inputMatrices);
 
             // do forward and back propagation
 
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
-            size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
-            for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+            if (m_localDataParallel) // all GPUs of this process, each on its share of the minibatch
+            {
+                bool computeGradient = learnRatePerSample > 0.01 * m_minLearnRate;
+                m_localDataParallel->ForwardAndBackprop(net, criterionNodes[0], evaluationNodes, computeGradient, m_dynamicLossScaling ? m_lossScale : 1.0);
+                if (computeGradient)
+                    m_localDataParallel->AggregateGradients(learnableNodes);
+            }
+            else if (m_hogwild) // all workers, each on its share of the minibatch, updating the shared parameters as they go
             {
-                if (actualNumSubminibatches > 1)
+                bool computeGradient = learnRatePerSample > 0.01 * m_minLearnRate;
+                const double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences());
+                m_hogwild->ForwardBackpropAndUpdate(computeGradient ? learnRatePerSample : 0, momentumPerSample, m_useNesterovMomentum);
+            }
+            else
+            {
+                // with recoverFromOutOfMemory, a minibatch that does not fit is started over in twice as many sub-minibatches
+                size_t numSubminibatchesToUse = numSubminibatchesNeeded;
+                bool isMinibatchCached = false;
+                for (;;)
                 {
-                    smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
-                    ComputationNetwork::BumpEvalTimeStamp(featureNodes);
-                    ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                    try
+                    {
+                        size_t actualNumSubminibatches = 1;
+                        if (numSubminibatchesToUse > 1 && isMinibatchCached)
+                            actualNumSubminibatches = smbDispatcher.Resplit(numSubminibatchesToUse);
+                        else if (numSubminibatchesToUse > 1)
+                        {
+                            actualNumSubminibatches = smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesToUse);
+                            isMinibatchCached = true;
+                        }
+                        for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+                        {
+                            if (actualNumSubminibatches > 1)
+                            {
+                                smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
+                                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                            }
+
+                            // ===========================================================
+                            // forward prop for evaluate eval nodes
+                            // ===========================================================
+
+                            // compute eval node first since when gradient is computed the forward function values
+                            // may be changed and need to be recomputed when gradient and function value share the same matrix
+                            net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
+
+                            // ===========================================================
+                            // forward prop for training criterion
+                            // ===========================================================
+
+                            net->ForwardProp(criterionNodes[0]);
+
+                            // ===========================================================
+                            // backprop
+                            // ===========================================================
+
+                            if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
+                            {
+                                // with overlapped aggregation, each gradient is handed to the aggregator as soon as backprop has completed it
+                                // (the gradient list is only known after the first minibatch; sub-minibatches are accumulated before aggregating)
+                                ComputationNetwork::GradientReadyCallback gradientReadyCallback;
+                                if (overlapGradientAggregation && actualNumSubminibatches == 1 && !learnParamsGradients.empty())
+                                {
+                                    m_distGradAgg->BeginOverlappedAggregation(learnParamsGradients);
+                                    gradientReadyCallback = [this](const ComputationNodeBasePtr& node)
+                                    {
+                                        m_distGradAgg->NotifyGradientReady(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                                    };
+                                }
+                                net->Backprop(criterionNodes[0], m_dynamicLossScaling ? m_lossScale : 1.0, gradientReadyCallback);
+                            }
+
+                            // house-keeping for sub-minibatching
+                            if (actualNumSubminibatches > 1)
+                                smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
+                        }                                                        // end sub-minibatch loop
+                        if (actualNumSubminibatches > 1)
+                            smbDispatcher.DoneWithCurrentMinibatch();
+                        break;
+                    }
+                    catch (const std::bad_alloc&)
+                    {
+                        size_t numParallelSequences = isMinibatchCached ? smbDispatcher.GetNumParallelSequences() : net->GetMBLayoutPtr()->GetNumParallelSequences();
+                        if (!m_recoverFromOutOfMemory || smbDispatcher.HasStatefulNodes() || numSubminibatchesToUse >= numParallelSequences)
+                            throw;
+                        numSubminibatchesToUse = max(numSubminibatchesToUse, (size_t) 1) * 2;
+                        fprintf(stderr, "Out of memory in minibatch of %d samples; starting it over in %d sub-minibatches.\n",
+                                (int) actualMBSize, (int) min(numSubminibatchesToUse, numParallelSequences));
+                        numOutOfMemoryRecoveries++;
+                    }
                 }
-
-                // ===========================================================
-                // forward prop for evaluate eval nodes
-                // ===========================================================
-
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
-
-                // ===========================================================
-                // forward prop for training criterion
-                // ===========================================================
-
-                net->ForwardProp(criterionNodes[0]);
-
-                // ===========================================================
-                // backprop
-                // ===========================================================
-
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
-
-                // house-keeping for sub-minibatching
-                if (actualNumSubminibatches > 1)
-                    smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
-            }                                                        // end sub-minibatch loop
-            if (actualNumSubminibatches > 1)
-                smbDispatcher.DoneWithCurrentMinibatch();
+            }
         } // if (actualMBSize > 0)
 
         // for progress and statistics, we should only count frames that are not gaps
-        size_t numSamplesWithLabel = wasDataRead ? net->GetNumSamplesWithLabel(actualMBSize) : 0;
+        size_t numSamplesWithLabel = 0;
+        if (m_localDataParallel && actualMBSize > 0)
+            numSamplesWithLabel = m_localDataParallel->GetNumSamplesWithLabel();
+        else if (m_hogwild && actualMBSize > 0)
+            numSamplesWithLabel = m_hogwild->GetNumSamplesWithLabel();
+        else if (wasDataRead)
+            numSamplesWithLabel = net->GetNumSamplesWithLabel(actualMBSize);
 
         // Sum of actualMBSize across all nodes when using parallel training
         size_t aggregateNumSamples = actualMBSize;
         size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
 
+        // with gradientAccumulationSteps, only the last minibatch of a group aggregates and updates, with the group's gradients
+        bool isUpdateStep = true;
+        if (m_gradientAccumulationSteps > 1)
+        {
+            bool hasGradients = actualMBSize > 0 && learnRatePerSample > 0.01 * m_minLearnRate;
+            isUpdateStep = gradientAccumulator.Add(learnableNodes, criterionNodes[0], evaluationNodes, actualMBSize, numSamplesWithLabel,
+                                                   hasGradients, isEndOfData, /*collectCriteria=*/useGradientAggregation);
+            if (!useGradientAggregation)
+                aggregateNumSamples = isUpdateStep ? gradientAccumulator.GetNumSamples() : 0; // (only used by the update)
+        }
+
         if (!useGradientAggregation)
         {
             // accumulate criterion values (objective, eval)
@@ -936,22 +1450,43 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             {
                 assert(wasDataRead);
                 // criteria are in Value()(0,0), we accumulate into another 1x1 Matrix (to avoid having to pull the values off the GPU)
-                Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(),
-                                                      0, 0, localEpochCriterion, 0, 0);
-                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                if (m_localDataParallel)
+                    m_localDataParallel->AccumulateCriteria(criterionNodes[0], evaluationNodes, localEpochCriterion, localEpochEvalErrors);
+                else if (m_hogwild)
+                    m_hogwild->AccumulateCriteria(localEpochCriterion, localEpochEvalErrors);
+                else
                 {
-                    Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(),
-                                                          0, 0, localEpochEvalErrors, 0, i);
+                    Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(),
+                                                          0, 0, localEpochCriterion, 0, 0);
+                    for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    {
+                        Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(),
+                                                              0, 0, localEpochEvalErrors, 0, i);
+                    }
                 }
             }
         }
+        else if (!isUpdateStep)
+        {
+            // the group's samples are counted once it is aggregated
+            aggregateNumSamples = 0;
+            aggregateNumSamplesWithLabel = 0;
+        }
         else
         {
             // distributed gradient aggregation
             if (learnParamsGradients.size() == 0)
             {
-                learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                // with overlapped aggregation, the gradients are listed in the order in which backprop completes them
+                std::vector<ComputationNodeBasePtr> nodesToAggregate;
+                if (overlapGradientAggregation)
+                    nodesToAggregate = net->LearnableParameterNodesInGradientOrder(criterionNodes[0]);
+                else
+                    nodesToAggregate.assign(learnableNodes.begin(), learnableNodes.end());
+
+                learnParamsGradients.reserve(nodesToAggregate.size());
+                std::vector<std::wstring> gradientNames;
+                for (auto nodeIter = nodesToAggregate.begin(); nodeIter != nodesToAggregate.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
                     if (node->IsParameterUpdateRequired())
@@ -967,19 +1502,42 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         }
 
                         learnParamsGradients.push_back(currParamsGradient);
+                        gradientNames.push_back(node->NodeName());
                     }
                 }
+                m_distGradAgg->SetGradientNames(gradientNames);
             }
 
             // prepare the header
             m_gradHeader->numEvalNode = evaluationNodes.size();
-            m_gradHeader->numSamples = actualMBSize;
-            m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
-            m_gradHeader->criterion = actualMBSize > 0 ? criterionNodes[0]->Get00Element() : 0.0;
-            for (size_t i = 0; i < evaluationNodes.size(); i++)
-                m_gradHeader->evalErrors[i] = actualMBSize > 0 ? evaluationNodes[i]->Get00Element() : 0.0;
+            if (m_gradientAccumulationSteps > 1)
+            {
+                m_gradHeader->numSamples = gradientAccumulator.GetNumSamples();
+                m_gradHeader->numSamplesWithLabel = gradientAccumulator.GetNumSamplesWithLabel();
+                m_gradHeader->criterion = gradientAccumulator.GetCriterion();
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    m_gradHeader->evalErrors[i] = gradientAccumulator.GetEvalError(i);
+            }
+            else
+            {
+                m_gradHeader->numSamples = actualMBSize;
+                m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
+                m_gradHeader->criterion = actualMBSize > 0 ? criterionNodes[0]->Get00Element() : 0.0;
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    m_gradHeader->evalErrors[i] = actualMBSize > 0 ? evaluationNodes[i]->Get00Element() : 0.0;
+            }
 
-            bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, epochNumber);
+            // this node's throughput, up to here (the Get00Element() calls have synchronized with the GPU)
+            timer.Stop();
+            double secondsInMB = timer.ElapsedSeconds();
+            m_gradHeader->minSamplesPerSecond = m_gradHeader->maxSamplesPerSecond = (secondsInMB > 0) ? numSamplesWithLabel / secondsInMB : 0.0;
+
+            bool samplesProcessed;
+            {
+                ExecutionProfiler::Scope profilerScope(L"AggregateGradients", "aggregation");
+                TrainingMetrics::ScopedTime aggregationTime(m_trainingMetrics ? &m_trainingMetrics->m_aggregationWait : nullptr);
+                samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, epochNumber);
+            }
             noMoreSamplesToProcess = !samplesProcessed;
 
             aggregateNumSamples = m_gradHeader->numSamples;
@@ -987,11 +1545,18 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             epochCriterion += m_gradHeader->criterion;
             for (size_t i = 0; i < epochEvalErrors.size(); i++)
                 epochEvalErrors[i] += m_gradHeader->evalErrors[i];
+
+            if ((m_gradHeader->minSamplesPerSecond > 0) && ((minNodeSamplesPerSecondLastMBs == 0) || (m_gradHeader->minSamplesPerSecond < minNodeSamplesPerSecondLastMBs)))
+                minNodeSamplesPerSecondLastMBs = m_gradHeader->minSamplesPerSecond;
+            maxNodeSamplesPerSecondLastMBs = max(maxNodeSamplesPerSecondLastMBs, m_gradHeader->maxSamplesPerSecond);
         }
 
-        // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        // update model parameters (with hogwildThreads, the workers have done so already)
+        // With dynamic loss scaling, the (aggregated) gradients are scaled back first, or the update is skipped if they overflowed.
+        if (!m_hogwild && (aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && (!m_dynamicLossScaling || UnscaleGradients(learnableNodes)))
         {
+            const double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences());
+            FusedUpdate fused = {};
             auto smoothedGradientIter = smoothedGradients.begin();
             for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
             {
@@ -1003,17 +1568,45 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     if (smoothedGradient.HasNan("TrainOneEpoch/UpdateWeights(): "))
                         LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
-                    UpdateWeights(node, smoothedGradient, learnRatePerSample,
-                                  GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), aggregateNumSamples,
-                                  m_L2RegWeight, m_L1RegWeight,
-                                  m_needAveMultiplier, m_useNesterovMomentum);
+                    if (m_fusedParameterUpdate && !m_optimizerStateOffload && AddToFusedUpdate(fused, node, smoothedGradient, aggregateNumSamples, m_needAveMultiplier))
+                    {
+                        node->BumpEvalTimeStamp();
+                        continue; // updated below
+                    }
+                    ExecutionProfiler::Scope profilerScope(node->NodeName(), "update");
+                    if (m_optimizerStateOffload) // the state visits the GPU for the update
+                    {
+                        UpdateWeights(node, m_optimizerStateOffload->Fetch(smoothedGradient), learnRatePerSample,
+                                      momentumPerSample, aggregateNumSamples,
+                                      m_L2RegWeight, m_L1RegWeight,
+                                      m_needAveMultiplier, m_useNesterovMomentum);
+                        m_optimizerStateOffload->Store(smoothedGradient);
+                    }
+                    else
+                        UpdateWeights(node, smoothedGradient, learnRatePerSample,
+                                      momentumPerSample, aggregateNumSamples,
+                                      m_L2RegWeight, m_L1RegWeight,
+                                      m_needAveMultiplier, m_useNesterovMomentum);
 #ifdef _DEBUG
                     if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
                         LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
                 }
             }
+            if (!fused.tensors.empty())
+            {
+                ExecutionProfiler::Scope profilerScope(L"(fused parameter update)", "update");
+                UpdateWeightsFused(fused, learnRatePerSample, momentumPerSample, aggregateNumSamples,
+                                   m_L2RegWeight, m_L1RegWeight, m_useNesterovMomentum);
+            }
+            if (m_weightPruning)
+                m_weightPruning->ApplyMasks();
+            m_numParameterUpdates++;
         }
+        if (m_localDataParallel && actualMBSize > 0)
+            m_localDataParallel->CopyParametersToReplicas(learnableNodes);
+        if (isEndOfData)
+            break; // (the incomplete group has been applied)
 
         // aggregation by model averaging
         if (useModelAveraging)
@@ -1059,11 +1652,31 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }
         }
 
+        // exchange the model with the parameter server (asynchronously; each node stops when its own data ends)
+        if (useParameterServer && wasDataRead)
+        {
+            m_parameterServer->Sync(learnableNodes);
+        }
+
         timer.Stop();
         numMBsRun++;
+        if (numMBsRun == 1)
+            StartupTiming::Finish("first minibatch trained");
+
+        // now that all pooled matrices have their actual sizes, report the memory footprint
+        if (numMBsRun == 1 && m_traceLevel > 0)
+            net->PrintMatrixPoolStatistics();
 
         totalTimeInMBs += timer.ElapsedSeconds();
         numSamplesLastMBs += useModelAveraging ? int(actualMBSize) : int(aggregateNumSamplesWithLabel);
+        if (m_trainingMetrics)
+        {
+            m_trainingMetrics->m_minibatchTime.Add(timer.ElapsedSeconds());
+            m_trainingMetrics->m_numMinibatches++;
+            m_trainingMetrics->m_numSamples += useModelAveraging ? actualMBSize : aggregateNumSamplesWithLabel;
+            if (m_distGradAgg)
+                m_trainingMetrics->m_numBytesSent = m_distGradAgg->GetNumBytesSent();
+        }
 
         if (numMBsRun % m_numMBsToShowResult == 0)
         {
@@ -1083,6 +1696,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }
 
             double trainLossPerSample = (numSamplesLastMBs != 0) ? ((epochCriterion - epochCriterionLastMBs) / numSamplesLastMBs) : 0.0;
+            if (m_trainingMetrics)
+                m_trainingMetrics->m_trainLossPerSample = trainLossPerSample;
             bool wasProgressPrinted = false;
 
             if (epochNumber > 0 || (int) epochSize > 0)
@@ -1124,8 +1739,20 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 SGDTrace(stderr, formatString.c_str(), i, evalError);
             }
 
-            string formatString = "TotalTime = " + GeneratePaddedFloatOrExpFormat(0, 4, totalTimeInMBs) + "s; SamplesPerSecond = %.1f\n";
+            string formatString = "TotalTime = " + GeneratePaddedFloatOrExpFormat(0, 4, totalTimeInMBs) + "s; SamplesPerSecond = %.1f";
             SGDTrace(stderr, formatString.c_str(), totalTimeInMBs, numSamplesLastMBs / totalTimeInMBs);
+            if (maxNodeSamplesPerSecondLastMBs > 0)
+                SGDTrace(stderr, "; NodeSamplesPerSecond = %.1f..%.1f", minNodeSamplesPerSecondLastMBs, maxNodeSamplesPerSecondLastMBs);
+            if (m_gpuWatcher)
+            {
+                GPUActivity gpuActivity = m_gpuWatcher->GetActivity();
+                GPUActivity mean = gpuActivity.MeanSince(gpuActivityLastMBs);
+                gpuActivityLastMBs = gpuActivity;
+                if (mean.numSamples > 0)
+                    SGDTrace(stderr, "; GPU: SM %.0f%%, memory %.0f%%, PCIe out/in %.0f/%.0f MB/s, %.0f W",
+                             mean.smUtilization, mean.memoryUtilization, mean.pcieTxMBps, mean.pcieRxMBps, mean.powerWatts);
+            }
+            SGDTrace(stderr, "\n");
 
             // progress tracing for compute cluster management
             if (wasProgressPrinted)
@@ -1133,7 +1760,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 ProgressTracing::TraceTrainLoss(trainLossPerSample);
             }
 
-            if (m_traceLevel > 0)
+            if (m_traceLevel > 0 && !AsyncLog::IsStarted()) // (the writer thread flushes)
             {
                 fflush(stderr);
             }
@@ -1141,6 +1768,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // reset statistics
             totalTimeInMBs = 0;
             numSamplesLastMBs = 0;
+            minNodeSamplesPerSecondLastMBs = 0;
+            maxNodeSamplesPerSecondLastMBs = 0;
 
             epochCriterionLastMBs = epochCriterion;
             for (size_t i = 0; i < epochEvalErrorsLastMBs.size(); i++)
@@ -1171,9 +1800,45 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
+        if (ExecutionProfiler::Active())
+        {
+            ExecutionProfiler::Active()->EndMinibatch();
+            if (ExecutionProfiler::Active()->GetNumMinibatches() >= numMBsToProfileExecution)
+                finishExecutionProfiling();
+        }
+
+        // mid-epoch checkpoint, between parameter updates (not within a group of gradientAccumulationSteps)
+        // Every node contributes its reader position; all of them are at the same model.
+        if (useMidEpochCheckPoints && ((size_t) numMBsRun % m_numMBsToCheckPoint == 0) && !gradientAccumulator.HasPending())
+        {
+            MidEpochState midEpochState;
+            midEpochState.tunedMBSize = tunedMBSize;
+            midEpochState.numMBsRun = numMBsRun;
+            midEpochState.totalEpochSamples = totalEpochSamples;
+            if (!useGradientAggregation)
+            {
+                epochCriterion = localEpochCriterion.Get00Element();
+                for (size_t i = 0; i < epochEvalErrors.size(); i++)
+                    epochEvalErrors[i] = localEpochEvalErrors(0, i);
+            }
+            midEpochState.epochCriterion = epochCriterion;
+            midEpochState.epochEvalErrors = epochEvalErrors;
+            size_t numNodes = (g_mpi != nullptr) ? g_mpi->NumNodesInUse() : 1;
+            midEpochState.samplePositions.assign(numNodes, 0);
+            midEpochState.samplePositions[(g_mpi != nullptr) ? g_mpi->CurrentNodeRank() : 0] = trainSetDataReader->GetCurrentSamplePosition();
+            if (numNodes > 1)
+                g_mpi->AllReduce(midEpochState.samplePositions);
+            SaveMidEpochCheckPoint(net, epochNumber, midEpochState, smoothedGradients);
+        }
     }
 
     // --- END MAIN MINIBATCH LOOP
+    finishExecutionProfiling(); // (epoch shorter than numMBsToProfileExecution)
+    if (m_implicitDeviceTransfers == DeviceTransferMonitor::trace)
+    {
+        DeviceTransferMonitor::WriteSummary(stderr);
+        DeviceTransferMonitor::Reset();
+    }
 
     if (useModelAveraging && (g_mpi->NumNodesInUse() > 1))
     {
@@ -1182,11 +1847,22 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         g_mpi->AllReduce(&residualSampels, 1);
         totalSamplesSeen += residualSampels;
         totalEpochSamples += residualSampels;
+        if (m_modelAverager != nullptr)
+            m_modelAverager->EndEpoch(learnableNodes);
         ModelAveragingSync(nSamplesSinceLastModelSync, learnableNodes);
         nSynced++;
         nSamplesSinceLastModelSync = 0;
     }
 
+    if (useParameterServer)
+    {
+        // the nodes have processed different numbers of samples; make the totals global, as for model averaging
+        m_parameterServer->EndEpoch(learnableNodes);
+        size_t localEpochSamples = totalEpochSamples;
+        g_mpi->AllReduce(&totalEpochSamples, 1);
+        totalSamplesSeen += totalEpochSamples - localEpochSamples;
+    }
+
     // compute final criterion values
     if (useGradientAggregation)
     {
@@ -1210,13 +1886,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
     }
 
-    // in case of model averaging, do one more final aggregation of criteria
-    if (useModelAveraging && (g_mpi->NumNodesInUse() > 1))
+    // in case of model averaging or a parameter server, do one more final aggregation of criteria
+    if ((useModelAveraging && (g_mpi->NumNodesInUse() > 1)) || useParameterServer)
     {
         // merge epochCriterion and epochEvalErrors over nodes
         g_mpi->AllReduce(&epochCriterion, 1);
         g_mpi->AllReduce(epochEvalErrors);
     }
+
+    AsyncLog::Flush(); // (the progress messages before the epoch's summary)
+
+    if (numOutOfMemoryRecoveries > 0)
+        fprintf(stderr, "Epoch[%2d of %d]: ran out of memory %d times; those minibatches were split into sub-minibatches.\n",
+                epochNumber + 1, (int) m_maxEpochs, (int) numOutOfMemoryRecoveries);
+
+    ComputationNetwork::SetSampledSoftmaxTraining<ElemType>(net, criterionNodes[0], false);
     return totalEpochSamples;
 }
 
@@ -1229,6 +1913,22 @@ static double MomentumPerMB(double momentumPerSample, size_t minibatchSize)
     return pow(momentumPerSample, minibatchSize);
 }
 
+// memory report of the per-parameter optimizer state (momentum, and the squares for AdaGrad, RMSProp, Adam etc.)
+template <class ElemType>
+static void PrintOptimizerStateMemory(FILE* f, const std::list<ComputationNodeBasePtr>& learnableNodes, const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    fprintf(f, "Optimizer state, in MB:\n");
+    size_t totalBytes = 0;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        size_t bytes = smoothedGradientIter->BufferSize();
+        fprintf(f, "%12.2f  %ls\n", bytes / (1024.0 * 1024.0), (*nodeIter)->NodeName().c_str());
+        totalBytes += bytes;
+    }
+    fprintf(f, "Total optimizer state %.2f MB for %d parameters\n", totalBytes / (1024.0 * 1024.0), (int) learnableNodes.size());
+}
+
 // Get{Train,Eval}CriterionNodes() return a reference that is, unfortunately, dependent on the network.
 // So we hold those inside here. Not very nice. Also not thread-safe. This may go away once we fix sequence-to-sequence models properly.
 // TODO: merge them into one.
@@ -1283,15 +1983,44 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         fprintf(stderr, "\tNodeName: %ls\n", (node->NodeName()).c_str());
     }
 
+    // streaming: the nodes accumulate in the forward prop of the first epoch, which trains on their running estimates,
+    // and are finalized at its end, see FinishStreamingPreCompute()
+    if (m_streamingPreCompute)
+    {
+        if (!m_dataParallelDevices.empty())
+            InvalidArgument("streamingPreCompute cannot be combined with dataParallelDevices.");
+        if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch || m_autoAdjustMinibatch)
+            InvalidArgument("streamingPreCompute cannot be combined with a learning-rate or minibatch-size search, which would accumulate their trial minibatches, too.");
+        for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++)
+        {
+            auto node = static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter);
+            node->MarkComputed(false /*begin accumulating*/);
+        }
+        m_streamingPreComputeNodes = nodes;
+        fprintf(stderr, "\nPrecomputing --> accumulating during the first epoch (streamingPreCompute).\n\n");
+        return false;
+    }
+
     // compute
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // [1/12/2015 erw] to support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
+    size_t requestedEpochSamples;
+    if (m_numSamplesForPreCompute > 0) // using a subset (with a randomizing reader, a random one)
+        requestedEpochSamples = m_numSamplesForPreCompute;
+    else if (m_useAllDataForPreComputedNode) // using all the data
+        requestedEpochSamples = requestDataSize;
     else // using only one epoch
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
+        requestedEpochSamples = m_epochSize;
+
+    // each worker accumulates over its share of the data (decimating the minibatches if the reader cannot distribute)
+    bool useDistributedPreCompute = m_distributedPreCompute && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1;
+    bool useDistributedMBReading = useDistributedPreCompute && trainSetDataReader->SupportsDistributedMBRead();
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), requestedEpochSamples);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, requestedEpochSamples);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1303,9 +2032,12 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
 
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy))
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, nullptr, useDistributedMBReading, useDistributedPreCompute, *inputMatrices, actualMBSize))
     {
+        if (actualMBSize == 0) // (this worker's share of a minibatch may be empty)
+            continue;
+
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
@@ -1325,6 +2057,8 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     }
 
     // finalize
+    if (useDistributedPreCompute)
+        MergePreComputedStatistics(nodes);
     for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++)
     {
         auto node = static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter);
@@ -1335,6 +2069,112 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     return true;
 }
 
+template <class ElemType>
+static std::vector<double> CopyToDoubles(const Matrix<ElemType>& matrix)
+{
+    std::unique_ptr<ElemType[]> values(matrix.CopyToArray());
+    return std::vector<double>(values.get(), values.get() + matrix.GetNumElements());
+}
+
+template <class ElemType>
+static void SetFromDoubles(Matrix<ElemType>& matrix, const std::vector<double>& values)
+{
+    std::vector<ElemType> elemValues(values.begin(), values.end());
+    matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), matrix.GetDeviceId(), elemValues.data());
+}
+
+// finalize the nodes that accumulated during the first epoch
+// Each minibatch was merged into the running statistics (Chan et al.'s pairwise update, on the device), so this only
+// merges the workers' statistics, if there are several, and turns the variances into InvStdDev values. With a single
+// worker, the result equals that of a separate pass over the same samples.
+template <class ElemType>
+void SGD<ElemType>::FinishStreamingPreCompute()
+{
+    if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+        MergePreComputedStatistics(m_streamingPreComputeNodes);
+    for (auto nodeIter = m_streamingPreComputeNodes.begin(); nodeIter != m_streamingPreComputeNodes.end(); nodeIter++)
+    {
+        auto node = static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter);
+        node->MarkComputed(true /*done accumulating*/);
+    }
+    m_streamingPreComputeNodes.clear();
+    fprintf(stderr, "\nPrecomputing --> Completed (over the first epoch).\n\n");
+}
+
+// merge the statistics that the workers accumulated over their shares of the data, on all workers
+// With the workers' sample counts n_i, means m_i and variances v_i, the merged mean is m = sum_i n_i m_i / N, and the
+// merged variance sum_i n_i (v_i + (m_i - m)^2) / N. Unlike merging sums of squares, this does not lose the variance
+// to cancellation when it is small relative to the mean.
+template <class ElemType>
+void SGD<ElemType>::MergePreComputedStatistics(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    std::vector<shared_ptr<MeanInvStdDevNodeBase<ElemType>>> statsNodes;
+    for (const auto& node : nodes)
+    {
+        auto statsNode = dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node);
+        if (!statsNode)
+            LogicError("MergePreComputedStatistics: %ls %ls operation cannot be precomputed on several workers.", node->NodeName().c_str(), node->OperationName().c_str());
+        statsNodes.push_back(statsNode);
+    }
+
+    // counts and means: allreduce n_i and n_i m_i
+    std::vector<double> localNumSamples;
+    std::vector<std::vector<double>> localMeans;
+    std::vector<double> buffer;
+    for (const auto& node : statsNodes)
+    {
+        localNumSamples.push_back((double) node->GetNumAccumulatedSamples());
+        localMeans.push_back(CopyToDoubles(node->AccumulatedMean()));
+        buffer.push_back(localNumSamples.back());
+        for (double mean : localMeans.back())
+            buffer.push_back(localNumSamples.back() * mean);
+    }
+    g_mpi->AllReduce(buffer);
+
+    std::vector<double> numSamples;
+    std::vector<std::vector<double>> means;
+    size_t pos = 0;
+    for (size_t i = 0; i < statsNodes.size(); i++)
+    {
+        numSamples.push_back(buffer[pos++]);
+        std::vector<double> mean(localMeans[i].size());
+        for (auto& value : mean)
+            value = buffer[pos++] / max(numSamples[i], 1.0);
+        means.push_back(move(mean));
+    }
+
+    // variances around the merged means: allreduce n_i (v_i + (m_i - m)^2)
+    buffer.clear();
+    for (size_t i = 0; i < statsNodes.size(); i++)
+    {
+        if (!statsNodes[i]->AccumulatedVariance())
+            continue;
+        std::vector<double> localVar = CopyToDoubles(*statsNodes[i]->AccumulatedVariance());
+        for (size_t k = 0; k < localVar.size(); k++)
+        {
+            double meanDiff = localMeans[i][k] - means[i][k];
+            buffer.push_back(localNumSamples[i] * (localVar[k] + meanDiff * meanDiff));
+        }
+    }
+    if (!buffer.empty())
+        g_mpi->AllReduce(buffer);
+
+    pos = 0;
+    for (size_t i = 0; i < statsNodes.size(); i++)
+    {
+        auto& node = statsNodes[i];
+        SetFromDoubles(node->AccumulatedMean(), means[i]);
+        if (node->AccumulatedVariance())
+        {
+            std::vector<double> var(means[i].size());
+            for (auto& value : var)
+                value = buffer[pos++] / max(numSamples[i], 1.0);
+            SetFromDoubles(*node->AccumulatedVariance(), var);
+        }
+        node->SetNumAccumulatedSamples((size_t) numSamples[i]);
+    }
+}
+
 // return a reasonable initial learning rate based on the initial mbsize
 template <class ElemType>
 double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -1378,6 +2218,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointFiles();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1388,6 +2229,18 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                        smoothedGradients,
                        /*out*/ prevCriterion,
                        /*out*/ dummyMinibatchSize);
+    TakeSearchSnapshot(net, smoothedGradients, totalSamplesSeen);
+
+    // all trials train on the same first numFramesToUseInSearch samples with the same minibatch size; read them once
+    // Not for data-parallel training, where the readers must stay in step across workers, nor for sequence training,
+    // whose reader computes the inputs from the model's outputs.
+    unique_ptr<CachingDataReader<ElemType>> cachingReader;
+    if (m_searchMinibatchCache && (!g_mpi || g_mpi->NumNodesInUse() == 1) &&
+        criterionNodes[0]->OperationName() != L"SequenceWithSoftmax")
+    {
+        cachingReader.reset(new CachingDataReader<ElemType>(*trainSetDataReader));
+        trainSetDataReader = cachingReader.get();
+    }
 
     // if model is not changed this is what we will get
     TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
@@ -1493,6 +2346,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     fprintf(stderr, "Best Learn Rate Per Sample for Epoch[%d] = %.10g  baseCriterion=%.10g\n",
             epochNumber + 1, bestLearnRatePerSample, baseCriterion);
 
+    m_searchSnapshot.reset();
     return bestLearnRatePerSample;
 }
 
@@ -1640,6 +2494,10 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
 
     size_t lastTriedTrialMinibatchSize = 0;
     double lastTriedTrialEpochCriterion = 0;
+
+    // the state of the previous epoch is current here, as no trial has run yet (the trials' sample counts are not used)
+    TakeSearchSnapshot(net, smoothedGradients, /*totalSamplesSeen=*/0);
+
     for (float trialMinibatchSizeFloat = (float) minMinibatchSize;
          trialMinibatchSizeFloat <= maxMinibatchSize;
          trialMinibatchSizeFloat *= minibatchSizeTuningFactor)
@@ -1702,6 +2560,7 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
                     "EpochCriterion = %.10g vs BaseCriterion = %.10g\n\n",
             (int) lastTriedTrialMinibatchSize, lastTriedTrialEpochCriterion, baseCriterion);
 
+    m_searchSnapshot.reset();
     return lastTriedTrialMinibatchSize;
 }
 
@@ -1746,7 +2605,14 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
         fprintf(stderr, "AvgLearningRatePerSample = %.8g\n", learnRatePerSample);
     }
 
+    if (m_searchSnapshot)
+    {
+        RestoreSearchSnapshot(smoothedGradients, /*out*/ totalSamplesSeen);
+        return;
+    }
+
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointFiles();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double dummyLearnRate;
@@ -1760,6 +2626,50 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                        /*out*/ dummyMinibatchSize);
 }
 
+// keep the state that a search trial changes in memory, so that TrainOneMiniEpochAndReloadModel() can restore it
+// without rereading the model and checkpoint files; the copies stay on the device of the original
+// Does nothing unless m_searchSnapshotInMemory. BatchNormalization nodes also persist their minibatch count, which is
+// not kept here, so networks with them keep reloading from disk.
+template <class ElemType>
+void SGD<ElemType>::TakeSearchSnapshot(ComputationNetworkPtr net, const std::list<Matrix<ElemType>>& smoothedGradients, const size_t totalSamplesSeen)
+{
+    m_searchSnapshot.reset();
+    if (!m_searchSnapshotInMemory || !net->GetNodesWithType(OperationNameOf(BatchNormalizationNode)).empty())
+        return;
+
+    unique_ptr<SearchSnapshot> snapshot(new SearchSnapshot());
+    for (const auto& nodeBase : net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+        const Matrix<ElemType>& value = node->Value();
+        snapshot->parameters.push_back(make_pair(node, make_shared<Matrix<ElemType>>(value, value.GetDeviceId())));
+    }
+    for (const auto& smoothedGradient : smoothedGradients)
+        snapshot->smoothedGradients.push_back(make_shared<Matrix<ElemType>>(smoothedGradient, smoothedGradient.GetDeviceId()));
+    snapshot->totalSamplesSeen = totalSamplesSeen;
+    snapshot->numParameterUpdates = m_numParameterUpdates;
+    snapshot->lossScale = m_lossScale;
+    snapshot->numMBsSinceLossScaleChange = m_numMBsSinceLossScaleChange;
+    m_searchSnapshot = move(snapshot);
+}
+
+template <class ElemType>
+void SGD<ElemType>::RestoreSearchSnapshot(std::list<Matrix<ElemType>>& smoothedGradients, /*out*/ size_t& totalSamplesSeen)
+{
+    for (const auto& parameter : m_searchSnapshot->parameters)
+    {
+        parameter.first->Value().SetValue(*parameter.second);
+        parameter.first->BumpEvalTimeStamp();
+    }
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (const auto& smoothedGradient : m_searchSnapshot->smoothedGradients)
+        (smoothedGradientIter++)->SetValue(*smoothedGradient);
+    totalSamplesSeen = m_searchSnapshot->totalSamplesSeen;
+    m_numParameterUpdates = m_searchSnapshot->numParameterUpdates;
+    m_lossScale = m_searchSnapshot->lossScale;
+    m_numMBsSinceLossScaleChange = m_searchSnapshot->numMBsSinceLossScaleChange;
+}
+
 // Attemps to compute the error signal for the whole utterance, which will
 // be fed to the neural network as features. Currently it is a workaround
 // for the two-forward-pass sequence and ctc training, which allows
@@ -1820,7 +2730,7 @@ int SGD<ElemType>::SGDTrace(FILE* __restrict __stream, const char* __restrict __
     {
         va_list args;
         va_start(args, __format);
-        result = vfprintf(__stream, __format, args);
+        result = AsyncLog::VWrite(__stream, __format, args);
         va_end(args);
     }
     return result;
@@ -1836,13 +2746,22 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
             m_distGradAgg = new AllReduceDistGradAggregator<ElemType>(g_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
-            if (m_numGradientBits != (8 * sizeof(ElemType)))
+            // without the 1-bit SGD module, compressed gradients are exchanged by the QuantizedDistGradAggregator
+            if ((m_numGradientBits != (8 * sizeof(ElemType))) || (m_gradientTopKRatio > 0) || m_adaptiveGradientBits)
             {
-                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
+                if (m_bufferedAsyncGradientAggregation)
+                {
+                    fprintf(stderr, "WARNING: useBufferedAsyncGradientAggregation is not supported with gradient compression and will be ignored.\n");
+                    m_bufferedAsyncGradientAggregation = false;
+                }
+                m_distGradAgg = new QuantizedDistGradAggregator<ElemType>(g_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, m_gradientTopKRatio, m_syncStatsTrace,
+                                                                          m_adaptiveGradientBits, m_gradientBitsMin, m_gradientBitsMax);
             }
-
-            m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+            else
+                m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, (size_t)(m_gradientBucketSizeInMB * 1024 * 1024), m_gpuDirectGradientAggregation, m_hierarchicalAllReduce, m_sparseGradientDensity);
 #endif // !QUANTIZED_GRADIENT_AGGREGATION
+            if (m_overlapGradientAggregation && !m_distGradAgg->SupportsOverlappedAggregation())
+                fprintf(stderr, "WARNING: overlapGradientAggregation is not supported with this gradient aggregation method and will be ignored.\n");
         }
 
         if (m_gradHeader == nullptr)
@@ -1884,7 +2803,10 @@ bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const
         double elapsedsec = MAtimer.ElapsedSeconds();
         SecondsSinceLastSyncFinished = first ? 0 : (float) elapsedsec;
         MAtimer.Start();
-        nProcessedFrames = ModelAveragingSync((int) nSamplesSinceLastSync, learnableNodes);
+        if (m_modelAverager != nullptr)
+            nProcessedFrames = m_modelAverager->Sync((int) nSamplesSinceLastSync, learnableNodes);
+        else
+            nProcessedFrames = ModelAveragingSync((int) nSamplesSinceLastSync, learnableNodes);
         MAtimer.Stop();
         SecondsSpentOnSync = (float) MAtimer.ElapsedSeconds();
 
@@ -1892,6 +2814,8 @@ bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const
     }
     else
     {
+        if (m_modelAverager != nullptr)
+            m_modelAverager->Progress();
         nProcessedFrames = 0;
         return false;
     }
@@ -2012,10 +2936,9 @@ template <class ElemType>
                                     (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
     }
     else if (adpType == GradientsUpdateType::AdaGrad ||
-             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType != GradientsUpdateType::None && gradientValues.GetMatrixType() == MatrixType::SPARSE))
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // rmsprop, fsadagrad, adam and lamb for sparse are not implemented yet, delegate them with adagrad
 
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
@@ -2031,6 +2954,21 @@ template <class ElemType>
                                                         (ElemType) sgd->m_rpi.dec, (ElemType) sgd->m_rpi.min, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
     }
+    else if (adpType == GradientsUpdateType::Adam)
+    {
+        smoothedGradient.Adam(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) sgd->m_adamInfo.beta1,
+                              (ElemType) sgd->m_adamInfo.beta2, (ElemType) sgd->m_adamInfo.epsilon, sgd->m_numParameterUpdates + 1, /*updateValues=*/true);
+    }
+    else if (adpType == GradientsUpdateType::Lamb)
+    {
+        // the Adam direction, scaled by this parameter's trust ratio ||w|| / ||direction||
+        smoothedGradient.Adam(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) sgd->m_adamInfo.beta1,
+                              (ElemType) sgd->m_adamInfo.beta2, (ElemType) sgd->m_adamInfo.epsilon, sgd->m_numParameterUpdates + 1, /*updateValues=*/false);
+        double valueNorm = functionValues.FrobeniusNorm();
+        double directionNorm = gradientValues.FrobeniusNorm();
+        double trustRatio = (valueNorm > 0 && directionNorm > 0) ? valueNorm / directionNorm : 1.0;
+        Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample * trustRatio), gradientValues, functionValues);
+    }
 
     if (noiseStd > 0)
     {
@@ -2075,6 +3013,151 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+// AddToFusedUpdate - add a parameter to a fused update, unless it needs what only UpdateWeights() does: gradient noise,
+// per-matrix norms (norm clipping, average multipliers, Lamb's trust ratio), sparse gradients, a smoothed gradient that
+// the first (unfused) update has not sized yet, or a device other than that of the parameters added before
+template <class ElemType>
+bool SGD<ElemType>::AddToFusedUpdate(FusedUpdate& fused, const ComputationNodeBasePtr& node, Matrix<ElemType>& smoothedGradient,
+                                     const size_t actualMBSize, const bool needAveMultiplier) const
+{
+    GradientsUpdateType adpType = GradUpdateType();
+    if (adpType == GradientsUpdateType::Lamb || GradientUpdateNoiseStd() > 0 ||
+        (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() && !m_gradientClippingWithTruncation) ||
+        (needAveMultiplier && (adpType == GradientsUpdateType::AdaGrad || adpType == GradientsUpdateType::RmsProp)))
+        return false;
+
+    ComputationNodePtr paramNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    Matrix<ElemType>& value = paramNode->Value();
+    Matrix<ElemType>& gradient = paramNode->Gradient();
+    if (value.GetMatrixType() != MatrixType::DENSE || gradient.GetMatrixType() != MatrixType::DENSE || smoothedGradient.GetMatrixType() != MatrixType::DENSE)
+        return false;
+
+    DEVICEID_TYPE deviceId = value.GetDeviceId();
+    if (gradient.GetDeviceId() != deviceId || smoothedGradient.GetDeviceId() != deviceId || (!fused.tensors.empty() && fused.deviceId != deviceId))
+        return false;
+
+    size_t numBlocks = (adpType == GradientsUpdateType::FSAdaGrad || adpType == GradientsUpdateType::Adam) ? 2 : adpType == GradientsUpdateType::RmsProp ? 3 : 1;
+    if (gradient.GetNumRows() != value.GetNumRows() || gradient.GetNumCols() != value.GetNumCols() ||
+        smoothedGradient.GetNumRows() != value.GetNumRows() || smoothedGradient.GetNumCols() < numBlocks * value.GetNumCols())
+        return false;
+
+    MultiTensorUpdateTensor<ElemType> tensor;
+    tensor.value = value.BufferPointer();
+    tensor.gradient = gradient.BufferPointer();
+    tensor.smoothedGradient = smoothedGradient.BufferPointer();
+    tensor.size = value.GetNumElements();
+    tensor.adaMul = 0;
+    // advances FSAdagrad's running frame count once per parameter, in the same order as the unfused updates
+    if (adpType == GradientsUpdateType::FSAdaGrad)
+        Matrix<ElemType>::FSAdagradScalars(actualMBSize, fused.adaWeight, tensor.adaMul);
+
+    fused.deviceId = deviceId;
+    fused.tensors.push_back(tensor);
+    return true;
+}
+
+// UpdateWeightsFused - the fused counterpart of UpdateWeightsS() for all parameters of 'fused'
+template <class ElemType>
+void SGD<ElemType>::UpdateWeightsFused(const FusedUpdate& fused,
+                                       const double learnRatePerSample,
+                                       const double momentumPerSample,
+                                       const size_t actualMBSize,
+                                       const double L2RegWeight, const double L1RegWeight,
+                                       const bool useNesterovMomentum) const
+{
+    assert(actualMBSize > 0);
+
+    GradientsUpdateType adpType = GradUpdateType();
+    MultiTensorUpdateParams<ElemType> params;
+    if (adpType == GradientsUpdateType::AdaGrad)
+        params.rule = MultiTensorUpdateRule::Adagrad;
+    else if (adpType == GradientsUpdateType::FSAdaGrad)
+        params.rule = MultiTensorUpdateRule::FSAdagrad;
+    else if (adpType == GradientsUpdateType::RmsProp)
+        params.rule = MultiTensorUpdateRule::RmsProp;
+    else if (adpType == GradientsUpdateType::Adam)
+        params.rule = MultiTensorUpdateRule::Adam;
+    else
+        params.rule = useNesterovMomentum ? MultiTensorUpdateRule::NesterovGrad : MultiTensorUpdateRule::NormalGrad;
+    params.learnRatePerSample = (ElemType) learnRatePerSample;
+    params.momentum = (ElemType) MomentumPerMB(momentumPerSample, actualMBSize);
+    params.clipThreshold = m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() ? (ElemType) fabs(m_clippingThresholdPerSample * actualMBSize) : 0;
+    // multiplied by actualMBSize so that they are invariant to minibatch size since learning rate is per sample
+    params.L2RegWeight = L2RegWeight > 0 ? (ElemType)(L2RegWeight * actualMBSize) : 0;
+    params.L1Threshold = L1RegWeight > 0 ? (ElemType)(learnRatePerSample * L1RegWeight * actualMBSize) : 0;
+    params.adaWeight = fused.adaWeight;
+    params.rmsGamma = (ElemType) m_rpi.gamma;
+    params.rmsWgtInc = (ElemType) m_rpi.inc;
+    params.rmsWgtMax = (ElemType) m_rpi.max;
+    params.rmsWgtDec = (ElemType) m_rpi.dec;
+    params.rmsWgtMin = (ElemType) m_rpi.min;
+    params.adamBeta1 = (ElemType) m_adamInfo.beta1;
+    params.adamBeta2 = (ElemType) m_adamInfo.beta2;
+    params.adamEpsilon = (ElemType) m_adamInfo.epsilon;
+    // as Matrix<ElemType>::Adam() for step m_numParameterUpdates + 1
+    params.adamBiasCorrection1 = (ElemType)(1 / (1 - pow(m_adamInfo.beta1, (double) (m_numParameterUpdates + 1))));
+    params.adamBiasCorrection2 = (ElemType)(1 / (1 - pow(m_adamInfo.beta2, (double) (m_numParameterUpdates + 1))));
+
+    Matrix<ElemType>::MultiTensorUpdate(fused.deviceId, fused.tensors, params);
+}
+
+// dynamic loss scaling: check the gradients (which are scaled by m_lossScale) for overflow, and scale them back if there is none
+// Returns false if the minibatch has to be skipped. In that case the loss scale is halved; after m_lossScaleGrowthInterval
+// minibatches without overflow it is doubled again, so it settles just below the largest scale the model tolerates.
+template <class ElemType>
+bool SGD<ElemType>::UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    // The sums of absolute values of all gradients are accumulated on the device, and only the total is read back,
+    // so that there is one synchronization per minibatch rather than one per parameter. inf/NaN carry through the sum.
+    // Sparse gradients are not supported by TensorView and are checked one by one.
+    ElemType sumOfAbs = 0;
+    bool haveDenseGradients = false;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+    {
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (!node->IsParameterUpdateRequired() || node->Gradient().IsEmpty())
+            continue;
+        if (node->Gradient().GetMatrixType() == SPARSE)
+        {
+            sumOfAbs += node->Gradient().SumOfAbsElements();
+            continue;
+        }
+        if (!haveDenseGradients)
+        {
+            if (m_gradientAbsSum == nullptr || m_gradientAbsSum->GetDeviceId() != node->Gradient().GetDeviceId())
+                m_gradientAbsSum = make_shared<Matrix<ElemType>>(1, 1, node->Gradient().GetDeviceId());
+            m_gradientAbsSum->SetValue(0);
+            haveDenseGradients = true;
+        }
+        TensorView<ElemType>(*m_gradientAbsSum).AddAbsOf(TensorView<ElemType>(node->Gradient()));
+    }
+    if (haveDenseGradients)
+        sumOfAbs += m_gradientAbsSum->Get00Element();
+    if (std::isnan(sumOfAbs) || std::isinf(sumOfAbs))
+    {
+        m_lossScale = max(m_lossScale / 2, 1.0);
+        m_numMBsSinceLossScaleChange = 0;
+        fprintf(stderr, "UnscaleGradients: Gradients overflowed, skipping the minibatch; loss scale reduced to %.0f.\n", m_lossScale);
+        return false;
+    }
+
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+    {
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (node->IsParameterUpdateRequired() && !node->Gradient().IsEmpty())
+            node->Gradient() *= (ElemType)(1 / m_lossScale);
+    }
+
+    if (++m_numMBsSinceLossScaleChange >= m_lossScaleGrowthInterval)
+    {
+        m_lossScale *= 2;
+        m_numMBsSinceLossScaleChange = 0;
+        if (m_traceLevel > 0)
+            fprintf(stderr, "UnscaleGradients: loss scale increased to %.0f.\n", m_lossScale);
+    }
+    return true;
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -2083,6 +3166,17 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
         if (m_gradientClippingWithTruncation)
             gradient.InplaceTruncate((ElemType)(maxGradientPerMB));
+        else if (gradient.GetMatrixType() == MatrixType::DENSE && maxGradientPerMB > 0)
+        {
+            // norm2 normalized, on the device: gradient *= min(1, maxGradientPerMB / ||gradient||) = maxGradientPerMB / max(||gradient||, maxGradientPerMB)
+            // The norm is never read back, so this does not wait for the GPU (once per parameter and minibatch).
+            Matrix<ElemType> normFactor(gradient.GetDeviceId());
+            normFactor.AssignFrobeniusNormOf(gradient);
+            normFactor.InplaceTruncateBottom((ElemType) maxGradientPerMB);
+            normFactor.ElementInverse();
+            normFactor *= (ElemType) maxGradientPerMB;
+            Matrix<ElemType>::Multiply1x1AndWeightedAdd(1, normFactor, gradient, 0, gradient);
+        }
         else
         {
             // norm2 normalized
@@ -2103,17 +3197,15 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
                                        const double prevCriterion,
                                        const size_t minibatchSize)
 {
+    bool sharded = IsCheckPointSharded();
+    size_t numShards = sharded ? g_mpi->NumNodesInUse() : 1;
+
     // In case of parallel training only the main node should we saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
     if ((g_mpi == nullptr) || g_mpi->IsMainNode())
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
-
+        WriteCheckPointFile(GetCheckPointFileNameForEpoch(int(epoch)), [&](File& fstream)
         {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
             fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
 
             fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
@@ -2124,24 +3216,117 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             fstream << minibatchSize;
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BParameterUpdates");
+            fstream << m_numParameterUpdates;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EParameterUpdates");
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+            if (!sharded)
             {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
-            }
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+
+                for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+                {
+                    const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+                    fstream << smoothedGradient;
+                }
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+            }
+            else // the manifest: the smoothed gradients are in the shard files
+            {
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BShards");
+                fstream << numShards;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EShards");
+            }
 
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+        });
+    }
 
-            // Ensuring that data is written
-            fstream.Flush();
-        }
+    // with sharding, node k writes smoothed gradients k, k + numShards, k + 2 * numShards, ...
+    // All nodes hold the same smoothed gradients in data-parallel training, so together they write the main node's.
+    size_t shard = sharded ? g_mpi->CurrentNodeRank() : 0;
+    if (sharded && (shard < numShards))
+    {
+        WriteCheckPointFile(GetCheckPointShardFileNameForEpoch(int(epoch), shard), [&](File& fstream)
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradientShard");
+            size_t k = 0;
+            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, k++)
+            {
+                if (k % numShards == shard)
+                    fstream << *smoothedGradientIter;
+            }
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradientShard");
+        });
+    }
+}
+
+// write a model or checkpoint file, either directly (through a temporary file that is renamed when complete, to avoid
+// corrupted files if the process dies during writing), or into the staging directory for the background writer
+template <class ElemType>
+void SGD<ElemType>::WriteCheckPointFile(const wstring& fileName, const function<void(File&)>& write)
+{
+    wstring tempFileName = (m_checkPointWriter != nullptr) ? m_checkPointWriter->StagingPath(fileName) : fileName + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        write(fstream);
 
-        renameOrDie(tempFileName, checkPointFileName);
+        // Ensuring that data is written
+        fstream.Flush();
     }
+    if (m_checkPointWriter != nullptr)
+        m_checkPointWriter->Commit(tempFileName, fileName);
+    else
+        renameOrDie(tempFileName, fileName);
+}
+
+template <class ElemType>
+void SGD<ElemType>::SaveModel(ComputationNetworkPtr net, const wstring& modelFileName)
+{
+    if (m_checkPointWriter == nullptr)
+        return net->Save(modelFileName);
+
+    wstring stagingFileName = m_checkPointWriter->StagingPath(modelFileName);
+    net->Save(stagingFileName);
+    m_checkPointWriter->Commit(stagingFileName, modelFileName);
+}
+
+// remove this node's checkpoint files of an epoch; with the background writer, this happens after the files that
+// were committed before are in place, so that there is always a complete checkpoint on disk
+template <class ElemType>
+void SGD<ElemType>::DeleteCheckPointFiles(const int epoch)
+{
+    vector<wstring> fileNames;
+    if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+        fileNames.push_back(GetCheckPointFileNameForEpoch(epoch));
+    if (IsCheckPointSharded() && (g_mpi->CurrentNodeRank() < g_mpi->NumNodesInUse()))
+        fileNames.push_back(GetCheckPointShardFileNameForEpoch(epoch, g_mpi->CurrentNodeRank()));
+
+    for (const auto& fileName : fileNames)
+    {
+        if (m_checkPointWriter != nullptr)
+            m_checkPointWriter->Remove(fileName);
+        else
+            _wunlink(fileName.c_str());
+    }
+}
+
+// make sure the model and checkpoint files of all nodes are in place before reading any of them back
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckPointFiles()
+{
+    if (m_checkPointWriter == nullptr)
+        return;
+    m_checkPointWriter->Wait();
+    if (g_mpi != nullptr)
+        g_mpi->WaitAll();
+}
+
+template <class ElemType>
+bool SGD<ElemType>::IsCheckPointSharded() const
+{
+    return m_shardCheckPoint && (m_parallelizationMethod == ParallelizationMethod::DataParallelSGD) && (g_mpi != nullptr) && (g_mpi->NumNodesInUse() > 1);
 }
 
 template <class ElemType>
@@ -2177,26 +3362,169 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
         minibatchSize = m_mbSize[epochNumber];
     }
 
-    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BParameterUpdates"))
+    {
+        fstream >> m_numParameterUpdates;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EParameterUpdates");
+    }
 
-    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BShards"))
     {
-        Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-        fstream >> smoothedGradient;
+        // sharded checkpoint (see SaveCheckPointInfo()); readable with any number of nodes
+        size_t numShards;
+        fstream >> numShards;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EShards");
+
+        vector<shared_ptr<File>> shards;
+        for (size_t shard = 0; shard < numShards; shard++)
+        {
+            shards.push_back(make_shared<File>(GetCheckPointShardFileNameForEpoch(int(epochNumber), shard), FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead));
+            shards.back()->GetMarker(FileMarker::fileMarkerBeginSection, L"BGradientShard");
+        }
+        size_t k = 0;
+        for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, k++)
+        {
+            Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+            *shards[k % numShards] >> smoothedGradient;
+        }
+        for (auto& shardStream : shards)
+            shardStream->GetMarker(FileMarker::fileMarkerEndSection, L"EGradientShard");
+    }
+    else
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+
+        for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+        {
+            Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+            fstream >> smoothedGradient;
+        }
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
     }
-    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECKP");
 
     return true;
 }
 
+// mid-epoch checkpoint (numMBsToCheckPoint): the model as <model>.mid, and in <model>.mid.ckp where the epoch stands,
+// the optimizer state, and the reader position of every node. The main node writes the model first, so a checkpoint
+// file older than the model is left from an interrupted write and is not used.
+template <class ElemType>
+void SGD<ElemType>::SaveMidEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const MidEpochState& state,
+                                           const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    if ((g_mpi != nullptr) && !g_mpi->IsMainNode())
+        return;
+
+    wstring modelFileName = GetMidEpochModelFileName(epoch);
+    SaveModel(net, modelFileName);
+    WriteCheckPointFile(modelFileName + L".ckp", [&](File& fstream)
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMidEpoch");
+        fstream << state.tunedMBSize << state.numMBsRun << state.totalEpochSamples << state.epochCriterion;
+        fstream << state.epochEvalErrors.size();
+        for (double evalError : state.epochEvalErrors)
+            fstream << evalError;
+        fstream << state.samplePositions.size();
+        for (size_t samplePosition : state.samplePositions)
+            fstream << samplePosition;
+        fstream << m_numParameterUpdates << m_lossScale << m_numMBsSinceLossScaleChange;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMidEpoch");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+        for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+            fstream << *smoothedGradientIter;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    });
+}
+
+// read the mid-epoch checkpoint of 'epoch' into the model and optimizer state, if there is one from this run that fits
+// the minibatch size, the number of nodes, and the evaluation nodes of this one; returns false otherwise
+template <class ElemType>
+bool SGD<ElemType>::LoadMidEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const size_t tunedMBSize, const size_t numEvalNodes,
+                                           /*out*/ MidEpochState& state,
+                                           std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    wstring modelFileName = GetMidEpochModelFileName(epoch);
+    wstring checkPointFileName = modelFileName + L".ckp";
+    if (!fexists(checkPointFileName.c_str()) ||
+        !msra::files::fuptodate(checkPointFileName, GetModelNameForEpoch(epoch - 1), false) || // left over from an earlier run
+        !msra::files::fuptodate(checkPointFileName, modelFileName, true))                       // model written, checkpoint not
+        return false;
+
+    File fstream(checkPointFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BMidEpoch");
+    size_t numEvalErrors, numSamplePositions, numParameterUpdates, numMBsSinceLossScaleChange;
+    double lossScale;
+    fstream >> state.tunedMBSize >> state.numMBsRun >> state.totalEpochSamples >> state.epochCriterion;
+    fstream >> numEvalErrors;
+    state.epochEvalErrors.resize(numEvalErrors);
+    for (auto& evalError : state.epochEvalErrors)
+        fstream >> evalError;
+    fstream >> numSamplePositions;
+    state.samplePositions.resize(numSamplePositions);
+    for (auto& samplePosition : state.samplePositions)
+        fstream >> samplePosition;
+    fstream >> numParameterUpdates >> lossScale >> numMBsSinceLossScaleChange;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EMidEpoch");
+
+    size_t numNodes = (g_mpi != nullptr) ? g_mpi->NumNodesInUse() : 1;
+    if ((state.tunedMBSize != tunedMBSize) || (numSamplePositions != numNodes) || (numEvalErrors != numEvalNodes))
+    {
+        fprintf(stderr, "WARNING: mid-epoch checkpoint %ls was written with a different minibatch size, number of nodes, or evaluation nodes; starting epoch %d over.\n",
+                checkPointFileName.c_str(), epoch + 1);
+        return false;
+    }
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+        fstream >> *smoothedGradientIter;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+    net->RereadPersistableParameters<ElemType>(modelFileName);
+    m_numParameterUpdates = numParameterUpdates;
+    m_lossScale = lossScale;
+    m_numMBsSinceLossScaleChange = numMBsSinceLossScaleChange;
+    return true;
+}
+
+// the mid-epoch checkpoint is obsolete once the epoch's own model and checkpoint are written
+template <class ElemType>
+void SGD<ElemType>::DeleteMidEpochCheckPointFiles(const int epoch)
+{
+    if ((g_mpi != nullptr) && !g_mpi->IsMainNode())
+        return;
+
+    wstring modelFileName = GetMidEpochModelFileName(epoch);
+    vector<wstring> fileNames = {modelFileName + L".ckp", modelFileName};
+    for (const auto& fileName : fileNames)
+    {
+        if (m_checkPointWriter != nullptr)
+            m_checkPointWriter->Remove(fileName);
+        else if (fexists(fileName.c_str()))
+            _wunlink(fileName.c_str());
+    }
+}
+
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochModelFileName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".mid";
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
 {
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetCheckPointShardFileNameForEpoch(const int epoch, const size_t shard)
+{
+    return msra::strfun::wstrprintf(L"%ls.shard%d", GetCheckPointFileNameForEpoch(epoch).c_str(), (int) shard);
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2275,7 +3603,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             fprintf(stderr, "\n###### d%ls######\n", node->NodeName().c_str());
 
             double eOrg = node->Value()(irow, icol);
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
 
@@ -2292,13 +3620,13 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             // TODO: why is this value not used?
             criterionNodes[npos]->Get00Element();
             double eGradErr = node->Gradient()(irow, icol);
-            node->Gradient().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Gradient().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             double ePos = eOrg + EPSILON;
             double eNeg = eOrg - EPSILON;
 
             node->Value()(irow, icol) = (ElemType) ePos;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2307,7 +3635,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             double mbEvalCriPos = criterionNodes[npos]->Get00Element(); // TODO: make Get00Element() a function of ComputationNodeBase
 
             node->Value()(irow, icol) = (ElemType) eNeg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2317,7 +3645,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
 
             // back to its original parameter value
             node->Value()(irow, icol) = (ElemType) eOrg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             // check if they are consistent
             double eGradNum = ((mbEvalCriPos - mbEvalCriNeg) / (ePos - eNeg));
@@ -2369,8 +3697,12 @@ static GradientsUpdateType ParseGradUpdateType(const wstring& s)
         return GradientsUpdateType::RmsProp;
     else if (!_wcsicmp(s.c_str(), L"fsAdagrad"))
         return GradientsUpdateType::FSAdaGrad;
+    else if (!_wcsicmp(s.c_str(), L"adam"))
+        return GradientsUpdateType::Adam;
+    else if (!_wcsicmp(s.c_str(), L"lamb"))
+        return GradientsUpdateType::Lamb;
     else
-        InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
+        InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad | adam | lamb )");
 }
 
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
@@ -2381,8 +3713,10 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
         return ParallelizationMethod::DataParallelSGD;
     else if (!_wcsicmp(s.c_str(), L"ModelAveragingSGD"))
         return ParallelizationMethod::ModelAveragingSGD;
+    else if (!_wcsicmp(s.c_str(), L"AsyncParameterServerSGD"))
+        return ParallelizationMethod::AsyncParameterServerSGD;
     else
-        InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD)");
+        InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD | asyncParameterServerSGD)");
 }
 
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
@@ -2431,6 +3765,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
+    m_searchSnapshotInMemory = configAALR(L"searchSnapshotInMemory", true);
+    m_searchMinibatchCache = configAALR(L"searchMinibatchCache", true);
     m_loadBestModel = configAALR(L"loadBestModel", true);
     m_useCVSetControlLRIfCVExists = configAALR(L"UseCVSetControlLRIfCVExists", true);
     m_useEvalCriterionControlLR = configAALR(L"UseEvalCriterionControlLR", false);
@@ -2442,6 +3778,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_recoverFromOutOfMemory = configSGD(L"recoverFromOutOfMemory", false);
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     m_epochSize = configSGD(L"epochSize", (size_t) 0);
@@ -2453,6 +3790,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     // the total number of epochs to run.
     m_maxEpochs = configSGD(L"maxEpochs");
 
+    m_pruningTargetSparsity = configSGD(L"pruningTargetSparsity", 0.0);
+    m_pruningStartEpoch = configSGD(L"pruningStartEpoch", (size_t) 1);
+    m_pruningEndEpoch = configSGD(L"pruningEndEpoch", m_maxEpochs);
+
     // Note: Momentum is best specified as a MB-size agnostic fashion.
     // Because momentum per sample is a number very close to 1, it is more handy to use a logarithmic specification.
     // We use 'momentumAsTimeConstant' to specify the time constant of the low-pass filter that momentum really is.
@@ -2464,10 +3805,38 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     bool useNesterovMomentum = configSGD(L"useNAG", false);
 
     m_maxTempMemSizeInSamplesForCNN = configSGD(L"maxTempMemSizeInSamplesForCNN", (size_t) 0);
+    m_gradientCheckpointing = configSGD(L"gradientCheckpointing", false);
+    m_concurrentForwardProp = configSGD(L"concurrentForwardProp", false);
+    m_elementwiseFusion = configSGD(L"elementwiseFusion", false);
+    m_simplifyGraph = configSGD(L"simplifyGraph", false);
+    m_skipGapsInLoops = configSGD(L"skipGapsInLoops", false);
+    m_simpleRNNLoopFusion = configSGD(L"simpleRNNLoopFusion", false);
+    m_fusedParameterUpdate = configSGD(L"fusedParameterUpdate", false);
+    m_offloadOptimizerState = configSGD(L"offloadOptimizerState", false);
+    m_prefetchMinibatches = configSGD(L"prefetchMinibatches", false);
+    m_trainingDataCache = (const wstring&) configSGD(L"trainingDataCache", L"none");
+    m_trainingDataCacheMaxMB = configSGD(L"trainingDataCacheMaxMB", (size_t) 4096);
+    if (m_trainingDataCache != L"none" && m_trainingDataCache != L"device" && m_trainingDataCache != L"host")
+        InvalidArgument("trainingDataCache: '%ls' is not one of 'none', 'device', 'host'.", m_trainingDataCache.c_str());
+    m_dynamicLossScaling = configSGD(L"dynamicLossScaling", false);
+    m_initialLossScale = configSGD(L"initialLossScale", 65536.0);
+    m_lossScaleGrowthInterval = configSGD(L"lossScaleGrowthInterval", (size_t) 2000);
+    if (m_dynamicLossScaling && m_initialLossScale < 1)
+        InvalidArgument("initialLossScale must be at least 1.");
+    if (m_dynamicLossScaling && m_lossScaleGrowthInterval == 0)
+        InvalidArgument("lossScaleGrowthInterval must be at least 1.");
 
     m_traceLevel = configSGD(L"traceLevel", (int) 0);
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t) 10);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t) 0);
+    m_numMBsToProfileExecution = configSGD(L"numMBsToProfileExecution", (size_t) 0);
+    m_memoryReport = configSGD(L"memoryReport", false);
+    m_implicitDeviceTransfers = DeviceTransferMonitor::ParseMode(configSGD(L"implicitDeviceTransfers", L"allow"));
+    m_metricsExportInterval = configSGD(L"metricsExportInterval", 10.0);
+    if (m_metricsExportInterval <= 0)
+        InvalidArgument("metricsExportInterval must be positive.");
+    m_gpuSamplingInterval = configSGD(L"gpuSamplingInterval", 0.0);
+    m_asyncProgressLog = configSGD(L"asyncProgressLog", false);
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
@@ -2496,6 +3865,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_rpi.max = configSGD(L"rms_wgt_max", 10.0);
     m_rpi.gamma = configSGD(L"rms_gamma", 0.99);
 
+    // Adam and Lamb parameters
+    m_adamInfo.beta1 = configSGD(L"adam_beta1", 0.9);
+    m_adamInfo.beta2 = configSGD(L"adam_beta2", 0.999);
+    m_adamInfo.epsilon = configSGD(L"adam_epsilon", 1e-8);
+    if (m_adamInfo.beta1 < 0 || m_adamInfo.beta1 >= 1 || m_adamInfo.beta2 < 0 || m_adamInfo.beta2 >= 1)
+        InvalidArgument("adam_beta1 and adam_beta2 must be in [0, 1).");
+
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
@@ -2522,6 +3898,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_numSamplesForPreCompute = configSGD(L"numSamplesForPreCompute", (size_t) 0);
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", false);
+    m_streamingPreCompute = configSGD(L"streamingPreCompute", false);
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2624,9 +4003,52 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInMB = 0;
+    m_overlapGradientAggregation = false;
+    m_gpuDirectGradientAggregation = false;
+    m_hierarchicalAllReduce = false;
+    m_sparseGradientDensity = 0;
+    m_gradientTopKRatio = 0;
+    m_adaptiveGradientBits = false;
+    m_gradientBitsMin = 1;
+    m_gradientBitsMax = 8;
     m_enableDistributedMBReading = false;
+    m_dynamicDataDistribution = false;
+    m_workItemSizeInMinibatches = 16;
     m_parallelizationStartEpochNum = 0;
+    m_shardCheckPoint = false;
+    m_elasticJoin = false;
     m_nFramesBetweenMASync = 40000; // default 40k frames
+    m_overlapModelAveraging = false;
+    m_blockMomentum = 0;
+    m_parameterServerSyncPeriod = 1;
+    m_parameterServerMaxStaleness = 4;
+
+    intargvector dataParallelDevices = configSGD(L"dataParallelDevices", ConfigRecordType::Array(intargvector()));
+    for (size_t i = 0; i < dataParallelDevices.size(); i++)
+        m_dataParallelDevices.push_back((DEVICEID_TYPE) dataParallelDevices[i]);
+
+    m_gradientAccumulationSteps = configSGD(L"gradientAccumulationSteps", (size_t) 1);
+    if (m_gradientAccumulationSteps == 0)
+        InvalidArgument("gradientAccumulationSteps must be at least 1.");
+
+    m_hogwildThreads = configSGD(L"hogwildThreads", (size_t) 0);
+    wstring hogwildLocking = (const wstring&) configSGD(L"hogwildLocking", L"none");
+    if (!_wcsicmp(hogwildLocking.c_str(), L"striped"))
+        m_hogwildStripedLocks = true;
+    else if (!_wcsicmp(hogwildLocking.c_str(), L"none"))
+        m_hogwildStripedLocks = false;
+    else
+        InvalidArgument("hogwildLocking must be 'none' or 'striped'.");
+    if (m_hogwildThreads > 1)
+    {
+        if (!m_dataParallelDevices.empty())
+            InvalidArgument("hogwildThreads cannot be combined with dataParallelDevices.");
+        if (m_gradientAccumulationSteps > 1)
+            InvalidArgument("hogwildThreads cannot be combined with gradientAccumulationSteps.");
+        if (m_gradType.mType != GradientsUpdateType::None || m_L2RegWeight > 0 || m_L1RegWeight > 0 || m_dynamicLossScaling)
+            InvalidArgument("hogwildThreads only supports plain SGD with momentum (gradUpdateType=None, no L1/L2 regularization or dynamic loss scaling).");
+    }
 
     if ((g_mpi != nullptr) && configSGD.Exists(L"ParallelTrain"))
     {
@@ -2634,7 +4056,17 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
         m_parallelizationMethod = ParseParallelizationMethod(configParallelTrain(L"parallelizationMethod", L"none"));
         m_parallelizationStartEpochNum = configParallelTrain(L"parallelizationStartEpoch", (int) 1) - 1; // Epoch numbers internally are 0 based
         m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
+        m_dynamicDataDistribution = configParallelTrain(L"dynamicDataDistribution", false);
+        m_workItemSizeInMinibatches = configParallelTrain(L"workItemSizeInMinibatches", (size_t) 16);
+        if (m_workItemSizeInMinibatches == 0)
+            InvalidArgument("workItemSizeInMinibatches must be at least 1.");
         m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int) 0);
+        m_shardCheckPoint = configParallelTrain(L"shardCheckPoint", false);
+        if (m_shardCheckPoint && (m_parallelizationMethod != ParallelizationMethod::DataParallelSGD))
+        {
+            fprintf(stderr, "WARNING: shardCheckPoint is only supported with DataParallelSGD, where all nodes hold the same optimizer state; ignored.\n");
+            m_shardCheckPoint = false;
+        }
 
         if (configParallelTrain.Exists(L"DataParallelSGD"))
         {
@@ -2643,18 +4075,74 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientBucketSizeInMB = configDataParallelSGD(L"gradientBucketSizeInMB", 0.0);
+            if (m_gradientBucketSizeInMB < 0)
+                InvalidArgument("gradientBucketSizeInMB must not be negative.");
+            m_overlapGradientAggregation = configDataParallelSGD(L"overlapGradientAggregation", false);
+            if (m_overlapGradientAggregation && m_gradientAccumulationSteps > 1)
+            {
+                fprintf(stderr, "WARNING: overlapGradientAggregation is not supported with gradientAccumulationSteps and will be ignored.\n");
+                m_overlapGradientAggregation = false; // (backprop would hand over the gradients of a single minibatch)
+            }
+            if (m_overlapGradientAggregation && m_recoverFromOutOfMemory)
+            {
+                fprintf(stderr, "WARNING: overlapGradientAggregation is not supported with recoverFromOutOfMemory and will be ignored.\n");
+                m_overlapGradientAggregation = false; // (a backprop that runs out of memory would leave the aggregation half done)
+            }
+            m_gpuDirectGradientAggregation = configDataParallelSGD(L"useGPUDirectGradientAggregation", false);
+            m_hierarchicalAllReduce = configDataParallelSGD(L"useHierarchicalAllReduce", false);
+            m_sparseGradientDensity = configDataParallelSGD(L"sparseGradientDensity", 0.0);
+            if ((m_sparseGradientDensity < 0) || (m_sparseGradientDensity >= 1))
+                InvalidArgument("sparseGradientDensity must be in the range [0, 1).");
+            m_gradientTopKRatio = configDataParallelSGD(L"gradientTopKRatio", 0.0);
+            if ((m_gradientTopKRatio < 0) || (m_gradientTopKRatio > 1))
+                InvalidArgument("gradientTopKRatio must be in the range [0, 1].");
+            m_adaptiveGradientBits = configDataParallelSGD(L"adaptiveGradientBits", false);
+            m_gradientBitsMin = configDataParallelSGD(L"gradientBitsMin", (size_t) 1);
+            m_gradientBitsMax = configDataParallelSGD(L"gradientBitsMax", (size_t) 8);
+            if (m_adaptiveGradientBits && !configDataParallelSGD.Exists(L"gradientBits"))
+                m_numGradientBits = 1; // (start low)
             if ((m_numGradientBits < 1) || (m_numGradientBits > (8 * sizeofElemType)))
             {
                 InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
             }
         }
 
+        m_elasticPortFile = (const wstring&) configParallelTrain(L"elasticPortFile", L"");
+        m_elasticJoin = configParallelTrain(L"elasticJoin", false);
+        if (!m_elasticPortFile.empty())
+        {
+            if (m_parallelizationMethod != ParallelizationMethod::DataParallelSGD)
+                InvalidArgument("elasticPortFile is only supported with DataParallelSGD.");
+            if (m_shardCheckPoint || m_bufferedAsyncGradientAggregation)
+                InvalidArgument("elasticPortFile cannot be combined with shardCheckPoint or useBufferedAsyncGradientAggregation, which depend on a fixed set of nodes.");
+        }
+        else if (m_elasticJoin)
+            InvalidArgument("elasticJoin requires the elasticPortFile of the job to join.");
+
         if (configParallelTrain.Exists(L"ModelAveragingSGD"))
         {
             const ConfigRecordType& configMASGD(configParallelTrain(L"ModelAveragingSGD", ConfigRecordType::Record()));
             m_nFramesBetweenMASync = configMASGD(L"syncFrequencyInFrames", (size_t) 40000);
+            m_overlapModelAveraging = configMASGD(L"overlapModelAveraging", false);
+            m_blockMomentum = configMASGD(L"blockMomentum", 0.0);
+            if ((m_blockMomentum < 0) || (m_blockMomentum >= 1))
+                InvalidArgument("blockMomentum must be in the range [0, 1).");
+        }
+
+        if (configParallelTrain.Exists(L"AsyncParameterServerSGD"))
+        {
+            const ConfigRecordType& configPSSGD(configParallelTrain(L"AsyncParameterServerSGD", ConfigRecordType::Record()));
+            m_parameterServerSyncPeriod = configPSSGD(L"syncPeriodInMinibatches", (size_t) 1);
+            if (m_parameterServerSyncPeriod == 0)
+                InvalidArgument("syncPeriodInMinibatches must be at least 1.");
+            m_parameterServerMaxStaleness = configPSSGD(L"maxStaleness", (size_t) 4);
         }
     }
+    if (!m_dataParallelDevices.empty() && (m_parallelizationMethod != ParallelizationMethod::None))
+        InvalidArgument("dataParallelDevices cannot be combined with parallel training over MPI (ParallelTrain).");
+    if (m_hogwildThreads > 1 && (m_parallelizationMethod != ParallelizationMethod::None))
+        InvalidArgument("hogwildThreads cannot be combined with parallel training over MPI (ParallelTrain).");
 }
 
 static size_t GetSizeOfPrecision(const ScriptableObjects::IConfigRecordPtr configp)
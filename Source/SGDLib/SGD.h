@@ -17,6 +17,13 @@
 #include <chrono>
 #include <random>
 #include "Profiler.h"
+#include "TrainingMetrics.h"
+#include "DeviceTransferMonitor.h"
+#include "WeightPruning.h"
+#include "OptimizerStateOffload.h"
+#include "BackgroundCrossValidation.h"
+#include "Distillation.h"
+#include "TrainingDataCache.h"
 
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
@@ -40,7 +47,9 @@ enum class GradientsUpdateType : int
     None,
     AdaGrad,
     RmsProp,
-    FSAdaGrad
+    FSAdaGrad,
+    Adam,
+    Lamb // Adam with a per-parameter trust ratio ||w|| / ||update||, for very large minibatches
 };
 
 // TODO: While currently combining these methods is not supported,
@@ -51,7 +60,8 @@ enum class ParallelizationMethod : int
     None = 0,
     DataParallelSGD = 1,
     ModelAveragingSGD = (1 << 1),
-    ModelParallelSGD = (1 << 2), // Currently unsupported
+    ModelParallelSGD = (1 << 2), // Currently unsupported as a parallelization method; within one process, nodes can be placed on different devices instead (see DeviceTransferNode)
+    AsyncParameterServerSGD = (1 << 3),
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -73,6 +83,20 @@ struct RMSPropInfo
     }
 };
 
+struct AdamInfo
+{
+    double beta1; // decay of the first-moment (momentum) estimate
+    double beta2; // decay of the second-moment estimate
+    double epsilon;
+
+    AdamInfo()
+    {
+        beta1 = 0.9;
+        beta2 = 0.999;
+        epsilon = 1e-8;
+    }
+};
+
 struct GradientUpdateInfo
 {
     GradientsUpdateType mType;
@@ -159,6 +183,12 @@ protected:
     // default is 1, which means no subminibatch is used
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
+    bool m_recoverFromOutOfMemory;
+    // if forward/backprop of a minibatch runs out of (GPU) memory, start it over in twice as many subminibatches
+    // (split along the parallel sequences), as often as needed, instead of failing
+
+    // the gradients of this many minibatches, as read, are summed before each update, see GradientAccumulator
+    size_t m_gradientAccumulationSteps;
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
@@ -167,11 +197,20 @@ protected:
     // the total number of epochs to run.
     size_t m_maxEpochs;
 
+    // gradual magnitude pruning of the weight matrices, see WeightPruning (target 0: off); epochs are 1-based
+    double m_pruningTargetSparsity;
+    size_t m_pruningStartEpoch;
+    size_t m_pruningEndEpoch;
+
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
 
     intargvector m_numMiniBatch4LRSearch;
     size_t m_numBestSearchEpoch;
+    // learning-rate and minibatch-size search: restore the model between trials from copies kept in (device) memory instead of
+    // rereading the model and checkpoint files, and replay the minibatches of the first learning-rate trial in the others
+    bool m_searchSnapshotInMemory;
+    bool m_searchMinibatchCache;
 
     LearningRateSearchAlgorithm m_autoLearnRateSearchType;
 
@@ -200,6 +239,34 @@ protected:
     floatargvector m_dropoutRates;
     size_t m_maxTempMemSizeInSamplesForCNN;
 
+    // gradient checkpointing: recompute cheap activations in backprop instead of holding them (trades compute for memory)
+    bool m_gradientCheckpointing;
+    // run independent nodes concurrently in forward prop (CPU only; helps networks made of many small operations),
+    // and independent recurrent loops in forward prop and backprop (any device; helps bidirectional recurrent layers)
+    bool m_concurrentForwardProp;
+    // compute a Plus that only feeds an elementwise nonlinearity in the same pass as that nonlinearity
+    bool m_elementwiseFusion;
+    // before training, merge identical nodes and fold the subexpressions of constants (parameters that are not updated)
+    bool m_simplifyGraph;
+    // in recurrent loops, compute each time step only for the parallel sequences that are not gaps (for sequences of mixed lengths)
+    bool m_skipGapsInLoops;
+    // run the forward prop of recurrent loops h = f(x + R * PastValue(h)) in one pass (one GPU kernel instead of several per time step)
+    bool m_simpleRNNLoopFusion;
+    // update all dense parameters in one fused step instead of a chain of kernels per parameter (cuts launch overhead)
+    bool m_fusedParameterUpdate;
+    // keep the smoothed gradients in host memory, and on the GPU only while updating, see OptimizerStateOffload
+    bool m_offloadOptimizerState;
+    // read the next minibatch on a background thread while the current one is trained on (for readers without read-ahead)
+    bool m_prefetchMinibatches;
+    // keep the training data in memory after the first epoch, see TrainingDataCache: "none", "device", or "host"
+    wstring m_trainingDataCache;
+    size_t m_trainingDataCacheMaxMB;
+    // dynamic loss scaling, for gradients kept in reduced precision: backprop is seeded with a large loss scale so that
+    // small gradients do not underflow; minibatches whose gradients overflow are skipped and halve the scale
+    bool m_dynamicLossScaling;
+    double m_initialLossScale;
+    size_t m_lossScaleGrowthInterval; // double the loss scale after this many minibatches without overflow
+
     int m_traceLevel;
 
     size_t m_numPrevLearnRates;
@@ -208,9 +275,25 @@ protected:
 
     GradientUpdateInfo m_gradType;
     RMSPropInfo m_rpi;
+    AdamInfo m_adamInfo; // Adam and Lamb
 
     int m_numMBsToShowResult;
     int m_numMBsToCUDAProfile;
+    // time each node's forward and backward pass and the reading, aggregation and update phases of this many
+    // minibatches of the first epoch trained, see ExecutionProfiler
+    size_t m_numMBsToProfileExecution;
+    // print the memory held per node, per matrix-pool bucket and per optimizer state: as planned after allocating the
+    // network, and as allocated (i.e. the peak so far) after each epoch
+    bool m_memoryReport;
+    // 'trace': list the matrices that Matrix operations move between devices implicitly, per node, after each epoch;
+    // 'fail': make such a transfer inside a node's forward or backward pass an error; see DeviceTransferMonitor
+    DeviceTransferMonitor::Mode m_implicitDeviceTransfers;
+    double m_metricsExportInterval; // seconds
+    // if > 0: sample the GPU's utilization, memory bandwidth, PCIe throughput and power this often (seconds) through NVML,
+    // and add their means to the progress messages and the metrics export, see GPUWatcher
+    double m_gpuSamplingInterval;
+    // write the progress messages (and those of the evaluator, ProgressTracing) from a background thread, see AsyncLog
+    bool m_asyncProgressLog;
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -218,11 +301,22 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    size_t m_numSamplesForPreCompute; // if not 0, precompute from only this many samples (the first ones of epoch 0)
+    // with several workers, each precomputes over its share of the data; the statistics are then merged
+    bool m_distributedPreCompute;
+    // accumulate the statistics during the first epoch (with running estimates) instead of in a pass of their own
+    bool m_streamingPreCompute;
+    std::list<ComputationNodeBasePtr> m_streamingPreComputeNodes; // (while accumulating)
 
     // Parallel training
     ParallelizationMethod m_parallelizationMethod;
     bool m_enableDistributedMBReading;
+    bool m_dynamicDataDistribution;      // with distributed reading: nodes claim blocks of the epoch from a shared queue instead of reading a fixed subset
+    size_t m_workItemSizeInMinibatches; // size of these blocks
     int m_parallelizationStartEpochNum;
+    bool m_shardCheckPoint; // every node writes a share of the smoothed gradients; the main node's .ckp file lists the shards
+    wstring m_elasticPortFile; // if given, workers may join and leave at the end of each epoch, see ElasticTraining
+    bool m_elasticJoin;        // this process joins the running job whose main node published the port file
 
     // decide if/how often we measure and show sync performance stats (seconds spend on sync, seconds since last sync etc.) ?
     // 0: No sync perfomance stats
@@ -233,10 +327,32 @@ protected:
     // Data parallel SGD training parameters
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
+    double m_gradientBucketSizeInMB; // pack small gradients into buckets of this size for aggregation (0: one message per gradient)
+    bool m_overlapGradientAggregation; // start aggregating gradients during backprop, as soon as each one is final
+    bool m_gpuDirectGradientAggregation; // reduce GPU gradients in device memory through a CUDA-aware MPI, bypassing host buffers
+    bool m_hierarchicalAllReduce;        // reduce gradients within each host first, then across hosts among one rank per host
+    double m_sparseGradientDensity;      // exchange gradients with values in at most this fraction of their columns as sparse columns (0: off)
     bool m_zeroThresholdFor1Bit;
+    double m_gradientTopKRatio; // if > 0: exchange only this fraction of the gradient values (largest first), see QuantizedDistGradAggregator
+    bool m_adaptiveGradientBits; // choose the bits per gradient, between m_gradientBitsMin and m_gradientBitsMax, see QuantizedDistGradAggregator
+    size_t m_gradientBitsMin;
+    size_t m_gradientBitsMax;
 
     // Parallel training related with MA
     size_t m_nFramesBetweenMASync;
+    bool m_overlapModelAveraging; // average a snapshot in the background while training continues, see OverlappedModelAverager
+    double m_blockMomentum;       // block momentum for m_overlapModelAveraging
+
+    // Parallel training with an asynchronous parameter server, see AsyncParameterServer
+    size_t m_parameterServerSyncPeriod;    // minibatches between pushes of the local model delta
+    size_t m_parameterServerMaxStaleness; // minibatches a worker may run ahead while its pull is pending
+
+    // single-process data parallelism: the GPUs besides the network's own to train on, see LocalDataParallel
+    std::vector<DEVICEID_TYPE> m_dataParallelDevices;
+
+    // lock-free multithreaded training on the CPU, see HogwildTraining
+    size_t m_hogwildThreads; // 0 or 1: off
+    bool m_hogwildStripedLocks;
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
@@ -256,6 +372,23 @@ protected:
 template <class ElemType>
 class IDistGradAggregator;
 
+template <class ElemType>
+class AsyncParameterServer;
+
+template <class ElemType>
+class OverlappedModelAverager;
+
+template <class ElemType>
+class LocalDataParallel;
+
+template <class ElemType>
+class HogwildTraining;
+
+template <class ElemType>
+class ElasticTraining;
+
+class AsyncCheckpointWriter;
+
 // -----------------------------------------------------------------------
 // class SGD
 // -----------------------------------------------------------------------
@@ -277,13 +410,34 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_numMBsToCheckPoint(configSGD(L"numMBsToCheckPoint", (size_t) 0)),
+          m_checkPointStagingDir((const wstring&) configSGD(L"checkPointStagingDir", L"")),
+          m_executionTraceFile((const wstring&) configSGD(L"executionTraceFile", L"")),
+          m_metricsFile((const wstring&) configSGD(L"metricsFile", L"")),
+          m_teacherModelPath((const wstring&) configSGD(L"teacherModelPath", L"")),
+          m_teacherOutputNodeName((const wstring&) configSGD(L"teacherOutputNodeName", L"")),
+          m_distillationTargetNodeName((const wstring&) configSGD(L"distillationTargetNodeName", L"")),
+          m_teacherDeviceId((DEVICEID_TYPE) (int) configSGD(L"teacherDeviceId", (int) DEVICEID_NOTYETDETERMINED)),
+          m_distillationTemperature(configSGD(L"distillationTemperature", 1.0)),
+          m_distillationTopK(configSGD(L"distillationTopK", (size_t) 0)),
+          m_cvDeviceId((DEVICEID_TYPE) (int) configSGD(L"cvDeviceId", (int) DEVICEID_NOTYETDETERMINED)),
+          m_cvMaxDelay(configSGD(L"cvMaxDelay", (size_t) 1)),
           // m_validateAfterModelReloading(configSGD(L"validateAfterModelReloading", true)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_prevChosenMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
+          m_lossScale(m_initialLossScale),
+          m_numMBsSinceLossScaleChange(0),
+          m_numParameterUpdates(0),
           m_distGradAgg(nullptr),
-          m_gradHeader(nullptr)
+          m_gradHeader(nullptr),
+          m_parameterServer(nullptr),
+          m_modelAverager(nullptr),
+          m_checkPointWriter(nullptr),
+          m_localDataParallel(nullptr),
+          m_hogwild(nullptr),
+          m_elastic(nullptr)
     {
         msra::files::make_intermediate_dirs(m_modelPath);
     }
@@ -299,6 +453,14 @@ public:
                IDataReader<ElemType>* trainSetDataReader,
                IDataReader<ElemType>* validationSetDataReader,
                const bool makeMode = true);
+    // Train() in two steps, so that the caller can prepare the readers meanwhile: CreateOrLoadNetwork() creates the
+    // network, or loads the checkpoint to continue from, and returns nullptr if no further training is necessary;
+    // TrainFromEpoch() then trains it, from the 'startEpoch' that CreateOrLoadNetwork() determined.
+    ComputationNetworkPtr CreateOrLoadNetwork(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                                              const bool makeMode, int& startEpoch);
+    void TrainFromEpoch(ComputationNetworkPtr net, int startEpoch,
+                        IDataReader<ElemType>* trainSetDataReader,
+                        IDataReader<ElemType>* validationSetDataReader);
     void Adapt(wstring origModelFileName, wstring refNodeName,
                IDataReader<ElemType>* trainSetDataReader,
                IDataReader<ElemType>* validationSetDataReader,
@@ -323,6 +485,8 @@ protected:
                     std::vector<ComputationNodeBasePtr>& featureNodes,
                     std::vector<ComputationNodeBasePtr>& labelNodes,
                     std::map<std::wstring, Matrix<ElemType>*>* inputMatrices);
+    void MergePreComputedStatistics(const std::list<ComputationNodeBasePtr>& nodes);
+    void FinishStreamingPreCompute();
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -358,6 +522,20 @@ protected:
                                          /*out*/ size_t& totalSamplesSeen,
                                          std::string prefixMsg = "");
 
+    // state that a search trial changes: the values of all LearnableParameter nodes (also those not being learned, which
+    // some nodes update as running statistics), the smoothed gradients, and the update counters
+    struct SearchSnapshot
+    {
+        std::vector<std::pair<ComputationNodePtr, std::shared_ptr<Matrix<ElemType>>>> parameters;
+        std::vector<std::shared_ptr<Matrix<ElemType>>> smoothedGradients;
+        size_t totalSamplesSeen;
+        size_t numParameterUpdates;
+        double lossScale;
+        size_t numMBsSinceLossScaleChange;
+    };
+    void TakeSearchSnapshot(ComputationNetworkPtr net, const std::list<Matrix<ElemType>>& smoothedGradients, const size_t totalSamplesSeen);
+    void RestoreSearchSnapshot(std::list<Matrix<ElemType>>& smoothedGradients, /*out*/ size_t& totalSamplesSeen);
+
     size_t AdaptiveMinibatchSizing(ComputationNetworkPtr net,
                                    ComputationNetworkPtr refNet,
                                    const ComputationNodeBasePtr& refNode,
@@ -421,7 +599,8 @@ protected:
                          /*out*/ double& epochCriterion,
                          /*out*/ std::vector<double>& epochEvalErrors,
                          /*out*/ size_t& totalSamplesSeen,
-                         std::string prefixMsg = "");
+                         std::string prefixMsg = "",
+                         bool midEpochCheckPoints = false);
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
 
@@ -454,13 +633,38 @@ protected:
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
 
+    // fusedParameterUpdate: parameters collected by AddToFusedUpdate() are updated together by UpdateWeightsFused(),
+    // in one pass per element (one kernel launch on the GPU), see Matrix<ElemType>::MultiTensorUpdate()
+    struct FusedUpdate
+    {
+        DEVICEID_TYPE deviceId;
+        ElemType adaWeight; // FSAdagrad
+        std::vector<MultiTensorUpdateTensor<ElemType>> tensors;
+    };
+    // returns false if the parameter needs UpdateWeights() instead
+    bool AddToFusedUpdate(FusedUpdate& fused, const ComputationNodeBasePtr& node, Matrix<ElemType>& smoothedGradient,
+                          const size_t actualMBSize, const bool needAveMultiplier) const;
+    void UpdateWeightsFused(const FusedUpdate& fused,
+                            const double learnRatePerSample,
+                            const double momentumPerSample,
+                            const size_t actualMBSize,
+                            const double L2RegWeight, const double L1RegWeight,
+                            const bool useNesterovMomentum) const;
+
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
+    bool UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes);
+
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const double prevCriterion,
                             const size_t minibatchSize);
+    void SaveModel(ComputationNetworkPtr net, const wstring& modelFileName);
+    void WriteCheckPointFile(const wstring& fileName, const function<void(File&)>& write);
+    void DeleteCheckPointFiles(const int epoch);
+    void WaitForCheckPointFiles();
+    bool IsCheckPointSharded() const;
 
     bool LoadCheckPointInfo(const size_t epochNumber,
                             /*out*/ size_t& totalSamplesSeen,
@@ -469,7 +673,26 @@ protected:
                             /*out*/ double& prevCriterion,
                             /*out*/ size_t& minibatchSize);
 
+    // mid-epoch checkpoints (numMBsToCheckPoint): where an interrupted epoch stands
+    struct MidEpochState
+    {
+        size_t tunedMBSize; // the epoch can only be continued with the same minibatch size
+        size_t numMBsRun;
+        size_t totalEpochSamples;
+        double epochCriterion;
+        std::vector<double> epochEvalErrors;
+        std::vector<size_t> samplePositions; // [rank] reader position of each node, see IDataReader::GetCurrentSamplePosition()
+    };
+    void SaveMidEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const MidEpochState& state,
+                                const std::list<Matrix<ElemType>>& smoothedGradients);
+    bool LoadMidEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const size_t tunedMBSize, const size_t numEvalNodes,
+                                /*out*/ MidEpochState& state,
+                                std::list<Matrix<ElemType>>& smoothedGradients);
+    void DeleteMidEpochCheckPointFiles(const int epoch);
+    wstring GetMidEpochModelFileName(const int epoch);
+
     wstring GetCheckPointFileNameForEpoch(const int epoch);
+    wstring GetCheckPointShardFileNameForEpoch(const int epoch, const size_t shard);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
 
     // return -1 if nothing exists
@@ -495,6 +718,20 @@ public:
 protected:
     wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    size_t m_numMBsToCheckPoint; // if > 0, a mid-epoch checkpoint is written every that many minibatches, from which an interrupted epoch continues
+    wstring m_checkPointStagingDir; // if given, model and checkpoint files are written here and moved to their final location in the background
+    wstring m_executionTraceFile;   // Chrome trace of numMBsToProfileExecution; default: <modelPath>.trace.json
+    wstring m_metricsFile;          // if given, training metrics are appended here every metricsExportInterval seconds, see TrainingMetrics
+    // knowledge distillation, see Distillation: the teacher's soft targets softmax(output / temperature) become the input 'distillationTargetNodeName'
+    wstring m_teacherModelPath;     // if given, distillation is on
+    wstring m_teacherOutputNodeName;
+    wstring m_distillationTargetNodeName;
+    DEVICEID_TYPE m_teacherDeviceId; // default: the student's device
+    double m_distillationTemperature;
+    size_t m_distillationTopK; // 0: all classes
+    // cross-validation in the background, see BackgroundCrossValidation
+    DEVICEID_TYPE m_cvDeviceId; // default: none, cross-validation runs between the epochs
+    size_t m_cvMaxDelay;        // epochs by which learning-rate control may lag behind
     // bool m_validateAfterModelReloading; // TODO: remove this. Why would one not validate a model?
 
     wstring m_trainCriterionNodeName;
@@ -503,8 +740,33 @@ protected:
     size_t m_prevChosenMinibatchSize;
     double m_lastFinishedEpochTrainLoss;
 
+    // state of dynamic loss scaling (carried across epochs)
+    double m_lossScale;
+    size_t m_numMBsSinceLossScaleChange;
+    shared_ptr<Matrix<ElemType>> m_gradientAbsSum; // 1x1 on the gradients' device, see UnscaleGradients()
+
+    // minibatches whose update has been applied (carried across epochs, saved in checkpoints); Adam's bias correction depends on it
+    size_t m_numParameterUpdates;
+
+    // set while a learning-rate or minibatch-size search restores trials from memory (m_searchSnapshotInMemory)
+    std::unique_ptr<SearchSnapshot> m_searchSnapshot;
+
+    std::unique_ptr<GPUWatcher> m_gpuWatcher;           // while training with a gpuSamplingInterval
+    std::unique_ptr<TrainingMetrics> m_trainingMetrics; // while training with a metricsFile
+    std::unique_ptr<WeightPruning<ElemType>> m_weightPruning; // while training with a pruningTargetSparsity
+    std::unique_ptr<OptimizerStateOffload<ElemType>> m_optimizerStateOffload; // with offloadOptimizerState on a GPU
+    std::unique_ptr<Distillation<ElemType>> m_distillation;   // while training with a teacherModelPath
+    std::unique_ptr<BackgroundCrossValidation<ElemType>> m_backgroundCV; // while training with a cvDeviceId
+    std::unique_ptr<TrainingDataCache<ElemType>> m_trainingDataCacheReader; // while training with a trainingDataCache
+
     IDistGradAggregator<ElemType>* m_distGradAgg;
     struct DistGradHeader* m_gradHeader;
+    AsyncParameterServer<ElemType>* m_parameterServer;
+    OverlappedModelAverager<ElemType>* m_modelAverager;
+    AsyncCheckpointWriter* m_checkPointWriter;
+    LocalDataParallel<ElemType>* m_localDataParallel;
+    HogwildTraining<ElemType>* m_hogwild;
+    ElasticTraining<ElemType>* m_elastic; // while training with an elasticPortFile
 
 private:
     int SGDTrace(FILE* __restrict __stream, const char* __restrict __format, ...);
@@ -14,8 +14,16 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // bucketSizeInBytes: consecutive gradient matrices are packed into contiguous buckets of up to this size, which are
+    // transferred and reduced as one message each (0: one message per matrix)
+    // useDeviceCollectives: reduce GPU gradients in place by MPIWrapper::RingAllReduce(), without staging them in host
+    // memory (requires a CUDA-aware MPI; otherwise, and for CPU gradients, the host path is used)
+    // useHierarchicalAllReduce: reduce the (host) buffers by MPIWrapper::HierarchicalAllReduce(), i.e. within each host
+    // first, so that only one rank per host communicates across hosts
+    // sparseGradientDensity: gradients that only have values in at most this fraction of their columns (e.g. embeddings
+    // fed by sparse inputs) are exchanged as (column index, column values) by AggregateSparseGradient() (0: off)
+    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace, size_t bucketSizeInBytes = 0, bool useDeviceCollectives = false, bool useHierarchicalAllReduce = false, double sparseGradientDensity = 0)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_bucketSizeInBytes(bucketSizeInBytes), m_useDeviceCollectives(useDeviceCollectives), m_useHierarchicalAllReduce(useHierarchicalAllReduce), m_sparseGradientDensity(sparseGradientDensity), m_overlapActive(false), m_nextBucketToStart(0), m_deviceCopySeconds(0), m_mpiSeconds(0), m_headerSeconds(0)
     {
     }
 
@@ -32,6 +40,14 @@ public:
         }
     }
 
+    bool GetPhaseSeconds(double& deviceCopySeconds, double& mpiSeconds, double& headerSeconds) const override
+    {
+        deviceCopySeconds = m_deviceCopySeconds;
+        mpiSeconds = m_mpiSeconds;
+        headerSeconds = m_headerSeconds;
+        return true;
+    }
+
     // Aggregate the gradient matrices across all nodes
     bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) override
     {
@@ -121,7 +137,78 @@ public:
         }
     }
 
+    // With double-buffered async aggregation, the gradients are only aggregated after the next minibatch's backprop anyway.
+    bool SupportsOverlappedAggregation() const override
+    {
+        return !m_useAsyncAggregation;
+    }
+
+    void BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& gradients) override
+    {
+        // the buckets are created by the first AggregateGradients() call; until then there is nothing to overlap
+        m_overlapActive = SupportsOverlappedAggregation() && !m_buckets.empty();
+        if (!m_overlapActive)
+            return;
+
+        m_overlappedGradients = gradients;
+        m_bucketOfGradient.clear();
+        m_numGradientsNotReady.resize(m_buckets.size());
+        for (size_t i = 0; i < m_buckets.size(); i++)
+        {
+            for (auto k : m_buckets[i].m_gradientIndices)
+                m_bucketOfGradient[gradients[k]] = i;
+            m_numGradientsNotReady[i] = m_buckets[i].m_gradientIndices.size();
+        }
+        m_nextBucketToStart = 0;
+    }
+
+    // start the reduction of all buckets whose gradients are now complete
+    void NotifyGradientReady(Matrix<ElemType>* gradient) override
+    {
+        if (!m_overlapActive)
+            return;
+        auto iter = m_bucketOfGradient.find(gradient);
+        if (iter == m_bucketOfGradient.end() || m_numGradientsNotReady[iter->second] == 0)
+            return;
+        m_numGradientsNotReady[iter->second]--;
+
+        // Buckets are started strictly in order, since all nodes must issue their allreduce calls in the same order.
+        std::vector<size_t> readyBuckets;
+        while (m_nextBucketToStart < m_buckets.size() && m_numGradientsNotReady[m_nextBucketToStart] == 0)
+            readyBuckets.push_back(m_nextBucketToStart++);
+        if (readyBuckets.empty())
+            return;
+
+        // On the GPU, the transfers to the CPU run on the compute stream, i.e. after the backprop work queued so far.
+        // Waiting for them right away would stall the queue, so the allreduce of a bucket is only issued once the next
+        // bucket is ready (or in AggregateGradients()), by when its transfer has most likely completed.
+        bool onGPU = (m_overlappedGradients[0]->GetDeviceId() >= 0);
+        if (onGPU)
+            IssueAllReduces(m_overlappedGradients);
+        BeginBucketTransfers(readyBuckets, m_overlappedGradients);
+        if (!onGPU)
+            IssueAllReduces(m_overlappedGradients);
+
+        // give MPI a chance to make progress on the reductions in flight
+        int allCompleted;
+        MPI_Testall((int) m_allReduceRequests.size(), m_allReduceRequests.data(), &allCompleted, MPI_STATUSES_IGNORE) || MpiFail("MPI_Testall");
+    }
+
 private:
+    // a group of consecutive gradient matrices that is aggregated as one contiguous buffer
+    struct GradientBucket
+    {
+        std::vector<size_t> m_gradientIndices;               // indices into the gradient list
+        std::vector<size_t> m_offsets;                       // element offset of each gradient in the bucket
+        size_t m_numElements;
+        std::shared_ptr<Matrix<ElemType>> m_packedGradients; // [1 x m_numElements], on the gradients' device; null for a single matrix
+
+        GradientBucket()
+            : m_numElements(0)
+        {
+        }
+    };
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -142,7 +229,17 @@ private:
         if (m_currentEpochNumber == -1)
         {
             int deviceId = gradients[0]->GetDeviceId();
-            if (deviceId != CPUDEVICE)
+            if (m_useDeviceCollectives)
+            {
+                if (deviceId == CPUDEVICE)
+                    m_useDeviceCollectives = false;
+                else if (m_useAsyncAggregation || !MPIWrapper::IsCUDAAware())
+                {
+                    fprintf(stderr, "SimpleDistGradAggregator: WARNING: GPU-direct gradient aggregation requires a CUDA-aware MPI and no buffered async aggregation; staging through host memory instead.\n");
+                    m_useDeviceCollectives = false;
+                }
+            }
+            if (deviceId != CPUDEVICE && !m_useDeviceCollectives)
             {
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
@@ -153,17 +250,38 @@ private:
                 if (gradients[i]->GetMatrixType() != DENSE)
                     RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
 
-                if (deviceId != CPUDEVICE)
+                if (m_useAsyncAggregation)
                 {
-                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
                 }
+            }
 
-                if (m_useAsyncAggregation)
+            SelectSparseGradients(gradients);
+            CreateBuckets(gradients);
+            m_bucketStates.assign(m_buckets.size(), bucketIdle);
+            m_allReduceRequests.assign(m_buckets.size(), MPI_REQUEST_NULL);
+            size_t maxBucketSize = 0;
+            for (const auto& bucket : m_buckets)
+            {
+                if (deviceId != CPUDEVICE && !m_useDeviceCollectives)
                 {
-                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
+                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
+                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, bucket.m_numElements));
                 }
+                maxBucketSize = std::max(maxBucketSize, bucket.m_numElements);
+            }
+            if (m_useDeviceCollectives && m_useHierarchicalAllReduce)
+            {
+                fprintf(stderr, "SimpleDistGradAggregator: WARNING: hierarchical allreduce applies to host buffers only; using the GPU-direct ring instead.\n");
+                m_useHierarchicalAllReduce = false;
+            }
+            if (m_useDeviceCollectives)
+            {
+                m_ringReceiveBuffer = std::make_shared<Matrix<ElemType>>(1, (maxBucketSize + NumProc() - 1) / NumProc(), deviceId);
+                fprintf(stderr, "SimpleDistGradAggregator: reducing the gradients directly in GPU memory.\n");
             }
+            if (m_buckets.size() < gradients.size())
+                fprintf(stderr, "SimpleDistGradAggregator: aggregating %d gradient matrices in %d buckets.\n", (int) gradients.size(), (int) m_buckets.size());
 
             if (m_useAsyncAggregation)
             {
@@ -205,6 +323,241 @@ private:
         return isNewEpoch;
     }
 
+    // the columns of a gradient that have values
+    static std::vector<int> ColumnsWithValues(const Matrix<ElemType>& gradient)
+    {
+        Matrix<ElemType> norms(gradient.GetDeviceId());
+        gradient.VectorNorm1(norms, /*isColWise=*/true);
+        std::unique_ptr<ElemType[]> normValues(norms.CopyToArray());
+        std::vector<int> columns;
+        for (size_t j = 0; j < gradient.GetNumCols(); j++)
+        {
+            if (normValues[j] != 0) // (NaNs count as values)
+                columns.push_back((int) j);
+        }
+        return columns;
+    }
+
+    // decide which gradients are aggregated by AggregateSparseGradient(): those whose first gradients have values in
+    // at most m_sparseGradientDensity of the columns, on average over all nodes (so that all nodes agree)
+    void SelectSparseGradients(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        m_isSparseGradient.assign(gradients.size(), false);
+        if (m_sparseGradientDensity <= 0)
+            return;
+        std::vector<size_t> numColumnsWithValues(gradients.size(), 0);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (gradients[i]->GetNumCols() > 1 && gradients[i]->GetNumCols() < (1 << 24)) // (column indices are passed as ElemType)
+                numColumnsWithValues[i] = ColumnsWithValues(*gradients[i]).size();
+            else
+                numColumnsWithValues[i] = SIZE_MAX / NumProc();
+        }
+        m_mpi->AllReduce(numColumnsWithValues);
+        size_t numSparse = 0;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            m_isSparseGradient[i] = numColumnsWithValues[i] <= m_sparseGradientDensity * NumProc() * gradients[i]->GetNumCols();
+            if (m_isSparseGradient[i])
+                numSparse++;
+        }
+        if (numSparse > 0)
+            fprintf(stderr, "SimpleDistGradAggregator: exchanging %d of %d gradient matrices as sparse columns.\n", (int) numSparse, (int) gradients.size());
+    }
+
+    // aggregate a gradient that only has values in a few columns: each node sends its columns with values, along with
+    // their indices, to all others, and every node adds up what it received. If the columns sent by all nodes together
+    // exceed m_sparseGradientDensity, this gradient is allreduced as a whole instead (all nodes see the same counts).
+    void AggregateSparseGradient(Matrix<ElemType>& gradient)
+    {
+        int deviceId = gradient.GetDeviceId();
+        size_t numRows = gradient.GetNumRows();
+        size_t numCols = gradient.GetNumCols();
+
+        std::vector<int> columns = ColumnsWithValues(gradient);
+        int numColumns = (int) columns.size();
+        std::vector<int> allNumColumns(NumProc());
+        MPI_Allgather(&numColumns, 1, MPI_INT, allNumColumns.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+        std::vector<int> columnOffsets(NumProc(), 0), valueCounts(NumProc()), valueOffsets(NumProc(), 0);
+        size_t totalColumns = 0;
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            columnOffsets[j] = (int) totalColumns;
+            valueOffsets[j] = (int) (totalColumns * numRows);
+            valueCounts[j] = (int) (allNumColumns[j] * numRows);
+            totalColumns += allNumColumns[j];
+        }
+
+        if (totalColumns > m_sparseGradientDensity * NumProc() * numCols)
+        {
+            std::unique_ptr<ElemType[]> values(gradient.CopyToArray());
+            m_mpi->AllReduce(values.get(), gradient.GetNumElements());
+            gradient.SetValue(numRows, numCols, deviceId, values.get());
+            m_numBytesSent += gradient.GetNumElements() * sizeof(ElemType);
+            return;
+        }
+
+        // gather our columns on the device, so that only they are transferred
+        std::vector<ElemType> sendValues;
+        if (numColumns > 0)
+        {
+            std::vector<ElemType> idxValues(columns.begin(), columns.end());
+            Matrix<ElemType> idx(1, numColumns, idxValues.data(), matrixFlagNormal, deviceId);
+            Matrix<ElemType> sendColumns(numRows, numColumns, deviceId);
+            sendColumns.DoGatherColumnsOf(0, idx, gradient, 1);
+            sendValues.resize(numRows * numColumns);
+            ElemType* sendBuffer = sendValues.data();
+            size_t sendBufferSize = sendValues.size();
+            sendColumns.CopyToArray(sendBuffer, sendBufferSize);
+        }
+
+        std::vector<int> allColumns(totalColumns);
+        std::vector<ElemType> allValues(totalColumns * numRows);
+        MPI_Allgatherv(columns.data(), numColumns, MPI_INT, allColumns.data(), allNumColumns.data(), columnOffsets.data(), MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        MPI_Allgatherv(sendValues.data(), (int) sendValues.size(), MPIWrapper::GetDataType(sendValues.data()), allValues.data(), valueCounts.data(), valueOffsets.data(), MPIWrapper::GetDataType(allValues.data()), m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        m_numBytesSent += numColumns * (sizeof(int) + numRows * sizeof(ElemType));
+
+        // sum them up; columns that several nodes have values in are added up by the scatter
+        if (totalColumns == 0)
+            return; // (no values anywhere: the gradient is zero already)
+        std::vector<ElemType> allIdxValues(allColumns.begin(), allColumns.end());
+        Matrix<ElemType> allIdx(1, totalColumns, allIdxValues.data(), matrixFlagNormal, deviceId);
+        Matrix<ElemType> allColumnValues(numRows, totalColumns, allValues.data(), matrixFlagNormal, deviceId);
+        gradient.DoScatterColumnsOf(0, allIdx, allColumnValues, 1);
+    }
+
+    // group consecutive gradient matrices into buckets of at most m_bucketSizeInBytes
+    // A matrix that does not fit into a bucket by itself gets a bucket of its own. Sparse gradients are not in any bucket.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        const size_t bucketSize = m_bucketSizeInBytes / sizeof(ElemType);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (m_isSparseGradient[i])
+                continue;
+            size_t numElements = gradients[i]->GetNumElements();
+            if (m_buckets.empty() || m_buckets.back().m_numElements + numElements > bucketSize)
+                m_buckets.push_back(GradientBucket());
+            GradientBucket& bucket = m_buckets.back();
+            bucket.m_gradientIndices.push_back(i);
+            bucket.m_offsets.push_back(bucket.m_numElements);
+            bucket.m_numElements += numElements;
+        }
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.m_gradientIndices.size() > 1)
+                bucket.m_packedGradients = std::make_shared<Matrix<ElemType>>(1, bucket.m_numElements, gradients[0]->GetDeviceId());
+        }
+    }
+
+    // the buffer holding the contents of a bucket: its packed matrix, or for a single matrix, that matrix itself
+    ElemType* BucketBuffer(const GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients) const
+    {
+        return bucket.m_packedGradients ? bucket.m_packedGradients->BufferPointer() : gradients[bucket.m_gradientIndices[0]]->BufferPointer();
+    }
+
+    // copy the gradients of a bucket into its packed matrix (viewing each gradient as a single row), or back
+    void PackBucket(const GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients, bool unpack)
+    {
+        if (!bucket.m_packedGradients)
+            return;
+        for (size_t k = 0; k < bucket.m_gradientIndices.size(); k++)
+        {
+            Matrix<ElemType>* gradient = gradients[bucket.m_gradientIndices[k]];
+            size_t numElements = gradient->GetNumElements();
+            Matrix<ElemType> gradientAsRow = gradient->Reshaped(1, numElements);
+            if (!unpack)
+                bucket.m_packedGradients->SetColumnSlice(gradientAsRow, bucket.m_offsets[k], numElements);
+            else
+                gradientAsRow.SetColumnSlice(bucket.m_packedGradients->ColumnSlice(bucket.m_offsets[k], numElements), 0, numElements);
+        }
+    }
+
+    // pack the given buckets and initiate their transfer to the CPU if needed; their allreduce is issued by IssueAllReduces()
+    void BeginBucketTransfers(const std::vector<size_t>& buckets, const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        if (buckets.empty())
+            return;
+        PhaseTimer phaseTimer(m_deviceCopySeconds);
+        int deviceId = gradients[0]->GetDeviceId();
+        if (m_buckets.size() < gradients.size())
+        {
+            for (auto i : buckets)
+                PackBucket(m_buckets[i], gradients, /*unpack=*/false);
+
+            // the transfers below run on a separate stream, which must see the packed buffers
+            if (deviceId >= 0 && m_useAsyncAggregation)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            }
+        }
+        for (auto i : buckets)
+        {
+            if (deviceId >= 0 && !m_useDeviceCollectives)
+                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(BucketBuffer(m_buckets[i], gradients), m_buckets[i].m_numElements, m_intermediateCPUBuffers[i].get());
+            m_bucketStates[i] = bucketTransferring;
+        }
+    }
+
+    // issue the allreduce for each bucket whose transfer has been initiated, in bucket order
+    void IssueAllReduces(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        int deviceId = gradients[0]->GetDeviceId();
+        for (size_t i = 0; i < m_buckets.size(); ++i)
+        {
+            if (m_bucketStates[i] != bucketTransferring)
+                continue;
+            m_numBytesSent += m_buckets[i].m_numElements * sizeof(ElemType);
+            if (m_useDeviceCollectives)
+            {
+                PhaseTimer phaseTimer(m_mpiSeconds);
+                RingAllReduceBucket(m_buckets[i], gradients);
+                m_bucketStates[i] = bucketReducing; // (done; m_allReduceRequests[i] stays null)
+                continue;
+            }
+            ElemType* reductionBuffer = BucketBuffer(m_buckets[i], gradients);
+            if (deviceId >= 0)
+            {
+                PhaseTimer phaseTimer(m_deviceCopySeconds);
+                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+                reductionBuffer = m_intermediateCPUBuffers[i].get();
+            }
+
+            PhaseTimer phaseTimer(m_mpiSeconds);
+            if (m_useHierarchicalAllReduce)
+            {
+                m_mpi->HierarchicalAllReduce(reductionBuffer, m_buckets[i].m_numElements); // (blocking; m_allReduceRequests[i] stays null)
+                m_bucketStates[i] = bucketReducing;
+                continue;
+            }
+
+            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, m_buckets[i].m_numElements, MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &m_allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
+            m_bucketStates[i] = bucketReducing;
+        }
+    }
+
+    // sum a bucket over all nodes in place in GPU memory (blocking)
+    void RingAllReduceBucket(const GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        int deviceId = gradients[0]->GetDeviceId();
+        std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+
+        // MPI reads the device memory directly, so the gradients (and their packing) must be complete
+        mainStreamSyncEvent->SynchronizeEvent();
+
+        Matrix<ElemType> bucketAsRow = bucket.m_packedGradients ? bucket.m_packedGradients->ColumnSlice(0, bucket.m_numElements)
+                                                                : gradients[bucket.m_gradientIndices[0]]->Reshaped(1, bucket.m_numElements);
+        m_mpi->RingAllReduce(BucketBuffer(bucket, gradients), bucket.m_numElements, m_ringReceiveBuffer->BufferPointer(), [&](size_t offset, size_t numElements)
+                             {
+                                 Matrix<ElemType> chunk = bucketAsRow.ColumnSlice(offset, numElements);
+                                 Matrix<ElemType>::ScaleAndAdd(1, m_ringReceiveBuffer->ColumnSlice(0, numElements), chunk);
+                                 std::unique_ptr<MatrixComputeStreamEvent> accumulateSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+                                 accumulateSyncEvent->SynchronizeEvent();
+                             });
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
@@ -239,16 +592,20 @@ private:
             }
         }
 
-        // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
+        // Pack the gradient buckets and initiate their transfer to the CPU if needed
+        // (except for those already started while overlapping with backprop)
+        size_t numBuckets = m_buckets.size();
+        std::vector<size_t> bucketsToStart;
+        for (size_t i = 0; i < numBuckets; ++i)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-            {
-                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->BufferPointer(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
-            }
+            if (m_bucketStates[i] == bucketIdle)
+                bucketsToStart.push_back(i);
         }
+        BeginBucketTransfers(bucketsToStart, gradients);
 
         // Initiate receive of the header on the main node
+        Timer headerTimer;
+        headerTimer.Start();
         std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
         if (m_mpi->IsMainNode())
         {
@@ -266,23 +623,24 @@ private:
         {
             MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, m_mpi->Communicator(), &sendHeaderRequest) || MpiFail("MPI_Isend");
         }
+        headerTimer.Stop();
+        m_headerSeconds += headerTimer.ElapsedSeconds();
 
-        // Perform MPI async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
+        // Perform MPI async allreduce on the gradient data, one message per bucket
+        IssueAllReduces(gradients);
+
+        // while those are in flight, exchange the sparse gradients
         for (size_t i = 0; i < numGradMatrices; ++i)
         {
-            ElemType* reductionBuffer = gradients[i]->BufferPointer();
-            if (deviceId >= 0)
+            if (m_isSparseGradient[i])
             {
-                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
-                reductionBuffer = m_intermediateCPUBuffers[i].get();
+                PhaseTimer phaseTimer(m_mpiSeconds);
+                AggregateSparseGradient(*gradients[i]);
             }
-
-            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
         }
 
         // On the main node wait for the headers to arrive and aggregate
+        headerTimer.Restart();
         if (m_mpi->IsMainNode())
         {
             size_t numNodesHeadersReceivedFrom = 0;
@@ -322,32 +680,55 @@ private:
             }
         }
 
+        headerTimer.Stop();
+        m_headerSeconds += headerTimer.ElapsedSeconds();
+
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
-        for (size_t i = 0; i < numGradMatrices; ++i)
+        for (size_t i = 0; i < numBuckets; ++i)
         {
-            MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-            if (deviceId >= 0)
             {
-                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->BufferPointer());
+                PhaseTimer phaseTimer(m_mpiSeconds);
+                MPI_Wait(&m_allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            }
+            m_bucketStates[i] = bucketIdle;
+            if (deviceId >= 0 && !m_useDeviceCollectives)
+            {
+                PhaseTimer phaseTimer(m_deviceCopySeconds);
+                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), m_buckets[i].m_numElements, BucketBuffer(m_buckets[i], gradients));
             }
         }
 
         // Wait to receive aggregate header
         if (!m_mpi->IsMainNode())
         {
+            PhaseTimer phaseTimer(m_headerSeconds);
             MPI_Wait(&recvAggHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
         }
 
         // Wait for all the transfers to finish
-        if (deviceId >= 0)
+        Timer copyTimer;
+        copyTimer.Start();
+        if (deviceId >= 0 && !m_useDeviceCollectives)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            for (size_t i = 0; i < numBuckets; ++i)
             {
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
             }
         }
 
+        // Scatter the aggregated buckets back into the gradient matrices
+        if (numBuckets < numGradMatrices)
+        {
+            for (const auto& bucket : m_buckets)
+                PackBucket(bucket, gradients, /*unpack=*/true);
+        }
+        copyTimer.Stop();
+        m_deviceCopySeconds += copyTimer.ElapsedSeconds();
+
+        m_overlapActive = false;
+
         // Wait for completion of the async send requests
+        headerTimer.Restart();
         if (!m_mpi->IsMainNode())
         {
             MPI_Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
@@ -356,6 +737,8 @@ private:
         {
             MPI_Waitall(sendAggHeaderRequests.size(), sendAggHeaderRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
         }
+        headerTimer.Stop();
+        m_headerSeconds += headerTimer.ElapsedSeconds();
 
         if (showSyncPerfStats)
         {
@@ -366,8 +749,33 @@ private:
     }
 
 private:
+    size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
+
+    enum BucketState
+    {
+        bucketIdle,
+        bucketTransferring, // packed, and being copied to the CPU if needed
+        bucketReducing      // allreduce in flight
+    };
+    std::vector<BucketState> m_bucketStates;
+    std::vector<MPI_Request> m_allReduceRequests; // (per bucket)
+
+    bool m_useDeviceCollectives;                           // reduce in GPU memory, see RingAllReduceBucket()
+    std::shared_ptr<Matrix<ElemType>> m_ringReceiveBuffer; // [1 x largest ring chunk]
+    bool m_useHierarchicalAllReduce;                       // reduce within hosts first, see MPIWrapper::HierarchicalAllReduce()
+    double m_sparseGradientDensity;                        // see AggregateSparseGradient()
+    std::vector<bool> m_isSparseGradient;                  // [gradient index] aggregated by AggregateSparseGradient() instead of in a bucket
+
+    // state of the aggregation overlapped with backprop (between BeginOverlappedAggregation() and AggregateGradients())
+    bool m_overlapActive;
+    std::vector<Matrix<ElemType>*> m_overlappedGradients;
+    std::unordered_map<Matrix<ElemType>*, size_t> m_bucketOfGradient;
+    std::vector<size_t> m_numGradientsNotReady; // (per bucket)
+    size_t m_nextBucketToStart;
+
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
-    std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
+    std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers; // (per bucket, as are the transferers)
 
     std::vector<std::unique_ptr<GPUDataTransferer<ElemType>>> m_gpuDataTransferers;
 
@@ -389,5 +797,30 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // time spent in the phases of the aggregation, see GetPhaseSeconds()
+    double m_deviceCopySeconds;
+    double m_mpiSeconds;
+    double m_headerSeconds;
+
+    // adds the time from its construction to its destruction to a phase's total
+    class PhaseTimer
+    {
+    public:
+        PhaseTimer(double& totalSeconds)
+            : m_totalSeconds(totalSeconds)
+        {
+            m_timer.Start();
+        }
+        ~PhaseTimer()
+        {
+            m_timer.Stop();
+            m_totalSeconds += m_timer.ElapsedSeconds();
+        }
+
+    private:
+        Timer m_timer;
+        double& m_totalSeconds;
+    };
 };
 } } }
@@ -10,6 +10,7 @@
 #include "ComputationNetwork.h"
 #include "DataReaderHelpers.h"
 #include "TrainingNodes.h" // TODO: we should move the functions that depend on these to the .cpp
+#include "AsyncLog.h"
 
 #include <vector>
 #include <string>
@@ -24,8 +25,10 @@ template <class ElemType>
 class SimpleEvaluator
 {
 public:
-    SimpleEvaluator(ComputationNetworkPtr net, const size_t numMBsToShowResult = 100, const int traceLevel = 0)
-        : m_net(net), m_numMBsToShowResult(numMBsToShowResult), m_traceLevel(traceLevel)
+    // With 'mpi' (and more than one node in use), each node evaluates its share of the data and the criteria are summed
+    // over all nodes; all nodes must call Evaluate(), and all get the same results.
+    SimpleEvaluator(ComputationNetworkPtr net, const size_t numMBsToShowResult = 100, const int traceLevel = 0, MPIWrapper* mpi = nullptr)
+        : m_net(net), m_numMBsToShowResult(numMBsToShowResult), m_traceLevel(traceLevel), m_mpi(mpi)
     {
     }
 
@@ -92,10 +95,16 @@ public:
         for (int i = 0; i < evalResults.size(); i++)
             evalResultsLastMBs.push_back((ElemType) 0);
 
-        dataReader->StartMinibatchLoop(mbSize, 0, testSize);
+        // data-parallel evaluation: each node reads its share of the data if the reader can, otherwise each minibatch is decimated
+        bool useParallelEval = m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+        bool useDistributedMBReading = useParallelEval && dataReader->SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader->StartDistributedMinibatchLoop(mbSize, 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), testSize);
+        else
+            dataReader->StartMinibatchLoop(mbSize, 0, testSize);
         m_net->StartEvaluateMinibatchLoop(evalNodes);
 
-        while (DataReaderHelpers::GetMinibatchIntoNetwork(*dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
+        while (DataReaderHelpers::GetMinibatchIntoNetwork(*dataReader, m_net, nullptr, useDistributedMBReading, useParallelEval, inputMatrices, actualMBSize))
         {
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
             ComputationNetwork::BumpEvalTimeStamp(labelNodes);
@@ -103,11 +112,12 @@ public:
             // for now since we share the same label masking flag we call this on one node only
             // Later, when we apply different labels on different nodes
             // we need to add code to call this function multiple times, one for each criteria node
-            size_t numSamplesWithLabel = m_net->GetNumSamplesWithLabel(actualMBSize);
-            for (int i = 0; i < evalNodes.size(); i++)
+            size_t numSamplesWithLabel = actualMBSize > 0 ? m_net->GetNumSamplesWithLabel(actualMBSize) : 0;
+            if (actualMBSize > 0) // (a node may get no share of a minibatch)
             {
-                m_net->ForwardProp(evalNodes[i]);
-                evalResults[i] += (double) evalNodes[i]->Get00Element(); // criterionNode should be a scalar
+                m_net->ForwardProp(evalNodes);
+                for (int i = 0; i < evalNodes.size(); i++)
+                    evalResults[i] += (double) evalNodes[i]->Get00Element(); // criterionNode should be a scalar
             }
 
             totalEpochSamples += numSamplesWithLabel;
@@ -146,9 +156,15 @@ public:
         {
             evalResultsLastMBs[i] = 0;
         }
+        if (useParallelEval) // sum over all nodes
+        {
+            m_mpi->AllReduce(evalResults);
+            m_mpi->AllReduce(&totalEpochSamples, 1);
+        }
 
-        fprintf(stderr, "Final Results: ");
+        AsyncLog::Write(stderr, "Final Results: ");
         DisplayEvalStatistics(1, numMBsRun, totalEpochSamples, evalNodes, evalResults, evalResultsLastMBs, true);
+        AsyncLog::Flush(); // (before the caller's own messages)
 
         for (int i = 0; i < evalResults.size(); i++)
         {
@@ -174,12 +190,12 @@ protected:
     void DisplayEvalStatistics(const size_t startMBNum, const size_t endMBNum, const size_t numSamplesLastMBs, const vector<ComputationNodeBasePtr>& evalNodes,
                                const vector<double>& evalResults, const vector<double>& evalResultsLastMBs, bool displayConvertedValue = false)
     {
-        fprintf(stderr, "Minibatch[%lu-%lu]: Samples Seen = %lu    ", startMBNum, endMBNum, numSamplesLastMBs);
+        AsyncLog::Write(stderr, "Minibatch[%lu-%lu]: Samples Seen = %lu    ", startMBNum, endMBNum, numSamplesLastMBs);
 
         for (size_t i = 0; i < evalResults.size(); i++)
         {
             double eresult = (evalResults[i] - evalResultsLastMBs[i]) / numSamplesLastMBs;
-            fprintf(stderr, "%ls: %ls/Sample = %.8g    ", evalNodes[i]->NodeName().c_str(), evalNodes[i]->OperationName().c_str(), eresult);
+            AsyncLog::Write(stderr, "%ls: %ls/Sample = %.8g    ", evalNodes[i]->NodeName().c_str(), evalNodes[i]->OperationName().c_str(), eresult);
 
             if (displayConvertedValue)
             {
@@ -187,18 +203,20 @@ protected:
                 if (evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyWithSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+                    evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyWithSampledSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(NoiseContrastiveEstimationNode))
-                    fprintf(stderr, "Perplexity = %.8g    ", std::exp(eresult));
+                    AsyncLog::Write(stderr, "Perplexity = %.8g    ", std::exp(eresult));
             }
         }
 
-        fprintf(stderr, "\n");
+        AsyncLog::Write(stderr, "\n");
     }
 
 protected:
     ComputationNetworkPtr m_net;
     size_t m_numMBsToShowResult;
     int m_traceLevel;
+    MPIWrapper* m_mpi; // if not null: data-parallel over its nodes
     void operator=(const SimpleEvaluator&); // (not assignable)
 };
 } } }
@@ -13,7 +13,9 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
 #include <fstream>
+#include <future>
 
 using namespace std;
 
@@ -25,8 +27,9 @@ class SimpleOutputWriter
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
 
 public:
-    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+    // With 'mpi' (and more than one node in use), WriteOutput() to a path is data-parallel, see there.
+    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0, MPIWrapper* mpi = nullptr)
+        : m_net(net), m_verbosity(verbosity), m_mpi(mpi)
     {
     }
 
@@ -71,7 +74,14 @@ public:
         m_net->StartEvaluateMinibatchLoop(outputNodes);
 
         size_t totalEpochSamples = 0;
-        std::map<std::wstring, void*, nocase_compare> outputMatrices;
+        std::map<std::wstring, Matrix<ElemType>*> outputMatrices;
+
+        // SaveData() runs on a background thread, on copies of the matrices (made on their device), so that writing a
+        // minibatch overlaps with evaluating the next one. The copies are double-buffered: the save that used a buffer
+        // has finished before the buffer is filled again, as there is at most one save in flight.
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> copies[2];
+        std::future<bool> pendingSave;
+        size_t numMinibatches = 0;
 
         size_t actualMBSize;
         while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
@@ -79,21 +89,27 @@ public:
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
             ComputationNetwork::BumpEvalTimeStamp(labelNodes);
 
+            m_net->ForwardProp(outputNodes);
             for (int i = 0; i < outputNodes.size(); i++)
-            {
-                m_net->ForwardProp(outputNodes[i]);
-                outputMatrices[outputNodes[i]->NodeName()] = (void*) (&dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i])->Value());
-            }
+                outputMatrices[outputNodes[i]->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i])->Value();
 
-            if (doUnitTest)
+            auto& buffer = copies[numMinibatches++ % 2];
+            std::map<std::wstring, void*, nocase_compare> matricesToSave;
+            for (const auto& iter : doUnitTest ? inputMatrices : outputMatrices)
             {
-                std::map<std::wstring, void*, nocase_compare> inputMatricesUnitTest;
-                for (auto iter = inputMatrices.begin(); iter != inputMatrices.end(); iter++)
-                    inputMatricesUnitTest[iter->first] = (void*) (iter->second);
-                dataWriter.SaveData(0, inputMatricesUnitTest, actualMBSize, actualMBSize, 0);
+                auto& copy = buffer[iter.first];
+                if (!copy)
+                    copy = make_shared<Matrix<ElemType>>(iter.second->GetDeviceId());
+                copy->SetValue(*iter.second, iter.second->GetFormat());
+                matricesToSave[iter.first] = (void*) copy.get();
             }
-            else
-                dataWriter.SaveData(0, outputMatrices, actualMBSize, actualMBSize, 0);
+
+            if (pendingSave.valid())
+                pendingSave.get(); // (rethrows)
+            pendingSave = std::async(std::launch::async, [&dataWriter, matricesToSave, actualMBSize]()
+                                     {
+                                         return dataWriter.SaveData(0, matricesToSave, actualMBSize, actualMBSize, 0);
+                                     });
 
             totalEpochSamples += actualMBSize;
 
@@ -101,6 +117,8 @@ public:
             // reader specific process if sentence ending is reached
             dataReader.DataEnd(endDataSentence);
         }
+        if (pendingSave.valid())
+            pendingSave.get();
 
         if (m_verbosity > 0)
             fprintf(stderr, "Total Samples Evaluated = %lu\n", totalEpochSamples);
@@ -108,9 +126,17 @@ public:
         // clean up
     }
 
-    void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize)
+    // writes one line of values per sample; with topK > 0, only the topK largest of each sample, as "index:value"
+    // pairs, best first. These are selected on the device, so that only they are copied to the host.
+    // Data-parallel (with an MPIWrapper), each node reads its share of the data (distributed reading if the reader can,
+    // otherwise a share of each minibatch) and writes it to its own shard, outputPath.<node>.rank<r>. The main node then
+    // writes outputPath.<node>.manifest, with one line "shard firstLine numLines" per minibatch and node, minibatches in
+    // the order read and nodes by rank within each; the shards' line ranges in that order are the whole output.
+    void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize, size_t topK = 0)
     {
         msra::files::make_intermediate_dirs(outputPath);
+        bool useParallelOutput = m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+        std::wstring shardSuffix = useParallelOutput ? msra::strfun::wstrprintf(L".rank%d", (int) m_mpi->CurrentNodeRank()) : L"";
 
         // specify output nodes and files
         std::vector<ComputationNodeBasePtr> outputNodes;
@@ -131,10 +157,11 @@ public:
         std::vector<ofstream*> outputStreams;
         for (int i = 0; i < outputNodes.size(); i++)
 #ifdef _MSC_VER
-            outputStreams.push_back(new ofstream((outputPath + L"." + outputNodes[i]->NodeName()).c_str()));
+            outputStreams.push_back(new ofstream((outputPath + L"." + outputNodes[i]->NodeName() + shardSuffix).c_str()));
 #else
-            outputStreams.push_back(new ofstream(wtocharpath(outputPath + L"." + outputNodes[i]->NodeName()).c_str()));
+            outputStreams.push_back(new ofstream(wtocharpath(outputPath + L"." + outputNodes[i]->NodeName() + shardSuffix).c_str()));
 #endif
+        std::vector<std::vector<size_t>> numLinesPerMB(outputNodes.size()); // [output node][minibatch] -> lines written (for the manifest)
 
         // allocate memory for forward computation
         m_net->AllocateAllMatrices({}, outputNodes, nullptr);
@@ -146,7 +173,11 @@ public:
             inputMatrices[featureNodes[i]->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(featureNodes[i])->Value();
 
         // evaluate with minibatches
-        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+        bool useDistributedMBReading = useParallelOutput && dataReader.SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), numOutputSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
 
         m_net->StartEvaluateMinibatchLoop(outputNodes);
 
@@ -154,18 +185,37 @@ public:
         size_t numMBsRun = 0;
         size_t tempArraySize = 0;
         ElemType* tempArray = nullptr;
+        size_t tempIndexArraySize = 0;
+        ElemType* tempIndexArray = nullptr;
+        Matrix<ElemType> topKIndexes(m_net->GetDeviceId()), topKValues(m_net->GetDeviceId());
 
         size_t actualMBSize;
-        while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
+        while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_net, nullptr, useDistributedMBReading, useParallelOutput, inputMatrices, actualMBSize))
         {
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
 
+            if (actualMBSize > 0) // (a node may get no share of a minibatch)
+                m_net->ForwardProp(outputNodes);
             for (int i = 0; i < outputNodes.size(); i++)
             {
-                m_net->ForwardProp(outputNodes[i]);
-
                 Matrix<ElemType>& outputValues = dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i])->Value();
                 ofstream& outputStream = *outputStreams[i];
+                numLinesPerMB[i].push_back(actualMBSize > 0 ? outputValues.GetNumCols() : 0);
+                if (actualMBSize == 0)
+                    continue;
+                if (topK > 0 && topK < outputValues.GetNumRows())
+                {
+                    outputValues.VectorMax(topKIndexes, topKValues, true, (int) topK);
+                    topKIndexes.CopyToArray(tempIndexArray, tempIndexArraySize);
+                    topKValues.CopyToArray(tempArray, tempArraySize);
+                    for (size_t j = 0; j < topKValues.GetNumCols(); j++)
+                    {
+                        for (size_t k = 0; k < topK; k++)
+                            outputStream << (size_t) tempIndexArray[j * topK + k] << ":" << tempArray[j * topK + k] << " ";
+                        outputStream << endl;
+                    }
+                    continue;
+                }
                 outputValues.CopyToArray(tempArray, tempArraySize);
                 ElemType* pCurValue = tempArray;
                 foreach_column (j, outputValues)
@@ -192,12 +242,58 @@ public:
             delete outputStreams[i];
         }
 
+        if (useParallelOutput)
+        {
+            for (int i = 0; i < outputNodes.size(); i++)
+                WriteManifest(outputPath + L"." + outputNodes[i]->NodeName(), numLinesPerMB[i]);
+            m_mpi->WaitAll(); // (the output is complete when all nodes return)
+        }
+
         delete[] tempArray;
+        delete[] tempIndexArray;
     }
 
 private:
+    // collects the nodes' lines per minibatch on the main node, which writes the manifest of the shards 'path'.rank<r>
+    void WriteManifest(const std::wstring& path, const std::vector<size_t>& numLinesPerMB)
+    {
+        // gathered by summing: each node fills in its own row
+        size_t numNodes = m_mpi->NumNodesInUse();
+        size_t rank = m_mpi->CurrentNodeRank();
+        size_t numMBs = numLinesPerMB.size();
+        std::vector<size_t> numMBsPerNode(numNodes, 0);
+        numMBsPerNode[rank] = numMBs;
+        m_mpi->AllReduce(numMBsPerNode);
+        size_t maxNumMBs = *std::max_element(numMBsPerNode.begin(), numMBsPerNode.end());
+        std::vector<size_t> numLines(numNodes * maxNumMBs, 0); // [node * maxNumMBs + minibatch]
+        std::copy(numLinesPerMB.begin(), numLinesPerMB.end(), numLines.begin() + rank * maxNumMBs);
+        m_mpi->AllReduce(numLines);
+        if (!m_mpi->IsMainNode())
+            return;
+
+        std::vector<size_t> firstLine(numNodes, 0);
+#ifdef _MSC_VER
+        ofstream manifest((path + L".manifest").c_str());
+#else
+        ofstream manifest(wtocharpath(path + L".manifest").c_str());
+#endif
+        for (size_t mb = 0; mb < maxNumMBs; mb++)
+        {
+            for (size_t r = 0; r < numNodes; r++)
+            {
+                size_t n = numLines[r * maxNumMBs + mb];
+                if (n == 0)
+                    continue;
+                manifest << msra::strfun::utf8(msra::strfun::wstrprintf(L"%ls.rank%d", path.c_str(), (int) r)) << "\t" << firstLine[r] << "\t" << n << endl;
+                firstLine[r] += n;
+            }
+        }
+        fprintf(stderr, "WriteOutput: wrote the manifest of %d shards to %ls.manifest\n", (int) numNodes, path.c_str());
+    }
+
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    MPIWrapper* m_mpi; // if not null: WriteOutput() to a path is data-parallel over its nodes
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 } } }
@@ -0,0 +1,329 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingDataCache.h -- keep the training data in memory after the first epoch (SGD's 'trainingDataCache')
+//
+// For corpora that fit into memory, the first epoch passes the minibatches through from the reader and keeps copies of
+// them, on the device of the network's inputs (trainingDataCache=device) or in CPU RAM (trainingDataCache=host). Once a
+// whole sweep is cached, later epochs do not use the reader at all. In frame mode, the cached frames of each input are
+// kept as one matrix, and each epoch draws its minibatches, of that epoch's size, from a new random permutation of all
+// frames, gathered on the device (DoGatherColumnsOf()). Otherwise, the minibatches keep the composition and layout they
+// were read with, and only their order is randomized anew in each epoch.
+//
+// Unlike CachingDataReader, which replays the start of one epoch for the learning-rate search, this spans all epochs,
+// and therefore requires that each epoch is a whole sweep (epochSize=0). If the data exceed trainingDataCacheMaxMB, the
+// cache is dropped, and the reader is used as without it.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Sequences.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class TrainingDataCache : public IDataReader<ElemType>
+{
+    struct Minibatch
+    {
+        std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> inputs;
+        MBLayoutPtr layout;
+    };
+
+public:
+    TrainingDataCache(DEVICEID_TYPE deviceId, size_t maxBytes)
+        : m_reader(nullptr), m_deviceId(deviceId), m_maxBytes(maxBytes), m_state(notCached), m_numBytes(0), m_frameMode(true), m_numParallelSequences(1),
+          m_numFrames(0), m_frameIndexes(deviceId), m_mbSize(0), m_next(0), m_layout(make_shared<MBLayout>())
+    {
+    }
+
+    // the reader of this epoch, to read through while not replaying (SGD may wrap it anew in each epoch)
+    void SetReader(IDataReader<ElemType>* reader)
+    {
+        m_reader = reader;
+    }
+
+    virtual void Init(const ConfigParameters&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void Destroy() override
+    {
+    }
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (m_state == cached)
+        {
+            StartReplay(mbSize, epoch);
+            return;
+        }
+        if (m_state != disabled)
+        {
+            if (requestedEpochSamples != requestDataSize)
+                Disable("the epochs are not whole sweeps (epochSize)");
+            else
+            {
+                Clear(); // (an incomplete recording)
+                m_state = recording;
+            }
+        }
+        m_reader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return m_reader->SupportsDistributedMBRead();
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (m_state != disabled)
+            Disable("distributed reading");
+        m_reader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+    }
+
+    virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) override
+    {
+        if (m_state == cached)
+            return m_frameMode ? ReplayFrames(matrices) : ReplayMinibatch(matrices);
+
+        bool wasDataRead = m_reader->GetMinibatch(matrices);
+        if (m_state == recording)
+        {
+            if (wasDataRead)
+                Record(matrices);
+            else
+                FinishRecording();
+        }
+        return wasDataRead;
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        if (m_state == cached)
+            pMBLayout->CopyFrom(m_layout);
+        else
+            m_reader->CopyMBLayoutTo(pMBLayout);
+    }
+    virtual size_t GetNumParallelSequences() override
+    {
+        return m_state == cached ? m_numParallelSequences : m_reader->GetNumParallelSequences();
+    }
+    virtual bool RequireSentenceSeg() const override
+    {
+        return m_reader->RequireSentenceSeg();
+    }
+    virtual bool DataEnd(EndDataType endDataType) override
+    {
+        return m_state == cached ? false : m_reader->DataEnd(endDataType);
+    }
+
+    // the two-forward-pass interface makes the minibatches depend on the model, so they cannot be replayed
+    virtual bool GetMinibatchCopy(std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                                  std::map<std::wstring, Matrix<ElemType>*>& matrices,
+                                  MBLayoutPtr pMBLayout) override
+    {
+        if (m_state == cached)
+            return false;
+        bool copied = m_reader->GetMinibatchCopy(uttInfo, matrices, pMBLayout);
+        if (copied && m_state != disabled)
+            Disable("the reader computes its inputs from the model's outputs");
+        return copied;
+    }
+    virtual bool SetNetOutput(const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo,
+                              const Matrix<ElemType>& outputs,
+                              const MBLayoutPtr pMBLayout) override
+    {
+        return m_state == cached ? false : m_reader->SetNetOutput(uttInfo, outputs, pMBLayout);
+    }
+
+private:
+    void Clear()
+    {
+        m_minibatches.clear();
+        m_frames.clear();
+        m_numBytes = 0;
+        m_numFrames = 0;
+        m_frameMode = true;
+    }
+
+    // from now on, pass everything through to the reader
+    void Disable(const char* reason)
+    {
+        fprintf(stderr, "TrainingDataCache: Not caching the training data, since %s.\n", reason);
+        Clear();
+        m_state = disabled;
+    }
+
+    void Record(const std::map<std::wstring, Matrix<ElemType>*>& matrices)
+    {
+        Minibatch minibatch;
+        minibatch.layout = make_shared<MBLayout>();
+        m_reader->CopyMBLayoutTo(minibatch.layout);
+        if (m_minibatches.empty())
+            m_numParallelSequences = m_reader->GetNumParallelSequences();
+        for (const auto& iter : matrices)
+        {
+            auto input = std::make_shared<Matrix<ElemType>>(*iter.second); // (a copy on the input's device)
+            input->TransferToDeviceIfNotThere(m_deviceId, true);
+            m_numBytes += input->BufferSize();
+            m_frameMode &= input->GetMatrixType() == DENSE;
+            minibatch.inputs[iter.first] = input;
+        }
+        // frame mode: each sample is a sequence of its own
+        m_frameMode &= minibatch.layout->GetNumTimeSteps() == 1 && !minibatch.layout->HasGaps();
+        m_numFrames += minibatch.layout->GetActualNumSamples();
+        m_minibatches.push_back(std::move(minibatch));
+
+        if (m_numBytes > m_maxBytes)
+            Disable(msra::strfun::strprintf("the training data exceed trainingDataCacheMaxMB=%d", (int) (m_maxBytes >> 20)).c_str());
+    }
+
+    void FinishRecording()
+    {
+        // frames are drawn by index, which is passed as ElemType, so there must not be more than it represents exactly
+        const size_t maxIndexableFrames = sizeof(ElemType) >= sizeof(double) ? SIZE_MAX : ((size_t) 1 << 24);
+        m_frameMode &= m_numFrames > 0 && m_numFrames <= maxIndexableFrames;
+        if (m_frameMode) // concatenate each input's frames into one matrix, freeing the minibatches' copies as we go
+        {
+            for (const auto& input : m_minibatches[0].inputs)
+            {
+                auto frames = std::make_shared<Matrix<ElemType>>(input.second->GetNumRows(), m_numFrames, m_deviceId);
+                size_t startColumn = 0;
+                for (auto& minibatch : m_minibatches)
+                {
+                    auto& matrix = minibatch.inputs.at(input.first);
+                    frames->SetColumnSlice(*matrix, startColumn, matrix->GetNumCols());
+                    startColumn += matrix->GetNumCols();
+                    matrix.reset();
+                }
+                m_frames[input.first] = frames;
+            }
+            m_minibatches.clear();
+        }
+        m_state = cached;
+        fprintf(stderr, "TrainingDataCache: Cached %d samples (%.1f MB) in %s; later epochs replay them %s.\n",
+                (int) m_numFrames, m_numBytes / 1048576.0, m_deviceId == CPUDEVICE ? "CPU RAM" : "GPU memory",
+                m_frameMode ? "as randomly drawn frames" : "as minibatches in random order");
+    }
+
+    void StartReplay(size_t mbSize, size_t epoch)
+    {
+        std::mt19937 rng((unsigned int) epoch);
+        m_next = 0;
+        if (m_frameMode)
+        {
+            std::vector<ElemType> indexes(m_numFrames);
+            for (size_t i = 0; i < indexes.size(); i++)
+                indexes[i] = (ElemType) i;
+            std::shuffle(indexes.begin(), indexes.end(), rng);
+            m_frameIndexes.SetValue(1, indexes.size(), m_deviceId, indexes.data(), matrixFlagNormal);
+            m_mbSize = mbSize;
+        }
+        else
+        {
+            m_order.resize(m_minibatches.size());
+            for (size_t i = 0; i < m_order.size(); i++)
+                m_order[i] = i;
+            std::shuffle(m_order.begin(), m_order.end(), rng);
+        }
+    }
+
+    bool ReplayMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+    {
+        if (m_next >= m_order.size())
+            return false;
+        const Minibatch& minibatch = m_minibatches[m_order[m_next++]];
+        for (auto& iter : matrices)
+            CopyToInput(*FindInput(minibatch.inputs, iter.first), *iter.second);
+        m_layout->CopyFrom(minibatch.layout);
+        return true;
+    }
+
+    // the next m_mbSize frames of this epoch's permutation
+    bool ReplayFrames(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+    {
+        if (m_next >= m_numFrames)
+            return false;
+        size_t numFrames = min(m_mbSize, m_numFrames - m_next);
+        Matrix<ElemType> indexes = m_frameIndexes.ColumnSlice(m_next, numFrames);
+        for (auto& iter : matrices)
+        {
+            const Matrix<ElemType>& frames = *FindInput(m_frames, iter.first);
+            if (iter.second->GetDeviceId() == m_deviceId)
+            {
+                iter.second->Resize(frames.GetNumRows(), numFrames);
+                iter.second->DoGatherColumnsOf(0, indexes, frames, 1);
+            }
+            else // gather in CPU RAM, then move
+            {
+                Matrix<ElemType> gathered(frames.GetNumRows(), numFrames, m_deviceId);
+                gathered.DoGatherColumnsOf(0, indexes, frames, 1);
+                CopyToInput(gathered, *iter.second);
+            }
+        }
+        m_layout->InitAsFrameMode(numFrames);
+        m_next += numFrames;
+        return true;
+    }
+
+    static const std::shared_ptr<Matrix<ElemType>>& FindInput(const std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>>& inputs, const std::wstring& name)
+    {
+        auto iter = inputs.find(name);
+        if (iter == inputs.end())
+            LogicError("TrainingDataCache: Input '%ls' was not read in the first epoch.", name.c_str());
+        return iter->second;
+    }
+
+    // (SetValue() would move the input to the cache's device)
+    void CopyToInput(const Matrix<ElemType>& cached, Matrix<ElemType>& input) const
+    {
+        if (input.GetDeviceId() == cached.GetDeviceId())
+            input.SetValue(cached);
+        else
+        {
+            Matrix<ElemType> copy(cached);
+            copy.TransferToDeviceIfNotThere(input.GetDeviceId(), true);
+            input.SetValue(copy);
+        }
+    }
+
+    enum State
+    {
+        notCached,
+        recording, // the current sweep is read through and cached
+        cached,    // a whole sweep is cached and is replayed
+        disabled   // everything is read through
+    };
+
+    IDataReader<ElemType>* m_reader;
+    DEVICEID_TYPE m_deviceId; // where the cache is kept
+    size_t m_maxBytes;
+    State m_state;
+
+    std::vector<Minibatch> m_minibatches; // as read; in frame mode, only while recording
+    size_t m_numBytes;
+    bool m_frameMode;
+    size_t m_numParallelSequences; // as the reader reported it for the first minibatch
+    size_t m_numFrames;
+    std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> m_frames; // frame mode: all frames of each input
+
+    // replay
+    Matrix<ElemType> m_frameIndexes; // frame mode: this epoch's permutation of the frames
+    std::vector<size_t> m_order;     // otherwise: this epoch's order of the minibatches
+    size_t m_mbSize;
+    size_t m_next; // next frame or minibatch of this epoch
+    MBLayoutPtr m_layout;
+};
+} } }
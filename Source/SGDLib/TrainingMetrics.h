@@ -0,0 +1,195 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingMetrics.h -- counters and histograms of the training loop, exported periodically for cluster management
+//
+// SGD updates them from the minibatch loop with atomic adds only. A background thread appends a snapshot every
+// exportInterval seconds (and one at the end) to a file, as one JSON object per line (JSON Lines), so that a job
+// scheduler or a sidecar process can tail it to detect slow jobs and stragglers without parsing the log.
+// Each snapshot holds the counters since the start of training, the GPU utilization at export time, and per histogram
+// the count, mean, max and percentiles of the values recorded since the previous snapshot. Histograms have
+// power-of-two buckets of microseconds; the percentiles are the upper bounds of their buckets. With a GPUWatcher
+// that samples the device (SGD's gpuSamplingInterval), the snapshot also holds the GPU's mean activity since the
+// previous one.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "BestGpu.h" // for GetGPUUtilization()
+#include "GPUWatcher.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class TrainingMetrics
+{
+public:
+    class Histogram
+    {
+    public:
+        Histogram()
+            : m_sum(0), m_max(0)
+        {
+            for (auto& bucket : m_buckets)
+                bucket = 0;
+        }
+
+        void Add(double seconds)
+        {
+            uint64_t microseconds = (uint64_t) (seconds * 1e6);
+            size_t bucket = 0;
+            while (bucket + 1 < NumBuckets && (1ull << bucket) <= microseconds)
+                bucket++;
+            m_buckets[bucket]++;
+            m_sum += microseconds;
+            uint64_t max = m_max;
+            while (microseconds > max && !m_max.compare_exchange_weak(max, microseconds))
+                ;
+        }
+
+        // the values since the last call, as a JSON object, and reset
+        std::string TakeJson()
+        {
+            uint64_t counts[NumBuckets];
+            uint64_t count = 0;
+            for (size_t i = 0; i < NumBuckets; i++)
+                count += counts[i] = m_buckets[i].exchange(0);
+            uint64_t sum = m_sum.exchange(0);
+            uint64_t max = m_max.exchange(0);
+            auto percentile = [&](double p)
+            {
+                uint64_t seen = 0;
+                for (size_t i = 0; i < NumBuckets; i++)
+                {
+                    seen += counts[i];
+                    if (seen > 0 && seen >= p * count)
+                        return std::min(1ull << i, (unsigned long long) max) / 1e3;
+                }
+                return max / 1e3;
+            };
+            return msra::strfun::strprintf("{\"count\":%llu,\"meanMs\":%.3f,\"maxMs\":%.3f,\"p50Ms\":%.3f,\"p90Ms\":%.3f,\"p99Ms\":%.3f}",
+                                           (unsigned long long) count, count > 0 ? sum / 1e3 / count : 0.0, max / 1e3, percentile(0.5), percentile(0.9), percentile(0.99));
+        }
+
+    private:
+        static const size_t NumBuckets = 40; // up to 2^39 microseconds, i.e. about a week
+        std::atomic<uint64_t> m_buckets[NumBuckets];
+        std::atomic<uint64_t> m_sum; // microseconds
+        std::atomic<uint64_t> m_max;
+    };
+
+    // adds the time from construction to destruction to a histogram, if there is one
+    class ScopedTime
+    {
+    public:
+        ScopedTime(Histogram* histogram)
+            : m_histogram(histogram)
+        {
+            if (m_histogram)
+                m_start = std::chrono::steady_clock::now();
+        }
+        ~ScopedTime()
+        {
+            if (m_histogram)
+                m_histogram->Add(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+        }
+
+    private:
+        Histogram* m_histogram;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // path: the file to append to; deviceId: the GPU whose utilization to report (< 0: none);
+    // gpuWatcher: if not null, samples that GPU (must outlive this)
+    TrainingMetrics(const std::wstring& path, double exportInterval, int rank, DEVICEID_TYPE deviceId, const GPUWatcher* gpuWatcher = nullptr)
+        : m_numMinibatches(0), m_numSamples(0), m_numBytesSent(0), m_epoch(0), m_trainLossPerSample(0),
+          m_exportInterval(exportInterval), m_rank(rank), m_deviceId(deviceId), m_gpuWatcher(gpuWatcher), m_numSamplesAtLastExport(0), m_stop(false)
+    {
+        if (m_gpuWatcher)
+            m_gpuActivityAtLastExport = m_gpuWatcher->GetActivity();
+        m_file = _wfopen(path.c_str(), L"a");
+        if (!m_file)
+            RuntimeError("TrainingMetrics: Cannot open '%ls' for writing.", path.c_str());
+        m_start = m_lastExport = std::chrono::steady_clock::now();
+        m_exporter = std::thread([this]()
+                                 {
+                                     std::unique_lock<std::mutex> lock(m_mutex);
+                                     while (!m_stop)
+                                     {
+                                         m_stopped.wait_for(lock, std::chrono::duration<double>(m_exportInterval));
+                                         Export();
+                                     }
+                                 });
+    }
+    ~TrainingMetrics()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_stopped.notify_one();
+        m_exporter.join(); // (exports the last snapshot)
+        fclose(m_file);
+    }
+
+    // counters, since the start of training
+    std::atomic<uint64_t> m_numMinibatches;
+    std::atomic<uint64_t> m_numSamples;
+    std::atomic<uint64_t> m_numBytesSent; // gradient payload, see IDistGradAggregator::GetNumBytesSent()
+    std::atomic<int> m_epoch;
+    std::atomic<double> m_trainLossPerSample; // of the last progress message
+    // durations
+    Histogram m_minibatchTime;   // the whole minibatch, as in SGD's SamplesPerSecond
+    Histogram m_readerWait;      // GetMinibatch(), i.e. the time the training waits for data
+    Histogram m_aggregationWait; // gradient aggregation across nodes
+
+private:
+    void Export() // (called with m_mutex held)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t numSamples = m_numSamples;
+        double elapsed = std::chrono::duration<double>(now - m_lastExport).count();
+        double samplesPerSecond = elapsed > 0 ? (numSamples - m_numSamplesAtLastExport) / elapsed : 0.0;
+        m_lastExport = now;
+        m_numSamplesAtLastExport = numSamples;
+
+        fprintf(m_file, "{\"time\":%.3f,\"rank\":%d,\"epoch\":%d,\"minibatches\":%llu,\"samples\":%llu,\"samplesPerSecond\":%.1f,\"bytesSent\":%llu,\"trainLossPerSample\":%.8g,\"gpuUtilization\":%d",
+                std::chrono::duration<double>(now - m_start).count(), m_rank, (int) m_epoch, (unsigned long long) m_numMinibatches, (unsigned long long) numSamples,
+                samplesPerSecond, (unsigned long long) m_numBytesSent, (double) m_trainLossPerSample, m_deviceId >= 0 ? GetGPUUtilization(m_deviceId) : -1);
+        if (m_gpuWatcher)
+        {
+            GPUActivity activity = m_gpuWatcher->GetActivity();
+            GPUActivity mean = activity.MeanSince(m_gpuActivityAtLastExport);
+            m_gpuActivityAtLastExport = activity;
+            fprintf(m_file, ",\"gpu\":{\"samples\":%d,\"smUtilization\":%.1f,\"memoryUtilization\":%.1f,\"pcieTxMBps\":%.1f,\"pcieRxMBps\":%.1f,\"powerWatts\":%.1f}",
+                    (int) mean.numSamples, mean.smUtilization, mean.memoryUtilization, mean.pcieTxMBps, mean.pcieRxMBps, mean.powerWatts);
+        }
+        fprintf(m_file, ",\"minibatchTime\":%s,\"readerWait\":%s,\"aggregationWait\":%s}\n",
+                m_minibatchTime.TakeJson().c_str(), m_readerWait.TakeJson().c_str(), m_aggregationWait.TakeJson().c_str());
+        fflush(m_file); // so that readers of the file see whole lines
+    }
+
+    FILE* m_file;
+    double m_exportInterval; // seconds
+    int m_rank;
+    DEVICEID_TYPE m_deviceId;
+    const GPUWatcher* m_gpuWatcher;
+    GPUActivity m_gpuActivityAtLastExport;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_lastExport;
+    uint64_t m_numSamplesAtLastExport;
+
+    std::thread m_exporter;
+    std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    bool m_stop;
+};
+} } }
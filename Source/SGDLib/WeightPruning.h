@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// WeightPruning.h -- gradual magnitude pruning of the weight matrices during training (SGD's 'pruningTargetSparsity')
+//
+// The sparsity (fraction of zeros) of each weight matrix rises from 0 at the start of epoch e0 = pruningStartEpoch to
+// the target s at the start of epoch e1 = pruningEndEpoch, as s * (1 - (1 - (e - e0) / (e1 - e0))^3), i.e. fast at
+// first, while there are many epochs left to recover, and slowly towards the end (Zhu & Gupta's schedule). At the start
+// of each epoch, the smallest values (by magnitude) of each matrix are set to zero, and a mask of the others is kept,
+// which is applied after every update, so that pruned weights stay zero. Vectors, such as biases, are not pruned.
+//
+// The masks are not saved: after restarting from a checkpoint, they are recovered from the zeros in the weights.
+// For inference, the pruned weights can be evaluated as sparse matrices, see the evaluator's 'sparseWeightsMaxDensity'.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class WeightPruning
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    // epochs are 1-based, as in the log
+    WeightPruning(double targetSparsity, size_t startEpoch, size_t endEpoch)
+        : m_targetSparsity(targetSparsity), m_startEpoch(startEpoch), m_endEpoch(max(endEpoch, startEpoch))
+    {
+        if (targetSparsity < 0 || targetSparsity >= 1)
+            InvalidArgument("pruningTargetSparsity must be at least 0 and less than 1.");
+    }
+
+    // the sparsity to prune to at the start of the (0-based) epoch
+    double SparsityForEpoch(int epochNumber) const
+    {
+        double e = epochNumber + 1.0;
+        if (e < m_startEpoch)
+            return 0;
+        if (e >= m_endEpoch)
+            return m_targetSparsity;
+        double remaining = 1 - (e - m_startEpoch) / (m_endEpoch - m_startEpoch);
+        return m_targetSparsity * (1 - remaining * remaining * remaining);
+    }
+
+    // prune to this epoch's sparsity and (re)compute the masks
+    void StartEpoch(int epochNumber, const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        double sparsity = SparsityForEpoch(epochNumber);
+        if (sparsity <= 0)
+            return;
+
+        size_t numValues = 0, numZeros = 0;
+        for (const auto& nodeBase : learnableNodes)
+        {
+            ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+            if (!node || !node->IsParameterUpdateRequired())
+                continue;
+            Matrix<ElemType>& weights = node->Value();
+            if (weights.GetNumRows() <= 1 || weights.GetNumCols() <= 1 || weights.GetMatrixType() != DENSE)
+                continue;
+
+            // values below the magnitude of the k-th smallest one are set to zero
+            size_t k = (size_t) (sparsity * weights.GetNumElements());
+            if (k > 0)
+            {
+                std::vector<ElemType> magnitudes(weights.GetNumElements());
+                ElemType* values = weights.CopyToArray();
+                for (size_t i = 0; i < magnitudes.size(); i++)
+                    magnitudes[i] = fabs(values[i]);
+                delete[] values;
+                std::nth_element(magnitudes.begin(), magnitudes.begin() + k, magnitudes.end());
+                weights.SetToZeroIfAbsLessThan(magnitudes[k]);
+            }
+
+            auto iter = m_masks.find(node);
+            if (iter == m_masks.end())
+                iter = m_masks.insert(make_pair(node, Matrix<ElemType>(weights.GetDeviceId()))).first;
+            Matrix<ElemType>& mask = iter->second;
+            mask.AssignAbsOf(weights);
+            mask.AssignSignOf(mask); // 1 where kept, 0 where pruned
+
+            numValues += weights.GetNumElements();
+            numZeros += weights.GetNumElements() - (size_t) mask.SumOfElements();
+        }
+        if (numValues > 0)
+            fprintf(stderr, "WeightPruning: Epoch %d: pruned to %.1f%% sparsity (target %.1f%%).\n",
+                    epochNumber + 1, 100.0 * numZeros / numValues, 100.0 * sparsity);
+    }
+
+    // after each update: keep the pruned weights at zero
+    void ApplyMasks()
+    {
+        for (auto& iter : m_masks)
+            iter.first->Value().ElementMultiplyWith(iter.second);
+    }
+
+private:
+    double m_targetSparsity;
+    double m_startEpoch;
+    double m_endEpoch;
+    std::map<ComputationNodePtr, Matrix<ElemType>> m_masks;
+};
+} } }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <exception>
 #include "simplesenonehmm.h"
 #include "latticearchive.h"
 #include "latticesource.h"
@@ -36,7 +37,7 @@ class GammaCalculation
 
 public:
     GammaCalculation()
-        : cpumode(false)
+        : cpumode(false), m_numeratorlogLLs(CPUDEVICE)
     {
         initialmark = false;
         lmf = 7.0f; // Note that 9 was best for Fisher  --these should best be configurable
@@ -55,6 +56,7 @@ public:
     void init(msra::asr::simplesenonehmm hset, int DeviceId)
     {
         m_deviceid = DeviceId;
+        m_numeratorlogLLs.TransferToDeviceIfNotThere(DeviceId, true, true);
         if (!initialmark)
         {
             m_hset = hset;
@@ -97,7 +99,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -123,23 +124,39 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
-        size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
-        size_t ts = 0;
-        for (size_t i = 0; i < lattices.size(); i++)
+        // The GPU holds the state of one lattice at a time, so there each utterance is copied in, processed, and copied out
+        // before the next one. On the CPU, the lattices only share read-only models, and each one works on its own column
+        // stripe of 'pred' and 'dengammas', so we copy in all utterances, run forward-backward on all lattices in parallel,
+        // and then copy out all gammas in the original order.
+        const bool parallelutterances = !parallellattice.enabled() && lattices.size() > 1;
+        std::vector<utterancestate> utterances(lattices.size());
+
+        // On the GPU, lattice forward-backward reads the logLLs from and writes the gammas to device matrices, so the
+        // logLLs only need to go to the CPU for the reference alignment. The numerator log-likelihoods are then taken from
+        // the labels, which are the one-hot encoding of 'uids', and only those are copied to the CPU.
+        const bool logllsoncpu = !parallellattice.enabled() || doreferencealign || labels.GetMatrixType() != Microsoft::MSR::CNTK::MatrixType::DENSE;
+        if (!logllsoncpu)
+        {
+            Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProduct(labels, loglikelihood, m_numeratorlogLLs, true /*isColWise*/);
+            m_numeratorlogLLscpu.resize(numcols);
+            m_numeratorlogLLs.CopySection(1, numcols, m_numeratorlogLLscpu.data(), 1);
+        }
+
+        // copy the logLLs of utterance [i] into 'pred' (and to the GPU), and determine its location in the minibatch
+        auto beginutterance = [&](size_t i, size_t ts)
         {
+            auto& utt = utterances[i];
             const size_t numframes = lattices[i]->getnumframes();
+            utt.ts = ts;
+            utt.numframes = numframes;
 
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
+            msra::dbn::matrixstripe predstripe(pred, ts, numframes); // logLLs for this utterance
 
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
                 tempmatrix = loglikelihood.ColumnSlice(ts, numframes);
-                // if (m_deviceid == CPUDEVICE)
-                {
+                if (logllsoncpu)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
                 if (m_deviceid != CPUDEVICE)
                     parallellattice.setloglls(tempmatrix);
@@ -147,16 +164,17 @@ public:
             else // multiple parallel sequences
             {
                 // get number of frames for the utterance
-                mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                utt.mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                utt.mapt = validframes[utt.mapi];
 
                 // scan MBLayout for end of utterance
                 size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
-                for (size_t t = validframes[mapi]; t < T; t++)
+                for (size_t t = utt.mapt; t < T; t++)
                 {
                     // TODO: Adapt this to new MBLayout, m_sequences would be easier to work off.
-                    if (pMBLayout->IsEnd(mapi, t))
+                    if (pMBLayout->IsEnd(utt.mapi, t))
                     {
-                        mapframenum = t - validframes[mapi] + 1;
+                        mapframenum = t - utt.mapt + 1;
                         break;
                     }
                 }
@@ -169,54 +187,66 @@ public:
                 if (numframes > tempmatrix.GetNumCols())
                     tempmatrix.Resize(numrows, numframes);
 
-                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(utt.mapi + (utt.mapt * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
 
-                // if (doreferencealign || m_deviceid == CPUDEVICE)
-                {
+                if (logllsoncpu)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
                 if (m_deviceid != CPUDEVICE)
                 {
                     parallellattice.setloglls(tempmatrix);
                 }
-            }
-
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
+                validframes[utt.mapi] += numframes; // advance the cursor within the parallel sequence
             }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
 
-            double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+            utt.numavlogp = 0;
+            for (size_t t = 0; t < numframes; t++) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
             {
                 const size_t s = uidsstripe[t];
-                numavlogp += predstripe(s, t) / amf;
+                if (logllsoncpu)
+                    utt.numavlogp += predstripe(s, t) / amf;
+                else
+                    utt.numavlogp += m_numeratorlogLLscpu[samplesInRecurrentStep == 1 ? ts + t : (utt.mapt + t) * samplesInRecurrentStep + utt.mapi] / amf;
             }
-            numavlogp /= numframes;
+            utt.numavlogp /= numframes;
+        };
+
+        // run lattice forward-backward for utterance [i]; this only touches the utterance's own stripes
+        auto forwardbackwardutterance = [&](size_t i)
+        {
+            auto& utt = utterances[i];
+            msra::dbn::matrixstripe predstripe(pred, utt.ts, utt.numframes);           // logLLs for this utterance
+            msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, utt.numframes); // denominator gammas
+            array_ref<size_t> uidsstripe(&uids[utt.ts], utt.numframes);
+            array_ref<size_t> boundariesstripe(&boundaries[utt.ts], doreferencealign ? utt.numframes : 0);
 
             // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+            utt.denavlogp = lattices[i]->second.forwardbackward(parallellattice,
+                                                                (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                                                (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                                                lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+        };
+
+        // copy the gammas of utterance [i] into 'gammafromlattice', and its reference alignment into 'labels'
+        auto endutterance = [&](size_t i)
+        {
+            const auto& utt = utterances[i];
+            const size_t numframes = utt.numframes;
+            objectValue += (ElemType)((utt.numavlogp - utt.denavlogp) * numframes);
 
             if (samplesInRecurrentStep == 1)
             {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+                tempmatrix = gammafromlattice.ColumnSlice(utt.ts, numframes);
             }
 
             // copy gamma to tempmatrix
             if (m_deviceid == CPUDEVICE)
             {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+                msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, numframes);
+                CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
             }
             else
                 parallellattice.getgamma(tempmatrix);
@@ -224,7 +254,7 @@ public:
             // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
             {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(utt.mapi + (utt.mapt * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
             }
 
@@ -232,22 +262,72 @@ public:
             {
                 for (size_t nframe = 0; nframe < numframes; nframe++)
                 {
-                    size_t uid = uidsstripe[nframe];
+                    size_t uid = uids[utt.ts + nframe];
                     if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
+                        labels(uid, (nframe + utt.mapt) * samplesInRecurrentStep + utt.mapi) = 1.0;
                     else
-                        labels(uid, ts + nframe) = 1.0;
+                        labels(uid, utt.ts + nframe) = 1.0;
                 }
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
+            fprintf(stderr, "dengamma value %f\n", utt.denavlogp);
+        };
+
+        // cal gamma for each utterance
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            beginutterance(i, ts);
+            if (!parallelutterances)
+            {
+                forwardbackwardutterance(i);
+                endutterance(i);
+            }
+            ts += utterances[i].numframes;
+        }
+
+        if (parallelutterances)
+        {
+            // exceptions must not leave an OpenMP region, so we pass the first one on after the loop
+            std::exception_ptr firstException;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int i = 0; i < (int) lattices.size(); i++)
+            {
+                try
+                {
+                    forwardbackwardutterance(i);
+                }
+                catch (...)
+                {
+#pragma omp critical
+                    if (!firstException)
+                        firstException = std::current_exception();
+                }
+            }
+            if (firstException)
+                std::rethrow_exception(firstException);
+
+            for (size_t i = 0; i < lattices.size(); i++)
+                endutterance(i);
         }
         functionValues.SetValue(objectValue);
     }
 
 private:
+    // location of an utterance within the minibatch, and its lattice forward-backward results
+    struct utterancestate
+    {
+        size_t ts;        // first column in 'pred', 'dengammas', and 'uids'
+        size_t numframes;
+        size_t mapi;      // parallel-sequence index (if multiple parallel sequences)
+        size_t mapt;      // first time step within that parallel sequence
+        double numavlogp; // av. log-likelihood of the reference state sequence
+        double denavlogp; // av. posterior as returned by lattice forward-backward
+        utterancestate()
+            : ts(0), numframes(0), mapi(0), mapt(0), numavlogp(0), denavlogp(0)
+        {
+        }
+    };
+
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
@@ -258,6 +338,11 @@ private:
 
         size_t numRows = src.GetNumRows();
         const Microsoft::MSR::CNTK::Matrix<ElemType> srcSlice = src.ColumnSlice(0, numCols);
+        if (srcSlice.GetDeviceId() == CPUDEVICE && numRows == dest.rows()) // no staging needed, copy straight into the columns of 'dest'
+        {
+            srcSlice.CopySection(numRows, numCols, (ElemType*) &dest(0, 0), dest.getcolstride());
+            return;
+        }
         if ((m_intermediateCUDACopyBuffer == nullptr) || (m_intermediateCUDACopyBufferSize < srcSlice.GetNumElements()))
         {
             m_intermediateCUDACopyBuffer = AllocateIntermediateBuffer(srcSlice.GetDeviceId(), srcSlice.GetNumElements());
@@ -292,6 +377,13 @@ private:
             LogicError("Cannot copy between a SSE matrix and a non-float type CNTK Matrix object!");
         }
 
+        if (deviceId == CPUDEVICE && (src.getcolstride() == src.rows()) && (numRows == src.rows())) // no staging needed, copy straight from 'src'
+        {
+            Microsoft::MSR::CNTK::Matrix<ElemType> srcView(numRows, numCols, (ElemType*) &src(0, 0), Microsoft::MSR::CNTK::matrixFlagDontOwnBuffer, CPUDEVICE);
+            dest.SetValue(srcView);
+            return;
+        }
+
         size_t numElements = numRows * numCols;
         if ((m_intermediateCUDACopyBuffer == nullptr) || (m_intermediateCUDACopyBufferSize < numElements))
         {
@@ -378,5 +470,7 @@ private:
     std::unique_ptr<Microsoft::MSR::CNTK::CUDAPageLockedMemAllocator> m_cudaAllocator;
     std::shared_ptr<ElemType> m_intermediateCUDACopyBuffer;
     size_t m_intermediateCUDACopyBufferSize;
+    Microsoft::MSR::CNTK::Matrix<ElemType> m_numeratorlogLLs; // [1 x T] log-likelihoods of the reference states (GPU only)
+    std::vector<ElemType> m_numeratorlogLLscpu;
 };
 } }
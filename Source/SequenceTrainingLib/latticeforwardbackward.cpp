@@ -15,6 +15,7 @@
 #include <unordered_map>
 #include <list>
 #include <stdexcept>
+#include <exception>
 
 using namespace std;
 
@@ -958,7 +959,13 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
             parallelstate.getedgeacscores(edgeacscoresgpu);
             parallelstate.copyalignments(thisedgealignmentsgpu);
         }
-        foreach_index (j, edges)
+        // Edges only write their own score, alignment, and alpha/beta/gamma matrix, so they are processed in parallel.
+        // When called for several lattices in parallel, nested parallelism is off, and this runs on the calling thread.
+        // Exceptions must not leave an OpenMP region, so we pass the first one on after the loop.
+        thisedgealignments.getalignmentsbuffer(); // allocate here, since thisedgealignments[j] would do it lazily in the loop
+        std::exception_ptr firstException;
+#pragma omp parallel for schedule(dynamic, 64) if (!cpuverification)
+        for (int j = 0; j < (int) edges.size(); j++)
         {
             const edgeinfowithscores &e = edges[j];
             const size_t ts = nodes[e.S].t;
@@ -969,12 +976,21 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
             {
                 const auto &aligntokens = getaligninfo(j); // get alignment tokens
                 const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
-                if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
-                    edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
-                else if (softalignstates)
-                    edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
-                else
-                    edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
+                try
+                {
+                    if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
+                        edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
+                    else if (softalignstates)
+                        edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
+                    else
+                        edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
+                }
+                catch (...)
+                {
+#pragma omp critical
+                    if (!firstException)
+                        firstException = std::current_exception();
+                }
             }
             if (cpuverification)
             {
@@ -1002,6 +1018,8 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
                 }
             }
         }
+        if (firstException)
+            std::rethrow_exception(firstException);
     }
 }
 
@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+# ----------------------------------------------------------
+# Copyright (c) Microsoft Corporation.  All rights reserved.
+# ---------------------------------------------------------
+# Generates the synthetic training data of the benchmarks (see README.txt). The data are deterministic for a given seed.
+#
+#   GenerateSyntheticData.py dense <file> <numSamples> <featureDim> <numClasses> [seed]
+#       UCIFastReader format: the class index, then the features, whose mean depends on the class (so that the
+#       networks have something to learn)
+#   GenerateSyntheticData.py text <file> <numSentences> <vocabSize> [seed]
+#       LMSequenceReader format: one sentence of 5..30 Zipf-distributed words per line, framed by </s>;
+#       every word of the vocabulary occurs at least once
+#   GenerateSyntheticData.py labelmap <file> <numClasses>
+#       UCIFastReader label mapping file: the class indices 0..numClasses-1
+
+import random
+import sys
+
+def dense(fileName, numSamples, featureDim, numClasses, seed):
+  rng = random.Random(seed)
+  classMeans = [[rng.uniform(-1, 1) for i in range(featureDim)] for c in range(numClasses)]
+  with open(fileName, "w") as f:
+    for s in range(numSamples):
+      c = rng.randrange(numClasses)
+      features = " ".join("%.3f" % (m + rng.gauss(0, 1)) for m in classMeans[c])
+      f.write("%d %s\n" % (c, features))
+
+def text(fileName, numSentences, vocabSize, seed):
+  rng = random.Random(seed)
+  words = ["w%d" % i for i in range(vocabSize)]
+  with open(fileName, "w") as f:
+    for i in range(0, vocabSize, 20):
+      f.write("</s> %s </s>\n" % " ".join(words[i:i + 20]))
+    for s in range(numSentences):
+      length = rng.randint(5, 30)
+      sentence = [words[min(int(vocabSize ** rng.random()) - 1, vocabSize - 1)] for i in range(length)]
+      f.write("</s> %s </s>\n" % " ".join(sentence))
+
+def labelmap(fileName, numClasses):
+  with open(fileName, "w") as f:
+    for c in range(numClasses):
+      f.write("%d\n" % c)
+
+if __name__ == "__main__":
+  if len(sys.argv) < 4:
+    sys.exit("usage: GenerateSyntheticData.py dense|text|labelmap <file> <arguments>; see the header of the script")
+  kind, fileName, args = sys.argv[1], sys.argv[2], [int(a) for a in sys.argv[3:]]
+  if kind == "dense":
+    dense(fileName, args[0], args[1], args[2], args[3] if len(args) > 3 else 1)
+  elif kind == "text":
+    text(fileName, args[0], args[1], args[2] if len(args) > 2 else 1)
+  elif kind == "labelmap":
+    labelmap(fileName, args[0])
+  else:
+    sys.exit("unknown kind of data: " + kind)
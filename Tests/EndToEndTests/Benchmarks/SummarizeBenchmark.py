@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+# ----------------------------------------------------------
+# Copyright (c) Microsoft Corporation.  All rights reserved.
+# ---------------------------------------------------------
+# Summarizes a benchmark run (see README.txt) into one JSON object, appended to the results file for regression tracking,
+# and prints it as one "Benchmark result:" line.
+#
+#   SummarizeBenchmark.py <resultsFile> <name> <device> <numProcesses> <metricsFile> <logFile>...
+#
+# The metrics file(s) are those written by SGD's metricsFile option (<metricsFile>.rank<N> for each MPI rank), one
+# JSON object per metricsExportInterval. The first interval of each rank is skipped as warm-up (network compilation,
+# memory allocation, reader start-up). Throughput is summed over the ranks; step latencies are per rank, and the
+# slowest rank's are reported, since that is what the others wait for.
+# Peak memory is taken from the logs of memoryReport: the largest total of distinct matrices of the network plus the
+# optimizer state, and on GPUs the peak of the CUDA caching allocator.
+
+import glob
+import json
+import re
+import sys
+
+def readMetrics(metricsFile):
+  files = sorted(glob.glob(metricsFile + ".rank*")) or [metricsFile]
+  ranks = []
+  for fileName in files:
+    with open(fileName) as f:
+      snapshots = [json.loads(line) for line in f if line.strip()]
+    ranks.append(snapshots)
+  return ranks
+
+# the intervals after the first one; the counters are cumulative, so the first snapshot is the baseline for those
+def summarizeRank(snapshots):
+  baseline, measured = (snapshots[0], snapshots[1:]) if len(snapshots) > 1 else (None, snapshots)
+  duration = measured[-1]["time"] - (baseline["time"] if baseline else 0)
+  samples = measured[-1]["samples"] - (baseline["samples"] if baseline else 0)
+  # mean of a histogram value over the intervals, weighted by the number of values in each
+  def mean(histogram, key):
+    count = sum(s[histogram]["count"] for s in measured)
+    return sum(s[histogram][key] * s[histogram]["count"] for s in measured) / count if count > 0 else 0.0
+  gpu = [s["gpuUtilization"] for s in measured if s["gpuUtilization"] >= 0]
+  return {
+    "samplesPerSecond": samples / duration if duration > 0 else 0.0,
+    "stepMeanMs": mean("minibatchTime", "meanMs"),
+    "stepP50Ms": mean("minibatchTime", "p50Ms"),
+    "stepP90Ms": mean("minibatchTime", "p90Ms"),
+    "stepP99Ms": max(s["minibatchTime"]["p99Ms"] for s in measured),
+    "stepMaxMs": max(s["minibatchTime"]["maxMs"] for s in measured),
+    "readerWaitMeanMs": mean("readerWait", "meanMs"),
+    "aggregationWaitMeanMs": mean("aggregationWait", "meanMs"),
+    "bytesSent": measured[-1]["bytesSent"],
+    "gpuUtilization": sum(gpu) / float(len(gpu)) if gpu else -1,
+  }
+
+def readPeakMemory(logFiles):
+  networkMB, optimizerMB, allocatorMB = 0.0, 0.0, 0.0
+  for fileName in logFiles:
+    with open(fileName) as f:
+      for line in f:
+        m = re.search(r"^Total +([0-9.]+) MB as held by the nodes, +([0-9.]+) in", line)
+        if m:
+          networkMB = max(networkMB, float(m.group(2)))
+        m = re.search(r"^Total optimizer state ([0-9.]+) MB", line)
+        if m:
+          optimizerMB = max(optimizerMB, float(m.group(1)))
+        m = re.search(r"^CUDADeviceCachingAllocator .* peak ([0-9.]+) MB", line)
+        if m:
+          allocatorMB = max(allocatorMB, float(m.group(1)))
+  return networkMB, optimizerMB, allocatorMB
+
+if __name__ == "__main__":
+  if len(sys.argv) < 7:
+    sys.exit("usage: SummarizeBenchmark.py <resultsFile> <name> <device> <numProcesses> <metricsFile> <logFile>...")
+  resultsFile, name, device, numProcesses, metricsFile, logFiles = sys.argv[1], sys.argv[2], sys.argv[3], int(sys.argv[4]), sys.argv[5], sys.argv[6:]
+
+  ranks = [summarizeRank(snapshots) for snapshots in readMetrics(metricsFile)]
+  slowest = max(ranks, key=lambda r: r["stepMeanMs"])
+  networkMB, optimizerMB, allocatorMB = readPeakMemory(logFiles)
+  result = {
+    "benchmark": name,
+    "device": device,
+    "processes": numProcesses,
+    "samplesPerSecond": round(sum(r["samplesPerSecond"] for r in ranks), 1),
+    "stepMeanMs": round(slowest["stepMeanMs"], 3),
+    "stepP50Ms": round(slowest["stepP50Ms"], 3),
+    "stepP90Ms": round(slowest["stepP90Ms"], 3),
+    "stepP99Ms": round(slowest["stepP99Ms"], 3),
+    "stepMaxMs": round(slowest["stepMaxMs"], 3),
+    "readerWaitMeanMs": round(slowest["readerWaitMeanMs"], 3),
+    "aggregationWaitMeanMs": round(slowest["aggregationWaitMeanMs"], 3),
+    "bytesSentPerProcess": max(r["bytesSent"] for r in ranks),
+    "gpuUtilization": round(sum(r["gpuUtilization"] for r in ranks) / len(ranks), 1),
+    "peakNetworkMB": networkMB,
+    "peakOptimizerStateMB": optimizerMB,
+    "peakDeviceAllocatorMB": allocatorMB,
+  }
+  line = json.dumps(result, sort_keys=True)
+  with open(resultsFile, "a") as f:
+    f.write(line + "\n")
+  print("Benchmark result: " + line)
@@ -0,0 +1,133 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Benchmark.h -- timing harness of the Math microbenchmarks
+//
+// Each benchmark is one operation on preallocated operands. It is run a few times to warm up (first-call allocations,
+// cuBLAS/cuDNN handle and algorithm selection, caches), then repeatedly, at least MinRepetitions times and for at least
+// MinSeconds, each repetition timed on the host with the device synchronized after it. Reported are the mean, min and
+// percentiles of the repetitions, and the achieved bandwidth and arithmetic throughput at the median time, from the
+// bytes and floating-point operations the caller declares for one repetition (the minimum that has to be moved and
+// computed, not what a particular kernel does).
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include <cuda_runtime_api.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class Benchmark
+{
+public:
+    struct Options
+    {
+        int deviceId = -1;
+        std::string filter;   // run only benchmarks whose name contains this
+        size_t numWarmups = 3;
+        size_t minRepetitions = 10;
+        size_t maxRepetitions = 1000;
+        double minSeconds = 0.5;
+        std::string jsonPath; // if not empty, append one JSON object per benchmark
+        const char* precision = "float";
+    };
+
+    Benchmark(const Options& options)
+        : m_options(options), m_json(nullptr)
+    {
+        if (!m_options.jsonPath.empty())
+        {
+            m_json = fopen(m_options.jsonPath.c_str(), "a");
+            if (!m_json)
+                RuntimeError("Benchmark: Cannot open '%s' for writing.", m_options.jsonPath.c_str());
+        }
+        fprintf(stdout, "%-44s %-28s %6s %10s %10s %10s %10s %10s %9s %9s\n",
+                "benchmark", "shape", "reps", "mean ms", "min ms", "p50 ms", "p90 ms", "p99 ms", "GB/s", "GFLOP/s");
+    }
+    ~Benchmark()
+    {
+        if (m_json)
+            fclose(m_json);
+    }
+
+    bool IsSelected(const std::string& name) const
+    {
+        return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+    }
+
+    // time 'op'; 'bytes' and 'flops' are those of one call
+    void Run(const std::string& name, const std::string& shape, double bytes, double flops, const std::function<void()>& op)
+    {
+        if (!IsSelected(name))
+            return;
+
+        for (size_t i = 0; i < m_options.numWarmups; i++)
+            op();
+        Synchronize();
+
+        std::vector<double> times; // seconds
+        double total = 0;
+        while (times.size() < m_options.maxRepetitions && (times.size() < m_options.minRepetitions || total < m_options.minSeconds))
+        {
+            auto start = std::chrono::steady_clock::now();
+            op();
+            Synchronize();
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            times.push_back(time);
+            total += time;
+        }
+
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](double p)
+        {
+            return times[std::min((size_t) (p * times.size()), times.size() - 1)];
+        };
+        double mean = total / times.size();
+        double median = percentile(0.5);
+        double gbPerSecond = bytes / median / 1e9;
+        double gflopPerSecond = flops / median / 1e9;
+
+        fprintf(stdout, "%-44s %-28s %6d %10.4f %10.4f %10.4f %10.4f %10.4f %9.2f %9.2f\n",
+                name.c_str(), shape.c_str(), (int) times.size(), mean * 1e3, times.front() * 1e3,
+                median * 1e3, percentile(0.9) * 1e3, percentile(0.99) * 1e3, gbPerSecond, gflopPerSecond);
+        fflush(stdout);
+        if (m_json)
+        {
+            fprintf(m_json, "{\"benchmark\":\"%s\",\"shape\":\"%s\",\"precision\":\"%s\",\"device\":%d,\"repetitions\":%d,"
+                            "\"meanMs\":%.6f,\"minMs\":%.6f,\"p50Ms\":%.6f,\"p90Ms\":%.6f,\"p99Ms\":%.6f,\"GBps\":%.3f,\"GFLOPps\":%.3f}\n",
+                    name.c_str(), shape.c_str(), m_options.precision, m_options.deviceId, (int) times.size(),
+                    mean * 1e3, times.front() * 1e3, median * 1e3, percentile(0.9) * 1e3, percentile(0.99) * 1e3, gbPerSecond, gflopPerSecond);
+            fflush(m_json);
+        }
+    }
+
+    int GetDeviceId() const
+    {
+        return m_options.deviceId;
+    }
+
+private:
+    // wait for the kernels of the repetition; they may be on several streams
+    void Synchronize() const
+    {
+#ifndef CPUONLY
+        if (m_options.deviceId >= 0)
+            cudaDeviceSynchronize();
+#endif
+    }
+
+    Options m_options;
+    FILE* m_json;
+};
+} } }
@@ -0,0 +1,371 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.cpp -- microbenchmarks of the Math library: element-wise ops, GEMM shapes of real models, TensorView
+// broadcasting, sparse times dense, gradient quantization and convolution engines
+//
+//   MathBenchmarks [-device <id>] [-double] [-filter <substring>] [-warmup <n>] [-repeat <n>] [-seconds <s>]
+//                  [-convEngine auto|cudnn|legacy|direct] [-json <file>]
+//
+// -device: GPU id, or -1 for the CPU (default)
+// -filter: run only the benchmarks whose name contains the substring, e.g. "GEMM/" or "Convolution/"
+// -repeat, -seconds: at least this many repetitions and seconds per benchmark (see Benchmark.h)
+// -json: append the results as JSON lines, e.g. for comparing builds or machines
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms
+#include "Basics.h"
+#include "Matrix.h"
+#include "TensorView.h"
+#include "QuantizedMatrix.h"
+#include "MatrixQuantizerImpl.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "ConvolutionEngine.h"
+#include "Benchmark.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+static string Shape(size_t rows, size_t cols)
+{
+    return msra::strfun::strprintf("%dx%d", (int) rows, (int) cols);
+}
+
+// -----------------------------------------------------------------------
+// element-wise ops and reductions (bandwidth-bound)
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void ElementwiseBenchmarks(Benchmark& benchmark)
+{
+    const size_t shapes[][2] = {{2048, 256}, {4096, 1024}};
+    for (const auto& shape : shapes)
+    {
+        size_t rows = shape[0], cols = shape[1];
+        double n = (double) rows * cols;
+        double bytes = n * sizeof(ElemType);
+        int deviceId = benchmark.GetDeviceId();
+        Matrix<ElemType> a(rows, cols, deviceId), b(rows, cols, deviceId), c(rows, cols, deviceId);
+        a.SetUniformRandomValue(-1, 1, 1);
+        b.SetUniformRandomValue(-1, 1, 2);
+        c.SetValue(0);
+
+        benchmark.Run("Elementwise/SetValue", Shape(rows, cols), bytes, 0, [&]() { c.SetValue(1); });
+        benchmark.Run("Elementwise/ScaleAndAdd", Shape(rows, cols), 3 * bytes, 2 * n, [&]() { Matrix<ElemType>::ScaleAndAdd(0.5, a, c); });
+        benchmark.Run("Elementwise/AssignElementProductOf", Shape(rows, cols), 3 * bytes, n, [&]() { c.AssignElementProductOf(a, b); });
+        benchmark.Run("Elementwise/AssignSigmoidOf", Shape(rows, cols), 2 * bytes, n, [&]() { c.AssignSigmoidOf(a); });
+        benchmark.Run("Elementwise/AssignLogSoftmaxOf", Shape(rows, cols), 2 * bytes, 3 * n, [&]() { c.AssignLogSoftmaxOf(a, true); });
+        benchmark.Run("Reduction/SumOfElements", Shape(rows, cols), bytes, n, [&]() { a.SumOfElements(); });
+    }
+}
+
+// -----------------------------------------------------------------------
+// GEMM, in the shapes of the forward and both backward products of typical layers
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void GEMMBenchmarks(Benchmark& benchmark)
+{
+    // m x k weights times k x n activations
+    struct Layer
+    {
+        const char* name;
+        size_t m, k, n;
+    };
+    const Layer layers[] = {
+        {"DNN input 440 -> 2048", 2048, 440, 256},
+        {"DNN hidden 2048 -> 2048", 2048, 2048, 256},
+        {"DNN output 2048 -> 9000", 9000, 2048, 256},
+        {"LSTM step 4x1024 gates", 4096, 1024, 64},
+        {"LM output 200 -> 10000", 10000, 200, 128},
+        {"Conv 3x3x128 unpacked 28x28", 128, 1152, 784},
+    };
+    int deviceId = benchmark.GetDeviceId();
+    for (const auto& layer : layers)
+    {
+        Matrix<ElemType> w(layer.m, layer.k, deviceId), x(layer.k, layer.n, deviceId), y(layer.m, layer.n, deviceId);
+        Matrix<ElemType> dw(layer.m, layer.k, deviceId), dx(layer.k, layer.n, deviceId);
+        w.SetUniformRandomValue(-1, 1, 1);
+        x.SetUniformRandomValue(-1, 1, 2);
+        y.SetUniformRandomValue(-1, 1, 3);
+        dw.SetValue(0);
+        dx.SetValue(0);
+
+        double flops = 2.0 * layer.m * layer.k * layer.n;
+        string shape = msra::strfun::strprintf("%dx%d * %dx%d", (int) layer.m, (int) layer.k, (int) layer.k, (int) layer.n);
+        auto bytes = [&](size_t outputElements)
+        {
+            return ((double) layer.m * layer.k + (double) layer.k * layer.n + (double) layer.m * layer.n + outputElements) * sizeof(ElemType);
+        };
+        string name = string("GEMM/") + layer.name;
+        benchmark.Run(name + " (forward W x)", shape, bytes(0), flops, [&]()
+                      {
+                          Matrix<ElemType>::MultiplyAndWeightedAdd(1, w, false, x, false, 0, y);
+                      });
+        benchmark.Run(name + " (input gradient W' dy)", shape, bytes(0), flops, [&]()
+                      {
+                          Matrix<ElemType>::MultiplyAndWeightedAdd(1, w, true, y, false, 0, dx);
+                      });
+        benchmark.Run(name + " (weight gradient += dy x')", shape, bytes(layer.m * layer.k), flops, [&]()
+                      {
+                          Matrix<ElemType>::MultiplyAndWeightedAdd(1, y, false, x, true, 1, dw);
+                      });
+    }
+}
+
+// -----------------------------------------------------------------------
+// TensorView: broadcasting and reduction
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void TensorViewBenchmarks(Benchmark& benchmark)
+{
+    const size_t rows = 2048, cols = 1024;
+    int deviceId = benchmark.GetDeviceId();
+    Matrix<ElemType> a(rows, cols, deviceId), c(rows, cols, deviceId), column(rows, 1, deviceId), row(1, cols, deviceId), columnSum(rows, 1, deviceId);
+    a.SetUniformRandomValue(-1, 1, 1);
+    column.SetUniformRandomValue(-1, 1, 2);
+    row.SetUniformRandomValue(-1, 1, 3);
+    c.SetValue(0);
+    columnSum.SetValue(0);
+
+    TensorView<ElemType> aView(a, TensorShape(rows, cols)), cView(c, TensorShape(rows, cols));
+    TensorView<ElemType> columnView(column, TensorShape(rows, 1)), rowView(row, TensorShape(1, cols)), columnSumView(columnSum, TensorShape(rows, 1));
+    double n = (double) rows * cols;
+    double bytes = n * sizeof(ElemType);
+
+    benchmark.Run("TensorView/Sum same shape", Shape(rows, cols), 2 * bytes, n, [&]() { cView.AssignSumOf(aView, aView); });
+    benchmark.Run("TensorView/Sum column broadcast (bias)", Shape(rows, cols), 2 * bytes, n, [&]() { cView.AssignSumOf(aView, columnView); });
+    benchmark.Run("TensorView/ElementwiseProduct row broadcast", Shape(rows, cols), 2 * bytes, n, [&]() { cView.AssignElementwiseProductOf(aView, rowView); });
+    benchmark.Run("TensorView/Sigmoid", Shape(rows, cols), 2 * bytes, n, [&]() { cView.AssignSigmoidOf(aView); });
+    benchmark.Run("TensorView/Copy reduce to column (bias gradient)", Shape(rows, cols), bytes, n, [&]() { columnSumView.AssignCopyOf(aView); });
+}
+
+// -----------------------------------------------------------------------
+// sparse inputs times dense weights, as in embeddings and sparse feature layers
+// -----------------------------------------------------------------------
+
+// numRows x numCols CSC matrix with nzPerColumn distinct random rows per column, values 1
+template <class ElemType>
+void SetRandomSparse(Matrix<ElemType>& m, size_t numRows, size_t numCols, size_t nzPerColumn)
+{
+    vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1), rows;
+    vector<ElemType> values;
+    srand(1);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        colStarts[j] = (CPUSPARSE_INDEX_TYPE) rows.size();
+        size_t stride = numRows / nzPerColumn;
+        for (size_t i = 0; i < nzPerColumn; i++) // one row in each of nzPerColumn bands, so that they are sorted and distinct
+        {
+            rows.push_back((CPUSPARSE_INDEX_TYPE) (i * stride + rand() % stride));
+            values.push_back(1);
+        }
+    }
+    colStarts[numCols] = (CPUSPARSE_INDEX_TYPE) rows.size();
+    m.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), values.size(), numRows, numCols);
+}
+
+template <class ElemType>
+void SparseBenchmarks(Benchmark& benchmark)
+{
+    struct Input
+    {
+        const char* name;
+        size_t inputDim, nzPerColumn, outputDim, batchSize;
+    };
+    const Input inputs[] = {
+        {"one-hot words 10000 -> 200", 10000, 1, 200, 256},
+        {"1% dense features 50000 -> 512", 50000, 500, 512, 256},
+    };
+    int deviceId = benchmark.GetDeviceId();
+    for (const auto& input : inputs)
+    {
+        Matrix<ElemType> x(input.inputDim, input.batchSize, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+        SetRandomSparse(x, input.inputDim, input.batchSize, input.nzPerColumn);
+        Matrix<ElemType> w(input.outputDim, input.inputDim, deviceId), y(input.outputDim, input.batchSize, deviceId), dw(input.outputDim, input.inputDim, deviceId);
+        w.SetUniformRandomValue(-1, 1, 1);
+        y.SetUniformRandomValue(-1, 1, 2);
+        dw.SetValue(0);
+
+        double nz = (double) input.nzPerColumn * input.batchSize;
+        double flops = 2.0 * nz * input.outputDim;
+        // the weight columns of the non-zeros, the sparse input and the output
+        double bytes = nz * input.outputDim * sizeof(ElemType) + nz * (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) + (double) input.outputDim * input.batchSize * sizeof(ElemType);
+        string shape = msra::strfun::strprintf("%dx%d * %dx%d nz %d", (int) input.outputDim, (int) input.inputDim, (int) input.inputDim, (int) input.batchSize, (int) nz);
+        string name = string("SpMM/") + input.name;
+        benchmark.Run(name + " (forward W x)", shape, bytes, flops, [&]()
+                      {
+                          Matrix<ElemType>::MultiplyAndWeightedAdd(1, w, false, x, false, 0, y);
+                      });
+        benchmark.Run(name + " (weight gradient += dy x')", shape, bytes, flops, [&]()
+                      {
+                          Matrix<ElemType>::MultiplyAndWeightedAdd(1, y, false, x, true, 1, dw);
+                      });
+    }
+}
+
+// -----------------------------------------------------------------------
+// gradient quantization with residuals, as in QuantizedDistGradAggregator
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void QuantizationBenchmarks(Benchmark& benchmark)
+{
+    const size_t rows = 2048, cols = 2048;
+    int deviceId = benchmark.GetDeviceId();
+    unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(deviceId, false));
+    unique_ptr<MemAllocator> allocator(deviceId == CPUDEVICE ? nullptr : new CUDAPageLockedMemAllocator(deviceId));
+    Matrix<ElemType> gradient(rows, cols, deviceId), residual(rows, cols, deviceId), unquantized(rows, cols, deviceId);
+    gradient.SetUniformRandomValue(-1, 1, 1);
+    residual.SetValue(0);
+    unquantized.SetValue(0);
+
+    for (size_t numBits : {1, 8})
+    {
+        // (like the aggregator, the quantized matrix is on the CPU, to be sent)
+        QuantizedMatrix<ElemType> quantized(rows, cols, numBits, CPUDEVICE, allocator.get());
+        double n = (double) rows * cols;
+        double bytes = 3 * n * sizeof(ElemType) + quantized.GetSize(); // gradient and residual in, residual and quantized out
+        string shape = msra::strfun::strprintf("%s %d bits", Shape(rows, cols).c_str(), (int) numBits);
+        benchmark.Run("Quantization/Quantize", shape, bytes, 4 * n, [&]()
+                      {
+                          quantizer->QuantizeAsync(gradient, residual, quantized, residual, false);
+                          quantizer->WaitQuantizeAsyncDone();
+                      });
+        benchmark.Run("Quantization/Unquantize and add", shape, 2 * n * sizeof(ElemType) + quantized.GetSize(), n, [&]()
+                      {
+                          quantizer->UnquantizeAsync(quantized, unquantized, true);
+                          quantizer->WaitUnquantizeAsyncDone();
+                      });
+    }
+}
+
+// -----------------------------------------------------------------------
+// convolution engines
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void ConvolutionBenchmarks(Benchmark& benchmark, typename ConvolutionEngineFactory<ElemType>::EngineType engineType)
+{
+    typedef typename ConvolutionEngineFactory<ElemType>::EngineType EngineType;
+    struct Layer
+    {
+        const char* name;
+        size_t w, h, c, kW, kH, k, stride, n;
+    };
+    const Layer layers[] = {
+        {"MNIST 5x5 16 -> 32", 14, 14, 16, 5, 5, 32, 1, 64},
+        {"CIFAR 5x5 3 -> 32", 32, 32, 3, 5, 5, 32, 1, 64},
+        {"ResNet 3x3 64 -> 64", 58, 58, 64, 3, 3, 64, 1, 16},
+        {"ImageNet 7x7/2 3 -> 64", 229, 229, 3, 7, 7, 64, 2, 16},
+    };
+    int deviceId = benchmark.GetDeviceId();
+    bool cudnn = engineType == EngineType::CuDnn || (engineType == EngineType::Auto && deviceId >= 0);
+    auto factory = ConvolutionEngineFactory<ElemType>::Create(deviceId, engineType, cudnn ? ImageLayoutKind::CHW : ImageLayoutKind::HWC);
+    auto engine = factory->CreateConvEngine(deviceId, 0);
+    for (const auto& layer : layers)
+    {
+        size_t outW = (layer.w - layer.kW) / layer.stride + 1;
+        size_t outH = (layer.h - layer.kH) / layer.stride + 1;
+        auto inT = factory->CreateTensor(layer.w, layer.h, layer.c, layer.n);
+        auto filterT = factory->CreateFilter(layer.kW, layer.kH, layer.c, layer.k);
+        auto outT = factory->CreateTensor(outW, outH, layer.k, layer.n);
+        auto convDesc = factory->CreateConvDescriptor(*inT, *filterT, layer.stride, layer.stride, false);
+
+        Matrix<ElemType> in(layer.w * layer.h * layer.c, layer.n, deviceId), inGrad(layer.w * layer.h * layer.c, layer.n, deviceId);
+        Matrix<ElemType> filter(layer.k, layer.kW * layer.kH * layer.c, deviceId), filterGrad(layer.k, layer.kW * layer.kH * layer.c, deviceId);
+        Matrix<ElemType> out(outW * outH * layer.k, layer.n, deviceId), outGrad(outW * outH * layer.k, layer.n, deviceId);
+        Matrix<ElemType> workspace(deviceId);
+        in.SetUniformRandomValue(-1, 1, 1);
+        filter.SetUniformRandomValue(-1, 1, 2);
+        outGrad.SetUniformRandomValue(-1, 1, 3);
+        inGrad.SetValue(0);
+        filterGrad.SetValue(0);
+
+        double flops = 2.0 * outW * outH * layer.k * layer.kW * layer.kH * layer.c * layer.n;
+        double bytes = ((double) in.GetNumElements() + filter.GetNumElements() + out.GetNumElements()) * sizeof(ElemType);
+        string shape = msra::strfun::strprintf("%dx%dx%d n %d", (int) layer.w, (int) layer.h, (int) layer.c, (int) layer.n);
+        string name = string("Convolution/") + layer.name;
+        benchmark.Run(name + " (forward)", shape, bytes, flops, [&]()
+                      {
+                          engine->Forward(*inT, in, *filterT, filter, *convDesc, *outT, out, workspace);
+                      });
+        benchmark.Run(name + " (backward data)", shape, bytes, flops, [&]()
+                      {
+                          engine->BackwardData(*outT, outGrad, *filterT, filter, *convDesc, *inT, inGrad, workspace);
+                      });
+        benchmark.Run(name + " (backward filter)", shape, bytes, flops, [&]()
+                      {
+                          engine->BackwardFilter(*outT, outGrad, *inT, in, *convDesc, *filterT, filterGrad, true, workspace);
+                      });
+    }
+}
+
+template <class ElemType>
+void RunAll(Benchmark& benchmark, typename ConvolutionEngineFactory<ElemType>::EngineType engineType)
+{
+    ElementwiseBenchmarks<ElemType>(benchmark);
+    GEMMBenchmarks<ElemType>(benchmark);
+    TensorViewBenchmarks<ElemType>(benchmark);
+    SparseBenchmarks<ElemType>(benchmark);
+    QuantizationBenchmarks<ElemType>(benchmark);
+    ConvolutionBenchmarks<ElemType>(benchmark, engineType);
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        Benchmark::Options options;
+        bool useDouble = false;
+        string convEngine = "auto";
+        for (int i = 1; i < argc; i++)
+        {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "-double")
+                useDouble = true;
+            else if (arg == "-device" && hasValue)
+                options.deviceId = atoi(argv[++i]);
+            else if (arg == "-filter" && hasValue)
+                options.filter = argv[++i];
+            else if (arg == "-warmup" && hasValue)
+                options.numWarmups = (size_t) atoi(argv[++i]);
+            else if (arg == "-repeat" && hasValue)
+                options.minRepetitions = (size_t) atoi(argv[++i]);
+            else if (arg == "-seconds" && hasValue)
+                options.minSeconds = atof(argv[++i]);
+            else if (arg == "-convEngine" && hasValue)
+                convEngine = argv[++i];
+            else if (arg == "-json" && hasValue)
+                options.jsonPath = argv[++i];
+            else
+                InvalidArgument("MathBenchmarks: unknown or incomplete argument '%s'; see the header of MathBenchmarks.cpp for the usage.", arg.c_str());
+        }
+        options.precision = useDouble ? "double" : "float";
+        options.minRepetitions = max(options.minRepetitions, (size_t) 1);
+        options.maxRepetitions = max(options.maxRepetitions, options.minRepetitions);
+
+        typedef ConvolutionEngineFactory<float>::EngineType EngineType; // (the same enum values for both precisions)
+        EngineType engineType = convEngine == "cudnn" ? EngineType::CuDnn : convEngine == "legacy" ? EngineType::Legacy : convEngine == "direct" ? EngineType::Direct : EngineType::Auto;
+
+        fprintf(stdout, "Math benchmarks, %s, device %d\n", options.precision, options.deviceId);
+        Benchmark benchmark(options);
+        if (useDouble)
+            RunAll<double>(benchmark, (ConvolutionEngineFactory<double>::EngineType) engineType);
+        else
+            RunAll<float>(benchmark, engineType);
+        return EXIT_SUCCESS;
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+}
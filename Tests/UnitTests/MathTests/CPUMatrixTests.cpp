@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUGemm.h"
+#include "../../../Source/Math/CPUInt8Matrix.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -220,6 +222,51 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyAndDiv, RandomSeedFixture)
     BOOST_CHECK(m3.IsEqualTo(m2));
 }
 
+// the built-in GEMM must agree with the BLAS library, including transposes, beta, and sizes that are not a multiple of its blocking
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyBuiltinGemm, RandomSeedFixture)
+{
+    DMatrix a = DMatrix::RandomUniform(131, 300, -1, 1, IncrementCounter());
+    DMatrix b = DMatrix::RandomUniform(300, 37, -1, 1, IncrementCounter());
+    const DMatrix c0 = DMatrix::RandomUniform(131, 37, -1, 1, IncrementCounter());
+    const DMatrix aT = a.Transpose();
+    const DMatrix bT = b.Transpose();
+
+    for (int trans = 0; trans < 4; trans++)
+    {
+        const bool transposeA = (trans & 2) != 0;
+        const bool transposeB = (trans & 1) != 0;
+        DMatrix c1 = c0, c2 = c0;
+        DMatrix::MultiplyAndWeightedAdd(0.5, transposeA ? aT : a, transposeA, transposeB ? bT : b, transposeB, 2, c1);
+        CPUGemm::SetBackend("builtin");
+        DMatrix::MultiplyAndWeightedAdd(0.5, transposeA ? aT : a, transposeA, transposeB ? bT : b, transposeB, 2, c2);
+        CPUGemm::SetBackend("default");
+        BOOST_CHECK(c1.IsEqualTo(c2, c_epsilonFloatE5));
+    }
+}
+
+// int8 products must be within the quantization error of the float ones (here: 1% of the largest output)
+BOOST_FIXTURE_TEST_CASE(CPUMatrixInt8Multiply, RandomSeedFixture)
+{
+    SMatrix a = SMatrix::RandomUniform(67, 45, -0.5, 0.5, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(45, 13, 0, 1, IncrementCounter());
+    SMatrix aT = a.Transpose();
+    SMatrix c;
+    SMatrix::Multiply(a, b, c);
+
+    for (int transpose = 0; transpose < 2; transpose++)
+    {
+        CPUInt8Matrix<float> quantized(transpose ? aT.GetArray() : a.GetArray(), transpose ? 45 : 67, transpose ? 67 : 45, transpose != 0);
+        BOOST_CHECK_EQUAL(quantized.GetNumRows(), 67);
+        BOOST_CHECK_EQUAL(quantized.GetNumCols(), 45);
+
+        SMatrix cQuantized(67, 13);
+        quantized.Multiply(b.GetArray(), 13, cQuantized.GetArray());
+        const float tolerance = 0.01f * c.MatrixNormInf();
+        foreach_coord (i, j, c)
+            BOOST_CHECK_LT(fabs(cQuantized(i, j) - c(i, j)), tolerance);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixElementOperations, RandomSeedFixture)
 {
     // TODO: consider splitting this large test
@@ -874,6 +921,306 @@ BOOST_FIXTURE_TEST_CASE(CPUColumnElementOperations, RandomSeedFixture)
     BOOST_CHECK(m0.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
+// the float versions of these may use the SIMD kernels (CPUSIMDKernels.cpp); check them against the scalar formula
+// The dimensions are odd such that the non-multiple-of-8 tail is exercised as well.
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSIMDElementOperations, RandomSeedFixture)
+{
+    SMatrix m0 = SMatrix::RandomUniform(37, 29, -5, 5, IncrementCounter());
+    m0(0, 0) = 1e-6f; // tiny values are handled separately in tanh
+    m0(1, 0) = -0.05f;
+
+    SMatrix m1;
+    m1.AssignSigmoidOf(m0);
+    foreach_coord (i, j, m0)
+        BOOST_CHECK_LT(fabs(m1(i, j) - 1 / (1 + exp(-m0(i, j)))), c_epsilonFloatE5);
+    m1.AssignTanhOf(m0);
+    foreach_coord (i, j, m0)
+        BOOST_CHECK_LT(fabs(m1(i, j) - tanh(m0(i, j))), c_epsilonFloatE5);
+    BOOST_CHECK_LT(fabs(m1(0, 0) - 1e-6f), 1e-12f);
+    m1.AssignExpOf(m0);
+    foreach_coord (i, j, m0)
+        BOOST_CHECK_LT(fabs(m1(i, j) - exp(m0(i, j))) / exp(m0(i, j)), c_epsilonFloatE5);
+
+    m1.AssignLogSoftmaxOf(m0, true);
+    foreach_column (j, m0)
+    {
+        double sum = 0;
+        foreach_row (i, m0)
+            sum += exp((double) m0(i, j));
+        foreach_row (i, m0)
+            BOOST_CHECK_LT(fabs(m1(i, j) - (m0(i, j) - log(sum))), c_epsilonFloatE4);
+    }
+
+    SMatrix m2;
+    SMatrix::VectorSum(m0, m2, true);
+    foreach_column (j, m0)
+    {
+        double sum = 0;
+        foreach_row (i, m0)
+            sum += m0(i, j);
+        BOOST_CHECK_LT(fabs(m2(0, j) - sum), c_epsilonFloatE4);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherScatterColumns, RandomSeedFixture)
+{
+    DMatrix a = DMatrix::RandomUniform(4, 10, -1, 1, IncrementCounter());
+    const double ids[] = {3, 0, -1, 3, 9};
+    DMatrix idx(1, 5);
+    for (size_t j = 0; j < 5; j++)
+        idx(0, j) = ids[j];
+
+    DMatrix g(4, 5);
+    g.DoGatherColumnsOf(0, idx, a, 2);
+    foreach_coord (i, j, g)
+        BOOST_CHECK_LT(fabs(g(i, j) - (ids[j] < 0 ? 0 : 2 * a(i, (size_t) ids[j]))), c_epsilonFloatE5);
+
+    // scatter back onto a copy of a, with beta = 1; column 3 receives two contributions, the gap none
+    DMatrix s(a);
+    s.DoScatterColumnsOf(1, idx, g, 0.5);
+    foreach_coord (i, j, s)
+    {
+        double expected = a(i, j) * (j == 3 ? 3 : (j == 0 || j == 9) ? 2 : 1);
+        BOOST_CHECK_LT(fabs(s(i, j) - expected), c_epsilonFloatE5);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignHashedIndicesOf, RandomSeedFixture)
+{
+    const size_t numIds = 2000, numBuckets = 16, numHashes = 2;
+    DMatrix ids(2, numIds / 2); // (the hashes are per element, the shape of ids does not matter)
+    for (size_t k = 0; k < numIds; k++)
+        ids.BufferPointer()[k] = k == 5 ? -1 : (double) (k * 7919 + 100000000);
+
+    DMatrix hashed;
+    hashed.AssignHashedIndicesOf(ids, numBuckets, numHashes);
+    BOOST_CHECK_EQUAL(hashed.GetNumRows(), numIds);
+    BOOST_CHECK_EQUAL(hashed.GetNumCols(), numHashes);
+
+    // buckets are in range and about uniformly used; the gap maps to -1
+    std::vector<size_t> counts(numBuckets, 0);
+    size_t numSame = 0;
+    for (size_t k = 0; k < numIds; k++)
+    {
+        if (k == 5)
+        {
+            BOOST_CHECK_EQUAL(hashed(k, 0), -1);
+            BOOST_CHECK_EQUAL(hashed(k, 1), -1);
+            continue;
+        }
+        BOOST_CHECK(hashed(k, 0) >= 0 && hashed(k, 0) < numBuckets && hashed(k, 0) == floor(hashed(k, 0)));
+        counts[(size_t) hashed(k, 0)]++;
+        numSame += hashed(k, 0) == hashed(k, 1);
+    }
+    for (size_t b = 0; b < numBuckets; b++)
+        BOOST_CHECK(counts[b] > numIds / numBuckets / 2 && counts[b] < numIds / numBuckets * 2);
+
+    // the two hash functions are independent: they agree about as often as chance (1 / numBuckets)
+    BOOST_CHECK_LT(numSame, numIds / numBuckets * 2);
+
+    // and the hashes are a function of the id only
+    DMatrix again;
+    again.AssignHashedIndicesOf(ids.ColumnSlice(10, 5), numBuckets, numHashes);
+    for (size_t k = 0; k < 10; k++)
+        for (size_t h = 0; h < numHashes; h++)
+            BOOST_CHECK_EQUAL(again(k, h), hashed(k + 20, h));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixDoDropoutOf, RandomSeedFixture)
+{
+    const size_t M = 50, N = 40;
+    const double rate = 0.3, scale = 1 / (1 - rate);
+    DMatrix a = DMatrix::RandomUniform(M, N, 1, 2, IncrementCounter());
+
+    DMatrix y(M, N);
+    y.DoDropoutOf(0, a, rate, 1234, 0);
+    size_t numDropped = 0;
+    foreach_coord (i, j, y)
+    {
+        if (y(i, j) == 0)
+            numDropped++;
+        else
+            BOOST_CHECK_LT(fabs(y(i, j) - scale * a(i, j)), c_epsilonFloatE5);
+    }
+    BOOST_CHECK_LT(fabs((double) numDropped / (M * N) - rate), 0.05);
+
+    // the same arguments give the same mask (beta = 1 adds it on top), also for a slice with its offset
+    DMatrix twice(y);
+    twice.DoDropoutOf(1, a, rate, 1234, 0);
+    DMatrix slice(M, 3);
+    slice.DoDropoutOf(0, a.ColumnSlice(7, 3), rate, 1234, 7 * M);
+    foreach_coord (i, j, y)
+        BOOST_CHECK_LT(fabs(twice(i, j) - 2 * y(i, j)), c_epsilonFloatE5);
+    foreach_coord (i, j, slice)
+        BOOST_CHECK_EQUAL(slice(i, j), y(i, j + 7));
+
+    // a different seed gives a different mask
+    DMatrix other(M, N);
+    other.DoDropoutOf(0, a, rate, 1235, 0);
+    size_t numDifferent = 0;
+    foreach_coord (i, j, y)
+        numDifferent += (other(i, j) == 0) != (y(i, j) == 0);
+    BOOST_CHECK_GT(numDifferent, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixCosDistanceWithShiftNeg, RandomSeedFixture)
+{
+    const size_t M = 5, N = 4, shift = 1, neg = 2;
+    DMatrix a = DMatrix::RandomUniform(M, N, -1, 1, IncrementCounter());
+    DMatrix b = DMatrix::RandomUniform(M, N, -1, 1, IncrementCounter());
+    DMatrix g = DMatrix::RandomUniform(neg + 1, N, -1, 1, IncrementCounter());
+
+    // sum(g .* cos) as a function of the inputs
+    auto forward = [&](DMatrix a, DMatrix b, DMatrix& invNormA, DMatrix& invNormB, DMatrix& y) -> double
+    {
+        invNormA.AssignVectorNorm2Of(a, true);
+        invNormA.AssignElementInverseOf(invNormA);
+        invNormB.AssignVectorNorm2Of(b, true);
+        invNormB.AssignElementInverseOf(invNormB);
+        y.AssignCosDistanceWithShiftNegOf(a, b, invNormA, invNormB, shift, neg);
+        double loss = 0;
+        foreach_coord (i, j, y)
+            loss += g(i, j) * y(i, j);
+        return loss;
+    };
+    DMatrix invNormA, invNormB, y;
+    forward(a, b, invNormA, invNormB, y);
+
+    // row i pairs column j of a with column j (i = 0) or (j + shift + i - 1) % N of b
+    foreach_coord (i, j, y)
+    {
+        size_t k = i == 0 ? j : (j + shift + i - 1) % N;
+        double dot = 0, normA = 0, normB = 0;
+        for (size_t r = 0; r < M; r++)
+        {
+            dot += a(r, j) * b(r, k);
+            normA += a(r, j) * a(r, j);
+            normB += b(r, k) * b(r, k);
+        }
+        BOOST_CHECK_LT(fabs(y(i, j) - dot / sqrt(normA * normB)), c_epsilonFloatE5);
+    }
+
+    // gradients against finite differences; they are added to what is there
+    for (int wrtB = 0; wrtB < 2; wrtB++)
+    {
+        DMatrix grad(M, N);
+        grad.SetValue(1);
+        grad.AddCosDistanceWithShiftNegGradientOf(wrtB != 0, g, y, a, b, invNormA, invNormB, shift, neg);
+        const double h = 1e-5;
+        foreach_coord (r, j, grad)
+        {
+            DMatrix plus(wrtB ? b : a), minus(wrtB ? b : a);
+            plus(r, j) += h;
+            minus(r, j) -= h;
+            DMatrix na, nb, ny;
+            double lossPlus = wrtB ? forward(a, plus, na, nb, ny) : forward(plus, b, na, nb, ny);
+            double lossMinus = wrtB ? forward(a, minus, na, nb, ny) : forward(minus, b, na, nb, ny);
+            BOOST_CHECK_LT(fabs(grad(r, j) - 1 - (lossPlus - lossMinus) / (2 * h)), c_epsilonFloatE4);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    const size_t M = 7, N = 5;
+    DMatrix logits = DMatrix::RandomUniform(M, N, -3, 3, IncrementCounter());
+    DMatrix labels(M, N);
+    labels.SetValue(0);
+    for (size_t j = 0; j < N - 1; j++) // last column is a gap: no labels, and logits that must not matter
+        labels(j % M, j) = 1;
+    logits(0, N - 1) = std::numeric_limits<double>::quiet_NaN();
+
+    DMatrix logSumExp(1, N);
+    DMatrix criterion(1, 1);
+    DMatrix::SoftmaxCrossEntropyForward(labels, logits, logSumExp, criterion);
+
+    // compare with the separate log-softmax and inner product
+    DMatrix logSoftmax(M, N);
+    logSoftmax.AssignLogSoftmaxOf(logits, true);
+    double expected = 0;
+    for (size_t j = 0; j < N - 1; j++)
+    {
+        BOOST_CHECK_LT(fabs(logSumExp(0, j) - (logits(0, j) - logSoftmax(0, j))), c_epsilonFloatE5);
+        for (size_t i = 0; i < M; i++)
+            expected -= labels(i, j) * logSoftmax(i, j);
+    }
+    BOOST_CHECK_LT(fabs(criterion(0, 0) - expected), c_epsilonFloatE5);
+
+    // gradient = 2 * (softmax - labels), added to 1
+    DMatrix gradient(1, 1);
+    gradient(0, 0) = 2;
+    DMatrix logitsGradient(M, N);
+    logitsGradient.SetValue(1);
+    DMatrix::SoftmaxCrossEntropyBackward(gradient, labels, logits, logSumExp, logitsGradient);
+    for (size_t j = 0; j < N - 1; j++)
+        for (size_t i = 0; i < M; i++)
+            BOOST_CHECK_LT(fabs(logitsGradient(i, j) - (1 + 2 * (exp(logSoftmax(i, j)) - labels(i, j)))), c_epsilonFloatE5);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixIndexedSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    // the same as with one-hot labels; the last column is a gap (index -1), whose gradient must stay untouched
+    const size_t M = 7, N = 5;
+    DMatrix logits = DMatrix::RandomUniform(M, N, -3, 3, IncrementCounter());
+    DMatrix labels(M, N);
+    labels.SetValue(0);
+    DMatrix labelIndices(1, N);
+    for (size_t j = 0; j < N - 1; j++)
+    {
+        labels((3 * j) % M, j) = 1;
+        labelIndices(0, j) = (double) ((3 * j) % M);
+    }
+    labelIndices(0, N - 1) = -1;
+    logits(0, N - 1) = std::numeric_limits<double>::quiet_NaN();
+
+    DMatrix logSumExp(1, N), expectedLogSumExp(1, N);
+    DMatrix criterion(1, 1), expectedCriterion(1, 1);
+    DMatrix::IndexedSoftmaxCrossEntropyForward(labelIndices, logits, logSumExp, criterion);
+    DMatrix::SoftmaxCrossEntropyForward(labels, logits, expectedLogSumExp, expectedCriterion);
+    BOOST_CHECK_LT(fabs(criterion(0, 0) - expectedCriterion(0, 0)), c_epsilonFloatE5);
+    for (size_t j = 0; j < N - 1; j++)
+        BOOST_CHECK_LT(fabs(logSumExp(0, j) - expectedLogSumExp(0, j)), c_epsilonFloatE5);
+
+    DMatrix gradient(1, 1);
+    gradient(0, 0) = 2;
+    DMatrix logitsGradient(M, N), expectedLogitsGradient(M, N);
+    logitsGradient.SetValue(1);
+    expectedLogitsGradient.SetValue(1);
+    DMatrix::IndexedSoftmaxCrossEntropyBackward(gradient, labelIndices, logits, logSumExp, logitsGradient);
+    DMatrix::SoftmaxCrossEntropyBackward(gradient, labels, logits, expectedLogSumExp, expectedLogitsGradient);
+    for (size_t i = 0; i < M; i++)
+    {
+        for (size_t j = 0; j < N - 1; j++)
+            BOOST_CHECK_LT(fabs(logitsGradient(i, j) - expectedLogitsGradient(i, j)), c_epsilonFloatE5);
+        BOOST_CHECK_EQUAL(logitsGradient(i, N - 1), 1);
+    }
+
+    labelIndices(0, 0) = (double) M;
+    BOOST_CHECK_THROW(DMatrix::IndexedSoftmaxCrossEntropyForward(labelIndices, logits, logSumExp, criterion), std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpColumnReduction, RandomSeedFixture)
+{
+    // the gradient of a bias: sum over the columns, more rows than one block and enough columns to be split into chunks
+    const size_t M = 300, N = 1000;
+    DMatrix a = DMatrix::RandomUniform(M, N, -1, 1, IncrementCounter());
+    DMatrix c = DMatrix::RandomUniform(M, 1, -1, 1, IncrementCounter());
+    DMatrix expected(c);
+
+    SmallVector<size_t> regularOpDims(1, M), reducingOpDims(1, N);
+    std::array<SmallVector<ptrdiff_t>, 2> regularStrides = { SmallVector<ptrdiff_t>(1, 1), SmallVector<ptrdiff_t>(1, 1) };
+    std::array<SmallVector<ptrdiff_t>, 2> reducingStrides = { SmallVector<ptrdiff_t>(1, (ptrdiff_t) M), SmallVector<ptrdiff_t>(1, 0) };
+    c.TensorOp(0.5, a, 2, ElementWiseOperator::opCopy, std::array<size_t, 2>{ 0, 0 }, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    for (size_t i = 0; i < M; i++)
+    {
+        double sum = 0;
+        for (size_t j = 0; j < N; j++)
+            sum += a(i, j);
+        BOOST_CHECK_LT(fabs(c(i, 0) - (0.5 * expected(i, 0) + 2 * sum)), c_epsilonFloatE5);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingFloat, RandomSeedFixture)
 {
     const float low = 0;
@@ -59,6 +59,102 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAddToBlockRow, RandomSeedFixture)
+{
+    // sparse input with a few non-zero rows, e.g. words in a minibatch
+    const size_t m = 100;
+    const size_t k = 8;
+    const size_t n = 5;
+    DenseMatrix dm0(m, k);
+    dm0.SetValue(0);
+    SparseMatrix sm0(MatrixFormat::matrixFormatSparseCSC, m, k, 0);
+    for (size_t col = 0; col < k; col++)
+    {
+        size_t row = (col * 37) % 10 * 7;
+        dm0(row, col) = (double) col + 1;
+        sm0.SetValue(row, col, dm0(row, col));
+    }
+
+    DenseMatrix dm1(n, k);
+    dm1.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    SparseMatrix sm2(MatrixFormat::matrixFormatSparseBlockRow);
+    SparseMatrix::MultiplyAndAdd(0.5, sm0, false, dm1, true, sm2);
+    BOOST_CHECK(sm2.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow);
+    BOOST_CHECK_EQUAL(sm2.NzCount(), 8 * n);
+
+    DenseMatrix dm2(m, n);
+    DenseMatrix::MultiplyAndWeightedAdd(0.5, dm0, false, dm1, true, 0, dm2);
+    DenseMatrix dm3(m, n);
+    dm3.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sm2, dm3);
+
+    BOOST_CHECK(dm2.IsEqualTo(dm3, c_epsilonFloatE4));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAddSparseDense, RandomSeedFixture)
+{
+    // a mostly pruned weight matrix times dense activations
+    const size_t m = 40;
+    const size_t k = 30;
+    const size_t n = 7;
+    DenseMatrix dm0(m, k);
+    dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix sm0(MatrixFormat::matrixFormatSparseCSC, m, k, 0);
+    foreach_coord (row, col, dm0)
+    {
+        if ((row + 3 * col) % 5 != 0)
+            dm0(row, col) = 0;
+        else
+            sm0.SetValue(row, col, dm0(row, col));
+    }
+
+    for (bool transposeA : {false, true})
+    {
+        DenseMatrix dm1(transposeA ? m : k, n);
+        dm1.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix expected(transposeA ? k : m, n);
+        expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix result(expected);
+
+        DenseMatrix::MultiplyAndWeightedAdd(0.5, dm0, transposeA, dm1, false, 0.25, expected);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, sm0, transposeA, dm1, false, 0.25, result);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+        DenseMatrix::MultiplyAndWeightedAdd(1, dm0, transposeA, dm1, false, 0, expected);
+        SparseMatrix::MultiplyAndWeightedAdd(1, sm0, transposeA, dm1, false, 0, result);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixScatterColumnsToBlockCol, RandomSeedFixture)
+{
+    const size_t m = 6;
+    const size_t n = 1000;
+    DenseMatrix a(m, 5);
+    a.SetUniformRandomValue(-1, 1, IncrementCounter());
+    const double ids[] = {700, 3, -1, 700, 12};
+    DenseMatrix idx(1, 5);
+    for (size_t j = 0; j < 5; j++)
+        idx(0, j) = ids[j];
+
+    // scatter twice, as for an embedding shared by two lookups
+    SparseMatrix sm(MatrixFormat::matrixFormatSparseBlockCol, m, n, 0);
+    sm.DoScatterColumnsOf(0, idx, a, 1);
+    sm.DoScatterColumnsOf(1, idx, a, 1);
+    BOOST_CHECK(sm.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol);
+    BOOST_CHECK_EQUAL(sm.NzCount(), 3 * m);
+
+    DenseMatrix expected(m, n);
+    expected.SetValue(0);
+    expected.DoScatterColumnsOf(0, idx, a, 2);
+    DenseMatrix dm(m, n);
+    dm.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sm, dm);
+
+    BOOST_CHECK(dm.IsEqualTo(expected, c_epsilonFloatE4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
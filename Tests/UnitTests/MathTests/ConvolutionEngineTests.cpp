@@ -535,6 +535,145 @@ BOOST_AUTO_TEST_CASE(AvgPoolBackward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(DirectPoolingMatchesLegacyCPU)
+{
+    int deviceId = -1;
+    int n = 3;
+    int cmap = 80; // more than one block of channels
+    int inW = 6;
+    int inH = 5;
+    int kW = 3;
+    int kH = 2;
+    int sW = 1; // overlapping windows
+    int sH = 2;
+    int outW = GetNumOut(inW, kW, sW, false);
+    int outH = GetNumOut(inH, kH, sH, false);
+
+    auto legacyFact = ConvFact::Create(deviceId, ConvFact::EngineType::Legacy, ImageLayoutKind::HWC);
+    auto directFact = ConvFact::Create(deviceId, ConvFact::EngineType::Direct, ImageLayoutKind::HWC);
+    auto legacyEng = legacyFact->CreatePoolEngine(deviceId);
+    auto directEng = directFact->CreatePoolEngine(deviceId);
+    auto inT = directFact->CreateTensor(inW, inH, cmap, n);
+    auto outT = directFact->CreateTensor(outW, outH, cmap, n);
+
+    vec buf(inW * inH * cmap * n);
+    int seed = 0;
+    // small integers, so that there are ties in the max pooling windows
+    std::generate(buf.begin(), buf.end(), [&seed]
+                  {
+                      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+                      return (float) (seed % 7);
+                  });
+    SingleMatrix in(inW * inH * cmap, n, buf.data(), matrixFlagNormal, deviceId);
+
+    for (auto kind : {PoolingDescriptor::PoolKind::Max, PoolingDescriptor::PoolKind::Average})
+    {
+        auto poolT = directFact->CreatePoolDescriptor(kind, kW, kH, sW, sH, 0, 0);
+        SingleMatrix legacyOut(outW * outH * cmap, n, deviceId);
+        SingleMatrix directOut(outW * outH * cmap, n, deviceId);
+        legacyEng->Forward(*inT, in, *poolT, *outT, legacyOut);
+        directEng->Forward(*inT, in, *poolT, *outT, directOut);
+        BOOST_CHECK(directOut.IsEqualTo(legacyOut, 1e-5f));
+
+        SingleMatrix srcGrad(legacyOut);
+        SingleMatrix legacyGrad(inW * inH * cmap, n, deviceId);
+        SingleMatrix directGrad(inW * inH * cmap, n, deviceId);
+        legacyGrad.SetValue(1);
+        directGrad.SetValue(1);
+        legacyEng->Backward(*outT, legacyOut, srcGrad, *poolT, *inT, in, legacyGrad);
+        directEng->Backward(*outT, directOut, srcGrad, *poolT, *inT, in, directGrad);
+        BOOST_CHECK(directGrad.IsEqualTo(legacyGrad, 1e-5f));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchNormalizationSpatialCPU)
+{
+    int deviceId = -1;
+    int n = 4;
+    int cmap = 3;
+    int inW = 2;
+    int inH = 3;
+    int pixels = inW * inH;
+
+    for (auto layout : {ImageLayoutKind::HWC, ImageLayoutKind::CHW})
+    {
+        auto fact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, layout);
+        auto eng = fact->CreateConvEngine(deviceId, 0);
+        auto inT = fact->CreateTensor(inW, inH, cmap, n);
+        auto scaleBiasT = fact->CreateTensor(1, 1, cmap, 1);
+        auto channelOf = [=](int i)
+        {
+            return layout == ImageLayoutKind::HWC ? i % cmap : i / pixels;
+        };
+
+        vec buf(pixels * cmap * n);
+        for (size_t i = 0; i < buf.size(); i++)
+            buf[i] = (float) ((i * 7) % 11) - 5.0f;
+        vec scaleBuf = {1.0f, 2.0f, 0.5f};
+        vec biasBuf = {0.0f, 1.0f, -1.0f};
+        SingleMatrix in(pixels * cmap, n, buf.data(), matrixFlagNormal, deviceId);
+        SingleMatrix scale(cmap, 1, scaleBuf.data(), matrixFlagNormal, deviceId);
+        SingleMatrix bias(cmap, 1, biasBuf.data(), matrixFlagNormal, deviceId);
+        SingleMatrix runMean(cmap, 1, deviceId);
+        SingleMatrix runInvStdDev(cmap, 1, deviceId);
+        SingleMatrix saveMean(cmap, 1, deviceId);
+        SingleMatrix saveInvStdDev(cmap, 1, deviceId);
+        SingleMatrix out(pixels * cmap, n, deviceId);
+        runMean.SetValue(0);
+        runInvStdDev.SetValue(0);
+
+        eng->NormalizeBatch(*inT, in, *scaleBiasT, scale, bias, true, 1.0, runMean, runInvStdDev, out, saveMean, saveInvStdDev);
+
+        // reference: mean and biased variance over the samples and pixels of each channel
+        std::vector<double> mean(cmap, 0), var(cmap, 0);
+        double count = (double) (n * pixels);
+        for (size_t i = 0; i < buf.size(); i++)
+            mean[channelOf((int) (i % (pixels * cmap)))] += buf[i] / count;
+        for (size_t i = 0; i < buf.size(); i++)
+        {
+            int c = channelOf((int) (i % (pixels * cmap)));
+            var[c] += (buf[i] - mean[c]) * (buf[i] - mean[c]) / count;
+        }
+        vec expOut(buf.size());
+        for (size_t i = 0; i < buf.size(); i++)
+        {
+            int c = channelOf((int) (i % (pixels * cmap)));
+            expOut[i] = (float) (scaleBuf[c] * (buf[i] - mean[c]) / sqrt(var[c] + 1e-5) + biasBuf[c]);
+        }
+        SingleMatrix exp(pixels * cmap, n, expOut.data(), matrixFlagNormal, deviceId);
+        BOOST_CHECK(out.IsEqualTo(exp, 1e-4f));
+        // with expAvgFactor 1, the running statistics are those of the batch
+        BOOST_CHECK(runMean.IsEqualTo(saveMean, 1e-6f));
+        BOOST_CHECK(runInvStdDev.IsEqualTo(saveInvStdDev, 1e-6f));
+
+        // inference with the running statistics gives the same output
+        SingleMatrix inferenceOut(pixels * cmap, n, deviceId);
+        eng->NormalizeBatchInference(*inT, in, *scaleBiasT, scale, bias, true, runMean, runInvStdDev, inferenceOut);
+        BOOST_CHECK(inferenceOut.IsEqualTo(exp, 1e-4f));
+
+        // the output gradient is 1 for element 0 and 0 elsewhere; then the bias gradient of its channel is 1, and the
+        // input gradients of a channel sum to 0
+        SingleMatrix srcGrad(pixels * cmap, n, deviceId);
+        srcGrad.SetValue(0);
+        srcGrad(0, 0) = 1;
+        SingleMatrix grad(pixels * cmap, n, deviceId);
+        grad.SetValue(0);
+        SingleMatrix scaleGrad(cmap, 1, deviceId);
+        SingleMatrix biasGrad(cmap, 1, deviceId);
+        eng->BackwardNormalizeBatch(*inT, in, srcGrad, grad, *scaleBiasT, scale, true, saveMean, saveInvStdDev, scaleGrad, biasGrad);
+
+        int c0 = channelOf(0);
+        BOOST_CHECK_CLOSE(biasGrad(c0, 0), 1.0f, 1e-3f);
+        BOOST_CHECK_CLOSE(scaleGrad(c0, 0), (float) ((buf[0] - mean[c0]) / sqrt(var[c0] + 1e-5)), 1e-3f);
+        std::vector<double> gradSum(cmap, 0);
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < pixels * cmap; i++)
+                gradSum[channelOf(i)] += grad(i, j);
+        for (int c = 0; c < cmap; c++)
+            BOOST_CHECK_SMALL(gradSum[c], 1e-4);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
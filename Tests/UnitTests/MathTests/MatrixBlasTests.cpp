@@ -307,6 +307,30 @@ BOOST_FIXTURE_TEST_CASE(MatrixInnerProductOfMatrices, RandomSeedFixture)
     BOOST_CHECK_EQUAL(217, ip);
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixMultiplyAndWeightedAddStridedBatched, RandomSeedFixture)
+{
+    // N products of [M x K] blocks of a with groups of K rows of b, into groups of M rows of c, as in a batched TimesNode
+    const size_t M = 3, K = 4, N = 5, T = 6;
+    SingleMatrix a = SingleMatrix::RandomGaussian(M, K * N, 0, 1, IncrementCounter(), CPUDEVICE);
+    SingleMatrix b = SingleMatrix::RandomGaussian(K * N, T, 0, 1, IncrementCounter(), CPUDEVICE);
+    SingleMatrix c = SingleMatrix::Zeros(M * N, T, CPUDEVICE);
+    SingleMatrix::MultiplyAndWeightedAddStridedBatched(1, a, false, M * K, b, false, K, 0, c, M, M, T, K, N);
+    // and back, with a transposed second factor: d_n = c_n * b_n'
+    SingleMatrix d = SingleMatrix::Zeros(M, K * N, CPUDEVICE);
+    SingleMatrix::MultiplyAndWeightedAddStridedBatched(1, c, false, M, b, true, K, 0, d, M * K, M, K, T, N);
+
+    for (size_t n = 0; n < N; n++)
+    {
+        SingleMatrix bn(CPUDEVICE), cn(CPUDEVICE), expectedC(CPUDEVICE), expectedD(CPUDEVICE);
+        bn.AssignRowSliceValuesOf(b, n * K, K);
+        cn.AssignRowSliceValuesOf(c, n * M, M);
+        SingleMatrix::Multiply(a.ColumnSlice(n * K, K), false, bn, false, expectedC);
+        SingleMatrix::Multiply(cn, false, bn, true, expectedD);
+        BOOST_CHECK(cn.IsEqualTo(expectedC, c_epsilonFloatE4));
+        BOOST_CHECK(d.ColumnSlice(n * K, K).IsEqualTo(expectedD, c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -1079,6 +1079,39 @@ BOOST_FIXTURE_TEST_CASE(MatrixVectorMax, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixVectorMaxTopKLongColumns, RandomSeedFixture)
+{
+    // long columns with many equal values: the k best, best first, equal values by row index
+    const size_t rows = 3001, cols = 7;
+    const int topK = 5;
+    std::vector<float> src(rows * cols);
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+            src[j * rows + i] = (float) ((i * 7919 + j * 104729) % 1000); // 3 or 4 of each of 0..999
+    for (auto deviceId : {CPUDEVICE, AUTOPLACEMATRIX})
+    {
+        Matrix<float> m(rows, cols, src.data(), matrixFlagNormal, deviceId);
+        Matrix<float> idx(deviceId), val(deviceId);
+        m.VectorMax(idx, val, true, topK);
+        BOOST_CHECK_EQUAL(idx.GetNumRows(), topK);
+        for (size_t j = 0; j < cols; j++)
+        {
+            std::vector<size_t> expected(rows);
+            for (size_t i = 0; i < rows; i++)
+                expected[i] = i;
+            std::stable_sort(expected.begin(), expected.end(), [&](size_t a, size_t b)
+                             {
+                                 return src[j * rows + a] > src[j * rows + b];
+                             });
+            for (int k = 0; k < topK; k++)
+            {
+                BOOST_CHECK_EQUAL((size_t) idx(k, j), expected[k]);
+                BOOST_CHECK_EQUAL(val(k, j), src[j * rows + expected[k]]);
+            }
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
 {
     float labels[] = {1.0f, 2.0f, 3.0f};
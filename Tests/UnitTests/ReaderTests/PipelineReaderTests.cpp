@@ -0,0 +1,197 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Readers/ReaderLib/PipelineReader.h"
+#include <set>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// an in-memory deserializer: chunk c has c+1 sequences; sequence i of it has i+1 samples;
+// the one dense stream holds the global sample index, so that every sample can be identified
+class MemoryDeserializer : public IDataDeserializer
+{
+    class MemoryChunk : public Chunk
+    {
+    public:
+        MemoryChunk(size_t firstSample)
+            : m_firstSample(firstSample)
+        {
+        }
+        virtual void GetSamples(size_t indexInChunk, size_t firstSample, size_t numberOfSamples, std::vector<SequenceData>& result) override
+        {
+            result.resize(1);
+            result[0].m_numberOfSamples = numberOfSamples;
+            result[0].m_values.clear();
+            size_t sequenceStart = m_firstSample + indexInChunk * (indexInChunk + 1) / 2;
+            for (size_t t = 0; t < numberOfSamples; t++)
+                result[0].m_values.push_back((float) (sequenceStart + firstSample + t));
+        }
+
+    private:
+        size_t m_firstSample;
+    };
+
+public:
+    MemoryDeserializer(size_t numChunks)
+        : m_numChunks(numChunks)
+    {
+    }
+    virtual std::vector<StreamDescription> GetStreamDescriptions() const override
+    {
+        return std::vector<StreamDescription>{StreamDescription{L"features", 1, false}};
+    }
+    virtual size_t GetNumChunks() const override
+    {
+        return m_numChunks;
+    }
+    virtual void GetSequencesForChunk(size_t chunkId, std::vector<SequenceDescription>& result) const override
+    {
+        result.clear();
+        for (size_t i = 0; i <= chunkId; i++)
+            result.push_back(SequenceDescription{i, i + 1});
+    }
+    virtual ChunkPtr GetChunk(size_t chunkId) override
+    {
+        size_t firstSample = 0;
+        for (size_t c = 0; c < chunkId; c++)
+            firstSample += (c + 1) * (c + 2) / 2;
+        return std::make_shared<MemoryChunk>(firstSample);
+    }
+    size_t GetTotalSamples() const
+    {
+        size_t total = 0;
+        for (size_t c = 0; c < m_numChunks; c++)
+            total += (c + 1) * (c + 2) / 2;
+        return total;
+    }
+
+private:
+    size_t m_numChunks;
+};
+
+// the rest of the epoch after randomizer.StartEpoch()
+static std::vector<size_t> ReadRest(ChunkRandomizer& randomizer)
+{
+    std::vector<size_t> samples;
+    std::vector<SequenceData> data;
+    SequenceReference sequence;
+    while (randomizer.GetNext(sequence))
+    {
+        sequence.m_chunk->GetSamples(sequence.m_indexInChunk, sequence.m_firstSample, sequence.m_numberOfSamples, data);
+        for (auto value : data[0].m_values)
+            samples.push_back((size_t) value);
+    }
+    return samples;
+}
+
+static std::vector<size_t> ReadEpoch(ChunkRandomizer& randomizer, size_t epoch, size_t epochSize, size_t workerRank, size_t numWorkers)
+{
+    randomizer.StartEpoch(epoch, epochSize, workerRank, numWorkers);
+    return ReadRest(randomizer);
+}
+
+BOOST_AUTO_TEST_SUITE(PipelineReaderSuite)
+
+BOOST_AUTO_TEST_CASE(ChunkRandomizerVisitsEachSampleOncePerSweep)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(10);
+    size_t totalSamples = deserializer->GetTotalSamples();
+    for (bool frameMode : {true, false})
+    {
+        ChunkRandomizer randomizer(deserializer, 3, frameMode);
+        for (size_t epoch = 0; epoch < 2; epoch++)
+        {
+            auto samples = ReadEpoch(randomizer, epoch, requestDataSize, 0, 1);
+            BOOST_CHECK_EQUAL(samples.size(), totalSamples);
+            BOOST_CHECK_EQUAL(std::set<size_t>(samples.begin(), samples.end()).size(), totalSamples);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ChunkRandomizerSeeksToEpochStart)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(10);
+    ChunkRandomizer inOrder(deserializer, 3, true);
+    ReadEpoch(inOrder, 0, 17, 0, 1);
+    auto expected = ReadEpoch(inOrder, 1, 17, 0, 1);
+    ChunkRandomizer restarted(deserializer, 3, true);
+    BOOST_CHECK(ReadEpoch(restarted, 1, 17, 0, 1) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkRandomizerContinuesEpochFromPosition)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(10);
+    ChunkRandomizer interrupted(deserializer, 3, false);
+    interrupted.StartEpoch(1, 40, 0, 1);
+    SequenceReference sequence;
+    for (size_t i = 0; i < 4; i++)
+        BOOST_REQUIRE(interrupted.GetNext(sequence));
+    size_t position = interrupted.GetPositionInEpoch();
+    auto expected = ReadRest(interrupted);
+    BOOST_REQUIRE(!expected.empty());
+
+    ChunkRandomizer restarted(deserializer, 3, false);
+    restarted.StartEpoch(1, 40, 0, 1);
+    restarted.SeekInEpoch(position);
+    BOOST_CHECK_EQUAL(restarted.GetPositionInEpoch(), position);
+    BOOST_CHECK(ReadRest(restarted) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkRandomizerIsDeterministicPerSweep)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(10);
+    ChunkRandomizer randomizer1(deserializer, 3, false);
+    ChunkRandomizer randomizer2(deserializer, 3, false);
+    auto sweep0 = ReadEpoch(randomizer1, 0, requestDataSize, 0, 1);
+    BOOST_CHECK(ReadEpoch(randomizer2, 0, requestDataSize, 0, 1) == sweep0);
+    BOOST_CHECK(ReadEpoch(randomizer1, 1, requestDataSize, 0, 1) != sweep0);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkRandomizerShardsByChunk)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(10);
+    std::set<size_t> all;
+    size_t total = 0;
+    for (size_t rank = 0; rank < 3; rank++)
+    {
+        ChunkRandomizer randomizer(deserializer, 2, false);
+        auto samples = ReadEpoch(randomizer, 0, requestDataSize, rank, 3);
+        all.insert(samples.begin(), samples.end());
+        total += samples.size();
+    }
+    BOOST_CHECK_EQUAL(total, deserializer->GetTotalSamples());
+    BOOST_CHECK_EQUAL(all.size(), deserializer->GetTotalSamples());
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerFillsGaps)
+{
+    auto deserializer = std::make_shared<MemoryDeserializer>(3);
+    ChunkRandomizer randomizer(deserializer, 0, false);
+    randomizer.StartEpoch(0, requestDataSize, 0, 1);
+    std::vector<SequenceReference> sequences(3);
+    for (auto& sequence : sequences) // chunk 0: [0]; chunk 1: [1], [2 3]
+        BOOST_CHECK(randomizer.GetNext(sequence));
+
+    Matrix<float> features(CPUDEVICE);
+    std::map<std::wstring, Matrix<float>*> matrices{{L"features", &features}};
+    auto pMBLayout = make_shared<MBLayout>();
+    SequencePacker<float> packer(deserializer->GetStreamDescriptions());
+    packer.Pack(sequences, 2, false, matrices, pMBLayout);
+
+    // each sequence goes to the shorter row: row 0: [0] [2 3]; row 1: [1] gap gap
+    BOOST_CHECK_EQUAL(pMBLayout->GetNumParallelSequences(), 2);
+    BOOST_CHECK_EQUAL(pMBLayout->GetNumTimeSteps(), 3);
+    BOOST_CHECK_EQUAL(features.GetNumCols(), 6);
+    BOOST_CHECK_EQUAL(features(0, 0), 0);
+    BOOST_CHECK_EQUAL(features(0, 1), 1);
+    BOOST_CHECK_EQUAL(features(0, 2), 2);
+    BOOST_CHECK_EQUAL(features(0, 4), 3);
+    BOOST_CHECK(pMBLayout->HasGaps());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }